@@ -0,0 +1,2235 @@
+//-----------------------------------------------------------------------------
+//
+//	Bench.cpp
+//
+//	Benchmark of the driver's receive pipeline.
+//
+//	Plays a Z-Wave controller on one side of a pseudo terminal, with the
+//	library's serial driver on the other, so that no hardware is needed.  The
+//	controller answers the initialization sequence for a set of sleeping sensor
+//	nodes, and then replays reports from them.  Each report goes through
+//	ReadMsg, ProcessMsg, Node::ApplicationCommandHandler and the value update
+//	before a notification reaches the watcher, and the time taken is measured.
+//
+//	With -s, the library's own SimulatedController is used instead, to time the
+//	interview of a larger network with realistic latencies.
+//
+//	With -g, the startup of networks of the given sizes is timed.  For each size,
+//	a SimulatedController network is interviewed and its configuration written.
+//	Then its nodes are replaced by ones made from the device files in the config
+//	folder, and that configuration is read back and written again.  The wall time,
+//	the allocations and the peak resident size of each step are printed, one
+//	result per line, so that runs on different commits can be compared.
+//
+//	With -t, a simulated network is interviewed, and then threads call the
+//	Manager at once: reading values, setting switches, reading node statistics
+//	and enabling polls.  The calls made each second and their latencies are
+//	printed for each number of threads, to show how the Manager's locking scales.
+//
+//	With -w, scripted workloads are run against a real controller, the library's
+//	SimulatedController or a trace recorded with the ControllerTrace option, as -a
+//	selects.  Each workload prints its throughput and the percentiles of its own
+//	latencies, then the driver's latency histograms, the airtime each queue used
+//	and the memory the driver's nodes and queues take, so that a site can be
+//	measured the same way each time.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <new>
+#include <set>
+#include <string>
+#include <vector>
+#include "tinyxml.h"
+#include "Options.h"
+#include "Manager.h"
+#include "Driver.h"
+#include "Notification.h"
+#include "platform/Atomic.h"
+#include "platform/Log.h"
+#include "Defs.h"
+
+using namespace OpenZWave;
+
+#ifndef OZW_CONFIG_PATH
+#define OZW_CONFIG_PATH "../../config/"
+#endif
+
+// The simulated network
+static uint32 const c_homeId = 0x01020304;
+static uint8 const c_controllerNodeId = 1;
+
+// The home ID that the SimulatedController reports
+static uint32 const c_simulatedHomeId = 0x0badc0de;
+
+static int		g_master = -1;				// Our end of the pseudo terminal
+static uint32	g_nodeCount = 32;
+static uint32	g_frameCount = 5000;
+static bool		g_verbose = false;
+
+// Shared between the watcher, the controller thread and the main thread
+static pthread_mutex_t	g_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t	g_cond = PTHREAD_COND_INITIALIZER;
+static uint32			g_protocolInfo = 0;			// Nodes whose protocol info has been received
+static uint32			g_allQueried = 0;			// Set once every node has been interviewed
+static uint32			g_awakeQueried = 0;			// Set once every node that is awake has been interviewed
+static uint32			g_homeId = 0;				// Of the network the driver is ready for
+static bool				g_failed = false;
+static uint32			g_valueNotifications = 0;
+static uint32			g_acks = 0;
+static bool				g_unhandled[256];
+static vector<ValueID>	g_values;					// Every value added
+static map<ValueID,double>	g_pending;				// The values a workload is waiting to hear from, and when each was asked for
+static vector<double>	g_answers;					// The ms from asking for each value to hearing from it
+static set<ValueID>		g_watched;					// The values whose refreshes are counted
+static uint32			g_watchedRefreshes = 0;
+
+// Every allocation made through operator new, by the library or the benchmark
+static volatile uint32	g_allocs = 0;
+static volatile uint64	g_allocBytes __attribute__((aligned(8))) = 0;
+
+#if __cplusplus >= 201103L
+#define BENCH_THROW_BAD_ALLOC
+#define BENCH_NO_THROW noexcept
+#else
+#define BENCH_THROW_BAD_ALLOC throw( std::bad_alloc )
+#define BENCH_NO_THROW throw()
+#endif
+
+//-----------------------------------------------------------------------------
+// <Free>
+// Release what operator new allocated.  Kept out of line, since GCC warns
+// about free on the result of a new expression once delete is inlined.
+//-----------------------------------------------------------------------------
+static void __attribute__((noinline)) Free
+(
+	void* _p
+)
+{
+	free( _p );
+}
+
+//-----------------------------------------------------------------------------
+// <operator new>
+// Count the allocations
+//-----------------------------------------------------------------------------
+void* operator new
+(
+	size_t _size
+)BENCH_THROW_BAD_ALLOC
+{
+	void* p = malloc( _size ? _size : 1 );
+	if( !p )
+	{
+		throw std::bad_alloc();
+	}
+	AtomicIncrement( &g_allocs );
+	AtomicAdd64( &g_allocBytes, _size );
+	return p;
+}
+
+void* operator new[]
+(
+	size_t _size
+)BENCH_THROW_BAD_ALLOC
+{
+	return operator new( _size );
+}
+
+void operator delete
+(
+	void* _p
+)BENCH_NO_THROW
+{
+	Free( _p );
+}
+
+void operator delete[]
+(
+	void* _p
+)BENCH_NO_THROW
+{
+	Free( _p );
+}
+
+#if defined __cpp_sized_deallocation
+// C++14 compilers call these when the size is known.  Without them, the
+// library's would be paired with the new above.
+void operator delete
+(
+	void* _p,
+	size_t
+)BENCH_NO_THROW
+{
+	operator delete( _p );
+}
+
+void operator delete[]
+(
+	void* _p,
+	size_t
+)BENCH_NO_THROW
+{
+	operator delete[]( _p );
+}
+#endif
+
+//-----------------------------------------------------------------------------
+// <Now>
+// Monotonic time in microseconds
+//-----------------------------------------------------------------------------
+static double Now
+(
+)
+{
+	struct timespec ts;
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+}
+
+//-----------------------------------------------------------------------------
+// <Deadline>
+// The time to give up waiting on g_cond, _timeoutMs from now
+//-----------------------------------------------------------------------------
+static void Deadline
+(
+	int32 const _timeoutMs,
+	struct timespec* o_until
+)
+{
+	clock_gettime( CLOCK_REALTIME, o_until );
+	o_until->tv_sec += _timeoutMs / 1000;
+	o_until->tv_nsec += ( _timeoutMs % 1000 ) * 1000000L;
+	if( o_until->tv_nsec >= 1000000000L )
+	{
+		o_until->tv_sec++;
+		o_until->tv_nsec -= 1000000000L;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <WaitFor>
+// Wait, with g_mutex locked, until *_counter passes _target or the time runs out
+//-----------------------------------------------------------------------------
+static bool WaitFor
+(
+	uint32 const* _counter,
+	uint32 const _target,
+	int32 const _timeoutMs
+)
+{
+	struct timespec until;
+	Deadline( _timeoutMs, &until );
+
+	while( *_counter < _target )
+	{
+		if( pthread_cond_timedwait( &g_cond, &g_mutex, &until ) == ETIMEDOUT )
+		{
+			return( *_counter >= _target );
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <OnNotification>
+// Count the value notifications, and the nodes the driver has found
+//-----------------------------------------------------------------------------
+static void OnNotification
+(
+	Notification const* _notification,
+	void* _context
+)
+{
+	pthread_mutex_lock( &g_mutex );
+	switch( _notification->GetType() )
+	{
+		case Notification::Type_ValueAdded:
+		case Notification::Type_ValueChanged:
+		case Notification::Type_ValueRefreshed:
+		{
+			ValueID const& valueId = _notification->GetValueID();
+			if( _notification->GetType() == Notification::Type_ValueAdded )
+			{
+				g_values.push_back( valueId );
+			}
+			else
+			{
+				map<ValueID,double>::iterator it = g_pending.find( valueId );
+				if( it != g_pending.end() )
+				{
+					g_answers.push_back( ( Now() - it->second ) / 1000.0 );
+					g_pending.erase( it );
+				}
+				if( g_watched.find( valueId ) != g_watched.end() )
+				{
+					g_watchedRefreshes++;
+				}
+			}
+			g_valueNotifications++;
+			break;
+		}
+		case Notification::Type_NodeProtocolInfo:
+		{
+			// The rest of each interview waits for the node to wake up
+			g_protocolInfo++;
+			break;
+		}
+		case Notification::Type_DriverReady:
+		{
+			g_homeId = _notification->GetHomeId();
+			break;
+		}
+		case Notification::Type_AllNodesQueried:
+		case Notification::Type_AllNodesQueriedSomeDead:
+		{
+			g_allQueried = 1;
+			g_awakeQueried = 1;
+			break;
+		}
+		case Notification::Type_AwakeNodesQueried:
+		{
+			g_awakeQueried = 1;
+			break;
+		}
+		case Notification::Type_DriverFailed:
+		{
+			g_failed = true;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	pthread_cond_broadcast( &g_cond );
+	pthread_mutex_unlock( &g_mutex );
+}
+
+//-----------------------------------------------------------------------------
+// <Checksum>
+// Set the checksum at the end of a frame
+//-----------------------------------------------------------------------------
+static void Checksum
+(
+	vector<uint8>& _frame
+)
+{
+	uint8 checksum = 0xff;
+	for( uint32 i=1; i<_frame.size()-1; ++i )
+	{
+		checksum ^= _frame[i];
+	}
+	_frame[_frame.size()-1] = checksum;
+}
+
+//-----------------------------------------------------------------------------
+// <WriteFrame>
+// Send a frame to the driver
+//-----------------------------------------------------------------------------
+static void WriteFrame
+(
+	vector<uint8> const& _frame
+)
+{
+	uint32 written = 0;
+	while( written < _frame.size() )
+	{
+		ssize_t n = write( g_master, &_frame[written], _frame.size() - written );
+		if( n <= 0 )
+		{
+			if( errno == EINTR || errno == EAGAIN )
+			{
+				continue;
+			}
+			return;
+		}
+		written += (uint32)n;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SendFrame>
+// Build a frame from its type, function and payload, and send it to the driver
+//-----------------------------------------------------------------------------
+static void SendFrame
+(
+	uint8 const _type,
+	uint8 const _function,
+	uint8 const* _payload,
+	uint32 const _length
+)
+{
+	vector<uint8> frame;
+	frame.push_back( SOF );
+	frame.push_back( (uint8)( _length + 3 ) );
+	frame.push_back( _type );
+	frame.push_back( _function );
+	frame.insert( frame.end(), _payload, _payload + _length );
+	frame.push_back( 0 );
+	Checksum( frame );
+	WriteFrame( frame );
+}
+
+//-----------------------------------------------------------------------------
+// <HandleRequest>
+// Answer a request from the driver the way a static controller would
+//-----------------------------------------------------------------------------
+static void HandleRequest
+(
+	uint8 const* _frame,
+	uint32 const _length
+)
+{
+	uint8 const function = _frame[3];
+	uint8 const* data = &_frame[4];
+	uint8 payload[64];
+	uint32 length = 0;
+	memset( payload, 0, sizeof(payload) );
+
+	switch( function )
+	{
+		case FUNC_ID_ZW_GET_VERSION:
+		{
+			static char const c_version[] = "Z-Wave 4.05";
+			memcpy( payload, c_version, sizeof(c_version) );
+			length = sizeof(c_version);
+			payload[length++] = 0x01;					// Static controller library
+			break;
+		}
+		case FUNC_ID_ZW_MEMORY_GET_ID:
+		{
+			payload[length++] = (uint8)( c_homeId >> 24 );
+			payload[length++] = (uint8)( c_homeId >> 16 );
+			payload[length++] = (uint8)( c_homeId >> 8 );
+			payload[length++] = (uint8)c_homeId;
+			payload[length++] = c_controllerNodeId;
+			break;
+		}
+		case FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:
+		{
+			payload[length++] = 0x08;					// The real primary
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_CAPABILITIES:
+		{
+			static uint8 const c_supported[] =
+			{
+				FUNC_ID_SERIAL_API_GET_INIT_DATA, FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION,
+				FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES, FUNC_ID_SERIAL_API_SET_TIMEOUTS,
+				FUNC_ID_SERIAL_API_GET_CAPABILITIES, FUNC_ID_ZW_SEND_DATA, FUNC_ID_ZW_GET_VERSION,
+				FUNC_ID_ZW_MEMORY_GET_ID, FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO, FUNC_ID_ZW_GET_SUC_NODE_ID,
+				FUNC_ID_ZW_REQUEST_NODE_INFO, FUNC_ID_ZW_GET_ROUTING_INFO
+			};
+			payload[length++] = 5;						// Serial API version
+			payload[length++] = 0;
+			length += 6;								// Manufacturer, product type and id
+			for( uint32 i=0; i<sizeof(c_supported); ++i )
+			{
+				payload[length + ( c_supported[i] - 1 ) / 8] |= 1 << ( ( c_supported[i] - 1 ) % 8 );
+			}
+			length += 32;
+			break;
+		}
+		case FUNC_ID_ZW_GET_SUC_NODE_ID:
+		{
+			payload[length++] = c_controllerNodeId;
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_INIT_DATA:
+		{
+			payload[length++] = 5;
+			payload[length++] = 0x08;					// SUC
+			payload[length++] = NUM_NODE_BITFIELD_BYTES;
+			for( uint32 i=0; i<g_nodeCount; ++i )
+			{
+				uint8 nodeId = (uint8)( c_controllerNodeId + 1 + i );
+				payload[length + ( nodeId - 1 ) / 8] |= 1 << ( ( nodeId - 1 ) % 8 );
+			}
+			length += NUM_NODE_BITFIELD_BYTES;
+			payload[length++] = 5;						// Chip type and version
+			payload[length++] = 0;
+			break;
+		}
+		case FUNC_ID_SERIAL_API_SET_TIMEOUTS:
+		{
+			payload[length++] = data[0];
+			payload[length++] = data[1];
+			break;
+		}
+		case FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION:
+		{
+			// No reply
+			return;
+		}
+		case FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO:
+		{
+			// A routing multilevel sensor that sleeps
+			payload[length++] = 0x53;
+			payload[length++] = 0x9c;
+			payload[length++] = 0x00;
+			payload[length++] = 0x04;
+			payload[length++] = 0x21;
+			payload[length++] = 0x01;
+			break;
+		}
+		case FUNC_ID_ZW_GET_ROUTING_INFO:
+		{
+			length = NUM_NODE_BITFIELD_BYTES;
+			break;
+		}
+		case FUNC_ID_ZW_REQUEST_NODE_INFO:
+		{
+			payload[length++] = 1;
+			SendFrame( RESPONSE, function, payload, length );
+
+			static uint8 const c_commandClasses[] = { 0x31, 0x84 };
+			length = 0;
+			payload[length++] = UPDATE_STATE_NODE_INFO_RECEIVED;
+			payload[length++] = data[0];
+			payload[length++] = (uint8)( 3 + sizeof(c_commandClasses) );
+			payload[length++] = 0x04;
+			payload[length++] = 0x21;
+			payload[length++] = 0x01;
+			memcpy( &payload[length], c_commandClasses, sizeof(c_commandClasses) );
+			length += sizeof(c_commandClasses);
+			SendFrame( REQUEST, FUNC_ID_ZW_APPLICATION_UPDATE, payload, length );
+			return;
+		}
+		case FUNC_ID_ZW_SEND_DATA:
+		{
+			// Every transmission succeeds, though the sleeping nodes never answer
+			payload[length++] = 1;
+			SendFrame( RESPONSE, function, payload, length );
+
+			uint8 callbackId = _frame[_length-2];
+			if( callbackId )
+			{
+				length = 0;
+				payload[length++] = callbackId;
+				payload[length++] = TRANSMIT_COMPLETE_OK;
+				SendFrame( REQUEST, function, payload, length );
+			}
+			return;
+		}
+		default:
+		{
+			if( !g_unhandled[function] )
+			{
+				g_unhandled[function] = true;
+				fprintf( stderr, "Simulated controller: function 0x%.2x is not handled\n", function );
+			}
+			return;
+		}
+	}
+
+	SendFrame( RESPONSE, function, payload, length );
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerThread>
+// Read what the driver sends, acknowledging and answering its requests
+//-----------------------------------------------------------------------------
+static void* ControllerThread
+(
+	void* _context
+)
+{
+	uint8 frame[258];
+	uint32 pos = 0;
+	uint8 buffer[256];
+	ssize_t n;
+	while( ( n = read( g_master, buffer, sizeof(buffer) ) ) != 0 )
+	{
+		if( n < 0 )
+		{
+			if( errno == EINTR || errno == EAGAIN )
+			{
+				continue;
+			}
+			break;
+		}
+
+		for( ssize_t i=0; i<n; ++i )
+		{
+			uint8 byte = buffer[i];
+			if( pos == 0 )
+			{
+				if( byte == SOF )
+				{
+					frame[pos++] = byte;
+				}
+				else if( byte == ACK )
+				{
+					pthread_mutex_lock( &g_mutex );
+					g_acks++;
+					pthread_cond_broadcast( &g_cond );
+					pthread_mutex_unlock( &g_mutex );
+				}
+				continue;
+			}
+
+			frame[pos++] = byte;
+			if( pos >= 2 && pos == (uint32)frame[1] + 2 )
+			{
+				uint8 ack = ACK;
+				if( write( g_master, &ack, 1 ) != 1 )
+				{
+					return NULL;
+				}
+				if( frame[2] == REQUEST )
+				{
+					HandleRequest( frame, pos );
+				}
+				pos = 0;
+			}
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <ReadFrames>
+// Read frames to replay from a file.  Each line holds one frame, written as
+// the "0x01, 0x0c, ..." of the driver's "Received:" log lines.
+//-----------------------------------------------------------------------------
+static bool ReadFrames
+(
+	char const* _filename,
+	vector< vector<uint8> >& _frames
+)
+{
+	std::ifstream file( _filename );
+	if( !file )
+	{
+		return false;
+	}
+
+	string line;
+	while( getline( file, line ) )
+	{
+		vector<uint8> frame;
+		size_t pos = 0;
+		while( ( pos = line.find( "0x", pos ) ) != string::npos )
+		{
+			frame.push_back( (uint8)strtol( line.c_str() + pos, NULL, 16 ) );
+			pos += 2;
+		}
+		// Only unsolicited reports can be replayed
+		if( frame.size() > 7 && frame[0] == SOF && frame[2] == REQUEST && frame[3] == FUNC_ID_APPLICATION_COMMAND_HANDLER )
+		{
+			_frames.push_back( frame );
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <MakeFrame>
+// The _index'th report to replay, sent as if from one of the simulated nodes
+//-----------------------------------------------------------------------------
+static vector<uint8> MakeFrame
+(
+	vector< vector<uint8> > const& _frames,
+	uint32 const _index
+)
+{
+	vector<uint8> frame;
+	if( _frames.empty() )
+	{
+		// A temperature report, with a new reading each time
+		static uint8 const c_report[] = { SOF, 0x0c, REQUEST, FUNC_ID_APPLICATION_COMMAND_HANDLER, 0x00, 0x00, 0x06, 0x31, 0x05, 0x01, 0x22, 0x00, 0x00, 0x00 };
+		frame.assign( c_report, c_report + sizeof(c_report) );
+		uint16 reading = (uint16)( 200 + ( _index / g_nodeCount ) % 100 );
+		frame[11] = (uint8)( reading >> 8 );
+		frame[12] = (uint8)reading;
+	}
+	else
+	{
+		frame = _frames[_index % _frames.size()];
+	}
+
+	frame[5] = (uint8)( c_controllerNodeId + 1 + _index % g_nodeCount );
+	Checksum( frame );
+	return frame;
+}
+
+//-----------------------------------------------------------------------------
+// <Percentile>
+// The _p'th percentile of a sorted set of samples
+//-----------------------------------------------------------------------------
+static double Percentile
+(
+	vector<double> const& _sorted,
+	double const _p
+)
+{
+	if( _sorted.empty() )
+	{
+		return 0.0;
+	}
+	size_t i = (size_t)( _p / 100.0 * ( _sorted.size() - 1 ) + 0.5 );
+	return _sorted[i];
+}
+
+//-----------------------------------------------------------------------------
+// <RunReports>
+// Measure the handling of reports from the emulated controller
+//-----------------------------------------------------------------------------
+static int RunReports
+(
+	vector< vector<uint8> > const& _frames
+)
+{
+	// The driver opens the other end of the pseudo terminal as its serial port
+	g_master = posix_openpt( O_RDWR | O_NOCTTY );
+	if( g_master < 0 || grantpt( g_master ) != 0 || unlockpt( g_master ) != 0 )
+	{
+		perror( "Cannot create a pseudo terminal" );
+		return 1;
+	}
+	string port = ptsname( g_master );
+
+	pthread_t controller;
+	pthread_create( &controller, NULL, ControllerThread, NULL );
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	double start = Now();
+	Manager::Get()->AddDriver( port );
+
+	int result = 0;
+	pthread_mutex_lock( &g_mutex );
+	if( !WaitFor( &g_protocolInfo, g_nodeCount, 60000 ) || g_failed )
+	{
+		pthread_mutex_unlock( &g_mutex );
+		fprintf( stderr, "The driver did not start\n" );
+		result = 1;
+	}
+	else
+	{
+		printf( "Driver ready with %d nodes in %.1f ms\n", g_nodeCount, ( Now() - start ) / 1000.0 );
+		pthread_mutex_unlock( &g_mutex );
+		usleep( 200000 );
+		pthread_mutex_lock( &g_mutex );
+
+		// Warm up, so that every node has created its values
+		for( uint32 i=0; i<g_nodeCount; ++i )
+		{
+			uint32 target = g_valueNotifications + 1;
+			WriteFrame( MakeFrame( _frames, i ) );
+			WaitFor( &g_valueNotifications, target, 2000 );
+		}
+		pthread_mutex_unlock( &g_mutex );
+		usleep( 200000 );
+		pthread_mutex_lock( &g_mutex );
+
+		// Latency: each report waits for the one before it to reach the watcher
+		vector<double> latencies;
+		latencies.reserve( g_frameCount );
+		uint32 lost = 0;
+		for( uint32 i=0; i<g_frameCount; ++i )
+		{
+			uint32 target = g_valueNotifications + 1;
+			vector<uint8> frame = MakeFrame( _frames, g_nodeCount + i );
+			double sent = Now();
+			WriteFrame( frame );
+			if( WaitFor( &g_valueNotifications, target, 2000 ) )
+			{
+				latencies.push_back( Now() - sent );
+			}
+			else
+			{
+				lost++;
+				g_valueNotifications = target;
+			}
+		}
+		std::sort( latencies.begin(), latencies.end() );
+		printf( "Latency of %d reports, from the controller to the watcher (us):\n", (uint32)latencies.size() );
+		printf( "  min %.1f  p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+			Percentile( latencies, 0 ), Percentile( latencies, 50 ), Percentile( latencies, 90 ),
+			Percentile( latencies, 99 ), Percentile( latencies, 100 ) );
+
+		// Throughput: reports are sent as fast as the driver acknowledges them
+		uint32 target = g_valueNotifications + g_frameCount;
+		start = Now();
+		for( uint32 i=0; i<g_frameCount; ++i )
+		{
+			uint32 acks = g_acks + 1;
+			pthread_mutex_unlock( &g_mutex );
+			WriteFrame( MakeFrame( _frames, g_nodeCount + g_frameCount + i ) );
+			pthread_mutex_lock( &g_mutex );
+			WaitFor( &g_acks, acks, 2000 );
+		}
+		if( !WaitFor( &g_valueNotifications, target, 10000 ) )
+		{
+			lost += target - g_valueNotifications;
+		}
+		double elapsed = Now() - start;
+		pthread_mutex_unlock( &g_mutex );
+		printf( "Throughput: %d reports in %.1f ms, %.0f reports/s\n", g_frameCount, elapsed / 1000.0, g_frameCount * 1000000.0 / elapsed );
+
+		if( lost )
+		{
+			printf( "%d reports did not produce a value notification\n", lost );
+		}
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+
+	close( g_master );
+	pthread_join( controller, NULL );
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <PrintLatency>
+// Print the percentiles the driver recorded for one stage
+//-----------------------------------------------------------------------------
+static void PrintLatency
+(
+	char const* _stage,
+	LatencyHistogram::Summary const& _summary
+)
+{
+	printf( "  %-24s %8d %6d %6d %6d %6d\n", _stage, _summary.m_count, _summary.m_p50, _summary.m_p90, _summary.m_p99, _summary.m_max );
+}
+
+//-----------------------------------------------------------------------------
+// <RunInterview>
+// Time the interview of a network simulated by the library
+//-----------------------------------------------------------------------------
+static int RunInterview
+(
+	string const& _settings
+)
+{
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	double start = Now();
+	Manager::Get()->AddDriver( _settings, Driver::ControllerInterface_Simulated );
+
+	int result = 0;
+	pthread_mutex_lock( &g_mutex );
+	if( !WaitFor( &g_allQueried, 1, 600000 ) || g_failed )
+	{
+		fprintf( stderr, "The interview did not finish\n" );
+		result = 1;
+	}
+	else
+	{
+		printf( "Interviewed the simulated network in %.1f ms\n", ( Now() - start ) / 1000.0 );
+	}
+	uint32 homeId = g_homeId;
+	pthread_mutex_unlock( &g_mutex );
+
+	if( result == 0 )
+	{
+		Driver::DriverLatencyData latency;
+		Manager::Get()->GetDriverLatencyStatistics( homeId, &latency );
+		printf( "Latency of each stage (ms):   count    p50    p90    p99    max\n" );
+		PrintLatency( "Query queue wait", latency.m_queueWait[Driver::MsgQueue_Query] );
+		PrintLatency( "Send queue wait", latency.m_queueWait[Driver::MsgQueue_Send] );
+		PrintLatency( "ACK", latency.m_ack );
+		PrintLatency( "Callback", latency.m_callback );
+		PrintLatency( "Reply", latency.m_reply );
+		PrintLatency( "Watchers", latency.m_handler );
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <Resources>
+// The allocations counted so far
+//-----------------------------------------------------------------------------
+struct Resources
+{
+	uint32	m_allocs;
+	uint64	m_allocBytes;
+};
+
+static Resources GetResources
+(
+)
+{
+	Resources resources;
+	resources.m_allocs = AtomicLoad( &g_allocs );
+	resources.m_allocBytes = AtomicLoad64( &g_allocBytes );
+	return resources;
+}
+
+//-----------------------------------------------------------------------------
+// <GetPeakRss>
+// The most memory the process has had resident, in KB
+//-----------------------------------------------------------------------------
+static long GetPeakRss
+(
+)
+{
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+#ifdef DARWIN
+	return usage.ru_maxrss / 1024;
+#else
+	return usage.ru_maxrss;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// <PrintResult>
+// Print one step of the startup benchmark on a line of its own
+//-----------------------------------------------------------------------------
+static void PrintResult
+(
+	uint32 const _nodes,
+	char const* _step,
+	double const _wallUs,
+	Resources const& _before,
+	char const* _extra
+)
+{
+	Resources after = GetResources();
+	printf( "result nodes=%d step=%s wall_ms=%.1f allocs=%u alloc_kb=%u peak_rss_kb=%ld%s\n",
+		_nodes, _step, _wallUs / 1000.0, after.m_allocs - _before.m_allocs,
+		(uint32)( ( after.m_allocBytes - _before.m_allocBytes ) / 1024 ), GetPeakRss(), _extra );
+	fflush( stdout );
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigFilename>
+// The configuration file of the simulated network
+//-----------------------------------------------------------------------------
+static string ConfigFilename
+(
+)
+{
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+
+	char str[32];
+	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", c_simulatedHomeId );
+	return userPath + str;
+}
+
+//-----------------------------------------------------------------------------
+// <TimeWriteConfig>
+// Time the writing of the configuration of a running network
+//-----------------------------------------------------------------------------
+static void TimeWriteConfig
+(
+	uint32 const _nodes,
+	char const* _step,
+	uint32 const _homeId
+)
+{
+	Resources before = GetResources();
+	double start = Now();
+	Manager::Get()->WriteConfig( _homeId );
+	double elapsed = Now() - start;
+
+	Driver::DriverData data;
+	Manager::Get()->GetDriverStatistics( _homeId, &data );
+	struct stat st;
+	long size = ( stat( ConfigFilename().c_str(), &st ) == 0 ) ? (long)st.st_size : 0;
+
+	char extra[64];
+	snprintf( extra, sizeof(extra), " build_ms=%.1f file_kb=%ld", data.m_configBuildTime / 1000.0, size / 1024 );
+	PrintResult( _nodes, _step, elapsed, before, extra );
+}
+
+//-----------------------------------------------------------------------------
+// <Product>
+// A product with a device file
+//-----------------------------------------------------------------------------
+struct Product
+{
+	string	m_manufacturerId;
+	string	m_manufacturerName;
+	string	m_type;
+	string	m_id;
+	string	m_name;
+	string	m_config;
+};
+
+static string GetAttribute
+(
+	TiXmlElement const* _element,
+	char const* _name
+)
+{
+	char const* str = _element->Attribute( _name );
+	return str ? str : "";
+}
+
+//-----------------------------------------------------------------------------
+// <ReadProducts>
+// Read the products in manufacturer_specific.xml that have a device file
+//-----------------------------------------------------------------------------
+static void ReadProducts
+(
+	string const& _configPath,
+	vector<Product>& o_products
+)
+{
+	TiXmlDocument doc;
+	if( !doc.LoadFile( ( _configPath + "manufacturer_specific.xml" ).c_str(), TIXML_ENCODING_UTF8 ) || !doc.RootElement() )
+	{
+		return;
+	}
+
+	set<string> configs;
+	for( TiXmlElement const* manufacturer = doc.RootElement()->FirstChildElement( "Manufacturer" ); manufacturer; manufacturer = manufacturer->NextSiblingElement( "Manufacturer" ) )
+	{
+		for( TiXmlElement const* element = manufacturer->FirstChildElement( "Product" ); element; element = element->NextSiblingElement( "Product" ) )
+		{
+			// Each device file once, and only those that are there
+			string config = GetAttribute( element, "config" );
+			struct stat st;
+			if( config.empty() || !configs.insert( config ).second || stat( ( _configPath + config ).c_str(), &st ) != 0 )
+			{
+				continue;
+			}
+
+			Product product;
+			product.m_manufacturerId = GetAttribute( manufacturer, "id" );
+			product.m_manufacturerName = GetAttribute( manufacturer, "name" );
+			product.m_type = GetAttribute( element, "type" );
+			product.m_id = GetAttribute( element, "id" );
+			product.m_name = GetAttribute( element, "name" );
+			product.m_config = config;
+			o_products.push_back( product );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NewCommandClass>
+// The element of a command class with a single instance
+//-----------------------------------------------------------------------------
+static TiXmlElement* NewCommandClass
+(
+	int const _id
+)
+{
+	TiXmlElement* ccElement = new TiXmlElement( "CommandClass" );
+	ccElement->SetAttribute( "id", _id );
+	ccElement->SetAttribute( "version", 1 );
+
+	TiXmlElement* instanceElement = new TiXmlElement( "Instance" );
+	instanceElement->SetAttribute( "index", 1 );
+	ccElement->LinkEndChild( instanceElement );
+	return ccElement;
+}
+
+//-----------------------------------------------------------------------------
+// <MakeNode>
+// The saved configuration of a node that is one of the products
+//-----------------------------------------------------------------------------
+static TiXmlElement* MakeNode
+(
+	uint8 const _nodeId,
+	Product const& _product,
+	string const& _configPath
+)
+{
+	// Each node is a switch with a sensor, as the SimulatedController's are.  It
+	// sleeps, so that the interview resumed once the configuration has been read
+	// waits for a wake up rather than running alongside the steps being timed.
+	TiXmlElement* nodeElement = new TiXmlElement( "Node" );
+	nodeElement->SetAttribute( "id", _nodeId );
+	nodeElement->SetAttribute( "name", "" );
+	nodeElement->SetAttribute( "location", "" );
+	nodeElement->SetAttribute( "basic", 4 );
+	nodeElement->SetAttribute( "generic", 16 );
+	nodeElement->SetAttribute( "specific", 1 );
+	nodeElement->SetAttribute( "type", "Binary Power Switch" );
+	nodeElement->SetAttribute( "listening", "false" );
+	nodeElement->SetAttribute( "frequentListening", "false" );
+	nodeElement->SetAttribute( "beaming", "true" );
+	nodeElement->SetAttribute( "routing", "true" );
+	nodeElement->SetAttribute( "max_baud_rate", 40000 );
+	nodeElement->SetAttribute( "version", 4 );
+	nodeElement->SetAttribute( "query_stage", "Complete" );
+
+	TiXmlElement* manufacturerElement = new TiXmlElement( "Manufacturer" );
+	manufacturerElement->SetAttribute( "id", _product.m_manufacturerId.c_str() );
+	manufacturerElement->SetAttribute( "name", _product.m_manufacturerName.c_str() );
+	TiXmlElement* productElement = new TiXmlElement( "Product" );
+	productElement->SetAttribute( "type", _product.m_type.c_str() );
+	productElement->SetAttribute( "id", _product.m_id.c_str() );
+	productElement->SetAttribute( "name", _product.m_name.c_str() );
+	manufacturerElement->LinkEndChild( productElement );
+	nodeElement->LinkEndChild( manufacturerElement );
+
+	// Basic, Switch Binary, Switch All, Sensor Multilevel, Configuration,
+	// Manufacturer Specific, Wake Up, Association and Version
+	static uint8 const c_commandClasses[] = { 0x20, 0x25, 0x27, 0x31, 0x70, 0x72, 0x84, 0x85, 0x86 };
+	map<int,TiXmlElement*> ccElements;
+	for( uint32 i=0; i<sizeof(c_commandClasses); ++i )
+	{
+		ccElements[c_commandClasses[i]] = NewCommandClass( c_commandClasses[i] );
+	}
+
+	// Then the values and associations of the device file, as the driver saves them
+	TiXmlDocument device;
+	if( device.LoadFile( ( _configPath + _product.m_config ).c_str(), TIXML_ENCODING_UTF8 ) && device.RootElement() )
+	{
+		for( TiXmlElement const* cc = device.RootElement()->FirstChildElement( "CommandClass" ); cc; cc = cc->NextSiblingElement( "CommandClass" ) )
+		{
+			int id;
+			if( cc->QueryIntAttribute( "id", &id ) != TIXML_SUCCESS || id <= 0 || id > 0xff )
+			{
+				continue;
+			}
+
+			char const* action = cc->Attribute( "action" );
+			if( action && !strcasecmp( action, "remove" ) )
+			{
+				map<int,TiXmlElement*>::iterator it = ccElements.find( id );
+				if( it != ccElements.end() )
+				{
+					delete it->second;
+					ccElements.erase( it );
+				}
+				continue;
+			}
+
+			// Security needs a network key
+			if( id == 0x98 || id == 0x9f )
+			{
+				continue;
+			}
+
+			TiXmlElement*& ccElement = ccElements[id];
+			if( !ccElement )
+			{
+				ccElement = NewCommandClass( id );
+			}
+			for( TiXmlElement const* child = cc->FirstChildElement(); child; child = child->NextSiblingElement() )
+			{
+				ccElement->LinkEndChild( child->Clone() );
+			}
+		}
+	}
+
+	TiXmlElement* ccsElement = new TiXmlElement( "CommandClasses" );
+	for( map<int,TiXmlElement*>::iterator it = ccElements.begin(); it != ccElements.end(); ++it )
+	{
+		ccsElement->LinkEndChild( it->second );
+	}
+	nodeElement->LinkEndChild( ccsElement );
+	return nodeElement;
+}
+
+//-----------------------------------------------------------------------------
+// <MakeSyntheticConfig>
+// Replace the nodes in the configuration of the interviewed network with
+// ones made from the device files
+//-----------------------------------------------------------------------------
+static bool MakeSyntheticConfig
+(
+	uint32 const _nodes,
+	string const& _configPath
+)
+{
+	vector<Product> products;
+	ReadProducts( _configPath, products );
+	if( products.empty() )
+	{
+		fprintf( stderr, "No device files were found in %s\n", _configPath.c_str() );
+		return false;
+	}
+
+	string filename = ConfigFilename();
+	TiXmlDocument doc;
+	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) || !doc.RootElement() )
+	{
+		fprintf( stderr, "Cannot read %s\n", filename.c_str() );
+		return false;
+	}
+
+	// Keep the controller
+	TiXmlElement* driverElement = doc.RootElement();
+	TiXmlElement* child = driverElement->FirstChildElement();
+	while( child )
+	{
+		TiXmlElement* next = child->NextSiblingElement();
+		int id;
+		if( !strcmp( child->Value(), "Node" ) && ( child->QueryIntAttribute( "id", &id ) != TIXML_SUCCESS || id != c_controllerNodeId ) )
+		{
+			driverElement->RemoveChild( child );
+		}
+		child = next;
+	}
+
+	// The products are stepped through in a fixed order, so that every run
+	// with the same config folder has the same mix
+	for( uint32 nodeId=2; nodeId<=_nodes; ++nodeId )
+	{
+		Product const& product = products[( ( nodeId - 2 ) * 97 ) % products.size()];
+		driverElement->LinkEndChild( MakeNode( (uint8)nodeId, product, _configPath ) );
+	}
+
+	if( !doc.SaveFile( filename.c_str() ) )
+	{
+		fprintf( stderr, "Cannot write %s\n", filename.c_str() );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <InterviewNetwork>
+// Time the interview of a simulated network, and the writing of its
+// configuration
+//-----------------------------------------------------------------------------
+static int InterviewNetwork
+(
+	uint32 const _nodes
+)
+{
+	// Without a configuration, every node is interviewed
+	unlink( ConfigFilename().c_str() );
+
+	char settings[64];
+	snprintf( settings, sizeof(settings), "nodes=%d,latency=0", _nodes - 1 );
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	Resources before = GetResources();
+	double start = Now();
+	Manager::Get()->AddDriver( settings, Driver::ControllerInterface_Simulated );
+
+	pthread_mutex_lock( &g_mutex );
+	bool done = WaitFor( &g_allQueried, 1, 600000 ) && !g_failed;
+	double elapsed = Now() - start;
+	uint32 homeId = g_homeId;
+	pthread_mutex_unlock( &g_mutex );
+
+	int result = 0;
+	if( done )
+	{
+		PrintResult( _nodes, "interview", elapsed, before, "" );
+		TimeWriteConfig( _nodes, "write", homeId );
+	}
+	else
+	{
+		fprintf( stderr, "The interview of %d nodes did not finish\n", _nodes );
+		result = 1;
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <LoadNetwork>
+// Time the reading of a synthetic configuration when the driver starts, and
+// the writing of it
+//-----------------------------------------------------------------------------
+static int LoadNetwork
+(
+	uint32 const _nodes,
+	string const& _configPath
+)
+{
+	if( !MakeSyntheticConfig( _nodes, _configPath ) )
+	{
+		return 1;
+	}
+
+	char settings[64];
+	snprintf( settings, sizeof(settings), "nodes=%d,latency=0", _nodes - 1 );
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	Resources before = GetResources();
+	double start = Now();
+	Manager::Get()->AddDriver( settings, Driver::ControllerInterface_Simulated );
+
+	pthread_mutex_lock( &g_mutex );
+	bool ready = WaitFor( &g_homeId, 1, 60000 ) && !g_failed;
+	uint32 homeId = g_homeId;
+	pthread_mutex_unlock( &g_mutex );
+
+	// The driver times ReadConfig itself, and it is finished once that time is set
+	Driver::DriverData data;
+	data.m_configReadTime = 0;
+	for( uint32 i=0; ready && i<10000; ++i )
+	{
+		Manager::Get()->GetDriverStatistics( homeId, &data );
+		if( data.m_configReadTime )
+		{
+			break;
+		}
+		usleep( 1000 );
+	}
+	double elapsed = Now() - start;
+
+	int result = 0;
+	if( !data.m_configReadTime )
+	{
+		fprintf( stderr, "The driver did not start\n" );
+		result = 1;
+	}
+	else if( Manager::Get()->GetNodeManufacturerName( homeId, 2 ).empty() )
+	{
+		fprintf( stderr, "The synthetic configuration was not read\n" );
+		result = 1;
+	}
+	else
+	{
+		char extra[32];
+		snprintf( extra, sizeof(extra), " driver_ms=%.1f", data.m_configReadTime / 1000.0 );
+		PrintResult( _nodes, "read", elapsed, before, extra );
+		TimeWriteConfig( _nodes, "rewrite", homeId );
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <RunStartup>
+// Time the startup of networks of each size
+//-----------------------------------------------------------------------------
+static int RunStartup
+(
+	vector<uint32> const& _sizes,
+	string const& _configPath
+)
+{
+	int result = 0;
+	for( vector<uint32>::const_iterator it = _sizes.begin(); it != _sizes.end() && result == 0; ++it )
+	{
+		// Each step runs in a process of its own, so that the peak resident
+		// size is that of the step alone
+		for( uint32 step=0; step<2 && result == 0; ++step )
+		{
+			fflush( stdout );
+			pid_t pid = fork();
+			if( pid == 0 )
+			{
+				_exit( step ? LoadNetwork( *it, _configPath ) : InterviewNetwork( *it ) );
+			}
+
+			int status;
+			if( pid < 0 || waitpid( pid, &status, 0 ) != pid || !WIFEXITED( status ) || WEXITSTATUS( status ) != 0 )
+			{
+				result = 1;
+			}
+		}
+	}
+
+	unlink( ConfigFilename().c_str() );
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <StressCall>
+// The Manager calls made by the stress threads
+//-----------------------------------------------------------------------------
+enum StressCall
+{
+	StressCall_GetValueAsString = 0,
+	StressCall_GetValueAsBool,
+	StressCall_SetValue,
+	StressCall_GetNodeStatistics,
+	StressCall_EnablePoll,
+	StressCall_Count
+};
+
+static char const* c_stressCallNames[] =
+{
+	"GetValueAsString",
+	"GetValueAsBool",
+	"SetValue",
+	"GetNodeStatistics",
+	"EnablePoll"
+};
+
+// Out of every 16 calls: half read a value as a string, and the rest are
+// spread over the other calls.  Only one in 16 sends anything to the network.
+static StressCall const c_stressMix[16] =
+{
+	StressCall_GetValueAsString, StressCall_GetValueAsBool, StressCall_GetValueAsString, StressCall_GetNodeStatistics,
+	StressCall_GetValueAsString, StressCall_GetValueAsBool, StressCall_GetValueAsString, StressCall_EnablePoll,
+	StressCall_GetValueAsString, StressCall_GetValueAsBool, StressCall_GetValueAsString, StressCall_GetNodeStatistics,
+	StressCall_GetValueAsString, StressCall_SetValue, StressCall_GetValueAsString, StressCall_EnablePoll
+};
+
+//-----------------------------------------------------------------------------
+// <StressThread>
+// What one stress thread is given, and what it measures
+//-----------------------------------------------------------------------------
+struct StressThread
+{
+	pthread_t		m_thread;
+	uint32			m_index;
+	uint32			m_homeId;
+	vector<double>	m_latencies[StressCall_Count];		// Of each call, in microseconds
+};
+
+static volatile uint32	g_stressRun = 0;			// Set while the stress threads are to keep calling
+static vector<ValueID>	g_stressValues;				// Every value of the network
+static vector<ValueID>	g_stressSwitches;			// The switches, which are read as bools and set
+
+//-----------------------------------------------------------------------------
+// <StressThreadProc>
+// Call the Manager in a loop until told to stop
+//-----------------------------------------------------------------------------
+static void* StressThreadProc
+(
+	void* _arg
+)
+{
+	StressThread* thread = (StressThread*)_arg;
+
+	// Each thread picks its values in its own fixed order, so runs can be compared
+	uint32 random = 0x9e3779b9 * ( thread->m_index + 1 );
+	bool polled = false;
+	ValueID const& pollValue = g_stressValues[thread->m_index % g_stressValues.size()];
+	string str;
+	bool state;
+	Node::NodeData nodeData;
+
+	for( uint32 i=0; AtomicLoad( &g_stressRun ); ++i )
+	{
+		random = random * 1664525 + 1013904223;
+		ValueID const& value = g_stressValues[( random >> 8 ) % g_stressValues.size()];
+		ValueID const& switchValue = g_stressSwitches[( random >> 8 ) % g_stressSwitches.size()];
+		StressCall call = c_stressMix[i % 16];
+
+		double start = Now();
+		switch( call )
+		{
+			case StressCall_GetValueAsString:
+			{
+				Manager::Get()->GetValueAsString( value, &str );
+				break;
+			}
+			case StressCall_GetValueAsBool:
+			{
+				Manager::Get()->GetValueAsBool( switchValue, &state );
+				break;
+			}
+			case StressCall_SetValue:
+			{
+				Manager::Get()->SetValue( switchValue, ( random & 0x10000 ) != 0 );
+				break;
+			}
+			case StressCall_GetNodeStatistics:
+			{
+				Manager::Get()->GetNodeStatistics( thread->m_homeId, value.GetNodeId(), &nodeData );
+				break;
+			}
+			case StressCall_EnablePoll:
+			{
+				// Every other time, the poll is disabled again
+				polled = polled ? !Manager::Get()->DisablePoll( pollValue ) : Manager::Get()->EnablePoll( pollValue );
+				break;
+			}
+			default:
+			{
+				break;
+			}
+		}
+		thread->m_latencies[call].push_back( Now() - start );
+	}
+
+	if( polled )
+	{
+		Manager::Get()->DisablePoll( pollValue );
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <PrintStressResult>
+// Print the throughput and latency of one call, on a line of its own
+//-----------------------------------------------------------------------------
+static void PrintStressResult
+(
+	uint32 const _threads,
+	char const* _call,
+	vector<double>& _latencies,
+	double const _elapsedUs
+)
+{
+	std::sort( _latencies.begin(), _latencies.end() );
+	printf( "result threads=%d call=%s calls_per_s=%.0f p50_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+		_threads, _call, _latencies.size() * 1000000.0 / _elapsedUs,
+		Percentile( _latencies, 50 ), Percentile( _latencies, 99 ), Percentile( _latencies, 99.9 ), Percentile( _latencies, 100 ) );
+}
+
+//-----------------------------------------------------------------------------
+// <RunStress>
+// Measure the Manager's throughput and latency as more threads call it
+//-----------------------------------------------------------------------------
+static int RunStress
+(
+	vector<uint32> const& _threadCounts,
+	uint32 const _durationMs
+)
+{
+	char settings[64];
+	snprintf( settings, sizeof(settings), "nodes=%d,latency=0", g_nodeCount );
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	Manager::Get()->AddDriver( settings, Driver::ControllerInterface_Simulated );
+
+	pthread_mutex_lock( &g_mutex );
+	bool done = WaitFor( &g_allQueried, 1, 600000 ) && !g_failed;
+	uint32 homeId = g_homeId;
+	g_stressValues = g_values;
+	pthread_mutex_unlock( &g_mutex );
+
+	for( vector<ValueID>::const_iterator it = g_stressValues.begin(); it != g_stressValues.end(); ++it )
+	{
+		if( it->GetCommandClassId() == 0x25 && it->GetType() == ValueID::ValueType_Bool && it->GetGenre() == ValueID::ValueGenre_User )
+		{
+			g_stressSwitches.push_back( *it );
+		}
+	}
+
+	int result = 0;
+	if( !done || g_stressSwitches.empty() )
+	{
+		fprintf( stderr, "The interview did not finish\n" );
+		result = 1;
+	}
+	else
+	{
+		printf( "Stressing the Manager with %d values of %d nodes\n", (uint32)g_stressValues.size(), g_nodeCount );
+		for( vector<uint32>::const_iterator it = _threadCounts.begin(); it != _threadCounts.end(); ++it )
+		{
+			vector<StressThread*> threads;
+			AtomicStore( &g_stressRun, 1 );
+			double start = Now();
+			for( uint32 i=0; i<*it; ++i )
+			{
+				StressThread* thread = new StressThread();
+				thread->m_index = i;
+				thread->m_homeId = homeId;
+				pthread_create( &thread->m_thread, NULL, StressThreadProc, thread );
+				threads.push_back( thread );
+			}
+			usleep( _durationMs * 1000 );
+			AtomicStore( &g_stressRun, 0 );
+
+			vector<double> latencies[StressCall_Count];
+			for( vector<StressThread*>::iterator tit = threads.begin(); tit != threads.end(); ++tit )
+			{
+				pthread_join( (*tit)->m_thread, NULL );
+				for( uint32 call=0; call<StressCall_Count; ++call )
+				{
+					latencies[call].insert( latencies[call].end(), (*tit)->m_latencies[call].begin(), (*tit)->m_latencies[call].end() );
+				}
+				delete *tit;
+			}
+			double elapsed = Now() - start;
+
+			vector<double> all;
+			for( uint32 call=0; call<StressCall_Count; ++call )
+			{
+				all.insert( all.end(), latencies[call].begin(), latencies[call].end() );
+				PrintStressResult( *it, c_stressCallNames[call], latencies[call], elapsed );
+			}
+			PrintStressResult( *it, "all", all, elapsed );
+			fflush( stdout );
+
+			// Let the network catch up with the values that were set
+			usleep( 500000 );
+		}
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <Workload>
+// The scripted workloads run with -w
+//-----------------------------------------------------------------------------
+enum Workload
+{
+	Workload_Interview = 0,
+	Workload_Set,
+	Workload_Get,
+	Workload_Scene,
+	Workload_Poll,
+	Workload_Idle,
+	Workload_Count
+};
+
+static char const* c_workloadNames[] =
+{
+	"interview",		// The interview of the network from scratch, as the user folder is new
+	"set",				// Switches set on and off, as many at once as there are switches
+	"get",				// Switches refreshed, as many at once as there are switches
+	"scene",			// Scenes of every switch activated, on and off in turn
+	"poll",				// Every switch polled as fast as the driver will send the polls
+	"idle"				// Nothing asked of the network, to measure what it sends by itself
+};
+
+static char const* c_queueNames[] =
+{
+	"command",
+	"security",
+	"noop",
+	"controller",
+	"wakeup",
+	"send",
+	"query",
+	"poll"
+};
+
+// How long to wait for a node to answer before counting a request as lost
+static int32 const c_answerTimeoutMs = 10000;
+
+//-----------------------------------------------------------------------------
+// <WaitForAnswers>
+// Wait, with g_mutex locked, until a value, or every value if _value is NULL,
+// has been heard from.  Those still not heard from when the time runs out are
+// no longer waited for, and the number of them is returned.
+//-----------------------------------------------------------------------------
+static uint32 WaitForAnswers
+(
+	ValueID const* _value,
+	int32 const _timeoutMs
+)
+{
+	struct timespec until;
+	Deadline( _timeoutMs, &until );
+
+	while( _value ? ( g_pending.find( *_value ) != g_pending.end() ) : !g_pending.empty() )
+	{
+		if( pthread_cond_timedwait( &g_cond, &g_mutex, &until ) == ETIMEDOUT )
+		{
+			break;
+		}
+	}
+
+	if( _value )
+	{
+		return (uint32)g_pending.erase( *_value );
+	}
+	uint32 lost = (uint32)g_pending.size();
+	g_pending.clear();
+	return lost;
+}
+
+//-----------------------------------------------------------------------------
+// <RunRequests>
+// Set or refresh the switches, each as soon as it has answered the last time
+//-----------------------------------------------------------------------------
+static uint32 RunRequests
+(
+	Workload const _workload,
+	vector<ValueID> const& _switches,
+	uint32 const _ops
+)
+{
+	uint32 lost = 0;
+	for( uint32 i=0; i<_ops; ++i )
+	{
+		ValueID const& value = _switches[i % _switches.size()];
+		pthread_mutex_lock( &g_mutex );
+		lost += WaitForAnswers( &value, c_answerTimeoutMs );
+		g_pending[value] = Now();
+		pthread_mutex_unlock( &g_mutex );
+
+		// Each pass over the switches turns them the other way
+		bool sent = ( _workload == Workload_Set ) ? Manager::Get()->SetValue( value, ( ( i / _switches.size() ) & 1 ) == 0 ) : Manager::Get()->RefreshValue( value );
+		if( !sent )
+		{
+			pthread_mutex_lock( &g_mutex );
+			lost += (uint32)g_pending.erase( value );
+			pthread_mutex_unlock( &g_mutex );
+		}
+	}
+
+	pthread_mutex_lock( &g_mutex );
+	lost += WaitForAnswers( NULL, c_answerTimeoutMs );
+	pthread_mutex_unlock( &g_mutex );
+	return lost;
+}
+
+//-----------------------------------------------------------------------------
+// <RunScenes>
+// Activate a scene of every switch on, then one of every switch off, timing
+// each until all the switches have answered
+//-----------------------------------------------------------------------------
+static uint32 RunScenes
+(
+	vector<ValueID> const& _switches,
+	uint32 const _ops,
+	vector<double>& o_latencies
+)
+{
+	uint8 scenes[2];
+	for( uint32 i=0; i<2; ++i )
+	{
+		scenes[i] = Manager::Get()->CreateScene();
+		for( vector<ValueID>::const_iterator it = _switches.begin(); it != _switches.end(); ++it )
+		{
+			Manager::Get()->AddSceneValue( scenes[i], *it, i == 0 );
+		}
+	}
+
+	uint32 lost = 0;
+	for( uint32 i=0; i<_ops; ++i )
+	{
+		pthread_mutex_lock( &g_mutex );
+		double start = Now();
+		for( vector<ValueID>::const_iterator it = _switches.begin(); it != _switches.end(); ++it )
+		{
+			g_pending[*it] = start;
+		}
+		pthread_mutex_unlock( &g_mutex );
+
+		Manager::Get()->ActivateScene( scenes[i & 1] );
+
+		pthread_mutex_lock( &g_mutex );
+		lost += WaitForAnswers( NULL, c_answerTimeoutMs );
+		o_latencies.push_back( ( Now() - start ) / 1000.0 );
+		pthread_mutex_unlock( &g_mutex );
+	}
+
+	Manager::Get()->RemoveScene( scenes[0] );
+	Manager::Get()->RemoveScene( scenes[1] );
+	return lost;
+}
+
+//-----------------------------------------------------------------------------
+// <RunPolls>
+// Poll every switch, one after another, for a while
+// Returns the number of polls answered
+//-----------------------------------------------------------------------------
+static uint32 RunPolls
+(
+	vector<ValueID> const& _switches,
+	uint32 const _durationMs
+)
+{
+	int32 interval = Manager::Get()->GetPollInterval();
+
+	// Each poll is sent as soon as the send queues are empty
+	Manager::Get()->SetPollInterval( 1, true );
+	pthread_mutex_lock( &g_mutex );
+	g_watched.insert( _switches.begin(), _switches.end() );
+	g_watchedRefreshes = 0;
+	pthread_mutex_unlock( &g_mutex );
+	for( vector<ValueID>::const_iterator it = _switches.begin(); it != _switches.end(); ++it )
+	{
+		Manager::Get()->EnablePoll( *it );
+	}
+
+	usleep( _durationMs * 1000 );
+
+	for( vector<ValueID>::const_iterator it = _switches.begin(); it != _switches.end(); ++it )
+	{
+		Manager::Get()->DisablePoll( *it );
+	}
+	Manager::Get()->SetPollInterval( interval, false );
+	pthread_mutex_lock( &g_mutex );
+	uint32 refreshes = g_watchedRefreshes;
+	g_watched.clear();
+	pthread_mutex_unlock( &g_mutex );
+	return refreshes;
+}
+
+//-----------------------------------------------------------------------------
+// <PrintWorkload>
+// Print what one workload achieved, and what the driver used doing it
+//-----------------------------------------------------------------------------
+static void PrintWorkload
+(
+	uint32 const _homeId,
+	char const* _name,
+	uint32 const _ops,
+	uint32 const _lost,
+	double const _elapsedUs,
+	vector<double>& _latencies,
+	Driver::DriverData const& _before,
+	Driver::DriverData const& _after
+)
+{
+	std::sort( _latencies.begin(), _latencies.end() );
+	printf( "result workload=%s ops=%u lost=%u wall_ms=%.1f ops_per_s=%.1f p50_ms=%.1f p90_ms=%.1f p99_ms=%.1f max_ms=%.1f\n",
+		_name, _ops, _lost, _elapsedUs / 1000.0, _ops * 1000000.0 / _elapsedUs,
+		Percentile( _latencies, 50 ), Percentile( _latencies, 90 ), Percentile( _latencies, 99 ), Percentile( _latencies, 100 ) );
+
+	printf( "traffic workload=%s reads=%llu writes=%llu retries=%llu dropped=%llu expired=%llu\n", _name,
+		(unsigned long long)( _after.m_readCnt - _before.m_readCnt ), (unsigned long long)( _after.m_writeCnt - _before.m_writeCnt ),
+		(unsigned long long)( _after.m_retries - _before.m_retries ), (unsigned long long)( _after.m_dropped - _before.m_dropped ),
+		(unsigned long long)( _after.m_expired - _before.m_expired ) );
+
+	// The estimated radio time, and the share of the workload's time it took up
+	uint32 airtime = 0;
+	printf( "airtime workload=%s", _name );
+	for( uint32 i=0; i<Driver::MsgQueue_Count; ++i )
+	{
+		uint32 used = _after.m_airtime[i] - _before.m_airtime[i];
+		printf( " %s_ms=%u", c_queueNames[i], used );
+		airtime += used;
+	}
+	printf( " total_ms=%u share=%.1f%%\n", airtime, airtime * 100000.0 / _elapsedUs );
+
+	// The histograms cover everything since the driver started
+	Driver::DriverLatencyData latency;
+	Manager::Get()->GetDriverLatencyStatistics( _homeId, &latency );
+	printf( "Driver latency so far (ms):    count    p50    p90    p99    max\n" );
+	PrintLatency( "Send queue wait", latency.m_queueWait[Driver::MsgQueue_Send] );
+	PrintLatency( "Query queue wait", latency.m_queueWait[Driver::MsgQueue_Query] );
+	PrintLatency( "Poll queue wait", latency.m_queueWait[Driver::MsgQueue_Poll] );
+	PrintLatency( "ACK", latency.m_ack );
+	PrintLatency( "Callback", latency.m_callback );
+	PrintLatency( "Reply", latency.m_reply );
+	PrintLatency( "Watchers", latency.m_handler );
+
+	Driver::MemoryData memory;
+	Manager::Get()->GetMemoryStatistics( _homeId, &memory );
+	uint64 queued = 0;
+	for( uint32 i=0; i<Driver::MsgQueue_Count; ++i )
+	{
+		queued += memory.m_queuedMsgs[i];
+	}
+	printf( "memory workload=%s nodes_kb=%u command_classes_kb=%u values_kb=%u groups_kb=%u queued_kb=%u notifications_kb=%u strings_kb=%u peak_rss_kb=%ld\n", _name,
+		(uint32)( memory.m_nodes / 1024 ), (uint32)( memory.m_commandClasses / 1024 ), (uint32)( memory.m_values / 1024 ),
+		(uint32)( memory.m_groups / 1024 ), (uint32)( ( queued + memory.m_wakeUpQueues ) / 1024 ),
+		(uint32)( memory.m_notifications / 1024 ), (uint32)( memory.m_sharedStrings / 1024 ), GetPeakRss() );
+	fflush( stdout );
+}
+
+//-----------------------------------------------------------------------------
+// <RunWorkloads>
+// Open a network, and run the workloads against it one after another
+//-----------------------------------------------------------------------------
+static int RunWorkloads
+(
+	string const& _controller,
+	vector<uint32> const& _workloads,
+	uint32 const _ops,
+	uint32 const _durationMs
+)
+{
+	// sim:, replay: and tcp: select the other kinds of controller
+	Driver::ControllerInterface controllerInterface = Driver::ControllerInterface_Serial;
+	string path = _controller;
+	if( _controller.compare( 0, 4, "sim:" ) == 0 )
+	{
+		controllerInterface = Driver::ControllerInterface_Simulated;
+		path = _controller.substr( 4 );
+	}
+	else if( _controller.compare( 0, 7, "replay:" ) == 0 )
+	{
+		controllerInterface = Driver::ControllerInterface_Replay;
+		path = _controller.substr( 7 );
+	}
+	else if( _controller.compare( 0, 4, "tcp:" ) == 0 )
+	{
+		controllerInterface = Driver::ControllerInterface_Tcp;
+		path = _controller.substr( 4 );
+	}
+	else if( strcasecmp( _controller.c_str(), "usb" ) == 0 )
+	{
+		controllerInterface = Driver::ControllerInterface_Hid;
+		path = "HID Controller";
+	}
+
+	Manager::Create();
+	Manager::Get()->AddWatcher( OnNotification, NULL );
+	double start = Now();
+	Manager::Get()->AddDriver( path, controllerInterface );
+
+	// Sleeping nodes are not waited for
+	pthread_mutex_lock( &g_mutex );
+	bool ready = WaitFor( &g_awakeQueried, 1, 3600000 ) && !g_failed;
+	double interviewUs = Now() - start;
+	uint32 homeId = g_homeId;
+	vector<ValueID> switches;
+	for( vector<ValueID>::const_iterator it = g_values.begin(); it != g_values.end(); ++it )
+	{
+		if( it->GetCommandClassId() == 0x25 && it->GetType() == ValueID::ValueType_Bool && it->GetGenre() == ValueID::ValueGenre_User )
+		{
+			switches.push_back( *it );
+		}
+	}
+	pthread_mutex_unlock( &g_mutex );
+
+	if( !ready )
+	{
+		fprintf( stderr, "The network on %s could not be opened\n", _controller.c_str() );
+		Manager::Get()->RemoveWatcher( OnNotification, NULL );
+		Manager::Destroy();
+		return 1;
+	}
+	printf( "Running against %s, with %d binary switches\n", _controller.c_str(), (uint32)switches.size() );
+
+	int result = 0;
+	for( vector<uint32>::const_iterator it = _workloads.begin(); it != _workloads.end(); ++it )
+	{
+		Workload workload = (Workload)*it;
+		char const* name = c_workloadNames[workload];
+		bool needsAnswers = ( workload != Workload_Interview && workload != Workload_Idle );
+		if( needsAnswers && ( switches.empty() || controllerInterface == Driver::ControllerInterface_Replay ) )
+		{
+			// A replayed trace does not answer what is sent to it
+			fprintf( stderr, "Skipped the %s workload, which needs binary switches that answer\n", name );
+			result = 1;
+			continue;
+		}
+
+		Driver::DriverData before;
+		Driver::DriverData after;
+		memset( &before, 0, sizeof(before) );
+		if( workload != Workload_Interview )
+		{
+			Manager::Get()->GetDriverStatistics( homeId, &before );
+		}
+		pthread_mutex_lock( &g_mutex );
+		g_answers.clear();
+		pthread_mutex_unlock( &g_mutex );
+
+		vector<double> latencies;
+		uint32 ops = 0;
+		uint32 lost = 0;
+		double workStart = Now();
+		switch( workload )
+		{
+			case Workload_Interview:
+			{
+				ops = 1;
+				latencies.push_back( interviewUs / 1000.0 );
+				workStart -= interviewUs;
+				break;
+			}
+			case Workload_Set:
+			case Workload_Get:
+			{
+				ops = _ops;
+				lost = RunRequests( workload, switches, _ops );
+				pthread_mutex_lock( &g_mutex );
+				latencies = g_answers;
+				pthread_mutex_unlock( &g_mutex );
+				break;
+			}
+			case Workload_Scene:
+			{
+				ops = _ops;
+				lost = RunScenes( switches, _ops, latencies );
+				break;
+			}
+			case Workload_Poll:
+			{
+				ops = RunPolls( switches, _durationMs );
+				break;
+			}
+			default:
+			{
+				usleep( _durationMs * 1000 );
+				break;
+			}
+		}
+		double elapsed = Now() - workStart;
+		Manager::Get()->GetDriverStatistics( homeId, &after );
+		if( workload == Workload_Idle )
+		{
+			// What the network sent by itself
+			ops = (uint32)( after.m_readCnt - before.m_readCnt );
+		}
+		PrintWorkload( homeId, name, ops, lost, elapsed, latencies, before, after );
+	}
+
+	Manager::Get()->RemoveWatcher( OnNotification, NULL );
+	Manager::Destroy();
+	return result;
+}
+
+//-----------------------------------------------------------------------------
+// <ParseWorkloads>
+// Read a list of workload names separated by commas
+//-----------------------------------------------------------------------------
+static bool ParseWorkloads
+(
+	char const* _str,
+	vector<uint32>& o_workloads
+)
+{
+	string str = _str;
+	size_t pos = 0;
+	while( pos <= str.size() )
+	{
+		size_t end = str.find( ',', pos );
+		if( end == string::npos )
+		{
+			end = str.size();
+		}
+		string name = str.substr( pos, end - pos );
+		uint32 i = 0;
+		while( i < Workload_Count && name != c_workloadNames[i] )
+		{
+			++i;
+		}
+		if( i == Workload_Count )
+		{
+			return false;
+		}
+		o_workloads.push_back( i );
+		pos = end + 1;
+	}
+	return !o_workloads.empty();
+}
+
+//-----------------------------------------------------------------------------
+// <ParseList>
+// Read a list of numbers separated by commas, each between _min and _max
+//-----------------------------------------------------------------------------
+static bool ParseList
+(
+	char const* _str,
+	uint32 const _min,
+	uint32 const _max,
+	vector<uint32>& o_list
+)
+{
+	char* p = (char*)_str;
+	while( *p )
+	{
+		uint32 n = (uint32)strtoul( p, &p, 10 );
+		if( n < _min || n > _max || ( *p && *p != ',' ) )
+		{
+			return false;
+		}
+		o_list.push_back( n );
+		if( *p )
+		{
+			++p;
+		}
+	}
+	return !o_list.empty();
+}
+
+//-----------------------------------------------------------------------------
+// <Usage>
+//-----------------------------------------------------------------------------
+static void Usage
+(
+	char const* _name
+)
+{
+	fprintf( stderr, "usage: %s [-n nodes] [-f frames] [-r capture] [-s settings] [-g sizes] [-t threads [-d ms]] [-w workloads [-a controller] [-o ops] [-d ms]] [-c config path] [-v]\n", _name );
+	fprintf( stderr, "  -n  number of simulated nodes (default 32)\n" );
+	fprintf( stderr, "  -f  number of reports to send in each test (default 5000)\n" );
+	fprintf( stderr, "  -r  replay the APPLICATION_COMMAND_HANDLER frames in this file, one per line\n" );
+	fprintf( stderr, "  -s  instead, time the interview of a SimulatedController network, such as nodes=232,latency=20\n" );
+	fprintf( stderr, "  -g  instead, time the startup of networks of these sizes, counting the controller, such as 10,100,232\n" );
+	fprintf( stderr, "  -t  instead, call the Manager from these numbers of threads at once, such as 1,2,4,8, on a simulated network of -n nodes\n" );
+	fprintf( stderr, "  -w  instead, run these workloads in turn, such as interview,set,get,scene,poll,idle\n" );
+	fprintf( stderr, "  -a  the controller for -w: a serial port, usb, tcp:host:port, replay:trace file or sim:settings\n" );
+	fprintf( stderr, "      (default sim:nodes=<-n>,latency=20)\n" );
+	fprintf( stderr, "  -o  number of requests or scene activations in each -w workload (default 200)\n" );
+	fprintf( stderr, "  -d  how long each number of threads calls the Manager, or the poll and idle workloads run, in ms (default 2000)\n" );
+	fprintf( stderr, "  -c  the config folder (default %s)\n", OZW_CONFIG_PATH );
+	fprintf( stderr, "  -v  log the driver's activity to the console\n" );
+}
+
+//-----------------------------------------------------------------------------
+// <main>
+//-----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	string configPath = OZW_CONFIG_PATH;
+	vector< vector<uint8> > frames;
+	string simulated;
+	vector<uint32> sizes;
+	vector<uint32> threads;
+	vector<uint32> workloads;
+	string controller;
+	uint32 ops = 200;
+	uint32 duration = 2000;
+	int opt;
+	while( ( opt = getopt( argc, argv, "n:f:r:s:g:t:w:a:o:d:c:v" ) ) != -1 )
+	{
+		switch( opt )
+		{
+			case 'n':
+			{
+				g_nodeCount = (uint32)atoi( optarg );
+				break;
+			}
+			case 'f':
+			{
+				g_frameCount = (uint32)atoi( optarg );
+				break;
+			}
+			case 'r':
+			{
+				if( !ReadFrames( optarg, frames ) || frames.empty() )
+				{
+					fprintf( stderr, "No reports to replay in %s\n", optarg );
+					return 1;
+				}
+				break;
+			}
+			case 's':
+			{
+				simulated = optarg;
+				break;
+			}
+			case 'g':
+			{
+				if( !ParseList( optarg, 2, 232, sizes ) )
+				{
+					Usage( argv[0] );
+					return 1;
+				}
+				break;
+			}
+			case 't':
+			{
+				if( !ParseList( optarg, 1, 256, threads ) )
+				{
+					Usage( argv[0] );
+					return 1;
+				}
+				break;
+			}
+			case 'w':
+			{
+				if( !ParseWorkloads( optarg, workloads ) )
+				{
+					Usage( argv[0] );
+					return 1;
+				}
+				break;
+			}
+			case 'a':
+			{
+				controller = optarg;
+				break;
+			}
+			case 'o':
+			{
+				ops = (uint32)atoi( optarg );
+				break;
+			}
+			case 'd':
+			{
+				duration = (uint32)atoi( optarg );
+				break;
+			}
+			case 'c':
+			{
+				configPath = optarg;
+				break;
+			}
+			case 'v':
+			{
+				g_verbose = true;
+				break;
+			}
+			default:
+			{
+				Usage( argv[0] );
+				return 1;
+			}
+		}
+	}
+	if( g_nodeCount < 1 || g_nodeCount > 231 || g_frameCount < 1 || duration < 1 || ops < 1 )
+	{
+		Usage( argv[0] );
+		return 1;
+	}
+
+	// Nothing is kept between runs
+	char userPath[] = "/tmp/ozwbenchXXXXXX";
+	if( !mkdtemp( userPath ) )
+	{
+		perror( "Cannot create a user folder" );
+		return 1;
+	}
+
+	// Passed on the command line, so that they win over config/options.xml.  The
+	// interview queries are kept for when the nodes wake up.
+	string options = "--SaveConfiguration false --AssumeAwake false --EnableSIS false";
+	options += g_verbose ? " --Logging true --ConsoleOutput true" : " --Logging false --ConsoleOutput false";
+	Options::Create( configPath, string( userPath ) + "/", options );
+	Options::Get()->Lock();
+
+	int result = 0;
+	if( !workloads.empty() )
+	{
+		if( controller.empty() )
+		{
+			char settings[64];
+			snprintf( settings, sizeof(settings), "sim:nodes=%d,latency=20", g_nodeCount );
+			controller = settings;
+		}
+		result = RunWorkloads( controller, workloads, ops, duration );
+	}
+	else if( !sizes.empty() )
+	{
+		result = RunStartup( sizes, configPath );
+	}
+	else if( !threads.empty() )
+	{
+		result = RunStress( threads, duration );
+	}
+	else if( !simulated.empty() )
+	{
+		result = RunInterview( simulated );
+	}
+	else
+	{
+		result = RunReports( frames );
+	}
+
+	Options::Destroy();
+
+	// The log file is opened even when logging is off
+	unlink( ( string( userPath ) + "/OZW_Log.txt" ).c_str() );
+	unlink( ( string( userPath ) + "/zwscene.xml" ).c_str() );
+	rmdir( userPath );
+	return result;
+}
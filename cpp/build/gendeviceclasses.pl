@@ -0,0 +1,176 @@
+#!/usr/bin/perl
+
+# Generates cpp/src/DeviceClassTables.cpp, the built in device class tables,
+# from config/device_classes.xml.  Run it (or "make devclasses") whenever the
+# XML changes, and commit the result.
+#
+# usage: gendeviceclasses.pl [device_classes.xml] [DeviceClassTables.cpp]
+
+use strict;
+use File::Basename;
+
+my $top = dirname(__FILE__) . "/../..";
+my $input = $ARGV[0] || "$top/config/device_classes.xml";
+my $output = $ARGV[1] || "$top/cpp/src/DeviceClassTables.cpp";
+
+open(my $in, "<", $input) or die "Cannot open $input: $!";
+my $xml = do { local $/; <$in> };
+close($in);
+
+# Comments may contain anything that looks like an element
+$xml =~ s/<!--.*?-->//gs;
+
+sub Attributes {
+    my %attrs;
+    while ($_[0] =~ /([\w:]+)\s*=\s*(["'])(.*?)\2/g) {
+        my ($name, $value) = ($1, $3);
+        $value =~ s/&lt;/</g;
+        $value =~ s/&gt;/>/g;
+        $value =~ s/&quot;/"/g;
+        $value =~ s/&apos;/'/g;
+        $value =~ s/&amp;/&/g;
+        $attrs{$name} = $value;
+    }
+    return \%attrs;
+}
+
+# Parse a hex number the way strtol( str, &end, 16 ) does
+sub Hex {
+    my ($str) = @_;
+    return 0 unless $str =~ /^\s*(?:0[xX])?([0-9a-fA-F]+)/;
+    return hex($1);
+}
+
+sub Entry {
+    my ($attrs, $key) = @_;
+    my $entry = { key => $key, label => $attrs->{'label'} };
+    $entry->{'label'} = "" unless defined $entry->{'label'};
+    if (defined $attrs->{'command_classes'}) {
+        my @ccs = map { Hex($_) & 0xff } grep { $_ ne "" } split(/,/, $attrs->{'command_classes'});
+        $entry->{'ccs'} = \@ccs;
+    }
+    $entry->{'basic'} = defined $attrs->{'basic'} ? Hex($attrs->{'basic'}) & 0xff : 0;
+    $entry->{'specific'} = {};
+    return $entry;
+}
+
+# As with the XML loader, a key that appears twice keeps the last entry
+my %tables = ( Basic => {}, Generic => {}, Role => {}, DeviceType => {}, NodeType => {} );
+my $generic;
+while ($xml =~ /<(\/?)(\w+)([^>]*?)(\/?)>/g) {
+    my ($close, $name, $attrText, $empty) = ($1, $2, $3, $4);
+    if ($close) {
+        undef $generic if $name eq "Generic";
+        next;
+    }
+
+    my $attrs = Attributes($attrText);
+    next unless defined $attrs->{'key'};
+    my $key = Hex($attrs->{'key'}) & 0xffff;
+
+    if ($name eq "Specific") {
+        $generic->{'specific'}{$key & 0xff} = Entry($attrs, $key & 0xff) if $generic;
+    } elsif ($name eq "Generic") {
+        my $entry = Entry($attrs, $key & 0xff);
+        $tables{'Generic'}{$key & 0xff} = $entry;
+        $generic = $empty ? undef : $entry;
+    } elsif ($name eq "Basic") {
+        $tables{'Basic'}{$key} = Entry($attrs, $key) if defined $attrs->{'label'};
+    } elsif (exists $tables{$name}) {
+        $tables{$name}{$key} = Entry($attrs, $key);
+    }
+}
+
+# Identical command class lists are only emitted once
+my %ccArrays;
+my @ccOrder;
+sub CCArray {
+    my ($entry) = @_;
+    return "NULL" unless defined $entry->{'ccs'};
+    my $body = join(", ", (map { sprintf("0x%.2x", $_) } @{$entry->{'ccs'}}), "0");
+    unless (exists $ccArrays{$body}) {
+        $ccArrays{$body} = "c_cc" . scalar(@ccOrder);
+        push(@ccOrder, $body);
+    }
+    return $ccArrays{$body};
+}
+
+sub Quote {
+    my ($str) = @_;
+    $str =~ s/\\/\\\\/g;
+    $str =~ s/"/\\"/g;
+    return "\"$str\"";
+}
+
+sub EntryInit {
+    my ($entry, $specific, $count) = @_;
+    return sprintf("{ 0x%.4x, 0x%.2x, %s, %s, %s, %d }", $entry->{'key'}, $entry->{'basic'}, Quote($entry->{'label'}), CCArray($entry), $specific, $count);
+}
+
+my @arrays;
+my @tables;
+foreach my $name ("Basic", "Generic", "Role", "DeviceType", "NodeType") {
+    my $table = $tables{$name};
+    my @keys = sort { $a <=> $b } keys %$table;
+    my @lines;
+    foreach my $key (@keys) {
+        my $entry = $table->{$key};
+        my @specificKeys = sort { $a <=> $b } keys %{$entry->{'specific'}};
+        my $specific = "NULL";
+        if (@specificKeys) {
+            $specific = sprintf("c_specific%.2x", $key);
+            push(@arrays, "static DeviceClasses::Entry const $specific\[\] =\n{\n"
+                . join(",\n", map { "\t" . EntryInit($entry->{'specific'}{$_}, "NULL", 0) } @specificKeys) . "\n};\n");
+        }
+        push(@lines, "\t" . EntryInit($entry, $specific, scalar(@specificKeys)));
+    }
+
+    if (@lines) {
+        my $array = "c_" . lcfirst($name);
+        push(@arrays, "static DeviceClasses::Entry const $array\[\] =\n{\n" . join(",\n", @lines) . "\n};\n");
+        push(@tables, "DeviceClasses::Table const DeviceClasses::s_builtin$name = { $array, " . scalar(@lines) . ", false };\n");
+    } else {
+        push(@tables, "DeviceClasses::Table const DeviceClasses::s_builtin$name = { NULL, 0, false };\n");
+    }
+}
+
+open(my $out, ">", $output) or die "Cannot write $output: $!";
+print $out <<'EOF';
+//-----------------------------------------------------------------------------
+//
+//	DeviceClassTables.cpp
+//
+//	Built in device class tables
+//
+//	Generated from config/device_classes.xml by cpp/build/gendeviceclasses.pl.
+//	Do not edit this file by hand.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "DeviceClasses.h"
+
+using namespace OpenZWave;
+
+EOF
+for (my $i = 0; $i < @ccOrder; ++$i) {
+    print $out "static uint8 const c_cc$i\[\] = { $ccOrder[$i] };\n";
+}
+print $out "\n" . join("\n", @arrays) . "\n" . join("", @tables);
+close($out);
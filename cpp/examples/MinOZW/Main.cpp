@@ -375,9 +375,9 @@ int main( int argc, char* argv[] )
 
 		Driver::DriverData data;
 		Manager::Get()->GetDriverStatistics( g_homeId, &data );
-		printf("SOF: %d ACK Waiting: %d Read Aborts: %d Bad Checksums: %d\n", data.m_SOFCnt, data.m_ACKWaiting, data.m_readAborts, data.m_badChecksum);
-		printf("Reads: %d Writes: %d CAN: %d NAK: %d ACK: %d Out of Frame: %d\n", data.m_readCnt, data.m_writeCnt, data.m_CANCnt, data.m_NAKCnt, data.m_ACKCnt, data.m_OOFCnt);
-		printf("Dropped: %d Retries: %d\n", data.m_dropped, data.m_retries);
+		printf("SOF: %llu ACK Waiting: %llu Read Aborts: %llu Bad Checksums: %llu\n", (unsigned long long)data.m_SOFCnt, (unsigned long long)data.m_ACKWaiting, (unsigned long long)data.m_readAborts, (unsigned long long)data.m_badChecksum);
+		printf("Reads: %llu Writes: %llu CAN: %llu NAK: %llu ACK: %llu Out of Frame: %llu\n", (unsigned long long)data.m_readCnt, (unsigned long long)data.m_writeCnt, (unsigned long long)data.m_CANCnt, (unsigned long long)data.m_NAKCnt, (unsigned long long)data.m_ACKCnt, (unsigned long long)data.m_OOFCnt);
+		printf("Dropped: %llu Retries: %llu\n", (unsigned long long)data.m_dropped, (unsigned long long)data.m_retries);
 	}
 
 	// program exit (clean up)
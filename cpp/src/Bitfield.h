@@ -31,8 +31,67 @@
 #include <vector>
 #include "Defs.h" 
 
+#if defined _MSC_VER
+#include <intrin.h>
+#pragma intrinsic(_BitScanForward)
+#endif
+
 namespace OpenZWave
 {
+	/**
+	 * \return the position of the lowest set bit.  _bits must not be zero.
+	 */
+	inline uint32 BitCountTrailingZeros( uint32 const _bits )
+	{
+#if defined _MSC_VER
+		unsigned long idx;
+		_BitScanForward( &idx, _bits );
+		return (uint32)idx;
+#else
+		return (uint32)__builtin_ctz( _bits );
+#endif
+	}
+
+	/**
+	 * \return the number of set bits.
+	 */
+	inline uint32 BitPopCount( uint32 _bits )
+	{
+#if defined _MSC_VER
+		// __popcnt needs a processor with the POPCNT instruction, so add up the bits in pairs, then nibbles, then bytes
+		_bits = _bits - ( ( _bits >> 1 ) & 0x55555555 );
+		_bits = ( _bits & 0x33333333 ) + ( ( _bits >> 2 ) & 0x33333333 );
+		return ( ( ( _bits + ( _bits >> 4 ) ) & 0x0f0f0f0f ) * 0x01010101 ) >> 24;
+#else
+		return (uint32)__builtin_popcount( _bits );
+#endif
+	}
+
+	/**
+	 * Find the next set bit in an array of words, skipping whole words that are clear.
+	 * \param _words the bits, 32 to a word, lowest first.
+	 * \param _numWords the number of words.
+	 * \param _idx the bit to start looking from.
+	 * \return the position of the first set bit at or after _idx, or _numWords*32 if there is none.
+	 */
+	inline uint32 BitFindNextSet( uint32 const* _words, uint32 const _numWords, uint32 const _idx )
+	{
+		uint32 word = _idx >> 5;
+		if( word < _numWords )
+		{
+			uint32 bits = _words[word] & ~( ( 1u << ( _idx & 0x1f ) ) - 1 );
+			while( bits == 0 && ++word < _numWords )
+			{
+				bits = _words[word];
+			}
+			if( bits != 0 )
+			{
+				return ( word << 5 ) + BitCountTrailingZeros( bits );
+			}
+		}
+		return _numWords << 5;
+	}
+
 	class OPENZWAVE_EXPORT Bitfield
 	{
 		friend class Iterator;
@@ -95,7 +154,7 @@ namespace OpenZWave
 			Iterator operator++(int)
 			{
 				Iterator tmp = *this;
-				++tmp;
+				NextSetBit();
 				return tmp;
 			}
 
@@ -121,24 +180,9 @@ namespace OpenZWave
 
 			void NextSetBit()
 			{
-				while( ((++m_idx)>>5)<m_bitfield->m_bits.size() )
-				{
-					// See if there are any bits left to find in the current uint32
-					if( ( m_bitfield->m_bits[m_idx>>5] & ~((1<<(m_idx&0x1f))-1) ) == 0 )
-					{
-						// No more bits - move on to next uint32 (or rather one less than 
-						// the next uint32 because of the preincrement in the while statement)
-						m_idx = (m_idx&0xffffffe0)+31;
-					}
-					else
-					{
-						if( (m_bitfield->m_bits[m_idx>>5] & (1<<(m_idx&0x1f))) !=0 )
-						{
-							// This bit is set
-							return;
-						}
-					}
-				}
+				// A word at a time, which stops at the end iterator's position if no more bits are set
+				uint32 numWords = (uint32)m_bitfield->m_bits.size();
+				m_idx = numWords ? BitFindNextSet( &m_bitfield->m_bits[0], numWords, m_idx + 1 ) : 0;
 			}
 
 			uint32				m_idx;
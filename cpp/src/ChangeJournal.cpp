@@ -0,0 +1,150 @@
+//-----------------------------------------------------------------------------
+//
+//	ChangeJournal.cpp
+//
+//	The most recent changes to a network, numbered so they can be caught up on
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <time.h>
+#include "ChangeJournal.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ChangeJournal::Change::Change>
+// Constructor
+//-----------------------------------------------------------------------------
+ChangeJournal::Change::Change
+(
+	uint64 const _sequence,
+	Notification const& _notification
+):
+	m_sequence( _sequence ),
+	m_type( _notification.GetType() ),
+	m_valueId( _notification.GetValueID() ),
+	m_groupIdx( ( _notification.GetType() == Notification::Type_Group ) ? _notification.GetByte() : 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ChangeJournal::ChangeJournal>
+// Constructor
+//-----------------------------------------------------------------------------
+ChangeJournal::ChangeJournal
+(
+	uint32 const _capacity
+):
+	m_capacity( _capacity ? _capacity : 1 ),
+	// Starting from the time leaves room for 16 million changes a second
+	// before the numbers could meet those of a later run
+	m_latest( ( (uint64)time( NULL ) ) << 24 ),
+	m_first( m_latest + 1 )
+{
+	m_changes.reserve( m_capacity );
+}
+
+//-----------------------------------------------------------------------------
+// <ChangeJournal::IsKept>
+// Whether notifications of a type are changes to keep
+//-----------------------------------------------------------------------------
+bool ChangeJournal::IsKept
+(
+	Notification::NotificationType const _type
+)
+{
+	switch( _type )
+	{
+		case Notification::Type_ValueAdded:
+		case Notification::Type_ValueRemoved:
+		case Notification::Type_ValueChanged:
+		case Notification::Type_Group:
+		case Notification::Type_NodeNew:
+		case Notification::Type_NodeAdded:
+		case Notification::Type_NodeRemoved:
+		case Notification::Type_NodeReset:
+		case Notification::Type_NodeNaming:
+		case Notification::Type_DriverReset:
+		{
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ChangeJournal::Record>
+// Note a change
+//-----------------------------------------------------------------------------
+void ChangeJournal::Record
+(
+	Notification const& _notification
+)
+{
+	if( !IsKept( _notification.GetType() ) )
+	{
+		return;
+	}
+
+	Change change( ++m_latest, _notification );
+	if( m_changes.size() < m_capacity )
+	{
+		m_changes.push_back( change );
+	}
+	else
+	{
+		m_changes[(uint32)( ( m_latest - m_first ) % m_capacity )] = change;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ChangeJournal::GetSince>
+// Copy the changes made after a sequence number
+//-----------------------------------------------------------------------------
+bool ChangeJournal::GetSince
+(
+	uint64 const _sequence,
+	vector<Change>* o_changes
+)const
+{
+	o_changes->clear();
+	if( _sequence > m_latest )
+	{
+		// From another run
+		return false;
+	}
+
+	uint64 oldest = m_latest + 1 - (uint64)m_changes.size();
+	if( _sequence + 1 < oldest )
+	{
+		// Overwritten, or from before this run
+		return false;
+	}
+
+	o_changes->reserve( (size_t)( m_latest - _sequence ) );
+	for( uint64 sequence = _sequence + 1; sequence <= m_latest; ++sequence )
+	{
+		o_changes->push_back( m_changes[(uint32)( ( sequence - m_first ) % m_capacity )] );
+	}
+	return true;
+}
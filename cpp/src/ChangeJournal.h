@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+//
+//	ChangeJournal.h
+//
+//	The most recent changes to a network, numbered so they can be caught up on
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ChangeJournal_H
+#define _ChangeJournal_H
+
+#include <vector>
+#include "Defs.h"
+#include "Notification.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	/** \brief The last changes made to a network's nodes, values and groups.
+	 *
+	 * Each driver keeps the last ChangeJournalSize changes (1024 by default) that
+	 * it tells the watchers about: values added, removed and changed, nodes added,
+	 * removed and renamed, associations changed and the driver being reset.  Each
+	 * change has a sequence number one higher than the one before.
+	 *
+	 * An application that loses track, such as a client that reconnects, keeps
+	 * the sequence number of the last change it saw and calls
+	 * Manager::GetChangesSince to be given the ones it missed.  If they are no longer
+	 * all kept, it must read the network again: it calls Manager::GetChangeSequence
+	 * first, then reads everything, then catches up from that sequence number.
+	 *
+	 * The numbers carry on from a different point each time a driver starts, so a
+	 * sequence number from an earlier run is never mistaken for one of this run.
+	 */
+	class OPENZWAVE_EXPORT ChangeJournal
+	{
+	public:
+		/** \brief One change. */
+		struct Change
+		{
+			Change( uint64 const _sequence, Notification const& _notification );
+
+			uint64							m_sequence;
+			Notification::NotificationType	m_type;			// One of the notification types listed above
+			ValueID							m_valueId;		// The value, or for a node or group change only the home and node IDs are set
+			uint8							m_groupIdx;		// For Type_Group, the group that changed
+		};
+
+		/**
+		 * \param _capacity the number of changes to keep.
+		 */
+		ChangeJournal( uint32 const _capacity );
+
+		/**
+		 * Note a change, if the notification is of a type that is kept.
+		 */
+		void Record( Notification const& _notification );
+
+		/**
+		 * \return the sequence number of the latest change.
+		 */
+		uint64 GetSequence()const{ return m_latest; }
+
+		/**
+		 * Copy the changes made after a sequence number.
+		 * \param _sequence the sequence number of the last change already seen.
+		 * \param o_changes cleared, then filled with the later changes, oldest first.
+		 * \return false if some of those changes are no longer kept, or the sequence number is not from this journal.
+		 */
+		bool GetSince( uint64 const _sequence, vector<Change>* o_changes )const;
+
+	private:
+		static bool IsKept( Notification::NotificationType const _type );
+
+		uint32			m_capacity;
+		uint64			m_latest;				// Sequence number of the latest change
+		uint64			m_first;				// Sequence number of the first change this journal gives
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<Change>	m_changes;				// The change numbered n is at ( n - m_first ) % m_capacity
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ChangeJournal_H
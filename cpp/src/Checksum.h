@@ -0,0 +1,64 @@
+//-----------------------------------------------------------------------------
+//
+//	Checksum.h
+//
+//	Frame checksums and CRCs
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _Checksum_H
+#define _Checksum_H
+
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/**
+	 * XOR the bytes of a buffer together, as for the checksum of a Serial API frame.
+	 * The bulk of the buffer is folded a word at a time.
+	 * \param _data the bytes.
+	 * \param _length how many bytes there are.
+	 * \param _checksum the value to start from (frames start from 0xff).
+	 * \return the checksum.
+	 */
+	uint8 XorChecksum( uint8 const* _data, uint32 const _length, uint8 const _checksum = 0xff );
+
+	/**
+	 * Work out the CRC-CCITT (polynomial 0x1021) of a buffer, using a lookup table.
+	 * \param _data the bytes.
+	 * \param _length how many bytes there are.
+	 * \param _crc the value to start from, or the CRC of the bytes before these.
+	 * \return the CRC.
+	 */
+	uint16 Crc16Ccitt( uint8 const* _data, uint32 const _length, uint16 const _crc = 0x1d0f );
+
+	/**
+	 * Hash a buffer with 32 bit FNV-1a, which is quick and spreads short inputs well.
+	 * It is not a checksum against deliberate changes.
+	 * \param _data the bytes.
+	 * \param _length how many bytes there are.
+	 * \param _hash the value to start from, or the hash of the bytes before these.
+	 * \return the hash.
+	 */
+	uint32 Fnv1a( uint8 const* _data, uint32 const _length, uint32 const _hash = 0x811c9dc5 );
+
+} // namespace OpenZWave
+
+#endif //_Checksum_H
@@ -0,0 +1,154 @@
+//-----------------------------------------------------------------------------
+//
+//	CommandClassProfile.cpp
+//
+//	Counts and times the work done by each command class
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "CommandClassProfile.h"
+#include "platform/Atomic.h"
+
+using namespace OpenZWave;
+
+volatile uint32 CommandClassProfile::s_enabled = 0;
+volatile uint32 CommandClassProfile::s_count[256][CommandClassProfile::Operation_Count];
+volatile uint32 CommandClassProfile::s_maxNs[256][CommandClassProfile::Operation_Count];
+volatile uint64 CommandClassProfile::s_totalNs[256][CommandClassProfile::Operation_Count];
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::Enable>
+// Turn profiling on or off
+//-----------------------------------------------------------------------------
+void CommandClassProfile::Enable
+(
+	bool const _enable
+)
+{
+	AtomicStore( &s_enabled, _enable ? 1 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::IsEnabled>
+// Whether calls are being timed
+//-----------------------------------------------------------------------------
+bool CommandClassProfile::IsEnabled
+(
+)
+{
+	return( AtomicLoad( &s_enabled ) != 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::Record>
+// Add a call to the counts
+//-----------------------------------------------------------------------------
+void CommandClassProfile::Record
+(
+	uint8 const _commandClassId,
+	Operation const _operation,
+	uint64 const _ns
+)
+{
+	if( _operation >= Operation_Count )
+	{
+		return;
+	}
+
+	AtomicIncrement( &s_count[_commandClassId][_operation] );
+	AtomicAdd64( &s_totalNs[_commandClassId][_operation], _ns );
+
+	volatile uint32* maxNs = &s_maxNs[_commandClassId][_operation];
+	uint32 ns = ( _ns > 0xffffffffULL ) ? 0xffffffff : (uint32)_ns;
+	uint32 max = AtomicLoad( maxNs );
+	while( ns > max && !AtomicCompareExchange( maxNs, max, ns ) )
+	{
+		max = AtomicLoad( maxNs );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::GetSnapshot>
+// Copy the counts and times
+//-----------------------------------------------------------------------------
+void CommandClassProfile::GetSnapshot
+(
+	vector<Data>* o_data
+)
+{
+	o_data->clear();
+	for( uint32 ccId = 0; ccId < 256; ++ccId )
+	{
+		Data data;
+		data.m_commandClassId = (uint8)ccId;
+		bool called = false;
+		for( uint32 op = 0; op < Operation_Count; ++op )
+		{
+			Counter& counter = data.m_counters[op];
+			counter.m_count = AtomicLoad( &s_count[ccId][op] );
+			counter.m_totalNs = AtomicLoad64( &s_totalNs[ccId][op] );
+			counter.m_maxNs = AtomicLoad( &s_maxNs[ccId][op] );
+			called = called || ( counter.m_count != 0 );
+		}
+		if( called )
+		{
+			o_data->push_back( data );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::Reset>
+// Clear the counts and times
+//-----------------------------------------------------------------------------
+void CommandClassProfile::Reset
+(
+)
+{
+	for( uint32 ccId = 0; ccId < 256; ++ccId )
+	{
+		for( uint32 op = 0; op < Operation_Count; ++op )
+		{
+			AtomicStore( &s_count[ccId][op], 0 );
+			AtomicStore( &s_maxNs[ccId][op], 0 );
+			AtomicAdd64( &s_totalNs[ccId][op], (uint64)0 - AtomicLoad64( &s_totalNs[ccId][op] ) );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClassProfile::GetOperationName>
+// The name of an operation
+//-----------------------------------------------------------------------------
+char const* CommandClassProfile::GetOperationName
+(
+	Operation const _operation
+)
+{
+	switch( _operation )
+	{
+		case Operation_HandleMsg:		return "HandleMsg";
+		case Operation_RequestState:	return "RequestState";
+		case Operation_RequestValue:	return "RequestValue";
+		case Operation_SetValue:		return "SetValue";
+		case Operation_ValueUpdate:		return "ValueUpdate";
+		default:						return "Unknown";
+	}
+}
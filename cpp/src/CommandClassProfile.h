@@ -0,0 +1,156 @@
+//-----------------------------------------------------------------------------
+//
+//	CommandClassProfile.h
+//
+//	Counts and times the work done by each command class
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _CommandClassProfile_H
+#define _CommandClassProfile_H
+
+#include <vector>
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	/** \brief Counts the calls into each command class, and the time they take.
+	 *
+	 * With the CommandClassProfiling option, or Manager::SetCommandClassProfiling, the
+	 * driver times each report a command class handles, each request for its state or a
+	 * value, each value set through it and each update to one of its values.  The counts
+	 * and times are kept for every command class ID, across all the drivers, and can be
+	 * read at any time with Manager::GetCommandClassProfile.
+	 *
+	 * The times are inclusive.  A report handled by an encapsulating command class, such
+	 * as Multi Channel or Security, counts the time spent in the command class it carries
+	 * as well, and a report counts the value updates it causes.
+	 *
+	 * Calls are timed with the high resolution clock and counted with atomic operations,
+	 * so any thread may record while another reads, and neither ever waits.  When
+	 * profiling is off, a Timer costs a single load.
+	 */
+	class OPENZWAVE_EXPORT CommandClassProfile
+	{
+	public:
+		/** The kinds of work that are timed */
+		enum Operation
+		{
+			Operation_HandleMsg = 0,		// CommandClass::HandleMsg, for a report from a node
+			Operation_RequestState,			// CommandClass::RequestState, while a node is queried or refreshed
+			Operation_RequestValue,			// CommandClass::RequestValue
+			Operation_SetValue,				// CommandClass::SetValue
+			Operation_ValueUpdate,			// A value being refreshed from a report, with its notification
+			Operation_Count
+		};
+
+		/** The counts and times of one operation */
+		struct Counter
+		{
+			uint32 m_count;
+			uint64 m_totalNs;
+			uint32 m_maxNs;					// Longer calls count as 0xffffffff, just over four seconds
+		};
+
+		/** The counts and times of one command class */
+		struct Data
+		{
+			uint8 m_commandClassId;
+			Counter m_counters[Operation_Count];
+		};
+
+		/** \brief Times one call for as long as it is in scope.
+		 *
+		 * Nothing is read or recorded if profiling was off when the timer was created.
+		 */
+		class Timer
+		{
+		public:
+			Timer( uint8 const _commandClassId, Operation const _operation ):
+				m_commandClassId( _commandClassId ),
+				m_operation( _operation ),
+				m_start( IsEnabled() ? TimeStamp::GetTicksNs() : 0 )
+			{
+			}
+
+			~Timer()
+			{
+				if( m_start )
+				{
+					Record( m_commandClassId, m_operation, TimeStamp::GetTicksNs() - m_start );
+				}
+			}
+
+		private:
+			Timer( Timer const& );						// prevent copy
+			Timer& operator = ( Timer const& );			// prevent assignment
+
+			uint8		m_commandClassId;
+			Operation	m_operation;
+			uint64		m_start;
+		};
+
+		/**
+		 * Turn profiling on or off.  The counts are kept while it is off.
+		 */
+		static void Enable( bool const _enable );
+
+		/**
+		 * \return true if calls are being timed.
+		 */
+		static bool IsEnabled();
+
+		/**
+		 * Add a call to the counts.
+		 * \param _commandClassId the command class that was called.
+		 * \param _operation what it was called for.
+		 * \param _ns how long the call took, in nanoseconds.
+		 */
+		static void Record( uint8 const _commandClassId, Operation const _operation, uint64 const _ns );
+
+		/**
+		 * Copy the counts and times.
+		 * \param o_data cleared, then filled with an entry for each command class that has
+		 * been called since the counts were last reset, in order of command class ID.
+		 */
+		static void GetSnapshot( vector<Data>* o_data );
+
+		/**
+		 * Clear the counts and times.  Calls recorded while this runs may be kept or lost.
+		 */
+		static void Reset();
+
+		/**
+		 * \return the name of an operation, for logging.
+		 */
+		static char const* GetOperationName( Operation const _operation );
+
+	private:
+		// Kept in separate arrays so that each total is 8 byte aligned for the atomic operations
+		static volatile uint32	s_enabled;
+		static volatile uint32	s_count[256][Operation_Count];
+		static volatile uint32	s_maxNs[256][Operation_Count];
+		static volatile uint64	s_totalNs[256][Operation_Count];
+	};
+
+} // namespace OpenZWave
+
+#endif //_CommandClassProfile_H
@@ -0,0 +1,477 @@
+//-----------------------------------------------------------------------------
+//
+//	ConfigCache.cpp
+//
+//	Binary form of the network configuration file
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+#include "ConfigCache.h"
+#include "platform/Log.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+//
+// File layout (all integers little endian, counts and indices as base 128 varints):
+//
+//	"OZWB"				magic
+//	uint32				format version
+//	varint				number of strings, then for each: varint length, bytes
+//	varint				number of top level nodes, then each node:
+//		uint8			c_nodeElement, c_nodeText or c_nodeCData
+//		element:		varint name, varint attribute count, (varint name, varint value) per
+//						attribute, varint child count, child nodes
+//		text:			varint value
+//
+static char const c_magic[4] = { 'O', 'Z', 'W', 'B' };
+static uint32 const c_formatVersion = 1;
+
+static uint8 const c_nodeElement = 1;
+static uint8 const c_nodeText = 2;
+static uint8 const c_nodeCData = 3;
+
+// Deepest element nesting accepted when loading
+static uint32 const c_maxDepth = 64;
+
+namespace
+{
+	//-----------------------------------------------------------------------------
+	// Builds the string table and the encoded tree
+	//-----------------------------------------------------------------------------
+	class Encoder
+	{
+	public:
+		void PutVarint
+		(
+			uint32 _value
+		)
+		{
+			while( _value >= 0x80 )
+			{
+				m_tree.push_back( (uint8)( _value | 0x80 ) );
+				_value >>= 7;
+			}
+			m_tree.push_back( (uint8)_value );
+		}
+
+		void PutString
+		(
+			char const* _str
+		)
+		{
+			string str( _str ? _str : "" );
+			map<string,uint32>::iterator it = m_index.find( str );
+			if( it == m_index.end() )
+			{
+				it = m_index.insert( pair<string,uint32>( str, (uint32)m_strings.size() ) ).first;
+				m_strings.push_back( &it->first );
+			}
+			PutVarint( it->second );
+		}
+
+		void PutNode
+		(
+			TiXmlNode const* _node
+		)
+		{
+			if( TiXmlElement const* element = _node->ToElement() )
+			{
+				m_tree.push_back( c_nodeElement );
+				PutString( element->Value() );
+
+				uint32 count = 0;
+				for( TiXmlAttribute const* attr = element->FirstAttribute(); attr; attr = attr->Next() )
+				{
+					++count;
+				}
+				PutVarint( count );
+				for( TiXmlAttribute const* attr = element->FirstAttribute(); attr; attr = attr->Next() )
+				{
+					PutString( attr->Name() );
+					PutString( attr->Value() );
+				}
+
+				PutChildren( element );
+			}
+			else if( TiXmlText const* text = _node->ToText() )
+			{
+				m_tree.push_back( text->CDATA() ? c_nodeCData : c_nodeText );
+				PutString( text->Value() );
+			}
+		}
+
+		void PutChildren
+		(
+			TiXmlNode const* _parent
+		)
+		{
+			// Declarations and comments are not kept
+			uint32 count = 0;
+			for( TiXmlNode const* child = _parent->FirstChild(); child; child = child->NextSibling() )
+			{
+				if( child->ToElement() || child->ToText() )
+				{
+					++count;
+				}
+			}
+			PutVarint( count );
+			for( TiXmlNode const* child = _parent->FirstChild(); child; child = child->NextSibling() )
+			{
+				PutNode( child );
+			}
+		}
+
+		void GetData
+		(
+			vector<uint8>& _data
+		)
+		{
+			_data.assign( c_magic, c_magic + sizeof(c_magic) );
+			for( uint32 i=0; i<4; ++i )
+			{
+				_data.push_back( (uint8)( c_formatVersion >> ( i * 8 ) ) );
+			}
+
+			// The string table goes first, so encode it after the tree that filled it
+			vector<uint8> tree;
+			tree.swap( m_tree );
+			PutVarint( (uint32)m_strings.size() );
+			for( vector<string const*>::iterator it = m_strings.begin(); it != m_strings.end(); ++it )
+			{
+				PutVarint( (uint32)(*it)->size() );
+				m_tree.insert( m_tree.end(), (*it)->begin(), (*it)->end() );
+			}
+			_data.insert( _data.end(), m_tree.begin(), m_tree.end() );
+			_data.insert( _data.end(), tree.begin(), tree.end() );
+		}
+
+	private:
+		vector<uint8>			m_tree;
+		map<string,uint32>		m_index;
+		vector<string const*>	m_strings;
+	};
+
+	//-----------------------------------------------------------------------------
+	// Rebuilds a document from the encoded form
+	//-----------------------------------------------------------------------------
+	class Decoder
+	{
+	public:
+		Decoder
+		(
+			uint8 const* _data,
+			size_t _length
+		):
+			m_pos( _data ),
+			m_end( _data + _length )
+		{
+		}
+
+		bool GetVarint
+		(
+			uint32& _value
+		)
+		{
+			_value = 0;
+			for( uint32 shift = 0; shift < 35; shift += 7 )
+			{
+				if( m_pos == m_end )
+				{
+					return false;
+				}
+				uint8 byte = *m_pos++;
+				_value |= (uint32)( byte & 0x7f ) << shift;
+				if( !( byte & 0x80 ) )
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		bool GetString
+		(
+			string const** _str
+		)
+		{
+			uint32 index;
+			if( !GetVarint( index ) || index >= m_strings.size() )
+			{
+				return false;
+			}
+			*_str = &m_strings[index];
+			return true;
+		}
+
+		bool GetHeader
+		(
+		)
+		{
+			if( (size_t)( m_end - m_pos ) < sizeof(c_magic) + 4 || memcmp( m_pos, c_magic, sizeof(c_magic) ) )
+			{
+				return false;
+			}
+			m_pos += sizeof(c_magic);
+
+			uint32 version = 0;
+			for( uint32 i=0; i<4; ++i )
+			{
+				version |= (uint32)( *m_pos++ ) << ( i * 8 );
+			}
+			if( version != c_formatVersion )
+			{
+				return false;
+			}
+
+			uint32 count;
+			if( !GetVarint( count ) || count > (uint32)( m_end - m_pos ) )
+			{
+				return false;
+			}
+			m_strings.reserve( count );
+			for( uint32 i=0; i<count; ++i )
+			{
+				uint32 length;
+				if( !GetVarint( length ) || length > (uint32)( m_end - m_pos ) )
+				{
+					return false;
+				}
+				m_strings.push_back( string( (char const*)m_pos, length ) );
+				m_pos += length;
+			}
+			return true;
+		}
+
+		bool GetChildren
+		(
+			TiXmlNode* _parent,
+			uint32 _depth
+		)
+		{
+			uint32 count;
+			if( _depth > c_maxDepth || !GetVarint( count ) )
+			{
+				return false;
+			}
+			for( uint32 i=0; i<count; ++i )
+			{
+				if( m_pos == m_end )
+				{
+					return false;
+				}
+
+				uint8 kind = *m_pos++;
+				string const* value;
+				if( !GetString( &value ) )
+				{
+					return false;
+				}
+
+				if( kind == c_nodeElement )
+				{
+					TiXmlElement* element = new TiXmlElement( value->c_str() );
+					_parent->LinkEndChild( element );
+
+					uint32 attributes;
+					if( !GetVarint( attributes ) )
+					{
+						return false;
+					}
+					for( uint32 j=0; j<attributes; ++j )
+					{
+						string const* name;
+						string const* attrValue;
+						if( !GetString( &name ) || !GetString( &attrValue ) )
+						{
+							return false;
+						}
+						element->SetAttribute( name->c_str(), attrValue->c_str() );
+					}
+
+					if( !GetChildren( element, _depth + 1 ) )
+					{
+						return false;
+					}
+				}
+				else if( kind == c_nodeText || kind == c_nodeCData )
+				{
+					TiXmlText* text = new TiXmlText( value->c_str() );
+					text->SetCDATA( kind == c_nodeCData );
+					_parent->LinkEndChild( text );
+				}
+				else
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool AtEnd()const{ return m_pos == m_end; }
+
+	private:
+		uint8 const*	m_pos;
+		uint8 const*	m_end;
+		vector<string>	m_strings;
+	};
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::Write>
+// Write a document to a binary configuration file
+//-----------------------------------------------------------------------------
+bool ConfigCache::Write
+(
+	TiXmlDocument const& _doc,
+	string const& _filename
+)
+{
+	vector<uint8> data;
+	Encode( _doc, data );
+
+	bool ok = false;
+	if( FILE* file = fopen( _filename.c_str(), "wb" ) )
+	{
+		ok = ( fwrite( &data[0], 1, data.size(), file ) == data.size() );
+		if( fclose( file ) != 0 )
+		{
+			ok = false;
+		}
+	}
+	if( !ok )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ConfigCache::Write - could not write %s", _filename.c_str() );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::Read>
+// Load a binary configuration file into a document
+//-----------------------------------------------------------------------------
+bool ConfigCache::Read
+(
+	string const& _filename,
+	TiXmlDocument& _doc
+)
+{
+	FILE* file = fopen( _filename.c_str(), "rb" );
+	if( file == NULL )
+	{
+		return false;
+	}
+
+	vector<uint8> data;
+	uint8 buffer[4096];
+	size_t length;
+	while( ( length = fread( buffer, 1, sizeof(buffer), file ) ) > 0 )
+	{
+		data.insert( data.end(), buffer, buffer + length );
+	}
+	fclose( file );
+
+	if( !Decode( data.empty() ? NULL : &data[0], (uint32)data.size(), _doc ) )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ConfigCache::Read - %s is not a valid configuration cache", _filename.c_str() );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::Encode>
+// Encode a document into the binary form in memory
+//-----------------------------------------------------------------------------
+void ConfigCache::Encode
+(
+	TiXmlDocument const& _doc,
+	vector<uint8>& _data
+)
+{
+	Encoder encoder;
+	encoder.PutChildren( &_doc );
+	encoder.GetData( _data );
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::Decode>
+// Rebuild a document from the binary form in memory
+//-----------------------------------------------------------------------------
+bool ConfigCache::Decode
+(
+	uint8 const* _data,
+	uint32 const _length,
+	TiXmlDocument& _doc
+)
+{
+	_doc.Clear();
+	_doc.LinkEndChild( new TiXmlDeclaration( "1.0", "utf-8", "" ) );
+
+	Decoder decoder( _data, _length );
+	if( !decoder.GetHeader() || !decoder.GetChildren( &_doc, 0 ) || !decoder.AtEnd() || !_doc.RootElement() )
+	{
+		_doc.Clear();
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::ConvertToBinary>
+// Convert an XML configuration file to the binary form
+//-----------------------------------------------------------------------------
+bool ConfigCache::ConvertToBinary
+(
+	string const& _xmlFilename,
+	string const& _binFilename
+)
+{
+	TiXmlDocument doc;
+	if( !doc.LoadFile( _xmlFilename.c_str(), TIXML_ENCODING_UTF8 ) )
+	{
+		return false;
+	}
+	return Write( doc, _binFilename );
+}
+
+//-----------------------------------------------------------------------------
+// <ConfigCache::ConvertToXML>
+// Convert a binary configuration file back to XML
+//-----------------------------------------------------------------------------
+bool ConfigCache::ConvertToXML
+(
+	string const& _binFilename,
+	string const& _xmlFilename
+)
+{
+	TiXmlDocument doc;
+	if( !Read( _binFilename, doc ) )
+	{
+		return false;
+	}
+	return doc.SaveFile( _xmlFilename.c_str() );
+}
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+//
+//	ConfigCache.h
+//
+//	Binary form of the network configuration file
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ConfigCache_H
+#define _ConfigCache_H
+
+#include <string>
+#include <vector>
+
+#include "Defs.h"
+
+class TiXmlDocument;
+
+namespace OpenZWave
+{
+	/** \brief Reads and writes the zwcfg network configuration in a binary form.
+	 *
+	 * The binary file holds the same element tree as the XML file: a table of every
+	 * distinct string, followed by the elements, attributes and text, each referring to
+	 * the table by index.  Loading it rebuilds the document without any text parsing,
+	 * so Node::ReadXML and the command classes read it exactly as they read the XML.
+	 * It is used instead of the XML file when the ConfigFormat option is "binary".
+	 */
+	class OPENZWAVE_EXPORT ConfigCache
+	{
+	public:
+		/**
+		 * Write a document to a binary configuration file.
+		 * \param _doc the document.
+		 * \param _filename path of the file to write.
+		 * \return true if the file was written.
+		 */
+		static bool Write( TiXmlDocument const& _doc, string const& _filename );
+
+		/**
+		 * Load a binary configuration file into a document.
+		 * \param _filename path of the file to read.
+		 * \param _doc the document to fill.  It is left empty if the file cannot be loaded.
+		 * \return true if the file was loaded.
+		 */
+		static bool Read( string const& _filename, TiXmlDocument& _doc );
+
+		/**
+		 * Encode a document into the binary form in memory.
+		 * \param _doc the document.
+		 * \param _data filled with the encoded document, exactly as Write would save it.
+		 */
+		static void Encode( TiXmlDocument const& _doc, vector<uint8>& _data );
+
+		/**
+		 * Rebuild a document from the binary form held in memory.
+		 * \param _data the encoded document.
+		 * \param _length number of bytes at _data.
+		 * \param _doc the document to fill.  It is left empty if the data is not valid.
+		 * \return true if the document was decoded.
+		 */
+		static bool Decode( uint8 const* _data, uint32 const _length, TiXmlDocument& _doc );
+
+		/**
+		 * Convert an XML configuration file to the binary form.
+		 * \param _xmlFilename path of the XML file to read.
+		 * \param _binFilename path of the binary file to write.
+		 * \return true if the conversion succeeded.
+		 */
+		static bool ConvertToBinary( string const& _xmlFilename, string const& _binFilename );
+
+		/**
+		 * Convert a binary configuration file back to XML.
+		 * \param _binFilename path of the binary file to read.
+		 * \param _xmlFilename path of the XML file to write.
+		 * \return true if the conversion succeeded.
+		 */
+		static bool ConvertToXML( string const& _binFilename, string const& _xmlFilename );
+	};
+
+} // namespace OpenZWave
+
+#endif //_ConfigCache_H
@@ -0,0 +1,510 @@
+//-----------------------------------------------------------------------------
+//
+//	ControllerGroup.cpp
+//
+//	The controllers of one Z-Wave network, sharing out the sending between them
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "ControllerGroup.h"
+#include "Msg.h"
+#include "Utils.h"
+#include "platform/Event.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+// A delivery time older than this no longer says much about the route
+static uint32 const c_costLifetimeMs = 600000;
+
+// The least a failure costs, and the most anything does
+static uint32 const c_failureCostMs = 5000;
+static uint32 const c_maxCostMs = 60000;
+
+// How long a frame that reached one controller is dropped if it reaches another
+static uint32 const c_duplicateMs = 1000;
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::ControllerGroup>
+// Constructor
+//-----------------------------------------------------------------------------
+ControllerGroup::ControllerGroup
+(
+	uint32 const _homeId
+):
+	m_homeId( _homeId ),
+	m_mutex( new Mutex() ),
+	m_idle( new Event() ),
+	m_busy( 0 ),
+	m_primary( NULL )
+{
+	m_idle->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::~ControllerGroup>
+// Destructor
+//-----------------------------------------------------------------------------
+ControllerGroup::~ControllerGroup
+(
+)
+{
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		delete *it;
+	}
+	m_idle->Release();
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::SetPrimary>
+// Make a driver the one with the nodes
+//-----------------------------------------------------------------------------
+void ControllerGroup::SetPrimary
+(
+	Driver* _driver
+)
+{
+	LockGuard LG( m_mutex );
+	if( !GetMember( _driver ) )
+	{
+		Member* member = new Member();
+		memset( member, 0, sizeof(Member) );
+		member->m_driver = _driver;
+		m_members.push_back( member );
+	}
+	m_primary = _driver;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::AddStandby>
+// Add a driver that only carries messages
+//-----------------------------------------------------------------------------
+void ControllerGroup::AddStandby
+(
+	Driver* _driver
+)
+{
+	LockGuard LG( m_mutex );
+	if( !GetMember( _driver ) )
+	{
+		Member* member = new Member();
+		memset( member, 0, sizeof(Member) );
+		member->m_driver = _driver;
+		m_members.push_back( member );
+	}
+	Log::Write( LogLevel_Info, "Controller %s joins the network with Home ID 0x%.8x, which now has %d controllers", _driver->GetControllerPath().c_str(), m_homeId, (int)m_members.size() );
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::FindStandby>
+// Find the standby for a controller
+//-----------------------------------------------------------------------------
+Driver* ControllerGroup::FindStandby
+(
+	string const& _controllerPath
+)
+{
+	LockGuard LG( m_mutex );
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		if( (*it)->m_driver != m_primary && (*it)->m_driver->GetControllerPath() == _controllerPath )
+		{
+			return (*it)->m_driver;
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::GetStandbys>
+// Get all the standbys
+//-----------------------------------------------------------------------------
+void ControllerGroup::GetStandbys
+(
+	vector<Driver*>* o_drivers
+)
+{
+	LockGuard LG( m_mutex );
+	o_drivers->clear();
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		if( (*it)->m_driver != m_primary )
+		{
+			o_drivers->push_back( (*it)->m_driver );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Remove>
+// Take a driver out of the group
+//-----------------------------------------------------------------------------
+bool ControllerGroup::Remove
+(
+	Driver* _driver
+)
+{
+	m_mutex->Lock();
+	bool found = false;
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		if( (*it)->m_driver == _driver )
+		{
+			delete *it;
+			m_members.erase( it );
+			found = true;
+			break;
+		}
+	}
+	if( m_primary == _driver )
+	{
+		m_primary = NULL;
+	}
+
+	// Another driver may be passing this one a message or a frame
+	while( m_busy )
+	{
+		m_mutex->Unlock();
+		Wait::Single( m_idle );
+		m_mutex->Lock();
+	}
+	m_mutex->Unlock();
+	return found;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Route>
+// Send a message by the controller with the best route to its node
+//-----------------------------------------------------------------------------
+bool ControllerGroup::Route
+(
+	Driver* _from,
+	Msg* _msg,
+	Driver::MsgQueue const _queue
+)
+{
+	uint8 nodeId = _msg->GetTargetNodeId();
+	if( _msg->GetHandoffs() || !_msg->IsSendData() || _msg->isEncrypted() || nodeId == 0 || nodeId > 232 )
+	{
+		return false;
+	}
+
+	m_mutex->Lock();
+	Member* from = GetMember( _from );
+	if( !from || _from != m_primary || m_members.size() < 2 )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	// Without a recent delivery time the primary sends, so that is how it learns one
+	uint32 now = (uint32)-m_start.TimeRemaining();
+	uint32 fromCost = GetCost( from, nodeId, now );
+	if( fromCost == 0 )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	Member* best = NULL;
+	uint32 bestCost = 0;
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		uint32 cost = GetCost( *it, nodeId, now );
+		if( *it != from && cost && ( !best || cost < bestCost ) )
+		{
+			best = *it;
+			bestCost = cost;
+		}
+	}
+
+	// Only move for a clear gain, so two similar routes do not take turns
+	if( !best || bestCost + ( bestCost >> 2 ) >= fromCost )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	Log::Write( LogLevel_Detail, nodeId, "Sending by controller %s, which delivers in %dms rather than %dms", best->m_driver->GetControllerPath().c_str(), bestCost, fromCost );
+	return HandOff( best->m_driver, _msg, _queue );
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Failover>
+// Pass a message one controller has given up on to another
+//-----------------------------------------------------------------------------
+bool ControllerGroup::Failover
+(
+	Driver* _from,
+	Msg* _msg,
+	Driver::MsgQueue const _queue
+)
+{
+	uint8 nodeId = _msg->GetTargetNodeId();
+	if( !_msg->IsSendData() || _msg->isEncrypted() || nodeId == 0 || nodeId > 232 )
+	{
+		return false;
+	}
+
+	m_mutex->Lock();
+	if( !m_primary || (uint32)_msg->GetHandoffs() + 1 >= m_members.size() )
+	{
+		// Every controller has had a go
+		m_mutex->Unlock();
+		return false;
+	}
+
+	// The controller that has delivered fastest, or any if none has yet
+	uint32 now = (uint32)-m_start.TimeRemaining();
+	Member* best = NULL;
+	uint32 bestCost = 0;
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		if( (*it)->m_driver == _from )
+		{
+			continue;
+		}
+		uint32 cost = GetCost( *it, nodeId, now );
+		if( !best || ( cost && ( !bestCost || cost < bestCost ) ) )
+		{
+			best = *it;
+			bestCost = cost;
+		}
+	}
+	if( !best )
+	{
+		m_mutex->Unlock();
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, nodeId, "Passing the message to controller %s to send", best->m_driver->GetControllerPath().c_str() );
+	return HandOff( best->m_driver, _msg, _queue );
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::NoteDelivery>
+// Average in the time a controller took to deliver to a node
+//-----------------------------------------------------------------------------
+void ControllerGroup::NoteDelivery
+(
+	Driver* _driver,
+	uint8 const _nodeId,
+	uint32 const _ms
+)
+{
+	LockGuard LG( m_mutex );
+	if( Member* member = GetMember( _driver ) )
+	{
+		uint32 now = (uint32)-m_start.TimeRemaining();
+		uint32 cost = GetCost( member, _nodeId, now );
+		cost = cost ? ( cost * 3 + _ms ) >> 2 : _ms;
+		member->m_cost[_nodeId] = cost ? cost : 1;
+		member->m_updated[_nodeId] = now;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::NoteFailure>
+// Make a controller's route to a node look worse
+//-----------------------------------------------------------------------------
+void ControllerGroup::NoteFailure
+(
+	Driver* _driver,
+	uint8 const _nodeId
+)
+{
+	LockGuard LG( m_mutex );
+	if( Member* member = GetMember( _driver ) )
+	{
+		uint32 now = (uint32)-m_start.TimeRemaining();
+		uint32 cost = GetCost( member, _nodeId, now ) << 1;
+		if( cost < c_failureCostMs )
+		{
+			cost = c_failureCostMs;
+		}
+		member->m_cost[_nodeId] = ( cost > c_maxCostMs ) ? c_maxCostMs : cost;
+		member->m_updated[_nodeId] = now;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Admit>
+// Check that a frame from a node has not already been handled
+//-----------------------------------------------------------------------------
+bool ControllerGroup::Admit
+(
+	uint8 const* _data
+)
+{
+	LockGuard LG( m_mutex );
+	if( m_members.size() < 2 )
+	{
+		return true;
+	}
+
+	// FNV-1a over the node and the command
+	uint32 hash = 2166136261u;
+	hash = ( hash ^ _data[3] ) * 16777619u;
+	for( uint32 i = 0; i < _data[4]; ++i )
+	{
+		hash = ( hash ^ _data[5+i] ) * 16777619u;
+	}
+
+	uint32 now = (uint32)-m_start.TimeRemaining();
+	if( m_recent.size() > 64 )
+	{
+		map<uint32,uint32>::iterator it = m_recent.begin();
+		while( it != m_recent.end() )
+		{
+			if( now - it->second >= c_duplicateMs )
+			{
+				m_recent.erase( it++ );
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	map<uint32,uint32>::iterator it = m_recent.find( hash );
+	if( it != m_recent.end() && now - it->second < c_duplicateMs )
+	{
+		return false;
+	}
+	m_recent[hash] = now;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Forward>
+// Pass a frame a standby received to the primary
+//-----------------------------------------------------------------------------
+void ControllerGroup::Forward
+(
+	Driver* _from,
+	uint8 const* _data,
+	bool const _encrypted
+)
+{
+	if( !Admit( _data ) )
+	{
+		Log::Write( LogLevel_Detail, _data[3], "Dropping a frame another controller has already received" );
+		return;
+	}
+
+	m_mutex->Lock();
+	Driver* primary = m_primary;
+	if( !primary || primary == _from )
+	{
+		m_mutex->Unlock();
+		return;
+	}
+	++m_busy;
+	m_idle->Reset();
+	m_mutex->Unlock();
+
+	primary->QueueForwardedFrame( _data, _encrypted );
+
+	m_mutex->Lock();
+	Done();
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::GetMember>
+// Find a driver's entry
+//-----------------------------------------------------------------------------
+ControllerGroup::Member* ControllerGroup::GetMember
+(
+	Driver const* _driver
+)
+{
+	for( vector<Member*>::iterator it = m_members.begin(); it != m_members.end(); ++it )
+	{
+		if( (*it)->m_driver == _driver )
+		{
+			return *it;
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::GetCost>
+// A controller's delivery time to a node, if it is recent
+//-----------------------------------------------------------------------------
+uint32 ControllerGroup::GetCost
+(
+	Member const* _member,
+	uint8 const _nodeId,
+	uint32 const _now
+)
+{
+	if( _member->m_cost[_nodeId] == 0 || _now - _member->m_updated[_nodeId] >= c_costLifetimeMs )
+	{
+		return 0;
+	}
+	return _member->m_cost[_nodeId];
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::HandOff>
+// Send a message through another driver.  The lock is not held while the
+// other driver queues it, as that takes its own locks.
+//-----------------------------------------------------------------------------
+bool ControllerGroup::HandOff
+(
+	Driver* _to,
+	Msg* _msg,
+	Driver::MsgQueue const _queue
+)
+{
+	++m_busy;
+	m_idle->Reset();
+	m_mutex->Unlock();
+
+	_msg->AddHandoff();
+	_msg->SetSendAttempts( 0 );
+	_to->SendMsg( _msg, _queue );
+
+	m_mutex->Lock();
+	Done();
+	m_mutex->Unlock();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerGroup::Done>
+// A call to another driver has returned
+//-----------------------------------------------------------------------------
+void ControllerGroup::Done
+(
+)
+{
+	if( --m_busy == 0 )
+	{
+		m_idle->Set();
+	}
+}
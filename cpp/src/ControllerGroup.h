@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+//
+//	ControllerGroup.h
+//
+//	The controllers of one Z-Wave network, sharing out the sending between them
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ControllerGroup_H
+#define _ControllerGroup_H
+
+#include <map>
+#include <vector>
+#include "Defs.h"
+#include "Driver.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Msg;
+	class Mutex;
+
+	/** \brief The controllers added to the Manager for the same home ID.
+	 *
+	 * With the ControllerGroups option, a second controller of a network that is already
+	 * open joins the first one's group rather than replacing it.  The first, the primary,
+	 * keeps the nodes and values and answers the application.  The others are standbys,
+	 * which read no configuration and interview no nodes.  They only carry messages.
+	 *
+	 * Each message the primary sends to a listening node goes by the controller that has
+	 * lately delivered to that node fastest.  The time from sending to the controller's
+	 * callback is kept for every controller and node, and a failure to deliver doubles
+	 * it.  Without a recent time for the primary, the primary sends.  A message that one
+	 * controller gives up on is passed to another, until each has had a go.
+	 *
+	 * What a standby receives from the nodes is passed to the primary, which handles it
+	 * as if it had received it itself.  A frame that reaches more than one controller
+	 * is only handled once.
+	 *
+	 * Only the Manager adds and removes drivers.  A group lasts as long as the Manager,
+	 * so the drivers keep their pointer to it.
+	 */
+	class ControllerGroup
+	{
+	public:
+		ControllerGroup( uint32 const _homeId );
+		~ControllerGroup();
+
+		uint32 GetHomeId()const{ return m_homeId; }
+
+		/** \return the driver that has the nodes, or NULL if it has been removed. */
+		Driver* GetPrimary()const{ return m_primary; }
+		void SetPrimary( Driver* _driver );
+
+		void AddStandby( Driver* _driver );
+
+		/** \return the driver for a controller that is a standby, or NULL. */
+		Driver* FindStandby( string const& _controllerPath );
+
+		/** \return all the standbys. */
+		void GetStandbys( vector<Driver*>* o_drivers );
+
+		/**
+		 * Take a driver out of the group, once no other driver is passing it anything.
+		 * \return true if it was in the group.
+		 */
+		bool Remove( Driver* _driver );
+
+		/**
+		 * Pass a message for a node to the controller with the best route to it, if that
+		 * is not the one sending it.  Only messages from the primary are moved.
+		 * \return true if another driver has taken the message.
+		 */
+		bool Route( Driver* _from, Msg* _msg, Driver::MsgQueue const _queue );
+
+		/**
+		 * Pass a message that a controller has given up on to another.
+		 * \return true if another driver has taken the message.
+		 */
+		bool Failover( Driver* _from, Msg* _msg, Driver::MsgQueue const _queue );
+
+		/** A controller delivered a message to a node, taking this many ms. */
+		void NoteDelivery( Driver* _driver, uint8 const _nodeId, uint32 const _ms );
+
+		/** A controller could not deliver a message to a node. */
+		void NoteFailure( Driver* _driver, uint8 const _nodeId );
+
+		/**
+		 * Check that a frame from a node has not already been handled, and note it if not.
+		 * \param _data the FUNC_ID_APPLICATION_COMMAND_HANDLER request.
+		 * \return true if it is to be handled.
+		 */
+		bool Admit( uint8 const* _data );
+
+		/** Pass a frame a standby received to the primary, unless another controller already has. */
+		void Forward( Driver* _from, uint8 const* _data, bool const _encrypted );
+
+	private:
+		ControllerGroup( ControllerGroup const& );					// prevent copy
+		ControllerGroup& operator = ( ControllerGroup const& );		// prevent assignment
+
+		struct Member
+		{
+			Driver*		m_driver;
+			uint32		m_cost[256];		// Smoothed ms to deliver to each node, or 0 if not known
+			uint32		m_updated[256];		// When each cost was last updated, in ms since m_start
+		};
+
+		Member* GetMember( Driver const* _driver );				// Must be called with m_mutex locked
+		uint32 GetCost( Member const* _member, uint8 const _nodeId, uint32 const _now );	// The cost if it is recent, or 0.  Must be called with m_mutex locked.
+		bool HandOff( Driver* _to, Msg* _msg, Driver::MsgQueue const _queue );	// Send a message through another driver.  Must be called with m_mutex locked, and returns with it unlocked.
+		void Done();												// Another driver has been called.  Must be called with m_mutex locked.
+
+		uint32				m_homeId;
+		Mutex*				m_mutex;
+		Event*				m_idle;				// Set while no call to another driver is under way
+		uint32				m_busy;				// Calls to other drivers under way
+		Driver*	volatile	m_primary;
+		vector<Member*>		m_members;			// Every driver, the primary included
+		map<uint32,uint32>	m_recent;			// The hash of each frame lately handled, and when
+		TimeStamp			m_start;
+	};
+
+} // namespace OpenZWave
+
+#endif //_ControllerGroup_H
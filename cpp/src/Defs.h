@@ -252,12 +252,16 @@ namespace OpenZWave
 
 #define FUNC_ID_ZW_SEND_NODE_INFORMATION				0x12
 #define FUNC_ID_ZW_SEND_DATA							0x13
+#define FUNC_ID_ZW_SEND_DATA_MULTI						0x14
 #define FUNC_ID_ZW_GET_VERSION							0x15
 #define FUNC_ID_ZW_R_F_POWER_LEVEL_SET					0x17
 #define FUNC_ID_ZW_GET_RANDOM							0x1c
 #define FUNC_ID_ZW_MEMORY_GET_ID						0x20
 #define FUNC_ID_MEMORY_GET_BYTE							0x21
 #define FUNC_ID_ZW_READ_MEMORY							0x23
+#define FUNC_ID_NVM_GET_ID								0x29	// Get the manufacturer, type and size of the controller's NVM
+#define FUNC_ID_NVM_EXT_READ_LONG_BUFFER				0x2a	// Read a block of the controller's NVM
+#define FUNC_ID_NVM_EXT_WRITE_LONG_BUFFER				0x2b	// Write a block of the controller's NVM
 
 #define FUNC_ID_ZW_SET_LEARN_NODE_STATE					0x40	// Not implemented
 #define FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO				0x41	// Get protocol info (baud rate, listening, etc.) for a given node
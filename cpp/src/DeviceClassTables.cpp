@@ -0,0 +1,422 @@
+//-----------------------------------------------------------------------------
+//
+//	DeviceClassTables.cpp
+//
+//	Built in device class tables
+//
+//	Generated from config/device_classes.xml by cpp/build/gendeviceclasses.pl.
+//	Do not edit this file by hand.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "DeviceClasses.h"
+
+using namespace OpenZWave;
+
+static uint8 const c_cc0[] = { 0x2d, 0x72, 0x85, 0xef, 0x2b, 0 };
+static uint8 const c_cc1[] = { 0x21, 0x72, 0x86, 0x8f, 0xef, 0x21, 0x60, 0x70, 0x72, 0x84, 0x85, 0x86, 0x8e, 0 };
+static uint8 const c_cc2[] = { 0xef, 0x20, 0 };
+static uint8 const c_cc3[] = { 0x72, 0x86, 0x94, 0 };
+static uint8 const c_cc4[] = { 0x30, 0x72, 0x85, 0x86, 0 };
+static uint8 const c_cc5[] = { 0x20, 0 };
+static uint8 const c_cc6[] = { 0x72, 0x86, 0x92, 0x93, 0 };
+static uint8 const c_cc7[] = { 0x40, 0x43, 0x72, 0 };
+static uint8 const c_cc8[] = { 0x46, 0x72, 0x86, 0x8f, 0xef, 0x46, 0x81, 0x8f, 0 };
+static uint8 const c_cc9[] = { 0x43, 0x72, 0x86, 0x8f, 0xef, 0x43, 0x8f, 0 };
+static uint8 const c_cc10[] = { 0x40, 0x43, 0x47, 0x72, 0x86, 0 };
+static uint8 const c_cc11[] = { 0x40, 0x43, 0x72, 0x86, 0 };
+static uint8 const c_cc12[] = { 0x50, 0 };
+static uint8 const c_cc13[] = { 0x27, 0 };
+static uint8 const c_cc14[] = { 0x2b, 0x2c, 0x72, 0 };
+static uint8 const c_cc15[] = { 0x20, 0x25, 0 };
+static uint8 const c_cc16[] = { 0x72, 0x86, 0 };
+static uint8 const c_cc17[] = { 0x27, 0x2b, 0x2c, 0x72, 0 };
+static uint8 const c_cc18[] = { 0x25, 0x72, 0x86, 0 };
+static uint8 const c_cc19[] = { 0x20, 0x26, 0 };
+static uint8 const c_cc20[] = { 0xef, 0x25, 0 };
+static uint8 const c_cc21[] = { 0xef, 0x26, 0 };
+static uint8 const c_cc22[] = { 0xef, 0x28, 0 };
+static uint8 const c_cc23[] = { 0xef, 0x29, 0 };
+static uint8 const c_cc24[] = { 0x25, 0x28, 0 };
+static uint8 const c_cc25[] = { 0x26, 0x29, 0 };
+static uint8 const c_cc26[] = { 0x23, 0x24, 0x72, 0x86, 0 };
+static uint8 const c_cc27[] = { 0x23, 0x24, 0x2f, 0x33, 0x72, 0x86, 0 };
+static uint8 const c_cc28[] = { 0x23, 0x2e, 0x72, 0x86, 0 };
+static uint8 const c_cc29[] = { 0x23, 0x2e, 0x2f, 0x34, 0x72, 0x86, 0 };
+static uint8 const c_cc30[] = { 0x37, 0x39, 0x72, 0x86, 0 };
+static uint8 const c_cc31[] = { 0x30, 0xef, 0x20, 0 };
+static uint8 const c_cc32[] = { 0x31, 0xef, 0x20, 0 };
+static uint8 const c_cc33[] = { 0x35, 0xef, 0x20, 0 };
+static uint8 const c_cc34[] = { 0x32, 0x72, 0x86, 0 };
+static uint8 const c_cc35[] = { 0x3c, 0x3d, 0x72, 0x86, 0 };
+static uint8 const c_cc36[] = { 0x62, 0 };
+static uint8 const c_cc37[] = { 0x62, 0x72, 0x86, 0 };
+static uint8 const c_cc38[] = { 0x62, 0x63, 0x72, 0x86, 0x98, 0 };
+static uint8 const c_cc39[] = { 0x63, 0x72, 0x76, 0x86, 0x98, 0 };
+static uint8 const c_cc40[] = { 0x90, 0 };
+static uint8 const c_cc41[] = { 0x20, 0x72, 0x86, 0x88, 0 };
+static uint8 const c_cc42[] = { 0x71, 0x72, 0x85, 0x86, 0xef, 0x71, 0 };
+static uint8 const c_cc43[] = { 0x71, 0x72, 0x80, 0x85, 0x86, 0xef, 0x71, 0 };
+static uint8 const c_cc44[] = { 0x71, 0x72, 0x86, 0xef, 0x71, 0 };
+static uint8 const c_cc45[] = { 0x71, 0x72, 0x80, 0x86, 0xef, 0x71, 0 };
+static uint8 const c_cc46[] = { 0x5a, 0 };
+static uint8 const c_cc47[] = { 0x5a, 0x84, 0 };
+static uint8 const c_cc48[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x56, 0x22, 0 };
+static uint8 const c_cc49[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0 };
+static uint8 const c_cc50[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x62, 0x63, 0x80, 0 };
+static uint8 const c_cc51[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x26, 0 };
+static uint8 const c_cc52[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x56, 0x60, 0x8e, 0x84, 0x22, 0 };
+static uint8 const c_cc53[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x25, 0 };
+static uint8 const c_cc54[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x60, 0x8e, 0x25, 0 };
+static uint8 const c_cc55[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x84, 0 };
+static uint8 const c_cc56[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x5b, 0 };
+static uint8 const c_cc57[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x30, 0x31, 0 };
+static uint8 const c_cc58[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x30, 0 };
+static uint8 const c_cc59[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x56, 0x32, 0 };
+static uint8 const c_cc60[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x60, 0x84, 0x22, 0 };
+static uint8 const c_cc61[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x43, 0x40, 0 };
+static uint8 const c_cc62[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x43, 0 };
+static uint8 const c_cc63[] = { 0x5a, 0x5e, 0x59, 0x72, 0x73, 0x85, 0x86, 0x26, 0x25, 0 };
+
+static DeviceClasses::Entry const c_basic[] =
+{
+	{ 0x0001, 0x00, "Controller", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Static Controller", NULL, NULL, 0 },
+	{ 0x0003, 0x00, "Slave", NULL, NULL, 0 },
+	{ 0x0004, 0x00, "Routing Slave", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific01[] =
+{
+	{ 0x0001, 0x00, "Portable Remote Controller", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Portable Scene Controller", c_cc0, NULL, 0 },
+	{ 0x0003, 0x00, "Portable Installer Tool", c_cc1, NULL, 0 },
+	{ 0x0004, 0x00, "Remote Control AV", NULL, NULL, 0 },
+	{ 0x0006, 0x00, "Remote Control Simple", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific02[] =
+{
+	{ 0x0001, 0x00, "Static PC Controller", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Static Scene Controller", c_cc0, NULL, 0 },
+	{ 0x0003, 0x00, "Static Installer Tool", c_cc1, NULL, 0 },
+	{ 0x0004, 0x00, "Set Top Box", NULL, NULL, 0 },
+	{ 0x0005, 0x00, "Sub System Controller", NULL, NULL, 0 },
+	{ 0x0006, 0x00, "TV", NULL, NULL, 0 },
+	{ 0x0007, 0x00, "Gateway", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific03[] =
+{
+	{ 0x0004, 0x00, "Satellite Receiver", c_cc3, NULL, 0 },
+	{ 0x0011, 0x94, "Satellite Receiver V2", c_cc3, NULL, 0 },
+	{ 0x0012, 0x30, "Doorbell", c_cc4, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific04[] =
+{
+	{ 0x0001, 0x00, "Simple Display", c_cc6, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific05[] =
+{
+	{ 0x0001, 0x00, "Secure Extender", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific06[] =
+{
+	{ 0x0001, 0x00, "General Appliance", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Kitchen Appliance", NULL, NULL, 0 },
+	{ 0x0003, 0x00, "Laundry Appliance", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific07[] =
+{
+	{ 0x0001, 0x00, "Notification Sensor", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific08[] =
+{
+	{ 0x0001, 0x00, "Heating Thermostat", NULL, NULL, 0 },
+	{ 0x0002, 0x40, "General Thermostat", c_cc7, NULL, 0 },
+	{ 0x0003, 0x46, "Setback Schedule Thermostat", c_cc8, NULL, 0 },
+	{ 0x0004, 0x43, "Setpoint Thermostat", c_cc9, NULL, 0 },
+	{ 0x0005, 0x40, "Setback Thermostat", c_cc10, NULL, 0 },
+	{ 0x0006, 0x40, "General Thermostat V2", c_cc11, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific09[] =
+{
+	{ 0x0001, 0x50, "Simple Window Covering", c_cc12, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific0f[] =
+{
+	{ 0x0001, 0x00, "Basic Repeater Slave", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific10[] =
+{
+	{ 0x0001, 0x00, "Binary Power Switch", c_cc13, NULL, 0 },
+	{ 0x0003, 0x00, "Binary Scene Switch", c_cc14, NULL, 0 },
+	{ 0x0004, 0x25, "Power Strip", c_cc15, NULL, 0 },
+	{ 0x0005, 0x25, "Siren", c_cc15, NULL, 0 },
+	{ 0x0006, 0x25, "Valve Open Close", c_cc15, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific11[] =
+{
+	{ 0x0001, 0x00, "Multilevel Power Switch", c_cc13, NULL, 0 },
+	{ 0x0003, 0x00, "Multiposition Motor", c_cc16, NULL, 0 },
+	{ 0x0004, 0x00, "Multilevel Scene Switch", c_cc17, NULL, 0 },
+	{ 0x0005, 0x00, "Motor Control Class A", c_cc18, NULL, 0 },
+	{ 0x0006, 0x00, "Motor Control Class B", c_cc18, NULL, 0 },
+	{ 0x0007, 0x00, "Motor Control Class C", c_cc18, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific12[] =
+{
+	{ 0x0001, 0x25, "Binary Remote Switch", c_cc20, NULL, 0 },
+	{ 0x0002, 0x26, "Multilevel Remote Switch", c_cc21, NULL, 0 },
+	{ 0x0003, 0x28, "Binary Toggle Remote Switch", c_cc22, NULL, 0 },
+	{ 0x0004, 0x29, "Multilevel Toggle Remote Switch", c_cc23, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific13[] =
+{
+	{ 0x0001, 0x28, "Binary Toggle Switch", c_cc24, NULL, 0 },
+	{ 0x0002, 0x29, "Multilevel Toggle Switch", c_cc25, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific14[] =
+{
+	{ 0x0001, 0x00, "Z/IP Tunneling Gateway", c_cc26, NULL, 0 },
+	{ 0x0002, 0x00, "Z/IP Advanced Gateway", c_cc27, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific15[] =
+{
+	{ 0x0001, 0x00, "Z/IP Tunneling Node", c_cc28, NULL, 0 },
+	{ 0x0002, 0x00, "Z/IP Advanced Node", c_cc29, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific16[] =
+{
+	{ 0x0001, 0x39, "Residential Heat Recovery Ventilation", c_cc30, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific17[] =
+{
+	{ 0x0001, 0x00, "Zoned Security Panel", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific18[] =
+{
+	{ 0x0001, 0x00, "Basic Wall Controller", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific20[] =
+{
+	{ 0x0001, 0x00, "Routing Binary Sensor", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific21[] =
+{
+	{ 0x0001, 0x00, "Routing Multilevel Sensor", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Chimney Fan", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific31[] =
+{
+	{ 0x0001, 0x32, "Simple Meter", c_cc34, NULL, 0 },
+	{ 0x0002, 0x00, "Advanced Energy Control", c_cc35, NULL, 0 },
+	{ 0x0003, 0x00, "Whole Home Meter Simple", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific40[] =
+{
+	{ 0x0001, 0x62, "Door Lock", c_cc36, NULL, 0 },
+	{ 0x0002, 0x62, "Advanced Door Lock", c_cc37, NULL, 0 },
+	{ 0x0003, 0x62, "Secure Keypad Door Lock", c_cc38, NULL, 0 },
+	{ 0x0004, 0x76, "Secure Keypad Door Lock DeadBolt", c_cc39, NULL, 0 },
+	{ 0x0005, 0x00, "Secure Door", NULL, NULL, 0 },
+	{ 0x0006, 0x00, "Secure Gate", NULL, NULL, 0 },
+	{ 0x0007, 0x00, "Secure Barrier AddOn", NULL, NULL, 0 },
+	{ 0x0008, 0x00, "Secure Barrier Open Only", NULL, NULL, 0 },
+	{ 0x0009, 0x00, "Secure Barrier Close Only", NULL, NULL, 0 },
+	{ 0x000a, 0x00, "Secure LockBox", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specific50[] =
+{
+	{ 0x0001, 0x00, "Energy Production", c_cc40, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_specifica1[] =
+{
+	{ 0x0001, 0x00, "Basic Routing Alarm Sensor", c_cc42, NULL, 0 },
+	{ 0x0002, 0x00, "Routing Alarm Sensor", c_cc43, NULL, 0 },
+	{ 0x0003, 0x00, "Basic Zensor Alarm Sensor", c_cc44, NULL, 0 },
+	{ 0x0004, 0x00, "Zensor Alarm Sensor", c_cc45, NULL, 0 },
+	{ 0x0005, 0x00, "Advanced Zensor Alarm Sensor", c_cc43, NULL, 0 },
+	{ 0x0006, 0x00, "Basic Routing Smoke Sensor", c_cc42, NULL, 0 },
+	{ 0x0007, 0x00, "Routing Smoke Sensor", c_cc43, NULL, 0 },
+	{ 0x0008, 0x00, "Basic Zensor Smoke Sensor", c_cc44, NULL, 0 },
+	{ 0x0009, 0x00, "Zensor Smoke Sensor", c_cc45, NULL, 0 },
+	{ 0x000a, 0x00, "Advanced Zensor Smoke Sensor", c_cc43, NULL, 0 },
+	{ 0x000b, 0x71, "Alarm Sensor", c_cc42, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_generic[] =
+{
+	{ 0x0001, 0x00, "Remote Controller", c_cc2, c_specific01, 5 },
+	{ 0x0002, 0x00, "Static Controller", c_cc2, c_specific02, 7 },
+	{ 0x0003, 0x00, "AV Control Point", c_cc5, c_specific03, 3 },
+	{ 0x0004, 0x00, "Display", c_cc5, c_specific04, 1 },
+	{ 0x0005, 0x00, "Network Extender", c_cc5, c_specific05, 1 },
+	{ 0x0006, 0x00, "Appliance", c_cc5, c_specific06, 3 },
+	{ 0x0007, 0x00, "Notification Sensor", c_cc5, c_specific07, 1 },
+	{ 0x0008, 0x00, "Thermostat", c_cc5, c_specific08, 6 },
+	{ 0x0009, 0x00, "Window Covering", c_cc5, c_specific09, 1 },
+	{ 0x000f, 0x00, "Repeater Slave", c_cc5, c_specific0f, 1 },
+	{ 0x0010, 0x25, "Binary Switch", c_cc15, c_specific10, 5 },
+	{ 0x0011, 0x26, "Multilevel Switch", c_cc19, c_specific11, 6 },
+	{ 0x0012, 0x00, "Remote Switch", c_cc2, c_specific12, 4 },
+	{ 0x0013, 0x00, "Toggle Switch", c_cc5, c_specific13, 2 },
+	{ 0x0014, 0x00, "Z/IP Gateway", c_cc5, c_specific14, 2 },
+	{ 0x0015, 0x00, "Z/IP Node", NULL, c_specific15, 2 },
+	{ 0x0016, 0x00, "Ventilation", c_cc5, c_specific16, 1 },
+	{ 0x0017, 0x00, "Security Panel", c_cc5, c_specific17, 1 },
+	{ 0x0018, 0x00, "Wall Controller", c_cc5, c_specific18, 1 },
+	{ 0x0020, 0x30, "Binary Sensor", c_cc31, c_specific20, 1 },
+	{ 0x0021, 0x31, "Multilevel Sensor", c_cc32, c_specific21, 2 },
+	{ 0x0030, 0x35, "Pulse Meter", c_cc33, NULL, 0 },
+	{ 0x0031, 0x00, "Meter", c_cc2, c_specific31, 3 },
+	{ 0x0040, 0x00, "Entry Control", c_cc5, c_specific40, 10 },
+	{ 0x0050, 0x00, "Semi Interoperable", c_cc41, c_specific50, 1 },
+	{ 0x00a1, 0x71, "Alarm Sensor", c_cc2, c_specifica1, 11 },
+	{ 0x00ff, 0x00, "Non Interoperable", NULL, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_role[] =
+{
+	{ 0x0000, 0x00, "Central Controller", c_cc46, NULL, 0 },
+	{ 0x0001, 0x00, "Sub Controller", c_cc46, NULL, 0 },
+	{ 0x0002, 0x00, "Portable Controller", c_cc46, NULL, 0 },
+	{ 0x0003, 0x00, "Portable Reporting Controller", c_cc47, NULL, 0 },
+	{ 0x0004, 0x00, "Portable Slave", c_cc47, NULL, 0 },
+	{ 0x0005, 0x00, "Always On Slave", c_cc46, NULL, 0 },
+	{ 0x0006, 0x00, "Reporting Sleeping Slave", c_cc47, NULL, 0 },
+	{ 0x0007, 0x00, "Listening Sleeping Slave", c_cc46, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_deviceType[] =
+{
+	{ 0x0000, 0x00, "Unknown Type", NULL, NULL, 0 },
+	{ 0x0100, 0x00, "Central Controller", c_cc48, NULL, 0 },
+	{ 0x0200, 0x00, "Display Simple", c_cc49, NULL, 0 },
+	{ 0x0300, 0x00, "Door Lock Keypad", c_cc50, NULL, 0 },
+	{ 0x0400, 0x00, "Fan Switch", c_cc51, NULL, 0 },
+	{ 0x0500, 0x00, "Gateway", c_cc52, NULL, 0 },
+	{ 0x0600, 0x00, "Light Dimmer Switch", c_cc51, NULL, 0 },
+	{ 0x0700, 0x00, "On/Off Power Switch", c_cc53, NULL, 0 },
+	{ 0x0800, 0x00, "Power Strip", c_cc54, NULL, 0 },
+	{ 0x0900, 0x00, "Remote Control AV", c_cc49, NULL, 0 },
+	{ 0x0a00, 0x00, "Remote Control Multi Purpose", c_cc55, NULL, 0 },
+	{ 0x0b00, 0x00, "Remote Control Simple", c_cc56, NULL, 0 },
+	{ 0x0b01, 0x00, "Key Fob", c_cc56, NULL, 0 },
+	{ 0x0b1d, 0x00, "Electrical Conductivity Sensor", c_cc57, NULL, 0 },
+	{ 0x0b1e, 0x00, "Loudness Sensor", c_cc57, NULL, 0 },
+	{ 0x0b1f, 0x00, "Moisture Sensor", c_cc57, NULL, 0 },
+	{ 0x0b20, 0x00, "Frequency Sensor", c_cc57, NULL, 0 },
+	{ 0x0b21, 0x00, "Time Sensor", c_cc57, NULL, 0 },
+	{ 0x0b22, 0x00, "Target Temperature Sensor", c_cc57, NULL, 0 },
+	{ 0x0bff, 0x00, "MultiDevice Sensor", c_cc57, NULL, 0 },
+	{ 0x0c00, 0x00, "Sensor Notification", c_cc58, NULL, 0 },
+	{ 0x0c01, 0x00, "Smoke Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c02, 0x00, "CO Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c03, 0x00, "CO2 Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c04, 0x00, "Heat Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c05, 0x00, "Water Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c06, 0x00, "Access Control Sensor", c_cc58, NULL, 0 },
+	{ 0x0c07, 0x00, "Home Security Sensor", c_cc58, NULL, 0 },
+	{ 0x0c08, 0x00, "Power Management Sensor", c_cc58, NULL, 0 },
+	{ 0x0c09, 0x00, "System Sensor", c_cc58, NULL, 0 },
+	{ 0x0c0a, 0x00, "Emergency Alarm Sensor", c_cc58, NULL, 0 },
+	{ 0x0c0b, 0x00, "Clock Sensor", c_cc58, NULL, 0 },
+	{ 0x0cff, 0x00, "MultiDevice Sensor", c_cc58, NULL, 0 },
+	{ 0x0d00, 0x00, "Multilevel Sensor", c_cc57, NULL, 0 },
+	{ 0x0d01, 0x00, "Air Temperature Sensor", c_cc57, NULL, 0 },
+	{ 0x0d02, 0x00, "General Purpose Sensor", c_cc57, NULL, 0 },
+	{ 0x0d03, 0x00, "Luminance Sensor", c_cc57, NULL, 0 },
+	{ 0x0d04, 0x00, "Power Sensor", c_cc57, NULL, 0 },
+	{ 0x0d05, 0x00, "Humidity Sensor", c_cc57, NULL, 0 },
+	{ 0x0d06, 0x00, "Velocity Sensor", c_cc57, NULL, 0 },
+	{ 0x0d07, 0x00, "Direction Sensor", c_cc57, NULL, 0 },
+	{ 0x0d08, 0x00, "Atmospheric Pressure Sensor", c_cc57, NULL, 0 },
+	{ 0x0d09, 0x00, "Barometric Pressure Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0a, 0x00, "Solar Radiation Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0b, 0x00, "Dew Point Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0c, 0x00, "Rain Rate Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0d, 0x00, "Tide Level Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0e, 0x00, "Weight Sensor", c_cc57, NULL, 0 },
+	{ 0x0d0f, 0x00, "Voltage Sensor", c_cc57, NULL, 0 },
+	{ 0x0d10, 0x00, "Current Sensor", c_cc57, NULL, 0 },
+	{ 0x0d11, 0x00, "CO2 Level Sensor", c_cc57, NULL, 0 },
+	{ 0x0d12, 0x00, "Air Flow Sensor", c_cc57, NULL, 0 },
+	{ 0x0d13, 0x00, "Tank Capacity Sensor", c_cc57, NULL, 0 },
+	{ 0x0d14, 0x00, "Distance Sensor", c_cc57, NULL, 0 },
+	{ 0x0d15, 0x00, "Angle Postition Sensor", c_cc57, NULL, 0 },
+	{ 0x0d16, 0x00, "Rotation Sensor", c_cc57, NULL, 0 },
+	{ 0x0d17, 0x00, "Water Temperature Sensor", c_cc57, NULL, 0 },
+	{ 0x0d18, 0x00, "Soil Temperature Sensor", c_cc57, NULL, 0 },
+	{ 0x0d19, 0x00, "Seismic Intensity Sensor", c_cc57, NULL, 0 },
+	{ 0x0d1a, 0x00, "Seismic Magnitude Sensor", c_cc57, NULL, 0 },
+	{ 0x0d1b, 0x00, "Ultraviolet Sensor", c_cc57, NULL, 0 },
+	{ 0x0d1c, 0x00, "Electrical Resistivity Sensor", c_cc57, NULL, 0 },
+	{ 0x0e00, 0x00, "Set Top Box", c_cc52, NULL, 0 },
+	{ 0x0f00, 0x00, "Siren", c_cc49, NULL, 0 },
+	{ 0x1000, 0x00, "Sub Energy Meter", c_cc59, NULL, 0 },
+	{ 0x1100, 0x00, "Sub System Controller", c_cc60, NULL, 0 },
+	{ 0x1200, 0x00, "Thermostat HVAC", c_cc61, NULL, 0 },
+	{ 0x1300, 0x00, "Thermostat Setback", c_cc62, NULL, 0 },
+	{ 0x1400, 0x00, "TV", c_cc52, NULL, 0 },
+	{ 0x1500, 0x00, "Valve open/close", c_cc63, NULL, 0 },
+	{ 0x1600, 0x00, "Wall Controller", c_cc56, NULL, 0 },
+	{ 0x1700, 0x00, "Whole Home Meter Simple", c_cc59, NULL, 0 },
+	{ 0x1800, 0x00, "Window Covering No Position/Endpoint", c_cc63, NULL, 0 },
+	{ 0x1900, 0x00, "Window Covering Endpoint Aware", c_cc63, NULL, 0 },
+	{ 0x1a00, 0x00, "Window Covering Position/Endpoint Aware", c_cc63, NULL, 0 }
+};
+
+static DeviceClasses::Entry const c_nodeType[] =
+{
+	{ 0x0000, 0x00, "Z-Wave+ node", NULL, NULL, 0 },
+	{ 0x0001, 0x00, "Z-Wave+ IP router", NULL, NULL, 0 },
+	{ 0x0002, 0x00, "Z-Wave+ IP gateway", NULL, NULL, 0 },
+	{ 0x0003, 0x00, "Z-Wave+ IP client and IP node", NULL, NULL, 0 },
+	{ 0x0004, 0x00, "Z-Wave+ IP client and Zwave node", NULL, NULL, 0 }
+};
+
+DeviceClasses::Table const DeviceClasses::s_builtinBasic = { c_basic, 4, false };
+DeviceClasses::Table const DeviceClasses::s_builtinGeneric = { c_generic, 27, false };
+DeviceClasses::Table const DeviceClasses::s_builtinRole = { c_role, 8, false };
+DeviceClasses::Table const DeviceClasses::s_builtinDeviceType = { c_deviceType, 75, false };
+DeviceClasses::Table const DeviceClasses::s_builtinNodeType = { c_nodeType, 5, false };
@@ -0,0 +1,337 @@
+//-----------------------------------------------------------------------------
+//
+//	DeviceClasses.cpp
+//
+//	Basic, generic, specific and Z-Wave+ device class tables
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+#include "DeviceClasses.h"
+#include "platform/Log.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	//-----------------------------------------------------------------------------
+	// Copy a string onto the heap
+	//-----------------------------------------------------------------------------
+	char const* CopyString
+	(
+		char const* _str
+	)
+	{
+		size_t length = strlen( _str );
+		char* copy = new char[length+1];
+		memcpy( copy, _str, length+1 );
+		return copy;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Fill an entry from a device class element
+	//-----------------------------------------------------------------------------
+	DeviceClasses::Entry ReadEntry
+	(
+		TiXmlElement const* _el,
+		uint16 const _key
+	)
+	{
+		DeviceClasses::Entry entry;
+		entry.m_key = _key;
+		entry.m_basicMapping = 0;
+		entry.m_label = NULL;
+		entry.m_mandatoryCommandClasses = NULL;
+		entry.m_specific = NULL;
+		entry.m_specificCount = 0;
+
+		char const* str = _el->Attribute( "label" );
+		entry.m_label = CopyString( str ? str : "" );
+
+		str = _el->Attribute( "command_classes" );
+		if( str )
+		{
+			// Parse the comma delimted command class list
+			vector<uint8> ccs;
+			char* pos = const_cast<char*>(str);
+			while( *pos )
+			{
+				ccs.push_back( (uint8)strtol( pos, &pos, 16 ) );
+				if( (*pos) == ',' )
+				{
+					++pos;
+				}
+			}
+
+			uint8* mandatory = new uint8[ccs.size()+1];
+			for( uint32 i=0; i<ccs.size(); ++i )
+			{
+				mandatory[i] = ccs[i];
+			}
+			mandatory[ccs.size()] = 0;	// Zero terminator
+			entry.m_mandatoryCommandClasses = mandatory;
+		}
+
+		str = _el->Attribute( "basic" );
+		if( str )
+		{
+			char* pStop;
+			entry.m_basicMapping = (uint8)strtol( str, &pStop, 16 );
+		}
+		return entry;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Free the heap data of an entry made by ReadEntry
+	//-----------------------------------------------------------------------------
+	void FreeEntry
+	(
+		DeviceClasses::Entry const& _entry
+	)
+	{
+		delete [] _entry.m_label;
+		delete [] _entry.m_mandatoryCommandClasses;
+		for( uint32 i=0; i<_entry.m_specificCount; ++i )
+		{
+			FreeEntry( _entry.m_specific[i] );
+		}
+		delete [] _entry.m_specific;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Add an entry to a set of entries.  As with the older map based tables, a
+	// key that appears twice keeps the last entry.
+	//-----------------------------------------------------------------------------
+	void AddEntry
+	(
+		map<uint16,DeviceClasses::Entry>& _entries,
+		DeviceClasses::Entry const& _entry
+	)
+	{
+		map<uint16,DeviceClasses::Entry>::iterator it = _entries.find( _entry.m_key );
+		if( it != _entries.end() )
+		{
+			FreeEntry( it->second );
+			it->second = _entry;
+		}
+		else
+		{
+			_entries[_entry.m_key] = _entry;
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Copy a set of entries into a sorted array
+	//-----------------------------------------------------------------------------
+	DeviceClasses::Entry const* MakeArray
+	(
+		map<uint16,DeviceClasses::Entry> const& _entries,
+		uint32& _count
+	)
+	{
+		_count = (uint32)_entries.size();
+		if( _entries.empty() )
+		{
+			return NULL;
+		}
+
+		DeviceClasses::Entry* entries = new DeviceClasses::Entry[_entries.size()];
+		uint32 i = 0;
+		for( map<uint16,DeviceClasses::Entry>::const_iterator it = _entries.begin(); it != _entries.end(); ++it )
+		{
+			entries[i++] = it->second;
+		}
+		return entries;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Replace a table with one made from a set of entries
+	//-----------------------------------------------------------------------------
+	void SetTable
+	(
+		DeviceClasses::Table& _table,
+		map<uint16,DeviceClasses::Entry> const& _entries
+	)
+	{
+		DeviceClasses::Free( _table );
+		_table.m_entries = MakeArray( _entries, _table.m_count );
+		_table.m_owned = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <DeviceClasses::Find>
+// Find an entry by its key
+//-----------------------------------------------------------------------------
+DeviceClasses::Entry const* DeviceClasses::Find
+(
+	Table const& _table,
+	uint16 const _key
+)
+{
+	uint32 low = 0;
+	uint32 high = _table.m_count;
+	while( low < high )
+	{
+		uint32 mid = low + ( high - low ) / 2;
+		if( _table.m_entries[mid].m_key < _key )
+		{
+			low = mid + 1;
+		}
+		else
+		{
+			high = mid;
+		}
+	}
+
+	if( low < _table.m_count && _table.m_entries[low].m_key == _key )
+	{
+		return &_table.m_entries[low];
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <DeviceClasses::FindSpecific>
+// Find a generic class's specific class
+//-----------------------------------------------------------------------------
+DeviceClasses::Entry const* DeviceClasses::FindSpecific
+(
+	Entry const* _generic,
+	uint8 const _specific
+)
+{
+	Table table = { _generic->m_specific, _generic->m_specificCount, false };
+	return Find( table, _specific );
+}
+
+//-----------------------------------------------------------------------------
+// <DeviceClasses::Load>
+// Load replacement tables from a device_classes.xml file
+//-----------------------------------------------------------------------------
+bool DeviceClasses::Load
+(
+	string const& _filename,
+	Table& _basic,
+	Table& _generic,
+	Table& _role,
+	Table& _deviceType,
+	Table& _nodeType
+)
+{
+	TiXmlDocument doc;
+	if( !doc.LoadFile( _filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	{
+		return false;
+	}
+
+	map<uint16,Entry> basic;
+	map<uint16,Entry> generic;
+	map<uint16,Entry> role;
+	map<uint16,Entry> deviceType;
+	map<uint16,Entry> nodeType;
+
+	// Read the basic and generic device classes
+	TiXmlElement const* child = doc.RootElement()->FirstChildElement();
+	while( child )
+	{
+		char const* str = child->Value();
+		char const* keyStr = child->Attribute( "key" );
+		if( str && keyStr )
+		{
+			char* pStop;
+			uint16 key = (uint16)strtol( keyStr, &pStop, 16 );
+
+			if( !strcmp( str, "Generic" ) )
+			{
+				// Generic classes are looked up by an 8 bit key
+				Entry entry = ReadEntry( child, (uint8)key );
+
+				// Add any specific device classes
+				map<uint16,Entry> specific;
+				for( TiXmlElement const* el = child->FirstChildElement(); el; el = el->NextSiblingElement() )
+				{
+					char const* name = el->Value();
+					char const* specificKey = el->Attribute( "key" );
+					if( name && specificKey && !strcmp( name, "Specific" ) )
+					{
+						AddEntry( specific, ReadEntry( el, (uint8)strtol( specificKey, &pStop, 16 ) ) );
+					}
+				}
+				entry.m_specific = MakeArray( specific, entry.m_specificCount );
+				AddEntry( generic, entry );
+			}
+			else if( !strcmp( str, "Basic" ) )
+			{
+				if( child->Attribute( "label" ) )
+				{
+					AddEntry( basic, ReadEntry( child, key ) );
+				}
+			}
+			else if( !strcmp( str, "Role" ) )
+			{
+				AddEntry( role, ReadEntry( child, key ) );
+			}
+			else if( !strcmp( str, "DeviceType" ) )
+			{
+				AddEntry( deviceType, ReadEntry( child, key ) );
+			}
+			else if( !strcmp( str, "NodeType" ) )
+			{
+				AddEntry( nodeType, ReadEntry( child, key ) );
+			}
+		}
+
+		child = child->NextSiblingElement();
+	}
+
+	SetTable( _basic, basic );
+	SetTable( _generic, generic );
+	SetTable( _role, role );
+	SetTable( _deviceType, deviceType );
+	SetTable( _nodeType, nodeType );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <DeviceClasses::Free>
+// Free a table made by Load
+//-----------------------------------------------------------------------------
+void DeviceClasses::Free
+(
+	Table& _table
+)
+{
+	if( _table.m_owned )
+	{
+		for( uint32 i=0; i<_table.m_count; ++i )
+		{
+			FreeEntry( _table.m_entries[i] );
+		}
+		delete [] _table.m_entries;
+	}
+	_table.m_entries = NULL;
+	_table.m_count = 0;
+	_table.m_owned = false;
+}
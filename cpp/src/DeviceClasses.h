@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+//
+//	DeviceClasses.h
+//
+//	Basic, generic, specific and Z-Wave+ device class tables
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _DeviceClasses_H
+#define _DeviceClasses_H
+
+#include <string>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief The device class data from device_classes.xml, held in sorted tables.
+	 *
+	 * The built in tables are compiled from config/device_classes.xml by
+	 * cpp/build/gendeviceclasses.pl (run "make devclasses" after changing the XML),
+	 * so nothing is parsed or allocated to use them when there is no XML at run time.
+	 * The config directory is updated apart from the library, so a device_classes.xml
+	 * there is loaded in their place, and one in the user path replaces that in turn.
+	 */
+	class DeviceClasses
+	{
+	public:
+		/** A device class, or a basic class when only the key and label are used */
+		struct Entry
+		{
+			uint16			m_key;
+			uint8			m_basicMapping;					/**< Command class that COMMAND_CLASS_BASIC maps on to, or zero if there is no mapping */
+			char const*		m_label;						/**< Descriptive label for the device */
+			uint8 const*	m_mandatoryCommandClasses;		/**< Zero terminated array of mandatory command classes, or NULL if there are none */
+			Entry const*	m_specific;						/**< A generic class's specific classes, sorted by key */
+			uint32			m_specificCount;
+		};
+
+		/** Entries sorted by key */
+		struct Table
+		{
+			Entry const*	m_entries;
+			uint32			m_count;
+			bool			m_owned;						/**< True if the entries were loaded from an override file, and must be freed */
+		};
+
+		/**
+		 * Find an entry by its key.
+		 * \param _table the table to search.
+		 * \param _key the key.
+		 * \return the entry, or NULL if there is none with that key.
+		 */
+		static Entry const* Find( Table const& _table, uint16 const _key );
+
+		/**
+		 * Find a generic class's specific class.
+		 * \param _generic the generic class.
+		 * \param _specific the specific class's key.
+		 * \return the entry, or NULL if there is none with that key.
+		 */
+		static Entry const* FindSpecific( Entry const* _generic, uint8 const _specific );
+
+		/**
+		 * Load replacement tables from a device_classes.xml file.  A table is only
+		 * replaced if the file is loaded.
+		 * \return true if the file was loaded.
+		 */
+		static bool Load( string const& _filename, Table& _basic, Table& _generic, Table& _role, Table& _deviceType, Table& _nodeType );
+
+		/**
+		 * Free a table made by Load.  Built in tables are left alone.
+		 * \param _table the table, which is emptied.
+		 */
+		static void Free( Table& _table );
+
+		// Built in tables, generated from config/device_classes.xml
+		static Table const s_builtinBasic;
+		static Table const s_builtinGeneric;
+		static Table const s_builtinRole;
+		static Table const s_builtinDeviceType;
+		static Table const s_builtinNodeType;
+	};
+
+} // namespace OpenZWave
+
+#endif //_DeviceClasses_H
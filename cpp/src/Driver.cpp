@@ -24,19 +24,37 @@
 //	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
 //
 //-----------------------------------------------------------------------------
+
 #include "Defs.h"
 #include "Driver.h"
+#include "ChangeJournal.h"
+#include "Checksum.h"
+#include "ConfigCache.h"
+#include "ControllerGroup.h"
+#include "XmlStreamReader.h"
+#include "XmlWriter.h"
 #include "Options.h"
 #include "Manager.h"
 #include "Node.h"
 #include "Msg.h"
+#include "MsgTrace.h"
 #include "Notification.h"
+#include "NotificationDispatcher.h"
 #include "Scene.h"
+#include "SharedPollThread.h"
+#include "SharedString.h"
 #include "ZWSecurity.h"
 
+#include "platform/Atomic.h"
+#include "platform/ControllerTrace.h"
 #include "platform/Event.h"
+#include "platform/FileOps.h"
 #include "platform/Mutex.h"
 #include "platform/SerialController.h"
+#include "platform/SimulatedController.h"
+#include "platform/Stream.h"
+#include "platform/ReplayController.h"
+#include "platform/TcpController.h"
 #ifdef WINRT
 #include "platform/winRT/HidControllerWinRT.h"
 #else
@@ -45,24 +63,40 @@
 #include "platform/Thread.h"
 #include "platform/Log.h"
 #include "platform/TimeStamp.h"
+#include "platform/WaitSet.h"
 
 #include "command_classes/CommandClasses.h"
 #include "command_classes/ApplicationStatus.h"
+#include "command_classes/Clock.h"
+#include "command_classes/Configuration.h"
 #include "command_classes/ControllerReplication.h"
 #include "command_classes/Security.h"
 #include "command_classes/WakeUp.h"
 #include "command_classes/SwitchAll.h"
+#include "command_classes/SwitchBinary.h"
+#include "command_classes/SwitchMultilevel.h"
+#include "command_classes/ThermostatMode.h"
+#include "command_classes/ThermostatOperatingState.h"
+#include "command_classes/ThermostatSetpoint.h"
+#include "command_classes/TimeParameters.h"
 #include "command_classes/ManufacturerSpecific.h"
+#include "command_classes/MultiCmd.h"
 #include "command_classes/NoOperation.h"
+#include "command_classes/Powerlevel.h"
+#include "command_classes/TransportService.h"
+#include "command_classes/UserCode.h"
 
 #include "value_classes/ValueID.h"
 #include "value_classes/Value.h"
+#include "value_classes/ValueDecimal.h"
 #include "value_classes/ValueStore.h"
+#include "value_classes/ValueIndex.h"
 
 #include "tinyxml.h"
 
 
 #include "Utils.h"
+#include "ValueLog.h"
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
 # include <unistd.h>
 #elif defined _WIN32
@@ -70,7 +104,10 @@
 #define sleep(x) Sleep(1000 * x)
 #endif
 #include <algorithm>
+#include <vector>
 #include <iostream>
+#include <math.h>
+#include <time.h>
 
 using namespace OpenZWave;
 
@@ -84,6 +121,134 @@ using namespace OpenZWave;
 //
 uint32 const c_configVersion = 3;
 
+// Room for a full frame formatted as "0xNN, " per byte
+static uint32 const c_maxFrameLogSize = 256 * 6;
+
+// Bytes of frame data each node may send per turn of the send queue scheduler
+static uint32 const c_msgQueueQuantum = 64;
+
+// Messages in a row a direct neighbour must have had delivered before it is
+// sent them without explore frames
+static uint8 const c_directDeliveryRun = 8;
+
+// Resolution of the poll scheduler
+static int32 const c_pollTickMs = 100;
+
+// How long before a sleeping node's predicted wake up its due polls are
+// queued for it
+static int32 const c_wakeUpStageMs = 10000;
+
+// Values held back for a sleeping node are released up to this much later than
+// the start of the staging time, so nodes that wake together are not all polled
+// at once
+static int32 const c_wakeUpJitterMs = c_wakeUpStageMs / 2;
+
+// Largest command class payload a single Z-Wave frame carries, which bounds
+// how many poll requests fit in one MultiCmd encapsulation
+static uint32 const c_maxMultiCmdPayload = 46;
+
+// Upper limit for the MaxInFlightMsgs option
+static uint32 const c_maxInFlightMsgs = 4;
+
+// Shortest retry timeout the AdaptiveRetryTimeout option will use, in ms
+static int32 const c_minRetryTimeout = 1000;
+
+// Time before the first probe of a node presumed dead, and the longest time
+// between probes, in ms
+static int32 const c_firstProbeInterval = 10000;
+static int32 const c_maxProbeInterval = 600000;
+
+// Shortest quiet time after which the LivenessInterval option probes a node,
+// and the shortest gap between frames counted towards a node's usual gap, in ms.
+// Shorter gaps are the frames of a single exchange.
+static int32 const c_minLivenessQuiet = 60000;
+static uint32 const c_minLivenessGap = 10000;
+
+// Time between the probes of quiet nodes, in ms
+static int32 const c_livenessProbeGap = 1000;
+
+// Most messages parked for a node presumed dead.  The oldest are dropped.
+static uint32 const c_maxParkedMsgs = 64;
+
+// How long a prefetched nonce is used for.  Nodes must keep a nonce for at
+// least three seconds, so this leaves some margin for the message to get there.
+static int32 const c_prefetchedNonceLifetime = 2500;
+
+// Most nodes addressed by one multicast frame, which keeps it well inside the
+// controller's buffer
+static uint32 const c_maxMulticastNodes = 64;
+
+// Time after a broadcast for the nodes to report their change themselves, and
+// the shortest gap between checks of the nodes that did not, in ms
+static int32 const c_broadcastSettleMs = 3000;
+static int32 const c_broadcastCheckGapMs = 500;
+
+// Bytes of controller NVM in each request, the most that fit both a read reply
+// and a write request in one frame, and how many requests are kept queued ahead
+static uint32 const c_nvmBlockSize = 240;
+static uint32 const c_nvmQueueAhead = 4;
+
+// A controller NVM backup starts with the magic number ("OZWN"), the version,
+// the home ID, the size of the NVM and the CRC of the NVM, all little endian
+static uint32 const c_nvmHeaderSize = 16;
+static uint32 const c_nvmMagic = 0x4e575a4f;
+static uint32 const c_nvmVersion = 1;
+
+uint8 const Driver::c_noNeighbors[NUM_NODE_BITFIELD_BYTES] = { 0 };
+
+static uint32 GetNvmHeaderField( uint8 const* _header, uint32 const _pos, uint32 const _bytes )
+{
+	uint32 value = 0;
+	for( uint32 i = _bytes; i > 0; --i )
+	{
+		value = ( value << 8 ) | _header[_pos+i-1];
+	}
+	return value;
+}
+
+static void SetNvmHeaderField( uint8* _header, uint32 const _pos, uint32 const _bytes, uint32 _value )
+{
+	for( uint32 i = 0; i < _bytes; ++i )
+	{
+		_header[_pos+i] = (uint8)_value;
+		_value >>= 8;
+	}
+}
+
+// Room for about a thousand sniffed frames.  Each is held as its time, its
+// length, the source and target nodes and the payload.
+static uint32 const c_snifferRingSize = 65536;
+static uint32 const c_sniffedHeaderSize = 7;
+
+// How far apart the clocks of listening nodes are set, and how often the
+// host's clock is checked for having been changed
+static int32 const c_timeSyncSpacingMs = 500;
+static int32 const c_timeSyncCheckMs = 60000;
+
+// The local time as seconds since 1970, so that a change of the offset from
+// UTC, such as the start of daylight saving, shows up as a step in it
+static int64 GetLocalSeconds( time_t const _time )
+{
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(push)
+#pragma warning(disable:4996)
+#endif
+	struct tm* local = localtime( &_time );
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(pop)
+#endif
+	if( local == NULL )
+	{
+		return (int64)_time;
+	}
+
+	// Days from 1970 to the start of the year, counting the leap days in between
+	int64 year = local->tm_year + 1900;
+	int64 days = 365 * ( year - 1970 ) + ( ( year - 1 ) / 4 - 1969 / 4 ) - ( ( year - 1 ) / 100 - 1969 / 100 ) + ( ( year - 1 ) / 400 - 1969 / 400 );
+	days += local->tm_yday;
+	return days * 86400 + local->tm_hour * 3600 + local->tm_min * 60 + local->tm_sec;
+}
+
 static char const* c_libraryTypeNames[] =
 {
 		"Unknown",			// library type 0
@@ -143,10 +308,24 @@ Driver::Driver
 m_driverThread( new Thread( "driver" ) ),
 m_initMutex(new Mutex()),
 m_exit( false ),
+m_tearingDown( false ),
 m_init( false ),
 m_awakeNodesQueried( false ),
 m_allNodesQueried( false ),
 m_notifytransactions( false ),
+m_configLength( 0 ),
+m_configReadTime( 0 ),
+m_configBuildTime( 0 ),
+m_configThread( NULL ),
+m_configEvent( NULL ),
+m_configMutex( NULL ),
+m_configPending( NULL ),
+m_configPendingBinary( false ),
+m_configPendingLogMark( 0 ),
+m_valueExport( NULL ),
+m_valueIndex( new ValueIndex() ),
+m_valueLog( NULL ),
+m_valueLogMaxSize( 0 ),
 m_controllerInterfaceType( _interface ),
 m_controllerPath( _controllerPath ),
 m_controller( NULL ),
@@ -160,8 +339,11 @@ m_productId ( 0 ),
 m_initVersion( 0 ),
 m_initCaps( 0 ),
 m_controllerCaps( 0 ),
+m_initCache( InitCache_Off ),
+m_controllerLost( false ),
+m_reconnectCheck( false ),
 m_Controller_nodeId ( 0 ),
-m_nodeMutex( new Mutex() ),
+m_nodeMutex( new RWLock() ),
 m_controllerReplication( NULL ),
 m_transmitOptions( TRANSMIT_OPTION_ACK | TRANSMIT_OPTION_AUTO_ROUTE | TRANSMIT_OPTION_EXPLORE ),
 m_waitingForAck( false ),
@@ -170,41 +352,98 @@ m_expectedReply( 0 ),
 m_expectedCommandClassId( 0 ),
 m_expectedNodeId( 0 ),
 m_pollThread( new Thread( "poll" ) ),
+m_pollBatchNodeId( 0 ),
+m_pollBatchThreadId( 0 ),
+m_setBatchNodeId( 0 ),
+m_triggerNodeId( 0 ),
+m_triggerMutex( new Mutex() ),
+m_pollEvent( new Event() ),
+m_sendIdleEvent( new Event() ),
+m_sendIdle( false ),
 m_pollMutex( new Mutex() ),
 m_pollInterval( 0 ),
 m_bIntervalBetweenPolls( false ),				// if set to true (via SetPollInterval), the pollInterval will be interspersed between each poll (so a much smaller m_pollInterval like 100, 500, or 1,000 may be appropriate)
+m_pollWaitingForIdle( false ),
+m_pollWarned( false ),
 m_currentControllerCommand( NULL ),
+m_controllerStepTimeout( 0 ),
 m_SUCNodeId( 0 ),
+m_timeSync( false ),
+m_timeSyncStarted( false ),
+m_timeSyncMaxDrift( 60 ),
+m_timeSyncTicks( 0 ),
+m_timeSyncLocal( 0 ),
 m_controllerResetEvent( NULL ),
 m_sendMutex( new Mutex() ),
 m_currentMsg( NULL ),
+m_circuitBreaker( false ),
+m_livenessInterval( 0 ),
+m_duplicateWindow( 0 ),
+m_group( NULL ),
+m_forwardMutex( new Mutex() ),
+m_handlingForwarded( false ),
+m_noncePrefetch( false ),
+m_nonceRequested( 0 ),
+m_maxInFlight( 1 ),
+m_sendDataAccepted( false ),
+m_adaptiveRetryTimeout( false ),
+m_deferBackgroundMsgs( true ),
+m_interviewMutex( new Mutex() ),
+m_maxInterviews( 0 ),
+m_interviewCount( 0 ),
+m_healthMutex( new Mutex() ),
+m_healthScanning( false ),
+m_healthFrames( 0 ),
+m_neighborRefreshInterval( 0 ),
+m_topologyVersion( 1 ),
+m_neighborRefreshNode( 0 ),
+m_healShare( 25 ),
+m_healRR( false ),
+m_healNode( 0 ),
+m_refreshFlags( 0 ),
+m_refreshNode( 0 ),
+m_nvmMutex( new Mutex() ),
+m_nvmState( NvmState_Idle ),
+m_nvmRestore( false ),
+m_nvmFile( NULL ),
+m_nvmImage( NULL ),
+m_nvmImageSize( 0 ),
+m_nvmSize( 0 ),
+m_nvmQueued( 0 ),
+m_nvmDone( 0 ),
+m_nvmOutstanding( 0 ),
+m_nvmReplied( false ),
+m_nvmCrc( 0 ),
+m_nvmPercent( 0 ),
+m_nvmElapsed( 0 ),
+m_snifferMutex( new Mutex() ),
+m_snifferRing( NULL ),
+m_snifferTrace( NULL ),
+m_sniffing( 0 ),
+m_snifferDropped( 0 ),
+m_msgTrace( new MsgTrace() ),
 m_virtualNeighborsReceived( false ),
+m_legacyButtonsRead( false ),
+m_broadcastMutex( new Mutex() ),
+m_valueSetMutex( new Mutex() ),
+m_nextSceneRuleId( 1 ),
+m_provisioningMutex( new Mutex() ),
 m_notificationsEvent( new Event() ),
-m_SOFCnt( 0 ),
-m_ACKWaiting( 0 ),
-m_readAborts( 0 ),
-m_badChecksum( 0 ),
-m_readCnt( 0 ),
-m_writeCnt( 0 ),
-m_CANCnt( 0 ),
-m_NAKCnt( 0 ),
-m_ACKCnt( 0 ),
-m_OOFCnt( 0 ),
-m_dropped( 0 ),
-m_retries( 0 ),
-m_callbacks( 0 ),
-m_badroutes( 0 ),
-m_noack( 0 ),
-m_netbusy( 0 ),
-m_notidle( 0 ),
-m_nondelivery( 0 ),
-m_routedbusy( 0 ),
-m_broadcastReadCnt( 0 ),
-m_broadcastWriteCnt( 0 ),
+m_notificationsMutex( new Mutex() ),
+m_notificationDispatcher( NULL ),
+m_notificationInterval( 0 ),
+m_heldNotifications( 0 ),
+m_bulkValueAdded( false ),
+m_changeJournal( NULL ),
+m_counters( new DriverCounters() ),
+m_rxFrameAge( 0 ),
 AuthKey( 0 ),
 EncryptKey( 0 ),
+InclusionAuthKey( 0 ),
+InclusionEncryptKey( 0 ),
 m_nonceReportSent( 0 ),
-m_nonceReportSentAttempt( 0 )
+m_nonceReportSentAttempt( 0 ),
+m_inclusionkeySet( false )
 {
 	// set a timestamp to indicate when this driver started
 	TimeStamp m_startTime;
@@ -213,10 +452,33 @@ m_nonceReportSentAttempt( 0 )
 	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
 		m_queueEvent[i] = new Event();
+		m_shapers[i].m_share = 0;
+		m_shapers[i].m_burst = 0;
+		m_shapers[i].m_tokens = 0;
+		m_queueAirtime[i] = 0;
+		m_queueDeadline[i] = 0;
+		m_queueAging[i] = 0;
+		m_queueAged[i] = 0;
 	}
 
 	// Clear the nodes array
-	memset( m_nodes, 0, sizeof(Node*) * 256 );
+	memset( m_initNodeMask, 0, sizeof(m_initNodeMask) );
+	memset( m_routesPending, 0, sizeof(m_routesPending) );
+	memset( m_timeSyncStaged, 0, sizeof(m_timeSyncStaged) );
+	memset( (void*)m_sendRoutes, 0, sizeof(m_sendRoutes) );
+	memset( (void*)m_valueCache, 0, sizeof(m_valueCache) );
+	memset( &m_nodeCounters, 0, sizeof(m_nodeCounters) );
+	memset( (void*)m_configDirty, 0, sizeof(m_configDirty) );
+	memset( m_interviews, 0, sizeof(m_interviews) );
+	for( int i=0; i<256; ++i )
+	{
+		m_circuits[i].m_open = false;
+		m_circuits[i].m_probeInterval = 0;
+		m_liveness[i].m_lastHeard = 0;
+		m_liveness[i].m_meanGap = 0;
+		m_liveness[i].m_probed = 0;
+		m_prefetchedNonces[i].m_valid = false;
+	}
 
 	// Clear the virtual neighbors array
 	memset( m_virtualNeighbors, 0, NUM_NODE_BITFIELD_BYTES );
@@ -229,15 +491,138 @@ m_nonceReportSentAttempt( 0 )
 	{
 		m_controller = new HidController();
 	}
+	else if( ControllerInterface_Simulated == _interface )
+	{
+		m_controller = new SimulatedController();
+	}
+	else if( ControllerInterface_Replay == _interface )
+	{
+		m_controller = new ReplayController();
+	}
+	else if( ControllerInterface_Tcp == _interface )
+	{
+		m_controller = new TcpController();
+	}
 	else
 	{
 		m_controller = new SerialController();
 	}
 	m_controller->SetSignalThreshold( 1 );
 
+	// Record the traffic with real hardware, so it can be replayed later
+	string trace;
+	Options::Get()->GetOptionAsString( "ControllerTrace", &trace );
+	if( !trace.empty() && ( ControllerInterface_Serial == _interface || ControllerInterface_Hid == _interface || ControllerInterface_Tcp == _interface ) )
+	{
+		string userPath;
+		Options::Get()->GetOptionAsString( "UserPath", &userPath );
+		m_controller->StartTrace( userPath + trace );
+	}
+
 	Options::Get()->GetOptionAsBool( "NotifyTransactions", &m_notifytransactions );
 	Options::Get()->GetOptionAsInt( "PollInterval", &m_pollInterval );
 	Options::Get()->GetOptionAsBool( "IntervalBetweenPolls", &m_bIntervalBetweenPolls );
+
+	bool notificationThread = false;
+	Options::Get()->GetOptionAsBool( "NotificationThread", &notificationThread );
+	if( notificationThread )
+	{
+		int32 queueSize = 256;
+		Options::Get()->GetOptionAsInt( "NotificationQueueSize", &queueSize );
+		m_notificationDispatcher = new NotificationDispatcher( queueSize > 0 ? (uint32)queueSize : 1, &m_handlerTime );
+	}
+
+	int32 notificationInterval = 0;
+	Options::Get()->GetOptionAsInt( "NotificationInterval", &notificationInterval );
+	m_notificationInterval = ( notificationInterval > 0 ) ? (uint32)notificationInterval : 0;
+
+	bool backgroundSave = false;
+	Options::Get()->GetOptionAsBool( "BackgroundConfigSave", &backgroundSave );
+	if( backgroundSave )
+	{
+		m_configEvent = new Event();
+		m_configMutex = new Mutex();
+		m_configThread = new Thread( "config" );
+		m_configThread->Start( Driver::ConfigThreadEntryPoint, this );
+	}
+
+	Options::Get()->GetOptionAsBool( "AdaptiveRetryTimeout", &m_adaptiveRetryTimeout );
+	Options::Get()->GetOptionAsBool( "DeferBackgroundMsgs", &m_deferBackgroundMsgs );
+	Options::Get()->GetOptionAsBool( "CircuitBreaker", &m_circuitBreaker );
+	int32 livenessInterval = 0;
+	Options::Get()->GetOptionAsInt( "LivenessInterval", &livenessInterval );
+	m_livenessInterval = ( livenessInterval > 0 ) ? livenessInterval * 1000 : 0;
+
+	int32 duplicateWindow = 0;
+	Options::Get()->GetOptionAsInt( "DuplicateFrameWindow", &duplicateWindow );
+	m_duplicateWindow = ( duplicateWindow > 0 ) ? duplicateWindow : 0;
+	Options::Get()->GetOptionAsBool( "NoncePrefetch", &m_noncePrefetch );
+	Options::Get()->GetOptionAsBool( "BulkValueAdded", &m_bulkValueAdded );
+	int32 journalSize = 0;
+	Options::Get()->GetOptionAsInt( "ChangeJournalSize", &journalSize );
+	if( journalSize > 0 )
+	{
+		m_changeJournal = new ChangeJournal( (uint32)journalSize );
+	}
+	ReadSendShaping();
+	ReadQueueTimes( "QueueDeadlines", m_queueDeadline );
+	ReadQueueTimes( "QueueAging", m_queueAging );
+	m_notifyExpired = false;
+	Options::Get()->GetOptionAsBool( "NotifyExpiredMsgs", &m_notifyExpired );
+
+	memset( m_staleNeighbors, 0, sizeof(m_staleNeighbors) );
+	memset( m_topology, 0, sizeof(m_topology) );
+	int32 neighborRefresh = 0;
+	Options::Get()->GetOptionAsInt( "NeighborRefreshInterval", &neighborRefresh );
+	if( neighborRefresh > 0 )
+	{
+		m_neighborRefreshInterval = neighborRefresh * 1000;
+	}
+
+	int32 stepTimeout = 0;
+	Options::Get()->GetOptionAsInt( "ControllerCommandTimeout", &stepTimeout );
+	if( stepTimeout > 0 )
+	{
+		m_controllerStepTimeout = stepTimeout * 1000;
+	}
+
+	Options::Get()->GetOptionAsInt( "HealAirtimeShare", &m_healShare );
+	if( m_healShare < 1 )
+	{
+		m_healShare = 1;
+	}
+	else if( m_healShare > 100 )
+	{
+		m_healShare = 100;
+	}
+
+	m_provisionWindow = 2;
+	Options::Get()->GetOptionAsInt( "ConfigProvisionWindow", &m_provisionWindow );
+	if( m_provisionWindow < 1 )
+	{
+		m_provisionWindow = 1;
+	}
+
+	int32 maxInterviews = 0;
+	Options::Get()->GetOptionAsInt( "MaxConcurrentInterviews", &maxInterviews );
+	if( maxInterviews > 0 )
+	{
+		m_maxInterviews = (uint32)maxInterviews;
+	}
+
+	Options::Get()->GetOptionAsBool( "TimeSync", &m_timeSync );
+	Options::Get()->GetOptionAsInt( "TimeSyncMaxDrift", &m_timeSyncMaxDrift );
+	if( m_timeSyncMaxDrift < 1 )
+	{
+		m_timeSyncMaxDrift = 1;
+	}
+
+	int32 maxInFlight = 1;
+	Options::Get()->GetOptionAsInt( "MaxInFlightMsgs", &maxInFlight );
+	if( maxInFlight > 1 )
+	{
+		m_maxInFlight = ( (uint32)maxInFlight < c_maxInFlightMsgs ) ? (uint32)maxInFlight : c_maxInFlightMsgs;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -259,6 +644,22 @@ Driver::~Driver
 	// append final driver stats output to the log file
 	LogDriverStatistics();
 
+	bool fast = false;
+	Options::Get()->GetOptionAsBool( "FastShutdown", &fast );
+	if( fast )
+	{
+		// The threads wind down while the configuration is saved.  The final
+		// snapshot goes to the background writer, which saves it after any
+		// older one it is busy with.
+		SignalExit();
+	}
+	else
+	{
+		// Finish any background save, so the final one below cannot be
+		// overtaken by an older snapshot
+		StopConfigThread();
+	}
+
 	// Save the driver config before deleting anything else
 	bool save;
 	if( Options::Get()->GetOptionAsBool( "SaveConfiguration", &save) )
@@ -269,6 +670,7 @@ Driver::~Driver
 			Scene::WriteXML( "zwscene.xml" );
 		}
 	}
+	StopConfigThread();
 
 	// The order of the statements below has been achieved by mitigating freed memory
 	//references using a memory allocator checker. Do not rearrange unless you are
@@ -277,41 +679,66 @@ Driver::~Driver
 	m_exit = true;
 	m_initMutex->Unlock();
 
+	if( SharedPollThread* spt = SharedPollThread::Get() )
+	{
+		spt->Remove( this );
+	}
 	m_pollThread->Stop();
 	m_pollThread->Release();
 
 	m_driverThread->Stop();
 	m_driverThread->Release();
 
-	m_sendMutex->Release();
-
 	m_controller->Close();
 	m_controller->Release();
 
 	m_initMutex->Release();
 
+	// Now that nothing more will be sent, leave the state for the next process
+	SaveHandoff();
+
+	// Sets still waiting to be confirmed never will be
+	CancelValueSets( 0 );
+	CompleteValueSets( m_valueSetResults );
+
 	if( m_currentMsg != NULL )
 	{
 		RemoveCurrentMsg();
 	}
 
-	// Clear the node data
+	// Clear the node data.  In a fast shutdown the nodes leave out the
+	// notifications and the queue, poll and route bookkeeping for each node
+	// and value, as the whole driver goes with them and the application has
+	// already been sent DriverRemoved.
+	m_tearingDown = fast;
 	{
-		LockGuard LG(m_nodeMutex);
-		for( int i=0; i<256; ++i )
+		WriteLockGuard LG(m_nodeMutex);
+		while( !m_nodeIds.empty() )
 		{
-			if( GetNodeUnsafe( i ) )
+			uint8 nodeId = m_nodeIds.front();
+			SetNodeObject( nodeId, NULL );
+			if( !m_tearingDown )
 			{
-				delete m_nodes[i];
-				m_nodes[i] = NULL;
 				Notification* notification = new Notification( Notification::Type_NodeRemoved );
-				notification->SetHomeAndNodeIds( m_homeId, i );
+				notification->SetHomeAndNodeIds( m_homeId, nodeId );
 				QueueNotification( notification );
 			}
 		}
 	}
+	// The values have all left it with their nodes
+	delete m_valueExport;
+	m_valueExport = NULL;
+	delete m_valueIndex;
+	m_valueIndex = NULL;
+	delete m_valueLog;
+	m_valueLog = NULL;
+
 	// Don't release until all nodes have removed their poll values
 	m_pollMutex->Release();
+	m_triggerMutex->Release();
+	m_provisioningMutex->Release();
+	m_pollEvent->Release();
+	m_sendIdleEvent->Release();
 
 	// Clear the send Queue
 	for( int32 i=0; i<MsgQueue_Count; ++i )
@@ -332,6 +759,33 @@ Driver::~Driver
 
 		m_queueEvent[i]->Release();
 	}
+	for( map<uint8,Provision*>::iterator it = m_provisions.begin(); it != m_provisions.end(); ++it )
+	{
+		delete it->second;
+	}
+	m_provisions.clear();
+	for( int i=0; i<256; ++i )
+	{
+		for( list< pair<MsgQueue,MsgQueueItem> >::iterator it = m_circuits[i].m_parked.begin(); it != m_circuits[i].m_parked.end(); ++it )
+		{
+			delete it->second.m_msg;
+		}
+		m_circuits[i].m_parked.clear();
+	}
+	for( map<uint8,InFlightMsg*>::iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it )
+	{
+		delete it->second->m_msg;
+		delete it->second;
+	}
+	m_inFlight.clear();
+	for( list<Msg*>::iterator it = m_handoffMsgs.begin(); it != m_handoffMsgs.end(); ++it )
+	{
+		delete *it;
+	}
+	m_handoffMsgs.clear();
+	// Kept until now, as deleting the nodes drops their in flight messages under it
+	m_sendMutex->Release();
+
 	/* Doing our Notification Call back here in the destructor is just asking for trouble
 	 * as there is a good chance that the application will do some sort of GetDriver() supported
 	 * method on the Manager Class, which by this time, most of the OZW Classes associated with the
@@ -352,10 +806,97 @@ Driver::~Driver
 	if (m_controllerReplication)
 		delete m_controllerReplication;
 
+	// Delivers anything still waiting before the thread stops
+	delete m_notificationDispatcher;
+
+	// Anything not delivered, including notifications still held back
+	for( list<Notification*>::iterator it = m_notifications.begin(); it != m_notifications.end(); ++it )
+	{
+		delete *it;
+	}
+	m_notifications.clear();
+	for( map<ValueID,CoalescedValue>::iterator it = m_coalescedValues.begin(); it != m_coalescedValues.end(); ++it )
+	{
+		if( it->second.m_held )
+		{
+			delete it->second.m_pending;
+		}
+	}
+	m_coalescedValues.clear();
+	DiscardRefreshRequests();
+
+	if( m_nvmFile )
+	{
+		fclose( m_nvmFile );
+		remove( ( m_nvmFileName + ".tmp" ).c_str() );
+	}
+	if( m_nvmImage )
+	{
+		FileOps::UnmapFile( m_nvmImage, m_nvmImageSize );
+	}
+	m_nvmMutex->Release();
+
+	delete m_snifferTrace;
+	if( m_snifferRing )
+	{
+		m_snifferRing->Release();
+	}
+	m_snifferMutex->Release();
+	delete m_msgTrace;
+
+	delete m_changeJournal;
+	m_forwardMutex->Release();
 	m_notificationsEvent->Release();
+	m_notificationsMutex->Release();
+	m_valueSetMutex->Release();
+	while( !m_broadcastChecks.empty() )
+	{
+		delete m_broadcastChecks.front();
+		m_broadcastChecks.pop_front();
+	}
+	m_broadcastMutex->Release();
+	m_interviewMutex->Release();
+	m_healthMutex->Release();
 	m_nodeMutex->Release();
 	delete AuthKey;
 	delete EncryptKey;
+	delete InclusionAuthKey;
+	delete InclusionEncryptKey;
+	delete m_counters;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SignalExit>
+// Ask the poll and driver threads to stop, without waiting for them
+//-----------------------------------------------------------------------------
+void Driver::SignalExit
+(
+)
+{
+	m_initMutex->Lock();
+	m_exit = true;
+	m_initMutex->Unlock();
+
+	m_pollThread->Signal();
+	m_driverThread->Signal();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::StopConfigThread>
+// Stop the background writer, which first saves any snapshot still pending
+//-----------------------------------------------------------------------------
+void Driver::StopConfigThread
+(
+)
+{
+	if( m_configThread )
+	{
+		m_configThread->Stop();
+		m_configThread->Release();
+		m_configThread = NULL;
+		m_configEvent->Release();
+		m_configMutex->Release();
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -415,6 +956,9 @@ void Driver::DriverThreadProc
 			waitObjects[9] = m_queueEvent[MsgQueue_Query];		// Node queries are pending.
 			waitObjects[10] = m_queueEvent[MsgQueue_Poll];		// Poll request is waiting.
 
+			// Watch the objects once, rather than on every pass round the loop
+			WaitSet waitSet( waitObjects, 11 );
+
 			TimeStamp retryTimeStamp;
 			int retryTimeout = RETRY_TIMEOUT;
 			Options::Get()->GetOptionAsInt( "RetryTimeout", &retryTimeout );
@@ -425,19 +969,34 @@ void Driver::DriverThreadProc
 				uint32 count = 11;
 				int32 timeout = Wait::Timeout_Infinite;
 
+				// If the controller has accepted the current message, it can wait
+				// for its callback in the background while we send the next one.
+				PipelineCurrentMsg( retryTimeStamp );
+
 				// If we're waiting for a message to complete, we can only
 				// handle incoming data, notifications and exit events.
 				if( m_waitingForAck || m_expectedCallbackId || m_expectedReply )
 				{
-					count = 3;
-					timeout = m_waitingForAck ? ACK_TIMEOUT : retryTimeStamp.TimeRemaining();
+					// A background message waiting for its reply can still give way to the more urgent queues
+					count = CanDeferCurrentMsg() ? 3 + MsgQueue_Query : 3;
+					timeout = m_waitingForAck ? m_ackTimeStamp.TimeRemaining() : retryTimeStamp.TimeRemaining();
 					if( timeout < 0 )
 					{
 						timeout = 0;
 					}
 				}
-				else if( m_currentControllerCommand != NULL )
+				else if( !m_inFlight.empty() )
+				{
+					// Only items that do not depend on the in flight messages can go next
+					if( !CanPipelineNextMsg() )
+					{
+						count = 3;
+					}
+					timeout = GetInFlightTimeout();
+				}
+				else if( m_currentControllerCommand != NULL && IsExclusiveControllerCommand( m_currentControllerCommand->m_controllerCommand ) )
 				{
+					// Only the command's own messages may be sent until it is done
 					count = 7;
 				}
 				else
@@ -445,15 +1004,90 @@ void Driver::DriverThreadProc
 					Log::QueueClear();							// clear the log queue when starting a new message
 				}
 
+				// Wake up in time to deliver any value notifications that have been held back
+				bool releaseHeld = false;
+				int32 heldTimeout = ReleaseHeldNotifications();
+				if( heldTimeout >= 0 && ( timeout == Wait::Timeout_Infinite || heldTimeout < timeout ) )
+				{
+					timeout = heldTimeout;
+					releaseHeld = true;
+				}
+
+				// Reports the network's other controllers received
+				HandleForwardedFrames();
+
+				// Wake up in time to handle the reports held back from flooding nodes
+				bool floodDue = false;
+				int32 floodTimeout = ReleaseHeldFrames();
+				if( floodTimeout >= 0 && ( timeout == Wait::Timeout_Infinite || floodTimeout < timeout ) )
+				{
+					timeout = floodTimeout;
+					floodDue = true;
+				}
+
+				// Wake up in time to give up a controller command that has stopped making progress
+				bool stepDue = false;
+				int32 stepTimeout = CheckControllerCommandStep();
+				if( stepTimeout >= 0 && ( timeout == Wait::Timeout_Infinite || stepTimeout < timeout ) )
+				{
+					timeout = stepTimeout;
+					stepDue = true;
+				}
+
+				// Report the value sets that are over, and wake up in time to time out the rest
+				bool setDue = false;
+				int32 setTimeout = CheckValueSets();
+				if( setTimeout >= 0 && ( timeout == Wait::Timeout_Infinite || setTimeout < timeout ) )
+				{
+					timeout = setTimeout;
+					setDue = true;
+				}
+
+				// Queues that have used up their share of the airtime wait for it to build up again
+				bool refillDue = false;
+				uint32 shaped = 0;
+				if( count > 3 )
+				{
+					int32 shapedTimeout = GetShapedQueues( &shaped );
+					if( shapedTimeout >= 0 && ( timeout == Wait::Timeout_Infinite || shapedTimeout < timeout ) )
+					{
+						timeout = shapedTimeout;
+						refillDue = true;
+					}
+
+					// A background queue left waiting too long goes ahead of the busier ones
+					shaped |= GetAgedQueues( count, shaped );
+				}
+
+				// Let the poll thread know when it can queue its next poll
+				m_sendMutex->Lock();
+				m_sendIdle = IsSendIdle();
+				m_sendMutex->Unlock();
+				if( m_sendIdle )
+				{
+					m_sendIdleEvent->Set();
+				}
+				else
+				{
+					m_sendIdleEvent->Reset();
+				}
+
 				// Wait for something to do
-				int32 res = Wait::Multiple( waitObjects, count, timeout );
+				int32 res = waitSet.Multiple( count, timeout, shaped << 3 );
 
 				switch( res )
 				{
 					case -1:
 					{
+						if( releaseHeld || floodDue || refillDue || stepDue || setDue )
+						{
+							// Only the held notifications or reports, a queue's airtime, a controller command's step or a value set are due.  They are seen to at the top of the loop.
+							break;
+						}
+
 						// Wait has timed out - time to resend
-						if( m_currentMsg != NULL )
+						ResumeInFlightMsg();
+						if( m_currentMsg != NULL && !m_controllerLost )
 						{
 							Notification* notification = new Notification( Notification::Type_Notification );
 							notification->SetHomeAndNodeIds( m_homeId, m_currentMsg->GetTargetNodeId() );
@@ -462,7 +1096,7 @@ void Driver::DriverThreadProc
 						}
 						if( WriteMsg( "Wait Timeout" ) )
 						{
-							retryTimeStamp.SetTime( retryTimeout );
+							retryTimeStamp.SetTime( GetRetryTimeout( retryTimeout ) );
 						}
 						break;
 					}
@@ -479,16 +1113,24 @@ void Driver::DriverThreadProc
 					}
 					case 2:
 					{
-						// Data has been received
+						// Data has been received, or the controller has come back
+						if( m_controller->TakeReconnected() )
+						{
+							HandleReconnect();
+						}
 						ReadMsg();
 						break;
 					}
 					default:
 					{
 						// All the other events are sending message queue items
+						if( m_currentMsg != NULL && ( res-3 ) < m_currentMsgQueueSource && CanDeferCurrentMsg() )
+						{
+							DeferCurrentMsg();
+						}
 						if( WriteNextMsg( (MsgQueue)(res-3) ) )
 						{
-							retryTimeStamp.SetTime( retryTimeout );
+							retryTimeStamp.SetTime( GetRetryTimeout( retryTimeout ) );
 						}
 						break;
 					}
@@ -528,6 +1170,33 @@ void Driver::DriverThreadProc
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::GetThreadId>
+// Get the operating system's id for one of the driver's threads
+//-----------------------------------------------------------------------------
+uint64 Driver::GetThreadId
+(
+		string const& _thread
+)
+{
+	if( _thread == "driver" )
+	{
+		return m_driverThread->GetId();
+	}
+	if( _thread == "poll" )
+	{
+		if( SharedPollThread* spt = SharedPollThread::Get() )
+		{
+			return spt->GetThreadId();
+		}
+		return m_pollThread->GetId();
+	}
+	if( _thread == "controller" && m_controller )
+	{
+		return m_controller->GetThreadId();
+	}
+	return 0;
+}
 
 //-----------------------------------------------------------------------------
 // <Driver::Init>
@@ -560,19 +1229,32 @@ bool Driver::Init
 	}
 
 	// Controller opened successfully, so we need to start all the worker threads
-	m_pollThread->Start( Driver::PollThreadEntryPoint, this );
+	if( SharedPollThread* spt = SharedPollThread::Get() )
+	{
+		spt->Add( this );
+	}
+	else
+	{
+		m_pollThread->Start( Driver::PollThreadEntryPoint, this );
+	}
 
 	// Send a NAK to the ZWave device
 	uint8 nak = NAK;
 	m_controller->Write( &nak, 1 );
 
-	// Get/set ZWave controller information in its preferred initialization order
-	m_controller->PlayInitSequence( this );
-
-	//If we ever want promiscuous mode uncomment this code.
-	//Msg* msg = new Msg( "FUNC_ID_ZW_SET_PROMISCUOUS_MODE", 0xff, REQUEST, FUNC_ID_ZW_SET_PROMISCUOUS_MODE, false, false );
-	//msg->Append( 0xff );
-	//SendMsg( msg );
+	// Get/set ZWave controller information in its preferred initialization order.
+	// If the controller's identity was saved, only the Home ID is needed to find it.
+	bool cachedInit = false;
+	Options::Get()->GetOptionAsBool( "CachedControllerInit", &cachedInit );
+	if( cachedInit )
+	{
+		m_initCache = InitCache_Try;
+		SendMsg( new Msg( "FUNC_ID_ZW_MEMORY_GET_ID", 0xff, REQUEST, FUNC_ID_ZW_MEMORY_GET_ID, false ), MsgQueue_Command );
+	}
+	else
+	{
+		m_controller->PlayInitSequence( this );
+	}
 
 	m_initMutex->Unlock();
 
@@ -594,35 +1276,47 @@ void Driver::RemoveQueues
 		RemoveCurrentMsg();
 	}
 
+	// Drop anything still in flight to the node
+	m_sendMutex->Lock();
+	map<uint8,InFlightMsg*>::iterator fit = m_inFlight.begin();
+	while( fit != m_inFlight.end() )
+	{
+		if( fit->second->m_msg->GetTargetNodeId() == _nodeId )
+		{
+			delete fit->second->m_msg;
+			delete fit->second;
+			m_inFlight.erase( fit++ );
+		}
+		else
+		{
+			++fit;
+		}
+	}
+	m_sendMutex->Unlock();
+
 	// Clear the send Queue
 	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
-		list<MsgQueueItem>::iterator it = m_msgQueue[i].begin();
-		while( it != m_msgQueue[i].end() )
+		list<MsgQueueItem> items;
+		m_msgQueue[i].TakeNodeItems( _nodeId, items );
+		for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
 		{
-			bool remove = false;
 			MsgQueueItem const& item = *it;
-			if( MsgQueueCmd_SendMsg == item.m_command && _nodeId == item.m_msg->GetTargetNodeId() )
+			if( MsgQueueCmd_SendMsg == item.m_command )
 			{
 				delete item.m_msg;
-				remove = true;
-			}
-			else if( MsgQueueCmd_QueryStageComplete == item.m_command && _nodeId == item.m_nodeId )
-			{
-				remove = true;
-			}
-			else if( MsgQueueCmd_Controller == item.m_command && _nodeId == item.m_cci->m_controllerCommandNode && m_currentControllerCommand != item.m_cci )
-			{
-				delete item.m_cci;
-				remove = true;
-			}
-			if( remove )
-			{
-				it = m_msgQueue[i].erase( it );
 			}
-			else
+			else if( MsgQueueCmd_Controller == item.m_command )
 			{
-				++it;
+				if( m_currentControllerCommand == item.m_cci )
+				{
+					// Keep the command being processed at the front of its queue
+					m_msgQueue[i].push_front( item );
+				}
+				else
+				{
+					delete item.m_cci;
+				}
 			}
 		}
 		if( m_msgQueue[i].empty() )
@@ -630,6 +1324,22 @@ void Driver::RemoveQueues
 			m_queueEvent[i]->Reset();
 		}
 	}
+
+	// And anything parked while it was presumed dead
+	m_sendMutex->Lock();
+	Circuit& circuit = m_circuits[_nodeId];
+	for( list< pair<MsgQueue,MsgQueueItem> >::iterator it = circuit.m_parked.begin(); it != circuit.m_parked.end(); ++it )
+	{
+		delete it->second.m_msg;
+	}
+	circuit.m_parked.clear();
+	circuit.m_open = false;
+	m_sendMutex->Unlock();
+
+	// The node is gone, so it no longer holds up the others' queries
+	EndInterview( _nodeId );
+	CancelProvision( _nodeId );
+	CancelValueSets( _nodeId );
 }
 
 //-----------------------------------------------------------------------------
@@ -637,11 +1347,16 @@ void Driver::RemoveQueues
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-// <Driver::ReadConfig>
-// Read our configuration from an XML document
+// <Driver::OpenConfig>
+// Open the saved configuration, binary or XML, returning its root element
+// once it is known to be for this controller.  Only the root element of an
+// XML file has been read when this returns.
 //-----------------------------------------------------------------------------
-bool Driver::ReadConfig
+TiXmlElement const* Driver::OpenConfig
 (
+		TiXmlDocument& o_doc,
+		XmlStreamReader& o_reader,
+		string& o_filename
 )
 {
 	char str[32];
@@ -652,21 +1367,44 @@ bool Driver::ReadConfig
 	Options::Get()->GetOptionAsString( "UserPath", &userPath );
 
 	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", m_homeId );
-	string filename =  userPath + string(str);
+	o_filename = userPath + string(str);
 
-	TiXmlDocument doc;
-	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	TiXmlElement const* driverElement = NULL;
+	bool loaded = false;
+	string handoff = GetHandoffFilename();
+	if( !handoff.empty() && OpenHandoff( o_doc, handoff ) )
 	{
-		return false;
+		o_filename = handoff;
+		driverElement = o_doc.RootElement();
+		loaded = true;
+	}
+	else if( IsBinaryConfig() )
+	{
+		// Fall back to the XML file if there is no usable binary one yet
+		snprintf( str, sizeof(str), "zwcfg_0x%08x.bin", m_homeId );
+		string binFilename = userPath + string(str);
+		if( ConfigCache::Read( binFilename, o_doc ) )
+		{
+			o_filename = binFilename;
+			driverElement = o_doc.RootElement();
+			loaded = true;
+		}
+	}
+	if( !loaded )
+	{
+		// Parse the XML a node at a time, rather than hold the whole network in memory
+		if( !o_reader.Open( o_filename ) )
+		{
+			return NULL;
+		}
+		driverElement = o_reader.GetRoot();
 	}
-
-	TiXmlElement const* driverElement = doc.RootElement();
 
 	// Version
 	if( TIXML_SUCCESS != driverElement->QueryIntAttribute( "version", &intVal ) || (uint32)intVal != c_configVersion )
 	{
-		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - %s is from an older version of OpenZWave and cannot be loaded.", filename.c_str() );
-		return false;
+		Log::Write( LogLevel_Warning, "WARNING: Driver::OpenConfig - %s is from an older version of OpenZWave and cannot be loaded.", o_filename.c_str() );
+		return NULL;
 	}
 
 	// Home ID
@@ -678,14 +1416,14 @@ bool Driver::ReadConfig
 
 		if( homeId != m_homeId )
 		{
-			Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - Home ID in file %s is incorrect", filename.c_str() );
-			return false;
+			Log::Write( LogLevel_Warning, "WARNING: Driver::OpenConfig - Home ID in file %s is incorrect", o_filename.c_str() );
+			return NULL;
 		}
 	}
 	else
 	{
-		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - Home ID is missing from file %s", filename.c_str() );
-		return false;
+		Log::Write( LogLevel_Warning, "WARNING: Driver::OpenConfig - Home ID is missing from file %s", o_filename.c_str() );
+		return NULL;
 	}
 
 	// Node ID
@@ -693,15 +1431,111 @@ bool Driver::ReadConfig
 	{
 		if( (uint8)intVal != m_Controller_nodeId )
 		{
-			Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - Controller Node ID in file %s is incorrect", filename.c_str() );
-			return false;
+			Log::Write( LogLevel_Warning, "WARNING: Driver::OpenConfig - Controller Node ID in file %s is incorrect", o_filename.c_str() );
+			return NULL;
 		}
 	}
 	else
 	{
-		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - Node ID is missing from file %s", filename.c_str() );
+		Log::Write( LogLevel_Warning, "WARNING: Driver::OpenConfig - Node ID is missing from file %s", o_filename.c_str() );
+		return NULL;
+	}
+
+	return driverElement;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::OpenHandoff>
+// Load the snapshot left by the previous process, if it is recent enough
+//-----------------------------------------------------------------------------
+bool Driver::OpenHandoff
+(
+		TiXmlDocument& o_doc,
+		string const& _filename
+)
+{
+	uint32 size;
+	uint8 const* data = FileOps::MapFile( _filename, size );
+	if( data == NULL )
+	{
+		return false;
+	}
+	bool decoded = ConfigCache::Decode( data, size, o_doc );
+	FileOps::UnmapFile( data, size );
+
+	int32 maxAge = 300;
+	Options::Get()->GetOptionAsInt( "StateHandoffMaxAge", &maxAge );
+	int written;
+	int32 age = -1;
+	if( decoded && o_doc.RootElement() && TIXML_SUCCESS == o_doc.RootElement()->QueryIntAttribute( "handoff_time", &written ) )
+	{
+		age = (int32)( (uint32)time( NULL ) - (uint32)written );
+	}
+	if( age < 0 || age > maxAge )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Ignoring the network state in %s, as it is not valid or is too old", _filename.c_str() );
+		o_doc.Clear();
+		remove( _filename.c_str() );
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, "Taking over the network state saved %d seconds ago in %s", age, _filename.c_str() );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PreloadConfigXML>
+// Parse the device files of the nodes read from the configuration, several at
+// a time, so the driver thread does not stop to read each one as the nodes are
+// interviewed
+//-----------------------------------------------------------------------------
+void Driver::PreloadConfigXML
+(
+)
+{
+	int32 numThreads = 0;
+	Options::Get()->GetOptionAsInt( "ConfigPreloadThreads", &numThreads );
+	if( numThreads <= 0 )
+	{
+		return;
+	}
+
+	list<string> configXMLs;
+	{
+		ReadLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator it = m_nodeIds.begin(); it != m_nodeIds.end(); ++it )
+		{
+			Node const* node = m_nodes[*it];
+			string configPath;
+			if( node->GetManufacturerId() != 0
+				&& ManufacturerSpecific::GetConfigPath( node->GetManufacturerId(), node->GetProductType(), node->GetProductId(), configPath ) )
+			{
+				configXMLs.push_back( configPath );
+			}
+		}
+	}
+
+	ManufacturerSpecific::PreloadConfigXML( configXMLs, (uint32)numThreads );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReadConfig>
+// Read our configuration from an XML document
+//-----------------------------------------------------------------------------
+bool Driver::ReadConfig
+(
+)
+{
+	int32 intVal;
+	TiXmlDocument doc;
+	XmlStreamReader reader;
+	string filename;
+	TiXmlElement const* driverElement = OpenConfig( doc, reader, filename );
+	if( driverElement == NULL )
+	{
 		return false;
 	}
+	bool loaded = ( doc.RootElement() != NULL );
 
 	// Capabilities
 	if( TIXML_SUCCESS == driverElement->QueryIntAttribute( "api_capabilities", &intVal ) )
@@ -727,9 +1561,34 @@ bool Driver::ReadConfig
 		m_bIntervalBetweenPolls = !strcmp( cstr, "true" );
 	}
 
+	// A heal that was still running when the configuration was last saved
+	cstr = driverElement->Attribute( "heal_nodes" );
+	if( cstr && *cstr )
+	{
+		LockGuard HLG(m_healthMutex);
+		m_healQueue.clear();
+		char* p = (char*)cstr;
+		while( *p )
+		{
+			uint32 nodeId = (uint32)strtoul( p, &p, 10 );
+			if( nodeId > 0 && nodeId < 256 )
+			{
+				m_healQueue.push_back( (uint8)nodeId );
+			}
+			if( *p != ',' )
+			{
+				break;
+			}
+			++p;
+		}
+		cstr = driverElement->Attribute( "heal_rr" );
+		m_healRR = ( cstr && !strcmp( cstr, "true" ) );
+		Log::Write( LogLevel_Info, "Resuming the network heal, with %d nodes to go", (int)m_healQueue.size() );
+	}
+
 	// Read the nodes
-	LockGuard LG(m_nodeMutex);
-	TiXmlElement const* nodeElement = driverElement->FirstChildElement();
+	WriteLockGuard LG(m_nodeMutex);
+	TiXmlElement const* nodeElement = loaded ? driverElement->FirstChildElement() : reader.ReadChild();
 	while( nodeElement )
 	{
 		char const* str = nodeElement->Value();
@@ -740,7 +1599,7 @@ bool Driver::ReadConfig
 			{
 				uint8 nodeId = (uint8)intVal;
 				Node* node = new Node( m_homeId, nodeId );
-				m_nodes[nodeId] = node;
+				SetNodeObject( nodeId, node );
 
 				Notification* notification = new Notification( Notification::Type_NodeAdded );
 				notification->SetHomeAndNodeIds( m_homeId, nodeId );
@@ -750,24 +1609,41 @@ bool Driver::ReadConfig
 				node->ReadXML( nodeElement );
 			}
 		}
+		else if( str && !strcmp( str, "LinkStatistics" ) )
+		{
+			ReadLinkStatistics( nodeElement );
+		}
+		else if( str && !strcmp( str, "Handoff" ) )
+		{
+			ReadHandoff( nodeElement );
+		}
 
-		nodeElement = nodeElement->NextSiblingElement();
+		nodeElement = loaded ? nodeElement->NextSiblingElement() : reader.ReadChild();
+	}
+
+	if( reader.HasError() )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadConfig - only the nodes before the error in %s were loaded", filename.c_str() );
 	}
 
 	LG.Unlock();
 
+	if( filename == GetHandoffFilename() )
+	{
+		// A snapshot is only good once.  From now on the configuration file
+		// is kept up to date instead.
+		remove( filename.c_str() );
+	}
+
 	// restore the previous state (for now, polling) for the nodes/values just retrieved
-	for( int i=0; i<256; i++ )
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 	{
-		if( m_nodes[i] != NULL )
+		ValueStore* vs = m_nodes[*nit]->m_values;
+		for( ValueStore::Iterator it = vs->Begin(); it != vs->End(); ++it )
 		{
-			ValueStore* vs = m_nodes[i]->m_values;
-			for( ValueStore::Iterator it = vs->Begin(); it != vs->End(); ++it )
-			{
-				Value* value = it->second;
-				if( value->m_pollIntensity != 0 )
-					EnablePoll( value->GetID(), value->m_pollIntensity );
-			}
+			Value* value = it->second;
+			if( value->m_pollIntensity != 0 )
+				EnablePoll( value->GetID(), value->m_pollIntensity );
 		}
 	}
 
@@ -775,5920 +1651,13886 @@ bool Driver::ReadConfig
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::WriteConfig>
-// Write ourselves to an XML document
+// <Driver::ReadCachedControllerInit>
+// Take the controller's identity from the saved configuration, rather than
+// ask the controller for it.  Fails if any of it was not saved.
 //-----------------------------------------------------------------------------
-void Driver::WriteConfig
+bool Driver::ReadCachedControllerInit
 (
 )
 {
-	char str[32];
-
-	if (!m_homeId) {
-		Log::Write( LogLevel_Warning, "WARNING: Tried to write driver config with no home ID set");
-		return;
-	}
-
-	// Create a new XML document to contain the driver configuration
 	TiXmlDocument doc;
-	TiXmlDeclaration* decl = new TiXmlDeclaration( "1.0", "utf-8", "" );
-	TiXmlElement* driverElement = new TiXmlElement( "Driver" );
-	doc.LinkEndChild( decl );
-	doc.LinkEndChild( driverElement );
-
-	driverElement->SetAttribute( "xmlns", "http://code.google.com/p/open-zwave/" );
-
-	snprintf( str, sizeof(str), "%d", c_configVersion );
-	driverElement->SetAttribute( "version", str );
-
-	snprintf( str, sizeof(str), "0x%.8x", m_homeId );
-	driverElement->SetAttribute( "home_id", str );
-
-	snprintf( str, sizeof(str), "%d", m_Controller_nodeId );
-	driverElement->SetAttribute( "node_id", str );
-
-	snprintf( str, sizeof(str), "%d", m_initCaps );
-	driverElement->SetAttribute( "api_capabilities", str );
-
-	snprintf( str, sizeof(str), "%d", m_controllerCaps );
-	driverElement->SetAttribute( "controller_capabilities", str );
+	XmlStreamReader reader;
+	string filename;
+	TiXmlElement const* driverElement = OpenConfig( doc, reader, filename );
+	if( driverElement == NULL )
+	{
+		return false;
+	}
 
-	snprintf( str, sizeof(str), "%d", m_pollInterval );
-	driverElement->SetAttribute( "poll_interval", str );
+	int32 libraryType, apiVersion, apiRevision, initVersion, initCaps, controllerCaps, manufacturerId, productType, productId;
+	char const* libraryVersion = driverElement->Attribute( "library_version" );
+	uint8 apiMask[sizeof(m_apiMask)];
+	uint8 nodeMask[sizeof(m_initNodeMask)];
+	if( libraryVersion == NULL
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "library_type", &libraryType )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "serial_api_version", &apiVersion )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "serial_api_revision", &apiRevision )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "init_version", &initVersion )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "api_capabilities", &initCaps )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "controller_capabilities", &controllerCaps )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "manufacturer_id", &manufacturerId )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "product_type", &productType )
+		|| TIXML_SUCCESS != driverElement->QueryIntAttribute( "product_id", &productId )
+		|| !ParseHex( driverElement->Attribute( "api_mask" ), apiMask, sizeof(apiMask) )
+		|| !ParseHex( driverElement->Attribute( "node_mask" ), nodeMask, sizeof(nodeMask) ) )
+	{
+		Log::Write( LogLevel_Info, "The controller's identity is not saved in %s", filename.c_str() );
+		return false;
+	}
 
-	snprintf( str, sizeof(str), "%s", m_bIntervalBetweenPolls ? "true" : "false" );
-	driverElement->SetAttribute( "poll_interval_between", str );
+	m_libraryVersion = libraryVersion;
+	m_libraryType = (uint8)libraryType;
+	if( m_libraryType < 9 )
+	{
+		m_libraryTypeName = c_libraryTypeNames[m_libraryType];
+	}
+	m_serialAPIVersion[0] = (uint8)apiVersion;
+	m_serialAPIVersion[1] = (uint8)apiRevision;
+	m_initVersion = (uint8)initVersion;
+	m_initCaps = (uint8)initCaps;
+	m_controllerCaps = (uint8)controllerCaps;
+	m_manufacturerId = (uint16)manufacturerId;
+	m_productType = (uint16)productType;
+	m_productId = (uint16)productId;
+	memcpy( m_apiMask, apiMask, sizeof(m_apiMask) );
+	memcpy( m_initNodeMask, nodeMask, sizeof(m_initNodeMask) );
+	Log::Write( LogLevel_Info, "Controller identity read from %s: %s library, version %s", filename.c_str(), m_libraryTypeName.c_str(), m_libraryVersion.c_str() );
+	return true;
+}
 
+//-----------------------------------------------------------------------------
+// <Driver::ReadLinkStatistics>
+// Restore the round trip times, delivery counts and link state saved by
+// WriteLinkStatistics, so the retry timeouts, heal order and circuit
+// breakers do not have to learn them again after a restart
+//-----------------------------------------------------------------------------
+void Driver::ReadLinkStatistics
+(
+		TiXmlElement const* _element
+)
+{
+	int intVal;
+	uint32 count = 0;
+	TiXmlElement const* linkElement = _element->FirstChildElement( "Link" );
+	for( ; linkElement; linkElement = linkElement->NextSiblingElement( "Link" ) )
 	{
-		LockGuard LG(m_nodeMutex);
+		if( TIXML_SUCCESS != linkElement->QueryIntAttribute( "node", &intVal ) || intVal <= 0 || intVal > 255 )
+		{
+			continue;
+		}
+		uint8 nodeId = (uint8)intVal;
+		Node* node = m_nodes[nodeId];
+		if( node == NULL )
+		{
+			continue;
+		}
 
-		for( int i=0; i<256; ++i )
+		int srtt = 0;
+		int rttVar = 0;
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "srtt", &srtt ) && srtt > 0
+			&& TIXML_SUCCESS == linkElement->QueryIntAttribute( "rttvar", &rttVar ) && rttVar >= 0 )
 		{
-			if( m_nodes[i] )
-			{
-				m_nodes[i]->WriteXML( driverElement );
-			}
+			node->m_smoothedRTT = srtt;
+			node->m_rttVariation = rttVar;
+		}
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "errors", &intVal ) && intVal >= 0 )
+		{
+			node->m_errors = (uint8)intVal;
+		}
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "sent", &intVal ) && intVal >= 0 )
+		{
+			m_nodeCounters.m_sentCnt[nodeId] = (uint32)intVal;
+		}
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "failed", &intVal ) && intVal >= 0 )
+		{
+			m_nodeCounters.m_sentFailed[nodeId] = (uint32)intVal;
+		}
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "retries", &intVal ) && intVal >= 0 )
+		{
+			m_nodeCounters.m_retries[nodeId] = (uint32)intVal;
+		}
+		if( TIXML_SUCCESS == linkElement->QueryIntAttribute( "rtt", &intVal ) && intVal >= 0 )
+		{
+			m_nodeCounters.m_averageRequestRTT[nodeId] = (uint32)intVal;
 		}
-	}
-	string userPath;
-	Options::Get()->GetOptionAsString( "UserPath", &userPath );
 
-	snprintf( str, sizeof(str), "zwcfg_0x%08x.xml", m_homeId );
-	string filename =  userPath + string(str);
+		char const* str = linkElement->Attribute( "stale_neighbors" );
+		if( str && !strcmp( str, "true" ) && nodeId <= NUM_NODE_BITFIELD_BYTES*8 )
+		{
+			LockGuard HLG(m_healthMutex);
+			SetBit( m_staleNeighbors, nodeId );
+		}
 
-	doc.SaveFile( filename.c_str() );
+		// Messages are held back from a node that was dead when the driver
+		// stopped, until it answers a probe
+		str = linkElement->Attribute( "dead" );
+		if( str && !strcmp( str, "true" ) )
+		{
+			OpenCircuit( nodeId );
+		}
+		++count;
+	}
+	Log::Write( LogLevel_Info, "Restored the link statistics of %d nodes", count );
 }
 
 //-----------------------------------------------------------------------------
-//	Controller
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Driver::GetNodeUnsafe>
-// Returns a pointer to the requested node without locking.
-// Only to be used by main thread code.
+// <Driver::GetHandoffFilename>
+// Where the snapshot handed to the next process is kept
 //-----------------------------------------------------------------------------
-Node* Driver::GetNodeUnsafe
+string Driver::GetHandoffFilename
 (
-		uint8 _nodeId
-)
+)const
 {
-	if( Node* node = m_nodes[_nodeId] )
+	string path;
+	Options::Get()->GetOptionAsString( "StateHandoffPath", &path );
+	if( path.empty() || !m_homeId )
 	{
-		return node;
+		return "";
 	}
-	return NULL;
+
+	char str[32];
+	snprintf( str, sizeof(str), "zwstate_0x%08x.bin", m_homeId );
+	return path + string(str);
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNode>
-// Locks the nodes and returns a pointer to the requested one
+// <Driver::SaveHandoff>
+// Leave a snapshot of the network for the process that takes over from this
+// one.  Called once the driver thread has stopped, so nothing more is sent.
 //-----------------------------------------------------------------------------
-Node* Driver::GetNode
+void Driver::SaveHandoff
 (
-		uint8 _nodeId
 )
 {
-	if (m_nodeMutex->IsSignalled()) {
-		Log::Write(LogLevel_Error, _nodeId, "Driver Thread is Not Locked during Call to GetNode");
-		return NULL;
-	}
-	if( Node* node = m_nodes[_nodeId] )
+	string filename = GetHandoffFilename();
+	if( filename.empty() )
 	{
-		return node;
+		return;
 	}
 
-	return NULL;
+	string xml;
+	BuildConfig( xml, true );
+	if( SaveConfig( xml, filename, true ) )
+	{
+		Log::Write( LogLevel_Info, "Saved the network state for the next process to %s", filename.c_str() );
+	}
 }
 
 //-----------------------------------------------------------------------------
-//	Sending Z-Wave messages
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Driver::SendQueryStageComplete>
-// Queue an item on the query queue that indicates a stage is complete
+// <Driver::WriteHandoff>
+// Save what the configuration file leaves out: which nodes were fully
+// queried, the application's messages not yet sent and the counters
 //-----------------------------------------------------------------------------
-void Driver::SendQueryStageComplete
+void Driver::WriteHandoff
 (
-		uint8 const _nodeId,
-		Node::QueryStage const _stage
+		XmlWriter& _writer
 )
 {
-	MsgQueueItem item;
-	item.m_command = MsgQueueCmd_QueryStageComplete;
-	item.m_nodeId = _nodeId;
-	item.m_queryStage = _stage;
-	item.m_retry = false;
+	_writer.StartElement( "Handoff" );
 
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// The messages waiting for sleeping nodes are saved with the nodes
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 	{
-		if( !node->IsListeningDevice() )
+		if( m_nodes[*nit]->m_queryStage == Node::QueryStage_Complete )
 		{
-			if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+			_writer.StartElement( "Complete" );
+			_writer.AttributeUInt( "node", *nit );
+			_writer.EndElement();
+		}
+	}
+
+	// The application's commands that were still waiting to be sent,
+	// including those held back from nodes presumed dead
+	_writer.StartElement( "Send" );
+	m_sendMutex->Lock();
+	for( int32 i=0; i<256; ++i )
+	{
+		list<MsgQueueItem> const& items = m_msgQueue[MsgQueue_Send].GetNodeItems( (uint8)i );
+		for( list<MsgQueueItem>::const_iterator it = items.begin(); it != items.end(); ++it )
+		{
+			if( MsgQueueCmd_SendMsg == it->m_command )
 			{
-				if( !wakeUp->IsAwake() )
-				{
-					// If the message is for a sleeping node, we queue it in the node itself.
-					Log::Write( LogLevel_Info, "" );
-					Log::Write( LogLevel_Detail, node->GetNodeId(), "Queuing (%s) Query Stage Complete (%s)", c_sendQueueNames[MsgQueue_WakeUp], node->GetQueryStageName( _stage ).c_str() );
-					wakeUp->QueueMsg( item );
-					return;
-				}
+				TiXmlElement msgElement( "Msg" );
+				it->m_msg->WriteXML( &msgElement );
+				_writer.Element( msgElement );
+			}
+		}
+		for( list< pair<MsgQueue,MsgQueueItem> >::const_iterator it = m_circuits[i].m_parked.begin(); it != m_circuits[i].m_parked.end(); ++it )
+		{
+			if( MsgQueue_Send == it->first && MsgQueueCmd_SendMsg == it->second.m_command )
+			{
+				TiXmlElement msgElement( "Msg" );
+				it->second.m_msg->WriteXML( &msgElement );
+				_writer.Element( msgElement );
 			}
 		}
+	}
+	m_sendMutex->Unlock();
+	_writer.EndElement();
 
-		// Non-sleeping node
-		Log::Write( LogLevel_Detail, node->GetNodeId(), "Queuing (%s) Query Stage Complete (%s)", c_sendQueueNames[MsgQueue_Query], node->GetQueryStageName( _stage ).c_str() );
-		m_sendMutex->Lock();
-		m_msgQueue[MsgQueue_Query].push_back( item );
-		m_queueEvent[MsgQueue_Query]->Set();
-		m_sendMutex->Unlock();
+	// The counters, kept as they are in memory, so only a build with the same
+	// layout restores them
+	uint64 values[DriverCounter_Count];
+	GetCounters( values );
+	string driverCounters;
+	string nodeCounters;
+	AppendHex( (uint8 const*)values, sizeof(values), driverCounters );
+	AppendHex( (uint8 const*)&m_nodeCounters, sizeof(m_nodeCounters), nodeCounters );
+	_writer.StartElement( "Counters" );
+	_writer.Attribute( "driver", driverCounters.c_str() );
+	_writer.Attribute( "nodes", nodeCounters.c_str() );
+	_writer.EndElement();
 
-	}
+	_writer.EndElement();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RetryQueryStageComplete>
-// Request the current stage will be repeated
+// <Driver::ReadHandoff>
+// Restore the state saved by WriteHandoff
 //-----------------------------------------------------------------------------
-void Driver::RetryQueryStageComplete
+void Driver::ReadHandoff
 (
-		uint8 const _nodeId,
-		Node::QueryStage const _stage
+		TiXmlElement const* _element
 )
 {
-	MsgQueueItem item;
-	item.m_command = MsgQueueCmd_QueryStageComplete;
-	item.m_nodeId = _nodeId;
-	item.m_queryStage = _stage;
+	int intVal;
+	uint32 complete = 0;
+	uint32 pending = 0;
+	for( TiXmlElement const* completeElement = _element->FirstChildElement( "Complete" ); completeElement; completeElement = completeElement->NextSiblingElement( "Complete" ) )
+	{
+		if( TIXML_SUCCESS == completeElement->QueryIntAttribute( "node", &intVal ) && intVal > 0 && intVal <= 255 && m_nodes[intVal] )
+		{
+			m_nodes[intVal]->m_handedOver = true;
+			++complete;
+		}
+	}
 
-	m_sendMutex->Lock();
+	if( TiXmlElement const* sendElement = _element->FirstChildElement( "Send" ) )
+	{
+		for( TiXmlElement const* msgElement = sendElement->FirstChildElement( "Msg" ); msgElement; msgElement = msgElement->NextSiblingElement( "Msg" ) )
+		{
+			if( Msg* msg = Msg::ReadXML( msgElement, m_homeId ) )
+			{
+				m_handoffMsgs.push_back( msg );
+				++pending;
+			}
+		}
+	}
 
-	for( list<MsgQueueItem>::iterator it = m_msgQueue[MsgQueue_Query].begin(); it != m_msgQueue[MsgQueue_Query].end(); ++it )
+	if( TiXmlElement const* countersElement = _element->FirstChildElement( "Counters" ) )
 	{
-		if( *it == item )
+		uint64 values[DriverCounter_Count];
+		if( ParseHex( countersElement->Attribute( "driver" ), (uint8*)values, sizeof(values) ) )
 		{
-			(*it).m_retry = true;
-			break;
+			for( int32 i=0; i<DriverCounter_Count; ++i )
+			{
+				AtomicAdd64( &m_counters->m_values[i], values[i] );
+			}
 		}
+		NodeCounters* nodeCounters = new NodeCounters();
+		if( ParseHex( countersElement->Attribute( "nodes" ), (uint8*)nodeCounters, sizeof(NodeCounters) ) )
+		{
+			m_nodeCounters = *nodeCounters;
+		}
+		delete nodeCounters;
 	}
-	m_sendMutex->Unlock();
+
+	Log::Write( LogLevel_Info, "Took over %d fully queried nodes and %d unsent messages from the previous process", complete, pending );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SendMsg>
-// Queue a message to be sent to the Z-Wave PC Interface
+// <Driver::WriteLinkStatistics>
+// Save what has been learnt about each node's link
 //-----------------------------------------------------------------------------
-void Driver::SendMsg
+void Driver::WriteLinkStatistics
 (
-		Msg* _msg,
-		MsgQueue const _queue
+		XmlWriter& _writer
 )
 {
-	MsgQueueItem item;
+	_writer.StartElement( "LinkStatistics" );
 
-	item.m_command = MsgQueueCmd_SendMsg;
-	item.m_msg = _msg;
-	/* make sure the HomeId is Set on this message */
-	_msg->SetHomeId(m_homeId);
-	_msg->Finalize();
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 	{
-		LockGuard LG(m_nodeMutex);
-		if( Node* node = GetNode(_msg->GetTargetNodeId()) )
+		uint8 nodeId = *nit;
+		Node* node = m_nodes[nodeId];
+		if( nodeId == m_Controller_nodeId )
 		{
-			/* if the node Supports the Security Class - check if this message is meant to be encapsulated */
-			if ( node->GetCommandClass(Security::StaticGetCommandClassId() ) )
-			{
-				CommandClass *cc = node->GetCommandClass(_msg->GetSendingCommandClass());
-				if ( (cc) && (cc->IsSecured()) )
-				{
-					Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Setting Encryption Flag on Message For Command Class %s", cc->GetCommandClassName().c_str());
-					item.m_msg->setEncrypted();
-				}
-			}
+			continue;
+		}
 
-			// If the message is for a sleeping node, we queue it in the node itself.
-			if( !node->IsListeningDevice() )
-			{
-				if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
-				{
-					if( !wakeUp->IsAwake() )
-					{
-						Log::Write( LogLevel_Detail, "" );
-						// Handle saving multi-step controller commands
-						if( m_currentControllerCommand != NULL )
-						{
-							Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[MsgQueue_Controller], c_controllerCommandNames[m_currentControllerCommand->m_controllerCommand] );
-							delete _msg;
-							item.m_command = MsgQueueCmd_Controller;
-							item.m_cci = new ControllerCommandItem( *m_currentControllerCommand );
-							item.m_msg = NULL;
-							UpdateControllerState( ControllerState_Sleeping );
-						}
-						else
-						{
-							Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[MsgQueue_WakeUp], _msg->GetAsString().c_str() );
-						}
-						wakeUp->QueueMsg( item );
-						return;
-					}
-				}
-			}
+		m_sendMutex->Lock();
+		bool dead = m_circuits[nodeId].m_open;
+		m_sendMutex->Unlock();
+		bool stale = IsNeighborInfoStale( nodeId );
+		if( !node->m_smoothedRTT && !m_nodeCounters.m_sentCnt[nodeId] && !node->m_errors && !dead && !stale )
+		{
+			// Nothing learnt yet
+			continue;
 		}
+
+		_writer.StartElement( "Link" );
+		_writer.AttributeInt( "node", nodeId );
+
+		if( node->m_smoothedRTT )
+		{
+			_writer.AttributeInt( "srtt", node->m_smoothedRTT );
+			_writer.AttributeInt( "rttvar", node->m_rttVariation );
+		}
+
+		_writer.AttributeUInt( "rtt", m_nodeCounters.m_averageRequestRTT[nodeId] );
+		_writer.AttributeUInt( "sent", m_nodeCounters.m_sentCnt[nodeId] );
+		_writer.AttributeUInt( "failed", m_nodeCounters.m_sentFailed[nodeId] );
+		_writer.AttributeUInt( "retries", m_nodeCounters.m_retries[nodeId] );
+
+		if( node->m_errors )
+		{
+			_writer.AttributeInt( "errors", node->m_errors );
+		}
+
+		if( dead )
+		{
+			_writer.Attribute( "dead", "true" );
+		}
+
+		if( stale )
+		{
+			_writer.Attribute( "stale_neighbors", "true" );
+		}
+		_writer.EndElement();
 	}
-	Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[_queue], _msg->GetAsString().c_str() );
-	m_sendMutex->Lock();
-	m_msgQueue[_queue].push_back( item );
-	m_queueEvent[_queue]->Set();
-	m_sendMutex->Unlock();
+
+	_writer.EndElement();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::WriteNextMsg>
-// Transmit a queued message to the Z-Wave controller
+// <Driver::WriteConfig>
+// Write ourselves to an XML document
 //-----------------------------------------------------------------------------
-bool Driver::WriteNextMsg
+void Driver::WriteConfig
 (
-		MsgQueue const _queue
 )
 {
+	char str[32];
 
-	// There are messages to send, so get the one at the front of the queue
-	m_sendMutex->Lock();
-	MsgQueueItem item = m_msgQueue[_queue].front();
+	if (!m_homeId) {
+		Log::Write( LogLevel_Warning, "WARNING: Tried to write driver config with no home ID set");
+		return;
+	}
 
-	if( MsgQueueCmd_SendMsg == item.m_command )
+	// The snapshot covers at least everything logged so far
+	uint64 logMark = m_valueLog ? m_valueLog->Mark() : 0;
+
+	string* xml = new string();
+	uint64 start = TimeStamp::GetTicksNs();
+	BuildConfig( *xml, false );
+	AtomicStore( &m_configBuildTime, (uint32)( ( TimeStamp::GetTicksNs() - start ) / 1000 ) );
+
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+
+	bool binary = IsBinaryConfig();
+	snprintf( str, sizeof(str), binary ? "zwcfg_0x%08x.bin" : "zwcfg_0x%08x.xml", m_homeId );
+	string filename =  userPath + string(str);
+
+	if( m_configThread )
 	{
-		// Send a message
-		m_currentMsg = item.m_msg;
-		m_currentMsgQueueSource = _queue;
-		m_msgQueue[_queue].pop_front();
-		if( m_msgQueue[_queue].empty() )
+		// Hand the snapshot to the writer thread.  If it has not yet picked
+		// up the previous one, that is now out of date and is dropped.
+		LockGuard LG(m_configMutex);
+		if( m_configPending )
 		{
-			m_queueEvent[_queue]->Reset();
+			Log::Write( LogLevel_Detail, "Driver::WriteConfig - replacing a snapshot that had not been saved yet" );
+			delete m_configPending;
 		}
-		if (m_nonceReportSent > 0) {
-			MsgQueueItem item_new;
-			item_new.m_command = MsgQueueCmd_SendMsg;
-			item_new.m_nodeId = item.m_msg->GetTargetNodeId();
-			item_new.m_retry = item.m_retry;
-			item_new.m_msg = new Msg(*item.m_msg);
-			m_msgQueue[_queue].push_front(item_new);
-			m_queueEvent[_queue]->Set();
-		}
-		m_sendMutex->Unlock();
-		return WriteMsg( "WriteNextMsg" );
+		m_configPending = xml;
+		m_configPendingFile = filename;
+		m_configPendingBinary = binary;
+		m_configPendingLogMark = logMark;
+		m_configEvent->Set();
+		return;
 	}
 
-	if( MsgQueueCmd_QueryStageComplete == item.m_command )
+	if( SaveConfig( *xml, filename, binary ) && m_valueLog )
 	{
-		// Move to the next query stage
-		m_currentMsg = NULL;
-		Node::QueryStage stage = item.m_queryStage;
-		m_msgQueue[_queue].pop_front();
-		if( m_msgQueue[_queue].empty() )
-		{
-			m_queueEvent[_queue]->Reset();
-		}
-		m_sendMutex->Unlock();
+		m_valueLog->Compact( logMark );
+	}
+	delete xml;
+}
 
-		Node* node = GetNodeUnsafe( item.m_nodeId );
-		if( node != NULL )
-		{
-			Log::Write( LogLevel_Detail, node->GetNodeId(), "Query Stage Complete (%s)", node->GetQueryStageName( stage ).c_str() );
-			if( !item.m_retry )
-			{
-				node->QueryStageComplete( stage );
-			}
-			node->AdvanceQueries();
-			return true;
-		}
+//-----------------------------------------------------------------------------
+// <Driver::BuildConfig>
+// Write the configuration as XML text, with the state to hand over to the
+// next process if _handoff is set
+//-----------------------------------------------------------------------------
+void Driver::BuildConfig
+(
+		string& o_xml,
+		bool const _handoff
+)
+{
+	char str[32];
+
+	// Write the driver configuration straight out as text.  Once built it is
+	// a snapshot that shares nothing with the nodes, so it can be saved from
+	// another thread.
+	XmlWriter writer;
+	writer.Clear( m_configLength );
+	writer.Declaration();
+	writer.StartElement( "Driver" );
+
+	writer.Attribute( "xmlns", "http://code.google.com/p/open-zwave/" );
+	writer.AttributeUInt( "version", c_configVersion );
+	writer.AttributeHex( "home_id", m_homeId, 8 );
+	writer.AttributeUInt( "node_id", m_Controller_nodeId );
+	writer.AttributeUInt( "api_capabilities", m_initCaps );
+	writer.AttributeUInt( "controller_capabilities", m_controllerCaps );
+	if( !m_libraryVersion.empty() )
+	{
+		// The controller's identity, so that CachedControllerInit need not ask for it
+		string mask;
+		writer.Attribute( "library_version", m_libraryVersion.c_str() );
+		writer.AttributeUInt( "library_type", m_libraryType );
+		writer.AttributeUInt( "serial_api_version", m_serialAPIVersion[0] );
+		writer.AttributeUInt( "serial_api_revision", m_serialAPIVersion[1] );
+		writer.AttributeUInt( "init_version", m_initVersion );
+		writer.AttributeUInt( "manufacturer_id", m_manufacturerId );
+		writer.AttributeUInt( "product_type", m_productType );
+		writer.AttributeUInt( "product_id", m_productId );
+		AppendHex( m_apiMask, sizeof(m_apiMask), mask );
+		writer.Attribute( "api_mask", mask.c_str() );
+		mask.clear();
+		AppendHex( m_initNodeMask, sizeof(m_initNodeMask), mask );
+		writer.Attribute( "node_mask", mask.c_str() );
+	}
+	writer.AttributeInt( "poll_interval", m_pollInterval );
+	writer.AttributeBool( "poll_interval_between", m_bIntervalBetweenPolls );
+	if( _handoff )
+	{
+		writer.AttributeUInt( "handoff_time", (uint32)time( NULL ) );
 	}
 
-	if( MsgQueueCmd_Controller == item.m_command )
 	{
-		// Run a multi-step controller command
-		m_currentControllerCommand = item.m_cci;
-		m_sendMutex->Unlock();
-		// Figure out if done with command
-		if ( m_currentControllerCommand->m_controllerCommandDone )
+		// The rest of a heal that is running, including the step under way
+		LockGuard HLG(m_healthMutex);
+		if( m_healNode || !m_healQueue.empty() )
 		{
-			m_sendMutex->Lock();
-			m_msgQueue[_queue].pop_front();
-			if( m_msgQueue[_queue].empty() )
+			string nodes;
+			if( m_healNode )
 			{
-				m_queueEvent[_queue]->Reset();
+				snprintf( str, sizeof(str), "%d", m_healNode );
+				nodes = str;
 			}
-			m_sendMutex->Unlock();
-			if( m_currentControllerCommand->m_controllerCallback )
+			for( list<uint8>::iterator it = m_healQueue.begin(); it != m_healQueue.end(); ++it )
 			{
-				m_currentControllerCommand->m_controllerCallback( m_currentControllerCommand->m_controllerState, m_currentControllerCommand->m_controllerReturnError, m_currentControllerCommand->m_controllerCallbackContext );
+				snprintf( str, sizeof(str), nodes.empty() ? "%d" : ",%d", *it );
+				nodes += str;
 			}
-			m_sendMutex->Lock();
-			delete m_currentControllerCommand;
-			m_currentControllerCommand = NULL;
-			m_sendMutex->Unlock();
-		}
-		else if( m_currentControllerCommand->m_controllerState == ControllerState_Normal )
-		{
-			DoControllerCommand();
+			writer.Attribute( "heal_nodes", nodes.c_str() );
+			writer.AttributeBool( "heal_rr", m_healRR );
 		}
-		else if( m_currentControllerCommand->m_controllerStateChanged )
+	}
+
+	{
+		WriteLockGuard LG(m_nodeMutex);
+
+		// Only the nodes that have changed since the last write are serialized
+		// again.  The others are copied from the text written then.
+		uint32 written = 0;
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 		{
-			if( m_currentControllerCommand->m_controllerCallback )
+			uint8 i = *nit;
+			if( TakeConfigDirty( (uint8)i ) || m_configCache[i].empty() )
 			{
-				m_currentControllerCommand->m_controllerCallback( m_currentControllerCommand->m_controllerState, m_currentControllerCommand->m_controllerReturnError, m_currentControllerCommand->m_controllerCallbackContext );
+				TiXmlElement holder( "Driver" );
+				m_nodes[i]->WriteXML( &holder );
+				m_configCache.At( i ).clear();
+				if( TiXmlElement const* nodeElement = holder.FirstChildElement() )
+				{
+					XmlWriter::Print( *nodeElement, writer.GetDepth(), m_configCache.At( i ) );
+				}
+				++written;
+			}
+			if( !m_configCache[i].empty() )
+			{
+				writer.Raw( m_configCache[i] );
 			}
-			m_currentControllerCommand->m_controllerStateChanged = false;
 		}
-		else
+		Log::Write( LogLevel_Detail, "Driver::WriteConfig - %d nodes changed since the last write", written );
+
+		// Unlike the nodes, these change with every message, so are always written afresh
+		WriteLinkStatistics( writer );
+
+		if( _handoff )
 		{
-			Log::Write( LogLevel_Info, "WriteNextMsg Controller nothing to do" );
-			m_sendMutex->Lock();
-			m_queueEvent[_queue]->Reset();
-			m_sendMutex->Unlock();
+			WriteHandoff( writer );
 		}
-		return true;
 	}
+	writer.EndElement();
 
-	return false;
+	writer.TakeText( o_xml );
+	if( !_handoff )
+	{
+		m_configLength = (uint32)o_xml.size();
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::WriteMsg>
-// Transmit the current message to the Z-Wave controller
+// <Driver::SaveConfig>
+// Write a configuration snapshot to disk.  It goes to a temporary file first,
+// which then replaces the old one, so a crash part way through cannot leave
+// a truncated configuration behind.
 //-----------------------------------------------------------------------------
-bool Driver::WriteMsg
+bool Driver::SaveConfig
 (
-		string const &msg
+		string const& _xml,
+		string const& _filename,
+		bool const _binary
 )
 {
-	if( !m_currentMsg )
+	string tmpname = _filename + ".tmp";
+	bool res = false;
+	if( _binary )
 	{
-		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "WriteMsg %s m_currentMsg=%08x", msg.c_str(), m_currentMsg );
-		// We try not to hang when this happenes
-		m_expectedCallbackId = 0;
-		m_expectedCommandClassId = 0;
-		m_expectedNodeId = 0;
-		m_expectedReply = 0;
-		m_waitingForAck = false;
-		return false;
-	}
-	/* if this is called with m_nonceReportSent > 0 it means that we have
-	 * tried to send a NONCE report and it timed out or was NAK'd
-	 *
-	 */
-	uint8 attempts;
-	uint8 nodeId;
-	if (m_nonceReportSent > 0) {
-		attempts = m_nonceReportSentAttempt++;
-		nodeId = m_nonceReportSent;
-	} else {
-		attempts = m_currentMsg->GetSendAttempts();
-		nodeId = m_currentMsg->GetTargetNodeId();
+		// The binary form is built from the element tree
+		TiXmlDocument doc;
+		doc.Parse( _xml.c_str(), 0, TIXML_ENCODING_UTF8 );
+		res = !doc.Error() && ConfigCache::Write( doc, tmpname );
 	}
-	LockGuard LG(m_nodeMutex);
-	Node* node = GetNode( nodeId );
-	if( attempts >= m_currentMsg->GetMaxSendAttempts() ||
-			(node != NULL && !node->IsNodeAlive() && !m_currentMsg->IsNoOperation() ) )
+	else if( FILE* file = fopen( tmpname.c_str(), "wb" ) )
 	{
-		if( node != NULL && !node->IsNodeAlive() )
-		{
-			Log::Write( LogLevel_Error, nodeId, "ERROR: Dropping command because node is presumed dead" );
-		}
-		else
-		{
-			// That's it - already tried to send GetMaxSendAttempt() times.
-			Log::Write( LogLevel_Error, nodeId, "ERROR: Dropping command, expected response not received after %d attempt(s)", m_currentMsg->GetMaxSendAttempts() );
-		}
-		if( m_currentControllerCommand != NULL )
-		{
-			/* its a ControllerCommand that is failed */
-			UpdateControllerState( ControllerState_Error, ControllerError_Failed);
-
-		}
+		res = ( fwrite( _xml.data(), 1, _xml.size(), file ) == _xml.size() );
+		res = ( fclose( file ) == 0 ) && res;
+	}
 
-		RemoveCurrentMsg();
-		m_dropped++;
+	if( !res || !FileOps::ReplaceFile( tmpname, _filename ) )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Failed to save the network configuration to %s", _filename.c_str() );
 		return false;
 	}
+	return true;
+}
 
-	if (( attempts != 0) && (m_nonceReportSent == 0))
+//-----------------------------------------------------------------------------
+// <Driver::OpenValueLog>
+// Apply the value changes logged since the configuration was last saved, and
+// start logging the ones to come.  Called once the configuration has been read.
+//-----------------------------------------------------------------------------
+void Driver::OpenValueLog
+(
+)
+{
+	bool enabled = false;
+	Options::Get()->GetOptionAsBool( "ValueLog", &enabled );
+	if( !enabled || m_valueLog )
 	{
-		// this is not the first attempt, so increment the callback id before sending
-		m_currentMsg->UpdateCallbackId();
+		return;
 	}
 
-	/* XXX TODO: Minor Bug - Due to the post increament of the SendAttempts, it means our final NONCE_GET will go though
-	 * but the subsequent MSG send will fail (as the counter is incremented only upon a successful NONCE_GET, and Not a Send
-	 *
-	 */
+	int32 maxSize = 262144;
+	Options::Get()->GetOptionAsInt( "ValueLogMaxSize", &maxSize );
+	m_valueLogMaxSize = ( maxSize > 0 ) ? (uint32)maxSize : 262144;
 
-	if (m_nonceReportSent == 0) {
-		if (m_currentMsg->isEncrypted() && !m_currentMsg->isNonceRecieved()) {
-			m_currentMsg->SetSendAttempts( ++attempts );
-		} else if (!m_currentMsg->isEncrypted() ) {
-			m_currentMsg->SetSendAttempts( ++attempts );
-		}
-		m_expectedCallbackId = m_currentMsg->GetCallbackId();
-		m_expectedCommandClassId = m_currentMsg->GetExpectedCommandClassId();
-		m_expectedNodeId = m_currentMsg->GetTargetNodeId();
-		m_expectedReply = m_currentMsg->GetExpectedReply();
-		m_waitingForAck = true;
-	}
-	string attemptsstr = "";
-	if( attempts > 1 )
+	char str[32];
+	snprintf( str, sizeof(str), "zwcfg_0x%08x.log", m_homeId );
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+	string filename = userPath + string(str);
+
+	ValueLog* log = new ValueLog( filename, m_homeId );
+	vector<ValueLog::Record> records;
+	if( !log->Open( &records ) )
 	{
-		char buf[15];
-		snprintf( buf, sizeof(buf), "Attempt %d, ", attempts );
-		attemptsstr = buf;
-		m_retries++;
-		if( node != NULL )
-		{
-			node->m_retries++;
-		}
+		delete log;
+		return;
 	}
 
-	Log::Write( LogLevel_Detail, "" );
+	// Only the latest change to each value matters
+	map<uint64,string> latest;
+	for( vector<ValueLog::Record>::const_iterator it = records.begin(); it != records.end(); ++it )
+	{
+		latest[it->m_id] = it->m_value;
+	}
 
-	if (m_nonceReportSent > 0) {
-		/* send a new NONCE report */
-		SendNonceKey(m_nonceReportSent, node->GenerateNonceKey());
-	} else if (m_currentMsg->isEncrypted()) {
-		if (m_currentMsg->isNonceRecieved()) {
-			Log::Write( LogLevel_Info, nodeId, "Processing (%s) Encrypted message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
-			SendEncryptedMessage();
-		} else {
-			Log::Write( LogLevel_Info, nodeId, "Processing (%s) Nonce Request message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x)", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply);
-			SendNonceRequest(m_currentMsg->GetLogText());
+	// Each value reads its element again as it was saved, but with the
+	// logged value in place of the saved one
+	uint32 applied = 0;
+	for( map<uint64,string>::const_iterator it = latest.begin(); it != latest.end(); ++it )
+	{
+		ValueID id( m_homeId, it->first );
+		NodeGuard NG( this, id.GetNodeId() );
+		if( !NG.GetNode() )
+		{
+			continue;
 		}
-	} else {
-		Log::Write( LogLevel_Info, nodeId, "Sending (%s) message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr.c_str(), m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
-		uint32 bytesWritten = m_controller->Write(m_currentMsg->GetBuffer(), m_currentMsg->GetLength());
-
-		if (bytesWritten == 0)
+		if( Value* value = GetValue( id ) )
 		{
-			//0 will be returned when the port is closed or something bad happened
-			//so send notification
-			Notification* notification = new Notification(Notification::Type_DriverFailed);
-			notification->SetHomeAndNodeIds(m_homeId, m_currentMsg->GetTargetNodeId());
-			QueueNotification(notification);
-			NotifyWatchers();
-
-			m_driverThread->Stop();
-			return false;
+			TiXmlElement element( "Value" );
+			value->WriteXML( &element );
+			element.SetAttribute( ValueLog::GetAttribute( id.GetType() ), it->second.c_str() );
+			value->ReadXML( m_homeId, id.GetNodeId(), id.GetCommandClassId(), &element );
+			value->Release();
+			++applied;
 		}
 	}
-	m_writeCnt++;
+	if( !records.empty() )
+	{
+		Log::Write( LogLevel_Info, "Applied %d changed values from %s", applied, filename.c_str() );
+	}
 
-	if( nodeId == 0xff )
+	// Values changed from now on are logged
+	m_valueLog = log;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::FlushValueLog>
+// Append the values changed since the last call to the value log
+//-----------------------------------------------------------------------------
+void Driver::FlushValueLog
+(
+)
+{
+	if( !m_valueLog )
 	{
-		m_broadcastWriteCnt++; // not accurate since library uses 0xff for the controller too
+		return;
 	}
-	else
+
+	set<ValueID> changed;
 	{
-		if( node != NULL )
+		LockGuard LG(m_notificationsMutex);
+		changed.swap( m_valueLogPending );
+	}
+	if( changed.empty() )
+	{
+		return;
+	}
+
+	// A value changed more than once since the last call is logged once,
+	// as it is now
+	vector<ValueLog::Record> records;
+	records.reserve( changed.size() );
+	for( set<ValueID>::const_iterator it = changed.begin(); it != changed.end(); ++it )
+	{
+		ValueID const& id = *it;
+		if( id.GetType() == ValueID::ValueType_Button || id.GetType() == ValueID::ValueType_Schedule )
 		{
-			node->m_sentCnt++;
-			node->m_sentTS.SetTime();
-			if( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER )
+			// A button has no state, and a schedule read again would merge
+			// the logged switch points into the ones it has
+			continue;
+		}
+
+		NodeGuard NG( this, id.GetNodeId() );
+		if( !NG.GetNode() )
+		{
+			continue;
+		}
+		if( Value* value = GetValue( id ) )
+		{
+			TiXmlElement element( "Value" );
+			value->WriteXML( &element );
+			value->Release();
+			if( char const* str = element.Attribute( ValueLog::GetAttribute( id.GetType() ) ) )
 			{
-				CommandClass *cc = node->GetCommandClass(m_expectedCommandClassId);
-				if( cc != NULL )
-				{
-					cc->SentCntIncr();
-				}
+				ValueLog::Record record;
+				record.m_id = id.GetId();
+				record.m_value = str;
+				records.push_back( record );
 			}
 		}
 	}
-	return true;
+	if( !records.empty() )
+	{
+		m_valueLog->Append( records );
+	}
+
+	if( m_valueLog->GetUnmarked() >= m_valueLogMaxSize )
+	{
+		// Saving the configuration lets the log start again
+		Log::Write( LogLevel_Detail, "The value log has grown past %d bytes, so saving the configuration", m_valueLogMaxSize );
+		WriteConfig();
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RemoveCurrentMsg>
-// Delete the current message
+// <Driver::ConfigThreadEntryPoint>
+// Entry point of the thread that saves the configuration in the background
 //-----------------------------------------------------------------------------
-void Driver::RemoveCurrentMsg
+void Driver::ConfigThreadEntryPoint
 (
+		Event* _exitEvent,
+		void* _context
 )
 {
-	Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Removing current message" );
-	if( m_currentMsg != NULL)
+	Driver* driver = (Driver*)_context;
+	if( driver )
 	{
-		delete m_currentMsg;
-		m_currentMsg = NULL;
+		driver->ConfigThreadProc( _exitEvent );
 	}
-
-	m_expectedCallbackId = 0;
-	m_expectedCommandClassId = 0;
-	m_expectedNodeId = 0;
-	m_expectedReply = 0;
-	m_waitingForAck = false;
-	m_nonceReportSent = 0;
-	m_nonceReportSentAttempt = 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::MoveMessagesToWakeUpQueue>
-// Move messages for a sleeping device to its wake-up queue
+// <Driver::ConfigThreadProc>
+// Save each snapshot handed over by WriteConfig.  A snapshot still pending
+// when the thread is told to exit is saved before it does.
 //-----------------------------------------------------------------------------
-bool Driver::MoveMessagesToWakeUpQueue
+void Driver::ConfigThreadProc
 (
-		uint8 const _targetNodeId,
-		bool const _move
+		Event* _exitEvent
 )
 {
-	// If the target node is one that goes to sleep, transfer
-	// all messages for it to its Wake-Up queue.
-	if( Node* node = GetNodeUnsafe(_targetNodeId) )
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;
+	waitObjects[1] = m_configEvent;
+
+	bool exiting = false;
+	while( !exiting )
 	{
-		if( !node->IsListeningDevice() && !node->IsFrequentListeningDevice() && _targetNodeId != m_Controller_nodeId )
+		exiting = ( Wait::Multiple( waitObjects, 2 ) == 0 );
+
+		string* xml;
+		string filename;
+		bool binary;
+		uint64 logMark;
 		{
-			if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
-			{
-				// Mark the node as asleep
-				wakeUp->SetAwake( false );
+			LockGuard LG(m_configMutex);
+			xml = m_configPending;
+			filename = m_configPendingFile;
+			binary = m_configPendingBinary;
+			logMark = m_configPendingLogMark;
+			m_configPending = NULL;
+			m_configEvent->Reset();
+		}
 
-				// If we need to save the messages
-				if( _move )
+		if( xml )
+		{
+			if( SaveConfig( *xml, filename, binary ) )
+			{
+				if( m_valueLog )
 				{
-					// Move all messages for this node to the wake-up queue
-					m_sendMutex->Lock();
-
-					// See if we are working on a controller command
-					if( m_currentControllerCommand )
-					{
-						// Don't save controller message as it will be recreated
-						RemoveCurrentMsg();
-					}
-
-					// Then try the current message first
-					if( m_currentMsg )
-					{
-						if( _targetNodeId == m_currentMsg->GetTargetNodeId() )
-						{
-							// This message is for the unresponsive node
-							// We do not move any "Wake Up No More Information"
-							// commands or NoOperations to the pending queue.
-							if( !m_currentMsg->IsWakeUpNoMoreInformationCommand() && !m_currentMsg->IsNoOperation() )
-							{
-								Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving message to Wake-Up queue: %s", m_currentMsg->GetAsString().c_str() );
-								/* reset the sendAttempts */
-								m_currentMsg->SetSendAttempts(0);
-
-								MsgQueueItem item;
-								item.m_command = MsgQueueCmd_SendMsg;
-								item.m_msg = m_currentMsg;
-								wakeUp->QueueMsg( item );
-							}
-							else
-							{
-								delete m_currentMsg;
-							}
-
-							m_currentMsg = NULL;
-							m_expectedCallbackId = 0;
-							m_expectedCommandClassId = 0;
-							m_expectedNodeId = 0;
-							m_expectedReply = 0;
-							m_waitingForAck = false;
-						}
-					}
-
-					// Now the message queues
-					for( int i=0; i<MsgQueue_Count; ++i )
-					{
-						list<MsgQueueItem>::iterator it = m_msgQueue[i].begin();
-						while( it != m_msgQueue[i].end() )
-						{
-							bool remove = false;
-							MsgQueueItem const& item = *it;
-							if( MsgQueueCmd_SendMsg == item.m_command )
-							{
-								if( _targetNodeId == item.m_msg->GetTargetNodeId() )
-								{
-									// This message is for the unresponsive node
-									// We do not move any "Wake Up No More Information"
-									// commands or NoOperations to the pending queue.
-									if( !item.m_msg->IsWakeUpNoMoreInformationCommand() && !item.m_msg->IsNoOperation() )
-									{
-										Log::Write( LogLevel_Info, item.m_msg->GetTargetNodeId(), "Node not responding - moving message to Wake-Up queue: %s", item.m_msg->GetAsString().c_str() );
-										/* reset any SendAttempts */
-										item.m_msg->SetSendAttempts(0);
-										wakeUp->QueueMsg( item );
-									}
-									else
-									{
-										delete item.m_msg;
-									}
-									remove = true;
-								}
-							}
-							if( MsgQueueCmd_QueryStageComplete == item.m_command )
-							{
-								if( _targetNodeId == item.m_nodeId )
-								{
-									Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving QueryStageComplete command to Wake-Up queue" );
-
-									wakeUp->QueueMsg( item );
-									remove = true;
-								}
-							}
-							if( MsgQueueCmd_Controller == item.m_command )
-							{
-								if( _targetNodeId == item.m_cci->m_controllerCommandNode )
-								{
-									Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving controller command to Wake-Up queue: %s", c_controllerCommandNames[item.m_cci->m_controllerCommand] );
-
-									wakeUp->QueueMsg( item );
-									remove = true;
-								}
-							}
-
-							if( remove )
-							{
-								it = m_msgQueue[i].erase( it );
-							}
-							else
-							{
-								++it;
-							}
-						}
-
-						// If the queue is now empty, we need to clear its event
-						if( m_msgQueue[i].empty() )
-						{
-							m_queueEvent[i]->Reset();
-						}
-					}
-
-					if( m_currentControllerCommand )
-					{
-						// Put command back on queue so it will be cleaned up
-						UpdateControllerState( ControllerState_Sleeping );
-						MsgQueueItem item;
-						item.m_command = MsgQueueCmd_Controller;
-						item.m_cci = new ControllerCommandItem( *m_currentControllerCommand );
-						m_currentControllerCommand = item.m_cci;
-						m_msgQueue[MsgQueue_Controller].push_back( item );
-						m_queueEvent[MsgQueue_Controller]->Set();
-					}
-
-					m_sendMutex->Unlock();
-
-					// Move completed successfully
-					return true;
+					m_valueLog->Compact( logMark );
+				}
+				if( !exiting )
+				{
+					Log::Write( LogLevel_Info, "Saved the network configuration to %s", filename.c_str() );
+					Notification* notification = new Notification( Notification::Type_ConfigSaved );
+					notification->SetHomeAndNodeIds( m_homeId, 0 );
+					QueueNotification( notification );
 				}
 			}
+			delete xml;
 		}
 	}
-
-	// Failed to move messages
-	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleErrorResponse>
-// For messages that return a ZW_SEND_DATA response, process the results here
-// If it is a non-listeing (sleeping) node return true.
+// <Driver::SetConfigDirty>
+// Mark a node as needing to be written out again
 //-----------------------------------------------------------------------------
-bool Driver::HandleErrorResponse
+void Driver::SetConfigDirty
 (
-		uint8 const _error,
-		uint8 const _nodeId,
-		char const* _funcStr,
-		bool _sleepCheck	// = 0
+		uint8 const _nodeId
 )
 {
-	// Only called with a ZW_SEND_DATA error response. We count and output the message here.
-	if( _error == TRANSMIT_COMPLETE_NOROUTE )
+	volatile uint32* word = &m_configDirty[_nodeId >> 5];
+	uint32 bit = 1u << ( _nodeId & 0x1f );
+	uint32 old = AtomicLoad( word );
+	while( !( old & bit ) && !AtomicCompareExchange( word, old, old | bit ) )
 	{
-		m_badroutes++;
-		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. No route available.", _funcStr );
+		old = AtomicLoad( word );
 	}
-	else if( _error == TRANSMIT_COMPLETE_NO_ACK )
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::TakeConfigDirty>
+// Clear a node's dirty mark.  Clearing it before the node is serialized
+// means a change made while that happens marks the node again.
+//-----------------------------------------------------------------------------
+bool Driver::TakeConfigDirty
+(
+		uint8 const _nodeId
+)
+{
+	volatile uint32* word = &m_configDirty[_nodeId >> 5];
+	uint32 bit = 1u << ( _nodeId & 0x1f );
+	uint32 old = AtomicLoad( word );
+	while( old & bit )
 	{
-		m_noack++;
-		Log::Write( LogLevel_Info, _nodeId, "WARNING: %s failed. No ACK received - device may be asleep.",  _funcStr );
-		if( m_currentMsg )
+		if( AtomicCompareExchange( word, old, old & ~bit ) )
 		{
-			// In case the failure is due to the target being a sleeping node, we
-			// first try to move its pending messages to its wake-up queue.
-			if( MoveMessagesToWakeUpQueue( m_currentMsg->GetTargetNodeId(), _sleepCheck ) )
-			{
-				return true;
-			}
-			Log::Write( LogLevel_Warning, _nodeId, "WARNING: Device is not a sleeping node." );
+			return true;
 		}
+		old = AtomicLoad( word );
 	}
-	else if( _error == TRANSMIT_COMPLETE_FAIL )
-	{
-		m_netbusy++;
-		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. Network is busy.", _funcStr );
-	}
-	else if( _error == TRANSMIT_COMPLETE_NOT_IDLE )
-	{
-		m_notidle++;
-		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. Network is busy.", _funcStr );
-	}
-	if( Node* node = GetNodeUnsafe( _nodeId ) )
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsBinaryConfig>
+// Check whether the network configuration is kept in the binary format
+//-----------------------------------------------------------------------------
+bool Driver::IsBinaryConfig
+(
+)const
+{
+	string format;
+	Options::Get()->GetOptionAsString( "ConfigFormat", &format );
+	return( format == "binary" );
+}
+
+//-----------------------------------------------------------------------------
+//	Controller
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeUnsafe>
+// Returns a pointer to the requested node without locking.
+// Only to be used by main thread code.
+//-----------------------------------------------------------------------------
+Node* Driver::GetNodeUnsafe
+(
+		uint8 _nodeId
+)
+{
+	if( Node* node = m_nodes[_nodeId] )
 	{
-		if( ++node->m_errors >= 3 )
-		{
-			node->SetNodeAlive( false );
-		}
+		return node;
 	}
-	return false;
+	return NULL;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::CheckCompletedNodeQueries>
-// Identify controller (as opposed to node) commands...especially blocking ones
+// <Driver::SetNodeObject>
+// Replace the object in a slot of the node array
 //-----------------------------------------------------------------------------
-void Driver::CheckCompletedNodeQueries
+void Driver::SetNodeObject
 (
+		uint8 const _nodeId,
+		Node* _node
 )
 {
-	Log::Write( LogLevel_Warning, "CheckCompletedNodeQueries m_allNodesQueried=%d m_awakeNodesQueried=%d", m_allNodesQueried, m_awakeNodesQueried );
-	if( !m_allNodesQueried )
+	delete m_nodes[_nodeId];
+	m_nodes.At( _nodeId ) = _node;
+
+	// The text saved for the old node no longer applies, so free it
+	if( !m_configCache[_nodeId].empty() )
 	{
-		bool all = true;
-		bool sleepingOnly = true;
-		bool deadFound = false;
+		string().swap( m_configCache.At( _nodeId ) );
+	}
 
-		{
-			LockGuard LG(m_nodeMutex);
-			for( int i=0; i<256; ++i )
-			{
-				if( m_nodes[i] )
-				{
-					if ( m_nodes[i]->GetCurrentQueryStage() != Node::QueryStage_Complete )
-					{
-						if( !m_nodes[i]->IsNodeAlive() )
-						{
-							deadFound = true;
-							continue;
-						}
-						all = false;
-						if( m_nodes[i]->IsListeningDevice() )
-						{
-							sleepingOnly = false;
-						}
-					}
-				}
-			}
-		}
+	// Nor does its neighbor list, which the new node has yet to be asked for
+	if( _nodeId > 0 && _nodeId <= NUM_NODE_BITFIELD_BYTES*8 && memcmp( m_topology[_nodeId-1], c_noNeighbors, NUM_NODE_BITFIELD_BYTES ) )
+	{
+		memset( m_topology[_nodeId-1], 0, NUM_NODE_BITFIELD_BYTES );
+		++m_topologyVersion;
+	}
 
-		Log::Write( LogLevel_Warning, "CheckCompletedNodeQueries all=%d, deadFound=%d sleepingOnly=%d", all, deadFound, sleepingOnly );
-		if( all )
-		{
-			if( deadFound )
-			{
-				// only dead nodes left to query
-				Log::Write( LogLevel_Info, "         Node query processing complete except for dead nodes." );
-				Notification* notification = new Notification( Notification::Type_AllNodesQueriedSomeDead );
-				notification->SetHomeAndNodeIds( m_homeId, 0xff );
-				QueueNotification( notification );
-			}
-			else
-			{
-				// no sleeping nodes, no dead nodes and no more nodes in the queue, so...All done
-				Log::Write( LogLevel_Info, "         Node query processing complete." );
-				Notification* notification = new Notification( Notification::Type_AllNodesQueried );
-				notification->SetHomeAndNodeIds( m_homeId, 0xff );
-				QueueNotification( notification );
-			}
-			m_awakeNodesQueried = true;
-			m_allNodesQueried = true;
-		}
-		else if( sleepingOnly )
-		{
-			if (!m_awakeNodesQueried )
-			{
-				// only sleeping nodes remain, so signal awake nodes queried complete
-				Log::Write( LogLevel_Info, "         Node query processing complete except for sleeping nodes." );
-				Notification* notification = new Notification( Notification::Type_AwakeNodesQueried );
-				notification->SetHomeAndNodeIds( m_homeId, 0xff );
-				QueueNotification( notification );
-				m_awakeNodesQueried = true;
-			}
-		}
+	vector<uint16>::iterator it = lower_bound( m_nodeIds.begin(), m_nodeIds.end(), _nodeId );
+	bool listed = ( it != m_nodeIds.end() ) && ( *it == _nodeId );
+	if( _node && !listed )
+	{
+		m_nodeIds.insert( it, _nodeId );
+	}
+	else if( !_node && listed )
+	{
+		m_nodeIds.erase( it );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsExpectedReply>
-// Determine if the reply is from the node we are expecting.
+// <Driver::GetNode>
+// Locks the nodes and returns a pointer to the requested one
 //-----------------------------------------------------------------------------
-bool Driver::IsExpectedReply
+Node* Driver::GetNode
 (
-		const uint8 _nodeId
+		uint8 _nodeId
 )
 {
-	// Accept all controller commands or where the protocol doesn't identify the actual node
-	if( m_expectedNodeId == 255 || _nodeId == 0 )
+	if (!m_nodeMutex->IsLocked()) {
+		Log::Write(LogLevel_Error, _nodeId, "Driver Thread is Not Locked during Call to GetNode");
+		return NULL;
+	}
+	if( Node* node = m_nodes[_nodeId] )
 	{
-		return true;
+		return node;
 	}
-	// Accept all messages that do not convey source node identification.
-	if( m_expectedReply == FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO ||
-			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_INFO ||
-			m_expectedReply == FUNC_ID_ZW_GET_ROUTING_INFO ||
-			m_expectedReply == FUNC_ID_ZW_ASSIGN_RETURN_ROUTE ||
-			m_expectedReply == FUNC_ID_ZW_DELETE_RETURN_ROUTE ||
-			m_expectedReply == FUNC_ID_ZW_SEND_DATA ||
-			m_expectedReply == FUNC_ID_ZW_SEND_NODE_INFORMATION ||
-			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE ||
-			m_expectedReply == FUNC_ID_ZW_ENABLE_SUC ||
-			m_expectedReply == FUNC_ID_ZW_SET_SUC_NODE_ID ||
-			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS )
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeGuard::NodeGuard>
+// Take the read lock on the node array, then the node's own mutex
+//-----------------------------------------------------------------------------
+Driver::NodeGuard::NodeGuard
+(
+		Driver* _driver,
+		uint8 const _nodeId
+):
+	m_driver( _driver ),
+	m_node( NULL )
+{
+	m_driver->m_nodeMutex->LockShared();
+	m_node = m_driver->m_nodes[_nodeId];
+	if( m_node )
 	{
-		return true;
+		m_node->m_mutex->Lock();
 	}
-	// Accept if source message contains node info and it is from the one we are expecting
-	if( m_expectedNodeId == _nodeId )
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeGuard::~NodeGuard>
+// Release the locks in the reverse order
+//-----------------------------------------------------------------------------
+Driver::NodeGuard::~NodeGuard
+(
+)
+{
+	if( m_node )
 	{
-		return true;
+		m_node->m_mutex->Unlock();
 	}
-	Log::Write( LogLevel_Detail, "IsExpectedReply: m_expectedNodeId = %d m_expectedReply = %02x", m_expectedNodeId, m_expectedReply );
-	return false;
+	m_driver->m_nodeMutex->UnlockShared();
 }
+
 //-----------------------------------------------------------------------------
-//	Receiving Z-Wave messages
+//	Sending Z-Wave messages
 //-----------------------------------------------------------------------------
 
 //-----------------------------------------------------------------------------
-// <Driver::ReadMsg>
-// Read data from the serial port
+// <Driver::NodeMsgQueue::NodeMsgQueue>
+// Constructor
 //-----------------------------------------------------------------------------
-bool Driver::ReadMsg
+Driver::NodeMsgQueue::NodeMsgQueue
+(
+):
+m_size( 0 )
+{
+	memset( m_isActive, 0, sizeof(m_isActive) );
+	memset( m_priority, 0, sizeof(m_priority) );
+	memset( m_deficit, 0, sizeof(m_deficit) );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::GetItemNodeId>
+// Identify the node that a queued item belongs to
+//-----------------------------------------------------------------------------
+uint8 Driver::NodeMsgQueue::GetItemNodeId
 (
+		MsgQueueItem const& _item
 )
 {
-	uint8 buffer[1024] = {0};
+	switch( _item.m_command )
+	{
+		case MsgQueueCmd_SendMsg:
+		{
+			return _item.m_msg->GetTargetNodeId();
+		}
+		case MsgQueueCmd_Controller:
+		{
+			return _item.m_cci->m_controllerCommandNode;
+		}
+		default:
+		{
+			return _item.m_nodeId;
+		}
+	}
+}
 
-	if( !m_controller->Read( buffer, 1 ) )
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::GetItemCost>
+// Amount of a node's turn that sending an item uses up
+//-----------------------------------------------------------------------------
+uint32 Driver::NodeMsgQueue::GetItemCost
+(
+		MsgQueueItem const& _item
+)
+{
+	// Only real frames use the radio.  Everything else is handled immediately.
+	if( MsgQueueCmd_SendMsg == _item.m_command )
 	{
-		// Nothing to read
-		return false;
+		return _item.m_msg->GetLength();
 	}
+	return 0;
+}
 
-	switch( buffer[0] )
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::push_back>
+// Add an item to the end of its node's queue
+//-----------------------------------------------------------------------------
+bool Driver::NodeMsgQueue::push_back
+(
+		MsgQueueItem const& _item
+)
+{
+	uint8 nodeId = GetItemNodeId( _item );
+	uint64 key = ( MsgQueueCmd_SendMsg == _item.m_command ) ? _item.m_msg->GetCoalesceKey() : 0;
+	if( key )
 	{
-		case SOF:
+		map<uint64,list<MsgQueueItem>::iterator>::iterator it = m_coalesce.find( key );
+		if( it != m_coalesce.end() )
 		{
-			m_SOFCnt++;
-			if( m_waitingForAck )
+			MsgQueueItem& queued = *it->second;
+			if( _item.m_msg->IsSupersedable() && queued.m_msg->IsSupersedable() && ( queued.m_msg->GetTargetNodeId() == nodeId ) )
 			{
-				// This can happen on any normal network when a transmission overlaps an unexpected
-				// reception and the data in the buffer doesn't contain the ACK. The controller will
-				// notice and send us a CAN to retransmit.
-				Log::Write( LogLevel_Detail, "Unsolicited message received while waiting for ACK." );
-				m_ACKWaiting++;
+				// The newer Set goes in the older one's place
+				OZW_LOG( LogLevel_Detail, nodeId, "Replacing the queued %s with a newer one", queued.m_msg->GetLogText().c_str() );
+				delete queued.m_msg;
+				queued.m_msg = _item.m_msg;
+				return false;
 			}
-
-			// Read the length byte.  Keep trying until we get it.
-			m_controller->SetSignalThreshold( 1 );
-			int32 response = Wait::Single( m_controller, 50 );
-			if( response < 0 )
+			if( !_item.m_msg->IsSupersedable() && ( *queued.m_msg == *_item.m_msg ) )
 			{
-				Log::Write( LogLevel_Warning, "WARNING: 50ms passed without finding the length byte...aborting frame read");
-				m_readAborts++;
-				break;
+				// The queued request will fetch the same report
+				OZW_LOG( LogLevel_Detail, nodeId, "Merging %s with the same request already queued", _item.m_msg->GetLogText().c_str() );
+				delete _item.m_msg;
+				return false;
 			}
+		}
+	}
 
-			m_controller->Read( &buffer[1], 1 );
-			m_controller->SetSignalThreshold( buffer[1] );
-			if( Wait::Single( m_controller, 500 ) < 0 )
-			{
-				Log::Write( LogLevel_Warning, "WARNING: 500ms passed without reading the rest of the frame...aborting frame read" );
-				m_readAborts++;
-				m_controller->SetSignalThreshold( 1 );
-				break;
-			}
+	m_nodeQueue[nodeId].push_back( _item );
+	m_nodeQueue[nodeId].back().m_queued = (uint32)-m_epoch.TimeRemaining();
+	if( key )
+	{
+		m_coalesce[key] = --m_nodeQueue[nodeId].end();
+	}
+	++m_size;
+	Activate( nodeId );
+	Schedule();
+	return true;
+}
 
-			m_controller->Read( &buffer[2], buffer[1] );
-			m_controller->SetSignalThreshold( 1 );
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::Unindex>
+// Forget an item that is leaving its node's queue
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::Unindex
+(
+		list<MsgQueueItem>::iterator const& _it
+)
+{
+	if( MsgQueueCmd_SendMsg != _it->m_command || 0 == _it->m_msg->GetCoalesceKey() )
+	{
+		return;
+	}
 
-			uint32 length = buffer[1] + 2;
+	// Only if the index points at this item, rather than a copy pushed back on the front
+	map<uint64,list<MsgQueueItem>::iterator>::iterator it = m_coalesce.find( _it->m_msg->GetCoalesceKey() );
+	if( it != m_coalesce.end() && it->second == _it )
+	{
+		m_coalesce.erase( it );
+	}
+}
 
-			// Log the data
-			string str = "";
-			for( uint32 i=0; i<length; ++i )
-			{
-				if( i )
-				{
-					str += ", ";
-				}
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::push_front>
+// Put an item back at the head of its node's queue, to be sent next
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::push_front
+(
+		MsgQueueItem const& _item
+)
+{
+	uint8 nodeId = GetItemNodeId( _item );
+	m_nodeQueue[nodeId].push_front( _item );
+	m_nodeQueue[nodeId].front().m_queued = (uint32)-m_epoch.TimeRemaining();
+	++m_size;
+	Activate( nodeId );
 
-				char byteStr[8];
-				snprintf( byteStr, sizeof(byteStr), "0x%.2x", buffer[i] );
-				str += byteStr;
-			}
-			uint8 nodeId = NodeFromMessage( buffer );
-			if( nodeId == 0 )
-			{
-				nodeId = GetNodeNumber( m_currentMsg );
-			}
-			Log::Write( LogLevel_Detail, nodeId, "  Received: %s", str.c_str() );
+	// Move the node to the front so that this item is what front() returns
+	m_active.splice( m_active.begin(), m_active, m_activePos[nodeId] );
+	uint32 cost = GetItemCost( _item );
+	if( m_deficit[nodeId] < cost )
+	{
+		m_deficit[nodeId] = cost;
+	}
+}
 
-			// Verify checksum
-			uint8 checksum = 0xff;
-			for( uint32 i=1; i<(length-1); ++i )
-			{
-				checksum ^= buffer[i];
-			}
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::pop_front>
+// Remove the item returned by front() and pick the next one
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::pop_front
+(
+)
+{
+	uint8 nodeId = m_active.front();
+	list<MsgQueueItem>& nodeQueue = m_nodeQueue[nodeId];
 
-			if( buffer[length-1] == checksum )
-			{
-				// Checksum correct - send ACK
-				uint8 ack = ACK;
-				m_controller->Write( &ack, 1 );
-				m_readCnt++;
+	uint32 cost = GetItemCost( nodeQueue.front() );
+	m_deficit[nodeId] = ( m_deficit[nodeId] > cost ) ? ( m_deficit[nodeId] - cost ) : 0;
+	Unindex( nodeQueue.begin() );
+	nodeQueue.pop_front();
+	--m_size;
 
-				// Process the received message
-				ProcessMsg( &buffer[2] );
-			}
-			else
-			{
-				Log::Write( LogLevel_Warning, nodeId, "WARNING: Checksum incorrect - sending NAK" );
-				m_badChecksum++;
-				uint8 nak = NAK;
-				m_controller->Write( &nak, 1 );
-				m_controller->Purge();
-			}
-			break;
-		}
+	if( nodeQueue.empty() )
+	{
+		Deactivate( nodeId );
+	}
+	else if( m_deficit[nodeId] < GetItemCost( nodeQueue.front() ) )
+	{
+		// This node has used up its turn
+		NextTurn();
+	}
+	Schedule();
+}
 
-		case CAN:
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::TakeNodeItems>
+// Remove all the items queued for a node
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::TakeNodeItems
+(
+		uint8 const _nodeId,
+		list<MsgQueueItem>& _items
+)
+{
+	list<MsgQueueItem>& nodeQueue = m_nodeQueue[_nodeId];
+	if( nodeQueue.empty() )
+	{
+		return;
+	}
+
+	for( list<MsgQueueItem>::iterator it = nodeQueue.begin(); it != nodeQueue.end(); ++it )
+	{
+		Unindex( it );
+	}
+	m_size -= nodeQueue.size();
+	_items.splice( _items.end(), nodeQueue );
+	Deactivate( _nodeId );
+	Schedule();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::SetNodePriority>
+// Set a node's priority
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::SetNodePriority
+(
+		uint8 const _nodeId,
+		uint8 const _priority
+)
+{
+	if( m_priority[_nodeId] == _priority )
+	{
+		return;
+	}
+
+	m_priority[_nodeId] = _priority;
+	if( m_isActive[_nodeId] && ( m_active.front() != _nodeId ) )
+	{
+		// The node at the front keeps its turn, and moves when the turn ends
+		m_active.erase( m_activePos[_nodeId] );
+		m_activePos[_nodeId] = m_active.insert( Place( _nodeId, AfterFront() ), _nodeId );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::Place>
+// Where a node joins the round-robin: after the other nodes of its priority,
+// but not before _first
+//-----------------------------------------------------------------------------
+list<uint8>::iterator Driver::NodeMsgQueue::Place
+(
+		uint8 const _nodeId,
+		list<uint8>::iterator const _first
+)
+{
+	list<uint8>::iterator it = m_active.end();
+	while( it != _first )
+	{
+		list<uint8>::iterator prev = it;
+		--prev;
+		if( m_priority[*prev] <= m_priority[_nodeId] )
 		{
-			// This is the other side of an unsolicited ACK. As mentioned there if we receive a message
-			// just after we transmitted one, the controller will notice and tell us to retransmit here.
-			// Don't increment the transmission counter as it is possible the message will never get out
-			// on very busy networks with lots of unsolicited messages being received. Increase the amount
-			// of retries but only up to a limit so we don't stay here forever.
-			Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "CAN received...triggering resend" );
-			m_CANCnt++;
-			if( m_currentMsg != NULL )
-			{
-				m_currentMsg->SetMaxSendAttempts( m_currentMsg->GetMaxSendAttempts() + 1 );
-			}
-			else
-			{
-				Log::Write( LogLevel_Warning, "m_currentMsg was NULL when trying to set MaxSendAttempts" );
-				Log::QueueDump();
-			}
-			WriteMsg( "CAN" );
 			break;
 		}
+		it = prev;
+	}
+	return it;
+}
 
-		case NAK:
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::AfterFront>
+// The node at the front has the current turn, and may have been given it out
+// of priority order by push_front.  The nodes after it are in priority order.
+//-----------------------------------------------------------------------------
+list<uint8>::iterator Driver::NodeMsgQueue::AfterFront
+(
+)
+{
+	list<uint8>::iterator it = m_active.begin();
+	if( it != m_active.end() )
+	{
+		++it;
+	}
+	return it;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::Activate>
+// Add a node to the round-robin if it is not already there
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::Activate
+(
+		uint8 const _nodeId
+)
+{
+	if( !m_isActive[_nodeId] )
+	{
+		// A node arriving at an empty queue starts its turn straight away
+		m_isActive[_nodeId] = true;
+		m_deficit[_nodeId] = m_active.empty() ? c_msgQueueQuantum : 0;
+		m_activePos[_nodeId] = m_active.insert( Place( _nodeId, AfterFront() ), _nodeId );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::Deactivate>
+// Remove a node with no more items from the round-robin
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::Deactivate
+(
+		uint8 const _nodeId
+)
+{
+	if( m_isActive[_nodeId] )
+	{
+		bool wasFront = ( m_active.front() == _nodeId );
+		m_isActive[_nodeId] = false;
+		m_deficit[_nodeId] = 0;
+		m_active.erase( m_activePos[_nodeId] );
+		if( wasFront && !m_active.empty() )
+		{
+			// The next node starts its turn
+			m_deficit[m_active.front()] += c_msgQueueQuantum;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::NextTurn>
+// Hand the turn to the next node in the round-robin
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::NextTurn
+(
+)
+{
+	// The node goes behind the others of its priority, so a more urgent node
+	// keeps taking turns until it has nothing left to send
+	uint8 nodeId = m_active.front();
+	m_active.erase( m_active.begin() );
+	m_activePos[nodeId] = m_active.insert( Place( nodeId, m_active.begin() ), nodeId );
+	m_deficit[m_active.front()] += c_msgQueueQuantum;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NodeMsgQueue::Schedule>
+// Make sure the node at the front can afford to send its next item
+//-----------------------------------------------------------------------------
+void Driver::NodeMsgQueue::Schedule
+(
+)
+{
+	// A node whose next frame is larger than its deficit keeps the deficit
+	// and waits for another round.  Every round adds a quantum, so this ends.
+	while( !m_active.empty() )
+	{
+		uint8 nodeId = m_active.front();
+		if( m_deficit[nodeId] >= GetItemCost( m_nodeQueue[nodeId].front() ) )
 		{
-			Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: NAK received...triggering resend" );
-			m_NAKCnt++;
-			WriteMsg( "NAK" );
 			break;
 		}
+		NextTurn();
+	}
+}
 
-		case ACK:
+//-----------------------------------------------------------------------------
+// <Driver::SendQueryStageComplete>
+// Queue an item on the query queue that indicates a stage is complete
+//-----------------------------------------------------------------------------
+void Driver::SendQueryStageComplete
+(
+		uint8 const _nodeId,
+		Node::QueryStage const _stage
+)
+{
+	MsgQueueItem item;
+	item.m_command = MsgQueueCmd_QueryStageComplete;
+	item.m_nodeId = _nodeId;
+	item.m_queryStage = _stage;
+	item.m_retry = false;
+
+	WriteLockGuard LG(m_nodeMutex);
+	if( Node* node = GetNode( _nodeId ) )
+	{
+		if( !node->IsListeningDevice() )
 		{
-			m_ACKCnt++;
-			m_waitingForAck = false;
-			if( m_currentMsg == NULL )
-			{
-				Log::Write( LogLevel_StreamDetail, 255, "  ACK received" );
-			}
-			else
+			if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
 			{
-				Log::Write( LogLevel_StreamDetail, GetNodeNumber( m_currentMsg ), "  ACK received CallbackId 0x%.2x Reply 0x%.2x", m_expectedCallbackId, m_expectedReply );
-				if( ( 0 == m_expectedCallbackId ) && ( 0 == m_expectedReply ) )
+				if( !wakeUp->IsAwake() )
 				{
-					// Remove the message from the queue, now that it has been acknowledged.
-					RemoveCurrentMsg();
+					// If the message is for a sleeping node, we queue it in the node itself.
+					Log::Write( LogLevel_Info, "" );
+					Log::Write( LogLevel_Detail, node->GetNodeId(), "Queuing (%s) Query Stage Complete (%s)", c_sendQueueNames[MsgQueue_WakeUp], node->GetQueryStageName( _stage ).c_str() );
+					wakeUp->QueueMsg( item );
+					PauseInterview( _nodeId );
+					return;
 				}
 			}
-			break;
 		}
 
-		default:
+		// Non-sleeping node
+		Log::Write( LogLevel_Detail, node->GetNodeId(), "Queuing (%s) Query Stage Complete (%s)", c_sendQueueNames[MsgQueue_Query], node->GetQueryStageName( _stage ).c_str() );
+		m_sendMutex->Lock();
+		m_msgQueue[MsgQueue_Query].SetNodePriority( _nodeId, (uint8)node->GetQueryPriority() );
+		m_msgQueue[MsgQueue_Query].push_back( item );
+		m_queueEvent[MsgQueue_Query]->Set();
+		m_sendMutex->Unlock();
+
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RetryQueryStageComplete>
+// Request the current stage will be repeated
+//-----------------------------------------------------------------------------
+void Driver::RetryQueryStageComplete
+(
+		uint8 const _nodeId,
+		Node::QueryStage const _stage
+)
+{
+	MsgQueueItem item;
+	item.m_command = MsgQueueCmd_QueryStageComplete;
+	item.m_nodeId = _nodeId;
+	item.m_queryStage = _stage;
+
+	m_sendMutex->Lock();
+
+	list<MsgQueueItem>& items = m_msgQueue[MsgQueue_Query].GetNodeItems( _nodeId );
+	for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
+	{
+		if( *it == item )
 		{
-			Log::Write( LogLevel_Warning, "WARNING: Out of frame flow! (0x%.2x).  Sending NAK.", buffer[0] );
-			m_OOFCnt++;
-			uint8 nak = NAK;
-			m_controller->Write( &nak, 1 );
-			m_controller->Purge();
+			(*it).m_retry = true;
 			break;
 		}
 	}
-
-	return true;
+	m_sendMutex->Unlock();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::ProcessMsg>
-// Process data received from the Z-Wave PC interface
+// <Driver::OpenCircuit>
+// A node is presumed dead.  With the CircuitBreaker option, its messages are
+// parked until it answers a probe.
 //-----------------------------------------------------------------------------
-void Driver::ProcessMsg
+void Driver::OpenCircuit
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	bool handleCallback = true;
-	bool wasencrypted = false;
-	//uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( !IsProbingDeadNodes() )
+	{
+		return;
+	}
 
-	if ((REQUEST == _data[0]) &&
-			(Security::StaticGetCommandClassId() == _data[5])) {
-		/* if this message is a NONCE Report - Then just Trigger the Encrypted Send */
-		if (SecurityCmd_NonceReport == _data[6]) {
-			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceReport from node %d", _data[3] );
+	m_sendMutex->Lock();
+	Circuit& circuit = m_circuits[_nodeId];
+	circuit.m_open = true;
+	circuit.m_probeInterval = c_firstProbeInterval;
+	circuit.m_nextProbe.SetTime( circuit.m_probeInterval );
+	if( !m_circuitBreaker )
+	{
+		// Only probed, with the LivenessInterval option
+		m_sendMutex->Unlock();
+		m_pollEvent->Set();
+		return;
+	}
 
-			/* handle possible resends of NONCE_REPORT messages.... See Issue #931 */
-			if (!m_currentMsg) {
-				Log::Write(LogLevel_Warning, _data[3], "Received a NonceReport from node, but no pending messages. Dropping..");
-				return;
+	// Park the messages already queued for the node.  Probes, query stage
+	// markers and controller commands stay where they are.
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		list<MsgQueueItem> items;
+		m_msgQueue[i].TakeNodeItems( _nodeId, items );
+		for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
+		{
+			MsgQueueItem const& item = *it;
+			if( MsgQueueCmd_SendMsg == item.m_command && !item.m_msg->IsNoOperation() && ParkMsg( item, (MsgQueue)i ) )
+			{
+				continue;
 			}
-
-			// No Need to triger a WriteMsg here - It should be handled automatically
-			m_currentMsg->setNonce(&_data[7]);
-			this->SendEncryptedMessage();
-			return;
-
-			/* if this is a NONCE Get - Then call to the CC directly, process it, and then bail out. */
-		} else if (SecurityCmd_NonceGet == _data[6]) {
-			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceGet from node %d", _data[3] );
+			if( MsgQueueCmd_Controller == item.m_command && m_currentControllerCommand == item.m_cci )
 			{
-				uint8 *nonce = NULL;
-				LockGuard LG(m_nodeMutex);
-				Node* node = GetNode( _data[3] );
-				if( node ) {
-					nonce = node->GenerateNonceKey();
-				} else {
-					Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
-					return;
-				}
-
-				SendNonceKey(_data[3], nonce);
-
+				m_msgQueue[i].push_front( item );
 			}
-			/* don't continue processing */
-			return;
-
-			/* if this message is encrypted, decrypt it first */
-		} else if ((SecurityCmd_MessageEncap == _data[6]) || (SecurityCmd_MessageEncapNonceGet == _data[6])) {
-			uint8 _newdata[256];
-			uint8 SecurityCmd = _data[6];
-			uint8 *_nonce;
+			else
+			{
+				m_msgQueue[i].push_back( item );
+			}
+		}
+		if( m_msgQueue[i].empty() )
+		{
+			m_queueEvent[i]->Reset();
+		}
+	}
+	Log::Write( LogLevel_Info, _nodeId, "Holding %d messages until the node answers a probe", (int)circuit.m_parked.size() );
+	m_sendMutex->Unlock();
 
-			/* clear out NONCE Report tracking */
-			m_nonceReportSent = 0;
-			m_nonceReportSentAttempt = 0;
+	// The poll thread sends the probes
+	m_pollEvent->Set();
+}
 
-			/* make sure the Node Exists, and it has the Security CC */
-			{
-				LockGuard LG(m_nodeMutex);
-				Node* node = GetNode( _data[3] );
-				if( node ) {
-					_nonce = node->GetNonceKey(_data[_data[4]-4]);
-					if (!_nonce) {
-						Log::Write(LogLevel_Warning, _data[3], "Could Not Retrieve Nonce for Node %d", _data[3]);
-						return;
-					}
-				} else {
-					Log::Write(LogLevel_Warning, _data[3], "Can't Find Node %d for Encrypted Message", _data[3]);
-					return;
-				}
-			}
-			if (DecryptBuffer(&_data[5], _data[4]+1, this, _data[3], this->GetControllerNodeId(), _nonce, &_newdata[0])) {
-				/* Ok - _newdata now contains the decrypted packet */
-				/* copy it back to the _data packet for processing */
-				/* New Length - See Decrypt Packet for why these numbers*/
-				_data[4] = _data[4] - 8 - 8 - 2 - 2;
-
-				/* now copy the decrypted packet */
-				memcpy(&_data[5], &_newdata[1], _data[4]);
-				//PrintHex("Decrypted Packet", _data, _data[4]+5);
-
-				/* if the Node has something else to send, it will encrypt a message and send it as a MessageEncapNonceGet */
-				if (SecurityCmd_MessageEncapNonceGet == SecurityCmd )
-				{
-				    Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_MessageEncapNonceGet from node %d - Sending New Nonce", _data[3] );
-				    LockGuard LG(m_nodeMutex);
-				    Node* node = GetNode( _data[3] );
-				    if( node ) {
-				        _nonce = node->GenerateNonceKey();
-				    } else {
-				        Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
-				        return;
-				    }
-				    SendNonceKey(_data[3], _nonce);
-				}
+//-----------------------------------------------------------------------------
+// <Driver::CloseCircuit>
+// A node presumed dead has answered, so send the messages parked for it
+//-----------------------------------------------------------------------------
+void Driver::CloseCircuit
+(
+		uint8 const _nodeId
+)
+{
+	m_sendMutex->Lock();
+	Circuit& circuit = m_circuits[_nodeId];
+	if( circuit.m_open )
+	{
+		circuit.m_open = false;
+		Log::Write( LogLevel_Info, _nodeId, "Node is back, sending the %d messages held for it", (int)circuit.m_parked.size() );
+		for( list< pair<MsgQueue,MsgQueueItem> >::iterator it = circuit.m_parked.begin(); it != circuit.m_parked.end(); ++it )
+		{
+			m_msgQueue[it->first].push_back( it->second );
+			m_queueEvent[it->first]->Set();
+		}
+		circuit.m_parked.clear();
+	}
+	m_sendMutex->Unlock();
+}
 
-				wasencrypted = true;
+//-----------------------------------------------------------------------------
+// <Driver::ParkMsg>
+// Park a message if its node's circuit is open
+//-----------------------------------------------------------------------------
+bool Driver::ParkMsg
+(
+		MsgQueueItem const& _item,
+		MsgQueue const _queue
+)
+{
+	Circuit& circuit = m_circuits[_item.m_msg->GetTargetNodeId()];
+	if( !circuit.m_open || !m_circuitBreaker )
+	{
+		return false;
+	}
 
-			} else {
-			    /* if the Node has something else to send, it will encrypt a message and send it as a MessageEncapNonceGet */
-			    if (SecurityCmd_MessageEncapNonceGet == SecurityCmd )
-			    {
-			        Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_MessageEncapNonceGet from node %d - Sending New Nonce", _data[3] );
-			        LockGuard LG(m_nodeMutex);
-			        Node* node = GetNode( _data[3] );
-			        if( node ) {
-			            _nonce = node->GenerateNonceKey();
-			        } else {
-			            Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
-			            return;
-			        }
-			        SendNonceKey(_data[3], _nonce);
-			    }
-				/* it failed for some reason, lets just move on */
-				m_expectedReply = 0;
-				m_expectedNodeId = 0;
-				RemoveCurrentMsg();
-				return;
-			}
+	// As with the wake up queue, an older copy of the same message is
+	// replaced, so that repeated polls and commands do not build up
+	for( list< pair<MsgQueue,MsgQueueItem> >::iterator it = circuit.m_parked.begin(); it != circuit.m_parked.end(); ++it )
+	{
+		if( it->second == _item )
+		{
+			delete it->second.m_msg;
+			circuit.m_parked.erase( it );
+			break;
 		}
 	}
+	if( circuit.m_parked.size() >= c_maxParkedMsgs )
+	{
+		delete circuit.m_parked.front().second.m_msg;
+		circuit.m_parked.pop_front();
+		Count( DriverCounter_Dropped );
+	}
+	circuit.m_parked.push_back( pair<MsgQueue,MsgQueueItem>( _queue, _item ) );
+	return true;
+}
 
+//-----------------------------------------------------------------------------
+// <Driver::ProbeDeadNodes>
+// Send a NoOperation to each node presumed dead that is due a probe
+//-----------------------------------------------------------------------------
+int32 Driver::ProbeDeadNodes
+(
+)
+{
+	int32 next = Wait::Timeout_Infinite;
+	if( !IsProbingDeadNodes() )
+	{
+		return next;
+	}
 
-	if( RESPONSE == _data[0] )
+	WriteLockGuard LG(m_nodeMutex);
+	for( int i=0; i<256; ++i )
 	{
-		switch( _data[1] )
+		m_sendMutex->Lock();
+		Circuit& circuit = m_circuits[i];
+		bool due = false;
+		if( circuit.m_open )
 		{
-			case FUNC_ID_SERIAL_API_GET_INIT_DATA:
+			int32 remaining = circuit.m_nextProbe.TimeRemaining();
+			if( remaining <= 0 )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSerialAPIGetInitDataResponse( _data );
-				break;
+				due = true;
+				circuit.m_probeInterval = ( circuit.m_probeInterval < c_maxProbeInterval / 2 ) ? ( circuit.m_probeInterval << 1 ) : c_maxProbeInterval;
+				circuit.m_nextProbe.SetTime( circuit.m_probeInterval );
+				remaining = circuit.m_probeInterval;
 			}
-			case FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:
+			if( next == Wait::Timeout_Infinite || remaining < next )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetControllerCapabilitiesResponse( _data );
-				break;
+				next = remaining;
 			}
-			case FUNC_ID_SERIAL_API_GET_CAPABILITIES:
+		}
+		m_sendMutex->Unlock();
+
+		if( due )
+		{
+			Node* node = GetNode( (uint8)i );
+			if( node && !node->IsNodeAlive() )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetSerialAPICapabilitiesResponse( _data );
-				break;
+				if( NoOperation* noop = static_cast<NoOperation*>( node->GetCommandClass( NoOperation::StaticGetCommandClassId() ) ) )
+				{
+					Log::Write( LogLevel_Info, (uint8)i, "Probing node presumed dead" );
+					noop->Set( true );
+				}
 			}
-			case FUNC_ID_SERIAL_API_SOFT_RESET:
+		}
+	}
+	return next;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NoteHeard>
+// A frame came from a node, or it acknowledged one, so it is alive
+//-----------------------------------------------------------------------------
+void Driver::NoteHeard
+(
+		uint8 const _nodeId
+)
+{
+	if( !m_livenessInterval )
+	{
+		return;
+	}
+
+	Liveness& liveness = m_liveness[_nodeId];
+	uint32 now = (uint32)-m_startTime.TimeRemaining() + 1;
+	uint32 last = liveness.m_lastHeard;
+	if( last && now - last >= c_minLivenessGap )
+	{
+		// Smooth the gaps, an eighth of each new one at a time
+		uint32 gap = now - last;
+		uint32 mean = liveness.m_meanGap;
+		liveness.m_meanGap = mean ? mean - ( mean >> 3 ) + ( gap >> 3 ) : gap;
+	}
+	liveness.m_lastHeard = now;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsStandby>
+// Whether another controller of the network has the nodes
+//-----------------------------------------------------------------------------
+bool Driver::IsStandby
+(
+)const
+{
+	ControllerGroup* group = AtomicLoadPtr( &m_group );
+	return( group && group->GetPrimary() != this );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::QueueForwardedFrame>
+// Take a frame a standby received.  The driver thread is woken as it is for
+// held notifications, and handles the frame at the top of its loop.
+//-----------------------------------------------------------------------------
+void Driver::QueueForwardedFrame
+(
+		uint8 const* _data,
+		bool const _encrypted
+)
+{
+	// A little spare, as some handlers look past the command for the RSSI
+	ForwardedFrame frame;
+	frame.m_data.assign( _data, _data + 5 + _data[4] );
+	frame.m_data.resize( frame.m_data.size() + 8, 0 );
+	frame.m_encrypted = _encrypted;
+
+	LockGuard LG(m_forwardMutex);
+	m_forwardedFrames.push_back( frame );
+	m_notificationsEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleForwardedFrames>
+// Handle the frames the standbys have received, as if they came from this
+// driver's own controller
+//-----------------------------------------------------------------------------
+void Driver::HandleForwardedFrames
+(
+)
+{
+	list<ForwardedFrame> frames;
+	{
+		LockGuard LG(m_forwardMutex);
+		if( m_forwardedFrames.empty() )
+		{
+			return;
+		}
+		frames.swap( m_forwardedFrames );
+	}
+
+	m_handlingForwarded = true;
+	for( list<ForwardedFrame>::iterator it = frames.begin(); it != frames.end(); ++it )
+	{
+		Log::Write( LogLevel_Detail, it->m_data[3], "Handling a frame received by another controller" );
+		HandleApplicationCommandHandlerRequest( &it->m_data[0], it->m_encrypted );
+	}
+	m_handlingForwarded = false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsDuplicateFrame>
+// Whether a frame repeats the node's last one with the same command class and
+// command, within the duplicate window.  Routed retransmissions and copies
+// that come by another path may arrive after other kinds of frame from the
+// node, so the last of each of a few kinds is kept.  A frame that changes back,
+// such as a sensor going open, closed and open again, is never a duplicate.
+//-----------------------------------------------------------------------------
+bool Driver::IsDuplicateFrame
+(
+		Node* _node,
+		uint8 const* _data
+)
+{
+	if( !m_duplicateWindow )
+	{
+		return false;
+	}
+
+	// The length and payload, without the receive status, which differs between
+	// copies that came by different paths
+	uint32 hash = Fnv1a( &_data[4], _data[4] + 1 );
+	uint32 now = (uint32)-m_startTime.TimeRemaining() + 1;
+	uint8 commandClassId = _data[5];
+	uint8 command = ( _data[4] > 1 ) ? _data[6] : 0;
+
+	uint32 const count = sizeof(_node->m_recentFrames) / sizeof(_node->m_recentFrames[0]);
+	Node::RecentFrame* frame = NULL;
+	for( uint32 i = 0; i < count; ++i )
+	{
+		Node::RecentFrame& recent = _node->m_recentFrames[i];
+		if( recent.m_time && recent.m_commandClassId == commandClassId && recent.m_command == command )
+		{
+			frame = &recent;
+			break;
+		}
+	}
+
+	if( frame )
+	{
+		if( frame->m_hash == hash && now - frame->m_time <= m_duplicateWindow )
+		{
+			// The window runs from the first copy, so a stream of them cannot hold it open
+			return true;
+		}
+	}
+	else
+	{
+		frame = &_node->m_recentFrames[_node->m_nextRecentFrame];
+		frame->m_commandClassId = commandClassId;
+		frame->m_command = command;
+		_node->m_nextRecentFrame = (uint8)( ( _node->m_nextRecentFrame + 1 ) % count );
+	}
+	frame->m_hash = hash;
+	frame->m_time = now;
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ProbeQuietNodes>
+// Send a NoOperation to a listening node that has not been heard from for
+// longer than usual
+//-----------------------------------------------------------------------------
+int32 Driver::ProbeQuietNodes
+(
+)
+{
+	int32 next = Wait::Timeout_Infinite;
+	if( !m_livenessInterval )
+	{
+		return next;
+	}
+
+	uint32 now = (uint32)-m_startTime.TimeRemaining() + 1;
+	bool sent = false;
+	WriteLockGuard LG(m_nodeMutex);
+	for( vector<uint16>::const_iterator it = m_nodeIds.begin(); it != m_nodeIds.end(); ++it )
+	{
+		uint8 nodeId = (uint8)*it;
+		Node* node = m_nodes[nodeId];
+		if( nodeId == m_Controller_nodeId || !node->IsListeningDevice() || !node->IsNodeAlive() || !node->AllQueriesCompleted() )
+		{
+			// Sleeping nodes cannot be reached, dead ones are probed by ProbeDeadNodes,
+			// and the interview of a node is probe enough
+			continue;
+		}
+
+		Liveness& liveness = m_liveness[nodeId];
+		uint32 last = liveness.m_lastHeard;
+		if( !last )
+		{
+			// Count from when the node was first seen
+			liveness.m_lastHeard = now;
+			continue;
+		}
+		if( liveness.m_probed == last )
+		{
+			// Already probed this quiet spell.  It ends when the probe is acknowledged.
+			continue;
+		}
+
+		int32 limit = m_livenessInterval;
+		uint32 mean = liveness.m_meanGap;
+		if( mean && (int32)( mean * 3 ) < limit )
+		{
+			limit = ( (int32)( mean * 3 ) > c_minLivenessQuiet ) ? (int32)( mean * 3 ) : c_minLivenessQuiet;
+		}
+
+		// Spread the probes of nodes that went quiet together
+		uint32 spread = ( nodeId * 0x9e3779b1 ) ^ ( last * 0x85ebca6b );
+		limit -= (int32)( ( spread >> 8 ) % (uint32)( limit / 4 + 1 ) );
+
+		int32 quiet = (int32)( now - last );
+		if( quiet < limit )
+		{
+			if( next == Wait::Timeout_Infinite || limit - quiet < next )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSerialAPISoftResetResponse( _data );
-				break;
+				next = limit - quiet;
 			}
-			case FUNC_ID_ZW_SEND_DATA:
+			continue;
+		}
+
+		// One probe at a time.  Any others that are due go after it.
+		if( next == Wait::Timeout_Infinite || c_livenessProbeGap < next )
+		{
+			next = c_livenessProbeGap;
+		}
+		if( sent )
+		{
+			continue;
+		}
+		if( NoOperation* noop = static_cast<NoOperation*>( node->GetCommandClass( NoOperation::StaticGetCommandClassId() ) ) )
+		{
+			Log::Write( LogLevel_Info, nodeId, "Probing node, which has been quiet for %d seconds", quiet / 1000 );
+			noop->Set( true );
+			sent = true;
+		}
+		liveness.m_probed = last;
+	}
+	return next;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReadSendShaping>
+// Set up the queue airtime limits from the SendShaping option, a space
+// separated list of queue=percent or queue=percent:burst entries
+//-----------------------------------------------------------------------------
+void Driver::ReadSendShaping
+(
+)
+{
+	string setting;
+	Options::Get()->GetOptionAsString( "SendShaping", &setting );
+
+	size_t pos = 0;
+	while( pos < setting.size() )
+	{
+		size_t start = setting.find_first_not_of( " \t", pos );
+		if( start == string::npos )
+		{
+			break;
+		}
+		size_t end = setting.find_first_of( " \t", start );
+		if( end == string::npos )
+		{
+			end = setting.size();
+		}
+		pos = end;
+
+		string entry = setting.substr( start, end - start );
+		size_t equals = entry.find( '=' );
+		int32 queue = -1;
+		for( int32 i=0; i<MsgQueue_Count && equals != string::npos; ++i )
+		{
+			if( entry.compare( 0, equals, c_sendQueueNames[i] ) == 0 )
 			{
-				HandleSendDataResponse( _data, false );
-				handleCallback = false;			// Skip the callback handling - a subsequent FUNC_ID_ZW_SEND_DATA request will deal with that
+				queue = i;
 				break;
 			}
-			case FUNC_ID_ZW_GET_VERSION:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetVersionResponse( _data );
-				break;
-			}
-			case FUNC_ID_ZW_GET_RANDOM:
+		}
+		if( queue < 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: SendShaping entry %s does not name a queue", entry.c_str() );
+			continue;
+		}
+
+		char* p;
+		int32 share = (int32)strtol( entry.c_str() + equals + 1, &p, 10 );
+		int32 burst = 1000;
+		if( *p == ':' )
+		{
+			burst = (int32)strtol( p + 1, &p, 10 );
+		}
+		if( share <= 0 || share >= 100 || burst <= 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: SendShaping entry %s needs a percentage between 1 and 99 and a positive burst", entry.c_str() );
+			continue;
+		}
+
+		// The burst is given in ms of airtime
+		SendShaper& shaper = m_shapers[queue];
+		shaper.m_share = share;
+		shaper.m_burst = ( burst < 1000000 ? burst : 1000000 ) * 1000;
+		shaper.m_tokens = shaper.m_burst;
+		shaper.m_refilled.SetTime();
+		Log::Write( LogLevel_Info, "The %s queue may use %d%% of the airtime, in bursts of up to %d ms", c_sendQueueNames[queue], share, burst );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReadQueueTimes>
+// Read a time for each queue from an option that is a space separated list
+// of queue=ms entries
+//-----------------------------------------------------------------------------
+void Driver::ReadQueueTimes
+(
+		char const* _option,
+		uint32* o_times
+)
+{
+	string setting;
+	Options::Get()->GetOptionAsString( _option, &setting );
+
+	size_t pos = 0;
+	while( pos < setting.size() )
+	{
+		size_t start = setting.find_first_not_of( " \t", pos );
+		if( start == string::npos )
+		{
+			break;
+		}
+		size_t end = setting.find_first_of( " \t", start );
+		if( end == string::npos )
+		{
+			end = setting.size();
+		}
+		pos = end;
+
+		string entry = setting.substr( start, end - start );
+		size_t equals = entry.find( '=' );
+		int32 queue = -1;
+		for( int32 i=0; i<MsgQueue_Count && equals != string::npos; ++i )
+		{
+			if( entry.compare( 0, equals, c_sendQueueNames[i] ) == 0 )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetRandomResponse( _data );
+				queue = i;
 				break;
 			}
-			case FUNC_ID_ZW_MEMORY_GET_ID:
+		}
+		if( queue < 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: %s entry %s does not name a queue", _option, entry.c_str() );
+			continue;
+		}
+
+		char* p;
+		int32 ms = (int32)strtol( entry.c_str() + equals + 1, &p, 10 );
+		if( ms <= 0 || *p != 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: %s entry %s needs a positive number of milliseconds", _option, entry.c_str() );
+			continue;
+		}
+
+		o_times[queue] = (uint32)ms;
+		Log::Write( LogLevel_Info, "%s for the %s queue is %d ms", _option, c_sendQueueNames[queue], ms );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetAgedQueues>
+// Find the queues to pass over so that one left waiting too long goes next
+//-----------------------------------------------------------------------------
+uint32 Driver::GetAgedQueues
+(
+		uint32 const _count,
+		uint32 const _blocked
+)
+{
+	LockGuard LG( m_sendMutex );
+	for( int32 i=MsgQueue_Send+1; i<MsgQueue_Count && i+3<(int32)_count; ++i )
+	{
+		if( m_queueAging[i] == 0 || ( _blocked & ( 1 << i ) ) || m_msgQueue[i].empty() )
+		{
+			continue;
+		}
+
+		int32 wait = m_msgQueue[i].GetWaitTime( m_msgQueue[i].front() );
+		if( wait <= (int32)m_queueAging[i] )
+		{
+			continue;
+		}
+
+		// Only the background queues are passed over.  The queues for
+		// controller commands, security and sleeping nodes always go first.
+		uint32 passed = 0;
+		for( int32 j=MsgQueue_Send; j<i; ++j )
+		{
+			if( !m_msgQueue[j].empty() )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleMemoryGetIdResponse( _data );
-				break;
+				passed |= ( 1 << j );
 			}
-			case FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO:
+		}
+		if( passed )
+		{
+			Log::Write( LogLevel_Detail, "The %s queue has waited %d ms, so it goes ahead of the busier queues", c_sendQueueNames[i], wait );
+			++m_queueAged[i];
+		}
+		return passed;
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsExpired>
+// Whether a queued message has waited past its deadline
+//-----------------------------------------------------------------------------
+bool Driver::IsExpired
+(
+		MsgQueue const _queue,
+		MsgQueueItem const& _item
+)
+{
+	if( MsgQueueCmd_SendMsg != _item.m_command )
+	{
+		return false;
+	}
+
+	uint32 deadline = _item.m_msg->GetMaxQueueTime();
+	if( deadline == 0 )
+	{
+		// Only a request for a report can be dropped by its queue's deadline.
+		// The node is asked again for it later, while a Set would be lost.
+		if( _item.m_msg->GetExpectedReply() != FUNC_ID_APPLICATION_COMMAND_HANDLER )
+		{
+			return false;
+		}
+		deadline = m_queueDeadline[_queue];
+		if( deadline == 0 )
+		{
+			return false;
+		}
+	}
+	return( m_msgQueue[_queue].GetWaitTime( _item ) > (int32)deadline );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::EstimateAirtime>
+// Radio time taken by a message, its ack and any repeats, in microseconds
+//-----------------------------------------------------------------------------
+uint32 Driver::EstimateAirtime
+(
+		Msg* _msg,
+		Node* _node
+)
+{
+	// Only ZW_SEND_DATA goes over the radio.  The others are handled by the controller.
+	uint8* buffer = _msg->GetBuffer();
+	if( ( _msg->GetLength() < 10 ) || ( buffer[3] != FUNC_ID_ZW_SEND_DATA ) )
+	{
+		return 0;
+	}
+
+	// The serial frame's SOF, length, type, function, node, data length,
+	// transmit options, callback id and checksum are not sent to the node
+	uint32 payload = _msg->GetLength() - 9;
+
+	// 100 kbit/s frames have a longer preamble and a 16 bit checksum
+	uint32 baud = ( _node && _node->GetMaxBaudRate() ) ? _node->GetMaxBaudRate() : 9600;
+	uint32 overhead = ( baud >= 100000 ) ? 40 + 1 + 9 + 2 : 10 + 1 + 9 + 1;
+
+	// A node the controller cannot hear directly is assumed to be one repeater
+	// away, which adds a routing header and sends everything twice
+	uint32 hops = 1;
+	Node* controller = m_nodes[m_Controller_nodeId];
+	uint8 nodeId = _msg->GetTargetNodeId();
+	if( controller && _node && nodeId && nodeId <= NUM_NODE_BITFIELD_BYTES*8 && !IsBitSet( GetNeighborRow( m_Controller_nodeId ), nodeId ) )
+	{
+		hops = 2;
+		overhead += 4;
+	}
+
+	// The frame and its ack, over each hop
+	uint32 bytes = ( overhead + payload ) + overhead;
+	if( _msg->isEncrypted() )
+	{
+		// The nonce get and report, each with its ack
+		bytes += 2 * ( overhead + 2 ) + 2 * ( overhead + 10 );
+	}
+	return (uint32)( ( (uint64)bytes * 8 * 1000000 * hops ) / baud );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ChargeAirtime>
+// Count the airtime used by a frame against its queue and node
+//-----------------------------------------------------------------------------
+void Driver::ChargeAirtime
+(
+		MsgQueue const _queue,
+		Node* _node,
+		uint32 const _airtime
+)
+{
+	m_queueAirtime[_queue] += _airtime;
+	if( _node )
+	{
+		m_nodeCounters.m_airtime[_node->GetNodeId()] += _airtime;
+	}
+
+	SendShaper& shaper = m_shapers[_queue];
+	if( shaper.m_share )
+	{
+		// May go into debt, which the queue then has to wait out
+		shaper.m_tokens -= (int32)_airtime;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetShapedQueues>
+// Refill the queues' airtime and find the ones that are in debt
+//-----------------------------------------------------------------------------
+int32 Driver::GetShapedQueues
+(
+		uint32* o_blocked
+)
+{
+	int32 next = Wait::Timeout_Infinite;
+	*o_blocked = 0;
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		SendShaper& shaper = m_shapers[i];
+		if( shaper.m_share == 0 )
+		{
+			continue;
+		}
+
+		// Each ms of real time earns share% of a ms of airtime
+		int32 elapsed = -shaper.m_refilled.TimeRemaining();
+		if( elapsed > 0 )
+		{
+			shaper.m_refilled.SetTime();
+			int64 tokens = (int64)shaper.m_tokens + (int64)elapsed * 10 * shaper.m_share;
+			shaper.m_tokens = ( tokens < shaper.m_burst ) ? (int32)tokens : shaper.m_burst;
+		}
+
+		if( shaper.m_tokens < 0 )
+		{
+			*o_blocked |= ( 1 << i );
+			int32 wait = ( -shaper.m_tokens ) / ( 10 * shaper.m_share ) + 1;
+			if( next == Wait::Timeout_Infinite || wait < next )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetNodeProtocolInfoResponse( _data );
-				break;
+				next = wait;
 			}
-			case FUNC_ID_ZW_REPLICATION_SEND_DATA:
+		}
+	}
+	return next;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::UpdateRetryTimeout>
+// Add a round trip time sample to a node's retry timeout estimate, using
+// Jacobson's smoothed mean and mean deviation
+//-----------------------------------------------------------------------------
+void Driver::UpdateRetryTimeout
+(
+		Node* _node,
+		uint32 const _rtt
+)
+{
+	// A reply to a message that has been sent more than once could be to any
+	// of the attempts, so it says nothing about the round trip time (Karn)
+	if( m_currentMsg == NULL || m_currentMsg->GetSendAttempts() > 1 )
+	{
+		return;
+	}
+
+	int32 rtt = (int32)_rtt;
+	if( _node->m_smoothedRTT == 0 )
+	{
+		_node->m_smoothedRTT = rtt << 3;
+		_node->m_rttVariation = rtt << 1;
+	}
+	else
+	{
+		int32 delta = rtt - ( _node->m_smoothedRTT >> 3 );
+		_node->m_smoothedRTT += delta;
+		if( _node->m_smoothedRTT <= 0 )
+		{
+			_node->m_smoothedRTT = 1;
+		}
+		if( delta < 0 )
+		{
+			delta = -delta;
+		}
+		_node->m_rttVariation += delta - ( _node->m_rttVariation >> 2 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetRetryTimeout>
+// How long to wait for the current message before sending it again.  Without
+// the AdaptiveRetryTimeout option, or until the target node has answered a
+// message, the RetryTimeout option is used.
+//-----------------------------------------------------------------------------
+int32 Driver::GetRetryTimeout
+(
+		int32 const _retryTimeout
+)
+{
+	if( !m_adaptiveRetryTimeout || m_currentMsg == NULL )
+	{
+		return _retryTimeout;
+	}
+
+	Node* node = GetNodeUnsafe( m_currentMsg->GetTargetNodeId() );
+	if( node == NULL || node->m_smoothedRTT == 0 || m_currentMsg->GetTargetNodeId() == m_Controller_nodeId )
+	{
+		return _retryTimeout;
+	}
+
+	// The smoothed round trip time plus four mean deviations, doubled for
+	// each attempt that has already timed out
+	int32 timeout = ( node->m_smoothedRTT >> 3 ) + node->m_rttVariation;
+	if( timeout < c_minRetryTimeout )
+	{
+		timeout = c_minRetryTimeout;
+	}
+	for( uint8 attempt = 1; attempt < m_currentMsg->GetSendAttempts() && timeout < _retryTimeout; ++attempt )
+	{
+		timeout <<= 1;
+	}
+	return ( timeout < _retryTimeout ) ? timeout : _retryTimeout;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CanDeferCurrentMsg>
+// A plain query or poll that the controller has delivered, and that is now
+// only waiting for the node's reply, may make way for a more urgent message
+//-----------------------------------------------------------------------------
+bool Driver::CanDeferCurrentMsg
+(
+)
+{
+	if( !m_deferBackgroundMsgs || m_currentMsg == NULL )
+	{
+		return false;
+	}
+	if( m_currentMsgQueueSource != MsgQueue_Query && m_currentMsgQueueSource != MsgQueue_Poll )
+	{
+		return false;
+	}
+	if( m_waitingForAck || m_expectedCallbackId || !m_expectedReply || !m_inFlight.empty() || m_currentControllerCommand != NULL )
+	{
+		return false;
+	}
+
+	// Secure messages depend on nonce state that is only kept for the current message
+	if( m_currentMsg->isEncrypted() || m_nonceReportSent || m_nonceRequested )
+	{
+		return false;
+	}
+	return m_currentMsg->GetSendAttempts() < m_currentMsg->GetMaxSendAttempts();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::DeferCurrentMsg>
+// Put the current message back at the front of the queue it came from.  If
+// the node's reply still arrives, it is handled like any other report.
+//-----------------------------------------------------------------------------
+void Driver::DeferCurrentMsg
+(
+)
+{
+	OZW_LOG( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Deferring %s while a more urgent message is sent", m_currentMsg->GetAsString().c_str() );
+
+	MsgQueueItem item;
+	item.m_command = MsgQueueCmd_SendMsg;
+	item.m_nodeId = m_currentMsg->GetTargetNodeId();
+	item.m_msg = m_currentMsg;
+
+	m_sendMutex->Lock();
+	m_msgQueue[m_currentMsgQueueSource].push_front( item );
+	m_queueEvent[m_currentMsgQueueSource]->Set();
+	m_currentMsg = NULL;
+	m_sendMutex->Unlock();
+
+	m_expectedCallbackId = 0;
+	m_expectedCommandClassId = 0;
+	m_expectedNodeId = 0;
+	m_expectedReply = 0;
+	m_sendDataAccepted = false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::StartInterview>
+// Check whether a node's queries may go ahead.  Unless the MaxConcurrentInterviews
+// option is set, they always can.
+//-----------------------------------------------------------------------------
+bool Driver::StartInterview
+(
+		Node* _node
+)
+{
+	if( 0 == m_maxInterviews || Node::QueryStage_Complete == _node->GetCurrentQueryStage() )
+	{
+		return true;
+	}
+
+	if( !_node->IsNodeAlive() )
+	{
+		// Nothing is sent to a dead node, so it is not counted until it revives
+		return false;
+	}
+
+	uint8 nodeId = _node->GetNodeId();
+	LockGuard LG(m_interviewMutex);
+	Interview& interview = m_interviews[nodeId];
+	switch( interview.m_state )
+	{
+		case InterviewState_Running:
+		{
+			return true;
+		}
+		case InterviewState_Paused:
+		{
+			// A node that has woken up must be queried before it goes back to sleep,
+			// so it carries on even if that takes us over the limit
+			interview.m_state = InterviewState_Running;
+			++m_interviewCount;
+			return true;
+		}
+		default:
+		{
+			// Nodes that are being added are queried straight away, as the user is waiting for them
+			if( m_interviewCount < m_maxInterviews || _node->IsAddingNode() )
 			{
-				HandleSendDataResponse( _data, true );
-				handleCallback = false;			// Skip the callback handling - a subsequent FUNC_ID_ZW_REPLICATION_SEND_DATA request will deal with that
-				break;
+				interview.m_state = InterviewState_Running;
+				++m_interviewCount;
+				return true;
 			}
-			case FUNC_ID_ZW_ASSIGN_RETURN_ROUTE:
+
+			if( InterviewState_Waiting != interview.m_state )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleAssignReturnRouteResponse( _data ) )
-				{
-					m_expectedCallbackId = _data[2];		// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
-				}
-				break;
-			}
-			case FUNC_ID_ZW_DELETE_RETURN_ROUTE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleDeleteReturnRouteResponse( _data ) )
-				{
-					m_expectedCallbackId = _data[2];		// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
-				}
-				break;
-			}
-			case FUNC_ID_ZW_ENABLE_SUC:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleEnableSUCResponse( _data );
-				break;
+				Log::Write( LogLevel_Detail, nodeId, "%d nodes are being queried, waiting for one of them to finish", m_interviewCount );
 			}
-			case FUNC_ID_ZW_REQUEST_NETWORK_UPDATE:
+			interview.m_state = InterviewState_Waiting;
+			interview.m_priority = _node->GetQueryPriority();
+			interview.m_stage = _node->GetCurrentQueryStage();
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PauseInterview>
+// A node being queried is asleep or dead, so another can be queried meanwhile
+//-----------------------------------------------------------------------------
+void Driver::PauseInterview
+(
+		uint8 const _nodeId
+)
+{
+	if( 0 == m_maxInterviews )
+	{
+		return;
+	}
+
+	LockGuard LG(m_interviewMutex);
+	if( InterviewState_Running == m_interviews[_nodeId].m_state )
+	{
+		m_interviews[_nodeId].m_state = InterviewState_Paused;
+		--m_interviewCount;
+		AdmitInterviews();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::EndInterview>
+// A node's queries are complete, or it has been removed
+//-----------------------------------------------------------------------------
+void Driver::EndInterview
+(
+		uint8 const _nodeId
+)
+{
+	if( 0 == m_maxInterviews )
+	{
+		return;
+	}
+
+	LockGuard LG(m_interviewMutex);
+	if( InterviewState_Running == m_interviews[_nodeId].m_state )
+	{
+		--m_interviewCount;
+	}
+	m_interviews[_nodeId].m_state = InterviewState_None;
+	AdmitInterviews();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AdmitInterviews>
+// Let the most urgent waiting nodes be queried, up to the limit.  Must be
+// called with m_interviewMutex locked.
+//-----------------------------------------------------------------------------
+void Driver::AdmitInterviews
+(
+)
+{
+	while( m_interviewCount < m_maxInterviews )
+	{
+		// Among nodes of the same priority, the lowest node id goes first
+		int next = -1;
+		for( int i=0; i<256; ++i )
+		{
+			if( InterviewState_Waiting == m_interviews[i].m_state && ( next < 0 || m_interviews[i].m_priority < m_interviews[next].m_priority ) )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleNetworkUpdateResponse( _data ) )
-				{
-					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
-				}
-				break;
+				next = i;
 			}
-			case FUNC_ID_ZW_SET_SUC_NODE_ID:
+		}
+		if( next < 0 )
+		{
+			return;
+		}
+
+		Interview& interview = m_interviews[next];
+		interview.m_state = InterviewState_Running;
+		++m_interviewCount;
+
+		// Have the driver thread call AdvanceQueries again, without moving on a stage
+		Log::Write( LogLevel_Detail, (uint8)next, "Starting the queries that were waiting" );
+		MsgQueueItem item;
+		item.m_command = MsgQueueCmd_QueryStageComplete;
+		item.m_nodeId = (uint8)next;
+		item.m_queryStage = interview.m_stage;
+		item.m_retry = true;
+
+		m_sendMutex->Lock();
+		m_msgQueue[MsgQueue_Query].SetNodePriority( (uint8)next, (uint8)interview.m_priority );
+		m_msgQueue[MsgQueue_Query].push_back( item );
+		m_queueEvent[MsgQueue_Query]->Set();
+		m_sendMutex->Unlock();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SendMsg>
+// Queue a message to be sent to the Z-Wave PC Interface
+//-----------------------------------------------------------------------------
+void Driver::SendMsg
+(
+		Msg* _msg,
+		MsgQueue const _queue
+)
+{
+	// While the poll thread is polling a node, it collects its own requests so
+	// that they can be coalesced.  Other threads also use the poll queue, such
+	// as the driver thread for firmware fragments, and their messages go past.
+	if( ( MsgQueue_Poll == _queue ) && ( 0 != m_pollBatchNodeId ) && ( _msg->GetTargetNodeId() == m_pollBatchNodeId ) && ( Thread::GetCurrentId() == m_pollBatchThreadId ) )
+	{
+		m_pollBatch.push_back( _msg );
+		return;
+	}
+
+	// Likewise while SetValues is setting several values on a node.  It holds
+	// the write lock throughout, so any other thread waits here until it is done.
+	if( ( MsgQueue_Send == _queue ) && ( 0 != m_setBatchNodeId ) )
+	{
+		ReadLockGuard LG(m_nodeMutex);
+		if( _msg->GetTargetNodeId() == m_setBatchNodeId )
+		{
+			m_setBatch.push_back( _msg );
+			return;
+		}
+	}
+
+	// Another controller of the network may have the better route to a listening node
+	ControllerGroup* group = AtomicLoadPtr( &m_group );
+	if( group && ( MsgQueue_Send == _queue || MsgQueue_Poll == _queue ) && !IsStandby() )
+	{
+		bool listening = false;
+		{
+			ReadLockGuard LG(m_nodeMutex);
+			Node* node = GetNode( _msg->GetTargetNodeId() );
+			listening = ( node != NULL ) && ( node->IsListeningDevice() || node->IsFrequentListeningDevice() );
+		}
+		_msg->SetHomeId( m_homeId );
+		_msg->Finalize();
+		if( listening && group->Route( this, _msg, _queue ) )
+		{
+			return;
+		}
+	}
+
+	MsgQueueItem item;
+
+	item.m_command = MsgQueueCmd_SendMsg;
+	item.m_msg = _msg;
+	/* make sure the HomeId is Set on this message */
+	_msg->SetHomeId(m_homeId);
+	_msg->Finalize();
+
+	// A payload too long for one frame is sent in segments, if the node can put them back together
+	if( _msg->IsSendData() && _msg->GetBuffer()[5] > TransportService::c_maxFramePayload )
+	{
+		vector<Msg*> segments;
+		{
+			ReadLockGuard LG(m_nodeMutex);
+			Node* node = GetNode( _msg->GetTargetNodeId() );
+			TransportService* cc = node ? static_cast<TransportService*>( node->GetCommandClass( TransportService::StaticGetCommandClassId() ) ) : NULL;
+			if( cc != NULL )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSetSUCNodeIdResponse( _data );
-				break;
+				cc->Segment( _msg, segments );
 			}
-			case FUNC_ID_ZW_GET_SUC_NODE_ID:
+		}
+		if( !segments.empty() )
+		{
+			delete _msg;
+			for( vector<Msg*>::iterator it = segments.begin(); it != segments.end(); ++it )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetSUCNodeIdResponse( _data );
-				break;
+				SendMsg( *it, _queue );
 			}
-			case FUNC_ID_ZW_REQUEST_NODE_INFO:
+			return;
+		}
+	}
+	m_msgTrace->Record( MsgTrace::Event_Enqueue, _msg, (uint8)_queue );
+
+	uint8 priority = Node::QueryPriority_Normal;
+	uint8 targetNodeId = _msg->GetTargetNodeId();
+	uint32 route = AtomicLoad( &m_sendRoutes[targetNodeId] );
+	if( route & SendRoute_Direct )
+	{
+		// Nothing to encrypt and the node is not asleep, so there is no need
+		// to look at the node itself
+		priority = (uint8)( ( route & SendRoute_PriorityMask ) >> SendRoute_PriorityShift );
+	}
+	else
+	{
+		// Only the read lock, as the caller may hold a NodeGuard.  The wake up
+		// queue has a mutex of its own.
+		ReadLockGuard LG(m_nodeMutex);
+		if( Node* node = GetNode( targetNodeId ) )
+		{
+			priority = (uint8)node->GetQueryPriority();
+
+			// Let later messages take the fast path, unless the route was
+			// cleared while it was being worked out
+			uint32 newRoute = ( route & ~0xff ) | GetSendRoute( node );
+			if( newRoute != route )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( _data[2] )
-				{
-					Log::Write( LogLevel_Info, _data[3], "FUNC_ID_ZW_REQUEST_NODE_INFO Request successful." );
-				}
-				else
-				{
-					Log::Write( LogLevel_Info, _data[3], "FUNC_ID_ZW_REQUEST_NODE_INFO Request failed." );
-				}
-				break;
+				AtomicCompareExchange( &m_sendRoutes[targetNodeId], route, newRoute );
 			}
-			case FUNC_ID_ZW_REMOVE_FAILED_NODE_ID:
+
+			/* if the node Supports the Security Class - check if this message is meant to be encapsulated */
+			if ( node->GetCommandClass(Security::StaticGetCommandClassId() ) )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleRemoveFailedNodeResponse( _data ) )
+				CommandClass *cc = node->GetCommandClass(_msg->GetSendingCommandClass());
+				if ( (cc) && (cc->IsSecured()) )
 				{
-					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
+					Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Setting Encryption Flag on Message For Command Class %s", cc->GetCommandClassName().c_str());
+					item.m_msg->setEncrypted();
 				}
-				break;
-			}
-			case FUNC_ID_ZW_IS_FAILED_NODE_ID:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleIsFailedNodeResponse( _data );
-				break;
 			}
-			case FUNC_ID_ZW_REPLACE_FAILED_NODE:
+
+			// If the message is for a sleeping node, we queue it in the node itself.
+			if( !node->IsListeningDevice() )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleReplaceFailedNodeResponse( _data ) )
+				if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
 				{
-					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
+					if( !wakeUp->IsAwake() )
+					{
+						Log::Write( LogLevel_Detail, "" );
+						// Handle saving multi-step controller commands
+						if( IsControllerCommandMsg( _msg ) )
+						{
+							Log::Write( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[MsgQueue_Controller], c_controllerCommandNames[m_currentControllerCommand->m_controllerCommand] );
+							delete _msg;
+							item.m_command = MsgQueueCmd_Controller;
+							item.m_cci = new ControllerCommandItem( *m_currentControllerCommand );
+							item.m_msg = NULL;
+							UpdateControllerState( ControllerState_Sleeping );
+						}
+						else
+						{
+							if( Log::IsEnabled( LogLevel_Detail, GetNodeNumber( _msg ) ) )
+							{
+								OZW_LOG( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[MsgQueue_WakeUp], _msg->GetAsString().c_str() );
+							}
+						}
+						wakeUp->QueueMsg( item );
+						return;
+					}
 				}
-				break;
 			}
-			case FUNC_ID_ZW_GET_ROUTING_INFO:
+		}
+	}
+	if( Log::IsEnabled( LogLevel_Detail, GetNodeNumber( _msg ) ) )
+	{
+		OZW_LOG( LogLevel_Detail, GetNodeNumber( _msg ), "Queuing (%s) %s", c_sendQueueNames[_queue], _msg->GetAsString().c_str() );
+	}
+	m_sendMutex->Lock();
+	if( !_msg->IsNoOperation() && ParkMsg( item, _queue ) )
+	{
+		m_sendMutex->Unlock();
+		return;
+	}
+	if( MsgQueue_Query == _queue )
+	{
+		m_msgQueue[_queue].SetNodePriority( _msg->GetTargetNodeId(), priority );
+	}
+	m_msgQueue[_queue].push_back( item );
+	m_queueEvent[_queue]->Set();
+	m_sendMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetTransmitOptions>
+// Choose the transmit options for a node from how its messages have fared
+//-----------------------------------------------------------------------------
+uint8 Driver::GetTransmitOptions
+(
+		uint8 const _nodeId
+)
+{
+	uint8 options = m_transmitOptions;
+	if( ( options & TRANSMIT_OPTION_EXPLORE ) == 0 || m_Controller_nodeId == 0 )
+	{
+		return options;
+	}
+
+	Node* node = GetNodeUnsafe( _nodeId );
+	if( node == NULL || node->m_deliveryRun < c_directDeliveryRun )
+	{
+		return options;
+	}
+
+	// The routing info lists the controller among the node's neighbours
+	if( !IsBitSet( GetNeighborRow( _nodeId ), m_Controller_nodeId ) )
+	{
+		return options;
+	}
+
+	return( options & ~TRANSMIT_OPTION_EXPLORE );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetSendRoute>
+// Work out whether SendMsg can queue messages for a node without looking at it
+//-----------------------------------------------------------------------------
+uint32 Driver::GetSendRoute
+(
+		Node const* _node
+)const
+{
+	if( _node->GetCommandClass( Security::StaticGetCommandClassId() ) )
+	{
+		for( map<uint8,CommandClass*>::const_iterator it = _node->m_commandClassMap.begin(); it != _node->m_commandClassMap.end(); ++it )
+		{
+			if( it->second->IsSecured() )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetRoutingInfoResponse( _data );
-				break;
+				return 0;
 			}
-			case FUNC_ID_ZW_R_F_POWER_LEVEL_SET:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleRfPowerLevelSetResponse( _data );
-				break;
-			}
-			case FUNC_ID_ZW_READ_MEMORY:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleReadMemoryResponse( _data );
-				break;
-			}
-			case FUNC_ID_SERIAL_API_SET_TIMEOUTS:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSerialApiSetTimeoutsResponse( _data );
-				break;
-			}
-			case FUNC_ID_MEMORY_GET_BYTE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleMemoryGetByteResponse( _data );
-				break;
-			}
-			case FUNC_ID_ZW_GET_VIRTUAL_NODES:
+		}
+	}
+
+	if( !_node->IsListeningDevice() )
+	{
+		// A node that sleeps is only routed directly while it is known to be awake
+		WakeUp* wakeUp = static_cast<WakeUp*>( _node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) );
+		if( !wakeUp || !wakeUp->IsAwake() )
+		{
+			return 0;
+		}
+	}
+
+	return( SendRoute_Direct | ( (uint32)_node->GetQueryPriority() << SendRoute_PriorityShift ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::InvalidateSendRoute>
+// Make SendMsg look at the node again, and count the change so that a route
+// being worked out from the old state is not stored
+//-----------------------------------------------------------------------------
+void Driver::InvalidateSendRoute
+(
+		uint8 const _nodeId
+)
+{
+	while( true )
+	{
+		uint32 route = AtomicLoad( &m_sendRoutes[_nodeId] );
+		uint32 changed = ( ( route >> SendRoute_ChangeShift ) + 1 ) << SendRoute_ChangeShift;
+		if( AtomicCompareExchange( &m_sendRoutes[_nodeId], route, changed ) )
+		{
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::WriteNextMsg>
+// Transmit a queued message to the Z-Wave controller
+//-----------------------------------------------------------------------------
+bool Driver::WriteNextMsg
+(
+		MsgQueue const _queue
+)
+{
+	// An item that arrived after the driver thread checked the queues may
+	// still have to wait for the in flight messages to complete
+	if( !m_inFlight.empty() && !CanPipelineNextMsg() )
+	{
+		return false;
+	}
+
+	// There are messages to send, so get the one at the front of the queue
+	m_sendMutex->Lock();
+
+	// Drop the messages that have waited too long, rather than add to the congestion
+	vector<uint8> expired;
+	while( !m_msgQueue[_queue].empty() && IsExpired( _queue, m_msgQueue[_queue].front() ) )
+	{
+		MsgQueueItem& front = m_msgQueue[_queue].front();
+		Msg* msg = front.m_msg;
+		if( Log::IsEnabled( LogLevel_Info, msg->GetTargetNodeId() ) )
+		{
+			Log::Write( LogLevel_Info, msg->GetTargetNodeId(), "Dropping %s, which waited %d ms on the %s queue", msg->GetAsString().c_str(), m_msgQueue[_queue].GetWaitTime( front ), c_sendQueueNames[_queue] );
+		}
+		expired.push_back( msg->GetTargetNodeId() );
+		Count( DriverCounter_Expired );
+		m_msgQueue[_queue].pop_front();
+		m_msgTrace->Record( MsgTrace::Event_Remove, msg );
+		delete msg;
+	}
+	if( !expired.empty() && m_notifyExpired )
+	{
+		m_sendMutex->Unlock();
+		for( vector<uint8>::iterator it = expired.begin(); it != expired.end(); ++it )
+		{
+			Notification* notification = new Notification( Notification::Type_Notification );
+			notification->SetHomeAndNodeIds( m_homeId, *it );
+			notification->SetNotification( Notification::Code_Expired );
+			QueueNotification( notification );
+		}
+		m_sendMutex->Lock();
+	}
+	if( m_msgQueue[_queue].empty() )
+	{
+		m_queueEvent[_queue]->Reset();
+		m_sendMutex->Unlock();
+		return false;
+	}
+	MsgQueueItem item = m_msgQueue[_queue].front();
+
+	if( MsgQueueCmd_SendMsg == item.m_command )
+	{
+		// Send a message
+		m_currentMsg = item.m_msg;
+		m_currentMsgQueueSource = _queue;
+		m_queueWait[_queue].Record( m_msgQueue[_queue].GetWaitTime( item ) );
+		m_msgTrace->Record( MsgTrace::Event_Dequeue, m_currentMsg, (uint8)_queue );
+		m_msgQueue[_queue].pop_front();
+		if( m_msgQueue[_queue].empty() )
+		{
+			m_queueEvent[_queue]->Reset();
+		}
+		if (m_nonceReportSent > 0) {
+			MsgQueueItem item_new;
+			item_new.m_command = MsgQueueCmd_SendMsg;
+			item_new.m_nodeId = item.m_msg->GetTargetNodeId();
+			item_new.m_retry = item.m_retry;
+			item_new.m_msg = new Msg(*item.m_msg);
+			m_msgQueue[_queue].push_front(item_new);
+			m_queueEvent[_queue]->Set();
+		}
+		m_sendMutex->Unlock();
+		return WriteMsg( "WriteNextMsg" );
+	}
+
+	if( MsgQueueCmd_QueryStageComplete == item.m_command )
+	{
+		// Move to the next query stage
+		m_currentMsg = NULL;
+		Node::QueryStage stage = item.m_queryStage;
+		m_msgQueue[_queue].pop_front();
+		if( m_msgQueue[_queue].empty() )
+		{
+			m_queueEvent[_queue]->Reset();
+		}
+		m_sendMutex->Unlock();
+
+		Node* node = GetNodeUnsafe( item.m_nodeId );
+		if( node != NULL )
+		{
+			Log::Write( LogLevel_Detail, node->GetNodeId(), "Query Stage Complete (%s)", node->GetQueryStageName( stage ).c_str() );
+			if( !item.m_retry )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleGetVirtualNodesResponse( _data );
-				break;
+				node->QueryStageComplete( stage );
 			}
-			case FUNC_ID_ZW_SET_SLAVE_LEARN_MODE:
+			node->AdvanceQueries();
+			return true;
+		}
+	}
+
+	if( MsgQueueCmd_Controller == item.m_command )
+	{
+		// Run a multi-step controller command
+		m_currentControllerCommand = item.m_cci;
+		m_sendMutex->Unlock();
+		// Figure out if done with command
+		if ( m_currentControllerCommand->m_controllerCommandDone )
+		{
+			m_sendMutex->Lock();
+			m_msgQueue[_queue].pop_front();
+			if( m_msgQueue[_queue].empty() )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleSetSlaveLearnModeResponse( _data ) )
-				{
-					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
-				}
-				break;
+				m_queueEvent[_queue]->Reset();
 			}
-			case FUNC_ID_ZW_SEND_SLAVE_NODE_INFO:
+			m_sendMutex->Unlock();
+			if( m_currentControllerCommand->m_controllerCallback )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				if( !HandleSendSlaveNodeInfoResponse( _data ) )
-				{
-					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
-					m_expectedReply = 0;
-					m_expectedCommandClassId = 0;
-					m_expectedNodeId = 0;
-				}
-				break;
+				m_currentControllerCommand->m_controllerCallback( m_currentControllerCommand->m_controllerState, m_currentControllerCommand->m_controllerReturnError, m_currentControllerCommand->m_controllerCallbackContext );
 			}
-			default:
+			m_sendMutex->Lock();
+			delete m_currentControllerCommand;
+			m_currentControllerCommand = NULL;
+			m_sendMutex->Unlock();
+		}
+		else if( m_currentControllerCommand->m_controllerState == ControllerState_Normal )
+		{
+			DoControllerCommand();
+		}
+		else if( m_currentControllerCommand->m_controllerStateChanged )
+		{
+			if( m_currentControllerCommand->m_controllerCallback )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				Log::Write( LogLevel_Info, "**TODO: handle response for 0x%.2x** Please report this message.", _data[1] );
-				break;
+				m_currentControllerCommand->m_controllerCallback( m_currentControllerCommand->m_controllerState, m_currentControllerCommand->m_controllerReturnError, m_currentControllerCommand->m_controllerCallbackContext );
 			}
+			m_currentControllerCommand->m_controllerStateChanged = false;
+		}
+		else
+		{
+			Log::Write( LogLevel_Info, "WriteNextMsg Controller nothing to do" );
+			m_sendMutex->Lock();
+			m_queueEvent[_queue]->Reset();
+			m_sendMutex->Unlock();
 		}
+		return true;
 	}
-	else if( REQUEST == _data[0] )
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::WriteMsg>
+// Transmit the current message to the Z-Wave controller
+//-----------------------------------------------------------------------------
+bool Driver::WriteMsg
+(
+		string const &msg
+)
+{
+	if( !m_currentMsg )
 	{
-		switch( _data[1] )
+		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "WriteMsg %s m_currentMsg=%08x", msg.c_str(), m_currentMsg );
+		// We try not to hang when this happenes
+		m_expectedCallbackId = 0;
+		m_expectedCommandClassId = 0;
+		m_expectedNodeId = 0;
+		m_expectedReply = 0;
+		m_waitingForAck = false;
+		return false;
+	}
+	/* if this is called with m_nonceReportSent > 0 it means that we have
+	 * tried to send a NONCE report and it timed out or was NAK'd
+	 *
+	 */
+	uint8 attempts;
+	uint8 nodeId;
+	if (m_nonceReportSent > 0) {
+		attempts = m_nonceReportSentAttempt++;
+		nodeId = m_nonceReportSent;
+	} else {
+		attempts = m_currentMsg->GetSendAttempts();
+		nodeId = m_currentMsg->GetTargetNodeId();
+	}
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( nodeId );
+	if( attempts >= m_currentMsg->GetMaxSendAttempts() ||
+			(node != NULL && !node->IsNodeAlive() && !m_currentMsg->IsNoOperation() ) )
+	{
+		if( node != NULL && !node->IsNodeAlive() && m_currentControllerCommand == NULL )
 		{
-			case FUNC_ID_APPLICATION_COMMAND_HANDLER:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleApplicationCommandHandlerRequest( _data, wasencrypted );
-				break;
-			}
-			case FUNC_ID_ZW_SEND_DATA:
+			// Hold on to it until the node answers a probe
+			MsgQueueItem item;
+			item.m_command = MsgQueueCmd_SendMsg;
+			item.m_msg = m_currentMsg;
+			m_sendMutex->Lock();
+			bool parked = ParkMsg( item, m_currentMsgQueueSource );
+			m_sendMutex->Unlock();
+			if( parked )
 			{
-				HandleSendDataRequest( _data, false );
-				break;
+				m_currentMsg->SetSendAttempts( 0 );
+				m_currentMsg = NULL;
+				RemoveCurrentMsg();
+				return false;
 			}
-			case FUNC_ID_ZW_REPLICATION_COMMAND_COMPLETE:
+		}
+
+		if( node != NULL && !node->IsNodeAlive() )
+		{
+			Log::Write( LogLevel_Error, nodeId, "ERROR: Dropping command because node is presumed dead" );
+		}
+		else
+		{
+			// Another controller of the network may still get it through.  The lock
+			// is let go first, as the other driver takes its own.
+			ControllerGroup* group = AtomicLoadPtr( &m_group );
+			if( group && m_nonceReportSent == 0 && !IsControllerCommandMsg( m_currentMsg ) )
 			{
-				if( m_controllerReplication )
+				LG.Unlock();
+				if( group->Failover( this, m_currentMsg, m_currentMsgQueueSource ) )
 				{
-					Log::Write( LogLevel_Detail, "" );
-					m_controllerReplication->SendNextData();
+					m_currentMsg = NULL;
+					RemoveCurrentMsg();
+					return false;
 				}
-				break;
-			}
-			case FUNC_ID_ZW_REPLICATION_SEND_DATA:
-			{
-				HandleSendDataRequest( _data, true );
-				break;
-			}
-			case FUNC_ID_ZW_ASSIGN_RETURN_ROUTE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleAssignReturnRouteRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_DELETE_RETURN_ROUTE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleDeleteReturnRouteRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_SEND_NODE_INFORMATION:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSendNodeInformationRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE:
-			case FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleNodeNeighborUpdateRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_APPLICATION_UPDATE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				handleCallback = !HandleApplicationUpdateRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_ADD_NODE_TO_NETWORK:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleAddNodeToNetworkRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleRemoveNodeFromNetworkRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_CREATE_NEW_PRIMARY:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleCreateNewPrimaryRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_CONTROLLER_CHANGE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleControllerChangeRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_SET_LEARN_MODE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSetLearnModeRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_REQUEST_NETWORK_UPDATE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleNetworkUpdateRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_REMOVE_FAILED_NODE_ID:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleRemoveFailedNodeRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_REPLACE_FAILED_NODE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleReplaceFailedNodeRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_SET_SLAVE_LEARN_MODE:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSetSlaveLearnModeRequest( _data );
-				break;
-			}
-			case FUNC_ID_ZW_SEND_SLAVE_NODE_INFO:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSendSlaveNodeInfoRequest( _data );
-				break;
-			}
-			case FUNC_ID_APPLICATION_SLAVE_COMMAND_HANDLER:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleApplicationSlaveCommandRequest( _data );
-				break;
-			}
-			case FUNC_ID_PROMISCUOUS_APPLICATION_COMMAND_HANDLER:
-			{
-				Log::Write( LogLevel_Detail, "" );
-				HandlePromiscuousApplicationCommandHandlerRequest( _data );
-				break;
 			}
-			case FUNC_ID_ZW_SET_DEFAULT:
+
+			// That's it - already tried to send GetMaxSendAttempt() times.
+			Log::Write( LogLevel_Error, nodeId, "ERROR: Dropping command, expected response not received after %d attempt(s)", m_currentMsg->GetMaxSendAttempts() );
+		}
+		if( IsControllerCommandMsg( m_currentMsg ) )
+		{
+			/* its a ControllerCommand that is failed */
+			UpdateControllerState( ControllerState_Error, ControllerError_Failed);
+
+		}
+		ValueSetMsgRemoved( m_currentMsg, false );
+
+		RemoveCurrentMsg();
+		Count( DriverCounter_Dropped );
+		return false;
+	}
+
+	if (( attempts != 0) && (m_nonceReportSent == 0))
+	{
+		// this is not the first attempt, so increment the callback id before sending
+		m_currentMsg->UpdateCallbackId();
+	}
+
+	/* XXX TODO: Minor Bug - Due to the post increament of the SendAttempts, it means our final NONCE_GET will go though
+	 * but the subsequent MSG send will fail (as the counter is incremented only upon a successful NONCE_GET, and Not a Send
+	 *
+	 */
+
+	if (m_nonceReportSent == 0) {
+		if (m_currentMsg->isEncrypted() && !m_currentMsg->isNonceRecieved()) {
+			m_currentMsg->SetSendAttempts( ++attempts );
+		} else if (!m_currentMsg->isEncrypted() ) {
+			m_currentMsg->SetSendAttempts( ++attempts );
+		}
+		m_expectedCallbackId = m_currentMsg->GetCallbackId();
+		m_expectedCommandClassId = m_currentMsg->GetExpectedCommandClassId();
+		m_expectedNodeId = m_currentMsg->GetTargetNodeId();
+		m_expectedReply = m_currentMsg->GetExpectedReply();
+		m_waitingForAck = true;
+		m_ackTimeStamp.SetTime( ACK_TIMEOUT + (int32)m_controller->GetLinkDelay() );
+		m_sendDataAccepted = false;
+	}
+	char attemptsstr[15] = "";
+	if( attempts > 1 )
+	{
+		snprintf( attemptsstr, sizeof(attemptsstr), "Attempt %d, ", attempts );
+		Count( DriverCounter_Retries );
+		m_msgTrace->Record( MsgTrace::Event_Retry, m_currentMsg );
+		if( node != NULL )
+		{
+			m_nodeCounters.m_retries[node->GetNodeId()]++;
+		}
+	}
+
+	Log::Write( LogLevel_Detail, "" );
+
+	if (m_nonceReportSent > 0) {
+		/* send a new NONCE report */
+		SendNonceKey(m_nonceReportSent, node->GenerateNonceKey());
+	} else if (m_currentMsg->isEncrypted()) {
+		uint8 nonce[8];
+		if (!m_currentMsg->isNonceRecieved() && TakePrefetchedNonce(nodeId, nonce)) {
+			/* the node sent us this nonce along with the reply to our last message */
+			Log::Write( LogLevel_Detail, nodeId, "Using the prefetched nonce" );
+			m_currentMsg->setNonce(nonce);
+		}
+		if (m_currentMsg->isNonceRecieved()) {
+			if( Log::IsEnabled( LogLevel_Info, nodeId ) )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				HandleSerialAPIResetRequest( _data );
-				break;
+				OZW_LOG( LogLevel_Info, nodeId, "Processing (%s) Encrypted message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr, m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
 			}
-			default:
+			SendEncryptedMessage();
+		} else {
+			Log::Write( LogLevel_Info, nodeId, "Processing (%s) Nonce Request message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x)", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr, m_expectedCallbackId, m_expectedReply);
+			m_msgTrace->Record( MsgTrace::Event_NonceRequest, m_currentMsg );
+			SendNonceRequest(m_currentMsg->GetLogText());
+		}
+	} else {
+		// Leave out explore frames where they cannot help.  Messages built
+		// with other than the usual options keep their own.
+		uint8 options = m_currentMsg->GetTransmitOptions();
+		if( ( options != 0 ) && ( ( options | TRANSMIT_OPTION_EXPLORE ) == m_transmitOptions ) )
+		{
+			m_currentMsg->SetTransmitOptions( GetTransmitOptions( nodeId ) );
+		}
+
+		if( Log::IsEnabled( LogLevel_Info, nodeId ) )
+		{
+			OZW_LOG( LogLevel_Info, nodeId, "Sending (%s) message (%sCallback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], attemptsstr, m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
+		}
+		uint32 bytesWritten = m_controller->Write(m_currentMsg->GetBuffer(), m_currentMsg->GetLength());
+
+		if (bytesWritten == 0)
+		{
+			bool hotReconnect = false;
+			Options::Get()->GetOptionAsBool( "HotReconnect", &hotReconnect );
+			if( hotReconnect )
 			{
-				Log::Write( LogLevel_Detail, "" );
-				Log::Write( LogLevel_Info, "**TODO: handle request for 0x%.2x** Please report this message.", _data[1] );
-				break;
+				// Wait for the controller to come back.  Until it does, the message is
+				// tried again at each timeout, without using up its attempts.
+				if( !m_controllerLost )
+				{
+					Log::Write( LogLevel_Warning, "WARNING: Lost the controller, waiting for it to come back" );
+					m_controllerLost = true;
+				}
+				m_currentMsg->SetSendAttempts( attempts - 1 );
+				return true;
 			}
+
+			//0 will be returned when the port is closed or something bad happened
+			//so send notification
+			Notification* notification = new Notification(Notification::Type_DriverFailed);
+			notification->SetHomeAndNodeIds(m_homeId, m_currentMsg->GetTargetNodeId());
+			QueueNotification(notification);
+			NotifyWatchers();
+
+			m_driverThread->Stop();
+			return false;
 		}
 	}
+	Count( DriverCounter_Write );
+	m_writeTS.SetTime();
+	if( m_nonceReportSent == 0 )
+	{
+		m_msgTrace->Record( MsgTrace::Event_Write, m_currentMsg );
+		ChargeAirtime( m_currentMsgQueueSource, node, EstimateAirtime( m_currentMsg, node ) );
+	}
 
-	// Generic callback handling
-	if( handleCallback )
+	if( nodeId == 0xff )
 	{
-		if( ( m_expectedCallbackId || m_expectedReply ) )
+		// Messages to the controller itself are also addressed to 0xff
+		if( m_currentMsg->GetBuffer()[3] == FUNC_ID_ZW_SEND_DATA )
 		{
-			if( m_expectedCallbackId )
+			Count( DriverCounter_BroadcastWrite );
+		}
+	}
+	else
+	{
+		if( node != NULL )
+		{
+			m_nodeCounters.m_sentCnt[node->GetNodeId()]++;
+			node->m_sentTS.SetTime();
+			if( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER )
 			{
-				if( m_expectedCallbackId == _data[2] )
+				CommandClass *cc = node->GetCommandClass(m_expectedCommandClassId);
+				if( cc != NULL )
 				{
-					Log::Write( LogLevel_Detail, _data[3], "  Expected callbackId was received" );
-					m_expectedCallbackId = 0;
-				} else if (_data[2] == 0x02 || _data[2] == 0x01) {
-					/* it was a NONCE request/reply. Drop it */
-					return;
+					cc->SentCntIncr();
 				}
 			}
-			if( m_expectedReply )
-			{
-				if( m_expectedReply == _data[1] )
-				{
-					if( m_expectedCommandClassId && ( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER ) )
-					{
-						if( m_expectedCallbackId == 0 && m_expectedCommandClassId == _data[5] && m_expectedNodeId == _data[3] )
-						{
-							Log::Write( LogLevel_Detail, _data[3], "  Expected reply and command class was received" );
-							m_waitingForAck = false;
-							m_expectedReply = 0;
-							m_expectedCommandClassId = 0;
-							m_expectedNodeId = 0;
-						}
-					}
-					else
-					{
-						if( IsExpectedReply( _data[3] ) )
+		}
+	}
+	return true;
+}
 
-						{
-							Log::Write( LogLevel_Detail, _data[3], "  Expected reply was received" );
-							m_expectedReply = 0;
-							m_expectedNodeId = 0;
-						}
-					}
-				}
-			}
-			if( !( m_expectedCallbackId || m_expectedReply ) )
-			{
-				Log::Write( LogLevel_Detail, _data[3], "  Message transaction complete" );
-				Log::Write( LogLevel_Detail, "" );
+//-----------------------------------------------------------------------------
+// <Driver::RemoveCurrentMsg>
+// Delete the current message
+//-----------------------------------------------------------------------------
+void Driver::RemoveCurrentMsg
+(
+)
+{
+	Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Removing current message" );
+	if( m_currentMsg != NULL)
+	{
+		m_msgTrace->Record( MsgTrace::Event_Remove, m_currentMsg );
+		ProvisionMsgRemoved( m_currentMsg );
+		NvmMsgRemoved( m_currentMsg );
+		ValueSetMsgRemoved( m_currentMsg, true );
+		delete m_currentMsg;
+		m_currentMsg = NULL;
+	}
+
+	m_expectedCallbackId = 0;
+	m_expectedCommandClassId = 0;
+	m_expectedNodeId = 0;
+	m_expectedReply = 0;
+	m_waitingForAck = false;
+	m_sendDataAccepted = false;
+	m_nonceReportSent = 0;
+	m_nonceReportSentAttempt = 0;
+	m_nonceRequested = 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PipelineCurrentMsg>
+// Move the current message in flight, if the controller has accepted it
+//-----------------------------------------------------------------------------
+bool Driver::PipelineCurrentMsg
+(
+		TimeStamp& _retryTimeStamp
+)
+{
+	if( m_inFlight.size() + 1 >= m_maxInFlight )
+	{
+		return false;
+	}
+
+	// Only plain ZW_SEND_DATA requests to a single node, which the controller has already
+	// accepted, and that are now only waiting for their callback.  Secure messages and
+	// controller commands depend on state that is only kept for the current message.
+	if( m_currentMsg == NULL || m_waitingForAck || !m_sendDataAccepted || !m_expectedCallbackId )
+	{
+		return false;
+	}
+	if( m_currentControllerCommand != NULL || m_nonceReportSent > 0 || m_currentMsg->isEncrypted() ||
+			!m_currentMsg->IsSendData() || m_currentMsg->GetTargetNodeId() == 0xff )
+	{
+		return false;
+	}
+	if( m_inFlight.find( m_expectedCallbackId ) != m_inFlight.end() )
+	{
+		return false;
+	}
+
+	InFlightMsg* inFlight = new InFlightMsg();
+	inFlight->m_msg = m_currentMsg;
+	inFlight->m_queue = m_currentMsgQueueSource;
+	inFlight->m_expectedCallbackId = m_expectedCallbackId;
+	inFlight->m_expectedReply = m_expectedReply;
+	inFlight->m_expectedCommandClassId = m_expectedCommandClassId;
+	inFlight->m_expectedNodeId = m_expectedNodeId;
+	inFlight->m_retryTimeStamp.SetTime( _retryTimeStamp.TimeRemaining() );
+
+	m_sendMutex->Lock();
+	m_inFlight[m_expectedCallbackId] = inFlight;
+	m_sendMutex->Unlock();
+
+	Log::Write( LogLevel_Detail, m_currentMsg->GetTargetNodeId(), "  Message in flight (Callback ID=0x%.2x), %d of %d outstanding", m_expectedCallbackId, (int)m_inFlight.size(), m_maxInFlight );
+
+	m_currentMsg = NULL;
+	m_expectedCallbackId = 0;
+	m_expectedCommandClassId = 0;
+	m_expectedNodeId = 0;
+	m_expectedReply = 0;
+	m_waitingForAck = false;
+	m_sendDataAccepted = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ResumeInFlightMsg>
+// Make a timed out in flight message current again, ready to be resent
+//-----------------------------------------------------------------------------
+bool Driver::ResumeInFlightMsg
+(
+)
+{
+	if( m_currentMsg != NULL || m_inFlight.empty() )
+	{
+		return false;
+	}
+
+	m_sendMutex->Lock();
+	map<uint8,InFlightMsg*>::iterator it = m_inFlight.begin();
+	for( ; it != m_inFlight.end(); ++it )
+	{
+		if( it->second->m_retryTimeStamp.TimeRemaining() <= 0 )
+		{
+			break;
+		}
+	}
+	if( it == m_inFlight.end() )
+	{
+		m_sendMutex->Unlock();
+		return false;
+	}
+
+	InFlightMsg* inFlight = it->second;
+	m_inFlight.erase( it );
+	m_sendMutex->Unlock();
+
+	m_currentMsg = inFlight->m_msg;
+	m_currentMsgQueueSource = inFlight->m_queue;
+	m_expectedCallbackId = inFlight->m_expectedCallbackId;
+	m_expectedReply = inFlight->m_expectedReply;
+	m_expectedCommandClassId = inFlight->m_expectedCommandClassId;
+	m_expectedNodeId = inFlight->m_expectedNodeId;
+	m_waitingForAck = false;
+	m_sendDataAccepted = false;
+	delete inFlight;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ProcessInFlightMsg>
+// Process a callback or reply for one of the in flight messages
+//-----------------------------------------------------------------------------
+bool Driver::ProcessInFlightMsg
+(
+		uint8* _data
+)
+{
+	if( m_inFlight.empty() || REQUEST != _data[0] )
+	{
+		return false;
+	}
+
+	m_sendMutex->Lock();
+	map<uint8,InFlightMsg*>::iterator it = m_inFlight.end();
+	if( FUNC_ID_ZW_SEND_DATA == _data[1] )
+	{
+		it = m_inFlight.find( _data[2] );
+		if( it != m_inFlight.end() && it->second->m_expectedCallbackId == 0 )
+		{
+			// We already have the callback for this message
+			it = m_inFlight.end();
+		}
+	}
+	else if( FUNC_ID_APPLICATION_COMMAND_HANDLER == _data[1] )
+	{
+		for( it = m_inFlight.begin(); it != m_inFlight.end(); ++it )
+		{
+			InFlightMsg const* inFlight = it->second;
+			if( inFlight->m_expectedCallbackId == 0 && inFlight->m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER &&
+					inFlight->m_expectedNodeId == _data[3] && inFlight->m_expectedCommandClassId == _data[5] )
+			{
+				break;
+			}
+		}
+	}
+	if( it == m_inFlight.end() )
+	{
+		m_sendMutex->Unlock();
+		return false;
+	}
+
+	InFlightMsg* inFlight = it->second;
+	m_inFlight.erase( it );
+	m_sendMutex->Unlock();
+
+	// Swap the in flight message in as the current one, so that the normal
+	// callback and reply handling applies to it, then put everything back.
+	Msg* currentMsg = m_currentMsg;
+	MsgQueue currentMsgQueueSource = m_currentMsgQueueSource;
+	uint8 expectedCallbackId = m_expectedCallbackId;
+	uint8 expectedReply = m_expectedReply;
+	uint8 expectedCommandClassId = m_expectedCommandClassId;
+	uint8 expectedNodeId = m_expectedNodeId;
+	bool waitingForAck = m_waitingForAck;
+	bool sendDataAccepted = m_sendDataAccepted;
+	uint8 nonceReportSent = m_nonceReportSent;
+	uint8 nonceReportSentAttempt = m_nonceReportSentAttempt;
+
+	m_currentMsg = inFlight->m_msg;
+	m_currentMsgQueueSource = inFlight->m_queue;
+	m_expectedCallbackId = inFlight->m_expectedCallbackId;
+	m_expectedReply = inFlight->m_expectedReply;
+	m_expectedCommandClassId = inFlight->m_expectedCommandClassId;
+	m_expectedNodeId = inFlight->m_expectedNodeId;
+	m_waitingForAck = false;
+	m_sendDataAccepted = true;
+	m_nonceReportSent = 0;
+	m_nonceReportSentAttempt = 0;
+
+	ProcessMsg( _data );
+
+	if( m_currentMsg != NULL )
+	{
+		// Still waiting for the reply
+		inFlight->m_msg = m_currentMsg;
+		inFlight->m_expectedCallbackId = m_expectedCallbackId;
+		inFlight->m_expectedReply = m_expectedReply;
+		inFlight->m_expectedCommandClassId = m_expectedCommandClassId;
+		inFlight->m_expectedNodeId = m_expectedNodeId;
+		m_sendMutex->Lock();
+		m_inFlight[m_currentMsg->GetCallbackId()] = inFlight;
+		m_sendMutex->Unlock();
+	}
+	else
+	{
+		delete inFlight;
+	}
+
+	m_currentMsg = currentMsg;
+	m_currentMsgQueueSource = currentMsgQueueSource;
+	m_expectedCallbackId = expectedCallbackId;
+	m_expectedReply = expectedReply;
+	m_expectedCommandClassId = expectedCommandClassId;
+	m_expectedNodeId = expectedNodeId;
+	m_waitingForAck = waitingForAck;
+	m_sendDataAccepted = sendDataAccepted;
+	m_nonceReportSent = nonceReportSent;
+	m_nonceReportSentAttempt = nonceReportSentAttempt;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CanPipelineNextMsg>
+// Check whether the next item to be sent can overlap the in flight messages
+//-----------------------------------------------------------------------------
+bool Driver::CanPipelineNextMsg
+(
+)
+{
+	if( m_currentControllerCommand != NULL )
+	{
+		return false;
+	}
+
+	bool canPipeline = true;
+	m_sendMutex->Lock();
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		if( m_msgQueue[i].empty() )
+		{
+			continue;
+		}
+
+		// This is the item the driver thread would pick next
+		MsgQueueItem const& item = m_msgQueue[i].front();
+		if( MsgQueueCmd_SendMsg == item.m_command )
+		{
+			canPipeline = item.m_msg->IsSendData() && !item.m_msg->isEncrypted() &&
+					item.m_msg->GetTargetNodeId() != 0xff && !IsNodeInFlight( item.m_msg->GetTargetNodeId() );
+		}
+		else if( MsgQueueCmd_QueryStageComplete == item.m_command )
+		{
+			canPipeline = !IsNodeInFlight( item.m_nodeId );
+		}
+		else
+		{
+			canPipeline = false;
+		}
+		break;
+	}
+	m_sendMutex->Unlock();
+	return canPipeline;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetInFlightTimeout>
+// Time in milliseconds until the first in flight message times out
+//-----------------------------------------------------------------------------
+int32 Driver::GetInFlightTimeout
+(
+)
+{
+	int32 timeout = Wait::Timeout_Infinite;
+	for( map<uint8,InFlightMsg*>::iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it )
+	{
+		int32 remaining = it->second->m_retryTimeStamp.TimeRemaining();
+		if( remaining < 0 )
+		{
+			remaining = 0;
+		}
+		if( timeout == Wait::Timeout_Infinite || remaining < timeout )
+		{
+			timeout = remaining;
+		}
+	}
+	return timeout;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeInFlight>
+// Check whether there is a message in flight to a node
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeInFlight
+(
+		uint8 const _nodeId
+)const
+{
+	for( map<uint8,InFlightMsg*>::const_iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it )
+	{
+		if( it->second->m_msg->GetTargetNodeId() == _nodeId )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::MoveMessagesToWakeUpQueue>
+// Move messages for a sleeping device to its wake-up queue
+//-----------------------------------------------------------------------------
+bool Driver::MoveMessagesToWakeUpQueue
+(
+		uint8 const _targetNodeId,
+		bool const _move
+)
+{
+	// If the target node is one that goes to sleep, transfer
+	// all messages for it to its Wake-Up queue.
+	if( Node* node = GetNodeUnsafe(_targetNodeId) )
+	{
+		if( !node->IsListeningDevice() && !node->IsFrequentListeningDevice() && _targetNodeId != m_Controller_nodeId )
+		{
+			if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+			{
+				// Mark the node as asleep
+				wakeUp->SetAwake( false );
+
+				// If we need to save the messages
+				if( _move )
+				{
+					// Move all messages for this node to the wake-up queue
+					m_sendMutex->Lock();
+
+					// See if we are working on a controller command
+					if( IsControllerCommandMsg( m_currentMsg ) )
+					{
+						// Don't save controller message as it will be recreated
+						RemoveCurrentMsg();
+					}
+
+					// Then try the current message first
+					if( m_currentMsg )
+					{
+						if( _targetNodeId == m_currentMsg->GetTargetNodeId() )
+						{
+							// This message is for the unresponsive node
+							// We do not move any "Wake Up No More Information"
+							// commands or NoOperations to the pending queue.
+							if( !m_currentMsg->IsWakeUpNoMoreInformationCommand() && !m_currentMsg->IsNoOperation() )
+							{
+								OZW_LOG( LogLevel_Info, _targetNodeId, "Node not responding - moving message to Wake-Up queue: %s", m_currentMsg->GetAsString().c_str() );
+								/* reset the sendAttempts */
+								m_currentMsg->SetSendAttempts(0);
+
+								MsgQueueItem item;
+								item.m_command = MsgQueueCmd_SendMsg;
+								item.m_msg = m_currentMsg;
+								wakeUp->QueueMsg( item );
+							}
+							else
+							{
+								delete m_currentMsg;
+							}
+
+							m_currentMsg = NULL;
+							m_expectedCallbackId = 0;
+							m_expectedCommandClassId = 0;
+							m_expectedNodeId = 0;
+							m_expectedReply = 0;
+							m_waitingForAck = false;
+						}
+					}
+
+					// Then any messages still in flight to the node
+					map<uint8,InFlightMsg*>::iterator fit = m_inFlight.begin();
+					while( fit != m_inFlight.end() )
+					{
+						Msg* msg = fit->second->m_msg;
+						if( _targetNodeId != msg->GetTargetNodeId() )
+						{
+							++fit;
+							continue;
+						}
+
+						if( !msg->IsWakeUpNoMoreInformationCommand() && !msg->IsNoOperation() )
+						{
+							OZW_LOG( LogLevel_Info, _targetNodeId, "Node not responding - moving message to Wake-Up queue: %s", msg->GetAsString().c_str() );
+							msg->SetSendAttempts(0);
+
+							MsgQueueItem item;
+							item.m_command = MsgQueueCmd_SendMsg;
+							item.m_msg = msg;
+							wakeUp->QueueMsg( item );
+						}
+						else
+						{
+							delete msg;
+						}
+						delete fit->second;
+						m_inFlight.erase( fit++ );
+					}
+
+					// Now the message queues
+					for( int i=0; i<MsgQueue_Count; ++i )
+					{
+						// Everything queued for this node is either moved or discarded
+						list<MsgQueueItem> items;
+						m_msgQueue[i].TakeNodeItems( _targetNodeId, items );
+						for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
+						{
+							MsgQueueItem const& item = *it;
+							if( MsgQueueCmd_SendMsg == item.m_command )
+							{
+								// This message is for the unresponsive node
+								// We do not move any "Wake Up No More Information"
+								// commands or NoOperations to the pending queue.
+								if( !item.m_msg->IsWakeUpNoMoreInformationCommand() && !item.m_msg->IsNoOperation() )
+								{
+									OZW_LOG( LogLevel_Info, item.m_msg->GetTargetNodeId(), "Node not responding - moving message to Wake-Up queue: %s", item.m_msg->GetAsString().c_str() );
+									/* reset any SendAttempts */
+									item.m_msg->SetSendAttempts(0);
+									wakeUp->QueueMsg( item );
+								}
+								else
+								{
+									delete item.m_msg;
+								}
+							}
+							else if( MsgQueueCmd_QueryStageComplete == item.m_command )
+							{
+								Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving QueryStageComplete command to Wake-Up queue" );
+
+								wakeUp->QueueMsg( item );
+							}
+							else if( MsgQueueCmd_Controller == item.m_command )
+							{
+								Log::Write( LogLevel_Info, _targetNodeId, "Node not responding - moving controller command to Wake-Up queue: %s", c_controllerCommandNames[item.m_cci->m_controllerCommand] );
+
+								wakeUp->QueueMsg( item );
+							}
+						}
+
+						// If the queue is now empty, we need to clear its event
+						if( m_msgQueue[i].empty() )
+						{
+							m_queueEvent[i]->Reset();
+						}
+					}
+
+					if( m_currentControllerCommand && ( IsExclusiveControllerCommand( m_currentControllerCommand->m_controllerCommand ) || m_currentControllerCommand->m_controllerCommandNode == _targetNodeId ) )
+					{
+						// Put command back on queue so it will be cleaned up
+						UpdateControllerState( ControllerState_Sleeping );
+						MsgQueueItem item;
+						item.m_command = MsgQueueCmd_Controller;
+						item.m_cci = new ControllerCommandItem( *m_currentControllerCommand );
+						m_currentControllerCommand = item.m_cci;
+						m_msgQueue[MsgQueue_Controller].push_back( item );
+						m_queueEvent[MsgQueue_Controller]->Set();
+					}
+
+					m_sendMutex->Unlock();
+
+					// Another node can be queried until this one wakes up
+					PauseInterview( _targetNodeId );
+
+					// Move completed successfully
+					return true;
+				}
+			}
+		}
+	}
+
+	// Failed to move messages
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleErrorResponse>
+// For messages that return a ZW_SEND_DATA response, process the results here
+// If it is a non-listeing (sleeping) node return true.
+//-----------------------------------------------------------------------------
+bool Driver::HandleErrorResponse
+(
+		uint8 const _error,
+		uint8 const _nodeId,
+		char const* _funcStr,
+		bool _sleepCheck	// = 0
+)
+{
+	// Only called with a ZW_SEND_DATA error response. We count and output the message here.
+	if( _error == TRANSMIT_COMPLETE_NOROUTE )
+	{
+		Count( DriverCounter_BadRoutes );
+		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. No route available.", _funcStr );
+		MarkNeighborsStale( _nodeId );
+	}
+	else if( _error == TRANSMIT_COMPLETE_NO_ACK )
+	{
+		Count( DriverCounter_NoACK );
+		Log::Write( LogLevel_Info, _nodeId, "WARNING: %s failed. No ACK received - device may be asleep.",  _funcStr );
+		if( m_currentMsg )
+		{
+			// In case the failure is due to the target being a sleeping node, we
+			// first try to move its pending messages to its wake-up queue.
+			if( MoveMessagesToWakeUpQueue( m_currentMsg->GetTargetNodeId(), _sleepCheck ) )
+			{
+				return true;
+			}
+			Log::Write( LogLevel_Warning, _nodeId, "WARNING: Device is not a sleeping node." );
+		}
+	}
+	else if( _error == TRANSMIT_COMPLETE_FAIL )
+	{
+		Count( DriverCounter_NetBusy );
+		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. Network is busy.", _funcStr );
+	}
+	else if( _error == TRANSMIT_COMPLETE_NOT_IDLE )
+	{
+		Count( DriverCounter_NotIdle );
+		Log::Write( LogLevel_Info, _nodeId, "ERROR: %s failed. Network is busy.", _funcStr );
+	}
+	if( Node* node = GetNodeUnsafe( _nodeId ) )
+	{
+		if( ++node->m_errors >= 3 )
+		{
+			node->SetNodeAlive( false );
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CheckCompletedNodeQueries>
+// Identify controller (as opposed to node) commands...especially blocking ones
+//-----------------------------------------------------------------------------
+void Driver::CheckCompletedNodeQueries
+(
+)
+{
+	Log::Write( LogLevel_Warning, "CheckCompletedNodeQueries m_allNodesQueried=%d m_awakeNodesQueried=%d", m_allNodesQueried, m_awakeNodesQueried );
+	if( !m_allNodesQueried )
+	{
+		bool all = true;
+		bool sleepingOnly = true;
+		bool deadFound = false;
+
+		{
+			WriteLockGuard LG(m_nodeMutex);
+			for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+			{
+				Node* node = m_nodes[*nit];
+				if ( node->GetCurrentQueryStage() != Node::QueryStage_Complete )
+				{
+					if( !node->IsNodeAlive() )
+					{
+						deadFound = true;
+						continue;
+					}
+					all = false;
+					if( node->IsListeningDevice() )
+					{
+						sleepingOnly = false;
+					}
+				}
+			}
+		}
+
+		Log::Write( LogLevel_Warning, "CheckCompletedNodeQueries all=%d, deadFound=%d sleepingOnly=%d", all, deadFound, sleepingOnly );
+		if( all )
+		{
+			if( deadFound )
+			{
+				// only dead nodes left to query
+				Log::Write( LogLevel_Info, "         Node query processing complete except for dead nodes." );
+				Notification* notification = new Notification( Notification::Type_AllNodesQueriedSomeDead );
+				notification->SetHomeAndNodeIds( m_homeId, 0xff );
+				QueueNotification( notification );
+			}
+			else
+			{
+				// no sleeping nodes, no dead nodes and no more nodes in the queue, so...All done
+				Log::Write( LogLevel_Info, "         Node query processing complete." );
+				Notification* notification = new Notification( Notification::Type_AllNodesQueried );
+				notification->SetHomeAndNodeIds( m_homeId, 0xff );
+				QueueNotification( notification );
+			}
+			m_awakeNodesQueried = true;
+			m_allNodesQueried = true;
+		}
+		else if( sleepingOnly )
+		{
+			if (!m_awakeNodesQueried )
+			{
+				// only sleeping nodes remain, so signal awake nodes queried complete
+				Log::Write( LogLevel_Info, "         Node query processing complete except for sleeping nodes." );
+				Notification* notification = new Notification( Notification::Type_AwakeNodesQueried );
+				notification->SetHomeAndNodeIds( m_homeId, 0xff );
+				QueueNotification( notification );
+				m_awakeNodesQueried = true;
+			}
+		}
+	}
+
+	// Once the listening nodes are ready, their clocks are set.  Those of
+	// sleeping nodes are set when they next wake.
+	if( m_timeSync && m_awakeNodesQueried )
+	{
+		bool started;
+		{
+			LockGuard HLG(m_healthMutex);
+			started = m_timeSyncStarted;
+		}
+		if( !started )
+		{
+			SyncTime();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsExpectedReply>
+// Determine if the reply is from the node we are expecting.
+//-----------------------------------------------------------------------------
+bool Driver::IsExpectedReply
+(
+		const uint8 _nodeId
+)
+{
+	// Accept all controller commands or where the protocol doesn't identify the actual node
+	if( m_expectedNodeId == 255 || _nodeId == 0 )
+	{
+		return true;
+	}
+	// Accept all messages that do not convey source node identification.
+	if( m_expectedReply == FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO ||
+			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_INFO ||
+			m_expectedReply == FUNC_ID_ZW_GET_ROUTING_INFO ||
+			m_expectedReply == FUNC_ID_ZW_ASSIGN_RETURN_ROUTE ||
+			m_expectedReply == FUNC_ID_ZW_DELETE_RETURN_ROUTE ||
+			m_expectedReply == FUNC_ID_ZW_SEND_DATA ||
+			m_expectedReply == FUNC_ID_ZW_SEND_DATA_MULTI ||
+			m_expectedReply == FUNC_ID_ZW_SEND_NODE_INFORMATION ||
+			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE ||
+			m_expectedReply == FUNC_ID_ZW_ENABLE_SUC ||
+			m_expectedReply == FUNC_ID_ZW_SET_SUC_NODE_ID ||
+			m_expectedReply == FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS )
+	{
+		return true;
+	}
+	// Accept if source message contains node info and it is from the one we are expecting
+	if( m_expectedNodeId == _nodeId )
+	{
+		return true;
+	}
+	Log::Write( LogLevel_Detail, "IsExpectedReply: m_expectedNodeId = %d m_expectedReply = %02x", m_expectedNodeId, m_expectedReply );
+	return false;
+}
+//-----------------------------------------------------------------------------
+//	Receiving Z-Wave messages
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Driver::ReadMsg>
+// Read data from the serial port
+//-----------------------------------------------------------------------------
+bool Driver::ReadMsg
+(
+)
+{
+	// Frames are processed where they lie in the controller's receive buffer.
+	// The scratch buffer is only used for a frame that wraps round its end.
+	uint8 scratch[Controller::c_maxFrameSize];
+	Controller::Frame frame;
+	if( !m_controller->ReadFrame( &frame, scratch ) )
+	{
+		// Nothing to read
+		return false;
+	}
+
+	uint8* buffer = frame.m_data;
+	uint8 type = buffer[0];
+	if( type != SOF )
+	{
+		// A single byte, which is finished with straight away
+		m_controller->ReleaseFrame( frame );
+	}
+
+	switch( type )
+	{
+		case SOF:
+		{
+			Count( DriverCounter_SOF );
+			if( m_waitingForAck )
+			{
+				// This can happen on any normal network when a transmission overlaps an unexpected
+				// reception and the data in the buffer doesn't contain the ACK. The controller will
+				// notice and send us a CAN to retransmit.
+				Log::Write( LogLevel_Detail, "Unsolicited message received while waiting for ACK." );
+				Count( DriverCounter_ACKWaiting );
+			}
+
+			// The controller's frame decoder only passes on complete frames, so the
+			// length byte and the rest of the frame are already in the stream.
+			if( frame.m_length == 0 )
+			{
+				m_controller->ReleaseFrame( frame );
+				Log::Write( LogLevel_Warning, "WARNING: Incomplete frame in the receive buffer...aborting frame read" );
+				Count( DriverCounter_ReadAborts );
+				break;
+			}
+
+			uint32 length = frame.m_length;
+			m_rxFrameAge = frame.m_age;
+
+			uint8 nodeId = NodeFromMessage( buffer );
+			if( nodeId == 0 )
+			{
+				nodeId = GetNodeNumber( m_currentMsg );
+			}
+
+			// Log the data (formatted on the stack, and only if someone will see it)
+			if( Log::IsEnabled( LogLevel_Detail, nodeId ) )
+			{
+				char str[c_maxFrameLogSize];
+				Log::Write( LogLevel_Detail, nodeId, "  Received: %s", PktToString( buffer, length, str, sizeof(str) ) );
+			}
+
+			// Verify checksum
+			if( buffer[length-1] == XorChecksum( &buffer[1], length-2 ) )
+			{
+				// Checksum correct - send ACK
+				uint8 ack = ACK;
+				m_controller->Write( &ack, 1 );
+				Count( DriverCounter_Read );
+
+				// Process the received message
+				if( !ProcessInFlightMsg( &buffer[2] ) )
+				{
+					ProcessMsg( &buffer[2] );
+				}
+				m_controller->ReleaseFrame( frame );
+			}
+			else
+			{
+				m_controller->ReleaseFrame( frame );
+				Log::Write( LogLevel_Warning, nodeId, "WARNING: Checksum incorrect - sending NAK" );
+				Count( DriverCounter_BadChecksum );
+				uint8 nak = NAK;
+				m_controller->Write( &nak, 1 );
+				m_controller->Purge();
+			}
+			m_rxFrameAge = 0;
+			break;
+		}
+
+		case CAN:
+		{
+			// This is the other side of an unsolicited ACK. As mentioned there if we receive a message
+			// just after we transmitted one, the controller will notice and tell us to retransmit here.
+			// Don't increment the transmission counter as it is possible the message will never get out
+			// on very busy networks with lots of unsolicited messages being received. Increase the amount
+			// of retries but only up to a limit so we don't stay here forever.
+			Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "CAN received...triggering resend" );
+			Count( DriverCounter_CAN );
+			if( m_currentMsg != NULL )
+			{
+				m_currentMsg->SetMaxSendAttempts( m_currentMsg->GetMaxSendAttempts() + 1 );
+			}
+			else
+			{
+				Log::Write( LogLevel_Warning, "m_currentMsg was NULL when trying to set MaxSendAttempts" );
+				Log::QueueDump();
+			}
+			WriteMsg( "CAN" );
+			break;
+		}
+
+		case NAK:
+		{
+			Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: NAK received...triggering resend" );
+			Count( DriverCounter_NAK );
+			WriteMsg( "NAK" );
+			break;
+		}
+
+		case ACK:
+		{
+			Count( DriverCounter_ACK );
+			if( m_waitingForAck )
+			{
+				m_ackLatency.Record( -m_writeTS.TimeRemaining() );
+			}
+			m_waitingForAck = false;
+			if( m_currentMsg == NULL )
+			{
+				Log::Write( LogLevel_StreamDetail, 255, "  ACK received" );
+			}
+			else
+			{
+				m_msgTrace->Record( MsgTrace::Event_Ack, m_currentMsg );
+				Log::Write( LogLevel_StreamDetail, GetNodeNumber( m_currentMsg ), "  ACK received CallbackId 0x%.2x Reply 0x%.2x", m_expectedCallbackId, m_expectedReply );
+				if( ( 0 == m_expectedCallbackId ) && ( 0 == m_expectedReply ) )
+				{
+					// Remove the message from the queue, now that it has been acknowledged.
+					RemoveCurrentMsg();
+				}
+			}
+			break;
+		}
+
+		default:
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Out of frame flow! (0x%.2x).  Sending NAK.", type );
+			Count( DriverCounter_OOF );
+			uint8 nak = NAK;
+			m_controller->Write( &nak, 1 );
+			m_controller->Purge();
+			break;
+		}
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ProcessMsg>
+// Process data received from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::ProcessMsg
+(
+		uint8* _data
+)
+{
+	bool handleCallback = true;
+	bool wasencrypted = false;
+	//uint8 nodeId = GetNodeNumber( m_currentMsg );
+
+	// The segments of a datagram are put back together before anything else looks at
+	// it, so that it is decrypted and matched to a request as if it came in one frame
+	uint8 datagram[TransportService::c_maxDatagram + 6];
+	if( ( REQUEST == _data[0] ) && ( FUNC_ID_APPLICATION_COMMAND_HANDLER == _data[1] ) &&
+			( TransportService::StaticGetCommandClassId() == _data[5] ) )
+	{
+		ReadLockGuard LG(m_nodeMutex);
+		Node* node = GetNode( _data[3] );
+		if( TransportService* cc = node ? static_cast<TransportService*>( node->GetCommandClass( TransportService::StaticGetCommandClassId() ) ) : NULL )
+		{
+			uint32 length = 0;
+			if( !cc->HandleSegment( &_data[6], _data[4], &datagram[5], length ) )
+			{
+				return;
+			}
+			memcpy( datagram, _data, 4 );
+			datagram[4] = (uint8)length;
+			_data = datagram;
+		}
+	}
+
+	if ((REQUEST == _data[0]) &&
+			(Security::StaticGetCommandClassId() == _data[5])) {
+		/* if this message is a NONCE Report - Then just Trigger the Encrypted Send */
+		if (SecurityCmd_NonceReport == _data[6]) {
+			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceReport from node %d", _data[3] );
+
+			if (m_noncePrefetch && m_nonceRequested != _data[3]) {
+				/* we didn't ask for this one, so the node has sent it along with the reply
+				 * to a MessageEncapNonceGet.  Keep it for its next message. */
+				PrefetchedNonce& prefetched = m_prefetchedNonces[_data[3]];
+				memcpy(prefetched.m_nonce, &_data[7], 8);
+				prefetched.m_expires.SetTime(c_prefetchedNonceLifetime);
+				prefetched.m_valid = true;
+				Log::Write(LogLevel_Detail, _data[3], "Keeping the nonce for the next message");
+				return;
+			}
+			m_nonceRequested = 0;
+
+			/* handle possible resends of NONCE_REPORT messages.... See Issue #931 */
+			if (!m_currentMsg) {
+				Log::Write(LogLevel_Warning, _data[3], "Received a NonceReport from node, but no pending messages. Dropping..");
+				return;
+			}
+
+			// No Need to triger a WriteMsg here - It should be handled automatically
+			m_msgTrace->Record( MsgTrace::Event_NonceReport, m_currentMsg );
+			m_currentMsg->setNonce(&_data[7]);
+			this->SendEncryptedMessage();
+			return;
+
+			/* if this is a NONCE Get - Then call to the CC directly, process it, and then bail out. */
+		} else if (SecurityCmd_NonceGet == _data[6]) {
+			Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_NonceGet from node %d", _data[3] );
+			{
+				uint8 *nonce = NULL;
+				WriteLockGuard LG(m_nodeMutex);
+				Node* node = GetNode( _data[3] );
+				if( node ) {
+					nonce = node->GenerateNonceKey();
+				} else {
+					Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
+					return;
+				}
+
+				SendNonceKey(_data[3], nonce);
+
+			}
+			/* don't continue processing */
+			return;
+
+			/* if this message is encrypted, decrypt it first */
+		} else if ((SecurityCmd_MessageEncap == _data[6]) || (SecurityCmd_MessageEncapNonceGet == _data[6])) {
+			uint8 _newdata[256];
+			uint8 SecurityCmd = _data[6];
+			uint8 *_nonce;
+
+			/* clear out NONCE Report tracking */
+			m_nonceReportSent = 0;
+			m_nonceReportSentAttempt = 0;
+
+			/* make sure the Node Exists, and it has the Security CC */
+			{
+				WriteLockGuard LG(m_nodeMutex);
+				Node* node = GetNode( _data[3] );
+				if( node ) {
+					_nonce = node->GetNonceKey(_data[_data[4]-4]);
+					if (!_nonce) {
+						Log::Write(LogLevel_Warning, _data[3], "Could Not Retrieve Nonce for Node %d", _data[3]);
+						return;
+					}
+				} else {
+					Log::Write(LogLevel_Warning, _data[3], "Can't Find Node %d for Encrypted Message", _data[3]);
+					return;
+				}
+			}
+			if (DecryptBuffer(&_data[5], _data[4]+1, this, _data[3], this->GetControllerNodeId(), _nonce, &_newdata[0])) {
+				/* Ok - _newdata now contains the decrypted packet */
+				/* copy it back to the _data packet for processing */
+				/* New Length - See Decrypt Packet for why these numbers*/
+				_data[4] = _data[4] - 8 - 8 - 2 - 2;
+
+				/* now copy the decrypted packet */
+				memcpy(&_data[5], &_newdata[1], _data[4]);
+				//PrintHex("Decrypted Packet", _data, _data[4]+5);
+
+				/* if the Node has something else to send, it will encrypt a message and send it as a MessageEncapNonceGet */
+				if (SecurityCmd_MessageEncapNonceGet == SecurityCmd )
+				{
+				    Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_MessageEncapNonceGet from node %d - Sending New Nonce", _data[3] );
+				    WriteLockGuard LG(m_nodeMutex);
+				    Node* node = GetNode( _data[3] );
+				    if( node ) {
+				        _nonce = node->GenerateNonceKey();
+				    } else {
+				        Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
+				        return;
+				    }
+				    SendNonceKey(_data[3], _nonce);
+				}
+
+				wasencrypted = true;
+
+			} else {
+			    /* if the Node has something else to send, it will encrypt a message and send it as a MessageEncapNonceGet */
+			    if (SecurityCmd_MessageEncapNonceGet == SecurityCmd )
+			    {
+			        Log::Write(LogLevel_Info,  _data[3], "Received SecurityCmd_MessageEncapNonceGet from node %d - Sending New Nonce", _data[3] );
+			        WriteLockGuard LG(m_nodeMutex);
+			        Node* node = GetNode( _data[3] );
+			        if( node ) {
+			            _nonce = node->GenerateNonceKey();
+			        } else {
+			            Log::Write(LogLevel_Warning, _data[3], "Couldn't Generate Nonce Key for Node %d", _data[3]);
+			            return;
+			        }
+			        SendNonceKey(_data[3], _nonce);
+			    }
+				/* it failed for some reason, lets just move on */
+				m_expectedReply = 0;
+				m_expectedNodeId = 0;
+				RemoveCurrentMsg();
+				return;
+			}
+		}
+	}
+
+
+	if( RESPONSE == _data[0] )
+	{
+		switch( _data[1] )
+		{
+			case FUNC_ID_SERIAL_API_GET_INIT_DATA:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSerialAPIGetInitDataResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetControllerCapabilitiesResponse( _data );
+				break;
+			}
+			case FUNC_ID_SERIAL_API_GET_CAPABILITIES:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetSerialAPICapabilitiesResponse( _data );
+				break;
+			}
+			case FUNC_ID_SERIAL_API_SOFT_RESET:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSerialAPISoftResetResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SEND_DATA:
+			{
+				HandleSendDataResponse( _data, false );
+				handleCallback = false;			// Skip the callback handling - a subsequent FUNC_ID_ZW_SEND_DATA request will deal with that
+				break;
+			}
+			case FUNC_ID_ZW_GET_VERSION:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetVersionResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_GET_RANDOM:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetRandomResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_MEMORY_GET_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleMemoryGetIdResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetNodeProtocolInfoResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SEND_DATA_MULTI:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( _data[2] )
+				{
+					Log::Write( LogLevel_Info, "Received reply to FUNC_ID_ZW_SEND_DATA_MULTI - command accepted" );
+				}
+				else
+				{
+					// The callback won't be coming, so the reply completes the transaction
+					Log::Write( LogLevel_Warning, "WARNING: Received reply to FUNC_ID_ZW_SEND_DATA_MULTI - command rejected" );
+					m_expectedCallbackId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_REPLICATION_SEND_DATA:
+			{
+				HandleSendDataResponse( _data, true );
+				handleCallback = false;			// Skip the callback handling - a subsequent FUNC_ID_ZW_REPLICATION_SEND_DATA request will deal with that
+				break;
+			}
+			case FUNC_ID_ZW_ASSIGN_RETURN_ROUTE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleAssignReturnRouteResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];		// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_DELETE_RETURN_ROUTE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleDeleteReturnRouteResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];		// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_ENABLE_SUC:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleEnableSUCResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REQUEST_NETWORK_UPDATE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleNetworkUpdateResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_SET_SUC_NODE_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSetSUCNodeIdResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_GET_SUC_NODE_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetSUCNodeIdResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REQUEST_NODE_INFO:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( _data[2] )
+				{
+					Log::Write( LogLevel_Info, _data[3], "FUNC_ID_ZW_REQUEST_NODE_INFO Request successful." );
+				}
+				else
+				{
+					Log::Write( LogLevel_Info, _data[3], "FUNC_ID_ZW_REQUEST_NODE_INFO Request failed." );
+				}
+				break;
+			}
+			case FUNC_ID_ZW_REMOVE_FAILED_NODE_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleRemoveFailedNodeResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_IS_FAILED_NODE_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleIsFailedNodeResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REPLACE_FAILED_NODE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleReplaceFailedNodeResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_GET_ROUTING_INFO:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetRoutingInfoResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_R_F_POWER_LEVEL_SET:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleRfPowerLevelSetResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_READ_MEMORY:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleReadMemoryResponse( _data );
+				break;
+			}
+			case FUNC_ID_SERIAL_API_SET_TIMEOUTS:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSerialApiSetTimeoutsResponse( _data );
+				break;
+			}
+			case FUNC_ID_MEMORY_GET_BYTE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleMemoryGetByteResponse( _data );
+				break;
+			}
+			case FUNC_ID_NVM_GET_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleNvmGetIdResponse( _data );
+				break;
+			}
+			case FUNC_ID_NVM_EXT_READ_LONG_BUFFER:
+			{
+				HandleNvmReadResponse( _data );
+				break;
+			}
+			case FUNC_ID_NVM_EXT_WRITE_LONG_BUFFER:
+			{
+				HandleNvmWriteResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_GET_VIRTUAL_NODES:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleGetVirtualNodesResponse( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SET_SLAVE_LEARN_MODE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleSetSlaveLearnModeResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			case FUNC_ID_ZW_SEND_SLAVE_NODE_INFO:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( !HandleSendSlaveNodeInfoResponse( _data ) )
+				{
+					m_expectedCallbackId = _data[2];	// The callback message won't be coming, so we force the transaction to complete
+					m_expectedReply = 0;
+					m_expectedCommandClassId = 0;
+					m_expectedNodeId = 0;
+				}
+				break;
+			}
+			default:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				Log::Write( LogLevel_Info, "**TODO: handle response for 0x%.2x** Please report this message.", _data[1] );
+				break;
+			}
+		}
+	}
+	else if( REQUEST == _data[0] )
+	{
+		switch( _data[1] )
+		{
+			case FUNC_ID_APPLICATION_COMMAND_HANDLER:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( IsStandby() )
+				{
+					// The nodes belong to the primary.  This driver still
+					// matches the frame to the reply it is waiting for, below.
+					m_group->Forward( this, _data, wasencrypted );
+				}
+				else
+				{
+					HandleApplicationCommandHandlerRequest( _data, wasencrypted );
+				}
+				break;
+			}
+			case FUNC_ID_ZW_SEND_DATA:
+			{
+				HandleSendDataRequest( _data, false );
+				break;
+			}
+			case FUNC_ID_ZW_SEND_DATA_MULTI:
+			{
+				// Multicasts are not acknowledged, so this only says whether the frame was sent
+				Log::Write( LogLevel_Detail, "" );
+				if( TRANSMIT_COMPLETE_OK == _data[3] )
+				{
+					Log::Write( LogLevel_Info, "FUNC_ID_ZW_SEND_DATA_MULTI Request with callback ID 0x%.2x received - multicast sent", _data[2] );
+				}
+				else
+				{
+					Log::Write( LogLevel_Warning, "WARNING: FUNC_ID_ZW_SEND_DATA_MULTI Request with callback ID 0x%.2x received - multicast failed (status 0x%.2x)", _data[2], _data[3] );
+				}
+				break;
+			}
+			case FUNC_ID_ZW_REPLICATION_COMMAND_COMPLETE:
+			{
+				if( m_controllerReplication )
+				{
+					Log::Write( LogLevel_Detail, "" );
+					m_controllerReplication->SendNextData();
+				}
+				break;
+			}
+			case FUNC_ID_ZW_REPLICATION_SEND_DATA:
+			{
+				HandleSendDataRequest( _data, true );
+				break;
+			}
+			case FUNC_ID_ZW_ASSIGN_RETURN_ROUTE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleAssignReturnRouteRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_DELETE_RETURN_ROUTE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleDeleteReturnRouteRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SEND_NODE_INFORMATION:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSendNodeInformationRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE:
+			case FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleNodeNeighborUpdateRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_APPLICATION_UPDATE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				if( IsStandby() )
+				{
+					// Node information is for the primary, which has the nodes
+					Log::Write( LogLevel_Detail, "Ignoring an application update, as another controller has the nodes" );
+					break;
+				}
+				handleCallback = !HandleApplicationUpdateRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_ADD_NODE_TO_NETWORK:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleAddNodeToNetworkRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleRemoveNodeFromNetworkRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_CREATE_NEW_PRIMARY:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleCreateNewPrimaryRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_CONTROLLER_CHANGE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleControllerChangeRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SET_LEARN_MODE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSetLearnModeRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REQUEST_NETWORK_UPDATE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleNetworkUpdateRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REMOVE_FAILED_NODE_ID:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleRemoveFailedNodeRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_REPLACE_FAILED_NODE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleReplaceFailedNodeRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SET_SLAVE_LEARN_MODE:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSetSlaveLearnModeRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SEND_SLAVE_NODE_INFO:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSendSlaveNodeInfoRequest( _data );
+				break;
+			}
+			case FUNC_ID_APPLICATION_SLAVE_COMMAND_HANDLER:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleApplicationSlaveCommandRequest( _data );
+				break;
+			}
+			case FUNC_ID_PROMISCUOUS_APPLICATION_COMMAND_HANDLER:
+			{
+				HandlePromiscuousApplicationCommandHandlerRequest( _data );
+				break;
+			}
+			case FUNC_ID_ZW_SET_DEFAULT:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				HandleSerialAPIResetRequest( _data );
+				break;
+			}
+			default:
+			{
+				Log::Write( LogLevel_Detail, "" );
+				Log::Write( LogLevel_Info, "**TODO: handle request for 0x%.2x** Please report this message.", _data[1] );
+				break;
+			}
+		}
+	}
+
+	// Generic callback handling
+	if( handleCallback )
+	{
+		if( ( m_expectedCallbackId || m_expectedReply ) )
+		{
+			if( m_expectedCallbackId )
+			{
+				if( m_expectedCallbackId == _data[2] )
+				{
+					Log::Write( LogLevel_Detail, _data[3], "  Expected callbackId was received" );
+					m_msgTrace->Record( MsgTrace::Event_Callback, m_currentMsg );
+					m_expectedCallbackId = 0;
+				} else if (_data[2] == 0x02 || _data[2] == 0x01) {
+					/* it was a NONCE request/reply. Drop it */
+					return;
+				}
+			}
+			if( m_expectedReply )
+			{
+				if( m_expectedReply == _data[1] )
+				{
+					if( m_expectedCommandClassId && ( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER ) )
+					{
+						if( m_expectedCallbackId == 0 && m_expectedCommandClassId == _data[5] && m_expectedNodeId == _data[3] )
+						{
+							Log::Write( LogLevel_Detail, _data[3], "  Expected reply and command class was received" );
+							m_msgTrace->Record( MsgTrace::Event_Response, m_currentMsg );
+							m_waitingForAck = false;
+							m_expectedReply = 0;
+							m_expectedCommandClassId = 0;
+							m_expectedNodeId = 0;
+						}
+					}
+					else
+					{
+						if( IsExpectedReply( _data[3] ) )
+
+						{
+							Log::Write( LogLevel_Detail, _data[3], "  Expected reply was received" );
+							m_msgTrace->Record( MsgTrace::Event_Response, m_currentMsg );
+							m_expectedReply = 0;
+							m_expectedNodeId = 0;
+						}
+					}
+				}
+			}
+			if( !( m_expectedCallbackId || m_expectedReply ) )
+			{
+				Log::Write( LogLevel_Detail, _data[3], "  Message transaction complete" );
+				Log::Write( LogLevel_Detail, "" );
+
+				if( m_notifytransactions )
+				{
+					Notification* notification = new Notification( Notification::Type_Notification );
+					notification->SetHomeAndNodeIds( m_homeId, _data[3] );
+					notification->SetNotification( Notification::Code_MsgComplete );
+					QueueNotification( notification );
+				}
+				RemoveCurrentMsg();
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetVersionResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetVersionResponse
+(
+		uint8* _data
+)
+{
+	m_libraryVersion = (char*)&_data[2];
+
+	m_libraryType = _data[m_libraryVersion.size()+3];
+	if( m_libraryType < 9 )
+	{
+		m_libraryTypeName = c_libraryTypeNames[m_libraryType];
+	}
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_VERSION:" );
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    %s library, version %s", m_libraryTypeName.c_str(), m_libraryVersion.c_str() );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetRandomResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+
+void Driver::HandleGetRandomResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_RANDOM: %s", _data[2] ? "true" : "false" );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetControllerCapabilitiesResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetControllerCapabilitiesResponse
+(
+		uint8* _data
+)
+{
+	m_controllerCaps = _data[2];
+
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:" );
+
+	char str[256];
+	if( m_controllerCaps & ControllerCaps_SIS )
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    There is a SUC ID Server (SIS) in this network." );
+		snprintf( str, sizeof(str), "    The PC controller is an inclusion %s%s%s",
+				( m_controllerCaps & ControllerCaps_SUC ) ? "static update controller (SUC)" : "controller",
+						( m_controllerCaps & ControllerCaps_OnOtherNetwork ) ? " which is using a Home ID from another network" : "",
+								( m_controllerCaps & ControllerCaps_RealPrimary ) ? " and was the original primary before the SIS was added." : "." );
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), str );
+
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    There is no SUC ID Server (SIS) in this network." );
+		snprintf( str, sizeof(str), "    The PC controller is a %s%s%s",
+				( m_controllerCaps & ControllerCaps_Secondary ) ? "secondary" : "primary",
+						( m_controllerCaps & ControllerCaps_SUC ) ? " static update controller (SUC)" : " controller",
+								( m_controllerCaps & ControllerCaps_OnOtherNetwork ) ? " which is using a Home ID from another network." : "." );
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), str );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetSerialAPICapabilitiesResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetSerialAPICapabilitiesResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), " Received reply to FUNC_ID_SERIAL_API_GET_CAPABILITIES" );
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Serial API Version:   %d.%d", _data[2], _data[3] );
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Manufacturer ID:      0x%.2x%.2x", _data[4], _data[5] );
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Product Type:         0x%.2x%.2x", _data[6], _data[7] );
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Product ID:           0x%.2x%.2x", _data[8], _data[9] );
+
+	// _data[10] to _data[41] are a 256-bit bitmask with one bit set for
+	// each FUNC_ID_ method supported by the controller.
+	// Bit 0 is FUNC_ID_ 1.  So FUNC_ID_SERIAL_API_GET_CAPABILITIES (0x07) will be bit 6 of the first byte.
+	m_serialAPIVersion[0] = _data[2];
+	m_serialAPIVersion[1] = _data[3];
+	m_manufacturerId = ( ( (uint16)_data[4] )<<8) | (uint16)_data[5];
+	m_productType = ( ( (uint16)_data[6] )<<8 ) | (uint16)_data[7];
+	m_productId = ( ( (uint16)_data[8] )<<8 ) | (uint16)_data[9];
+	memcpy( m_apiMask, &_data[10], sizeof( m_apiMask ) );
+	if( m_initCache == InitCache_Recheck )
+	{
+		// The init data has been handled already
+		m_initCache = InitCache_Off;
+		return;
+	}
+	QueueInitData();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::QueueInitData>
+// Once the Serial API capabilities are known, ask for the init data and
+// set the controller up
+//-----------------------------------------------------------------------------
+void Driver::QueueInitData
+(
+)
+{
+	if( IsBridgeController() )
+	{
+		SendMsg( new Msg( "FUNC_ID_ZW_GET_VIRTUAL_NODES", 0xff, REQUEST, FUNC_ID_ZW_GET_VIRTUAL_NODES, false ), MsgQueue_Command);
+	}
+	else if( IsAPICallSupported( FUNC_ID_ZW_GET_RANDOM ) )
+
+	{
+		Msg *msg = new Msg( "FUNC_ID_ZW_GET_RANDOM", 0xff, REQUEST, FUNC_ID_ZW_GET_RANDOM, false );
+		msg->Append( 32 );      // 32 bytes
+		SendMsg( msg, MsgQueue_Command );
+	}
+	SendMsg( new Msg( "FUNC_ID_SERIAL_API_GET_INIT_DATA", 0xff, REQUEST, FUNC_ID_SERIAL_API_GET_INIT_DATA, false ), MsgQueue_Command);
+	if( !IsBridgeController() )
+	{
+		Msg* msg = new Msg( "FUNC_ID_SERIAL_API_SET_TIMEOUTS", 0xff, REQUEST, FUNC_ID_SERIAL_API_SET_TIMEOUTS, false );
+		msg->Append( ACK_TIMEOUT / 10 );
+		msg->Append( BYTE_TIMEOUT / 10 );
+		SendMsg( msg, MsgQueue_Command );
+	}
+	Msg* msg = new Msg( "FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION", 0xff, REQUEST, FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION, false, false );
+	msg->Append( APPLICATION_NODEINFO_LISTENING );
+	msg->Append( 0x02 );			// Generic Static Controller
+	msg->Append( 0x01 );			// Specific Static PC Controller
+	msg->Append( 0x00 );			// Length
+	SendMsg( msg, MsgQueue_Command );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSerialAPISoftResetResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSerialAPISoftResetResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to Soft Reset." );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSerialAPIResetRequest>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSerialAPIResetRequest
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to complete Controller Reset." );
+	if( m_controllerResetEvent != NULL )
+	{
+		m_controllerResetEvent->Set();
+		m_controllerResetEvent = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleEnableSUCResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleEnableSUCResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to Enable SUC." );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleNetworkUpdateResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleNetworkUpdateResponse
+(
+		uint8* _data
+)
+{
+	bool res = true;
+	ControllerState state = ControllerState_InProgress;
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE - command in progress" );
+	}
+	else
+	{
+		// Failed
+		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE - command failed"  );
+		state = ControllerState_Failed;
+		res = false;
+	}
+
+	UpdateControllerState( state );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSetSUCNodeIdResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSetSUCNodeIdResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to SET_SUC_NODE_ID." );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetSUCNodeIdResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetSUCNodeIdResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to GET_SUC_NODE_ID.  Node ID = %d", _data[2] );
+	m_SUCNodeId = _data[2];
+	if( _data[2] == 0)
+	{
+		bool enableSIS = true;
+		Options::Get()->GetOptionAsBool("EnableSIS", &enableSIS);
+		if (enableSIS) {
+			if (IsAPICallSupported(FUNC_ID_ZW_ENABLE_SUC) && IsAPICallSupported(FUNC_ID_ZW_SET_SUC_NODE_ID)) {
+				Log::Write( LogLevel_Info, "  No SUC, so we become SIS" );
+
+				Msg* msg;
+				msg = new Msg( "Enable SUC", m_Controller_nodeId, REQUEST, FUNC_ID_ZW_ENABLE_SUC, false );
+				msg->Append( 1 );
+				msg->Append( SUC_FUNC_NODEID_SERVER );		// SIS; SUC would be ZW_SUC_FUNC_BASIC_SUC
+				SendMsg( msg, MsgQueue_Send );
+
+				msg = new Msg( "Set SUC node ID", m_Controller_nodeId, REQUEST, FUNC_ID_ZW_SET_SUC_NODE_ID, false );
+				msg->Append( m_Controller_nodeId );
+				msg->Append( 1 );								// TRUE, we want to be SUC/SIS
+				msg->Append( 0 );								// no low power
+				msg->Append( SUC_FUNC_NODEID_SERVER );
+				SendMsg( msg, MsgQueue_Send );
+			} else {
+				Log::Write (LogLevel_Info, "Controller Does not Support SUC - Cannot Setup Controller as SUC Node");
+			}
+		} else {
+			Log::Write( LogLevel_Info, "  No SUC, not becoming SUC as option is disabled" );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleMemoryGetIdResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleMemoryGetIdResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_MEMORY_GET_ID. Home ID = 0x%02x%02x%02x%02x.  Our node ID = %d", _data[2], _data[3], _data[4], _data[5], _data[6] );
+	if( m_reconnectCheck )
+	{
+		uint32 homeId = ( ( (uint32)_data[2] )<<24 ) | ( ( (uint32)_data[3] )<<16 ) | ( ( (uint32)_data[4] )<<8 ) | ( (uint32)_data[5] );
+		if( homeId != m_homeId || _data[6] != m_Controller_nodeId )
+		{
+			// Another controller has been plugged in, so the network known to the driver is not this one
+			Log::Write( LogLevel_Error, "ERROR: The controller that came back is not the one that was lost" );
+			m_reconnectCheck = false;
+			Notification* notification = new Notification( Notification::Type_DriverFailed );
+			notification->SetHomeAndNodeIds( m_homeId, 0 );
+			QueueNotification( notification );
+			NotifyWatchers();
+
+			m_driverThread->Stop();
+			return;
+		}
+
+		// The same network, so on to its node list.  The controller's own settings are lost if it was reset, so they go again too.
+		QueueInitData();
+		return;
+	}
+	m_homeId = ( ( (uint32)_data[2] )<<24 ) | ( ( (uint32)_data[3] )<<16 ) | ( ( (uint32)_data[4] )<<8 ) | ( (uint32)_data[5] );
+	m_Controller_nodeId = _data[6];
+	m_controllerReplication = static_cast<ControllerReplication*>(ControllerReplication::Create( m_homeId, m_Controller_nodeId ));
+
+	if( m_initCache == InitCache_Try )
+	{
+		if( ReadCachedControllerInit() )
+		{
+			// Straight on to the init data, which will show whether the identity is still good
+			m_initCache = InitCache_Used;
+			SendMsg( new Msg( "FUNC_ID_ZW_GET_SUC_NODE_ID", 0xff, REQUEST, FUNC_ID_ZW_GET_SUC_NODE_ID, false ), MsgQueue_Command );
+			QueueInitData();
+		}
+		else
+		{
+			m_initCache = InitCache_Off;
+			QueueIdentityRequests();
+			SendMsg( new Msg( "FUNC_ID_ZW_GET_SUC_NODE_ID", 0xff, REQUEST, FUNC_ID_ZW_GET_SUC_NODE_ID, false ), MsgQueue_Command );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleReconnect>
+// The controller has been opened again after it failed.  Whatever it was
+// doing has been lost, so the messages waiting on it are sent again, once
+// it has been checked to be the same controller.
+//-----------------------------------------------------------------------------
+void Driver::HandleReconnect
+(
+)
+{
+	bool hotReconnect = false;
+	Options::Get()->GetOptionAsBool( "HotReconnect", &hotReconnect );
+	m_controllerLost = false;
+	if( !hotReconnect || !m_init )
+	{
+		return;
+	}
+	Log::Write( LogLevel_Info, "The controller is back, checking it is the same one" );
+
+	// Start afresh, as Init does
+	uint8 nak = NAK;
+	m_controller->Write( &nak, 1 );
+
+	// The callbacks still to come will not, so the messages waiting for them are due again now
+	m_sendMutex->Lock();
+	for( map<uint8,InFlightMsg*>::iterator it = m_inFlight.begin(); it != m_inFlight.end(); ++it )
+	{
+		it->second->m_retryTimeStamp.SetTime( 0 );
+	}
+	m_sendMutex->Unlock();
+
+	// The current message goes back to the front of its queue, for after the checks
+	if( m_currentMsg != NULL && m_currentControllerCommand == NULL && !m_currentMsg->isEncrypted() && m_nonceReportSent == 0 )
+	{
+		uint8 attempts = m_currentMsg->GetSendAttempts();
+		if( attempts > 0 )
+		{
+			m_currentMsg->SetSendAttempts( attempts - 1 );
+		}
+		m_waitingForAck = false;
+		DeferCurrentMsg();
+	}
+
+	m_reconnectCheck = true;
+	SendMsg( new Msg( "FUNC_ID_ZW_MEMORY_GET_ID", 0xff, REQUEST, FUNC_ID_ZW_MEMORY_GET_ID, false ), MsgQueue_Command );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::QueueIdentityRequests>
+// Ask the controller for the identity that CachedControllerInit can save
+//-----------------------------------------------------------------------------
+void Driver::QueueIdentityRequests
+(
+)
+{
+	SendMsg( new Msg( "FUNC_ID_ZW_GET_VERSION", 0xff, REQUEST, FUNC_ID_ZW_GET_VERSION, false ), MsgQueue_Command );
+	SendMsg( new Msg( "FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES", 0xff, REQUEST, FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES, false ), MsgQueue_Command );
+	SendMsg( new Msg( "FUNC_ID_SERIAL_API_GET_CAPABILITIES", 0xff, REQUEST, FUNC_ID_SERIAL_API_GET_CAPABILITIES, false ), MsgQueue_Command );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSerialAPIGetInitDataResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSerialAPIGetInitDataResponse
+(
+		uint8* _data
+)
+{
+	if( m_reconnectCheck )
+	{
+		m_reconnectCheck = false;
+		if( _data[4] == NUM_NODE_BITFIELD_BYTES && !memcmp( &_data[5], m_initNodeMask, NUM_NODE_BITFIELD_BYTES ) )
+		{
+			Log::Write( LogLevel_Info, "The controller is back with the same nodes, carrying on" );
+			return;
+		}
+		Log::Write( LogLevel_Warning, "WARNING: The controller came back with a different node list, so reading it again" );
+	}
+
+	if( !m_init && Manager::Get()->JoinControllerGroup( this ) )
+	{
+		// Another controller of this network already has the nodes.  This one
+		// only carries messages for it, so it reads no configuration and
+		// interviews no one.
+		Log::Write( LogLevel_Info, "Controller %s is a standby for Home ID 0x%.8x", m_controllerPath.c_str(), m_homeId );
+		m_init = true;
+		return;
+	}
+
+	if( !m_init )
+	{
+		// Mark the driver as ready (we have to do this first or
+		// all the code handling notifications will go awry).
+		Manager::Get()->SetDriverReady( this, true );
+
+		// Values take their places in the shared table as they are created
+		string exportPath;
+		Options::Get()->GetOptionAsString( "ValueExportPath", &exportPath );
+		if( !exportPath.empty() && !m_valueExport )
+		{
+			int32 slots = 4096;
+			Options::Get()->GetOptionAsInt( "ValueExportSlots", &slots );
+			if( slots > 0 )
+			{
+				m_valueExport = ValueExport::Create( exportPath, m_homeId, (uint32)slots );
+			}
+		}
+
+		// Read the config file first, to get the last known state
+		uint64 start = TimeStamp::GetTicksNs();
+		ReadConfig();
+		AtomicStore( &m_configReadTime, (uint32)( ( TimeStamp::GetTicksNs() - start ) / 1000 ) );
+		PreloadConfigXML();
+		OpenValueLog();
+	}
+	else
+	{
+		// Notify the user that all node and value information has been deleted
+		// We need to wait to do this here so we have new information to report.
+		Notification* notification = new Notification( Notification::Type_DriverReset );
+		notification->SetHomeAndNodeIds( m_homeId, 0 );
+		QueueNotification( notification );
+	}
+
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_SERIAL_API_GET_INIT_DATA:" );
+
+	// A cached identity is only trusted while the controller still reports the
+	// same capabilities and nodes as when it was saved
+	bool stale = false;
+	if( m_initCache == InitCache_Used )
+	{
+		stale = ( _data[2] != m_initVersion ) || ( _data[3] != m_initCaps ) || ( _data[4] != NUM_NODE_BITFIELD_BYTES ) || memcmp( &_data[5], m_initNodeMask, NUM_NODE_BITFIELD_BYTES );
+	}
+
+	m_initVersion = _data[2];
+	m_initCaps = _data[3];
+
+	if( _data[4] == NUM_NODE_BITFIELD_BYTES )
+	{
+		memcpy( m_initNodeMask, &_data[5], NUM_NODE_BITFIELD_BYTES );
+		NodeSet nodes( &_data[5] );
+
+		// Nodes that are no longer in the Z-Wave network
+		vector<uint16> known;
+		{
+			ReadLockGuard LG(m_nodeMutex);
+			known = m_nodeIds;
+		}
+		for( vector<uint16>::const_iterator it = known.begin(); it != known.end(); ++it )
+		{
+			if( *it > NUM_NODE_BITFIELD_BYTES*8 || nodes.Contains( (uint8)*it ) )
+			{
+				continue;
+			}
+			uint8 nodeId = (uint8)*it;
+			WriteLockGuard LG(m_nodeMutex);
+			if( GetNode(nodeId) )
+			{
+				// This node no longer exists in the Z-Wave network
+				Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Removed", nodeId );
+				SetNodeObject( nodeId, NULL );
+				Notification* notification = new Notification( Notification::Type_NodeRemoved );
+				notification->SetHomeAndNodeIds( m_homeId, nodeId );
+				QueueNotification( notification );
+			}
+		}
+
+		uint32 position = 0;
+		InstanceAssociation member;
+		while( nodes.GetNext( position, &member ) )
+		{
+			uint8 nodeId = member.m_nodeId;
+			if( IsVirtualNode( nodeId ) )
+			{
+				Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Virtual (ignored)", nodeId );
+			}
+			else
+			{
+				WriteLockGuard LG(m_nodeMutex);
+				Node* node = GetNode( nodeId );
+				if( node )
+				{
+					Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Known", nodeId );
+					if( !m_init && node->m_handedOver )
+					{
+						// The previous process had finished querying it
+						// moments ago, so its values are still current
+						node->m_handedOver = false;
+						node->m_queryStage = Node::QueryStage_Complete;
+						node->AdvanceQueries();
+					}
+					else if( !m_init )
+					{
+						// The node was read in from the config, so we
+						// only need to get its current state
+						node->SetQueryStage( Node::QueryStage_CacheLoad );
+					}
+
+				}
+				else
+				{
+					// This node is new
+					Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - New", nodeId );
+					Notification* notification = new Notification( Notification::Type_NodeNew );
+					notification->SetHomeAndNodeIds( m_homeId, nodeId );
+					QueueNotification( notification );
+
+					// Create the node and request its info
+					InitNode( nodeId );
+				}
+			}
+		}
+	}
+
+	if( m_initCache == InitCache_Used )
+	{
+		if( stale )
+		{
+			Log::Write( LogLevel_Info, "The controller or its nodes have changed since its identity was saved, so it will be asked for again" );
+			m_initCache = InitCache_Recheck;
+			QueueIdentityRequests();
+		}
+		else
+		{
+			Log::Write( LogLevel_Info, "The saved controller identity is still good" );
+			m_initCache = InitCache_Off;
+		}
+	}
+
+	// Messages handed over by the previous process, for the nodes that are still there
+	while( !m_handoffMsgs.empty() )
+	{
+		Msg* msg = m_handoffMsgs.front();
+		m_handoffMsgs.pop_front();
+		if( GetNodeUnsafe( msg->GetTargetNodeId() ) )
+		{
+			SendMsg( msg, MsgQueue_Send );
+		}
+		else
+		{
+			delete msg;
+		}
+	}
+
+	m_init = true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetNodeProtocolInfoResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetNodeProtocolInfoResponse
+(
+		uint8* _data
+)
+{
+	// The node that the protocol info response is for is not included in the message.
+	// We have to assume that the node is the same one as in the most recent request.
+	if( !m_currentMsg )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Received unexpected FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO message - ignoring.");
+		return;
+	}
+
+	uint8 nodeId = m_currentMsg->GetTargetNodeId();
+	Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO" );
+
+	// Update the node with the protocol info
+	if( Node* node = GetNodeUnsafe( nodeId ) )
+	{
+		node->UpdateProtocolInfo( &_data[2] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleAssignReturnRouteResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleAssignReturnRouteResponse
+(
+		uint8* _data
+)
+{
+	bool res = true;
+	ControllerState state = ControllerState_InProgress;
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE - command in progress" );
+	}
+	else
+	{
+		// Failed
+		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE - command failed" );
+		state = ControllerState_Failed;
+		res = false;
+	}
+
+	UpdateControllerState( state );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleDeleteReturnRouteResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleDeleteReturnRouteResponse
+(
+		uint8* _data
+)
+{
+	bool res = true;
+	ControllerState state = ControllerState_InProgress;
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE - command in progress" );
+	}
+	else
+	{
+		// Failed
+		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE - command failed" );
+		state = ControllerState_Failed;
+		res = false;
+	}
+
+	UpdateControllerState( state );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleRemoveFailedNodeResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleRemoveFailedNodeResponse
+(
+		uint8* _data
+)
+{
+	bool res = true;
+	ControllerState state = ControllerState_InProgress;
+	ControllerError error = ControllerError_None;
+	if( _data[2] )
+	{
+		string reason;
+		switch( _data[2] )
+		{
+			case FAILED_NODE_NOT_FOUND:
+			{
+				reason = "Node not found";
+				error = ControllerError_NotFound;
+				break;
+			}
+			case FAILED_NODE_REMOVE_PROCESS_BUSY:
+			{
+				reason = "Remove process busy";
+				error = ControllerError_Busy;
+				break;
+			}
+			case FAILED_NODE_REMOVE_FAIL:
+			{
+				reason = "Remove failed";
+				error = ControllerError_Failed;
+				break;
+			}
+			case FAILED_NODE_NOT_PRIMARY_CONTROLLER:
+			{
+				reason = "Not Primary Controller";
+				error = ControllerError_NotPrimary;
+				break;
+			}
+			default:
+			{
+				reason = "Command failed";
+				break;
+			}
+		}
+
+		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - %s", reason.c_str() );
+		state = ControllerState_Failed;
+		res = false;
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - Command in progress" );
+	}
+
+	UpdateControllerState( state, error );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleIsFailedNodeResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleIsFailedNodeResponse
+(
+		uint8* _data
+)
+{
+	ControllerState state;
+	uint8 nodeId = m_currentControllerCommand ? m_currentControllerCommand->m_controllerCommandNode : GetNodeNumber( m_currentMsg );
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_IS_FAILED_NODE_ID - node %d failed", nodeId );
+		state = ControllerState_NodeFailed;
+		if( Node* node = GetNodeUnsafe( nodeId ) )
+		{
+			if (node->IsNodeReset()) {
+				/* a DeviceReset has Occured. Remove the Node */
+				if (!BeginControllerCommand(Driver::ControllerCommand_RemoveFailedNode, NULL, NULL, true, nodeId, 0))
+					Log::Write(LogLevel_Warning, nodeId, "RemoveFailedNode for DeviceResetLocally Command Failed");
+
+				Notification* notification = new Notification( Notification::Type_NodeReset );
+				notification->SetHomeAndNodeIds( m_homeId, nodeId );
+				QueueNotification( notification );
+				state = ControllerState_Completed;
+			} else {
+				node->SetNodeAlive( false );
+			}
+		}
+	}
+	else
+	{
+		Log::Write( LogLevel_Warning, nodeId, "Received reply to FUNC_ID_ZW_IS_FAILED_NODE_ID - node %d has not failed", nodeId );
+		if( Node* node = GetNodeUnsafe( nodeId ) )
+		{
+			node->SetNodeAlive( true );
+		}
+		state = ControllerState_NodeOK;
+	}
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleReplaceFailedNodeResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleReplaceFailedNodeResponse
+(
+		uint8* _data
+)
+{
+	bool res = true;
+	ControllerState state = ControllerState_InProgress;
+	if( _data[2] )
+	{
+		// Command failed
+		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - command failed" );
+		state = ControllerState_Failed;
+		res = false;
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - command in progress" );
+	}
+
+	UpdateControllerState( state );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSendDataResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSendDataResponse
+(
+		uint8* _data,
+		bool _replication
+)
+{
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "  %s delivered to Z-Wave stack", _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA" );
+		m_sendDataAccepted = !_replication;
+	}
+	else
+	{
+		Log::Write( LogLevel_Error, GetNodeNumber( m_currentMsg ), "ERROR: %s could not be delivered to Z-Wave stack", _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA" );
+		Count( DriverCounter_NonDelivery );
+		if( Node* node = GetNodeUnsafe( GetNodeNumber( m_currentMsg ) ) )
+		{
+			m_nodeCounters.m_sentFailed[node->GetNodeId()]++;
+			node->m_deliveryRun = 0;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleGetRoutingInfoResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleGetRoutingInfoResponse
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_ROUTING_INFO" );
+
+	WriteLockGuard LG(m_nodeMutex);
+	if( Node* node = GetNode( GetNodeNumber( m_currentMsg ) ) )
+	{
+		// copy the 29-byte bitmap received (29*8=232 possible nodes) into this node's neighbors member variable
+		UpdateNeighbors( node, &_data[2] );
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Neighbors of this node are:" );
+		bool bNeighbors = false;
+		for( int by=0; by<29; by++ )
+		{
+			for( int bi=0; bi<8; bi++ )
+			{
+				if( (_data[2+by] & (0x01<<bi)) )
+				{
+					Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %d", (by<<3)+bi+1 );
+					bNeighbors = true;
+				}
+			}
+		}
+
+		if( !bNeighbors )
+		{
+			Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), " (none reported)" );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSendDataRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSendDataRequest
+(
+		uint8* _data,
+		bool _replication
+)
+{
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	Log::Write( LogLevel_Detail, nodeId, "  %s Request with callback ID 0x%.2x received (expected 0x%.2x)",  _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA", _data[2], _data[2] < 10 ? _data[2] : m_expectedCallbackId );
+	/* Callback ID's below 10 are reserved for NONCE messages */
+	if ((_data[2] > 10 ) && ( _data[2] != m_expectedCallbackId )) {
+		// Wrong callback ID
+		Count( DriverCounter_Callbacks );
+		Log::Write( LogLevel_Warning, nodeId, "WARNING: Unexpected Callback ID received" );
+	} else {
+		Node* node = GetNodeUnsafe( nodeId );
+		if( node != NULL )
+		{
+			if( _data[3] != 0 )
+			{
+				m_nodeCounters.m_sentFailed[nodeId]++;
+				MarkNeighborsStale( nodeId );
+
+				// Let the next attempt explore for a route again
+				node->m_deliveryRun = 0;
+			}
+			else
+			{
+				if( node->m_deliveryRun < 255 )
+				{
+					++node->m_deliveryRun;
+				}
+				m_nodeCounters.m_lastRequestRTT[nodeId] = -node->m_sentTS.TimeRemaining();
+				node->m_callbackLatency.Record( m_nodeCounters.m_lastRequestRTT[nodeId] );
+				m_callbackLatency.Record( m_nodeCounters.m_lastRequestRTT[nodeId] );
+
+				if( m_nodeCounters.m_averageRequestRTT[nodeId] )
+				{
+					// if the average has been established, update by averaging the average and the last RTT
+					m_nodeCounters.m_averageRequestRTT[nodeId] = ( m_nodeCounters.m_averageRequestRTT[nodeId] + m_nodeCounters.m_lastRequestRTT[nodeId] ) >> 1;
+				}
+				else
+				{
+					// if this is the first observed RTT, set the average to this value
+					m_nodeCounters.m_averageRequestRTT[nodeId] = m_nodeCounters.m_lastRequestRTT[nodeId];
+				}
+				Log::Write(LogLevel_Info, nodeId, "Request RTT %d Average Request RTT %d", m_nodeCounters.m_lastRequestRTT[nodeId], m_nodeCounters.m_averageRequestRTT[nodeId] );
+
+				if( m_expectedReply != FUNC_ID_APPLICATION_COMMAND_HANDLER )
+				{
+					// No report to wait for, so the exchange is complete
+					UpdateRetryTimeout( node, m_nodeCounters.m_lastRequestRTT[nodeId] );
+				}
+			}
+		}
+
+		// Let the network's other controllers know how well this one reaches the
+		// node.  A standby has no nodes, so times from the last frame it wrote.
+		if( ControllerGroup* group = AtomicLoadPtr( &m_group ) )
+		{
+			if( _data[3] != 0 )
+			{
+				group->NoteFailure( this, nodeId );
+			}
+			else
+			{
+				group->NoteDelivery( this, nodeId, node ? m_nodeCounters.m_lastRequestRTT[nodeId] : (uint32)-m_writeTS.TimeRemaining() );
+			}
+		}
+
+		// We do this here since HandleErrorResponse/MoveMessagesToWakeUpQueue can delete m_currentMsg
+		if( m_currentMsg && m_currentMsg->IsNoOperation() )
+		{
+			Notification* notification = new Notification( Notification::Type_Notification );
+			notification->SetHomeAndNodeIds( m_homeId, GetNodeNumber( m_currentMsg) );
+			notification->SetNotification( Notification::Code_NoOperation );
+			QueueNotification( notification );
+		}
+
+		// Callback ID matches our expectation
+		if( _data[3] != 0 )
+		{
+			if( !HandleErrorResponse( _data[3], nodeId, _replication ? "ZW_REPLICATION_END_DATA" : "ZW_SEND_DATA", !_replication ) )
+			{
+				if( m_currentMsg &&  m_currentMsg->IsNoOperation() && node != NULL &&
+						( node->GetCurrentQueryStage() == Node::QueryStage_Probe  ||
+								node->GetCurrentQueryStage() == Node::QueryStage_CacheLoad ) )
+				{
+					node->QueryStageRetry( node->GetCurrentQueryStage(), 3 );
+				}
+			}
+		}
+		else if( node != NULL )
+		{
+			// If WakeUpNoMoreInformation request succeeds, update our status
+			if( m_currentMsg && m_currentMsg->IsWakeUpNoMoreInformationCommand() )
+			{
+				if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+				{
+					// Mark the node as asleep
+					wakeUp->SetAwake( false );
+				}
+			}
+			// If node is not alive, mark it alive now
+			if( !node->IsNodeAlive() )
+			{
+				node->SetNodeAlive( true );
+			}
+			NoteHeard( node->GetNodeId() );
+		}
+		// Command reception acknowledged by node, error or not, but ignore any NONCE messages
+		//
+		//	m_expectedCallbackId = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleNetworkUpdateRequest>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleNetworkUpdateRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state = ControllerState_Failed;
+	ControllerError error = ControllerError_None;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	switch( _data[3] )
+	{
+		case SUC_UPDATE_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Success" );
+			state = ControllerState_Completed;
+			break;
+		}
+		case SUC_UPDATE_ABORT:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - Error. Process aborted." );
+			error = ControllerError_Failed;
+			break;
+		}
+		case SUC_UPDATE_WAIT:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - SUC is busy." );
+			error = ControllerError_Busy;
+			break;
+		}
+		case SUC_UPDATE_DISABLED:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - SUC is disabled." );
+			error = ControllerError_Disabled;
+			break;
+		}
+		case SUC_UPDATE_OVERFLOW:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - Overflow. Full replication required." );
+			error = ControllerError_Overflow;
+			break;
+		}
+		default:
+		{
+		}
+	}
+
+	UpdateControllerState( state, error );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleAddNodeToNetworkRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleAddNodeToNetworkRequest
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_ADD_NODE_TO_NETWORK:" );
+	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_ADD_NODE_TO_NETWORK, _data );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleRemoveNodeFromNetworkRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleRemoveNodeFromNetworkRequest
+(
+		uint8* _data
+)
+{
+	//uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	ControllerState state = m_currentControllerCommand->m_controllerState;
+	Log::Write( LogLevel_Info, "FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK:" );
+
+	switch( _data[3] )
+	{
+		case REMOVE_NODE_STATUS_LEARN_READY:
+		{
+			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_LEARN_READY" );
+			state = ControllerState_Waiting;
+			m_currentControllerCommand->m_controllerCommandNode = 0;
+			break;
+		}
+		case REMOVE_NODE_STATUS_NODE_FOUND:
+		{
+			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_NODE_FOUND" );
+			state = ControllerState_InProgress;
+			break;
+		}
+		case REMOVE_NODE_STATUS_REMOVING_SLAVE:
+		{
+			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_REMOVING_SLAVE" );
+			if (_data[4] != 0)
+			{
+				Log::Write( LogLevel_Info, "Removing node ID %d", _data[4] );
+				m_currentControllerCommand->m_controllerCommandNode = _data[4];
+			}
+			else
+			{
+				Log::Write( LogLevel_Warning, "Remove Node Failed - NodeID 0 Returned");
+				state = ControllerState_Failed;
+			}
+			break;
+		}
+		case REMOVE_NODE_STATUS_REMOVING_CONTROLLER:
+		{
+			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_REMOVING_CONTROLLER" );
+			m_currentControllerCommand->m_controllerCommandNode = _data[4];
+			if( m_currentControllerCommand->m_controllerCommandNode == 0 ) // Some controllers don't return node number
+			{
+				if( _data[5] >= 3 )
+				{
+					WriteLockGuard LG(m_nodeMutex);
+					for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+					{
+						uint8 i = *nit;
+						// Ignore primary controller
+						if( m_nodes[i]->m_nodeId == m_Controller_nodeId )
+						{
+							continue;
+						}
+						// See if we can match another way
+						if( m_nodes[i]->m_basic == _data[6] &&
+								m_nodes[i]->m_generic == _data[7] &&
+								m_nodes[i]->m_specific == _data[8] )
+						{
+							if( m_currentControllerCommand->m_controllerCommandNode != 0 )
+							{
+								Log::Write( LogLevel_Info, "Alternative controller lookup found more then one match. Using the first one found." );
+							}
+							else
+							{
+								m_currentControllerCommand->m_controllerCommandNode = m_nodes[i]->m_nodeId;
+							}
+						}
+					}
+				}
+				else
+				{
+					Log::Write( LogLevel_Warning, "WARNING: Node is 0 but not enough data to perform alternative match." );
+				}
+			}
+			else
+			{
+				m_currentControllerCommand->m_controllerCommandNode = _data[4];
+			}
+			Log::Write( LogLevel_Info, "Removing controller ID %d", m_currentControllerCommand->m_controllerCommandNode );
+			break;
+		}
+		case REMOVE_NODE_STATUS_DONE:
+		{
+			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_DONE" );
+			if( !m_currentControllerCommand->m_controllerCommandDone )
+			{
+
+				// Remove Node Stop calls back through here so make sure
+				// we do't do it again.
+				UpdateControllerState( ControllerState_Completed );
+				//AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
+				if ( m_currentControllerCommand->m_controllerCommandNode == 0 ) // never received "removing" update
+				{
+					if ( _data[4] != 0 ) // but message has the clue
+					{
+						m_currentControllerCommand->m_controllerCommandNode = _data[4];
+					}
+				}
+
+				if ( m_currentControllerCommand->m_controllerCommandNode != 0 && m_currentControllerCommand->m_controllerCommandNode != 0xff )
+				{
+					{
+						WriteLockGuard LG(m_nodeMutex);
+						SetNodeObject( m_currentControllerCommand->m_controllerCommandNode, NULL );
+					}
+					Notification* notification = new Notification( Notification::Type_NodeRemoved );
+					notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
+					QueueNotification( notification );
+				}
+			}
+			return;
+		}
+		case REMOVE_NODE_STATUS_FAILED:
+		{
+			//AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
+			Log::Write( LogLevel_Warning,  "WARNING: REMOVE_NODE_STATUS_FAILED" );
+			state = ControllerState_Failed;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleControllerChangeRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleControllerChangeRequest
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_CONTROLLER_CHANGE:" );
+	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_CONTROLLER_CHANGE, _data );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleCreateNewPrimaryRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleCreateNewPrimaryRequest
+(
+		uint8* _data
+)
+{
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_CREATE_NEW_PRIMARY:" );
+	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_CREATE_NEW_PRIMARY, _data );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSetLearnModeRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSetLearnModeRequest
+(
+		uint8* _data
+)
+{
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	ControllerState state = m_currentControllerCommand->m_controllerState;
+	Log::Write( LogLevel_Info, nodeId, "FUNC_ID_ZW_SET_LEARN_MODE:" );
+
+	switch( _data[3] )
+	{
+		case LEARN_MODE_STARTED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_STARTED" );
+			state = ControllerState_Waiting;
+			break;
+		}
+		case LEARN_MODE_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_DONE" );
+			state = ControllerState_Completed;
+
+			// Stop learn mode
+			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
+			msg->Append( 0 );
+			SendMsg( msg, MsgQueue_Command );
+
+			// Rebuild all the node info.  Group and scene data that we stored
+			// during replication will be applied as we discover each node.
+			InitAllNodes();
+			break;
+		}
+		case LEARN_MODE_FAILED:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: LEARN_MODE_FAILED" );
+			state = ControllerState_Failed;
+
+			// Stop learn mode
+			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
+			msg->Append( 0 );
+			SendMsg( msg, MsgQueue_Command );
+
+			// Rebuild all the node info, since it may have been partially
+			// updated by the failed command.  Group and scene data that we
+			// stored during replication will be applied as we discover each node.
+			InitAllNodes();
+			break;
+		}
+		case LEARN_MODE_DELETED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_DELETED" );
+			state = ControllerState_Failed;
+			// Stop learn mode
+			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
+			msg->Append( 0 );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleRemoveFailedNodeRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleRemoveFailedNodeRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state = ControllerState_Completed;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	switch( _data[3] )
+	{
+		case FAILED_NODE_OK:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - Node %d is OK, so command failed", m_currentControllerCommand->m_controllerCommandNode );
+			state = ControllerState_NodeOK;
+			break;
+		}
+		case FAILED_NODE_REMOVED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - node %d successfully moved to failed nodes list", m_currentControllerCommand->m_controllerCommandNode );
+			state = ControllerState_Completed;
+
+			{
+				WriteLockGuard LG(m_nodeMutex);
+				SetNodeObject( m_currentControllerCommand->m_controllerCommandNode, NULL );
+			}
+			Notification* notification = new Notification( Notification::Type_NodeRemoved );
+			notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
+			QueueNotification( notification );
+
+			break;
+		}
+		case FAILED_NODE_NOT_REMOVED:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - unable to move node %d to failed nodes list", m_currentControllerCommand->m_controllerCommandNode );
+			state = ControllerState_Failed;
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleReplaceFailedNodeRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleReplaceFailedNodeRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state = ControllerState_Completed;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	switch( _data[3] )
+	{
+		case FAILED_NODE_OK:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node is OK, so command failed" );
+			state = ControllerState_NodeOK;
+			break;
+		}
+		case FAILED_NODE_REPLACE_WAITING:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Waiting for new node" );
+			state = ControllerState_Waiting;
+			break;
+		}
+		case FAILED_NODE_REPLACE_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node successfully replaced" );
+			state = ControllerState_Completed;
+
+			// Request new node info for this device
+			if( m_currentControllerCommand != NULL )
+			{
+				InitNode( m_currentControllerCommand->m_controllerCommandNode, true );
+			}
+			break;
+		}
+		case FAILED_NODE_REPLACE_FAILED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node replacement failed" );
+			state = ControllerState_Failed;
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleApplicationCommandHandlerRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleApplicationCommandHandlerRequest
+(
+		uint8* _data,
+		bool encrypted
+)
+{
+
+	uint8 status = _data[2];
+	uint8 nodeId = _data[3];
+	uint8 classId = _data[5];
+	Node* node = GetNodeUnsafe( nodeId );
+	bool duplicate = false;
+
+	if( ( status & RECEIVE_STATUS_ROUTED_BUSY ) != 0 )
+	{
+		Count( DriverCounter_RoutedBusy );
+	}
+	if( ( status & RECEIVE_STATUS_TYPE_BROAD ) != 0 )
+	{
+		Count( DriverCounter_BroadcastRead );
+	}
+	if( node != NULL )
+	{
+		m_nodeCounters.m_receivedCnt[nodeId]++;
+		node->m_errors = 0;
+		ControllerGroup* group = AtomicLoadPtr( &m_group );
+		if( IsDuplicateFrame( node, _data ) || ( group && !m_handlingForwarded && !group->Admit( _data ) ) )
+		{
+			m_nodeCounters.m_receivedDups[nodeId]++;
+
+			// A routed retransmission, or a copy that came by another path.  It still shows
+			// the node is there, but is not handled again, unless it may be the reply being
+			// waited for.
+			duplicate = !( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER && m_expectedNodeId == nodeId && m_expectedCommandClassId == classId );
+		}
+		else
+		{
+			// Only the message itself is kept, as _data points into the receive buffer
+			uint8 length = ( _data[4] + 5 < (int)sizeof(node->m_lastReceivedMessage) ) ? _data[4] + 5 : sizeof(node->m_lastReceivedMessage);
+			memcpy( node->m_lastReceivedMessage, _data, length );
+			if( node->m_lastReceivedLength > length )
+			{
+				memset( &node->m_lastReceivedMessage[length], 0, node->m_lastReceivedLength - length );
+			}
+			node->m_lastReceivedLength = length;
+		}
+		node->m_receivedTS.SetTime();
+		NoteHeard( nodeId );
+		if( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER && m_expectedNodeId == nodeId && !m_handlingForwarded )
+		{
+			// Need to confirm this is the correct response to the last sent request.
+			// At least ignore any received messages prior to the send data request.
+			// The time the frame waited to be read is not part of the round trip.
+			int32 rtt = -node->m_sentTS.TimeRemaining() - (int32)m_rxFrameAge;
+			m_nodeCounters.m_lastResponseRTT[nodeId] = ( rtt > 0 ) ? rtt : 0;
+			node->m_replyLatency.Record( m_nodeCounters.m_lastResponseRTT[nodeId] );
+			m_replyLatency.Record( m_nodeCounters.m_lastResponseRTT[nodeId] );
+
+			if( m_nodeCounters.m_averageResponseRTT[nodeId] )
+			{
+				// if the average has been established, update by averaging the average and the last RTT
+				m_nodeCounters.m_averageResponseRTT[nodeId] = ( m_nodeCounters.m_averageResponseRTT[nodeId] + m_nodeCounters.m_lastResponseRTT[nodeId] ) >> 1;
+			}
+			else
+			{
+				// if this is the first observed RTT, set the average to this value
+				m_nodeCounters.m_averageResponseRTT[nodeId] = m_nodeCounters.m_lastResponseRTT[nodeId];
+			}
+			Log::Write(LogLevel_Info, nodeId, "Response RTT %d Average Response RTT %d", m_nodeCounters.m_lastResponseRTT[nodeId], m_nodeCounters.m_averageResponseRTT[nodeId] );
+			UpdateRetryTimeout( node, m_nodeCounters.m_lastResponseRTT[nodeId] );
+		}
+		else
+		{
+			m_nodeCounters.m_receivedUnsolicited[nodeId]++;
+		}
+		if ( !node->IsNodeAlive() )
+		{
+			node->SetNodeAlive( true );
+		}
+	}
+	if( duplicate )
+	{
+		Log::Write( LogLevel_Detail, nodeId, "Dropping a duplicate frame" );
+		return;
+	}
+	if( ApplicationStatus::StaticGetCommandClassId() == classId )
+	{
+		//TODO: Test this class function or implement
+	}
+	else if( ControllerReplication::StaticGetCommandClassId() == classId )
+	{
+		if( m_controllerReplication && m_currentControllerCommand && ( ControllerCommand_ReceiveConfiguration == m_currentControllerCommand->m_controllerCommand ) )
+		{
+			m_controllerReplication->HandleMsg( &_data[6], _data[4] );
+
+			UpdateControllerState( ControllerState_InProgress );
+		}
+	}
+	else
+	{
+		// Allow the node to handle the message itself.  The scenes and
+		// refreshes its changes trigger are held back until the whole frame
+		// has been seen.
+		if( node != NULL )
+		{
+			m_triggerMutex->Lock();
+			m_triggerNodeId = nodeId;
+			m_triggerMutex->Unlock();
+
+			node->ApplicationCommandHandler( _data, encrypted );
+
+			FlushTriggeredScenes();
+			FlushTriggeredRefreshes( nodeId );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandlePromiscuousApplicationCommandHandlerRequest>
+// Process a request from the Z-Wave PC interface when in promiscuous mode.
+// Frames for this controller still come as FUNC_ID_APPLICATION_COMMAND_HANDLER,
+// so these are all between other nodes.  They are only put in the sniffer's ring.
+//-----------------------------------------------------------------------------
+void Driver::HandlePromiscuousApplicationCommandHandlerRequest
+(
+		uint8* _data
+)
+{
+	if( !AtomicLoad( &m_sniffing ) )
+	{
+		return;
+	}
+
+	uint8 length = _data[4];
+	uint32 size = c_sniffedHeaderSize + length;
+	if( c_snifferRingSize - m_snifferRing->GetDataSize() < size )
+	{
+		// Full, because the frames are not being taken fast enough
+		AtomicIncrement( &m_snifferDropped );
+		return;
+	}
+
+	uint8 record[c_sniffedHeaderSize + 255];
+	uint32 time = (uint32)-m_snifferStart.TimeRemaining();
+	record[0] = (uint8)time;
+	record[1] = (uint8)( time >> 8 );
+	record[2] = (uint8)( time >> 16 );
+	record[3] = (uint8)( time >> 24 );
+	record[4] = length;
+	record[5] = _data[3];				// Source node
+	record[6] = _data[5+length];		// Target node, after the payload
+	memcpy( &record[c_sniffedHeaderSize], &_data[5], length );
+	m_snifferRing->Put( record, size );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleAssignReturnRouteRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleAssignReturnRouteRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	if( _data[3] )
+	{
+		// Failed
+		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_ASSIGN_RETURN_ROUTE", true );
+		state = ControllerState_Failed;
+	}
+	else
+	{
+		// Success
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE for node %d - SUCCESS", m_currentControllerCommand->m_controllerCommandNode );
+		state = ControllerState_Completed;
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleDeleteReturnRouteRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleDeleteReturnRouteRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	if( _data[3] )
+	{
+		// Failed
+		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_DELETE_RETURN_ROUTE", true );
+		state = ControllerState_Failed;
+	}
+	else
+	{
+		// Success
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE for node %d - SUCCESS", m_currentControllerCommand->m_controllerCommandNode );
+		state = ControllerState_Completed;
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleSendNodeInformationRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleSendNodeInformationRequest
+(
+		uint8* _data
+)
+{
+	ControllerState state;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	if( _data[3] )
+	{
+		// Failed
+		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_SEND_NODE_INFORMATION" );
+		state = ControllerState_Failed;
+	}
+	else
+	{
+		// Success
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_NODE_INFORMATION - SUCCESS" );
+		state = ControllerState_Completed;
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleNodeNeighborUpdateRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleNodeNeighborUpdateRequest
+(
+		uint8* _data
+)
+{
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	ControllerState state = ControllerState_Normal;
+	switch( _data[3] )
+	{
+		case REQUEST_NEIGHBOR_UPDATE_STARTED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "REQUEST_NEIGHBOR_UPDATE_STARTED" );
+			state = ControllerState_InProgress;
+			break;
+		}
+		case REQUEST_NEIGHBOR_UPDATE_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "REQUEST_NEIGHBOR_UPDATE_DONE" );
+			state = ControllerState_Completed;
+
+			// We now request the neighbour information from the
+			// controller and store it in our node object.
+			if( m_currentControllerCommand != NULL )
+			{
+				RequestNodeNeighbors( m_currentControllerCommand->m_controllerCommandNode, 0 );
+			}
+			break;
+		}
+		case REQUEST_NEIGHBOR_UPDATE_FAILED:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: REQUEST_NEIGHBOR_UPDATE_FAILED" );
+			state = ControllerState_Failed;
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HandleApplicationUpdateRequest>
+// Process a request from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+bool Driver::HandleApplicationUpdateRequest
+(
+		uint8* _data
+)
+{
+	bool messageRemoved = false;
+	uint8 nodeId = _data[3];
+	Node* node = GetNodeUnsafe( nodeId );
+
+	// If node is not alive, mark it alive now
+	if( node != NULL && !node->IsNodeAlive() )
+	{
+		node->SetNodeAlive( true );
+	}
+
+	switch( _data[2] )
+	{
+		case UPDATE_STATE_SUC_ID:
+		{
+			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_SUC_ID from node %d", nodeId );
+			m_SUCNodeId = nodeId; // need to confirm real data here
+			break;
+		}
+		case UPDATE_STATE_DELETE_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "** Network change **: Z-Wave node %d was removed", nodeId );
+
+			{
+				WriteLockGuard LG(m_nodeMutex);
+				SetNodeObject( nodeId, NULL );
+			}
+
+			Notification* notification = new Notification( Notification::Type_NodeRemoved );
+			notification->SetHomeAndNodeIds( m_homeId, nodeId );
+			QueueNotification( notification );
+			break;
+		}
+		case UPDATE_STATE_NEW_ID_ASSIGNED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "** Network change **: ID %d was assigned to a new Z-Wave node", nodeId );
+                        // Check if the new node id is equal to the current one.... if so no operation is needed, thus no remove and add is necessary
+                        if ( _data[3] != _data[6] )
+                        {
+                        	// Request the node protocol info (also removes any existing node and creates a new one)
+			        InitNode( nodeId );	
+                        }
+                        else 
+                        {
+                        	Log::Write(LogLevel_Info, nodeId, "Not Re-assigning NodeID as old and new NodeID match");
+                        }
+			
+			break;
+		}
+		case UPDATE_STATE_ROUTING_PENDING:
+		{
+			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_ROUTING_PENDING from node %d", nodeId );
+			break;
+		}
+		case UPDATE_STATE_NODE_INFO_REQ_FAILED:
+		{
+			Log::Write( LogLevel_Warning, nodeId, "WARNING: FUNC_ID_ZW_APPLICATION_UPDATE: UPDATE_STATE_NODE_INFO_REQ_FAILED received" );
+
+			// Note: Unhelpfully, the nodeId is always zero in this message.  We have to
+			// assume the message came from the last node to which we sent a request.
+			if( m_currentMsg )
+			{
+				Node* tnode = GetNodeUnsafe( m_currentMsg->GetTargetNodeId() );
+				if( tnode )
+				{
+					// Retry the query twice
+					tnode->QueryStageRetry( Node::QueryStage_NodeInfo, 2 );
+
+					// Just in case the failure was due to the node being asleep, we try
+					// to move its pending messages to its wakeup queue.  If it is not
+					// a sleeping device, this will have no effect.
+					if( MoveMessagesToWakeUpQueue( tnode->GetNodeId(), true ) )
+					{
+						messageRemoved = true;
+					}
+				}
+			}
+			break;
+		}
+		case UPDATE_STATE_NODE_INFO_REQ_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_NODE_INFO_REQ_DONE from node %d", nodeId );
+			break;
+		}
+		case UPDATE_STATE_NODE_INFO_RECEIVED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_NODE_INFO_RECEIVED from node %d", nodeId );
+			if( node )
+			{
+				node->UpdateNodeInfo( &_data[8], _data[4] - 3 );
+			}
+			break;
+		}
+	}
+
+	if( messageRemoved )
+	{
+		m_waitingForAck = false;
+		m_expectedCallbackId = 0;
+		m_expectedReply = 0;
+		m_expectedCommandClassId = 0;
+		m_expectedNodeId = 0;
+	}
+
+	return messageRemoved;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CommonAddNodeStatusRequestHandler>
+// Handle common AddNode processing for many similar commands
+//-----------------------------------------------------------------------------
+void Driver::CommonAddNodeStatusRequestHandler
+(
+		uint8 _funcId,
+		uint8* _data
+)
+{
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	ControllerState state = ControllerState_Normal;
+	if( m_currentControllerCommand != NULL )
+	{
+		state = m_currentControllerCommand->m_controllerState;
+	}
+	switch( _data[3] )
+	{
+		case ADD_NODE_STATUS_LEARN_READY:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_LEARN_READY" );
+			m_currentControllerCommand->m_controllerAdded = false;
+			state = ControllerState_Waiting;
+			break;
+		}
+		case ADD_NODE_STATUS_NODE_FOUND:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_NODE_FOUND" );
+			state = ControllerState_InProgress;
+			break;
+		}
+		case ADD_NODE_STATUS_ADDING_SLAVE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_ADDING_SLAVE" );
+			/* Discovered all the CC's are sent in this packet as well:
+			 * position description
+			 * 4 - Node ID
+			 * 5 - Length
+			 * 6 - Basic Device Class
+			 * 7 - Generic Device Class
+			 * 8 - Specific Device Class
+			 * 9 to Length - Command Classes
+			 * Last pck - CRC
+			 */
+			if( m_currentControllerCommand != NULL )
+			{
+				Log::Write( LogLevel_Info, nodeId, "Adding node ID %d - %s", _data[4], m_currentControllerCommand->m_controllerCommandArg ? "Secure" : "Non-Secure");
+				m_currentControllerCommand->m_controllerAdded = false;
+				m_currentControllerCommand->m_controllerCommandNode = _data[4];
+				/* make sure we dont overrun our buffer. Its ok to truncate */
+				uint8 length = _data[5];
+				if (length > 254) length = 254;
+				memcpy(&m_currentControllerCommand->m_controllerDeviceProtocolInfo, &_data[6], length);
+				m_currentControllerCommand->m_controllerDeviceProtocolInfoLength = length;
+			}
+//			AddNodeStop( _funcId );
+//			sleep(1);
+			break;
+		}
+		case ADD_NODE_STATUS_ADDING_CONTROLLER:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_ADDING_CONTROLLER");
+			Log::Write( LogLevel_Info, nodeId, "Adding controller ID %d", _data[4] );
+			/* Discovered all the CC's are sent in this packet as well:
+			 * position description
+			 * 4 - Node ID
+			 * 5 - Length
+			 * 6 - Basic Device Class
+			 * 7 - Generic Device Class
+			 * 8 - Specific Device Class
+			 * 9 to Length - Command Classes
+			 * Last pck - CRC
+			 */
+
+
+			if( m_currentControllerCommand != NULL )
+			{
+				m_currentControllerCommand->m_controllerAdded = true;
+				m_currentControllerCommand->m_controllerCommandNode = _data[4];
+			}
+//			AddNodeStop( _funcId );
+			break;
+		}
+		case ADD_NODE_STATUS_PROTOCOL_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_PROTOCOL_DONE" );
+			// We added a device.
+			// Get the controller out of add mode to avoid accidentally adding other devices.
+			// We used to call replication here.
+			AddNodeStop( _funcId );
+			break;
+		}
+		case ADD_NODE_STATUS_DONE:
+		{
+			if (state == ControllerState_Failed) {
+				/* if it was a failed add, we just move on */
+				state = ControllerState_Completed;
+				break;
+			}
+
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_DONE" );
+			state = ControllerState_Completed;
+			if( m_currentControllerCommand != NULL && m_currentControllerCommand->m_controllerCommandNode != 0xff )
+			{
+				InitNode( m_currentControllerCommand->m_controllerCommandNode, true, m_currentControllerCommand->m_controllerCommandArg != 0, m_currentControllerCommand->m_controllerDeviceProtocolInfo, m_currentControllerCommand->m_controllerDeviceProtocolInfoLength );
+			}
+
+			// Not sure about the new controller function here.
+			if( _funcId != FUNC_ID_ZW_ADD_NODE_TO_NETWORK && m_currentControllerCommand != NULL && m_currentControllerCommand->m_controllerAdded )
+			{
+				// Rebuild all the node info.  Group and scene data that we stored
+				// during replication will be applied as we discover each node.
+				InitAllNodes();
+			}
+			break;
+		}
+		case ADD_NODE_STATUS_FAILED:
+		{
+			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_FAILED" );
+			state = ControllerState_Failed;
+
+			// Remove the AddNode command from the queue
+			RemoveCurrentMsg();
+
+			// Get the controller out of add mode to avoid accidentally adding other devices.
+			AddNodeStop( _funcId );
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	UpdateControllerState( state );
+}
+
+//-----------------------------------------------------------------------------
+//	Polling Z-Wave devices
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Driver::EnablePoll>
+// Enable polling of a value
+//-----------------------------------------------------------------------------
+bool Driver::EnablePoll
+(
+		ValueID const &_valueId,
+		uint8 const _intensity
+)
+{
+	// make sure the polling thread doesn't lock the node while we're in this function
+	m_pollMutex->Lock();
+
+	// confirm that this node exists
+	uint8 nodeId = _valueId.GetNodeId();
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( nodeId );
+	if( node != NULL )
+	{
+		// confirm that this value is in the node's value store
+		if( Value* value = node->GetValue( _valueId ) )
+		{
+			// update the value's pollIntensity
+			value->SetPollIntensity( _intensity );
+
+			// Add the valueid to the polling list
+			// See if the node is already in the poll list.
+			if( m_pollWheel.Contains( _valueId ) || find( m_pollDue.begin(), m_pollDue.end(), _valueId ) != m_pollDue.end() )
+			{
+				// It is already in the poll list, so we have nothing to do.
+				Log::Write( LogLevel_Detail, "EnablePoll not required to do anything (value is already in the poll list)" );
+				value->Release();
+				m_pollMutex->Unlock();
+				return true;
+			}
+
+			// Not in the list, so we add it.  The first poll waits for the value's
+			// own slot in its interval, so values enabled together do not come due together.
+			m_pollWheel.Insert( _valueId, GetPollPhaseTicks( _valueId, GetPollTicks( value ) ) );
+			value->Release();
+			m_pollMutex->Unlock();
+			m_pollEvent->Set();
+
+			// send notification to indicate polling is enabled
+			Notification* notification = new Notification( Notification::Type_PollingEnabled );
+			notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
+			QueueNotification( notification );
+			Log::Write( LogLevel_Info, nodeId, "EnablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
+					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), (int)( m_pollWheel.Size() + m_pollDue.size() ) );
+			return true;
+		}
+
+		// allow the poll thread to continue
+		m_pollMutex->Unlock();
+
+		Log::Write( LogLevel_Info, nodeId, "EnablePoll failed - value not found for node %d", nodeId );
+		return false;
+	}
+
+	// allow the poll thread to continue
+	m_pollMutex->Unlock();
+
+	Log::Write( LogLevel_Info, "EnablePoll failed - node %d not found", nodeId );
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::DisablePoll>
+// Disable polling of a node
+//-----------------------------------------------------------------------------
+bool Driver::DisablePoll
+(
+		ValueID const &_valueId
+)
+{
+	// make sure the polling thread doesn't lock the node while we're in this function
+	m_pollMutex->Lock();
+
+	// confirm that this node exists
+	uint8 nodeId = _valueId.GetNodeId();
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( nodeId );
+	if( node != NULL)
+	{
+		// See if the value is already in the poll list.
+		list<ValueID>::iterator it = find( m_pollDue.begin(), m_pollDue.end(), _valueId );
+		bool found = m_pollWheel.Remove( _valueId );
+		if( it != m_pollDue.end() )
+		{
+			m_pollDue.erase( it );
+			found = true;
+		}
+		if( found )
+		{
+			// Found it
+			// get the value object and reset pollIntensity to zero (indicating no polling)
+			if( Value* value = GetValue( _valueId ) )
+			{
+				value->SetPollIntensity( 0 );
+				value->Release();
+			}
+			m_pollMutex->Unlock();
+
+			// send notification to indicate polling is disabled
+			Notification* notification = new Notification( Notification::Type_PollingDisabled );
+			notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
+			QueueNotification( notification );
+			Log::Write( LogLevel_Info, nodeId, "DisablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
+					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), (int)( m_pollWheel.Size() + m_pollDue.size() ) );
+			return true;
+		}
+
+		// Not in the list
+		m_pollMutex->Unlock();
+		Log::Write( LogLevel_Info, nodeId, "DisablePoll failed - value not on list");
+		return false;
+	}
+
+	// allow the poll thread to continue
+	m_pollMutex->Unlock();
+
+	Log::Write( LogLevel_Info, "DisablePoll failed - node %d not found", nodeId );
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::isPolled>
+// Check polling status of a value
+//-----------------------------------------------------------------------------
+bool Driver::isPolled
+(
+		ValueID const &_valueId
+)
+{
+	bool bPolled;
+
+	// make sure the polling thread doesn't lock the node while we're in this function
+	m_pollMutex->Lock();
+
+	Value* value = GetValue( _valueId );
+	if( value && value->GetPollIntensity() != 0 )
+	{
+		bPolled = true;
+	}
+	else
+	{
+		bPolled = false;
+	}
+
+	if (value) value->Release();
+
+	/*
+	 * This code is retained for the moment as a belt-and-suspenders test to confirm that
+	 * the pollIntensity member of each value and the pollList contents do not get out
+	 * of sync.
+	 */
+	// confirm that this node exists
+	uint8 nodeId = _valueId.GetNodeId();
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( nodeId );
+	if( node != NULL)
+	{
+
+		// See if the value is already in the poll list.
+		if( m_pollWheel.Contains( _valueId ) || find( m_pollDue.begin(), m_pollDue.end(), _valueId ) != m_pollDue.end() )
+		{
+			// Found it
+			if( bPolled )
+			{
+				m_pollMutex->Unlock();
+				return true;
+			}
+			else
+			{
+				Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
+			}
+		}
+
+		// Not in the list
+
+		if( !bPolled )
+		{
+			m_pollMutex->Unlock();
+			return false;
+		}
+		else
+		{
+			Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
+		}
+	}
+
+	// allow the poll thread to continue
+	m_pollMutex->Unlock();
+
+	Log::Write( LogLevel_Info, "isPolled failed - node %d not found (the value reported that it is%s polled)", nodeId, bPolled?"":" not" );
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SetPollIntensity>
+// Set the intensity with which this value is polled
+//-----------------------------------------------------------------------------
+void Driver::SetPollIntensity
+(
+		ValueID const &_valueId,
+		uint8 const _intensity
+)
+{
+	// make sure the polling thread doesn't lock the value while we're in this function
+	m_pollMutex->Lock();
+
+	Value* value = GetValue( _valueId );
+	if (!value)
+	{
+		m_pollMutex->Unlock();
+		return;
+	}
+	value->SetPollIntensity( _intensity );
+	SetConfigDirty( _valueId.GetNodeId() );
+
+	// Reschedule the value using its new interval
+	if( m_pollWheel.Contains( _valueId ) )
+	{
+		m_pollWheel.Insert( _valueId, GetPollPhaseTicks( _valueId, GetPollTicks( value ) ) );
+		m_pollEvent->Set();
+	}
+
+	value->Release();
+	m_pollMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SetValuePollInterval>
+// Set the time between polls of this value
+//-----------------------------------------------------------------------------
+void Driver::SetValuePollInterval
+(
+		ValueID const &_valueId,
+		uint32 const _milliseconds
+)
+{
+	// make sure the polling thread doesn't lock the value while we're in this function
+	m_pollMutex->Lock();
+
+	Value* value = GetValue( _valueId );
+	if( !value )
+	{
+		m_pollMutex->Unlock();
+		return;
+	}
+	value->SetPollInterval( _milliseconds );
+	SetConfigDirty( _valueId.GetNodeId() );
+
+	// Reschedule the value using its new interval
+	if( m_pollWheel.Contains( _valueId ) )
+	{
+		m_pollWheel.Insert( _valueId, GetPollPhaseTicks( _valueId, GetPollTicks( value ) ) );
+		m_pollEvent->Set();
+	}
+
+	value->Release();
+	m_pollMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AdaptValuePollInterval>
+// Change how often a value is polled, in answer to what it reported
+//-----------------------------------------------------------------------------
+void Driver::AdaptValuePollInterval
+(
+		Value* _value,
+		uint32 const _milliseconds
+)
+{
+	// Unlike SetValuePollInterval, the caller already holds the value and the
+	// config is not marked dirty, as the interval changes with every report.
+	m_pollMutex->Lock();
+	_value->SetPollInterval( _milliseconds );
+
+	// A value has just been read, so its next poll is due a whole interval from now
+	if( m_pollWheel.Contains( _value->GetID() ) )
+	{
+		m_pollWheel.Insert( _value->GetID(), GetPollTicks( _value ) );
+		m_pollEvent->Set();
+	}
+	m_pollMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PollThreadEntryPoint>
+// Entry point of the thread for poll Z-Wave devices
+//-----------------------------------------------------------------------------
+void Driver::PollThreadEntryPoint
+(
+		Event* _exitEvent,
+		void* _context
+)
+{
+	Driver* driver = (Driver*)_context;
+	if( driver )
+	{
+		driver->PollThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PollThreadProc>
+// Thread for poll Z-Wave devices
+//-----------------------------------------------------------------------------
+void Driver::PollThreadProc
+(
+		Event* _exitEvent
+)
+{
+	Wait* waitObjects[3];
+	waitObjects[0] = _exitEvent;
+	waitObjects[1] = m_pollEvent;
+	waitObjects[2] = m_sendIdleEvent;
+	WaitSet waitSet( waitObjects, 3 );
+
+	while( 1 )
+	{
+		bool waitForIdle;
+		int32 timeout = PollStep( &waitForIdle );
+
+		if( waitSet.Multiple( waitForIdle ? 3 : 2, timeout ) == 0 )
+		{
+			// Exit has been called
+			return;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PollStep>
+// Send a poll that has come due, and run the other scheduled work of the
+// poll thread.  Returns how long to wait before calling again, unless
+// m_pollEvent, or m_sendIdleEvent if o_waitForIdle is set, is signalled first.
+//-----------------------------------------------------------------------------
+int32 Driver::PollStep
+(
+		bool* o_waitForIdle
+)
+{
+	// Move the poll wheel on by the whole ticks that have passed
+	m_pollMutex->Lock();
+	int32 elapsed = -m_pollLastTick.TimeRemaining();
+	if( elapsed >= c_pollTickMs )
+	{
+		uint32 ticks = (uint32)( elapsed / c_pollTickMs );
+		m_pollWheel.Advance( ticks, m_pollDue );
+		m_pollLastTick.SetTime( (int32)( ticks * c_pollTickMs ) - elapsed );
+	}
+	bool pollDue = m_awakeNodesQueried && !m_pollDue.empty();
+	m_pollMutex->Unlock();
+
+	int32 timeout = Wait::Timeout_Infinite;
+	*o_waitForIdle = false;
+
+	if( pollDue )
+	{
+		// Polling messages are only sent when there are no other messages waiting to be sent
+		// While this makes the polls much more variable and uncertain if some other activity dominates
+		// a send queue, that may be appropriate.  With a QueueAging time for the Poll
+		// queue, a poll that has waited that long is queued anyway, and goes ahead of
+		// the busier queues once it has waited as long again.
+		bool aged = m_pollWaitingForIdle && m_queueAging[MsgQueue_Poll] && -m_pollBusySince.TimeRemaining() >= (int32)m_queueAging[MsgQueue_Poll];
+		if( !m_sendIdle && !aged )
+		{
+			if( !m_pollWaitingForIdle )
+			{
+				m_pollBusySince.SetTime();
+				m_pollWaitingForIdle = true;
+			}
+			else if( !m_pollWarned && -m_pollBusySince.TimeRemaining() >= 300000 )
+			{
+				// 300 seconds worth of delay?  Something unusual is going on
+				Log::Write( LogLevel_Warning, "Poll queue hasn't been able to execute for 300 secs or more" );
+				Log::QueueDump();
+				m_pollWarned = true;
+			}
+			*o_waitForIdle = true;
+			timeout = 1000;
+		}
+		else if( m_pollNext.TimeRemaining() > 0 )
+		{
+			// Spread the polls out
+			m_pollWaitingForIdle = false;
+			timeout = m_pollNext.TimeRemaining();
+		}
+		else
+		{
+			m_pollWaitingForIdle = false;
+			m_pollWarned = false;
+
+			m_pollMutex->Lock();
+			// Take every value on the same node that has come due, so they can
+			// be requested together
+			uint8 nodeId = m_pollDue.front().GetNodeId();
+			list<ValueID> valueIds;
+			list<ValueID>::iterator it = m_pollDue.begin();
+			while( it != m_pollDue.end() )
+			{
+				if( it->GetNodeId() == nodeId )
+				{
+					valueIds.push_back( *it );
+					it = m_pollDue.erase( it );
+				}
+				else
+				{
+					++it;
+				}
+			}
+			{
+				NodeGuard LG( this, nodeId );
+				if( Node* node = LG.GetNode() )
+				{
+					PollNode( node, valueIds );
+				}
+			}
+			m_pollNext.SetTime( GetPollSpacing() );
+			m_pollMutex->Unlock();
+			return 0;
+		}
+	}
+	else
+	{
+		m_pollWaitingForIdle = false;
+		m_pollWarned = false;
+		if( !m_awakeNodesQueried )
+		{
+			// don't poll just yet, wait before re-checking to see if the awake nodes have been queried
+			timeout = 500;
+		}
+	}
+
+	// Sleep until the next poll comes due, unless something else needs looking at first
+	m_pollMutex->Lock();
+	uint32 ticks = m_pollWheel.GetTicksToNext();
+	m_pollMutex->Unlock();
+	if( ticks )
+	{
+		int32 due = (int32)( ticks * c_pollTickMs ) + m_pollLastTick.TimeRemaining();
+		if( due < 0 )
+		{
+			due = 0;
+		}
+		if( timeout == Wait::Timeout_Infinite || due < timeout )
+		{
+			timeout = due;
+		}
+	}
+
+	m_pollEvent->Reset();
+
+	// Nodes presumed dead are probed from here too
+	int32 probe = ProbeDeadNodes();
+	if( probe != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || probe < timeout ) )
+	{
+		timeout = probe;
+	}
+
+	// as are listening nodes that have gone quiet
+	int32 quiet = ProbeQuietNodes();
+	if( quiet != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || quiet < timeout ) )
+	{
+		timeout = quiet;
+	}
+
+	// and the links between nodes tested
+	int32 health = RunHealthScan();
+	if( health != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || health < timeout ) )
+	{
+		timeout = health;
+	}
+
+	// and any neighbor lists that have gone stale refreshed
+	int32 refresh = RefreshStaleNeighbors();
+	if( refresh != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || refresh < timeout ) )
+	{
+		timeout = refresh;
+	}
+
+	// and the nodes that may have missed a broadcast checked
+	int32 broadcast = RunBroadcastChecks();
+	if( broadcast != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || broadcast < timeout ) )
+	{
+		timeout = broadcast;
+	}
+
+	// and the network healed, a node at a time
+	int32 heal = RunHeal();
+	if( heal != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || heal < timeout ) )
+	{
+		timeout = heal;
+	}
+
+	// and the return routes of nodes whose associations changed brought up to date
+	int32 routes = RunRouteUpdates();
+	if( routes != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || routes < timeout ) )
+	{
+		timeout = routes;
+	}
+
+	// and the clocks of the nodes kept in step with the host's
+	int32 timeSync = RunTimeSync();
+	if( timeSync != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || timeSync < timeout ) )
+	{
+		timeout = timeSync;
+	}
+
+	// and the values of many nodes refreshed
+	int32 round = RunRefreshRound();
+	if( round != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || round < timeout ) )
+	{
+		timeout = round;
+	}
+
+	// and any sniffed frames written to their trace
+	int32 sniffed = TraceSniffedFrames();
+	if( sniffed != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || sniffed < timeout ) )
+	{
+		timeout = sniffed;
+	}
+
+	return timeout;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetPollTicks>
+// Time until a value is next due to be polled
+//-----------------------------------------------------------------------------
+uint32 Driver::GetPollTicks
+(
+		Value const* _value
+)
+{
+	int64 interval = _value->GetPollInterval();
+	if( interval == 0 )
+	{
+		// Derive it from the intensity: a value with intensity N is polled
+		// once every N times through the poll list.
+		int64 pollInterval = m_pollInterval;
+		if( pollInterval < 100 )
+		{
+			Log::Write( LogLevel_Info, "The pollInterval setting is only %d, which appears to be a legacy setting.  Multiplying by 1000 to convert to ms.", m_pollInterval );
+			pollInterval *= 1000;
+		}
+		interval = pollInterval * ( _value->GetPollIntensity() ? _value->GetPollIntensity() : 1 );
+		if( m_bIntervalBetweenPolls )
+		{
+			// The interval is between each poll, so one pass takes that long for every value in the list
+			interval *= (int64)( m_pollWheel.Size() + m_pollDue.size() + 1 );
+		}
+	}
+
+	interval /= c_pollTickMs;
+	if( interval < 1 )
+	{
+		interval = 1;
+	}
+	return( interval > 0x7fffffff ? 0x7fffffff : (uint32)interval );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetPollPhaseTicks>
+// Time until a value's own slot in its poll interval comes round.  The slot is
+// taken from a hash of the ValueID, so values with the same interval are spread
+// evenly across it, and a value keeps its slot from one poll to the next.
+//-----------------------------------------------------------------------------
+uint32 Driver::GetPollPhaseTicks
+(
+		ValueID const& _valueId,
+		uint32 const _interval
+)
+{
+	if( _interval <= 1 )
+	{
+		return 1;
+	}
+
+	// Mix all the bits of the ID, as values on one node differ only in a few of them
+	uint64 hash = _valueId.GetId() ^ ( (uint64)_valueId.GetHomeId() << 16 );
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+
+	uint32 phase = (uint32)( hash % _interval );
+	uint32 ticks = ( phase + _interval - m_pollWheel.GetNow() % _interval ) % _interval;
+	return( ticks ? ticks : _interval );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetPollSpacing>
+// Minimum time between two polls
+//-----------------------------------------------------------------------------
+int32 Driver::GetPollSpacing
+(
+)
+{
+	int32 pollInterval = m_pollInterval;
+	if( pollInterval < 100 )
+	{
+		pollInterval *= 1000;
+	}
+
+	if( m_bIntervalBetweenPolls )
+	{
+		return pollInterval;
+	}
+
+	// If the polling interval is for the whole poll list, leave enough time
+	// between polls for all of them to take place within the interval.
+	size_t count = m_pollWheel.Size() + m_pollDue.size();
+	return( count ? pollInterval / (int32)count : pollInterval );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsSendIdle>
+// Check whether the send queues that polls give way to are empty.  The
+// poll thread reads m_sendIdle instead, which the driver thread sets from this.
+//-----------------------------------------------------------------------------
+bool Driver::IsSendIdle
+(
+)const
+{
+	return( m_msgQueue[MsgQueue_Poll].empty()
+			&& m_msgQueue[MsgQueue_Send].empty()
+			&& m_msgQueue[MsgQueue_Command].empty()
+			&& m_msgQueue[MsgQueue_Query].empty()
+			&& m_currentMsg == NULL
+			&& m_inFlight.empty() );
+}
+
+//-----------------------------------------------------------------------------
+// <CompareCommandClass>
+// Order values by their command class
+//-----------------------------------------------------------------------------
+static bool CompareCommandClass
+(
+		ValueID const& _first,
+		ValueID const& _second
+)
+{
+	return( _first.GetCommandClassId() < _second.GetCommandClassId() );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::PollNode>
+// Request the state of values that came due together on one node
+//-----------------------------------------------------------------------------
+void Driver::PollNode
+(
+		Node* _node,
+		list<ValueID> const& _valueIds
+)
+{
+	list<ValueID> requests;
+	for( list<ValueID>::const_iterator it = _valueIds.begin(); it != _valueIds.end(); ++it )
+	{
+		if( Value* value = GetValue( *it ) )
+		{
+			// Schedule the next poll of this value.  Its slot is kept even if this
+			// poll was late, so a backlog does not leave the values in step.
+			m_pollWheel.Insert( *it, GetPollPhaseTicks( *it, GetPollTicks( value ) ) );
+			value->Release();
+			requests.push_back( *it );
+		}
+	}
+
+	if( requests.empty() )
+	{
+		return;
+	}
+
+	if( !_node->IsListeningDevice() )
+	{
+		// The device is not awake all the time.  If it is not awake, we mark it
+		// as requiring a poll.  The poll will be done next time the node wakes up.
+		if( WakeUp* wakeUp = static_cast<WakeUp*>( _node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+		{
+			if( !wakeUp->IsAwake() )
+			{
+				int32 nextWakeUp = wakeUp->GetNextWakeUp();
+				if( nextWakeUp < 0 )
+				{
+					// Nothing is known of when it wakes, so ask for all its
+					// values once it has woken
+					wakeUp->SetPollRequired();
+					return;
+				}
+
+				if( nextWakeUp > c_wakeUpStageMs )
+				{
+					// Hold the values back until just before the predicted wake up.  The
+					// whole batch is held by the same jitter, so it stays together.
+					uint32 ticks = (uint32)( nextWakeUp - c_wakeUpStageMs + rand() % c_wakeUpJitterMs ) / c_pollTickMs;
+					for( list<ValueID>::iterator it = requests.begin(); it != requests.end(); ++it )
+					{
+						m_pollWheel.Insert( *it, ticks ? ticks : 1 );
+					}
+					return;
+				}
+
+				// The node is due to wake.  The requests go into its wake up queue,
+				// ready to be sent together as soon as it does.
+			}
+		}
+	}
+
+	// Keep the requests for each command class together.  The sort is stable,
+	// so values of one class are still requested in the order they came due.
+	requests.sort( CompareCommandClass );
+
+	m_pollBatchThreadId = Thread::GetCurrentId();
+	m_pollBatchNodeId = _node->m_nodeId;
+	for( list<ValueID>::iterator it = requests.begin(); it != requests.end(); ++it )
+	{
+		// Request an update of the value
+		if( CommandClass* cc = _node->GetCommandClass( it->GetCommandClassId() ) )
+		{
+			uint8 index = it->GetIndex();
+			uint8 instance = it->GetInstance();
+			Log::Write( LogLevel_Detail, _node->m_nodeId, "Polling: %s index = %d instance = %d (poll queue has %d messages)", cc->GetCommandClassName().c_str(), index, instance, m_msgQueue[MsgQueue_Poll].size() );
+			cc->RequestValueIfStale( -1, 0, index, instance, MsgQueue_Poll );
+		}
+	}
+	m_pollBatchNodeId = 0;
+
+	FlushPollBatch( _node, (uint32)requests.size() );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::FlushPollBatch>
+// Queue the poll requests collected for a node.  Identical requests are only
+// sent once, and if the node supports MultiCmd the rest are packed into as
+// few encapsulated frames as possible.  Anything that cannot be packed is
+// queued back to back.
+//-----------------------------------------------------------------------------
+void Driver::FlushPollBatch
+(
+		Node* _node,
+		uint32 _valueCount
+)
+{
+	list<Msg*> batch;
+	batch.swap( m_pollBatch );
+	if( batch.empty() )
+	{
+		return;
+	}
+
+	RemoveDuplicateRequests( batch );
+
+	uint32 encapsulated = 0;
+	uint32 frames = SendBatch( _node, batch, MsgQueue_Poll, encapsulated );
+
+	// The driver thread sets this again once the requests have gone.  Those
+	// for a sleeping node wait in its wake up queue instead, and must not
+	// hold up the poll thread.
+	bool asleep = false;
+	if( !_node->IsListeningDevice() )
+	{
+		if( WakeUp* wakeUp = static_cast<WakeUp*>( _node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+		{
+			asleep = !wakeUp->IsAwake();
+		}
+	}
+	if( !asleep )
+	{
+		m_sendIdle = false;
+		m_sendIdleEvent->Reset();
+	}
+
+	if( _valueCount > 1 )
+	{
+		++m_nodeCounters.m_pollBatches[_node->GetNodeId()];
+		if( _valueCount > frames )
+		{
+			m_nodeCounters.m_pollsCoalesced[_node->GetNodeId()] += _valueCount - frames;
+		}
+		Log::Write( LogLevel_Detail, _node->m_nodeId, "Polled %d values in %d frames (%d requests MultiCmd encapsulated)", _valueCount, frames, encapsulated );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RemoveDuplicateRequests>
+// Values that share a report (several readings of one multi-value sensor,
+// for example) all ask for it with the same Get, which need only be sent once
+//-----------------------------------------------------------------------------
+void Driver::RemoveDuplicateRequests
+(
+		list<Msg*>& _batch
+)
+{
+	for( list<Msg*>::iterator it = _batch.begin(); it != _batch.end(); ++it )
+	{
+		uint8 length = 0;
+		uint8 const* payload = (*it)->GetSendDataPayload( length );
+		if( payload == NULL )
+		{
+			continue;
+		}
+
+		list<Msg*>::iterator dup = it;
+		++dup;
+		while( dup != _batch.end() )
+		{
+			uint8 dupLength = 0;
+			uint8 const* dupPayload = (*dup)->GetSendDataPayload( dupLength );
+			if( ( dupPayload != NULL ) && ( dupLength == length ) && !memcmp( payload, dupPayload, length ) )
+			{
+				delete *dup;
+				dup = _batch.erase( dup );
+			}
+			else
+			{
+				++dup;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CollectTriggeredRefresh>
+// Hold back a refresh triggered while a frame from the node is handled
+//-----------------------------------------------------------------------------
+bool Driver::CollectTriggeredRefresh
+(
+		uint8 const _nodeId,
+		uint8 const _commandClassId,
+		uint8 const _requestFlags,
+		uint8 const _instance,
+		uint8 const _index
+)
+{
+	LockGuard LG( m_triggerMutex );
+	if( _nodeId != m_triggerNodeId )
+	{
+		return false;
+	}
+
+	TriggeredRefresh refresh;
+	refresh.m_commandClassId = _commandClassId;
+	refresh.m_requestFlags = _requestFlags;
+	refresh.m_instance = _instance;
+	refresh.m_index = _index;
+	if( find( m_triggeredRefreshes.begin(), m_triggeredRefreshes.end(), refresh ) == m_triggeredRefreshes.end() )
+	{
+		m_triggeredRefreshes.push_back( refresh );
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::FlushTriggeredRefreshes>
+// Request the values that the frame just handled triggered refreshes of.
+// Each is asked for once, and if the node supports MultiCmd the requests
+// are packed together.
+//-----------------------------------------------------------------------------
+void Driver::FlushTriggeredRefreshes
+(
+		uint8 const _nodeId
+)
+{
+	list<TriggeredRefresh> refreshes;
+	m_triggerMutex->Lock();
+	m_triggerNodeId = 0;
+	refreshes.swap( m_triggeredRefreshes );
+	m_triggerMutex->Unlock();
+	if( refreshes.empty() )
+	{
+		return;
+	}
+
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( _nodeId );
+	if( node == NULL )
+	{
+		return;
+	}
+
+	// As in SetValues, only the requests for a listening node are collected
+	bool pack = ( refreshes.size() > 1 ) && node->IsListeningDevice() && ( node->GetCommandClass( MultiCmd::StaticGetCommandClassId() ) != NULL );
+	if( pack )
+	{
+		m_setBatchNodeId = _nodeId;
+	}
+	for( list<TriggeredRefresh>::const_iterator it = refreshes.begin(); it != refreshes.end(); ++it )
+	{
+		if( CommandClass* cc = node->GetCommandClass( it->m_commandClassId ) )
+		{
+			cc->RequestValueIfStale( -1, it->m_requestFlags, it->m_index, it->m_instance, MsgQueue_Send );
+		}
+	}
+	m_setBatchNodeId = 0;
+
+	if( pack )
+	{
+		list<Msg*> batch;
+		batch.swap( m_setBatch );
+		RemoveDuplicateRequests( batch );
+		uint32 count = (uint32)batch.size();
+		uint32 encapsulated = 0;
+		uint32 frames = SendBatch( node, batch, MsgQueue_Send, encapsulated );
+		Log::Write( LogLevel_Detail, _nodeId, "Refreshed %d values with %d requests in %d frames (%d requests MultiCmd encapsulated)", (int)refreshes.size(), count, frames, encapsulated );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RefreshThermostat>
+// Request a thermostat's mode, operating state and setpoints, those not read
+// within the maximum age, packed together if the node supports MultiCmd
+//-----------------------------------------------------------------------------
+bool Driver::RefreshThermostat
+(
+		uint8 const _nodeId,
+		int32 const _maxAge
+)
+{
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( _nodeId );
+	if( node == NULL )
+	{
+		return false;
+	}
+
+	// Each setpoint type the node supports has a value, so only those are asked for.
+	// The IDs are taken first, as a refresh from the cache notifies the watchers.
+	list<ValueID> values;
+	ValueStore* vs = node->GetValueStore();
+	for( ValueStore::Iterator it = vs->Begin(); it != vs->End(); ++it )
+	{
+		uint8 ccId = it->second->GetID().GetCommandClassId();
+		if( ( ccId == ThermostatMode::StaticGetCommandClassId() ) || ( ccId == ThermostatOperatingState::StaticGetCommandClassId() ) || ( ccId == ThermostatSetpoint::StaticGetCommandClassId() ) )
+		{
+			values.push_back( it->second->GetID() );
+		}
+	}
+	if( values.empty() )
+	{
+		return false;
+	}
+
+	// As in SetValues, only the requests for a listening node are collected
+	bool pack = node->IsListeningDevice() && ( node->GetCommandClass( MultiCmd::StaticGetCommandClassId() ) != NULL );
+	if( pack )
+	{
+		m_setBatchNodeId = _nodeId;
+	}
+	for( list<ValueID>::const_iterator it = values.begin(); it != values.end(); ++it )
+	{
+		if( CommandClass* cc = node->GetCommandClass( it->GetCommandClassId() ) )
+		{
+			cc->RequestValueIfStale( _maxAge, 0, it->GetIndex(), it->GetInstance(), MsgQueue_Send );
+		}
+	}
+	m_setBatchNodeId = 0;
+
+	if( pack )
+	{
+		list<Msg*> batch;
+		batch.swap( m_setBatch );
+		RemoveDuplicateRequests( batch );
+		uint32 count = (uint32)batch.size();
+		uint32 encapsulated = 0;
+		uint32 frames = count ? SendBatch( node, batch, MsgQueue_Send, encapsulated ) : 0;
+		Log::Write( LogLevel_Detail, _nodeId, "Refreshed %d thermostat values with %d requests in %d frames (%d requests MultiCmd encapsulated)", (int)values.size(), count, frames, encapsulated );
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AddFloodedNode>
+// Look after the reports held back from a node that is sending too many
+//-----------------------------------------------------------------------------
+void Driver::AddFloodedNode
+(
+		uint8 const _nodeId
+)
+{
+	if( find( m_floodedNodes.begin(), m_floodedNodes.end(), _nodeId ) == m_floodedNodes.end() )
+	{
+		m_floodedNodes.push_back( _nodeId );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReleaseHeldFrames>
+// Handle the held reports that the nodes' rate limits now allow, as if
+// they had just arrived
+//-----------------------------------------------------------------------------
+int32 Driver::ReleaseHeldFrames
+(
+)
+{
+	int32 timeout = -1;
+	list<uint8>::iterator it = m_floodedNodes.begin();
+	while( it != m_floodedNodes.end() )
+	{
+		uint8 nodeId = *it;
+		Node* node = GetNodeUnsafe( nodeId );
+		int32 remaining = -1;
+		if( node != NULL )
+		{
+			m_triggerMutex->Lock();
+			m_triggerNodeId = nodeId;
+			m_triggerMutex->Unlock();
+
+			remaining = node->ReleaseHeldFrames();
+
+			FlushTriggeredScenes();
+			FlushTriggeredRefreshes( nodeId );
+		}
+
+		if( remaining < 0 )
+		{
+			it = m_floodedNodes.erase( it );
+			continue;
+		}
+		if( timeout < 0 || remaining < timeout )
+		{
+			timeout = remaining;
+		}
+		++it;
+	}
+	return timeout;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SendBatch>
+// Queue a batch of messages for a node.  If the node supports MultiCmd they
+// are packed into as few encapsulated frames as possible, and anything that
+// cannot be packed is queued back to back.  Returns the number of frames.
+//-----------------------------------------------------------------------------
+uint32 Driver::SendBatch
+(
+		Node* _node,
+		list<Msg*>& _batch,
+		MsgQueue const _queue,
+		uint32& _encapsulated
+)
+{
+	bool multiCmd = ( _batch.size() > 1 ) && ( _node->GetCommandClass( MultiCmd::StaticGetCommandClassId() ) != NULL );
+	bool security = ( _node->GetCommandClass( Security::StaticGetCommandClassId() ) != NULL );
+	uint32 frames = 0;
+	_encapsulated = 0;
+
+	list<Msg*> encap;
+	uint32 encapLength = 3;		// command class, command and count
+	list<Msg*>::iterator it = _batch.begin();
+	while( it != _batch.end() || !encap.empty() )
+	{
+		Msg* msg = NULL;
+		uint8 length = 0;
+		uint8 const* payload = NULL;
+		if( it != _batch.end() )
+		{
+			msg = *it;
+			++it;
+			if( multiCmd )
+			{
+				payload = msg->GetSendDataPayload( length );
+
+				// Encrypted requests have to go on their own
+				if( payload && security )
+				{
+					CommandClass* cc = _node->GetCommandClass( payload[0] );
+					if( cc && cc->IsSecured() )
+					{
+						payload = NULL;
+					}
+				}
+			}
+		}
+
+		if( payload && ( encapLength + length + 1 <= c_maxMultiCmdPayload ) )
+		{
+			encap.push_back( msg );
+			encapLength += length + 1;
+			continue;
+		}
+
+		// Send what has been packed so far before going on
+		if( encap.size() == 1 )
+		{
+			SendMsg( encap.front(), _queue );
+			++frames;
+		}
+		else if( !encap.empty() )
+		{
+			char const* logText = "MultiCmd Encapsulated Set";
+			if( MsgQueue_Poll == _queue )
+			{
+				logText = "MultiCmd Encapsulated Poll";
+			}
+			else if( MsgQueue_WakeUp == _queue )
+			{
+				logText = "MultiCmd Encapsulated Wake Up Queue";
+			}
+			Msg* encapMsg = new Msg( logText, _node->m_nodeId, REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+			encapMsg->Append( _node->m_nodeId );
+			encapMsg->Append( (uint8)encapLength );
+			encapMsg->Append( MultiCmd::StaticGetCommandClassId() );
+			encapMsg->Append( MultiCmd::MultiCmdCmd_Encap );
+			encapMsg->Append( (uint8)encap.size() );
+			for( list<Msg*>::iterator eit = encap.begin(); eit != encap.end(); ++eit )
+			{
+				uint8 encapPayloadLength = 0;
+				uint8 const* encapPayload = (*eit)->GetSendDataPayload( encapPayloadLength );
+				encapMsg->Append( encapPayloadLength );
+				for( uint8 i=0; i<encapPayloadLength; ++i )
+				{
+					encapMsg->Append( encapPayload[i] );
+				}
+				delete *eit;
+			}
+			encapMsg->Append( GetTransmitOptions() );
+			_encapsulated += (uint32)encap.size();
+			SendMsg( encapMsg, _queue );
+			++frames;
+		}
+		encap.clear();
+		encapLength = 3;
+
+		if( payload )
+		{
+			// Start the next encapsulation with this request
+			encap.push_back( msg );
+			encapLength += length + 1;
+		}
+		else if( msg )
+		{
+			SendMsg( msg, _queue );
+			++frames;
+		}
+	}
+
+	_batch.clear();
+	return frames;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SetValues>
+// Set several values, packing the commands for each node together
+//-----------------------------------------------------------------------------
+bool Driver::SetValues
+(
+		vector< pair<ValueID,string> > const& _values
+)
+{
+	// Group the values by node, keeping each node's in the order given
+	map< uint8, vector< pair<ValueID,string> > > nodes;
+	for( vector< pair<ValueID,string> >::const_iterator it = _values.begin(); it != _values.end(); ++it )
+	{
+		nodes[it->first.GetNodeId()].push_back( *it );
+	}
+
+	bool res = true;
+	for( map< uint8, vector< pair<ValueID,string> > >::iterator nit = nodes.begin(); nit != nodes.end(); ++nit )
+	{
+		WriteLockGuard LG(m_nodeMutex);
+		Node* node = GetNode( nit->first );
+		vector< pair<ValueID,string> > const& values = nit->second;
+
+		// Messages for a sleeping node wait in its wake up queue, so only
+		// the commands for a listening node are collected
+		bool pack = ( node != NULL ) && ( values.size() > 1 ) && node->IsListeningDevice() && ( node->GetCommandClass( MultiCmd::StaticGetCommandClassId() ) != NULL );
+		if( pack )
+		{
+			m_setBatchNodeId = nit->first;
+		}
+		for( vector< pair<ValueID,string> >::const_iterator it = values.begin(); it != values.end(); ++it )
+		{
+			// An unknown value would throw while the commands are being collected
+			Value* value = GetValue( it->first );
+			if( value == NULL )
+			{
+				Log::Write( LogLevel_Warning, nit->first, "SetValues: value not found" );
+				res = false;
+				continue;
+			}
+			value->Release();
+
+			if( !Manager::Get()->SetValue( it->first, it->second ) )
+			{
+				res = false;
+			}
+		}
+		m_setBatchNodeId = 0;
+
+		if( pack )
+		{
+			list<Msg*> batch;
+			batch.swap( m_setBatch );
+			uint32 count = (uint32)batch.size();
+			uint32 encapsulated = 0;
+			uint32 frames = SendBatch( node, batch, MsgQueue_Send, encapsulated );
+			Log::Write( LogLevel_Detail, nit->first, "Set %d values with %d commands in %d frames (%d commands MultiCmd encapsulated)", (int)values.size(), count, frames, encapsulated );
+		}
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+//	Retrieving Node information
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Driver::InitAllNodes>
+// Delete all nodes and fetch new node data from the Z-Wave network
+//-----------------------------------------------------------------------------
+void Driver::InitAllNodes
+(
+)
+{
+	// Delete all the node data
+	{
+		WriteLockGuard LG(m_nodeMutex);
+		while( !m_nodeIds.empty() )
+		{
+			SetNodeObject( m_nodeIds.front(), NULL );
+		}
+	}
+	// Fetch new node data from the Z-Wave network
+	m_controller->PlayInitSequence( this );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::InitNode>
+// Queue a node to be interrogated for its setup details
+//-----------------------------------------------------------------------------
+void Driver::InitNode
+(
+		uint8 const _nodeId,
+		bool newNode,
+		bool secure,
+		uint8 const *_protocolInfo,
+		uint8 const _length
+)
+{
+	// Delete any existing node and replace it with a new one
+	{
+		WriteLockGuard LG(m_nodeMutex);
+		if( m_nodes[_nodeId] )
+		{
+			// Remove the original node
+			SetNodeObject( _nodeId, NULL );
+			Notification* notification = new Notification( Notification::Type_NodeRemoved );
+			notification->SetHomeAndNodeIds( m_homeId, _nodeId );
+			QueueNotification( notification );
+		}
+
+		// Add the new node
+		SetNodeObject( _nodeId, new Node( m_homeId, _nodeId ) );
+		if (newNode == true) static_cast<Node *>(m_nodes[_nodeId])->SetAddingNode();
+	}
+
+	Notification* notification = new Notification( Notification::Type_NodeAdded );
+	notification->SetHomeAndNodeIds( m_homeId, _nodeId );
+	QueueNotification( notification );
+
+	if (_length == 0) {
+		// Request the node info
+		m_nodes[_nodeId]->SetQueryStage( Node::QueryStage_ProtocolInfo );
+	} else {
+		if (isNetworkKeySet())
+			m_nodes[_nodeId]->SetSecured(secure);
+		else
+			Log::Write(LogLevel_Info, _nodeId, "Network Key Not Set - Secure Option is %s", secure ? "required" : "not required");
+		m_nodes[_nodeId]->SetProtocolInfo(_protocolInfo, _length);
+	}
+	Log::Write(LogLevel_Info, _nodeId, "Initializing Node. New Node: %s (%s)", static_cast<Node *>(m_nodes[_nodeId])->IsAddingNode() ? "true" : "false", newNode ? "true" : "false");
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeListeningDevice>
+// Get whether the node is a listening device that does not go to sleep
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeListeningDevice
+(
+		uint8 const _nodeId
+)
+{
+	bool res = false;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		res = node->IsListeningDevice();
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeFrequentListeningDevice>
+// Get whether the node is a listening device that does not go to sleep
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeFrequentListeningDevice
+(
+		uint8 const _nodeId
+)
+{
+	bool res = false;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		res = node->IsFrequentListeningDevice();
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeBeamingDevice>
+// Get whether the node is a beam capable device.
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeBeamingDevice
+(
+		uint8 const _nodeId
+)
+{
+	bool res = false;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		res = node->IsBeamingDevice();
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeRoutingDevice>
+// Get whether the node is a routing device that passes messages to other nodes
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeRoutingDevice
+(
+		uint8 const _nodeId
+)
+{
+	bool res = false;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		res = node->IsRoutingDevice();
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsNodeSecurityDevice>
+// Get the security attribute for a node
+//-----------------------------------------------------------------------------
+bool Driver::IsNodeSecurityDevice
+(
+		uint8 const _nodeId
+)
+{
+	bool security = false;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		security = node->IsSecurityDevice();
+	}
+
+	return security;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeMaxBaudRate>
+// Get the maximum baud rate of a node's communications
+//-----------------------------------------------------------------------------
+uint32 Driver::GetNodeMaxBaudRate
+(
+		uint8 const _nodeId
+)
+{
+	uint32 baud = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		baud = node->GetMaxBaudRate();
+	}
+
+	return baud;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeVersion>
+// Get the version number of a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeVersion
+(
+		uint8 const _nodeId
+)
+{
+	uint8 version = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		version = node->GetVersion();
+	}
+
+	return version;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeSecurity>
+// Get the security byte of a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeSecurity
+(
+		uint8 const _nodeId
+)
+{
+	uint8 security = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		security = node->GetSecurity();
+	}
+
+	return security;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeBasic>
+// Get the basic type of a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeBasic
+(
+		uint8 const _nodeId
+)
+{
+	uint8 basic = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		basic = node->GetBasic();
+	}
+
+	return basic;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeGeneric>
+// Get the generic type of a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeGeneric
+(
+		uint8 const _nodeId
+)
+{
+	uint8 genericType = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		genericType = node->GetGeneric();
+	}
+
+	return genericType;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeSpecific>
+// Get the specific type of a node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeSpecific
+(
+		uint8 const _nodeId
+)
+{
+	uint8 specific = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		specific = node->GetSpecific();
+	}
+
+	return specific;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeType>
+// Get the basic/generic/specific type of the specified node
+// Returns a copy of the string rather than a const ref for thread safety
+//-----------------------------------------------------------------------------
+string Driver::GetNodeType
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetType();
+	}
+
+	return "Unknown";
+}
+
+
+bool Driver::IsNodeZWavePlus
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->IsNodeZWavePlus();
+	}
+	return false;
+}
+
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeNeighbors>
+// Gets the neighbors for a node
+//-----------------------------------------------------------------------------
+uint32 Driver::GetNodeNeighbors
+(
+		uint8 const _nodeId,
+		uint8** o_neighbors
+)
+{
+	*o_neighbors = NULL;
+	uint8 const* row = GetNodeNeighborBitmap( _nodeId );
+	if( row == NULL )
+	{
+		return 0;
+	}
+
+	ReadLockGuard LG(m_nodeMutex);
+	NodeSet neighbors( row );
+	uint32 numNeighbors = neighbors.GetCount();
+	if( !numNeighbors )
+	{
+		return 0;
+	}
 
-				if( m_notifytransactions )
-				{
-					Notification* notification = new Notification( Notification::Type_Notification );
-					notification->SetHomeAndNodeIds( m_homeId, _data[3] );
-					notification->SetNotification( Notification::Code_MsgComplete );
-					QueueNotification( notification );
-				}
-				RemoveCurrentMsg();
-			}
-		}
+	uint8* ids = new uint8[numNeighbors];
+	uint32 index = 0;
+	uint32 position = 0;
+	InstanceAssociation neighbor;
+	while( index < numNeighbors && neighbors.GetNext( position, &neighbor ) )
+	{
+		ids[index++] = neighbor.m_nodeId;
 	}
+	*o_neighbors = ids;
+	return index;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetVersionResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeNeighborBitmap>
+// The bitmap of a node's neighbors, without copying it
 //-----------------------------------------------------------------------------
-void Driver::HandleGetVersionResponse
+uint8 const* Driver::GetNodeNeighborBitmap
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	m_libraryVersion = (char*)&_data[2];
+	if( ( _nodeId == 0 ) || ( _nodeId > NUM_NODE_BITFIELD_BYTES*8 ) )
+	{
+		return NULL;
+	}
 
-	m_libraryType = _data[m_libraryVersion.size()+3];
-	if( m_libraryType < 9 )
+	// The list is only known once the node has got past the neighbor query
+	NodeGuard LG( this, _nodeId );
+	Node* node = LG.GetNode();
+	if( node == NULL || node->GetCurrentQueryStage() < Node::QueryStage_Session )
 	{
-		m_libraryTypeName = c_libraryTypeNames[m_libraryType];
+		return NULL;
 	}
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_VERSION:" );
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    %s library, version %s", m_libraryTypeName.c_str(), m_libraryVersion.c_str() );
+	return m_topology[_nodeId-1];
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetRandomResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNetworkTopology>
+// Copy every node's neighbor bitmap, unless the caller's copy is current
 //-----------------------------------------------------------------------------
-
-void Driver::HandleGetRandomResponse
+uint32 Driver::GetNetworkTopology
 (
-		uint8* _data
+		uint8* o_topology,
+		uint32 const _version
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_RANDOM: %s", _data[2] ? "true" : "false" );
+	ReadLockGuard LG(m_nodeMutex);
+	if( _version != m_topologyVersion )
+	{
+		memcpy( o_topology, m_topology, sizeof(m_topology) );
+	}
+	return m_topologyVersion;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetControllerCapabilitiesResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeManufacturerName>
+// Get the manufacturer name for the node with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-void Driver::HandleGetControllerCapabilitiesResponse
+string Driver::GetNodeManufacturerName
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	m_controllerCaps = _data[2];
-
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:" );
-
-	char str[256];
-	if( m_controllerCaps & ControllerCaps_SIS )
-	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    There is a SUC ID Server (SIS) in this network." );
-		snprintf( str, sizeof(str), "    The PC controller is an inclusion %s%s%s",
-				( m_controllerCaps & ControllerCaps_SUC ) ? "static update controller (SUC)" : "controller",
-						( m_controllerCaps & ControllerCaps_OnOtherNetwork ) ? " which is using a Home ID from another network" : "",
-								( m_controllerCaps & ControllerCaps_RealPrimary ) ? " and was the original primary before the SIS was added." : "." );
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), str );
-
-	}
-	else
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    There is no SUC ID Server (SIS) in this network." );
-		snprintf( str, sizeof(str), "    The PC controller is a %s%s%s",
-				( m_controllerCaps & ControllerCaps_Secondary ) ? "secondary" : "primary",
-						( m_controllerCaps & ControllerCaps_SUC ) ? " static update controller (SUC)" : " controller",
-								( m_controllerCaps & ControllerCaps_OnOtherNetwork ) ? " which is using a Home ID from another network." : "." );
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), str );
+		return node->GetManufacturerName();
 	}
+
+	return "";
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetSerialAPICapabilitiesResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeProductName>
+// Get the product name for the node with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-void Driver::HandleGetSerialAPICapabilitiesResponse
+string Driver::GetNodeProductName
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), " Received reply to FUNC_ID_SERIAL_API_GET_CAPABILITIES" );
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Serial API Version:   %d.%d", _data[2], _data[3] );
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Manufacturer ID:      0x%.2x%.2x", _data[4], _data[5] );
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Product Type:         0x%.2x%.2x", _data[6], _data[7] );
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Product ID:           0x%.2x%.2x", _data[8], _data[9] );
-
-	// _data[10] to _data[41] are a 256-bit bitmask with one bit set for
-	// each FUNC_ID_ method supported by the controller.
-	// Bit 0 is FUNC_ID_ 1.  So FUNC_ID_SERIAL_API_GET_CAPABILITIES (0x07) will be bit 6 of the first byte.
-	m_serialAPIVersion[0] = _data[2];
-	m_serialAPIVersion[1] = _data[3];
-	m_manufacturerId = ( ( (uint16)_data[4] )<<8) | (uint16)_data[5];
-	m_productType = ( ( (uint16)_data[6] )<<8 ) | (uint16)_data[7];
-	m_productId = ( ( (uint16)_data[8] )<<8 ) | (uint16)_data[9];
-	memcpy( m_apiMask, &_data[10], sizeof( m_apiMask ) );
-
-	if( IsBridgeController() )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		SendMsg( new Msg( "FUNC_ID_ZW_GET_VIRTUAL_NODES", 0xff, REQUEST, FUNC_ID_ZW_GET_VIRTUAL_NODES, false ), MsgQueue_Command);
+		return node->GetProductName();
 	}
-	else if( IsAPICallSupported( FUNC_ID_ZW_GET_RANDOM ) )
 
-	{
-		Msg *msg = new Msg( "FUNC_ID_ZW_GET_RANDOM", 0xff, REQUEST, FUNC_ID_ZW_GET_RANDOM, false );
-		msg->Append( 32 );      // 32 bytes
-		SendMsg( msg, MsgQueue_Command );
-	}
-	SendMsg( new Msg( "FUNC_ID_SERIAL_API_GET_INIT_DATA", 0xff, REQUEST, FUNC_ID_SERIAL_API_GET_INIT_DATA, false ), MsgQueue_Command);
-	if( !IsBridgeController() )
-	{
-		Msg* msg = new Msg( "FUNC_ID_SERIAL_API_SET_TIMEOUTS", 0xff, REQUEST, FUNC_ID_SERIAL_API_SET_TIMEOUTS, false );
-		msg->Append( ACK_TIMEOUT / 10 );
-		msg->Append( BYTE_TIMEOUT / 10 );
-		SendMsg( msg, MsgQueue_Command );
-	}
-	Msg* msg = new Msg( "FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION", 0xff, REQUEST, FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION, false, false );
-	msg->Append( APPLICATION_NODEINFO_LISTENING );
-	msg->Append( 0x02 );			// Generic Static Controller
-	msg->Append( 0x01 );			// Specific Static PC Controller
-	msg->Append( 0x00 );			// Length
-	SendMsg( msg, MsgQueue_Command );
+	return "";
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSerialAPISoftResetResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeName>
+// Get the user-editable name for the node with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-void Driver::HandleSerialAPISoftResetResponse
+string Driver::GetNodeName
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to Soft Reset." );
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetNodeName();
+	}
+
+	return "";
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSerialAPIResetRequest>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeLocation>
+// Get the user-editable string for location of the specified node
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-void Driver::HandleSerialAPIResetRequest
+string Driver::GetNodeLocation
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to complete Controller Reset." );
-	if( m_controllerResetEvent != NULL )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		m_controllerResetEvent->Set();
-		m_controllerResetEvent = NULL;
+		return node->GetLocation();
 	}
+
+	return "";
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleEnableSUCResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeManufacturerId>
+// Get the manufacturer Id string value with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-void Driver::HandleEnableSUCResponse
+uint16 Driver::GetNodeManufacturerId
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to Enable SUC." );
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetManufacturerId();
+	}
+
+	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleNetworkUpdateResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeProductType>
+// Get the product type string value with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
 //-----------------------------------------------------------------------------
-bool Driver::HandleNetworkUpdateResponse
+uint16 Driver::GetNodeProductType
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	if( _data[2] )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE - command in progress" );
+		return node->GetProductType();
 	}
-	else
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeProductId>
+// Get the product Id string value with the specified ID
+// Returns a copy of the string rather than a const ref for thread safety
+//-----------------------------------------------------------------------------
+uint16 Driver::GetNodeProductId
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Failed
-		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE - command failed"  );
-		state = ControllerState_Failed;
-		res = false;
+		return node->GetProductId();
 	}
 
-	UpdateControllerState( state );
-	return res;
+	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSetSUCNodeIdResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeDeviceType>
+// Get the node device type as reported in the Z-Wave+ Info report.
 //-----------------------------------------------------------------------------
-void Driver::HandleSetSUCNodeIdResponse
+uint16 Driver::GetNodeDeviceType
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to SET_SUC_NODE_ID." );
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetDeviceType();
+	}
+
+	return 0x00; // unknown
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetSUCNodeIdResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeDeviceTypeString>
+// Get the node DeviceType as a string as reported in the Z-Wave+ Info report.
 //-----------------------------------------------------------------------------
-void Driver::HandleGetSUCNodeIdResponse
+
+string Driver::GetNodeDeviceTypeString
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to GET_SUC_NODE_ID.  Node ID = %d", _data[2] );
-	m_SUCNodeId = _data[2];
-	if( _data[2] == 0)
+
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		bool enableSIS = true;
-		Options::Get()->GetOptionAsBool("EnableSIS", &enableSIS);
-		if (enableSIS) {
-			if (IsAPICallSupported(FUNC_ID_ZW_ENABLE_SUC) && IsAPICallSupported(FUNC_ID_ZW_SET_SUC_NODE_ID)) {
-				Log::Write( LogLevel_Info, "  No SUC, so we become SIS" );
+		return node->GetDeviceTypeString();
+	}
 
-				Msg* msg;
-				msg = new Msg( "Enable SUC", m_Controller_nodeId, REQUEST, FUNC_ID_ZW_ENABLE_SUC, false );
-				msg->Append( 1 );
-				msg->Append( SUC_FUNC_NODEID_SERVER );		// SIS; SUC would be ZW_SUC_FUNC_BASIC_SUC
-				SendMsg( msg, MsgQueue_Send );
+	return ""; // unknown
+}
 
-				msg = new Msg( "Set SUC node ID", m_Controller_nodeId, REQUEST, FUNC_ID_ZW_SET_SUC_NODE_ID, false );
-				msg->Append( m_Controller_nodeId );
-				msg->Append( 1 );								// TRUE, we want to be SUC/SIS
-				msg->Append( 0 );								// no low power
-				msg->Append( SUC_FUNC_NODEID_SERVER );
-				SendMsg( msg, MsgQueue_Send );
-			} else {
-				Log::Write (LogLevel_Info, "Controller Does not Support SUC - Cannot Setup Controller as SUC Node");
-			}
-		} else {
-			Log::Write( LogLevel_Info, "  No SUC, not becoming SUC as option is disabled" );
-		}
+
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodeRole>
+// Get the node role as reported in the Z-Wave+ Info report.
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNodeRole
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetRoleType();
 	}
+
+	return 0x00; // unknown
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleMemoryGetIdResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeRoleString>
+// Get the node role as a string as reported in the Z-Wave+ Info report.
 //-----------------------------------------------------------------------------
-void Driver::HandleMemoryGetIdResponse
+string Driver::GetNodeRoleString
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_MEMORY_GET_ID. Home ID = 0x%02x%02x%02x%02x.  Our node ID = %d", _data[2], _data[3], _data[4], _data[5], _data[6] );
-	m_homeId = ( ( (uint32)_data[2] )<<24 ) | ( ( (uint32)_data[3] )<<16 ) | ( ( (uint32)_data[4] )<<8 ) | ( (uint32)_data[5] );
-	m_Controller_nodeId = _data[6];
-	m_controllerReplication = static_cast<ControllerReplication*>(ControllerReplication::Create( m_homeId, m_Controller_nodeId ));
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		return node->GetRoleTypeString();
+	}
+
+	return ""; // unknown
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSerialAPIGetInitDataResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodePlusType>
+// Get the node role as a string as reported in the Z-Wave+ Info report.
 //-----------------------------------------------------------------------------
-void Driver::HandleSerialAPIGetInitDataResponse
+uint8 Driver::GetNodePlusType
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	int32 i;
-
-	if( !m_init )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Mark the driver as ready (we have to do this first or
-		// all the code handling notifications will go awry).
-		Manager::Get()->SetDriverReady( this, true );
-
-		// Read the config file first, to get the last known state
-		ReadConfig();
+		return node->GetNodeType();
 	}
-	else
+	return 0x00; // unknown
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNodePlusTypeString>
+// Get the node role as a string as reported in the Z-Wave+ Info report.
+//-----------------------------------------------------------------------------
+string Driver::GetNodePlusTypeString
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Notify the user that all node and value information has been deleted
-		// We need to wait to do this here so we have new information to report.
-		Notification* notification = new Notification( Notification::Type_DriverReset );
-		notification->SetHomeAndNodeIds( m_homeId, 0 );
-		QueueNotification( notification );
+		return node->GetNodeTypeString();
 	}
+	return ""; // unknown
+}
 
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_SERIAL_API_GET_INIT_DATA:" );
-	m_initVersion = _data[2];
-	m_initCaps = _data[3];
 
-	if( _data[4] == NUM_NODE_BITFIELD_BYTES )
-	{
-		for( i=0; i<NUM_NODE_BITFIELD_BYTES; ++i)
-		{
-			for( int32 j=0; j<8; ++j )
-			{
-				uint8 nodeId = (i*8)+j+1;
-				if( _data[i+5] & (0x01 << j) )
-				{
-					if( IsVirtualNode( nodeId ) )
-					{
-						Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Virtual (ignored)", nodeId );
-					}
-					else
-					{
-						LockGuard LG(m_nodeMutex);
-						Node* node = GetNode( nodeId );
-						if( node )
-						{
-							Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Known", nodeId );
-							if( !m_init )
-							{
-								// The node was read in from the config, so we
-								// only need to get its current state
-								node->SetQueryStage( Node::QueryStage_CacheLoad );
-							}
 
-						}
-						else
-						{
-							// This node is new
-							Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - New", nodeId );
-							Notification* notification = new Notification( Notification::Type_NodeNew );
-							notification->SetHomeAndNodeIds( m_homeId, nodeId );
-							QueueNotification( notification );
 
-							// Create the node and request its info
-							InitNode( nodeId );
-						}
-					}
-				}
-				else
-				{
-					LockGuard LG(m_nodeMutex);
-					if( GetNode(nodeId) )
-					{
-						// This node no longer exists in the Z-Wave network
-						Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %.3d - Removed", nodeId );
-						delete m_nodes[nodeId];
-						m_nodes[nodeId] = NULL;
-						Notification* notification = new Notification( Notification::Type_NodeRemoved );
-						notification->SetHomeAndNodeIds( m_homeId, nodeId );
-						QueueNotification( notification );
 
-					}
-				}
-			}
-		}
+//-----------------------------------------------------------------------------
+// <Driver::SetNodeManufacturerName>
+// Set the manufacturer name for the node with the specified ID
+//-----------------------------------------------------------------------------
+void Driver::SetNodeManufacturerName
+(
+		uint8 const _nodeId,
+		string const& _manufacturerName
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		node->SetManufacturerName( _manufacturerName );
 	}
-
-	m_init = true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetNodeProtocolInfoResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::SetNodeProductName>
+// Set the product name string value with the specified ID
 //-----------------------------------------------------------------------------
-void Driver::HandleGetNodeProtocolInfoResponse
+void Driver::SetNodeProductName
 (
-		uint8* _data
+		uint8 const _nodeId,
+		string const& _productName
 )
 {
-	// The node that the protocol info response is for is not included in the message.
-	// We have to assume that the node is the same one as in the most recent request.
-	if( !m_currentMsg )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		Log::Write( LogLevel_Warning, "WARNING: Received unexpected FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO message - ignoring.");
-		return;
+		node->SetProductName( _productName );
 	}
+}
 
-	uint8 nodeId = m_currentMsg->GetTargetNodeId();
-	Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO" );
-
-	// Update the node with the protocol info
-	if( Node* node = GetNodeUnsafe( nodeId ) )
+//-----------------------------------------------------------------------------
+// <Driver::SetNodeName>
+// Set the node name string value with the specified ID
+//-----------------------------------------------------------------------------
+void Driver::SetNodeName
+(
+		uint8 const _nodeId,
+		string const& _nodeName
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		node->UpdateProtocolInfo( &_data[2] );
+		node->SetNodeName( _nodeName );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleAssignReturnRouteResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::SetNodeLocation>
+// Set the location string value with the specified ID
 //-----------------------------------------------------------------------------
-bool Driver::HandleAssignReturnRouteResponse
+void Driver::SetNodeLocation
 (
-		uint8* _data
+		uint8 const _nodeId,
+		string const& _location
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	if( _data[2] )
-	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE - command in progress" );
-	}
-	else
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Failed
-		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE - command failed" );
-		state = ControllerState_Failed;
-		res = false;
+		node->SetLocation( _location );
 	}
-
-	UpdateControllerState( state );
-	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleDeleteReturnRouteResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::SetNodeLevel>
+// Helper to set the node level through the basic command class
 //-----------------------------------------------------------------------------
-bool Driver::HandleDeleteReturnRouteResponse
+void Driver::SetNodeLevel
 (
-		uint8* _data
+		uint8 const _nodeId,
+		uint8 const _level
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	if( _data[2] )
-	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE - command in progress" );
-	}
-	else
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Failed
-		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE - command failed" );
-		state = ControllerState_Failed;
-		res = false;
+		node->SetLevel( _level );
 	}
-
-	UpdateControllerState( state );
-	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleRemoveFailedNodeResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::SetNodeOn>
+// Helper to set the node on through the basic command class
 //-----------------------------------------------------------------------------
-bool Driver::HandleRemoveFailedNodeResponse
+void Driver::SetNodeOn
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	ControllerError error = ControllerError_None;
-	if( _data[2] )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		string reason;
-		switch( _data[2] )
-		{
-			case FAILED_NODE_NOT_FOUND:
-			{
-				reason = "Node not found";
-				error = ControllerError_NotFound;
-				break;
-			}
-			case FAILED_NODE_REMOVE_PROCESS_BUSY:
-			{
-				reason = "Remove process busy";
-				error = ControllerError_Busy;
-				break;
-			}
-			case FAILED_NODE_REMOVE_FAIL:
-			{
-				reason = "Remove failed";
-				error = ControllerError_Failed;
-				break;
-			}
-			case FAILED_NODE_NOT_PRIMARY_CONTROLLER:
-			{
-				reason = "Not Primary Controller";
-				error = ControllerError_NotPrimary;
-				break;
-			}
-			default:
-			{
-				reason = "Command failed";
-				break;
-			}
-		}
-
-		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - %s", reason.c_str() );
-		state = ControllerState_Failed;
-		res = false;
+		node->SetNodeOn();
 	}
-	else
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SetNodeOff>
+// Helper to set the node off through the basic command class
+//-----------------------------------------------------------------------------
+void Driver::SetNodeOff
+(
+		uint8 const _nodeId
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - Command in progress" );
+		node->SetNodeOff();
 	}
-
-	UpdateControllerState( state, error );
-	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleIsFailedNodeResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetValue>
+// Get a pointer to a Value object for the specified ValueID
 //-----------------------------------------------------------------------------
-void Driver::HandleIsFailedNodeResponse
+Value* Driver::GetValue
 (
-		uint8* _data
+		ValueID const& _id
 )
 {
-	ControllerState state;
-	uint8 nodeId = m_currentControllerCommand ? m_currentControllerCommand->m_controllerCommandNode : GetNodeNumber( m_currentMsg );
-	if( _data[2] )
+	// This method is only called by code that has already locked the node.
+	// Mix the node, command class, instance and index into the cache slot.
+	uint64 id = _id.GetId();
+	uint32 low = (uint32)id;
+	uint32 slot = ( ( low >> 4 ) ^ ( low >> 14 ) ^ ( low >> 24 ) ^ (uint32)( id >> 56 ) ) & ( c_valueCacheSize - 1 );
+	ValueCacheEntry& entry = m_valueCache[slot];
+	bool locked = AtomicCompareExchange( &entry.m_lock, 0, 1 );
+	uint32 generation = ValueStore::GetGeneration();
+	if( locked && entry.m_value && ( entry.m_id == id ) && ( entry.m_generation == generation ) )
 	{
-		Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_IS_FAILED_NODE_ID - node %d failed", nodeId );
-		state = ControllerState_NodeFailed;
-		if( Node* node = GetNodeUnsafe( nodeId ) )
-		{
-			if (node->IsNodeReset()) {
-				/* a DeviceReset has Occured. Remove the Node */
-				if (!BeginControllerCommand(Driver::ControllerCommand_RemoveFailedNode, NULL, NULL, true, nodeId, 0))
-					Log::Write(LogLevel_Warning, nodeId, "RemoveFailedNode for DeviceResetLocally Command Failed");
+		Value* value = entry.m_value;
+		value->AddRef();
+		AtomicStore( &entry.m_lock, 0 );
+		return value;
+	}
 
-				Notification* notification = new Notification( Notification::Type_NodeReset );
-				notification->SetHomeAndNodeIds( m_homeId, nodeId );
-				QueueNotification( notification );
-				state = ControllerState_Completed;
-			} else {
-				node->SetNodeAlive( false );
-			}
-		}
+	Value* value = NULL;
+	if( Node* node = m_nodes[_id.GetNodeId()] )
+	{
+		value = node->GetValue( _id );
 	}
-	else
+
+	if( locked )
 	{
-		Log::Write( LogLevel_Warning, nodeId, "Received reply to FUNC_ID_ZW_IS_FAILED_NODE_ID - node %d has not failed", nodeId );
-		if( Node* node = GetNodeUnsafe( nodeId ) )
+		if( value )
 		{
-			node->SetNodeAlive( true );
+			entry.m_generation = generation;
+			entry.m_id = id;
+			entry.m_value = value;
 		}
-		state = ControllerState_NodeOK;
+		AtomicStore( &entry.m_lock, 0 );
 	}
-	UpdateControllerState( state );
+	return value;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleReplaceFailedNodeResponse>
-// Process a response from the Z-Wave PC interface
+// Controller commands
 //-----------------------------------------------------------------------------
-bool Driver::HandleReplaceFailedNodeResponse
+
+//-----------------------------------------------------------------------------
+// <Driver::ResetController>
+// Reset controller and erase all node information
+//-----------------------------------------------------------------------------
+void Driver::ResetController
 (
-		uint8* _data
+		Event* _evt
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	if( _data[2] )
+	m_controllerResetEvent = _evt;
+	Log::Write( LogLevel_Info, "Reset controller and erase all node information");
+	Msg* msg = new Msg( "Reset controller and erase all node information", 0xff, REQUEST, FUNC_ID_ZW_SET_DEFAULT, true );
+	SendMsg( msg, MsgQueue_Command );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SoftReset>
+// Soft-reset the Z-Wave controller chip
+//-----------------------------------------------------------------------------
+void Driver::SoftReset
+(
+)
+{
+	Log::Write( LogLevel_Info, "Soft-resetting the Z-Wave controller chip");
+	Msg* msg = new Msg( "Soft-resetting the Z-Wave controller chip", 0xff, REQUEST, FUNC_ID_SERIAL_API_SOFT_RESET, false, false );
+	SendMsg( msg, MsgQueue_Command );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RequestNodeNeighbors>
+// Get the neighbour information for a node from the controller
+//-----------------------------------------------------------------------------
+void Driver::RequestNodeNeighbors
+(
+		uint8 const _nodeId,
+		uint32 const _requestFlags
+)
+{
+	if( IsAPICallSupported( FUNC_ID_ZW_GET_ROUTING_INFO ) )
 	{
-		// Command failed
-		Log::Write( LogLevel_Warning, GetNodeNumber( m_currentMsg ), "WARNING: Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - command failed" );
-		state = ControllerState_Failed;
-		res = false;
+		// Note: This is not the same as RequestNodeNeighbourUpdate.  This method
+		// merely requests the controller's current neighbour information and
+		// the reply will be copied into the relevant Node object for later use.
+		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Requesting routing info (neighbor list) for Node %d", _nodeId );
+		Msg* msg = new Msg( "Get Routing Info", _nodeId, REQUEST, FUNC_ID_ZW_GET_ROUTING_INFO, false );
+		msg->Append( _nodeId );
+		msg->Append( 0 ); // don't remove bad links
+		msg->Append( 0 ); // don't remove non-repeaters
+		msg->Append( 3 ); // funcid
+		SendMsg( msg, MsgQueue_Command );
 	}
-	else
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::BeginControllerCommand>
+// Start the controller performing one of its network management functions
+// Create a ControllerCommand request.
+//-----------------------------------------------------------------------------
+bool Driver::BeginControllerCommand
+(
+		ControllerCommand _command,
+		pfnControllerCallback_t _callback,
+		void* _context,
+		bool _highPower,
+		uint8 _nodeId,
+		uint8 _arg
+)
+{
+	ControllerCommandItem* cci;
+	MsgQueueItem item;
+
+	if( _command == ControllerCommand_None )
 	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - command in progress" );
+		return false;
 	}
 
-	UpdateControllerState( state );
-	return res;
+	Log::Write( LogLevel_Detail, _nodeId, "Queuing (%s) %s", c_sendQueueNames[MsgQueue_Controller], c_controllerCommandNames[_command] );
+	cci = new ControllerCommandItem();
+	cci->m_controllerCommand = _command;
+	cci->m_controllerCallback = _callback;
+	cci->m_controllerCallbackContext = _context;
+	cci->m_highPower = _highPower;
+	cci->m_controllerCommandNode = _nodeId;
+	cci->m_controllerCommandArg = _arg;
+	cci->m_controllerState = ControllerState_Normal;
+	cci->m_controllerStateChanged = false;
+	cci->m_controllerCommandDone = false;
+
+	item.m_command = MsgQueueCmd_Controller;
+	item.m_cci = cci;
+
+	m_sendMutex->Lock();
+	m_msgQueue[MsgQueue_Controller].push_back( item );
+	m_queueEvent[MsgQueue_Controller]->Set();
+	m_sendMutex->Unlock();
+
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSendDataResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::DoControllerCommand>
+// Start the controller performing one of its network management functions
 //-----------------------------------------------------------------------------
-void Driver::HandleSendDataResponse
+void Driver::DoControllerCommand
 (
-		uint8* _data,
-		bool _replication
 )
 {
-	if( _data[2] )
-	{
-		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "  %s delivered to Z-Wave stack", _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA" );
-	}
-	else
+	UpdateControllerState( ControllerState_Starting );
+	switch( m_currentControllerCommand->m_controllerCommand )
 	{
-		Log::Write( LogLevel_Error, GetNodeNumber( m_currentMsg ), "ERROR: %s could not be delivered to Z-Wave stack", _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA" );
-		m_nondelivery++;
-		if( Node* node = GetNodeUnsafe( GetNodeNumber( m_currentMsg ) ) )
+		case ControllerCommand_AddDevice:
+		{
+			if( !IsPrimaryController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Add Device" );
+				Msg* msg = new Msg( "ControllerCommand_AddDevice", 0xff, REQUEST, FUNC_ID_ZW_ADD_NODE_TO_NETWORK, true );
+				uint8 options = ADD_NODE_ANY;
+				if (m_currentControllerCommand->m_highPower) options |= OPTION_HIGH_POWER;
+				if (IsAPICallSupported(FUNC_ID_ZW_EXPLORE_REQUEST_INCLUSION)) options |= OPTION_NWI;
+				msg->Append( options);
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
+		}
+		case ControllerCommand_CreateNewPrimary:
+		{
+			if( IsPrimaryController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotSecondary );
+			}
+			else if( !IsStaticUpdateController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotSUC );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Create New Primary" );
+				Msg* msg = new Msg( "ControllerCommand_CreateNewPrimary", 0xff, REQUEST, FUNC_ID_ZW_CREATE_NEW_PRIMARY, true );
+				msg->Append( CREATE_PRIMARY_START );
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
+		}
+		case ControllerCommand_ReceiveConfiguration:
+		{
+			Log::Write( LogLevel_Info, 0, "Receive Configuration" );
+			Msg* msg = new Msg( "ControllerCommand_ReceiveConfiguration", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, true );
+			msg->Append( 0xff );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_RemoveDevice:
+		{
+			if( !IsPrimaryController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Remove Device" );
+				Msg* msg = new Msg( "ControllerCommand_RemoveDevice", 0xff, REQUEST, FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK, true );
+				msg->Append( m_currentControllerCommand->m_highPower ? REMOVE_NODE_ANY | OPTION_HIGH_POWER : REMOVE_NODE_ANY );
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
+		}
+		case ControllerCommand_HasNodeFailed:
+		{
+			Log::Write( LogLevel_Info, 0, "Requesting whether node %d has failed", m_currentControllerCommand->m_controllerCommandNode );
+			Msg* msg = new Msg( "ControllerCommand_HasNodeFailed", 0xff, REQUEST, FUNC_ID_ZW_IS_FAILED_NODE_ID, false );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_RemoveFailedNode:
+		{
+			Log::Write( LogLevel_Info, 0, "ControllerCommand_RemoveFailedNode", m_currentControllerCommand->m_controllerCommandNode );
+			Msg* msg = new Msg( "ControllerCommand_RemoveFailedNode", 0xff, REQUEST, FUNC_ID_ZW_REMOVE_FAILED_NODE_ID, true );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_ReplaceFailedNode:
+		{
+			Log::Write( LogLevel_Info, 0, "Replace Failed Node %d", m_currentControllerCommand->m_controllerCommandNode );
+			Msg* msg = new Msg( "ControllerCommand_ReplaceFailedNode", 0xff, REQUEST, FUNC_ID_ZW_REPLACE_FAILED_NODE, true );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_TransferPrimaryRole:
+		{
+			if( !IsPrimaryController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Transfer Primary Role" );
+				Msg* msg = new Msg( "ControllerCommand_TransferPrimaryRole", 0xff, REQUEST, FUNC_ID_ZW_CONTROLLER_CHANGE, true );
+				msg->Append( m_currentControllerCommand->m_highPower ? CONTROLLER_CHANGE_START | OPTION_HIGH_POWER : CONTROLLER_CHANGE_START );
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
+		}
+		case ControllerCommand_RequestNetworkUpdate:
 		{
-			node->m_sentFailed++;
+			if( !IsStaticUpdateController() )
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotSUC );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Request Network Update" );
+				Msg* msg = new Msg( "ControllerCommand_RequestNetworkUpdate", 0xff, REQUEST, FUNC_ID_ZW_REQUEST_NETWORK_UPDATE, true );
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
 		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// <Driver::HandleGetRoutingInfoResponse>
-// Process a response from the Z-Wave PC interface
-//-----------------------------------------------------------------------------
-void Driver::HandleGetRoutingInfoResponse
-(
-		uint8* _data
-)
-{
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_GET_ROUTING_INFO" );
-
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( GetNodeNumber( m_currentMsg ) ) )
-	{
-		// copy the 29-byte bitmap received (29*8=232 possible nodes) into this node's neighbors member variable
-		memcpy( node->m_neighbors, &_data[2], 29 );
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Neighbors of this node are:" );
-		bool bNeighbors = false;
-		for( int by=0; by<29; by++ )
+		case ControllerCommand_RequestNodeNeighborUpdate:
 		{
-			for( int bi=0; bi<8; bi++ )
+			if( !IsPrimaryController() )
 			{
-				if( (_data[2+by] & (0x01<<bi)) )
+				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, 0, "Requesting Neighbor Update for node %d", m_currentControllerCommand->m_controllerCommandNode );
+				bool opts = IsAPICallSupported( FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS );
+				Msg* msg;
+				if( opts )
 				{
-					Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "    Node %d", (by<<3)+bi+1 );
-					bNeighbors = true;
+					msg = new Msg( "ControllerCommand_RequestNodeNeighborUpdate", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS, true );
+				}
+				else
+				{
+					msg = new Msg( "ControllerCommand_RequestNodeNeighborUpdate", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE, true );
+				}
+				msg->Append( m_currentControllerCommand->m_controllerCommandNode );
+				if( opts )
+				{
+					msg->Append( GetTransmitOptions() );
 				}
+				SendMsg( msg, MsgQueue_Command );
 			}
+			break;
 		}
-
-		if( !bNeighbors )
+		case ControllerCommand_AssignReturnRoute:
 		{
-			Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), " (none reported)" );
+			Log::Write( LogLevel_Info, 0, "Assigning return route from node %d to node %d", m_currentControllerCommand->m_controllerCommandNode, m_currentControllerCommand->m_controllerCommandArg );
+			Msg* msg = new Msg( "ControllerCommand_AssignReturnRoute", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_ASSIGN_RETURN_ROUTE, true );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
+			msg->Append( m_currentControllerCommand->m_controllerCommandArg );		// to the specific destination
+			SendMsg( msg, MsgQueue_Command );
+			break;
 		}
-	}
-}
-
-//-----------------------------------------------------------------------------
-// <Driver::HandleSendDataRequest>
-// Process a request from the Z-Wave PC interface
-//-----------------------------------------------------------------------------
-void Driver::HandleSendDataRequest
-(
-		uint8* _data,
-		bool _replication
-)
-{
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	Log::Write( LogLevel_Detail, nodeId, "  %s Request with callback ID 0x%.2x received (expected 0x%.2x)",  _replication ? "ZW_REPLICATION_SEND_DATA" : "ZW_SEND_DATA", _data[2], _data[2] < 10 ? _data[2] : m_expectedCallbackId );
-	/* Callback ID's below 10 are reserved for NONCE messages */
-	if ((_data[2] > 10 ) && ( _data[2] != m_expectedCallbackId )) {
-		// Wrong callback ID
-		m_callbacks++;
-		Log::Write( LogLevel_Warning, nodeId, "WARNING: Unexpected Callback ID received" );
-	} else {
-		Node* node = GetNodeUnsafe( nodeId );
-		if( node != NULL )
+		case ControllerCommand_DeleteAllReturnRoutes:
 		{
-			if( _data[3] != 0 )
+			Log::Write( LogLevel_Info, 0, "Deleting all return routes from node %d", m_currentControllerCommand->m_controllerCommandNode );
+			Msg* msg = new Msg( "ControllerCommand_DeleteAllReturnRoutess", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_DELETE_RETURN_ROUTE, true );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_SendNodeInformation:
+		{
+			Log::Write( LogLevel_Info, 0, "Sending a node information frame" );
+			Msg* msg = new Msg( "ControllerCommand_SendNodeInformation", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_SEND_NODE_INFORMATION, true );
+			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// to the node
+			msg->Append( GetTransmitOptions() );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_ReplicationSend:
+		{
+			if( !IsPrimaryController() )
 			{
-				node->m_sentFailed++;
+				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
 			}
 			else
 			{
-				node->m_lastRequestRTT = -node->m_sentTS.TimeRemaining();
-
-				if( node->m_averageRequestRTT )
+				Log::Write( LogLevel_Info, 0, "Replication Send" );
+				Msg* msg = new Msg( "ControllerCommand_ReplicationSend", 0xff, REQUEST, FUNC_ID_ZW_ADD_NODE_TO_NETWORK, true );
+				msg->Append( m_currentControllerCommand->m_highPower ? ADD_NODE_CONTROLLER | OPTION_HIGH_POWER : ADD_NODE_CONTROLLER );
+				SendMsg( msg, MsgQueue_Command );
+			}
+			break;
+		}
+		case ControllerCommand_CreateButton:
+		{
+			if( IsBridgeController() )
+			{
+				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+				if( node != NULL )
 				{
-					// if the average has been established, update by averaging the average and the last RTT
-					node->m_averageRequestRTT = ( node->m_averageRequestRTT + node->m_lastRequestRTT ) >> 1;
+					if( node->m_buttonMap.find( m_currentControllerCommand->m_controllerCommandArg ) == node->m_buttonMap.end() && m_virtualNeighborsReceived )
+					{
+						bool found = false;
+						uint8 buttonId;
+						for( uint8 n = 1; n <= 232 && !found; n++ )
+						{
+							if( IsVirtualNode( n ) && !node->GetVirtualNodeButton( n, &buttonId ) ) // found unused virtual node
+							{
+								{
+									WriteLockGuard LG( m_nodeMutex );
+									node->SetButton( m_currentControllerCommand->m_controllerCommandArg, n );
+								}
+								SendVirtualNodeInfo( n, m_currentControllerCommand->m_controllerCommandNode );
+								found = true;
+							}
+						}
+						if( !found ) // create a new virtual node
+						{
+							Log::Write( LogLevel_Info, 0, "AddVirtualNode" );
+							Msg* msg = new Msg( "FUNC_ID_SERIAL_API_SLAVE_NODE_INFO", 0xff, REQUEST, FUNC_ID_SERIAL_API_SLAVE_NODE_INFO, false, false );
+							msg->Append( 0 );		// node 0
+							msg->Append( 1 );		// listening
+							msg->Append( 0x09 );		// genericType window covering
+							msg->Append( 0x00 );		// specificType undefined
+							msg->Append( 0 );		// length
+							SendMsg( msg, MsgQueue_Command );
+
+							msg = new Msg( "FUNC_ID_ZW_SET_SLAVE_LEARN_MODE", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
+							msg->Append( 0 );		// node 0 to add
+							if( IsPrimaryController() || IsInclusionController() )
+							{
+								msg->Append( SLAVE_LEARN_MODE_ADD );
+							}
+							else
+							{
+								msg->Append( SLAVE_LEARN_MODE_ENABLE );
+							}
+							SendMsg( msg, MsgQueue_Command );
+						}
+					}
+					else
+					{
+						UpdateControllerState( ControllerState_Error, ControllerError_ButtonNotFound );
+					}
 				}
 				else
 				{
-					// if this is the first observed RTT, set the average to this value
-					node->m_averageRequestRTT = node->m_lastRequestRTT;
+					UpdateControllerState( ControllerState_Error, ControllerError_NodeNotFound );
 				}
-				Log::Write(LogLevel_Info, nodeId, "Request RTT %d Average Request RTT %d", node->m_lastRequestRTT, node->m_averageRequestRTT );
+			} else
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotBridge );
 			}
+			break;
 		}
+		case ControllerCommand_DeleteButton:
+		{
+			if( IsBridgeController() )
+			{
+				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+				if( node != NULL )
+				{
+					// Make sure button is allocated to a virtual node.
+					if( node->m_buttonMap.find( m_currentControllerCommand->m_controllerCommandArg ) != node->m_buttonMap.end() )
+					{
+#ifdef notdef
+						// We would need a reference count to decide when to free virtual nodes
+						// We could do this by making the bitmap of virtual nodes into a map that also holds a reference count.
+						Log::Write( LogLevel_Info, 0, "RemoveVirtualNode %d", m_currentControllerCommand->m_controllerCommandNode );
+						Msg* msg = new Msg( "Remove Virtual Node", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
+						msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
+						if( IsPrimaryController() || IsInclusionController() )
+							msg->Append( SLAVE_LEARN_MODE_REMOVE );
+						else
+							msg->Append( SLAVE_LEARN_MODE_ENABLE );
+						SendMsg( msg );
+#endif
+						{
+							WriteLockGuard LG( m_nodeMutex );
+							node->RemoveButton( m_currentControllerCommand->m_controllerCommandArg );
+						}
+						SaveButtons();
 
-		// We do this here since HandleErrorResponse/MoveMessagesToWakeUpQueue can delete m_currentMsg
-		if( m_currentMsg && m_currentMsg->IsNoOperation() )
+						Notification* notification = new Notification( Notification::Type_DeleteButton );
+						notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
+						notification->SetButtonId( m_currentControllerCommand->m_controllerCommandArg );
+						QueueNotification( notification );
+					}
+					else
+					{
+						UpdateControllerState( ControllerState_Error, ControllerError_ButtonNotFound );
+					}
+				}
+				else
+				{
+					UpdateControllerState( ControllerState_Error, ControllerError_NodeNotFound );
+				}
+			}
+			else
+			{
+				UpdateControllerState( ControllerState_Error, ControllerError_NotBridge );
+			}
+			break;
+		}
+		case ControllerCommand_None:
 		{
-			Notification* notification = new Notification( Notification::Type_Notification );
-			notification->SetHomeAndNodeIds( m_homeId, GetNodeNumber( m_currentMsg) );
-			notification->SetNotification( Notification::Code_NoOperation );
-			QueueNotification( notification );
+			// To keep gcc quiet
+			break;
 		}
+	}
+}
 
-		// Callback ID matches our expectation
-		if( _data[3] != 0 )
+//-----------------------------------------------------------------------------
+// <Driver::UpdateControllerState>
+// Stop the current controller function
+//-----------------------------------------------------------------------------
+void Driver::UpdateControllerState( ControllerState const _state, ControllerError const _error )
+{
+	if( m_currentControllerCommand != NULL )
+	{
+		if( _state != m_currentControllerCommand->m_controllerState )
 		{
-			if( !HandleErrorResponse( _data[3], nodeId, _replication ? "ZW_REPLICATION_END_DATA" : "ZW_SEND_DATA", !_replication ) )
+			m_currentControllerCommand->m_controllerStateChanged = true;
+			m_currentControllerCommand->m_controllerState = _state;
+			m_controllerStepDue.SetTime( m_controllerStepTimeout );
+			switch( _state )
 			{
-				if( m_currentMsg &&  m_currentMsg->IsNoOperation() && node != NULL &&
-						( node->GetCurrentQueryStage() == Node::QueryStage_Probe  ||
-								node->GetCurrentQueryStage() == Node::QueryStage_CacheLoad ) )
+				case ControllerState_Error:
+				case ControllerState_Cancel:
+				case ControllerState_Failed:
+				case ControllerState_Sleeping:
+				case ControllerState_NodeFailed:
+				case ControllerState_NodeOK:
+				case ControllerState_Completed:
 				{
-					node->QueryStageRetry( node->GetCurrentQueryStage(), 3 );
+					m_currentControllerCommand->m_controllerCommandDone = true;
+					m_sendMutex->Lock();
+					m_queueEvent[MsgQueue_Controller]->Set();
+					m_sendMutex->Unlock();
+					break;
 				}
-			}
-		}
-		else if( node != NULL )
-		{
-			// If WakeUpNoMoreInformation request succeeds, update our status
-			if( m_currentMsg && m_currentMsg->IsWakeUpNoMoreInformationCommand() )
-			{
-				if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
+				default:
 				{
-					// Mark the node as asleep
-					wakeUp->SetAwake( false );
+					break;
 				}
 			}
-			// If node is not alive, mark it alive now
-			if( !node->IsNodeAlive() )
-			{
-				node->SetNodeAlive( true );
-			}
+
 		}
-		// Command reception acknowledged by node, error or not, but ignore any NONCE messages
-		//
-		//	m_expectedCallbackId = 0;
+		Notification* notification = new Notification( Notification::Type_ControllerCommand );
+		notification->SetHomeAndNodeIds(m_homeId, 0);
+		notification->SetEvent(_state);
+
+		if( _error != ControllerError_None )
+		{
+			m_currentControllerCommand->m_controllerReturnError = _error;
+			/* Create a new Notification Callback */
+			notification->SetNotification(_error);
+		}
+		QueueNotification( notification );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleNetworkUpdateRequest>
-// Process a response from the Z-Wave PC interface
+// <Driver::CheckControllerCommandStep>
+// Give up the current controller command if it has been in the same state
+// for longer than the ControllerCommandTimeout option allows
 //-----------------------------------------------------------------------------
-void Driver::HandleNetworkUpdateRequest
+int32 Driver::CheckControllerCommandStep
 (
-		uint8* _data
 )
 {
-	ControllerState state = ControllerState_Failed;
-	ControllerError error = ControllerError_None;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	switch( _data[3] )
+	if( m_currentControllerCommand == NULL || m_controllerStepTimeout == 0 ||
+			m_currentControllerCommand->m_controllerCommandDone || m_currentControllerCommand->m_controllerState == ControllerState_Normal )
 	{
-		case SUC_UPDATE_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Success" );
-			state = ControllerState_Completed;
-			break;
-		}
-		case SUC_UPDATE_ABORT:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - Error. Process aborted." );
-			error = ControllerError_Failed;
-			break;
-		}
-		case SUC_UPDATE_WAIT:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - SUC is busy." );
-			error = ControllerError_Busy;
-			break;
-		}
-		case SUC_UPDATE_DISABLED:
+		return -1;
+	}
+
+	int32 remaining = m_controllerStepDue.TimeRemaining();
+	if( remaining > 0 )
+	{
+		return remaining;
+	}
+
+	Log::Write( LogLevel_Warning, m_currentControllerCommand->m_controllerCommandNode, "WARNING: %s made no progress in %d seconds - giving up", c_controllerCommandNames[m_currentControllerCommand->m_controllerCommand], m_controllerStepTimeout / 1000 );
+	if( !CancelControllerCommand() )
+	{
+		if( IsControllerCommandMsg( m_currentMsg ) )
 		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - SUC is disabled." );
-			error = ControllerError_Disabled;
-			break;
+			RemoveCurrentMsg();
 		}
-		case SUC_UPDATE_OVERFLOW:
+		UpdateControllerState( ControllerState_Failed, ControllerError_Failed );
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::IsExclusiveControllerCommand>
+// Whether the rest of the traffic must wait for a controller command.  The
+// commands that put the controller into a network management mode, or that
+// change the node list, have it to themselves.  Those that are a single
+// exchange with one node can be interleaved with ordinary messages.
+//-----------------------------------------------------------------------------
+bool Driver::IsExclusiveControllerCommand
+(
+		ControllerCommand const _command
+)
+{
+	switch( _command )
+	{
+		case ControllerCommand_AssignReturnRoute:
+		case ControllerCommand_DeleteAllReturnRoutes:
+		case ControllerCommand_SendNodeInformation:
+		case ControllerCommand_HasNodeFailed:
 		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REQUEST_NETWORK_UPDATE: Failed - Overflow. Full replication required." );
-			error = ControllerError_Overflow;
-			break;
+			return false;
 		}
 		default:
 		{
+			return true;
 		}
 	}
-
-	UpdateControllerState( state, error );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleAddNodeToNetworkRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::IsControllerCommandMsg>
+// Whether a message belongs to the current controller command.  While an
+// exclusive command runs, nothing else is sent, so every message does.  The
+// others are told apart by their function, which only controller commands use.
 //-----------------------------------------------------------------------------
-void Driver::HandleAddNodeToNetworkRequest
+bool Driver::IsControllerCommandMsg
 (
-		uint8* _data
-)
+		Msg const* _msg
+)const
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_ADD_NODE_TO_NETWORK:" );
-	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_ADD_NODE_TO_NETWORK, _data );
+	if( m_currentControllerCommand == NULL || _msg == NULL )
+	{
+		return false;
+	}
+	if( IsExclusiveControllerCommand( m_currentControllerCommand->m_controllerCommand ) )
+	{
+		return true;
+	}
+
+	switch( _msg->GetExpectedReply() )
+	{
+		case FUNC_ID_ZW_ASSIGN_RETURN_ROUTE:
+		case FUNC_ID_ZW_DELETE_RETURN_ROUTE:
+		case FUNC_ID_ZW_SEND_NODE_INFORMATION:
+		case FUNC_ID_ZW_IS_FAILED_NODE_ID:
+		{
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleRemoveNodeFromNetworkRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::CancelControllerCommand>
+// Stop the current controller function
 //-----------------------------------------------------------------------------
-void Driver::HandleRemoveNodeFromNetworkRequest
+bool Driver::CancelControllerCommand
 (
-		uint8* _data
 )
 {
-	//uint8 nodeId = GetNodeNumber( m_currentMsg );
 	if( m_currentControllerCommand == NULL )
 	{
-		return;
+		// Controller is not doing anything
+		return false;
 	}
-	ControllerState state = m_currentControllerCommand->m_controllerState;
-	Log::Write( LogLevel_Info, "FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK:" );
 
-	switch( _data[3] )
+	switch( m_currentControllerCommand->m_controllerCommand )
 	{
-		case REMOVE_NODE_STATUS_LEARN_READY:
+		case ControllerCommand_AddDevice:
 		{
-			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_LEARN_READY" );
-			state = ControllerState_Waiting;
-			m_currentControllerCommand->m_controllerCommandNode = 0;
+			Log::Write( LogLevel_Info, 0, "Cancel Add Node" );
+			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no new node to initialize
+			AddNodeStop( FUNC_ID_ZW_ADD_NODE_TO_NETWORK );
 			break;
 		}
-		case REMOVE_NODE_STATUS_NODE_FOUND:
+		case ControllerCommand_CreateNewPrimary:
 		{
-			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_NODE_FOUND" );
-			state = ControllerState_InProgress;
+			Log::Write( LogLevel_Info, 0, "Cancel Create New Primary" );
+			Msg* msg = new Msg( "CreateNewPrimary Stop", 0xff, REQUEST, FUNC_ID_ZW_CREATE_NEW_PRIMARY, true );
+			msg->Append( CREATE_PRIMARY_STOP );
+			SendMsg( msg, MsgQueue_Command );
 			break;
 		}
-		case REMOVE_NODE_STATUS_REMOVING_SLAVE:
+		case ControllerCommand_ReceiveConfiguration:
 		{
-			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_REMOVING_SLAVE" );
-			if (_data[4] != 0)
-			{
-				Log::Write( LogLevel_Info, "Removing node ID %d", _data[4] );
-				m_currentControllerCommand->m_controllerCommandNode = _data[4];
-			}
-			else
-			{
-				Log::Write( LogLevel_Warning, "Remove Node Failed - NodeID 0 Returned");
-				state = ControllerState_Failed;
-			}
+			Log::Write( LogLevel_Info, 0, "Cancel Receive Configuration" );
+			Msg* msg = new Msg( "ReceiveConfiguration Stop", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
+			msg->Append( 0 );
+			SendMsg( msg, MsgQueue_Command );
 			break;
 		}
-		case REMOVE_NODE_STATUS_REMOVING_CONTROLLER:
+		case ControllerCommand_RemoveDevice:
 		{
-			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_REMOVING_CONTROLLER" );
-			m_currentControllerCommand->m_controllerCommandNode = _data[4];
-			if( m_currentControllerCommand->m_controllerCommandNode == 0 ) // Some controllers don't return node number
-			{
-				if( _data[5] >= 3 )
-				{
-					LockGuard LG(m_nodeMutex);
-					for( int i=0; i<256; i++ )
-					{
-						if( m_nodes[i] == NULL )
-						{
-							continue;
-						}
-						// Ignore primary controller
-						if( m_nodes[i]->m_nodeId == m_Controller_nodeId )
-						{
-							continue;
-						}
-						// See if we can match another way
-						if( m_nodes[i]->m_basic == _data[6] &&
-								m_nodes[i]->m_generic == _data[7] &&
-								m_nodes[i]->m_specific == _data[8] )
-						{
-							if( m_currentControllerCommand->m_controllerCommandNode != 0 )
-							{
-								Log::Write( LogLevel_Info, "Alternative controller lookup found more then one match. Using the first one found." );
-							}
-							else
-							{
-								m_currentControllerCommand->m_controllerCommandNode = m_nodes[i]->m_nodeId;
-							}
-						}
-					}
-				}
-				else
-				{
-					Log::Write( LogLevel_Warning, "WARNING: Node is 0 but not enough data to perform alternative match." );
-				}
-			}
-			else
-			{
-				m_currentControllerCommand->m_controllerCommandNode = _data[4];
-			}
-			Log::Write( LogLevel_Info, "Removing controller ID %d", m_currentControllerCommand->m_controllerCommandNode );
+			Log::Write( LogLevel_Info, 0, "Cancel Remove Device" );
+			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no node to remove
+			AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
 			break;
 		}
-		case REMOVE_NODE_STATUS_DONE:
+		case ControllerCommand_TransferPrimaryRole:
 		{
-			Log::Write( LogLevel_Info, "REMOVE_NODE_STATUS_DONE" );
-			if( !m_currentControllerCommand->m_controllerCommandDone )
-			{
-
-				// Remove Node Stop calls back through here so make sure
-				// we do't do it again.
-				UpdateControllerState( ControllerState_Completed );
-				//AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
-				if ( m_currentControllerCommand->m_controllerCommandNode == 0 ) // never received "removing" update
-				{
-					if ( _data[4] != 0 ) // but message has the clue
-					{
-						m_currentControllerCommand->m_controllerCommandNode = _data[4];
-					}
-				}
-
-				if ( m_currentControllerCommand->m_controllerCommandNode != 0 && m_currentControllerCommand->m_controllerCommandNode != 0xff )
-				{
-					{
-						LockGuard LG(m_nodeMutex);
-						delete m_nodes[m_currentControllerCommand->m_controllerCommandNode];
-						m_nodes[m_currentControllerCommand->m_controllerCommandNode] = NULL;
-					}
-					Notification* notification = new Notification( Notification::Type_NodeRemoved );
-					notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
-					QueueNotification( notification );
-				}
-			}
-			return;
+			Log::Write( LogLevel_Info, 0, "Cancel Transfer Primary Role" );
+			Msg* msg = new Msg( "Transfer Primary Role Stop", 0xff, REQUEST, FUNC_ID_ZW_CONTROLLER_CHANGE, true );
+			msg->Append( CONTROLLER_CHANGE_STOP );
+			SendMsg( msg, MsgQueue_Command );
+			break;
+		}
+		case ControllerCommand_ReplicationSend:
+		{
+			Log::Write( LogLevel_Info, 0, "Cancel Replication Send" );
+			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no new node to initialize
+			AddNodeStop( FUNC_ID_ZW_ADD_NODE_TO_NETWORK );
+			break;
 		}
-		case REMOVE_NODE_STATUS_FAILED:
+		case ControllerCommand_CreateButton:
+		case ControllerCommand_DeleteButton:
 		{
-			//AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
-			Log::Write( LogLevel_Warning,  "WARNING: REMOVE_NODE_STATUS_FAILED" );
-			state = ControllerState_Failed;
+			if( m_currentControllerCommand->m_controllerCommandNode != 0 )
+			{
+				SendSlaveLearnModeOff();
+			}
 			break;
 		}
-		default:
+		case ControllerCommand_None:
+		case ControllerCommand_RequestNetworkUpdate:
+		case ControllerCommand_RequestNodeNeighborUpdate:
+		case ControllerCommand_AssignReturnRoute:
+		case ControllerCommand_DeleteAllReturnRoutes:
+		case ControllerCommand_RemoveFailedNode:
+		case ControllerCommand_HasNodeFailed:
+		case ControllerCommand_ReplaceFailedNode:
+		case ControllerCommand_SendNodeInformation:
 		{
-			break;
+			// Cannot cancel
+			return false;
 		}
 	}
 
-	UpdateControllerState( state );
+	UpdateControllerState( ControllerState_Cancel );
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleControllerChangeRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::AddNodeStop>
+// Stop the Add Node mode based on API of controller
 //-----------------------------------------------------------------------------
-void Driver::HandleControllerChangeRequest
+void Driver::AddNodeStop
 (
-		uint8* _data
+		uint8 const _funcId
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_CONTROLLER_CHANGE:" );
-	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_CONTROLLER_CHANGE, _data );
-}
+	if( m_currentControllerCommand == NULL )
+	{
+		// Controller is not doing anything
+		return;
+	}
 
-//-----------------------------------------------------------------------------
-// <Driver::HandleCreateNewPrimaryRequest>
-// Process a request from the Z-Wave PC interface
-//-----------------------------------------------------------------------------
-void Driver::HandleCreateNewPrimaryRequest
-(
-		uint8* _data
-)
-{
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "FUNC_ID_ZW_CREATE_NEW_PRIMARY:" );
-	CommonAddNodeStatusRequestHandler( FUNC_ID_ZW_CREATE_NEW_PRIMARY, _data );
+	if( m_serialAPIVersion[0] == 2 && m_serialAPIVersion[1] == 76 )
+	{
+		Msg* msg = new Msg( "Add Node Stop", 0xff, REQUEST, _funcId, false, false );
+		msg->Append( ADD_NODE_STOP );
+		SendMsg( msg, Driver::MsgQueue_Command );
+	}
+	else
+	{
+		Msg* msg = new Msg( "Add Node Stop", 0xff, REQUEST, _funcId, false, true );
+		msg->Append( ADD_NODE_STOP );
+		SendMsg( msg, Driver::MsgQueue_Command );
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSetLearnModeRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::TestNetwork>
+// Run a series of messages to a single node or every node on the network.
 //-----------------------------------------------------------------------------
-void Driver::HandleSetLearnModeRequest
+void Driver::TestNetwork
 (
-		uint8* _data
+		uint8 const _nodeId,
+		uint32 const _count
 )
 {
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( m_currentControllerCommand == NULL )
-	{
-		return;
-	}
-	ControllerState state = m_currentControllerCommand->m_controllerState;
-	Log::Write( LogLevel_Info, nodeId, "FUNC_ID_ZW_SET_LEARN_MODE:" );
-
-	switch( _data[3] )
+	WriteLockGuard LG(m_nodeMutex);
+	if( _nodeId == 0 )	// send _count messages to every node
 	{
-		case LEARN_MODE_STARTED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_STARTED" );
-			state = ControllerState_Waiting;
-			break;
-		}
-		case LEARN_MODE_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_DONE" );
-			state = ControllerState_Completed;
-
-			// Stop learn mode
-			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
-			msg->Append( 0 );
-			SendMsg( msg, MsgQueue_Command );
-
-			// Rebuild all the node info.  Group and scene data that we stored
-			// during replication will be applied as we discover each node.
-			InitAllNodes();
-			break;
-		}
-		case LEARN_MODE_FAILED:
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: LEARN_MODE_FAILED" );
-			state = ControllerState_Failed;
-
-			// Stop learn mode
-			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
-			msg->Append( 0 );
-			SendMsg( msg, MsgQueue_Command );
-
-			// Rebuild all the node info, since it may have been partially
-			// updated by the failed command.  Group and scene data that we
-			// stored during replication will be applied as we discover each node.
-			InitAllNodes();
-			break;
+			if( *nit == m_Controller_nodeId ) // ignore sending to ourself
+			{
+				continue;
+			}
+			NoOperation *noop = static_cast<NoOperation*>( m_nodes[*nit]->GetCommandClass( NoOperation::StaticGetCommandClassId() ) );
+			for( int j=0; j < (int)_count; j++ )
+			{
+				noop->Set( true );
+			}
 		}
-		case LEARN_MODE_DELETED:
+	}
+	else if( _nodeId != m_Controller_nodeId && m_nodes[_nodeId] != NULL )
+	{
+		NoOperation *noop = static_cast<NoOperation*>( m_nodes[_nodeId]->GetCommandClass( NoOperation::StaticGetCommandClassId() ) );
+		for( int i=0; i < (int)_count; i++ )
 		{
-			Log::Write( LogLevel_Info, nodeId, "LEARN_MODE_DELETED" );
-			state = ControllerState_Failed;
-			// Stop learn mode
-			Msg* msg = new Msg( "End Learn Mode", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
-			msg->Append( 0 );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			noop->Set( true );
 		}
 	}
-
-	UpdateControllerState( state );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleRemoveFailedNodeRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::BeginHealthScan>
+// Start testing every link between neighbouring nodes
 //-----------------------------------------------------------------------------
-void Driver::HandleRemoveFailedNodeRequest
+bool Driver::BeginHealthScan
 (
-		uint8* _data
+		uint16 const _frames
 )
 {
-	ControllerState state = ControllerState_Completed;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	switch( _data[3] )
+	vector<HealthLink> links;
 	{
-		case FAILED_NODE_OK:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - Node %d is OK, so command failed", m_currentControllerCommand->m_controllerCommandNode );
-			state = ControllerState_NodeOK;
-			break;
-		}
-		case FAILED_NODE_REMOVED:
+		ReadLockGuard LG(m_nodeMutex);
+		for( int i=1; i<=NUM_NODE_BITFIELD_BYTES*8; ++i )
 		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - node %d successfully moved to failed nodes list", m_currentControllerCommand->m_controllerCommandNode );
-			state = ControllerState_Completed;
-
+			Node* source = m_nodes[i];
+			if( ( source == NULL ) || ( i == m_Controller_nodeId ) || !source->IsNodeAlive() || !source->IsListeningDevice() || !source->GetCommandClass( Powerlevel::StaticGetCommandClassId() ) )
 			{
-				LockGuard LG(m_nodeMutex);
-				delete m_nodes[m_currentControllerCommand->m_controllerCommandNode];
-				m_nodes[m_currentControllerCommand->m_controllerCommandNode] = NULL;
+				continue;
 			}
-			Notification* notification = new Notification( Notification::Type_NodeRemoved );
-			notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
-			QueueNotification( notification );
 
-			break;
-		}
-		case FAILED_NODE_NOT_REMOVED:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_REMOVE_FAILED_NODE_ID - unable to move node %d to failed nodes list", m_currentControllerCommand->m_controllerCommandNode );
-			state = ControllerState_Failed;
-			break;
+			NodeSet neighbors( GetNeighborRow( (uint8)i ) );
+			uint32 position = 0;
+			InstanceAssociation neighbor;
+			while( neighbors.GetNext( position, &neighbor ) )
+			{
+				int j = neighbor.m_nodeId;
+				if( ( j == i ) || ( m_nodes[j] == NULL ) || !m_nodes[j]->IsNodeAlive() )
+				{
+					continue;
+				}
+
+				// Each link is only tested once, from the lower numbered
+				// node if both ends could test it
+				Node* target = m_nodes[j];
+				if( ( j < i ) && ( j != m_Controller_nodeId ) && target->IsListeningDevice() && target->GetCommandClass( Powerlevel::StaticGetCommandClassId() ) && IsBitSet( GetNeighborRow( (uint8)j ), (uint8)i ) )
+				{
+					continue;
+				}
+
+				HealthLink link;
+				link.m_quality.m_sourceId = (uint8)i;
+				link.m_quality.m_targetId = (uint8)j;
+				link.m_quality.m_sent = 0;
+				link.m_quality.m_acked = 0;
+				link.m_running = false;
+				link.m_done = false;
+				link.m_checks = 0;
+				links.push_back( link );
+			}
 		}
 	}
 
-	UpdateControllerState( state );
+	if( links.empty() )
+	{
+		Log::Write( LogLevel_Warning, "Network health scan not started: no links can be tested.  Are the neighbor lists known, and do any listening nodes support Powerlevel?" );
+		return false;
+	}
+
+	{
+		LockGuard LG(m_healthMutex);
+		m_healthLinks.swap( links );
+		m_healthFrames = _frames ? _frames : 1;
+		m_healthEpoch.SetTime();
+		m_healthScanning = true;
+	}
+	Log::Write( LogLevel_Info, "Starting a network health scan of %d links, with %d test frames each", (int)m_healthLinks.size(), m_healthFrames );
+	m_pollEvent->Set();
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleReplaceFailedNodeRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::IsLinkBlocked>
+// Whether a link's nodes are under test, or could hear a node under test
 //-----------------------------------------------------------------------------
-void Driver::HandleReplaceFailedNodeRequest
+bool Driver::IsLinkBlocked
 (
-		uint8* _data
+		HealthLink const& _link,
+		uint8 const* _busy
 )
 {
-	ControllerState state = ControllerState_Completed;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	switch( _data[3] )
+	uint8 ends[2] = { _link.m_quality.m_sourceId, _link.m_quality.m_targetId };
+	for( int e=0; e<2; ++e )
 	{
-		case FAILED_NODE_OK:
-		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node is OK, so command failed" );
-			state = ControllerState_NodeOK;
-			break;
-		}
-		case FAILED_NODE_REPLACE_WAITING:
+		if( IsBitSet( _busy, ends[e] ) )
 		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Waiting for new node" );
-			state = ControllerState_Waiting;
-			break;
+			return true;
 		}
-		case FAILED_NODE_REPLACE_DONE:
+		if( m_nodes[ends[e]] )
 		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node successfully replaced" );
-			state = ControllerState_Completed;
-
-			// Request new node info for this device
-			if( m_currentControllerCommand != NULL )
+			uint8 const* neighbors = GetNeighborRow( ends[e] );
+			for( int i=0; i<NUM_NODE_BITFIELD_BYTES; ++i )
 			{
-				InitNode( m_currentControllerCommand->m_controllerCommandNode, true );
+				if( neighbors[i] & _busy[i] )
+				{
+					return true;
+				}
 			}
-			break;
-		}
-		case FAILED_NODE_REPLACE_FAILED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_REPLACE_FAILED_NODE - Node replacement failed" );
-			state = ControllerState_Failed;
-			break;
 		}
 	}
-
-	UpdateControllerState( state );
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleApplicationCommandHandlerRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::RunHealthScan>
+// Start the link tests that can run alongside those already running, and
+// ask for the results of any that should have finished
 //-----------------------------------------------------------------------------
-void Driver::HandleApplicationCommandHandlerRequest
+int32 Driver::RunHealthScan
 (
-		uint8* _data,
-		bool encrypted
 )
 {
-
-	uint8 status = _data[2];
-	uint8 nodeId = _data[3];
-	uint8 classId = _data[5];
-	Node* node = GetNodeUnsafe( nodeId );
-
-	if( ( status & RECEIVE_STATUS_ROUTED_BUSY ) != 0 )
-	{
-		m_routedbusy++;
-	}
-	if( ( status & RECEIVE_STATUS_TYPE_BROAD ) != 0 )
+	int32 next = Wait::Timeout_Infinite;
+	if( !m_healthScanning )
 	{
-		m_broadcastReadCnt++;
+		return next;
 	}
-	if( node != NULL )
+
+	// Sending test frames takes about this long per frame, including the
+	// acknowledgement, and the tests are given this long to start
+	static int32 const c_msPerTestFrame = 40;
+	static int32 const c_testStartMs = 2000;
+	static uint8 const c_maxChecks = 5;
+
+	WriteLockGuard LG(m_nodeMutex);
+	LockGuard HLG(m_healthMutex);
+
+	// The nodes under test
+	uint8 busy[NUM_NODE_BITFIELD_BYTES];
+	memset( busy, 0, sizeof(busy) );
+	for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
 	{
-		node->m_receivedCnt++;
-		node->m_errors = 0;
-		int cmp = memcmp( _data, node->m_lastReceivedMessage, sizeof(node->m_lastReceivedMessage));
-		if( cmp == 0 && node->m_receivedTS.TimeRemaining() > -500 )
+		if( it->m_running )
 		{
-			// if the exact same sequence of bytes are received within 500ms
-			node->m_receivedDups++;
+			SetBit( busy, it->m_quality.m_sourceId );
+			SetBit( busy, it->m_quality.m_targetId );
 		}
-		else
+	}
+
+	int32 now = -m_healthEpoch.TimeRemaining();
+	bool done = true;
+	for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
+	{
+		HealthLink& link = *it;
+		if( link.m_done )
 		{
-			memcpy( node->m_lastReceivedMessage, _data, sizeof(node->m_lastReceivedMessage) );
+			continue;
+		}
+		done = false;
+
+		Node* node = GetNode( link.m_quality.m_sourceId );
+		Powerlevel* cc = node ? static_cast<Powerlevel*>( node->GetCommandClass( Powerlevel::StaticGetCommandClassId() ) ) : NULL;
+		if( cc == NULL )
+		{
+			link.m_running = false;
+			link.m_done = true;
+			continue;
 		}
-		node->m_receivedTS.SetTime();
-		if( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER && m_expectedNodeId == nodeId )
-		{
-			// Need to confirm this is the correct response to the last sent request.
-			// At least ignore any received messages prior to the send data request.
-			node->m_lastResponseRTT = -node->m_sentTS.TimeRemaining();
 
-			if( node->m_averageResponseRTT )
+		if( link.m_running )
+		{
+			int32 remaining = link.m_nextCheck - now;
+			if( remaining <= 0 )
 			{
-				// if the average has been established, update by averaging the average and the last RTT
-				node->m_averageResponseRTT = ( node->m_averageResponseRTT + node->m_lastResponseRTT ) >> 1;
+				if( link.m_checks >= c_maxChecks )
+				{
+					Log::Write( LogLevel_Warning, link.m_quality.m_sourceId, "No result for the test of the link to node %d", link.m_quality.m_targetId );
+					link.m_quality.m_sent = 0;
+					link.m_running = false;
+					link.m_done = true;
+					continue;
+				}
+				++link.m_checks;
+				cc->RequestLinkTestReport();
+				remaining = c_testStartMs;
+				link.m_nextCheck = now + remaining;
 			}
-			else
+			if( next == Wait::Timeout_Infinite || remaining < next )
 			{
-				// if this is the first observed RTT, set the average to this value
-				node->m_averageResponseRTT = node->m_lastResponseRTT;
+				next = remaining;
 			}
-			Log::Write(LogLevel_Info, nodeId, "Response RTT %d Average Response RTT %d", node->m_lastResponseRTT, node->m_averageResponseRTT );
+			continue;
 		}
-		else
+
+		// Not yet started.  Nodes that could hear a link under test have to wait.
+		if( IsLinkBlocked( link, busy ) )
 		{
-			node->m_receivedUnsolicited++;
+			continue;
 		}
-		if ( !node->IsNodeAlive() )
+
+		Log::Write( LogLevel_Detail, link.m_quality.m_sourceId, "Health scan testing the link to node %d", link.m_quality.m_targetId );
+		if( !cc->TestLink( link.m_quality.m_targetId, m_healthFrames ) )
 		{
-			node->SetNodeAlive( true );
+			link.m_done = true;
+			continue;
 		}
-	}
-	if( ApplicationStatus::StaticGetCommandClassId() == classId )
-	{
-		//TODO: Test this class function or implement
-	}
-	else if( ControllerReplication::StaticGetCommandClassId() == classId )
-	{
-		if( m_controllerReplication && m_currentControllerCommand && ( ControllerCommand_ReceiveConfiguration == m_currentControllerCommand->m_controllerCommand ) )
+		SetBit( busy, link.m_quality.m_sourceId );
+		SetBit( busy, link.m_quality.m_targetId );
+		link.m_running = true;
+		link.m_checks = 0;
+		int32 duration = c_testStartMs + (int32)m_healthFrames * c_msPerTestFrame;
+		link.m_nextCheck = now + duration;
+		if( next == Wait::Timeout_Infinite || duration < next )
 		{
-			m_controllerReplication->HandleMsg( &_data[6], _data[4] );
-
-			UpdateControllerState( ControllerState_InProgress );
+			next = duration;
 		}
 	}
-	else
+
+	if( done )
 	{
-		// Allow the node to handle the message itself
-		if( node != NULL )
+		m_healthScanning = false;
+		uint32 tested = 0;
+		for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
 		{
-			node->ApplicationCommandHandler( _data, encrypted );
+			if( it->m_quality.m_sent )
+			{
+				++tested;
+			}
 		}
-	}
-}
+		Log::Write( LogLevel_Info, "Network health scan complete: %d of %d links tested", tested, (int)m_healthLinks.size() );
 
-//-----------------------------------------------------------------------------
-// <Driver::HandlePromiscuousApplicationCommandHandlerRequest>
-// Process a request from the Z-Wave PC interface when in promiscuous mode.
-//-----------------------------------------------------------------------------
-void Driver::HandlePromiscuousApplicationCommandHandlerRequest
-(
-		uint8* _data
-)
-{
-	//uint8 nodeId = _data[3];
-	//uint8 len = _data[4];
-	//uint8 classId = _data[5];
-	//uint8 destNodeId = _data[5+len];
+		Notification* notification = new Notification( Notification::Type_NetworkHealthScan );
+		notification->SetHomeAndNodeIds( m_homeId, m_Controller_nodeId );
+		QueueNotification( notification );
+	}
+	return next;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleAssignReturnRouteRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::OnLinkTestReport>
+// Record the result of a link test
 //-----------------------------------------------------------------------------
-void Driver::HandleAssignReturnRouteRequest
+void Driver::OnLinkTestReport
 (
-		uint8* _data
+		uint8 const _sourceId,
+		uint8 const _targetId,
+		uint8 const _status,
+		uint16 const _acked
 )
 {
-	ControllerState state;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( m_currentControllerCommand == NULL )
+	LockGuard LG(m_healthMutex);
+	if( !m_healthScanning )
 	{
 		return;
 	}
-	if( _data[3] )
-	{
-		// Failed
-		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_ASSIGN_RETURN_ROUTE", true );
-		state = ControllerState_Failed;
-	}
-	else
+
+	for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
 	{
-		// Success
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_ASSIGN_RETURN_ROUTE for node %d - SUCCESS", m_currentControllerCommand->m_controllerCommandNode );
-		state = ControllerState_Completed;
-	}
+		HealthLink& link = *it;
+		if( link.m_running && ( link.m_quality.m_sourceId == _sourceId ) && ( link.m_quality.m_targetId == _targetId ) )
+		{
+			if( _status == Powerlevel::PowerLevelStatus_InProgress )
+			{
+				// Not finished yet, so ask again a little later
+				link.m_nextCheck = -m_healthEpoch.TimeRemaining() + 1000;
+				break;
+			}
 
-	UpdateControllerState( state );
+			link.m_quality.m_sent = m_healthFrames;
+			link.m_quality.m_acked = ( _acked < m_healthFrames ) ? _acked : m_healthFrames;
+			link.m_running = false;
+			link.m_done = true;
+			Log::Write( LogLevel_Info, _sourceId, "Link to node %d: %d of %d test frames acknowledged", _targetId, link.m_quality.m_acked, link.m_quality.m_sent );
+
+			// The next links can start now
+			m_pollEvent->Set();
+			break;
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleDeleteReturnRouteRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::GetLinkQuality>
+// The share of test frames that got across a link in the last scan
 //-----------------------------------------------------------------------------
-void Driver::HandleDeleteReturnRouteRequest
+bool Driver::GetLinkQuality
 (
-		uint8* _data
+		uint8 const _nodeA,
+		uint8 const _nodeB,
+		uint8* o_percent
 )
 {
-	ControllerState state;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( m_currentControllerCommand == NULL )
-	{
-		return;
-	}
-	if( _data[3] )
-	{
-		// Failed
-		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_DELETE_RETURN_ROUTE", true );
-		state = ControllerState_Failed;
-	}
-	else
+	LockGuard LG(m_healthMutex);
+	for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
 	{
-		// Success
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_DELETE_RETURN_ROUTE for node %d - SUCCESS", m_currentControllerCommand->m_controllerCommandNode );
-		state = ControllerState_Completed;
+		LinkQuality const& quality = it->m_quality;
+		if( ( ( quality.m_sourceId == _nodeA ) && ( quality.m_targetId == _nodeB ) ) || ( ( quality.m_sourceId == _nodeB ) && ( quality.m_targetId == _nodeA ) ) )
+		{
+			if( !it->m_done || ( quality.m_sent == 0 ) )
+			{
+				return false;
+			}
+			*o_percent = (uint8)( ( (uint32)quality.m_acked * 100 ) / quality.m_sent );
+			return true;
+		}
 	}
-
-	UpdateControllerState( state );
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSendNodeInformationRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::GetLinkQualities>
+// Every link found by the last scan
 //-----------------------------------------------------------------------------
-void Driver::HandleSendNodeInformationRequest
+uint32 Driver::GetLinkQualities
 (
-		uint8* _data
+		vector<LinkQuality>* o_links
 )
 {
-	ControllerState state;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( m_currentControllerCommand == NULL )
-	{
-		return;
-	}
-	if( _data[3] )
-	{
-		// Failed
-		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "ZW_SEND_NODE_INFORMATION" );
-		state = ControllerState_Failed;
-	}
-	else
+	LockGuard LG(m_healthMutex);
+	o_links->clear();
+	for( vector<HealthLink>::iterator it = m_healthLinks.begin(); it != m_healthLinks.end(); ++it )
 	{
-		// Success
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_NODE_INFORMATION - SUCCESS" );
-		state = ControllerState_Completed;
+		o_links->push_back( it->m_quality );
 	}
-
-	UpdateControllerState( state );
+	return (uint32)o_links->size();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleNodeNeighborUpdateRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::MarkNeighborsStale>
+// Note that a node's neighbor list may be out of date
 //-----------------------------------------------------------------------------
-void Driver::HandleNodeNeighborUpdateRequest
+void Driver::MarkNeighborsStale
 (
-		uint8* _data
+		uint8 const _nodeId
 )
 {
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	ControllerState state = ControllerState_Normal;
-	switch( _data[3] )
+	if( ( _nodeId == 0 ) || ( _nodeId > NUM_NODE_BITFIELD_BYTES*8 ) || ( _nodeId == m_Controller_nodeId ) )
 	{
-		case REQUEST_NEIGHBOR_UPDATE_STARTED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "REQUEST_NEIGHBOR_UPDATE_STARTED" );
-			state = ControllerState_InProgress;
-			break;
-		}
-		case REQUEST_NEIGHBOR_UPDATE_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "REQUEST_NEIGHBOR_UPDATE_DONE" );
-			state = ControllerState_Completed;
+		return;
+	}
 
-			// We now request the neighbour information from the
-			// controller and store it in our node object.
-			if( m_currentControllerCommand != NULL )
-			{
-				RequestNodeNeighbors( m_currentControllerCommand->m_controllerCommandNode, 0 );
-			}
-			break;
-		}
-		case REQUEST_NEIGHBOR_UPDATE_FAILED:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: REQUEST_NEIGHBOR_UPDATE_FAILED" );
-			state = ControllerState_Failed;
-			break;
-		}
-		default:
+	LockGuard LG(m_healthMutex);
+	if( !IsBitSet( m_staleNeighbors, _nodeId ) )
+	{
+		Log::Write( LogLevel_Detail, _nodeId, "Neighbor list marked as out of date" );
+		SetBit( m_staleNeighbors, _nodeId );
+		if( m_neighborRefreshInterval )
 		{
-			break;
+			m_pollEvent->Set();
 		}
 	}
-
-	UpdateControllerState( state );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleApplicationUpdateRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::UpdateNeighbors>
+// Store a node's new neighbor list.  Any node that it has gained or lost, whose
+// own list does not agree, is marked stale.
 //-----------------------------------------------------------------------------
-bool Driver::HandleApplicationUpdateRequest
+void Driver::UpdateNeighbors
 (
-		uint8* _data
+		Node* _node,
+		uint8 const* _neighbors
 )
 {
-	bool messageRemoved = false;
-	uint8 nodeId = _data[3];
-	Node* node = GetNodeUnsafe( nodeId );
-
-	// If node is not alive, mark it alive now
-	if( node != NULL && !node->IsNodeAlive() )
+	uint8 nodeId = _node->GetNodeId();
+	if( ( nodeId == 0 ) || ( nodeId > NUM_NODE_BITFIELD_BYTES*8 ) )
 	{
-		node->SetNodeAlive( true );
+		return;
 	}
 
-	switch( _data[2] )
+	// The topology only changes, and its version moves on, if the list is new
+	uint8* row = m_topology[nodeId-1];
+	uint8 changed[NUM_NODE_BITFIELD_BYTES];
+	bool anyChanged = false;
+	for( int i=0; i<NUM_NODE_BITFIELD_BYTES; ++i )
 	{
-		case UPDATE_STATE_SUC_ID:
-		{
-			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_SUC_ID from node %d", nodeId );
-			m_SUCNodeId = nodeId; // need to confirm real data here
-			break;
-		}
-		case UPDATE_STATE_DELETE_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "** Network change **: Z-Wave node %d was removed", nodeId );
-
-			{
-				LockGuard LG(m_nodeMutex);
-				delete m_nodes[nodeId];
-				m_nodes[nodeId] = NULL;
-			}
-
-			Notification* notification = new Notification( Notification::Type_NodeRemoved );
-			notification->SetHomeAndNodeIds( m_homeId, nodeId );
-			QueueNotification( notification );
-			break;
-		}
-		case UPDATE_STATE_NEW_ID_ASSIGNED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "** Network change **: ID %d was assigned to a new Z-Wave node", nodeId );
-                        // Check if the new node id is equal to the current one.... if so no operation is needed, thus no remove and add is necessary
-                        if ( _data[3] != _data[6] )
-                        {
-                        	// Request the node protocol info (also removes any existing node and creates a new one)
-			        InitNode( nodeId );	
-                        }
-                        else 
-                        {
-                        	Log::Write(LogLevel_Info, nodeId, "Not Re-assigning NodeID as old and new NodeID match");
-                        }
-			
-			break;
-		}
-		case UPDATE_STATE_ROUTING_PENDING:
-		{
-			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_ROUTING_PENDING from node %d", nodeId );
-			break;
-		}
-		case UPDATE_STATE_NODE_INFO_REQ_FAILED:
-		{
-			Log::Write( LogLevel_Warning, nodeId, "WARNING: FUNC_ID_ZW_APPLICATION_UPDATE: UPDATE_STATE_NODE_INFO_REQ_FAILED received" );
-
-			// Note: Unhelpfully, the nodeId is always zero in this message.  We have to
-			// assume the message came from the last node to which we sent a request.
-			if( m_currentMsg )
-			{
-				Node* tnode = GetNodeUnsafe( m_currentMsg->GetTargetNodeId() );
-				if( tnode )
-				{
-					// Retry the query twice
-					tnode->QueryStageRetry( Node::QueryStage_NodeInfo, 2 );
-
-					// Just in case the failure was due to the node being asleep, we try
-					// to move its pending messages to its wakeup queue.  If it is not
-					// a sleeping device, this will have no effect.
-					if( MoveMessagesToWakeUpQueue( tnode->GetNodeId(), true ) )
-					{
-						messageRemoved = true;
-					}
-				}
-			}
-			break;
-		}
-		case UPDATE_STATE_NODE_INFO_REQ_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_NODE_INFO_REQ_DONE from node %d", nodeId );
-			break;
-		}
-		case UPDATE_STATE_NODE_INFO_RECEIVED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "UPDATE_STATE_NODE_INFO_RECEIVED from node %d", nodeId );
-			if( node )
-			{
-				node->UpdateNodeInfo( &_data[8], _data[4] - 3 );
-			}
-			break;
-		}
+		changed[i] = row[i] ^ _neighbors[i];
+		anyChanged = anyChanged || ( changed[i] != 0 );
+	}
+	if( anyChanged )
+	{
+		memcpy( row, _neighbors, NUM_NODE_BITFIELD_BYTES );
+		++m_topologyVersion;
 	}
 
-	if( messageRemoved )
+	LockGuard LG(m_healthMutex);
+	m_staleNeighbors[( nodeId - 1 ) >> 3] &= (uint8)~( 1 << ( ( nodeId - 1 ) & 7 ) );
+	if( !anyChanged )
 	{
-		m_waitingForAck = false;
-		m_expectedCallbackId = 0;
-		m_expectedReply = 0;
-		m_expectedCommandClassId = 0;
-		m_expectedNodeId = 0;
+		return;
 	}
 
-	return messageRemoved;
+	NodeSet changedNodes( changed );
+	uint32 position = 0;
+	InstanceAssociation member;
+	while( changedNodes.GetNext( position, &member ) )
+	{
+		uint8 i = member.m_nodeId;
+		if( i == m_Controller_nodeId )
+		{
+			continue;
+		}
+		Node* other = m_nodes[i];
+		if( other && ( IsBitSet( GetNeighborRow( i ), nodeId ) != IsBitSet( _neighbors, i ) ) && !IsBitSet( m_staleNeighbors, i ) )
+		{
+			Log::Write( LogLevel_Detail, i, "Neighbor list disagrees with node %d's new one, so is out of date", nodeId );
+			SetBit( m_staleNeighbors, i );
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::CommonAddNodeStatusRequestHandler>
-// Handle common AddNode processing for many similar commands
+// <Driver::RefreshStaleNeighbors>
+// Have the next stale node rediscover its neighbors, if one is due
 //-----------------------------------------------------------------------------
-void Driver::CommonAddNodeStatusRequestHandler
+int32 Driver::RefreshStaleNeighbors
 (
-		uint8 _funcId,
-		uint8* _data
 )
 {
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	ControllerState state = ControllerState_Normal;
-	if( m_currentControllerCommand != NULL )
+	if( m_neighborRefreshInterval == 0 )
 	{
-		state = m_currentControllerCommand->m_controllerState;
+		return Wait::Timeout_Infinite;
 	}
-	switch( _data[3] )
+
+	int32 remaining = m_nextNeighborRefresh.TimeRemaining();
+	if( remaining > 0 )
 	{
-		case ADD_NODE_STATUS_LEARN_READY:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_LEARN_READY" );
-			m_currentControllerCommand->m_controllerAdded = false;
-			state = ControllerState_Waiting;
-			break;
-		}
-		case ADD_NODE_STATUS_NODE_FOUND:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_NODE_FOUND" );
-			state = ControllerState_InProgress;
-			break;
-		}
-		case ADD_NODE_STATUS_ADDING_SLAVE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_ADDING_SLAVE" );
-			/* Discovered all the CC's are sent in this packet as well:
-			 * position description
-			 * 4 - Node ID
-			 * 5 - Length
-			 * 6 - Basic Device Class
-			 * 7 - Generic Device Class
-			 * 8 - Specific Device Class
-			 * 9 to Length - Command Classes
-			 * Last pck - CRC
-			 */
-			if( m_currentControllerCommand != NULL )
-			{
-				Log::Write( LogLevel_Info, nodeId, "Adding node ID %d - %s", _data[4], m_currentControllerCommand->m_controllerCommandArg ? "Secure" : "Non-Secure");
-				m_currentControllerCommand->m_controllerAdded = false;
-				m_currentControllerCommand->m_controllerCommandNode = _data[4];
-				/* make sure we dont overrun our buffer. Its ok to truncate */
-				uint8 length = _data[5];
-				if (length > 254) length = 254;
-				memcpy(&m_currentControllerCommand->m_controllerDeviceProtocolInfo, &_data[6], length);
-				m_currentControllerCommand->m_controllerDeviceProtocolInfoLength = length;
-			}
-//			AddNodeStop( _funcId );
-//			sleep(1);
-			break;
-		}
-		case ADD_NODE_STATUS_ADDING_CONTROLLER:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_ADDING_CONTROLLER");
-			Log::Write( LogLevel_Info, nodeId, "Adding controller ID %d", _data[4] );
-			/* Discovered all the CC's are sent in this packet as well:
-			 * position description
-			 * 4 - Node ID
-			 * 5 - Length
-			 * 6 - Basic Device Class
-			 * 7 - Generic Device Class
-			 * 8 - Specific Device Class
-			 * 9 to Length - Command Classes
-			 * Last pck - CRC
-			 */
+		return remaining;
+	}
 
+	uint8 refreshNode = 0;
+	bool stale = false;
+	{
+		WriteLockGuard LG(m_nodeMutex);
+		LockGuard HLG(m_healthMutex);
 
-			if( m_currentControllerCommand != NULL )
-			{
-				m_currentControllerCommand->m_controllerAdded = true;
-				m_currentControllerCommand->m_controllerCommandNode = _data[4];
-			}
-//			AddNodeStop( _funcId );
-			break;
-		}
-		case ADD_NODE_STATUS_PROTOCOL_DONE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_PROTOCOL_DONE" );
-			// We added a device.
-			// Get the controller out of add mode to avoid accidentally adding other devices.
-			// We used to call replication here.
-			AddNodeStop( _funcId );
-			break;
-		}
-		case ADD_NODE_STATUS_DONE:
+		// Take the stale nodes in turn, starting after the last one refreshed.
+		// Sleeping and dead nodes cannot do a neighbor discovery, so they wait.
+		for( int n=1; n<=NUM_NODE_BITFIELD_BYTES*8; ++n )
 		{
-			if (state == ControllerState_Failed) {
-				/* if it was a failed add, we just move on */
-				state = ControllerState_Completed;
-				break;
+			uint8 nodeId = (uint8)( ( ( m_neighborRefreshNode + n - 1 ) % ( NUM_NODE_BITFIELD_BYTES*8 ) ) + 1 );
+			if( !IsBitSet( m_staleNeighbors, nodeId ) )
+			{
+				continue;
 			}
 
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_DONE" );
-			state = ControllerState_Completed;
-			if( m_currentControllerCommand != NULL && m_currentControllerCommand->m_controllerCommandNode != 0xff )
+			Node* node = GetNode( nodeId );
+			if( node == NULL )
 			{
-				InitNode( m_currentControllerCommand->m_controllerCommandNode, true, m_currentControllerCommand->m_controllerCommandArg != 0, m_currentControllerCommand->m_controllerDeviceProtocolInfo, m_currentControllerCommand->m_controllerDeviceProtocolInfoLength );
+				m_staleNeighbors[( nodeId - 1 ) >> 3] &= (uint8)~( 1 << ( ( nodeId - 1 ) & 7 ) );
+				continue;
 			}
-
-			// Not sure about the new controller function here.
-			if( _funcId != FUNC_ID_ZW_ADD_NODE_TO_NETWORK && m_currentControllerCommand != NULL && m_currentControllerCommand->m_controllerAdded )
+			stale = true;
+			if( node->IsNodeAlive() && node->IsListeningDevice() )
 			{
-				// Rebuild all the node info.  Group and scene data that we stored
-				// during replication will be applied as we discover each node.
-				InitAllNodes();
+				refreshNode = nodeId;
+				m_neighborRefreshNode = nodeId;
+				break;
 			}
-			break;
 		}
-		case ADD_NODE_STATUS_FAILED:
-		{
-			Log::Write( LogLevel_Info, nodeId, "ADD_NODE_STATUS_FAILED" );
-			state = ControllerState_Failed;
+	}
 
-			// Remove the AddNode command from the queue
-			RemoveCurrentMsg();
+	if( !stale )
+	{
+		return Wait::Timeout_Infinite;
+	}
 
-			// Get the controller out of add mode to avoid accidentally adding other devices.
-			AddNodeStop( _funcId );
-			break;
-		}
-		default:
-		{
-			break;
-		}
+	// If only nodes that cannot be refreshed yet are stale, look again later
+	if( refreshNode )
+	{
+		Log::Write( LogLevel_Info, refreshNode, "Refreshing the out of date neighbor list" );
+		BeginControllerCommand( ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, refreshNode, 0 );
 	}
+	m_nextNeighborRefresh.SetTime( m_neighborRefreshInterval );
+	return m_neighborRefreshInterval;
+}
 
-	UpdateControllerState( state );
+//-----------------------------------------------------------------------------
+// <Driver::IsNeighborInfoStale>
+// Whether a node's neighbor list may be out of date
+//-----------------------------------------------------------------------------
+bool Driver::IsNeighborInfoStale
+(
+		uint8 const _nodeId
+)
+{
+	if( ( _nodeId == 0 ) || ( _nodeId > NUM_NODE_BITFIELD_BYTES*8 ) )
+	{
+		return false;
+	}
+	LockGuard LG(m_healthMutex);
+	return IsBitSet( m_staleNeighbors, _nodeId );
 }
 
 //-----------------------------------------------------------------------------
-//	Polling Z-Wave devices
+// <Driver::AreNeighbors>
+// Whether either node lists the other as a neighbor
 //-----------------------------------------------------------------------------
+bool Driver::AreNeighbors
+(
+		uint8 const _nodeA,
+		uint8 const _nodeB
+)
+{
+	if( ( _nodeA == 0 ) || ( _nodeA > NUM_NODE_BITFIELD_BYTES*8 ) || ( _nodeB == 0 ) || ( _nodeB > NUM_NODE_BITFIELD_BYTES*8 ) )
+	{
+		return false;
+	}
+
+	ReadLockGuard LG(m_nodeMutex);
+	return ( GetNode( _nodeA ) && IsBitSet( GetNeighborRow( _nodeA ), _nodeB ) ) || ( GetNode( _nodeB ) && IsBitSet( GetNeighborRow( _nodeB ), _nodeA ) );
+}
 
 //-----------------------------------------------------------------------------
-// <Driver::EnablePoll>
-// Enable polling of a value
+// <Driver::GetLinkBadness>
+// How badly messages to a node have fared, for the order of a heal
 //-----------------------------------------------------------------------------
-bool Driver::EnablePoll
+uint32 Driver::GetLinkBadness
 (
-		ValueID const &_valueId,
-		uint8 const _intensity
+		Node* _node
 )
 {
-	// make sure the polling thread doesn't lock the node while we're in this function
-	m_pollMutex->Lock();
+	// Failures count for more than retries, and a node whose neighbor list
+	// is known to be out of date goes ahead of the rest
+	uint8 nodeId = _node->GetNodeId();
+	uint32 badness = ( ( m_nodeCounters.m_sentFailed[nodeId] * 4 + m_nodeCounters.m_retries[nodeId] ) * 1000 ) / ( m_nodeCounters.m_sentCnt[nodeId] + 1 );
+	if( IsNeighborInfoStale( nodeId ) )
+	{
+		badness += 100000;
+	}
+	return badness;
+}
 
-	// confirm that this node exists
-	uint8 nodeId = _valueId.GetNodeId();
-	LockGuard LG(m_nodeMutex);
-	Node* node = GetNode( nodeId );
-	if( node != NULL )
+//-----------------------------------------------------------------------------
+// <Driver::BeginHeal>
+// Queue every node to be healed, worst links first
+//-----------------------------------------------------------------------------
+void Driver::BeginHeal
+(
+		bool const _doRR
+)
+{
+	vector< pair<uint32,uint8> > nodes;
 	{
-		// confirm that this value is in the node's value store
-		if( Value* value = node->GetValue( _valueId ) )
+		ReadLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 		{
-			// update the value's pollIntensity
-			value->SetPollIntensity( _intensity );
-
-			// Add the valueid to the polling list
-			// See if the node is already in the poll list.
-			for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+			if( *nit != m_Controller_nodeId )
 			{
-				if( (*it).m_id == _valueId )
-				{
-					// It is already in the poll list, so we have nothing to do.
-					Log::Write( LogLevel_Detail, "EnablePoll not required to do anything (value is already in the poll list)" );
-					value->Release();
-					m_pollMutex->Unlock();
-					return true;
-				}
+				// Negated, so the sort puts the worst first and keeps ties in node order
+				nodes.push_back( pair<uint32,uint8>( ~GetLinkBadness( m_nodes[*nit] ), *nit ) );
 			}
-
-			// Not in the list, so we add it
-			PollEntry pe;
-			pe.m_id = _valueId;
-			pe.m_pollCounter = value->GetPollIntensity();
-			m_pollList.push_back( pe );
-			value->Release();
-			m_pollMutex->Unlock();
-
-			// send notification to indicate polling is enabled
-			Notification* notification = new Notification( Notification::Type_PollingEnabled );
-			notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
-			QueueNotification( notification );
-			Log::Write( LogLevel_Info, nodeId, "EnablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
-					_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollList.size() );
-			return true;
 		}
+	}
+	sort( nodes.begin(), nodes.end() );
 
-		// allow the poll thread to continue
-		m_pollMutex->Unlock();
-
-		Log::Write( LogLevel_Info, nodeId, "EnablePoll failed - value not found for node %d", nodeId );
-		return false;
+	{
+		LockGuard HLG(m_healthMutex);
+		m_healQueue.clear();
+		for( vector< pair<uint32,uint8> >::iterator it = nodes.begin(); it != nodes.end(); ++it )
+		{
+			m_healQueue.push_back( it->second );
+		}
+		m_healRR = _doRR;
 	}
+	Log::Write( LogLevel_Info, "Healing %d nodes, using at most %d%% of the network's time", (int)nodes.size(), m_healShare );
+	m_pollEvent->Set();
+}
 
-	// allow the poll thread to continue
-	m_pollMutex->Unlock();
+//-----------------------------------------------------------------------------
+// <Driver::CancelHeal>
+// Drop the nodes still to be healed
+//-----------------------------------------------------------------------------
+uint32 Driver::CancelHeal
+(
+)
+{
+	LockGuard HLG(m_healthMutex);
+	uint32 count = (uint32)m_healQueue.size();
+	m_healQueue.clear();
+	if( count )
+	{
+		Log::Write( LogLevel_Info, "Network heal cancelled with %d nodes to go", count );
+	}
+	return count;
+}
 
-	Log::Write( LogLevel_Info, "EnablePoll failed - node %d not found", nodeId );
-	return false;
+//-----------------------------------------------------------------------------
+// <Driver::GetHealRemaining>
+// The number of nodes still to be healed, including any under way
+//-----------------------------------------------------------------------------
+uint32 Driver::GetHealRemaining
+(
+)
+{
+	LockGuard HLG(m_healthMutex);
+	return (uint32)m_healQueue.size() + ( m_healNode ? 1 : 0 );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::DisablePoll>
-// Disable polling of a node
+// <Driver::RunHeal>
+// Finish the heal step under way once the controller is done with it, and
+// start the next one once enough time has passed
 //-----------------------------------------------------------------------------
-bool Driver::DisablePoll
+int32 Driver::RunHeal
 (
-		ValueID const &_valueId
 )
 {
-	// make sure the polling thread doesn't lock the node while we're in this function
-	m_pollMutex->Lock();
+	// Heal steps are checked on this often, and given up on after this long
+	static int32 const c_healCheckMs = 500;
+	static int32 const c_maxHealStepMs = 120000;
 
-	// confirm that this node exists
-	uint8 nodeId = _valueId.GetNodeId();
-	LockGuard LG(m_nodeMutex);
-	Node* node = GetNode( nodeId );
-	if( node != NULL)
+	uint8 nodeId;
 	{
-		// See if the value is already in the poll list.
-		for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+		LockGuard HLG(m_healthMutex);
+		if( !m_healNode && m_healQueue.empty() )
 		{
-			if( (*it).m_id == _valueId )
-			{
-				// Found it
-				// remove it from the poll list
-				m_pollList.erase( it );
+			return Wait::Timeout_Infinite;
+		}
 
-				// get the value object and reset pollIntensity to zero (indicating no polling)
-				Value* value = GetValue( _valueId );
-				if (!value)
-					continue;
-				value->SetPollIntensity( 0 );
-				value->Release();
-				m_pollMutex->Unlock();
+		m_sendMutex->Lock();
+		bool controllerBusy = ( m_currentControllerCommand != NULL ) || !m_msgQueue[MsgQueue_Controller].empty();
+		bool sendWaiting = !m_msgQueue[MsgQueue_Send].empty();
+		m_sendMutex->Unlock();
 
-				// send notification to indicate polling is disabled
-				Notification* notification = new Notification( Notification::Type_PollingDisabled );
-				notification->SetHomeAndNodeIds( m_homeId, _valueId.GetNodeId() );
-				QueueNotification( notification );
-				Log::Write( LogLevel_Info, nodeId, "DisablePoll for HomeID 0x%.8x, value(cc=0x%02x,in=0x%02x,id=0x%02x)--poll list has %d items",
-						_valueId.GetHomeId(), _valueId.GetCommandClassId(), _valueId.GetIndex(), _valueId.GetInstance(), m_pollList.size() );
-				return true;
+		if( m_healNode )
+		{
+			int32 elapsed = -m_healStepStart.TimeRemaining();
+			if( controllerBusy && elapsed < c_maxHealStepMs )
+			{
+				return c_healCheckMs;
+			}
+
+			// Wait long enough that the step used no more than the share of the time
+			int32 rest = (int32)( ( (int64)elapsed * ( 100 - m_healShare ) ) / m_healShare );
+			Log::Write( LogLevel_Info, m_healNode, "Heal step took %d ms, next step in %d ms", elapsed, rest );
+			m_healNode = 0;
+			m_nextHealStep.SetTime( rest );
+			if( m_healQueue.empty() )
+			{
+				Log::Write( LogLevel_Info, "Network heal complete" );
+				return Wait::Timeout_Infinite;
 			}
 		}
 
-		// Not in the list
-		m_pollMutex->Unlock();
-		Log::Write( LogLevel_Info, nodeId, "DisablePoll failed - value not on list");
-		return false;
+		int32 remaining = m_nextHealStep.TimeRemaining();
+		if( remaining > 0 )
+		{
+			return remaining;
+		}
+		if( sendWaiting || controllerBusy )
+		{
+			// The application's messages, and anything else the controller is doing, go first
+			return c_healCheckMs;
+		}
+
+		nodeId = m_healQueue.front();
+		m_healQueue.pop_front();
+		m_healNode = nodeId;
+		m_healStepStart.SetTime();
 	}
 
-	// allow the poll thread to continue
-	m_pollMutex->Unlock();
+	WriteLockGuard LG(m_nodeMutex);
+	if( GetNode( nodeId ) == NULL )
+	{
+		// Removed since the heal began, so go straight on to the next
+		LockGuard HLG(m_healthMutex);
+		m_healNode = 0;
+		return 0;
+	}
 
-	Log::Write( LogLevel_Info, "DisablePoll failed - node %d not found", nodeId );
-	return false;
+	Log::Write( LogLevel_Info, nodeId, "Healing node, %d more to go", (int)GetHealRemaining() - 1 );
+	BeginControllerCommand( ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, nodeId, 0 );
+	if( m_healRR )
+	{
+		UpdateNodeRoutes( nodeId, true );
+	}
+	return c_healCheckMs;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::isPolled>
-// Check polling status of a value
+// <Driver::HealStaleNodes>
+// Have every node with a stale neighbor list rediscover its neighbors now
 //-----------------------------------------------------------------------------
-bool Driver::isPolled
+uint32 Driver::HealStaleNodes
 (
-		ValueID const &_valueId
+		bool const _doRR
 )
 {
-	bool bPolled;
-
-	// make sure the polling thread doesn't lock the node while we're in this function
-	m_pollMutex->Lock();
+	uint32 count = 0;
+	WriteLockGuard LG(m_nodeMutex);
+	for( int i=1; i<=NUM_NODE_BITFIELD_BYTES*8; ++i )
+	{
+		if( IsNeighborInfoStale( (uint8)i ) && ( GetNode( (uint8)i ) != NULL ) )
+		{
+			BeginControllerCommand( ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, (uint8)i, 0 );
+			if( _doRR )
+			{
+				UpdateNodeRoutes( (uint8)i, true );
+			}
+			++count;
+		}
+	}
+	return count;
+}
 
-	Value* value = GetValue( _valueId );
-	if( value && value->GetPollIntensity() != 0 )
+//-----------------------------------------------------------------------------
+// <Driver::BeginRefreshRound>
+// Start requesting the values of many nodes, a node at a time
+//-----------------------------------------------------------------------------
+bool Driver::BeginRefreshRound
+(
+		uint8 const _filter,
+		NodeSet const* _nodes
+)
+{
+	uint32 flags = 0;
+	if( _filter & RefreshFilter_Static )
 	{
-		bPolled = true;
+		flags |= CommandClass::RequestFlag_Static;
 	}
-	else
+	if( _filter & RefreshFilter_Session )
 	{
-		bPolled = false;
+		flags |= CommandClass::RequestFlag_Session;
 	}
-
-	if (value) value->Release();
-
-	/*
-	 * This code is retained for the moment as a belt-and-suspenders test to confirm that
-	 * the pollIntensity member of each value and the pollList contents do not get out
-	 * of sync.
-	 */
-	// confirm that this node exists
-	uint8 nodeId = _valueId.GetNodeId();
-	LockGuard LG(m_nodeMutex);
-	Node* node = GetNode( nodeId );
-	if( node != NULL)
+	if( _filter & RefreshFilter_Dynamic )
 	{
+		flags |= CommandClass::RequestFlag_Dynamic;
+	}
+	if( flags == 0 )
+	{
+		return false;
+	}
 
-		// See if the value is already in the poll list.
-		for( list<PollEntry>::iterator it = m_pollList.begin(); it != m_pollList.end(); ++it )
+	list<uint8> nodes;
+	{
+		ReadLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 		{
-			if( (*it).m_id == _valueId )
+			if( ( *nit != m_Controller_nodeId ) && ( ( _nodes == NULL ) || _nodes->Contains( *nit ) ) )
 			{
-				// Found it
-				if( bPolled )
-				{
-					m_pollMutex->Unlock();
-					return true;
-				}
-				else
-				{
-					Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
-				}
+				nodes.push_back( *nit );
 			}
 		}
+	}
+	if( nodes.empty() )
+	{
+		return false;
+	}
 
-		// Not in the list
-
-		if( !bPolled )
+	{
+		LockGuard HLG(m_healthMutex);
+		if( m_refreshResult.m_running )
 		{
-			m_pollMutex->Unlock();
+			Log::Write( LogLevel_Warning, "A refresh round is already running" );
 			return false;
 		}
-		else
-		{
-			Log::Write( LogLevel_Error, nodeId, "IsPolled setting for valueId 0x%016x is not consistent with the poll list", _valueId.GetId() );
-		}
-	}
-
-	// allow the poll thread to continue
-	m_pollMutex->Unlock();
 
-	Log::Write( LogLevel_Info, "isPolled failed - node %d not found (the value reported that it is%s polled)", nodeId, bPolled?"":" not" );
-	return false;
+		// Any requests left over from a cancelled round are dropped
+		DiscardRefreshRequests();
+		m_refreshQueue.swap( nodes );
+		m_refreshFlags = flags;
+		m_refreshNode = 0;
+		m_refreshStart.SetTime();
+		memset( &m_refreshResult, 0, sizeof(m_refreshResult) );
+		m_refreshResult.m_running = true;
+		Log::Write( LogLevel_Info, "Refresh round of %d nodes started", (int)m_refreshQueue.size() );
+	}
+	m_pollEvent->Set();
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetPollIntensity>
-// Set the intensity with which this value is polled
+// <Driver::CancelRefreshRound>
+// Stop a refresh round.  Requests already queued are still sent.
 //-----------------------------------------------------------------------------
-void Driver::SetPollIntensity
+uint32 Driver::CancelRefreshRound
 (
-		ValueID const &_valueId,
-		uint8 const _intensity
 )
 {
-	// make sure the polling thread doesn't lock the value while we're in this function
-	m_pollMutex->Lock();
-
-	Value* value = GetValue( _valueId );
-	if (!value)
-		return;
-	value->SetPollIntensity( _intensity );
+	LockGuard HLG(m_healthMutex);
+	if( !m_refreshResult.m_running )
+	{
+		return 0;
+	}
 
-	value->Release();
-	m_pollMutex->Unlock();
+	uint32 count = (uint32)m_refreshQueue.size() + ( m_refreshNode ? 1 : 0 );
+	m_refreshQueue.clear();
+	DiscardRefreshRequests();
+	m_refreshNode = 0;
+	m_refreshResult.m_running = false;
+	m_refreshResult.m_duration = (uint32)-m_refreshStart.TimeRemaining();
+	Log::Write( LogLevel_Info, "Refresh round cancelled with %d nodes to go", count );
+	return count;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::PollThreadEntryPoint>
-// Entry point of the thread for poll Z-Wave devices
+// <Driver::GetRefreshRoundResult>
+// The outcome of the last refresh round, or the progress of the one running
 //-----------------------------------------------------------------------------
-void Driver::PollThreadEntryPoint
+void Driver::GetRefreshRoundResult
 (
-		Event* _exitEvent,
-		void* _context
+		RefreshRoundData* _data
 )
 {
-	Driver* driver = (Driver*)_context;
-	if( driver )
+	LockGuard HLG(m_healthMutex);
+	*_data = m_refreshResult;
+	if( m_refreshResult.m_running )
 	{
-		driver->PollThreadProc( _exitEvent );
+		_data->m_duration = (uint32)-m_refreshStart.TimeRemaining();
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::PollThreadProc>
-// Thread for poll Z-Wave devices
+// <Driver::DiscardRefreshRequests>
+// Delete the requests of the current node that have not been queued
 //-----------------------------------------------------------------------------
-void Driver::PollThreadProc
+void Driver::DiscardRefreshRequests
 (
-		Event* _exitEvent
 )
 {
-	while( 1 )
+	for( list<Msg*>::iterator it = m_refreshPending.begin(); it != m_refreshPending.end(); ++it )
 	{
-		int32 pollInterval = m_pollInterval;
+		delete *it;
+	}
+	m_refreshPending.clear();
+}
 
-		if( m_awakeNodesQueried && !m_pollList.empty() )
+//-----------------------------------------------------------------------------
+// <Driver::BeginNvmTransfer>
+// Start copying the controller's NVM to or from a file
+//-----------------------------------------------------------------------------
+bool Driver::BeginNvmTransfer
+(
+		string const& _fileName,
+		bool const _restore
+)
+{
+	{
+		LockGuard LG( m_nvmMutex );
+		if( m_nvmState == NvmState_Sizing || m_nvmState == NvmState_Reading || m_nvmState == NvmState_Writing )
 		{
-			// We only bother getting the lock if the pollList is not empty
-			m_pollMutex->Lock();
-
-			// Get the next value to be polled
-			PollEntry pe = m_pollList.front();
-			m_pollList.pop_front();
-			ValueID  valueId = pe.m_id;
-
-			// only execute this poll if pe.m_pollCounter == 1; otherwise decrement the counter and process the next polled value
-			if( pe.m_pollCounter != 1)
-			{
-				pe.m_pollCounter--;
-				m_pollList.push_back( pe );
-				m_pollMutex->Unlock();
-				continue;
-			}
+			Log::Write( LogLevel_Warning, "A controller NVM backup or restore is already under way" );
+			return false;
+		}
+		if( m_nvmOutstanding )
+		{
+			Log::Write( LogLevel_Warning, "The requests of the last controller NVM backup or restore are still being sent" );
+			return false;
+		}
 
-			// reset the poll counter to the full pollIntensity value and push it at the end of the list
-			// release the value object referenced; call GetNode to ensure the node objects are locked during this period
-			{
-				LockGuard LG(m_nodeMutex);
-				(void)GetNode( valueId.GetNodeId() );
-				Value* value = GetValue( valueId );
-				if (!value)
-					continue;
-				pe.m_pollCounter = value->GetPollIntensity();
-				m_pollList.push_back( pe );
-				value->Release();
-			}
-			// If the polling interval is for the whole poll list, calculate the time before the next poll,
-			// so that all polls can take place within the user-specified interval.
-			if( !m_bIntervalBetweenPolls )
+		if( _restore )
+		{
+			// Nothing is written unless the whole backup checks out
+			uint32 size = 0;
+			uint8 const* image = FileOps::MapFile( _fileName, size );
+			bool ok = ( image != NULL ) && ( size > c_nvmHeaderSize )
+				&& ( GetNvmHeaderField( image, 0, 4 ) == c_nvmMagic )
+				&& ( GetNvmHeaderField( image, 4, 2 ) == c_nvmVersion )
+				&& ( GetNvmHeaderField( image, 10, 4 ) == size - c_nvmHeaderSize )
+				&& ( GetNvmHeaderField( image, 14, 2 ) == Crc16Ccitt( image + c_nvmHeaderSize, size - c_nvmHeaderSize ) );
+			if( !ok )
 			{
-				if( pollInterval < 100 )
+				Log::Write( LogLevel_Warning, "%s is not a controller NVM backup, or is damaged", _fileName.c_str() );
+				if( image )
 				{
-					Log::Write( LogLevel_Info, "The pollInterval setting is only %d, which appears to be a legacy setting.  Multiplying by 1000 to convert to ms.", pollInterval );
-					pollInterval *= 1000;
+					FileOps::UnmapFile( image, size );
 				}
-				pollInterval /= (int32) m_pollList.size();
+				return false;
 			}
-
+			m_nvmImage = image;
+			m_nvmImageSize = size;
+			Log::Write( LogLevel_Info, "Restoring the controller NVM from %s, a backup of home ID 0x%.8x", _fileName.c_str(), GetNvmHeaderField( image, 6, 4 ) );
+		}
+		else
+		{
+			// The backup is written to a new file, so an earlier one is only
+			// replaced once this one is whole
+			string tmpName = _fileName + ".tmp";
+			uint8 header[c_nvmHeaderSize] = { 0 };
+			m_nvmFile = fopen( tmpName.c_str(), "wb" );
+			if( m_nvmFile == NULL || fwrite( header, 1, c_nvmHeaderSize, m_nvmFile ) != c_nvmHeaderSize )
 			{
-				LockGuard LG(m_nodeMutex);
-				// Request the state of the value from the node to which it belongs
-				if( Node* node = GetNode( valueId.GetNodeId() ) )
+				Log::Write( LogLevel_Warning, "Could not write the controller NVM backup %s", tmpName.c_str() );
+				if( m_nvmFile )
 				{
-					bool requestState = true;
-					if( !node->IsListeningDevice() )
-					{
-						// The device is not awake all the time.  If it is not awake, we mark it
-						// as requiring a poll.  The poll will be done next time the node wakes up.
-						if( WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
-						{
-							if( !wakeUp->IsAwake() )
-							{
-								wakeUp->SetPollRequired();
-								requestState = false;
-							}
-						}
-					}
-
-					if( requestState )
-					{
-						// Request an update of the value
-						CommandClass* cc = node->GetCommandClass( valueId.GetCommandClassId() );
-						if (cc) {
-							uint8 index = valueId.GetIndex();
-							uint8 instance = valueId.GetInstance();
-							Log::Write( LogLevel_Detail, node->m_nodeId, "Polling: %s index = %d instance = %d (poll queue has %d messages)", cc->GetCommandClassName().c_str(), index, instance, m_msgQueue[MsgQueue_Poll].size() );
-							cc->RequestValue( 0, index, instance, MsgQueue_Poll );
-						}
-					}
-
+					fclose( m_nvmFile );
+					m_nvmFile = NULL;
+					remove( tmpName.c_str() );
 				}
+				return false;
 			}
+			Log::Write( LogLevel_Info, "Backing up the controller NVM to %s", _fileName.c_str() );
+		}
 
-			m_pollMutex->Unlock();
+		m_nvmRestore = _restore;
+		m_nvmFileName = _fileName;
+		m_nvmSize = 0;
+		m_nvmQueued = 0;
+		m_nvmDone = 0;
+		m_nvmPercent = 0;
+		m_nvmElapsed = 0;
+		m_nvmReplied = false;
+		++m_nvmOutstanding;
+		m_nvmState = NvmState_Sizing;
+		NotifyNvm();
+	}
 
-			// Polling messages are only sent when there are no other messages waiting to be sent
-			// While this makes the polls much more variable and uncertain if some other activity dominates
-			// a send queue, that may be appropriate
-			// TODO we can have a debate about whether to test all four queues or just the Poll queue
-			// Wait until the library isn't actively sending messages (or in the midst of a transaction)
-			int i32;
-			int loopCount = 0;
-			while( !m_msgQueue[MsgQueue_Poll].empty()
-					|| !m_msgQueue[MsgQueue_Send].empty()
-					|| !m_msgQueue[MsgQueue_Command].empty()
-					|| !m_msgQueue[MsgQueue_Query].empty()
-					|| m_currentMsg != NULL )
-			{
-				i32 = Wait::Single( _exitEvent, 10);		// test conditions every 10ms
-				if( i32 == 0 )
-				{
-					// Exit has been called
-					return;
-				}
-				loopCount++;
-				if( loopCount == 3000*10 )		// 300 seconds worth of delay?  Something unusual is going on
-				{
-					Log::Write( LogLevel_Warning, "Poll queue hasn't been able to execute for 300 secs or more" );
-					Log::QueueDump();
-					//					assert( 0 );
-				}
-			}
+	SendMsg( new Msg( "FUNC_ID_NVM_GET_ID", 0xff, REQUEST, FUNC_ID_NVM_GET_ID, false ), MsgQueue_Controller );
+	return true;
+}
 
-			// ready for next poll...insert the pollInterval delay
-			i32 = Wait::Single( _exitEvent, pollInterval );
-			if( i32 == 0 )
-			{
-				// Exit has been called
-				return;
-			}
-		}
-		else		// poll list is empty or awake nodes haven't been fully queried yet
-		{
-			// don't poll just yet, wait for the pollInterval or exit before re-checking to see if the pollList has elements
-			int32 i32 = Wait::Single( _exitEvent, 500 );
-			if( i32 == 0 )
-			{
-				// Exit has been called
-				return;
-			}
-		}
+//-----------------------------------------------------------------------------
+// <Driver::CancelNvmTransfer>
+// Stop copying the controller's NVM.  Requests already queued are still sent.
+//-----------------------------------------------------------------------------
+bool Driver::CancelNvmTransfer
+(
+)
+{
+	LockGuard LG( m_nvmMutex );
+	if( m_nvmState != NvmState_Sizing && m_nvmState != NvmState_Reading && m_nvmState != NvmState_Writing )
+	{
+		return false;
 	}
+
+	Log::Write( LogLevel_Info, "Controller NVM %s cancelled after %d of %d bytes", m_nvmRestore ? "restore" : "backup", m_nvmDone, m_nvmSize );
+	EndNvmTransfer( NvmState_Failed );
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-//	Retrieving Node information
+// <Driver::GetNvmProgress>
+// The progress of a controller NVM backup or restore, or the outcome of the last one
 //-----------------------------------------------------------------------------
+void Driver::GetNvmProgress
+(
+		NvmData* _data
+)
+{
+	LockGuard LG( m_nvmMutex );
+	_data->m_state = m_nvmState;
+	_data->m_restore = m_nvmRestore;
+	_data->m_size = m_nvmSize;
+	_data->m_done = m_nvmDone;
+	_data->m_elapsed = ( m_nvmState == NvmState_Reading || m_nvmState == NvmState_Writing ) ? (uint32)-m_nvmStarted.TimeRemaining() : m_nvmElapsed;
+	_data->m_bytesPerSecond = _data->m_elapsed ? (uint32)( (uint64)m_nvmDone * 1000 / _data->m_elapsed ) : 0;
+}
 
 //-----------------------------------------------------------------------------
-// <Driver::InitAllNodes>
-// Delete all nodes and fetch new node data from the Z-Wave network
+// <Driver::HandleNvmGetIdResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-void Driver::InitAllNodes
+void Driver::HandleNvmGetIdResponse
 (
+		uint8* _data
 )
 {
-	// Delete all the node data
+	// The size is given as a power of two
+	uint32 size = ( _data[4] < 24 ) ? ( 1u << _data[4] ) : 0;
+	Log::Write( LogLevel_Info, "Received reply to FUNC_ID_NVM_GET_ID: manufacturer 0x%.2x, type 0x%.2x, %d bytes", _data[2], _data[3], size );
 	{
-		LockGuard LG(m_nodeMutex);
-		for( int i=0; i<256; ++i )
+		LockGuard LG( m_nvmMutex );
+		m_nvmReplied = true;
+		if( m_nvmState != NvmState_Sizing )
 		{
-			if( m_nodes[i] )
-			{
-				delete m_nodes[i];
-				m_nodes[i] = NULL;
-			}
+			return;
+		}
+
+		if( size == 0 )
+		{
+			Log::Write( LogLevel_Warning, "The controller did not give the size of its NVM" );
+			EndNvmTransfer( NvmState_Failed );
+			return;
+		}
+		if( m_nvmRestore && size != m_nvmImageSize - c_nvmHeaderSize )
+		{
+			Log::Write( LogLevel_Warning, "The controller NVM backup is of %d bytes, and the controller has %d", m_nvmImageSize - c_nvmHeaderSize, size );
+			EndNvmTransfer( NvmState_Failed );
+			return;
 		}
+
+		m_nvmSize = size;
+		m_nvmCrc = 0x1d0f;			// Crc16Ccitt's starting value
+		m_nvmStarted.SetTime();
+		m_nvmState = m_nvmRestore ? NvmState_Writing : NvmState_Reading;
+		NotifyNvm();
 	}
-	// Fetch new node data from the Z-Wave network
-	m_controller->PlayInitSequence( this );
+	QueueNvmRequests();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::InitNode>
-// Queue a node to be interrogated for its setup details
+// <Driver::HandleNvmReadResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-void Driver::InitNode
+void Driver::HandleNvmReadResponse
 (
-		uint8 const _nodeId,
-		bool newNode,
-		bool secure,
-		uint8 const *_protocolInfo,
-		uint8 const _length
+		uint8* _data
 )
 {
-	// Delete any existing node and replace it with a new one
 	{
-		LockGuard LG(m_nodeMutex);
-		if( m_nodes[_nodeId] )
+		LockGuard LG( m_nvmMutex );
+		m_nvmReplied = true;
+		if( m_nvmState != NvmState_Reading )
 		{
-			// Remove the original node
-			delete m_nodes[_nodeId];
-			Notification* notification = new Notification( Notification::Type_NodeRemoved );
-			notification->SetHomeAndNodeIds( m_homeId, _nodeId );
-			QueueNotification( notification );
+			return;
 		}
 
-		// Add the new node
-		m_nodes[_nodeId] = new Node( m_homeId, _nodeId );
-		if (newNode == true) static_cast<Node *>(m_nodes[_nodeId])->SetAddingNode();
+		// Replies come in the order the requests were queued
+		uint32 length = GetNvmBlockLength( m_nvmDone );
+		m_nvmCrc = Crc16Ccitt( &_data[2], length, m_nvmCrc );
+		if( fwrite( &_data[2], 1, length, m_nvmFile ) != length )
+		{
+			Log::Write( LogLevel_Warning, "Failed to write to the controller NVM backup %s.tmp", m_nvmFileName.c_str() );
+			EndNvmTransfer( NvmState_Failed );
+			return;
+		}
+		AdvanceNvm( length );
 	}
+	QueueNvmRequests();
+}
 
-	Notification* notification = new Notification( Notification::Type_NodeAdded );
-	notification->SetHomeAndNodeIds( m_homeId, _nodeId );
-	QueueNotification( notification );
+//-----------------------------------------------------------------------------
+// <Driver::HandleNvmWriteResponse>
+// Process a response from the Z-Wave PC interface
+//-----------------------------------------------------------------------------
+void Driver::HandleNvmWriteResponse
+(
+		uint8* _data
+)
+{
+	{
+		LockGuard LG( m_nvmMutex );
+		m_nvmReplied = true;
+		if( m_nvmState != NvmState_Writing )
+		{
+			return;
+		}
 
-	if (_length == 0) {
-		// Request the node info
-		m_nodes[_nodeId]->SetQueryStage( Node::QueryStage_ProtocolInfo );
-	} else {
-		if (isNetworkKeySet())
-			m_nodes[_nodeId]->SetSecured(secure);
-		else
-			Log::Write(LogLevel_Info, _nodeId, "Network Key Not Set - Secure Option is %s", secure ? "required" : "not required");
-		m_nodes[_nodeId]->SetProtocolInfo(_protocolInfo, _length);
+		if( !_data[2] )
+		{
+			Log::Write( LogLevel_Warning, "The controller failed to write %d bytes of its NVM at 0x%.5x", GetNvmBlockLength( m_nvmDone ), m_nvmDone );
+			EndNvmTransfer( NvmState_Failed );
+			return;
+		}
+		AdvanceNvm( GetNvmBlockLength( m_nvmDone ) );
 	}
-	Log::Write(LogLevel_Info, _nodeId, "Initializing Node. New Node: %s (%s)", static_cast<Node *>(m_nodes[_nodeId])->IsAddingNode() ? "true" : "false", newNode ? "true" : "false");
+	QueueNvmRequests();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsNodeListeningDevice>
-// Get whether the node is a listening device that does not go to sleep
+// <Driver::NvmMsgRemoved>
+// An NVM request is being removed, after its reply or after giving up on one
 //-----------------------------------------------------------------------------
-bool Driver::IsNodeListeningDevice
+void Driver::NvmMsgRemoved
 (
-		uint8 const _nodeId
+		Msg const* _msg
 )
 {
-	bool res = false;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	uint8 reply = _msg->GetExpectedReply();
+	if( reply != FUNC_ID_NVM_GET_ID && reply != FUNC_ID_NVM_EXT_READ_LONG_BUFFER && reply != FUNC_ID_NVM_EXT_WRITE_LONG_BUFFER )
 	{
-		res = node->IsListeningDevice();
+		return;
 	}
 
-	return res;
+	LockGuard LG( m_nvmMutex );
+	if( m_nvmOutstanding )
+	{
+		--m_nvmOutstanding;
+	}
+	if( !m_nvmReplied && ( m_nvmState == NvmState_Sizing || m_nvmState == NvmState_Reading || m_nvmState == NvmState_Writing ) )
+	{
+		Log::Write( LogLevel_Warning, "The controller did not reply to an NVM request, after %d of %d bytes", m_nvmDone, m_nvmSize );
+		EndNvmTransfer( NvmState_Failed );
+	}
+	m_nvmReplied = false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsNodeFrequentListeningDevice>
-// Get whether the node is a listening device that does not go to sleep
+// <Driver::QueueNvmRequests>
+// Keep a few requests queued ahead, so the controller is never left waiting
+// for the next one
 //-----------------------------------------------------------------------------
-bool Driver::IsNodeFrequentListeningDevice
+void Driver::QueueNvmRequests
 (
-		uint8 const _nodeId
 )
 {
-	bool res = false;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	list<Msg*> msgs;
 	{
-		res = node->IsFrequentListeningDevice();
+		LockGuard LG( m_nvmMutex );
+		while( ( m_nvmState == NvmState_Reading || m_nvmState == NvmState_Writing ) && ( m_nvmQueued < m_nvmSize ) && ( m_nvmOutstanding < c_nvmQueueAhead ) )
+		{
+			uint32 length = GetNvmBlockLength( m_nvmQueued );
+			Msg* msg;
+			if( m_nvmRestore )
+			{
+				msg = new Msg( "FUNC_ID_NVM_EXT_WRITE_LONG_BUFFER", 0xff, REQUEST, FUNC_ID_NVM_EXT_WRITE_LONG_BUFFER, false );
+			}
+			else
+			{
+				msg = new Msg( "FUNC_ID_NVM_EXT_READ_LONG_BUFFER", 0xff, REQUEST, FUNC_ID_NVM_EXT_READ_LONG_BUFFER, false );
+			}
+			msg->Append( (uint8)( m_nvmQueued >> 16 ) );
+			msg->Append( (uint8)( m_nvmQueued >> 8 ) );
+			msg->Append( (uint8)m_nvmQueued );
+			msg->Append( (uint8)( length >> 8 ) );
+			msg->Append( (uint8)length );
+			if( m_nvmRestore )
+			{
+				uint8 const* block = m_nvmImage + c_nvmHeaderSize + m_nvmQueued;
+				for( uint32 i = 0; i < length; ++i )
+				{
+					msg->Append( block[i] );
+				}
+			}
+			msgs.push_back( msg );
+			m_nvmQueued += length;
+			++m_nvmOutstanding;
+		}
 	}
 
-	return res;
+	for( list<Msg*>::iterator it = msgs.begin(); it != msgs.end(); ++it )
+	{
+		SendMsg( *it, MsgQueue_Controller );
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsNodeBeamingDevice>
-// Get whether the node is a beam capable device.
+// <Driver::AdvanceNvm>
+// Count a block as copied, and finish once they all have been.
+// Must be called with m_nvmMutex locked.
 //-----------------------------------------------------------------------------
-bool Driver::IsNodeBeamingDevice
+void Driver::AdvanceNvm
 (
-		uint8 const _nodeId
+		uint32 const _length
 )
 {
-	bool res = false;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	m_nvmDone += _length;
+	if( m_nvmDone >= m_nvmSize )
 	{
-		res = node->IsBeamingDevice();
+		EndNvmTransfer( NvmState_Complete );
+		return;
 	}
 
-	return res;
+	uint32 percent = (uint32)( (uint64)m_nvmDone * 10 / m_nvmSize );
+	if( percent > m_nvmPercent )
+	{
+		m_nvmPercent = percent;
+		NotifyNvm();
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsNodeRoutingDevice>
-// Get whether the node is a routing device that passes messages to other nodes
+// <Driver::EndNvmTransfer>
+// Close the files of a backup or restore, and report how it went.
+// Must be called with m_nvmMutex locked.
 //-----------------------------------------------------------------------------
-bool Driver::IsNodeRoutingDevice
+void Driver::EndNvmTransfer
 (
-		uint8 const _nodeId
+		NvmState _state
 )
 {
-	bool res = false;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	if( m_nvmState == NvmState_Reading || m_nvmState == NvmState_Writing )
 	{
-		res = node->IsRoutingDevice();
+		m_nvmElapsed = (uint32)-m_nvmStarted.TimeRemaining();
 	}
 
-	return res;
+	if( m_nvmFile )
+	{
+		string tmpName = m_nvmFileName + ".tmp";
+		bool ok = false;
+		if( _state == NvmState_Complete )
+		{
+			// Fill in the header, now the CRC is known
+			uint8 header[c_nvmHeaderSize];
+			SetNvmHeaderField( header, 0, 4, c_nvmMagic );
+			SetNvmHeaderField( header, 4, 2, c_nvmVersion );
+			SetNvmHeaderField( header, 6, 4, m_homeId );
+			SetNvmHeaderField( header, 10, 4, m_nvmSize );
+			SetNvmHeaderField( header, 14, 2, m_nvmCrc );
+			ok = ( fseek( m_nvmFile, 0, SEEK_SET ) == 0 ) && ( fwrite( header, 1, c_nvmHeaderSize, m_nvmFile ) == c_nvmHeaderSize );
+		}
+		ok = ( fclose( m_nvmFile ) == 0 ) && ok;
+		m_nvmFile = NULL;
+		ok = ok && FileOps::ReplaceFile( tmpName, m_nvmFileName );
+		if( !ok )
+		{
+			remove( tmpName.c_str() );
+			if( _state == NvmState_Complete )
+			{
+				Log::Write( LogLevel_Warning, "Failed to save the controller NVM backup %s", m_nvmFileName.c_str() );
+				_state = NvmState_Failed;
+			}
+		}
+	}
+	if( m_nvmImage )
+	{
+		FileOps::UnmapFile( m_nvmImage, m_nvmImageSize );
+		m_nvmImage = NULL;
+	}
+
+	if( _state == NvmState_Complete )
+	{
+		m_nvmPercent = 10;
+		Log::Write( LogLevel_Info, "Controller NVM %s complete: %d bytes in %dms (%d bytes/s)", m_nvmRestore ? "restore" : "backup", m_nvmSize, m_nvmElapsed, m_nvmElapsed ? (uint32)( (uint64)m_nvmSize * 1000 / m_nvmElapsed ) : 0 );
+	}
+	else
+	{
+		Log::Write( LogLevel_Warning, "Controller NVM %s failed after %d of %d bytes", m_nvmRestore ? "restore" : "backup", m_nvmDone, m_nvmSize );
+	}
+	m_nvmState = _state;
+	NotifyNvm();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::IsNodeSecurityDevice>
-// Get the security attribute for a node
+// <Driver::NotifyNvm>
+// Send a Type_ControllerNvm notification.
+// Must be called with m_nvmMutex locked.
 //-----------------------------------------------------------------------------
-bool Driver::IsNodeSecurityDevice
+void Driver::NotifyNvm
 (
-		uint8 const _nodeId
 )
 {
-	bool security = false;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		security = node->IsSecurityDevice();
-	}
+	Notification* notification = new Notification( Notification::Type_ControllerNvm );
+	notification->SetHomeAndNodeIds( m_homeId, m_Controller_nodeId );
+	notification->SetControllerNvmProgress( (uint8)m_nvmState, (uint8)( m_nvmPercent * 10 ) );
+	QueueNotification( notification );
+}
 
-	return security;
+//-----------------------------------------------------------------------------
+// <Driver::GetNvmBlockLength>
+// The bytes of the block starting at an offset
+//-----------------------------------------------------------------------------
+uint32 Driver::GetNvmBlockLength
+(
+		uint32 const _offset
+)const
+{
+	return ( m_nvmSize - _offset < c_nvmBlockSize ) ? m_nvmSize - _offset : c_nvmBlockSize;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeMaxBaudRate>
-// Get the maximum baud rate of a node's communications
+// <Driver::BeginSniffing>
+// Put the controller in promiscuous mode, and capture the frames between other nodes
 //-----------------------------------------------------------------------------
-uint32 Driver::GetNodeMaxBaudRate
+bool Driver::BeginSniffing
 (
-		uint8 const _nodeId
+		string const& _traceFile
 )
 {
-	uint32 baud = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
 	{
-		baud = node->GetMaxBaudRate();
+		LockGuard LG( m_snifferMutex );
+		if( AtomicLoad( &m_sniffing ) )
+		{
+			Log::Write( LogLevel_Warning, "The sniffer is already running" );
+			return false;
+		}
+
+		ControllerTrace* trace = NULL;
+		if( !_traceFile.empty() )
+		{
+			string userPath;
+			Options::Get()->GetOptionAsString( "UserPath", &userPath );
+			if( ( trace = ControllerTrace::Create( userPath + _traceFile ) ) == NULL )
+			{
+				return false;
+			}
+		}
+
+		if( m_snifferRing == NULL )
+		{
+			m_snifferRing = new Stream( c_snifferRingSize );
+		}
+		else
+		{
+			// Anything left from the last time, which the producer has stopped adding to
+			m_snifferRing->Purge();
+		}
+		m_snifferTrace = trace;
+		m_snifferStart.SetTime();
+		m_snifferDropped = 0;
+		AtomicStore( &m_sniffing, 1 );
 	}
 
-	return baud;
+	Log::Write( LogLevel_Info, "Sniffing the frames between other nodes%s%s", _traceFile.empty() ? "" : " to ", _traceFile.c_str() );
+	SetPromiscuousMode( true );
+	if( !_traceFile.empty() )
+	{
+		m_pollEvent->Set();
+	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeVersion>
-// Get the version number of a node
+// <Driver::EndSniffing>
+// Take the controller out of promiscuous mode
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeVersion
+bool Driver::EndSniffing
 (
-		uint8 const _nodeId
 )
 {
-	uint8 version = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	if( !AtomicLoad( &m_sniffing ) )
 	{
-		version = node->GetVersion();
+		return false;
 	}
+	SetPromiscuousMode( false );
 
-	return version;
+	LockGuard LG( m_snifferMutex );
+	AtomicStore( &m_sniffing, 0 );
+	if( m_snifferTrace )
+	{
+		// The frames still in the ring go to the trace before it is closed
+		SniffedFrame frame;
+		while( TakeSniffedFrame( &frame ) )
+		{
+			WriteSniffedFrame( frame );
+		}
+		delete m_snifferTrace;
+		m_snifferTrace = NULL;
+	}
+	Log::Write( LogLevel_Info, "Sniffing stopped, %d frames dropped", AtomicLoad( &m_snifferDropped ) );
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeSecurity>
-// Get the security byte of a node
+// <Driver::GetSniffedFrames>
+// Take the frames captured since the last call, waiting for one if there are none
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeSecurity
+bool Driver::GetSniffedFrames
 (
-		uint8 const _nodeId
+		vector<SniffedFrame>* o_frames,
+		int32 const _timeout,
+		uint32* o_dropped
 )
 {
-	uint8 security = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	o_frames->clear();
 	{
-		security = node->GetSecurity();
+		LockGuard LG( m_snifferMutex );
+		if( !AtomicLoad( &m_sniffing ) || m_snifferTrace )
+		{
+			return false;
+		}
+		m_snifferRing->SetSignalThreshold( 1 );
 	}
 
-	return security;
+	// Waiting for a frame holds no lock, so the sniffer can be stopped meanwhile
+	Wait::Single( m_snifferRing, _timeout );
+
+	LockGuard LG( m_snifferMutex );
+	SniffedFrame frame;
+	while( TakeSniffedFrame( &frame ) )
+	{
+		o_frames->push_back( frame );
+	}
+	if( o_dropped )
+	{
+		*o_dropped = AtomicLoad( &m_snifferDropped );
+	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeBasic>
-// Get the basic type of a node
+// <Driver::TraceSniffedFrames>
+// Move the captured frames to the trace file, from the poll thread
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeBasic
+int32 Driver::TraceSniffedFrames
 (
-		uint8 const _nodeId
 )
 {
-	uint8 basic = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// How often the ring is emptied into the trace
+	static int32 const c_snifferTraceMs = 250;
+
+	LockGuard LG( m_snifferMutex );
+	if( !AtomicLoad( &m_sniffing ) || !m_snifferTrace )
 	{
-		basic = node->GetBasic();
+		return Wait::Timeout_Infinite;
 	}
 
-	return basic;
+	SniffedFrame frame;
+	while( TakeSniffedFrame( &frame ) )
+	{
+		WriteSniffedFrame( frame );
+	}
+	return c_snifferTraceMs;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeGeneric>
-// Get the generic type of a node
+// <Driver::TakeSniffedFrame>
+// Take the oldest frame from the ring
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeGeneric
+bool Driver::TakeSniffedFrame
 (
-		uint8 const _nodeId
+		SniffedFrame* o_frame
 )
 {
-	uint8 genericType = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// Each frame is its time, its length, the source and target nodes and the payload
+	uint8 header[c_sniffedHeaderSize];
+	if( m_snifferRing == NULL || !m_snifferRing->Get( header, c_sniffedHeaderSize ) )
 	{
-		genericType = node->GetGeneric();
+		return false;
 	}
 
-	return genericType;
+	o_frame->m_time = (uint32)header[0] | ( (uint32)header[1] << 8 ) | ( (uint32)header[2] << 16 ) | ( (uint32)header[3] << 24 );
+	o_frame->m_sourceId = header[5];
+	o_frame->m_targetId = header[6];
+	o_frame->m_data.resize( header[4] );
+	if( header[4] )
+	{
+		// The whole frame was put in at once, so the rest is there
+		m_snifferRing->Get( &o_frame->m_data[0], header[4] );
+	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeSpecific>
-// Get the specific type of a node
+// <Driver::WriteSniffedFrame>
+// Add a captured frame to the trace file
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeSpecific
+void Driver::WriteSniffedFrame
 (
-		uint8 const _nodeId
+		SniffedFrame const& _frame
 )
 {
-	uint8 specific = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	uint8 data[2 + 255];
+	data[0] = _frame.m_sourceId;
+	data[1] = _frame.m_targetId;
+	uint32 length = (uint32)_frame.m_data.size();
+	if( length )
 	{
-		specific = node->GetSpecific();
+		memcpy( &data[2], &_frame.m_data[0], length );
 	}
-
-	return specific;
+	m_snifferTrace->Write( ControllerTrace::Direction_Sniffed, data, 2 + length, (int32)_frame.m_time );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeType>
-// Get the basic/generic/specific type of the specified node
-// Returns a copy of the string rather than a const ref for thread safety
+// <Driver::SetPromiscuousMode>
+// Ask the controller to pass on, or stop passing on, the frames between other nodes
 //-----------------------------------------------------------------------------
-string Driver::GetNodeType
+void Driver::SetPromiscuousMode
 (
-		uint8 const _nodeId
+		bool const _on
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		return node->GetType();
-	}
-
-	return "Unknown";
+	Msg* msg = new Msg( "FUNC_ID_ZW_SET_PROMISCUOUS_MODE", 0xff, REQUEST, FUNC_ID_ZW_SET_PROMISCUOUS_MODE, false, false );
+	msg->Append( _on ? 0xff : 0x00 );
+	SendMsg( msg, MsgQueue_Command );
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::BeginMsgTrace>
+// Start recording what happens to each message sent
+//-----------------------------------------------------------------------------
+void Driver::BeginMsgTrace
+(
+		uint32 const _capacity
+)
+{
+	m_msgTrace->Start( _capacity );
+	Log::Write( LogLevel_Info, "Tracing messages, keeping the last %d events", _capacity );
+}
 
-bool Driver::IsNodeZWavePlus
+//-----------------------------------------------------------------------------
+// <Driver::EndMsgTrace>
+// Stop recording messages, and save the events for a trace viewer
+//-----------------------------------------------------------------------------
+bool Driver::EndMsgTrace
 (
-		uint8 const _nodeId
+		string const& _fileName
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	if( !m_msgTrace->IsTracing() )
 	{
-		return node->IsNodeZWavePlus();
+		Log::Write( LogLevel_Warning, "Messages are not being traced" );
+		return false;
 	}
-	return false;
-}
+	m_msgTrace->Stop();
 
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+	return m_msgTrace->Write( userPath + _fileName, m_homeId, c_sendQueueNames, MsgQueue_Count );
+}
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeNeighbors>
-// Gets the neighbors for a node
+// <Driver::RunRefreshRound>
+// Queue more of the current node's requests once earlier ones have gone,
+// and move on to the next node once they all have
 //-----------------------------------------------------------------------------
-uint32 Driver::GetNodeNeighbors
+int32 Driver::RunRefreshRound
 (
-		uint8 const _nodeId,
-		uint8** o_neighbors
 )
 {
-	uint32 numNeighbors = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// How often the node's requests are checked on, and how many may wait on the poll queue
+	static int32 const c_refreshCheckMs = 250;
+	static uint32 const c_refreshWindow = 2;
+
 	{
-		numNeighbors = node->GetNeighbors( o_neighbors );
+		LockGuard HLG(m_healthMutex);
+		if( !m_refreshResult.m_running )
+		{
+			return Wait::Timeout_Infinite;
+		}
 	}
 
-	return numNeighbors;
+	WriteLockGuard LG(m_nodeMutex);
+	LockGuard HLG(m_healthMutex);
+	while( m_refreshResult.m_running )
+	{
+		if( m_refreshNode )
+		{
+			if( GetNode( m_refreshNode ) == NULL )
+			{
+				// Removed while its requests were going out
+				DiscardRefreshRequests();
+				++m_refreshResult.m_skipped;
+				m_refreshNode = 0;
+				continue;
+			}
+
+			// The node's requests still waiting to be sent, or being sent
+			m_sendMutex->Lock();
+			uint32 outstanding = (uint32)m_msgQueue[MsgQueue_Poll].GetNodeItems( m_refreshNode ).size();
+			if( ( m_currentMsg != NULL ) && ( m_currentMsg->GetTargetNodeId() == m_refreshNode ) )
+			{
+				++outstanding;
+			}
+			m_sendMutex->Unlock();
+
+			while( ( outstanding < c_refreshWindow ) && !m_refreshPending.empty() )
+			{
+				Msg* msg = m_refreshPending.front();
+				m_refreshPending.pop_front();
+				SendMsg( msg, MsgQueue_Poll );
+				++m_refreshResult.m_requests;
+				++outstanding;
+			}
+			if( outstanding )
+			{
+				return c_refreshCheckMs;
+			}
+
+			++m_refreshResult.m_nodes;
+			m_refreshNode = 0;
+		}
+
+		if( m_refreshQueue.empty() )
+		{
+			m_refreshResult.m_running = false;
+			m_refreshResult.m_duration = (uint32)-m_refreshStart.TimeRemaining();
+			Log::Write( LogLevel_Info, "Refresh round complete in %d ms: %d nodes refreshed with %d requests, %d asleep, %d skipped",
+					m_refreshResult.m_duration, m_refreshResult.m_nodes, m_refreshResult.m_requests, m_refreshResult.m_sleeping, m_refreshResult.m_skipped );
+
+			Notification* notification = new Notification( Notification::Type_RefreshRoundComplete );
+			notification->SetHomeAndNodeIds( m_homeId, m_Controller_nodeId );
+			QueueNotification( notification );
+			break;
+		}
+
+		uint8 nodeId = m_refreshQueue.front();
+		m_refreshQueue.pop_front();
+		Node* node = GetNode( nodeId );
+		if( ( node == NULL ) || !node->IsNodeAlive() )
+		{
+			++m_refreshResult.m_skipped;
+			continue;
+		}
+
+		if( !node->IsListeningDevice() )
+		{
+			WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) );
+			if( ( wakeUp != NULL ) && !wakeUp->IsAwake() )
+			{
+				// Its dynamic values are requested as soon as it wakes
+				Log::Write( LogLevel_Detail, nodeId, "Refresh round: node is asleep, refreshing when it wakes" );
+				wakeUp->SetPollRequired();
+				++m_refreshResult.m_sleeping;
+				continue;
+			}
+		}
+
+		// Collect the node's requests, to be let out a few at a time
+		m_pollBatchThreadId = Thread::GetCurrentId();
+		m_pollBatchNodeId = nodeId;
+		for( map<uint8,CommandClass*>::const_iterator it = node->m_commandClassMap.begin(); it != node->m_commandClassMap.end(); ++it )
+		{
+			if( !it->second->IsAfterMark() )
+			{
+				it->second->RequestStateForAllInstances( m_refreshFlags, MsgQueue_Poll );
+			}
+		}
+		m_pollBatchNodeId = 0;
+		m_refreshPending.splice( m_refreshPending.end(), m_pollBatch );
+		m_refreshNode = nodeId;
+		Log::Write( LogLevel_Detail, nodeId, "Refresh round: %d requests, %d more nodes to go", (int)m_refreshPending.size(), (int)m_refreshQueue.size() );
+	}
+	return Wait::Timeout_Infinite;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeManufacturerName>
-// Get the manufacturer name for the node with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+//	SwitchAll
 //-----------------------------------------------------------------------------
-string Driver::GetNodeManufacturerName
+
+//-----------------------------------------------------------------------------
+// <Driver::SwitchAllOn>
+// All devices that support the SwitchAll command class will be turned on
+//-----------------------------------------------------------------------------
+void Driver::SwitchAllOn
 (
-		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		return node->GetManufacturerName();
-	}
-
-	return "";
+	SendSwitchAll( true );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeProductName>
-// Get the product name for the node with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+// <Driver::SwitchAllOff>
+// All devices that support the SwitchAll command class will be turned off
 //-----------------------------------------------------------------------------
-string Driver::GetNodeProductName
+void Driver::SwitchAllOff
 (
-		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		return node->GetProductName();
-	}
-
-	return "";
+	SendSwitchAll( false );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeName>
-// Get the user-editable name for the node with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+// <Driver::SendSwitchAll>
+// Broadcast SwitchAll On or Off.  Nodes that cannot hear the broadcast are
+// sent it on their own, to wait until they wake.
 //-----------------------------------------------------------------------------
-string Driver::GetNodeName
+void Driver::SendSwitchAll
 (
-		uint8 const _nodeId
+		bool const _on
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	vector<uint8> nodeIds;
 	{
-		return node->GetNodeName();
+		WriteLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+		{
+			Node* node = m_nodes[*nit];
+			if( !node->GetCommandClass( SwitchAll::StaticGetCommandClassId() ) )
+			{
+				continue;
+			}
+			if( node->IsListeningDevice() )
+			{
+				nodeIds.push_back( (uint8)*nit );
+			}
+			else if( _on )
+			{
+				SwitchAll::On( this, (uint8)*nit );
+			}
+			else
+			{
+				SwitchAll::Off( this, (uint8)*nit );
+			}
+		}
 	}
-
-	return "";
+	SwitchAll::Broadcast( this, _on, nodeIds );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeLocation>
-// Get the user-editable string for location of the specified node
-// Returns a copy of the string rather than a const ref for thread safety
+//	Broadcasts
 //-----------------------------------------------------------------------------
-string Driver::GetNodeLocation
+
+//-----------------------------------------------------------------------------
+// <Driver::SendBroadcast>
+// Send a command to every node at once, and note the nodes to check afterwards
+//-----------------------------------------------------------------------------
+void Driver::SendBroadcast
 (
-		uint8 const _nodeId
+		char const* _logText,
+		uint8 const* _command,
+		uint8 const _length,
+		vector<uint8> const& _nodeIds
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	Log::Write( LogLevel_Info, "Broadcasting %s, to be checked on %d nodes", _logText, (int)_nodeIds.size() );
+	Msg* msg = new Msg( _logText, 0xff, REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->Append( 0xff );
+	msg->Append( _length );
+	for( uint8 i=0; i<_length; ++i )
 	{
-		return node->GetLocation();
+		msg->Append( _command[i] );
 	}
+	msg->Append( GetTransmitOptions() );
+	SendMsg( msg, MsgQueue_Send );
 
-	return "";
+	if( _nodeIds.empty() || _length == 0 )
+	{
+		return;
+	}
+
+	BroadcastCheck* check = new BroadcastCheck();
+	check->m_logText = _logText;
+	check->m_command.assign( _command, _command + _length );
+	check->m_nodeIds = _nodeIds;
+	check->m_sent.SetTime();
+	{
+		LockGuard LG( m_broadcastMutex );
+
+		// An earlier command of the same class must not be sent again to the nodes
+		// that this one is for
+		list<BroadcastCheck*>::iterator it = m_broadcastChecks.begin();
+		while( it != m_broadcastChecks.end() )
+		{
+			BroadcastCheck* earlier = *it;
+			if( earlier->m_command[0] == _command[0] )
+			{
+				vector<uint8> kept;
+				for( vector<uint8>::const_iterator nit = earlier->m_nodeIds.begin(); nit != earlier->m_nodeIds.end(); ++nit )
+				{
+					if( find( _nodeIds.begin(), _nodeIds.end(), *nit ) == _nodeIds.end() )
+					{
+						kept.push_back( *nit );
+					}
+				}
+				earlier->m_nodeIds.swap( kept );
+			}
+			if( earlier->m_nodeIds.empty() )
+			{
+				delete earlier;
+				it = m_broadcastChecks.erase( it );
+			}
+			else
+			{
+				++it;
+			}
+		}
+		m_broadcastChecks.push_back( check );
+	}
+	m_pollEvent->Set();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeManufacturerId>
-// Get the manufacturer Id string value with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+// <Driver::RunBroadcastChecks>
+// Send a broadcast again to the next node that has been quiet since, and read
+// back its state
 //-----------------------------------------------------------------------------
-uint16 Driver::GetNodeManufacturerId
+int32 Driver::RunBroadcastChecks
 (
-		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	int32 gap = m_nextBroadcastCheck.TimeRemaining();
+	while( true )
 	{
-		return node->GetManufacturerId();
-	}
+		uint8 nodeId;
+		int32 sinceSent;
+		char const* logText;
+		vector<uint8> command;
+		{
+			LockGuard LG( m_broadcastMutex );
+			if( m_broadcastChecks.empty() )
+			{
+				return Wait::Timeout_Infinite;
+			}
 
-	return 0;
+			BroadcastCheck* check = m_broadcastChecks.front();
+			int32 settle = c_broadcastSettleMs + check->m_sent.TimeRemaining();
+			if( settle > 0 || gap > 0 )
+			{
+				return( settle > gap ? settle : gap );
+			}
+
+			nodeId = check->m_nodeIds.back();
+			check->m_nodeIds.pop_back();
+			sinceSent = -check->m_sent.TimeRemaining();
+			logText = check->m_logText;
+			command = check->m_command;
+			if( check->m_nodeIds.empty() )
+			{
+				delete check;
+				m_broadcastChecks.pop_front();
+			}
+		}
+
+		// Nodes that have been heard from since, or that are not there to ask,
+		// are passed over without waiting
+		NodeGuard LG( this, nodeId );
+		Node* node = LG.GetNode();
+		if( node == NULL || !node->IsNodeAlive() || -node->m_receivedTS.TimeRemaining() < sinceSent )
+		{
+			continue;
+		}
+
+		Log::Write( LogLevel_Info, nodeId, "Nothing heard since the broadcast of %s, so sending it to the node", logText );
+		Msg* msg = new Msg( logText, nodeId, REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+		msg->Append( nodeId );
+		msg->Append( (uint8)command.size() );
+		for( vector<uint8>::const_iterator it = command.begin(); it != command.end(); ++it )
+		{
+			msg->Append( *it );
+		}
+		msg->Append( GetTransmitOptions() );
+		SendMsg( msg, MsgQueue_Send );
+
+		if( CommandClass* cc = node->GetCommandClass( SwitchBinary::StaticGetCommandClassId() ) )
+		{
+			cc->RequestValue( 0, 0, 1, MsgQueue_Send );
+		}
+		if( CommandClass* cc = node->GetCommandClass( SwitchMultilevel::StaticGetCommandClassId() ) )
+		{
+			cc->RequestValue( 0, 0, 1, MsgQueue_Send );
+		}
+
+		m_nextBroadcastCheck.SetTime( c_broadcastCheckGapMs );
+		return c_broadcastCheckGapMs;
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeProductType>
-// Get the product type string value with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+//	Scenes
 //-----------------------------------------------------------------------------
-uint16 Driver::GetNodeProductType
+
+//-----------------------------------------------------------------------------
+// <Driver::ActivateScene>
+// Set the values of a scene, using multicasts where possible
+//-----------------------------------------------------------------------------
+bool Driver::ActivateScene
 (
-		uint8 const _nodeId
+		vector< pair<ValueID,string> > const& _values
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// Group the values that can be multicast by the command that sets them
+	map< pair<uint8,uint8>, vector<uint8> > groups;
 	{
-		return node->GetProductType();
+		WriteLockGuard LG(m_nodeMutex);
+		for( vector< pair<ValueID,string> >::const_iterator it = _values.begin(); it != _values.end(); ++it )
+		{
+			uint8 level;
+			if( GetMulticastLevel( it->first, it->second, level ) )
+			{
+				groups[ pair<uint8,uint8>( it->first.GetCommandClassId(), level ) ].push_back( it->first.GetNodeId() );
+			}
+		}
 	}
 
-	return 0;
+	for( map< pair<uint8,uint8>, vector<uint8> >::iterator it = groups.begin(); it != groups.end(); ++it )
+	{
+		// A multicast to one node saves nothing
+		if( it->second.size() > 1 )
+		{
+			SendMulticastSet( it->second, it->first.first, it->first.second );
+		}
+	}
+
+	// Every value is then set as usual.  These follow the multicasts in the
+	// send queue, and see to it that a node that missed one still changes.
+	bool res = true;
+	for( vector< pair<ValueID,string> >::const_iterator it = _values.begin(); it != _values.end(); ++it )
+	{
+		if( !Manager::Get()->SetValue( it->first, it->second ) )
+		{
+			res = false;
+		}
+	}
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeProductId>
-// Get the product Id string value with the specified ID
-// Returns a copy of the string rather than a const ref for thread safety
+// <Driver::GetMulticastLevel>
+// Work out whether a value can be set by a multicast, and what to send
 //-----------------------------------------------------------------------------
-uint16 Driver::GetNodeProductId
+bool Driver::GetMulticastLevel
 (
-		uint8 const _nodeId
+		ValueID const& _id,
+		string const& _value,
+		uint8& _level
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// Sleeping nodes do not hear multicasts, and they cannot be encrypted or
+	// addressed to an endpoint
+	Node* node = GetNodeUnsafe( _id.GetNodeId() );
+	if( !node || !node->IsNodeAlive() || !node->IsListeningDevice() )
 	{
-		return node->GetProductId();
+		return false;
+	}
+	CommandClass* cc = node->GetCommandClass( _id.GetCommandClassId() );
+	if( !cc || cc->IsSecured() || ( _id.GetInstance() != 1 ) || ( cc->GetEndPoint( _id.GetInstance() ) != 0 ) || ( _id.GetIndex() != 0 ) )
+	{
+		return false;
 	}
 
-	return 0;
+	if( ( _id.GetCommandClassId() == SwitchBinary::StaticGetCommandClassId() ) && ( _id.GetType() == ValueID::ValueType_Bool ) )
+	{
+		if( !strcasecmp( "true", _value.c_str() ) )
+		{
+			_level = 0xff;
+			return true;
+		}
+		if( !strcasecmp( "false", _value.c_str() ) )
+		{
+			_level = 0x00;
+			return true;
+		}
+	}
+	else if( ( _id.GetCommandClassId() == SwitchMultilevel::StaticGetCommandClassId() ) && ( _id.GetType() == ValueID::ValueType_Byte ) )
+	{
+		int32 val = atoi( _value.c_str() );
+		if( ( ( val >= 0 ) && ( val <= 99 ) ) || ( val == 0xff ) )
+		{
+			_level = (uint8)val;
+			return true;
+		}
+	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeDeviceType>
-// Get the node device type as reported in the Z-Wave+ Info report.
+// <Driver::SendMulticastSet>
+// Send a switch's set command to several nodes at once
 //-----------------------------------------------------------------------------
-uint16 Driver::GetNodeDeviceType
+void Driver::SendMulticastSet
 (
-		uint8 const _nodeId
+		vector<uint8> const& _nodeIds,
+		uint8 const _commandClassId,
+		uint8 const _level
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	for( uint32 start = 0; start < _nodeIds.size(); start += c_maxMulticastNodes )
 	{
-		return node->GetDeviceType();
-	}
+		uint32 count = (uint32)_nodeIds.size() - start;
+		if( count > c_maxMulticastNodes )
+		{
+			count = c_maxMulticastNodes;
+		}
 
-	return 0x00; // unknown
+		Log::Write( LogLevel_Info, "Multicasting set of command class 0x%.2x to %d nodes", _commandClassId, count );
+		Msg* msg = new Msg( "Multicast Set", 0xff, REQUEST, FUNC_ID_ZW_SEND_DATA_MULTI, true );
+		msg->Append( (uint8)count );
+		for( uint32 i=0; i<count; ++i )
+		{
+			msg->Append( _nodeIds[start+i] );
+		}
+		msg->Append( 3 );
+		msg->Append( _commandClassId );
+		msg->Append( 0x01 );			// Set, in both of the switch command classes
+		msg->Append( _level );
+		msg->Append( GetTransmitOptions() );
+		SendMsg( msg, MsgQueue_Send );
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeDeviceTypeString>
-// Get the node DeviceType as a string as reported in the Z-Wave+ Info report.
+// <Driver::SetConfigParam>
+// Set the value of one of the configuration parameters of a device
 //-----------------------------------------------------------------------------
-
-string Driver::GetNodeDeviceTypeString
+bool Driver::SetConfigParam
 (
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		uint8 const _param,
+		int32 _value,
+		uint8 _size
 )
 {
-
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		return node->GetDeviceTypeString();
+		return node->SetConfigParam( _param, _value, _size );
 	}
 
-	return ""; // unknown
+	return false;
 }
 
-
-
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeRole>
-// Get the node role as reported in the Z-Wave+ Info report.
+// <Driver::RequestConfigParam>
+// Request the value of one of the configuration parameters of a device
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNodeRole
+void Driver::RequestConfigParam
 (
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		uint8 const _param
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		return node->GetRoleType();
+		node->RequestConfigParam( _param );
 	}
-
-	return 0x00; // unknown
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeRoleString>
-// Get the node role as a string as reported in the Z-Wave+ Info report.
+// <Driver::ProvisionConfigParams>
+// Push a set of configuration parameters to a node, skipping those that
+// already have the value wanted
 //-----------------------------------------------------------------------------
-string Driver::GetNodeRoleString
+bool Driver::ProvisionConfigParams
 (
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		map<uint8,int32> const& _params
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	WriteLockGuard LG(m_nodeMutex);
+	Node* node = GetNode( _nodeId );
+	if( !node || !node->GetCommandClass( Configuration::StaticGetCommandClassId() ) )
 	{
-		return node->GetRoleTypeString();
+		return false;
 	}
 
-	return ""; // unknown
-}
+	Provision* provision;
+	map<uint8,Provision*>::iterator pit = m_provisions.find( _nodeId );
+	if( pit != m_provisions.end() )
+	{
+		provision = pit->second;
+	}
+	else
+	{
+		provision = new Provision();
+		provision->m_failed = 0;
+		m_provisions[_nodeId] = provision;
+	}
 
-//-----------------------------------------------------------------------------
-// <Driver::GetNodePlusType>
-// Get the node role as a string as reported in the Z-Wave+ Info report.
-//-----------------------------------------------------------------------------
-uint8 Driver::GetNodePlusType
-(
-		uint8 const _nodeId
-)
-{
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	uint32 skipped = 0;
+	for( map<uint8,int32>::const_iterator it = _params.begin(); it != _params.end(); ++it )
 	{
-		return node->GetNodeType();
+		// A later request for a parameter replaces one not yet sent
+		for( list<ProvisionParam>::iterator lit = provision->m_pending.begin(); lit != provision->m_pending.end(); ++lit )
+		{
+			if( lit->m_param == it->first )
+			{
+				provision->m_pending.erase( lit );
+				break;
+			}
+		}
+
+		// Parameters that have never been reported are sent with the
+		// default size used by SetConfigParam
+		ProvisionParam param;
+		param.m_param = it->first;
+		param.m_value = it->second;
+		param.m_size = 2;
+		int32 current;
+		if( node->GetConfigParam( it->first, current, param.m_size ) && ( current == it->second ) )
+		{
+			++skipped;
+			continue;
+		}
+		provision->m_pending.push_back( param );
 	}
-	return 0x00; // unknown
+
+	Log::Write( LogLevel_Info, _nodeId, "Provisioning %d configuration parameters (%d already set)", (int)provision->m_pending.size(), skipped );
+	ProvisionNext( _nodeId );
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodePlusTypeString>
-// Get the node role as a string as reported in the Z-Wave+ Info report.
+// <Driver::ProvisionNext>
+// Send a node's next configuration parameters, or finish if there are none
 //-----------------------------------------------------------------------------
-string Driver::GetNodePlusTypeString
+void Driver::ProvisionNext
 (
 		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	WriteLockGuard LG(m_nodeMutex);
+	map<uint8,Provision*>::iterator pit = m_provisions.find( _nodeId );
+	if( pit == m_provisions.end() )
 	{
-		return node->GetNodeTypeString();
+		return;
 	}
-	return ""; // unknown
-}
-
+	Provision* provision = pit->second;
+	Node* node = GetNode( _nodeId );
+	Configuration* cc = node ? static_cast<Configuration*>( node->GetCommandClass( Configuration::StaticGetCommandClassId() ) ) : NULL;
+	if( cc != NULL )
+	{
+		while( !provision->m_pending.empty() && ( provision->m_outstanding.size() < (uint32)m_provisionWindow ) )
+		{
+			ProvisionParam param = provision->m_pending.front();
+			provision->m_pending.pop_front();
+			node->SetConfigParam( param.m_param, param.m_value, param.m_size );
 
+			// The report to this confirms the parameter
+			if( cc->RequestValue( 0, param.m_param, 1, MsgQueue_Send ) )
+			{
+				provision->m_outstanding[param.m_param] = param;
+			}
+		}
+	}
 
+	uint32 remaining = (uint32)( provision->m_pending.size() + provision->m_outstanding.size() );
+	Notification* notification = new Notification( Notification::Type_ConfigProvisioning );
+	notification->SetHomeAndNodeIds( m_homeId, _nodeId );
+	notification->SetProvisionProgress( (uint8)( remaining < 0xff ? remaining : 0xff ), (uint8)( provision->m_failed < 0xff ? provision->m_failed : 0xff ) );
+	QueueNotification( notification );
 
+	if( provision->m_outstanding.empty() )
+	{
+		// Nothing can be confirmed from here on, so provisioning is over
+		Log::Write( LogLevel_Info, _nodeId, "Provisioning of configuration parameters complete (%d failed)", provision->m_failed );
+		delete provision;
+		m_provisions.erase( pit );
+	}
+}
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeManufacturerName>
-// Set the manufacturer name for the node with the specified ID
+// <Driver::ProvisionReport>
+// A configuration parameter has been reported by a device
 //-----------------------------------------------------------------------------
-void Driver::SetNodeManufacturerName
+void Driver::ProvisionReport
 (
 		uint8 const _nodeId,
-		string const& _manufacturerName
+		uint8 const _param,
+		int32 const _value,
+		uint8 const _size
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	WriteLockGuard LG(m_nodeMutex);
+	map<uint8,Provision*>::iterator pit = m_provisions.find( _nodeId );
+	if( pit == m_provisions.end() )
 	{
-		node->SetManufacturerName( _manufacturerName );
+		return;
+	}
+	map<uint8,ProvisionParam>::iterator it = pit->second->m_outstanding.find( _param );
+	if( it == pit->second->m_outstanding.end() )
+	{
+		return;
+	}
+
+	// Reports are unsigned, so only compare the bytes that were sent
+	uint32 mask = ( _size >= 4 ) ? 0xffffffff : ( ( 1u << ( _size * 8 ) ) - 1 );
+	if( ( (uint32)_value & mask ) != ( (uint32)it->second.m_value & mask ) )
+	{
+		Log::Write( LogLevel_Warning, _nodeId, "WARNING: Configuration parameter %d was reported as %d rather than %d", _param, _value, it->second.m_value );
+		++pit->second->m_failed;
 	}
+	pit->second->m_outstanding.erase( it );
+	ProvisionNext( _nodeId );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeProductName>
-// Set the product name string value with the specified ID
+// <Driver::ProvisionMsgRemoved>
+// A message is being removed.  If it was a parameter's read back and there
+// has been no report, the parameter has failed.
 //-----------------------------------------------------------------------------
-void Driver::SetNodeProductName
+void Driver::ProvisionMsgRemoved
 (
-		uint8 const _nodeId,
-		string const& _productName
+		Msg const* _msg
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	if( ( _msg->GetSendDataByte( 0 ) != Configuration::StaticGetCommandClassId() ) || ( _msg->GetSendDataByte( 1 ) != 0x05 ) )	// ConfigurationCmd_Get
 	{
-		node->SetProductName( _productName );
+		return;
+	}
+
+	WriteLockGuard LG(m_nodeMutex);
+	uint8 nodeId = _msg->GetTargetNodeId();
+	map<uint8,Provision*>::iterator pit = m_provisions.find( nodeId );
+	if( pit == m_provisions.end() )
+	{
+		return;
+	}
+	map<uint8,ProvisionParam>::iterator it = pit->second->m_outstanding.find( _msg->GetSendDataByte( 2 ) );
+	if( it != pit->second->m_outstanding.end() )
+	{
+		Log::Write( LogLevel_Warning, nodeId, "WARNING: Configuration parameter %d could not be confirmed", it->first );
+		++pit->second->m_failed;
+		pit->second->m_outstanding.erase( it );
+		ProvisionNext( nodeId );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeName>
-// Set the node name string value with the specified ID
+// <Driver::CancelProvision>
+// Forget the parameters being provisioned on a node
 //-----------------------------------------------------------------------------
-void Driver::SetNodeName
+void Driver::CancelProvision
 (
-		uint8 const _nodeId,
-		string const& _nodeName
+		uint8 const _nodeId
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	WriteLockGuard LG(m_nodeMutex);
+	map<uint8,Provision*>::iterator pit = m_provisions.find( _nodeId );
+	if( pit != m_provisions.end() )
 	{
-		node->SetNodeName( _nodeName );
+		delete pit->second;
+		m_provisions.erase( pit );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeLocation>
-// Set the location string value with the specified ID
+// <Driver::ProvisionUserCodes>
+// Push a set of user codes to a lock, skipping slots that already hold them
 //-----------------------------------------------------------------------------
-void Driver::SetNodeLocation
+bool Driver::ProvisionUserCodes
 (
 		uint8 const _nodeId,
-		string const& _location
+		map<uint8,string> const& _codes,
+		bool const _clearOthers
 )
 {
-	LockGuard LG(m_nodeMutex);
+	WriteLockGuard LG(m_nodeMutex);
 	if( Node* node = GetNode( _nodeId ) )
 	{
-		node->SetLocation( _location );
+		if( UserCode* cc = static_cast<UserCode*>( node->GetCommandClass( UserCode::StaticGetCommandClassId() ) ) )
+		{
+			cc->ProvisionCodes( _codes, _clearOthers );
+			return true;
+		}
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeLevel>
-// Helper to set the node level through the basic command class
+// <Driver::BeginValueSet>
+// Start watching for the outcome of a value set, before the set is sent
 //-----------------------------------------------------------------------------
-void Driver::SetNodeLevel
+void Driver::BeginValueSet
 (
-		uint8 const _nodeId,
-		uint8 const _level
+		Value const* _value,
+		string const& _newValue,
+		uint32 const _timeout,
+		pfnSetValueCallback_t _callback,
+		void* _context
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		node->SetLevel( _level );
-	}
+	ValueSet* set = new ValueSet( _value->GetID() );
+	set->m_value = _newValue;
+	set->m_writeOnly = _value->IsWriteOnly();
+	set->m_timeout = _timeout;
+	set->m_due.SetTime( _timeout );
+	set->m_callback = _callback;
+	set->m_context = _context;
+
+	LockGuard LG( m_valueSetMutex );
+	AddValueSet( set );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeOn>
-// Helper to set the node on through the basic command class
+// <Driver::AddValueSet>
+// Start waiting for a set, in place of any earlier set of the same value.
+// Called with m_valueSetMutex held.
 //-----------------------------------------------------------------------------
-void Driver::SetNodeOn
+void Driver::AddValueSet
 (
-		uint8 const _nodeId
+		ValueSet* _set
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	// The device can only confirm the latest value it was sent.  The set's own
+	// messages wake the driver thread, which then times it out when it is due.
+	for( list<ValueSet*>::iterator it = m_valueSets.begin(); it != m_valueSets.end(); )
 	{
-		node->SetNodeOn();
+		if( (*it)->m_id == _set->m_id )
+		{
+			// A failure rolls the value back to before the first of the sets
+			if( _set->m_previous == NULL )
+			{
+				_set->m_previous = (*it)->m_previous;
+				(*it)->m_previous = NULL;
+			}
+			m_valueSetResults.push_back( make_pair( *it, SetValueResult_Superseded ) );
+			it = m_valueSets.erase( it );
+		}
+		else
+		{
+			++it;
+		}
 	}
+	m_valueSets.push_back( _set );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetNodeOff>
-// Helper to set the node off through the basic command class
+// <Driver::EndValueSet>
+// Forget the latest set of a value, which could not be sent
 //-----------------------------------------------------------------------------
-void Driver::SetNodeOff
+void Driver::EndValueSet
 (
-		uint8 const _nodeId
+		ValueID const& _id
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	LockGuard LG( m_valueSetMutex );
+	for( list<ValueSet*>::reverse_iterator it = m_valueSets.rbegin(); it != m_valueSets.rend(); ++it )
 	{
-		node->SetNodeOff();
+		if( (*it)->m_id == _id )
+		{
+			ValueSet* set = *it;
+			m_valueSets.erase( --it.base() );
+			if( set->m_previous != NULL )
+			{
+				// It took over an optimistic set, whose value must still be rolled back
+				set->m_callback = NULL;
+				m_valueSetResults.push_back( make_pair( set, SetValueResult_NotDelivered ) );
+			}
+			else
+			{
+				delete set;
+			}
+			break;
+		}
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetValue>
-// Get a pointer to a Value object for the specified ValueID
+// <Driver::BeginOptimisticSet>
+// Give a value the new value from a set straight away, as if the device had
+// reported it, keeping the old one in case the set fails.  _target is the
+// temporary copy that the set was made from.
 //-----------------------------------------------------------------------------
-Value* Driver::GetValue
+void Driver::BeginOptimisticSet
 (
-		ValueID const& _id
+		Value* _target,
+		uint32 const _timeout
 )
 {
-
-	// This method is only called by code that has already locked the node
-	if( Node* node = m_nodes[_id.GetNodeId()] )
+	Value* value = GetValue( _target->GetID() );
+	if( value == NULL )
 	{
-		return node->GetValue( _id );
+		return;
 	}
 
-	return NULL;
-}
+	{
+		LockGuard LG( m_valueSetMutex );
+		if( !value->SwapValue( _target ) )
+		{
+			// Only the scalar and list values are set optimistically
+			value->Release();
+			return;
+		}
 
-//-----------------------------------------------------------------------------
-// Controller commands
-//-----------------------------------------------------------------------------
+		// A set made through SetValueAsync is already waiting.  Otherwise one
+		// is started here, with no callback, to confirm or roll back this one.
+		ValueSet* set = NULL;
+		for( list<ValueSet*>::reverse_iterator it = m_valueSets.rbegin(); it != m_valueSets.rend(); ++it )
+		{
+			if( (*it)->m_id == _target->GetID() )
+			{
+				set = *it;
+				break;
+			}
+		}
+		if( set == NULL || !ValueSetMatches( value, set->m_value ) )
+		{
+			set = new ValueSet( _target->GetID() );
+			set->m_value = value->GetAsString();
+			set->m_timeout = _timeout;
+			set->m_due.SetTime( _timeout );
+			AddValueSet( set );
+		}
 
-//-----------------------------------------------------------------------------
-// <Driver::ResetController>
-// Reset controller and erase all node information
-//-----------------------------------------------------------------------------
-void Driver::ResetController
-(
-		Event* _evt
-)
-{
-	m_controllerResetEvent = _evt;
-	Log::Write( LogLevel_Info, "Reset controller and erase all node information");
-	Msg* msg = new Msg( "Reset controller and erase all node information", 0xff, REQUEST, FUNC_ID_ZW_SET_DEFAULT, true );
-	SendMsg( msg, MsgQueue_Command );
-}
+		// The copy now holds the old value.  If an earlier set is still
+		// waiting, the value from before that one is kept instead.
+		if( set->m_previous == NULL )
+		{
+			_target->AddRef();
+			set->m_previous = _target;
+		}
+	}
 
-//-----------------------------------------------------------------------------
-// <Driver::SoftReset>
-// Soft-reset the Z-Wave controller chip
-//-----------------------------------------------------------------------------
-void Driver::SoftReset
-(
-)
-{
-	Log::Write( LogLevel_Info, "Soft-resetting the Z-Wave controller chip");
-	Msg* msg = new Msg( "Soft-resetting the Z-Wave controller chip", 0xff, REQUEST, FUNC_ID_SERIAL_API_SOFT_RESET, false, false );
-	SendMsg( msg, MsgQueue_Command );
+	Log::Write( LogLevel_Info, value->GetID().GetNodeId(), "Value 0x%016llx shows \"%s\" until the set is confirmed", (unsigned long long)value->GetID().GetId(), value->GetAsString().c_str() );
+	Notification* notification = new Notification( Notification::Type_ValueChanged );
+	notification->SetValueId( value->GetID() );
+	notification->SetValueState( Notification::ValueState_Pending );
+	QueueNotification( notification );
+	value->Release();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RequestNodeNeighbors>
-// Get the neighbour information for a node from the controller
+// <Driver::ValueSetReported>
+// A value has been read from its device.  A set of it is confirmed if the
+// value is the one that was sent.  Any other value only counts once the set
+// has been delivered, since until then the report may be from before it.
 //-----------------------------------------------------------------------------
-void Driver::RequestNodeNeighbors
+void Driver::ValueSetReported
 (
-		uint8 const _nodeId,
-		uint32 const _requestFlags
+		Value* _value
 )
 {
-	if( IsAPICallSupported( FUNC_ID_ZW_GET_ROUTING_INFO ) )
+	LockGuard LG( m_valueSetMutex );
+	for( list<ValueSet*>::iterator it = m_valueSets.begin(); it != m_valueSets.end(); )
 	{
-		// Note: This is not the same as RequestNodeNeighbourUpdate.  This method
-		// merely requests the controller's current neighbour information and
-		// the reply will be copied into the relevant Node object for later use.
-		Log::Write( LogLevel_Detail, GetNodeNumber( m_currentMsg ), "Requesting routing info (neighbor list) for Node %d", _nodeId );
-		Msg* msg = new Msg( "Get Routing Info", _nodeId, REQUEST, FUNC_ID_ZW_GET_ROUTING_INFO, false );
-		msg->Append( _nodeId );
-		msg->Append( 0 ); // don't remove bad links
-		msg->Append( 0 ); // don't remove non-repeaters
-		msg->Append( 3 ); // funcid
-		SendMsg( msg, MsgQueue_Command );
+		ValueSet* set = *it;
+		if( set->m_id == _value->GetID() && ( set->m_delivered || ValueSetMatches( _value, set->m_value ) ) )
+		{
+			m_valueSetResults.push_back( make_pair( set, ValueSetMatches( _value, set->m_value ) ? SetValueResult_Confirmed : SetValueResult_Different ) );
+			it = m_valueSets.erase( it );
+		}
+		else
+		{
+			++it;
+		}
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::BeginControllerCommand>
-// Start the controller performing one of its network management functions
-// Create a ControllerCommand request.
+// <Driver::ValueSetMsgRemoved>
+// A message is being removed.  If it was dropped, the sets waiting on its
+// node and command class have failed.  If it was delivered, they can be
+// confirmed by the next report, or at once for write only values.
 //-----------------------------------------------------------------------------
-bool Driver::BeginControllerCommand
+void Driver::ValueSetMsgRemoved
 (
-		ControllerCommand _command,
-		pfnControllerCallback_t _callback,
-		void* _context,
-		bool _highPower,
-		uint8 _nodeId,
-		uint8 _arg
+		Msg const* _msg,
+		bool const _delivered
 )
 {
-	ControllerCommandItem* cci;
-	MsgQueueItem item;
-
-	if( _command == ControllerCommand_None )
+	if( !_msg->IsSendData() )
 	{
-		return false;
+		return;
 	}
 
-	Log::Write( LogLevel_Detail, _nodeId, "Queuing (%s) %s", c_sendQueueNames[MsgQueue_Controller], c_controllerCommandNames[_command] );
-	cci = new ControllerCommandItem();
-	cci->m_controllerCommand = _command;
-	cci->m_controllerCallback = _callback;
-	cci->m_controllerCallbackContext = _context;
-	cci->m_highPower = _highPower;
-	cci->m_controllerCommandNode = _nodeId;
-	cci->m_controllerCommandArg = _arg;
-	cci->m_controllerState = ControllerState_Normal;
-	cci->m_controllerStateChanged = false;
-	cci->m_controllerCommandDone = false;
-
-	item.m_command = MsgQueueCmd_Controller;
-	item.m_cci = cci;
+	// A Set wrapped for an instance is only known by the command class of its read back
+	uint8 nodeId = _msg->GetTargetNodeId();
+	uint8 commandClassId = _msg->GetSendDataByte( 0 );
+	if( commandClassId == 0 )
+	{
+		commandClassId = _msg->GetExpectedCommandClassId();
+	}
 
-	m_sendMutex->Lock();
-	m_msgQueue[MsgQueue_Controller].push_back( item );
-	m_queueEvent[MsgQueue_Controller]->Set();
-	m_sendMutex->Unlock();
+	LockGuard LG( m_valueSetMutex );
+	for( list<ValueSet*>::iterator it = m_valueSets.begin(); it != m_valueSets.end(); )
+	{
+		ValueSet* set = *it;
+		if( set->m_id.GetNodeId() != nodeId || set->m_id.GetCommandClassId() != commandClassId )
+		{
+			++it;
+			continue;
+		}
 
-	return true;
+		set->m_delivered = true;
+		if( !_delivered || set->m_writeOnly )
+		{
+			m_valueSetResults.push_back( make_pair( set, _delivered ? SetValueResult_Delivered : SetValueResult_NotDelivered ) );
+			it = m_valueSets.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::DoControllerCommand>
-// Start the controller performing one of its network management functions
+// <Driver::CheckValueSets>
+// Make the callbacks for the sets that are over, and time out any that are
+// due.  Called by the driver thread.
 //-----------------------------------------------------------------------------
-void Driver::DoControllerCommand
+int32 Driver::CheckValueSets
 (
-)
-{
-	UpdateControllerState( ControllerState_Starting );
-	switch( m_currentControllerCommand->m_controllerCommand )
-	{
-		case ControllerCommand_AddDevice:
-		{
-			if( !IsPrimaryController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Add Device" );
-				Msg* msg = new Msg( "ControllerCommand_AddDevice", 0xff, REQUEST, FUNC_ID_ZW_ADD_NODE_TO_NETWORK, true );
-				uint8 options = ADD_NODE_ANY;
-				if (m_currentControllerCommand->m_highPower) options |= OPTION_HIGH_POWER;
-				if (IsAPICallSupported(FUNC_ID_ZW_EXPLORE_REQUEST_INCLUSION)) options |= OPTION_NWI;
-				msg->Append( options);
-				SendMsg( msg, MsgQueue_Command );
-			}
-			break;
-		}
-		case ControllerCommand_CreateNewPrimary:
+)
+{
+	int32 next = -1;
+	ValueSetResults results;
+	m_valueSetMutex->Lock();
+	results.swap( m_valueSetResults );
+	for( list<ValueSet*>::iterator it = m_valueSets.begin(); it != m_valueSets.end(); )
+	{
+		ValueSet* set = *it;
+		if( set->m_timeout == 0 )
 		{
-			if( IsPrimaryController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotSecondary );
-			}
-			else if( !IsStaticUpdateController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotSUC );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Create New Primary" );
-				Msg* msg = new Msg( "ControllerCommand_CreateNewPrimary", 0xff, REQUEST, FUNC_ID_ZW_CREATE_NEW_PRIMARY, true );
-				msg->Append( CREATE_PRIMARY_START );
-				SendMsg( msg, MsgQueue_Command );
-			}
-			break;
+			++it;
+			continue;
 		}
-		case ControllerCommand_ReceiveConfiguration:
+
+		int32 remaining = set->m_due.TimeRemaining();
+		if( remaining <= 0 )
 		{
-			Log::Write( LogLevel_Info, 0, "Receive Configuration" );
-			Msg* msg = new Msg( "ControllerCommand_ReceiveConfiguration", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, true );
-			msg->Append( 0xff );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			results.push_back( make_pair( set, SetValueResult_Timeout ) );
+			it = m_valueSets.erase( it );
+			continue;
 		}
-		case ControllerCommand_RemoveDevice:
+		if( next < 0 || remaining < next )
 		{
-			if( !IsPrimaryController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Remove Device" );
-				Msg* msg = new Msg( "ControllerCommand_RemoveDevice", 0xff, REQUEST, FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK, true );
-				msg->Append( m_currentControllerCommand->m_highPower ? REMOVE_NODE_ANY | OPTION_HIGH_POWER : REMOVE_NODE_ANY );
-				SendMsg( msg, MsgQueue_Command );
-			}
-			break;
+			next = remaining;
 		}
-		case ControllerCommand_HasNodeFailed:
+		++it;
+	}
+	m_valueSetMutex->Unlock();
+
+	CompleteValueSets( results );
+	return next;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CancelValueSets>
+// End the sets of a node's values, or of every value if _nodeId is 0
+//-----------------------------------------------------------------------------
+void Driver::CancelValueSets
+(
+		uint8 const _nodeId
+)
+{
+	LockGuard LG( m_valueSetMutex );
+	for( list<ValueSet*>::iterator it = m_valueSets.begin(); it != m_valueSets.end(); )
+	{
+		if( _nodeId == 0 || (*it)->m_id.GetNodeId() == _nodeId )
 		{
-			Log::Write( LogLevel_Info, 0, "Requesting whether node %d has failed", m_currentControllerCommand->m_controllerCommandNode );
-			Msg* msg = new Msg( "ControllerCommand_HasNodeFailed", 0xff, REQUEST, FUNC_ID_ZW_IS_FAILED_NODE_ID, false );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			m_valueSetResults.push_back( make_pair( *it, SetValueResult_Cancelled ) );
+			it = m_valueSets.erase( it );
 		}
-		case ControllerCommand_RemoveFailedNode:
+		else
 		{
-			Log::Write( LogLevel_Info, 0, "ControllerCommand_RemoveFailedNode", m_currentControllerCommand->m_controllerCommandNode );
-			Msg* msg = new Msg( "ControllerCommand_RemoveFailedNode", 0xff, REQUEST, FUNC_ID_ZW_REMOVE_FAILED_NODE_ID, true );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			++it;
 		}
-		case ControllerCommand_ReplaceFailedNode:
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CompleteValueSets>
+// Tell the applications how their sets went
+//-----------------------------------------------------------------------------
+void Driver::CompleteValueSets
+(
+		ValueSetResults& _results
+)
+{
+	static char const* c_setValueResultNames[] =
+	{
+		"Confirmed",
+		"Delivered",
+		"Different",
+		"NotDelivered",
+		"Timeout",
+		"Superseded",
+		"Cancelled"
+	};
+
+	for( ValueSetResults::iterator it = _results.begin(); it != _results.end(); ++it )
+	{
+		ValueSet* set = it->first;
+		Log::Write( it->second <= SetValueResult_Delivered ? LogLevel_Info : LogLevel_Warning, set->m_id.GetNodeId(), "Set of value 0x%016llx to \"%s\": %s", (unsigned long long)set->m_id.GetId(), set->m_value.c_str(), c_setValueResultNames[it->second] );
+		if( set->m_previous != NULL )
 		{
-			Log::Write( LogLevel_Info, 0, "Replace Failed Node %d", m_currentControllerCommand->m_controllerCommandNode );
-			Msg* msg = new Msg( "ControllerCommand_ReplaceFailedNode", 0xff, REQUEST, FUNC_ID_ZW_REPLACE_FAILED_NODE, true );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			EndOptimisticSet( set, it->second );
 		}
-		case ControllerCommand_TransferPrimaryRole:
+		if( set->m_callback )
 		{
-			if( !IsPrimaryController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Transfer Primary Role" );
-				Msg* msg = new Msg( "ControllerCommand_TransferPrimaryRole", 0xff, REQUEST, FUNC_ID_ZW_CONTROLLER_CHANGE, true );
-				msg->Append( m_currentControllerCommand->m_highPower ? CONTROLLER_CHANGE_START | OPTION_HIGH_POWER : CONTROLLER_CHANGE_START );
-				SendMsg( msg, MsgQueue_Command );
-			}
-			break;
+			set->m_callback( set->m_id, it->second, set->m_context );
 		}
-		case ControllerCommand_RequestNetworkUpdate:
+		delete set;
+	}
+	_results.clear();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::EndOptimisticSet>
+// Tell the watchers that a value shown before its device reported it has
+// been confirmed, or put the value back as it was if the set failed.  If the
+// device reported something else, that report has already been notified.
+//-----------------------------------------------------------------------------
+void Driver::EndOptimisticSet
+(
+		ValueSet* _set,
+		SetValueResult const _result
+)
+{
+	Value* previous = _set->m_previous;
+	_set->m_previous = NULL;
+
+	uint8 state;
+	switch( _result )
+	{
+		case SetValueResult_Confirmed:
 		{
-			if( !IsStaticUpdateController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotSUC );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Request Network Update" );
-				Msg* msg = new Msg( "ControllerCommand_RequestNetworkUpdate", 0xff, REQUEST, FUNC_ID_ZW_REQUEST_NETWORK_UPDATE, true );
-				SendMsg( msg, MsgQueue_Command );
-			}
+			state = Notification::ValueState_Confirmed;
 			break;
 		}
-		case ControllerCommand_RequestNodeNeighborUpdate:
+		case SetValueResult_NotDelivered:
+		case SetValueResult_Timeout:
 		{
-			if( !IsPrimaryController() )
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
-			}
-			else
+			state = Notification::ValueState_RolledBack;
+			NodeGuard LG( this, _set->m_id.GetNodeId() );
+			if( Value* value = GetValue( _set->m_id ) )
 			{
-				Log::Write( LogLevel_Info, 0, "Requesting Neighbor Update for node %d", m_currentControllerCommand->m_controllerCommandNode );
-				bool opts = IsAPICallSupported( FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS );
-				Msg* msg;
-				if( opts )
-				{
-					msg = new Msg( "ControllerCommand_RequestNodeNeighborUpdate", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE_OPTIONS, true );
-				}
-				else
-				{
-					msg = new Msg( "ControllerCommand_RequestNodeNeighborUpdate", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_REQUEST_NODE_NEIGHBOR_UPDATE, true );
-				}
-				msg->Append( m_currentControllerCommand->m_controllerCommandNode );
-				if( opts )
-				{
-					msg->Append( GetTransmitOptions() );
-				}
-				SendMsg( msg, MsgQueue_Command );
+				value->SwapValue( previous );
+				value->Release();
 			}
 			break;
 		}
-		case ControllerCommand_AssignReturnRoute:
+		default:
 		{
-			Log::Write( LogLevel_Info, 0, "Assigning return route from node %d to node %d", m_currentControllerCommand->m_controllerCommandNode, m_currentControllerCommand->m_controllerCommandArg );
-			Msg* msg = new Msg( "ControllerCommand_AssignReturnRoute", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_ASSIGN_RETURN_ROUTE, true );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
-			msg->Append( m_currentControllerCommand->m_controllerCommandArg );		// to the specific destination
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			previous->Release();
+			return;
 		}
-		case ControllerCommand_DeleteAllReturnRoutes:
+	}
+	previous->Release();
+
+	Notification* notification = new Notification( Notification::Type_ValueChanged );
+	notification->SetValueId( _set->m_id );
+	notification->SetValueState( state );
+	QueueNotification( notification );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ValueSetMatches>
+// Whether a value holds what it was set to, comparing numbers as numbers
+//-----------------------------------------------------------------------------
+bool Driver::ValueSetMatches
+(
+		Value const* _value,
+		string const& _expected
+)
+{
+	string current = _value->GetAsString();
+	switch( _value->GetID().GetType() )
+	{
+		case ValueID::ValueType_Bool:
+		case ValueID::ValueType_Button:
 		{
-			Log::Write( LogLevel_Info, 0, "Deleting all return routes from node %d", m_currentControllerCommand->m_controllerCommandNode );
-			Msg* msg = new Msg( "ControllerCommand_DeleteAllReturnRoutess", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_DELETE_RETURN_ROUTE, true );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			return !strcasecmp( current.c_str(), _expected.c_str() );
 		}
-		case ControllerCommand_SendNodeInformation:
+		case ValueID::ValueType_Byte:
+		case ValueID::ValueType_Short:
+		case ValueID::ValueType_Int:
 		{
-			Log::Write( LogLevel_Info, 0, "Sending a node information frame" );
-			Msg* msg = new Msg( "ControllerCommand_SendNodeInformation", m_currentControllerCommand->m_controllerCommandNode, REQUEST, FUNC_ID_ZW_SEND_NODE_INFORMATION, true );
-			msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// to the node
-			msg->Append( GetTransmitOptions() );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			return( atoi( current.c_str() ) == atoi( _expected.c_str() ) );
 		}
-		case ControllerCommand_ReplicationSend:
+		case ValueID::ValueType_Decimal:
 		{
-			if( !IsPrimaryController() )
+			// Equal to the precision the device reports with
+			double step = 1.0;
+			for( uint8 i = static_cast<ValueDecimal const*>( _value )->GetPrecision(); i > 0; --i )
 			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotPrimary );
-			}
-			else
-			{
-				Log::Write( LogLevel_Info, 0, "Replication Send" );
-				Msg* msg = new Msg( "ControllerCommand_ReplicationSend", 0xff, REQUEST, FUNC_ID_ZW_ADD_NODE_TO_NETWORK, true );
-				msg->Append( m_currentControllerCommand->m_highPower ? ADD_NODE_CONTROLLER | OPTION_HIGH_POWER : ADD_NODE_CONTROLLER );
-				SendMsg( msg, MsgQueue_Command );
+				step /= 10.0;
 			}
-			break;
+			return( fabs( atof( current.c_str() ) - atof( _expected.c_str() ) ) < step / 2.0 );
 		}
-		case ControllerCommand_CreateButton:
+		default:
 		{
-			if( IsBridgeController() )
-			{
-				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-				if( node != NULL )
-				{
-					if( node->m_buttonMap.find( m_currentControllerCommand->m_controllerCommandArg ) == node->m_buttonMap.end() && m_virtualNeighborsReceived )
-					{
-						bool found = false;
-						for( uint8 n = 1; n <= 232 && !found; n++ )
-						{
-							if( !IsVirtualNode( n ))
-								continue;
+			return( current == _expected );
+		}
+	}
+}
 
-							map<uint8,uint8>::iterator it = node->m_buttonMap.begin();
-							for( ; it != node->m_buttonMap.end(); ++it )
-							{
-								// is virtual node already in map?
-								if( it->second == n )
-									break;
-							}
-							if( it == node->m_buttonMap.end() ) // found unused virtual node
-							{
-								node->m_buttonMap[m_currentControllerCommand->m_controllerCommandArg] = n;
-								SendVirtualNodeInfo( n, m_currentControllerCommand->m_controllerCommandNode );
-								found = true;
-							}
-						}
-						if( !found ) // create a new virtual node
-						{
-							Log::Write( LogLevel_Info, 0, "AddVirtualNode" );
-							Msg* msg = new Msg( "FUNC_ID_SERIAL_API_SLAVE_NODE_INFO", 0xff, REQUEST, FUNC_ID_SERIAL_API_SLAVE_NODE_INFO, false, false );
-							msg->Append( 0 );		// node 0
-							msg->Append( 1 );		// listening
-							msg->Append( 0x09 );		// genericType window covering
-							msg->Append( 0x00 );		// specificType undefined
-							msg->Append( 0 );		// length
-							SendMsg( msg, MsgQueue_Command );
+//-----------------------------------------------------------------------------
+// <Driver::RaiseSceneEvent>
+// Pass a scene or button event straight to the watchers, from the driver
+// thread, ahead of the notifications it also brings about
+//-----------------------------------------------------------------------------
+void Driver::RaiseSceneEvent
+(
+		SceneEvent& _event
+)
+{
+	_event.m_homeId = m_homeId;
+	uint32 now = (uint32)-m_startTime.TimeRemaining();
+	_event.m_received = ( now > m_rxFrameAge ) ? now - m_rxFrameAge : 0;
+	Manager::Get()->NotifySceneEventWatchers( _event );
+	CheckSceneRules( _event );
+}
 
-							msg = new Msg( "FUNC_ID_ZW_SET_SLAVE_LEARN_MODE", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
-							msg->Append( 0 );		// node 0 to add
-							if( IsPrimaryController() || IsInclusionController() )
-							{
-								msg->Append( SLAVE_LEARN_MODE_ADD );
-							}
-							else
-							{
-								msg->Append( SLAVE_LEARN_MODE_ENABLE );
-							}
-							SendMsg( msg, MsgQueue_Command );
-						}
-					}
-					else
-					{
-						UpdateControllerState( ControllerState_Error, ControllerError_ButtonNotFound );
-					}
-				}
-				else
+//-----------------------------------------------------------------------------
+// <Driver::AddSceneRule>
+// Activate a scene whenever a value changes, or changes to a given value
+//-----------------------------------------------------------------------------
+uint32 Driver::AddSceneRule
+(
+		ValueID const& _valueId,
+		string const& _value,
+		uint8 const _sceneId
+)
+{
+	LockGuard LG( m_triggerMutex );
+	SceneRule rule;
+	rule.m_ruleId = m_nextSceneRuleId++;
+	rule.m_sceneId = _sceneId;
+	rule.m_value = _value;
+	rule.m_keyAttributes = 0xff;
+	m_valueSceneRules[_valueId.GetId()].push_back( rule );
+	Log::Write( LogLevel_Info, _valueId.GetNodeId(), "Scene rule %d: activate scene %d when value 0x%.16llx changes%s%s", rule.m_ruleId, _sceneId, (unsigned long long)_valueId.GetId(), _value.empty() ? "" : " to ", _value.c_str() );
+	return rule.m_ruleId;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AddSceneRule>
+// Activate a scene whenever a node sends a scene event
+//-----------------------------------------------------------------------------
+uint32 Driver::AddSceneRule
+(
+		uint8 const _nodeId,
+		uint8 const _triggerSceneId,
+		uint8 const _keyAttributes,
+		uint8 const _sceneId
+)
+{
+	LockGuard LG( m_triggerMutex );
+	SceneRule rule;
+	rule.m_ruleId = m_nextSceneRuleId++;
+	rule.m_sceneId = _sceneId;
+	rule.m_keyAttributes = _keyAttributes;
+	m_eventSceneRules[(uint16)( ( _nodeId << 8 ) | _triggerSceneId )].push_back( rule );
+	Log::Write( LogLevel_Info, _nodeId, "Scene rule %d: activate scene %d on scene event %d, key attributes %d", rule.m_ruleId, _sceneId, _triggerSceneId, _keyAttributes );
+	return rule.m_ruleId;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RemoveSceneRule>
+// Remove a rule added by AddSceneRule
+//-----------------------------------------------------------------------------
+bool Driver::RemoveSceneRule
+(
+		uint32 const _ruleId
+)
+{
+	LockGuard LG( m_triggerMutex );
+	for( map< uint64, list<SceneRule> >::iterator it = m_valueSceneRules.begin(); it != m_valueSceneRules.end(); ++it )
+	{
+		for( list<SceneRule>::iterator rit = it->second.begin(); rit != it->second.end(); ++rit )
+		{
+			if( rit->m_ruleId == _ruleId )
+			{
+				it->second.erase( rit );
+				if( it->second.empty() )
 				{
-					UpdateControllerState( ControllerState_Error, ControllerError_NodeNotFound );
+					m_valueSceneRules.erase( it );
 				}
-			} else
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotBridge );
+				return true;
 			}
-			break;
 		}
-		case ControllerCommand_DeleteButton:
+	}
+	for( map< uint16, list<SceneRule> >::iterator it = m_eventSceneRules.begin(); it != m_eventSceneRules.end(); ++it )
+	{
+		for( list<SceneRule>::iterator rit = it->second.begin(); rit != it->second.end(); ++rit )
 		{
-			if( IsBridgeController() )
+			if( rit->m_ruleId == _ruleId )
 			{
-				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-				if( node != NULL )
-				{
-					// Make sure button is allocated to a virtual node.
-					if( node->m_buttonMap.find( m_currentControllerCommand->m_controllerCommandArg ) != node->m_buttonMap.end() )
-					{
-#ifdef notdef
-						// We would need a reference count to decide when to free virtual nodes
-						// We could do this by making the bitmap of virtual nodes into a map that also holds a reference count.
-						Log::Write( LogLevel_Info, 0, "RemoveVirtualNode %d", m_currentControllerCommand->m_controllerCommandNode );
-						Msg* msg = new Msg( "Remove Virtual Node", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
-						msg->Append( m_currentControllerCommand->m_controllerCommandNode );		// from the node
-						if( IsPrimaryController() || IsInclusionController() )
-							msg->Append( SLAVE_LEARN_MODE_REMOVE );
-						else
-							msg->Append( SLAVE_LEARN_MODE_ENABLE );
-						SendMsg( msg );
-#endif
-						node->m_buttonMap.erase( m_currentControllerCommand->m_controllerCommandArg );
-						SaveButtons();
-
-						Notification* notification = new Notification( Notification::Type_DeleteButton );
-						notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
-						notification->SetButtonId( m_currentControllerCommand->m_controllerCommandArg );
-						QueueNotification( notification );
-					}
-					else
-					{
-						UpdateControllerState( ControllerState_Error, ControllerError_ButtonNotFound );
-					}
-				}
-				else
+				it->second.erase( rit );
+				if( it->second.empty() )
 				{
-					UpdateControllerState( ControllerState_Error, ControllerError_NodeNotFound );
+					m_eventSceneRules.erase( it );
 				}
+				return true;
 			}
-			else
-			{
-				UpdateControllerState( ControllerState_Error, ControllerError_NotBridge );
-			}
-			break;
 		}
-		case ControllerCommand_None:
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CheckSceneRules>
+// Trigger the scenes whose rules a value change matches.  Only changes
+// reported in a frame from a device count, so a scene's own sets cannot
+// trigger further scenes.
+//-----------------------------------------------------------------------------
+void Driver::CheckSceneRules
+(
+		Value const* _value
+)
+{
+	LockGuard LG( m_triggerMutex );
+	if( m_valueSceneRules.empty() || ( m_triggerNodeId == 0 ) )
+	{
+		return;
+	}
+
+	map< uint64, list<SceneRule> >::const_iterator it = m_valueSceneRules.find( _value->GetID().GetId() );
+	if( it == m_valueSceneRules.end() )
+	{
+		return;
+	}
+	for( list<SceneRule>::const_iterator rit = it->second.begin(); rit != it->second.end(); ++rit )
+	{
+		if( rit->m_value.empty() || ValueSetMatches( _value, rit->m_value ) )
 		{
-			// To keep gcc quiet
-			break;
+			Log::Write( LogLevel_Detail, _value->GetID().GetNodeId(), "Scene rule %d triggered scene %d", rit->m_ruleId, rit->m_sceneId );
+			TriggerScene( rit->m_sceneId );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CheckSceneRules>
+// Trigger the scenes whose rules a scene event matches
+//-----------------------------------------------------------------------------
+void Driver::CheckSceneRules
+(
+		SceneEvent const& _event
+)
+{
+	LockGuard LG( m_triggerMutex );
+	if( m_eventSceneRules.empty() || ( m_triggerNodeId == 0 ) )
+	{
+		return;
+	}
+
+	map< uint16, list<SceneRule> >::const_iterator it = m_eventSceneRules.find( (uint16)( ( _event.m_nodeId << 8 ) | _event.m_sceneId ) );
+	if( it == m_eventSceneRules.end() )
+	{
+		return;
+	}
+	for( list<SceneRule>::const_iterator rit = it->second.begin(); rit != it->second.end(); ++rit )
+	{
+		if( ( rit->m_keyAttributes == 0xff ) || ( rit->m_keyAttributes == _event.m_keyAttributes ) )
+		{
+			Log::Write( LogLevel_Detail, _event.m_nodeId, "Scene rule %d triggered scene %d", rit->m_ruleId, rit->m_sceneId );
+			TriggerScene( rit->m_sceneId );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::TriggerScene>
+// Hold back a scene until the frame that triggered it has been handled
+//-----------------------------------------------------------------------------
+void Driver::TriggerScene
+(
+		uint8 const _sceneId
+)
+{
+	if( find( m_triggeredScenes.begin(), m_triggeredScenes.end(), _sceneId ) == m_triggeredScenes.end() )
+	{
+		m_triggeredScenes.push_back( _sceneId );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::FlushTriggeredScenes>
+// Activate the scenes the frame just handled triggered.  Collection stops
+// first, so the values the scenes set do not trigger rules themselves.
+//-----------------------------------------------------------------------------
+void Driver::FlushTriggeredScenes
+(
+)
+{
+	list<uint8> scenes;
+	m_triggerMutex->Lock();
+	m_triggerNodeId = 0;
+	scenes.swap( m_triggeredScenes );
+	m_triggerMutex->Unlock();
+
+	for( list<uint8>::const_iterator it = scenes.begin(); it != scenes.end(); ++it )
+	{
+		Scene* scene = Scene::Get( *it );
+		if( scene == NULL )
+		{
+			Log::Write( LogLevel_Warning, "Scene %d triggered by a scene rule does not exist", *it );
+			continue;
+		}
+		if( !scene->Activate() )
+		{
+			Log::Write( LogLevel_Warning, "Scene %d triggered by a scene rule was not fully activated", *it );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::AddProvisionedProduct>
+// Expect more nodes of the same product as a node already interviewed
+//-----------------------------------------------------------------------------
+bool Driver::AddProvisionedProduct
+(
+		uint8 const _templateNodeId
+)
+{
+	NodeGuard LG( this, _templateNodeId );
+	Node* node = LG.GetNode();
+	if( node == NULL )
+	{
+		return false;
+	}
+	if( !node->m_manufacturerSpecificClassReceived || node->GetCurrentQueryStage() < Node::QueryStage_CacheLoad )
+	{
+		Log::Write( LogLevel_Warning, _templateNodeId, "AddProvisionedProduct: the node's static queries are not complete" );
+		return false;
+	}
+
+	TiXmlElement nodeElement( "Node" );
+	node->WriteCommandClassesXML( &nodeElement );
+
+	// Commands waiting for the template node to wake up are its own, not the product's
+	for( TiXmlElement* ccElement = nodeElement.FirstChildElement()->FirstChildElement( "CommandClass" ); ccElement; ccElement = ccElement->NextSiblingElement( "CommandClass" ) )
+	{
+		if( TiXmlElement* pendingElement = ccElement->FirstChildElement( "Pending" ) )
+		{
+			ccElement->RemoveChild( pendingElement );
+		}
+	}
+	string commandClasses;
+	XmlWriter::Print( *nodeElement.FirstChildElement(), 0, commandClasses );
+
+	uint64 key = GetProvisioningKey( node->GetManufacturerId(), node->GetProductType(), node->GetProductId() );
+	LockGuard PLG( m_provisioningMutex );
+	ProvisionedProduct& product = m_provisionedProducts[key];
+	product.m_productKey = node->GetProductKey();
+	product.m_commandClasses.swap( commandClasses );
+	Log::Write( LogLevel_Info, _templateNodeId, "Provisioned product %s from node %d", product.m_productKey.c_str(), _templateNodeId );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::RemoveProvisionedProduct>
+// Stop expecting nodes of a product
+//-----------------------------------------------------------------------------
+bool Driver::RemoveProvisionedProduct
+(
+		uint16 const _manufacturerId,
+		uint16 const _productType,
+		uint16 const _productId
+)
+{
+	LockGuard LG( m_provisioningMutex );
+	return m_provisionedProducts.erase( GetProvisioningKey( _manufacturerId, _productType, _productId ) ) != 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::SetProvisionedConfigParam>
+// Set a configuration parameter to send to each new node of a product
+//-----------------------------------------------------------------------------
+bool Driver::SetProvisionedConfigParam
+(
+		uint16 const _manufacturerId,
+		uint16 const _productType,
+		uint16 const _productId,
+		uint8 const _param,
+		int32 const _value,
+		uint8 const _size
+)
+{
+	LockGuard LG( m_provisioningMutex );
+	map<uint64,ProvisionedProduct>::iterator it = m_provisionedProducts.find( GetProvisioningKey( _manufacturerId, _productType, _productId ) );
+	if( it == m_provisionedProducts.end() )
+	{
+		return false;
+	}
+	it->second.m_configParams[_param] = pair<int32,uint8>( _value, _size );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ApplyProvisionedProduct>
+// Give a new node the command classes of its product's template, and send it
+// the desired configuration packed into as few frames as it allows
+//-----------------------------------------------------------------------------
+bool Driver::ApplyProvisionedProduct
+(
+		Node* _node
+)
+{
+	string commandClasses;
+	map< uint8, pair<int32,uint8> > configParams;
+	{
+		LockGuard LG( m_provisioningMutex );
+		map<uint64,ProvisionedProduct>::const_iterator it = m_provisionedProducts.find( GetProvisioningKey( _node->GetManufacturerId(), _node->GetProductType(), _node->GetProductId() ) );
+		if( it == m_provisionedProducts.end() )
+		{
+			return false;
+		}
+		if( it->second.m_productKey != _node->GetProductKey() )
+		{
+			// Another version of the product, with other command classes
+			Log::Write( LogLevel_Info, _node->GetNodeId(), "Node's command classes do not match provisioned product %s, so interviewing it", it->second.m_productKey.c_str() );
+			return false;
 		}
+		commandClasses = it->second.m_commandClasses;
+		configParams = it->second.m_configParams;
+	}
+
+	TiXmlDocument doc;
+	doc.Parse( commandClasses.c_str() );
+	if( doc.RootElement() == NULL )
+	{
+		return false;
+	}
+	Log::Write( LogLevel_Info, _node->GetNodeId(), "Node is a provisioned product, taking its command classes from the template" );
+	_node->ReadCommandClassesXML( doc.RootElement() );
+
+	Configuration* cc = static_cast<Configuration*>( _node->GetCommandClass( Configuration::StaticGetCommandClassId() ) );
+	if( cc == NULL || configParams.empty() )
+	{
+		return true;
+	}
+
+	// As in SetValues, only the commands for a listening node are collected
+	bool pack = ( configParams.size() > 1 ) && _node->IsListeningDevice() && ( _node->GetCommandClass( MultiCmd::StaticGetCommandClassId() ) != NULL );
+	if( pack )
+	{
+		m_setBatchNodeId = _node->GetNodeId();
+	}
+	for( map< uint8, pair<int32,uint8> >::const_iterator it = configParams.begin(); it != configParams.end(); ++it )
+	{
+		cc->Set( it->first, it->second.first, it->second.second );
+	}
+	m_setBatchNodeId = 0;
+
+	if( pack )
+	{
+		list<Msg*> batch;
+		batch.swap( m_setBatch );
+		uint32 count = (uint32)batch.size();
+		uint32 encapsulated = 0;
+		uint32 frames = SendBatch( _node, batch, MsgQueue_Send, encapsulated );
+		Log::Write( LogLevel_Detail, _node->GetNodeId(), "Sent %d provisioned configuration parameters in %d frames (%d MultiCmd encapsulated)", count, frames, encapsulated );
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetNumGroups>
+// Gets the number of association groups reported by this node
+//-----------------------------------------------------------------------------
+uint8 Driver::GetNumGroups
+(
+		uint8 const _nodeId
+)
+{
+	uint8 numGroups = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		numGroups = node->GetNumGroups();
+	}
+
+	return numGroups;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetAssociations>
+// Gets the associations for a group
+//-----------------------------------------------------------------------------
+uint32 Driver::GetAssociations
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8** o_associations
+)
+{
+	uint32 numAssociations = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		numAssociations = node->GetAssociations( _groupIdx, o_associations );
+	}
+
+	return numAssociations;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetAssociations>
+// Gets the associations for a group
+//-----------------------------------------------------------------------------
+uint32 Driver::GetAssociations
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		InstanceAssociation** o_associations
+)
+{
+	uint32 numAssociations = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		numAssociations = node->GetAssociations( _groupIdx, o_associations );
+	}
+
+	return numAssociations;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::GetMaxAssociations>
+// Gets the maximum number of associations for a group
+//-----------------------------------------------------------------------------
+uint8 Driver::GetMaxAssociations
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx
+)
+{
+	uint8 maxAssociations = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		maxAssociations = node->GetMaxAssociations( _groupIdx );
 	}
+
+	return maxAssociations;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::UpdateControllerState>
-// Stop the current controller function
+// <Driver::GetGroupLabel>
+// Gets the label for a particular group
 //-----------------------------------------------------------------------------
-void Driver::UpdateControllerState( ControllerState const _state, ControllerError const _error )
+string Driver::GetGroupLabel
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx
+)
 {
-	if( m_currentControllerCommand != NULL )
+	string label = "";
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		if( _state != m_currentControllerCommand->m_controllerState )
-		{
-			m_currentControllerCommand->m_controllerStateChanged = true;
-			m_currentControllerCommand->m_controllerState = _state;
-			switch( _state )
-			{
-				case ControllerState_Error:
-				case ControllerState_Cancel:
-				case ControllerState_Failed:
-				case ControllerState_Sleeping:
-				case ControllerState_NodeFailed:
-				case ControllerState_NodeOK:
-				case ControllerState_Completed:
-				{
-					m_currentControllerCommand->m_controllerCommandDone = true;
-					m_sendMutex->Lock();
-					m_queueEvent[MsgQueue_Controller]->Set();
-					m_sendMutex->Unlock();
-					break;
-				}
-				default:
-				{
-					break;
-				}
-			}
+		label = node->GetGroupLabel( _groupIdx );
+	}
 
-		}
-		Notification* notification = new Notification( Notification::Type_ControllerCommand );
-		notification->SetHomeAndNodeIds(m_homeId, 0);
-		notification->SetEvent(_state);
+	return label;
+}
 
-		if( _error != ControllerError_None )
-		{
-			m_currentControllerCommand->m_controllerReturnError = _error;
-			/* Create a new Notification Callback */
-			notification->SetNotification(_error);
-		}
-		QueueNotification( notification );
+//-----------------------------------------------------------------------------
+// <Driver::AddAssociation>
+// Adds a node to an association group
+//-----------------------------------------------------------------------------
+void Driver::AddAssociation
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8 const _targetNodeId,
+		uint8 const _instance
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		node->AddAssociation( _groupIdx, _targetNodeId, _instance );
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::RemoveAssociation>
+// Removes a node from an association group
+//-----------------------------------------------------------------------------
+void Driver::RemoveAssociation
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8 const _targetNodeId,
+		uint8 const _instance
+)
+{
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		node->RemoveAssociation( _groupIdx, _targetNodeId, _instance );
+	}
+}
 
+//-----------------------------------------------------------------------------
+// <Driver::GetAssociations>
+// Gets the members of an association group
+//-----------------------------------------------------------------------------
+uint32 Driver::GetAssociations
+(
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		NodeSet* o_members
+)
+{
+	uint32 numAssociations = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
+	{
+		numAssociations = node->GetAssociations( _groupIdx, o_members );
+	}
+	else
+	{
+		o_members->Clear();
+	}
 
+	return numAssociations;
+}
 
 //-----------------------------------------------------------------------------
-// <Driver::CancelControllerCommand>
-// Stop the current controller function
+// <Driver::SetAssociations>
+// Changes the members of an association group
 //-----------------------------------------------------------------------------
-bool Driver::CancelControllerCommand
+uint32 Driver::SetAssociations
 (
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		NodeSet const& _members
 )
 {
-	if( m_currentControllerCommand == NULL )
+	uint32 changes = 0;
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		// Controller is not doing anything
-		return false;
+		changes = node->SetAssociations( _groupIdx, _members );
 	}
 
-	switch( m_currentControllerCommand->m_controllerCommand )
+	return changes;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::QueueNotification>
+// Add a notification to the queue to be sent at a later, safe time.
+//-----------------------------------------------------------------------------
+void Driver::QueueNotification
+(
+		Notification* _notification
+)
+{
+	// The application hears about the network from its primary controller
+	if( IsStandby() )
 	{
-		case ControllerCommand_AddDevice:
-		{
-			Log::Write( LogLevel_Info, 0, "Cancel Add Node" );
-			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no new node to initialize
-			AddNodeStop( FUNC_ID_ZW_ADD_NODE_TO_NETWORK );
-			break;
-		}
-		case ControllerCommand_CreateNewPrimary:
+		delete _notification;
+		return;
+	}
+
+	// Anything that is reported about a node, other than events and values
+	// that have been read again unchanged, alters what WriteConfig saves
+	switch( _notification->GetType() )
+	{
+		case Notification::Type_ValueRefreshed:
+		case Notification::Type_NodeEvent:
+		case Notification::Type_SceneEvent:
+		case Notification::Type_Notification:
+		case Notification::Type_ControllerCommand:
+		case Notification::Type_ButtonOn:
+		case Notification::Type_ButtonOff:
+		case Notification::Type_ConfigSaved:
+		case Notification::Type_ConfigProvisioning:
+		case Notification::Type_NetworkHealthScan:
+		case Notification::Type_RefreshRoundComplete:
+		case Notification::Type_NodeQueryStage:
+		case Notification::Type_FirmwareUpdate:
+		case Notification::Type_ControllerNvm:
 		{
-			Log::Write( LogLevel_Info, 0, "Cancel Create New Primary" );
-			Msg* msg = new Msg( "CreateNewPrimary Stop", 0xff, REQUEST, FUNC_ID_ZW_CREATE_NEW_PRIMARY, true );
-			msg->Append( CREATE_PRIMARY_STOP );
-			SendMsg( msg, MsgQueue_Command );
 			break;
 		}
-		case ControllerCommand_ReceiveConfiguration:
+		default:
 		{
-			Log::Write( LogLevel_Info, 0, "Cancel Receive Configuration" );
-			Msg* msg = new Msg( "ReceiveConfiguration Stop", 0xff, REQUEST, FUNC_ID_ZW_SET_LEARN_MODE, false, false );
-			msg->Append( 0 );
-			SendMsg( msg, MsgQueue_Command );
+			SetConfigDirty( _notification->GetNodeId() );
 			break;
 		}
-		case ControllerCommand_RemoveDevice:
+	}
+
+	// The value exists now, so while no value has been removed it need not be looked up again
+	_notification->m_generation = ValueStore::GetGeneration();
+
+	LockGuard LG(m_notificationsMutex);
+	if( m_changeJournal )
+	{
+		// Every change is numbered, even those the watchers only see merged with others
+		m_changeJournal->Record( *_notification );
+	}
+	if( m_valueLog && _notification->GetType() == Notification::Type_ValueChanged )
+	{
+		// Logged from NotifyWatchers, once the new value has been stored
+		m_valueLogPending.insert( _notification->GetValueID() );
+	}
+	if( CoalesceNotification( _notification ) )
+	{
+		return;
+	}
+	if( m_bulkValueAdded && MergeValueAdded( _notification ) )
+	{
+		return;
+	}
+	m_notifications.push_back( _notification );
+	m_notificationsEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::MergeValueAdded>
+// Add a new value to the Type_ValuesAdded notification at the end of the
+// queue, if it is for the same node, command class and genre.  Otherwise the
+// ValueAdded becomes a Type_ValuesAdded that later values can join.  Only the
+// last notification is looked at, so the order the watchers see things
+// happen in is kept.  Called with the notifications mutex held.
+//-----------------------------------------------------------------------------
+bool Driver::MergeValueAdded
+(
+		Notification* _notification
+)
+{
+	if( _notification->GetType() != Notification::Type_ValueAdded )
+	{
+		return false;
+	}
+
+	ValueID const& id = _notification->GetValueID();
+	if( !m_notifications.empty() )
+	{
+		Notification* last = m_notifications.back();
+		if( last->GetType() == Notification::Type_ValuesAdded )
 		{
-			Log::Write( LogLevel_Info, 0, "Cancel Remove Device" );
-			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no node to remove
-			AddNodeStop( FUNC_ID_ZW_REMOVE_NODE_FROM_NETWORK );
-			break;
+			ValueID const& lastId = last->GetValueID();
+			if( lastId.GetHomeId() == id.GetHomeId()
+				&& lastId.GetNodeId() == id.GetNodeId()
+				&& lastId.GetCommandClassId() == id.GetCommandClassId()
+				&& lastId.GetGenre() == id.GetGenre() )
+			{
+				last->AddValueId( id );
+				delete _notification;
+				return true;
+			}
 		}
-		case ControllerCommand_TransferPrimaryRole:
+	}
+
+	_notification->m_type = Notification::Type_ValuesAdded;
+	_notification->AddValueId( id );
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::CoalesceNotification>
+// Merge a value notification into one that is already waiting, or hold it
+// back until its value's interval has passed.  Called with the
+// notifications mutex held.
+//-----------------------------------------------------------------------------
+bool Driver::CoalesceNotification
+(
+		Notification* _notification
+)
+{
+	Notification::NotificationType type = _notification->GetType();
+	if( type != Notification::Type_ValueChanged && type != Notification::Type_ValueRefreshed )
+	{
+		return false;
+	}
+
+	ValueID const& id = _notification->GetValueID();
+	map<ValueID,CoalescedValue>::iterator it = m_coalescedValues.find( id );
+	if( it == m_coalescedValues.end() )
+	{
+		uint32 interval = GetNotificationInterval( id );
+		if( interval == 0 )
 		{
-			Log::Write( LogLevel_Info, 0, "Cancel Transfer Primary Role" );
-			Msg* msg = new Msg( "Transfer Primary Role Stop", 0xff, REQUEST, FUNC_ID_ZW_CONTROLLER_CHANGE, true );
-			msg->Append( CONTROLLER_CHANGE_STOP );
-			SendMsg( msg, MsgQueue_Command );
-			break;
+			return false;
 		}
-		case ControllerCommand_ReplicationSend:
+
+		// The first notification for a value goes straight out
+		CoalescedValue value;
+		value.m_pending = _notification;
+		value.m_held = false;
+		value.m_delivered = 0;
+		value.m_interval = interval;
+		m_coalescedValues.insert( map<ValueID,CoalescedValue>::value_type( id, value ) );
+		return false;
+	}
+
+	CoalescedValue& value = it->second;
+	if( value.m_pending != NULL )
+	{
+		// The watchers can only read the latest value, so one notification
+		// covers them all.  A change must not be reported as a refresh.
+		if( type == Notification::Type_ValueChanged )
 		{
-			Log::Write( LogLevel_Info, 0, "Cancel Replication Send" );
-			m_currentControllerCommand->m_controllerCommandNode = 0xff;		// identify the fact that there is no new node to initialize
-			AddNodeStop( FUNC_ID_ZW_ADD_NODE_TO_NETWORK );
-			break;
+			value.m_pending->m_type = Notification::Type_ValueChanged;
+			value.m_pending->m_byte = _notification->m_byte;
 		}
-		case ControllerCommand_CreateButton:
-		case ControllerCommand_DeleteButton:
+		delete _notification;
+		return true;
+	}
+
+	value.m_pending = _notification;
+	uint32 now = (uint32)-m_startTime.TimeRemaining();
+	if( now - value.m_delivered >= value.m_interval )
+	{
+		return false;
+	}
+
+	// Too soon after the last one.  Wake the driver thread so that it
+	// waits for this one to come due.
+	value.m_held = true;
+	++m_heldNotifications;
+	m_notificationsEvent->Set();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::ReleaseHeldNotifications>
+// Queue any held value notifications whose interval has passed
+//-----------------------------------------------------------------------------
+int32 Driver::ReleaseHeldNotifications
+(
+)
+{
+	LockGuard LG(m_notificationsMutex);
+	if( m_heldNotifications == 0 )
+	{
+		return -1;
+	}
+
+	int32 next = -1;
+	uint32 now = (uint32)-m_startTime.TimeRemaining();
+	for( map<ValueID,CoalescedValue>::iterator it = m_coalescedValues.begin(); it != m_coalescedValues.end(); ++it )
+	{
+		CoalescedValue& value = it->second;
+		if( !value.m_held )
 		{
-			if( m_currentControllerCommand->m_controllerCommandNode != 0 )
-			{
-				SendSlaveLearnModeOff();
-			}
-			break;
+			continue;
 		}
-		case ControllerCommand_None:
-		case ControllerCommand_RequestNetworkUpdate:
-		case ControllerCommand_RequestNodeNeighborUpdate:
-		case ControllerCommand_AssignReturnRoute:
-		case ControllerCommand_DeleteAllReturnRoutes:
-		case ControllerCommand_RemoveFailedNode:
-		case ControllerCommand_HasNodeFailed:
-		case ControllerCommand_ReplaceFailedNode:
-		case ControllerCommand_SendNodeInformation:
+
+		uint32 elapsed = now - value.m_delivered;
+		if( elapsed >= value.m_interval )
 		{
-			// Cannot cancel
-			return false;
+			m_notifications.push_back( value.m_pending );
+			m_notificationsEvent->Set();
+			value.m_held = false;
+			--m_heldNotifications;
+		}
+		else if( next < 0 || (int32)( value.m_interval - elapsed ) < next )
+		{
+			next = (int32)( value.m_interval - elapsed );
 		}
 	}
-
-	UpdateControllerState( ControllerState_Cancel );
-	return true;
+	return next;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::AddNodeStop>
-// Stop the Add Node mode based on API of controller
+// <Driver::SetNotificationInterval>
+// Set the shortest time between notifications for a value
 //-----------------------------------------------------------------------------
-void Driver::AddNodeStop
+void Driver::SetNotificationInterval
 (
-		uint8 const _funcId
+		ValueID const& _id,
+		uint32 const _interval
 )
 {
-	if( m_currentControllerCommand == NULL )
-	{
-		// Controller is not doing anything
-		return;
-	}
+	LockGuard LG(m_notificationsMutex);
+	m_notificationIntervals[_id] = _interval;
 
-	if( m_serialAPIVersion[0] == 2 && m_serialAPIVersion[1] == 76 )
-	{
-		Msg* msg = new Msg( "Add Node Stop", 0xff, REQUEST, _funcId, false, false );
-		msg->Append( ADD_NODE_STOP );
-		SendMsg( msg, Driver::MsgQueue_Command );
-	}
-	else
+	map<ValueID,CoalescedValue>::iterator it = m_coalescedValues.find( _id );
+	if( it != m_coalescedValues.end() )
 	{
-		Msg* msg = new Msg( "Add Node Stop", 0xff, REQUEST, _funcId, false, true );
-		msg->Append( ADD_NODE_STOP );
-		SendMsg( msg, Driver::MsgQueue_Command );
+		// Takes effect from the next notification.  Anything held back is
+		// released at the top of the driver thread's loop, if now due.
+		it->second.m_interval = _interval;
+		m_notificationsEvent->Set();
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::TestNetwork>
-// Run a series of messages to a single node or every node on the network.
+// <Driver::GetNotificationInterval>
+// Get the shortest time between notifications for a value
 //-----------------------------------------------------------------------------
-void Driver::TestNetwork
+uint32 Driver::GetNotificationInterval
 (
-		uint8 const _nodeId,
-		uint32 const _count
+		ValueID const& _id
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( _nodeId == 0 )	// send _count messages to every node
+	LockGuard LG(m_notificationsMutex);
+	map<ValueID,uint32>::iterator it = m_notificationIntervals.find( _id );
+	return( ( it != m_notificationIntervals.end() ) ? it->second : m_notificationInterval );
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::NotifyWatchers>
+// Notify any watching objects of a value change
+//-----------------------------------------------------------------------------
+void Driver::NotifyWatchers
+(
+)
+{
+	FlushValueLog();
+
+	// Take everything that is waiting in one go, so that the notifications
+	// raised while handling a frame (such as each of the reports carried
+	// in a Multi Command encapsulation) reach the watchers as one batch.
+	list<Notification*> pending;
 	{
-		for( int i=0; i<256; ++i )
+		LockGuard LG(m_notificationsMutex);
+		pending.swap( m_notifications );
+		m_notificationsEvent->Reset();
+
+		// Once a coalesced value's notification is on its way, the next one
+		// starts a new slot, and its interval runs from now.
+		if( m_coalescedValues.size() )
 		{
-			if( i == m_Controller_nodeId ) // ignore sending to ourself
-			{
-				continue;
-			}
-			if( m_nodes[i] != NULL )
+			uint32 now = (uint32)-m_startTime.TimeRemaining();
+			for( list<Notification*>::iterator it = pending.begin(); it != pending.end(); ++it )
 			{
-				NoOperation *noop = static_cast<NoOperation*>( m_nodes[i]->GetCommandClass( NoOperation::StaticGetCommandClassId() ) );
-				for( int j=0; j < (int)_count; j++ )
+				Notification::NotificationType type = (*it)->GetType();
+				if( type == Notification::Type_ValueChanged || type == Notification::Type_ValueRefreshed )
 				{
-					noop->Set( true );
+					map<ValueID,CoalescedValue>::iterator cit = m_coalescedValues.find( (*it)->GetValueID() );
+					if( cit != m_coalescedValues.end() && cit->second.m_pending == *it )
+					{
+						cit->second.m_pending = NULL;
+						cit->second.m_delivered = now;
+					}
 				}
 			}
 		}
 	}
-	else if( _nodeId != m_Controller_nodeId && m_nodes[_nodeId] != NULL )
+
+	vector<Notification const*> batch;
+	uint32 dispatched = 0;
+	for( list<Notification*>::iterator it = pending.begin(); it != pending.end(); ++it )
 	{
-		NoOperation *noop = static_cast<NoOperation*>( m_nodes[_nodeId]->GetCommandClass( NoOperation::StaticGetCommandClassId() ) );
-		for( int i=0; i < (int)_count; i++ )
+		Notification* notification = *it;
+
+		/* check the any ValueID's sent as part of the Notification are still valid */
+		switch (notification->GetType()) {
+			case Notification::Type_ValueChanged:
+			case Notification::Type_ValueRefreshed: {
+				if( notification->m_generation == ValueStore::GetGeneration() )
+				{
+					// No value has been removed since it was queued
+					break;
+				}
+				Value *val = GetValue(notification->GetValueID());
+				if (!val) {
+					Log::Write(LogLevel_Info, notification->GetNodeId(), "Dropping Notification as ValueID does not exist");
+					delete notification;
+					continue;
+				}
+				val->Release();
+				break;
+			}
+			default:
+				break;
+		}
+
+		OZW_LOG( LogLevel_Detail, notification->GetNodeId(), "Notification: %s", notification->GetAsString().c_str() );
+
+		if( m_notificationDispatcher )
 		{
-			noop->Set( true );
+			// The dispatch thread delivers and deletes it.  It is only woken
+			// once the whole lot has been queued.
+			m_notificationDispatcher->Push( notification, false );
+			++dispatched;
+		}
+		else
+		{
+			batch.push_back( notification );
 		}
 	}
-}
-
-//-----------------------------------------------------------------------------
-//	SwitchAll
-//-----------------------------------------------------------------------------
 
-//-----------------------------------------------------------------------------
-// <Driver::SwitchAllOn>
-// All devices that support the SwitchAll command class will be turned on
-//-----------------------------------------------------------------------------
-void Driver::SwitchAllOn
-(
-)
-{
-	SwitchAll::On( this, 0xff );
+	if( dispatched )
+	{
+		m_notificationDispatcher->Signal();
+	}
 
-	LockGuard LG(m_nodeMutex);
-	for( int i=0; i<256; ++i )
+	if( !batch.empty() )
 	{
-		if( GetNodeUnsafe( i ) )
+		TimeStamp start;
+		Manager::Get()->NotifyWatchers( &batch[0], (uint32)batch.size() );
+		m_handlerTime.Record( -start.TimeRemaining() );
+		for( vector<Notification const*>::iterator it = batch.begin(); it != batch.end(); ++it )
 		{
-			if( m_nodes[i]->GetCommandClass( SwitchAll::StaticGetCommandClassId() ) )
-			{
-				SwitchAll::On( this, (uint8)i );
-			}
+			delete *it;
 		}
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SwitchAllOff>
-// All devices that support the SwitchAll command class will be turned off
+// <Driver::HandleRfPowerLevelSetResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-void Driver::SwitchAllOff
+bool Driver::HandleRfPowerLevelSetResponse
 (
+		uint8* _data
 )
 {
-	SwitchAll::Off( this, 0xff );
+	bool res = true;
+	// the meaning of this command is currently unclear, and there
+	// isn't any returned response data, so just log the function call
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_R_F_POWER_LEVEL_SET" );
 
-	LockGuard LG(m_nodeMutex);
-	for( int i=0; i<256; ++i )
-	{
-		if( GetNodeUnsafe( i ) )
-		{
-			if( m_nodes[i]->GetCommandClass( SwitchAll::StaticGetCommandClassId() ) )
-			{
-				SwitchAll::Off( this, (uint8)i );
-			}
-		}
-	}
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SetConfigParam>
-// Set the value of one of the configuration parameters of a device
+// <Driver::HandleSerialApiSetTimeoutsResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-bool Driver::SetConfigParam
+bool Driver::HandleSerialApiSetTimeoutsResponse
 (
-		uint8 const _nodeId,
-		uint8 const _param,
-		int32 _value,
-		uint8 _size
+		uint8* _data
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		return node->SetConfigParam( _param, _value, _size );
-	}
-
-	return false;
+	// the meaning of this command and its response is currently unclear
+	bool res = true;
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_SERIAL_API_SET_TIMEOUTS" );
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RequestConfigParam>
-// Request the value of one of the configuration parameters of a device
+// <Driver::HandleMemoryGetByteResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-void Driver::RequestConfigParam
+bool Driver::HandleMemoryGetByteResponse
 (
-		uint8 const _nodeId,
-		uint8 const _param
+		uint8* _data
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		node->RequestConfigParam( _param );
-	}
+	bool res = true;
+	// the meaning of this command and its response is currently unclear
+	// it seems to return three bytes of data, so print them out
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_MEMORY_GET_BYTE, returned data: 0x%02hx 0x%02hx 0x%02hx", _data[0], _data[1], _data[2] );
+
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNumGroups>
-// Gets the number of association groups reported by this node
+// <Driver::HandleReadMemoryResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-uint8 Driver::GetNumGroups
+bool Driver::HandleReadMemoryResponse
 (
-		uint8 const _nodeId
+		uint8* _data
 )
 {
-	uint8 numGroups = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		numGroups = node->GetNumGroups();
-	}
-
-	return numGroups;
+	// the meaning of this command and its response is currently unclear
+	bool res = true;
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_MEMORY_GET_BYTE" );
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetAssociations>
-// Gets the associations for a group
+// <Driver::HandleGetVirtualNodesResponse>
+// Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-uint32 Driver::GetAssociations
+void Driver::HandleGetVirtualNodesResponse
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8** o_associations
+		uint8* _data
 )
 {
-	uint32 numAssociations = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_GET_VIRTUAL_NODES" );
+	memcpy( m_virtualNeighbors, &_data[2], 29 );
+	m_virtualNeighborsReceived = true;
+	bool bNeighbors = false;
+	for( int by=0; by<29; by++ )
 	{
-		numAssociations = node->GetAssociations( _groupIdx, o_associations );
+		for( int bi=0; bi<8; bi++ )
+		{
+			if( (_data[2+by] & (0x01<<bi)) )
+			{
+				Log::Write( LogLevel_Info, nodeId, "    Node %d", (by<<3)+bi+1 );
+				bNeighbors = true;
+			}
+		}
 	}
-
-	return numAssociations;
+	if( !bNeighbors )
+		Log::Write( LogLevel_Info, nodeId, "    (none reported)" );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetAssociations>
-// Gets the associations for a group
+// <Driver::GetVirtualNeighbors>
+// Gets the virtual neighbors for a network
 //-----------------------------------------------------------------------------
-uint32 Driver::GetAssociations
+uint32 Driver::GetVirtualNeighbors
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		InstanceAssociation** o_associations
+		uint8** o_neighbors
 )
 {
-	uint32 numAssociations = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	int i;
+	uint32 numNeighbors = 0;
+	if( !m_virtualNeighborsReceived )
 	{
-		numAssociations = node->GetAssociations( _groupIdx, o_associations );
+		*o_neighbors = NULL;
+		return 0;
+	}
+	for( i = 0; i < 29; i++ )
+	{
+		for( unsigned char mask = 0x80; mask != 0; mask >>= 1 )
+			if( m_virtualNeighbors[i] & mask )
+				numNeighbors++;
 	}
 
-	return numAssociations;
+	// handle the possibility that no neighbors are reported
+	if( !numNeighbors )
+	{
+		*o_neighbors = NULL;
+		return 0;
+	}
+
+	// create and populate an array with neighbor node ids
+	uint8* neighbors = new uint8[numNeighbors];
+	uint32 index = 0;
+	for( int by=0; by<29; by++ )
+	{
+		for( int bi=0; bi<8; bi++ )
+		{
+			if( (m_virtualNeighbors[by] & (0x01<<bi)) )
+				neighbors[index++] = ( (by<<3) + bi + 1 );
+		}
+	}
+
+	*o_neighbors = neighbors;
+	return numNeighbors;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetMaxAssociations>
-// Gets the maximum number of associations for a group
+// <Driver::RequestVirtualNeighbors>
+// Get the virtual neighbour information from the controller
 //-----------------------------------------------------------------------------
-uint8 Driver::GetMaxAssociations
+void Driver::RequestVirtualNeighbors
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx
+		MsgQueue const _queue
 )
 {
-	uint8 maxAssociations = 0;
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		maxAssociations = node->GetMaxAssociations( _groupIdx );
-	}
-
-	return maxAssociations;
+	Msg* msg = new Msg( "Get Virtual Neighbor List", 0xff, REQUEST, FUNC_ID_ZW_GET_VIRTUAL_NODES, false );
+	SendMsg( msg, _queue );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetGroupLabel>
-// Gets the label for a particular group
+// <Driver::SendVirtualNodeInfo>
+// Send node info frame on behalf of a virtual node.
 //-----------------------------------------------------------------------------
-string Driver::GetGroupLabel
+void Driver::SendVirtualNodeInfo
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx
+		uint8 const _FromNodeId,
+		uint8 const _ToNodeId
 )
 {
-	string label = "";
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		label = node->GetGroupLabel( _groupIdx );
-	}
+	char str[80];
 
-	return label;
+	snprintf( str, sizeof(str), "Send Virtual Node Info from %d to %d", _FromNodeId, _ToNodeId );
+	Msg* msg = new Msg( "Send Virtual Node Info", 0xff, REQUEST, FUNC_ID_ZW_SEND_SLAVE_NODE_INFO, true );
+	msg->SetLogText( str );
+	msg->Append( _FromNodeId );		// from the virtual node
+	msg->Append( _ToNodeId );		// to the handheld controller
+	msg->Append( TRANSMIT_OPTION_ACK );
+	SendMsg( msg, MsgQueue_Command );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::AddAssociation>
-// Adds a node to an association group
+// <Driver::SendSlaveLearnModeOff>
+// Disable Slave Learn Mode.
 //-----------------------------------------------------------------------------
-void Driver::AddAssociation
+void Driver::SendSlaveLearnModeOff
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8 const _targetNodeId,
-		uint8 const _instance
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
+	if( !( IsPrimaryController() || IsInclusionController() ) )
 	{
-		node->AddAssociation( _groupIdx, _targetNodeId, _instance );
+		Msg* msg = new Msg( "Set Slave Learn Mode Off ", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
+		msg->Append( 0 );	// filler node id
+		msg->Append( SLAVE_LEARN_MODE_DISABLE );
+		SendMsg( msg, MsgQueue_Command  );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RemoveAssociation>
-// Removes a node from an association group
+// <Driver::SaveButtons>
+// Save the buttons, which are kept with their nodes in the network configuration
 //-----------------------------------------------------------------------------
-void Driver::RemoveAssociation
+void Driver::SaveButtons
 (
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8 const _targetNodeId,
-		uint8 const _instance
 )
 {
-	LockGuard LG(m_nodeMutex);
-	if( Node* node = GetNode( _nodeId ) )
-	{
-		node->RemoveAssociation( _groupIdx, _targetNodeId, _instance );
-	}
+	WriteConfig();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::QueueNotification>
-// Add a notification to the queue to be sent at a later, safe time.
+// <Driver::ReadButtons>
+// Read the buttons of a node that has none saved with its configuration from
+// zwbutton.xml, where older versions kept them.  The file is parsed once, and
+// the buttons are saved with the node from then on.
 //-----------------------------------------------------------------------------
-void Driver::QueueNotification
+void Driver::ReadButtons
 (
-		Notification* _notification
+		uint8 const _nodeId
 )
 {
-	m_notifications.push_back( _notification );
-	m_notificationsEvent->Set();
+	if( !m_legacyButtonsRead )
+	{
+		m_legacyButtonsRead = true;
+		ReadLegacyButtons();
+	}
+
+	map<uint8, map<uint8,uint8> >::iterator nit = m_legacyButtons.find( _nodeId );
+	Node* node = GetNodeUnsafe( _nodeId );
+	if( nit == m_legacyButtons.end() || node == NULL )
+	{
+		return;
+	}
+
+	for( map<uint8,uint8>::iterator it = nit->second.begin(); it != nit->second.end(); ++it )
+	{
+		node->SetButton( it->first, it->second );
+		Notification* notification = new Notification( Notification::Type_CreateButton );
+		notification->SetHomeAndNodeIds( m_homeId, it->second );
+		notification->SetButtonId( it->first );
+		QueueNotification( notification );
+	}
+	m_legacyButtons.erase( nit );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::NotifyWatchers>
-// Notify any watching objects of a value change
+// <Driver::ReadLegacyButtons>
+// Read the button info of every node from zwbutton.xml
 //-----------------------------------------------------------------------------
-void Driver::NotifyWatchers
+void Driver::ReadLegacyButtons
 (
 )
 {
-	list<Notification*>::iterator nit = m_notifications.begin();
-	while( nit != m_notifications.end() )
+	int32 intVal;
+	int32 nodeId;
+	int32 buttonId;
+	char const* str;
+
+	// Load the XML document that contains the driver configuration
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+
+	string filename =  userPath + "zwbutton.xml";
+
+	TiXmlDocument doc;
+	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
 	{
-		Notification* notification = m_notifications.front();
-		m_notifications.pop_front();
+		Log::Write( LogLevel_Debug, "Driver::ReadButtons - zwbutton.xml file not found.");
+		return;
+	}
 
-		/* check the any ValueID's sent as part of the Notification are still valid */
-		switch (notification->GetType()) {
-			case Notification::Type_ValueChanged:
-			case Notification::Type_ValueRefreshed: {
-				Value *val = GetValue(notification->GetValueID());
-				if (!val) {
-					Log::Write(LogLevel_Info, notification->GetNodeId(), "Dropping Notification as ValueID does not exist");
-					nit = m_notifications.begin();
-					delete notification;
-					val->Release();
-					continue;
+	TiXmlElement const* nodesElement = doc.RootElement();
+	str = nodesElement->Value();
+	if( str && strcmp( str, "Nodes" ))
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - zwbutton.xml is malformed");
+		return;
+	}
+
+	// Version
+	if( TIXML_SUCCESS == nodesElement->QueryIntAttribute( "version", &intVal ) )
+	{
+		if( (uint32)intVal != 1 )
+		{
+			Log::Write( LogLevel_Info, "Driver::ReadButtons - %s is from an older version of OpenZWave and cannot be loaded.", "zwbutton.xml" );
+			return;
+		}
+	}
+	else
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - zwbutton.xml is from an older version of OpenZWave and cannot be loaded." );
+		return;
+	}
+
+	TiXmlElement const* nodeElement = nodesElement->FirstChildElement();
+	while( nodeElement )
+	{
+		str = nodeElement->Value();
+		if( str && !strcmp( str, "Node" ) && TIXML_SUCCESS == nodeElement->QueryIntAttribute( "id", &intVal ) && intVal > 0 && intVal < 256 )
+		{
+			TiXmlElement const* buttonElement = nodeElement->FirstChildElement();
+			while( buttonElement )
+			{
+				str = buttonElement->Value();
+				if( str && !strcmp( str, "Button"))
+				{
+					if (TIXML_SUCCESS != buttonElement->QueryIntAttribute( "id", &buttonId ) )
+					{
+						Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - cannot find Button Id for node %d", intVal );
+						break;
+					}
+					str = buttonElement->GetText();
+					if( str )
+					{
+						char *p;
+						nodeId = (int32)strtol( str, &p, 0 );
+					}
+					else
+					{
+						Log::Write( LogLevel_Info, "Driver::ReadButtons - missing virtual node value for node %d button id %d", intVal, buttonId );
+						break;
+					}
+					m_legacyButtons[(uint8)intVal][(uint8)buttonId] = (uint8)nodeId;
 				}
-				break;
+				buttonElement = buttonElement->NextSiblingElement();
 			}
-			default:
-				break;
 		}
-
-		Log::Write(LogLevel_Detail, notification->GetNodeId(), "Notification: %s", notification->GetAsString().c_str());
-
-		Manager::Get()->NotifyWatchers( notification );
-
-		delete notification;
-		nit = m_notifications.begin();
+		nodeElement = nodeElement->NextSiblingElement();
 	}
-	m_notificationsEvent->Reset();
 }
-
 //-----------------------------------------------------------------------------
-// <Driver::HandleRfPowerLevelSetResponse>
+// <Driver::HandleSetSlaveLearnModeResponse>
 // Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-bool Driver::HandleRfPowerLevelSetResponse
+bool Driver::HandleSetSlaveLearnModeResponse
 (
 		uint8* _data
 )
 {
 	bool res = true;
-	// the meaning of this command is currently unclear, and there
-	// isn't any returned response data, so just log the function call
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_R_F_POWER_LEVEL_SET" );
+	ControllerState state = ControllerState_InProgress;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SET_SLAVE_LEARN_MODE - command in progress" );
+	}
+	else
+	{
+		// Failed
+		Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_SET_SLAVE_LEARN_MODE - command failed" );
+		state = ControllerState_Failed;
+		res = false;
+		SendSlaveLearnModeOff();
+	}
 
+	UpdateControllerState( state );
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSerialApiSetTimeoutsResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::HandleSetSlaveLearnModeRequest>
+// Process a request from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-bool Driver::HandleSerialApiSetTimeoutsResponse
+void Driver::HandleSetSlaveLearnModeRequest
 (
 		uint8* _data
 )
 {
-	// the meaning of this command and its response is currently unclear
-	bool res = true;
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_SERIAL_API_SET_TIMEOUTS" );
-	return res;
+	ControllerState state = ControllerState_Waiting;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+
+	SendSlaveLearnModeOff();
+	switch( _data[3] )
+	{
+		case SLAVE_ASSIGN_COMPLETE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_COMPLETE" );
+			if( _data[4] == 0 ) // original node is 0 so adding
+			{
+				Log::Write( LogLevel_Info, nodeId, "Adding virtual node ID %d", _data[5] );
+				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+				if( node != NULL )
+				{
+					{
+						WriteLockGuard LG( m_nodeMutex );
+						node->SetButton( m_currentControllerCommand->m_controllerCommandArg, _data[5] );
+					}
+					SendVirtualNodeInfo( _data[5], m_currentControllerCommand->m_controllerCommandNode );
+				}
+			}
+			else
+				if( _data[5] == 0 )
+				{
+					Log::Write( LogLevel_Info, nodeId, "Removing virtual node ID %d", _data[4] );
+				}
+			break;
+		}
+		case SLAVE_ASSIGN_NODEID_DONE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_NODEID_DONE" );
+			if( _data[4] == 0 ) // original node is 0 so adding
+			{
+				Log::Write( LogLevel_Info, nodeId, "Adding virtual node ID %d", _data[5] );
+				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+				if( node != NULL )
+				{
+					{
+						WriteLockGuard LG( m_nodeMutex );
+						node->SetButton( m_currentControllerCommand->m_controllerCommandArg, _data[5] );
+					}
+					SendVirtualNodeInfo( _data[5], m_currentControllerCommand->m_controllerCommandNode );
+				}
+			}
+			else
+				if( _data[5] == 0 )
+				{
+					Log::Write( LogLevel_Info, nodeId, "Removing virtual node ID %d", _data[4] );
+				}
+			break;
+		}
+		case SLAVE_ASSIGN_RANGE_INFO_UPDATE:
+		{
+			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_RANGE_INFO_UPDATE" );
+			break;
+		}
+	}
+	m_currentControllerCommand->m_controllerAdded = false;
+
+	UpdateControllerState( state );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleMemoryGetByteResponse>
+// <Driver::HandleSendSlaveNodeInfoResponse>
 // Process a response from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-bool Driver::HandleMemoryGetByteResponse
+bool Driver::HandleSendSlaveNodeInfoResponse
 (
 		uint8* _data
 )
 {
 	bool res = true;
-	// the meaning of this command and its response is currently unclear
-	// it seems to return three bytes of data, so print them out
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_ZW_MEMORY_GET_BYTE, returned data: 0x%02hx 0x%02hx 0x%02hx", _data[0], _data[1], _data[2] );
+	ControllerState state = ControllerState_InProgress;
+	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	if( m_currentControllerCommand == NULL )
+	{
+		return false;
+	}
+	if( _data[2] )
+	{
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_SLAVE_NODE_INFO - command in progress" );
+	}
+	else
+	{
+		// Failed
+		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_SLAVE_NODE_INFO - command failed" );
+		state = ControllerState_Failed;
+		// Undo button map settings
+		Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+		if( node != NULL )
+		{
+			WriteLockGuard LG( m_nodeMutex );
+			node->RemoveButton( m_currentControllerCommand->m_controllerCommandArg );
+		}
+		res = false;
+	}
 
+	UpdateControllerState( state );
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleReadMemoryResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::HandleSendSlaveNodeInfoRequest>
+// Process a request from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-bool Driver::HandleReadMemoryResponse
+void Driver::HandleSendSlaveNodeInfoRequest
 (
 		uint8* _data
 )
 {
-	// the meaning of this command and its response is currently unclear
-	bool res = true;
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "Received reply to FUNC_ID_MEMORY_GET_BYTE" );
-	return res;
+	if( m_currentControllerCommand == NULL )
+	{
+		return;
+	}
+	if( _data[3] == 0 )	// finish up
+	{
+		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "SEND_SLAVE_NODE_INFO_COMPLETE OK" );
+		SaveButtons();
+		Notification* notification = new Notification( Notification::Type_CreateButton );
+		notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
+		notification->SetButtonId( m_currentControllerCommand->m_controllerCommandArg );
+		QueueNotification( notification );
+
+		UpdateControllerState( ControllerState_Completed );
+		RequestVirtualNeighbors( MsgQueue_Send );
+	}
+	else			// error. try again
+	{
+		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "SLAVE_NODE_INFO_COMPLETE" );
+		Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
+		if( node != NULL)
+		{
+			SendVirtualNodeInfo( node->m_buttonMap[m_currentControllerCommand->m_controllerCommandArg], m_currentControllerCommand->m_controllerCommandNode );
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleGetVirtualNodesResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::HandleApplicationSlaveCommandRequest>
+// Process a request from the Z-Wave PC interface
 //-----------------------------------------------------------------------------
-void Driver::HandleGetVirtualNodesResponse
+void Driver::HandleApplicationSlaveCommandRequest
 (
 		uint8* _data
 )
 {
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_GET_VIRTUAL_NODES" );
-	memcpy( m_virtualNeighbors, &_data[2], 29 );
-	m_virtualNeighborsReceived = true;
-	bool bNeighbors = false;
-	for( int by=0; by<29; by++ )
+	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "APPLICATION_SLAVE_COMMAND_HANDLER rxStatus %x dest %d source %d len %d", _data[2], _data[3], _data[4], _data[5] );
+	Node* node = GetNodeUnsafe( _data[4] );
+	uint8 buttonId;
+	if( node != NULL && _data[5] == 3 && _data[6] == 0x20 && _data[7] == 0x01 ) // only support Basic Set for now
 	{
-		for( int bi=0; bi<8; bi++ )
+		if( node->GetVirtualNodeButton( _data[3], &buttonId ) )
 		{
-			if( (_data[2+by] & (0x01<<bi)) )
+			Notification *notification;
+			if( _data[8] == 0 )
 			{
-				Log::Write( LogLevel_Info, nodeId, "    Node %d", (by<<3)+bi+1 );
-				bNeighbors = true;
+				notification = new Notification( Notification::Type_ButtonOff );
+			}
+			else
+			{
+				notification = new Notification( Notification::Type_ButtonOn );
 			}
+			notification->SetHomeAndNodeIds( m_homeId, _data[4] );
+			notification->SetButtonId( buttonId );
+			QueueNotification( notification );
 		}
 	}
-	if( !bNeighbors )
-		Log::Write( LogLevel_Info, nodeId, "    (none reported)" );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetVirtualNeighbors>
-// Gets the virtual neighbors for a network
+// <Driver::NodeFromMessage>
+// See if we can get node from incoming message data
 //-----------------------------------------------------------------------------
-uint32 Driver::GetVirtualNeighbors
+uint8 Driver::NodeFromMessage
 (
-		uint8** o_neighbors
+		uint8 const* buffer
 )
 {
-	int i;
-	uint32 numNeighbors = 0;
-	if( !m_virtualNeighborsReceived )
+	uint8 nodeId = 0;
+
+	if( buffer[1] >= 5 )
 	{
-		*o_neighbors = NULL;
-		return 0;
+		switch( buffer[3] )
+		{
+			case FUNC_ID_APPLICATION_COMMAND_HANDLER:		nodeId = buffer[5];	break;
+			case FUNC_ID_ZW_APPLICATION_UPDATE:			nodeId = buffer[5];	break;
+		}
 	}
-	for( i = 0; i < 29; i++ )
+	return nodeId;
+}
+//-----------------------------------------------------------------------------
+// <Driver::UpdateNodeRoutes>
+// Update a node's routing information
+//-----------------------------------------------------------------------------
+void Driver::UpdateNodeRoutes
+(
+		uint8 const _nodeId,
+		bool _doUpdate		// = false
+)
+{
+	// Only for routing slaves
+	Node* node = GetNodeUnsafe( _nodeId );
+	if( node != NULL && node->GetBasic() == 0x04 )
 	{
-		for( unsigned char mask = 0x80; mask != 0; mask >>= 1 )
-			if( m_virtualNeighbors[i] & mask )
-				numNeighbors++;
-	}
+		uint8 numGroups = GetNumGroups( _nodeId );
+		uint8 numNodes = 0;
+		uint8 nodes[5];
+		InstanceAssociation* associations;
+		uint8 i;
 
-	// handle the possibility that no neighbors are reported
-	if( !numNeighbors )
-	{
-		*o_neighbors = NULL;
-		return 0;
-	}
+		// Determine up to 5 destinations
 
-	// create and populate an array with neighbor node ids
-	uint8* neighbors = new uint8[numNeighbors];
-	uint32 index = 0;
-	for( int by=0; by<29; by++ )
-	{
-		for( int bi=0; bi<8; bi++ )
+		memset( nodes, 0, sizeof(nodes) );
+		for( i = 1; i <= numGroups && numNodes < sizeof(nodes) ; i++ )
 		{
-			if( (m_virtualNeighbors[by] & (0x01<<bi)) )
-				neighbors[index++] = ( (by<<3) + bi + 1 );
+			associations = NULL;
+			uint32 len = GetAssociations( _nodeId, i, &associations );
+			for( uint8 j = 0; j < len; j++ )
+			{
+				uint8 k;
+				/* there is a gcc bug that triggers here: https://gcc.gnu.org/bugzilla/show_bug.cgi?id=59124
+				 * see also https://github.com/OpenZWave/open-zwave/issues/586
+				 */
+				for( k = 0; k < numNodes && k < sizeof(nodes); k++ )
+				{
+					if( nodes[k] == associations[j].m_nodeId )
+					{
+						break;
+					}
+				}
+				if( k >= numNodes && numNodes < sizeof(nodes) )	// not in list so add it
+				{
+					nodes[numNodes++] = associations[j].m_nodeId;
+				}
+			}
+			if( associations != NULL )
+			{
+				delete [] associations;
+			}
+		}
+		if( !_doUpdate && !node->m_routesAssigned && numNodes == 0 )
+		{
+			// Nothing to assign, and nothing known to have been
+			return;
+		}
+
+		// The controller can only delete all of a node's return routes at once, so
+		// they are all assigned again if a destination has gone, or if what the
+		// node was given is not known.  Otherwise only the new destinations are
+		// assigned.
+		bool replace = _doUpdate || !node->m_routesAssigned;
+		for( i = 0; i < node->m_numRouteNodes && !replace; i++ )
+		{
+			replace = ( memchr( nodes, node->m_routeNodes[i], numNodes ) == NULL );
+		}
+
+		// Figure out what to do if one of these fail.
+		uint8 assigned = 0;
+		if( replace )
+		{
+			BeginControllerCommand( ControllerCommand_DeleteAllReturnRoutes, NULL, NULL, true, _nodeId, 0 );
+		}
+		for( i = 0; i < numNodes; i++ )
+		{
+			if( replace || memchr( node->m_routeNodes, nodes[i], node->m_numRouteNodes ) == NULL )
+			{
+				BeginControllerCommand( ControllerCommand_AssignReturnRoute, NULL, NULL, true, _nodeId, nodes[i] );
+				++assigned;
+			}
+		}
+		if( replace || assigned )
+		{
+			Log::Write( LogLevel_Info, _nodeId, replace ? "Replacing the return routes, with %d assigned" : "Adding %d return routes", assigned );
 		}
+		node->m_numRouteNodes = numNodes;
+		memcpy( node->m_routeNodes, nodes, sizeof(nodes) );
+		node->m_routesAssigned = true;
 	}
+}
 
-	*o_neighbors = neighbors;
-	return numNeighbors;
+//-----------------------------------------------------------------------------
+// <Driver::ScheduleNodeRoutes>
+// Update a node's return routes once its associations have stopped changing
+//-----------------------------------------------------------------------------
+void Driver::ScheduleNodeRoutes
+(
+		uint8 const _nodeId
+)
+{
+	// A burst of association changes is dealt with in one pass, once it is over
+	static int32 const c_routeUpdateDelayMs = 2000;
+
+	{
+		LockGuard HLG(m_healthMutex);
+		m_routesPending[_nodeId>>5] |= 1u << ( _nodeId & 0x1f );
+		m_routesDue.SetTime( c_routeUpdateDelayMs );
+	}
+	m_pollEvent->Set();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::RequestVirtualNeighbors>
-// Get the virtual neighbour information from the controller
+// <Driver::RunRouteUpdates>
+// Update the return routes of the nodes whose associations changed, once
+// they have stopped changing
 //-----------------------------------------------------------------------------
-void Driver::RequestVirtualNeighbors
+int32 Driver::RunRouteUpdates
 (
-		MsgQueue const _queue
 )
 {
-	Msg* msg = new Msg( "Get Virtual Neighbor List", 0xff, REQUEST, FUNC_ID_ZW_GET_VIRTUAL_NODES, false );
-	SendMsg( msg, _queue );
+	uint32 pending[8];
+	{
+		LockGuard HLG(m_healthMutex);
+		uint32 any = 0;
+		for( uint32 i = 0; i < 8; ++i )
+		{
+			any |= m_routesPending[i];
+		}
+		if( !any )
+		{
+			return Wait::Timeout_Infinite;
+		}
+
+		int32 remaining = m_routesDue.TimeRemaining();
+		if( remaining > 0 )
+		{
+			return remaining;
+		}
+		memcpy( pending, m_routesPending, sizeof(pending) );
+		memset( m_routesPending, 0, sizeof(m_routesPending) );
+	}
+
+	WriteLockGuard LG(m_nodeMutex);
+	for( uint32 nodeId = 1; nodeId < 256; ++nodeId )
+	{
+		if( pending[nodeId>>5] & ( 1u << ( nodeId & 0x1f ) ) )
+		{
+			UpdateNodeRoutes( (uint8)nodeId );
+		}
+	}
+	return Wait::Timeout_Infinite;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SendVirtualNodeInfo>
-// Send node info frame on behalf of a virtual node.
+// <Driver::SyncTime>
+// Set the clocks of all the nodes that have one, a listening node at a time
 //-----------------------------------------------------------------------------
-void Driver::SendVirtualNodeInfo
+uint32 Driver::SyncTime
 (
-		uint8 const _FromNodeId,
-		uint8 const _ToNodeId
 )
 {
-	char str[80];
+	list<uint8> nodes;
+	{
+		WriteLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+		{
+			Node* node = GetNode( (uint8)*nit );
+			if( ( node != NULL ) && ( *nit != m_Controller_nodeId ) && ( node->GetCommandClass( Clock::StaticGetCommandClassId() ) || node->GetCommandClass( TimeParameters::StaticGetCommandClassId() ) ) )
+			{
+				nodes.push_back( (uint8)*nit );
+			}
+		}
+	}
 
-	snprintf( str, sizeof(str), "Send Virtual Node Info from %d to %d", _FromNodeId, _ToNodeId );
-	Msg* msg = new Msg( str, 0xff, REQUEST, FUNC_ID_ZW_SEND_SLAVE_NODE_INFO, true );
-	msg->Append( _FromNodeId );		// from the virtual node
-	msg->Append( _ToNodeId );		// to the handheld controller
-	msg->Append( TRANSMIT_OPTION_ACK );
-	SendMsg( msg, MsgQueue_Command );
+	LockGuard HLG(m_healthMutex);
+
+	// The host's clock is watched for changes from now on
+	m_timeSyncStarted = true;
+	m_timeSyncTicks = TimeStamp::GetTicksNs();
+	m_timeSyncLocal = GetLocalSeconds( time( NULL ) );
+	m_timeSyncCheck.SetTime( c_timeSyncCheckMs );
+
+	// Nodes still waiting from an earlier call keep their place
+	for( list<uint8>::const_iterator it = nodes.begin(); it != nodes.end(); ++it )
+	{
+		if( find( m_timeSyncQueue.begin(), m_timeSyncQueue.end(), *it ) == m_timeSyncQueue.end() )
+		{
+			m_timeSyncQueue.push_back( *it );
+		}
+	}
+	Log::Write( LogLevel_Info, "Time sync: setting the clocks of %d nodes", (int)nodes.size() );
+	m_pollEvent->Set();
+	return (uint32)nodes.size();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SendSlaveLearnModeOff>
-// Disable Slave Learn Mode.
+// <Driver::SetNodeTime>
+// Set each clock a node has to a time.  Must be called with m_nodeMutex locked.
 //-----------------------------------------------------------------------------
-void Driver::SendSlaveLearnModeOff
+bool Driver::SetNodeTime
 (
+		Node* _node,
+		time_t const _time
 )
 {
-	if( !( IsPrimaryController() || IsInclusionController() ) )
+	bool res = false;
+	uint8 const ccIds[] = { Clock::StaticGetCommandClassId(), TimeParameters::StaticGetCommandClassId() };
+	for( uint32 i = 0; i < sizeof(ccIds); ++i )
 	{
-		Msg* msg = new Msg( "Set Slave Learn Mode Off ", 0xff, REQUEST, FUNC_ID_ZW_SET_SLAVE_LEARN_MODE, true );
-		msg->Append( 0 );	// filler node id
-		msg->Append( SLAVE_LEARN_MODE_DISABLE );
-		SendMsg( msg, MsgQueue_Command  );
+		if( CommandClass* cc = _node->GetCommandClass( ccIds[i] ) )
+		{
+			Bitfield const* instances = cc->GetInstances();
+			for( Bitfield::Iterator it = instances->Begin(); it != instances->End(); ++it )
+			{
+				res |= cc->SetTime( (uint8)*it, _time );
+			}
+		}
 	}
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::SaveButtons>
-// Save button info into file.
+// <Driver::RestageTimeSync>
+// A sleeping node is waking up.  Replace the clock set waiting in its wake up
+// queue, which holds the time it was queued at, with one of the current time.
 //-----------------------------------------------------------------------------
-void Driver::SaveButtons
+void Driver::RestageTimeSync
 (
+		Node* _node
 )
 {
-	char str[16];
-
-	// Create a new XML document to contain the driver configuration
-	TiXmlDocument doc;
-	TiXmlDeclaration* decl = new TiXmlDeclaration( "1.0", "utf-8", "" );
-	TiXmlElement* nodesElement = new TiXmlElement( "Nodes" );
-	doc.LinkEndChild( decl );
-	doc.LinkEndChild( nodesElement );
-
-	nodesElement->SetAttribute( "xmlns", "http://code.google.com/p/open-zwave/" );
-
-	snprintf( str, sizeof(str), "%d", 1 );
-	nodesElement->SetAttribute( "version", str);
-	LockGuard LG(m_nodeMutex);
-	for( int i = 1; i < 256; i++ )
+	uint8 nodeId = _node->GetNodeId();
 	{
-		if( m_nodes[i] == NULL || m_nodes[i]->m_buttonMap.empty() )
+		LockGuard HLG(m_healthMutex);
+		uint32 bit = 1u << ( nodeId & 0x1f );
+		if( !( m_timeSyncStaged[nodeId>>5] & bit ) )
 		{
-			continue;
+			return;
 		}
+		m_timeSyncStaged[nodeId>>5] &= ~bit;
+	}
 
-		TiXmlElement* nodeElement = new TiXmlElement( "Node" );
+	// The node is still marked as asleep, so the new set supersedes the
+	// old one in the wake up queue and goes out with the rest
+	SetNodeTime( _node, time( NULL ) );
+	Log::Write( LogLevel_Detail, nodeId, "Time sync: brought the clock set waiting for the node up to date" );
+}
 
-		snprintf( str, sizeof(str), "%d", i );
-		nodeElement->SetAttribute( "id", str );
+//-----------------------------------------------------------------------------
+// <Driver::CheckHostClock>
+// Set the clocks again if the host's local time has moved by more than
+// TimeSyncMaxDrift since they were last set
+//-----------------------------------------------------------------------------
+void Driver::CheckHostClock
+(
+)
+{
+	int64 drift;
+	{
+		LockGuard HLG(m_healthMutex);
+		m_timeSyncCheck.SetTime( c_timeSyncCheckMs );
 
-		for( map<uint8,uint8>::iterator it = m_nodes[i]->m_buttonMap.begin(); it != m_nodes[i]->m_buttonMap.end(); ++it )
+		// The monotonic clock is not stepped by NTP or daylight saving,
+		// so it says what the local time should be by now
+		int64 expected = m_timeSyncLocal + (int64)( ( TimeStamp::GetTicksNs() - m_timeSyncTicks ) / 1000000000 );
+		drift = GetLocalSeconds( time( NULL ) ) - expected;
+		if( ( drift < m_timeSyncMaxDrift ) && ( -drift < m_timeSyncMaxDrift ) )
 		{
-			TiXmlElement* valueElement = new TiXmlElement( "Button" );
-
-			snprintf( str, sizeof(str), "%d", it->first );
-			valueElement->SetAttribute( "id", str );
-
-			snprintf( str, sizeof(str), "%d", it->second );
-			TiXmlText* textElement = new TiXmlText( str );
-			valueElement->LinkEndChild( textElement );
-
-			nodeElement->LinkEndChild( valueElement );
+			return;
 		}
-
-		nodesElement->LinkEndChild( nodeElement );
 	}
 
-	string userPath;
-	Options::Get()->GetOptionAsString( "UserPath", &userPath );
-
-	string filename =  userPath + "zwbutton.xml";
-
-	doc.SaveFile( filename.c_str() );
+	Log::Write( LogLevel_Info, "Time sync: the local time has moved by %d seconds since the clocks were set", (int)drift );
+	SyncTime();
 }
+
 //-----------------------------------------------------------------------------
-// <Driver::ReadButtons>
-// Read button info per node from file.
+// <Driver::RunTimeSync>
+// Set the clocks of the nodes waiting to be set, spacing out the listening
+// ones, and watch the host's clock for being changed
 //-----------------------------------------------------------------------------
-void Driver::ReadButtons
+int32 Driver::RunTimeSync
 (
-		uint8 const _nodeId
 )
 {
-	int32 intVal;
-	int32 nodeId;
-	int32 buttonId;
-	char const* str;
-
-	// Load the XML document that contains the driver configuration
-	string userPath;
-	Options::Get()->GetOptionAsString( "UserPath", &userPath );
-
-	string filename =  userPath + "zwbutton.xml";
-
-	TiXmlDocument doc;
-	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
-	{
-		Log::Write( LogLevel_Debug, "Driver::ReadButtons - zwbutton.xml file not found.");
-		return;
-	}
-
-	TiXmlElement const* nodesElement = doc.RootElement();
-	str = nodesElement->Value();
-	if( str && strcmp( str, "Nodes" ))
-	{
-		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - zwbutton.xml is malformed");
-		return;
-	}
-
-	// Version
-	if( TIXML_SUCCESS == nodesElement->QueryIntAttribute( "version", &intVal ) )
+	bool check;
 	{
-		if( (uint32)intVal != 1 )
-		{
-			Log::Write( LogLevel_Info, "Driver::ReadButtons - %s is from an older version of OpenZWave and cannot be loaded.", "zwbutton.xml" );
-			return;
-		}
+		LockGuard HLG(m_healthMutex);
+		check = m_timeSyncStarted && ( m_timeSyncCheck.TimeRemaining() <= 0 );
 	}
-	else
+	if( check )
 	{
-		Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - zwbutton.xml is from an older version of OpenZWave and cannot be loaded." );
-		return;
+		CheckHostClock();
 	}
 
-	TiXmlElement const* nodeElement = nodesElement->FirstChildElement();
-	while( nodeElement )
+	int32 timeout = Wait::Timeout_Infinite;
+	while( true )
 	{
-		str = nodeElement->Value();
-		if( str && !strcmp( str, "Node" ))
+		uint8 nodeId;
 		{
-			Node* node = NULL;
-			if( TIXML_SUCCESS == nodeElement->QueryIntAttribute( "id", &intVal ) )
+			LockGuard HLG(m_healthMutex);
+			if( m_timeSyncStarted )
 			{
-				if( _nodeId == intVal )
-				{
-					node = GetNodeUnsafe( intVal );
-				}
+				int32 remaining = m_timeSyncCheck.TimeRemaining();
+				timeout = ( remaining > 0 ) ? remaining : 0;
+			}
+			if( m_timeSyncQueue.empty() )
+			{
+				break;
 			}
-			if( node != NULL )
+			int32 remaining = m_timeSyncNext.TimeRemaining();
+			if( remaining > 0 )
 			{
-				TiXmlElement const* buttonElement = nodeElement->FirstChildElement();
-				while( buttonElement )
+				if( ( timeout == Wait::Timeout_Infinite ) || ( remaining < timeout ) )
 				{
-					str = buttonElement->Value();
-					if( str && !strcmp( str, "Button"))
-					{
-						if (TIXML_SUCCESS != buttonElement->QueryIntAttribute( "id", &buttonId ) )
-						{
-							Log::Write( LogLevel_Warning, "WARNING: Driver::ReadButtons - cannot find Button Id for node %d", _nodeId );
-							return;
-						}
-						str = buttonElement->GetText();
-						if( str )
-						{
-							char *p;
-							nodeId = (int32)strtol( str, &p, 0 );
-						}
-						else
-						{
-							Log::Write( LogLevel_Info, "Driver::ReadButtons - missing virtual node value for node %d button id %d", _nodeId, buttonId );
-							return;
-						}
-						node->m_buttonMap[buttonId] = nodeId;
-						Notification* notification = new Notification( Notification::Type_CreateButton );
-						notification->SetHomeAndNodeIds( m_homeId, nodeId );
-						notification->SetButtonId( buttonId );
-						QueueNotification( notification );
-					}
-					buttonElement = buttonElement->NextSiblingElement();
+					timeout = remaining;
 				}
+				break;
 			}
+			nodeId = m_timeSyncQueue.front();
+			m_timeSyncQueue.pop_front();
+		}
+
+		WriteLockGuard LG(m_nodeMutex);
+		Node* node = GetNode( nodeId );
+		if( ( node == NULL ) || !node->IsNodeAlive() )
+		{
+			continue;
+		}
+
+		bool asleep = false;
+		if( !node->IsListeningDevice() )
+		{
+			WakeUp* wakeUp = static_cast<WakeUp*>( node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) );
+			asleep = ( wakeUp != NULL ) && !wakeUp->IsAwake();
+		}
+
+		// A set for a sleeping node waits in its wake up queue, superseding any
+		// set already there, and nothing goes on air until the node wakes
+		if( !SetNodeTime( node, time( NULL ) ) )
+		{
+			continue;
+		}
+
+		LockGuard HLG(m_healthMutex);
+		if( asleep )
+		{
+			m_timeSyncStaged[nodeId>>5] |= 1u << ( nodeId & 0x1f );
+			Log::Write( LogLevel_Detail, nodeId, "Time sync: node is asleep, setting its clock when it wakes" );
+		}
+		else
+		{
+			m_timeSyncNext.SetTime( c_timeSyncSpacingMs );
+			Log::Write( LogLevel_Detail, nodeId, "Time sync: clock set, %d more nodes to go", (int)m_timeSyncQueue.size() );
 		}
-		nodeElement = nodeElement->NextSiblingElement();
 	}
+	return timeout;
 }
+
 //-----------------------------------------------------------------------------
-// <Driver::HandleSetSlaveLearnModeResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetDriverStatistics>
+// Return driver statistics
 //-----------------------------------------------------------------------------
-bool Driver::HandleSetSlaveLearnModeResponse
+void Driver::GetDriverStatistics
 (
-		uint8* _data
+		DriverData* _data
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( _data[2] )
-	{
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SET_SLAVE_LEARN_MODE - command in progress" );
-	}
-	else
+	uint64 values[DriverCounter_Count];
+	GetCounters( values );
+
+	_data->m_SOFCnt = values[DriverCounter_SOF];
+	_data->m_ACKWaiting = values[DriverCounter_ACKWaiting];
+	_data->m_readAborts = values[DriverCounter_ReadAborts] + m_controller->GetReadAborts();
+	_data->m_badChecksum = values[DriverCounter_BadChecksum];
+	_data->m_readCnt = values[DriverCounter_Read];
+	_data->m_writeCnt = values[DriverCounter_Write];
+	_data->m_CANCnt = values[DriverCounter_CAN];
+	_data->m_NAKCnt = values[DriverCounter_NAK];
+	_data->m_ACKCnt = values[DriverCounter_ACK];
+	_data->m_OOFCnt = values[DriverCounter_OOF];
+	_data->m_dropped = values[DriverCounter_Dropped];
+	_data->m_retries = values[DriverCounter_Retries];
+	_data->m_callbacks = values[DriverCounter_Callbacks];
+	_data->m_badroutes = values[DriverCounter_BadRoutes];
+	_data->m_noack = values[DriverCounter_NoACK];
+	_data->m_netbusy = values[DriverCounter_NetBusy];
+	_data->m_notidle = values[DriverCounter_NotIdle];
+	_data->m_nondelivery = values[DriverCounter_NonDelivery];
+	_data->m_routedbusy = values[DriverCounter_RoutedBusy];
+	_data->m_broadcastReadCnt = values[DriverCounter_BroadcastRead];
+	_data->m_broadcastWriteCnt = values[DriverCounter_BroadcastWrite];
+	_data->m_expired = values[DriverCounter_Expired];
+	for( int32 i=0; i<MsgQueue_Count; ++i )
 	{
-		// Failed
-		Log::Write( LogLevel_Warning, nodeId, "WARNING: Received reply to FUNC_ID_ZW_SET_SLAVE_LEARN_MODE - command failed" );
-		state = ControllerState_Failed;
-		res = false;
-		SendSlaveLearnModeOff();
+		_data->m_airtime[i] = (uint32)( m_queueAirtime[i] / 1000 );
+		_data->m_aged[i] = m_queueAged[i];
 	}
-
-	UpdateControllerState( state );
-	return res;
+	_data->m_configReadTime = AtomicLoad( &m_configReadTime );
+	_data->m_configBuildTime = AtomicLoad( &m_configBuildTime );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSetSlaveLearnModeRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::Count>
+// Increment one of the driver's counters
 //-----------------------------------------------------------------------------
-void Driver::HandleSetSlaveLearnModeRequest
+void Driver::Count
 (
-		uint8* _data
+		DriverCounter const _counter
 )
 {
-	ControllerState state = ControllerState_Waiting;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
+	AtomicAdd64( &m_counters->m_values[_counter], 1 );
+}
 
-	if( m_currentControllerCommand == NULL )
+//-----------------------------------------------------------------------------
+// <Driver::GetCounters>
+// Take a consistent snapshot of all the counters
+//-----------------------------------------------------------------------------
+void Driver::GetCounters
+(
+		uint64* o_values
+)const
+{
+	// The counters only ever go up, so if two passes read the same values then
+	// there was a moment between them when the counters held all of those values.
+	// Counting is much rarer than this loop, so it seldom needs more than two passes,
+	// and after a few the last pass is as good as any.
+	uint64 check[DriverCounter_Count];
+	for( int32 i=0; i<DriverCounter_Count; ++i )
 	{
-		return;
+		o_values[i] = AtomicLoad64( &m_counters->m_values[i] );
 	}
-
-	SendSlaveLearnModeOff();
-	switch( _data[3] )
+	for( int32 attempt=0; attempt<4; ++attempt )
 	{
-		case SLAVE_ASSIGN_COMPLETE:
-		{
-			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_COMPLETE" );
-			if( _data[4] == 0 ) // original node is 0 so adding
-			{
-				Log::Write( LogLevel_Info, nodeId, "Adding virtual node ID %d", _data[5] );
-				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-				if( node != NULL )
-				{
-					node->m_buttonMap[m_currentControllerCommand->m_controllerCommandArg] = _data[5];
-					SendVirtualNodeInfo( _data[5], m_currentControllerCommand->m_controllerCommandNode );
-				}
-			}
-			else
-				if( _data[5] == 0 )
-				{
-					Log::Write( LogLevel_Info, nodeId, "Removing virtual node ID %d", _data[4] );
-				}
-			break;
-		}
-		case SLAVE_ASSIGN_NODEID_DONE:
+		bool same = true;
+		for( int32 i=0; i<DriverCounter_Count; ++i )
 		{
-			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_NODEID_DONE" );
-			if( _data[4] == 0 ) // original node is 0 so adding
-			{
-				Log::Write( LogLevel_Info, nodeId, "Adding virtual node ID %d", _data[5] );
-				Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-				if( node != NULL )
-				{
-					node->m_buttonMap[m_currentControllerCommand->m_controllerCommandArg] = _data[5];
-					SendVirtualNodeInfo( _data[5], m_currentControllerCommand->m_controllerCommandNode );
-				}
-			}
-			else
-				if( _data[5] == 0 )
-				{
-					Log::Write( LogLevel_Info, nodeId, "Removing virtual node ID %d", _data[4] );
-				}
-			break;
+			check[i] = AtomicLoad64( &m_counters->m_values[i] );
+			same = same && ( check[i] == o_values[i] );
 		}
-		case SLAVE_ASSIGN_RANGE_INFO_UPDATE:
+		if( same )
 		{
-			Log::Write( LogLevel_Info, nodeId, "SLAVE_ASSIGN_RANGE_INFO_UPDATE" );
 			break;
 		}
+		memcpy( o_values, check, sizeof(check) );
 	}
-	m_currentControllerCommand->m_controllerAdded = false;
-
-	UpdateControllerState( state );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSendSlaveNodeInfoResponse>
-// Process a response from the Z-Wave PC interface
+// <Driver::GetNodeStatistics>
+// Return per node statistics
 //-----------------------------------------------------------------------------
-bool Driver::HandleSendSlaveNodeInfoResponse
+void Driver::GetNodeStatistics
 (
-		uint8* _data
+		uint8 const _nodeId,
+		Node::NodeData* _data
 )
 {
-	bool res = true;
-	ControllerState state = ControllerState_InProgress;
-	uint8 nodeId = GetNodeNumber( m_currentMsg );
-	if( m_currentControllerCommand == NULL )
-	{
-		return false;
-	}
-	if( _data[2] )
-	{
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_SLAVE_NODE_INFO - command in progress" );
-	}
-	else
+	NodeGuard LG( this, _nodeId );
+	Node* node = LG.GetNode();
+	if( node != NULL )
 	{
-		// Failed
-		Log::Write( LogLevel_Info, nodeId, "Received reply to FUNC_ID_ZW_SEND_SLAVE_NODE_INFO - command failed" );
-		state = ControllerState_Failed;
-		// Undo button map settings
-		Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-		if( node != NULL )
-		{
-			node->m_buttonMap.erase( m_currentControllerCommand->m_controllerCommandArg );
-		}
-		res = false;
+		_data->m_sentCnt = m_nodeCounters.m_sentCnt[_nodeId];
+		_data->m_sentFailed = m_nodeCounters.m_sentFailed[_nodeId];
+		_data->m_retries = m_nodeCounters.m_retries[_nodeId];
+		_data->m_receivedCnt = m_nodeCounters.m_receivedCnt[_nodeId];
+		_data->m_receivedDups = m_nodeCounters.m_receivedDups[_nodeId];
+		_data->m_receivedUnsolicited = m_nodeCounters.m_receivedUnsolicited[_nodeId];
+		_data->m_lastRequestRTT = m_nodeCounters.m_lastRequestRTT[_nodeId];
+		_data->m_lastResponseRTT = m_nodeCounters.m_lastResponseRTT[_nodeId];
+		_data->m_averageRequestRTT = m_nodeCounters.m_averageRequestRTT[_nodeId];
+		_data->m_averageResponseRTT = m_nodeCounters.m_averageResponseRTT[_nodeId];
+		_data->m_quality = m_nodeCounters.m_quality[_nodeId];
+		_data->m_pollBatches = m_nodeCounters.m_pollBatches[_nodeId];
+		_data->m_pollsCoalesced = m_nodeCounters.m_pollsCoalesced[_nodeId];
+		_data->m_reportsCoalesced = m_nodeCounters.m_reportsCoalesced[_nodeId];
+		_data->m_airtime = (uint32)( m_nodeCounters.m_airtime[_nodeId] / 1000 );
+		node->GetNodeStatistics( _data );
 	}
-
-	UpdateControllerState( state );
-	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleSendSlaveNodeInfoRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::GetMemoryUsage>
+// Bytes used by a queued item, counting two pointers for its list entry
 //-----------------------------------------------------------------------------
-void Driver::HandleSendSlaveNodeInfoRequest
+uint32 Driver::GetMemoryUsage
 (
-		uint8* _data
+		MsgQueueItem const& _item
 )
 {
-	if( m_currentControllerCommand == NULL )
-	{
-		return;
-	}
-	if( _data[3] == 0 )	// finish up
+	uint32 bytes = (uint32)( sizeof(MsgQueueItem) + 2 * sizeof(void*) );
+	if( _item.m_msg )
 	{
-		Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "SEND_SLAVE_NODE_INFO_COMPLETE OK" );
-		SaveButtons();
-		Notification* notification = new Notification( Notification::Type_CreateButton );
-		notification->SetHomeAndNodeIds( m_homeId, m_currentControllerCommand->m_controllerCommandNode );
-		notification->SetButtonId( m_currentControllerCommand->m_controllerCommandArg );
-		QueueNotification( notification );
-
-		UpdateControllerState( ControllerState_Completed );
-		RequestVirtualNeighbors( MsgQueue_Send );
+		bytes += sizeof(Msg);
 	}
-	else			// error. try again
+	if( _item.m_cci )
 	{
-		HandleErrorResponse( _data[3], m_currentControllerCommand->m_controllerCommandNode, "SLAVE_NODE_INFO_COMPLETE" );
-		Node* node = GetNodeUnsafe( m_currentControllerCommand->m_controllerCommandNode );
-		if( node != NULL)
-		{
-			SendVirtualNodeInfo( node->m_buttonMap[m_currentControllerCommand->m_controllerCommandArg], m_currentControllerCommand->m_controllerCommandNode );
-		}
+		bytes += sizeof(ControllerCommandItem);
 	}
+	return bytes;
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::HandleApplicationSlaveCommandRequest>
-// Process a request from the Z-Wave PC interface
+// <Driver::GetMemoryStatistics>
+// Estimate the memory used by the nodes and queues
 //-----------------------------------------------------------------------------
-void Driver::HandleApplicationSlaveCommandRequest
+void Driver::GetMemoryStatistics
 (
-		uint8* _data
+		MemoryData* _data
 )
 {
-	Log::Write( LogLevel_Info, GetNodeNumber( m_currentMsg ), "APPLICATION_SLAVE_COMMAND_HANDLER rxStatus %x dest %d source %d len %d", _data[2], _data[3], _data[4], _data[5] );
-	Node* node = GetNodeUnsafe( _data[4] );
-	if( node != NULL && _data[5] == 3 && _data[6] == 0x20 && _data[7] == 0x01 ) // only support Basic Set for now
+	memset( _data, 0, sizeof(MemoryData) );
 	{
-		map<uint8,uint8>::iterator it = node->m_buttonMap.begin();
-		for( ; it != node->m_buttonMap.end(); ++it )
+		ReadLockGuard LG(m_nodeMutex);
+		for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 		{
-			if( it->second == _data[3] )
-				break;
+			Node::NodeMemoryData nodeData;
+			m_nodes[*nit]->GetNodeMemoryStatistics( &nodeData );
+			_data->m_nodes += nodeData.m_node;
+			_data->m_commandClasses += nodeData.m_commandClasses;
+			_data->m_values += nodeData.m_values;
+			_data->m_groups += nodeData.m_groups;
+			_data->m_wakeUpQueues += nodeData.m_wakeUpQueue;
 		}
-		if( it != node->m_buttonMap.end() )
+		_data->m_nodes += (uint64)m_nodes.GetNumPages() * NodeTable<Node*>::PageSize * sizeof(Node*);
+		_data->m_nodes += sizeof(m_topology);
+	}
+
+	m_sendMutex->Lock();
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		for( int n=0; n<256; ++n )
 		{
-			Notification *notification;
-			if( _data[8] == 0 )
-			{
-				notification = new Notification( Notification::Type_ButtonOff );
-			}
-			else
+			list<MsgQueueItem> const& items = m_msgQueue[i].GetNodeItems( (uint8)n );
+			for( list<MsgQueueItem>::const_iterator it = items.begin(); it != items.end(); ++it )
 			{
-				notification = new Notification( Notification::Type_ButtonOn );
+				_data->m_queuedMsgs[i] += GetMemoryUsage( *it );
 			}
-			notification->SetHomeAndNodeIds( m_homeId, _data[4] );
-			notification->SetButtonId( it->first );
-			QueueNotification( notification );
 		}
 	}
+	m_sendMutex->Unlock();
+
+	m_notificationsMutex->Lock();
+	_data->m_notifications = m_notifications.size() * ( sizeof(Notification) + 2 * sizeof(void*) );
+	_data->m_notifications += m_coalescedValues.size() * ( sizeof(ValueID) + sizeof(CoalescedValue) + 4 * sizeof(void*) );
+	_data->m_notifications += m_heldNotifications * sizeof(Notification);
+	m_notificationsMutex->Unlock();
+
+	_data->m_sharedStrings = SharedString::GetPoolMemoryUsage();
+	_data->m_logQueue = Log::GetQueueMemoryUsage();
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::NodeFromMessage>
-// See if we can get node from incoming message data
+// <Driver::GetNodeMemoryStatistics>
+// Estimate the memory used by a node
 //-----------------------------------------------------------------------------
-uint8 Driver::NodeFromMessage
+void Driver::GetNodeMemoryStatistics
 (
-		uint8 const* buffer
+		uint8 const _nodeId,
+		Node::NodeMemoryData* _data
 )
 {
-	uint8 nodeId = 0;
-
-	if( buffer[1] >= 5 )
+	NodeGuard LG( this, _nodeId );
+	if( Node* node = LG.GetNode() )
 	{
-		switch( buffer[3] )
-		{
-			case FUNC_ID_APPLICATION_COMMAND_HANDLER:		nodeId = buffer[5];	break;
-			case FUNC_ID_ZW_APPLICATION_UPDATE:			nodeId = buffer[5];	break;
-		}
+		node->GetNodeMemoryStatistics( _data );
 	}
-	return nodeId;
 }
+
 //-----------------------------------------------------------------------------
-// <Driver::UpdateNodeRoutes>
-// Update a node's routing information
+// <Driver::GetAllNodeStatistics>
+// Copy the counters of every node at once
 //-----------------------------------------------------------------------------
-void Driver::UpdateNodeRoutes
+void Driver::GetAllNodeStatistics
 (
-		uint8 const _nodeId,
-		bool _doUpdate		// = false
+		NodeCounters* _data
 )
 {
-	// Only for routing slaves
-	Node* node = GetNodeUnsafe( _nodeId );
-	if( node != NULL && node->GetBasic() == 0x04 )
+	ReadLockGuard LG(m_nodeMutex);
+	*_data = m_nodeCounters;
+	memset( _data->m_nodes, 0, sizeof(_data->m_nodes) );
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
 	{
-		uint8 numGroups = GetNumGroups( _nodeId );
-		uint8 numNodes = 0;
-		uint8 nodes[5];
-		InstanceAssociation* associations;
-		uint8 i;
+		_data->m_nodes[*nit>>3] |= (uint8)( 1 << ( *nit & 7 ) );
+	}
+}
 
-		// Determine up to 5 destinations
+//-----------------------------------------------------------------------------
+// <Driver::ResetNodeCounters>
+// Clear the counters of a node that is being deleted
+//-----------------------------------------------------------------------------
+void Driver::ResetNodeCounters
+(
+		uint8 const _nodeId
+)
+{
+	m_nodeCounters.m_sentCnt[_nodeId] = 0;
+	m_nodeCounters.m_sentFailed[_nodeId] = 0;
+	m_nodeCounters.m_retries[_nodeId] = 0;
+	m_nodeCounters.m_receivedCnt[_nodeId] = 0;
+	m_nodeCounters.m_receivedDups[_nodeId] = 0;
+	m_nodeCounters.m_receivedUnsolicited[_nodeId] = 0;
+	m_nodeCounters.m_lastRequestRTT[_nodeId] = 0;
+	m_nodeCounters.m_averageRequestRTT[_nodeId] = 0;
+	m_nodeCounters.m_lastResponseRTT[_nodeId] = 0;
+	m_nodeCounters.m_averageResponseRTT[_nodeId] = 0;
+	m_nodeCounters.m_pollBatches[_nodeId] = 0;
+	m_nodeCounters.m_pollsCoalesced[_nodeId] = 0;
+	m_nodeCounters.m_reportsCoalesced[_nodeId] = 0;
+	m_nodeCounters.m_airtime[_nodeId] = 0;
+	m_nodeCounters.m_quality[_nodeId] = 0;
+}
 
-		memset( nodes, 0, sizeof(nodes) );
-		for( i = 1; i <= numGroups && numNodes < sizeof(nodes) ; i++ )
-		{
-			associations = NULL;
-			uint32 len = GetAssociations( _nodeId, i, &associations );
-			for( uint8 j = 0; j < len; j++ )
-			{
-				uint8 k;
-				/* there is a gcc bug that triggers here: https://gcc.gnu.org/bugzilla/show_bug.cgi?id=59124
-				 * see also https://github.com/OpenZWave/open-zwave/issues/586
-				 */
-				for( k = 0; k < numNodes && k < sizeof(nodes); k++ )
-				{
-					if( nodes[k] == associations[j].m_nodeId )
-					{
-						break;
-					}
-				}
-				if( k >= numNodes && numNodes < sizeof(nodes) )	// not in list so add it
-				{
-					nodes[numNodes++] = associations[j].m_nodeId;
-				}
-			}
-			if( associations != NULL )
-			{
-				delete [] associations;
-			}
-		}
-		if( _doUpdate || numNodes != node->m_numRouteNodes || memcmp( nodes, node->m_routeNodes, sizeof(node->m_routeNodes) ) != 0 )
-		{
-			// Figure out what to do if one of these fail.
-			BeginControllerCommand( ControllerCommand_DeleteAllReturnRoutes, NULL, NULL, true, _nodeId, 0 );
-			for( i = 0; i < numNodes; i++ )
-			{
-				BeginControllerCommand( ControllerCommand_AssignReturnRoute, NULL, NULL, true, _nodeId, nodes[i] );
-			}
-			node->m_numRouteNodes = numNodes;
-			memcpy( node->m_routeNodes, nodes, sizeof(nodes) );
-		}
+//-----------------------------------------------------------------------------
+// <Driver::GetDriverLatencyStatistics>
+// Return the percentiles of the time taken by each stage of sending a message
+//-----------------------------------------------------------------------------
+void Driver::GetDriverLatencyStatistics
+(
+		DriverLatencyData* _data
+)
+{
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		m_queueWait[i].GetSummary( &_data->m_queueWait[i] );
 	}
+	m_ackLatency.GetSummary( &_data->m_ack );
+	m_callbackLatency.GetSummary( &_data->m_callback );
+	m_replyLatency.GetSummary( &_data->m_reply );
+	m_handlerTime.GetSummary( &_data->m_handler );
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetDriverStatistics>
-// Return driver statistics
+// <Driver::GetNodeLatencyStatistics>
+// Return the percentiles of a node's round trip times
 //-----------------------------------------------------------------------------
-void Driver::GetDriverStatistics
+void Driver::GetNodeLatencyStatistics
 (
-		DriverData* _data
+		uint8 const _nodeId,
+		Node::NodeLatencyData* _data
 )
 {
-	_data->m_SOFCnt = m_SOFCnt;
-	_data->m_ACKWaiting = m_ACKWaiting;
-	_data->m_readAborts = m_readAborts;
-	_data->m_badChecksum = m_badChecksum;
-	_data->m_readCnt = m_readCnt;
-	_data->m_writeCnt = m_writeCnt;
-	_data->m_CANCnt = m_CANCnt;
-	_data->m_NAKCnt = m_NAKCnt;
-	_data->m_ACKCnt = m_ACKCnt;
-	_data->m_OOFCnt = m_OOFCnt;
-	_data->m_dropped = m_dropped;
-	_data->m_retries = m_retries;
-	_data->m_callbacks = m_callbacks;
-	_data->m_badroutes = m_badroutes;
-	_data->m_noack = m_noack;
-	_data->m_netbusy = m_netbusy;
-	_data->m_notidle = m_notidle;
-	_data->m_nondelivery = m_nondelivery;
-	_data->m_routedbusy = m_routedbusy;
-	_data->m_broadcastReadCnt = m_broadcastReadCnt;
-	_data->m_broadcastWriteCnt = m_broadcastWriteCnt;
+	NodeGuard LG( this, _nodeId );
+	Node* node = LG.GetNode();
+	if( node != NULL )
+	{
+		node->GetNodeLatencyStatistics( _data );
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Driver::GetNodeStatistics>
-// Return per node statistics
+// <Driver::GetNodeQueryStageStatistics>
+// Return the time each stage of a node's interview took
 //-----------------------------------------------------------------------------
-void Driver::GetNodeStatistics
+void Driver::GetNodeQueryStageStatistics
 (
 		uint8 const _nodeId,
-		Node::NodeData* _data
+		Node::NodeQueryStageData* _data
 )
 {
-	LockGuard LG(m_nodeMutex);
-	Node* node = GetNode( _nodeId );
+	NodeGuard LG( this, _nodeId );
+	Node* node = LG.GetNode();
 	if( node != NULL )
 	{
-		node->GetNodeStatistics( _data );
+		node->GetNodeQueryStageStatistics( _data );
 	}
 }
 
@@ -6716,10 +15558,10 @@ void Driver::LogDriverStatistics
 	Log::Write( LogLevel_Always, "*********************  Cumulative Network Statistics  *********************" );
 	Log::Write( LogLevel_Always, "*** General" );
 	Log::Write( LogLevel_Always, "Driver run time: . .  . %ld days, %ld hours, %ld minutes", days, hours, minutes);
-	Log::Write( LogLevel_Always, "Frames processed: . . . . . . . . . . . . . . . . . . . . %ld", data.m_SOFCnt );
-	Log::Write( LogLevel_Always, "Total messages successfully received: . . . . . . . . . . %ld", data.m_readCnt );
-	Log::Write( LogLevel_Always, "Total Messages successfully sent: . . . . . . . . . . . . %ld", data.m_writeCnt );
-	Log::Write( LogLevel_Always, "ACKs received from controller:  . . . . . . . . . . . . . %ld", data.m_ACKCnt );
+	Log::Write( LogLevel_Always, "Frames processed: . . . . . . . . . . . . . . . . . . . . %llu", (unsigned long long)data.m_SOFCnt );
+	Log::Write( LogLevel_Always, "Total messages successfully received: . . . . . . . . . . %llu", (unsigned long long)data.m_readCnt );
+	Log::Write( LogLevel_Always, "Total Messages successfully sent: . . . . . . . . . . . . %llu", (unsigned long long)data.m_writeCnt );
+	Log::Write( LogLevel_Always, "ACKs received from controller:  . . . . . . . . . . . . . %llu", (unsigned long long)data.m_ACKCnt );
 	// Consider tracking and adding:
 	//		Initialization messages
 	//		Ad-hoc command messages
@@ -6727,17 +15569,294 @@ void Driver::LogDriverStatistics
 	//		Messages inititated by network
 	//		Others?
 	Log::Write( LogLevel_Always, "*** Errors" );
-	Log::Write( LogLevel_Always, "Unsolicited messages received while waiting for ACK:  . . %ld", data.m_ACKWaiting );
-	Log::Write( LogLevel_Always, "Reads aborted due to timeouts:  . . . . . . . . . . . . . %ld", data.m_readAborts );
-	Log::Write( LogLevel_Always, "Bad checksum errors:  . . . . . . . . . . . . . . . . . . %ld", data.m_badChecksum );
-	Log::Write( LogLevel_Always, "CANs received from controller:  . . . . . . . . . . . . . %ld", data.m_CANCnt );
-	Log::Write( LogLevel_Always, "NAKs received from controller:  . . . . . . . . . . . . . %ld", data.m_NAKCnt );
-	Log::Write( LogLevel_Always, "Out of frame data flow errors:  . . . . . . . . . . . . . %ld", data.m_OOFCnt );
-	Log::Write( LogLevel_Always, "Messages retransmitted: . . . . . . . . . . . . . . . . . %ld", data.m_retries );
-	Log::Write( LogLevel_Always, "Messages dropped and not delivered: . . . . . . . . . . . %ld", data.m_dropped );
+	Log::Write( LogLevel_Always, "Unsolicited messages received while waiting for ACK:  . . %llu", (unsigned long long)data.m_ACKWaiting );
+	Log::Write( LogLevel_Always, "Reads aborted due to timeouts:  . . . . . . . . . . . . . %llu", (unsigned long long)data.m_readAborts );
+	Log::Write( LogLevel_Always, "Bad checksum errors:  . . . . . . . . . . . . . . . . . . %llu", (unsigned long long)data.m_badChecksum );
+	Log::Write( LogLevel_Always, "CANs received from controller:  . . . . . . . . . . . . . %llu", (unsigned long long)data.m_CANCnt );
+	Log::Write( LogLevel_Always, "NAKs received from controller:  . . . . . . . . . . . . . %llu", (unsigned long long)data.m_NAKCnt );
+	Log::Write( LogLevel_Always, "Out of frame data flow errors:  . . . . . . . . . . . . . %llu", (unsigned long long)data.m_OOFCnt );
+	Log::Write( LogLevel_Always, "Messages retransmitted: . . . . . . . . . . . . . . . . . %llu", (unsigned long long)data.m_retries );
+	Log::Write( LogLevel_Always, "Messages dropped and not delivered: . . . . . . . . . . . %llu", (unsigned long long)data.m_dropped );
+	Log::Write( LogLevel_Always, "Messages dropped past their queue deadline: . . . . . . . %llu", (unsigned long long)data.m_expired );
+	Log::Write( LogLevel_Always, "*** Estimated airtime (ms)" );
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		Log::Write( LogLevel_Always, "%-10s queue: . . . . . . . . . . . . . . . . . . . . %ld", c_sendQueueNames[i], data.m_airtime[i] );
+	}
+	Log::Write( LogLevel_Always, "*** Times gone ahead of busier queues" );
+	for( int32 i=MsgQueue_Send+1; i<MsgQueue_Count; ++i )
+	{
+		Log::Write( LogLevel_Always, "%-10s queue: . . . . . . . . . . . . . . . . . . . . %ld", c_sendQueueNames[i], data.m_aged[i] );
+	}
+
+	DriverLatencyData latency;
+	GetDriverLatencyStatistics( &latency );
+	Log::Write( LogLevel_Always, "*** Latency (ms)                       count    p50    p90    p99    max" );
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		char stage[32];
+		snprintf( stage, sizeof(stage), "Waiting in the %s queue", c_sendQueueNames[i] );
+		LogLatency( stage, latency.m_queueWait[i] );
+	}
+	LogLatency( "ACK from the controller", latency.m_ack );
+	LogLatency( "Callback from the controller", latency.m_callback );
+	LogLatency( "Reply from the node", latency.m_reply );
+	LogLatency( "Watchers handling notifications", latency.m_handler );
+
+#ifdef DEBUG
+	// Debug builds time the waits for the driver's busiest locks
+	struct { char const* m_name; Mutex* m_mutex; } const locks[] =
+	{
+		{ "Send queues", m_sendMutex },
+		{ "Poll list", m_pollMutex },
+		{ "Notifications", m_notificationsMutex },
+		{ "Network health", m_healthMutex },
+		{ "Interviews", m_interviewMutex }
+	};
+	Log::Write( LogLevel_Always, "*** Lock contention                  locks  contended  wait(ms)  max wait  max held" );
+	for( uint32 i=0; i<sizeof(locks)/sizeof(locks[0]); ++i )
+	{
+		Mutex::Statistics stats;
+		if( locks[i].m_mutex->GetStatistics( &stats ) )
+		{
+			Log::Write( LogLevel_Always, "%-28s %10u %10u %9u %9u %9u", locks[i].m_name, stats.m_locks, stats.m_contended, stats.m_waitTime, stats.m_maxWaitTime, stats.m_maxHoldTime );
+		}
+	}
+#endif
 	Log::Write( LogLevel_Always, "***************************************************************************" );
 }
 
+//-----------------------------------------------------------------------------
+// <Driver::LogLatency>
+// Report the percentiles of one stage to the driver's log
+//-----------------------------------------------------------------------------
+void Driver::LogLatency
+(
+		char const* _stage,
+		LatencyHistogram::Summary const& _summary
+)
+{
+	Log::Write( LogLevel_Always, "%-36s %6d %6d %6d %6d %6d", _stage, _summary.m_count, _summary.m_p50, _summary.m_p90, _summary.m_p99, _summary.m_max );
+}
+
+//-----------------------------------------------------------------------------
+// Helpers for WriteMetrics
+//-----------------------------------------------------------------------------
+static uint32 const c_metricBoundsMs[] = { 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000 };
+static uint32 const c_metricBoundCount = sizeof(c_metricBoundsMs) / sizeof(c_metricBoundsMs[0]);
+
+static void AppendMetricHeader
+(
+		string& o_text,
+		char const* _name,
+		char const* _type,
+		char const* _help
+)
+{
+	o_text += "# HELP ";
+	o_text += _name;
+	o_text += " ";
+	o_text += _help;
+	o_text += "\n# TYPE ";
+	o_text += _name;
+	o_text += " ";
+	o_text += _type;
+	o_text += "\n";
+}
+
+static void AppendMetric
+(
+		string& o_text,
+		char const* _name,
+		char const* _labels,
+		uint64 const _value,
+		bool const _ms				// Write a value in milliseconds as seconds
+)
+{
+	char line[256];
+	if( _ms )
+	{
+		snprintf( line, sizeof(line), "%s{%s} %u.%03u\n", _name, _labels, (uint32)( _value / 1000 ), (uint32)( _value % 1000 ) );
+	}
+	else
+	{
+		snprintf( line, sizeof(line), "%s{%s} %llu\n", _name, _labels, (unsigned long long)_value );
+	}
+	o_text += line;
+}
+
+static void AppendHistogram
+(
+		string& o_text,
+		char const* _name,
+		char const* _labels,
+		LatencyHistogram const& _histogram
+)
+{
+	uint32 counts[c_metricBoundCount];
+	uint32 count;
+	uint32 sum;
+	_histogram.GetCumulative( c_metricBoundsMs, c_metricBoundCount, counts, &count, &sum );
+
+	char line[256];
+	for( uint32 i=0; i<c_metricBoundCount; ++i )
+	{
+		snprintf( line, sizeof(line), "%s_bucket{%s,le=\"%u.%03u\"} %u\n", _name, _labels, c_metricBoundsMs[i] / 1000, c_metricBoundsMs[i] % 1000, counts[i] );
+		o_text += line;
+	}
+	snprintf( line, sizeof(line), "%s_bucket{%s,le=\"+Inf\"} %u\n", _name, _labels, count );
+	o_text += line;
+	snprintf( line, sizeof(line), "%s_sum{%s} %u.%03u\n", _name, _labels, sum / 1000, sum % 1000 );
+	o_text += line;
+	snprintf( line, sizeof(line), "%s_count{%s} %u\n", _name, _labels, count );
+	o_text += line;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::WriteMetrics>
+// Render the statistics in the Prometheus text format
+//-----------------------------------------------------------------------------
+void Driver::WriteMetrics
+(
+		string& o_text
+)
+{
+	char labels[64];
+	snprintf( labels, sizeof(labels), "home_id=\"0x%.8x\"", m_homeId );
+
+	struct Counter
+	{
+		char const*		m_name;
+		char const*		m_help;
+		DriverCounter	m_counter;
+	};
+	Counter const counters[] =
+	{
+		{ "ozw_frames_total", "Frames received from the controller.", DriverCounter_SOF },
+		{ "ozw_messages_read_total", "Messages successfully read from the controller.", DriverCounter_Read },
+		{ "ozw_messages_written_total", "Messages successfully written to the controller.", DriverCounter_Write },
+		{ "ozw_controller_acks_total", "ACKs received from the controller.", DriverCounter_ACK },
+		{ "ozw_controller_naks_total", "NAKs received from the controller.", DriverCounter_NAK },
+		{ "ozw_controller_cans_total", "CANs received from the controller.", DriverCounter_CAN },
+		{ "ozw_out_of_frame_total", "Bytes received out of framing.", DriverCounter_OOF },
+		{ "ozw_ack_waiting_total", "Unsolicited messages received while waiting for an ACK.", DriverCounter_ACKWaiting },
+		{ "ozw_read_aborts_total", "Reads aborted due to timeouts.", DriverCounter_ReadAborts },
+		{ "ozw_bad_checksums_total", "Messages received with a bad checksum.", DriverCounter_BadChecksum },
+		{ "ozw_retries_total", "Messages retransmitted.", DriverCounter_Retries },
+		{ "ozw_dropped_total", "Messages dropped and not delivered.", DriverCounter_Dropped },
+		{ "ozw_unexpected_callbacks_total", "Unexpected callbacks from the controller.", DriverCounter_Callbacks },
+		{ "ozw_bad_routes_total", "Messages that failed due to a bad route.", DriverCounter_BadRoutes },
+		{ "ozw_no_ack_total", "Messages not acknowledged by the node.", DriverCounter_NoACK },
+		{ "ozw_network_busy_total", "Messages that failed because the network was busy.", DriverCounter_NetBusy },
+		{ "ozw_not_idle_total", "Messages that failed because the controller was not idle.", DriverCounter_NotIdle },
+		{ "ozw_not_delivered_total", "Messages the controller could not deliver to the network.", DriverCounter_NonDelivery },
+		{ "ozw_routed_busy_total", "Messages received with the routed busy status.", DriverCounter_RoutedBusy },
+		{ "ozw_broadcasts_read_total", "Broadcasts received.", DriverCounter_BroadcastRead },
+		{ "ozw_broadcasts_written_total", "Broadcasts sent.", DriverCounter_BroadcastWrite },
+		{ "ozw_expired_total", "Messages dropped unsent, having waited on their queue past their deadline.", DriverCounter_Expired }
+	};
+
+	uint64 values[DriverCounter_Count];
+	GetCounters( values );
+	for( uint32 i=0; i<sizeof(counters)/sizeof(counters[0]); ++i )
+	{
+		AppendMetricHeader( o_text, counters[i].m_name, "counter", counters[i].m_help );
+		AppendMetric( o_text, counters[i].m_name, labels, values[counters[i].m_counter], false );
+	}
+
+	char queueLabels[96];
+	AppendMetricHeader( o_text, "ozw_queue_airtime_seconds_total", "counter", "Estimated radio time used by the messages of each send queue." );
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		snprintf( queueLabels, sizeof(queueLabels), "%s,queue=\"%s\"", labels, c_sendQueueNames[i] );
+		AppendMetric( o_text, "ozw_queue_airtime_seconds_total", queueLabels, m_queueAirtime[i] / 1000, true );
+	}
+
+	AppendMetricHeader( o_text, "ozw_queue_aged_total", "counter", "Times each send queue went ahead of busier ones, having waited past its QueueAging time." );
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		snprintf( queueLabels, sizeof(queueLabels), "%s,queue=\"%s\"", labels, c_sendQueueNames[i] );
+		AppendMetric( o_text, "ozw_queue_aged_total", queueLabels, m_queueAged[i], false );
+	}
+
+	AppendMetricHeader( o_text, "ozw_queue_wait_seconds", "histogram", "Time from queueing a message to sending it." );
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		snprintf( queueLabels, sizeof(queueLabels), "%s,queue=\"%s\"", labels, c_sendQueueNames[i] );
+		AppendHistogram( o_text, "ozw_queue_wait_seconds", queueLabels, m_queueWait[i] );
+	}
+	AppendMetricHeader( o_text, "ozw_ack_latency_seconds", "histogram", "Time from sending a frame to the controller's ACK." );
+	AppendHistogram( o_text, "ozw_ack_latency_seconds", labels, m_ackLatency );
+	AppendMetricHeader( o_text, "ozw_callback_latency_seconds", "histogram", "Time from sending a request to the controller's callback." );
+	AppendHistogram( o_text, "ozw_callback_latency_seconds", labels, m_callbackLatency );
+	AppendMetricHeader( o_text, "ozw_reply_latency_seconds", "histogram", "Time from sending a request to the node's reply." );
+	AppendHistogram( o_text, "ozw_reply_latency_seconds", labels, m_replyLatency );
+	AppendMetricHeader( o_text, "ozw_notification_handler_seconds", "histogram", "Time taken by the watchers over each batch of notifications." );
+	AppendHistogram( o_text, "ozw_notification_handler_seconds", labels, m_handlerTime );
+
+	// Each metric's samples have to be together, so the nodes are visited once per metric
+	ReadLockGuard LG(m_nodeMutex);
+	WriteNodeMetric( o_text, "ozw_node_sent_total", "counter", "Messages sent to the node.", m_nodeCounters.m_sentCnt, false );
+	WriteNodeMetric( o_text, "ozw_node_send_failures_total", "counter", "Messages to the node that failed.", m_nodeCounters.m_sentFailed, false );
+	WriteNodeMetric( o_text, "ozw_node_retries_total", "counter", "Messages to the node retransmitted.", m_nodeCounters.m_retries, false );
+	WriteNodeMetric( o_text, "ozw_node_received_total", "counter", "Messages received from the node.", m_nodeCounters.m_receivedCnt, false );
+	WriteNodeMetric( o_text, "ozw_node_received_duplicates_total", "counter", "Duplicate messages received from the node.", m_nodeCounters.m_receivedDups, false );
+	WriteNodeMetric( o_text, "ozw_node_received_unsolicited_total", "counter", "Unsolicited messages received from the node.", m_nodeCounters.m_receivedUnsolicited, false );
+	WriteNodeMetric( o_text, "ozw_node_reports_coalesced_total", "counter", "Reports from the node replaced by a later one while it was over its rate limit.", m_nodeCounters.m_reportsCoalesced, false );
+	WriteNodeMetric( o_text, "ozw_node_request_rtt_seconds", "gauge", "Last time from a request to the controller's callback.", m_nodeCounters.m_lastRequestRTT, true );
+	WriteNodeMetric( o_text, "ozw_node_request_rtt_average_seconds", "gauge", "Running average of the time from a request to the controller's callback.", m_nodeCounters.m_averageRequestRTT, true );
+	WriteNodeMetric( o_text, "ozw_node_response_rtt_seconds", "gauge", "Last time from a request to the node's reply.", m_nodeCounters.m_lastResponseRTT, true );
+	WriteNodeMetric( o_text, "ozw_node_response_rtt_average_seconds", "gauge", "Running average of the time from a request to the node's reply.", m_nodeCounters.m_averageResponseRTT, true );
+
+	char nodeLabels[96];
+	AppendMetricHeader( o_text, "ozw_node_airtime_seconds_total", "counter", "Estimated radio time used by messages to the node." );
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+	{
+		int i = *nit;
+		snprintf( nodeLabels, sizeof(nodeLabels), "%s,node=\"%d\"", labels, i );
+		AppendMetric( o_text, "ozw_node_airtime_seconds_total", nodeLabels, m_nodeCounters.m_airtime[i] / 1000, true );
+	}
+
+	AppendMetricHeader( o_text, "ozw_node_callback_latency_seconds", "histogram", "Time from a request to the node to the controller's callback." );
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+	{
+		int i = *nit;
+		snprintf( nodeLabels, sizeof(nodeLabels), "%s,node=\"%d\"", labels, i );
+		AppendHistogram( o_text, "ozw_node_callback_latency_seconds", nodeLabels, m_nodes[i]->m_callbackLatency );
+	}
+	AppendMetricHeader( o_text, "ozw_node_reply_latency_seconds", "histogram", "Time from a request to the node to its reply." );
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+	{
+		int i = *nit;
+		snprintf( nodeLabels, sizeof(nodeLabels), "%s,node=\"%d\"", labels, i );
+		AppendHistogram( o_text, "ozw_node_reply_latency_seconds", nodeLabels, m_nodes[i]->m_replyLatency );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::WriteNodeMetric>
+// Render one of the node counters for every node.  Called with m_nodeMutex held.
+//-----------------------------------------------------------------------------
+void Driver::WriteNodeMetric
+(
+		string& o_text,
+		char const* _name,
+		char const* _type,
+		char const* _help,
+		uint32 const* _values,
+		bool const _ms
+)
+{
+	char labels[96];
+	AppendMetricHeader( o_text, _name, _type, _help );
+	for( vector<uint16>::const_iterator nit = m_nodeIds.begin(); nit != m_nodeIds.end(); ++nit )
+	{
+		int i = *nit;
+		snprintf( labels, sizeof(labels), "home_id=\"0x%.8x\",node=\"%d\"", m_homeId, i );
+		AppendMetric( o_text, _name, labels, _values[i], _ms );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Driver::GetNetworkKey>
 // Get the Network Key we will use for Security Command Class
@@ -6781,10 +15900,14 @@ uint8 *Driver::GetNetworkKey() {
 //-----------------------------------------------------------------------------
 bool Driver::SendEncryptedMessage() {
 
+	if (m_noncePrefetch) {
+		/* if there is more for this node, have it send its next nonce straight back */
+		m_currentMsg->setNonceGet(HasQueuedEncryptedMsg(m_currentMsg->GetTargetNodeId()));
+	}
 	uint8 *buffer = m_currentMsg->GetBuffer();
 	uint8 length = m_currentMsg->GetLength();
 	m_expectedCallbackId = m_currentMsg->GetCallbackId();
-	Log::Write(LogLevel_Info, m_currentMsg->GetTargetNodeId(), "Sending (%s) message (Callback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str());
+	OZW_LOG( LogLevel_Info, m_currentMsg->GetTargetNodeId(), "Sending (%s) message (Callback ID=0x%.2x, Expected Reply=0x%.2x) - %s", c_sendQueueNames[m_currentMsgQueueSource], m_expectedCallbackId, m_expectedReply, m_currentMsg->GetAsString().c_str() );
 
 	m_controller->Write( buffer, length );
 	m_currentMsg->clearNonce();
@@ -6812,15 +15935,62 @@ bool Driver::SendNonceRequest(string logmsg) {
 	//m_buffer[9] = m_expectedCallbackId;
 	m_buffer[9] = 2;
 	// Calculate the checksum
-	m_buffer[10] = 0xff;
-	for( uint32 i=1; i<10; ++i )
-	{
-		m_buffer[10] ^= m_buffer[i];
-	}
+	m_buffer[10] = XorChecksum( &m_buffer[1], 9 );
 	Log::Write(LogLevel_Info, m_currentMsg->GetTargetNodeId(), "Sending (%s) message (Callback ID=0x%.2x, Expected Reply=0x%.2x) - Nonce_Get(%s) - %s:", c_sendQueueNames[m_currentMsgQueueSource], m_expectedCallbackId, m_expectedReply, logmsg.c_str(), PktToString(m_buffer, 10).c_str());
 
 	m_controller->Write(m_buffer, 11);
+	m_nonceRequested = m_currentMsg->GetTargetNodeId();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::HasQueuedEncryptedMsg>
+// True if an encrypted message for the node is waiting in the send queues
+//-----------------------------------------------------------------------------
+bool Driver::HasQueuedEncryptedMsg
+(
+	uint8 const _nodeId
+)
+{
+	LockGuard LG(m_sendMutex);
+	for( int32 i=0; i<MsgQueue_Count; ++i )
+	{
+		list<MsgQueueItem>& items = m_msgQueue[i].GetNodeItems( _nodeId );
+		for( list<MsgQueueItem>::iterator it = items.begin(); it != items.end(); ++it )
+		{
+			if( it->m_command == MsgQueueCmd_SendMsg && it->m_msg->isEncrypted() )
+			{
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Driver::TakePrefetchedNonce>
+// Use up the node's prefetched nonce, if it has one that has not expired
+//-----------------------------------------------------------------------------
+bool Driver::TakePrefetchedNonce
+(
+	uint8 const _nodeId,
+	uint8* _nonce
+)
+{
+	PrefetchedNonce& prefetched = m_prefetchedNonces[_nodeId];
+	if( !prefetched.m_valid )
+	{
+		return false;
+	}
 
+	// A nonce is only good for one message
+	prefetched.m_valid = false;
+	if( prefetched.m_expires.TimeRemaining() <= 0 )
+	{
+		return false;
+	}
+	memcpy( _nonce, prefetched.m_nonce, 8 );
 	return true;
 }
 
@@ -6832,9 +16002,14 @@ bool Driver::initNetworkKeys(bool newnode) {
 	uint8_t SecuritySchemes[1][16] = {
 			{0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 }
 	};
-	this->m_inclusionkeySet = newnode;
-	this->AuthKey = new aes_encrypt_ctx;
-	this->EncryptKey = new aes_encrypt_ctx;
+	/* each key's schedules are worked out once and then kept, rather than
+	 * for every frame sent or received while a node is being added */
+	aes_encrypt_ctx*& authKey = newnode ? this->InclusionAuthKey : this->AuthKey;
+	aes_encrypt_ctx*& encryptKey = newnode ? this->InclusionEncryptKey : this->EncryptKey;
+	if (authKey == NULL)
+		authKey = new aes_encrypt_ctx;
+	if (encryptKey == NULL)
+		encryptKey = new aes_encrypt_ctx;
 
 	Log::Write(LogLevel_Info, GetControllerNodeId(), "Setting Up %s Network Key for Secure Communications", newnode == true ? "Inclusion" : "Provided");
 
@@ -6848,43 +16023,45 @@ bool Driver::initNetworkKeys(bool newnode) {
 		return false;
 	}
 
-	if (aes_encrypt_key128(newnode == false ? this->GetNetworkKey() : SecuritySchemes[0], this->EncryptKey) == EXIT_FAILURE) {
+	if (aes_encrypt_key128(newnode == false ? this->GetNetworkKey() : SecuritySchemes[0], encryptKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to Set Initial Network Key for Encryption");
 		return false;
 	}
 
-	if (aes_encrypt_key128(newnode == false ? this->GetNetworkKey() : SecuritySchemes[0], this->AuthKey) == EXIT_FAILURE) {
+	if (aes_encrypt_key128(newnode == false ? this->GetNetworkKey() : SecuritySchemes[0], authKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to Set Initial Network Key for Authentication");
 		return false;
 	}
 
 	uint8 tmpEncKey[32];
 	uint8 tmpAuthKey[32];
-	aes_mode_reset(this->EncryptKey);
-	aes_mode_reset(this->AuthKey);
+	aes_mode_reset(encryptKey);
+	aes_mode_reset(authKey);
 
-	if (aes_ecb_encrypt(EncryptPassword, tmpEncKey, 16, this->EncryptKey) == EXIT_FAILURE) {
+	if (aes_ecb_encrypt(EncryptPassword, tmpEncKey, 16, encryptKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to Generate Encrypted Network Key for Encryption");
 		return false;
 	}
-	if (aes_ecb_encrypt(AuthPassword, tmpAuthKey, 16, this->AuthKey) == EXIT_FAILURE) {
+	if (aes_ecb_encrypt(AuthPassword, tmpAuthKey, 16, authKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to Generate Encrypted Network Key for Authentication");
 		return false;
 	}
 
 
-	aes_mode_reset(this->EncryptKey);
-	aes_mode_reset(this->AuthKey);
-	if (aes_encrypt_key128(tmpEncKey, this->EncryptKey) == EXIT_FAILURE) {
+	aes_mode_reset(encryptKey);
+	aes_mode_reset(authKey);
+	if (aes_encrypt_key128(tmpEncKey, encryptKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to set Encrypted Network Key for Encryption");
 		return false;
 	}
-	if (aes_encrypt_key128(tmpAuthKey, this->AuthKey) == EXIT_FAILURE) {
+	if (aes_encrypt_key128(tmpAuthKey, authKey) == EXIT_FAILURE) {
 		Log::Write(LogLevel_Warning, GetControllerNodeId(), "Failed to set Encrypted Network Key for Authentication");
 		return false;
 	}
-	aes_mode_reset(this->EncryptKey);
-	aes_mode_reset(this->AuthKey);
+	aes_mode_reset(encryptKey);
+	aes_mode_reset(authKey);
+	if (newnode)
+		this->m_inclusionkeySet = true;
 	return true;
 }
 
@@ -6908,11 +16085,7 @@ void Driver::SendNonceKey(uint8 nodeId, uint8 *nonce) {
 	/* this is the same as the Actual Message */
 	m_buffer[17] = 1;
 	// Calculate the checksum
-	m_buffer[18] = 0xff;
-	for( uint32 i=1; i<18; ++i )
-	{
-		m_buffer[18] ^= m_buffer[i];
-	}
+	m_buffer[18] = XorChecksum( &m_buffer[1], 17 );
 	Log::Write(LogLevel_Info, nodeId, "Sending (%s) message (Callback ID=0x%.2x, Expected Reply=0x%.2x) - Nonce_Report - %s:", c_sendQueueNames[m_currentMsgQueueSource], m_buffer[17], m_expectedReply, PktToString(m_buffer, 19).c_str());
 
 	m_controller->Write(m_buffer, 19);
@@ -6928,9 +16101,9 @@ aes_encrypt_ctx *Driver::GetAuthKey
 			m_currentControllerCommand->m_controllerCommand == ControllerCommand_AddDevice &&
 			m_currentControllerCommand->m_controllerState == ControllerState_Completed ) {
 		/* we are adding a Node, so our AuthKey is different from normal comms */
-		initNetworkKeys(true);
-	} else if (m_inclusionkeySet) {
-		initNetworkKeys(false);
+		if (!m_inclusionkeySet)
+			initNetworkKeys(true);
+		return this->InclusionAuthKey;
 	}
 	return this->AuthKey;
 };
@@ -6942,11 +16115,10 @@ aes_encrypt_ctx *Driver::GetEncKey
 			m_currentControllerCommand->m_controllerCommand == ControllerCommand_AddDevice &&
 			m_currentControllerCommand->m_controllerState == ControllerState_Completed ) {
 		/* we are adding a Node, so our EncryptKey is different from normal comms */
-		initNetworkKeys(true);
-	} else if (m_inclusionkeySet) {
-		initNetworkKeys(false);
+		if (!m_inclusionkeySet)
+			initNetworkKeys(true);
+		return this->InclusionEncryptKey;
 	}
-
 	return this->EncryptKey;
 };
 
@@ -31,6 +31,7 @@
 #include <string>
 #include <map>
 #include <list>
+#include <set>
 
 #include "Defs.h"
 #include "Group.h"
@@ -38,9 +39,16 @@
 #include "Node.h"
 #include "platform/Event.h"
 #include "platform/Mutex.h"
+#include "platform/RWLock.h"
 #include "platform/TimeStamp.h"
+#include "TimerWheel.h"
+#include "LatencyHistogram.h"
+#include "NodeTable.h"
 #include "aes/aescpp.h"
 
+class TiXmlElement;
+class TiXmlDocument;
+
 namespace OpenZWave
 {
 	class Msg;
@@ -51,6 +59,28 @@ namespace OpenZWave
 	class Thread;
 	class ControllerReplication;
 	class Notification;
+	class NotificationDispatcher;
+	class XmlWriter;
+	class XmlStreamReader;
+	class ValueExport;
+	class ValueIndex;
+	class ChangeJournal;
+	class ValueLog;
+	class Stream;
+	class ControllerTrace;
+	class MsgTrace;
+	class ControllerGroup;
+
+	/** \brief The result of testing the link between two nodes with Powerlevel test frames.
+	 * \see Manager::BeginNetworkHealthScan
+	 */
+	struct LinkQuality
+	{
+		uint8	m_sourceId;			// The node that sent the test frames
+		uint8	m_targetId;			// The node they were sent to
+		uint16	m_sent;				// Test frames sent, or zero if the test could not be run
+		uint16	m_acked;			// Test frames the target acknowledged
+	};
 
 	/** \brief The Driver class handles communication between OpenZWave
 	 *  and a device attached via a serial port (typically a controller).
@@ -67,14 +97,24 @@ namespace OpenZWave
 		friend class ValueButton;
 		friend class Association;
 		friend class Basic;
+		friend class Color;
+		friend class Configuration;
+		friend class Powerlevel;
+		friend class DoorLockLogging;
+		friend class FirmwareUpdateMetaData;
 		friend class ManufacturerSpecific;
 		friend class MultiChannelAssociation;
 		friend class NodeNaming;
 		friend class NoOperation;
 		friend class SceneActivation;
+		friend class CentralScene;
+		friend class UserCode;
 		friend class WakeUp;
 		friend class Security;
 		friend class Msg;
+		friend class Scene;
+		friend class SharedPollThread;
+		friend class ControllerGroup;
 
 	//-----------------------------------------------------------------------------
 	//	Controller Interfaces
@@ -84,7 +124,10 @@ namespace OpenZWave
 		{
 			ControllerInterface_Unknown = 0,
 			ControllerInterface_Serial,
-			ControllerInterface_Hid
+			ControllerInterface_Hid,
+			ControllerInterface_Simulated,			/**< A controller and network simulated in software, for load testing.  See SimulatedController */
+			ControllerInterface_Replay,				/**< Plays back a trace recorded with the ControllerTrace option.  See ReplayController */
+			ControllerInterface_Tcp					/**< A controller on another machine, such as one shared with ser2net.  See TcpController */
 		};
 
 	//-----------------------------------------------------------------------------
@@ -101,6 +144,15 @@ namespace OpenZWave
 		 */
 		virtual ~Driver();
 
+		/**
+		 *  Set the exit flag and ask the poll and driver threads to stop, without
+		 *  waiting for them.  With the FastShutdown option, the destructor does this
+		 *  before saving the configuration, and the Manager does it for every driver
+		 *  before deleting any, so the threads all wind down together.
+		 */
+		void SignalExit();
+		void StopConfigThread();						// Wait for the background writer to save what it has, then free it
+
 		/**
 		 *  Start the driverThread
 		 */
@@ -152,6 +204,7 @@ namespace OpenZWave
 		Thread*					m_driverThread;			/**< Thread for reading from the Z-Wave controller, and for creating and managing the other threads for sending, polling etc. */
 		Mutex*					m_initMutex;            /**< Mutex to ensure proper ordering of initialization/deinitialization */
 		bool					m_exit;					/**< Flag that is set when the application is exiting. */
+		bool					m_tearingDown;			/**< Set by a fast shutdown while the nodes are deleted, so they skip their notifications and bookkeeping */
 		bool					m_init;					/**< Set to true once the driver has been initialised */
 		bool					m_awakeNodesQueried;	/**< Set to true once the driver has polled all awake nodes */
 		bool					m_allNodesQueried;		/**< Set to true once the driver has polled all nodes */
@@ -164,7 +217,64 @@ namespace OpenZWave
 	private:
 		void RequestConfig();							// Get the network configuration from the Z-Wave network
 		bool ReadConfig();								// Read the configuration from a file
+		void PreloadConfigXML();						// Parse the device files of the nodes just read, before their interviews need them
+		TiXmlElement const* OpenConfig( TiXmlDocument& o_doc, XmlStreamReader& o_reader, string& o_filename );	// The root of the configuration file, or NULL if there is none for this controller
+		bool ReadCachedControllerInit();				// Read the controller's identity from the configuration file
 		void WriteConfig();								// Save the configuration to a file
+		void BuildConfig( string& o_xml, bool const _handoff );	// The configuration as XML text, with the state for the next process if _handoff is set
+		bool IsBinaryConfig()const;						// True if the configuration is kept in the binary format rather than XML
+		void SetConfigDirty( uint8 const _nodeId );		// Mark a node's saved configuration as out of date
+		bool TakeConfigDirty( uint8 const _nodeId );	// Clear a node's dirty mark, returning whether it was set
+		bool SaveConfig( string const& _xml, string const& _filename, bool const _binary );	// Write a snapshot to a temporary file and move it over the old one
+		void OpenValueLog();							// With the ValueLog option, apply the changes logged since the configuration was saved, and log the ones to come
+		void FlushValueLog();							// Append the values changed since the last call to the log, and save the configuration once it has grown too long
+		void WriteLinkStatistics( XmlWriter& _writer );					// Save what is known about each node's link, so a restart does not start cold
+		void ReadLinkStatistics( TiXmlElement const* _element );		// Restore it.  Must be called with m_nodeMutex locked, once the nodes exist.
+
+		/**
+		 * With the StateHandoffPath option, the driver leaves a snapshot of the
+		 * network in that folder when it is removed, meant to be kept in memory
+		 * such as /dev/shm.  It is the configuration in the binary format plus a
+		 * Handoff element, which holds what the configuration file leaves out: the
+		 * nodes that were fully queried, the messages waiting to be sent, and the
+		 * counters.  The next process to start a driver for the
+		 * same network reads the snapshot, mapped rather than read, in place of the
+		 * configuration file.  It then skips the queries for the nodes that were
+		 * complete, and removes the snapshot, so it is only ever used once.  A
+		 * snapshot older than StateHandoffMaxAge is ignored.
+		 */
+		string GetHandoffFilename()const;				// The snapshot for this network, or empty if there is to be none
+		void SaveHandoff();								// Write the snapshot
+		void WriteHandoff( XmlWriter& _writer );		// The state the configuration leaves out.  Must be called with m_nodeMutex locked.
+		void ReadHandoff( TiXmlElement const* _element );	// Restore it.  Must be called with m_nodeMutex locked, once the nodes exist.
+		bool OpenHandoff( TiXmlDocument& o_doc, string const& _filename );	// Load the snapshot, if there is one recent enough
+
+		static void ConfigThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ConfigThreadProc( Event* _exitEvent );
+
+		volatile uint32			m_configDirty[8];		// One bit per node whose configuration changed since it was last written
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		NodeTable<string>		m_configCache;			// Each node's configuration as the XML text last written, empty if none
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32					m_configLength;			// Length of the last configuration written, to size the next one
+		volatile uint32			m_configReadTime;		// Time taken by ReadConfig when the driver started, in microseconds
+		volatile uint32			m_configBuildTime;		// Time taken to build the last configuration written, in microseconds
+		Thread*					m_configThread;			// If not NULL, saves the configuration in the background
+		Event*					m_configEvent;			// Set when there is a snapshot waiting to be saved
+		Mutex*					m_configMutex;			// Serialize access to the pending snapshot
+		string*					m_configPending;		// The most recent snapshot not yet picked up by the writer thread
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		string					m_configPendingFile;	// Where that snapshot should be saved
+OPENZWAVE_EXPORT_WARNINGS_ON
+		bool					m_configPendingBinary;	// True if that snapshot should be saved in the binary format
+		uint64					m_configPendingLogMark;	// The end of the value log when that snapshot was built
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<Msg*>				m_handoffMsgs;			// Messages handed over, sent once the controller's node list has been read
+OPENZWAVE_EXPORT_WARNINGS_ON
+		ValueExport*			m_valueExport;			// The values shared with other processes, if the ValueExportPath option is set.  See ValueExport.h.
+		ValueIndex*				m_valueIndex;			// The values by command class, genre, label and instance, for Manager::FindValues.  See ValueIndex.h.
+		ValueLog*				m_valueLog;				// The value changes not yet saved in the configuration, if the ValueLog option is set.  See ValueLog.h.
+		uint32					m_valueLogMaxSize;		// Bytes logged after which the configuration is saved, from the ValueLogMaxSize option
 
 	//-----------------------------------------------------------------------------
 	//	Controller
@@ -202,6 +312,7 @@ namespace OpenZWave
 		uint16 GetProductType()const{ return m_productType; }
 		uint16 GetProductId()const{ return m_productId; }
 		string GetControllerPath()const{ return m_controllerPath; }
+		uint64 GetThreadId( string const& _thread );
 		ControllerInterface GetControllerInterfaceType()const{ return m_controllerInterfaceType; }
 		string GetLibraryVersion()const{ return m_libraryVersion; }
 		string GetLibraryTypeName()const{ return m_libraryTypeName; }
@@ -235,6 +346,38 @@ namespace OpenZWave
 		 *  \see LockNodes, ReleaseNodes
 		 */
 		Node* GetNode( uint8 _nodeId );
+		/**
+		 *  Put a node object in the node array, deleting the one it replaces, and keep
+		 *  m_nodeIds in step.  Must be called with m_nodeMutex write locked.
+		 *  \param _nodeId The nodeId of the slot.
+		 *  \param _node The new node, or NULL to leave the slot empty.
+		 */
+		void SetNodeObject( uint8 const _nodeId, Node* _node );
+		/**
+		 *  Holds one node for the length of a scope.  It takes the read lock on m_nodeMutex,
+		 *  so the node cannot be removed, and then the node's own mutex, so that threads working
+		 *  on different nodes run side by side.  Only adding or removing nodes, and work that
+		 *  spans the whole network, takes m_nodeMutex for writing.
+		 *
+		 *  The locks are taken in the order m_pollMutex, m_nodeMutex, one node's mutex,
+		 *  m_healthMutex, m_sendMutex.  A thread holds at most one node's mutex, and must not
+		 *  take the write lock on m_nodeMutex while it holds a NodeGuard.
+		 */
+		class NodeGuard
+		{
+		public:
+			NodeGuard( Driver* _driver, uint8 const _nodeId );
+			~NodeGuard();
+			Node* GetNode()const{ return m_node; }
+
+		private:
+			NodeGuard( NodeGuard const& );					// prevent copy
+			NodeGuard& operator = ( NodeGuard const& );		// prevent assignment
+
+			Driver*		m_driver;
+			Node*		m_node;
+		};
+		friend class NodeGuard;
 		/**
 		 *  Lock the nodes so no other thread can modify them.
 		 */
@@ -262,9 +405,46 @@ namespace OpenZWave
 		uint8					m_initVersion;								// Version of the Serial API used by the controller.
 		uint8					m_initCaps;									// Set of flags indicating the serial API capabilities (See IsSlave, HasTimerSupport, IsPrimaryController and IsStaticUpdateController above).
 		uint8					m_controllerCaps;							// Set of flags indicating the controller's capabilities (See IsInclusionController above).
+		uint8					m_initNodeMask[NUM_NODE_BITFIELD_BYTES];	// The nodes listed in the controller's init data
+
+		// With the CachedControllerInit option, the controller's identity is read
+		// from the configuration file once the Home ID is known, and checked
+		// against the init data that follows
+		enum InitCache
+		{
+			InitCache_Off = 0,
+			InitCache_Try,						// Only the Home ID has been asked for
+			InitCache_Used,						// The identity was read from the file, and the init data has yet to confirm it
+			InitCache_Recheck					// The identity was out of date, and is being asked for again
+		};
+		InitCache				m_initCache;
+
+		// With the HotReconnect option, a controller that drops out, such as a USB stick
+		// being reset, is waited for rather than failing the driver.  Once it is back,
+		// its Home ID and node list are checked before the driver carries on.
+		bool					m_controllerLost;							// A write failed, and the controller has yet to come back
+		bool					m_reconnectCheck;							// The controller is back, and its identity is being checked
 		uint8					m_Controller_nodeId;						// Z-Wave Controller's own node ID.
-		Node*					m_nodes[256];								// Array containing all the node objects.
-		Mutex*					m_nodeMutex;								// Serializes access to node data
+		NodeTable<Node*>		m_nodes;									// The node objects, by node ID.  Written only through SetNodeObject.
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<uint16>			m_nodeIds;									// Ids of the nodes in m_nodes, in ascending order, so that loops over the nodes skip the empty slots
+OPENZWAVE_EXPORT_WARNINGS_ON
+		RWLock*					m_nodeMutex;								// Guards the node array.  Work on a single node takes the read lock through a NodeGuard.
+		volatile uint32			m_sendRoutes[256];							// How SendMsg can handle messages to each node without taking m_nodeMutex.  See SendRoute.
+
+		// Direct-mapped cache of the values found by GetValue, so repeated access to the same
+		// values skips the node's value store.  An entry is only used if ValueStore::GetGeneration
+		// has not changed since it was filled.  Readers holding the read lock on m_nodeMutex may
+		// share the cache, so each entry has a try-lock; a reader that finds it taken goes to the store.
+		struct ValueCacheEntry
+		{
+			volatile uint32	m_lock;
+			uint32			m_generation;
+			uint64			m_id;											// ValueID::GetId
+			Value*			m_value;
+		};
+		enum { c_valueCacheSize = 256 };
+		ValueCacheEntry			m_valueCache[c_valueCacheSize];
 
 		ControllerReplication*	m_controllerReplication;					// Controller replication is handled separately from the other command classes, due to older hand-held controllers using invalid node IDs.
 
@@ -286,6 +466,9 @@ namespace OpenZWave
 		void HandleSetSUCNodeIdResponse( uint8* _data );
 		void HandleGetSUCNodeIdResponse( uint8* _data );
 		void HandleMemoryGetIdResponse( uint8* _data );
+		void HandleReconnect();
+		void QueueIdentityRequests();
+		void QueueInitData();
 		/**
 		 *  Process a response to a FUNC_ID_SERIAL_API_GET_INIT_DATA request.
 		 *  <p>
@@ -348,6 +531,9 @@ namespace OpenZWave
 	//-----------------------------------------------------------------------------
 	//	Polling Z-Wave devices
 	//-----------------------------------------------------------------------------
+	public:
+		void AdaptValuePollInterval( Value* _value, uint32 const _milliseconds );	// Called by command classes on the driver thread to change how often a value is polled
+
 	private:
 		int32 GetPollInterval(){ return m_pollInterval ; }
 		void SetPollInterval( int32 _milliseconds, bool _bIntervalBetweenPolls ){ m_pollInterval = _milliseconds; m_bIntervalBetweenPolls = _bIntervalBetweenPolls; }
@@ -355,21 +541,69 @@ namespace OpenZWave
 		bool DisablePoll( const ValueID &_valueId );
 		bool isPolled( const ValueID &_valueId );
 		void SetPollIntensity( const ValueID &_valueId, uint8 _intensity );
+		void SetValuePollInterval( const ValueID &_valueId, uint32 _milliseconds );
 		static void PollThreadEntryPoint( Event* _exitEvent, void* _context );
 		void PollThreadProc( Event* _exitEvent );
+		int32 PollStep( bool* o_waitForIdle );							// One pass of the poll thread's work.  Returns how long to wait before the next.
+		uint32 GetPollTicks( Value const* _value );						// Time until a value should be polled again, in poll wheel ticks
+		uint32 GetPollPhaseTicks( ValueID const& _valueId, uint32 _interval );	// Time until a value's own slot in its poll interval comes round, in poll wheel ticks
+		int32 GetPollSpacing();												// Minimum time between two polls, in milliseconds
+		bool IsSendIdle()const;												// True if nothing is being sent that a poll should wait for.  Driver thread only, with m_sendMutex locked.
+		void PollNode( Node* _node, list<ValueID> const& _valueIds );		// Request a batch of values that came due together on one node
+		void FlushPollBatch( Node* _node, uint32 _valueCount );			// Send the requests collected by PollNode, coalescing them where possible
+		static void RemoveDuplicateRequests( list<Msg*>& _batch );			// Drop requests whose payload is the same as an earlier one's
+
+		// A value refresh triggered by a change to another value (see CommandClass::CheckForRefreshValues)
+		struct TriggeredRefresh
+		{
+			uint8	m_commandClassId;
+			uint8	m_requestFlags;
+			uint8	m_instance;
+			uint8	m_index;
 
-		Thread*					m_pollThread;								// Thread for polling devices on the Z-Wave network
-		struct PollEntry
+			bool operator == ( TriggeredRefresh const& _other )const{ return m_commandClassId == _other.m_commandClassId && m_requestFlags == _other.m_requestFlags && m_instance == _other.m_instance && m_index == _other.m_index; }
+		};
+		bool CollectTriggeredRefresh( uint8 const _nodeId, uint8 const _commandClassId, uint8 const _requestFlags, uint8 const _instance, uint8 const _index );	// False if the refresh should be requested at once
+		void FlushTriggeredRefreshes( uint8 const _nodeId );				// Request the refreshes triggered while a node's frame was handled, packed together
+		void AddFloodedNode( uint8 const _nodeId );							// A node has reports held back by its rate limit (see Node::TakeRxCredit)
+		int32 ReleaseHeldFrames();											// Handles the held reports that are due, returning the milliseconds until the next are, or -1
+
+		// The Version and MultiInstance reports of the first node interviewed of a product (see Node::ReplayProductDiscovery)
+		struct ProductDiscovery
 		{
-			ValueID	m_id;
-			uint8	m_pollCounter;
+			string					m_applicationVersion;
+			list< vector<uint8> >	m_reports;									// Each starting with its command class id
 		};
+
+		Thread*					m_pollThread;								// Thread for polling devices on the Z-Wave network
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		TimerWheel				m_pollWheel;								// Polled values, scheduled by when they are next due
+		list<ValueID>			m_pollDue;									// Values whose poll is due, in the order they came due
+		list<Msg*>				m_pollBatch;								// Poll requests collected for m_pollBatchNodeId
+		list<Msg*>				m_setBatch;									// Commands collected for m_setBatchNodeId
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint8					m_pollBatchNodeId;							// While non-zero, poll requests for this node are collected rather than queued
+		uint64					m_pollBatchThreadId;						// The thread that set m_pollBatchNodeId.  Only its own requests are collected.
+		uint8					m_setBatchNodeId;							// While non-zero, SetValues, FlushTriggeredRefreshes or RefreshThermostat collects the commands sent to this node.  Guarded by m_nodeMutex.
 OPENZWAVE_EXPORT_WARNINGS_OFF
-		list<PollEntry>			m_pollList;									// List of nodes that need to be polled
+		list<TriggeredRefresh>	m_triggeredRefreshes;						// Refreshes triggered while the frame from m_triggerNodeId is handled
+		list<uint8>				m_floodedNodes;								// Nodes with reports held back.  Driver thread only.
+		map<string,ProductDiscovery>	m_productDiscovery;					// Keyed by Node::GetProductKey().  Driver thread only.
+		map<string,ProductDiscovery>	m_productSecurity;					// The SecurityCmd_SupportedReport of the first secure node of each product, as its only report (see Node::ReplaySecuredClasses).  Driver thread only.
 OPENZWAVE_EXPORT_WARNINGS_ON
+		uint8					m_triggerNodeId;							// While non-zero, refreshes triggered on this node are collected.  Guarded by m_triggerMutex.
+		Mutex*					m_triggerMutex;
+		Event*					m_pollEvent;								// Signalled when the poll schedule changes
+		Event*					m_sendIdleEvent;							// Signalled by the driver thread when the send queues are empty
+		volatile bool			m_sendIdle;									// Whether m_sendIdleEvent is set, so the poll thread need not look at the queues
 		Mutex*					m_pollMutex;								// Serialize access to the polling list
 		int32					m_pollInterval;								// Time interval during which all nodes must be polled
 		bool					m_bIntervalBetweenPolls;					// if true, the library intersperses m_pollInterval between polls; if false, the library attempts to complete all polls within m_pollInterval
+		TimeStamp				m_pollLastTick;								// When the poll wheel was last advanced
+		TimeStamp				m_pollNext;									// Earliest time the next poll may be sent
+		TimeStamp				m_pollBusySince;							// When polls started waiting for the send queues
+		bool					m_pollWaitingForIdle;
+		bool					m_pollWarned;								// The poll queue has been reported as stuck
 
 	//-----------------------------------------------------------------------------
 	//	Retrieving Node information
@@ -406,6 +640,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		uint8 GetNodeSpecific( uint8 const _nodeId );
 		string GetNodeType( uint8 const _nodeId );
 		uint32 GetNodeNeighbors( uint8 const _nodeId, uint8** o_neighbors );
+		uint8 const* GetNodeNeighborBitmap( uint8 const _nodeId );
+		uint32 GetNetworkTopology( uint8* o_topology, uint32 const _version );
 
 		string GetNodeManufacturerName( uint8 const _nodeId );
 		string GetNodeProductName( uint8 const _nodeId );
@@ -432,6 +668,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void SetNodeOff( uint8 const _nodeId );
 
 		Value* GetValue( ValueID const& _id );
+		bool SetValues( vector< pair<ValueID,string> > const& _values );	// Set several values, MultiCmd encapsulating each node's commands where possible
+		bool RefreshThermostat( uint8 const _nodeId, int32 const _maxAge );	// Request a thermostat's stale values together, MultiCmd encapsulated where possible
 
 		bool IsAPICallSupported( uint8 const _apinum )const{ return (( m_apiMask[( _apinum - 1 ) >> 3] & ( 1 << (( _apinum - 1 ) & 0x07 ))) != 0 ); }
 		void SetAPICall( uint8 const _apinum, bool _toSet )
@@ -548,13 +786,52 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		};
 
 		ControllerCommandItem*			m_currentControllerCommand;
+		TimeStamp				m_controllerStepDue;			// When the current command's step is given up, if it has not moved on
+		int32					m_controllerStepTimeout;		// ms a step may take, or 0 for no limit
 
 		void DoControllerCommand();
 		void UpdateControllerState( ControllerState const _state, ControllerError const _error = ControllerError_None );
+		int32 CheckControllerCommandStep();									// Gives up a command whose step is overdue, returning the ms until the step is due, or -1
+		static bool IsExclusiveControllerCommand( ControllerCommand const _command );	// The command must have the controller to itself, rather than overlap the other queues
+		bool IsControllerCommandMsg( Msg const* _msg )const;				// The message was sent by the current controller command
 
 		uint8					m_SUCNodeId;
 
 		void UpdateNodeRoutes( uint8 const_nodeId, bool _doUpdate = false );
+		void ScheduleNodeRoutes( uint8 const _nodeId );						// Update a node's return routes once its associations have stopped changing
+		int32 RunRouteUpdates();											// Update the return routes that are due.  Returns the time until it should be called again.
+
+		uint32					m_routesPending[8];					// One bit per node whose return routes are to be updated.  Guarded by m_healthMutex.
+		TimeStamp				m_routesDue;						// When they are, a while after the last association change
+
+		/**
+		 * \brief Set the clocks of the nodes with the Clock or Time Parameters command class, from the poll thread.
+		 *
+		 * Listening nodes are set a node at a time, half a second apart.  The set for a sleeping
+		 * node is queued until it wakes, replacing any set already waiting, and the time in it is
+		 * brought up to date as the node wakes.  Once the clocks have been set, the host's local
+		 * time is checked against its monotonic clock every minute, and if it has moved by
+		 * TimeSyncMaxDrift seconds or more, as it does when daylight saving starts or ends or NTP
+		 * steps the clock, they are all set again.  Smaller moves are left alone, as the Clock
+		 * command class only counts minutes.  Guarded by m_healthMutex.
+		 */
+		uint32 SyncTime();													// Returns the number of nodes with a clock
+		bool SetNodeTime( Node* _node, time_t const _time );				// Set each clock a node has.  False if it has none.
+		void RestageTimeSync( Node* _node );								// A sleeping node is waking, so bring the set waiting for it up to date
+		void CheckHostClock();												// Set the clocks again if the host's local time has moved
+		int32 RunTimeSync();												// Set the clocks that are due.  Returns the time until it should be called again.
+
+		bool					m_timeSync;							// TimeSync option: set the clocks once the listening nodes have been queried
+		bool					m_timeSyncStarted;					// The clocks have been set, so the host's clock is being watched
+		int32					m_timeSyncMaxDrift;					// Seconds the local time may move before the clocks are set again
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<uint8>				m_timeSyncQueue;					// Nodes whose clocks are still to be set
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32					m_timeSyncStaged[8];				// One bit per sleeping node with a set waiting in its wake up queue
+		TimeStamp				m_timeSyncNext;						// When the next listening node may be set
+		TimeStamp				m_timeSyncCheck;					// When the host's clock is next checked
+		uint64					m_timeSyncTicks;					// TimeStamp::GetTicksNs when the clocks were last set
+		int64					m_timeSyncLocal;					// and the local time then, in seconds
 
 		Event*					m_controllerResetEvent;
 
@@ -582,6 +859,14 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		uint8 GetTransmitOptions()const{ return m_transmitOptions; }
 
+		/**
+		 * Fetch the transmit options to use for a node.  Explore frames are left out for
+		 * a node that is a direct neighbour of the controller and has had every recent
+		 * message delivered, since route discovery cannot help it.  Only call from the
+		 * driver thread.
+		 */
+		uint8 GetTransmitOptions( uint8 const _nodeId );
+
 	private:
 		/**
 		 *  If there are messages in the send queue (m_sendQueue), gets the next message in the
@@ -603,13 +888,34 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		bool WriteNextMsg( MsgQueue const _queue );							// Extracts the first message from the queue, and makes it the current one.
 		bool WriteMsg( string const &str);									// Sends the current message to the Z-Wave network
 		void RemoveCurrentMsg();											// Deletes the current message and cleans up the callback etc states
+		uint32 SendBatch( Node* _node, list<Msg*>& _batch, MsgQueue const _queue, uint32& _encapsulated );	// Queue a node's messages, MultiCmd encapsulated where possible
 		bool MoveMessagesToWakeUpQueue(	uint8 const _targetNodeId, bool const _move );		// If a node does not respond, and is of a type that can sleep, this method is used to move all its pending messages to another queue ready for when it wakes up next.
 		bool HandleErrorResponse( uint8 const _error, uint8 const _nodeId, char const* _funcStr, bool _sleepCheck = false );									    // Handle data errors and process consistently. If message is moved to wake-up queue, return true.
 		bool IsExpectedReply( uint8 const _nodeId );						// Determine if reply message is the one we are expecting
 		void SendQueryStageComplete( uint8 const _nodeId, Node::QueryStage const _stage );
 		void RetryQueryStageComplete( uint8 const _nodeId, Node::QueryStage const _stage );
+		bool StartInterview( Node* _node );									// False if the node must wait for other nodes' queries to finish first
+		void PauseInterview( uint8 const _nodeId );							// The node is asleep or dead, so another node can be queried meanwhile
+		void EndInterview( uint8 const _nodeId );							// The node's queries are complete, or it has been removed
+		void AdmitInterviews();												// Let the most urgent waiting nodes be queried
 		void CheckCompletedNodeQueries();									// Send notifications if all awake and/or sleeping nodes have completed their queries
 
+		// What SendMsg last found out about a node, so that it can queue most messages
+		// without taking m_nodeMutex.  The low byte holds the flags and the node's query
+		// priority, and the rest counts the changes, so that a route worked out under the
+		// lock is not stored over a change made meanwhile.  The fast path is only taken
+		// for nodes that have no secured command classes and are listening or awake,
+		// so only changes that could end that need to clear the route.
+		enum SendRoute
+		{
+			SendRoute_Direct		= 0x01,								// Messages need neither encrypting nor holding for the node to wake
+			SendRoute_PriorityShift	= 1,
+			SendRoute_PriorityMask	= 0x06,
+			SendRoute_ChangeShift	= 8
+		};
+		uint32 GetSendRoute( Node const* _node )const;						// Works out the route for a node.  Called with m_nodeMutex held.
+		void InvalidateSendRoute( uint8 const _nodeId );					// Called when a node's listening, awake or secured state, or query priority, changes
+
 		// Requests to be sent to nodes are assigned to one of five queues.
 		// From highest to lowest priority, these are
 		//
@@ -659,7 +965,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 				m_nodeId(0),
 				m_queryStage(Node::QueryStage_None),
 				m_retry(false),
-				m_cci(NULL)
+				m_cci(NULL),
+				m_queued(0)
 			{}
 
 			bool operator == ( MsgQueueItem const& _other )const
@@ -689,22 +996,573 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 			Node::QueryStage		m_queryStage;
 			bool				m_retry;
 			ControllerCommandItem*		m_cci;
+			uint32				m_queued;		// When the item was put on its queue, set by NodeMsgQueue
 		};
 
+		static uint32 GetMemoryUsage( MsgQueueItem const& _item );		// Bytes used by a queued item and what it owns, including its list entry
+
+		/**
+		 * \brief A single priority level of the send queue.
+		 *
+		 * Items are held in one FIFO per node, and the nodes with pending items take
+		 * turns using deficit round-robin scheduling, with the frame length as the cost.
+		 * The order of items for any one node is preserved, but a node with a long
+		 * backlog can no longer hold up the others.  All of a node's items can be
+		 * removed without searching the rest of the queue.
+		 *
+		 * Nodes can also be given a priority, lower values first.  A node only gets a
+		 * turn while no node with a lower value has items waiting, so the round-robin
+		 * is between the nodes of the most urgent priority.
+		 */
+		class NodeMsgQueue
+		{
+		public:
+			NodeMsgQueue();
+
+			bool empty()const{ return( m_size == 0 ); }
+			size_t size()const{ return m_size; }
+
+			/** Next item to be sent.  Stays the same until the queue is modified. */
+			MsgQueueItem& front(){ return m_nodeQueue[m_active.front()].front(); }
+			void pop_front();
+			/**
+			 * Add an item to the end of its node's queue, unless it can be merged with one already there.
+			 * A request identical to a queued one that expects a report is dropped, and a supersedable Set
+			 * takes the place of the queued Set of the same value.  Either way the message left over is deleted.
+			 * \return false if the item was merged.
+			 */
+			bool push_back( MsgQueueItem const& _item );
+			/** Put an item back at the head of its node's queue and give that node the next turn. */
+			void push_front( MsgQueueItem const& _item );
+
+			/** The items queued for one node.  They may be changed in place, but not added or removed. */
+			list<MsgQueueItem>& GetNodeItems( uint8 const _nodeId ){ return m_nodeQueue[_nodeId]; }
+			/** Move all the items queued for one node onto the end of _items. */
+			void TakeNodeItems( uint8 const _nodeId, list<MsgQueueItem>& _items );
+
+			static uint8 GetItemNodeId( MsgQueueItem const& _item );
+
+			/** Set a node's priority.  Nodes default to zero, the most urgent. */
+			void SetNodePriority( uint8 const _nodeId, uint8 const _priority );
+
+			/** Milliseconds since an item was put on the queue. */
+			int32 GetWaitTime( MsgQueueItem const& _item ){ return( -m_epoch.TimeRemaining() - (int32)_item.m_queued ); }
+
+		private:
+			static uint32 GetItemCost( MsgQueueItem const& _item );
+			list<uint8>::iterator Place( uint8 const _nodeId, list<uint8>::iterator const _first );
+			list<uint8>::iterator AfterFront();
+			void Activate( uint8 const _nodeId );
+			void Deactivate( uint8 const _nodeId );
+			void NextTurn();
+			void Schedule();
+			void Unindex( list<MsgQueueItem>::iterator const& _it );	// Forget an item that is leaving its node's queue
+
 OPENZWAVE_EXPORT_WARNINGS_OFF
-		list<MsgQueueItem>			m_msgQueue[MsgQueue_Count];
+			list<MsgQueueItem>		m_nodeQueue[256];				// Items waiting for each node
+			list<uint8>			m_active;						// Nodes with items waiting, the one at the front has the current turn
+			list<uint8>::iterator		m_activePos[256];				// Position of each node in m_active
+			map<uint64,list<MsgQueueItem>::iterator>	m_coalesce;	// Queued requests that later ones can be merged with, by Msg::GetCoalesceKey
 OPENZWAVE_EXPORT_WARNINGS_ON
+			bool				m_isActive[256];
+			uint8				m_priority[256];
+			uint32				m_deficit[256];					// Bytes each node may still send in its current turn
+			size_t				m_size;
+			TimeStamp			m_epoch;						// Items are stamped with the milliseconds since this
+		};
+
+		NodeMsgQueue			m_msgQueue[MsgQueue_Count];
 		Event*					m_queueEvent[MsgQueue_Count];		// Events for each queue, which are signaled when the queue is not empty
 		Mutex*					m_sendMutex;						// Serialize access to the queues
 		Msg*					m_currentMsg;
 		MsgQueue				m_currentMsgQueueSource;			// identifies which queue held m_currentMsg
 		TimeStamp				m_resendTimeStamp;
 
+		/**
+		 * \brief Messages held back from a node that is presumed dead.
+		 *
+		 * With the CircuitBreaker option set, messages for a dead node are parked here
+		 * rather than sent and dropped, so it uses no more of the network's time.  The
+		 * node is probed with a NoOperation at intervals that double up to a limit,
+		 * and when it answers one (or anything else) the parked messages go back on
+		 * the queues they came from.
+		 */
+		struct Circuit
+		{
+			bool					m_open;							// True while the node is presumed dead
+			int32					m_probeInterval;				// ms between the last probe and the next
+			TimeStamp				m_nextProbe;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+			list< pair<MsgQueue,MsgQueueItem> >	m_parked;
+OPENZWAVE_EXPORT_WARNINGS_ON
+		};
+
+		void OpenCircuit( uint8 const _nodeId );							// The node is presumed dead, so park its messages and start probing it
+		void CloseCircuit( uint8 const _nodeId );							// The node has answered, so requeue its parked messages
+		bool ParkMsg( MsgQueueItem const& _item, MsgQueue const _queue );	// Park a message if its node's circuit is open.  Must be called with m_sendMutex locked.
+		int32 ProbeDeadNodes();												// Probe the dead nodes that are due.  Returns the time until the next probe.
+
+		bool					m_circuitBreaker;
+		Circuit					m_circuits[256];
+
+		/**
+		 * \brief When a listening node was last heard from, to find the ones that have gone quiet.
+		 *
+		 * With the LivenessInterval option set, a listening node that has neither sent a frame
+		 * nor acknowledged one for that long is sent a NoOperation on the NoOp queue, so a node
+		 * that has died is found before anything else is sent to it.  A node that is usually
+		 * heard from more often is probed after three of its usual gaps instead, though never
+		 * within c_minLivenessQuiet.  Each quiet spell is shortened by up to a quarter, by an
+		 * amount that depends on the node and the spell, so probes are spread out, and only one
+		 * is sent at a time.  A node that does not answer is presumed dead, and is then probed
+		 * as the circuit breaker does, at intervals that double up to a limit.
+		 */
+		struct Liveness
+		{
+			volatile uint32			m_lastHeard;					// ms since m_startTime, or 0 if never.  Written by the driver thread.
+			volatile uint32			m_meanGap;						// Smoothed ms between the times the node is heard, or 0 if not yet known
+			uint32					m_probed;						// m_lastHeard when the node was last probed.  Used by the poll thread.
+		};
+
+		void NoteHeard( uint8 const _nodeId );								// A frame came from the node, or it acknowledged one
+		int32 ProbeQuietNodes();											// Probe a listening node that has been quiet too long.  Returns the time until the next may be due.
+		bool IsProbingDeadNodes()const{ return( m_circuitBreaker || m_livenessInterval ); }
+
+		int32					m_livenessInterval;					// Longest quiet time before a listening node is probed, in ms, or 0 for no probes
+		Liveness				m_liveness[256];
+
+		bool IsDuplicateFrame( Node* _node, uint8 const* _data );			// Whether a frame repeats the node's last one of the same command within m_duplicateWindow, noting it if not
+
+		uint32					m_duplicateWindow;					// ms within which a repeated frame from a node is dropped, or 0 to keep them all
+
+		/** A frame that a standby controller of the network received, for the primary to handle */
+		struct ForwardedFrame
+		{
+			vector<uint8>	m_data;			// The FUNC_ID_APPLICATION_COMMAND_HANDLER request
+			bool			m_encrypted;
+		};
+
+		bool IsStandby()const;												// True if another controller of the network has the nodes, and this one only carries messages
+		void QueueForwardedFrame( uint8 const* _data, bool const _encrypted );	// Take a frame a standby received, for the driver thread to handle
+		void HandleForwardedFrames();										// Handle the frames passed on by the standbys
+
+		ControllerGroup* volatile	m_group;						// The network's other controllers, or NULL.  Set by the Manager.
+		Mutex*					m_forwardMutex;						// Guards m_forwardedFrames
+		list<ForwardedFrame>	m_forwardedFrames;
+		bool					m_handlingForwarded;				// Set while the driver thread handles a forwarded frame
+
+		/**
+		 * \brief A token bucket limiting the share of the radio's time a queue may use.
+		 *
+		 * Each frame sent is charged its estimated airtime, worked out by EstimateAirtime from
+		 * its length, the node's speed and whether it has to be routed.  The bucket refills at
+		 * m_share percent of real time, up to m_burst, and while it is in debt the driver thread
+		 * takes nothing from the queue.  Background queues limited this way cannot hold up the
+		 * unlimited interactive ones for long.  Set up from the SendShaping option, and only
+		 * used by the driver thread.
+		 */
+		struct SendShaper
+		{
+			int32					m_share;						// Percentage of the time the queue may use, or 0 for no limit
+			int32					m_burst;						// Most airtime that can be saved up, in microseconds
+			int32					m_tokens;						// Airtime the queue may still use, in microseconds
+			TimeStamp				m_refilled;
+		};
+
+		void ReadSendShaping();
+		uint32 EstimateAirtime( Msg* _msg, Node* _node );					// Radio time taken by a message and its acks, in microseconds
+		void ChargeAirtime( MsgQueue const _queue, Node* _node, uint32 const _airtime );
+		int32 GetShapedQueues( uint32* o_blocked );							// Set a bit for each queue that must wait.  Returns the time until the first may send.
+
+		SendShaper				m_shapers[MsgQueue_Count];
+		uint64					m_queueAirtime[MsgQueue_Count];		// Estimated airtime used by each queue, in microseconds
+
+		/**
+		 * Requests for reports, such as polls and refreshes, that wait on a congested queue
+		 * past its deadline are dropped when they reach its front rather than sent, as the
+		 * value will be asked for again anyway.  A message can also be given a deadline of
+		 * its own with Msg::SetMaxQueueTime.  Set up from the QueueDeadlines option.
+		 */
+		void ReadQueueTimes( char const* _option, uint32* o_times );		// Read queue=ms entries from an option into a time for each queue
+		bool IsExpired( MsgQueue const _queue, MsgQueueItem const& _item );	// Must be called with m_sendMutex locked
+
+		uint32					m_queueDeadline[MsgQueue_Count];	// Longest wait for a request on each queue, in ms, or 0 for no limit
+		bool					m_notifyExpired;					// Send a Code_Expired notification for each message dropped
+
+		/**
+		 * The driver thread takes from the queues in order, so a busy Send queue can hold
+		 * up the Query and Poll queues, and Query can hold up Poll, for as long as it stays
+		 * busy.  Once the item at the front of a queue has waited longer than the queue's
+		 * aging time, the busier background queues ahead of it are passed over until it has
+		 * sent a message, which gives each a share of the radio however busy the others are.
+		 * The queues ahead of Send are never passed over.  Set up from the QueueAging option.
+		 */
+		uint32 GetAgedQueues( uint32 const _count, uint32 const _blocked );	// Returns a bit for each queue to pass over
+
+		uint32					m_queueAging[MsgQueue_Count];		// Longest wait on each queue before it goes ahead of busier ones, in ms, or 0 for never
+		uint32					m_queueAged[MsgQueue_Count];		// Times each queue has gone ahead of busier ones
+
+		/**
+		 * \brief A nonce that a node has sent ahead of the message that will use it.
+		 *
+		 * With the NoncePrefetch option set, an encrypted message to a node that has more
+		 * encrypted messages queued is sent as a MessageEncapNonceGet, so the node sends
+		 * its next nonce straight back.  The nonce is kept here, and if it has not expired
+		 * by the time the next message is sent, that message needs no NonceGet round trip.
+		 */
+		struct PrefetchedNonce
+		{
+			bool					m_valid;
+			uint8					m_nonce[8];
+			TimeStamp				m_expires;
+		};
+
+		bool HasQueuedEncryptedMsg( uint8 const _nodeId );					// True if an encrypted message for the node is waiting in the send queues
+		bool TakePrefetchedNonce( uint8 const _nodeId, uint8* _nonce );		// Use up the node's prefetched nonce, if it has one that has not expired
+
+		bool					m_noncePrefetch;
+		uint8					m_nonceRequested;							// Node that the current message's NonceGet went to, or zero
+		PrefetchedNonce			m_prefetchedNonces[256];
+
+		/**
+		 * \brief A ZW_SEND_DATA request that the controller has accepted, and that is now only
+		 * waiting for its callback and/or reply.  While it waits, messages to other nodes can
+		 * be sent.  Only used when the MaxInFlightMsgs option is greater than one.
+		 */
+		struct InFlightMsg
+		{
+			Msg*					m_msg;
+			MsgQueue				m_queue;
+			uint8					m_expectedCallbackId;
+			uint8					m_expectedReply;
+			uint8					m_expectedCommandClassId;
+			uint8					m_expectedNodeId;
+			TimeStamp				m_retryTimeStamp;
+		};
+
+		bool PipelineCurrentMsg( TimeStamp& _retryTimeStamp );				// Move the current message in flight, so that the next one can be sent
+		bool ResumeInFlightMsg();											// Make a timed out in flight message the current one again, so that it can be resent
+		bool ProcessInFlightMsg( uint8* _data );							// Process a frame that belongs to an in flight message
+		bool CanPipelineNextMsg();											// True if the next queued item does not have to wait for the in flight messages
+		int32 GetInFlightTimeout();											// Time until the first in flight message times out
+		bool IsNodeInFlight( uint8 const _nodeId )const;
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map<uint8,InFlightMsg*>	m_inFlight;							// In flight messages, keyed by callback ID
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32					m_maxInFlight;						// Number of messages that may be outstanding at once, including the current one
+		bool					m_sendDataAccepted;					// True once the controller has accepted the current ZW_SEND_DATA request
+
+		void UpdateRetryTimeout( Node* _node, uint32 const _rtt );			// Add a round trip time to a node's retry timeout estimate
+		int32 GetRetryTimeout( int32 const _retryTimeout );				// How long to wait for the current message before sending it again
+		bool					m_adaptiveRetryTimeout;				// If true, each node's retry timeout is estimated from its round trip times
+
+		/**
+		 * \brief Letting more urgent messages go ahead of a background one that is waiting for its reply.
+		 *
+		 * Once the controller has delivered a query or poll, the radio is free until the node
+		 * replies, but the driver would otherwise wait up to the retry timeout before sending
+		 * anything else.  With the DeferBackgroundMsgs option set, a message from the Query or
+		 * Poll queue in that state goes back to the front of its queue as soon as an item
+		 * arrives on a more urgent queue.  Each deferral uses up one of the message's attempts,
+		 * so it is never deferred on its last one.
+		 */
+		bool CanDeferCurrentMsg();											// True if the current message may give way
+		void DeferCurrentMsg();												// Put the current message back on its queue
+
+		bool					m_deferBackgroundMsgs;
+
+		enum InterviewState
+		{
+			InterviewState_None = 0,
+			InterviewState_Waiting,											// Waiting for other nodes' queries to finish
+			InterviewState_Running,
+			InterviewState_Paused											// Asleep or dead, so not counted against m_maxInterviews
+		};
+
+		struct Interview
+		{
+			InterviewState			m_state;
+			Node::QueryPriority		m_priority;
+			Node::QueryStage		m_stage;							// Stage to resume at once a waiting node is let through
+		};
+
+		Mutex*					m_interviewMutex;
+		uint32					m_maxInterviews;					// Number of nodes that may be queried at once, or zero for no limit
+		uint32					m_interviewCount;					// Number of nodes in InterviewState_Running
+		Interview				m_interviews[256];
+
 	//-----------------------------------------------------------------------------
 	// Network functions
 	//-----------------------------------------------------------------------------
 	private:
 		void TestNetwork( uint8 const _nodeId, uint32 const _count );
+		bool BeginHealthScan( uint16 const _frames );
+		bool GetLinkQuality( uint8 const _nodeA, uint8 const _nodeB, uint8* o_percent );
+		uint32 GetLinkQualities( vector<LinkQuality>* o_links );
+
+		/**
+		 * \brief A test of every link between neighbouring nodes, made with Powerlevel test frames.
+		 *
+		 * Each link is tested by the node at one end, which must support Powerlevel and be
+		 * listening, sending test frames to the other.  Links are tested in rounds, with any
+		 * number under test at once as long as no node of one is the same as, or a neighbor
+		 * of, a node of another, so the test frames do not collide.  The poll thread starts
+		 * the tests and asks for their results, and the reports come back through
+		 * OnLinkTestReport.
+		 */
+		struct HealthLink
+		{
+			LinkQuality				m_quality;
+			bool					m_running;
+			bool					m_done;
+			uint8					m_checks;						// Reports asked for since the test started
+			int32					m_nextCheck;					// Milliseconds since m_healthEpoch
+		};
+
+		int32 RunHealthScan();												// Start the link tests that can go next, and check the running ones.  Returns the time until it next needs to run.
+		void OnLinkTestReport( uint8 const _sourceId, uint8 const _targetId, uint8 const _status, uint16 const _acked );	// Called by Powerlevel with the result of a link test
+		bool IsLinkBlocked( HealthLink const& _link, uint8 const* _busy );	// Whether a link's nodes are busy, or could hear a busy node
+		void SetBit( uint8* _mask, uint8 const _nodeId ){ _mask[( _nodeId - 1 ) >> 3] |= (uint8)( 1 << ( ( _nodeId - 1 ) & 7 ) ); }
+		bool IsBitSet( uint8 const* _mask, uint8 const _nodeId )const{ return ( _mask[( _nodeId - 1 ) >> 3] & ( 1 << ( ( _nodeId - 1 ) & 7 ) ) ) != 0; }
+
+		Mutex*					m_healthMutex;
+		bool					m_healthScanning;
+		uint16					m_healthFrames;						// Test frames sent over each link
+		TimeStamp				m_healthEpoch;						// When the scan started
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<HealthLink>		m_healthLinks;
+OPENZWAVE_EXPORT_WARNINGS_ON
+
+		/**
+		 * \brief Neighbor lists refreshed one node at a time, as they go out of date.
+		 *
+		 * m_topology holds the last neighbor list read for each node, which can be
+		 * queried without any radio traffic.  A node's list is marked stale when a message
+		 * to it fails or finds no route, or when another node's new list disagrees with it.
+		 * With the NeighborRefreshInterval option set, the poll thread has one stale node
+		 * at a time rediscover its neighbors, no more often than that interval, rather than
+		 * sweeping the whole network the way HealNetwork does.  The stale mask is guarded
+		 * by m_healthMutex.
+		 */
+		void MarkNeighborsStale( uint8 const _nodeId );					// Note that a node's neighbor list may be out of date
+		void UpdateNeighbors( Node* _node, uint8 const* _neighbors );		// Store a node's new neighbor list, marking the nodes it now disagrees with
+		int32 RefreshStaleNeighbors();										// Start the next neighbor refresh if one is due.  Returns the time until the next one.
+		bool IsNeighborInfoStale( uint8 const _nodeId );
+		bool AreNeighbors( uint8 const _nodeA, uint8 const _nodeB );
+		uint8 const* GetNeighborRow( uint8 const _nodeId )const{ return ( _nodeId > 0 && _nodeId <= NUM_NODE_BITFIELD_BYTES*8 ) ? m_topology[_nodeId-1] : c_noNeighbors; }
+		uint32 HealStaleNodes( bool const _doRR );
+
+		int32					m_neighborRefreshInterval;			// ms between neighbor refreshes, or 0 for none
+		uint8					m_staleNeighbors[NUM_NODE_BITFIELD_BYTES];
+		uint8					m_topology[NUM_NODE_BITFIELD_BYTES*8][NUM_NODE_BITFIELD_BYTES];	// Each node's neighbor bitmap, by node ID - 1.  Written with m_nodeMutex write locked.
+		uint32					m_topologyVersion;					// Changed whenever m_topology is
+		static uint8 const		c_noNeighbors[NUM_NODE_BITFIELD_BYTES];	// The row for a node ID outside m_topology
+		uint8					m_neighborRefreshNode;				// The node last refreshed, so the others get their turn
+		TimeStamp				m_nextNeighborRefresh;
+
+		/**
+		 * \brief HealNetwork spread out over time, so the network stays usable while it runs.
+		 *
+		 * The nodes are healed one at a time, those with the worst links first.  A step is a
+		 * neighbor update and, if asked for, the return routes, and lasts until the controller
+		 * has nothing left to do.  The next step waits until healing has used no more than the
+		 * HealAirtimeShare option's percentage of the time, and for as long as application
+		 * messages are waiting to be sent.  The nodes still to be healed are saved with the
+		 * network configuration, so a heal carries on after a restart.  Guarded by m_healthMutex.
+		 */
+		void BeginHeal( bool const _doRR );
+		uint32 CancelHeal();
+		uint32 GetHealRemaining();
+		int32 RunHeal();													// Start the next heal step if it is due.  Returns the time until it should be called again.
+		uint32 GetLinkBadness( Node* _node );								// Higher for nodes whose messages more often fail
+
+		int32					m_healShare;						// Most percentage of the time heal steps may take
+		bool					m_healRR;							// Whether return routes are updated too
+		uint8					m_healNode;							// The node whose heal step is running, or 0
+		TimeStamp				m_healStepStart;
+		TimeStamp				m_nextHealStep;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<uint8>				m_healQueue;						// Nodes still to be healed, worst first
+OPENZWAVE_EXPORT_WARNINGS_ON
+
+	public:
+		/** Which values a refresh round requests.  Combine with |. */
+		enum RefreshFilter
+		{
+			RefreshFilter_Static	= 0x01,		/**< Values that never change. */
+			RefreshFilter_Session	= 0x02,		/**< Values that change infrequently. */
+			RefreshFilter_Dynamic	= 0x04		/**< Values that change, as requested by RequestNodeDynamic. */
+		};
+
+		/** The outcome of a refresh round, or its progress while it runs */
+		struct RefreshRoundData
+		{
+			bool	m_running;
+			uint32	m_nodes;					// Nodes whose values were requested
+			uint32	m_sleeping;					// Sleeping nodes, which will be refreshed when they next wake
+			uint32	m_skipped;					// Nodes presumed dead, or removed during the round
+			uint32	m_requests;					// Requests sent
+			uint32	m_duration;					// ms from the start of the round to the last reply
+		};
+
+		/** The stage a firmware update started by Manager::BeginFirmwareUpdate has reached */
+		enum FirmwareUpdateState
+		{
+			FirmwareUpdateState_Idle = 0,			/**< No update has been started */
+			FirmwareUpdateState_MetaData,			/**< Asking the node which firmware it runs */
+			FirmwareUpdateState_Requesting,			/**< Asking the node to take the image */
+			FirmwareUpdateState_Transferring,		/**< Sending fragments as the node asks for them */
+			FirmwareUpdateState_Verifying,			/**< The last fragment has been sent, and the node is checking the image */
+			FirmwareUpdateState_Complete,			/**< The node has taken the image */
+			FirmwareUpdateState_Failed				/**< The node refused the image, or could not use it.  See m_status. */
+		};
+
+		/** The progress of a firmware update, or its outcome once it is over */
+		struct FirmwareUpdateData
+		{
+			FirmwareUpdateState	m_state;
+			uint8	m_status;					// Status from the node's Request Report or Status Report, 0 until it sends one
+			uint16	m_fragmentSize;				// Bytes of image in each fragment
+			uint32	m_fragments;				// Fragments in the image
+			uint32	m_highest;					// Highest fragment the node has asked for
+			uint32	m_sent;						// Fragments sent, counting any the node asked for again
+			uint32	m_elapsed;					// ms from the node taking the request to the end of the transfer, or until now
+			uint32	m_bytesPerSecond;			// Image bytes sent per second over m_elapsed
+		};
+
+		/** The stage a controller NVM backup or restore has reached */
+		enum NvmState
+		{
+			NvmState_Idle = 0,						/**< No backup or restore has been started */
+			NvmState_Sizing,						/**< Asking the controller how large its NVM is */
+			NvmState_Reading,						/**< Reading the NVM into the backup file */
+			NvmState_Writing,						/**< Writing the backup file into the NVM */
+			NvmState_Complete,						/**< The whole NVM has been copied */
+			NvmState_Failed							/**< The controller refused a request, or the file could not be used */
+		};
+
+		/** The progress of a controller NVM backup or restore, or its outcome once it is over */
+		struct NvmData
+		{
+			NvmState	m_state;
+			bool	m_restore;					// Whether the NVM is being written rather than read
+			uint32	m_size;						// Bytes of NVM, 0 until the controller has said
+			uint32	m_done;						// Bytes read or written
+			uint32	m_elapsed;					// ms from the first request for data to the last reply, or until now
+			uint32	m_bytesPerSecond;			// Bytes copied per second over m_elapsed
+		};
+
+		/** A frame between two other nodes, captured by the sniffer */
+		struct SniffedFrame
+		{
+			uint32	m_time;						// ms from the start of sniffing to the frame's arrival
+			uint8	m_sourceId;
+			uint8	m_targetId;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+			vector<uint8>	m_data;				// The command class payload, starting with the command class id
+OPENZWAVE_EXPORT_WARNINGS_ON
+		};
+
+	private:
+		/**
+		 * \brief Request the values of many nodes, a node at a time, from the poll thread.
+		 *
+		 * The nodes are taken in order of node id.  All the requests for one node are sent before
+		 * those of the next, so they share its route, and no more than a few of a node's requests
+		 * are waiting on the poll queue at once, so other traffic can go in between.  Sleeping
+		 * nodes are marked to be refreshed when they next wake.  A Type_RefreshRoundComplete
+		 * notification is sent at the end.  Guarded by m_healthMutex.
+		 */
+		bool BeginRefreshRound( uint8 const _filter, NodeSet const* _nodes );
+		uint32 CancelRefreshRound();
+		void GetRefreshRoundResult( RefreshRoundData* _data );
+		int32 RunRefreshRound();											// Send the next requests if there is room.  Returns the time until it should be called again.
+		void DiscardRefreshRequests();
+
+		uint32					m_refreshFlags;						// CommandClass::RequestFlag_* for the round under way
+		uint8					m_refreshNode;						// The node whose requests are being sent, or 0
+		TimeStamp				m_refreshStart;
+		RefreshRoundData		m_refreshResult;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<uint8>				m_refreshQueue;						// Nodes still to be refreshed
+		list<Msg*>				m_refreshPending;					// Requests for m_refreshNode not yet queued
+OPENZWAVE_EXPORT_WARNINGS_ON
+
+		/**
+		 * \brief Copy the controller's NVM to or from a file.
+		 *
+		 * The NVM is copied in blocks of 240 bytes, the most that fit in one Serial
+		 * API frame.  The controller takes one request at a time, so a few are kept queued
+		 * ahead on the Controller queue, and the next is written out as soon as a reply comes
+		 * in.  A backup is written to the file as each block arrives, with a CRC over the
+		 * whole NVM in its header.  Guarded by m_nvmMutex, which is never held while a message
+		 * is queued.
+		 */
+		bool BeginNvmTransfer( string const& _fileName, bool const _restore );
+		bool CancelNvmTransfer();
+		void GetNvmProgress( NvmData* _data );
+		void HandleNvmGetIdResponse( uint8* _data );
+		void HandleNvmReadResponse( uint8* _data );
+		void HandleNvmWriteResponse( uint8* _data );
+		void NvmMsgRemoved( Msg const* _msg );								// A message is being removed, and may have been a request that got no reply
+		void QueueNvmRequests();											// Top up the requests queued ahead
+		void AdvanceNvm( uint32 const _length );							// These three must be called with m_nvmMutex locked
+		void EndNvmTransfer( NvmState _state );
+		void NotifyNvm();
+		uint32 GetNvmBlockLength( uint32 const _offset )const;
+
+		Mutex*					m_nvmMutex;
+		NvmState				m_nvmState;
+		bool					m_nvmRestore;
+		string					m_nvmFileName;						// The backup being written, or the file being restored
+		FILE*					m_nvmFile;							// A backup is written to m_nvmFileName + ".tmp", then renamed
+		uint8 const*			m_nvmImage;							// The mapped file being restored, header included
+		uint32					m_nvmImageSize;
+		uint32					m_nvmSize;							// Bytes of NVM
+		uint32					m_nvmQueued;						// Offset up to which requests have been queued
+		uint32					m_nvmDone;							// Offset up to which replies have come in
+		uint32					m_nvmOutstanding;					// Requests queued and not yet removed, from this or an earlier transfer
+		bool					m_nvmReplied;						// Whether the request being sent has had its reply
+		uint16					m_nvmCrc;							// CRC of the bytes read so far
+		uint32					m_nvmPercent;						// Tenths of the NVM copied at the last notification
+		TimeStamp				m_nvmStarted;
+		uint32					m_nvmElapsed;
+
+		/**
+		 * \brief Capture the frames that pass between other nodes, with the controller in
+		 * promiscuous mode.
+		 *
+		 * The driver thread puts each frame into m_snifferRing, with the time it arrived, and
+		 * does nothing else with it: it is not decoded, and no node or value is touched.  The
+		 * ring is lock-free for that one producer and one consumer at a time, which is either
+		 * the application calling GetSniffedFrames or, when the frames go to a trace file, the
+		 * poll thread.  A frame that finds the ring full is dropped and counted.  Consumers,
+		 * and starting and stopping, are serialized by m_snifferMutex.
+		 */
+		bool BeginSniffing( string const& _traceFile );
+		bool EndSniffing();
+		bool GetSniffedFrames( vector<SniffedFrame>* o_frames, int32 const _timeout, uint32* o_dropped );
+		int32 TraceSniffedFrames();											// Move the frames in the ring to the trace file.  Returns the time until it should be called again.
+		bool TakeSniffedFrame( SniffedFrame* o_frame );						// These two must be called with m_snifferMutex locked
+		void WriteSniffedFrame( SniffedFrame const& _frame );
+		void SetPromiscuousMode( bool const _on );
+
+		Mutex*					m_snifferMutex;
+		Stream*					m_snifferRing;						// Created when sniffing first starts, and kept until the driver goes
+		ControllerTrace*		m_snifferTrace;						// Where the frames go, or NULL if the application takes them
+		TimeStamp				m_snifferStart;
+		volatile uint32			m_sniffing;							// Non-zero while frames are captured
+		volatile uint32			m_snifferDropped;					// Frames dropped since sniffing started, because the ring was full
+
+		/**
+		 * \brief Record what happens to each message sent, to be viewed on a timeline.
+		 * \see MsgTrace
+		 */
+		void BeginMsgTrace( uint32 const _capacity );
+		bool EndMsgTrace( string const& _fileName );
+
+		MsgTrace*				m_msgTrace;
 
 	//-----------------------------------------------------------------------------
 	// Virtual Node commands
@@ -717,14 +1575,19 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 	private:
 		uint32 GetVirtualNeighbors( uint8** o_neighbors );
 		void RequestVirtualNeighbors( MsgQueue const _queue );
-		bool IsVirtualNode( uint8 const _nodeId )const{  return (( m_virtualNeighbors[( _nodeId - 1 ) >> 3] & 1 << (( _nodeId - 1 ) & 0x07 )) != 0 ); }
+		bool IsVirtualNode( uint8 const _nodeId )const{  return ( _nodeId > 0 ) && ( _nodeId <= NUM_NODE_BITFIELD_BYTES*8 ) && (( m_virtualNeighbors[( _nodeId - 1 ) >> 3] & 1 << (( _nodeId - 1 ) & 0x07 )) != 0 ); }
 		void SendVirtualNodeInfo( uint8 const _fromNodeId, uint8 const _ToNodeId );
 		void SendSlaveLearnModeOff();
 		void SaveButtons();
 		void ReadButtons( uint8 const _nodeId );
+		void ReadLegacyButtons();
 
 		bool		m_virtualNeighborsReceived;
 		uint8		m_virtualNeighbors[NUM_NODE_BITFIELD_BYTES];		// Bitmask containing virtual neighbors
+		bool		m_legacyButtonsRead;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map<uint8, map<uint8,uint8> >	m_legacyButtons;		// The buttons in zwbutton.xml of each node not yet given them
+OPENZWAVE_EXPORT_WARNINGS_ON
 
 	//-----------------------------------------------------------------------------
 	// SwitchAll
@@ -733,6 +1596,59 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		// The public interface is provided via the wrappers in the Manager class
 		void SwitchAllOn();
 		void SwitchAllOff();
+		void SendSwitchAll( bool const _on );
+
+	public:
+		/**
+		 * \brief Send a command to every node in one broadcast frame, then check the nodes that stay quiet.
+		 *
+		 * A broadcast is not acknowledged, so a node may miss it.  Each of the listening nodes
+		 * it is meant for is checked once c_broadcastSettleMs has passed.  A node that has sent
+		 * nothing since the broadcast is sent the command on its own and asked for its switch
+		 * state, no more than one node every c_broadcastCheckGapMs.  Nodes that report their
+		 * change themselves cost no more frames.  A later broadcast of the same command class
+		 * replaces an earlier one's checks of the nodes they share.
+		 * \param _logText names the message in the log.  Only the pointer is kept, so it must
+		 * be a string literal.
+		 * \param _command the command class, the command and its parameters.
+		 * \param _nodeIds the listening nodes to check.
+		 */
+		void SendBroadcast( char const* _logText, uint8 const* _command, uint8 const _length, vector<uint8> const& _nodeIds );
+
+	private:
+		struct BroadcastCheck
+		{
+			char const*		m_logText;
+			vector<uint8>	m_command;				// The command class, the command and its parameters
+			vector<uint8>	m_nodeIds;				// The nodes still to check
+			TimeStamp		m_sent;					// When the broadcast was queued
+		};
+
+		int32 RunBroadcastChecks();					// Check the next node that may have missed a broadcast, if one is due.  Returns the time until the next one.
+
+		Mutex*					m_broadcastMutex;	// Guards m_broadcastChecks
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<BroadcastCheck*>	m_broadcastChecks;	// In the order they were sent
+OPENZWAVE_EXPORT_WARNINGS_ON
+		TimeStamp				m_nextBroadcastCheck;
+
+	//-----------------------------------------------------------------------------
+	// Scenes
+	//-----------------------------------------------------------------------------
+	private:
+		/**
+		 * \brief Set the values of a scene, using multicasts where possible.
+		 *
+		 * Switch values that several listening nodes are being set to are sent as a
+		 * single multicast, so that the devices change together rather than one after
+		 * another.  Each value is then set as usual, which catches any node that missed
+		 * the multicast and updates the value.  Used when the SceneMulticast option is set.
+		 * \param _values the scene's values on this driver's network, and what to set them to.
+		 * \return true if every value was set.
+		 */
+		bool ActivateScene( vector< pair<ValueID,string> > const& _values );
+		bool GetMulticastLevel( ValueID const& _id, string const& _value, uint8& _level );	// Must be called with m_nodeMutex locked
+		void SendMulticastSet( vector<uint8> const& _nodeIds, uint8 const _commandClassId, uint8 const _level );
 
 	//-----------------------------------------------------------------------------
 	// Configuration Parameters	(wrappers for the Node methods)
@@ -741,9 +1657,184 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		// The public interface is provided via the wrappers in the Manager class
 		bool SetConfigParam( uint8 const _nodeId, uint8 const _param, int32 _value, uint8 const _size );
 		void RequestConfigParam( uint8 const _nodeId, uint8 const _param );
+		bool ProvisionConfigParams( uint8 const _nodeId, map<uint8,int32> const& _params );
+		bool ProvisionUserCodes( uint8 const _nodeId, map<uint8,string> const& _codes, bool const _clearOthers );
+
+		/**
+		 * \brief A set of configuration parameters being pushed to a node.
+		 *
+		 * Each parameter is set and then read back, and no more than
+		 * m_provisionWindow of a node's parameters are outstanding at once, so the
+		 * send queue keeps moving between nodes while many are provisioned.  All of
+		 * this is guarded by m_nodeMutex.
+		 */
+		struct ProvisionParam
+		{
+			uint8					m_param;
+			uint8					m_size;
+			int32					m_value;
+		};
+		struct Provision
+		{
+OPENZWAVE_EXPORT_WARNINGS_OFF
+			list<ProvisionParam>		m_pending;						// Not sent yet
+			map<uint8,ProvisionParam>	m_outstanding;					// Set, and waiting for the report, keyed by parameter
+OPENZWAVE_EXPORT_WARNINGS_ON
+			uint32					m_failed;
+		};
+
+		void ProvisionNext( uint8 const _nodeId );							// Send a node's next parameters, or finish if there are none
+		void ProvisionReport( uint8 const _nodeId, uint8 const _param, int32 const _value, uint8 const _size );	// A parameter has been reported by the device
+		void ProvisionMsgRemoved( Msg const* _msg );						// A message is being removed, and may have been a read back that got no report
+		void CancelProvision( uint8 const _nodeId );
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map<uint8,Provision*>	m_provisions;
+OPENZWAVE_EXPORT_WARNINGS_ON
+		int32					m_provisionWindow;					// Parameters per node that may be outstanding at once
 
 	//-----------------------------------------------------------------------------
-	// Groups (wrappers for the Node methods)
+	// Confirmed value sets
+	//-----------------------------------------------------------------------------
+	public:
+		enum SetValueResult
+		{
+			SetValueResult_Confirmed = 0,		/**< The device reported the value it was set to */
+			SetValueResult_Delivered,			/**< The set of a write only value was delivered.  There is no report to confirm it by. */
+			SetValueResult_Different,			/**< After the set was delivered, the device reported a different value */
+			SetValueResult_NotDelivered,		/**< A message for the value was dropped, as the device did not acknowledge it */
+			SetValueResult_Timeout,				/**< Nothing confirmed the set in time */
+			SetValueResult_Superseded,			/**< The value was set again before this set was confirmed */
+			SetValueResult_Cancelled			/**< The node or the driver was removed */
+		};
+
+		typedef void (*pfnSetValueCallback_t)( ValueID const& _id, SetValueResult _result, void* _context );
+
+	private:
+		// The public interface is provided via the wrappers in the Manager class
+		void BeginValueSet( Value const* _value, string const& _newValue, uint32 const _timeout, pfnSetValueCallback_t _callback, void* _context );	// Must be called with the node locked
+		void EndValueSet( ValueID const& _id );							// Forget a set that could not be started, without calling back
+		void BeginOptimisticSet( Value* _target, uint32 const _timeout );	// Show the value a set is sending until it is confirmed or rolled back.  Must be called with the node locked.
+		void ValueSetReported( Value* _value );							// A value has been read from the device, which may confirm a set
+		void ValueSetMsgRemoved( Msg const* _msg, bool const _delivered );	// A message is being removed, after it was delivered or dropped
+		int32 CheckValueSets();											// Times out sets, returning the ms until the next one is due, or -1
+		void CancelValueSets( uint8 const _nodeId );					// Ends a node's sets, or every set if _nodeId is 0
+		static bool ValueSetMatches( Value const* _value, string const& _expected );
+
+		/**
+		 * \brief A value set whose outcome is to be reported.
+		 *
+		 * A set is confirmed by the report that the read back after it brings in.
+		 * Sets of write only values, which are not read back, are confirmed by the
+		 * delivery of the node's next message for the command class.  Sets that are
+		 * over wait in m_valueSetResults for the driver thread to make their callbacks,
+		 * so that no locks are held then.  Both lists are guarded by m_valueSetMutex.
+		 *
+		 * With the OptimisticSet option, the value shows what it was set to while the
+		 * set is waiting, and m_previous holds what it showed before.  If the set fails
+		 * the value is rolled back to that.
+		 */
+		struct ValueSet
+		{
+			ValueSet( ValueID const& _id ): m_id( _id ), m_writeOnly( false ), m_delivered( false ), m_timeout( 0 ), m_callback( NULL ), m_context( NULL ), m_previous( NULL ){}
+
+			ValueID					m_id;
+			string					m_value;
+			bool					m_writeOnly;
+			bool					m_delivered;			// A message for the command class has been delivered since the set
+			uint32					m_timeout;				// ms, or 0 for no limit
+			TimeStamp				m_due;
+			pfnSetValueCallback_t	m_callback;
+			void*					m_context;
+			Value*					m_previous;				// A copy of the value from before an optimistic set, or NULL
+		};
+		typedef list< pair<ValueSet*,SetValueResult> > ValueSetResults;
+
+		void AddValueSet( ValueSet* _set );								// Supersedes any earlier set of the value.  Must be called with m_valueSetMutex held.
+		void CompleteValueSets( ValueSetResults& _results );			// Makes the callbacks for sets that are over, and deletes them
+		void EndOptimisticSet( ValueSet* _set, SetValueResult const _result );	// Confirms or rolls back the value shown for a set
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<ValueSet*>			m_valueSets;
+		ValueSetResults			m_valueSetResults;
+OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*					m_valueSetMutex;
+
+	//-----------------------------------------------------------------------------
+	// Scene events
+	//-----------------------------------------------------------------------------
+	public:
+		/**
+		 * \brief A scene or button event, passed to the scene event watchers as soon as it arrives.
+		 * \see Manager::AddSceneEventWatcher
+		 */
+		struct SceneEvent
+		{
+			uint32	m_homeId;
+			uint8	m_nodeId;
+			uint8	m_instance;
+			uint8	m_commandClassId;		/**< CentralScene::StaticGetCommandClassId() or SceneActivation::StaticGetCommandClassId() */
+			uint8	m_sceneId;
+			uint8	m_keyAttributes;		/**< For Central Scene, how the key was used: 0 pressed, 1 released, 2 held down, 3 to 6 pressed 2 to 5 times.  Otherwise 0. */
+			uint8	m_sequence;				/**< For Central Scene, the device's sequence number, which repeats for a retransmitted event.  Otherwise 0. */
+			uint8	m_duration;				/**< For Scene Activation, the dimming duration as sent (0xff for the device's own).  Otherwise 0. */
+			uint32	m_received;				/**< When the frame arrived, in milliseconds since the driver started */
+		};
+
+		typedef void (*pfnSceneEventCallback_t)( SceneEvent const& _event, void* _context );
+
+	private:
+		void RaiseSceneEvent( SceneEvent& _event );						// Stamps the event and passes it to the scene event watchers
+
+		// Scene rules activate a scene when a value changes or a scene event
+		// arrives, straight from the driver thread.  The scenes triggered by a
+		// frame are activated once it has been handled.
+		struct SceneRule
+		{
+			uint32	m_ruleId;
+			uint8	m_sceneId;			// Scene to activate
+			string	m_value;			// For a value rule, the value that triggers it, or empty for any change
+			uint8	m_keyAttributes;	// For an event rule, the key attributes that trigger it, or 0xff for any
+		};
+		uint32 AddSceneRule( ValueID const& _valueId, string const& _value, uint8 const _sceneId );
+		uint32 AddSceneRule( uint8 const _nodeId, uint8 const _triggerSceneId, uint8 const _keyAttributes, uint8 const _sceneId );
+		bool RemoveSceneRule( uint32 const _ruleId );
+		void CheckSceneRules( Value const* _value );					// Called when a value has changed
+		void CheckSceneRules( SceneEvent const& _event );
+		void TriggerScene( uint8 const _sceneId );						// Must be called with m_triggerMutex locked
+		void FlushTriggeredScenes();									// Activate the scenes triggered while a frame was handled
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map< uint64, list<SceneRule> >	m_valueSceneRules;		// By ValueID::GetId()
+		map< uint16, list<SceneRule> >	m_eventSceneRules;		// By node id << 8 | scene id
+		list<uint8>						m_triggeredScenes;		// Scenes triggered while the frame from m_triggerNodeId is handled
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32							m_nextSceneRuleId;		// The scene rule members are guarded by m_triggerMutex
+
+	//-----------------------------------------------------------------------------
+	// Provisioning
+	//-----------------------------------------------------------------------------
+	private:
+		// A product expected to be included.  A new node of the product takes its
+		// command classes from a node already interviewed, rather than querying
+		// them, and is then sent the desired configuration in one batch.
+		struct ProvisionedProduct
+		{
+			string							m_productKey;			// Node::GetProductKey() of the template node, which the new node must match
+			string							m_commandClasses;		// <CommandClasses> element of the template node, as XML text
+			map< uint8, pair<int32,uint8> >	m_configParams;			// Desired value and size of each configuration parameter
+		};
+		bool AddProvisionedProduct( uint8 const _templateNodeId );
+		bool RemoveProvisionedProduct( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId );
+		bool SetProvisionedConfigParam( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, uint8 const _param, int32 const _value, uint8 const _size );
+		bool ApplyProvisionedProduct( Node* _node );					// Called by the node's interview once its ids are known.  False if no template matches.
+		static uint64 GetProvisioningKey( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId ){ return ( (uint64)_manufacturerId << 32 ) | ( (uint32)_productType << 16 ) | _productId; }
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map<uint64,ProvisionedProduct>	m_provisionedProducts;	// By GetProvisioningKey()
+OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*							m_provisioningMutex;	// Guards m_provisionedProducts
+
 	//-----------------------------------------------------------------------------
 	private:
 		// The public interface is provided via the wrappers in the Manager class
@@ -754,6 +1845,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		string GetGroupLabel( uint8 const _nodeId, uint8 const _groupIdx );
 		void AddAssociation( uint8 const _nodeId, uint8 const _groupIdx, uint8 const _targetNodeId, uint8 const _instance = 0x00 );
 		void RemoveAssociation( uint8 const _nodeId, uint8 const _groupIdx, uint8 const _targetNodeId, uint8 const _instance = 0x00 );
+		uint32 GetAssociations( uint8 const _nodeId, uint8 const _groupIdx, NodeSet* o_members );
+		uint32 SetAssociations( uint8 const _nodeId, uint8 const _groupIdx, NodeSet const& _members );
 
 	//-----------------------------------------------------------------------------
 	//	Notifications
@@ -762,10 +1855,38 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void QueueNotification( Notification* _notification );				// Adds a notification to the list.  Notifications are queued until a point in the thread where we know we do not have any nodes locked.
 		void NotifyWatchers();												// Passes the notifications to all the registered watcher callbacks in turn.
 
+		void SetNotificationInterval( ValueID const& _id, uint32 const _interval );
+		uint32 GetNotificationInterval( ValueID const& _id );
+		bool CoalesceNotification( Notification* _notification );			// Returns true if the notification was merged with, or held back behind, an earlier one for its value
+		int32 ReleaseHeldNotifications();									// Queues the held notifications that are due, returning the milliseconds until the next one is, or -1
+		bool MergeValueAdded( Notification* _notification );				// Returns true if a ValueAdded was added to the Type_ValuesAdded waiting before it
+
+		// A value whose notifications are coalesced.  While a notification for the value
+		// is waiting to be delivered, later ones are merged into it, and once one has been
+		// delivered, the next waits until the value's interval has passed.
+		struct CoalescedValue
+		{
+			Notification*	m_pending;							// Waiting to be delivered, or NULL
+			bool			m_held;								// m_pending has not yet been put in m_notifications
+			uint32			m_delivered;						// When the last notification was delivered, in milliseconds since m_startTime
+			uint32			m_interval;
+		};
+
 OPENZWAVE_EXPORT_WARNINGS_OFF
 		list<Notification*>		m_notifications;
+		map<ValueID,CoalescedValue>	m_coalescedValues;
+		map<ValueID,uint32>		m_notificationIntervals;					// Set with Manager::SetValueNotificationInterval, overriding m_notificationInterval
 OPENZWAVE_EXPORT_WARNINGS_ON
 		Event*				m_notificationsEvent;
+		Mutex*				m_notificationsMutex;						// Notifications can be queued from threads other than the driver thread
+		NotificationDispatcher*	m_notificationDispatcher;					// If not NULL, watchers are called from its thread rather than the driver thread
+		uint32				m_notificationInterval;						// Shortest time between notifications for a value, from the NotificationInterval option (0 = every notification is delivered)
+		uint32				m_heldNotifications;						// Number of m_coalescedValues that are held
+		bool				m_bulkValueAdded;							// Send Type_ValuesAdded rather than Type_ValueAdded, from the BulkValueAdded option
+		ChangeJournal*		m_changeJournal;							// The latest changes, for Manager::GetChangesSince, or NULL if ChangeJournalSize is 0.  Guarded by m_notificationsMutex.
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		set<ValueID>		m_valueLogPending;							// Values changed since the last FlushValueLog.  Guarded by m_notificationsMutex.
+OPENZWAVE_EXPORT_WARNINGS_ON
 
 	//-----------------------------------------------------------------------------
 	//	Statistics
@@ -773,56 +1894,158 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 	public:
 		struct DriverData
 		{
-			uint32 m_SOFCnt;			// Number of SOF bytes received
-			uint32 m_ACKWaiting;		// Number of unsolicited messages while waiting for an ACK
-			uint32 m_readAborts;		// Number of times read were aborted due to timeouts
-			uint32 m_badChecksum;		// Number of bad checksums
-			uint32 m_readCnt;			// Number of messages successfully read
-			uint32 m_writeCnt;			// Number of messages successfully sent
-			uint32 m_CANCnt;			// Number of CAN bytes received
-			uint32 m_NAKCnt;			// Number of NAK bytes received
-			uint32 m_ACKCnt;			// Number of ACK bytes received
-			uint32 m_OOFCnt;			// Number of bytes out of framing
-			uint32 m_dropped;			// Number of messages dropped & not delivered
-			uint32 m_retries;			// Number of messages retransmitted
-			uint32 m_callbacks;			// Number of unexpected callbacks
-			uint32 m_badroutes;			// Number of failed messages due to bad route response
-			uint32 m_noack;				// Number of no ACK returned errors
-			uint32 m_netbusy;			// Number of network busy/failure messages
-			uint32 m_notidle;
-			uint32 m_nondelivery;		// Number of messages not delivered to network
-			uint32 m_routedbusy;		// Number of messages received with routed busy status
-			uint32 m_broadcastReadCnt;	// Number of broadcasts read
-			uint32 m_broadcastWriteCnt;	// Number of broadcasts sent
+			uint64 m_SOFCnt;			// Number of SOF bytes received
+			uint64 m_ACKWaiting;		// Number of unsolicited messages while waiting for an ACK
+			uint64 m_readAborts;		// Number of times read were aborted due to timeouts
+			uint64 m_badChecksum;		// Number of bad checksums
+			uint64 m_readCnt;			// Number of messages successfully read
+			uint64 m_writeCnt;			// Number of messages successfully sent
+			uint64 m_CANCnt;			// Number of CAN bytes received
+			uint64 m_NAKCnt;			// Number of NAK bytes received
+			uint64 m_ACKCnt;			// Number of ACK bytes received
+			uint64 m_OOFCnt;			// Number of bytes out of framing
+			uint64 m_dropped;			// Number of messages dropped & not delivered
+			uint64 m_retries;			// Number of messages retransmitted
+			uint64 m_callbacks;			// Number of unexpected callbacks
+			uint64 m_badroutes;			// Number of failed messages due to bad route response
+			uint64 m_noack;				// Number of no ACK returned errors
+			uint64 m_netbusy;			// Number of network busy/failure messages
+			uint64 m_notidle;
+			uint64 m_nondelivery;		// Number of messages not delivered to network
+			uint64 m_routedbusy;		// Number of messages received with routed busy status
+			uint64 m_broadcastReadCnt;	// Number of broadcasts read
+			uint64 m_broadcastWriteCnt;	// Number of broadcasts sent
+			uint64 m_expired;			// Number of messages dropped unsent, having waited on their queue past their deadline
+			uint32 m_airtime[MsgQueue_Count];	// Estimated radio time used by each queue's messages, in ms
+			uint32 m_aged[MsgQueue_Count];		// Times each queue has gone ahead of busier ones, having waited past its QueueAging time
+			uint32 m_configReadTime;	// Time taken to read the saved configuration when the driver started, in microseconds
+			uint32 m_configBuildTime;	// Time taken to build the last configuration written, in microseconds
+		};
+
+		/**
+		 * The counters of every node, one array per counter indexed by node id, so that
+		 * all the nodes can be read in a single copy.  The entries of nodes that do not
+		 * exist are zero.
+		 */
+		struct NodeCounters
+		{
+			uint8 m_nodes[32];					// Bit set of the nodes that exist, filled in by GetAllNodeStatistics
+			uint32 m_sentCnt[256];				// Messages sent to the node
+			uint32 m_sentFailed[256];			// Sent messages that failed
+			uint32 m_retries[256];				// Message retries
+			uint32 m_receivedCnt[256];			// Messages received from the node
+			uint32 m_receivedDups[256];			// Duplicated messages received
+			uint32 m_receivedUnsolicited[256];	// Messages received unsolicited
+			uint32 m_lastRequestRTT[256];		// ms
+			uint32 m_averageRequestRTT[256];	// ms
+			uint32 m_lastResponseRTT[256];		// ms
+			uint32 m_averageResponseRTT[256];	// ms
+			uint32 m_pollBatches[256];			// Polls that requested more than one value together
+			uint32 m_pollsCoalesced[256];		// Frames saved by coalescing polled values
+			uint32 m_reportsCoalesced[256];		// Reports replaced by a later one while the node was over the InboundRateLimit
+			uint64 m_airtime[256];				// Estimated radio time used by messages to the node, in microseconds
+			uint8 m_quality[256];				// Node quality measure
+		};
+
+		/**
+		 * Estimated bytes used by the driver's nodes and queues.  The shared strings and the
+		 * log queue belong to the whole process, so are the same for every driver.
+		 */
+		struct MemoryData
+		{
+			uint64 m_nodes;						// The node objects, their strings and their tables
+			uint64 m_commandClasses;			// The command class objects
+			uint64 m_values;					// The values, without their labels, units and help
+			uint64 m_groups;					// The association groups
+			uint64 m_wakeUpQueues;				// Messages waiting for sleeping nodes to wake
+			uint64 m_queuedMsgs[MsgQueue_Count];	// Items waiting in each send queue
+			uint64 m_notifications;				// Notifications waiting for the watchers, or held back
+			uint64 m_sharedStrings;				// The pool of value labels, units and help
+			uint64 m_logQueue;					// Log entries kept until a dump trigger
+		};
+
+		/** Percentiles of the time taken by each stage of sending a message, in milliseconds */
+		struct DriverLatencyData
+		{
+			LatencyHistogram::Summary m_queueWait[MsgQueue_Count];	// From queueing a message to sending it, for each queue
+			LatencyHistogram::Summary m_ack;		// From sending a frame to the controller's ACK
+			LatencyHistogram::Summary m_callback;	// From sending a request to the controller's callback
+			LatencyHistogram::Summary m_reply;		// From sending a request to the node's reply
+			LatencyHistogram::Summary m_handler;	// Taken by the watchers over each batch of notifications
 		};
 
 		void LogDriverStatistics();
 
+		/**
+		 * Render the driver's counters and latency histograms, and the counters and round trip
+		 * times of each node, in the Prometheus text exposition format (version 0.0.4).
+		 * The live counters are read directly rather than copied into a DriverData first.
+		 * \param o_text the metrics are appended to this.
+		 */
+		void WriteMetrics( string& o_text );
+
 	private:
 		void GetDriverStatistics( DriverData* _data );
 		void GetNodeStatistics( uint8 const _nodeId, Node::NodeData* _data );
+		void GetAllNodeStatistics( NodeCounters* _data );
+		void ResetNodeCounters( uint8 const _nodeId );						// Called when a node is deleted
+		void GetDriverLatencyStatistics( DriverLatencyData* _data );
+		void GetNodeLatencyStatistics( uint8 const _nodeId, Node::NodeLatencyData* _data );
+		void GetNodeQueryStageStatistics( uint8 const _nodeId, Node::NodeQueryStageData* _data );
+		void GetMemoryStatistics( MemoryData* _data );
+		void GetNodeMemoryStatistics( uint8 const _nodeId, Node::NodeMemoryData* _data );
+		void LogLatency( char const* _stage, LatencyHistogram::Summary const& _summary );
+		void WriteNodeMetric( string& o_text, char const* _name, char const* _type, char const* _help, uint32 const* _values, bool const _ms );
+
+		// The counters can be incremented by any thread, and read by any thread without a lock.  They are
+		// 64 bits, so never wrap, and padded so that nothing else shares their cache lines.
+		enum DriverCounter
+		{
+			DriverCounter_SOF = 0,		// Number of SOF bytes received
+			DriverCounter_ACKWaiting,	// Number of unsolicited messages while waiting for an ACK
+			DriverCounter_ReadAborts,	// Number of times read were aborted due to timeouts
+			DriverCounter_BadChecksum,	// Number of bad checksums
+			DriverCounter_Read,			// Number of messages successfully read
+			DriverCounter_Write,		// Number of messages successfully sent
+			DriverCounter_CAN,			// Number of CAN bytes received
+			DriverCounter_NAK,			// Number of NAK bytes received
+			DriverCounter_ACK,			// Number of ACK bytes received
+			DriverCounter_OOF,			// Number of bytes out of framing
+			DriverCounter_Dropped,		// Number of messages dropped & not delivered
+			DriverCounter_Retries,		// Number of retransmitted messages
+			DriverCounter_Callbacks,	// Number of unexpected callbacks
+			DriverCounter_BadRoutes,	// Number of failed messages due to bad route response
+			DriverCounter_NoACK,		// Number of no ACK returned errors
+			DriverCounter_NetBusy,		// Number of network busy/failure messages
+			DriverCounter_NotIdle,		// Number of not idle messages
+			DriverCounter_NonDelivery,	// Number of messages not delivered to network
+			DriverCounter_RoutedBusy,	// Number of messages received with routed busy status
+			DriverCounter_BroadcastRead,	// Number of broadcasts read
+			DriverCounter_BroadcastWrite,	// Number of broadcasts sent
+			DriverCounter_Expired,		// Number of messages dropped unsent, having waited past their deadline
+			DriverCounter_Count
+		};
+
+		struct DriverCounters
+		{
+			uint8			m_padBefore[64];
+			volatile uint64	m_values[DriverCounter_Count];
+			uint8			m_padAfter[64];
+		};
 
-		uint32 m_SOFCnt;			// Number of SOF bytes received
-		uint32 m_ACKWaiting;		// Number of unsolicited messages while waiting for an ACK
-		uint32 m_readAborts;		// Number of times read were aborted due to timeouts
-		uint32 m_badChecksum;		// Number of bad checksums
-		uint32 m_readCnt;			// Number of messages successfully read
-		uint32 m_writeCnt;			// Number of messages successfully sent
-		uint32 m_CANCnt;			// Number of CAN bytes received
-		uint32 m_NAKCnt;			// Number of NAK bytes received
-		uint32 m_ACKCnt;			// Number of ACK bytes received
-		uint32 m_OOFCnt;			// Number of bytes out of framing
-		uint32 m_dropped;			// Number of messages dropped & not delivered
-		uint32 m_retries;			// Number of retransmitted messages
-		uint32 m_callbacks;			// Number of unexpected callbacks
-		uint32 m_badroutes;			// Number of failed messages due to bad route response
-		uint32 m_noack;				// Number of no ACK returned errors
-		uint32 m_netbusy;			// Number of network busy/failure messages
-		uint32 m_notidle;			// Number of not idle messages
-		uint32 m_nondelivery;		// Number of messages not delivered to network
-		uint32 m_routedbusy;		// Number of messages received with routed busy status
-		uint32 m_broadcastReadCnt;	// Number of broadcasts read
-		uint32 m_broadcastWriteCnt;	// Number of broadcasts sent
+		void Count( DriverCounter const _counter );
+		void GetCounters( uint64* o_values )const;	// A consistent snapshot of all the counters
+
+		DriverCounters* m_counters;	// Allocated separately, so the 64 bit counters are aligned for atomic access even on 32 bit machines
+		uint32 m_rxFrameAge;		// How long the frame being processed waited in the receive buffer, in ms
+		NodeCounters m_nodeCounters;	// Written by the driver thread only.  m_nodes is not kept up to date.
+		TimeStamp m_writeTS;		// When the last frame was sent
+		TimeStamp m_ackTimeStamp;	// When the controller's ACK for the last frame is overdue
+		LatencyHistogram m_queueWait[MsgQueue_Count];
+		LatencyHistogram m_ackLatency;
+		LatencyHistogram m_callbackLatency;
+		LatencyHistogram m_replyLatency;
+		LatencyHistogram m_handlerTime;
 		//time_t m_commandStart;	// Start time of last command
 		//time_t m_timeoutLost;		// Cumulative time lost to timeouts
 
@@ -843,9 +2066,11 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		void SendNonceKey(uint8 nodeId, uint8 *nonce);
 		aes_encrypt_ctx *AuthKey;
 		aes_encrypt_ctx *EncryptKey;
+		aes_encrypt_ctx *InclusionAuthKey;			// Used while a node is being added
+		aes_encrypt_ctx *InclusionEncryptKey;
 		uint8 m_nonceReportSent;
 		uint8 m_nonceReportSentAttempt;
-		bool m_inclusionkeySet;
+		bool m_inclusionkeySet;						// True once the inclusion key schedules have been worked out
 
 	};
 
@@ -145,10 +145,8 @@ Group::Group
 		associationElement = associationElement->NextSiblingElement();
 	}
 
-	// Group must be added before OnGroupChanged is called so UpdateNodeRoutes can find it.
-	// Since we do not want to update return routes UpdateNodeRoutes won't find the group
-	// so nothing will go out from here. The not sending of return routes information
-	// only works by a side effect of not finding the group.
+	// The group is added to its node after this, so OnGroupChanged does not
+	// update the node's return routes for it.
 	OnGroupChanged( pending );
 }
 
@@ -189,6 +187,26 @@ void Group::CheckAuto
 
 
 
+//-----------------------------------------------------------------------------
+// <Group::GetMemoryUsage>
+// Bytes used by the group, counting four pointers for each node of the map
+//-----------------------------------------------------------------------------
+uint32 Group::GetMemoryUsage
+(
+)const
+{
+	uint32 bytes = (uint32)( sizeof(Group) + m_label.capacity() );
+	for( map<InstanceAssociation,AssociationCommandVec,classcomp>::const_iterator it = m_associations.begin(); it != m_associations.end(); ++it )
+	{
+		bytes += (uint32)( 4 * sizeof(void*) + sizeof(InstanceAssociation) + sizeof(AssociationCommandVec) + it->second.capacity() * sizeof(AssociationCommand) );
+		for( AssociationCommandVec::const_iterator cit = it->second.begin(); cit != it->second.end(); ++cit )
+		{
+			bytes += cit->GetLength();
+		}
+	}
+	return bytes;
+}
+
 //-----------------------------------------------------------------------------
 // <Group::WriteXML>
 // Write ourselves to an XML document
@@ -239,14 +257,7 @@ bool Group::Contains
 	uint8 const _instance
 )
 {
-	for( map<InstanceAssociation,AssociationCommandVec,classcomp>::iterator it = m_associations.begin(); it != m_associations.end(); ++it )
-	{
-		if ((it->first.m_nodeId == _nodeId) && (it->first.m_instance == _instance))
-		{
-			return true;
-		}
-	}
-	return false;
+	return m_members.Contains( _nodeId, _instance );
 }
 
 //-----------------------------------------------------------------------------
@@ -315,6 +326,55 @@ void Group::RemoveAssociation
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Group::SetAssociations>
+// Make the group hold exactly the members given, sending only the changes
+//-----------------------------------------------------------------------------
+uint32 Group::SetAssociations
+(
+	NodeSet const& _members
+)
+{
+	NodeSet added;
+	NodeSet removed;
+	_members.Difference( m_members, &added );
+	m_members.Difference( _members, &removed );
+	uint32 changes = added.GetCount() + removed.GetCount();
+	if( changes == 0 )
+	{
+		Log::Write( LogLevel_Info, m_nodeId, "Group %d already holds the associations wanted", m_groupIdx );
+		return 0;
+	}
+
+	Log::Write( LogLevel_Info, m_nodeId, "Changing group %d: adding %d and removing %d associations", m_groupIdx, added.GetCount(), removed.GetCount() );
+	if( Driver* driver = Manager::Get()->GetDriver( m_homeId ) )
+	{
+		if( Node* node = driver->GetNodeUnsafe( m_nodeId ) )
+		{
+			// Removals go first, so a full group has room for the additions
+			MultiChannelAssociation* cc = static_cast<MultiChannelAssociation*>( node->GetCommandClass( MultiChannelAssociation::StaticGetCommandClassId() ));
+			if( cc && IsMultiInstance() )
+			{
+				cc->Remove( m_groupIdx, removed );
+				cc->Set( m_groupIdx, added );
+				cc->QueryGroup( m_groupIdx, 0 );
+			}
+			else if( Association* cc = static_cast<Association*>( node->GetCommandClass( Association::StaticGetCommandClassId() ) ) )
+			{
+				cc->Remove( m_groupIdx, removed );
+				cc->Set( m_groupIdx, added );
+				cc->QueryGroup( m_groupIdx, 0 );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, m_nodeId, "No supported Association CC found" );
+				return 0;
+			}
+		}
+	}
+	return changes;
+}
+
 //-----------------------------------------------------------------------------
 // <Group::OnGroupChanged>
 // Change the group contents and notify the watchers
@@ -389,6 +449,12 @@ void Group::OnGroupChanged
 
 	if( notify )
 	{
+		m_members.Clear();
+		for( map<InstanceAssociation,AssociationCommandVec,classcomp>::iterator it = m_associations.begin(); it != m_associations.end(); ++it )
+		{
+			m_members.Add( it->first.m_nodeId, it->first.m_instance );
+		}
+
 		// If the node supports COMMAND_CLASS_ASSOCIATION_COMMAND_CONFIGURATION, we need to request the command data.
 		if( Driver* driver = Manager::Get()->GetDriver( m_homeId ) )
 		{
@@ -409,14 +475,17 @@ void Group::OnGroupChanged
 		notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
 		notification->SetGroupIdx( m_groupIdx );
 		Manager::Get()->GetDriver( m_homeId )->QueueNotification( notification ); 
-		// Update routes on remote node if necessary
+		// Update routes on remote node if necessary, once the changes stop.  A
+		// group being read from the configuration is not yet the node's, and
+		// its routes were assigned before it was saved.
 		bool update = false;
 		Options::Get()->GetOptionAsBool( "PerformReturnRoutes", &update );
 		if( update )
 		{
 			Driver *drv = Manager::Get()->GetDriver( m_homeId );
-			if (drv)
-				drv->UpdateNodeRoutes( m_nodeId );
+			Node* node = drv ? drv->GetNodeUnsafe( m_nodeId ) : NULL;
+			if( node && node->GetGroup( m_groupIdx ) == this )
+				drv->ScheduleNodeRoutes( m_nodeId );
 		}
 	}
 }
@@ -554,4 +623,229 @@ Group::AssociationCommand::~AssociationCommand
 	delete [] m_data;
 }
 
+//-----------------------------------------------------------------------------
+// <NodeSet::NodeSet>
+// Constructor, from a node mask
+//-----------------------------------------------------------------------------
+NodeSet::NodeSet
+(
+	uint8 const* _mask
+)
+{
+	Clear();
+	for( uint32 i = 0; i < NUM_NODE_BITFIELD_BYTES; ++i )
+	{
+		m_bits[i >> 2] |= ( (uint32)_mask[i] ) << ( ( i & 3 ) << 3 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::Clear>
+// Empty the set
+//-----------------------------------------------------------------------------
+void NodeSet::Clear
+(
+)
+{
+	memset( m_bits, 0, sizeof(m_bits) );
+	m_instances.clear();
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::Add>
+// Add a node, or an instance of a node, to the set
+//-----------------------------------------------------------------------------
+bool NodeSet::Add
+(
+	uint8 const _nodeId,
+	uint8 const _instance
+)
+{
+	if( ( _nodeId == 0 ) || ( _nodeId > NUM_NODE_BITFIELD_BYTES * 8 ) )
+	{
+		return false;
+	}
+	if( _instance == 0x00 )
+	{
+		uint32 bit = 1u << ( ( _nodeId - 1 ) & 0x1f );
+		if( m_bits[( _nodeId - 1 ) >> 5] & bit )
+		{
+			return false;
+		}
+		m_bits[( _nodeId - 1 ) >> 5] |= bit;
+		return true;
+	}
+
+	vector<InstanceAssociation>::iterator it = m_instances.begin();
+	while( ( it != m_instances.end() ) && ( ( it->m_nodeId < _nodeId ) || ( ( it->m_nodeId == _nodeId ) && ( it->m_instance < _instance ) ) ) )
+	{
+		++it;
+	}
+	if( ( it != m_instances.end() ) && ( it->m_nodeId == _nodeId ) && ( it->m_instance == _instance ) )
+	{
+		return false;
+	}
+	InstanceAssociation association;
+	association.m_nodeId = _nodeId;
+	association.m_instance = _instance;
+	m_instances.insert( it, association );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::Remove>
+// Remove a node, or an instance of a node, from the set
+//-----------------------------------------------------------------------------
+bool NodeSet::Remove
+(
+	uint8 const _nodeId,
+	uint8 const _instance
+)
+{
+	if( !Contains( _nodeId, _instance ) )
+	{
+		return false;
+	}
+	if( _instance == 0x00 )
+	{
+		m_bits[( _nodeId - 1 ) >> 5] &= ~( 1u << ( ( _nodeId - 1 ) & 0x1f ) );
+		return true;
+	}
+	for( vector<InstanceAssociation>::iterator it = m_instances.begin(); it != m_instances.end(); ++it )
+	{
+		if( ( it->m_nodeId == _nodeId ) && ( it->m_instance == _instance ) )
+		{
+			m_instances.erase( it );
+			break;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::Contains>
+// Whether a node, or an instance of a node, is in the set
+//-----------------------------------------------------------------------------
+bool NodeSet::Contains
+(
+	uint8 const _nodeId,
+	uint8 const _instance
+)const
+{
+	if( ( _nodeId == 0 ) || ( _nodeId > NUM_NODE_BITFIELD_BYTES * 8 ) )
+	{
+		return false;
+	}
+	if( _instance == 0x00 )
+	{
+		return ( m_bits[( _nodeId - 1 ) >> 5] & ( 1u << ( ( _nodeId - 1 ) & 0x1f ) ) ) != 0;
+	}
+	for( vector<InstanceAssociation>::const_iterator it = m_instances.begin(); it != m_instances.end(); ++it )
+	{
+		if( ( it->m_nodeId == _nodeId ) && ( it->m_instance == _instance ) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
+//-----------------------------------------------------------------------------
+// <NodeSet::GetCount>
+// The number of members of the set
+//-----------------------------------------------------------------------------
+uint32 NodeSet::GetCount
+(
+)const
+{
+	uint32 count = (uint32)m_instances.size();
+	for( uint32 i = 0; i < NumWords; ++i )
+	{
+		count += BitPopCount( m_bits[i] );
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::GetNext>
+// Step through the members of the set
+//-----------------------------------------------------------------------------
+bool NodeSet::GetNext
+(
+	uint32& io_position,
+	InstanceAssociation* o_association
+)const
+{
+	// Positions below the number of bits are node ids less one, and the
+	// rest are indexes into the list of instances
+	uint32 const numBits = NumWords << 5;
+	if( io_position < numBits )
+	{
+		// No bits are set beyond the last node id, so the search ends at numBits
+		uint32 position = BitFindNextSet( m_bits, NumWords, io_position );
+		io_position = position + 1;
+		if( position < numBits )
+		{
+			o_association->m_nodeId = (uint8)( position + 1 );
+			o_association->m_instance = 0x00;
+			return true;
+		}
+		io_position = numBits;
+	}
+
+	uint32 index = io_position - numBits;
+	if( index < m_instances.size() )
+	{
+		*o_association = m_instances[index];
+		++io_position;
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::Difference>
+// Get the members of this set that are not in another
+//-----------------------------------------------------------------------------
+void NodeSet::Difference
+(
+	NodeSet const& _other,
+	NodeSet* o_result
+)const
+{
+	for( uint32 i = 0; i < NumWords; ++i )
+	{
+		o_result->m_bits[i] = m_bits[i] & ~_other.m_bits[i];
+	}
+	o_result->m_instances.clear();
+	for( vector<InstanceAssociation>::const_iterator it = m_instances.begin(); it != m_instances.end(); ++it )
+	{
+		if( !_other.Contains( it->m_nodeId, it->m_instance ) )
+		{
+			o_result->m_instances.push_back( *it );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NodeSet::operator==>
+// Whether two sets have the same members
+//-----------------------------------------------------------------------------
+bool NodeSet::operator==
+(
+	NodeSet const& _other
+)const
+{
+	if( memcmp( m_bits, _other.m_bits, sizeof(m_bits) ) || ( m_instances.size() != _other.m_instances.size() ) )
+	{
+		return false;
+	}
+	for( size_t i = 0; i < m_instances.size(); ++i )
+	{
+		if( ( m_instances[i].m_nodeId != _other.m_instances[i].m_nodeId ) || ( m_instances[i].m_instance != _other.m_instances[i].m_instance ) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -32,6 +32,7 @@
 #include <vector>
 #include <map>
 #include "Defs.h"
+#include "Bitfield.h"
 
 class TiXmlElement;
 
@@ -43,6 +44,62 @@ namespace OpenZWave
 		uint8 m_nodeId;
 		uint8 m_instance;
 	} InstanceAssociation;
+
+	/** \brief A set of association targets.
+	 *
+	 * Whole nodes are held as one bit for each of the 232 possible node ids, in 32 bit
+	 * words so they can be counted and stepped through a word at a time.  The bits are in
+	 * the same order as in the node masks sent by the controller, which a set can be made
+	 * from, such as a node's neighbors.  Associations with a particular
+	 * instance of a node, which are rare, are kept in a sorted list alongside.  Copying
+	 * a set into one that already has room for its instances does not allocate.
+	 */
+	class OPENZWAVE_EXPORT NodeSet
+	{
+	public:
+		NodeSet(){ Clear(); }
+
+		/**
+		 * \param _mask a node mask of NUM_NODE_BITFIELD_BYTES bytes, with node 1 in the lowest bit of the first.
+		 */
+		explicit NodeSet( uint8 const* _mask );
+
+		void Clear();
+		bool Add( uint8 const _nodeId, uint8 const _instance = 0x00 );			// false if already in the set, or the node id is out of range
+		bool Remove( uint8 const _nodeId, uint8 const _instance = 0x00 );		// false if not in the set
+		bool Contains( uint8 const _nodeId, uint8 const _instance = 0x00 )const;
+		uint32 GetCount()const;
+		bool IsEmpty()const{ return GetCount() == 0; }
+
+		/**
+		 * Step through the members of the set, whole nodes first in order of node id.
+		 * \param io_position set to zero to start.  Updated to the position after the member returned.
+		 * \param o_association the member.
+		 * \return false once there are no more members.
+		 */
+		bool GetNext( uint32& io_position, InstanceAssociation* o_association )const;
+
+		/**
+		 * Get the members of this set that are not in another.
+		 * \param _other the set to take away.
+		 * \param o_result filled with the members found only in this set.
+		 */
+		void Difference( NodeSet const& _other, NodeSet* o_result )const;
+
+		bool operator==( NodeSet const& _other )const;
+		bool operator!=( NodeSet const& _other )const{ return !( *this == _other ); }
+
+	private:
+		enum
+		{
+			NumWords	= ( NUM_NODE_BITFIELD_BYTES + 3 ) / 4
+		};
+
+		uint32								m_bits[NumWords];					// Bit (id-1) is set for node id
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<InstanceAssociation>			m_instances;						// Sorted by node id, then instance
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
 	
 	/** \brief Manages a group of devices (various nodes associated with each other).
 	 */
@@ -72,6 +129,8 @@ namespace OpenZWave
 		uint8 GetMaxAssociations()const{ return m_maxAssociations; }
 		uint8 GetIdx()const{ return m_groupIdx; }
 		bool Contains( uint8 const _nodeId, uint8 const _instance = 0x00 );
+		void GetMembers( NodeSet* o_members )const{ *o_members = m_members; }
+		uint32 GetMemoryUsage()const;			// Bytes used by the group and its associations
 
 	private:
 		bool IsAuto()const{ return m_auto; }
@@ -83,6 +142,7 @@ namespace OpenZWave
 
 		void AddAssociation( uint8 const _nodeId, uint8 const _instance = 0x00 );
 		void RemoveAssociation( uint8 const _nodeId, uint8 const _instance = 0x00 );
+		uint32 SetAssociations( NodeSet const& _members );
 		void OnGroupChanged( vector<uint8> const& _associations );
 		void OnGroupChanged( vector<InstanceAssociation> const& _associations );
 
@@ -100,6 +160,8 @@ namespace OpenZWave
 			AssociationCommand( uint8 const _length, uint8 const* _data );
 			~AssociationCommand();
 
+			uint8 GetLength()const{ return m_length; }
+
 		private:
 			uint8	m_length;
 			uint8*	m_data;
@@ -123,6 +185,7 @@ namespace OpenZWave
 		bool								m_auto;				// If true, the controller will automatically be associated with the group
 		bool								m_multiInstance;    // If true, the group is MultiInstance capable
 		map<InstanceAssociation,AssociationCommandVec,classcomp>	m_associations;
+		NodeSet								m_members;			// The keys of m_associations, for quick lookups
 	};
 
 } //namespace OpenZWave
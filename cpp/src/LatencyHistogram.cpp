@@ -0,0 +1,210 @@
+//-----------------------------------------------------------------------------
+//
+//	LatencyHistogram.cpp
+//
+//	Lock-free histogram of latencies, for percentile statistics
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "LatencyHistogram.h"
+#include "platform/Atomic.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::LatencyHistogram>
+// Constructor
+//-----------------------------------------------------------------------------
+LatencyHistogram::LatencyHistogram
+(
+):
+	m_sum( 0 ),
+	m_max( 0 )
+{
+	for( uint32 i=0; i<BucketCount; ++i )
+	{
+		m_buckets[i] = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::Record>
+// Add a latency to the histogram
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Record
+(
+	int32 const _ms
+)
+{
+	uint32 ms = _ms > 0 ? (uint32)_ms : 0;
+	AtomicIncrement( &m_buckets[GetBucket( ms )] );
+	AtomicAdd( &m_sum, ms );
+
+	uint32 max = AtomicLoad( &m_max );
+	while( ms > max && !AtomicCompareExchange( &m_max, max, ms ) )
+	{
+		max = AtomicLoad( &m_max );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetSummary>
+// Fetch the percentiles of the latencies recorded so far
+//-----------------------------------------------------------------------------
+void LatencyHistogram::GetSummary
+(
+	Summary* _summary
+)const
+{
+	// Work from a copy, so the percentiles agree with each other even while latencies are recorded
+	uint32 buckets[BucketCount];
+	uint32 count = 0;
+	for( uint32 i=0; i<BucketCount; ++i )
+	{
+		buckets[i] = AtomicLoad( &m_buckets[i] );
+		count += buckets[i];
+	}
+
+	uint32 max = AtomicLoad( &m_max );
+	_summary->m_count = count;
+	_summary->m_mean = count ? AtomicLoad( &m_sum ) / count : 0;
+	_summary->m_max = max;
+
+	// The rank of each percentile, rounded up so that p99 of a few samples is the highest
+	uint32 const permille[3] = { 500, 900, 990 };
+	uint32* const values[3] = { &_summary->m_p50, &_summary->m_p90, &_summary->m_p99 };
+	uint32 bucket = 0;
+	uint32 seen = 0;
+	for( uint32 i=0; i<3; ++i )
+	{
+		if( count == 0 )
+		{
+			*values[i] = 0;
+			continue;
+		}
+
+		uint32 rank = (uint32)( ( (uint64)count * permille[i] + 999 ) / 1000 );
+		while( seen + buckets[bucket] < rank )
+		{
+			seen += buckets[bucket++];
+		}
+
+		uint32 highest = GetBucketHighest( bucket );
+		*values[i] = highest < max ? highest : max;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetCumulative>
+// Count the latencies at or below each of a set of bounds
+//-----------------------------------------------------------------------------
+void LatencyHistogram::GetCumulative
+(
+	uint32 const* _bounds,
+	uint32 const _boundCount,
+	uint32* o_counts,
+	uint32* o_count,
+	uint32* o_sum
+)const
+{
+	uint32 count = 0;
+	uint32 bound = 0;
+	for( uint32 i=0; i<BucketCount; ++i )
+	{
+		uint32 highest = GetBucketHighest( i );
+		while( bound < _boundCount && highest > _bounds[bound] )
+		{
+			o_counts[bound++] = count;
+		}
+		count += AtomicLoad( &m_buckets[i] );
+	}
+	while( bound < _boundCount )
+	{
+		o_counts[bound++] = count;
+	}
+
+	*o_count = count;
+	*o_sum = AtomicLoad( &m_sum );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::Reset>
+// Discard everything recorded so far
+//-----------------------------------------------------------------------------
+void LatencyHistogram::Reset
+(
+)
+{
+	for( uint32 i=0; i<BucketCount; ++i )
+	{
+		AtomicStore( &m_buckets[i], 0 );
+	}
+	AtomicStore( &m_sum, 0 );
+	AtomicStore( &m_max, 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetBucket>
+// The bucket that counts a latency
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetBucket
+(
+	uint32 _ms
+)
+{
+	if( _ms < LinearBuckets )
+	{
+		return _ms;
+	}
+
+	uint32 exponent = 0;
+	for( uint32 value = _ms; value > 1; value >>= 1 )
+	{
+		++exponent;
+	}
+	if( exponent > MaxExponent )
+	{
+		return BucketCount - 1;
+	}
+
+	// The top SubBucketBits+1 bits pick the bucket within the power of two
+	uint32 shift = exponent - SubBucketBits;
+	return LinearBuckets + ( exponent - SubBucketBits - 1 ) * SubBuckets + ( ( _ms >> shift ) - SubBuckets );
+}
+
+//-----------------------------------------------------------------------------
+// <LatencyHistogram::GetBucketHighest>
+// The highest latency a bucket counts
+//-----------------------------------------------------------------------------
+uint32 LatencyHistogram::GetBucketHighest
+(
+	uint32 _bucket
+)
+{
+	if( _bucket < LinearBuckets )
+	{
+		return _bucket;
+	}
+
+	uint32 exponent = ( _bucket - LinearBuckets ) / SubBuckets + SubBucketBits + 1;
+	uint32 subBucket = ( _bucket - LinearBuckets ) % SubBuckets + SubBuckets;
+	uint32 shift = exponent - SubBucketBits;
+	return ( ( subBucket + 1 ) << shift ) - 1;
+}
@@ -0,0 +1,108 @@
+//-----------------------------------------------------------------------------
+//
+//	LatencyHistogram.h
+//
+//	Lock-free histogram of latencies, for percentile statistics
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _LatencyHistogram_H
+#define _LatencyHistogram_H
+
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief Counts latencies in log-linear buckets, so that percentiles can be reported.
+	 *
+	 * Latencies below 32ms each have a bucket of their own.  Above that, every power of two
+	 * is split into 16 equal buckets, so a percentile is never more than 1/16th (about 6%)
+	 * above the true value, in the manner of an HDR histogram.  Latencies of 2^21ms (about
+	 * 35 minutes) and more all share the last bucket.
+	 *
+	 * Record only uses atomic increments, so any thread may record while another reads
+	 * the summary, and neither ever waits.
+	 */
+	class LatencyHistogram
+	{
+	public:
+		/** Percentiles of the latencies recorded, in milliseconds */
+		struct Summary
+		{
+			uint32 m_count;				// Number of latencies recorded
+			uint32 m_mean;
+			uint32 m_p50;
+			uint32 m_p90;
+			uint32 m_p99;
+			uint32 m_max;
+		};
+
+		LatencyHistogram();
+
+		/**
+		 * Add a latency to the histogram.
+		 * \param _ms the latency in milliseconds.  Negative values count as zero.
+		 */
+		void Record( int32 const _ms );
+
+		/**
+		 * Fetch the percentiles of the latencies recorded so far.
+		 * \param _summary filled in with the percentiles.  All zero if nothing has been recorded.
+		 */
+		void GetSummary( Summary* _summary )const;
+
+		/**
+		 * Count the latencies at or below each of a set of bounds, for exporting as a cumulative histogram.
+		 * A latency is counted against a bound if its whole bucket is at or below it, so the counts
+		 * may be a little low for bounds that do not fall on the edge of a bucket.
+		 * \param _bounds the bounds in milliseconds, in ascending order.
+		 * \param _boundCount number of bounds.
+		 * \param o_counts filled in with the number of latencies at or below each bound.
+		 * \param o_count the number of latencies recorded.
+		 * \param o_sum the sum of the latencies recorded, in milliseconds.
+		 */
+		void GetCumulative( uint32 const* _bounds, uint32 const _boundCount, uint32* o_counts, uint32* o_count, uint32* o_sum )const;
+
+		/**
+		 * Discard everything recorded so far.  Latencies recorded while this runs may be kept or lost.
+		 */
+		void Reset();
+
+	private:
+		enum
+		{
+			SubBucketBits = 4,
+			SubBuckets = 1 << SubBucketBits,
+			LinearBuckets = SubBuckets * 2,			// Values below this have a bucket each
+			MaxExponent = 20,						// Highest power of two with buckets of its own
+			BucketCount = LinearBuckets + ( MaxExponent - SubBucketBits ) * SubBuckets
+		};
+
+		static uint32 GetBucket( uint32 _ms );
+		static uint32 GetBucketHighest( uint32 _bucket );
+
+		volatile uint32	m_buckets[BucketCount];
+		volatile uint32	m_sum;					// Of all the latencies, for the mean
+		volatile uint32	m_max;
+	};
+
+} // namespace OpenZWave
+
+#endif //_LatencyHistogram_H
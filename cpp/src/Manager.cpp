@@ -32,19 +32,26 @@
 
 #include "Defs.h"
 #include "Manager.h"
+#include "CommandClassProfile.h"
+#include "ControllerGroup.h"
 #include "Driver.h"
 #include "Node.h"
 #include "Notification.h"
 #include "Options.h"
 #include "Scene.h"
+#include "SharedPollThread.h"
 #include "Utils.h"
 
+#include "platform/Atomic.h"
 #include "platform/Mutex.h"
 #include "platform/Event.h"
 #include "platform/Log.h"
 
 #include "command_classes/CommandClasses.h"
 #include "command_classes/CommandClass.h"
+#include "command_classes/DoorLockLogging.h"
+#include "command_classes/FirmwareUpdateMetaData.h"
+#include "command_classes/ManufacturerSpecific.h"
 #include "command_classes/WakeUp.h"
 
 #include "value_classes/ValueID.h"
@@ -58,6 +65,7 @@
 #include "value_classes/ValueSchedule.h"
 #include "value_classes/ValueShort.h"
 #include "value_classes/ValueString.h"
+#include "value_classes/ValueStore.h"
 
 using namespace OpenZWave;
 
@@ -141,8 +149,12 @@ ozwversion Manager::getVersion() {
 Manager::Manager
 (
 ):
-m_notificationMutex( new Mutex() )
+m_driverMutex( new Mutex() ),
+m_notificationMutex( new Mutex() ),
+m_sceneEventMutex( new Mutex() )
 {
+	memset( (void*)m_driverIndex, 0, sizeof(m_driverIndex) );
+
 	// Ensure the singleton instance is set
 	s_instance = this;
 
@@ -180,12 +192,45 @@ m_notificationMutex( new Mutex() )
 	int nDumpTrigger = (int) LogLevel_Warning;
 	Options::Get()->GetOptionAsInt( "DumpTriggerLevel", &nDumpTrigger );
 
+	string logFormat = "text";
+	Options::Get()->GetOptionAsString( "LogFormat", &logFormat );
+
 	string logFilename = userPath + logFileNameBase;
-	Log::Create( logFilename, bAppend, bConsoleOutput, (LogLevel) nSaveLogLevel, (LogLevel) nQueueLogLevel, (LogLevel) nDumpTrigger );
+	Log::Create( logFilename, bAppend, bConsoleOutput, (LogLevel) nSaveLogLevel, (LogLevel) nQueueLogLevel, (LogLevel) nDumpTrigger, logFormat == "binary" );
 	Log::SetLoggingState( logging );
 
+	// Trace particular nodes more, or less, closely than the rest
+	string nodeLogLevels;
+	Options::Get()->GetOptionAsString( "NodeLogLevels", &nodeLogLevels );
+	size_t pos = 0;
+	while( pos < nodeLogLevels.size() )
+	{
+		size_t start = nodeLogLevels.find_first_not_of( " \t", pos );
+		if( start == string::npos )
+		{
+			break;
+		}
+		pos = nodeLogLevels.find_first_of( " \t", start );
+		string entry = nodeLogLevels.substr( start, ( pos == string::npos ) ? string::npos : pos - start );
+
+		char* p;
+		long nodeId = strtol( entry.c_str(), &p, 10 );
+		long level = ( *p == '=' ) ? strtol( p + 1, &p, 10 ) : 0;
+		if( nodeId < 1 || nodeId > 255 || level < LogLevel_None || level > LogLevel_StreamDetail || *p != 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: NodeLogLevels entry %s should be a node and a log level, such as 5=9", entry.c_str() );
+			continue;
+		}
+		Log::SetNodeLogLevel( (uint8)nodeId, (LogLevel)level );
+	}
+
+	bool profiling = false;
+	Options::Get()->GetOptionAsBool( "CommandClassProfiling", &profiling );
+	CommandClassProfile::Enable( profiling );
+
 	CommandClasses::RegisterCommandClasses();
 	Scene::ReadScenes();
+	SharedPollThread::Create();
 	Log::Write(LogLevel_Always, "OpenZwave Version %s Starting Up", getVersionAsString().c_str());
 }
 
@@ -197,6 +242,43 @@ Manager::~Manager
 (
 )
 {
+	bool fast = false;
+	Options::Get()->GetOptionAsBool( "FastShutdown", &fast );
+	if( fast )
+	{
+		// Let every driver's threads start winding down, rather than
+		// waiting for each driver in turn
+		for( list<Driver*>::iterator it = m_pendingDrivers.begin(); it != m_pendingDrivers.end(); ++it )
+		{
+			(*it)->SignalExit();
+		}
+		for( map<uint32,Driver*>::iterator it = m_readyDrivers.begin(); it != m_readyDrivers.end(); ++it )
+		{
+			it->second->SignalExit();
+		}
+		for( map<uint32,ControllerGroup*>::iterator it = m_controllerGroups.begin(); it != m_controllerGroups.end(); ++it )
+		{
+			vector<Driver*> standbys;
+			it->second->GetStandbys( &standbys );
+			for( vector<Driver*>::iterator sit = standbys.begin(); sit != standbys.end(); ++sit )
+			{
+				(*sit)->SignalExit();
+			}
+		}
+	}
+
+	// The standbys go first, as they pass what they receive to the ready drivers
+	for( map<uint32,ControllerGroup*>::iterator it = m_controllerGroups.begin(); it != m_controllerGroups.end(); ++it )
+	{
+		vector<Driver*> standbys;
+		it->second->GetStandbys( &standbys );
+		for( vector<Driver*>::iterator sit = standbys.begin(); sit != standbys.end(); ++sit )
+		{
+			it->second->Remove( *sit );
+			delete *sit;
+		}
+	}
+
 	// Clear the pending list
 	while( !m_pendingDrivers.empty() )
 	{
@@ -209,11 +291,28 @@ Manager::~Manager
 	while( !m_readyDrivers.empty() )
 	{
 		map<uint32,Driver*>::iterator it = m_readyDrivers.begin();
+		map<uint32,ControllerGroup*>::iterator git = m_controllerGroups.find( it->first );
+		if( git != m_controllerGroups.end() )
+		{
+			git->second->Remove( it->second );
+		}
 		delete it->second;
 		m_readyDrivers.erase( it );
 	}
+	memset( (void*)m_driverIndex, 0, sizeof(m_driverIndex) );
+
+	for( map<uint32,ControllerGroup*>::iterator it = m_controllerGroups.begin(); it != m_controllerGroups.end(); ++it )
+	{
+		delete it->second;
+	}
+	m_controllerGroups.clear();
+
+	// Only once every driver has left it
+	SharedPollThread::Destroy();
 
+	m_driverMutex->Release();
 	m_notificationMutex->Release();
+	m_sceneEventMutex->Release();
 
 	// Clear the watchers list
 	while( !m_watchers.empty() )
@@ -223,13 +322,11 @@ Manager::~Manager
 		m_watchers.erase( it );
 	}
 
-	// Clear the generic device class list
-	while( !Node::s_genericDeviceClasses.empty() )
-	{
-		map<uint8,Node::GenericDeviceClass*>::iterator git = Node::s_genericDeviceClasses.begin();
-		delete git->second;
-		Node::s_genericDeviceClasses.erase( git );
-	}
+	// Free any device class tables loaded from an override file
+	Node::UnloadDeviceClasses();
+
+	// Free the product tables shared by the drivers
+	ManufacturerSpecific::UnloadProductXML();
 
 	Log::Destroy();
 }
@@ -274,12 +371,14 @@ bool Manager::AddDriver
 )
 {
 	// Make sure we don't already have a driver for this controller
+	m_driverMutex->Lock();
 
 	// Search the pending list
 	for( list<Driver*>::iterator pit = m_pendingDrivers.begin(); pit != m_pendingDrivers.end(); ++pit )
 	{
 		if( _controllerPath == (*pit)->GetControllerPath() )
 		{
+			m_driverMutex->Unlock();
 			Log::Write( LogLevel_Info, "mgr,     Cannot add driver for controller %s - driver already exists", _controllerPath.c_str() );
 			return false;
 		}
@@ -290,6 +389,7 @@ bool Manager::AddDriver
 	{
 		if( _controllerPath == rit->second->GetControllerPath() )
 		{
+			m_driverMutex->Unlock();
 			Log::Write( LogLevel_Info, "mgr,     Cannot add driver for controller %s - driver already exists", _controllerPath.c_str() );
 			return false;
 		}
@@ -297,6 +397,8 @@ bool Manager::AddDriver
 
 	Driver* driver = new Driver( _controllerPath, _interface );
 	m_pendingDrivers.push_back( driver );
+	m_driverMutex->Unlock();
+
 	driver->Start();
 
 	Log::Write( LogLevel_Info, "mgr,     Added driver for controller %s", _controllerPath.c_str() );
@@ -312,18 +414,39 @@ bool Manager::RemoveDriver
 		string const& _controllerPath
 )
 {
+	// The driver is deleted outside the lock, as its threads may call back
+	// into the Manager while they are being stopped
+	m_driverMutex->Lock();
+
 	// Search the pending list
 	for( list<Driver*>::iterator pit = m_pendingDrivers.begin(); pit != m_pendingDrivers.end(); ++pit )
 	{
 		if( _controllerPath == (*pit)->GetControllerPath() )
 		{
-			delete *pit;
+			Driver* driver = *pit;
 			m_pendingDrivers.erase( pit );
+			m_driverMutex->Unlock();
+
+			delete driver;
 			Log::Write( LogLevel_Info, "mgr,     Driver for controller %s removed", _controllerPath.c_str() );
 			return true;
 		}
 	}
 
+	// Search the standbys
+	for( map<uint32,ControllerGroup*>::iterator git = m_controllerGroups.begin(); git != m_controllerGroups.end(); ++git )
+	{
+		if( Driver* driver = git->second->FindStandby( _controllerPath ) )
+		{
+			m_driverMutex->Unlock();
+
+			git->second->Remove( driver );
+			delete driver;
+			Log::Write( LogLevel_Info, "mgr,     Standby driver for controller %s removed", _controllerPath.c_str() );
+			return true;
+		}
+	}
+
 	// Search the ready map
 	for( map<uint32,Driver*>::iterator rit = m_readyDrivers.begin(); rit != m_readyDrivers.end(); ++rit )
 	{
@@ -341,15 +464,37 @@ bool Manager::RemoveDriver
 			 *
 			 * But we can't change this, as the Driver Destructor triggers internal GetDriver calls... which
 			 * will crash and burn if they can't get a valid Driver back...
+			 * So the driver leaves the map first, but stays in m_driverIndex until it has been deleted.
 			 */
 			Log::Write( LogLevel_Info, "mgr,     Driver for controller %s pending removal", _controllerPath.c_str() );
-			delete rit->second;
+			Driver* driver = rit->second;
+			map<uint32,ControllerGroup*>::iterator git = m_controllerGroups.find( rit->first );
+			ControllerGroup* group = ( git != m_controllerGroups.end() ) ? git->second : NULL;
 			m_readyDrivers.erase( rit );
+			m_driverMutex->Unlock();
+
+			// The standbys stop passing it frames before it goes
+			if( group )
+			{
+				group->Remove( driver );
+			}
+			delete driver;
+
+			m_driverMutex->Lock();
+			for( uint32 i = 0; i < c_maxIndexedDrivers; ++i )
+			{
+				if( m_driverIndex[i] == driver )
+				{
+					AtomicStorePtr( &m_driverIndex[i], (Driver*)NULL );
+				}
+			}
+			m_driverMutex->Unlock();
 			Log::Write( LogLevel_Info, "mgr,     Driver for controller %s removed", _controllerPath.c_str() );
 			return true;
 		}
 	}
 
+	m_driverMutex->Unlock();
 	Log::Write( LogLevel_Info, "mgr,     Failed to remove driver for controller %s", _controllerPath.c_str() );
 	return false;
 }
@@ -363,11 +508,27 @@ Driver* Manager::GetDriver
 		uint32 const _homeId
 )
 {
+	// Applications have a handful of controllers at most, so a scan of the
+	// index finds them without taking a lock
+	for( uint32 i = 0; i < c_maxIndexedDrivers; ++i )
+	{
+		Driver* driver = AtomicLoadPtr( &m_driverIndex[i] );
+		if( driver && ( driver->GetHomeId() == _homeId ) )
+		{
+			return driver;
+		}
+	}
+
+	// Any drivers beyond the index are only in the map
+	m_driverMutex->Lock();
 	map<uint32,Driver*>::iterator it = m_readyDrivers.find( _homeId );
 	if( it != m_readyDrivers.end() )
 	{
-		return it->second;
+		Driver* driver = it->second;
+		m_driverMutex->Unlock();
+		return driver;
 	}
+	m_driverMutex->Unlock();
 
 	Log::Write( LogLevel_Error, "mgr,     Manager::GetDriver failed - Home ID 0x%.8x is unknown", _homeId );
 	OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_HOMEID, "Invalid HomeId passed to GetDriver");
@@ -387,6 +548,7 @@ void Manager::SetDriverReady
 {
 	// Search the pending list
 	bool found = false;
+	m_driverMutex->Lock();
 	for( list<Driver*>::iterator it = m_pendingDrivers.begin(); it != m_pendingDrivers.end(); ++it )
 	{
 		if( (*it) == _driver )
@@ -405,9 +567,38 @@ void Manager::SetDriverReady
 			Log::Write( LogLevel_Info, "" );
 		}
 
-		// Add the driver to the ready map
+		// Add the driver to the ready map, and to the index if there is room
 		m_readyDrivers[_driver->GetHomeId()] = _driver;
 
+		// Standbys left by a removed driver carry messages for this one now
+		map<uint32,ControllerGroup*>::iterator git = m_controllerGroups.find( _driver->GetHomeId() );
+		if( git != m_controllerGroups.end() && !git->second->GetPrimary() )
+		{
+			git->second->SetPrimary( _driver );
+			AtomicStorePtr( &_driver->m_group, git->second );
+		}
+		uint32 slot = c_maxIndexedDrivers;
+		for( uint32 i = 0; i < c_maxIndexedDrivers; ++i )
+		{
+			if( m_driverIndex[i] == _driver )
+			{
+				slot = c_maxIndexedDrivers;
+				break;
+			}
+			if( !m_driverIndex[i] && ( slot == c_maxIndexedDrivers ) )
+			{
+				slot = i;
+			}
+		}
+		if( slot < c_maxIndexedDrivers )
+		{
+			AtomicStorePtr( &m_driverIndex[slot], _driver );
+		}
+	}
+	m_driverMutex->Unlock();
+
+	if( found )
+	{
 		// Notify the watchers
 		Notification* notification = new Notification(success ? Notification::Type_DriverReady : Notification::Type_DriverFailed );
 		notification->SetHomeAndNodeIds( _driver->GetHomeId(), _driver->GetControllerNodeId() );
@@ -415,6 +606,55 @@ void Manager::SetDriverReady
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::JoinControllerGroup>
+// Make a driver a standby for the ready driver of the same network.  Called
+// by the driver once it knows its home ID, instead of SetDriverReady.
+//-----------------------------------------------------------------------------
+bool Manager::JoinControllerGroup
+(
+		Driver* _driver
+)
+{
+	bool groups = false;
+	Options::Get()->GetOptionAsBool( "ControllerGroups", &groups );
+	if( !groups )
+	{
+		return false;
+	}
+
+	uint32 homeId = _driver->GetHomeId();
+	LockGuard LG(m_driverMutex);
+	map<uint32,Driver*>::iterator rit = m_readyDrivers.find( homeId );
+	if( rit == m_readyDrivers.end() || rit->second == _driver )
+	{
+		return false;
+	}
+
+	ControllerGroup* group;
+	map<uint32,ControllerGroup*>::iterator git = m_controllerGroups.find( homeId );
+	if( git == m_controllerGroups.end() )
+	{
+		group = new ControllerGroup( homeId );
+		m_controllerGroups[homeId] = group;
+	}
+	else
+	{
+		group = git->second;
+	}
+	if( !group->GetPrimary() )
+	{
+		group->SetPrimary( rit->second );
+		AtomicStorePtr( &rit->second->m_group, group );
+	}
+	group->AddStandby( _driver );
+	AtomicStorePtr( &_driver->m_group, group );
+
+	// A standby is never ready, as the application only sees the primary
+	m_pendingDrivers.remove( _driver );
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetControllerNodeId>
 //
@@ -609,6 +849,23 @@ string Manager::GetControllerPath
 	}
 	return path;
 }
+
+//-----------------------------------------------------------------------------
+// <Manager::GetDriverThreadId>
+// Retrieve the operating system's id for one of the driver's threads
+//-----------------------------------------------------------------------------
+uint64 Manager::GetDriverThreadId
+(
+		uint32 const _homeId,
+		string const& _thread
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetThreadId( _thread );
+	}
+	return 0;
+}
 //-----------------------------------------------------------------------------
 //	Polling Z-Wave values
 //-----------------------------------------------------------------------------
@@ -621,16 +878,18 @@ int32 Manager::GetPollInterval
 (
 )
 {
-	for( map<uint32,Driver*>::iterator rit = m_readyDrivers.begin(); rit != m_readyDrivers.end(); ++rit )
+	int32 interval = 0;
+	m_driverMutex->Lock();
+	if( !m_readyDrivers.empty() )
 	{
-		return rit->second->GetPollInterval();
+		interval = m_readyDrivers.begin()->second->GetPollInterval();
 	}
-	for( list<Driver*>::iterator pit = m_pendingDrivers.begin(); pit != m_pendingDrivers.end(); ++pit )
+	else if( !m_pendingDrivers.empty() )
 	{
-		return (*pit)->GetPollInterval();
+		interval = m_pendingDrivers.front()->GetPollInterval();
 	}
-	return 0;
-
+	m_driverMutex->Unlock();
+	return interval;
 }
 
 //-----------------------------------------------------------------------------
@@ -643,6 +902,7 @@ void Manager::SetPollInterval
 		bool _bIntervalBetweenPolls
 )
 {
+	m_driverMutex->Lock();
 	for( list<Driver*>::iterator pit = m_pendingDrivers.begin(); pit != m_pendingDrivers.end(); ++pit )
 	{
 		(*pit)->SetPollInterval( _milliseconds, _bIntervalBetweenPolls );
@@ -652,6 +912,7 @@ void Manager::SetPollInterval
 	{
 		rit->second->SetPollInterval( _milliseconds, _bIntervalBetweenPolls );
 	}
+	m_driverMutex->Unlock();
 }
 
 //-----------------------------------------------------------------------------
@@ -739,7 +1000,7 @@ uint8 Manager::GetPollIntensity
 	uint8 intensity = 0;
 	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _valueId.GetNodeId() );
 		if( Value* value = driver->GetValue( _valueId ) )
 		{
 			intensity = value->GetPollIntensity();
@@ -752,6 +1013,49 @@ uint8 Manager::GetPollIntensity
 	return intensity;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::SetValuePollInterval>
+// Change the time between polls of this value
+//-----------------------------------------------------------------------------
+void Manager::SetValuePollInterval
+(
+		ValueID const &_valueId,
+		uint32 const _milliseconds
+)
+{
+	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
+	{
+		return( driver->SetValuePollInterval( _valueId, _milliseconds ) );
+	}
+
+	Log::Write( LogLevel_Error, "mgr,     SetValuePollInterval failed - Driver with Home ID 0x%.8x is not available", _valueId.GetHomeId() );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValuePollInterval>
+// Get the time between polls of this value
+//-----------------------------------------------------------------------------
+uint32 Manager::GetValuePollInterval
+(
+		ValueID const &_valueId
+)
+{
+	uint32 interval = 0;
+	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
+	{
+		Driver::NodeGuard LG( driver, _valueId.GetNodeId() );
+		if( Value* value = driver->GetValue( _valueId ) )
+		{
+			interval = value->GetPollInterval();
+			value->Release();
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValuePollInterval");
+		}
+	}
+
+	return interval;
+}
+
 //-----------------------------------------------------------------------------
 //	Retrieving Node information
 //-----------------------------------------------------------------------------
@@ -770,7 +1074,7 @@ bool Manager::RefreshNodeInfo
 	{
 		// Cause the node's data to be obtained from the Z-Wave network
 		// in the same way as if it had just been added.
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		Node* node = driver->GetNode( _nodeId );
 		if( node )
 		{
@@ -794,7 +1098,7 @@ bool Manager::RequestNodeState
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		// Retreive the Node's session and dynamic data
 		Node* node = driver->GetNode( _nodeId );
 		if( node )
@@ -818,7 +1122,7 @@ bool Manager::RequestNodeDynamic
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		// Retreive the Node's dynamic data
 		Node* node = driver->GetNode( _nodeId );
 		if( node )
@@ -830,6 +1134,72 @@ bool Manager::RequestNodeDynamic
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::BeginRefreshRound>
+// Refresh the values of many nodes, a node at a time
+//-----------------------------------------------------------------------------
+bool Manager::BeginRefreshRound
+(
+		uint32 const _homeId,
+		uint8 const _filter,
+		NodeSet const* _nodes
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->BeginRefreshRound( _filter, _nodes );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::CancelRefreshRound>
+// Stop a refresh round
+//-----------------------------------------------------------------------------
+uint32 Manager::CancelRefreshRound
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->CancelRefreshRound();
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetRefreshRoundResult>
+// Get the outcome of the last refresh round
+//-----------------------------------------------------------------------------
+void Manager::GetRefreshRoundResult
+(
+		uint32 const _homeId,
+		Driver::RefreshRoundData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetRefreshRoundResult( _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SyncTime>
+// Set the clocks of all the nodes that have one
+//-----------------------------------------------------------------------------
+uint32 Manager::SyncTime
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SyncTime();
+	}
+	return 0;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::IsNodeListeningDevice>
 // Get whether the node is a listening device that does not go to sleep
@@ -1101,6 +1471,43 @@ uint32 Manager::GetNodeNeighbors
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeNeighborBitmap>
+// Get the bitmap of this node's neighbors, without copying it
+//-----------------------------------------------------------------------------
+uint8 const* Manager::GetNodeNeighborBitmap
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetNodeNeighborBitmap( _nodeId );
+	}
+
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNetworkTopology>
+// Get the neighbor bitmaps of every node, if they have changed
+//-----------------------------------------------------------------------------
+uint32 Manager::GetNetworkTopology
+(
+		uint32 const _homeId,
+		uint8* o_topology,
+		uint32 const _version
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetNetworkTopology( o_topology, _version );
+	}
+
+	return 0;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetNodeManufacturerName>
 // Get the manufacturer name of a node
@@ -1460,7 +1867,7 @@ bool Manager::IsNodeInfoReceived
 		Node *node;
 
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _nodeId );
 
 		if( (node = driver->GetNode( _nodeId ) ) != NULL)
 		{
@@ -1491,7 +1898,7 @@ bool Manager::GetNodeClassInformation
 		Node *node;
 
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _nodeId );
 
 		if( ( node = driver->GetNode( _nodeId ) ) != NULL )
 		{
@@ -1509,6 +1916,15 @@ bool Manager::GetNodeClassInformation
 				// Positive result
 				result = true;
 			}
+			else if( node->NodeInfoReceived() && node->IsControlledClass( _commandClassId, _classVersion ) )
+			{
+				// A class the node controls, which has no object yet
+				if( _className )
+				{
+					*_className = CommandClasses::GetName( _commandClassId );
+				}
+				result = true;
+			}
 		}
 
 	}
@@ -1534,7 +1950,7 @@ bool Manager::IsNodeAwake
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
 		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _nodeId );
 
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
@@ -1560,7 +1976,7 @@ bool Manager::IsNodeFailed
 	bool result = false;
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _nodeId );
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
 			result = !node->IsNodeAlive();
@@ -1582,7 +1998,7 @@ string Manager::GetNodeQueryStage
 	string result = "Unknown";
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _nodeId );
 		if( Node* node = driver->GetNode( _nodeId ) )
 		{
 			result = node->GetQueryStageName( node->GetCurrentQueryStage() );
@@ -1591,6 +2007,51 @@ string Manager::GetNodeQueryStage
 	return result;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::SetNodeQueryPriority>
+// Set how urgently a node is queried
+//-----------------------------------------------------------------------------
+bool Manager::SetNodeQueryPriority
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		Node::QueryPriority const _priority
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			node->SetQueryPriority( _priority );
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeQueryPriority>
+// Get how urgently a node is queried
+//-----------------------------------------------------------------------------
+Node::QueryPriority Manager::GetNodeQueryPriority
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	Node::QueryPriority result = Node::QueryPriority_Normal;
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			result = node->GetQueryPriority();
+		}
+	}
+	return result;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::SetNodeLevel>
 // Helper method to set the basic level of a node
@@ -1624,7 +2085,7 @@ string Manager::GetValueLabel
 	string label;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			label = value->GetLabel();
@@ -1637,6 +2098,37 @@ string Manager::GetValueLabel
 	return label;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetValueLabel>
+// Gets the user-friendly label for the value, sharing its text
+//-----------------------------------------------------------------------------
+bool Manager::GetValueLabel
+(
+		ValueID const& _id,
+		SharedString* o_value
+)
+{
+	bool res = false;
+
+	if( o_value )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( Value* value = driver->GetValue( _id ) )
+			{
+				*o_value = value->GetSharedLabel();
+				value->Release();
+				res = true;
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueLabel");
+			}
+		}
+	}
+
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::SetValueLabel>
 // Sets the user-friendly label for the value
@@ -1649,7 +2141,7 @@ void Manager::SetValueLabel
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetLabel( _value );
@@ -1672,7 +2164,7 @@ string Manager::GetValueUnits
 	string units;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			units = value->GetUnits();
@@ -1685,6 +2177,37 @@ string Manager::GetValueUnits
 	return units;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetValueUnits>
+// Gets the units for the value, sharing its text
+//-----------------------------------------------------------------------------
+bool Manager::GetValueUnits
+(
+		ValueID const& _id,
+		SharedString* o_value
+)
+{
+	bool res = false;
+
+	if( o_value )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( Value* value = driver->GetValue( _id ) )
+			{
+				*o_value = value->GetSharedUnits();
+				value->Release();
+				res = true;
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueUnits");
+			}
+		}
+	}
+
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::SetValueUnits>
 // Sets the units that the value is measured in
@@ -1697,7 +2220,7 @@ void Manager::SetValueUnits
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetUnits( _value );
@@ -1720,7 +2243,7 @@ string Manager::GetValueHelp
 	string help;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			help = value->GetHelp();
@@ -1733,6 +2256,37 @@ string Manager::GetValueHelp
 	return help;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetValueHelp>
+// Gets the help text for the value, sharing its text
+//-----------------------------------------------------------------------------
+bool Manager::GetValueHelp
+(
+		ValueID const& _id,
+		SharedString* o_value
+)
+{
+	bool res = false;
+
+	if( o_value )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( Value* value = driver->GetValue( _id ) )
+			{
+				*o_value = value->GetSharedHelp();
+				value->Release();
+				res = true;
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueHelp");
+			}
+		}
+	}
+
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::SetValueHelp>
 // Sets a help string describing the value's purpose and usage
@@ -1745,7 +2299,7 @@ void Manager::SetValueHelp
 {
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			value->SetHelp( _value );
@@ -1768,7 +2322,7 @@ int32 Manager::GetValueMin
 	int32 limit = 0;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			limit = value->GetMin();
@@ -1793,7 +2347,7 @@ int32 Manager::GetValueMax
 	int32 limit = 0;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			limit = value->GetMax();
@@ -1818,7 +2372,7 @@ bool Manager::IsValueReadOnly
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsReadOnly();
@@ -1843,7 +2397,7 @@ bool Manager::IsValueWriteOnly
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsWriteOnly();
@@ -1868,7 +2422,7 @@ bool Manager::IsValueSet
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsSet();
@@ -1893,7 +2447,7 @@ bool Manager::IsValuePolled
 	bool res = false;
 	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
 		if( Value* value = driver->GetValue( _id ) )
 		{
 			res = value->IsPolled();
@@ -1924,7 +2478,7 @@ bool Manager::GetValueAsBool
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->GetValue();
@@ -1939,7 +2493,7 @@ bool Manager::GetValueAsBool
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->IsPressed();
@@ -1975,7 +2529,7 @@ bool Manager::GetValueAsByte
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->GetValue();
@@ -2011,11 +2565,10 @@ bool Manager::GetValueAsFloat
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
 				{
-					string str = value->GetValue();
-					*o_value = (float)atof( str.c_str() );
+					*o_value = value->GetValueAsFloat();
 					value->Release();
 					res = true;
 				} else {
@@ -2048,7 +2601,7 @@ bool Manager::GetValueAsInt
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->GetValue();
@@ -2085,7 +2638,7 @@ bool Manager::GetValueAsRaw
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
 				{
 					*o_length = value->GetLength();
@@ -2123,7 +2676,7 @@ bool Manager::GetValueAsShort
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->GetValue();
@@ -2158,7 +2711,7 @@ bool Manager::GetValueAsString
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
 
 			switch( _id.GetType() )
 			{
@@ -2327,7 +2880,7 @@ bool Manager::GetValueListSelection
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
 				{
 					ValueList::Item const *item = value->GetItem();
@@ -2352,6 +2905,48 @@ bool Manager::GetValueListSelection
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::GetValueListSelection>
+// Gets the selected item from a list value (sharing its label)
+//-----------------------------------------------------------------------------
+bool Manager::GetValueListSelection
+(
+		ValueID const& _id,
+		SharedString* o_value
+)
+{
+	bool res = false;
+
+	if( o_value )
+	{
+		if( ValueID::ValueType_List == _id.GetType() )
+		{
+			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+			{
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				{
+					ValueList::Item const *item = value->GetItem();
+					if( item != NULL && !item->m_label.empty() )
+					{
+						*o_value = item->m_label;
+						res = true;
+					} else {
+						Log::Write(LogLevel_Warning, "ValueList returned a NULL value for GetValueListSelection: %s", value->GetLabel().c_str());
+					}
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListSelection");
+				}
+			}
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueListSelection is not a List Value");
+		}
+	}
+
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetValueListSelection>
 // Gets the selected item from a list value (returning the index)
@@ -2370,7 +2965,7 @@ bool Manager::GetValueListSelection
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
 				{
 					ValueList::Item const *item = value->GetItem();
@@ -2412,9 +3007,46 @@ bool Manager::GetValueListItems
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				{
+					o_value->clear();
+					res = value->GetItemLabels( o_value );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueListItems");
+				}
+			}
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueListItems is not a List Value");
+		}
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValueListItems>
+// Gets the list of items from a list value, sharing their labels
+//-----------------------------------------------------------------------------
+bool Manager::GetValueListItems
+(
+		ValueID const& _id,
+		vector<SharedString>* o_value
+)
+{
+	bool res = false;
+
+	if( o_value )
+	{
+		if( ValueID::ValueType_List == _id.GetType() )
+		{
+			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+			{
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
 				{
+					// Clearing keeps the capacity, so a reused vector is not reallocated
 					o_value->clear();
 					res = value->GetItemLabels( o_value );
 					value->Release();
@@ -2448,7 +3080,7 @@ bool Manager::GetValueListValues
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
 				{
 					o_value->clear();
@@ -2485,7 +3117,7 @@ bool Manager::GetValueFloatPrecision
 		{
 			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
 				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
 				{
 					*o_value = value->GetPrecision();
@@ -2504,1505 +3136,3022 @@ bool Manager::GetValueFloatPrecision
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a bool
+// <Manager::GetValueHandle>
+// Gets a handle for reading a scalar value without locks
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+ValueHandle Manager::GetValueHandle
 (
-		ValueID const& _id,
-		bool const _value
+		ValueID const& _id
 )
 {
-	bool res = false;
-
-	if( ValueID::ValueType_Bool == _id.GetType() )
+	switch( _id.GetType() )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		case ValueID::ValueType_Bool:
+		case ValueID::ValueType_Byte:
+		case ValueID::ValueType_Short:
+		case ValueID::ValueType_Int:
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( Value* value = driver->GetValue( _id ) )
 				{
-					res = value->Set( _value );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					// The handle keeps the reference GetValue added
+					return ValueHandle( value );
 				}
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueHandle");
 			}
+			break;
+		}
+		default:
+		{
+			OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueHandle is not a Bool, Byte, Short or Int Value");
+			break;
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a bool Value");
 	}
-
-	return res;
+	return ValueHandle();
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a byte
+// <Manager::GetNodeValues>
+// Copies all the values of a node
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+bool Manager::GetNodeValues
 (
-		ValueID const& _id,
-		uint8 const _value
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		ValueSnapshot* o_values,
+		ValueID::ValueGenre const _genre		// = ValueID::ValueGenre_Count
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Byte == _id.GetType() )
+	if( o_values )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		o_values->Clear();
+		if( Driver* driver = GetDriver( _homeId ) )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			Driver::NodeGuard LG( driver, _nodeId );
+			if( Node* node = driver->GetNodeUnsafe( _nodeId ) )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
-				{
-					res = value->Set( _value );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-				}
+				SnapshotNode( node, o_values, _genre );
+				res = true;
 			}
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Byte Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a floating point number
+// <Manager::SnapshotNetwork>
+// Copies all the values of every node in a network
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+bool Manager::SnapshotNetwork
 (
-		ValueID const& _id,
-		float const _value
+		uint32 const _homeId,
+		ValueSnapshot* o_values,
+		ValueID::ValueGenre const _genre		// = ValueID::ValueGenre_Count
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Decimal == _id.GetType() )
+	if( o_values )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		o_values->Clear();
+		if( Driver* driver = GetDriver( _homeId ) )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			ReadLockGuard LG(driver->m_nodeMutex);
+			for( int i=0; i<256; ++i )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+				if( Node* node = driver->GetNodeUnsafe( (uint8)i ) )
 				{
-					char str[256];
-					snprintf( str, sizeof(str), "%f", _value );
-
-					// remove trailing zeros (and the decimal point, if present)
-					// TODO: better way of figuring out which locale is being used ('.' or ',' to separate decimals)
-					size_t nLen;
-					if( ( strchr( str, '.' ) != NULL) || (strchr( str, ',' ) != NULL ) )
-					{
-						for( nLen = strlen( str ) - 1; nLen > 0; nLen-- )
-						{
-							if( str[nLen] == '0' )
-								str[nLen] = 0;
-							else
-								break;
-						}
-						if( (str[nLen] == '.') || (str[nLen] == ',') )
-							str[nLen] = 0;
-					}
-
-					// now set the value
-					res = value->Set( str );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					SnapshotNode( node, o_values, _genre );
 				}
 			}
+			res = true;
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Decimal Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a 32-bit signed integer
+// <Manager::GetChangeSequence>
+// Gets the sequence number of the latest change to a network
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+uint64 Manager::GetChangeSequence
 (
-		ValueID const& _id,
-		int32 const _value
+		uint32 const _homeId
 )
 {
-	bool res = false;
-
-	if( ValueID::ValueType_Int == _id.GetType() )
+	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		LockGuard LG( driver->m_notificationsMutex );
+		if( driver->m_changeJournal )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
-			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
-				{
-					res = value->Set( _value );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-				}
-			}
+			return driver->m_changeJournal->GetSequence();
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Int Value");
 	}
-
-	return res;
+	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a collection of bytes
+// <Manager::GetChangesSince>
+// Gets the changes to a network made after a sequence number
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+bool Manager::GetChangesSince
 (
-		ValueID const& _id,
-		uint8 const* _value,
-		uint8 const _length
+		uint32 const _homeId,
+		uint64 const _sequence,
+		vector<ChangeJournal::Change>* o_changes
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Raw == _id.GetType() )
+	if( o_changes )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		o_changes->clear();
+		if( Driver* driver = GetDriver( _homeId ) )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			LockGuard LG( driver->m_notificationsMutex );
+			if( driver->m_changeJournal )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
-				{
-					res = value->Set( _value, _length );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-				}
+				res = driver->m_changeJournal->GetSince( _sequence, o_changes );
 			}
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Raw Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a 16-bit signed integer
+// <Manager::FindValues>
+// Finds the values of a network that match a query
 //-----------------------------------------------------------------------------
-bool Manager::SetValue
+bool Manager::FindValues
 (
-		ValueID const& _id,
-		int16 const _value
+		uint32 const _homeId,
+		ValueIndex::Query const& _query,
+		vector<ValueID>* o_values
 )
 {
-	bool res = false;
-
-	if( ValueID::ValueType_Short == _id.GetType() )
+	if( o_values )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		o_values->clear();
+		if( Driver* driver = GetDriver( _homeId ) )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			if( driver->m_valueIndex )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
-				{
-					res = value->Set( _value );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-				}
+				driver->m_valueIndex->Find( _query, o_values );
 			}
+			return true;
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Short Value");
 	}
 
-	return res;
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetValueListSelection>
-// Sets the selected item in a list by value
+// <Manager::WriteNetworkState>
+// Writes the nodes and values of a network as JSON or CBOR
 //-----------------------------------------------------------------------------
-bool Manager::SetValueListSelection
+bool Manager::WriteNetworkState
 (
-		ValueID const& _id,
-		string const& _selectedItem
+		uint32 const _homeId,
+		StateWriter::Format const _format,
+		string* o_buffer,
+		uint64 const _since		// = 0
 )
 {
-	bool res = false;
+	Driver* driver = o_buffer ? GetDriver( _homeId ) : NULL;
+	if( !driver )
+	{
+		return false;
+	}
 
-	if( ValueID::ValueType_List == _id.GetType() )
+	// Find what changed, before the nodes are read, so nothing that changes
+	// while they are read is missed by the next call
+	uint64 sequence = 0;
+	bool full = true;
+	vector<ChangeJournal::Change> changes;
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		LockGuard LG( driver->m_notificationsMutex );
+		if( driver->m_changeJournal )
 		{
-			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			sequence = driver->m_changeJournal->GetSequence();
+			if( _since )
 			{
-				LockGuard LG(driver->m_nodeMutex);
-				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
-				{
-					res = value->SetByLabel( _selectedItem );
-					value->Release();
-				} else {
-					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueListSelection");
-				}
+				full = !driver->m_changeJournal->GetSince( _since, &changes );
 			}
-
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValueListSelection is not a List Value");
 	}
 
-	return res;
-}
-
-//-----------------------------------------------------------------------------
-// <Manager::SetValue>
-// Sets the value from a string
-//-----------------------------------------------------------------------------
-bool Manager::SetValue
-(
-		ValueID const& _id,
-		string const& _value
-)
-{
-	bool res = false;
-
-	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	// The nodes to write, and the values of each that changed
+	map<uint8,vector<ValueID> > changedValues;
+	set<uint8> removedNodes;
+	vector<ValueID> removedValues;
+	if( !full )
 	{
-		if( _id.GetNodeId() != driver->GetControllerNodeId() )
+		for( vector<ChangeJournal::Change>::const_iterator it = changes.begin(); it != changes.end() && !full; ++it )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-
-			switch( _id.GetType() )
+			uint8 nodeId = it->m_valueId.GetNodeId();
+			switch( it->m_type )
 			{
-				case ValueID::ValueType_Bool:
+				case Notification::Type_ValueAdded:
+				case Notification::Type_ValueChanged:
+				case Notification::Type_ValueRemoved:
 				{
-					if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
-					{
-						if( !strcasecmp( "true", _value.c_str() ) )
-						{
-							res = value->Set( true );
-						}
-						else if( !strcasecmp( "false", _value.c_str() ) )
-						{
-							res = value->Set( false );
-						}
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
+					changedValues[nodeId].push_back( it->m_valueId );
 					break;
 				}
-				case ValueID::ValueType_Byte:
+				case Notification::Type_NodeRemoved:
 				{
-					if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
-					{
-						uint32 val = (uint32)atoi( _value.c_str() );
-						if( val < 256 )
-						{
-							res = value->Set( (uint8)val );
-						}
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
+					removedNodes.insert( nodeId );
+					changedValues.erase( nodeId );
 					break;
 				}
-				case ValueID::ValueType_Decimal:
+				case Notification::Type_DriverReset:
 				{
-					if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
-					{
-						res = value->Set( _value );
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
+					full = true;
 					break;
 				}
-				case ValueID::ValueType_Int:
+				default:
 				{
-					if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
-					{
-						int32 val = atoi( _value.c_str() );
-						res = value->Set( val );
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
+					changedValues[nodeId];
+					removedNodes.erase( nodeId );
 					break;
 				}
-				case ValueID::ValueType_List:
+			}
+		}
+	}
+
+	StateWriter writer( _format, o_buffer );
+	writer.BeginObject();
+	writer.Key( "homeId" );
+	writer.UInt( _homeId );
+	writer.Key( "sequence" );
+	writer.UInt( sequence );
+	writer.Key( "full" );
+	writer.Bool( full );
+
+	writer.Key( "nodes" );
+	writer.BeginArray();
+	{
+		ReadLockGuard LG( driver->m_nodeMutex );
+		if( full )
+		{
+			for( int i=0; i<256; ++i )
+			{
+				if( Node* node = driver->GetNodeUnsafe( (uint8)i ) )
 				{
-					if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
-					{
-						res = value->SetByLabel( _value );
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
-					break;
+					WriteNodeState( writer, node, NULL );
 				}
-				case ValueID::ValueType_Short:
+			}
+		}
+		else
+		{
+			for( map<uint8,vector<ValueID> >::iterator it = changedValues.begin(); it != changedValues.end(); ++it )
+			{
+				Node* node = driver->GetNodeUnsafe( it->first );
+				if( !node )
 				{
-					if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
-					{
-						int32 val = (uint32)atoi( _value.c_str() );
-						if( ( val < 32768 ) && ( val >= -32768 ) )
-						{
-							res = value->Set( (int16)val );
-						}
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
-					}
-					break;
+					removedNodes.insert( it->first );
+					continue;
 				}
-				case ValueID::ValueType_String:
+
+				// Values that changed several times are written once, and those
+				// no longer in the node are listed as removed
+				vector<ValueID>& ids = it->second;
+				sort( ids.begin(), ids.end() );
+				ids.erase( unique( ids.begin(), ids.end() ), ids.end() );
+				vector<ValueID> present;
+				for( vector<ValueID>::const_iterator vit = ids.begin(); vit != ids.end(); ++vit )
 				{
-					if( ValueString* value = static_cast<ValueString*>( driver->GetValue( _id ) ) )
+					if( Value* value = node->GetValue( *vit ) )
 					{
-						res = value->Set( _value );
+						present.push_back( *vit );
 						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
 					}
-					break;
-				}
-				case ValueID::ValueType_Raw:
-				{
-					if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
+					else
 					{
-						res = value->SetFromString( _value );
-						value->Release();
-					} else {
-						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+						removedValues.push_back( *vit );
 					}
-					break;
 				}
-				case ValueID::ValueType_Schedule:
-				case ValueID::ValueType_Button:
+				WriteNodeState( writer, node, &present );
+			}
+
+			// A node that was removed may have been added again since
+			for( set<uint8>::iterator it = removedNodes.begin(); it != removedNodes.end(); )
+			{
+				if( driver->GetNodeUnsafe( *it ) )
 				{
-					OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueFloatPrecision is not a Decimal Value");
-					break;
+					removedNodes.erase( it++ );
+				}
+				else
+				{
+					++it;
 				}
 			}
 		}
 	}
-	return res;
-}
-
-//-----------------------------------------------------------------------------
-// <Manager::RefreshValue>
-// Instruct the driver to refresh this value by sending a message to the device
-//-----------------------------------------------------------------------------
-bool Manager::RefreshValue
-(
-		ValueID const& _id
-)
-{
-	bool bRet = false;	// return value
+	writer.EndArray();
 
-	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	writer.Key( "removedNodes" );
+	writer.BeginArray();
+	for( set<uint8>::const_iterator it = removedNodes.begin(); it != removedNodes.end(); ++it )
 	{
-		Node *node;
-
-		// Need to lock and unlock nodes to check this information
-		LockGuard LG(driver->m_nodeMutex);
+		writer.UInt( *it );
+	}
+	writer.EndArray();
 
-		if( (node = driver->GetNode( _id.GetNodeId() ) ) != NULL)
-		{
-			CommandClass* cc = node->GetCommandClass( _id.GetCommandClassId() );
-			if (cc) {
-				uint8 index = _id.GetIndex();
-				uint8 instance = _id.GetInstance();
-				Log::Write( LogLevel_Info, "mgr,     Refreshing node %d: %s index = %d instance = %d (to confirm a reported change)", node->m_nodeId, cc->GetCommandClassName().c_str(), index, instance );
-				cc->RequestValue( 0, index, instance, Driver::MsgQueue_Send );
-				bRet = true;
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to RefreshValue");
-				bRet = false;
-			}
-		}
+	writer.Key( "removedValues" );
+	writer.BeginArray();
+	char id[24];
+	for( vector<ValueID>::const_iterator it = removedValues.begin(); it != removedValues.end(); ++it )
+	{
+		snprintf( id, sizeof(id), "%llu", (unsigned long long)it->GetId() );
+		writer.String( id );
 	}
-	return bRet;
+	writer.EndArray();
+
+	writer.EndObject();
+	return true;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetChangeVerified>
-// Set the verify changes flag for the specified value
+// <Manager::WriteNodeState>
+// Write a node, with all its values or only those listed.  The caller holds the node lock.
 //-----------------------------------------------------------------------------
-void Manager::SetChangeVerified
+void Manager::WriteNodeState
 (
-		ValueID const& _id,
-		bool _verify
+		StateWriter& _writer,
+		Node* _node,
+		vector<ValueID> const* _values
 )
 {
-	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	bool awake = true;
+	if( !_node->IsListeningDevice() )
 	{
-		LockGuard LG(driver->m_nodeMutex);
-		if( Value* value = driver->GetValue( _id ) )
+		if( WakeUp* wcc = static_cast<WakeUp*>( _node->GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
 		{
-			value->SetChangeVerified( _verify );
-			value->Release();
-		} else {
-			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetChangeVerified");
+			awake = wcc->IsAwake();
 		}
 	}
-}
 
-//-----------------------------------------------------------------------------
-// <Manager::GetChangeVerified>
-// Get the verify changes flag for the specified value
-//-----------------------------------------------------------------------------
-bool Manager::GetChangeVerified
-(
-		ValueID const& _id
-)
-{
-	bool res = false;
-	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	_writer.BeginObject();
+	_writer.Key( "id" );
+	_writer.UInt( _node->GetNodeId() );
+	_writer.Key( "name" );
+	_writer.String( _node->m_nodeName );
+	_writer.Key( "location" );
+	_writer.String( _node->m_location );
+	_writer.Key( "manufacturer" );
+	_writer.String( _node->m_manufacturerName );
+	_writer.Key( "product" );
+	_writer.String( _node->m_productName );
+	_writer.Key( "manufacturerId" );
+	_writer.UInt( _node->m_manufacturerId );
+	_writer.Key( "productType" );
+	_writer.UInt( _node->m_productType );
+	_writer.Key( "productId" );
+	_writer.UInt( _node->m_productId );
+	_writer.Key( "type" );
+	_writer.String( _node->m_type );
+	_writer.Key( "listening" );
+	_writer.Bool( _node->IsListeningDevice() );
+	_writer.Key( "frequentListening" );
+	_writer.Bool( _node->IsFrequentListeningDevice() );
+	_writer.Key( "awake" );
+	_writer.Bool( awake );
+	_writer.Key( "failed" );
+	_writer.Bool( !_node->IsNodeAlive() );
+	_writer.Key( "zwavePlus" );
+	_writer.Bool( _node->IsNodeZWavePlus() );
+	_writer.Key( "queryStage" );
+	_writer.String( _node->GetQueryStageName( _node->GetCurrentQueryStage() ) );
+
+	_writer.Key( "values" );
+	_writer.BeginArray();
+	if( _values )
+	{
+		for( vector<ValueID>::const_iterator it = _values->begin(); it != _values->end(); ++it )
+		{
+			if( Value* value = _node->GetValue( *it ) )
+			{
+				WriteValueState( _writer, value );
+				value->Release();
+			}
+		}
+	}
+	else
 	{
-		LockGuard LG(driver->m_nodeMutex);
-		if( Value* value = driver->GetValue( _id ) )
+		ValueStore* store = _node->GetValueStore();
+		for( ValueStore::Iterator it = store->Begin(); it != store->End(); ++it )
 		{
-			res = value->GetChangeVerified();
-			value->Release();
-		} else {
-			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetChangeVerified");
+			WriteValueState( _writer, it->second );
 		}
 	}
-	return res;
+	_writer.EndArray();
+	_writer.EndObject();
 }
 
-
 //-----------------------------------------------------------------------------
-// <Manager::PressButton>
-// Starts an activity in a device.
+// <Manager::WriteValueState>
+// Write a value
 //-----------------------------------------------------------------------------
-bool Manager::PressButton
+void Manager::WriteValueState
 (
-		ValueID const& _id
+		StateWriter& _writer,
+		Value* _value
 )
 {
-	bool res = false;
+	ValueID const& valueId = _value->GetID();
+	char id[24];
+	snprintf( id, sizeof(id), "%llu", (unsigned long long)valueId.GetId() );
 
-	if( ValueID::ValueType_Button == _id.GetType() )
+	_writer.BeginObject();
+	_writer.Key( "id" );
+	_writer.String( id );
+	_writer.Key( "genre" );
+	_writer.String( Value::GetGenreNameFromEnum( valueId.GetGenre() ) );
+	_writer.Key( "commandClass" );
+	_writer.UInt( valueId.GetCommandClassId() );
+	_writer.Key( "instance" );
+	_writer.UInt( valueId.GetInstance() );
+	_writer.Key( "index" );
+	_writer.UInt( valueId.GetIndex() );
+	_writer.Key( "type" );
+	_writer.String( Value::GetTypeNameFromEnum( valueId.GetType() ) );
+	_writer.Key( "label" );
+	_writer.String( _value->GetLabel() );
+	_writer.Key( "units" );
+	_writer.String( _value->GetUnits() );
+	_writer.Key( "readOnly" );
+	_writer.Bool( _value->IsReadOnly() );
+	_writer.Key( "writeOnly" );
+	_writer.Bool( _value->IsWriteOnly() );
+	_writer.Key( "set" );
+	_writer.Bool( _value->IsSet() );
+
+	_writer.Key( "value" );
+	switch( valueId.GetType() )
 	{
-		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		case ValueID::ValueType_Bool:
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+			_writer.Bool( static_cast<ValueBool*>( _value )->GetValue() );
+			break;
+		}
+		case ValueID::ValueType_Button:
+		{
+			_writer.Bool( static_cast<ValueButton*>( _value )->IsPressed() );
+			break;
+		}
+		case ValueID::ValueType_Byte:
+		{
+			_writer.UInt( static_cast<ValueByte*>( _value )->GetValue() );
+			break;
+		}
+		case ValueID::ValueType_Short:
+		{
+			_writer.Int( static_cast<ValueShort*>( _value )->GetValue() );
+			break;
+		}
+		case ValueID::ValueType_Int:
+		{
+			_writer.Int( static_cast<ValueInt*>( _value )->GetValue() );
+			break;
+		}
+		case ValueID::ValueType_List:
+		{
+			// A list may have nothing selected yet
+			if( ValueList::Item const* item = static_cast<ValueList*>( _value )->GetItem() )
 			{
-				res = value->PressButton();
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to PressButton");
+				_writer.String( item->m_label );
+				_writer.Key( "listValue" );
+				_writer.Int( item->m_value );
+			}
+			else
+			{
+				_writer.Null();
 			}
+			break;
+		}
+		default:
+		{
+			_writer.String( _value->GetAsString() );
+			break;
 		}
-	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to PressButton is not a Button Value");
 	}
+	_writer.EndObject();
+}
 
-	return res;
+//-----------------------------------------------------------------------------
+// <Manager::SnapshotNode>
+// Append a node's values to a snapshot.  The caller holds the node lock.
+//-----------------------------------------------------------------------------
+void Manager::SnapshotNode
+(
+		Node* _node,
+		ValueSnapshot* o_values,
+		ValueID::ValueGenre const _genre
+)
+{
+	ValueStore* store = _node->GetValueStore();
+	for( ValueStore::Iterator it = store->Begin(); it != store->End(); ++it )
+	{
+		Value* value = it->second;
+		if( ValueID::ValueGenre_Count == _genre || value->GetID().GetGenre() == _genre )
+		{
+			o_values->Add( value );
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::ReleaseButton>
-// Stops an activity in a device.
+// <Manager::SetValue>
+// Sets the value from a bool
 //-----------------------------------------------------------------------------
-bool Manager::ReleaseButton
+bool Manager::SetValue
 (
-		ValueID const& _id
+		ValueID const& _id,
+		bool const _value
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Button == _id.GetType() )
+	if( ValueID::ValueType_Bool == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				res = value->ReleaseButton();
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to ReleaseButton");
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
+				{
+					res = value->Set( _value );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+				}
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to ReleaseButton is not a Button Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a bool Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// Climate Control Schedules
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Manager::GetNumSwitchPoints>
-// Get the number of switch points defined in a schedule
+// <Manager::SetValue>
+// Sets the value from a byte
 //-----------------------------------------------------------------------------
-uint8 Manager::GetNumSwitchPoints
+bool Manager::SetValue
 (
-		ValueID const& _id
+		ValueID const& _id,
+		uint8 const _value
 )
 {
-	//	bool res = false;
+	bool res = false;
 
-	uint8 numSwitchPoints = 0;
-	if( ValueID::ValueType_Schedule == _id.GetType() )
+	if( ValueID::ValueType_Byte == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				numSwitchPoints = value->GetNumSwitchPoints();
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetNumSwitchPoints");
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
+				{
+					res = value->Set( _value );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+				}
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetNumSwitchPoints is not a Schedule Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Byte Value");
 	}
 
-	return numSwitchPoints;
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SetSwitchPoint>
-// Set a switch point in the schedule
+// <Manager::SetValue>
+// Sets the value from a floating point number
 //-----------------------------------------------------------------------------
-bool Manager::SetSwitchPoint
+bool Manager::SetValue
 (
 		ValueID const& _id,
-		uint8 const _hours,
-		uint8 const _minutes,
-		int8 const _setback
+		float const _value
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Schedule == _id.GetType() )
+	if( ValueID::ValueType_Decimal == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				res = value->SetSwitchPoint( _hours, _minutes, _setback );
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetSwitchPoint");
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+				{
+					char str[256];
+					snprintf( str, sizeof(str), "%f", _value );
+
+					// remove trailing zeros (and the decimal point, if present)
+					// TODO: better way of figuring out which locale is being used ('.' or ',' to separate decimals)
+					size_t nLen;
+					if( ( strchr( str, '.' ) != NULL) || (strchr( str, ',' ) != NULL ) )
+					{
+						for( nLen = strlen( str ) - 1; nLen > 0; nLen-- )
+						{
+							if( str[nLen] == '0' )
+								str[nLen] = 0;
+							else
+								break;
+						}
+						if( (str[nLen] == '.') || (str[nLen] == ',') )
+							str[nLen] = 0;
+					}
+
+					// now set the value
+					res = value->Set( str );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+				}
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetSwitchPoint is not a Schedule Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Decimal Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RemoveSwitchPoint>
-// Remove a switch point from the schedule
+// <Manager::SetValue>
+// Sets the value from a 32-bit signed integer
 //-----------------------------------------------------------------------------
-bool Manager::RemoveSwitchPoint
+bool Manager::SetValue
 (
 		ValueID const& _id,
-		uint8 const _hours,
-		uint8 const _minutes
+		int32 const _value
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Schedule == _id.GetType() )
+	if( ValueID::ValueType_Int == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				uint8 idx;
-				res = value->FindSwitchPoint( _hours, _minutes, &idx );
-
-				if( res )
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
 				{
-					res = value->RemoveSwitchPoint( idx );
+					res = value->Set( _value );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
 				}
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to RemoveSwitchPoint");
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to RemoveSwitchPoint is not a Schedule Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Int Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::ClearSwitchPoints>
-// Clears all switch points from the schedule
+// <Manager::SetValue>
+// Sets the value from a collection of bytes
 //-----------------------------------------------------------------------------
-void Manager::ClearSwitchPoints
+bool Manager::SetValue
 (
-		ValueID const& _id
+		ValueID const& _id,
+		uint8 const* _value,
+		uint8 const _length
 )
 {
-	if( ValueID::ValueType_Schedule == _id.GetType() )
+	bool res = false;
+
+	if( ValueID::ValueType_Raw == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				value->ClearSwitchPoints();
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to ClearSwitchPoints");
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
+				{
+					res = value->Set( _value, _length );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+				}
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to ClearSwitchPoints is not a Schedule Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Raw Value");
 	}
+
+	return res;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::GetSwitchPoint>
-// Gets switch point data from the schedule
+// <Manager::SetValue>
+// Sets the value from a 16-bit signed integer
 //-----------------------------------------------------------------------------
-bool Manager::GetSwitchPoint
+bool Manager::SetValue
 (
 		ValueID const& _id,
-		uint8 const _idx,
-		uint8* o_hours,
-		uint8* o_minutes,
-		int8* o_setback
+		int16 const _value
 )
 {
 	bool res = false;
 
-	if( ValueID::ValueType_Schedule == _id.GetType() )
+	if( ValueID::ValueType_Short == _id.GetType() )
 	{
 		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
 		{
-			LockGuard LG(driver->m_nodeMutex);
-			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
 			{
-				res = value->GetSwitchPoint( _idx, o_hours, o_minutes, o_setback );
-				value->Release();
-			} else {
-				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetSwitchPoint");
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
+				{
+					res = value->Set( _value );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+				}
 			}
 		}
 	} else {
-		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetSwitchPoint is not a Schedule Value");
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValue is not a Short Value");
 	}
 
 	return res;
 }
 
 //-----------------------------------------------------------------------------
-//	SwitchAll
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Manager::SwitchAllOn>
-// All devices that support the SwitchAll command class will be turned on
+// <Manager::SetValueListSelection>
+// Sets the selected item in a list by value
+//-----------------------------------------------------------------------------
+bool Manager::SetValueListSelection
+(
+		ValueID const& _id,
+		string const& _selectedItem
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_List == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			if( _id.GetNodeId() != driver->GetControllerNodeId() )
+			{
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+				{
+					res = value->SetByLabel( _selectedItem );
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueListSelection");
+				}
+			}
+
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValueListSelection is not a List Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValue>
+// Sets the value from a string
+//-----------------------------------------------------------------------------
+bool Manager::SetValue
+(
+		ValueID const& _id,
+		string const& _value
+)
+{
+	bool res = false;
+
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		if( _id.GetNodeId() != driver->GetControllerNodeId() )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+
+			switch( _id.GetType() )
+			{
+				case ValueID::ValueType_Bool:
+				{
+					if( ValueBool* value = static_cast<ValueBool*>( driver->GetValue( _id ) ) )
+					{
+						if( !strcasecmp( "true", _value.c_str() ) )
+						{
+							res = value->Set( true );
+						}
+						else if( !strcasecmp( "false", _value.c_str() ) )
+						{
+							res = value->Set( false );
+						}
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Byte:
+				{
+					if( ValueByte* value = static_cast<ValueByte*>( driver->GetValue( _id ) ) )
+					{
+						uint32 val = (uint32)atoi( _value.c_str() );
+						if( val < 256 )
+						{
+							res = value->Set( (uint8)val );
+						}
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Decimal:
+				{
+					if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+					{
+						res = value->Set( _value );
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Int:
+				{
+					if( ValueInt* value = static_cast<ValueInt*>( driver->GetValue( _id ) ) )
+					{
+						int32 val = atoi( _value.c_str() );
+						res = value->Set( val );
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_List:
+				{
+					if( ValueList* value = static_cast<ValueList*>( driver->GetValue( _id ) ) )
+					{
+						res = value->SetByLabel( _value );
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Short:
+				{
+					if( ValueShort* value = static_cast<ValueShort*>( driver->GetValue( _id ) ) )
+					{
+						int32 val = (uint32)atoi( _value.c_str() );
+						if( ( val < 32768 ) && ( val >= -32768 ) )
+						{
+							res = value->Set( (int16)val );
+						}
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_String:
+				{
+					if( ValueString* value = static_cast<ValueString*>( driver->GetValue( _id ) ) )
+					{
+						res = value->Set( _value );
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Raw:
+				{
+					if( ValueRaw* value = static_cast<ValueRaw*>( driver->GetValue( _id ) ) )
+					{
+						res = value->SetFromString( _value );
+						value->Release();
+					} else {
+						OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValue");
+					}
+					break;
+				}
+				case ValueID::ValueType_Schedule:
+				case ValueID::ValueType_Button:
+				{
+					OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueFloatPrecision is not a Decimal Value");
+					break;
+				}
+			}
+		}
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValueAsync>
+// Sets the value from a string, calling back with the outcome
+//-----------------------------------------------------------------------------
+bool Manager::SetValueAsync
+(
+		ValueID const& _id,
+		string const& _value,
+		Driver::pfnSetValueCallback_t _callback,
+		void* _context,
+		uint32 const _timeout
+)
+{
+	Driver* driver = GetDriver( _id.GetHomeId() );
+	if( driver == NULL || _id.GetNodeId() == driver->GetControllerNodeId() )
+	{
+		return false;
+	}
+	if( ValueID::ValueType_Schedule == _id.GetType() || ValueID::ValueType_Button == _id.GetType() )
+	{
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValueAsync cannot be set from a string");
+		return false;
+	}
+
+	// Watch for the outcome before the set is sent, so that a quick report is not missed
+	{
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+		Value* value = driver->GetValue( _id );
+		if( value == NULL )
+		{
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueAsync");
+			return false;
+		}
+		driver->BeginValueSet( value, _value, _timeout, _callback, _context );
+		value->Release();
+	}
+
+	if( !SetValue( _id, _value ) )
+	{
+		driver->EndValueSet( _id );
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValues>
+// Sets several values from strings, packing the commands for each node
+//-----------------------------------------------------------------------------
+bool Manager::SetValues
+(
+		vector< pair<ValueID,string> > const& _values
+)
+{
+	// Each network's driver sets its own values
+	map< uint32, vector< pair<ValueID,string> > > networks;
+	for( vector< pair<ValueID,string> >::const_iterator it = _values.begin(); it != _values.end(); ++it )
+	{
+		networks[it->first.GetHomeId()].push_back( *it );
+	}
+
+	bool res = true;
+	for( map< uint32, vector< pair<ValueID,string> > >::iterator it = networks.begin(); it != networks.end(); ++it )
+	{
+		Driver* driver = GetDriver( it->first );
+		if( !driver || !driver->SetValues( it->second ) )
+		{
+			res = false;
+		}
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RefreshValue>
+// Instruct the driver to refresh this value by sending a message to the device
+//-----------------------------------------------------------------------------
+bool Manager::RefreshValue
+(
+		ValueID const& _id
+)
+{
+	return RefreshValue( _id, -1 );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RefreshValue>
+// Refresh this value, unless it was read from the device recently enough
+//-----------------------------------------------------------------------------
+bool Manager::RefreshValue
+(
+		ValueID const& _id,
+		int32 const _maxAge
+)
+{
+	bool bRet = false;	// return value
+
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		Node *node;
+
+		// Need to lock and unlock nodes to check this information
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+
+		if( (node = driver->GetNode( _id.GetNodeId() ) ) != NULL)
+		{
+			CommandClass* cc = node->GetCommandClass( _id.GetCommandClassId() );
+			if (cc) {
+				uint8 index = _id.GetIndex();
+				uint8 instance = _id.GetInstance();
+				Log::Write( LogLevel_Info, "mgr,     Refreshing node %d: %s index = %d instance = %d (to confirm a reported change)", node->m_nodeId, cc->GetCommandClassName().c_str(), index, instance );
+				cc->RequestValueIfStale( _maxAge, 0, index, instance, Driver::MsgQueue_Send );
+				bRet = true;
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to RefreshValue");
+				bRet = false;
+			}
+		}
+	}
+	return bRet;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RefreshThermostat>
+// Refresh a thermostat's stale values together
+//-----------------------------------------------------------------------------
+bool Manager::RefreshThermostat
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		int32 const _maxAge
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->RefreshThermostat( _nodeId, _maxAge );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetChangeVerified>
+// Set the verify changes flag for the specified value
+//-----------------------------------------------------------------------------
+void Manager::SetChangeVerified
+(
+		ValueID const& _id,
+		bool _verify
+)
+{
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+		if( Value* value = driver->GetValue( _id ) )
+		{
+			value->SetChangeVerified( _verify );
+			value->Release();
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetChangeVerified");
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetChangeVerified>
+// Get the verify changes flag for the specified value
+//-----------------------------------------------------------------------------
+bool Manager::GetChangeVerified
+(
+		ValueID const& _id
+)
+{
+	bool res = false;
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+		if( Value* value = driver->GetValue( _id ) )
+		{
+			res = value->GetChangeVerified();
+			value->Release();
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetChangeVerified");
+		}
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValueNotificationInterval>
+// Set the shortest time between notifications for the specified value
+//-----------------------------------------------------------------------------
+void Manager::SetValueNotificationInterval
+(
+		ValueID const& _id,
+		uint32 const _milliseconds
+)
+{
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+		if( Value* value = driver->GetValue( _id ) )
+		{
+			driver->SetNotificationInterval( _id, _milliseconds );
+			value->Release();
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueNotificationInterval");
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValueNotificationInterval>
+// Get the shortest time between notifications for the specified value
+//-----------------------------------------------------------------------------
+uint32 Manager::GetValueNotificationInterval
+(
+		ValueID const& _id
+)
+{
+	uint32 res = 0;
+	if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+	{
+		Driver::NodeGuard LG( driver, _id.GetNodeId() );
+		if( Value* value = driver->GetValue( _id ) )
+		{
+			res = driver->GetNotificationInterval( _id );
+			value->Release();
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueNotificationInterval");
+		}
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValueDeadband>
+// Set the smallest change of the specified value that is notified
+//-----------------------------------------------------------------------------
+void Manager::SetValueDeadband
+(
+		ValueID const& _id,
+		float const _deadband,
+		bool const _percent
+)
+{
+	ValueID::ValueType type = _id.GetType();
+	if( ValueID::ValueType_Decimal == type || ValueID::ValueType_Int == type || ValueID::ValueType_Short == type )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( Value* value = driver->GetValue( _id ) )
+			{
+				value->SetDeadband( _deadband, _percent );
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueDeadband");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValueDeadband is not a Decimal, Int or Short Value");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValueDeadband>
+// Get the smallest change of the specified value that is notified
+//-----------------------------------------------------------------------------
+float Manager::GetValueDeadband
+(
+		ValueID const& _id,
+		bool* o_percent		// = NULL
+)
+{
+	float res = 0.0f;
+	ValueID::ValueType type = _id.GetType();
+	if( ValueID::ValueType_Decimal == type || ValueID::ValueType_Int == type || ValueID::ValueType_Short == type )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( Value* value = driver->GetValue( _id ) )
+			{
+				res = value->GetDeadband();
+				if( o_percent )
+				{
+					*o_percent = value->IsDeadbandPercent();
+				}
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueDeadband");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueDeadband is not a Decimal, Int or Short Value");
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetValueHistoryDepth>
+// Keep the most recent readings of the specified value
+//-----------------------------------------------------------------------------
+void Manager::SetValueHistoryDepth
+(
+		ValueID const& _id,
+		uint32 const _depth
+)
+{
+	if( ValueID::ValueType_Decimal == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+			{
+				value->SetHistoryDepth( _depth );
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetValueHistoryDepth");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetValueHistoryDepth is not a Decimal Value");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetValueHistory>
+// Get the recent readings of the specified value
+//-----------------------------------------------------------------------------
+bool Manager::GetValueHistory
+(
+		ValueID const& _id,
+		uint32 const _since,
+		vector<ValueHistory::Sample>* o_samples
+)
+{
+	bool res = false;
+
+	if( o_samples )
+	{
+		o_samples->clear();
+		if( ValueID::ValueType_Decimal == _id.GetType() )
+		{
+			if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+			{
+				Driver::NodeGuard LG( driver, _id.GetNodeId() );
+				if( ValueDecimal* value = static_cast<ValueDecimal*>( driver->GetValue( _id ) ) )
+				{
+					if( ValueHistory const* history = value->GetHistory() )
+					{
+						history->Get( _since, o_samples );
+						res = true;
+					}
+					value->Release();
+				} else {
+					OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetValueHistory");
+				}
+			}
+		} else {
+			OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetValueHistory is not a Decimal Value");
+		}
+	}
+
+	return res;
+}
+
+
+//-----------------------------------------------------------------------------
+// <Manager::PressButton>
+// Starts an activity in a device.
+//-----------------------------------------------------------------------------
+bool Manager::PressButton
+(
+		ValueID const& _id
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Button == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+			{
+				res = value->PressButton();
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to PressButton");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to PressButton is not a Button Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ReleaseButton>
+// Stops an activity in a device.
+//-----------------------------------------------------------------------------
+bool Manager::ReleaseButton
+(
+		ValueID const& _id
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Button == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueButton* value = static_cast<ValueButton*>( driver->GetValue( _id ) ) )
+			{
+				res = value->ReleaseButton();
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to ReleaseButton");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to ReleaseButton is not a Button Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// Climate Control Schedules
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNumSwitchPoints>
+// Get the number of switch points defined in a schedule
+//-----------------------------------------------------------------------------
+uint8 Manager::GetNumSwitchPoints
+(
+		ValueID const& _id
+)
+{
+	//	bool res = false;
+
+	uint8 numSwitchPoints = 0;
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				numSwitchPoints = value->GetNumSwitchPoints();
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetNumSwitchPoints");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetNumSwitchPoints is not a Schedule Value");
+	}
+
+	return numSwitchPoints;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetSwitchPoint>
+// Set a switch point in the schedule
+//-----------------------------------------------------------------------------
+bool Manager::SetSwitchPoint
+(
+		ValueID const& _id,
+		uint8 const _hours,
+		uint8 const _minutes,
+		int8 const _setback
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				res = value->SetSwitchPoint( _hours, _minutes, _setback );
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetSwitchPoint");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetSwitchPoint is not a Schedule Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveSwitchPoint>
+// Remove a switch point from the schedule
+//-----------------------------------------------------------------------------
+bool Manager::RemoveSwitchPoint
+(
+		ValueID const& _id,
+		uint8 const _hours,
+		uint8 const _minutes
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				uint8 idx;
+				res = value->FindSwitchPoint( _hours, _minutes, &idx );
+
+				if( res )
+				{
+					res = value->RemoveSwitchPoint( idx );
+				}
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to RemoveSwitchPoint");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to RemoveSwitchPoint is not a Schedule Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ClearSwitchPoints>
+// Clears all switch points from the schedule
+//-----------------------------------------------------------------------------
+void Manager::ClearSwitchPoints
+(
+		ValueID const& _id
+)
+{
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				value->ClearSwitchPoints();
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to ClearSwitchPoints");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to ClearSwitchPoints is not a Schedule Value");
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetSwitchPoint>
+// Gets switch point data from the schedule
+//-----------------------------------------------------------------------------
+bool Manager::GetSwitchPoint
+(
+		ValueID const& _id,
+		uint8 const _idx,
+		uint8* o_hours,
+		uint8* o_minutes,
+		int8* o_setback
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				res = value->GetSwitchPoint( _idx, o_hours, o_minutes, o_setback );
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to GetSwitchPoint");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to GetSwitchPoint is not a Schedule Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetSchedule>
+// Send a schedule to the device, if it has changed
+//-----------------------------------------------------------------------------
+bool Manager::SetSchedule
+(
+		ValueID const& _id
+)
+{
+	bool res = false;
+
+	if( ValueID::ValueType_Schedule == _id.GetType() )
+	{
+		if( Driver* driver = GetDriver( _id.GetHomeId() ) )
+		{
+			Driver::NodeGuard LG( driver, _id.GetNodeId() );
+			if( ValueSchedule* value = static_cast<ValueSchedule*>( driver->GetValue( _id ) ) )
+			{
+				res = value->Set();
+				value->Release();
+			} else {
+				OZW_ERROR(OZWException::OZWEXCEPTION_INVALID_VALUEID, "Invalid ValueID passed to SetSchedule");
+			}
+		}
+	} else {
+		OZW_ERROR(OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID, "ValueID passed to SetSchedule is not a Schedule Value");
+	}
+
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+//	SwitchAll
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::SwitchAllOn>
+// All devices that support the SwitchAll command class will be turned on
+//-----------------------------------------------------------------------------
+void Manager::SwitchAllOn
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SwitchAllOn();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SwitchAllOff>
+// All devices that support the SwitchAll command class will be turned off
+//-----------------------------------------------------------------------------
+void Manager::SwitchAllOff
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SwitchAllOff();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	Configuration Parameters
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::SetConfigParam>
+// Set the value of one of the configuration parameters of a device
+//-----------------------------------------------------------------------------
+bool Manager::SetConfigParam
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _param,
+		int32 _value,
+		uint8 const _size
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SetConfigParam( _nodeId, _param, _value, _size );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RequestConfigParam>
+// Request the value of one of the configuration parameters of a device
+//-----------------------------------------------------------------------------
+void Manager::RequestConfigParam
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _param
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->RequestConfigParam( _nodeId, _param );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RequestAllConfigParams>
+// Request the values of all of the known configuration parameters of a device
+//-----------------------------------------------------------------------------
+void Manager::RequestAllConfigParams
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		WriteLockGuard LG(driver->m_nodeMutex);
+		Node* node = driver->GetNode( _nodeId );
+		if( node )
+		{
+			node->SetQueryStage( Node::QueryStage_Configuration );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ProvisionConfigParams>
+// Push a set of configuration parameters to a device
+//-----------------------------------------------------------------------------
+bool Manager::ProvisionConfigParams
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		map<uint8,int32> const& _params
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->ProvisionConfigParams( _nodeId, _params );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ProvisionUserCodes>
+// Push a set of user codes to a lock
+//-----------------------------------------------------------------------------
+bool Manager::ProvisionUserCodes
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		map<uint8,string> const& _codes,
+		bool const _clearOthers
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->ProvisionUserCodes( _nodeId, _codes, _clearOthers );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetDoorLockLogRecords>
+// Take the records read from a lock's log since the last call
+//-----------------------------------------------------------------------------
+uint32 Manager::GetDoorLockLogRecords
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		vector<string>* o_records
+)
+{
+	uint32 count = 0;
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			if( DoorLockLogging* cc = static_cast<DoorLockLogging*>( node->GetCommandClass( DoorLockLogging::StaticGetCommandClassId() ) ) )
+			{
+				count = cc->TakeRecords( o_records );
+			}
+		}
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+//	Groups
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNumGroups>
+// Gets the number of association groups reported by this node
+//-----------------------------------------------------------------------------
+uint8 Manager::GetNumGroups
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetNumGroups( _nodeId );
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetAssociations>
+// Gets the associations for a group
+//-----------------------------------------------------------------------------
+uint32 Manager::GetAssociations
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8** o_associations
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetAssociations( _nodeId, _groupIdx, o_associations );
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetAssociations>
+// Gets the associations for a group
+//-----------------------------------------------------------------------------
+uint32 Manager::GetAssociations
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		InstanceAssociation** o_associations
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetAssociations( _nodeId, _groupIdx, o_associations );
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetMaxAssociations>
+// Gets the maximum number of associations for a group
+//-----------------------------------------------------------------------------
+uint8 Manager::GetMaxAssociations
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetMaxAssociations( _nodeId, _groupIdx );
+	}
+
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetGroupLabel>
+// Gets the label for a particular group
+//-----------------------------------------------------------------------------
+string Manager::GetGroupLabel
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetGroupLabel( _nodeId, _groupIdx );
+	}
+
+	return "";
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::AddAssociation>
+// Adds a node to an association group
+//-----------------------------------------------------------------------------
+void Manager::AddAssociation
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8 const _targetNodeId,
+		uint8 const _instance
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->AddAssociation( _nodeId, _groupIdx, _targetNodeId, _instance );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveAssociation>
+// Removes a node from an association group
+//-----------------------------------------------------------------------------
+void Manager::RemoveAssociation
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		uint8 const _targetNodeId,
+		uint8 const _instance
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->RemoveAssociation( _nodeId, _groupIdx, _targetNodeId, _instance );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetAssociations>
+// Gets the members of an association group
+//-----------------------------------------------------------------------------
+uint32 Manager::GetAssociations
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		NodeSet* o_members
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetAssociations( _nodeId, _groupIdx, o_members );
+	}
+
+	o_members->Clear();
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetAssociations>
+// Changes the members of an association group
+//-----------------------------------------------------------------------------
+uint32 Manager::SetAssociations
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _groupIdx,
+		NodeSet const& _members
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SetAssociations( _nodeId, _groupIdx, _members );
+	}
+
+	return 0;
+}
+
+
+//-----------------------------------------------------------------------------
+//	Notifications
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::AddWatcher>
+// Add a watcher to the list
+//-----------------------------------------------------------------------------
+bool Manager::AddWatcher
+(
+		pfnOnNotification_t _watcher,
+		void* _context,
+		NotificationFilter const& _filter
+)
+{
+	// Ensure this watcher is not already on the list
+	m_notificationMutex->Lock();
+	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
+	{
+		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
+		{
+			// Already in the list
+			m_notificationMutex->Unlock();
+			return false;
+		}
+	}
+
+	m_watchers.push_back( new Watcher( _watcher, _context, _filter ) );
+	m_notificationMutex->Unlock();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveWatcher>
+// Remove a watcher from the list
+//-----------------------------------------------------------------------------
+bool Manager::RemoveWatcher
+(
+		pfnOnNotification_t _watcher,
+		void* _context
+)
+{
+	m_notificationMutex->Lock();
+	list<Watcher*>::iterator it = m_watchers.begin();
+	while( it != m_watchers.end() )
+	{
+		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
+		{
+			delete (*it);
+			m_watchers.erase( it );
+			m_notificationMutex->Unlock();
+			return true;
+		}
+		++it;
+	}
+
+	m_notificationMutex->Unlock();
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::AddBatchWatcher>
+// Add a batch watcher to the list
+//-----------------------------------------------------------------------------
+bool Manager::AddBatchWatcher
+(
+		pfnOnNotificationBatch_t _watcher,
+		void* _context,
+		NotificationFilter const& _filter
+)
+{
+	// Ensure this watcher is not already on the list
+	m_notificationMutex->Lock();
+	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
+	{
+		if( ((*it)->m_batchCallback == _watcher ) && ( (*it)->m_context == _context ) )
+		{
+			// Already in the list
+			m_notificationMutex->Unlock();
+			return false;
+		}
+	}
+
+	m_watchers.push_back( new Watcher( _watcher, _context, _filter ) );
+	m_notificationMutex->Unlock();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveBatchWatcher>
+// Remove a batch watcher from the list
+//-----------------------------------------------------------------------------
+bool Manager::RemoveBatchWatcher
+(
+		pfnOnNotificationBatch_t _watcher,
+		void* _context
+)
+{
+	m_notificationMutex->Lock();
+	list<Watcher*>::iterator it = m_watchers.begin();
+	while( it != m_watchers.end() )
+	{
+		if( ((*it)->m_batchCallback == _watcher ) && ( (*it)->m_context == _context ) )
+		{
+			delete (*it);
+			m_watchers.erase( it );
+			m_notificationMutex->Unlock();
+			return true;
+		}
+		++it;
+	}
+
+	m_notificationMutex->Unlock();
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::AddSceneEventWatcher>
+// Add a scene event watcher to the list
+//-----------------------------------------------------------------------------
+bool Manager::AddSceneEventWatcher
+(
+		Driver::pfnSceneEventCallback_t _watcher,
+		void* _context
+)
+{
+	LockGuard LG( m_sceneEventMutex );
+	pair<Driver::pfnSceneEventCallback_t,void*> watcher( _watcher, _context );
+	if( find( m_sceneEventWatchers.begin(), m_sceneEventWatchers.end(), watcher ) != m_sceneEventWatchers.end() )
+	{
+		// Already in the list
+		return false;
+	}
+
+	m_sceneEventWatchers.push_back( watcher );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveSceneEventWatcher>
+// Remove a scene event watcher from the list
+//-----------------------------------------------------------------------------
+bool Manager::RemoveSceneEventWatcher
+(
+		Driver::pfnSceneEventCallback_t _watcher,
+		void* _context
+)
+{
+	LockGuard LG( m_sceneEventMutex );
+	list< pair<Driver::pfnSceneEventCallback_t,void*> >::iterator it = find( m_sceneEventWatchers.begin(), m_sceneEventWatchers.end(), make_pair( _watcher, _context ) );
+	if( it == m_sceneEventWatchers.end() )
+	{
+		return false;
+	}
+
+	m_sceneEventWatchers.erase( it );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::NotifySceneEventWatchers>
+// Pass a scene event to each of the scene event watchers
+//-----------------------------------------------------------------------------
+void Manager::NotifySceneEventWatchers
+(
+		Driver::SceneEvent const& _event
+)
+{
+	LockGuard LG( m_sceneEventMutex );
+	for( list< pair<Driver::pfnSceneEventCallback_t,void*> >::iterator it = m_sceneEventWatchers.begin(); it != m_sceneEventWatchers.end(); ++it )
+	{
+		it->first( _event, it->second );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::NotifyWatchers>
+// Notify any watching objects of a value change
+//-----------------------------------------------------------------------------
+void Manager::NotifyWatchers
+(
+		Notification const* const* _notifications,
+		uint32 _count
+)
+{
+	m_notificationMutex->Lock();
+	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
+	{
+		Watcher* pWatcher = *it;
+		if( pWatcher->m_batchCallback )
+		{
+			if( !pWatcher->m_filtered )
+			{
+				pWatcher->m_batchCallback( _notifications, _count, pWatcher->m_context );
+				continue;
+			}
+
+			// Pass only the notifications the watcher wants, if there are any
+			m_filteredNotifications.clear();
+			for( uint32 i=0; i<_count; ++i )
+			{
+				if( pWatcher->m_filter.Matches( _notifications[i] ) )
+				{
+					m_filteredNotifications.push_back( _notifications[i] );
+				}
+			}
+			if( !m_filteredNotifications.empty() )
+			{
+				pWatcher->m_batchCallback( &m_filteredNotifications[0], (uint32)m_filteredNotifications.size(), pWatcher->m_context );
+			}
+		}
+		else
+		{
+			for( uint32 i=0; i<_count; ++i )
+			{
+				if( !pWatcher->m_filtered || pWatcher->m_filter.Matches( _notifications[i] ) )
+				{
+					pWatcher->m_callback( _notifications[i], pWatcher->m_context );
+				}
+			}
+		}
+	}
+	m_notificationMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	Controller commands
+//-----------------------------------------------------------------------------
+
+//-----------------------------------------------------------------------------
+// <Manager::ResetController>
+// Reset controller and erase all node information
+//-----------------------------------------------------------------------------
+void Manager::ResetController
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Event *event = new Event();
+		driver->ResetController( event );
+		Wait::Single( event );
+		event->Release();
+		string path = driver->GetControllerPath();
+		Driver::ControllerInterface intf = driver->GetControllerInterfaceType();
+		RemoveDriver( path );
+		AddDriver( path, intf );
+		Wait::Multiple( NULL, 0, 500 );
+	}
+	RemoveAllScenes( _homeId );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SoftReset>
+// Soft-reset the Z-Wave controller chip
+//-----------------------------------------------------------------------------
+void Manager::SoftReset
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->SoftReset();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::BeginControllerCommand>
+// Start the controller performing one of its network management functions
+//-----------------------------------------------------------------------------
+bool Manager::BeginControllerCommand
+(
+		uint32 const _homeId,
+		Driver::ControllerCommand _command,
+		Driver::pfnControllerCallback_t _callback,				// = NULL
+		void* _context,								// = NULL
+		bool _highPower,							// = false
+		uint8 _nodeId,								// = 0xff
+		uint8 _arg								// = 0
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->BeginControllerCommand( _command, _callback, _context, _highPower, _nodeId, _arg );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::CancelControllerCommand>
+// Stop the current controller function
+//-----------------------------------------------------------------------------
+bool Manager::CancelControllerCommand
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return( driver->CancelControllerCommand() );
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::TestNetworkNode>
+// Send a number of test messages to a node and record results.
+//-----------------------------------------------------------------------------
+void Manager::TestNetworkNode
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint32 const _count
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->TestNetwork( _nodeId, _count );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::TestNetwork>
+// Send a number of test messages to every node and record results.
 //-----------------------------------------------------------------------------
-void Manager::SwitchAllOn
+void Manager::TestNetwork
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint32 const _count
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->SwitchAllOn();
+		driver->TestNetwork( 0, _count );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SwitchAllOff>
-// All devices that support the SwitchAll command class will be turned off
+// <Manager::BeginNetworkHealthScan>
+// Test the links between neighboring nodes.
 //-----------------------------------------------------------------------------
-void Manager::SwitchAllOff
+bool Manager::BeginNetworkHealthScan
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint16 const _frames
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->SwitchAllOff();
+		return driver->BeginHealthScan( _frames );
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-//	Configuration Parameters
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Manager::SetConfigParam>
-// Set the value of one of the configuration parameters of a device
+// <Manager::GetLinkQuality>
+// Get the result of the last health scan for a link.
 //-----------------------------------------------------------------------------
-bool Manager::SetConfigParam
+bool Manager::GetLinkQuality
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _param,
-		int32 _value,
-		uint8 const _size
+		uint8 const _nodeA,
+		uint8 const _nodeB,
+		uint8* o_percent
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->SetConfigParam( _nodeId, _param, _value, _size );
+		return driver->GetLinkQuality( _nodeA, _nodeB, o_percent );
 	}
-
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RequestConfigParam>
-// Request the value of one of the configuration parameters of a device
+// <Manager::GetLinkQualities>
+// Get the results of the last health scan for every link.
 //-----------------------------------------------------------------------------
-void Manager::RequestConfigParam
+uint32 Manager::GetLinkQualities
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _param
+		vector<LinkQuality>* o_links
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		driver->RequestConfigParam( _nodeId, _param );
+		return driver->GetLinkQualities( o_links );
 	}
+	o_links->clear();
+	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RequestAllConfigParams>
-// Request the values of all of the known configuration parameters of a device
+// <Manager::HealNetworkNode>
+// Heal a single node in the network
 //-----------------------------------------------------------------------------
-void Manager::RequestAllConfigParams
+void Manager::HealNetworkNode
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		bool _doRR
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		Node* node = driver->GetNode( _nodeId );
 		if( node )
 		{
-			node->SetQueryStage( Node::QueryStage_Configuration );
+			driver->BeginControllerCommand( Driver::ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, _nodeId, 0 );
+			if( _doRR )
+			{
+				driver->UpdateNodeRoutes( _nodeId, true );
+			}
 		}
 	}
 }
 
 //-----------------------------------------------------------------------------
-//	Groups
-//-----------------------------------------------------------------------------
-
-//-----------------------------------------------------------------------------
-// <Manager::GetNumGroups>
-// Gets the number of association groups reported by this node
+// <Manager::HealNetwork>
+// Heal the Z-Wave network one node at a time.
 //-----------------------------------------------------------------------------
-uint8 Manager::GetNumGroups
+void Manager::HealNetwork
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		bool _doRR
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->GetNumGroups( _nodeId );
+		driver->BeginHeal( _doRR );
 	}
-
-	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::GetAssociations>
-// Gets the associations for a group
+// <Manager::CancelHealNetwork>
+// Stop a heal started by HealNetwork.
 //-----------------------------------------------------------------------------
-uint32 Manager::GetAssociations
+uint32 Manager::CancelHealNetwork
 (
-		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8** o_associations
+		uint32 const _homeId
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->GetAssociations( _nodeId, _groupIdx, o_associations );
+		return driver->CancelHeal();
 	}
-
 	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::GetAssociations>
-// Gets the associations for a group
+// <Manager::GetHealNetworkRemaining>
+// The number of nodes a heal still has to do.
 //-----------------------------------------------------------------------------
-uint32 Manager::GetAssociations
+uint32 Manager::GetHealNetworkRemaining
 (
-		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		InstanceAssociation** o_associations
+		uint32 const _homeId
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->GetAssociations( _nodeId, _groupIdx, o_associations );
+		return driver->GetHealRemaining();
 	}
-
 	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::GetMaxAssociations>
-// Gets the maximum number of associations for a group
+// <Manager::HealStaleNodes>
+// Heal the nodes whose neighbor lists may be out of date.
 //-----------------------------------------------------------------------------
-uint8 Manager::GetMaxAssociations
+uint32 Manager::HealStaleNodes
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx
+		bool _doRR
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->GetMaxAssociations( _nodeId, _groupIdx );
+		return driver->HealStaleNodes( _doRR );
 	}
-
 	return 0;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::GetGroupLabel>
-// Gets the label for a particular group
+// <Manager::IsNodeNeighborInfoStale>
+// Whether a node's neighbor list may be out of date.
 //-----------------------------------------------------------------------------
-string Manager::GetGroupLabel
+bool Manager::IsNodeNeighborInfoStale
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx
+		uint8 const _nodeId
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		return driver->GetGroupLabel( _nodeId, _groupIdx );
+		return driver->IsNeighborInfoStale( _nodeId );
 	}
-
-	return "";
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::AddAssociation>
-// Adds a node to an association group
+// <Manager::AreNodesNeighbors>
+// Whether two nodes are neighbors, from the neighbor lists already read.
 //-----------------------------------------------------------------------------
-void Manager::AddAssociation
+bool Manager::AreNodesNeighbors
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8 const _targetNodeId,
-		uint8 const _instance
+		uint8 const _nodeA,
+		uint8 const _nodeB
 )
 {
 	if( Driver* driver = GetDriver( _homeId ) )
 	{
-		driver->AddAssociation( _nodeId, _groupIdx, _targetNodeId, _instance );
+		return driver->AreNeighbors( _nodeA, _nodeB );
 	}
+	return false;
 }
-
 //-----------------------------------------------------------------------------
-// <Manager::RemoveAssociation>
-// Removes a node from an association group
+// <Manager::AddNode>
+// Add a Device to the Network.
 //-----------------------------------------------------------------------------
-void Manager::RemoveAssociation
+bool Manager::AddNode
 (
-		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _groupIdx,
-		uint8 const _targetNodeId,
-		uint8 const _instance
+		uint32 const _homeId, bool _doSecurity
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		driver->RemoveAssociation( _nodeId, _groupIdx, _targetNodeId, _instance );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		/* we use the Args option to communicate if Security CC should be initialized */
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_AddDevice,
+				NULL, NULL, true, 0, (_doSecurity  == true ? 1 : 0));
 	}
+	return false;
 }
 
-
-//-----------------------------------------------------------------------------
-//	Notifications
-//-----------------------------------------------------------------------------
-
 //-----------------------------------------------------------------------------
-// <Manager::AddWatcher>
-// Add a watcher to the list
+// <Manager::RemoveNode>
+// Remove a Device from the Network.
 //-----------------------------------------------------------------------------
-bool Manager::AddWatcher
+bool Manager::RemoveNode
 (
-		pfnOnNotification_t _watcher,
-		void* _context
+		uint32 const _homeId
 )
 {
-	// Ensure this watcher is not already on the list
-	m_notificationMutex->Lock();
-	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
-	{
-		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
-		{
-			// Already in the list
-			m_notificationMutex->Unlock();
-			return false;
-		}
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_RemoveDevice,
+				NULL, NULL, true, 0, 0);
 	}
-
-	m_watchers.push_back( new Watcher( _watcher, _context ) );
-	m_notificationMutex->Unlock();
-	return true;
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RemoveWatcher>
-// Remove a watcher from the list
+// <Manager::RemoveFailedNode>
+// Remove a Specific Device from the network if its non-responsive.
 //-----------------------------------------------------------------------------
-bool Manager::RemoveWatcher
+bool Manager::RemoveFailedNode
 (
-		pfnOnNotification_t _watcher,
-		void* _context
+		uint32 const _homeId,
+		uint8 const _nodeId
 )
 {
-	m_notificationMutex->Lock();
-	list<Watcher*>::iterator it = m_watchers.begin();
-	while( it != m_watchers.end() )
-	{
-		if( ((*it)->m_callback == _watcher ) && ( (*it)->m_context == _context ) )
-		{
-			delete (*it);
-			m_watchers.erase( it );
-			m_notificationMutex->Unlock();
-			return true;
-		}
-		++it;
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_RemoveFailedNode,
+				NULL, NULL, true, _nodeId, 0);
 	}
-
-	m_notificationMutex->Unlock();
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::NotifyWatchers>
-// Notify any watching objects of a value change
+// <Manager::HasNodeFailed>
+// Test if the Controller Believes the Node has Failed.
 //-----------------------------------------------------------------------------
-void Manager::NotifyWatchers
+bool Manager::HasNodeFailed
 (
-		Notification* _notification
+		uint32 const _homeId,
+		uint8 const _nodeId
 )
 {
-	m_notificationMutex->Lock();
-	for( list<Watcher*>::iterator it = m_watchers.begin(); it != m_watchers.end(); ++it )
-	{
-		Watcher* pWatcher = *it;
-		pWatcher->m_callback( _notification, pWatcher->m_context );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_HasNodeFailed,
+				NULL, NULL, true, _nodeId, 0);
 	}
-	m_notificationMutex->Unlock();
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-//	Controller commands
+// <Manager::AssignReturnRoute>
+// Ask a Node to update its Return Route to the Controller
 //-----------------------------------------------------------------------------
+bool Manager::AssignReturnRoute
+(
+		uint32 const _homeId,
+		uint8 const _nodeId
+)
+{
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_AssignReturnRoute,
+				NULL, NULL, true, _nodeId, 0);
+	}
+	return false;
+}
 
 //-----------------------------------------------------------------------------
-// <Manager::ResetController>
-// Reset controller and erase all node information
+// <Manager::RequestNodeNeighborUpdate>
+// Ask a Node to update its Neighbor Table.
 //-----------------------------------------------------------------------------
-void Manager::ResetController
+bool Manager::RequestNodeNeighborUpdate
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint8 const _nodeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		Event *event = new Event();
-		driver->ResetController( event );
-		Wait::Single( event );
-		event->Release();
-		string path = driver->GetControllerPath();
-		Driver::ControllerInterface intf = driver->GetControllerInterfaceType();
-		RemoveDriver( path );
-		AddDriver( path, intf );
-		Wait::Multiple( NULL, 0, 500 );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_RequestNodeNeighborUpdate,
+				NULL, NULL, true, _nodeId, 0);
 	}
-	RemoveAllScenes( _homeId );
+	return false;
 }
 
+
 //-----------------------------------------------------------------------------
-// <Manager::SoftReset>
-// Soft-reset the Z-Wave controller chip
+// <Manager::DeleteAllReturnRoutes>
+// Ask a Node to delete all its Return Routes
 //-----------------------------------------------------------------------------
-void Manager::SoftReset
+bool Manager::DeleteAllReturnRoutes
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint8 const _nodeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		driver->SoftReset();
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_DeleteAllReturnRoutes,
+				NULL, NULL, true, _nodeId, 0);
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::BeginControllerCommand>
-// Start the controller performing one of its network management functions
+// <Manager::SendNodeInformation>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-bool Manager::BeginControllerCommand
+bool Manager::SendNodeInformation
 (
 		uint32 const _homeId,
-		Driver::ControllerCommand _command,
-		Driver::pfnControllerCallback_t _callback,				// = NULL
-		void* _context,								// = NULL
-		bool _highPower,							// = false
-		uint8 _nodeId,								// = 0xff
-		uint8 _arg								// = 0
+		uint8 const _nodeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		return driver->BeginControllerCommand( _command, _callback, _context, _highPower, _nodeId, _arg );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_SendNodeInformation,
+				NULL, NULL, true, _nodeId, 0);
 	}
-
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::CancelControllerCommand>
-// Stop the current controller function
+// <Manager::CreateNewPrimary>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-bool Manager::CancelControllerCommand
+bool Manager::CreateNewPrimary
 (
 		uint32 const _homeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		return( driver->CancelControllerCommand() );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_CreateNewPrimary,
+				NULL, NULL, true, 0, 0);
 	}
-
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::TestNetworkNode>
-// Send a number of test messages to a node and record results.
+// <Manager::ReceiveConfiguration>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-void Manager::TestNetworkNode
+bool Manager::ReceiveConfiguration
 (
-		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint32 const _count
+		uint32 const _homeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		driver->TestNetwork( _nodeId, _count );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_ReceiveConfiguration,
+				NULL, NULL, true, 0, 0);
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::TestNetwork>
-// Send a number of test messages to every node and record results.
+// <Manager::ReplaceFailedNode>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-void Manager::TestNetwork
+bool Manager::ReplaceFailedNode
 (
 		uint32 const _homeId,
-		uint32 const _count
+		uint8 const _nodeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		driver->TestNetwork( 0, _count );
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_ReplaceFailedNode,
+				NULL, NULL, true, _nodeId, 0);
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::HealNetworkNode>
-// Heal a single node in the network
+// <Manager::TransferPrimaryRole>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-void Manager::HealNetworkNode
+bool Manager::TransferPrimaryRole
 (
-		uint32 const _homeId,
-		uint8 const _nodeId,
-		bool _doRR
+		uint32 const _homeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		LockGuard LG(driver->m_nodeMutex);
-		Node* node = driver->GetNode( _nodeId );
-		if( node )
-		{
-			driver->BeginControllerCommand( Driver::ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, _nodeId, 0 );
-			if( _doRR )
-			{
-				driver->UpdateNodeRoutes( _nodeId, true );
-			}
-		}
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_TransferPrimaryRole,
+				NULL, NULL, true, 0, 0);
 	}
+	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::HealNetwork>
-// Heal the Z-Wave network one node at a time.
+// <Manager::RequestNetworkUpdate>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-void Manager::HealNetwork
+bool Manager::RequestNetworkUpdate
 (
 		uint32 const _homeId,
-		bool _doRR
+		uint8 const _nodeId
 )
 {
-	if( Driver* driver = GetDriver( _homeId ) )
-	{
-		LockGuard LG(driver->m_nodeMutex);
-		for( uint8 i=0; i<255; i++ )
-		{
-			if( driver->m_nodes[i] != NULL )
-			{
-				driver->BeginControllerCommand( Driver::ControllerCommand_RequestNodeNeighborUpdate, NULL, NULL, true, i, 0 );
-				if( _doRR )
-				{
-					driver->UpdateNodeRoutes( i, true );
-				}
-			}
-		}
+	if (Driver *driver = GetDriver( _homeId ) ) {
+		WriteLockGuard LG(driver->m_nodeMutex);
+		return driver->BeginControllerCommand(
+				Driver::ControllerCommand_RequestNetworkUpdate,
+				NULL, NULL, true, _nodeId, 0);
 	}
+	return false;
 }
+
 //-----------------------------------------------------------------------------
-// <Manager::AddNode>
-// Add a Device to the Network.
+// <Manager::ReplicationSend>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-bool Manager::AddNode
+bool Manager::ReplicationSend
 (
-		uint32 const _homeId, bool _doSecurity
+		uint32 const _homeId,
+		uint8 const _nodeId
 )
 {
 	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		/* we use the Args option to communicate if Security CC should be initialized */
+		WriteLockGuard LG(driver->m_nodeMutex);
 		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_AddDevice,
-				NULL, NULL, true, 0, (_doSecurity  == true ? 1 : 0));
+				Driver::ControllerCommand_ReplicationSend,
+				NULL, NULL, true, _nodeId, 0);
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RemoveNode>
-// Remove a Device from the Network.
+// <Manager::CreateButton>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-bool Manager::RemoveNode
+bool Manager::CreateButton
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _buttonid
 )
 {
 	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_RemoveDevice,
-				NULL, NULL, true, 0, 0);
+				Driver::ControllerCommand_CreateButton,
+				NULL, NULL, true, _nodeId, _buttonid);
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RemoveFailedNode>
-// Remove a Specific Device from the network if its non-responsive.
+// <Manager::DeleteButton>
+// Send a NIF frame from the Controller to the Node
 //-----------------------------------------------------------------------------
-bool Manager::RemoveFailedNode
+bool Manager::DeleteButton
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		uint8 const _buttonid
 )
 {
 	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
+		WriteLockGuard LG(driver->m_nodeMutex);
 		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_RemoveFailedNode,
-				NULL, NULL, true, _nodeId, 0);
+				Driver::ControllerCommand_DeleteButton,
+				NULL, NULL, true, _nodeId, _buttonid);
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::HasNodeFailed>
-// Test if the Controller Believes the Node has Failed.
+// <Manager::BeginFirmwareUpdate>
+// Send a new firmware image to a node
 //-----------------------------------------------------------------------------
-bool Manager::HasNodeFailed
+bool Manager::BeginFirmwareUpdate
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		string const& _fileName,
+		uint8 const _target		// = 0
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_HasNodeFailed,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			if( FirmwareUpdateMetaData* cc = static_cast<FirmwareUpdateMetaData*>( node->GetCommandClass( FirmwareUpdateMetaData::StaticGetCommandClassId() ) ) )
+			{
+				return cc->BeginUpdate( _fileName, _target );
+			}
+		}
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::AssignReturnRoute>
-// Ask a Node to update its Return Route to the Controller
+// <Manager::CancelFirmwareUpdate>
+// Stop sending a firmware image to a node
 //-----------------------------------------------------------------------------
-bool Manager::AssignReturnRoute
+bool Manager::CancelFirmwareUpdate
 (
 		uint32 const _homeId,
 		uint8 const _nodeId
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_AssignReturnRoute,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			if( FirmwareUpdateMetaData* cc = static_cast<FirmwareUpdateMetaData*>( node->GetCommandClass( FirmwareUpdateMetaData::StaticGetCommandClassId() ) ) )
+			{
+				return cc->CancelUpdate();
+			}
+		}
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RequestNodeNeighborUpdate>
-// Ask a Node to update its Neighbor Table.
+// <Manager::GetFirmwareUpdateProgress>
+// Get the progress of a firmware update
 //-----------------------------------------------------------------------------
-bool Manager::RequestNodeNeighborUpdate
+bool Manager::GetFirmwareUpdateProgress
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		uint8 const _nodeId,
+		Driver::FirmwareUpdateData* _data
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_RequestNodeNeighborUpdate,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		Driver::NodeGuard LG( driver, _nodeId );
+		if( Node* node = driver->GetNode( _nodeId ) )
+		{
+			if( FirmwareUpdateMetaData* cc = static_cast<FirmwareUpdateMetaData*>( node->GetCommandClass( FirmwareUpdateMetaData::StaticGetCommandClassId() ) ) )
+			{
+				cc->GetProgress( _data );
+				return true;
+			}
+		}
 	}
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::BackupControllerNvm>
+// Copy the controller's NVM to a file
+//-----------------------------------------------------------------------------
+bool Manager::BackupControllerNvm
+(
+		uint32 const _homeId,
+		string const& _fileName
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->BeginNvmTransfer( _fileName, false );
+	}
+	return false;
+}
 
 //-----------------------------------------------------------------------------
-// <Manager::DeleteAllReturnRoutes>
-// Ask a Node to delete all its Return Routes
+// <Manager::RestoreControllerNvm>
+// Write a backup into the controller's NVM
 //-----------------------------------------------------------------------------
-bool Manager::DeleteAllReturnRoutes
+bool Manager::RestoreControllerNvm
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		string const& _fileName
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_DeleteAllReturnRoutes,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->BeginNvmTransfer( _fileName, true );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::CancelControllerNvm>
+// Stop a controller NVM backup or restore
+//-----------------------------------------------------------------------------
+bool Manager::CancelControllerNvm
+(
+		uint32 const _homeId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->CancelNvmTransfer();
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::SendNodeInformation>
-// Send a NIF frame from the Controller to the Node
+// <Manager::GetControllerNvmProgress>
+// Get the progress of a controller NVM backup or restore
 //-----------------------------------------------------------------------------
-bool Manager::SendNodeInformation
+bool Manager::GetControllerNvmProgress
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		Driver::NvmData* _data
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_SendNodeInformation,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetNvmProgress( _data );
+		return true;
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::CreateNewPrimary>
-// Send a NIF frame from the Controller to the Node
+// <Manager::BeginSniffing>
+// Capture the frames that pass between other nodes
 //-----------------------------------------------------------------------------
-bool Manager::CreateNewPrimary
+bool Manager::BeginSniffing
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		string const& _traceFile	// = ""
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_CreateNewPrimary,
-				NULL, NULL, true, 0, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->BeginSniffing( _traceFile );
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::ReceiveConfiguration>
-// Send a NIF frame from the Controller to the Node
+// <Manager::EndSniffing>
+// Stop capturing frames
 //-----------------------------------------------------------------------------
-bool Manager::ReceiveConfiguration
+bool Manager::EndSniffing
 (
 		uint32 const _homeId
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_ReceiveConfiguration,
-				NULL, NULL, true, 0, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->EndSniffing();
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::ReplaceFailedNode>
-// Send a NIF frame from the Controller to the Node
+// <Manager::GetSniffedFrames>
+// Take the frames captured since the last call
 //-----------------------------------------------------------------------------
-bool Manager::ReplaceFailedNode
+bool Manager::GetSniffedFrames
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		vector<Driver::SniffedFrame>* o_frames,
+		int32 const _timeout,		// = 0
+		uint32* o_dropped			// = NULL
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_ReplaceFailedNode,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->GetSniffedFrames( o_frames, _timeout, o_dropped );
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::TransferPrimaryRole>
-// Send a NIF frame from the Controller to the Node
+// <Manager::BeginMsgTrace>
+// Start recording what happens to each message sent
 //-----------------------------------------------------------------------------
-bool Manager::TransferPrimaryRole
+void Manager::BeginMsgTrace
 (
-		uint32 const _homeId
+		uint32 const _homeId,
+		uint32 const _capacity		// = 65536
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_TransferPrimaryRole,
-				NULL, NULL, true, 0, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->BeginMsgTrace( _capacity );
 	}
-	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::RequestNetworkUpdate>
-// Send a NIF frame from the Controller to the Node
+// <Manager::EndMsgTrace>
+// Stop recording messages, and save the events for a trace viewer
 //-----------------------------------------------------------------------------
-bool Manager::RequestNetworkUpdate
+bool Manager::EndMsgTrace
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		string const& _fileName
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_RequestNetworkUpdate,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->EndMsgTrace( _fileName );
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::ReplicationSend>
-// Send a NIF frame from the Controller to the Node
+// <Manager::AddProvisionedProduct>
+// Expect more nodes of the same product as a node already interviewed
 //-----------------------------------------------------------------------------
-bool Manager::ReplicationSend
+bool Manager::AddProvisionedProduct
 (
 		uint32 const _homeId,
-		uint8 const _nodeId
+		uint8 const _templateNodeId
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_ReplicationSend,
-				NULL, NULL, true, _nodeId, 0);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->AddProvisionedProduct( _templateNodeId );
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::CreateButton>
-// Send a NIF frame from the Controller to the Node
+// <Manager::RemoveProvisionedProduct>
+// Stop expecting nodes of a product
 //-----------------------------------------------------------------------------
-bool Manager::CreateButton
+bool Manager::RemoveProvisionedProduct
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _buttonid
+		uint16 const _manufacturerId,
+		uint16 const _productType,
+		uint16 const _productId
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_CreateButton,
-				NULL, NULL, true, _nodeId, _buttonid);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->RemoveProvisionedProduct( _manufacturerId, _productType, _productId );
 	}
 	return false;
 }
 
 //-----------------------------------------------------------------------------
-// <Manager::DeleteButton>
-// Send a NIF frame from the Controller to the Node
+// <Manager::SetProvisionedConfigParam>
+// Set a configuration parameter to send to each new node of a product
 //-----------------------------------------------------------------------------
-bool Manager::DeleteButton
+bool Manager::SetProvisionedConfigParam
 (
 		uint32 const _homeId,
-		uint8 const _nodeId,
-		uint8 const _buttonid
+		uint16 const _manufacturerId,
+		uint16 const _productType,
+		uint16 const _productId,
+		uint8 const _param,
+		int32 const _value,
+		uint8 const _size
 )
 {
-	if (Driver *driver = GetDriver( _homeId ) ) {
-		LockGuard LG(driver->m_nodeMutex);
-		return driver->BeginControllerCommand(
-				Driver::ControllerCommand_DeleteButton,
-				NULL, NULL, true, _nodeId, _buttonid);
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->SetProvisionedConfigParam( _manufacturerId, _productType, _productId, _param, _value, _size );
 	}
 	return false;
 }
@@ -4018,7 +6167,10 @@ uint8 Manager::GetNumScenes
 (
 )
 {
-	return Scene::s_sceneCnt;
+	// Only the scenes that can be named by a uint8 are counted
+	vector<uint16> sceneIds;
+	Scene::GetAllScenes( &sceneIds );
+	return (uint8)( upper_bound( sceneIds.begin(), sceneIds.end(), (uint16)0xff ) - sceneIds.begin() );
 }
 
 //-----------------------------------------------------------------------------
@@ -4031,7 +6183,22 @@ uint8 Manager::GetAllScenes
 )
 {
 	*_sceneIds = NULL;
-	return Scene::GetAllScenes( _sceneIds );
+	vector<uint16> sceneIds;
+	Scene::GetAllScenes( &sceneIds );
+	uint8 numScenes = 0;
+	while( numScenes < sceneIds.size() && sceneIds[numScenes] <= 0xff )
+	{
+		++numScenes;
+	}
+	if( numScenes > 0 )
+	{
+		*_sceneIds = new uint8[numScenes];
+		for( uint8 i = 0; i < numScenes; ++i )
+		{
+			(*_sceneIds)[i] = (uint8)sceneIds[i];
+		}
+	}
+	return numScenes;
 }
 
 //-----------------------------------------------------------------------------
@@ -4043,21 +6210,19 @@ void Manager::RemoveAllScenes
 		uint32 const _homeId
 )
 {
-	for( int i = 1; i < 256; i++ )
+	if( _homeId == 0 )	// remove every device from every scene
 	{
-		if( _homeId == 0 )	// remove every device from every scene
+		vector<uint16> sceneIds;
+		Scene::GetAllScenes( &sceneIds );
+		for( vector<uint16>::iterator it = sceneIds.begin(); it != sceneIds.end(); ++it )
 		{
-			RemoveScene( i );
-		}
-		else
-		{
-			Scene *scene = Scene::Get( i );
-			if( scene != NULL )
-			{
-				scene->RemoveValues( _homeId );
-			}
+			delete Scene::Get( *it );
 		}
 	}
+	else
+	{
+		Scene::RemoveValues( _homeId );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -4711,6 +6876,61 @@ bool Manager::ActivateScene
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Manager::AddSceneRule>
+// Activate a scene from the driver thread whenever a value changes
+//-----------------------------------------------------------------------------
+uint32 Manager::AddSceneRule
+(
+		ValueID const& _valueId,
+		string const& _value,
+		uint8 const _sceneId
+)
+{
+	if( Driver* driver = GetDriver( _valueId.GetHomeId() ) )
+	{
+		return driver->AddSceneRule( _valueId, _value, _sceneId );
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::AddSceneRule>
+// Activate a scene from the driver thread whenever a node sends a scene event
+//-----------------------------------------------------------------------------
+uint32 Manager::AddSceneRule
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		uint8 const _triggerSceneId,
+		uint8 const _keyAttributes,
+		uint8 const _sceneId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->AddSceneRule( _nodeId, _triggerSceneId, _keyAttributes, _sceneId );
+	}
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::RemoveSceneRule>
+// Remove a scene rule
+//-----------------------------------------------------------------------------
+bool Manager::RemoveSceneRule
+(
+		uint32 const _homeId,
+		uint32 const _ruleId
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		return driver->RemoveSceneRule( _ruleId );
+	}
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // <Manager::GetDriverStatistics>
 // Retrieve driver based counters.
@@ -4745,3 +6965,154 @@ void Manager::GetNodeStatistics
 	}
 
 }
+
+//-----------------------------------------------------------------------------
+// <Manager::GetMetrics>
+// Retrieve the statistics as text for a metrics scraper.
+//-----------------------------------------------------------------------------
+void Manager::GetMetrics
+(
+		uint32 const _homeId,
+		string& o_text
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->WriteMetrics( o_text );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetAllNodeStatistics>
+// Retrieve the counters of every node.
+//-----------------------------------------------------------------------------
+void Manager::GetAllNodeStatistics
+(
+		uint32 const _homeId,
+		Driver::NodeCounters* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetAllNodeStatistics( _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetDriverLatencyStatistics>
+// Retrieve the percentiles of the driver's latencies.
+//-----------------------------------------------------------------------------
+void Manager::GetDriverLatencyStatistics
+(
+		uint32 const _homeId,
+		Driver::DriverLatencyData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetDriverLatencyStatistics( _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeLatencyStatistics>
+// Retrieve the percentiles of a node's round trip times.
+//-----------------------------------------------------------------------------
+void Manager::GetNodeLatencyStatistics
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		Node::NodeLatencyData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetNodeLatencyStatistics( _nodeId, _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeQueryStageStatistics>
+// Retrieve the time each stage of a node's interview took.
+//-----------------------------------------------------------------------------
+void Manager::GetNodeQueryStageStatistics
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		Node::NodeQueryStageData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetNodeQueryStageStatistics( _nodeId, _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetMemoryStatistics>
+// Estimate the memory used by a driver
+//-----------------------------------------------------------------------------
+void Manager::GetMemoryStatistics
+(
+		uint32 const _homeId,
+		Driver::MemoryData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetMemoryStatistics( _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetNodeMemoryStatistics>
+// Estimate the memory used by a node
+//-----------------------------------------------------------------------------
+void Manager::GetNodeMemoryStatistics
+(
+		uint32 const _homeId,
+		uint8 const _nodeId,
+		Node::NodeMemoryData* _data
+)
+{
+	if( Driver* driver = GetDriver( _homeId ) )
+	{
+		driver->GetNodeMemoryStatistics( _nodeId, _data );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::SetCommandClassProfiling>
+// Start or stop timing the calls into each command class
+//-----------------------------------------------------------------------------
+void Manager::SetCommandClassProfiling
+(
+		bool const _enable
+)
+{
+	CommandClassProfile::Enable( _enable );
+	Log::Write( LogLevel_Info, "Command class profiling %s", _enable ? "started" : "stopped" );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::GetCommandClassProfile>
+// Retrieve the number of calls into each command class, and the time they took
+//-----------------------------------------------------------------------------
+void Manager::GetCommandClassProfile
+(
+		vector<CommandClassProfile::Data>* o_data
+)
+{
+	CommandClassProfile::GetSnapshot( o_data );
+}
+
+//-----------------------------------------------------------------------------
+// <Manager::ResetCommandClassProfile>
+// Clear the counts and times of the calls into each command class
+//-----------------------------------------------------------------------------
+void Manager::ResetCommandClassProfile
+(
+)
+{
+	CommandClassProfile::Reset();
+}
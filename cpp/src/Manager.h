@@ -36,13 +36,23 @@
 #include <deque>
 
 #include "Defs.h"
+#include "ChangeJournal.h"
+#include "CommandClassProfile.h"
 #include "Driver.h"
 #include "Group.h"
+#include "NotificationFilter.h"
+#include "SharedString.h"
+#include "StateWriter.h"
 #include "value_classes/ValueID.h"
+#include "value_classes/ValueHandle.h"
+#include "value_classes/ValueHistory.h"
+#include "value_classes/ValueIndex.h"
+#include "value_classes/ValueSnapshot.h"
 
 namespace OpenZWave
 {
 	class Options;
+	class ControllerGroup;
 	class Node;
 	class Msg;
 	class Value;
@@ -116,9 +126,12 @@ namespace OpenZWave
 		friend class ValueStore;
 		friend class ValueButton;
 		friend class Msg;
+		friend class NotificationDispatcher;
+		friend class Scene;
 
 	public:
 		typedef void (*pfnOnNotification_t)( Notification const* _pNotification, void* _context );
+		typedef void (*pfnOnNotificationBatch_t)( Notification const* const* _pNotifications, uint32 _count, void* _context );
 
 	//-----------------------------------------------------------------------------
 	// Construction
@@ -229,7 +242,10 @@ namespace OpenZWave
 		 * has been received, a DriverReady notification callback is sent, containing the Home ID of the controller.  This Home ID is
 		 * required by most of the OpenZWave Manager class methods.
 		 * @param _controllerPath The string used to open the controller.  On Windows this might be something like
-		 * "\\.\COM3", or on Linux "/dev/ttyUSB0".
+		 * "\\.\COM3", or on Linux "/dev/ttyUSB0".  For Driver::ControllerInterface_Simulated it holds the settings
+		 * of the simulated network, such as "nodes=232,latency=20" (see SimulatedController).  For
+		 * Driver::ControllerInterface_Tcp it is the "host:port" to connect to (see TcpController).
+		 * @param _interface The kind of hardware interface the controller has.
 		 * \return True if a new driver was created, false if a driver for the controller already exists.
 		 * \see Create, Get, RemoveDriver
 		 */
@@ -347,16 +363,34 @@ namespace OpenZWave
 		 * \param _homeId The Home ID of the Z-Wave controller.
 		 */
 		string GetControllerPath( uint32 const _homeId );
+
+		/**
+		 * \brief Get the operating system's id for one of the driver's threads.
+		 * Lets the application find the threads in system tools, or keep its own work off the CPUs
+		 * given to them with the ThreadAffinity option.
+		 * \param _homeId The Home ID of the Z-Wave controller.
+		 * \param _thread "driver", "poll" or "controller", the last being the thread that reads from
+		 * a serial or HID controller.
+		 * \return the thread id (the kernel thread id on Linux), or zero if there is no such thread.
+		 * \see Thread::GetId
+		 */
+		uint64 GetDriverThreadId( uint32 const _homeId, string const& _thread );
 	/*@}*/
 
 	private:
 		Driver* GetDriver( uint32 const _homeId );	/**< Get a pointer to a Driver object from the HomeID.  Only to be used by OpenZWave. */
 		void SetDriverReady( Driver* _driver, bool success );		/**< Indicate that the Driver is ready to be used, and send the notification callback. */
+		bool JoinControllerGroup( Driver* _driver );				/**< With the ControllerGroups option, make a driver a standby for the ready driver with the same home ID, if there is one. */
+
+		static uint32 const	c_maxIndexedDrivers = 8;
 
 OPENZWAVE_EXPORT_WARNINGS_OFF
 		list<Driver*>		m_pendingDrivers;		/**< Drivers that are in the process of reading saved data and querying their Z-Wave network for basic information. */
 		map<uint32,Driver*>	m_readyDrivers;			/**< Drivers that are ready to be used by the application. */
+		map<uint32,ControllerGroup*>	m_controllerGroups;	/**< The controllers of each network that has more than one, holding the standby drivers.  Kept until the Manager is destroyed. */
 OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*				m_driverMutex;			/**< Guards m_pendingDrivers, m_readyDrivers, m_controllerGroups and changes to m_driverIndex. */
+		Driver* volatile	m_driverIndex[c_maxIndexedDrivers];	/**< The first ready drivers, which GetDriver searches without a lock.  A removed driver keeps its slot until it has been deleted. */
 
 	//-----------------------------------------------------------------------------
 	//	Polling Z-Wave devices
@@ -423,6 +457,23 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		uint8 GetPollIntensity( ValueID const &_valueId );
 
+		/**
+		 * \brief Set the time between polls of a value, in milliseconds.
+		 * This replaces the interval derived from the poll intensity and the poll interval.
+		 * \param _valueId The ID of the value whose poll interval should be set.
+		 * \param _milliseconds The time between polls, or zero to go back to using the poll intensity.
+		 */
+		void SetValuePollInterval( ValueID const &_valueId, uint32 const _milliseconds );
+
+		/**
+		 * \brief Get the time between polls of a value, in milliseconds.
+		 * \param _valueId The ID of the value to check.
+		 * \return The time between polls, or zero if it is derived from the poll intensity.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 */
+		uint32 GetValuePollInterval( ValueID const &_valueId );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -439,7 +490,8 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 * This method would normally be called automatically by OpenZWave, but if you know that a node has been
 		 * changed, calling this method will force a refresh of all of the data held by the library.  This can be especially
 		 * useful for devices that were asleep when the application was first run. This is the
-		 * same as the query state starting from the beginning.
+		 * same as the query state starting from the beginning.  If the SkipMatchingInterviews option is set, the static
+		 * queries are skipped for a node whose ids, command classes and versions still match its last interview.
 		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
 		 * \param _nodeId The ID of the node to query.
 		 * \return True if the request was sent successfully.
@@ -466,6 +518,48 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool RequestNodeDynamic( uint32 const _homeId, uint8 const _nodeId );
 
+		/**
+		 * \brief Refresh the values of many nodes, without flooding the network.
+		 * The nodes are refreshed one at a time, in order of node id, from the poll thread.
+		 * Only a few of a node's requests wait to be sent at once, so other messages can
+		 * go in between.  Sleeping nodes are refreshed when they next wake up, and nodes
+		 * presumed dead are skipped.  A Notification::Type_RefreshRoundComplete is sent once
+		 * every node has replied or timed out.
+		 * \param _homeId The Home ID of the Z-Wave controller.
+		 * \param _filter Which values to request, a combination of Driver::RefreshFilter flags.
+		 * \param _nodes The nodes to refresh, or NULL for all of them.
+		 * \return false if a round is already running, or there is nothing to refresh.
+		 * \see CancelRefreshRound, GetRefreshRoundResult
+		 */
+		bool BeginRefreshRound( uint32 const _homeId, uint8 const _filter = Driver::RefreshFilter_Dynamic, NodeSet const* _nodes = NULL );
+
+		/**
+		 * \brief Stop a refresh round.  Requests already on the poll queue are still sent.
+		 * \param _homeId The Home ID of the Z-Wave controller.
+		 * \return the number of nodes that will not now be refreshed.
+		 */
+		uint32 CancelRefreshRound( uint32 const _homeId );
+
+		/**
+		 * \brief Get the outcome of the last refresh round, or the progress of one running.
+		 * \param _homeId The Home ID of the Z-Wave controller.
+		 * \param _data Filled in with the counts and the time taken.
+		 */
+		void GetRefreshRoundResult( uint32 const _homeId, Driver::RefreshRoundData* _data );
+
+		/**
+		 * \brief Set the clocks of all the nodes with the Clock or Time Parameters command class.
+		 * Listening nodes are set one at a time from the poll thread, half a second apart.  The
+		 * set for a sleeping node waits until it wakes, replacing any set already waiting for it,
+		 * and carries the time at which the node woke.  From then on, if the host's local time
+		 * moves by the TimeSyncMaxDrift option or more, as it does when daylight saving starts or
+		 * ends or NTP steps the clock, the clocks are set again.  The TimeSync option does this
+		 * once the listening nodes have been queried.
+		 * \param _homeId The Home ID of the Z-Wave controller.
+		 * \return the number of nodes with a clock.
+		 */
+		uint32 SyncTime( uint32 const _homeId );
+
 		/**
 		 * \brief Get whether the node is a listening device that does not go to sleep
 		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
@@ -579,9 +673,38 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
 		 * \param _nodeId The ID of the node to query.
 		 * \param _nodeNeighbors An array of 29 uint8s to hold the neighbor bitmap
+		 * \see GetNodeNeighborBitmap, GetNetworkTopology
 		 */
 		uint32 GetNodeNeighbors( uint32 const _homeId, uint8 const _nodeId, uint8** _nodeNeighbors );
 
+		/**
+		 * \brief Get a node's neighbors without copying them.
+		 *
+		 * The bitmap has NUM_NODE_BITFIELD_BYTES bytes, with node 1 in the lowest bit of the
+		 * first.  It stays where it is for as long as the driver, and is updated in place
+		 * when the node's routing info is read again.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to query.
+		 * \return the bitmap, or NULL if the node's neighbors are not known yet.
+		 * \see GetNetworkTopology
+		 */
+		uint8 const* GetNodeNeighborBitmap( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * \brief Get the neighbors of every node in the network at once.
+		 *
+		 * The topology is NUM_NODE_BITFIELD_BYTES*8 rows of NUM_NODE_BITFIELD_BYTES bytes,
+		 * the neighbor bitmap of each node ID in turn starting from node 1.  The rows of
+		 * unknown nodes are empty.  The topology has a version, which changes whenever a
+		 * node's neighbors do, so a caller that passes back the version it last received
+		 * has nothing copied until there is a change.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param o_topology Space for NUM_NODE_BITFIELD_BYTES*NUM_NODE_BITFIELD_BYTES*8 bytes.
+		 * \param _version The version last received, or 0 to always copy.
+		 * \return the current version, or 0 if the network is not known.
+		 */
+		uint32 GetNetworkTopology( uint32 const _homeId, uint8* o_topology, uint32 const _version = 0 );
+
 		/**
 		 * \brief Get the manufacturer name of a device
 		 * The manufacturer name would normally be handled by the Manufacturer Specific command class,
@@ -823,6 +946,29 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		string GetNodeQueryStage( uint32 const _homeId, uint8 const _nodeId );
 
+		/**
+		 * \brief Set how urgently a node is queried, compared with the other nodes.
+		 * While nodes with a higher priority have queries waiting, nodes with a lower one
+		 * wait for them.  Unless this is called, door locks and thermostats have a high
+		 * priority and nodes that are not always listening a low one.  The priority is saved
+		 * with the network configuration.  See also the MaxConcurrentInterviews option.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node.
+		 * \param _priority The query priority.
+		 * \return True if the node was found.
+		 * \see GetNodeQueryPriority
+		 */
+		bool SetNodeQueryPriority( uint32 const _homeId, uint8 const _nodeId, Node::QueryPriority const _priority );
+
+		/**
+		 * \brief Get how urgently a node is queried, compared with the other nodes.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node.
+		 * \return The node's query priority.
+		 * \see SetNodeQueryPriority
+		 */
+		Node::QueryPriority GetNodeQueryPriority( uint32 const _homeId, uint8 const _nodeId );
+
 
 		/**
 		 * \brief Get the node device type as reported in the Z-Wave+ Info report.
@@ -894,6 +1040,18 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		string GetValueLabel( ValueID const& _id );
 
+		/**
+		 * \brief Gets the user-friendly label for the value, without copying it.
+		 * The SharedString holds the text the value has, so reading it allocates nothing, and it stays
+		 * valid after the label is changed or the value removed.
+		 * \param _id The unique identifier of the value.
+		 * \param o_value Pointer to a SharedString that will be given the label.
+		 * \return true if the label was obtained.
+ 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \see ValueID, SharedString
+		 */
+		bool GetValueLabel( ValueID const& _id, SharedString* o_value );
+
 		/**
 		 * \brief Sets the user-friendly label for the value.
 		 * \param _id The unique identifier of the value.
@@ -914,6 +1072,16 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		string GetValueUnits( ValueID const& _id );
 
+		/**
+		 * \brief Gets the units that the value is measured in, without copying them.
+		 * \param _id The unique identifier of the value.
+		 * \param o_value Pointer to a SharedString that will be given the units.
+		 * \return true if the units were obtained.
+ 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \see ValueID, SharedString, GetValueLabel
+		 */
+		bool GetValueUnits( ValueID const& _id, SharedString* o_value );
+
 		/**
 		 * \brief Sets the units that the value is measured in.
 		 * \param _id The unique identifier of the value.
@@ -934,6 +1102,16 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		string GetValueHelp( ValueID const& _id );
 
+		/**
+		 * \brief Gets the help string of the value, without copying it.
+		 * \param _id The unique identifier of the value.
+		 * \param o_value Pointer to a SharedString that will be given the help text.
+		 * \return true if the help text was obtained.
+ 		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \see ValueID, SharedString, GetValueLabel
+		 */
+		bool GetValueHelp( ValueID const& _id, SharedString* o_value );
+
 		/**
 		 * \brief Sets a help string describing the value's purpose and usage.
 		 * \param _id The unique identifier of the value.
@@ -1102,6 +1280,17 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool GetValueListSelection( ValueID const& _id, string* o_value );
 
+		/**
+		 * \brief Gets the selected item from a list, without copying its label.
+		 * \param _id The unique identifier of the value.
+		 * \param o_value Pointer to a SharedString that will be given the label of the selected item.
+		 * \return True if the value was obtained.  Returns false if the value is not a ValueID::ValueType_List.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
+		 * \see GetValueListSelection, GetValueListItems, SharedString
+		 */
+		bool GetValueListSelection( ValueID const& _id, SharedString* o_value );
+
 		/**
 		 * \brief Gets the selected item from a list (as an integer).
 		 * \param _id The unique identifier of the value.
@@ -1126,6 +1315,19 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool GetValueListItems( ValueID const& _id, vector<string>* o_value );
 
+		/**
+		 * \brief Gets the list of items from a list value, without copying their labels.
+		 * Each SharedString holds an item label as the value has it.  Called again with the same
+		 * vector, nothing is allocated.
+		 * \param _id The unique identifier of the value.
+		 * \param o_value Pointer to a vector that will be cleared, then filled with the item labels.
+		 * \return true if the list items were obtained.  Returns false if the value is not a ValueID::ValueType_List.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
+		 * \see GetValueListItems, GetValueListValues, SharedString
+		 */
+		bool GetValueListItems( ValueID const& _id, vector<SharedString>* o_value );
+
 		/**
 		 * \brief Gets the list of values from a list value.
 		 * \param _id The unique identifier of the value.
@@ -1150,6 +1352,101 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool GetValueFloatPrecision( ValueID const& _id, uint8* o_value );
 
+		/**
+		 * \brief Gets a handle for reading a value without locks.
+		 * For values that are read very often, the handle's reads cost a few atomic loads, rather than
+		 * the lock, the lookup of the ValueID and the reference counting done by GetValueAsBool etc.
+		 * \param _id The unique identifier of the value.  Only ValueID::ValueType_Bool, ValueID::ValueType_Byte,
+		 * ValueID::ValueType_Short and ValueID::ValueType_Int values can be read through a handle.
+		 * \return the handle, which is not valid if the value could not be found or is of another type.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is of a different type
+		 * \see ValueHandle, GetValueAsBool, GetValueAsByte, GetValueAsShort, GetValueAsInt
+		 */
+		ValueHandle GetValueHandle( ValueID const& _id );
+
+		/**
+		 * \brief Copies all the values of a node.
+		 * The values are copied while holding the node lock once, rather than once for each value
+		 * as GetValueAsString and the other getters do.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node.
+		 * \param o_values Cleared, then filled with the node's values.
+		 * \param _genre If not ValueID::ValueGenre_Count, only values of this genre are copied.
+		 * \return true if the node was found.
+		 * \see ValueSnapshot, SnapshotNetwork
+		 */
+		bool GetNodeValues( uint32 const _homeId, uint8 const _nodeId, ValueSnapshot* o_values, ValueID::ValueGenre const _genre = ValueID::ValueGenre_Count );
+
+		/**
+		 * \brief Copies all the values of every node in a network.
+		 * The values are copied while holding the node lock once.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the network.
+		 * \param o_values Cleared, then filled with the values of each node in turn.
+		 * \param _genre If not ValueID::ValueGenre_Count, only values of this genre are copied.
+		 * \return true if the network was found.
+		 * \see ValueSnapshot, GetNodeValues
+		 */
+		bool SnapshotNetwork( uint32 const _homeId, ValueSnapshot* o_values, ValueID::ValueGenre const _genre = ValueID::ValueGenre_Count );
+
+		/**
+		 * \brief Gets the sequence number of the latest change to a network.
+		 * Call this before reading the network in full, then pass the number to GetChangesSince
+		 * to catch up on what changed while it was being read.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the network.
+		 * \return the sequence number, or zero if the network was not found or keeps no changes (ChangeJournalSize is 0).
+		 * \see ChangeJournal, GetChangesSince
+		 */
+		uint64 GetChangeSequence( uint32 const _homeId );
+
+		/**
+		 * \brief Gets the changes to a network's values, nodes and groups made after a sequence number.
+		 * Lets an application that lost track, such as a client that reconnects, catch up without
+		 * reading the whole network again.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the network.
+		 * \param _sequence The sequence number of the last change already seen, or from GetChangeSequence.
+		 * \param o_changes Cleared, then filled with the changes made since, oldest first.
+		 * \return false if the changes are no longer all kept, or the sequence number is from an earlier run
+		 * of the driver.  The application must then read the network again.
+		 * \see ChangeJournal, GetChangeSequence
+		 */
+		bool GetChangesSince( uint32 const _homeId, uint64 const _sequence, vector<ChangeJournal::Change>* o_changes );
+
+		/**
+		 * \brief Finds the values of a network that match a query.
+		 * The driver keeps its values indexed as they are added and removed, so a query such as
+		 * the user values of SensorMultilevel on a few nodes is answered without visiting every value.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the network.
+		 * \param _query The nodes, command class, genre, label and instance the values must have.  Conditions
+		 * left at their defaults match any value.
+		 * \param o_values Cleared, then filled with the values found, in ValueID order.
+		 * \return false if the network was not found.
+		 * \see ValueIndex
+		 */
+		bool FindValues( uint32 const _homeId, ValueIndex::Query const& _query, vector<ValueID>* o_values );
+
+		/**
+		 * \brief Writes the nodes and values of a network as JSON or CBOR.
+		 * Everything is read in one pass with the node list locked once, and written straight into
+		 * the buffer, rather than through a call to the Manager for each property of each node and value.
+		 * <p>The state is an object with the members homeId, sequence (to pass as _since next time), full
+		 * (false if only the changes were written), nodes, removedNodes and removedValues.  Each node has
+		 * its id, name, location, manufacturer, product, manufacturerId, productType, productId, type,
+		 * listening, frequentListening, awake, failed, zwavePlus, queryStage and values.  Each value has
+		 * its id (ValueID::GetId, as a decimal string), genre, commandClass, instance, index, type, label,
+		 * units, readOnly, writeOnly, set and value.  A list's value is the label of its selected item, with
+		 * the item's value in listValue.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the network.
+		 * \param _format JSON or CBOR.
+		 * \param o_buffer The state is appended to it.  A buffer reused from one call to the next keeps its memory.
+		 * \param _since Zero to write every node and value.  Otherwise a sequence number from an earlier call
+		 * or GetChangeSequence, to write only the nodes and values that changed after it, and those removed.
+		 * Everything is written if those changes are no longer all kept.
+		 * \return false if the network was not found.
+		 * \see StateWriter, GetChangesSince
+		 */
+		bool WriteNetworkState( uint32 const _homeId, StateWriter::Format const _format, string* o_buffer, uint64 const _since = 0 );
+
 		/**
 		 * \brief Sets the state of a bool.
 		 * Due to the possibility of a device being asleep, the command is assumed to succeed, and the value
@@ -1250,6 +1547,40 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool SetValue( ValueID const& _id, string const& _value );
 
+		/**
+		 * \brief Sets several values from strings, regardless of type.
+		 * Each value is set as SetValue would set it, but the commands for a listening node that
+		 * supports the MultiCmd command class are packed into as few frames as possible, so that
+		 * pushing a lot of configuration to a node takes fewer transactions.
+		 * \param _values The unique identifiers of the values, each paired with its new value.
+		 * \return true if every value was set.  Returns false if any value could not be found or parsed.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if a Driver cannot be found
+		 * \see SetValue
+		 */
+		bool SetValues( vector< pair<ValueID,string> > const& _values );
+
+		/**
+		 * \brief Sets the value from a string, and reports whether the device took it.
+		 * The value is set as SetValue would set it.  Once the device has reported the value
+		 * after the set, or the set has failed, the callback is made from the driver thread with
+		 * the outcome, so the application need not work it out from later notifications.  Any
+		 * number of values can be set this way at once.  Setting the same value again ends the
+		 * earlier set with Driver::SetValueResult_Superseded.
+		 * \param _id The unique identifier of the value.
+		 * \param _value The new value, in the form SetValue takes.
+		 * \param _callback Called once with the outcome.  It must not block the driver thread.
+		 * \param _context Passed to the callback.
+		 * \param _timeout Milliseconds to wait before reporting Driver::SetValueResult_Timeout, or 0 to
+		 * wait for as long as it takes.  A sleeping device only reports its value once it wakes.
+		 * \return true if the set was sent, in which case the callback will be made.  Returns false
+		 * if the value could not be parsed into the correct type for the value.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the value cannot be set from a string
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \see SetValue, Driver::SetValueResult
+		 */
+		bool SetValueAsync( ValueID const& _id, string const& _value, Driver::pfnSetValueCallback_t _callback, void* _context, uint32 const _timeout = 0 );
+
 		/**
 		 * \brief Sets the selected item in a list.
 		 * Due to the possibility of a device being asleep, the command is assumed to succeed, and the value
@@ -1276,6 +1607,37 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool RefreshValue( ValueID const& _id);
 
+		/**
+		 * \brief Refreshes the specified value from the Z-Wave network, unless it is recent enough.
+		 * If the value was read from the device within the last _maxAge milliseconds, a
+		 * Notification::Type_ValueRefreshed notification is sent at once and nothing goes on air.
+		 * RefreshValue without a maximum age does the same with the RefreshMaxAge option, which
+		 * also applies to polls and to the refreshes one value's change triggers of others.
+		 * \param _id The unique identifier of the value to be refreshed.
+		 * \param _maxAge The oldest the value may be, in milliseconds.  0 always asks the device,
+		 * and -1 uses the RefreshMaxAge option.
+		 * \return true if the driver and node were found; false otherwise
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \see RefreshValue
+		 */
+		bool RefreshValue( ValueID const& _id, int32 const _maxAge );
+
+		/**
+		 * \brief Refreshes a thermostat's mode, operating state and setpoints from the Z-Wave network.
+		 * Only the setpoint types the node supports are asked for, and, as with RefreshValue, a
+		 * value read from the device within the last _maxAge milliseconds is not asked for again.
+		 * If the node is listening and supports MultiCmd, the requests go together in as few
+		 * encapsulated frames as they fit in, rather than a round trip each.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the thermostat.
+		 * \param _maxAge The oldest a value may be, in milliseconds.  0 always asks the device,
+		 * and -1 uses the RefreshMaxAge option.
+		 * \return true if the node has thermostat values; false otherwise
+		 * \see RefreshValue
+		 */
+		bool RefreshThermostat( uint32 const _homeId, uint8 const _nodeId, int32 const _maxAge = -1 );
+
 		/**
 		 * \brief Sets a flag indicating whether value changes noted upon a refresh should be verified.  If so, the
 		 * library will immediately refresh the value a second time whenever a change is observed.  This helps to filter
@@ -1299,6 +1661,89 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool GetChangeVerified( ValueID const& _id );
 
+		/**
+		 * \brief Sets the shortest time between notifications for a value.  While a
+		 * ValueChanged or ValueRefreshed notification for the value waits to be delivered,
+		 * any more are merged into it (as a ValueChanged if any of them was one), and after
+		 * one has been delivered the next is held back until the interval has passed.  The
+		 * watchers are told about the latest value, but no more often than this.
+		 * Overrides the NotificationInterval option for this value.
+		 * \param _id The unique identifier of the value.
+		 * \param _milliseconds the interval, or zero to deliver every notification.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::GetValueNotificationInterval
+		 */
+		void SetValueNotificationInterval( ValueID const& _id, uint32 const _milliseconds );
+
+		/**
+		 * \brief Gets the shortest time between notifications for a value.
+		 * \param _id The unique identifier of the value.
+		 * \return the interval in milliseconds, from SetValueNotificationInterval or the
+		 * NotificationInterval option.  Zero if every notification is delivered.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::SetValueNotificationInterval
+		 */
+		uint32 GetValueNotificationInterval( ValueID const& _id );
+
+		/**
+		 * \brief Sets a deadband for a decimal, int or short value.  A report that differs
+		 * from the value in the last ValueChanged notification by no more than the deadband
+		 * updates the value without notifying the watchers, so small jitter in a sensor's
+		 * readings does not flood them.  Such a report is still notified if the
+		 * DeadbandHeartbeat option's number of seconds has passed since the last notification.
+		 * \param _id The unique identifier of the value.
+		 * \param _deadband the largest change to hold back, or zero to notify every report.
+		 * \param _percent if true, _deadband is a percentage of the last notified value rather
+		 * than an amount in the value's units.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is not a Decimal, Int or Short
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::GetValueDeadband
+		 */
+		void SetValueDeadband( ValueID const& _id, float const _deadband, bool const _percent );
+
+		/**
+		 * \brief Gets the deadband of a decimal, int or short value.
+		 * \param _id The unique identifier of the value.
+		 * \param o_percent if not NULL, set to whether the deadband is a percentage.
+		 * \return the deadband, or zero if every report is notified.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is not a Decimal, Int or Short
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::SetValueDeadband
+		 */
+		float GetValueDeadband( ValueID const& _id, bool* o_percent = NULL );
+
+		/**
+		 * \brief Keeps the most recent readings of a decimal value, such as a meter or sensor
+		 * reading.  Every report from the device is kept with the time it arrived, whether or
+		 * not the value changed.  Overrides the ValueHistoryDepth option for this value.
+		 * \param _id The unique identifier of the value.
+		 * \param _depth how many readings to keep, or zero to stop keeping them.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is not a Decimal
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::GetValueHistory
+		 */
+		void SetValueHistoryDepth( ValueID const& _id, uint32 const _depth );
+
+		/**
+		 * \brief Gets the recent readings of a decimal value, oldest first.
+		 * \param _id The unique identifier of the value.
+		 * \param _since only readings that arrived at or after this time are returned, in seconds
+		 * since 1970 UTC (as returned by time()).  Zero for all of them.
+		 * \param o_samples filled with the readings.
+		 * \return true if readings are being kept for the value, from SetValueHistoryDepth or
+		 * the ValueHistoryDepth option.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is not a Decimal
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \sa Manager::SetValueHistoryDepth
+		 */
+		bool GetValueHistory( ValueID const& _id, uint32 const _since, vector<ValueHistory::Sample>* o_samples );
+
 		/**
 		 * \brief Starts an activity in a device.
 		 * Since buttons are write-only values that do not report a state, no notification callbacks are sent.
@@ -1322,6 +1767,11 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		bool ReleaseButton( ValueID const& _id );
 	/*@}*/
 
+	private:
+		void SnapshotNode( Node* _node, ValueSnapshot* o_values, ValueID::ValueGenre const _genre );	// Append a node's values to a snapshot.  The caller holds the node lock.
+		void WriteNodeState( StateWriter& _writer, Node* _node, vector<ValueID> const* _values );		// Write a node, with all its values or only those listed.  The caller holds the node lock.
+		void WriteValueState( StateWriter& _writer, Value* _value );
+
 	//-----------------------------------------------------------------------------
 	// Climate Control Schedules
 	//-----------------------------------------------------------------------------
@@ -1416,6 +1866,19 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool GetSwitchPoint( ValueID const& _id, uint8 const _idx, uint8* o_hours, uint8* o_minutes, int8* o_setback );
 
+		/**
+		 * \brief Sends a schedule to the device.
+		 * The schedule is only sent if its switch points differ from those the device last reported
+		 * or was sent, so calling this for every day of the week only sends the days that changed.
+		 * \param _id The unique identifier of the schedule value.
+		 * \return true if the schedule was sent or the device already holds it.  Returns false if the value is not a ValueID::ValueType_Schedule. The type can be tested with a call to ValueID::GetType.
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_VALUEID if the ValueID is invalid
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_CANNOT_CONVERT_VALUEID if the Actual Value is off a different type
+		 * \throws OZWException with Type OZWException::OZWEXCEPTION_INVALID_HOMEID if the Driver cannot be found
+		 * \see SetSwitchPoint, RemoveSwitchPoint, ClearSwitchPoints
+		 */
+		bool SetSchedule( ValueID const& _id );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -1423,9 +1886,11 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 	//-----------------------------------------------------------------------------
 	/** \name SwitchAll
 	 *  Methods for switching all devices on or off together.  The devices must support
-	 *	the SwitchAll command class.  The command is first broadcast to all nodes, and
-	 *	then followed up with individual commands to each node (because broadcasts are
-	 *	not routed, the message might not otherwise reach all the nodes).
+	 *	the SwitchAll command class.  The command is broadcast to all nodes in one frame.
+	 *	Because broadcasts are not routed, the message might not reach all the nodes, so
+	 *	a few seconds later each listening node that has not reported anything since is
+	 *	sent the command on its own and asked for its state, one node at a time.  Sleeping
+	 *	nodes are sent the command on its own when they wake.
 	 */
 	/*@{*/
 
@@ -1492,11 +1957,62 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 
 		/**
 		 * \brief Request the values of all known configurable parameters from a device.
+		 * With the LazyConfigParams option, this also creates the values of the parameters in the
+		 * device's config file that have not been set, requested or reported yet, each with a
+		 * ValueAdded notification.
 		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
 		 * \param _nodeId The ID of the node to configure.
 		 * \see SetConfigParam, ValueID, Notification
 		 */
 		void RequestAllConfigParams( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * \brief Push a set of configurable parameters to a device.
+		 * Parameters whose last reported value is already the one wanted are skipped.  The rest
+		 * are each set and then read back, with no more than the ConfigProvisionWindow option's
+		 * number of them outstanding on the node at once, so that many nodes can be provisioned
+		 * together without any one of them holding up the others.  Progress is reported with
+		 * Notification::Type_ConfigProvisioning notifications, the last of which has
+		 * Notification::GetProvisionRemaining() equal to zero.  Calling this again for a node
+		 * that is still being provisioned adds to its parameters.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node to configure.
+		 * \param _params The values wanted, keyed by parameter index.  A parameter that has never
+		 * been reported by the device is sent with a size of 2 bytes, as with SetConfigParam.
+		 * \return true if provisioning was started.  False if the node does not support configuration.
+		 * \see SetConfigParam, RequestAllConfigParams, Notification
+		 */
+		bool ProvisionConfigParams( uint32 const _homeId, uint8 const _nodeId, map<uint8,int32> const& _params );
+
+		/**
+		 * \brief Push a set of user codes to a lock.
+		 * Slots whose last reported state is already the one wanted, including known-empty slots
+		 * that are to stay empty, are skipped.  The rest are each set and then read back, packed
+		 * into as few frames as the device allows.  If the lock is asleep, the messages wait for
+		 * it to wake up and are all sent while it is awake.  The new codes are reported with the
+		 * usual ValueChanged notifications as the lock confirms them.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the lock.
+		 * \param _codes The codes wanted, keyed by slot.  An empty code clears the slot.
+		 * \param _clearOthers If true, any slot not in _codes that may hold a code is cleared.
+		 * \return true if provisioning was started.  False if the node does not support user codes.
+		 * \see SetValue
+		 */
+		bool ProvisionUserCodes( uint32 const _homeId, uint8 const _nodeId, map<uint8,string> const& _codes, bool const _clearOthers = false );
+
+		/**
+		 * \brief Take the records read from a lock's log since the last call.
+		 * Each time the lock's state is refreshed, only the records after the last one read are
+		 * requested.  Once they have arrived a Notification::Type_DoorLockLogRecords notification
+		 * is sent.  The first time, only the most recent record is read.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the lock.
+		 * \param o_records The records are added to the end of this, oldest first, in the same
+		 * tab delimited form as the Log Record value.
+		 * \return the number of records added.
+		 * \see Notification
+		 */
+		uint32 GetDoorLockLogRecords( uint32 const _homeId, uint8 const _nodeId, vector<string>* o_records );
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -1592,6 +2108,33 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		void RemoveAssociation( uint32 const _homeId, uint8 const _nodeId, uint8 const _groupIdx, uint8 const _targetNodeId, uint8 const _instance = 0x00 );
 
+		/**
+		 * \brief Gets the members of an association group.
+		 * The members are copied into a set owned by the caller, so unlike the other GetAssociations
+		 * methods nothing needs to be freed, and a set that is used again is not reallocated.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node whose associations we are interested in.
+		 * \param _groupIdx One-based index of the group (because Z-Wave product manuals use one-based group numbering).
+		 * \param o_members Filled with the nodes and instances in the group.  Emptied if there is no such group.
+		 * \return The number of members of the group.
+		 * \see SetAssociations, GetNumGroups, GetMaxAssociations
+		 */
+		uint32 GetAssociations( uint32 const _homeId, uint8 const _nodeId, uint8 const _groupIdx, NodeSet* o_members );
+
+		/**
+		 * \brief Sets the members of an association group.
+		 * Only the difference from the members last reported by the device is sent, with the removals
+		 * and then the additions packed several to a message, followed by a single request for the
+		 * group's new contents.  Instances of nodes can only be set in multi instance groups.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node whose associations are to be changed.
+		 * \param _groupIdx One-based index of the group (because Z-Wave product manuals use one-based group numbering).
+		 * \param _members The nodes and instances the group should hold.
+		 * \return The number of associations added or removed.  Zero if the group already held the members wanted.
+		 * \see GetAssociations, AddAssociation, RemoveAssociation
+		 */
+		uint32 SetAssociations( uint32 const _homeId, uint8 const _nodeId, uint8 const _groupIdx, NodeSet const& _members );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -1609,10 +2152,11 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 * An application needs only add a single watcher - all notifications will be reported to it.
 		 * \param _watcher pointer to a function that will be called by the notification system.
 		 * \param _context pointer to user defined data that will be passed to the watcher function with each notification.
+		 * \param _filter the notifications the watcher wants.  The rest are not passed to it.  By default, all of them.
 		 * \return true if the watcher was successfully added.
-		 * \see RemoveWatcher, Notification
+		 * \see RemoveWatcher, Notification, NotificationFilter
 		 */
-		bool AddWatcher( pfnOnNotification_t _watcher, void* _context );
+		bool AddWatcher( pfnOnNotification_t _watcher, void* _context, NotificationFilter const& _filter = NotificationFilter() );
 
 		/**
 		 * \brief Remove a notification watcher.
@@ -1622,32 +2166,108 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 * \see AddWatcher, Notification
 		 */
 		bool RemoveWatcher( pfnOnNotification_t _watcher, void* _context );
+
+		/**
+		 * \brief Add a notification watcher that receives notifications in batches.
+		 * Each call passes every notification that was waiting to be delivered, oldest first.
+		 * The notifications, and the array holding them, are only valid until the watcher returns.
+		 * Setting the NotificationThread option makes the calls come from a dedicated thread, so
+		 * the time spent handling them does not hold up communication with the Z-Wave network.
+		 * \param _watcher pointer to a function that will be called by the notification system.
+		 * \param _context pointer to user defined data that will be passed to the watcher function with each batch.
+		 * \param _filter the notifications the watcher wants.  The rest are left out of its batches, and it is
+		 * not called when none are left.  By default, all of them.
+		 * \return true if the watcher was successfully added.
+		 * \see RemoveBatchWatcher, AddWatcher, Notification, NotificationFilter
+		 */
+		bool AddBatchWatcher( pfnOnNotificationBatch_t _watcher, void* _context, NotificationFilter const& _filter = NotificationFilter() );
+
+		/**
+		 * \brief Remove a batch notification watcher.
+		 * \param _watcher pointer to a function that must match that passed to a previous call to AddBatchWatcher
+		 * \param _context pointer to user defined data that must match the one passed in that same previous call to AddBatchWatcher.
+		 * \return true if the watcher was successfully removed.
+		 * \see AddBatchWatcher, Notification
+		 */
+		bool RemoveBatchWatcher( pfnOnNotificationBatch_t _watcher, void* _context );
+
+		/**
+		 * \brief Add a watcher for scene and button events.
+		 * Events from Central Scene and Scene Activation are passed to these watchers as soon as
+		 * the frame has been decoded, before any value is updated or notification queued, so a
+		 * scene controller can switch lights with as little delay as possible.  The watchers are
+		 * called from the driver thread and must return quickly.  The usual Type_ValueRefreshed,
+		 * Type_ValueChanged and Type_SceneEvent notifications still follow.
+		 * \param _watcher pointer to a function that will be called with each event.
+		 * \param _context pointer to user defined data that will be passed to the watcher function with each event.
+		 * \return true if the watcher was successfully added.
+		 * \see RemoveSceneEventWatcher, Driver::SceneEvent
+		 */
+		bool AddSceneEventWatcher( Driver::pfnSceneEventCallback_t _watcher, void* _context );
+
+		/**
+		 * \brief Remove a scene event watcher.
+		 * \param _watcher pointer to a function that must match that passed to a previous call to AddSceneEventWatcher
+		 * \param _context pointer to user defined data that must match the one passed in that same previous call to AddSceneEventWatcher.
+		 * \return true if the watcher was successfully removed.
+		 * \see AddSceneEventWatcher
+		 */
+		bool RemoveSceneEventWatcher( Driver::pfnSceneEventCallback_t _watcher, void* _context );
 	/*@}*/
 
 	private:
-		void NotifyWatchers( Notification* _notification );					// Passes the notifications to all the registered watcher callbacks in turn.
+		void NotifyWatchers( Notification const* const* _notifications, uint32 _count );	// Passes the notifications to all the registered watcher callbacks in turn.
 
 		struct Watcher
 		{
-			pfnOnNotification_t	m_callback;
-			void*				m_context;
+			pfnOnNotification_t			m_callback;
+			pfnOnNotificationBatch_t	m_batchCallback;
+			void*						m_context;
+			NotificationFilter			m_filter;
+			bool						m_filtered;		// False if the filter accepts everything
 
 			Watcher
 			(
 				pfnOnNotification_t _callback,
-				void* _context
+				void* _context,
+				NotificationFilter const& _filter
 			):
 				m_callback( _callback ),
-				m_context( _context )
+				m_batchCallback( NULL ),
+				m_context( _context ),
+				m_filter( _filter ),
+				m_filtered( !_filter.IsEmpty() )
+			{
+			}
+
+			Watcher
+			(
+				pfnOnNotificationBatch_t _batchCallback,
+				void* _context,
+				NotificationFilter const& _filter
+			):
+				m_callback( NULL ),
+				m_batchCallback( _batchCallback ),
+				m_context( _context ),
+				m_filter( _filter ),
+				m_filtered( !_filter.IsEmpty() )
 			{
 			}
 		};
 
 OPENZWAVE_EXPORT_WARNINGS_OFF
 		list<Watcher*>		m_watchers;										// List of all the registered watchers.
+		vector<Notification const*>	m_filteredNotifications;				// The batch passed to a filtered batch watcher.  Only used under m_notificationMutex.
 OPENZWAVE_EXPORT_WARNINGS_ON
 		Mutex*				m_notificationMutex;
 
+		void NotifySceneEventWatchers( Driver::SceneEvent const& _event );	// Passes a scene event to the scene event watchers
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list< pair<Driver::pfnSceneEventCallback_t,void*> >	m_sceneEventWatchers;
+OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*				m_sceneEventMutex;						// Kept apart from m_notificationMutex, which is held while watchers handle notifications
+
 	//-----------------------------------------------------------------------------
 	// Controller commands
 	//-----------------------------------------------------------------------------
@@ -1766,6 +2386,40 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		void TestNetwork( uint32 const _homeId, uint32 const _count );
 
+		/**
+		 * \brief Test the radio links between the nodes of the network.
+		 * Every listening node that supports the Powerlevel command class sends test frames
+		 * to each of its neighbors.  Tests whose nodes cannot hear each other run at the
+		 * same time.  A Notification::Type_NetworkHealthScan is sent when all are done.
+		 * The neighbor lists must be known, so the nodes should have finished their interviews.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param _frames The number of test frames to send over each link.
+		 * \return true if any links are to be tested.
+		 * \see GetLinkQuality, GetLinkQualities
+		 */
+		bool BeginNetworkHealthScan( uint32 const _homeId, uint16 const _frames = 10 );
+
+		/**
+		 * \brief Get the result of the last network health scan for a link.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param _nodeA The node at one end of the link.
+		 * \param _nodeB The node at the other end.
+		 * \param o_percent Set to the share of test frames that were acknowledged.
+		 * \return false if the link was not tested.
+		 * \see BeginNetworkHealthScan
+		 */
+		bool GetLinkQuality( uint32 const _homeId, uint8 const _nodeA, uint8 const _nodeB, uint8* o_percent );
+
+		/**
+		 * \brief Get the results of the last network health scan for every link.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param o_links Filled with a result for each link.  A link whose test did not run
+		 * has no frames sent.
+		 * \return the number of links.
+		 * \see BeginNetworkHealthScan
+		 */
+		uint32 GetLinkQualities( uint32 const _homeId, vector<LinkQuality>* o_links );
+
  		/**
 		 * \brief Heal network node by requesting the node rediscover their neighbors.
 		 * Sends a ControllerCommand_RequestNodeNeighborUpdate to the node.
@@ -1777,13 +2431,65 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 
  		/**
 		 * \brief Heal network by requesting node's rediscover their neighbors.
-		 * Sends a ControllerCommand_RequestNodeNeighborUpdate to every node.
-		 * Can take a while on larger networks.
+		 * Sends a ControllerCommand_RequestNodeNeighborUpdate to every node, one node at a time,
+		 * starting with those whose messages most often fail.  Each node waits until the
+		 * heal has used no more than the HealAirtimeShare option's percentage of the time,
+		 * and until any messages waiting to be sent have gone, so can take a while on larger
+		 * networks.  The nodes still to be healed are saved with the network configuration,
+		 * and the heal carries on after a restart.  A second call starts the heal again.
 		 * \param _homeId The Home ID of the Z-Wave network to be healed.
 		 * \param _doRR Whether to perform return routes initialization.
+		 * \see CancelHealNetwork, GetHealNetworkRemaining
 		 */
 		void HealNetwork( uint32 const _homeId, bool _doRR );
 
+		/**
+		 * \brief Stop a heal started by HealNetwork.  The node being healed is finished.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \return the number of nodes that will not now be healed.
+		 */
+		uint32 CancelHealNetwork( uint32 const _homeId );
+
+		/**
+		 * \brief Get the number of nodes a heal started by HealNetwork still has to do.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \return the nodes still to be healed, including the one under way.
+		 */
+		uint32 GetHealNetworkRemaining( uint32 const _homeId );
+
+		/**
+		 * \brief Heal only the nodes whose neighbor lists may be out of date.
+		 * A node's list is marked as out of date when messages to it fail or find no route,
+		 * or when a neighbor's new list disagrees with it.  Each such node is sent a
+		 * ControllerCommand_RequestNodeNeighborUpdate, as HealNetwork sends to every node.
+		 * The NeighborRefreshInterval option does the same in the background, one node at a time.
+		 * \param _homeId The Home ID of the Z-Wave network to be healed.
+		 * \param _doRR Whether to perform return routes initialization.
+		 * \return the number of nodes being healed.
+		 * \see IsNodeNeighborInfoStale
+		 */
+		uint32 HealStaleNodes( uint32 const _homeId, bool _doRR );
+
+		/**
+		 * \brief Find out whether a node's neighbor list may be out of date.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param _nodeId The node to check.
+		 * \return true if the list is due to be refreshed.
+		 * \see HealStaleNodes
+		 */
+		bool IsNodeNeighborInfoStale( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * \brief Find out whether two nodes are neighbors, from the neighbor lists already read.
+		 * No messages are sent.
+		 * \param _homeId The Home ID of the Z-Wave network.
+		 * \param _nodeA One node.
+		 * \param _nodeB The other node.
+		 * \return true if either node lists the other as a neighbor.
+		 * \see GetNodeNeighbors
+		 */
+		bool AreNodesNeighbors( uint32 const _homeId, uint8 const _nodeA, uint8 const _nodeB );
+
 		/**
 		 * \brief Start the Inclusion Process to add a Node to the Network.
 		 * The Status of the Node Inclusion is communicated via Notifications. Specifically, you should
@@ -2013,6 +2719,197 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool DeleteButton(uint32 const _homeId, uint8 const _nodeId, uint8 const _buttonid);
 
+		/**
+		 * \brief Send a new firmware image to a node.
+		 *
+		 * The node must support COMMAND_CLASS_FIRMWARE_UPDATE_MD.  The image is sent in
+		 * fragments as the node asks for them, behind all other traffic, so the network stays
+		 * usable while the update runs.  Progress is reported with Notification::Type_FirmwareUpdate
+		 * notifications, as the update moves from one Driver::FirmwareUpdateState to the next
+		 * and at every further 10% of the image sent.
+		 *
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _nodeId The ID of the node to update
+		 * \param _fileName The image, exactly as it is to be written to the node
+		 * \param _target The firmware target, 0 for the node's own firmware
+		 * \return true if the update was started
+		 * \sa CancelFirmwareUpdate, GetFirmwareUpdateProgress
+		 */
+		bool BeginFirmwareUpdate( uint32 const _homeId, uint8 const _nodeId, string const& _fileName, uint8 const _target = 0 );
+
+		/**
+		 * \brief Stop sending a firmware image to a node.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _nodeId The ID of the node being updated
+		 * \return true if an update was under way
+		 * \sa BeginFirmwareUpdate
+		 */
+		bool CancelFirmwareUpdate( uint32 const _homeId, uint8 const _nodeId );
+
+		/**
+		 * \brief Get the progress of a firmware update, or the outcome of the last one.
+		 * Includes the number of fragments sent again at the node's request, and the rate at which
+		 * the image has been taken.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _nodeId The ID of the node being updated
+		 * \param _data Filled in with the progress.  Left alone if the node does not support firmware updates.
+		 * \return true if the node supports firmware updates
+		 * \sa BeginFirmwareUpdate
+		 */
+		bool GetFirmwareUpdateProgress( uint32 const _homeId, uint8 const _nodeId, Driver::FirmwareUpdateData* _data );
+
+		/**
+		 * \brief Copy the controller's NVM, which holds the network, to a file.
+		 *
+		 * The NVM is read in the largest blocks a Serial API frame holds, with the next few
+		 * requests always queued so the controller is kept busy, and each block is written to
+		 * the file as it arrives.  The file is only replaced once the whole NVM has been read,
+		 * and carries a CRC of it.  Progress is reported with Notification::Type_ControllerNvm
+		 * notifications, as the backup moves from one Driver::NvmState to the next and at every
+		 * further 10% of the NVM read.  Controllers with the 500 series NVM interface only.
+		 *
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _fileName The file to write
+		 * \return true if the backup was started
+		 * \sa RestoreControllerNvm, CancelControllerNvm, GetControllerNvmProgress
+		 */
+		bool BackupControllerNvm( uint32 const _homeId, string const& _fileName );
+
+		/**
+		 * \brief Write a backup made by BackupControllerNvm into the controller's NVM.
+		 *
+		 * The backup's CRC is checked before anything is written, and it must be of a controller
+		 * with the same size of NVM.  Progress is reported as for BackupControllerNvm.  The
+		 * controller only uses the restored network once it has been reset with SoftReset, and the
+		 * driver should then be removed and added again so it reads the network afresh.
+		 *
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _fileName The backup to restore
+		 * \return true if the restore was started
+		 * \sa BackupControllerNvm, CancelControllerNvm, GetControllerNvmProgress
+		 */
+		bool RestoreControllerNvm( uint32 const _homeId, string const& _fileName );
+
+		/**
+		 * \brief Stop a controller NVM backup or restore.  The few requests already queued are
+		 * still sent, so a cancelled restore leaves the NVM partly written.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \return true if a backup or restore was under way
+		 * \sa BackupControllerNvm, RestoreControllerNvm
+		 */
+		bool CancelControllerNvm( uint32 const _homeId );
+
+		/**
+		 * \brief Get the progress of a controller NVM backup or restore, or the outcome of the last one.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _data Filled in with the progress
+		 * \return true if the driver was found
+		 * \sa BackupControllerNvm, RestoreControllerNvm
+		 */
+		bool GetControllerNvmProgress( uint32 const _homeId, Driver::NvmData* _data );
+
+		/**
+		 * \brief Capture the frames that pass between other nodes, for network diagnostics.
+		 *
+		 * The controller is put in promiscuous mode, and each frame it overhears is kept with the
+		 * time it arrived.  The frames are not decoded, and no node or value is changed by them.
+		 * They are either taken by the application with GetSniffedFrames or, if a trace file is
+		 * given, written to it as Direction_Sniffed records of the ControllerTrace format.  Up to
+		 * about a thousand frames are held, and any more that arrive before they are taken are
+		 * dropped.  Not all controllers support promiscuous mode.
+		 *
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _traceFile A trace file to write, in the UserPath folder, or empty for the application to take the frames
+		 * \return true if the sniffer was started
+		 * \sa EndSniffing, GetSniffedFrames
+		 */
+		bool BeginSniffing( uint32 const _homeId, string const& _traceFile = "" );
+
+		/**
+		 * \brief Take the controller out of promiscuous mode, and close any trace file.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \return true if the sniffer was running
+		 * \sa BeginSniffing
+		 */
+		bool EndSniffing( uint32 const _homeId );
+
+		/**
+		 * \brief Take the frames captured since the last call.
+		 * Call from one thread at a time.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param o_frames Filled with the frames, oldest first
+		 * \param _timeout ms to wait for a frame if there are none yet, 0 to return at once or -1 to wait until one comes
+		 * \param o_dropped If not NULL, filled with the number of frames dropped since sniffing started
+		 * \return true if the sniffer is running without a trace file
+		 * \sa BeginSniffing
+		 */
+		bool GetSniffedFrames( uint32 const _homeId, vector<Driver::SniffedFrame>* o_frames, int32 const _timeout = 0, uint32* o_dropped = NULL );
+
+		/**
+		 * \brief Record what happens to each message sent, to see on a timeline where the time goes.
+		 *
+		 * Each message being queued, taken off its queue, written, acknowledged, answered and called
+		 * back is noted with the time, the thread and the node, along with the nonces asked for, the
+		 * retries and the message's removal.  The latest events are kept, up to the number given,
+		 * until EndMsgTrace saves them.  Any events from an earlier trace are discarded.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _capacity The number of events to keep
+		 * \sa EndMsgTrace
+		 */
+		void BeginMsgTrace( uint32 const _homeId, uint32 const _capacity = 65536 );
+
+		/**
+		 * \brief Stop recording messages, and save the events in the Chrome trace event format.
+		 * The file can be opened in chrome://tracing or the Perfetto UI, where each message is a
+		 * span from being queued to being removed.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _fileName The file to write, in the UserPath folder
+		 * \return true if a trace was running and the file was written
+		 * \sa BeginMsgTrace
+		 */
+		bool EndMsgTrace( uint32 const _homeId, string const& _fileName );
+
+		/**
+		 * \brief Expect more nodes of the same product as a node already interviewed.
+		 * When a node with the same manufacturer, product type and product id, and the same command
+		 * classes in its node information frame, is next added, it is given the template node's command
+		 * classes, versions, endpoints and static values rather than being asked for them, and is then
+		 * sent the configuration set with SetProvisionedConfigParam, in as few frames as it allows.
+		 * The node's protocol info, node info and manufacturer specific report are still needed to
+		 * recognise it.  Provisioned products are not saved, and must be added again each time the
+		 * driver is started.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _templateNodeId The ID of an interviewed node of the product
+		 * \return true if the product was added, false if the node does not exist or its static queries are not complete
+		 * \sa RemoveProvisionedProduct, SetProvisionedConfigParam, AddNode
+		 */
+		bool AddProvisionedProduct( uint32 const _homeId, uint8 const _templateNodeId );
+
+		/**
+		 * \brief Stop expecting nodes of a product added with AddProvisionedProduct.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _manufacturerId The manufacturer ID of the product
+		 * \param _productType The product type of the product
+		 * \param _productId The product ID of the product
+		 * \return true if the product had been provisioned
+		 * \sa AddProvisionedProduct
+		 */
+		bool RemoveProvisionedProduct( uint32 const _homeId, uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId );
+
+		/**
+		 * \brief Set a configuration parameter to send to each new node of a provisioned product.
+		 * \param _homeId The HomeID of the Z-Wave network
+		 * \param _manufacturerId The manufacturer ID of the product
+		 * \param _productType The product type of the product
+		 * \param _productId The product ID of the product
+		 * \param _param The index of the parameter.
+		 * \param _value The value to which the parameter should be set.
+		 * \param _size Is an optional number of bytes to be sent for the parameter _value. Defaults to 2.
+		 * \return true if the product has been provisioned with AddProvisionedProduct
+		 * \sa AddProvisionedProduct, SetConfigParam
+		 */
+		bool SetProvisionedConfigParam( uint32 const _homeId, uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, uint8 const _param, int32 const _value, uint8 const _size = 2 );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -2351,6 +3248,40 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		bool ActivateScene( uint8 const _sceneId );
 
+		/**
+		 * \brief Activate a scene whenever a value changes.
+		 * The scene is activated by the driver thread as soon as the frame that reported the change has been
+		 * handled, without waiting for the application.  Rules are not saved, and must be added again each time
+		 * the driver is started.  Changes made by the scenes themselves do not trigger rules.
+		 * \param _valueId The value to watch.
+		 * \param _value The value that triggers the scene, compared as SetValue would set it, or an empty string for any change.
+		 * \param _sceneId The Scene ID to activate.
+		 * \return the rule's ID, or 0 if the driver does not exist.
+		 * \see RemoveSceneRule, ActivateScene
+		 */
+		uint32 AddSceneRule( ValueID const& _valueId, string const& _value, uint8 const _sceneId );
+
+		/**
+		 * \brief Activate a scene whenever a node sends a Central Scene or Scene Activation event.
+		 * \param _homeId The Home ID of the Z-Wave controller that manages the node.
+		 * \param _nodeId The ID of the node that sends the event.
+		 * \param _triggerSceneId The scene or button number in the event.
+		 * \param _keyAttributes For Central Scene, how the key must be used (see Driver::SceneEvent), or 0xff for any.
+		 * \param _sceneId The Scene ID to activate.
+		 * \return the rule's ID, or 0 if the driver does not exist.
+		 * \see RemoveSceneRule, AddSceneEventWatcher
+		 */
+		uint32 AddSceneRule( uint32 const _homeId, uint8 const _nodeId, uint8 const _triggerSceneId, uint8 const _keyAttributes, uint8 const _sceneId );
+
+		/**
+		 * \brief Remove a rule added by AddSceneRule.
+		 * \param _homeId The Home ID of the Z-Wave controller the rule was added to.
+		 * \param _ruleId The rule's ID.
+		 * \return true if the rule was removed.
+		 * \see AddSceneRule
+		 */
+		bool RemoveSceneRule( uint32 const _homeId, uint32 const _ruleId );
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -2368,6 +3299,17 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		void GetDriverStatistics( uint32 const _homeId, Driver::DriverData* _data );
 
+		/**
+		 * \brief Retrieve the driver and node statistics as text for a metrics scraper
+		 * The driver's counters and latency histograms, and each node's counters, round trip
+		 * times and latency histograms, in the Prometheus text exposition format.  Every
+		 * sample carries a home_id label, and the node samples a node label, so the text of
+		 * several drivers can be served together.
+		 * \param _homeId The Home ID of the driver
+		 * \param o_text The metrics are appended to this
+		 */
+		void GetMetrics( uint32 const _homeId, string& o_text );
+
 		/**
 		 * \brief Retrieve statistics per node
 		 * \param _homeId The Home ID of the driver for the node
@@ -2376,6 +3318,83 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		 */
 		void GetNodeStatistics( uint32 const _homeId, uint8 const _nodeId, Node::NodeData* _data );
 
+		/**
+		 * \brief Retrieve the counters of every node in a single copy
+		 * Cheaper than calling GetNodeStatistics for each node, for applications that
+		 * gather the statistics of the whole network at regular intervals.
+		 * \param _homeId The Home ID of the driver for the nodes
+		 * \param _data Pointer to structure NodeCounters to return values.  m_nodes says which nodes exist.
+		 */
+		void GetAllNodeStatistics( uint32 const _homeId, Driver::NodeCounters* _data );
+
+		/**
+		 * \brief Retrieve the percentiles of the time taken by each stage of sending a message
+		 * \param _homeId The Home ID of the driver to obtain the latencies
+		 * \param _data Pointer to structure DriverLatencyData to return values
+		 */
+		void GetDriverLatencyStatistics( uint32 const _homeId, Driver::DriverLatencyData* _data );
+
+		/**
+		 * \brief Retrieve the percentiles of the round trip times to a node
+		 * \param _homeId The Home ID of the driver for the node
+		 * \param _nodeId The node number
+		 * \param _data Pointer to structure NodeLatencyData to return values
+		 */
+		void GetNodeLatencyStatistics( uint32 const _homeId, uint8 const _nodeId, Node::NodeLatencyData* _data );
+
+		/**
+		 * \brief Retrieve the time each stage of a node's interview took, and how often it was retried
+		 * A Notification::Type_NodeQueryStage is sent as each stage is over.  While the interview is
+		 * running, the current stage and the interview as a whole are timed until now.  Stages that
+		 * are queried again start their timings afresh.
+		 * \param _homeId The Home ID of the driver for the node
+		 * \param _nodeId The node number
+		 * \param _data Pointer to structure NodeQueryStageData to return values
+		 */
+		void GetNodeQueryStageStatistics( uint32 const _homeId, uint8 const _nodeId, Node::NodeQueryStageData* _data );
+
+		/**
+		 * \brief Estimate the memory used by a driver's nodes, values, groups and queues
+		 * The figures count the objects and what they own on the heap, with an allowance
+		 * for each container entry, so they track growth rather than match the allocator
+		 * exactly.  Values and their shared strings are reported separately.
+		 * \param _homeId The Home ID of the driver
+		 * \param _data Pointer to structure MemoryData to return values
+		 */
+		void GetMemoryStatistics( uint32 const _homeId, Driver::MemoryData* _data );
+
+		/**
+		 * \brief Estimate the memory used by a node, and by each of its command classes
+		 * \param _homeId The Home ID of the driver for the node
+		 * \param _nodeId The node number
+		 * \param _data Pointer to structure NodeMemoryData to return values
+		 */
+		void GetNodeMemoryStatistics( uint32 const _homeId, uint8 const _nodeId, Node::NodeMemoryData* _data );
+
+		/**
+		 * \brief Start or stop counting and timing the calls into each command class
+		 * The CommandClassProfiling option sets whether this starts on.  The counts are
+		 * kept for all drivers together, and are kept while profiling is off.
+		 * \param _enable true to time the calls.
+		 * \see GetCommandClassProfile, ResetCommandClassProfile
+		 */
+		void SetCommandClassProfiling( bool const _enable );
+
+		/**
+		 * \brief Retrieve the number of calls into each command class, and the time they took
+		 * For each command class, the reports it handled, the requests for its state and values,
+		 * the values set through it and its value updates are counted, with their total and
+		 * longest times.  The times include any command classes called from within, so those of
+		 * an encapsulating command class include the ones it carries.
+		 * \param o_data cleared, then filled with an entry for each command class called.
+		 */
+		void GetCommandClassProfile( vector<CommandClassProfile::Data>* o_data );
+
+		/**
+		 * \brief Clear the counts and times returned by GetCommandClassProfile
+		 */
+		void ResetCommandClassProfile();
+
 	};
 	/*@}*/
 } // namespace OpenZWave
@@ -26,15 +26,19 @@
 //-----------------------------------------------------------------------------
 
 #include "Defs.h"
+#include "Checksum.h"
 #include "Msg.h"
 #include "Node.h"
 #include "Manager.h"
 #include "Utils.h"
 #include "ZWSecurity.h"
 #include "platform/Log.h"
+#include "platform/MemoryPool.h"
 #include "command_classes/MultiInstance.h"
 #include "command_classes/Security.h"
+#include "command_classes/Supervision.h"
 #include "aes/aescpp.h"
+#include "tinyxml.h"
 
 using namespace OpenZWave;
 
@@ -43,13 +47,41 @@ uint8 Msg::s_nextCallbackId = 10;
 
 #define DEBUG 1
 
+// Freed messages kept for reuse
+static MemoryPool s_msgPool( sizeof(Msg), 64 );
+
+//-----------------------------------------------------------------------------
+// <Msg::operator new>
+// Allocate a message from the pool
+//-----------------------------------------------------------------------------
+void* Msg::operator new
+(
+	size_t _size
+)
+{
+	return s_msgPool.Allocate( _size );
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::operator delete>
+// Return a message to the pool
+//-----------------------------------------------------------------------------
+void Msg::operator delete
+(
+	void* _ptr,
+	size_t _size
+)
+{
+	s_msgPool.Free( _ptr, _size );
+}
+
 //-----------------------------------------------------------------------------
 // <Msg::Msg>
 // Constructor
 //-----------------------------------------------------------------------------
 Msg::Msg
 (
-	string const& _logText,
+	char const* _logText,
 	uint8 _targetNodeId,
 	uint8 const _msgType,
 	uint8 const _function,
@@ -68,12 +100,19 @@ Msg::Msg
 	m_targetNodeId( _targetNodeId ),
 	m_sendAttempts( 0 ),
 	m_maxSendAttempts( MAX_TRIES ),
+	m_maxQueueTime( 0 ),
+	m_handoffs( 0 ),
 	m_instance( 1 ),
 	m_endPoint( 0 ),
 	m_flags( 0 ),
+	m_sessionFlags( 0 ),
 	m_encrypted ( false ),
 	m_noncerecvd ( false ),
-	m_homeId ( 0 )
+	m_nonceGet ( false ),
+	m_homeId ( 0 ),
+	m_supersedeLength( 0 ),
+	m_coalesceKey( 0 ),
+	m_traceId( 0 )
 {
 	if( _bReplyRequired )
 	{
@@ -81,15 +120,25 @@ Msg::Msg
 		m_expectedReply = _expectedReply ? _expectedReply : _function;
 	}
 
-	memset(m_buffer, 0x00, 256);
-	memset(e_buffer, 0x00, 256);
-
 	m_buffer[0] = SOF;
 	m_buffer[1] = 0;					// Length of the following data, filled in during Finalize.
 	m_buffer[2] = _msgType;
 	m_buffer[3] = _function;
 }
 
+//-----------------------------------------------------------------------------
+// <Msg::SetLogText>
+// Name the message with a copy of a text built at run time
+//-----------------------------------------------------------------------------
+void Msg::SetLogText
+(
+	string const& _logText
+)
+{
+	m_logTextCopy = SharedString( _logText );
+	m_logText = m_logTextCopy.c_str();
+}
+
 //-----------------------------------------------------------------------------
 // <Msg::SetInstance>
 // Used to enable wrapping with MultiInstance/MultiChannel during finalize.
@@ -127,6 +176,26 @@ void Msg::SetInstance
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Msg::SetSupervision>
+// Used to enable wrapping with Supervision during finalize.  The message is
+// then complete once the node's Supervision report arrives.
+//-----------------------------------------------------------------------------
+void Msg::SetSupervision
+(
+	uint8 const _sessionFlags
+)
+{
+	m_flags |= m_Supervision;
+	m_sessionFlags = _sessionFlags;
+	m_expectedReply = FUNC_ID_APPLICATION_COMMAND_HANDLER;
+	if( ( m_flags & ( m_MultiChannel | m_MultiInstance ) ) == 0 )
+	{
+		// Otherwise the report comes back wrapped in the same encapsulation
+		m_expectedCommandClassId = Supervision::StaticGetCommandClassId();
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Msg::Append>
 // Add a byte to the message
@@ -136,6 +205,7 @@ void Msg::Append
 	uint8 const _data
 )
 {
+	m_buffer.Reserve( m_length + 1 );
 	m_buffer[m_length++] = _data;
 }
 
@@ -151,6 +221,46 @@ void Msg::Finalize()
 		return;
 	}
 
+	// Room for the encapsulation headers, the callback id and the checksum
+	m_buffer.Reserve( m_length + 10 );
+
+	// Work out which queued requests this one could be merged with, while
+	// the payload is still where the command class put it
+	if( ( m_buffer[3] == FUNC_ID_ZW_SEND_DATA ) && ( m_length > 6 ) )
+	{
+		uint8 keyLength = 0;
+		if( m_supersedeLength )
+		{
+			keyLength = ( m_supersedeLength < m_buffer[5] ) ? m_supersedeLength : m_buffer[5];
+		}
+		else if( m_expectedReply == FUNC_ID_APPLICATION_COMMAND_HANDLER )
+		{
+			keyLength = m_buffer[5];
+		}
+
+		if( keyLength )
+		{
+			// FNV-1a over the kind of key, the target, the instance and the identifying bytes
+			uint8 head[4] = { (uint8)( m_supersedeLength ? 1 : 2 ), m_targetNodeId, m_instance, m_endPoint };
+			uint64 hash = 0xcbf29ce484222325ULL;
+			for( int i=0; i<4; ++i )
+			{
+				hash = ( hash ^ head[i] ) * 0x100000001b3ULL;
+			}
+			for( uint8 i=0; i<keyLength; ++i )
+			{
+				hash = ( hash ^ m_buffer[6+i] ) * 0x100000001b3ULL;
+			}
+			m_coalesceKey = hash ? hash : 1;
+		}
+	}
+
+	// Supervision goes inside any Multi-Channel/Instance encapsulation
+	if( ( m_flags & m_Supervision ) != 0 )
+	{
+		SupervisionEncap();
+	}
+
 	// Deal with Multi-Channel/Instance encapsulation
 	if( ( m_flags & ( m_MultiChannel | m_MultiInstance ) ) != 0 )
 	{
@@ -178,12 +288,8 @@ void Msg::Finalize()
 	}
 
 	// Calculate the checksum
-	uint8 checksum = 0xff;
-	for( uint32 i=1; i<m_length; ++i )
-	{
-		checksum ^= m_buffer[i];
-	}
-	m_buffer[m_length++] = checksum;
+	m_buffer[m_length] = XorChecksum( &m_buffer[1], m_length-1 );
+	m_length++;
 
 	m_bFinal = true;
 }
@@ -202,20 +308,54 @@ void Msg::UpdateCallbackId()
 			s_nextCallbackId = 10;
 		}
 
-		// update the callback ID
+		// update the callback ID, and swap it into the checksum in place of the old one
+		m_buffer[m_length-1] ^= m_buffer[m_length-2] ^ s_nextCallbackId;
 		m_buffer[m_length-2] = s_nextCallbackId;
 		m_callbackId = s_nextCallbackId++;
+	}
+}
 
-		// Recalculate the checksum
-		uint8 checksum = 0xff;
-		for( int32 i=1; i<m_length-1; ++i )
-		{
-			checksum ^= m_buffer[i];
-		}
-		m_buffer[m_length-1] = checksum;
+
+//-----------------------------------------------------------------------------
+// <Msg::GetTransmitOptions>
+// The transmit options follow the payload of a ZW_SEND_DATA request
+//-----------------------------------------------------------------------------
+uint8 Msg::GetTransmitOptions
+(
+)const
+{
+	if( !m_bFinal || ( m_buffer[3] != FUNC_ID_ZW_SEND_DATA ) )
+	{
+		return 0;
+	}
+
+	// Followed by the callback id, if there is one, and the checksum
+	uint32 pos = 6 + m_buffer[5];
+	if( pos + ( m_bCallbackRequired ? 2 : 1 ) >= m_length )
+	{
+		return 0;
 	}
+	return m_buffer[pos];
 }
 
+//-----------------------------------------------------------------------------
+// <Msg::SetTransmitOptions>
+// Change the transmit options and swap them into the checksum
+//-----------------------------------------------------------------------------
+void Msg::SetTransmitOptions
+(
+	uint8 const _options
+)
+{
+	if( GetTransmitOptions() == 0 )
+	{
+		return;
+	}
+
+	uint32 pos = 6 + m_buffer[5];
+	m_buffer[m_length-1] ^= m_buffer[pos] ^ _options;
+	m_buffer[pos] = _options;
+}
 
 //-----------------------------------------------------------------------------
 // <Msg::GetAsString>
@@ -223,7 +363,7 @@ void Msg::UpdateCallbackId()
 //-----------------------------------------------------------------------------
 string Msg::GetAsString()
 {
-	string str = m_logText;
+	string str = GetLogText();
 
 	char byteStr[16];
 	if( m_targetNodeId != 0xff )
@@ -234,17 +374,43 @@ string Msg::GetAsString()
 
 	str += ": ";
 
-	for( uint32 i=0; i<m_length; ++i )
-	{
-		if( i )
-		{
-			str += ", ";
-		}
+	char pktStr[256*6];
+	str += PktToString( m_buffer, m_length, pktStr, sizeof(pktStr) );
 
-		snprintf( byteStr, sizeof(byteStr), "0x%.2x", m_buffer[i] );
-		str += byteStr;
+	return str;
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::GetLogText>
+// The text naming the message, noting the encapsulation Finalize added.
+// Built only when it is asked for, as most messages are never logged.
+//-----------------------------------------------------------------------------
+string Msg::GetLogText
+(
+)const
+{
+	string str( m_logText );
+	if( !m_bFinal || m_buffer[3] != FUNC_ID_ZW_SEND_DATA )
+	{
+		return str;
 	}
 
+	char prefix[64];
+	if( ( m_flags & m_Supervision ) != 0 )
+	{
+		snprintf( prefix, sizeof(prefix), "Supervision Encapsulated (session=%d): ", m_sessionFlags & 0x3f );
+		str.insert( 0, prefix );
+	}
+	if( ( m_flags & m_MultiChannel ) != 0 )
+	{
+		snprintf( prefix, sizeof(prefix), "MultiChannel Encapsulated (instance=%d): ", m_instance );
+		str.insert( 0, prefix );
+	}
+	else if( ( m_flags & m_MultiInstance ) != 0 )
+	{
+		snprintf( prefix, sizeof(prefix), "MultiInstance Encapsulated (instance=%d): ", m_instance );
+		str.insert( 0, prefix );
+	}
 	return str;
 }
 
@@ -256,7 +422,6 @@ void Msg::MultiEncap
 (
 )
 {
-	char str[256];
 	if( m_buffer[3]	!= FUNC_ID_ZW_SEND_DATA )
 	{
 		return;
@@ -277,9 +442,6 @@ void Msg::MultiEncap
 		m_buffer[8] = 1;
 		m_buffer[9] = m_endPoint;
 		m_length += 4;
-
-		snprintf( str, sizeof(str), "MultiChannel Encapsulated (instance=%d): %s", m_instance, m_logText.c_str() );
-		m_logText = str;
 	}
 	else
 	{
@@ -294,10 +456,33 @@ void Msg::MultiEncap
 		m_buffer[7] = MultiInstance::MultiInstanceCmd_Encap;
 		m_buffer[8] = m_instance;
 		m_length += 3;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::SupervisionEncap>
+// Encapsulate the data inside a Supervision Get
+//-----------------------------------------------------------------------------
+void Msg::SupervisionEncap
+(
+)
+{
+	if( m_buffer[3] != FUNC_ID_ZW_SEND_DATA )
+	{
+		return;
+	}
 
-		snprintf( str, sizeof(str), "MultiInstance Encapsulated (instance=%d): %s", m_instance, m_logText.c_str() );
-		m_logText = str;
+	for( uint32 i=m_length-1; i>=6; --i )
+	{
+		m_buffer[i+4] = m_buffer[i];
 	}
+
+	m_buffer[9] = m_buffer[5];
+	m_buffer[5] += 4;
+	m_buffer[6] = Supervision::StaticGetCommandClassId();
+	m_buffer[7] = Supervision::SupervisionCmd_Get;
+	m_buffer[8] = m_sessionFlags;
+	m_length += 4;
 }
 
 //-----------------------------------------------------------------------------
@@ -311,17 +496,129 @@ Driver* Msg::GetDriver
 	return( Manager::Get()->GetDriver( m_homeId ) );
 }
 
+//-----------------------------------------------------------------------------
+// <Msg::WriteXML>
+// Save a finalized message.  The frame is kept whole, encapsulation and all,
+// along with what the driver needs to match the replies to it.
+//-----------------------------------------------------------------------------
+void Msg::WriteXML
+(
+	TiXmlElement* _msgElement
+)const
+{
+	char str[32];
+	string frame;
+	AppendHex( m_buffer, m_length, frame );
+
+	_msgElement->SetAttribute( "text", m_logText );
+	_msgElement->SetAttribute( "node", m_targetNodeId );
+	_msgElement->SetAttribute( "callback", m_bCallbackRequired ? "true" : "false" );
+	_msgElement->SetAttribute( "reply", m_expectedReply );
+	_msgElement->SetAttribute( "cc", m_expectedCommandClassId );
+	_msgElement->SetAttribute( "instance", m_instance );
+	_msgElement->SetAttribute( "endpoint", m_endPoint );
+	_msgElement->SetAttribute( "flags", m_flags );
+	_msgElement->SetAttribute( "session", m_sessionFlags );
+	_msgElement->SetAttribute( "max_attempts", m_maxSendAttempts );
+	_msgElement->SetAttribute( "supersede", m_supersedeLength );
+	snprintf( str, sizeof(str), "0x%.8x", (uint32)( m_coalesceKey >> 32 ) );
+	_msgElement->SetAttribute( "key_high", str );
+	snprintf( str, sizeof(str), "0x%.8x", (uint32)m_coalesceKey );
+	_msgElement->SetAttribute( "key_low", str );
+	_msgElement->SetAttribute( "encrypted", m_encrypted ? "true" : "false" );
+	_msgElement->SetAttribute( "frame", frame.c_str() );
+}
+
+//-----------------------------------------------------------------------------
+// <Msg::ReadXML>
+// Rebuild a message saved by WriteXML
+//-----------------------------------------------------------------------------
+Msg* Msg::ReadXML
+(
+	TiXmlElement const* _element,
+	uint32 const _homeId
+)
+{
+	char const* text = _element->Attribute( "text" );
+	char const* frame = _element->Attribute( "frame" );
+	char const* str;
+	int32 node, reply, cc, instance, endPoint, flags, session, maxAttempts, supersede;
+	if( text == NULL || frame == NULL
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "node", &node )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "reply", &reply )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "cc", &cc )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "instance", &instance )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "endpoint", &endPoint )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "flags", &flags )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "session", &session )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "max_attempts", &maxAttempts )
+		|| TIXML_SUCCESS != _element->QueryIntAttribute( "supersede", &supersede ) )
+	{
+		return NULL;
+	}
+
+	// A frame runs from the SOF to the checksum, and holds at least the function.
+	// Its length has to fit in m_length.
+	uint32 length = (uint32)strlen( frame ) / 2;
+	uint8 buffer[255];
+	if( length < 5 || length > sizeof(buffer) || !ParseHex( frame, buffer, length ) || buffer[0] != SOF )
+	{
+		return NULL;
+	}
+
+	str = _element->Attribute( "callback" );
+	bool callbackRequired = ( str && !strcmp( str, "true" ) );
+	if( callbackRequired && length < 6 )
+	{
+		return NULL;
+	}
+
+	Msg* msg = new Msg( "", (uint8)node, buffer[2], buffer[3], callbackRequired, reply != 0, (uint8)reply, (uint8)cc );
+	msg->SetLogText( text );
+	msg->m_buffer.Reserve( length );
+	memcpy( msg->m_buffer, buffer, length );
+	msg->m_length = (uint8)length;
+	msg->m_bFinal = true;
+	msg->m_instance = (uint8)instance;
+	msg->m_endPoint = (uint8)endPoint;
+	msg->m_flags = (uint8)flags;
+	msg->m_sessionFlags = (uint8)session;
+	msg->m_maxSendAttempts = (uint8)maxAttempts;
+	msg->m_supersedeLength = (uint8)supersede;
+	msg->m_homeId = _homeId;
+
+	uint32 high = 0;
+	uint32 low = 0;
+	if( ( str = _element->Attribute( "key_high" ) ) )
+	{
+		high = (uint32)strtoul( str, NULL, 16 );
+	}
+	if( ( str = _element->Attribute( "key_low" ) ) )
+	{
+		low = (uint32)strtoul( str, NULL, 16 );
+	}
+	msg->m_coalesceKey = ( (uint64)high << 32 ) | low;
+
+	str = _element->Attribute( "encrypted" );
+	msg->m_encrypted = ( str && !strcmp( str, "true" ) );
+
+	// The callback id was handed out by the process that saved the message
+	msg->UpdateCallbackId();
+	return msg;
+}
 
 uint8* Msg::GetBuffer() {
 	if (m_encrypted == false)
 		return m_buffer;
-	else
-		if (EncyrptBuffer(m_buffer, m_length, GetDriver(), GetDriver()->GetControllerNodeId(), m_targetNodeId, m_nonce, e_buffer)) {
+	else {
+		e_buffer.Reserve( 256 );
+		if (EncyrptBuffer(m_buffer, m_length, GetDriver(), GetDriver()->GetControllerNodeId(), m_targetNodeId, m_nonce, e_buffer, m_nonceGet)) {
 			return e_buffer;
 		} else {
 			Log::Write(LogLevel_Warning, m_targetNodeId, "Failed to Encyrpt Packet");
 			return NULL;
 		}
+	}
 }
 
 
@@ -32,8 +32,11 @@
 #include <string>
 #include <string.h>
 #include "Defs.h"
+#include "SharedString.h"
 //#include "Driver.h"
 
+class TiXmlElement;
+
 namespace OpenZWave
 {
 	class CommandClass;
@@ -48,16 +51,30 @@ namespace OpenZWave
 		{
 			m_MultiChannel			= 0x01,		// Indicate MultiChannel encapsulation
 			m_MultiInstance			= 0x02,		// Indicate MultiInstance encapsulation
+			m_Supervision			= 0x04,		// Indicate Supervision encapsulation
 		};
 
-		Msg( string const& _logtext, uint8 _targetNodeId, uint8 const _msgType, uint8 const _function, bool const _bCallbackRequired, bool const _bReplyRequired = true, uint8 const _expectedReply = 0, uint8 const _expectedCommandClassId = 0 );
+		/**
+		 * \param _logText text that names the message in the log.  Only the pointer is kept, so it must
+		 * outlive the message, as a string literal does.  A text built at run time is given with SetLogText.
+		 */
+		Msg( char const* _logText, uint8 _targetNodeId, uint8 const _msgType, uint8 const _function, bool const _bCallbackRequired, bool const _bReplyRequired = true, uint8 const _expectedReply = 0, uint8 const _expectedCommandClassId = 0 );
 		~Msg(){}
 
+		void SetLogText( string const& _logText );		// Name the message with a copy of a text built at run time
+
+		// Messages are allocated from a pool, as one is created for every frame sent
+		static void* operator new( size_t _size );
+		static void operator delete( void* _ptr, size_t _size );
+
 		void SetInstance( CommandClass* _cc, uint8 const _instance );	// Used to enable wrapping with MultiInstance/MultiChannel during finalize.
+		void SetSupervision( uint8 const _sessionFlags );				// Wrap in a Supervision Get during finalize, inside any MultiInstance/MultiChannel, and wait for its report.  Call after SetInstance.
 
 		void Append( uint8 const _data );
 		void Finalize();
 		void UpdateCallbackId();
+		uint8 GetTransmitOptions()const;						// Transmit options of a finalized ZW_SEND_DATA request, or 0
+		void SetTransmitOptions( uint8 const _options );		// Change the transmit options of a finalized ZW_SEND_DATA request
 
 		/**
 		 * \brief Identifies the Node ID of the "target" node (if any) for this function.
@@ -103,9 +120,9 @@ namespace OpenZWave
 //		uint8 GetExpectedIndex()const{ return m_expectedIndex; }
 		/**
 		 * \brief get the LogText Associated with this message
-		 * \return the LogText used during the constructor
+		 * \return the LogText used during the constructor, preceded by a note of any encapsulation
 		 */
-		string GetLogText()const{ return m_logText; }
+		string GetLogText()const;
 
 		uint32 GetLength()const{ return m_encrypted == true ? m_length + 20 + 6 : m_length; }
 		uint8* GetBuffer();
@@ -117,6 +134,30 @@ namespace OpenZWave
 		uint8 GetMaxSendAttempts()const{ return m_maxSendAttempts; }
 		void SetMaxSendAttempts( uint8 _count ){ if( _count < MAX_MAX_TRIES ) m_maxSendAttempts = _count; }
 
+		/**
+		 * \brief Drop the message unsent if it waits on its send queue for longer than this.
+		 * Without one, a request for a report has its queue's deadline from the QueueDeadlines
+		 * option, and other messages wait for as long as it takes.
+		 * \param _ms the longest wait in milliseconds, or 0 for the queue's deadline.
+		 */
+		void SetMaxQueueTime( uint32 const _ms ){ m_maxQueueTime = _ms; }
+		uint32 GetMaxQueueTime()const{ return m_maxQueueTime; }
+
+		/**
+		 * \brief The number of times the message has been passed to another controller of its
+		 * network, to be sent over a better route or after this one failed.
+		 * \see ControllerGroup
+		 */
+		uint8 GetHandoffs()const{ return m_handoffs; }
+		void AddHandoff(){ ++m_handoffs; }
+
+		/**
+		 * \brief The number a MsgTrace gave the message, so its events can be matched up.
+		 * \return the number, or 0 if the message has not been traced.
+		 */
+		uint32 GetTraceId()const{ return m_traceId; }
+		void SetTraceId( uint32 const _id ){ m_traceId = _id; }
+
 		bool IsWakeUpNoMoreInformationCommand()
 		{
 			return( m_bFinal && (m_length==11) && (m_buffer[3]==0x13) && (m_buffer[6]==0x84) && (m_buffer[7]==0x08) );
@@ -125,6 +166,28 @@ namespace OpenZWave
 		{
 			return( m_bFinal && (m_length==11) && (m_buffer[3]==0x13) && (m_buffer[6]==0x00) && (m_buffer[7]==0x00) );
 		}
+		bool IsSendData()const
+		{
+			return( m_bFinal && (m_buffer[3]==0x13) );
+		}
+
+		/**
+		 * \brief Let a later Set of the same value replace this one while it is still queued.
+		 * Call before the message is sent.
+		 * \param _keyLength how many bytes of the command class payload, starting with the
+		 * command class itself, identify the value being set.
+		 */
+		void SetSupersedable( uint8 const _keyLength ){ m_supersedeLength = _keyLength; }
+		bool IsSupersedable()const{ return( m_supersedeLength != 0 ); }
+
+		/**
+		 * \brief Identifies the queued requests that this one can be merged with or replace.
+		 * A request that expects a report shares its key with identical requests, and a Set
+		 * marked with SetSupersedable shares its key with the other Sets of the same value on
+		 * the same node and instance.  Worked out by Finalize.
+		 * \return the key, or 0 if the message is always sent.
+		 */
+		uint64 GetCoalesceKey()const{ return m_coalesceKey; }
 
 		bool operator == ( Msg const& _other )const
 		{
@@ -137,6 +200,56 @@ namespace OpenZWave
 
 			return false;
 		}
+		/**
+		 * \brief Get the command class payload of a ZW_SEND_DATA request that is not
+		 * wrapped in a MultiInstance/MultiChannel encapsulation.  Finalizing a message
+		 * only adds to the end of it, so the payload is the same before and after.
+		 * \param _length set to the length of the payload.
+		 * \return the payload, or NULL if the message is not such a request.
+		 */
+		uint8 const* GetSendDataPayload( uint8& _length )const
+		{
+			if( (m_buffer[3] != FUNC_ID_ZW_SEND_DATA) || ( m_flags & ( m_MultiChannel | m_MultiInstance ) ) != 0 || (m_length < 7) )
+			{
+				return NULL;
+			}
+			uint8 skip = GetSupervisionLength();
+			_length = m_buffer[5] - skip;
+			return &m_buffer[6+skip];
+		}
+
+		/**
+		 * \brief Get the command class payload of a ZW_SEND_DATA request that has not been
+		 * finalized yet, whatever encapsulation it will be given.
+		 * \param _length set to the length of the payload.
+		 * \return the payload, or NULL if the message is not such a request.
+		 */
+		uint8 const* GetUnwrappedPayload( uint8& _length )const
+		{
+			if( m_bFinal || (m_buffer[3] != FUNC_ID_ZW_SEND_DATA) || (m_length < 7) )
+			{
+				return NULL;
+			}
+			_length = m_buffer[5];
+			return &m_buffer[6];
+		}
+
+		/**
+		 * \brief Get a byte of the command class payload of a ZW_SEND_DATA request, whether or
+		 * not it has been finalized.
+		 * \param _index offset into the payload, where 0 is the command class.
+		 * \return the byte, or 0 if the message is not an unencapsulated request that long.
+		 */
+		uint8 GetSendDataByte( uint8 const _index )const
+		{
+			uint8 skip = GetSupervisionLength();
+			if( (m_buffer[3] != FUNC_ID_ZW_SEND_DATA) || ( m_flags & ( m_MultiChannel | m_MultiInstance ) ) != 0 || ( _index + skip >= m_buffer[5] ) )
+			{
+				return 0;
+			}
+			return m_buffer[6+skip+_index];
+		}
+
 		uint8 GetSendingCommandClass() {
 			if (m_buffer[3] == 0x13) {
 				return m_buffer[6];
@@ -163,8 +276,27 @@ namespace OpenZWave
 			memset((m_nonce), '\0', 8);
 			m_noncerecvd = false;
 		}
+		/** Ask the node for its next nonce along with this message, by sending it as a MessageEncapNonceGet */
+		void setNonceGet(bool nonceGet) {
+			m_nonceGet = nonceGet;
+		}
 		void SetHomeId(uint32 homeId) { m_homeId = homeId; };
 
+		/**
+		 * \brief Save a finalized message, so that it can be sent after a restart.
+		 * \param _msgElement the element to fill in.
+		 * \see ReadXML
+		 */
+		void WriteXML( TiXmlElement* _msgElement )const;
+
+		/**
+		 * \brief Rebuild a message saved by WriteXML.  It is given a new callback id.
+		 * \param _element the element written by WriteXML.
+		 * \param _homeId the home id of the driver that will send it.
+		 * \return the message, or NULL if the element does not hold a valid one.
+		 */
+		static Msg* ReadXML( TiXmlElement const* _element, uint32 const _homeId );
+
 		/** Returns a pointer to the driver (interface with a Z-Wave controller)
 		 *  associated with this node.
 		*/
@@ -173,8 +305,68 @@ namespace OpenZWave
 
 
 		void MultiEncap();						// Encapsulate the data inside a MultiInstance/Multicommand message
+		void SupervisionEncap();				// Encapsulate the data inside a Supervision Get
+		uint8 GetSupervisionLength()const{ return( ( m_bFinal && ( m_flags & m_Supervision ) != 0 ) ? 4 : 0 ); }	// Bytes of Supervision header at the start of a finalized payload
+
+		/**
+		 * \brief Storage for a frame, held in the message up to InlineSize bytes.
+		 *
+		 * Nearly every frame fits in a few dozen bytes, while a message could need 256,
+		 * and thousands of messages can wait in the queues of a large network.  Reserve
+		 * moves the frame to a 256 byte block on the heap when it outgrows the message.
+		 * The buffer converts to a pointer to the frame, which changes when it moves.
+		 */
+		template<uint32 InlineSize> class FrameBuffer
+		{
+		public:
+			FrameBuffer(): m_spill( NULL ){ memset( m_inline, 0, sizeof(m_inline) ); }
+			FrameBuffer( FrameBuffer const& _other ): m_spill( NULL ){ *this = _other; }
+			~FrameBuffer(){ delete [] m_spill; }
+
+			FrameBuffer& operator = ( FrameBuffer const& _other )
+			{
+				if( this != &_other )
+				{
+					memcpy( m_inline, _other.m_inline, sizeof(m_inline) );
+					if( _other.m_spill )
+					{
+						Reserve( 256 );
+						memcpy( m_spill, _other.m_spill, 256 );
+					}
+					else
+					{
+						delete [] m_spill;
+						m_spill = NULL;
+					}
+				}
+				return *this;
+			}
+
+			operator uint8* (){ return m_spill ? m_spill : m_inline; }
+			operator uint8 const* ()const{ return m_spill ? m_spill : m_inline; }
+
+			/** Make room for a frame of _length bytes. */
+			void Reserve( uint32 const _length )
+			{
+				if( _length > InlineSize && !m_spill )
+				{
+					m_spill = new uint8[256]();
+					memcpy( m_spill, m_inline, InlineSize );
+				}
+			}
+
+		private:
+			uint8*			m_spill;
+			uint8			m_inline[InlineSize ? InlineSize : 1];
+		};
+
+		enum
+		{
+			InlineFrameSize	= 48					// Covers all but the longest frames, such as firmware and configuration blocks
+		};
 
-		string			m_logText;
+		char const*		m_logText;				// Static, or the text of m_logTextCopy
+		SharedString	m_logTextCopy;			// Copy of a log text built at run time
 		bool			m_bFinal;
 		bool			m_bCallbackRequired;
 
@@ -182,21 +374,30 @@ namespace OpenZWave
 		uint8			m_expectedReply;
 		uint8			m_expectedCommandClassId;
 		uint8			m_length;
-		uint8			m_buffer[256];
-		uint8			e_buffer[256];
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		FrameBuffer<InlineFrameSize>	m_buffer;
+		FrameBuffer<0>	e_buffer;				// The encrypted frame, only allocated for secure messages
+OPENZWAVE_EXPORT_WARNINGS_ON
 
 		uint8			m_targetNodeId;
 		uint8			m_sendAttempts;
 		uint8			m_maxSendAttempts;
+		uint32			m_maxQueueTime;			// Milliseconds the message may wait on its queue, or 0 for the queue's deadline
+		uint8			m_handoffs;				// Times the message has moved to another controller of the network
 
 		uint8			m_instance;
 		uint8			m_endPoint;				// Endpoint to use if the message must be wrapped in a multiInstance or multiChannel command class
 		uint8			m_flags;
+		uint8			m_sessionFlags;			// Session id and status updates flag of the Supervision Get, if m_Supervision is set
 
 		bool			m_encrypted;
 		bool			m_noncerecvd;
+		bool			m_nonceGet;
 		uint8			m_nonce[8];
 		uint32			m_homeId;
+		uint8			m_supersedeLength;		// Bytes of the payload that identify the value a Set is for, or 0
+		uint64			m_coalesceKey;
+		uint32			m_traceId;				// Set by MsgTrace, or 0
 		static uint8	s_nextCallbackId;		// counter to get a unique callback id
 	};
 
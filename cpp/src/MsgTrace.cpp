@@ -0,0 +1,259 @@
+//-----------------------------------------------------------------------------
+//
+//	MsgTrace.cpp
+//
+//	Records the life of each message sent, for a timeline viewer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "MsgTrace.h"
+#include "Msg.h"
+#include "Utils.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+#include "platform/TimeStamp.h"
+
+using namespace OpenZWave;
+
+static char const* c_eventNames[] =
+{
+	"Enqueue",
+	"Dequeue",
+	"Write",
+	"ACK",
+	"Response",
+	"Callback",
+	"Nonce Request",
+	"Nonce Report",
+	"Retry",
+	"Remove"
+};
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::MsgTrace>
+// Constructor
+//-----------------------------------------------------------------------------
+MsgTrace::MsgTrace
+(
+):
+	m_mutex( new Mutex( false ) ),
+	m_tracing( 0 ),
+	m_capacity( 0 ),
+	m_next( 0 ),
+	m_start( 0 ),
+	m_nextMsgId( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::~MsgTrace>
+// Destructor
+//-----------------------------------------------------------------------------
+MsgTrace::~MsgTrace
+(
+)
+{
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::Start>
+// Start a trace
+//-----------------------------------------------------------------------------
+void MsgTrace::Start
+(
+	uint32 const _capacity
+)
+{
+	LockGuard LG( m_mutex );
+	m_capacity = _capacity ? _capacity : 1;
+	m_entries.clear();
+	m_entries.reserve( m_capacity );
+	m_next = 0;
+	m_start = TimeStamp::GetTicksNs();
+	AtomicStore( &m_tracing, 1 );
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::Stop>
+// Stop recording events
+//-----------------------------------------------------------------------------
+void MsgTrace::Stop
+(
+)
+{
+	LockGuard LG( m_mutex );
+	AtomicStore( &m_tracing, 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::Add>
+// Note an event
+//-----------------------------------------------------------------------------
+void MsgTrace::Add
+(
+	Event const _event,
+	Msg* _msg,
+	uint8 const _queue
+)
+{
+	if( _msg == NULL )
+	{
+		return;
+	}
+
+	Entry entry;
+	entry.m_threadId = Thread::GetCurrentId();
+	entry.m_event = (uint8)_event;
+	entry.m_nodeId = _msg->GetTargetNodeId();
+	entry.m_funcId = _msg->GetBuffer()[3];
+	entry.m_queue = _queue;
+	entry.m_attempt = _msg->GetSendAttempts();
+	entry.m_callbackId = _msg->GetCallbackId();
+
+	LockGuard LG( m_mutex );
+	if( !m_tracing )
+	{
+		return;
+	}
+	if( !_msg->GetTraceId() )
+	{
+		// Zero means not traced, so it is skipped if the numbers wrap
+		if( ++m_nextMsgId == 0 )
+		{
+			++m_nextMsgId;
+		}
+		_msg->SetTraceId( m_nextMsgId );
+	}
+	entry.m_msgId = _msg->GetTraceId();
+	entry.m_time = TimeStamp::GetTicksNs() - m_start;
+
+	if( m_entries.size() < m_capacity )
+	{
+		m_entries.push_back( entry );
+	}
+	else
+	{
+		m_entries[m_next] = entry;
+	}
+	m_next = ( m_next + 1 ) % m_capacity;
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::Write>
+// Save the events recorded in the Chrome trace event format
+//-----------------------------------------------------------------------------
+bool MsgTrace::Write
+(
+	string const& _filename,
+	uint32 const _homeId,
+	char const* const* _queueNames,
+	uint32 const _queueCount
+)
+{
+	// Copy the events, oldest first, so the file is written without holding the lock
+	vector<Entry> entries;
+	{
+		LockGuard LG( m_mutex );
+		entries.reserve( m_entries.size() );
+		if( m_entries.size() == m_capacity )
+		{
+			entries.insert( entries.end(), m_entries.begin() + m_next, m_entries.end() );
+			entries.insert( entries.end(), m_entries.begin(), m_entries.begin() + m_next );
+		}
+		else
+		{
+			entries = m_entries;
+		}
+	}
+
+	string tmpname = _filename + ".tmp";
+	FILE* file = fopen( tmpname.c_str(), "w" );
+	if( file == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Could not open %s to write the message trace", tmpname.c_str() );
+		return false;
+	}
+
+	fprintf( file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" );
+	fprintf( file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"OpenZWave 0x%.8x\"}}", _homeId, _homeId );
+	for( vector<Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it )
+	{
+		Entry const& entry = *it;
+
+		// Each message is a span of its own, from being queued to being removed.  The
+		// span's start and end must share a name, so it names the node and function.
+		char name[32];
+		if( entry.m_nodeId == 0xff )
+		{
+			snprintf( name, sizeof(name), "Controller 0x%.2x", entry.m_funcId );
+		}
+		else
+		{
+			snprintf( name, sizeof(name), "Node %03d 0x%.2x", entry.m_nodeId, entry.m_funcId );
+		}
+
+		char const* phase = "n";
+		if( Event_Enqueue == entry.m_event )
+		{
+			phase = "b";
+		}
+		else if( Event_Remove == entry.m_event )
+		{
+			phase = "e";
+		}
+
+		fprintf( file, ",\n{\"name\":\"%s\",\"cat\":\"msg\",\"ph\":\"%s\",\"id\":%u,\"pid\":%u,\"tid\":%llu,\"ts\":%llu.%03u,\"args\":{\"event\":\"%s\",\"node\":%d,\"attempt\":%d,\"callbackId\":%d",
+				( phase[0] == 'n' ) ? c_eventNames[entry.m_event] : name, phase, entry.m_msgId, _homeId, (unsigned long long)entry.m_threadId,
+				(unsigned long long)( entry.m_time / 1000 ), (uint32)( entry.m_time % 1000 ), c_eventNames[entry.m_event], entry.m_nodeId, entry.m_attempt, entry.m_callbackId );
+		if( entry.m_queue < _queueCount )
+		{
+			fprintf( file, ",\"queue\":\"%s\"", _queueNames[entry.m_queue] );
+		}
+		fprintf( file, "}}" );
+	}
+	fprintf( file, "\n]}\n" );
+
+	bool ok = ( ferror( file ) == 0 );
+	ok = ( fclose( file ) == 0 ) && ok;
+	ok = ok && FileOps::ReplaceFile( tmpname, _filename );
+	if( !ok )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Failed to write the message trace %s", _filename.c_str() );
+		return false;
+	}
+	Log::Write( LogLevel_Info, "Wrote %d message events to %s", (uint32)entries.size(), _filename.c_str() );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <MsgTrace::GetEventName>
+// The name of an event
+//-----------------------------------------------------------------------------
+char const* MsgTrace::GetEventName
+(
+	Event const _event
+)
+{
+	return( ( _event < Event_Count ) ? c_eventNames[_event] : "Unknown" );
+}
@@ -0,0 +1,151 @@
+//-----------------------------------------------------------------------------
+//
+//	MsgTrace.h
+//
+//	Records the life of each message sent, for a timeline viewer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _MsgTrace_H
+#define _MsgTrace_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "platform/Atomic.h"
+
+namespace OpenZWave
+{
+	class Msg;
+	class Mutex;
+
+	/** \brief Records what happens to each message a driver sends, for a timeline viewer.
+	 *
+	 * While a trace runs, the driver notes each message being queued, taken off its queue,
+	 * written to the controller, acknowledged, answered by the controller, called back and
+	 * answered by the node, as well as the nonces asked for and received for it, each retry
+	 * and its removal.  Each event keeps the time in nanoseconds, the thread it happened on
+	 * and the node the message is for.
+	 *
+	 * The events are kept in a ring of a fixed size, so a long trace keeps the latest ones.
+	 * Write saves them in the Chrome trace event format, which chrome://tracing and the
+	 * Perfetto UI open.  Each message is shown as a span of its own from being queued to
+	 * being removed, with the other events marked on it, so time spent waiting on a queue
+	 * and bursts of retries stand out.
+	 *
+	 * When no trace is running, Record costs a single load.
+	 */
+	class MsgTrace
+	{
+	public:
+		enum Event
+		{
+			Event_Enqueue = 0,				// Put on a send queue, or held for a sleeping node
+			Event_Dequeue,					// Taken off its queue to be sent
+			Event_Write,					// Written to the controller
+			Event_Ack,						// Acknowledged by the controller
+			Event_Response,					// The reply it was waiting for arrived
+			Event_Callback,					// The controller called back with the result of sending it
+			Event_NonceRequest,				// A nonce was asked for, to encrypt it
+			Event_NonceReport,				// The nonce arrived
+			Event_Retry,					// About to be sent again
+			Event_Remove,					// Done with, whether or not it succeeded
+			Event_Count
+		};
+
+		MsgTrace();
+		~MsgTrace();
+
+		/**
+		 * Start a trace, discarding any events already recorded.
+		 * \param _capacity the number of events to keep.
+		 */
+		void Start( uint32 const _capacity );
+
+		/**
+		 * Stop recording events.  Those recorded are kept until the next trace starts.
+		 */
+		void Stop();
+
+		/**
+		 * \return true while a trace is running.
+		 */
+		bool IsTracing()const{ return( AtomicLoad( &m_tracing ) != 0 ); }
+
+		/**
+		 * Note an event, if a trace is running.  The first event of a message gives it a trace ID.
+		 * \param _event what happened.
+		 * \param _msg the message it happened to.
+		 * \param _queue the send queue, for Event_Enqueue and Event_Dequeue.
+		 */
+		void Record( Event const _event, Msg* _msg, uint8 const _queue = 0xff )
+		{
+			if( IsTracing() )
+			{
+				Add( _event, _msg, _queue );
+			}
+		}
+
+		/**
+		 * Save the events recorded in the Chrome trace event format.
+		 * \param _filename the file to write.
+		 * \param _homeId the network, used as the process ID so the traces of several drivers can be merged.
+		 * \param _queueNames the name of each send queue.
+		 * \param _queueCount the number of send queues.
+		 * \return true if the file was written.
+		 */
+		bool Write( string const& _filename, uint32 const _homeId, char const* const* _queueNames, uint32 const _queueCount );
+
+		/**
+		 * \return the name of an event.
+		 */
+		static char const* GetEventName( Event const _event );
+
+	private:
+		MsgTrace( MsgTrace const& );					// prevent copy
+		MsgTrace& operator = ( MsgTrace const& );		// prevent assignment
+
+		struct Entry
+		{
+			uint64	m_time;						// Nanoseconds since the trace started
+			uint64	m_threadId;
+			uint32	m_msgId;
+			uint8	m_event;
+			uint8	m_nodeId;
+			uint8	m_funcId;
+			uint8	m_queue;
+			uint8	m_attempt;
+			uint8	m_callbackId;
+		};
+
+		void Add( Event const _event, Msg* _msg, uint8 const _queue );
+
+		Mutex*			m_mutex;
+		volatile uint32	m_tracing;
+		vector<Entry>	m_entries;				// The ring
+		uint32			m_capacity;
+		uint32			m_next;					// Where the next event goes in the ring
+		uint64			m_start;				// Clock reading when the trace started
+		uint32			m_nextMsgId;
+	};
+
+} // namespace OpenZWave
+
+#endif //_MsgTrace_H
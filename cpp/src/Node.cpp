@@ -32,12 +32,14 @@
 #include "Defs.h"
 #include "Group.h"
 #include "Options.h"
+#include "CommandClassProfile.h"
 #include "Manager.h"
 #include "Driver.h"
 #include "Notification.h"
 #include "Msg.h"
 #include "ZWSecurity.h"
 #include "platform/Log.h"
+#include "platform/MemoryPool.h"
 #include "platform/Mutex.h"
 #include "Utils.h"
 
@@ -47,12 +49,19 @@
 #include "command_classes/CommandClass.h"
 #include "command_classes/Association.h"
 #include "command_classes/Basic.h"
+#include "command_classes/Battery.h"
+#include "command_classes/CentralScene.h"
 #include "command_classes/Configuration.h"
 #include "command_classes/ControllerReplication.h"
 #include "command_classes/ManufacturerSpecific.h"
+#include "command_classes/Meter.h"
 #include "command_classes/MultiInstance.h"
 #include "command_classes/MultiChannelAssociation.h"
 #include "command_classes/Security.h"
+#include "command_classes/SensorBinary.h"
+#include "command_classes/SensorMultilevel.h"
+#include "command_classes/SwitchBinary.h"
+#include "command_classes/SwitchMultilevel.h"
 #include "command_classes/WakeUp.h"
 #include "command_classes/NodeNaming.h"
 #include "command_classes/NoOperation.h"
@@ -83,11 +92,25 @@ using namespace OpenZWave;
 // Statics
 //-----------------------------------------------------------------------------
 bool Node::s_deviceClassesLoaded = false;
-map<uint8,string> Node::s_basicDeviceClasses;
-map<uint8,Node::GenericDeviceClass*> Node::s_genericDeviceClasses;
-map<uint8,Node::DeviceClass*> Node::s_roleDeviceClasses;
-map<uint16,Node::DeviceClass*> Node::s_deviceTypeClasses;
-map<uint8,Node::DeviceClass*> Node::s_nodeTypes;
+Mutex* Node::s_deviceClassesMutex = new Mutex();
+DeviceClasses::Table Node::s_basicDeviceClasses = { NULL, 0, false };
+DeviceClasses::Table Node::s_genericDeviceClasses = { NULL, 0, false };
+DeviceClasses::Table Node::s_roleDeviceClasses = { NULL, 0, false };
+DeviceClasses::Table Node::s_deviceTypeClasses = { NULL, 0, false };
+DeviceClasses::Table Node::s_nodeTypes = { NULL, 0, false };
+
+// Freed nodes kept for reuse
+static MemoryPool s_nodePool( sizeof(Node), 8 );
+
+// Checked for every clear text frame to a secured command class
+static Options::Handle<bool> s_enforceSecureReception( "EnforceSecureReception", true );
+
+// Checked for every sensor and meter report
+static Options::Handle<int32> s_inboundRateLimit( "InboundRateLimit", 0 );
+static Options::Handle<int32> s_inboundBurst( "InboundBurst", 10 );
+
+// Distinct reports held back from a node that is over its rate limit
+static size_t const c_maxHeldFrames = 16;
 
 static char const* c_queryStageNames[] =
 {
@@ -121,6 +144,7 @@ Node::Node
 		uint32 const _homeId,
 		uint8 const _nodeId
 ):
+m_mutex( new Mutex() ),
 m_queryStage( QueryStage_None ),
 m_queryPending( false ),
 m_queryConfiguration( false ),
@@ -133,6 +157,14 @@ m_manufacturerSpecificClassReceived( false ),
 m_nodeInfoSupported( true ),
 m_refreshonNodeInfoFrame ( true ),
 m_nodeAlive( true ),	// assome live node
+m_queryPriority( QueryPriority_Normal ),
+m_queryPrioritySet( false ),
+m_recordingDiscovery( false ),
+m_replayingDiscovery( false ),
+m_discoveryReplayed( false ),
+m_recordingSecurity( false ),
+m_securityReplayed( false ),
+m_handedOver( false ),
 m_listening( true ),	// assume we start out listening
 m_frequentListening( false ),
 m_beaming( false ),
@@ -147,6 +179,8 @@ m_generic( 0 ),
 m_specific( 0 ),
 m_type( "" ),
 m_numRouteNodes( 0 ),
+m_routesAssigned( false ),
+m_buttonsInConfig( false ),
 m_addingNode( false ),
 m_manufacturerName( "" ),
 m_productName( "" ),
@@ -160,27 +194,53 @@ m_role( 0 ),
 m_nodeType ( 0 ),
 m_secured ( false ),
 m_values( new ValueStore() ),
-m_sentCnt( 0 ),
-m_sentFailed( 0 ),
-m_retries( 0 ),
-m_receivedCnt( 0 ),
-m_receivedDups( 0 ),
-m_receivedUnsolicited( 0 ),
-m_lastRequestRTT( 0 ),
-m_lastResponseRTT( 0 ),
-m_averageRequestRTT( 0 ),
-m_averageResponseRTT( 0 ),
-m_quality( 0 ),
+m_deferConfigParams( false ),
+m_smoothedRTT( 0 ),
+m_rttVariation( 0 ),
 m_lastReceivedMessage(),
+m_lastReceivedLength( 0 ),
+m_recentFrames(),
+m_nextRecentFrame( 0 ),
 m_errors( 0 ),
+m_deliveryRun( 0 ),
+m_timedStage( QueryStage_None ),
+m_interviewElapsed( 0 ),
+m_rxCredit( 0xffffffff ),		// Cut down to the burst at the first refill
+m_flooding( false ),
 m_lastnonce ( 0 )
 {
-	memset( m_neighbors, 0, sizeof(m_neighbors) );
+	memset( m_stageData, 0, sizeof(m_stageData) );
 	memset( m_routeNodes, 0, sizeof(m_routeNodes) );
 	memset( m_nonces, 0, sizeof(m_nonces) );
+	memset( m_commandClasses, 0, sizeof(m_commandClasses) );
 	AddCommandClass( 0 );
 }
 
+//-----------------------------------------------------------------------------
+// <Node::operator new>
+// Allocate a node from the pool
+//-----------------------------------------------------------------------------
+void* Node::operator new
+(
+		size_t _size
+)
+{
+	return s_nodePool.Allocate( _size );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::operator delete>
+// Return a node to the pool
+//-----------------------------------------------------------------------------
+void Node::operator delete
+(
+		void* _ptr,
+		size_t _size
+)
+{
+	s_nodePool.Free( _ptr, _size );
+}
+
 //-----------------------------------------------------------------------------
 // <Node::~Node>
 // Destructor
@@ -189,16 +249,22 @@ Node::~Node
 (
 )
 {
-	// Remove any messages from queues
-	GetDriver()->RemoveQueues( m_nodeId );
-
-	// Remove the values from the poll list
-	for( ValueStore::Iterator it = m_values->Begin(); it != m_values->End(); ++it )
+	// A driver being torn down frees its queues, poll list and routes itself
+	if( !GetDriver()->m_tearingDown )
 	{
-		ValueID const& valueId = it->second->GetID();
-		if( GetDriver()->isPolled( valueId ) )
+		// Remove any messages from queues
+		GetDriver()->RemoveQueues( m_nodeId );
+		GetDriver()->InvalidateSendRoute( m_nodeId );
+		GetDriver()->ResetNodeCounters( m_nodeId );
+
+		// Remove the values from the poll list
+		for( ValueStore::Iterator it = m_values->Begin(); it != m_values->End(); ++it )
 		{
-			GetDriver()->DisablePoll( valueId );
+			ValueID const& valueId = it->second->GetID();
+			if( GetDriver()->isPolled( valueId ) )
+			{
+				GetDriver()->DisablePoll( valueId );
+			}
 		}
 	}
 
@@ -211,6 +277,7 @@ Node::~Node
 	while( !m_commandClassMap.empty() )
 	{
 		map<uint8,CommandClass*>::iterator it = m_commandClassMap.begin();
+		m_commandClasses[it->first] = NULL;
 		delete it->second;
 		m_commandClassMap.erase( it );
 	}
@@ -224,11 +291,10 @@ Node::~Node
 	}
 
 	// Delete the button map
-	while( !m_buttonMap.empty() )
-	{
-		map<uint8,uint8>::iterator it = m_buttonMap.begin();
-		m_buttonMap.erase( it );
-	}
+	m_buttonMap.clear();
+	m_virtualNodeButtons.clear();
+
+	m_mutex->Release();
 }
 
 //-----------------------------------------------------------------------------
@@ -253,9 +319,16 @@ void Node::AdvanceQueries
 	// each stage is only visited once.
 
 	Log::Write( LogLevel_Detail, m_nodeId, "AdvanceQueries queryPending=%d queryRetries=%d queryStage=%s live=%d", m_queryPending, m_queryRetries, c_queryStageNames[m_queryStage], m_nodeAlive );
+	if( !GetDriver()->StartInterview( this ) )
+	{
+		// Too many other nodes are being queried.  The driver calls us again when one of them is done.
+		return;
+	}
+
 	bool addQSC = false;			// We only want to add a query stage complete if we did some work.
 	while( !m_queryPending && m_nodeAlive )
 	{
+		TimeQueryStage();
 		switch( m_queryStage )
 		{
 			case QueryStage_None:
@@ -365,6 +438,7 @@ void Node::AdvanceQueries
 					ManufacturerSpecific* cc = static_cast<ManufacturerSpecific*>( GetCommandClass( ManufacturerSpecific::StaticGetCommandClassId() ) );
 					if( cc  )
 					{
+						CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_RequestState );
 						m_queryPending = cc->RequestState( CommandClass::RequestFlag_Static, 1, Driver::MsgQueue_Query );
 						addQSC = m_queryPending;
 					}
@@ -398,11 +472,29 @@ void Node::AdvanceQueries
 			}
 			case QueryStage_NodePlusInfo:
 			{
+				// If the node identifies itself and its command classes exactly as it did
+				// when it was last interviewed, the static data we already hold is still
+				// good, so go straight on to the stages that have to be refreshed.
+				bool skipStatic = false;
+				Options::Get()->GetOptionAsBool( "SkipMatchingInterviews", &skipStatic );
+				if( skipStatic && !m_interviewFingerprint.empty() && ( m_interviewFingerprint == GetInterviewFingerprint() ) )
+				{
+					Log::Write( LogLevel_Info, m_nodeId, "Node matches its interview fingerprint, skipping the static queries" );
+					m_queryStage = QueryStage_Associations;
+					m_queryRetries = 0;
+
+					Notification* notification = new Notification( Notification::Type_EssentialNodeQueriesComplete );
+					notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
+					GetDriver()->QueueNotification( notification );
+					break;
+				}
+
 				Log::Write( LogLevel_Detail, m_nodeId, "QueryStage_NodePlusInfo" );
 				ZWavePlusInfo* pluscc = static_cast<ZWavePlusInfo*>( GetCommandClass( ZWavePlusInfo::StaticGetCommandClassId() ) );
 
 				if ( pluscc )
 				{
+					CommandClassProfile::Timer timer( pluscc->GetCommandClassId(), CommandClassProfile::Operation_RequestState );
 					m_queryPending = pluscc->RequestState( CommandClass::RequestFlag_Static, 1, Driver::MsgQueue_Query );
 				}
 				if (m_queryPending)
@@ -427,7 +519,13 @@ void Node::AdvanceQueries
 
 				Security* seccc = static_cast<Security*>( GetCommandClass( Security::StaticGetCommandClassId() ) );
 
-				if( seccc )
+				if( seccc && ReplaySecuredClasses() )
+				{
+					// Another node of the same product has reported its secured classes already
+					m_queryStage = QueryStage_ManufacturerSpecific2;
+					m_queryRetries = 0;
+				}
+				else if( seccc )
 				{
 					// start the process setting up the Security CommandClass
 					m_queryPending = seccc->Init();
@@ -457,6 +555,7 @@ void Node::AdvanceQueries
 					ManufacturerSpecific* cc = static_cast<ManufacturerSpecific*>( GetCommandClass( ManufacturerSpecific::StaticGetCommandClassId() ) );
 					if( cc  )
 					{
+						CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_RequestState );
 						m_queryPending = cc->RequestState( CommandClass::RequestFlag_Static, 1, Driver::MsgQueue_Query );
 						addQSC = m_queryPending;
 					}
@@ -482,6 +581,28 @@ void Node::AdvanceQueries
 			{
 				// Get the version information (if the device supports COMMAND_CLASS_VERSION
 				Log::Write( LogLevel_Detail, m_nodeId, "QueryStage_Versions" );
+				if( GetDriver()->ApplyProvisionedProduct( this ) )
+				{
+					// The command classes, and the static values with them, came from the
+					// product's template, so go straight on to the stages that have to be done
+					m_queryStage = QueryStage_Associations;
+					m_queryRetries = 0;
+
+					m_interviewFingerprint = GetInterviewFingerprint();
+					GetDriver()->SetConfigDirty( m_nodeId );
+
+					Notification* notification = new Notification( Notification::Type_EssentialNodeQueriesComplete );
+					notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
+					GetDriver()->QueueNotification( notification );
+					break;
+				}
+				if( ReplayProductDiscovery() )
+				{
+					// Another node of the same product has answered these queries already
+					m_queryStage = QueryStage_Instances;
+					m_queryRetries = 0;
+					break;
+				}
 				Version* vcc = static_cast<Version*>( GetCommandClass( Version::StaticGetCommandClassId() ) );
 				if( vcc )
 				{
@@ -514,7 +635,7 @@ void Node::AdvanceQueries
 				// if the device at this node supports multiple instances, obtain a list of these instances
 				Log::Write( LogLevel_Detail, m_nodeId, "QueryStage_Instances" );
 				MultiInstance* micc = static_cast<MultiInstance*>( GetCommandClass( MultiInstance::StaticGetCommandClassId() ) );
-				if( micc )
+				if( micc && !m_discoveryReplayed )
 				{
 					m_queryPending = micc->RequestInstances();
 					addQSC = m_queryPending;
@@ -526,6 +647,10 @@ void Node::AdvanceQueries
 					m_queryStage = QueryStage_Static;
 					m_queryRetries = 0;
 
+					// Remember what the node looked like, so the next interview can be skipped if it has not changed
+					m_interviewFingerprint = GetInterviewFingerprint();
+					GetDriver()->SetConfigDirty( m_nodeId );
+
 					Log::Write( LogLevel_Info, m_nodeId, "Essential node queries are complete" );
 					Notification* notification = new Notification( Notification::Type_EssentialNodeQueriesComplete );
 					notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
@@ -683,6 +808,12 @@ void Node::AdvanceQueries
 			case QueryStage_Complete:
 			{
 				ClearAddingNode();
+				// Basic reports go straight to the class they are mapped to from now on
+				if( Basic* basic = static_cast<Basic*>( GetCommandClass( Basic::StaticGetCommandClassId() ) ) )
+				{
+					basic->ResolveMapping();
+				}
+
 				// Notify the watchers that the queries are complete for this node
 				Log::Write( LogLevel_Detail, m_nodeId, "QueryStage_Complete" );
 				Notification* notification = new Notification( Notification::Type_NodeQueriesComplete );
@@ -695,6 +826,9 @@ void Node::AdvanceQueries
 				{
 					cc->SendPending();
 				}
+				// Let the next waiting node be queried
+				GetDriver()->EndInterview( m_nodeId );
+
 				// Check whether all nodes are now complete
 				GetDriver()->CheckCompletedNodeQueries();
 				return;
@@ -739,6 +873,8 @@ void Node::QueryStageComplete
 			m_queryStage = (QueryStage)( (uint32)m_queryStage + 1 );
 		}
 		m_queryRetries = 0;
+		GetDriver()->SetConfigDirty( m_nodeId );
+		TimeQueryStage();
 	}
 }
 
@@ -761,6 +897,10 @@ void Node::QueryStageRetry
 	}
 
 	m_queryPending = false;
+	if( m_queryStage < QueryStage_Complete )
+	{
+		++m_stageData[m_queryStage].m_retries;
+	}
 	if( _maxAttempts && ( ++m_queryRetries >= _maxAttempts ) )
 	{
 		m_queryRetries = 0;
@@ -769,6 +909,8 @@ void Node::QueryStageRetry
 		if( m_queryStage != QueryStage_Probe && m_queryStage != QueryStage_CacheLoad )
 		{
 			m_queryStage = (Node::QueryStage)( (uint32)(m_queryStage + 1) );
+			GetDriver()->SetConfigDirty( m_nodeId );
+			TimeQueryStage();
 		}
 	}
 	// Repeat the current query stage
@@ -787,8 +929,17 @@ void Node::SetQueryStage
 {
 	if( (int)_stage < (int)m_queryStage )
 	{
+		// Basic reports are not passed on to the mapped class until the
+		// interview is complete again
+		if( Basic* basic = static_cast<Basic*>( GetCommandClass( Basic::StaticGetCommandClassId() ) ) )
+		{
+			basic->ClearResolvedMapping();
+		}
+
 		m_queryStage = _stage;
 		m_queryPending = false;
+		GetDriver()->SetConfigDirty( m_nodeId );
+		TimeQueryStage();
 
 		if( QueryStage_Configuration == _stage )
 		{
@@ -802,62 +953,113 @@ void Node::SetQueryStage
 }
 
 //-----------------------------------------------------------------------------
-// <Node::GetQueryStageName>
-// Gets the query stage name
+// <Node::TimeQueryStage>
+// Record how long the stage just left took, and start timing the current one.
+// Going back to an earlier stage starts the timings from there again.
 //-----------------------------------------------------------------------------
-string Node::GetQueryStageName
+void Node::TimeQueryStage
 (
-		QueryStage const _stage
 )
 {
-	return c_queryStageNames[_stage];
+	if( m_queryStage == m_timedStage )
+	{
+		return;
+	}
+
+	if( m_timedStage < QueryStage_Complete && m_stageData[m_timedStage].m_visited )
+	{
+		m_stageData[m_timedStage].m_elapsed = (uint32)( -m_stageStart.TimeRemaining() );
+
+		Notification* notification = new Notification( Notification::Type_NodeQueryStage );
+		notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
+		notification->SetQueryStage( (uint8)m_timedStage );
+		GetDriver()->QueueNotification( notification );
+	}
+
+	if( m_queryStage < m_timedStage || m_timedStage == QueryStage_None )
+	{
+		// A new interview, or some of the stages are being queried again
+		for( uint32 i = m_queryStage; i < QueryStage_Complete; ++i )
+		{
+			m_stageData[i].m_elapsed = 0;
+			m_stageData[i].m_retries = 0;
+			m_stageData[i].m_visited = false;
+		}
+		m_interviewStart.SetTime();
+		m_interviewElapsed = 0;
+	}
+
+	m_timedStage = m_queryStage;
+	if( m_queryStage == QueryStage_Complete )
+	{
+		m_interviewElapsed = (uint32)( -m_interviewStart.TimeRemaining() );
+
+		uint32 slowest = QueryStage_None;
+		for( uint32 i = 0; i < QueryStage_Complete; ++i )
+		{
+			if( m_stageData[i].m_elapsed > m_stageData[slowest].m_elapsed )
+			{
+				slowest = i;
+			}
+		}
+		Log::Write( LogLevel_Info, m_nodeId, "Interview took %dms, longest stage %s %dms", m_interviewElapsed, c_queryStageNames[slowest], m_stageData[slowest].m_elapsed );
+		return;
+	}
+
+	m_stageData[m_queryStage].m_visited = true;
+	m_stageStart.SetTime();
 }
 
 //-----------------------------------------------------------------------------
-// <Node::GetNeighbors>
-// Gets the neighbors of a node
+// <Node::SetQueryPriority>
+// Set how urgently the node is queried
 //-----------------------------------------------------------------------------
-uint32 Node::GetNeighbors
+void Node::SetQueryPriority
 (
-		uint8** o_neighbors
+		QueryPriority const _priority
 )
 {
-	// determine how many neighbors there are
-	int i;
-	uint32 numNeighbors = 0;
-	if( m_queryStage < QueryStage_Session )
-	{
-		*o_neighbors = NULL;
-		return 0;
-	}
-	for( i = 0; i < 29; i++ )
+	m_queryPriority = _priority;
+	m_queryPrioritySet = true;
+	GetDriver()->InvalidateSendRoute( m_nodeId );
+	GetDriver()->SetConfigDirty( m_nodeId );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::GetQueryPriority>
+// Returns how urgently the node is queried
+//-----------------------------------------------------------------------------
+Node::QueryPriority Node::GetQueryPriority
+(
+)const
+{
+	if( m_queryPrioritySet )
 	{
-		for( unsigned char mask = 0x80; mask != 0; mask >>= 1 )
-			if( ( m_neighbors[i] & mask ) != 0 )
-				numNeighbors++;
+		return m_queryPriority;
 	}
 
-	// handle the possibility that no neighbors are reported
-	if( !numNeighbors )
+	// Entry Control and Thermostat devices are the ones users wait on
+	if( m_generic == 0x40 || m_generic == 0x08 )
 	{
-		*o_neighbors = NULL;
-		return 0;
+		return QueryPriority_High;
 	}
-
-	// create and populate an array with neighbor node ids
-	uint8* neighbors = new uint8[numNeighbors];
-	uint32 index = 0;
-	for( int by=0; by<29; by++ )
+	if( !m_listening )
 	{
-		for( int bi=0; bi<8; bi++ )
-		{
-			if( (m_neighbors[by] & ( 0x01<<bi ) ) )
-				neighbors[index++] = ( ( by<<3 ) + bi + 1 );
-		}
+		return QueryPriority_Low;
 	}
+	return QueryPriority_Normal;
+}
 
-	*o_neighbors = neighbors;
-	return numNeighbors;
+//-----------------------------------------------------------------------------
+// <Node::GetQueryStageName>
+// Gets the query stage name
+//-----------------------------------------------------------------------------
+string Node::GetQueryStageName
+(
+		QueryStage const _stage
+)
+{
+	return c_queryStageNames[_stage];
 }
 
 //-----------------------------------------------------------------------------
@@ -1044,6 +1246,18 @@ void Node::ReadXML
 	if ( str )
 		m_refreshonNodeInfoFrame = !strcmp (str, "true" );
 
+	str = _node->Attribute( "fingerprint" );
+	if( str )
+	{
+		m_interviewFingerprint = str;
+	}
+
+	if( TIXML_SUCCESS == _node->QueryIntAttribute( "query_priority", &intVal ) && intVal >= QueryPriority_High && intVal <= QueryPriority_Low )
+	{
+		m_queryPriority = (QueryPriority)intVal;
+		m_queryPrioritySet = true;
+	}
+
 	// Read the manufacturer info and create the command classes
 	TiXmlElement const* child = _node->FirstChildElement();
 	while( child )
@@ -1055,6 +1269,10 @@ void Node::ReadXML
 			{
 				ReadCommandClassesXML( child );
 			}
+			else if( !strcmp( str, "Buttons" ) )
+			{
+				ReadButtonsXML( child );
+			}
 			else if( !strcmp( str, "Manufacturer" ) )
 			{
 				str = child->Attribute( "id" );
@@ -1164,12 +1382,20 @@ void Node::ReadDeviceProtocolXML
 //-----------------------------------------------------------------------------
 void Node::ReadCommandClassesXML
 (
-		TiXmlElement const* _ccsElement
+		TiXmlElement const* _ccsElement,
+		bool const _deferConfigParams	// = false
 )
 {
 	char const* str;
 	int32 intVal;
 
+	// Parameters already set aside belong to the file being read again
+	m_deferConfigParams = _deferConfigParams;
+	if( _deferConfigParams )
+	{
+		m_pendingConfigParams.clear();
+	}
+
 	TiXmlElement const* ccElement = _ccsElement->FirstChildElement();
 	while( ccElement )
 	{
@@ -1205,6 +1431,23 @@ void Node::ReadCommandClassesXML
 							continue;
 						}
 
+						// A class the node only controls, saved with nothing but its version, can wait
+						if( IsBareAfterMark( ccElement ) )
+						{
+							bool inNIF = false;
+							if( char const* innif = ccElement->Attribute( "innif" ) )
+							{
+								inNIF = !strcmp( innif, "true" );
+							}
+							int32 version = 1;
+							ccElement->QueryIntAttribute( "version", &version );
+							if( DeferCommandClass( id, (uint8)version, inNIF ) )
+							{
+								ccElement = ccElement->NextSiblingElement();
+								continue;
+							}
+						}
+
 						// Command class support does not exist yet, so we create it
 						cc = AddCommandClass( id );
 					}
@@ -1219,6 +1462,8 @@ void Node::ReadCommandClassesXML
 
 		ccElement = ccElement->NextSiblingElement();
 	}
+
+	m_deferConfigParams = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -1298,6 +1543,17 @@ void Node::WriteXML
 
 	nodeElement->SetAttribute( "query_stage", c_queryStageNames[m_queryStage] );
 
+	if( !m_interviewFingerprint.empty() )
+	{
+		nodeElement->SetAttribute( "fingerprint", m_interviewFingerprint.c_str() );
+	}
+
+	if( m_queryPrioritySet )
+	{
+		snprintf( str, 32, "%d", m_queryPriority );
+		nodeElement->SetAttribute( "query_priority", str );
+	}
+
 	// Write the manufacturer and product data in the same format
 	// as used in the ManyfacturerSpecfic.xml file.  This will
 	// allow new devices to be added via a simple cut and paste.
@@ -1330,20 +1586,195 @@ void Node::WriteXML
 	}
 	productElement->SetAttribute( "name", m_productName.c_str() );
 
-	// Write the command classes
-	TiXmlElement* ccsElement = new TiXmlElement( "CommandClasses" );
-	nodeElement->LinkEndChild( ccsElement );
+	WriteCommandClassesXML( nodeElement );
 
-	for( map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin(); it != m_commandClassMap.end(); ++it )
+	// Once the buttons are kept here, the element is written even when there are
+	// none, so that zwbutton.xml is not read for them again
+	if( m_buttonsInConfig )
+	{
+		TiXmlElement* buttonsElement = new TiXmlElement( "Buttons" );
+		nodeElement->LinkEndChild( buttonsElement );
+		for( map<uint8,uint8>::const_iterator it = m_buttonMap.begin(); it != m_buttonMap.end(); ++it )
+		{
+			TiXmlElement* buttonElement = new TiXmlElement( "Button" );
+			buttonsElement->LinkEndChild( buttonElement );
+
+			snprintf( str, sizeof(str), "%d", it->first );
+			buttonElement->SetAttribute( "id", str );
+
+			snprintf( str, sizeof(str), "%d", it->second );
+			buttonElement->LinkEndChild( new TiXmlText( str ) );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::ReadButtonsXML>
+// Read the buttons saved with the node, as zwbutton.xml used to hold them
+//-----------------------------------------------------------------------------
+void Node::ReadButtonsXML
+(
+		TiXmlElement const* _buttonsElement
+)
+{
+	m_buttonsInConfig = true;
+	TiXmlElement const* buttonElement = _buttonsElement->FirstChildElement( "Button" );
+	for( ; buttonElement; buttonElement = buttonElement->NextSiblingElement( "Button" ) )
 	{
-		if( it->second->GetCommandClassId() == NoOperation::StaticGetCommandClassId() ) // don't output NoOperation
+		int buttonId;
+		char const* str = buttonElement->GetText();
+		if( TIXML_SUCCESS != buttonElement->QueryIntAttribute( "id", &buttonId ) || !str )
 		{
+			Log::Write( LogLevel_Warning, m_nodeId, "WARNING: A saved button has no ID or virtual node" );
 			continue;
 		}
-		TiXmlElement* ccElement = new TiXmlElement( "CommandClass" );
-		ccsElement->LinkEndChild( ccElement );
-		it->second->WriteXML( ccElement );
+		uint8 virtualNodeId = (uint8)strtol( str, NULL, 0 );
+		m_buttonMap[(uint8)buttonId] = virtualNodeId;
+		m_virtualNodeButtons[virtualNodeId] = (uint8)buttonId;
+
+		Notification* notification = new Notification( Notification::Type_CreateButton );
+		notification->SetHomeAndNodeIds( m_homeId, virtualNodeId );
+		notification->SetButtonId( (uint8)buttonId );
+		GetDriver()->QueueNotification( notification );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::SetButton>
+// Serve a button from a virtual node
+//-----------------------------------------------------------------------------
+void Node::SetButton
+(
+		uint8 const _buttonId,
+		uint8 const _virtualNodeId
+)
+{
+	map<uint8,uint8>::iterator it = m_buttonMap.find( _buttonId );
+	if( it != m_buttonMap.end() )
+	{
+		m_virtualNodeButtons.erase( it->second );
+	}
+	m_buttonMap[_buttonId] = _virtualNodeId;
+	m_virtualNodeButtons[_virtualNodeId] = _buttonId;
+	m_buttonsInConfig = true;
+	GetDriver()->SetConfigDirty( m_nodeId );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::RemoveButton>
+// Stop serving a button
+//-----------------------------------------------------------------------------
+void Node::RemoveButton
+(
+		uint8 const _buttonId
+)
+{
+	map<uint8,uint8>::iterator it = m_buttonMap.find( _buttonId );
+	if( it != m_buttonMap.end() )
+	{
+		map<uint8,uint8>::iterator vit = m_virtualNodeButtons.find( it->second );
+		if( vit != m_virtualNodeButtons.end() && vit->second == _buttonId )
+		{
+			m_virtualNodeButtons.erase( vit );
+		}
+		m_buttonMap.erase( it );
+		m_buttonsInConfig = true;
+		GetDriver()->SetConfigDirty( m_nodeId );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::GetVirtualNodeButton>
+// Find the button that a virtual node serves
+//-----------------------------------------------------------------------------
+bool Node::GetVirtualNodeButton
+(
+		uint8 const _virtualNodeId,
+		uint8* o_buttonId
+)const
+{
+	map<uint8,uint8>::const_iterator it = m_virtualNodeButtons.find( _virtualNodeId );
+	if( it == m_virtualNodeButtons.end() )
+	{
+		return false;
+	}
+	*o_buttonId = it->second;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::WriteCommandClassesXML>
+// Save the command classes of the node, as ReadCommandClassesXML reads them
+//-----------------------------------------------------------------------------
+void Node::WriteCommandClassesXML
+(
+		TiXmlElement* _nodeElement
+)
+{
+	TiXmlElement* ccsElement = new TiXmlElement( "CommandClasses" );
+	_nodeElement->LinkEndChild( ccsElement );
+
+	// The classes with objects and those the node only controls, in id order
+	map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin();
+	map<uint8,ControlledClass>::const_iterator cit = m_controlledClasses.begin();
+	while( it != m_commandClassMap.end() || cit != m_controlledClasses.end() )
+	{
+		if( cit == m_controlledClasses.end() || ( it != m_commandClassMap.end() && it->first < cit->first ) )
+		{
+			if( it->second->GetCommandClassId() != NoOperation::StaticGetCommandClassId() ) // don't output NoOperation
+			{
+				TiXmlElement* ccElement = new TiXmlElement( "CommandClass" );
+				ccsElement->LinkEndChild( ccElement );
+				it->second->WriteXML( ccElement );
+			}
+			++it;
+		}
+		else
+		{
+			// Written as CommandClass::WriteXML would write the class
+			char str[16];
+			TiXmlElement* ccElement = new TiXmlElement( "CommandClass" );
+			ccsElement->LinkEndChild( ccElement );
+			snprintf( str, sizeof(str), "%d", cit->first );
+			ccElement->SetAttribute( "id", str );
+			ccElement->SetAttribute( "name", CommandClasses::GetName( cit->first ).c_str() );
+			snprintf( str, sizeof(str), "%d", cit->second.m_version );
+			ccElement->SetAttribute( "version", str );
+			ccElement->SetAttribute( "after_mark", "true" );
+			if( cit->second.m_inNIF )
+			{
+				ccElement->SetAttribute( "innif", "true" );
+			}
+			++cit;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::IsBareAfterMark>
+// Check whether a saved class is one the node only controls, with nothing
+// saved but what DeferCommandClass keeps
+//-----------------------------------------------------------------------------
+bool Node::IsBareAfterMark
+(
+		TiXmlElement const* _ccElement
+)
+{
+	char const* afterMark = _ccElement->Attribute( "after_mark" );
+	if( !afterMark || strcmp( afterMark, "true" ) || _ccElement->FirstChild() )
+	{
+		return false;
+	}
+
+	for( TiXmlAttribute const* attribute = _ccElement->FirstAttribute(); attribute; attribute = attribute->Next() )
+	{
+		char const* name = attribute->Name();
+		if( strcmp( name, "id" ) && strcmp( name, "name" ) && strcmp( name, "version" ) && strcmp( name, "after_mark" ) && strcmp( name, "innif" ) )
+		{
+			return false;
+		}
 	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1424,7 +1855,7 @@ void Node::UpdateProtocolInfo
 		// Set up the device class based data for the node, including mandatory command classes
 		SetDeviceClasses( _data[3], _data[4], _data[5] );
 		// Do this for every controller. A little extra work but it won't be a large file.
-		if( IsController() )
+		if( IsController() && !m_buttonsInConfig )
 		{
 			GetDriver()->ReadButtons( m_nodeId );
 		}
@@ -1446,6 +1877,7 @@ void Node::UpdateProtocolInfo
 		}
 
 	}
+	GetDriver()->InvalidateSendRoute( m_nodeId );
 	m_protocolInfoReceived = true;
 }
 
@@ -1621,6 +2053,8 @@ void Node::SetSecuredClasses
 			Log::Write( LogLevel_Info, m_nodeId, "    %s (Unsecured) - %s", it->second->GetCommandClassName().c_str(), it->second->IsInNIF() ? "InNIF" : "NotInNIF" );
 	}
 
+	// Messages for the secured classes now have to be encrypted
+	GetDriver()->InvalidateSendRoute( m_nodeId );
 
 }
 //-----------------------------------------------------------------------------
@@ -1667,6 +2101,13 @@ void Node::UpdateNodeInfo
 					Log::Write (LogLevel_Info, m_nodeId, "    %s (Disabled - Network Key Not Set)", Security::StaticGetCommandClassName().c_str());
 					continue;
 				}
+				// A class the node only controls needs no object until a frame for it arrives
+				if( afterMark && DeferCommandClass( _data[i], 1, true ) )
+				{
+					newCommandClasses = true;
+					Log::Write( LogLevel_Info, m_nodeId, "    %s", CommandClasses::GetName( _data[i] ).c_str() );
+					continue;
+				}
 				if( CommandClass* pCommandClass = AddCommandClass( _data[i] ) )
 				{
 					/* this CC was in the NIF frame */
@@ -1734,6 +2175,7 @@ void Node::SetNodeAlive
 		Log::Write( LogLevel_Error, m_nodeId, "WARNING: node revived" );
 		m_nodeAlive = true;
 		m_errors = 0;
+		GetDriver()->CloseCircuit( m_nodeId );
 		if( m_queryStage != Node::QueryStage_Complete )
 		{
 			m_queryRetries = 0; // restart at last stage
@@ -1747,8 +2189,12 @@ void Node::SetNodeAlive
 	{
 		Log::Write( LogLevel_Error, m_nodeId, "ERROR: node presumed dead" );
 		m_nodeAlive = false;
+		GetDriver()->OpenCircuit( m_nodeId );
 		if( m_queryStage != Node::QueryStage_Complete )
 		{
+			// Let another node be queried until this one revives
+			GetDriver()->PauseInterview( m_nodeId );
+
 			// Check whether all nodes are now complete
 			GetDriver()->CheckCompletedNodeQueries();
 		}
@@ -1794,37 +2240,324 @@ void Node::SetStaticRequests
 }
 
 //-----------------------------------------------------------------------------
-// <Node::SetNodeName>
-// Set the name of the node
+// <Node::GetInterviewFingerprint>
+// Build the fingerprint of the node's static interview
 //-----------------------------------------------------------------------------
-void Node::SetNodeName
+string Node::GetInterviewFingerprint
 (
-		string const& _nodeName
 )
 {
-	m_nodeName = _nodeName;
-	// Notify the watchers of the name changes
-	Notification* notification = new Notification( Notification::Type_NodeNaming );
-	notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
-	GetDriver()->QueueNotification( notification );
-	if( NodeNaming* cc = static_cast<NodeNaming*>( GetCommandClass( NodeNaming::StaticGetCommandClassId() ) ) )
+	char str[32];
+	snprintf( str, sizeof(str), "%.4x:%.4x:%.4x", m_manufacturerId, m_productType, m_productId );
+	string fingerprint = str;
+
+	map<uint8,uint8> versions;
+	GetNIFClasses( &versions );
+	for( map<uint8,uint8>::const_iterator it = versions.begin(); it != versions.end(); ++it )
 	{
-		// The node supports naming, so we try to write the name into the device
-		cc->SetName( _nodeName );
+		snprintf( str, sizeof(str), ",%.2x.%d", it->first, it->second );
+		fingerprint += str;
 	}
+	return fingerprint;
 }
 
 //-----------------------------------------------------------------------------
-// <Node::SetLocation>
-// Set the location of the node
+// <Node::GetProductKey>
+// Build the key under which the node's product discovery is shared
 //-----------------------------------------------------------------------------
-void Node::SetLocation
+string Node::GetProductKey
 (
-		string const& _location
 )
 {
-	m_location = _location;
-	// Notify the watchers of the name changes
+	char str[32];
+	snprintf( str, sizeof(str), "%.4x:%.4x:%.4x", m_manufacturerId, m_productType, m_productId );
+	string key = str;
+
+	map<uint8,uint8> versions;
+	GetNIFClasses( &versions );
+	for( map<uint8,uint8>::const_iterator it = versions.begin(); it != versions.end(); ++it )
+	{
+		snprintf( str, sizeof(str), ",%.2x", it->first );
+		key += str;
+	}
+	return key;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::GetNIFClasses>
+// Collect the classes in the node info frame, whether or not they have
+// objects, with their versions
+//-----------------------------------------------------------------------------
+void Node::GetNIFClasses
+(
+		map<uint8,uint8>* o_versions
+)
+{
+	for( map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin(); it != m_commandClassMap.end(); ++it )
+	{
+		if( it->second->IsInNIF() )
+		{
+			(*o_versions)[it->first] = it->second->GetVersion();
+		}
+	}
+	for( map<uint8,ControlledClass>::const_iterator it = m_controlledClasses.begin(); it != m_controlledClasses.end(); ++it )
+	{
+		if( it->second.m_inNIF )
+		{
+			(*o_versions)[it->first] = it->second.m_version;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::ReplayProductDiscovery>
+// Hand the node the Version and MultiInstance reports recorded from the first
+// node of its product, in place of asking it for them.  The first node of a
+// product records its reports instead.
+//-----------------------------------------------------------------------------
+bool Node::ReplayProductDiscovery
+(
+)
+{
+	m_recordingDiscovery = false;
+	m_discoveryReplayed = false;
+	m_discoveryReports.clear();
+
+	bool useCache = false;
+	Options::Get()->GetOptionAsBool( "ProductDiscoveryCache", &useCache );
+
+	// Without the node's ids, or its application version to check them by, the products cannot be told apart
+	if( !useCache || !m_manufacturerSpecificClassReceived || !GetCommandClass( Version::StaticGetCommandClassId() ) )
+	{
+		return false;
+	}
+
+	m_productKey = GetProductKey();
+	map<string,Driver::ProductDiscovery>::const_iterator it = GetDriver()->m_productDiscovery.find( m_productKey );
+	if( it == GetDriver()->m_productDiscovery.end() )
+	{
+		m_recordingDiscovery = true;
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, m_nodeId, "Using the versions and endpoints found for product %s", m_productKey.c_str() );
+	m_replayingDiscovery = true;
+	for( list< vector<uint8> >::const_iterator rit = it->second.m_reports.begin(); rit != it->second.m_reports.end(); ++rit )
+	{
+		vector<uint8> const& report = *rit;
+		if( CommandClass* cc = GetCommandClass( report[0] ) )
+		{
+			CommandClassProfile::Timer timer( report[0], CommandClassProfile::Operation_HandleMsg );
+			cc->HandleMsg( &report[1], (uint32)report.size() - 1 );
+		}
+	}
+	m_replayingDiscovery = false;
+	m_discoveryReplayed = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::RecordDiscoveryReport>
+// Keep a Version or MultiInstance report for later nodes of the same product
+//-----------------------------------------------------------------------------
+void Node::RecordDiscoveryReport
+(
+	uint8 const _commandClassId,
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	if( m_recordingDiscovery )
+	{
+		vector<uint8> report( 1, _commandClassId );
+		report.insert( report.end(), _data, _data + _length );
+		m_discoveryReports.push_back( report );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::ProductVersionReported>
+// The Version report arrives once the discovery reports have, so the
+// recorded reports can be shared from here.  A node that was given another
+// node's reports is asked for its own if its application version differs.
+//-----------------------------------------------------------------------------
+void Node::ProductVersionReported
+(
+	string const& _applicationVersion
+)
+{
+	// The secured classes recorded for the product belong to this application version
+	map<string,Driver::ProductDiscovery>::iterator sit = GetDriver()->m_productSecurity.find( m_securityKey );
+	if( !m_securityKey.empty() && sit != GetDriver()->m_productSecurity.end() )
+	{
+		if( sit->second.m_applicationVersion.empty() )
+		{
+			sit->second.m_applicationVersion = _applicationVersion;
+		}
+		else if( m_securityReplayed && sit->second.m_applicationVersion != _applicationVersion )
+		{
+			Log::Write( LogLevel_Info, m_nodeId, "Application version %s differs from the %s recorded for product %s, so asking for the secured command classes", _applicationVersion.c_str(), sit->second.m_applicationVersion.c_str(), m_securityKey.c_str() );
+			VerifySecuredClasses();
+		}
+	}
+
+	if( m_recordingDiscovery )
+	{
+		m_recordingDiscovery = false;
+		Driver::ProductDiscovery& discovery = GetDriver()->m_productDiscovery[m_productKey];
+		discovery.m_applicationVersion = _applicationVersion;
+		discovery.m_reports.swap( m_discoveryReports );
+		m_discoveryReports.clear();
+		Log::Write( LogLevel_Info, m_nodeId, "Recorded the versions and endpoints of product %s, application version %s", m_productKey.c_str(), _applicationVersion.c_str() );
+		return;
+	}
+
+	if( !m_discoveryReplayed )
+	{
+		return;
+	}
+	m_discoveryReplayed = false;
+
+	bool verify = true;
+	Options::Get()->GetOptionAsBool( "ProductDiscoveryVerify", &verify );
+	map<string,Driver::ProductDiscovery>::iterator it = GetDriver()->m_productDiscovery.find( m_productKey );
+	if( !verify || it == GetDriver()->m_productDiscovery.end() || it->second.m_applicationVersion == _applicationVersion )
+	{
+		return;
+	}
+
+	Log::Write( LogLevel_Info, m_nodeId, "Application version %s differs from the %s recorded for product %s, so querying the versions and endpoints again", _applicationVersion.c_str(), it->second.m_applicationVersion.c_str(), m_productKey.c_str() );
+	GetDriver()->m_productDiscovery.erase( it );
+
+	SetStaticRequests();
+	if( Version* vcc = static_cast<Version*>( GetCommandClass( Version::StaticGetCommandClassId() ) ) )
+	{
+		// Ask for the version report again, so the new recording can be kept
+		vcc->SetStaticRequest( CommandClass::StaticRequest_Values );
+	}
+	if( MultiInstance* micc = static_cast<MultiInstance*>( GetCommandClass( MultiInstance::StaticGetCommandClassId() ) ) )
+	{
+		micc->ResetEndPoints();
+	}
+	SetQueryStage( QueryStage_Versions );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::ReplaySecuredClasses>
+// Hand the node the SecurityCmd_SupportedReport recorded from the first node
+// of its product, in place of the encrypted exchange that would get its own.
+// The first node of a product records its report instead.
+//-----------------------------------------------------------------------------
+bool Node::ReplaySecuredClasses
+(
+)
+{
+	m_recordingSecurity = false;
+	m_securityReplayed = false;
+
+	bool useCache = false;
+	Options::Get()->GetOptionAsBool( "ProductSecurityCache", &useCache );
+	Security* seccc = static_cast<Security*>( GetCommandClass( Security::StaticGetCommandClassId() ) );
+	if( !useCache || !m_manufacturerSpecificClassReceived || !seccc )
+	{
+		return false;
+	}
+
+	m_securityKey = GetProductKey();
+	map<string,Driver::ProductDiscovery>::const_iterator it = GetDriver()->m_productSecurity.find( m_securityKey );
+	if( it == GetDriver()->m_productSecurity.end() || it->second.m_reports.empty() )
+	{
+		m_recordingSecurity = true;
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, m_nodeId, "Using the secured command classes found for product %s", m_securityKey.c_str() );
+	vector<uint8> report = it->second.m_reports.front();
+	CommandClassProfile::Timer timer( seccc->GetCommandClassId(), CommandClassProfile::Operation_HandleMsg );
+	seccc->HandleMsg( &report[0], (uint32)report.size() );
+	m_securityReplayed = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::RecordSecuredClasses>
+// Keep a SecurityCmd_SupportedReport for later nodes of the same product
+//-----------------------------------------------------------------------------
+void Node::RecordSecuredClasses
+(
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	if( !m_recordingSecurity )
+	{
+		return;
+	}
+	m_recordingSecurity = false;
+
+	// A list split over several reports is not kept
+	if( _length < 2 || _data[1] != 0 )
+	{
+		return;
+	}
+
+	Driver::ProductDiscovery& security = GetDriver()->m_productSecurity[m_securityKey];
+	security.m_applicationVersion.clear();
+	security.m_reports.clear();
+	security.m_reports.push_back( vector<uint8>( _data, _data + _length ) );
+	Log::Write( LogLevel_Info, m_nodeId, "Recorded the secured command classes of product %s", m_securityKey.c_str() );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::VerifySecuredClasses>
+// Ask the node for its secured classes after all, and record them for its
+// product in place of those it was given
+//-----------------------------------------------------------------------------
+void Node::VerifySecuredClasses
+(
+)
+{
+	m_securityReplayed = false;
+	if( Security* seccc = static_cast<Security*>( GetCommandClass( Security::StaticGetCommandClassId() ) ) )
+	{
+		GetDriver()->m_productSecurity.erase( m_securityKey );
+		m_recordingSecurity = true;
+		seccc->Init();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::SetNodeName>
+// Set the name of the node
+//-----------------------------------------------------------------------------
+void Node::SetNodeName
+(
+		string const& _nodeName
+)
+{
+	m_nodeName = _nodeName;
+	// Notify the watchers of the name changes
+	Notification* notification = new Notification( Notification::Type_NodeNaming );
+	notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
+	GetDriver()->QueueNotification( notification );
+	if( NodeNaming* cc = static_cast<NodeNaming*>( GetCommandClass( NodeNaming::StaticGetCommandClassId() ) ) )
+	{
+		// The node supports naming, so we try to write the name into the device
+		cc->SetName( _nodeName );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::SetLocation>
+// Set the location of the node
+//-----------------------------------------------------------------------------
+void Node::SetLocation
+(
+		string const& _location
+)
+{
+	m_location = _location;
+	// Notify the watchers of the name changes
 	Notification* notification = new Notification( Notification::Type_NodeNaming );
 	notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
 	GetDriver()->QueueNotification( notification );
@@ -1846,13 +2579,90 @@ void Node::ApplicationCommandHandler
 
 )
 {
-	if( CommandClass* pCommandClass = GetCommandClass( _data[5] ) )
+	uint64 key;
+	if( s_inboundRateLimit.Get() <= 0 || !GetCoalesceKey( _data, &key ) )
+	{
+		HandleFrame( _data, encrypted );
+		return;
+	}
+
+	// An earlier report of the same value that is still held back is out of date
+	for( list<HeldFrame>::iterator it = m_heldFrames.begin(); it != m_heldFrames.end(); ++it )
+	{
+		if( it->m_key == key )
+		{
+			m_heldFrames.erase( it );
+			GetDriver()->m_nodeCounters.m_reportsCoalesced[m_nodeId]++;
+			break;
+		}
+	}
+
+	// A reply the driver is waiting for is never held back.  Otherwise a report
+	// must wait behind those already held, so that they are handled in order.
+	bool allowed = m_heldFrames.empty() && TakeRxCredit();
+	if( allowed || GetDriver()->m_expectedNodeId == m_nodeId )
+	{
+		HandleFrame( _data, encrypted );
+		return;
+	}
+
+	if( m_heldFrames.size() >= c_maxHeldFrames )
+	{
+		m_heldFrames.pop_front();
+		GetDriver()->m_nodeCounters.m_reportsCoalesced[m_nodeId]++;
+	}
+	m_heldFrames.push_back( HeldFrame() );
+	HeldFrame& frame = m_heldFrames.back();
+	frame.m_key = key;
+	frame.m_data.assign( _data, _data + _data[4] + 6 );
+	frame.m_encrypted = encrypted;
+	GetDriver()->AddFloodedNode( m_nodeId );
+
+	if( !m_flooding )
+	{
+		m_flooding = true;
+		Log::Write( LogLevel_Warning, m_nodeId, "Node is sending more than %d reports a minute.  Only the latest report of each value will be handled until it calms down.", s_inboundRateLimit.Get() );
+		Notification* notification = new Notification( Notification::Type_Notification );
+		notification->SetHomeAndNodeIds( m_homeId, m_nodeId );
+		notification->SetNotification( Notification::Code_Flooding );
+		GetDriver()->QueueNotification( notification );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::HandleFrame>
+// Pass a frame to the command class it is for
+//-----------------------------------------------------------------------------
+void Node::HandleFrame
+(
+		uint8 const* _data,
+		bool encrypted
+)
+{
+	CommandClass* pCommandClass = GetCommandClass( _data[5] );
+	if( !pCommandClass && IsControlledClass( _data[5], NULL ) )
+	{
+		// The first frame for a class the node controls
+		pCommandClass = AddCommandClass( _data[5] );
+		if( pCommandClass )
+		{
+			Log::Write( LogLevel_Detail, m_nodeId, "Created %s to handle a frame from the node", pCommandClass->GetCommandClassName().c_str() );
+		}
+	}
+
+	// A secure frame for a class the node was not known to secure says the
+	// classes taken from another node of its product do not fit it
+	if( encrypted && m_securityReplayed && ( !pCommandClass || !pCommandClass->IsSecured() ) && _data[5] != Security::StaticGetCommandClassId() )
+	{
+		Log::Write( LogLevel_Info, m_nodeId, "Received a secure frame for command class 0x%.2x, which was not known to be secured, so asking for the secured command classes", _data[5] );
+		VerifySecuredClasses();
+	}
+
+	if( pCommandClass )
 	{
 		if (pCommandClass->IsSecured() && !encrypted) {
 			Log::Write( LogLevel_Warning, m_nodeId, "Received a Clear Text Message for the CommandClass %s which is Secured", pCommandClass->GetCommandClassName().c_str());
-			bool drop = true;
-			Options::Get()->GetOptionAsBool("EnforceSecureReception", &drop);
-			if (drop) {
+			if (s_enforceSecureReception.Get()) {
 				Log::Write( LogLevel_Warning, m_nodeId, "   Dropping Message");
 				return;
 			} else {
@@ -1861,6 +2671,7 @@ void Node::ApplicationCommandHandler
 		}
 
 		pCommandClass->ReceivedCntIncr();
+		CommandClassProfile::Timer timer( _data[5], CommandClassProfile::Operation_HandleMsg );
 		pCommandClass->HandleMsg( &_data[6], _data[4] );
 	}
 	else
@@ -1871,14 +2682,188 @@ void Node::ApplicationCommandHandler
 			// We have to at least acknowledge the message to avoid locking the sending device.
 			Log::Write( LogLevel_Info, m_nodeId, "ApplicationCommandHandler - Default acknowledgement of controller replication data" );
 
-			Msg* msg = new Msg( "Replication Command Complete", m_nodeId, REQUEST, FUNC_ID_ZW_REPLICATION_COMMAND_COMPLETE, false );
-			GetDriver()->SendMsg( msg, Driver::MsgQueue_Command );
+			Msg* msg = new Msg( "Replication Command Complete", m_nodeId, REQUEST, FUNC_ID_ZW_REPLICATION_COMMAND_COMPLETE, false );
+			GetDriver()->SendMsg( msg, Driver::MsgQueue_Command );
+		}
+		else
+		{
+			Log::Write( LogLevel_Info, m_nodeId, "ApplicationCommandHandler - Unhandled Command Class 0x%.2x", _data[5] );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::RefillRxCredit>
+// Add to the node's allowance of reports for the time since it was last
+// refilled, up to the burst
+//-----------------------------------------------------------------------------
+void Node::RefillRxCredit
+(
+)
+{
+	uint32 rate = (uint32)s_inboundRateLimit.Get();
+	int32 burst = s_inboundBurst.Get();
+	uint32 full = ( burst > 1 ) ? (uint32)burst * 1000 : 1000;
+	int32 elapsed = -m_rxCreditTime.TimeRemaining();
+	if( rate == 0 || elapsed <= 0 )
+	{
+		if( m_rxCredit > full )
+		{
+			m_rxCredit = full;
+		}
+		return;
+	}
+
+	// Each ms earns rate/60 thousandths of a report.  The ms that have not
+	// earned a whole thousandth yet are carried over.
+	uint64 earned = (uint64)elapsed * rate / 60;
+	uint64 credit = (uint64)m_rxCredit + earned;
+	if( credit >= full )
+	{
+		m_rxCredit = full;
+		m_rxCreditTime.SetTime();
+	}
+	else
+	{
+		m_rxCredit = (uint32)credit;
+		m_rxCreditTime.SetTime( -(int32)( elapsed - earned * 60 / rate ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Node::TakeRxCredit>
+// Take one report from the node's allowance, if there is one to take
+//-----------------------------------------------------------------------------
+bool Node::TakeRxCredit
+(
+)
+{
+	RefillRxCredit();
+	if( m_rxCredit >= 1000 )
+	{
+		m_rxCredit -= 1000;
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::ReleaseHeldFrames>
+// Handle the held reports that the node's allowance now covers.  Returns
+// the ms until the next can be handled, or until the allowance is full
+// again, or -1 once it is and the node is no longer flooding.
+//-----------------------------------------------------------------------------
+int32 Node::ReleaseHeldFrames
+(
+)
+{
+	uint32 rate = (uint32)s_inboundRateLimit.Get();
+	while( !m_heldFrames.empty() && ( rate == 0 || TakeRxCredit() ) )
+	{
+		// The frame is taken off the list first, as handling it may hold back another
+		vector<uint8> data;
+		data.swap( m_heldFrames.front().m_data );
+		bool encrypted = m_heldFrames.front().m_encrypted;
+		m_heldFrames.pop_front();
+		HandleFrame( &data[0], encrypted );
+	}
+
+	if( rate == 0 )
+	{
+		m_flooding = false;
+		return -1;
+	}
+
+	RefillRxCredit();
+	if( !m_heldFrames.empty() )
+	{
+		return (int32)( ( 1000 - m_rxCredit ) * 60 / rate ) + 1;
+	}
+
+	int32 burst = s_inboundBurst.Get();
+	uint32 full = ( burst > 1 ) ? (uint32)burst * 1000 : 1000;
+	if( m_rxCredit < full )
+	{
+		return (int32)( (uint64)( full - m_rxCredit ) * 60 / rate ) + 1;
+	}
+
+	if( m_flooding )
+	{
+		m_flooding = false;
+		Log::Write( LogLevel_Info, m_nodeId, "Node is no longer sending too many reports" );
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::GetCoalesceKey>
+// Reports of a value that the rate limit may hold back get a key, the same
+// for every report of the value: the command class, the command, the
+// endpoint and, for sensors and meters, the type and scale
+//-----------------------------------------------------------------------------
+bool Node::GetCoalesceKey
+(
+		uint8 const* _data,
+		uint64* o_key
+)
+{
+	uint8 const* payload = &_data[5];
+	uint32 length = _data[4];
+	uint8 endPoint = 0;
+	if( length >= 5 && payload[0] == MultiInstance::StaticGetCommandClassId() )
+	{
+		if( payload[1] == MultiInstance::MultiChannelCmd_Encap )
+		{
+			endPoint = payload[2] & 0x7f;
+			payload += 4;
+			length -= 4;
+		}
+		else if( payload[1] == MultiInstance::MultiInstanceCmd_Encap )
+		{
+			endPoint = payload[2];
+			payload += 3;
+			length -= 3;
+		}
+	}
+	if( length < 2 )
+	{
+		return false;
+	}
+
+	uint8 commandClassId = payload[0];
+	uint8 command = payload[1];
+	uint16 selector = 0;
+	if( commandClassId == SensorMultilevel::StaticGetCommandClassId() && command == 0x05 )	// Report
+	{
+		if( length < 4 )
+		{
+			return false;
 		}
-		else
+		selector = (uint16)( ( payload[2] << 8 ) | ( payload[3] & 0x18 ) );
+	}
+	else if( commandClassId == Meter::StaticGetCommandClassId() && command == 0x02 )			// Report
+	{
+		if( length < 4 )
 		{
-			Log::Write( LogLevel_Info, m_nodeId, "ApplicationCommandHandler - Unhandled Command Class 0x%.2x", _data[5] );
+			return false;
 		}
+		selector = (uint16)( ( payload[2] << 8 ) | ( payload[3] & 0x18 ) );
+	}
+	else if( commandClassId == SensorBinary::StaticGetCommandClassId() && command == 0x03 )	// Report
+	{
+		selector = ( length >= 4 ) ? payload[3] : 0;
+	}
+	else if( !( command == 0x03 &&																// Report
+			( commandClassId == Battery::StaticGetCommandClassId()
+			|| commandClassId == SwitchBinary::StaticGetCommandClassId()
+			|| commandClassId == SwitchMultilevel::StaticGetCommandClassId()
+			|| commandClassId == Basic::StaticGetCommandClassId() ) ) )
+	{
+		return false;
 	}
+
+	*o_key = ( (uint64)endPoint << 32 ) | ( (uint64)commandClassId << 24 ) | ( (uint64)command << 16 ) | selector;
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -1890,14 +2875,7 @@ CommandClass* Node::GetCommandClass
 		uint8 const _commandClassId
 )const
 {
-	map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.find( _commandClassId );
-	if( it != m_commandClassMap.end() )
-	{
-		return it->second;
-	}
-
-	// Not found
-	return NULL;
+	return m_commandClasses[_commandClassId];
 }
 
 //-----------------------------------------------------------------------------
@@ -1919,6 +2897,21 @@ CommandClass* Node::AddCommandClass
 	if( CommandClass* pCommandClass = CommandClasses::CreateCommandClass( _commandClassId, m_homeId, m_nodeId ) )
 	{
 		m_commandClassMap[_commandClassId] = pCommandClass;
+		m_commandClasses[_commandClassId] = pCommandClass;
+
+		// A class that was only noted keeps what was known of it
+		map<uint8,ControlledClass>::iterator cit = m_controlledClasses.find( _commandClassId );
+		if( cit != m_controlledClasses.end() )
+		{
+			pCommandClass->SetAfterMark();
+			pCommandClass->RestoreVersion( cit->second.m_version );
+			if( cit->second.m_inNIF )
+			{
+				pCommandClass->SetInNIF();
+			}
+			pCommandClass->SetInstance( 1 );
+			m_controlledClasses.erase( cit );
+		}
 		return pCommandClass;
 	}
 	else
@@ -1929,6 +2922,71 @@ CommandClass* Node::AddCommandClass
 	return NULL;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::DeferCommandClass>
+// Note a class the node controls, without creating its object yet
+//-----------------------------------------------------------------------------
+bool Node::DeferCommandClass
+(
+		uint8 const _commandClassId,
+		uint8 const _version,
+		bool const _inNIF
+)
+{
+	if( GetCommandClass( _commandClassId ) || !CommandClasses::IsSupported( _commandClassId ) )
+	{
+		return false;
+	}
+
+	// Classes the interview looks for, and those that query a node that controls them
+	if( _commandClassId == CentralScene::StaticGetCommandClassId()
+		|| _commandClassId == MultiInstance::StaticGetCommandClassId()
+		|| _commandClassId == Security::StaticGetCommandClassId()
+		|| _commandClassId == Version::StaticGetCommandClassId()
+		|| _commandClassId == WakeUp::StaticGetCommandClassId()
+		|| _commandClassId == ManufacturerSpecific::StaticGetCommandClassId()
+		|| _commandClassId == NoOperation::StaticGetCommandClassId() )
+	{
+		return false;
+	}
+
+	map<uint8,ControlledClass>::iterator it = m_controlledClasses.find( _commandClassId );
+	if( it == m_controlledClasses.end() )
+	{
+		ControlledClass controlled;
+		controlled.m_version = _version ? _version : 1;
+		controlled.m_inNIF = _inNIF;
+		m_controlledClasses[_commandClassId] = controlled;
+	}
+	else if( _inNIF )
+	{
+		it->second.m_inNIF = true;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::IsControlledClass>
+// Check for a class the node controls that has no object yet
+//-----------------------------------------------------------------------------
+bool Node::IsControlledClass
+(
+		uint8 const _commandClassId,
+		uint8* o_version
+)const
+{
+	map<uint8,ControlledClass>::const_iterator it = m_controlledClasses.find( _commandClassId );
+	if( it == m_controlledClasses.end() )
+	{
+		return false;
+	}
+	if( o_version )
+	{
+		*o_version = it->second.m_version;
+	}
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <Node::RemoveCommandClass>
 // Remove a command class from the node
@@ -1938,6 +2996,8 @@ void Node::RemoveCommandClass
 		uint8 const _commandClassId
 )
 {
+	m_controlledClasses.erase( _commandClassId );
+
 	map<uint8,CommandClass*>::iterator it = m_commandClassMap.find( _commandClassId );
 	if( it == m_commandClassMap.end() )
 	{
@@ -1951,9 +3011,16 @@ void Node::RemoveCommandClass
 		store->RemoveCommandClassValues( _commandClassId );
 	}
 
+	// Basic may have been mapped to it
+	if( Basic* basic = static_cast<Basic*>( GetCommandClass( Basic::StaticGetCommandClassId() ) ) )
+	{
+		basic->ClearResolvedMapping();
+	}
+
 	// Destroy the command class object and remove it from our map
 	Log::Write( LogLevel_Info, m_nodeId, "RemoveCommandClass - Removed support for %s", it->second->GetCommandClassName().c_str() );
 
+	m_commandClasses[_commandClassId] = NULL;
 	delete it->second;
 	m_commandClassMap.erase( it );
 }
@@ -1971,6 +3038,8 @@ bool Node::SetConfigParam
 {
 	if( Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) ) )
 	{
+		MaterializeConfigParam( _param );
+
 		// First try to find an existing value representing the parameter, and set that.
 		if( Value* value = cc->GetValue( 1, _param ) )
 		{
@@ -2024,6 +3093,74 @@ bool Node::SetConfigParam
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::GetConfigParam>
+// Get the value last reported for a configuration parameter
+//-----------------------------------------------------------------------------
+bool Node::GetConfigParam
+(
+		uint8 const _param,
+		int32& _value,
+		uint8& _size
+)
+{
+	bool res = false;
+	if( Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) ) )
+	{
+		MaterializeConfigParam( _param );
+		if( Value* value = cc->GetValue( 1, _param ) )
+		{
+			if( value->IsSet() )
+			{
+				res = true;
+				switch( value->GetID().GetType() )
+				{
+					case ValueID::ValueType_Bool:
+					{
+						_value = static_cast<ValueBool*>( value )->GetValue() ? 1 : 0;
+						_size = 1;
+						break;
+					}
+					case ValueID::ValueType_Byte:
+					{
+						_value = static_cast<ValueByte*>( value )->GetValue();
+						_size = 1;
+						break;
+					}
+					case ValueID::ValueType_Short:
+					{
+						_value = static_cast<ValueShort*>( value )->GetValue();
+						_size = 2;
+						break;
+					}
+					case ValueID::ValueType_Int:
+					{
+						_value = static_cast<ValueInt*>( value )->GetValue();
+						_size = 4;
+						break;
+					}
+					case ValueID::ValueType_List:
+					{
+						ValueList* valueList = static_cast<ValueList*>( value );
+						ValueList::Item const* item = valueList->GetItem();
+						_value = item ? item->m_value : 0;
+						_size = valueList->GetSize();
+						res = ( item != NULL );
+						break;
+					}
+					default:
+					{
+						res = false;
+						break;
+					}
+				}
+			}
+			value->Release();
+		}
+	}
+	return res;
+}
+
 //-----------------------------------------------------------------------------
 // <Node::RequestConfigParam>
 // Request the value of a configuration parameter from the device
@@ -2035,6 +3172,8 @@ void Node::RequestConfigParam
 {
 	if( Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) ) )
 	{
+		MaterializeConfigParam( _param );
+		CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_RequestValue );
 		cc->RequestValue( 0, _param, 1, Driver::MsgQueue_Send );
 	}
 }
@@ -2051,6 +3190,9 @@ bool Node::RequestAllConfigParams
 	bool res = false;
 	if( Configuration* cc = static_cast<Configuration*>( GetCommandClass( Configuration::StaticGetCommandClassId() ) ) )
 	{
+		// Every parameter the config file describes is wanted now
+		MaterializeConfigParams();
+
 		// Go through all the values in the value store, and request all those which are in the Configuration command class
 		for( ValueStore::Iterator it = m_values->Begin(); it != m_values->End(); ++it )
 		{
@@ -2061,6 +3203,7 @@ bool Node::RequestAllConfigParams
 				 * lot of ConfigParams requests, and should help speed up any user generated messages being sent out (as the MsgQueue_Send has a higher
 				 * priority than MsgQueue_Query
 				 */
+				CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_RequestValue );
 				res |= cc->RequestValue( _requestFlags, value->GetID().GetIndex(), 1, Driver::MsgQueue_Query );
 			}
 		}
@@ -2069,6 +3212,46 @@ bool Node::RequestAllConfigParams
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::MaterializeConfigParam>
+// Create the value of a parameter that was set aside while reading its config file
+//-----------------------------------------------------------------------------
+bool Node::MaterializeConfigParam
+(
+		uint8 const _param
+)
+{
+	map<uint8,TiXmlElement const*>::iterator it = m_pendingConfigParams.find( _param );
+	if( it == m_pendingConfigParams.end() )
+	{
+		return false;
+	}
+
+	TiXmlElement const* valueElement = it->second;
+	m_pendingConfigParams.erase( it );
+	return CreateValueFromXML( Configuration::StaticGetCommandClassId(), valueElement );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::MaterializeConfigParams>
+// Create the values of all the parameters set aside while reading the config file
+//-----------------------------------------------------------------------------
+void Node::MaterializeConfigParams
+(
+)
+{
+	if( m_pendingConfigParams.empty() )
+	{
+		return;
+	}
+
+	Log::Write( LogLevel_Info, m_nodeId, "Creating the %d configuration parameters not used yet", (int)m_pendingConfigParams.size() );
+	while( !m_pendingConfigParams.empty() )
+	{
+		MaterializeConfigParam( m_pendingConfigParams.begin()->first );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Node::RequestDynamicValues>
 // Request an update of all known dynamic values from the device
@@ -2554,6 +3737,11 @@ void Node::ReadValueFromXML
 			value->ReadXML( m_homeId, m_nodeId, _commandClassId, _valueElement );
 			value->Release();
 		}
+		else if( m_deferConfigParams && _commandClassId == Configuration::StaticGetCommandClassId() && instance <= 1 )
+		{
+			// Leave the parameter out until something asks for it
+			m_pendingConfigParams[index] = _valueElement;
+		}
 		else
 		{
 			CreateValueFromXML( _commandClassId, _valueElement );
@@ -2783,6 +3971,45 @@ void Node::RemoveAssociation
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Node::GetAssociations>
+// Gets the members of an association group
+//-----------------------------------------------------------------------------
+uint32 Node::GetAssociations
+(
+		uint8 const _groupIdx,
+		NodeSet* o_members
+)
+{
+	if( Group* group = GetGroup( _groupIdx ) )
+	{
+		group->GetMembers( o_members );
+		return o_members->GetCount();
+	}
+
+	o_members->Clear();
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// <Node::SetAssociations>
+// Changes the members of an association group
+//-----------------------------------------------------------------------------
+uint32 Node::SetAssociations
+(
+		uint8 const _groupIdx,
+		NodeSet const& _members
+)
+{
+	uint32 changes = 0;
+	if( Group* group = GetGroup( _groupIdx ) )
+	{
+		changes = group->SetAssociations( _members );
+	}
+
+	return changes;
+}
+
 //-----------------------------------------------------------------------------
 // <Node::AutoAssociate>
 // Automatically associate the controller with certain groups
@@ -2842,23 +4069,17 @@ string Node::GetEndPointDeviceClassLabel
 	snprintf( str, sizeof(str), "Generic 0x%.2x Specific 0x%.2x", _generic, _specific );
 	label = str;
 
-	// Read in the device class data if it has not been read already.
-	if( !s_deviceClassesLoaded )
-	{
-		ReadDeviceClasses();
-	}
+	ReadDeviceClasses();
 
 	// Get the Generic device class label
-	map<uint8,GenericDeviceClass*>::iterator git = s_genericDeviceClasses.find( _generic );
-	if( git != s_genericDeviceClasses.end() )
+	if( DeviceClasses::Entry const* genericDeviceClass = DeviceClasses::Find( s_genericDeviceClasses, _generic ) )
 	{
-		GenericDeviceClass* genericDeviceClass = git->second;
-		label = genericDeviceClass->GetLabel();
+		label = genericDeviceClass->m_label;
 
 		// Override with any specific device class label
-		if( DeviceClass* specificDeviceClass = genericDeviceClass->GetSpecificDeviceClass( _specific ) )
+		if( DeviceClasses::Entry const* specificDeviceClass = DeviceClasses::FindSpecific( genericDeviceClass, _specific ) )
 		{
-			label = specificDeviceClass->GetLabel();
+			label = specificDeviceClass->m_label;
 		}
 	}
 
@@ -2880,17 +4101,12 @@ bool Node::SetDeviceClasses
 	m_generic = _generic;
 	m_specific = _specific;
 
-	// Read in the device class data if it has not been read already.
-	if( !s_deviceClassesLoaded )
-	{
-		ReadDeviceClasses();
-	}
+	ReadDeviceClasses();
 
 	// Get the basic device class label
-	map<uint8,string>::iterator bit = s_basicDeviceClasses.find( _basic );
-	if( bit != s_basicDeviceClasses.end() )
+	if( DeviceClasses::Entry const* basicDeviceClass = DeviceClasses::Find( s_basicDeviceClasses, _basic ) )
 	{
-		m_type = bit->second;
+		m_type = basicDeviceClass->m_label;
 		Log::Write( LogLevel_Info, m_nodeId, "  Basic device class    (0x%.2x) - %s", m_basic, m_type.c_str() );
 	}
 	else
@@ -2900,34 +4116,32 @@ bool Node::SetDeviceClasses
 
 	// Apply any Generic device class data
 	uint8 basicMapping = 0;
-	map<uint8,GenericDeviceClass*>::iterator git = s_genericDeviceClasses.find( _generic );
-	if( git != s_genericDeviceClasses.end() )
+	if( DeviceClasses::Entry const* genericDeviceClass = DeviceClasses::Find( s_genericDeviceClasses, _generic ) )
 	{
-		GenericDeviceClass* genericDeviceClass = git->second;
-		m_type = genericDeviceClass->GetLabel();
+		m_type = genericDeviceClass->m_label;
 
 		Log::Write( LogLevel_Info, m_nodeId, "  Generic device Class  (0x%.2x) - %s", m_generic, m_type.c_str() );
 
 		// Add the mandatory command classes for this generic class type
-		AddMandatoryCommandClasses( genericDeviceClass->GetMandatoryCommandClasses() );
+		AddMandatoryCommandClasses( genericDeviceClass->m_mandatoryCommandClasses );
 
 		// Get the command class that COMMAND_CLASS_BASIC maps to.
-		basicMapping = genericDeviceClass->GetBasicMapping();
+		basicMapping = genericDeviceClass->m_basicMapping;
 
 		// Apply any Specific device class data
-		if( DeviceClass* specificDeviceClass = genericDeviceClass->GetSpecificDeviceClass( _specific ) )
+		if( DeviceClasses::Entry const* specificDeviceClass = DeviceClasses::FindSpecific( genericDeviceClass, _specific ) )
 		{
-			m_type = specificDeviceClass->GetLabel();
+			m_type = specificDeviceClass->m_label;
 
 			Log::Write( LogLevel_Info, m_nodeId, "  Specific device class (0x%.2x) - %s", m_specific, m_type.c_str() );
 
 			// Add the mandatory command classes for this specific class type
-			AddMandatoryCommandClasses( specificDeviceClass->GetMandatoryCommandClasses() );
+			AddMandatoryCommandClasses( specificDeviceClass->m_mandatoryCommandClasses );
 
-			if( specificDeviceClass->GetBasicMapping() )
+			if( specificDeviceClass->m_basicMapping )
 			{
 				// Override the generic device class basic mapping with the specific device class one.
-				basicMapping = specificDeviceClass->GetBasicMapping();
+				basicMapping = specificDeviceClass->m_basicMapping;
 			}
 		}
 		else
@@ -2988,6 +4202,11 @@ bool Node::SetDeviceClasses
 				reportedClasses = true;
 			}
 		}
+		for( map<uint8,ControlledClass>::const_iterator dit = m_controlledClasses.begin(); dit != m_controlledClasses.end(); ++dit )
+		{
+			Log::Write( LogLevel_Info, m_nodeId, "    %s", CommandClasses::GetName( dit->first ).c_str() );
+			reportedClasses = true;
+		}
 		if( !reportedClasses )
 		{
 			Log::Write( LogLevel_Info, m_nodeId, "    None" );
@@ -3013,10 +4232,7 @@ bool Node::SetPlusDeviceClasses
 		return false; // already set
 	}
 
-	if( !s_deviceClassesLoaded )
-	{
-		ReadDeviceClasses();
-	}
+	ReadDeviceClasses();
 
 	m_nodePlusInfoReceived = true;
 	m_role = _role;
@@ -3024,13 +4240,11 @@ bool Node::SetPlusDeviceClasses
 	m_nodeType = _nodeType;
 
 	Log::Write (LogLevel_Info, m_nodeId, "ZWave+ Info Received from Node %d", m_nodeId);
-	map<uint8,DeviceClass*>::iterator nit = s_nodeTypes.find( m_nodeType );
-	if (nit != s_nodeTypes.end())
+	if( DeviceClasses::Entry const* deviceClass = DeviceClasses::Find( s_nodeTypes, m_nodeType ) )
 	{
-		DeviceClass* deviceClass = nit->second;
 
-		Log::Write( LogLevel_Info, m_nodeId, "  Zwave+ Node Type  (0x%.2x) - %s. Mandatory Command Classes:", m_nodeType, deviceClass->GetLabel().c_str() );
-		uint8 const *_commandClasses = deviceClass->GetMandatoryCommandClasses();
+		Log::Write( LogLevel_Info, m_nodeId, "  Zwave+ Node Type  (0x%.2x) - %s. Mandatory Command Classes:", m_nodeType, deviceClass->m_label );
+		uint8 const *_commandClasses = deviceClass->m_mandatoryCommandClasses;
 
 		/* no CommandClasses to add */
 		if (_commandClasses != NULL)
@@ -3050,7 +4264,7 @@ bool Node::SetPlusDeviceClasses
 
 
 			// Add the mandatory command classes for this Roletype
-			AddMandatoryCommandClasses( deviceClass->GetMandatoryCommandClasses() );
+			AddMandatoryCommandClasses( deviceClass->m_mandatoryCommandClasses );
 		}
 		else
 		{
@@ -3064,14 +4278,12 @@ bool Node::SetPlusDeviceClasses
 
 
 	// Apply any Zwave+ device class data
-	map<uint16,DeviceClass*>::iterator dit = s_deviceTypeClasses.find( _deviceType );
-	if( dit != s_deviceTypeClasses.end() )
+	if( DeviceClasses::Entry const* deviceClass = DeviceClasses::Find( s_deviceTypeClasses, _deviceType ) )
 	{
-		DeviceClass* deviceClass = dit->second;
-		// m_type = deviceClass->GetLabel(); // do we what to update the type with the zwave+ info??
+		// m_type = deviceClass->m_label; // do we what to update the type with the zwave+ info??
 
-		Log::Write( LogLevel_Info, m_nodeId, "  Zwave+ Device Type  (0x%.2x) - %s. Mandatory Command Classes:", _deviceType, deviceClass->GetLabel().c_str() );
-		uint8 const *_commandClasses = deviceClass->GetMandatoryCommandClasses();
+		Log::Write( LogLevel_Info, m_nodeId, "  Zwave+ Device Type  (0x%.2x) - %s. Mandatory Command Classes:", _deviceType, deviceClass->m_label );
+		uint8 const *_commandClasses = deviceClass->m_mandatoryCommandClasses;
 
 		/* no CommandClasses to add */
 		if (_commandClasses != NULL)
@@ -3091,7 +4303,7 @@ bool Node::SetPlusDeviceClasses
 
 
 			// Add the mandatory command classes for this device class type
-			AddMandatoryCommandClasses( deviceClass->GetMandatoryCommandClasses() );
+			AddMandatoryCommandClasses( deviceClass->m_mandatoryCommandClasses );
 		}
 		else
 		{
@@ -3104,14 +4316,12 @@ bool Node::SetPlusDeviceClasses
 	}
 
 	// Apply any Role device class data
-	map<uint8,DeviceClass*>::iterator rit = s_roleDeviceClasses.find( _role );
-	if( rit != s_roleDeviceClasses.end() )
+	if( DeviceClasses::Entry const* roleDeviceClass = DeviceClasses::Find( s_roleDeviceClasses, _role ) )
 	{
-		DeviceClass* roleDeviceClass = rit->second;
 
-		Log::Write( LogLevel_Info, m_nodeId, "  ZWave+ Role Type  (0x%.2x) - %s", m_generic, roleDeviceClass->GetLabel().c_str() );
+		Log::Write( LogLevel_Info, m_nodeId, "  ZWave+ Role Type  (0x%.2x) - %s", m_generic, roleDeviceClass->m_label );
 
-		uint8 const *_commandClasses = roleDeviceClass->GetMandatoryCommandClasses();
+		uint8 const *_commandClasses = roleDeviceClass->m_mandatoryCommandClasses;
 
 		/* no CommandClasses to add */
 		if (_commandClasses != NULL)
@@ -3131,7 +4341,7 @@ bool Node::SetPlusDeviceClasses
 
 
 			// Add the mandatory command classes for this role class type
-			AddMandatoryCommandClasses( roleDeviceClass->GetMandatoryCommandClasses() );
+			AddMandatoryCommandClasses( roleDeviceClass->m_mandatoryCommandClasses );
 		}
 		else
 		{
@@ -3183,6 +4393,11 @@ bool Node::AddMandatoryCommandClasses
 				continue;
 			}
 
+			if( afterMark && DeferCommandClass( cc, 1, false ) )
+			{
+				continue;
+			}
+
 			if( CommandClass* commandClass = AddCommandClass( cc ) )
 			{
 				// If this class came after the COMMAND_CLASS_MARK, then we do not create values.
@@ -3203,74 +4418,60 @@ bool Node::AddMandatoryCommandClasses
 
 //-----------------------------------------------------------------------------
 // <Node::ReadDeviceClasses>
-// Read the static device class data from the device_classes.xml file
+// Select the device class tables, if no driver has done so yet.  The built in
+// ones are used unless there is a device_classes.xml to override them.  The
+// config directory is updated apart from the library, so its file is read
+// first, and one in the user path replaces that.
 //-----------------------------------------------------------------------------
 void Node::ReadDeviceClasses
 (
 )
 {
-	// Load the XML document that contains the device class information
-	string configPath;
-	Options::Get()->GetOptionAsString( "ConfigPath", &configPath );
-
-	string filename =  configPath + string("device_classes.xml");
-
-	TiXmlDocument doc;
-	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	LockGuard LG(s_deviceClassesMutex);
+	if( s_deviceClassesLoaded )
 	{
-		Log::Write( LogLevel_Info, "Failed to load device_classes.xml" );
-		Log::Write( LogLevel_Info, "Check that the config path provided when creating the Manager points to the correct location." );
 		return;
 	}
 
-	TiXmlElement const* deviceClassesElement = doc.RootElement();
+	s_basicDeviceClasses = DeviceClasses::s_builtinBasic;
+	s_genericDeviceClasses = DeviceClasses::s_builtinGeneric;
+	s_roleDeviceClasses = DeviceClasses::s_builtinRole;
+	s_deviceTypeClasses = DeviceClasses::s_builtinDeviceType;
+	s_nodeTypes = DeviceClasses::s_builtinNodeType;
 
-	// Read the basic and generic device classes
-	TiXmlElement const* child = deviceClassesElement->FirstChildElement();
-	while( child )
+	char const* paths[] = { "ConfigPath", "UserPath" };
+	for( uint32 i = 0; i < sizeof(paths) / sizeof(paths[0]); ++i )
 	{
-		char const* str = child->Value();
-		if( str )
-		{
-			char const* keyStr = child->Attribute( "key" );
-			if( keyStr )
-			{
-				char* pStop;
-				uint16 key = (uint16)strtol( keyStr, &pStop, 16 );
+		string path;
+		Options::Get()->GetOptionAsString( paths[i], &path );
 
-				if( !strcmp( str, "Generic" ) )
-				{
-					s_genericDeviceClasses[key] = new GenericDeviceClass( child );
-				}
-				else if( !strcmp( str, "Basic" ) )
-				{
-					char const* label = child->Attribute( "label" );
-					if( label )
-					{
-						s_basicDeviceClasses[key] = label;
-					}
-				}
-				else if( !strcmp( str, "Role" ) )
-				{
-					s_roleDeviceClasses[key] = new DeviceClass( child );
-				}
-				else if( !strcmp( str, "DeviceType" ) )
-				{
-					s_deviceTypeClasses[key] = new DeviceClass( child );
-				}
-				else if (!strcmp( str, "NodeType" ) )
-				{
-					s_nodeTypes[key] = new DeviceClass( child );
-				}
-			}
+		string filename =  path + string("device_classes.xml");
+		if( DeviceClasses::Load( filename, s_basicDeviceClasses, s_genericDeviceClasses, s_roleDeviceClasses, s_deviceTypeClasses, s_nodeTypes ) )
+		{
+			Log::Write( LogLevel_Info, "Using the device classes from %s", filename.c_str() );
 		}
-
-		child = child->NextSiblingElement();
 	}
 
 	s_deviceClassesLoaded = true;
 }
 
+//-----------------------------------------------------------------------------
+// <Node::UnloadDeviceClasses>
+// Free any device class tables loaded from an override file
+//-----------------------------------------------------------------------------
+void Node::UnloadDeviceClasses
+(
+)
+{
+	LockGuard LG(s_deviceClassesMutex);
+	DeviceClasses::Free( s_basicDeviceClasses );
+	DeviceClasses::Free( s_genericDeviceClasses );
+	DeviceClasses::Free( s_roleDeviceClasses );
+	DeviceClasses::Free( s_deviceTypeClasses );
+	DeviceClasses::Free( s_nodeTypes );
+	s_deviceClassesLoaded = false;
+}
+
 //-----------------------------------------------------------------------------
 // <Node::GetNoderStatistics>
 // Return driver statistics
@@ -3280,19 +4481,10 @@ void Node::GetNodeStatistics
 		NodeData* _data
 )
 {
-	_data->m_sentCnt = m_sentCnt;
-	_data->m_sentFailed = m_sentFailed;
-	_data->m_retries = m_retries;
-	_data->m_receivedCnt = m_receivedCnt;
-	_data->m_receivedDups = m_receivedDups;
-	_data->m_receivedUnsolicited = m_receivedUnsolicited;
-	_data->m_lastRequestRTT = m_lastRequestRTT;
-	_data->m_lastResponseRTT = m_lastResponseRTT;
+	// The counters are kept by the driver, which fills them in
 	_data->m_sentTS = m_sentTS.GetAsString();
 	_data->m_receivedTS = m_receivedTS.GetAsString();
-	_data->m_averageRequestRTT = m_averageRequestRTT;
-	_data->m_averageResponseRTT = m_averageResponseRTT;
-	_data->m_quality = m_quality;
+	_data->m_retryTimeout = m_smoothedRTT ? (uint32)( ( m_smoothedRTT >> 3 ) + m_rttVariation ) : 0;
 	memcpy( _data->m_lastReceivedMessage, m_lastReceivedMessage, sizeof(m_lastReceivedMessage) );
 	for( map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin(); it != m_commandClassMap.end(); ++it )
 	{
@@ -3305,120 +4497,108 @@ void Node::GetNodeStatistics
 }
 
 //-----------------------------------------------------------------------------
-// <DeviceClass::DeviceClass>
-// Constructor
+// <Node::GetNodeLatencyStatistics>
+// Return the percentiles of the node's round trip times
 //-----------------------------------------------------------------------------
-Node::DeviceClass::DeviceClass
+void Node::GetNodeLatencyStatistics
 (
-		TiXmlElement const* _el
-):
-m_mandatoryCommandClasses(NULL),
-m_basicMapping(0)
+		NodeLatencyData* _data
+)
 {
-	char const* str = _el->Attribute( "label" );
-	if( str )
+	m_callbackLatency.GetSummary( &_data->m_callback );
+	m_replyLatency.GetSummary( &_data->m_reply );
+}
+
+//-----------------------------------------------------------------------------
+// <Node::GetNodeQueryStageStatistics>
+// Return the time each stage of the interview took, with the current stage
+// and the interview timed until now if it is not complete
+//-----------------------------------------------------------------------------
+void Node::GetNodeQueryStageStatistics
+(
+		NodeQueryStageData* _data
+)
+{
+	_data->m_current = m_queryStage;
+	memcpy( _data->m_stages, m_stageData, sizeof(m_stageData) );
+	if( m_timedStage == QueryStage_Complete )
 	{
-		m_label = str;
+		_data->m_elapsed = m_interviewElapsed;
 	}
-
-	str = _el->Attribute( "command_classes" );
-	if( str )
+	else if( m_timedStage == QueryStage_None )
 	{
-		// Parse the comma delimted command class
-		// list into a temporary vector.
-		vector<uint8> ccs;
-		char* pos = const_cast<char*>(str);
-		while( *pos )
-		{
-			ccs.push_back( (uint8)strtol( pos, &pos, 16 ) );
-			if( (*pos) == ',' )
-			{
-				++pos;
-			}
-		}
-
-		// Copy the vector contents into an array.
-		size_t numCCs = ccs.size();
-		m_mandatoryCommandClasses = new uint8[numCCs+1];
-		m_mandatoryCommandClasses[numCCs] = 0;	// Zero terminator
-
-		for( uint32 i=0; i<numCCs; ++i )
-		{
-			m_mandatoryCommandClasses[i] = ccs[i];
-		}
+		// Not started since the node was created or loaded
+		_data->m_elapsed = 0;
 	}
-
-	str = _el->Attribute( "basic" );
-	if( str )
+	else
 	{
-		char* pStop;
-		m_basicMapping = (uint8)strtol( str, &pStop, 16 );
+		_data->m_elapsed = (uint32)( -m_interviewStart.TimeRemaining() );
+		_data->m_stages[m_timedStage].m_elapsed = (uint32)( -m_stageStart.TimeRemaining() );
 	}
 }
 
 //-----------------------------------------------------------------------------
-// <Node::GenericDeviceClass::GenericDeviceClass>
-// Constructor
+// <Node::GetNodeMemoryStatistics>
+// Estimate the memory used by the node.  Each map entry is counted as four
+// pointers as well as its contents.
 //-----------------------------------------------------------------------------
-Node::GenericDeviceClass::GenericDeviceClass
+void Node::GetNodeMemoryStatistics
 (
-		TiXmlElement const* _el
-):
-DeviceClass( _el )
+		NodeMemoryData* _data
+)
 {
-	// Add any specific device classes
-	TiXmlElement const* child = _el->FirstChildElement();
-	while( child )
+	_data->m_node = (uint32)( sizeof(Node) + m_type.capacity() + m_manufacturerName.capacity() + m_productName.capacity()
+		+ m_nodeName.capacity() + m_location.capacity() + m_interviewFingerprint.capacity()
+		+ sizeof(ValueStore) + m_commandClassMap.size() * ( 4 * sizeof(void*) + sizeof(pair<uint8,CommandClass*>) )
+		+ m_controlledClasses.size() * ( 4 * sizeof(void*) + sizeof(pair<uint8,ControlledClass>) )
+		+ m_groups.size() * ( 4 * sizeof(void*) + sizeof(pair<uint8,Group*>) ) );
+	_data->m_commandClasses = 0;
+	_data->m_values = 0;
+	_data->m_groups = 0;
+	_data->m_wakeUpQueue = 0;
+	_data->m_ccData.clear();
+
+	map<uint8,CommandClassMemoryData> ccData;
+	for( map<uint8,CommandClass*>::const_iterator it = m_commandClassMap.begin(); it != m_commandClassMap.end(); ++it )
 	{
-		char const* str = child->Value();
-		if( str && !strcmp( str, "Specific" ) )
-		{
-			char const* keyStr = child->Attribute( "key" );
-			if( keyStr )
-			{
-				char* pStop;
-				uint8 key = (uint8)strtol( keyStr, &pStop, 16 );
+		CommandClassMemoryData& data = ccData[it->first];
+		data.m_commandClassId = it->first;
+		data.m_commandClass = sizeof(CommandClass);
+		data.m_values = 0;
+		data.m_valueCount = 0;
+		_data->m_commandClasses += data.m_commandClass;
+	}
 
-				m_specificDeviceClasses[key] = new DeviceClass( child );
-			}
+	// The values, and the store's table of them
+	uint32 count = 0;
+	for( ValueStore::Iterator it = m_values->Begin(); it != m_values->End(); ++it )
+	{
+		uint32 bytes = it->second->GetMemoryUsage();
+		map<uint8,CommandClassMemoryData>::iterator cit = ccData.find( it->second->GetID().GetCommandClassId() );
+		if( cit != ccData.end() )
+		{
+			cit->second.m_values += bytes;
+			++cit->second.m_valueCount;
 		}
-
-		child = child->NextSiblingElement();
+		_data->m_values += bytes;
+		++count;
 	}
-}
+	_data->m_values += count * sizeof(ValueStore::Entry);
 
-//-----------------------------------------------------------------------------
-// <Node::GenericDeviceClass::~GenericDeviceClass>
-// Destructor
-//-----------------------------------------------------------------------------
-Node::GenericDeviceClass::~GenericDeviceClass
-(
-)
-{
-	while( !m_specificDeviceClasses.empty() )
+	for( map<uint8,Group*>::const_iterator it = m_groups.begin(); it != m_groups.end(); ++it )
 	{
-		map<uint8,DeviceClass*>::iterator it = m_specificDeviceClasses.begin();
-		delete it->second;
-		m_specificDeviceClasses.erase( it );
+		_data->m_groups += it->second->GetMemoryUsage();
 	}
-}
 
-//-----------------------------------------------------------------------------
-// <Node::GenericDeviceClass::GetSpecificDeviceClass>
-// Get a specific device class object
-//-----------------------------------------------------------------------------
-Node::DeviceClass* Node::GenericDeviceClass::GetSpecificDeviceClass
-(
-		uint8 const& _specific
-)
-{
-	map<uint8,DeviceClass*>::iterator it = m_specificDeviceClasses.find( _specific );
-	if( it != m_specificDeviceClasses.end() )
+	if( WakeUp* wakeUp = static_cast<WakeUp*>( GetCommandClass( WakeUp::StaticGetCommandClassId() ) ) )
 	{
-		return it->second;
+		_data->m_wakeUpQueue = wakeUp->GetPendingMemoryUsage();
 	}
 
-	return NULL;
+	for( map<uint8,CommandClassMemoryData>::const_iterator it = ccData.begin(); it != ccData.end(); ++it )
+	{
+		_data->m_ccData.push_back( it->second );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -3455,9 +4635,11 @@ uint8 *Node::GenerateNonceKey() {
 	this->m_lastnonce++;
 	if (this->m_lastnonce >= 8)
 		this->m_lastnonce = 0;
+#ifdef DEBUG
 	for (uint8 i = 0; i < 8; i++) {
 		PrintHex("NONCES", (const uint8_t*)this->m_nonces[i], 8);
 	}
+#endif
 	return &this->m_nonces[idx][0];
 }
 //-----------------------------------------------------------------------------
@@ -3485,15 +4667,10 @@ uint8 *Node::GetNonceKey(uint32 nonceid) {
 //-----------------------------------------------------------------------------
 string Node::GetDeviceTypeString() {
 
-	if( !s_deviceClassesLoaded )
-	{
-		ReadDeviceClasses();
-	}
-	map<uint16,DeviceClass*>::iterator nit = s_deviceTypeClasses.find( m_deviceType );
-	if (nit != s_deviceTypeClasses.end())
+	ReadDeviceClasses();
+	if( DeviceClasses::Entry const* deviceClass = DeviceClasses::Find( s_deviceTypeClasses, m_deviceType ) )
 	{
-		DeviceClass* deviceClass = nit->second;
-		return deviceClass->GetLabel();
+		return deviceClass->m_label;
 	}
 	return "";
 }
@@ -3502,15 +4679,10 @@ string Node::GetDeviceTypeString() {
 // Get the ZWave+ RoleType as a String
 //-----------------------------------------------------------------------------
 string Node::GetRoleTypeString() {
-	if( !s_deviceClassesLoaded )
+	ReadDeviceClasses();
+	if( DeviceClasses::Entry const* deviceClass = DeviceClasses::Find( s_roleDeviceClasses, m_role ) )
 	{
-		ReadDeviceClasses();
-	}
-	map<uint8,DeviceClass*>::iterator nit = s_roleDeviceClasses.find( m_role );
-	if (nit != s_roleDeviceClasses.end())
-	{
-		DeviceClass* deviceClass = nit->second;
-		return deviceClass->GetLabel();
+		return deviceClass->m_label;
 	}
 	return "";
 }
@@ -3519,15 +4691,10 @@ string Node::GetRoleTypeString() {
 // Get the ZWave+ NodeType as a String
 //-----------------------------------------------------------------------------
 string Node::GetNodeTypeString() {
-	if( !s_deviceClassesLoaded )
-	{
-		ReadDeviceClasses();
-	}
-	map<uint8,DeviceClass*>::iterator nit = s_nodeTypes.find( m_nodeType );
-	if (nit != s_nodeTypes.end())
+	ReadDeviceClasses();
+	if( DeviceClasses::Entry const* deviceClass = DeviceClasses::Find( s_nodeTypes, m_nodeType ) )
 	{
-		DeviceClass* deviceClass = nit->second;
-		return deviceClass->GetLabel();
+		return deviceClass->m_label;
 	}
 	return "";
 }
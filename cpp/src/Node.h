@@ -36,8 +36,10 @@
 #include "value_classes/ValueID.h"
 #include "value_classes/ValueList.h"
 #include "Msg.h"
+#include "LatencyHistogram.h"
 #include "platform/TimeStamp.h"
 #include "Group.h"
+#include "DeviceClasses.h"
 
 class TiXmlElement;
 
@@ -76,6 +78,7 @@ namespace OpenZWave
 			friend class ClimateControlSchedule;
 			friend class Clock;
 			friend class CommandClass;
+			friend class Configuration;
 			friend class ControllerReplication;
 			friend class EnergyProduction;
 			friend class Hail;
@@ -121,7 +124,13 @@ namespace OpenZWave
 			 */
 			virtual ~Node();
 
+			// Nodes are allocated from a pool, as they are deleted and created again when the network is reset or a node is replaced
+			static void* operator new( size_t _size );
+			static void operator delete( void* _ptr, size_t _size );
+
 		private:
+			Mutex*		m_mutex;			// Taken by Driver::NodeGuard, so that threads working on different nodes do not wait for each other
+
 			/** Returns a pointer to the driver (interface with a Z-Wave controller)
 			 *  associated with this node.
 			 */
@@ -155,6 +164,13 @@ namespace OpenZWave
 				QueryStage_Complete							/**< Query process is completed for this node */
 			};
 
+			enum QueryPriority
+			{
+				QueryPriority_High = 0,						/**< Queried before other nodes, such as door locks and thermostats */
+				QueryPriority_Normal,						/**< Most mains powered devices */
+				QueryPriority_Low							/**< Queried after other nodes, such as battery powered sensors */
+			};
+
 
 			/**
 			 * This function advances the query process (see Remarks below for more detail on the
@@ -214,6 +230,23 @@ namespace OpenZWave
 			 */
 			string GetQueryStageName( QueryStage const _stage );
 
+			/**
+			 * Set how urgently the node is queried, compared with the other nodes.  This
+			 * replaces the priority chosen from the node's device class, and is saved.
+			 * \param _priority The query priority.
+			 * \see GetQueryPriority
+			 */
+			void SetQueryPriority( QueryPriority const _priority );
+
+			/**
+			 * Returns how urgently the node is queried.  Unless one has been set, door locks
+			 * and thermostats have a high priority, and nodes that are not always listening
+			 * a low one.
+			 * \return The query priority.
+			 * \see SetQueryPriority
+			 */
+			QueryPriority GetQueryPriority()const;
+
 			/**
 			 * Returns whether the library thinks a node is functioning properly
 			 * \return boolean status of node.
@@ -262,6 +295,27 @@ namespace OpenZWave
 		private:
 			void SetStaticRequests();
 
+			/**
+			 * Build the fingerprint of the node's static interview: its manufacturer and
+			 * product ids, and each command class in its node info frame with the version
+			 * found for it.
+			 */
+			string GetInterviewFingerprint();
+
+			/**
+			 * Build the key under which the versions and endpoints found for a node are
+			 * shared with other nodes of its product: its manufacturer and product ids,
+			 * and the command classes in its node info frame.
+			 */
+			string GetProductKey();
+			void GetNIFClasses( map<uint8,uint8>* o_versions );		// The classes in the node info frame, with and without objects, and their versions
+			bool ReplayProductDiscovery();			// Fills in the Versions and Instances stages from another node of the product, if the ProductDiscoveryCache option allows
+			void RecordDiscoveryReport( uint8 const _commandClassId, uint8 const* _data, uint32 const _length );
+			void ProductVersionReported( string const& _applicationVersion );	// Keeps the reports recorded, or checks those replayed, against the node's application version
+			bool ReplaySecuredClasses();			// Fills in the SecurityReport stage from another node of the product, if the ProductSecurityCache option allows
+			void RecordSecuredClasses( uint8 const* _data, uint32 const _length );
+			void VerifySecuredClasses();			// Asks a node that was given another node's secured classes for its own
+
 			QueryStage	m_queryStage;
 			bool		m_queryPending;
 			bool		m_queryConfiguration;
@@ -274,6 +328,18 @@ namespace OpenZWave
 			bool		m_nodeInfoSupported;
 			bool		m_refreshonNodeInfoFrame;
 			bool		m_nodeAlive;
+			string		m_interviewFingerprint;		// Saved GetInterviewFingerprint() from the last static interview to complete
+			QueryPriority	m_queryPriority;
+			bool		m_queryPrioritySet;			// True if m_queryPriority was set by the application, rather than chosen from the device class
+			string		m_productKey;				// GetProductKey() when the Versions stage began
+			list< vector<uint8> >	m_discoveryReports;	// Version and MultiInstance reports recorded for later nodes of the product
+			bool		m_recordingDiscovery;
+			bool		m_replayingDiscovery;		// The reports being handled are replayed, so nothing is to be sent
+			bool		m_discoveryReplayed;		// The Versions and Instances stages were filled in from another node of the product
+			string		m_securityKey;				// GetProductKey() when the SecurityReport stage began
+			bool		m_recordingSecurity;
+			bool		m_securityReplayed;			// The secured classes were taken from another node of the product, and not yet checked
+			bool		m_handedOver;				// Fully queried by the process that handed the network over, so not queried again at startup
 
 			//-----------------------------------------------------------------------------
 			// Capabilities
@@ -313,12 +379,17 @@ namespace OpenZWave
 			uint8 GetGeneric()const{ return m_generic; }
 			uint8 GetSpecific()const{ return m_specific; }
 			string const& GetType()const{ return m_type; }
-			uint32 GetNeighbors( uint8** o_associations );
 			bool IsController()const{ return ( m_basic == 0x01 || m_basic == 0x02 ) && ( m_generic == 0x01 || m_generic == 0x02 ); }
 			bool IsAddingNode() const { return m_addingNode; }	/* These three *AddingNode functions are used to tell if we this node is just being discovered. Currently used by the Security CC to initiate the Network Key Exchange */
 			void SetAddingNode() { m_addingNode = true; }
 			void ClearAddingNode() { m_addingNode = false; }
 			bool IsNodeReset();
+
+			// The buttons of a bridge controller, each served by one of its virtual nodes
+			void SetButton( uint8 const _buttonId, uint8 const _virtualNodeId );
+			void RemoveButton( uint8 const _buttonId );
+			bool GetVirtualNodeButton( uint8 const _virtualNodeId, uint8* o_buttonId )const;
+			bool HasButtonsInConfig()const{ return m_buttonsInConfig; }
 		private:
 			bool		m_listening;
 			bool		m_frequentListening;
@@ -333,10 +404,12 @@ namespace OpenZWave
 			uint8		m_generic;
 			uint8		m_specific;
 			string		m_type;					// Label representing the specific/generic/basic value
-			uint8		m_neighbors[29];		// Bitmask containing the neighboring nodes
 			uint8		m_numRouteNodes;		// number of node routes
 			uint8		m_routeNodes[5];		// nodes to route to
+			bool		m_routesAssigned;		// m_routeNodes are the return routes the node was given, rather than not known
 			map<uint8,uint8>	m_buttonMap;	// Map button IDs into virtual node numbers
+			map<uint8,uint8>	m_virtualNodeButtons;	// The button ID each virtual node in m_buttonMap serves, so inbound frames need not search
+			bool		m_buttonsInConfig;		// The buttons are saved with the node's configuration, rather than read from zwbutton.xml
 			bool		m_addingNode;
 
 			//-----------------------------------------------------------------------------
@@ -426,12 +499,35 @@ namespace OpenZWave
 			 * \see m_commandClassMap, ValueStore, GetValueStore, ValueStore::RemoveCommandClassValues
 			 */
 			void RemoveCommandClass( uint8 const _commandClassId );
+			/**
+			 * Notes a class listed after the COMMAND_CLASS_MARK without creating its object, which
+			 * AddCommandClass creates when it is needed.  Only done for classes that create no values
+			 * and make no requests of their own.
+			 * \param _commandClassId Class ID (a single byte value) identifying the command class.
+			 * \param _version The version of the class, if known, otherwise 1.
+			 * \param _inNIF True if the class was in the node info frame.
+			 * \return true if the class was noted, or false if it needs an object now.
+			 * \see m_controlledClasses, AddCommandClass
+			 */
+			bool DeferCommandClass( uint8 const _commandClassId, uint8 const _version, bool const _inNIF );
+			bool IsControlledClass( uint8 const _commandClassId, uint8* o_version )const;
 			void ReadXML( TiXmlElement const* _nodeElement );
 			void ReadDeviceProtocolXML( TiXmlElement const* _ccsElement );
-			void ReadCommandClassesXML( TiXmlElement const* _ccsElement );
+			void ReadCommandClassesXML( TiXmlElement const* _ccsElement, bool const _deferConfigParams = false );
 			void WriteXML( TiXmlElement* _nodeElement );
+			void WriteCommandClassesXML( TiXmlElement* _nodeElement );
+			void ReadButtonsXML( TiXmlElement const* _buttonsElement );
+			static bool IsBareAfterMark( TiXmlElement const* _ccElement );
 
 			map<uint8,CommandClass*>		m_commandClassMap;	/**< Map of command class ids and pointers to associated command class objects */
+			CommandClass*					m_commandClasses[256];	/**< The same command class objects indexed by id, so that GetCommandClass is a single lookup.  m_commandClassMap is kept for iterating in id order. */
+
+			struct ControlledClass
+			{
+				uint8	m_version;
+				bool	m_inNIF;
+			};
+			map<uint8,ControlledClass>		m_controlledClasses;	/**< Classes the node only controls, which have no object until a frame for one arrives.  A class is never in both this and m_commandClassMap. */
 			bool							m_secured; /**< Is this Node added Securely */
 			//-----------------------------------------------------------------------------
 			// Basic commands (helpers that go through the basic command class)
@@ -484,9 +580,21 @@ namespace OpenZWave
 			//-----------------------------------------------------------------------------
 		private:
 			bool SetConfigParam( uint8 const _param, int32 _value, uint8 const _size );
+			bool GetConfigParam( uint8 const _param, int32& _value, uint8& _size );	// The value last reported by the device, if there is one
 			void RequestConfigParam( uint8 const _param );
 			bool RequestAllConfigParams( uint32 const _requestFlags );
 
+			/**
+			 * Create the value for a parameter described by the device's config file, if
+			 * it was left uncreated by the LazyConfigParams option.
+			 * \return true if the value was created.
+			 */
+			bool MaterializeConfigParam( uint8 const _param );
+			void MaterializeConfigParams();
+
+			map<uint8,TiXmlElement const*>	m_pendingConfigParams;	// Config file elements of the parameters not created yet, which stay valid until ManufacturerSpecific::UnloadProductXML
+			bool							m_deferConfigParams;	// Set while a config file is read with LazyConfigParams on
+
 			//-----------------------------------------------------------------------------
 			// Dynamic Values (used by query and other command classes for updating)
 			//-----------------------------------------------------------------------------
@@ -504,6 +612,8 @@ namespace OpenZWave
 			string GetGroupLabel( uint8 const _groupIdx );
 			void AddAssociation( uint8 const _groupIdx, uint8 const _targetNodeId, uint8 const _instance = 0x00 );
 			void RemoveAssociation( uint8 const _groupIdx, uint8 const _targetNodeId, uint8 const _instance = 0x00 );
+			uint32 GetAssociations( uint8 const _groupIdx, NodeSet* o_members );
+			uint32 SetAssociations( uint8 const _groupIdx, NodeSet const& _members );
 			void AutoAssociate();
 
 			// The following methods are not exposed
@@ -514,52 +624,23 @@ namespace OpenZWave
 			map<uint8,Group*> m_groups;											// Maps group indices to Group objects.
 
 			//-----------------------------------------------------------------------------
-			// Device Classes (static data read from the device_classes.xml file)
+			// Device Classes (static data from the device_classes.xml file)
 			//-----------------------------------------------------------------------------
 		private:
-			// Container for device class info
-			class DeviceClass
-			{
-				public:
-				DeviceClass( TiXmlElement const* _el );
-				~DeviceClass(){ delete [] m_mandatoryCommandClasses; }
-
-				uint8 const*	GetMandatoryCommandClasses(){ return m_mandatoryCommandClasses; }
-				uint8			GetBasicMapping(){ return m_basicMapping; }
-				string const&	GetLabel(){ return m_label; }
-
-				private:
-				uint8*			m_mandatoryCommandClasses;						// Zero terminated array of mandatory command classes for this device type.
-				uint8			m_basicMapping;									// Command class that COMMAND_CLASS_BASIC maps on to, or zero if there is no mapping.
-				string			m_label;										// Descriptive label for the device.
-			};
-
-			// Container for generic device class info
-			class GenericDeviceClass : public DeviceClass
-			{
-				public:
-					GenericDeviceClass( TiXmlElement const* _el );
-					~GenericDeviceClass();
-
-					DeviceClass* GetSpecificDeviceClass( uint8 const& _specific );
-
-				private:
-					map<uint8,DeviceClass*>	m_specificDeviceClasses;
-			};
-
-
 			bool SetDeviceClasses( uint8 const _basic, uint8 const _generic, uint8 const _specific );	// Set the device class data for the node
 			bool SetPlusDeviceClasses( uint8 const _role, uint8 const _nodeType, uint16 const _deviceType );	// Set the device class data for the node based on the Zwave+ info report
 			bool AddMandatoryCommandClasses( uint8 const* _commandClasses );							// Add mandatory command classes as specified in the device_classes.xml to the node.
-			void ReadDeviceClasses();																	// Read the static device class data from the device_classes.xml file
+			void ReadDeviceClasses();																	// Select the built in device class tables, or an override device_classes.xml in the user path
+			static void UnloadDeviceClasses();															// Free any device class tables loaded from an override file
 			string GetEndPointDeviceClassLabel( uint8 const _generic, uint8 const _specific );
 
-			static bool								s_deviceClassesLoaded;		// True if the xml file has already been loaded
-			static map<uint8,string>				s_basicDeviceClasses;		// Map of basic device classes.
-			static map<uint8,GenericDeviceClass*>	s_genericDeviceClasses;		// Map of generic device classes.
-			static map<uint8,DeviceClass*> 			s_roleDeviceClasses;		// Map of Zwave+ role device classes.
-			static map<uint16,DeviceClass*> 		s_deviceTypeClasses;		// Map of Zwave+ device type device classes.
-			static map<uint8, DeviceClass*>			s_nodeTypes;				// Map of ZWave+ Node Types
+			static bool								s_deviceClassesLoaded;		// True if the device class tables have been selected
+			static Mutex*							s_deviceClassesMutex;		// Lets the first driver thread to need the tables select them while the others wait
+			static DeviceClasses::Table				s_basicDeviceClasses;		// Basic device classes.
+			static DeviceClasses::Table				s_genericDeviceClasses;		// Generic device classes, each with its specific classes.
+			static DeviceClasses::Table				s_roleDeviceClasses;		// Zwave+ role device classes.
+			static DeviceClasses::Table				s_deviceTypeClasses;		// Zwave+ device type device classes.
+			static DeviceClasses::Table				s_nodeTypes;				// ZWave+ Node Types
 
 
 			//-----------------------------------------------------------------------------
@@ -587,29 +668,114 @@ namespace OpenZWave
 					uint32 m_averageRequestRTT;				// ms
 					uint32 m_lastResponseRTT;
 					uint32 m_averageResponseRTT;
+					uint32 m_retryTimeout;				// ms, estimated from the round trip times, or zero if there are none yet
 					uint8 m_quality;					// Node quality measure
 					uint8 m_lastReceivedMessage[254];
 					list<CommandClassData> m_ccData;
+					uint32 m_pollBatches;				// Polls that requested more than one value together
+					uint32 m_pollsCoalesced;			// Frames saved by coalescing polled values
+					uint32 m_reportsCoalesced;			// Reports replaced by a later one while the node was over the InboundRateLimit
+					uint32 m_airtime;					// Estimated radio time used by messages to the node, in ms
+			};
+
+			/** Bytes used by a command class and its values */
+			struct CommandClassMemoryData
+			{
+				uint8 m_commandClassId;
+				uint32 m_commandClass;				// The command class object, without what its subclass adds
+				uint32 m_values;
+				uint32 m_valueCount;
+			};
+
+			/** Bytes used by a node.  The value labels, units and help are shared, so are not included. */
+			struct NodeMemoryData
+			{
+					uint32 m_node;						// The node object, its strings and its tables
+					uint32 m_commandClasses;			// The command class objects
+					uint32 m_values;
+					uint32 m_groups;
+					uint32 m_wakeUpQueue;				// Messages waiting for a sleeping node to wake
+					list<CommandClassMemoryData> m_ccData;
+			};
+
+			/** Percentiles of the round trip times to the node, in milliseconds */
+			struct NodeLatencyData
+			{
+					LatencyHistogram::Summary m_callback;	// From sending a request to the controller's callback
+					LatencyHistogram::Summary m_reply;		// From sending a request to the node's reply
+			};
+
+			/** Time taken by one stage of the node's interview */
+			struct QueryStageData
+			{
+					uint32 m_elapsed;					// ms from reaching the stage until it was over, or until now for the current stage
+					uint32 m_retries;					// Times the stage was retried
+					bool m_visited;						// The stage has been reached since the interview last started
+			};
+
+			/** Time taken by the node's interview, stage by stage */
+			struct NodeQueryStageData
+			{
+					QueryStage m_current;
+					uint32 m_elapsed;					// ms from the start of the interview, or of the stages being queried again, until it was complete, or until now
+					QueryStageData m_stages[QueryStage_Complete];	// Indexed by QueryStage
 			};
 
 			private:
 			void GetNodeStatistics( NodeData* _data );
+			void GetNodeLatencyStatistics( NodeLatencyData* _data );
+			void GetNodeMemoryStatistics( NodeMemoryData* _data );
+			void GetNodeQueryStageStatistics( NodeQueryStageData* _data );
+			void TimeQueryStage();				// Closes the stage just left and starts timing the current one, if m_queryStage has changed
 
-			uint32 m_sentCnt;				// Number of messages sent from this node.
-			uint32 m_sentFailed;				// Number of sent messages failed
-			uint32 m_retries;				// Number of message retries
-			uint32 m_receivedCnt;				// Number of messages received from this node.
-			uint32 m_receivedDups;				// Number of duplicated messages received;
-			uint32 m_receivedUnsolicited;			// Number of messages received unsolicited
-			uint32 m_lastRequestRTT;			// Last message request RTT
-			uint32 m_lastResponseRTT;			// Last message response RTT
+			// The message counters and round trip times are kept by the driver, in Driver::NodeCounters
 			TimeStamp m_sentTS;				// Last message sent time
 			TimeStamp m_receivedTS;				// Last message received time
-			uint32 m_averageRequestRTT;			// Average Request round trip time.
-			uint32 m_averageResponseRTT;			// Average Response round trip time.
-			uint8 m_quality;				// Node quality measure
+			int32 m_smoothedRTT;				// Smoothed round trip time, in eighths of a ms
+			int32 m_rttVariation;				// Mean deviation of the round trip time, in quarters of a ms
 			uint8 m_lastReceivedMessage[254];		// Place to hold last received message
+			uint8 m_lastReceivedLength;			// Bytes of m_lastReceivedMessage in use
+			struct RecentFrame
+			{
+				uint32 m_hash;				// Fnv1a of the frame's length and payload
+				uint32 m_time;				// When it arrived, in ms since the driver started, or 0 if the entry is unused
+				uint8 m_commandClassId;
+				uint8 m_command;
+			};
+			RecentFrame m_recentFrames[8];			// The last frame received of each of a few command classes and commands, so a duplicate is caught even if other kinds came in between
+			uint8 m_nextRecentFrame;			// The entry of m_recentFrames to overwrite next
 			uint8 m_errors;					// Count errors for dead node detection
+			uint8 m_deliveryRun;				// Sends in a row that the controller reported as delivered, up to 255
+			LatencyHistogram m_callbackLatency;		// Request round trip times
+			LatencyHistogram m_replyLatency;		// Response round trip times
+			TimeStamp m_interviewStart;			// When the interview, or the stages being queried again, started
+			TimeStamp m_stageStart;				// When m_timedStage was reached
+			QueryStage m_timedStage;			// The stage being timed
+			uint32 m_interviewElapsed;			// ms the interview took, once it is complete
+			QueryStageData m_stageData[QueryStage_Complete];
+
+			//-----------------------------------------------------------------------------
+			//	Inbound rate limiting
+			//-----------------------------------------------------------------------------
+			private:
+			// A report held back while the node sends more than the InboundRateLimit option allows
+			struct HeldFrame
+			{
+				uint64			m_key;			// Reports with the same key replace each other
+				vector<uint8>	m_data;
+				bool			m_encrypted;
+			};
+
+			void HandleFrame( uint8 const* _data, bool encrypted );
+			void RefillRxCredit();
+			bool TakeRxCredit();				// Refills the node's allowance of reports, and takes one from it if it can
+			int32 ReleaseHeldFrames();			// Handles the held reports the allowance now covers, returning the ms until more can be, or -1 once the node has calmed down
+			static bool GetCoalesceKey( uint8 const* _data, uint64* o_key );
+
+			uint32 m_rxCredit;					// Reports the node may send before it is limited, in thousandths
+			TimeStamp m_rxCreditTime;			// When m_rxCredit was last refilled
+			list<HeldFrame> m_heldFrames;		// In the order their latest reports arrived
+			bool m_flooding;					// The node has gone over its allowance, and has not had time to recover it
 
 			//-----------------------------------------------------------------------------
 			//	Encryption Related
@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+//
+//	NodeTable.h
+//
+//	A table indexed by node ID, allocated in pages as they are used
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NodeTable_H
+#define _NodeTable_H
+
+#include <string.h>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief A table with an entry for every 16 bit node ID.
+	 *
+	 * Z-Wave Long Range numbers its nodes from 256 upward, while a network uses few of
+	 * the 65536 IDs.  The table is split into pages of 256 entries, and a page is only
+	 * allocated when an entry in it is first written.  Nodes 1-232 and a few Long
+	 * Range nodes take two pages.  Reading an entry of a page that has not been
+	 * allocated gives a default constructed value, without allocating the page.
+	 *
+	 * Writing an entry may allocate its page, so the table needs the same locking as
+	 * an array would, with writers excluding readers.  Pages are only freed with the table.
+	 */
+	template<class T> class NodeTable
+	{
+	public:
+		enum
+		{
+			PageSize	= 256,
+			NumPages	= 65536 / PageSize
+		};
+
+		NodeTable()
+		{
+			memset( m_pages, 0, sizeof(m_pages) );
+		}
+
+		~NodeTable()
+		{
+			for( uint32 i = 0; i < NumPages; ++i )
+			{
+				delete [] m_pages[i];
+			}
+		}
+
+		/** \return the entry for a node, read only. */
+		T const& operator[]( uint16 const _nodeId )const
+		{
+			T const* page = m_pages[_nodeId / PageSize];
+			return page ? page[_nodeId % PageSize] : s_empty;
+		}
+
+		/** \return the entry for a node, to be written.  Its page is allocated if need be. */
+		T& At( uint16 const _nodeId )
+		{
+			T*& page = m_pages[_nodeId / PageSize];
+			if( !page )
+			{
+				page = new T[PageSize]();
+			}
+			return page[_nodeId % PageSize];
+		}
+
+		/** \return the number of pages allocated. */
+		uint32 GetNumPages()const
+		{
+			uint32 count = 0;
+			for( uint32 i = 0; i < NumPages; ++i )
+			{
+				if( m_pages[i] )
+				{
+					++count;
+				}
+			}
+			return count;
+		}
+
+	private:
+		NodeTable( NodeTable const& );					// prevent copy
+		NodeTable& operator = ( NodeTable const& );		// prevent assignment
+
+		T*			m_pages[NumPages];
+		static T	s_empty;
+	};
+
+	template<class T> T NodeTable<T>::s_empty = T();
+
+} // namespace OpenZWave
+
+#endif //_NodeTable_H
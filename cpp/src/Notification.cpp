@@ -28,9 +28,56 @@
 #include "Defs.h"
 #include "Notification.h"
 #include "Driver.h"
+#include "platform/MemoryPool.h"
 
 using namespace OpenZWave;
 
+// Freed notifications kept for reuse
+static MemoryPool s_notificationPool( sizeof(Notification), 256 );
+
+//-----------------------------------------------------------------------------
+// <Notification::operator new>
+// Allocate a notification from the pool
+//-----------------------------------------------------------------------------
+void* Notification::operator new
+(
+	size_t _size
+)
+{
+	return s_notificationPool.Allocate( _size );
+}
+
+//-----------------------------------------------------------------------------
+// <Notification::operator delete>
+// Return a notification to the pool
+//-----------------------------------------------------------------------------
+void Notification::operator delete
+(
+	void* _ptr,
+	size_t _size
+)
+{
+	s_notificationPool.Free( _ptr, _size );
+}
+
+
+//-----------------------------------------------------------------------------
+// <Notification::AddValueId>
+// Add a value to a Type_ValuesAdded notification
+//-----------------------------------------------------------------------------
+void Notification::AddValueId
+(
+	ValueID const& _valueId
+)
+{
+	assert( Type_ValuesAdded == m_type );
+	if( !m_valueIds )
+	{
+		m_valueIds = new vector<ValueID>();
+		m_valueId = _valueId;
+	}
+	m_valueIds->push_back( _valueId );
+}
 
 //-----------------------------------------------------------------------------
 // <Notification::GetAsString>
@@ -141,6 +188,12 @@ string Notification::GetAsString() const {
 				case Code_Alive:
 					str = "Notification - Node Alive";
 					break;
+				case Code_Flooding:
+					str = "Notification - Node Flooding";
+					break;
+				case Code_Expired:
+					str = "Notification - Message Expired";
+					break;
 			}
 			break;
 		case Type_DriverRemoved:
@@ -226,6 +279,33 @@ string Notification::GetAsString() const {
 			case Type_NodeReset:
 				str = "Node Reset";
 				break;
+			case Type_ConfigSaved:
+				str = "Config Saved";
+				break;
+			case Type_ConfigProvisioning:
+				str = "Config Provisioning";
+				break;
+			case Type_DoorLockLogRecords:
+				str = "Door Lock Log Records";
+				break;
+			case Type_NetworkHealthScan:
+				str = "Network Health Scan";
+				break;
+			case Type_RefreshRoundComplete:
+				str = "Refresh Round Complete";
+				break;
+			case Type_ValuesAdded:
+				str = "ValuesAdded";
+				break;
+			case Type_NodeQueryStage:
+				str = "Node Query Stage";
+				break;
+			case Type_FirmwareUpdate:
+				str = "Firmware Update";
+				break;
+			case Type_ControllerNvm:
+				str = "Controller NVM";
+				break;
 	}
 	return str;
 
@@ -28,6 +28,7 @@
 #ifndef _Notification_H
 #define _Notification_H
 
+#include <vector>
 #include "Defs.h"
 #include "value_classes/ValueID.h"
 
@@ -43,11 +44,14 @@ namespace OpenZWave
 	{
 		friend class Manager;
 		friend class Driver;
+		friend class NotificationDispatcher;
 		friend class Node;
 		friend class Group;
 		friend class Value;
 		friend class ValueStore;
 		friend class Basic;
+		friend class DoorLockLogging;
+		friend class FirmwareUpdateMetaData;
 		friend class ManufacturerSpecific;
 		friend class NodeNaming;
 		friend class NoOperation;
@@ -66,7 +70,7 @@ namespace OpenZWave
 		{
 			Type_ValueAdded = 0,				/**< A new node value has been added to OpenZWave's list. These notifications occur after a node has been discovered, and details of its command classes have been received.  Each command class may generate one or more values depending on the complexity of the item being represented.  */
 			Type_ValueRemoved,					/**< A node value has been removed from OpenZWave's list.  This only occurs when a node is removed. */
-			Type_ValueChanged,					/**< A node value has been updated from the Z-Wave network and it is different from the previous value. */
+			Type_ValueChanged,					/**< A node value has been updated from the Z-Wave network and it is different from the previous value.  With the OptimisticSet option, also sent when a set is made, confirmed or rolled back.  See GetValueState. */
 			Type_ValueRefreshed,				/**< A node value has been updated from the Z-Wave network. */
 			Type_Group,							/**< The associations for the node have changed. The application should rebuild any group information it holds about the node. */
 			Type_NodeNew,						/**< A new node has been found (not already stored in zwcfg*.xml file) */
@@ -94,7 +98,16 @@ namespace OpenZWave
 			Type_DriverRemoved,					/**< The Driver is being removed. (either due to Error or by request) Do Not Call Any Driver Related Methods after receiving this call */
 			Type_ControllerCommand,				/**< When Controller Commands are executed, Notifications of Success/Failure etc are communicated via this Notification
 												  * Notification::GetEvent returns Driver::ControllerState and Notification::GetNotification returns Driver::ControllerError if there was a error */
-			Type_NodeReset						/**< The Device has been reset and thus removed from the NodeList in OZW */
+			Type_NodeReset,						/**< The Device has been reset and thus removed from the NodeList in OZW */
+			Type_ConfigSaved,					/**< The network configuration has been written to disk by the background writer (see the BackgroundConfigSave option) */
+			Type_ConfigProvisioning,			/**< Progress of Manager::ProvisionConfigParams on a node.  Sent as each parameter is confirmed or fails, and once all are done. */
+			Type_DoorLockLogRecords,			/**< New records have been read from a lock's log.  Take them with Manager::GetDoorLockLogRecords. */
+			Type_NetworkHealthScan,				/**< A scan started by Manager::BeginNetworkHealthScan has finished.  Read the results with Manager::GetLinkQualities. */
+			Type_RefreshRoundComplete,			/**< A refresh round started by Manager::BeginRefreshRound has finished.  Read its timing with Manager::GetRefreshRoundResult. */
+			Type_ValuesAdded					/**< Several new values of a node's command class have been added.  Sent instead of Type_ValueAdded when the BulkValueAdded option is set.  The values are listed by GetValueIDs, and GetValueID returns the first of them. */,
+			Type_NodeQueryStage,				/**< A stage of a node's interview is over.  GetQueryStage returns the stage.  Read the time each stage took with Manager::GetNodeQueryStageStatistics. */
+			Type_FirmwareUpdate					/**< A firmware update started by Manager::BeginFirmwareUpdate has moved on a stage, or another tenth of the image has been sent.  Read its progress with Manager::GetFirmwareUpdateProgress. */,
+			Type_ControllerNvm					/**< A controller NVM backup or restore started by Manager::BackupControllerNvm or Manager::RestoreControllerNvm has moved on a stage, or another tenth of the NVM has been copied.  Read its progress with Manager::GetControllerNvmProgress. */
 		};
 
 		/**
@@ -110,7 +123,21 @@ namespace OpenZWave
 			Code_Awake,						/**< Report when a sleeping node wakes up */
 			Code_Sleep,						/**< Report when a node goes to sleep */
 			Code_Dead,						/**< Report when a node is presumed dead */
-			Code_Alive						/**< Report when a node is revived */
+			Code_Alive,						/**< Report when a node is revived */
+			Code_Flooding,					/**< Report when a node sends more reports than the InboundRateLimit option allows.  Until it calms down, only the latest report of each of its values is handled. */
+			Code_Expired					/**< Report when a message for a node is dropped unsent, having waited on its queue past its deadline (only with the NotifyExpiredMsgs option) */
+		};
+
+		/**
+		 * Value states.
+		 * Notifications of the type Type_ValueChanged say which of these the value is in.
+		 */
+		enum ValueState
+		{
+			ValueState_Reported = 0,		/**< The value was read from the device */
+			ValueState_Pending,				/**< The value has been set to this, but the device has not yet reported it.  Only sent with the OptimisticSet option. */
+			ValueState_Confirmed,			/**< The device has reported the value a pending set was for */
+			ValueState_RolledBack			/**< A pending set failed, and the value is back to what it was before */
 		};
 
 		/**
@@ -175,16 +202,80 @@ namespace OpenZWave
 		 */
 		uint8 GetByte()const{ return m_byte; }
 
+		/**
+		 * Get the number of configuration parameters still being provisioned.  Only valid in Notification::Type_ConfigProvisioning notifications.
+		 * \return the number of parameters not yet confirmed.  Zero once provisioning of the node is complete.
+		 */
+		uint8 GetProvisionRemaining()const{ assert(Type_ConfigProvisioning==m_type); return m_byte; }
+
+		/**
+		 * Get the number of configuration parameters the device did not take.  Only valid in Notification::Type_ConfigProvisioning notifications.
+		 * \return the number of parameters that could not be set, or were reported with a different value.
+		 */
+		uint8 GetProvisionFailed()const{ assert(Type_ConfigProvisioning==m_type); return m_event; }
+
+		/**
+		 * Get the number of log records read by the fetch that sent this notification.  Only valid in Notification::Type_DoorLockLogRecords notifications.
+		 * \return the number of new records, or 0xff if there were more than 254.
+		 */
+		uint8 GetLogRecordCount()const{ assert(Type_DoorLockLogRecords==m_type); return m_byte; }
+
+		/**
+		 * Get the values that have been added.  Only valid in Notification::Type_ValuesAdded notifications.
+		 * They all belong to the same node, command class and genre.
+		 * \return the value IDs, in the order the values were created.
+		 */
+		vector<ValueID> const& GetValueIDs()const{ assert(Type_ValuesAdded==m_type); return *m_valueIds; }
+
+		/**
+		 * Get the interview stage that is over.  Only valid in Notification::Type_NodeQueryStage notifications.
+		 * \return the stage, as a Node::QueryStage.
+		 */
+		uint8 GetQueryStage()const{ assert(Type_NodeQueryStage==m_type); return m_byte; }
+
+		/**
+		 * Get the stage a firmware update has reached.  Only valid in Notification::Type_FirmwareUpdate notifications.
+		 * \return the stage, as a Driver::FirmwareUpdateState.
+		 */
+		uint8 GetFirmwareUpdateState()const{ assert(Type_FirmwareUpdate==m_type); return m_byte; }
+
+		/**
+		 * Get the percentage of the image sent so far.  Only valid in Notification::Type_FirmwareUpdate notifications.
+		 * \return the percentage, in steps of ten.
+		 */
+		uint8 GetFirmwareUpdatePercent()const{ assert(Type_FirmwareUpdate==m_type); return m_event; }
+
+		/**
+		 * Get the stage a controller NVM backup or restore has reached.  Only valid in Notification::Type_ControllerNvm notifications.
+		 * \return the stage, as a Driver::NvmState.
+		 */
+		uint8 GetControllerNvmState()const{ assert(Type_ControllerNvm==m_type); return m_byte; }
+
+		/**
+		 * Get the percentage of the NVM copied so far.  Only valid in Notification::Type_ControllerNvm notifications.
+		 * \return the percentage, in steps of ten.
+		 */
+		uint8 GetControllerNvmPercent()const{ assert(Type_ControllerNvm==m_type); return m_event; }
+
+		/**
+		 * Get the state of the value.  Only valid in Notification::Type_ValueChanged notifications.
+		 * \return one of the ValueState values.
+		 */
+		uint8 GetValueState()const{ assert(Type_ValueChanged==m_type); return m_byte; }
+
 		/**
 		 * Helper Function to return the Notification as a String
 		 * \return A string representation of this Notification
 		 */
 		string GetAsString()const;
 
+		// Notifications are allocated from a pool, as one is created for every value received
+		static void* operator new( size_t _size );
+		static void operator delete( void* _ptr, size_t _size );
 
 	private:
-		Notification( NotificationType _type ): m_type( _type ), m_byte(0), m_event(0) {}
-		~Notification(){}
+		Notification( NotificationType _type ): m_type( _type ), m_byte(0), m_event(0), m_valueIds(NULL), m_generation(0) {}
+		~Notification(){ delete m_valueIds; }
 
 		void SetHomeAndNodeIds( uint32 const _homeId, uint8 const _nodeId ){ m_valueId = ValueID( _homeId, _nodeId ); }
 		void SetHomeNodeIdAndInstance ( uint32 const _homeId, uint8 const _nodeId, uint32 const _instance ){ m_valueId = ValueID( _homeId, _nodeId, _instance ); }
@@ -194,11 +285,20 @@ namespace OpenZWave
 		void SetSceneId( uint8 const _sceneId ){ assert(Type_SceneEvent==m_type); m_byte = _sceneId; }
 		void SetButtonId( uint8 const _buttonId ){ assert(Type_CreateButton==m_type||Type_DeleteButton==m_type||Type_ButtonOn==m_type||Type_ButtonOff==m_type); m_byte = _buttonId; }
 		void SetNotification( uint8 const _noteId ){ assert((Type_Notification==m_type) || (Type_ControllerCommand == m_type)); m_byte = _noteId; }
+		void SetProvisionProgress( uint8 const _remaining, uint8 const _failed ){ assert(Type_ConfigProvisioning==m_type); m_byte = _remaining; m_event = _failed; }
+		void SetLogRecordCount( uint8 const _count ){ assert(Type_DoorLockLogRecords==m_type); m_byte = _count; }
+		void SetQueryStage( uint8 const _stage ){ assert(Type_NodeQueryStage==m_type); m_byte = _stage; }
+		void SetFirmwareUpdateProgress( uint8 const _state, uint8 const _percent ){ assert(Type_FirmwareUpdate==m_type); m_byte = _state; m_event = _percent; }
+		void SetControllerNvmProgress( uint8 const _state, uint8 const _percent ){ assert(Type_ControllerNvm==m_type); m_byte = _state; m_event = _percent; }
+		void SetValueState( uint8 const _state ){ assert(Type_ValueChanged==m_type); m_byte = _state; }
+		void AddValueId( ValueID const& _valueId );
 
 		NotificationType		m_type;
 		ValueID				m_valueId;
 		uint8				m_byte;
 		uint8				m_event;
+		vector<ValueID>*		m_valueIds;		// Only allocated for Type_ValuesAdded
+		uint32				m_generation;	// ValueStore::GetGeneration when a value notification was queued
 	};
 
 } //namespace OpenZWave
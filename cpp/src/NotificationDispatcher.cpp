@@ -0,0 +1,278 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationDispatcher.cpp
+//
+//	Delivers notifications to the watchers on a thread of its own
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "NotificationDispatcher.h"
+#include "Manager.h"
+#include "Notification.h"
+#include "LatencyHistogram.h"
+#include "platform/Atomic.h"
+#include "platform/Event.h"
+#include "platform/Log.h"
+#include "platform/Thread.h"
+#include "platform/TimeStamp.h"
+#include "platform/Wait.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::NotificationDispatcher>
+// Constructor
+//-----------------------------------------------------------------------------
+NotificationDispatcher::NotificationDispatcher
+(
+		uint32 _capacity,
+		LatencyHistogram* _handlerTime	// = NULL
+):
+	m_pushPos( 0 ),
+	m_popPos( 0 ),
+	m_handlerTime( _handlerTime ),
+	m_thread( new Thread( "notification" ) ),
+	m_dataEvent( new Event() ),
+	m_spaceEvent( new Event() )
+{
+	uint32 capacity = 2;
+	while( capacity < _capacity )
+	{
+		capacity <<= 1;
+	}
+	m_mask = capacity - 1;
+
+	m_cells = new Cell[capacity];
+	for( uint32 i=0; i<capacity; ++i )
+	{
+		m_cells[i].m_sequence = i;
+		m_cells[i].m_notification = NULL;
+	}
+	m_batch = new Notification const*[capacity];
+
+	m_thread->Start( NotificationDispatcher::DispatchThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::~NotificationDispatcher>
+// Destructor
+//-----------------------------------------------------------------------------
+NotificationDispatcher::~NotificationDispatcher
+(
+)
+{
+	m_thread->Stop();
+	m_thread->Release();
+
+	// Anything pushed while the thread was stopping
+	Dispatch();
+
+	m_spaceEvent->Release();
+	m_dataEvent->Release();
+	delete [] m_batch;
+	delete [] m_cells;
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Push>
+// Queue a notification, waiting for room if the ring is full
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::Push
+(
+		Notification* _notification,
+		bool const _signal				// = true
+)
+{
+	if( !TryPush( _notification ) )
+	{
+		Log::Write( LogLevel_Warning, "Notification queue is full, waiting for the watchers to catch up" );
+
+		// Make sure the dispatch thread is emptying the ring
+		m_dataEvent->Set();
+		while( 1 )
+		{
+			m_spaceEvent->Reset();
+			if( TryPush( _notification ) )
+			{
+				break;
+			}
+			Wait::Single( m_spaceEvent, 1000 );
+		}
+	}
+
+	if( _signal )
+	{
+		m_dataEvent->Set();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Signal>
+// Wake the dispatch thread to deliver what has been queued
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::Signal
+(
+)
+{
+	m_dataEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::TryPush>
+// Claim the next free cell and fill it.  Each cell's sequence number says
+// which push position it is ready for, so producers only have to agree on
+// m_pushPos.
+//-----------------------------------------------------------------------------
+bool NotificationDispatcher::TryPush
+(
+		Notification* _notification
+)
+{
+	uint32 pos = AtomicLoad( &m_pushPos );
+	while( 1 )
+	{
+		Cell* cell = &m_cells[pos & m_mask];
+		int32 diff = (int32)( AtomicLoad( &cell->m_sequence ) - pos );
+		if( diff == 0 )
+		{
+			if( AtomicCompareExchange( &m_pushPos, pos, pos + 1 ) )
+			{
+				cell->m_notification = _notification;
+				AtomicStore( &cell->m_sequence, pos + 1 );
+				return true;
+			}
+		}
+		else if( diff < 0 )
+		{
+			// The dispatch thread has not emptied this cell yet
+			return false;
+		}
+		pos = AtomicLoad( &m_pushPos );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Pop>
+// Take the oldest notification, or NULL if nothing has been pushed
+//-----------------------------------------------------------------------------
+Notification* NotificationDispatcher::Pop
+(
+)
+{
+	Cell* cell = &m_cells[m_popPos & m_mask];
+	if( (int32)( AtomicLoad( &cell->m_sequence ) - ( m_popPos + 1 ) ) < 0 )
+	{
+		return NULL;
+	}
+
+	Notification* notification = cell->m_notification;
+	AtomicStore( &cell->m_sequence, m_popPos + m_mask + 1 );
+	++m_popPos;
+	return notification;
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::Dispatch>
+// Deliver everything that has been queued as a single batch
+//-----------------------------------------------------------------------------
+uint32 NotificationDispatcher::Dispatch
+(
+)
+{
+	uint32 count = 0;
+	while( count <= m_mask )
+	{
+		Notification* notification = Pop();
+		if( notification == NULL )
+		{
+			break;
+		}
+		m_batch[count++] = notification;
+	}
+
+	if( count )
+	{
+		m_spaceEvent->Set();
+		TimeStamp start;
+		Manager::Get()->NotifyWatchers( m_batch, count );
+		if( m_handlerTime )
+		{
+			m_handlerTime->Record( -start.TimeRemaining() );
+		}
+		for( uint32 i=0; i<count; ++i )
+		{
+			delete m_batch[i];
+		}
+	}
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::DispatchThreadEntryPoint>
+// Entry point of the dispatch thread
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::DispatchThreadEntryPoint
+(
+		Event* _exitEvent,
+		void* _context
+)
+{
+	NotificationDispatcher* dispatcher = (NotificationDispatcher*)_context;
+	if( dispatcher )
+	{
+		dispatcher->DispatchThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationDispatcher::DispatchThreadProc>
+// Deliver notifications as they are queued
+//-----------------------------------------------------------------------------
+void NotificationDispatcher::DispatchThreadProc
+(
+		Event* _exitEvent
+)
+{
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;
+	waitObjects[1] = m_dataEvent;
+
+	while( 1 )
+	{
+		if( Dispatch() )
+		{
+			continue;
+		}
+
+		// Only sleep once the reset is certain not to have hidden a push
+		m_dataEvent->Reset();
+		if( Dispatch() )
+		{
+			continue;
+		}
+
+		if( Wait::Multiple( waitObjects, 2 ) == 0 )
+		{
+			// Exit has been signalled
+			Dispatch();
+			return;
+		}
+	}
+}
@@ -0,0 +1,102 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationDispatcher.h
+//
+//	Delivers notifications to the watchers on a thread of its own
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NotificationDispatcher_H
+#define _NotificationDispatcher_H
+
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class LatencyHistogram;
+	class Notification;
+	class Thread;
+
+	/** \brief Hands notifications from the driver to the watchers on a separate thread.
+	 *
+	 * Notifications are passed through a fixed size ring that any number of threads may
+	 * push onto without taking a lock.  The dispatch thread takes everything that has
+	 * been queued each time it wakes, and passes it to the watchers as one batch, so a
+	 * slow watcher holds up only the dispatch thread and never the serial I/O.
+	 */
+	class NotificationDispatcher
+	{
+	public:
+		/**
+		 * Constructor.  Starts the dispatch thread.
+		 * \param _capacity number of notifications the ring can hold.  Rounded up to a power of two.
+		 * \param _handlerTime if not NULL, the time the watchers take over each batch is recorded here.
+		 */
+		NotificationDispatcher( uint32 _capacity, LatencyHistogram* _handlerTime = NULL );
+
+		/**
+		 * Destructor.  Delivers anything still queued, then stops the dispatch thread.
+		 */
+		~NotificationDispatcher();
+
+		/**
+		 * Queue a notification for delivery.  If the ring is full, this waits
+		 * for the dispatch thread to make room.
+		 * \param _notification the notification.  The dispatcher deletes it once it has been delivered.
+		 * \param _signal false to leave the dispatch thread asleep, so that several notifications
+		 * can be queued and then delivered as one batch by calling Signal.
+		 */
+		void Push( Notification* _notification, bool const _signal = true );
+
+		/**
+		 * Wake the dispatch thread to deliver the notifications queued with Push.
+		 */
+		void Signal();
+
+	private:
+		struct Cell
+		{
+			volatile uint32	m_sequence;		// Position of the push that may fill this cell next
+			Notification*	m_notification;
+		};
+
+		bool TryPush( Notification* _notification );
+		Notification* Pop();
+		uint32 Dispatch();
+
+		static void DispatchThreadEntryPoint( Event* _exitEvent, void* _context );
+		void DispatchThreadProc( Event* _exitEvent );
+
+		Cell*				m_cells;
+		uint32				m_mask;				// Capacity - 1
+		volatile uint32		m_pushPos;			// Position of the next push
+		uint32				m_popPos;			// Position of the next pop, only used by the dispatch thread
+
+		Notification const**	m_batch;		// Notifications being delivered
+		LatencyHistogram*	m_handlerTime;
+		Thread*				m_thread;
+		Event*				m_dataEvent;		// Signalled when notifications have been queued
+		Event*				m_spaceEvent;		// Signalled when the dispatch thread has emptied some cells
+	};
+
+} // namespace OpenZWave
+
+#endif //_NotificationDispatcher_H
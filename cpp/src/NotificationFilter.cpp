@@ -0,0 +1,162 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationFilter.cpp
+//
+//	Selects the notifications a watcher is called with
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "Defs.h"
+#include "NotificationFilter.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::NotificationFilter>
+// Constructor
+//-----------------------------------------------------------------------------
+NotificationFilter::NotificationFilter
+(
+):
+	m_types( 0 ),
+	m_homeId( 0 ),
+	m_genres( 0 ),
+	m_anyNode( true ),
+	m_anyCommandClass( true )
+{
+	memset( m_nodes, 0, sizeof(m_nodes) );
+	memset( m_commandClasses, 0, sizeof(m_commandClasses) );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::AddType>
+// Accept notifications of a type
+//-----------------------------------------------------------------------------
+void NotificationFilter::AddType
+(
+	Notification::NotificationType const _type
+)
+{
+	m_types |= ( (uint64)1 << _type );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::AddNode>
+// Accept notifications about a node
+//-----------------------------------------------------------------------------
+void NotificationFilter::AddNode
+(
+	uint8 const _nodeId
+)
+{
+	Set( m_nodes, _nodeId );
+	m_anyNode = false;
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::AddCommandClass>
+// Accept value notifications for a command class
+//-----------------------------------------------------------------------------
+void NotificationFilter::AddCommandClass
+(
+	uint8 const _commandClassId
+)
+{
+	Set( m_commandClasses, _commandClassId );
+	m_anyCommandClass = false;
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::AddGenre>
+// Accept value notifications for a genre
+//-----------------------------------------------------------------------------
+void NotificationFilter::AddGenre
+(
+	ValueID::ValueGenre const _genre
+)
+{
+	m_genres |= (uint8)( 1 << _genre );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::IsEmpty>
+// Whether the filter accepts everything
+//-----------------------------------------------------------------------------
+bool NotificationFilter::IsEmpty
+(
+)const
+{
+	return( !m_types && !m_homeId && m_anyNode && m_anyCommandClass && !m_genres );
+}
+
+//-----------------------------------------------------------------------------
+// <NotificationFilter::Matches>
+// Whether a notification passes the filter
+//-----------------------------------------------------------------------------
+bool NotificationFilter::Matches
+(
+	Notification const* _notification
+)const
+{
+	Notification::NotificationType type = _notification->GetType();
+	if( m_types && !( m_types & ( (uint64)1 << type ) ) )
+	{
+		return false;
+	}
+
+	ValueID const& id = _notification->GetValueID();
+	if( m_homeId && ( id.GetHomeId() != m_homeId ) )
+	{
+		return false;
+	}
+
+	if( !m_anyNode && !Test( m_nodes, id.GetNodeId() ) )
+	{
+		return false;
+	}
+
+	switch( type )
+	{
+		case Notification::Type_ValueAdded:
+		case Notification::Type_ValuesAdded:
+		case Notification::Type_ValueRemoved:
+		case Notification::Type_ValueChanged:
+		case Notification::Type_ValueRefreshed:
+		case Notification::Type_PollingDisabled:
+		case Notification::Type_PollingEnabled:
+		{
+			if( !m_anyCommandClass && !Test( m_commandClasses, id.GetCommandClassId() ) )
+			{
+				return false;
+			}
+			if( m_genres && !( m_genres & ( 1 << id.GetGenre() ) ) )
+			{
+				return false;
+			}
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	return true;
+}
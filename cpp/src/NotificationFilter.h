@@ -0,0 +1,112 @@
+//-----------------------------------------------------------------------------
+//
+//	NotificationFilter.h
+//
+//	Selects the notifications a watcher is called with
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _NotificationFilter_H
+#define _NotificationFilter_H
+
+#include "Defs.h"
+#include "Notification.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	/** \brief Describes the notifications a watcher wants, so that the Manager
+	 *    only calls it with those.
+	 *
+	 *    A new filter matches every notification.  Each call narrows it down:
+	 *    a notification must have one of the types added, come from the home ID
+	 *    set and from one of the nodes added.  The command class and genre
+	 *    conditions only apply to notifications about a value (value added,
+	 *    removed, changed or refreshed and polling enabled or disabled); any
+	 *    other notification passes them.  To get only value notifications,
+	 *    add their types as well.
+	 *
+	 *    \code
+	 *    NotificationFilter filter;
+	 *    filter.AddType( Notification::Type_ValueChanged );
+	 *    filter.AddCommandClass( 0x32 );		// Meter
+	 *    Manager::Get()->AddWatcher( OnMeterChanged, context, filter );
+	 *    \endcode
+	 *
+	 *    \see Manager::AddWatcher, Manager::AddBatchWatcher
+	 */
+	class OPENZWAVE_EXPORT NotificationFilter
+	{
+	public:
+		NotificationFilter();
+
+		/**
+		 * Accept notifications of this type.  Until a type is added, all types are accepted.
+		 */
+		void AddType( Notification::NotificationType const _type );
+
+		/**
+		 * Only accept notifications from the driver with this home ID.  Zero accepts any.
+		 */
+		void SetHomeId( uint32 const _homeId ){ m_homeId = _homeId; }
+
+		/**
+		 * Accept notifications about this node.  Until a node is added, all nodes are accepted.
+		 */
+		void AddNode( uint8 const _nodeId );
+
+		/**
+		 * Accept value notifications for this command class.  Until a command class is
+		 * added, values of all command classes are accepted.
+		 */
+		void AddCommandClass( uint8 const _commandClassId );
+
+		/**
+		 * Accept value notifications for this genre.  Until a genre is added, values of
+		 * all genres are accepted.
+		 */
+		void AddGenre( ValueID::ValueGenre const _genre );
+
+		/**
+		 * \return true if the filter accepts every notification.
+		 */
+		bool IsEmpty()const;
+
+		/**
+		 * \return true if the notification passes the filter.
+		 */
+		bool Matches( Notification const* _notification )const;
+
+	private:
+		static bool Test( uint32 const* _set, uint8 const _index ){ return( ( _set[_index >> 5] & ( 1u << ( _index & 31 ) ) ) != 0 ); }
+		static void Set( uint32* _set, uint8 const _index ){ _set[_index >> 5] |= ( 1u << ( _index & 31 ) ); }
+
+		uint64		m_types;						// Bit for each NotificationType, or zero for all
+		uint32		m_homeId;						// Zero for all
+		uint32		m_nodes[8];						// Bit for each node id
+		uint32		m_commandClasses[8];			// Bit for each command class id
+		uint8		m_genres;						// Bit for each ValueGenre, or zero for all
+		bool		m_anyNode;
+		bool		m_anyCommandClass;
+	};
+
+} //namespace OpenZWave
+
+#endif //_NotificationFilter_H
@@ -39,6 +39,7 @@
 using namespace OpenZWave;
 
 Options* Options::s_instance = NULL;
+Options::HandleBase* Options::s_handles = NULL;
 
 //-----------------------------------------------------------------------------
 // <Options::Create>
@@ -92,7 +93,6 @@ Options* Options::Create
 				return NULL;
 			}
 		}
-		FileOps::Destroy();
 		s_instance = new Options( configPath, userPath, _commandLine );
 
 		// Add the default options
@@ -106,6 +106,8 @@ Options* Options::Create
 		s_instance->AddOptionInt(		"SaveLogLevel",				LogLevel_Detail );			// Save (to file) log messages equal to or above LogLevel_Detail
 		s_instance->AddOptionInt(		"QueueLogLevel",			LogLevel_Debug );			// Save (in RAM) log messages equal to or above LogLevel_Debug
 		s_instance->AddOptionInt(		"DumpTriggerLevel",			LogLevel_None );			// Default is to never dump RAM-stored log messages
+		s_instance->AddOptionString(	"NodeLogLevels",			string(""),		false );	// Log level of particular nodes in place of SaveLogLevel, as space separated node=level entries such as "5=9 12=4"
+		s_instance->AddOptionString(	"LogFormat",				string("text"),	false );	// Format of the log file: "text", or "binary" to record the arguments of each entry and format them only when the log is decoded (see BinaryLog)
 
 		s_instance->AddOptionBool(		"Associate",				true );						// Enable automatic association of the controller with group one of every device.
 		s_instance->AddOptionString(	"Exclude",					string(""),		true );		// Remove support for the listed command classes.
@@ -113,18 +115,79 @@ Options* Options::Create
 		s_instance->AddOptionBool(		"NotifyTransactions",		false );					// Notifications when transaction complete is reported.
 		s_instance->AddOptionString(	"Interface",				string(""),		true );		// Identify the serial port to be accessed (TODO: change the code so more than one serial port can be specified and HID)
 		s_instance->AddOptionBool(		"SaveConfiguration",		true );						// Save the XML configuration upon driver close.
+		s_instance->AddOptionString(	"ConfigFormat",				string("xml"),	false );	// Format of the network configuration cache: "xml" (zwcfg_<homeid>.xml) or "binary" (zwcfg_<homeid>.bin, much faster to load)
+		s_instance->AddOptionBool(		"BackgroundConfigSave",		false );					// if true, the network configuration is written to disk by a thread of its own rather than the caller of WriteConfig
+		s_instance->AddOptionInt(		"ConfigPreloadThreads",		4 );						// number of threads that parse the device files of the nodes in the saved configuration at startup, rather than each being read during its node's interview.  0 disables the preload
+		s_instance->AddOptionBool(		"LazyConfigParams",			false );					// if true, the configuration parameters in a device's config file are only created as values when first set, requested or reported, or by RequestAllConfigParams
+		s_instance->AddOptionBool(		"ProductIndex",				false );					// if true, manufacturer_specific.xml and the device files are compiled once into manufacturer_specific.idx in the user path, which is then mapped rather than parsed at startup.  One built into the config path by 'make configindex' is used as well
 		s_instance->AddOptionInt(		"DriverMaxAttempts",		0);
+		s_instance->AddOptionBool(		"ControllerGroups",			false );					// if true, a controller added for a network that another controller already has becomes its standby, sharing out the sending and passing on what it receives, rather than replacing it
 
 		s_instance->AddOptionInt(		"PollInterval",				30000);						// 30 seconds (can easily poll 30 values in this time; ~120 values is the effective limit for 30 seconds)
 		s_instance->AddOptionBool(		"IntervalBetweenPolls",		false );					// if false, try to execute the entire poll list within the PollInterval time frame
 																								// if true, wait for PollInterval milliseconds between polls
 		s_instance->AddOptionBool(		"SuppressValueRefresh",		false );					// if true, notifications for refreshed (but unchanged) values will not be sent
+		s_instance->AddOptionInt(		"RefreshMaxAge",			0 );						// Milliseconds for which a value read from its device is recent enough to answer a refresh or poll of it with a ValueRefreshed notification, rather than asking the device again (0 = always ask)
+		s_instance->AddOptionBool(		"OptimisticSet",			false );					// if true, a value that is set shows its new value at once, with a pending ValueChanged notification, and is confirmed or rolled back once the device reports it or the set fails
+		s_instance->AddOptionInt(		"OptimisticSetTimeout",		10000 );					// Milliseconds an optimistic set waits for the device to report the value before it is rolled back (0 = wait for as long as it takes)
 		s_instance->AddOptionBool(		"PerformReturnRoutes",		true );					// if true, return routes will be updated
 		s_instance->AddOptionString(	"NetworkKey", 				string(""), 			false);
 		s_instance->AddOptionBool(		"RefreshAllUserCodes",		false ); 					// if true, during startup, we refresh all the UserCodes the device reports it supports. If False, we stop after we get the first "Available" slot (Some devices have 250+ usercode slots! - That makes our Session Stage Very Long )
+		s_instance->AddOptionInt(		"UserCodeCacheAge",			0);							// UserCode slots reported within this many seconds, including before a restart, are not read again during startup (0 = read them all)
 		s_instance->AddOptionInt( 		"RetryTimeout", 			RETRY_TIMEOUT);				// How long do we wait to timeout messages sent
+		s_instance->AddOptionBool(		"AdaptiveRetryTimeout",		false);						// if true, the timeout for each node is estimated from its round trip times, with RetryTimeout as the upper limit
+		s_instance->AddOptionBool(		"DeferBackgroundMsgs",		true);						// if true, a query or poll that is only waiting for the node's reply goes back on its queue when a more urgent message is queued, and is sent again after it
+		s_instance->AddOptionInt(		"ConfigProvisionWindow",	2);							// how many configuration parameters ProvisionConfigParams may have outstanding on each node at once
+		s_instance->AddOptionBool(		"SceneMulticast",			false);						// if true, scenes set the switches of several nodes with one multicast, followed by the usual commands to each node
+		s_instance->AddOptionInt(		"DuplicateFrameWindow",		500);						// ms within which a frame that repeats a node's last one with the same command class and command is dropped as a duplicate, such as a routed retransmission (0 = handle them all)
+		s_instance->AddOptionBool(		"CommandClassProfiling",	false);						// if true, the calls into each command class are counted and timed, for Manager::GetCommandClassProfile
+		s_instance->AddOptionInt(		"LivenessInterval",			0);							// Seconds a listening node may be quiet before it is probed with a NoOperation, or sooner if it is usually heard from more often.  Nodes presumed dead are then probed until they answer (0 = no probes)
+		s_instance->AddOptionBool(		"CircuitBreaker",			false);						// if true, messages for a node presumed dead are held rather than dropped, and sent once the node answers one of the probes sent to it
+		s_instance->AddOptionInt(		"ControllerCommandTimeout",	0);							// Seconds a controller command may stay in one state before it is cancelled, or failed if it cannot be (0 = no limit)
+		s_instance->AddOptionInt(		"NeighborRefreshInterval",	0);							// Seconds between rediscoveries of neighbor lists that may be out of date, done one node at a time (0 = only when HealStaleNodes or HealNetwork is called)
+		s_instance->AddOptionInt(		"HealAirtimeShare",			25);						// Most percentage of the network's time Manager::HealNetwork may take, healing one node at a time and waiting for queued messages to be sent (100 = heal each node as soon as the last is done)
+		s_instance->AddOptionString(	"SendShaping",				"",				false);		// Share of the radio's time each queue may use, as space separated queue=percent or queue=percent:burst_ms entries such as "Poll=10 Query=20:2000" (queues not listed are not limited)
+		s_instance->AddOptionString(	"QueueDeadlines",			"",				false);		// Longest time a request for a report may wait on each queue before it is dropped, as space separated queue=ms entries such as "Poll=60000 Query=300000" (queues not listed never drop them)
+		s_instance->AddOptionString(	"QueueAging",				"",				false);		// Longest time the front of the Query or Poll queue may wait before it goes ahead of the busier queues above it, as space separated queue=ms entries such as "Query=30000 Poll=60000" (queues not listed wait their turn)
+		s_instance->AddOptionBool(		"NotifyExpiredMsgs",		false);						// Send a Code_Expired notification for each message dropped past its deadline
+		s_instance->AddOptionBool(		"NoncePrefetch",			false);						// if true, an encrypted message to a node with more encrypted messages queued asks for the node's next nonce, so the next message can be sent without a NonceGet round trip
+		s_instance->AddOptionBool(		"TimeSync",					false);						// if true, the clocks of nodes with the Clock or Time Parameters command class are set once the listening nodes have been queried (see Manager::SyncTime)
+		s_instance->AddOptionInt(		"TimeSyncMaxDrift",			60);						// Seconds the host's local time may move, by daylight saving or an NTP step, before the clocks set by TimeSync or Manager::SyncTime are set again
+		s_instance->AddOptionInt(		"MaxInFlightMsgs",			1);							// How many ZW_SEND_DATA requests to different nodes may be outstanding at once (1 = wait for each one to complete, the maximum is 4)
+		s_instance->AddOptionInt(		"MaxConcurrentInterviews",	0);							// How many nodes may be queried at once, the most urgent (see Manager::SetNodeQueryPriority) going first (0 = no limit)
 		s_instance->AddOptionBool( 		"EnableSIS", 				true);						// Automatically become a SUC if there is no SUC on the network.
 		s_instance->AddOptionBool( 		"AssumeAwake", 				true);						// Assume Devices that Support the Wakeup CC are awake when we first query them....
+		s_instance->AddOptionBool(		"SkipMatchingInterviews",	false);						// Skip the static queries when a node being interviewed again still matches the ids, command classes and versions saved from its last interview
+		s_instance->AddOptionBool(		"ProductDiscoveryCache",	false);						// if true, a node of a product already interviewed takes its command class versions and endpoints from the first node of that product rather than querying them
+		s_instance->AddOptionBool(		"ProductDiscoveryVerify",	true);						// if true, a node that took its versions and endpoints from another node of its product queries them again if its application version turns out to differ
+		s_instance->AddOptionBool(		"ProductSecurityCache",		false);						// if true, a secure node of a product already interviewed takes its secured command classes from the first node of that product, asking for its own only if its application version differs or it sends a secure frame for another class
+		s_instance->AddOptionBool(		"NotificationThread",		false);						// Call the notification watchers from a thread of their own, so they cannot hold up the driver thread
+		s_instance->AddOptionInt(		"ChangeJournalSize",		1024);						// Number of the latest value, node and group changes each driver keeps for Manager::GetChangesSince (0 = none)
+		s_instance->AddOptionBool(		"BulkValueAdded",			false);						// if true, values added one after another to the same command class of a node are reported in one Type_ValuesAdded notification rather than a Type_ValueAdded each
+		s_instance->AddOptionInt(		"NotificationQueueSize",	256);						// How many notifications may wait for the watchers when NotificationThread is set
+		s_instance->AddOptionInt(		"NotificationInterval",		0);							// Shortest time in milliseconds between ValueChanged/ValueRefreshed notifications for any one value, later ones being merged into a single notification (0 = deliver every notification)
+		s_instance->AddOptionInt(		"ValueHistoryDepth",		0);							// How many of the most recent readings of each meter and multilevel sensor value to keep for Manager::GetValueHistory (0 = keep none)
+		s_instance->AddOptionInt(		"InboundRateLimit",			0);							// Reports per minute a node may send before its later reports of the same value replace each other rather than each being handled (0 = no limit)
+		s_instance->AddOptionInt(		"InboundBurst",				10);						// Reports a node may send at once before InboundRateLimit applies
+		s_instance->AddOptionInt(		"DeadbandHeartbeat",		3600);						// Seconds after which a report within a value's deadband (see Manager::SetValueDeadband) is notified anyway (0 = never)
+		s_instance->AddOptionBool(		"MeterAdaptivePolling",		false);						// if true, polled meter readings that count up are polled more often while their rate is changing, and less often while it is steady
+		s_instance->AddOptionInt(		"MeterPollFastest",			30000);						// Shortest time in milliseconds between polls of a meter reading with MeterAdaptivePolling
+		s_instance->AddOptionInt(		"MeterPollSlowest",			900000);					// Longest time in milliseconds between polls of a meter reading with MeterAdaptivePolling
+		s_instance->AddOptionString(	"ControllerTrace",			"",				false);		// if set, everything read from and written to a serial or HID controller is recorded in this file in the user path, for ReplayController
+		s_instance->AddOptionInt(		"TraceReplaySpeed",			1);							// How many times faster than it was recorded ReplayController plays a trace back (0 = as fast as the driver reads it)
+		s_instance->AddOptionString(	"ThreadAffinity",			"",				false);		// CPUs each thread may run on, as space separated name=cpus entries such as "driver=1 SerialController=1 poll=2-3" (Linux only)
+		s_instance->AddOptionString(	"ThreadPriority",			"",				false);		// Scheduling of each thread, as space separated name=fifo:<priority> or name=nice:<value> entries such as "SerialController=fifo:50 poll=nice:10"
+		s_instance->AddOptionBool(		"SerialLowLatency",			false);						// if true, the serial driver is asked to pass on each byte at once (ASYNC_LOW_LATENCY), which takes the 16ms latency timer of FTDI based sticks down to 1ms (Linux only)
+		s_instance->AddOptionBool(		"SharedThreads",			false);						// if true, all drivers share one poll thread, and serial controllers share one read thread (Linux/Unix only), rather than each having their own
+		s_instance->AddOptionBool(		"HotReconnect",				false);						// if true, a controller that drops out, such as a USB stick being reset, is waited for and checked when it comes back, rather than failing the driver (the serial port is opened again as soon as its device reappears on Linux)
+		s_instance->AddOptionBool(		"CachedControllerInit",		false);						// if true, the controller's identity is read from the network configuration at startup rather than asked for, as long as its init data has not changed
+		s_instance->AddOptionString(	"StateHandoffPath",			"",				false);		// if set, a driver being removed leaves a snapshot of its nodes, unsent messages and counters in this folder (such as /dev/shm/), which the next process to start a driver for the network takes over, skipping the queries of the nodes that were complete
+		s_instance->AddOptionInt(		"StateHandoffMaxAge",		300);						// Seconds for which a snapshot left in StateHandoffPath may be taken over, older ones being ignored
+		s_instance->AddOptionString(	"ValueExportPath",			"",				false);		// if set, each driver keeps its numeric values in a table mapped into memory in this folder (such as /dev/shm/), which other processes can map read only and read without calling into the library
+		s_instance->AddOptionInt(		"ValueExportSlots",			4096);						// Number of values the table in ValueExportPath can hold, for each driver
+		s_instance->AddOptionBool(		"ValueLog",					false);						// if true, each value change is appended to zwcfg_0x<homeid>.log in the user path as it happens, and applied over the saved configuration at startup, so the values survive a crash without the configuration being saved
+		s_instance->AddOptionInt(		"ValueLogMaxSize",			262144);					// Bytes the value log may grow by before the configuration is saved and the log started again
+		s_instance->AddOptionBool(		"FastShutdown",				false);						// if true, a driver being removed stops all its threads together, saves through the background writer if there is one, and frees its nodes without a NodeRemoved or ValueRemoved notification for each (DriverRemoved is still sent)
 		s_instance->AddOptionBool(		"NotifyOnDriverUnload",		false);						// Should we send the Node/Value Notifications on Driver Unloading - Read comments in Driver::~Driver() method about possible race conditions
 		s_instance->AddOptionString(	"SecurityStrategy", 		"SUPPORTED", 	false);		// Should we encrypt CC's that are available via both clear text and Security CC?
 		s_instance->AddOptionString(	"CustomSecuredCC", 			"0x62,0x4c,0x63", 	false);	// What List of Custom CC should we always encrypt if SecurityStrategy is CUSTOM
@@ -156,6 +219,9 @@ bool Options::Destroy
 	delete s_instance;
 	s_instance = NULL;
 
+	// FileOps is kept for as long as the options, since the drivers use it to save their configuration
+	FileOps::Destroy();
+
 	return true;
 }
 
@@ -185,6 +251,12 @@ Options::~Options
 (
 )
 {
+	// Send the handles back to their defaults before their options are deleted
+	for( HandleBase* handle = s_handles; handle; handle = handle->m_next )
+	{
+		handle->Resolve( NULL );
+	}
+
 	// Clear the options map
 	while( !m_options.empty() )
 	{
@@ -373,6 +445,12 @@ bool Options::Lock
 	ParseOptionsString( m_commandLine );
 	m_locked = true;
 
+	// The values are final, so the handles can point straight at them
+	for( HandleBase* handle = s_handles; handle; handle = handle->m_next )
+	{
+		handle->Resolve( Find( handle->m_name ) );
+	}
+
 	return true;
 }
 
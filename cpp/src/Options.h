@@ -231,6 +231,53 @@ namespace OpenZWave
 			bool				m_append;
 		};
 
+	public:
+		class HandleBase
+		{
+			friend class Options;
+
+		protected:
+			HandleBase( char const* _name ): m_name( _name ), m_next( s_handles ){ s_handles = this; }
+			virtual ~HandleBase(){}
+			virtual void Resolve( Option const* _option ) = 0;	// NULL when the options are destroyed
+
+			static bool const* ValueOf( Option const* _option, bool const* ){ return _option->m_type == OptionType_Bool ? &_option->m_valueBool : NULL; }
+			static int32 const* ValueOf( Option const* _option, int32 const* ){ return _option->m_type == OptionType_Int ? &_option->m_valueInt : NULL; }
+			static string const* ValueOf( Option const* _option, string const* ){ return _option->m_type == OptionType_String ? &_option->m_valueString : NULL; }
+
+		private:
+			char const*			m_name;
+			HandleBase*			m_next;
+		};
+
+		/**
+		 * \brief An option that is read often, looked up by name only once.
+		 *
+		 * Declare handles at namespace scope, for example
+		 * static Options::Handle<bool> s_suppressValueRefresh( "SuppressValueRefresh", false );
+		 * Lock finds each handle's option, and Get is then a plain read of its value.
+		 * Until the options are locked, or if there is no option of that name and type,
+		 * Get returns the default.
+		 */
+		template <class T> class Handle: public HandleBase
+		{
+		public:
+			Handle( char const* _name, T const& _default ): HandleBase( _name ), m_default( _default ), m_value( &m_default ){}
+			T const& Get()const{ return *m_value; }
+
+		private:
+			virtual void Resolve( Option const* _option )
+			{
+				T const* value = _option ? ValueOf( _option, m_value ) : NULL;
+				m_value = value ? value : &m_default;
+			}
+
+			T					m_default;
+			T const*			m_value;
+		};
+
+	private:
+
 		Options( string const& _configPath, string const& _userPath, string const& _commandLine );	// Constructor, to be called only via the static Create method.
 		~Options();																					// Destructor, to be called only via the static Destroy method.
 
@@ -248,6 +295,7 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		string				m_LocalPath;
 		bool				m_locked;										// If true, the options are final and AddOption can no longer be called.
 		static Options*		s_instance;
+		static HandleBase*	s_handles;										// Every Handle, linked through m_next as they are constructed
 	};
 } // namespace OpenZWave
 
@@ -0,0 +1,584 @@
+//-----------------------------------------------------------------------------
+//
+//	ProductIndex.cpp
+//
+//	Precompiled index of the manufacturer and product database
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include "ProductIndex.h"
+#include "ConfigCache.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+// File layout.  Every number is little endian, and every string is a byte
+// offset into the string table, where it is stored NUL terminated.
+//
+//	"OZWP"				magic
+//	uint32				format version
+//	uint32				size of manufacturer_specific.xml when the index was built
+//	uint32				modification time of manufacturer_specific.xml, or for a
+//						prebuilt index, the hash of its contents
+//	uint32				config path the index was built from, empty if prebuilt
+//	uint32				number of manufacturers, products and device files
+//	uint32				offset and length of the string table
+//	uint32				flags
+//	manufacturers		sorted by id: uint16 id, uint16 unused, uint32 name
+//	products			sorted by manufacturer, type and id: uint16 manufacturer id,
+//						uint16 type, uint16 id, uint16 unused, uint32 name, uint32 index
+//						of the device file or c_noConfig
+//	device files		sorted by path: uint32 path, uint32 size, uint32 modification
+//						time or hash, uint32 offset and length of the ConfigCache
+//						encoded file
+//	string table
+//	encoded device files
+//
+static char const c_magic[4] = { 'O', 'Z', 'W', 'P' };
+static uint32 const c_formatVersion = 2;
+
+static uint32 const c_headerSize = 44;
+static uint32 const c_manufacturerSize = 8;
+static uint32 const c_productSize = 16;
+static uint32 const c_configSize = 20;
+
+static uint32 const c_noConfig = 0xffffffff;
+
+static uint32 const c_flagPrebuilt = 0x01;
+
+namespace
+{
+	uint16 Get16
+	(
+		uint8 const* _data
+	)
+	{
+		return (uint16)( _data[0] | ( _data[1] << 8 ) );
+	}
+
+	uint32 Get32
+	(
+		uint8 const* _data
+	)
+	{
+		return (uint32)_data[0] | ( (uint32)_data[1] << 8 ) | ( (uint32)_data[2] << 16 ) | ( (uint32)_data[3] << 24 );
+	}
+
+	void Put16
+	(
+		vector<uint8>& _data,
+		uint16 _value
+	)
+	{
+		_data.push_back( (uint8)_value );
+		_data.push_back( (uint8)( _value >> 8 ) );
+	}
+
+	void Put32
+	(
+		vector<uint8>& _data,
+		uint32 _value
+	)
+	{
+		for( uint32 i=0; i<4; ++i )
+		{
+			_data.push_back( (uint8)( _value >> ( i * 8 ) ) );
+		}
+	}
+
+	uint64 ProductKey
+	(
+		uint16 _manufacturerId,
+		uint16 _productType,
+		uint16 _productId
+	)
+	{
+		return ( (uint64)_manufacturerId << 32 ) | ( (uint64)_productType << 16 ) | (uint64)_productId;
+	}
+
+	bool CompareEntry
+	(
+		ProductIndex::Entry const& _a,
+		ProductIndex::Entry const& _b
+	)
+	{
+		return ProductKey( _a.m_manufacturerId, _a.m_productType, _a.m_productId ) < ProductKey( _b.m_manufacturerId, _b.m_productType, _b.m_productId );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Collects each distinct string once
+	//-----------------------------------------------------------------------------
+	class StringTable
+	{
+	public:
+		uint32 Add
+		(
+			string const& _str
+		)
+		{
+			map<string,uint32>::iterator it = m_index.find( _str );
+			if( it != m_index.end() )
+			{
+				return it->second;
+			}
+			uint32 offset = (uint32)m_data.size();
+			m_data.insert( m_data.end(), _str.begin(), _str.end() );
+			m_data.push_back( 0 );
+			m_index[_str] = offset;
+			return offset;
+		}
+
+		vector<uint8> const& GetData()const{ return m_data; }
+
+	private:
+		vector<uint8>			m_data;
+		map<string,uint32>		m_index;
+	};
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Build>
+// Compile the product database and device files into an index file
+//-----------------------------------------------------------------------------
+bool ProductIndex::Build
+(
+	string const& _filename,
+	string const& _configPath,
+	map<uint16,string> const& _manufacturers,
+	vector<Entry> const& _products,
+	bool const _prebuilt	// = false
+)
+{
+	StringTable strings;
+	uint32 configPathOffset = strings.Add( _prebuilt ? string() : _configPath );
+
+	vector<Entry> products( _products );
+	sort( products.begin(), products.end(), CompareEntry );
+
+	// Each device file is encoded once, however many products share it
+	map<string,uint32> configs;
+	for( vector<Entry>::const_iterator it = products.begin(); it != products.end(); ++it )
+	{
+		if( !it->m_configPath.empty() )
+		{
+			configs[it->m_configPath] = 0;
+		}
+	}
+
+	vector<uint8> configTable;
+	vector<uint8> blobs;
+	uint32 index = 0;
+	for( map<string,uint32>::iterator it = configs.begin(); it != configs.end(); ++it )
+	{
+		it->second = index++;
+
+		string filename = _configPath + it->first;
+		uint32 size = 0;
+		uint32 modified = 0;
+		vector<uint8> data;
+		TiXmlDocument doc;
+		if( GetFileStamp( filename, _prebuilt, size, modified ) && doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+		{
+			ConfigCache::Encode( doc, data );
+		}
+		else if( _prebuilt )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: ProductIndex::Build - unable to load %s", filename.c_str() );
+			return false;
+		}
+		else
+		{
+			Log::Write( LogLevel_Info, "ProductIndex::Build - unable to load %s", filename.c_str() );
+		}
+
+		Put32( configTable, strings.Add( it->first ) );
+		Put32( configTable, size );
+		Put32( configTable, modified );
+		Put32( configTable, (uint32)blobs.size() );
+		Put32( configTable, (uint32)data.size() );
+		blobs.insert( blobs.end(), data.begin(), data.end() );
+	}
+
+	vector<uint8> manufacturerTable;
+	for( map<uint16,string>::const_iterator it = _manufacturers.begin(); it != _manufacturers.end(); ++it )
+	{
+		Put16( manufacturerTable, it->first );
+		Put16( manufacturerTable, 0 );
+		Put32( manufacturerTable, strings.Add( it->second ) );
+	}
+
+	vector<uint8> productTable;
+	for( vector<Entry>::const_iterator it = products.begin(); it != products.end(); ++it )
+	{
+		Put16( productTable, it->m_manufacturerId );
+		Put16( productTable, it->m_productType );
+		Put16( productTable, it->m_productId );
+		Put16( productTable, 0 );
+		Put32( productTable, strings.Add( it->m_productName ) );
+		Put32( productTable, it->m_configPath.empty() ? c_noConfig : configs[it->m_configPath] );
+	}
+
+	uint32 xmlSize = 0;
+	uint32 xmlModified = 0;
+	if( !GetFileStamp( _configPath + "manufacturer_specific.xml", _prebuilt, xmlSize, xmlModified ) )
+	{
+		return false;
+	}
+
+	uint32 stringsOffset = c_headerSize + (uint32)( manufacturerTable.size() + productTable.size() + configTable.size() );
+	uint32 blobsOffset = stringsOffset + (uint32)strings.GetData().size();
+
+	// The encoded files follow the string table
+	for( uint32 i=0; i<configs.size(); ++i )
+	{
+		uint8* offset = &configTable[i * c_configSize + 12];
+		uint32 value = Get32( offset ) + blobsOffset;
+		for( uint32 j=0; j<4; ++j )
+		{
+			offset[j] = (uint8)( value >> ( j * 8 ) );
+		}
+	}
+
+	vector<uint8> file( c_magic, c_magic + sizeof(c_magic) );
+	Put32( file, c_formatVersion );
+	Put32( file, xmlSize );
+	Put32( file, xmlModified );
+	Put32( file, configPathOffset );
+	Put32( file, (uint32)_manufacturers.size() );
+	Put32( file, (uint32)products.size() );
+	Put32( file, (uint32)configs.size() );
+	Put32( file, stringsOffset );
+	Put32( file, (uint32)strings.GetData().size() );
+	Put32( file, _prebuilt ? c_flagPrebuilt : 0 );
+	file.insert( file.end(), manufacturerTable.begin(), manufacturerTable.end() );
+	file.insert( file.end(), productTable.begin(), productTable.end() );
+	file.insert( file.end(), configTable.begin(), configTable.end() );
+	file.insert( file.end(), strings.GetData().begin(), strings.GetData().end() );
+	file.insert( file.end(), blobs.begin(), blobs.end() );
+
+	// Write it beside the old one, so a reader never maps a partly written index
+	string tmpname = _filename + ".tmp";
+	bool ok = false;
+	if( FILE* out = fopen( tmpname.c_str(), "wb" ) )
+	{
+		ok = ( fwrite( &file[0], 1, file.size(), out ) == file.size() );
+		if( fclose( out ) != 0 )
+		{
+			ok = false;
+		}
+	}
+	if( !ok || !FileOps::ReplaceFile( tmpname, _filename ) )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ProductIndex::Build - could not write %s", _filename.c_str() );
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, "Built the product index %s: %d products, %d device files", _filename.c_str(), (int)products.size(), (int)configs.size() );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::Open>
+// Map an index file, if it is still current
+//-----------------------------------------------------------------------------
+ProductIndex* ProductIndex::Open
+(
+	string const& _filename,
+	string const& _configPath
+)
+{
+	uint32 size = 0;
+	uint8 const* data = FileOps::MapFile( _filename, size );
+	if( data == NULL )
+	{
+		return NULL;
+	}
+
+	uint32 xmlSize;
+	uint32 xmlModified;
+	if( size >= c_headerSize && !memcmp( data, c_magic, sizeof(c_magic) ) && Get32( &data[4] ) == c_formatVersion
+		&& GetFileStamp( _configPath + "manufacturer_specific.xml", ( Get32( &data[40] ) & c_flagPrebuilt ) != 0, xmlSize, xmlModified )
+		&& Get32( &data[8] ) == xmlSize && Get32( &data[12] ) == xmlModified )
+	{
+		ProductIndex* index = new ProductIndex( data, size, _configPath );
+		char const* configPath = index->GetString( Get32( &data[16] ) );
+		if( configPath && ( index->m_prebuilt ? !*configPath : _configPath == configPath ) )
+		{
+			return index;
+		}
+		// Deleting the index unmaps the file
+		delete index;
+		return NULL;
+	}
+
+	FileOps::UnmapFile( data, size );
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::ProductIndex>
+// Constructor
+//-----------------------------------------------------------------------------
+ProductIndex::ProductIndex
+(
+	uint8 const* _data,
+	uint32 const _size,
+	string const& _configPath
+):
+	m_data( _data ),
+	m_size( _size ),
+	m_manufacturerCount( Get32( &_data[20] ) ),
+	m_productCount( Get32( &_data[24] ) ),
+	m_configCount( Get32( &_data[28] ) ),
+	m_stringsOffset( Get32( &_data[32] ) ),
+	m_stringsLength( Get32( &_data[36] ) ),
+	m_prebuilt( ( Get32( &_data[40] ) & c_flagPrebuilt ) != 0 ),
+	m_configPath( _configPath )
+{
+	// Reject tables that do not fit, so the lookups need no further checks
+	uint64 tables = (uint64)c_headerSize + (uint64)m_manufacturerCount * c_manufacturerSize
+		+ (uint64)m_productCount * c_productSize + (uint64)m_configCount * c_configSize;
+	if( tables > m_stringsOffset || (uint64)m_stringsOffset + m_stringsLength > m_size
+		|| m_stringsLength == 0 || m_data[m_stringsOffset + m_stringsLength - 1] != 0 )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: The product index is damaged and will be rebuilt" );
+		m_manufacturerCount = 0;
+		m_productCount = 0;
+		m_configCount = 0;
+		m_stringsLength = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::~ProductIndex>
+// Destructor
+//-----------------------------------------------------------------------------
+ProductIndex::~ProductIndex
+(
+)
+{
+	FileOps::UnmapFile( m_data, m_size );
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetString>
+// Get a string from the string table
+//-----------------------------------------------------------------------------
+char const* ProductIndex::GetString
+(
+	uint32 const _offset
+)const
+{
+	if( _offset >= m_stringsLength )
+	{
+		return NULL;
+	}
+	return (char const*)&m_data[m_stringsOffset + _offset];
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetFileStamp>
+// Get what identifies the version of a file: its size, and its modification
+// time or for a prebuilt index, a hash (32 bit FNV-1a) of its contents
+//-----------------------------------------------------------------------------
+bool ProductIndex::GetFileStamp
+(
+	string const& _filename,
+	bool const _prebuilt,
+	uint32& o_size,
+	uint32& o_stamp
+)
+{
+	if( !_prebuilt )
+	{
+		return FileOps::FileInfo( _filename, o_size, o_stamp );
+	}
+
+	uint8 const* data = FileOps::MapFile( _filename, o_size );
+	if( data == NULL )
+	{
+		return false;
+	}
+
+	uint32 hash = 2166136261u;
+	for( uint32 i=0; i<o_size; ++i )
+	{
+		hash = ( hash ^ data[i] ) * 16777619u;
+	}
+	FileOps::UnmapFile( data, o_size );
+
+	o_stamp = hash;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetManufacturerName>
+// Look up a manufacturer's name
+//-----------------------------------------------------------------------------
+bool ProductIndex::GetManufacturerName
+(
+	uint16 const _manufacturerId,
+	string& _name
+)const
+{
+	uint8 const* table = &m_data[c_headerSize];
+	uint32 low = 0;
+	uint32 high = m_manufacturerCount;
+	while( low < high )
+	{
+		uint32 mid = low + ( high - low ) / 2;
+		uint8 const* record = &table[mid * c_manufacturerSize];
+		uint16 id = Get16( record );
+		if( id < _manufacturerId )
+		{
+			low = mid + 1;
+		}
+		else if( id > _manufacturerId )
+		{
+			high = mid;
+		}
+		else
+		{
+			char const* name = GetString( Get32( &record[4] ) );
+			if( name == NULL )
+			{
+				return false;
+			}
+			_name = name;
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::GetProduct>
+// Look up a product's name and device file
+//-----------------------------------------------------------------------------
+bool ProductIndex::GetProduct
+(
+	uint16 const _manufacturerId,
+	uint16 const _productType,
+	uint16 const _productId,
+	string& _name,
+	string& _configPath
+)const
+{
+	uint8 const* table = &m_data[c_headerSize + m_manufacturerCount * c_manufacturerSize];
+	uint8 const* configs = &table[m_productCount * c_productSize];
+	uint64 key = ProductKey( _manufacturerId, _productType, _productId );
+	uint32 low = 0;
+	uint32 high = m_productCount;
+	while( low < high )
+	{
+		uint32 mid = low + ( high - low ) / 2;
+		uint8 const* record = &table[mid * c_productSize];
+		uint64 recordKey = ProductKey( Get16( record ), Get16( &record[2] ), Get16( &record[4] ) );
+		if( recordKey < key )
+		{
+			low = mid + 1;
+		}
+		else if( recordKey > key )
+		{
+			high = mid;
+		}
+		else
+		{
+			char const* name = GetString( Get32( &record[8] ) );
+			if( name == NULL )
+			{
+				return false;
+			}
+			_name = name;
+			_configPath.clear();
+
+			uint32 config = Get32( &record[12] );
+			if( config < m_configCount )
+			{
+				if( char const* path = GetString( Get32( &configs[config * c_configSize] ) ) )
+				{
+					_configPath = path;
+				}
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ProductIndex::LoadConfig>
+// Decode a device file, unless it has changed since the index was built
+//-----------------------------------------------------------------------------
+bool ProductIndex::LoadConfig
+(
+	string const& _configXML,
+	TiXmlDocument& _doc
+)const
+{
+	uint8 const* table = &m_data[c_headerSize + m_manufacturerCount * c_manufacturerSize + m_productCount * c_productSize];
+	uint32 low = 0;
+	uint32 high = m_configCount;
+	while( low < high )
+	{
+		uint32 mid = low + ( high - low ) / 2;
+		uint8 const* record = &table[mid * c_configSize];
+		char const* path = GetString( Get32( record ) );
+		if( path == NULL )
+		{
+			return false;
+		}
+
+		int cmp = strcmp( path, _configXML.c_str() );
+		if( cmp < 0 )
+		{
+			low = mid + 1;
+		}
+		else if( cmp > 0 )
+		{
+			high = mid;
+		}
+		else
+		{
+			uint32 offset = Get32( &record[12] );
+			uint32 length = Get32( &record[16] );
+			if( length == 0 || (uint64)offset + length > m_size )
+			{
+				return false;
+			}
+
+			uint32 size;
+			uint32 modified;
+			if( !GetFileStamp( m_configPath + _configXML, m_prebuilt, size, modified )
+				|| size != Get32( &record[4] ) || modified != Get32( &record[8] ) )
+			{
+				Log::Write( LogLevel_Detail, "%s has changed since the product index was built", _configXML.c_str() );
+				return false;
+			}
+			return ConfigCache::Decode( &m_data[offset], length, _doc );
+		}
+	}
+	return false;
+}
@@ -0,0 +1,136 @@
+//-----------------------------------------------------------------------------
+//
+//	ProductIndex.h
+//
+//	Precompiled index of the manufacturer and product database
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ProductIndex_H
+#define _ProductIndex_H
+
+#include <string>
+#include <map>
+#include <vector>
+
+#include "Defs.h"
+
+class TiXmlDocument;
+
+namespace OpenZWave
+{
+	/** \brief A compiled form of manufacturer_specific.xml and the device files it refers to.
+	 *
+	 * The index is a single file holding sorted tables of manufacturers and products,
+	 * and each device configuration file already encoded by ConfigCache.  It is mapped
+	 * into memory rather than read, and a device file is only decoded when a node that
+	 * uses it is found, so neither the startup time nor the memory used grows with the
+	 * size of the config folder.  An index is only used while manufacturer_specific.xml
+	 * and the config path are the ones it was built from.  A device file that has
+	 * changed since is loaded from its XML instead.
+	 *
+	 * A prebuilt index is made by the build (the ozwconfigindex tool) once the config
+	 * folder has been checked, and is shipped in that folder.  It is not tied to a
+	 * path, and identifies the files by their size and a hash of their contents
+	 * rather than their modification time, so it survives being copied on install.
+	 */
+	class OPENZWAVE_EXPORT ProductIndex
+	{
+	public:
+		/** A product, as read from manufacturer_specific.xml */
+		struct Entry
+		{
+			uint16	m_manufacturerId;
+			uint16	m_productType;
+			uint16	m_productId;
+			string	m_productName;
+			string	m_configPath;		/**< Device file, relative to the config path.  Empty if there is none. */
+		};
+
+		/**
+		 * Build an index file.
+		 * \param _filename path of the index file to write.
+		 * \param _configPath the config folder holding manufacturer_specific.xml and the device files.
+		 * \param _manufacturers manufacturer names by id.
+		 * \param _products every product.
+		 * \param _prebuilt true to build an index for the config folder itself, to be shipped with it.
+		 * Fails if any device file cannot be loaded.
+		 * \return true if the index was written.
+		 */
+		static bool Build( string const& _filename, string const& _configPath, map<uint16,string> const& _manufacturers, vector<Entry> const& _products, bool const _prebuilt = false );
+
+		/**
+		 * Map an index file into memory.
+		 * \param _filename path of the index file.
+		 * \param _configPath the config folder the index must have been built from, or
+		 * for a prebuilt index, the folder it describes.
+		 * \return the index, or NULL if there is none or it is out of date.
+		 */
+		static ProductIndex* Open( string const& _filename, string const& _configPath );
+
+		~ProductIndex();
+
+		/**
+		 * Look up a manufacturer.
+		 * \param _manufacturerId the manufacturer id.
+		 * \param _name set to the manufacturer's name if it was found.
+		 * \return true if the manufacturer was found.
+		 */
+		bool GetManufacturerName( uint16 const _manufacturerId, string& _name )const;
+
+		/**
+		 * Look up a product.
+		 * \param _manufacturerId, _productType, _productId identify the product.
+		 * \param _name set to the product's name if it was found.
+		 * \param _configPath set to the product's device file if it was found.
+		 * \return true if the product was found.
+		 */
+		bool GetProduct( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, string& _name, string& _configPath )const;
+
+		/**
+		 * Decode a device file.
+		 * \param _configXML the device file, relative to the config path.
+		 * \param _doc the document to fill.
+		 * \return true if the file was in the index and has not changed since.
+		 */
+		bool LoadConfig( string const& _configXML, TiXmlDocument& _doc )const;
+
+	private:
+		ProductIndex( uint8 const* _data, uint32 const _size, string const& _configPath );
+
+		char const* GetString( uint32 const _offset )const;
+		static bool GetFileStamp( string const& _filename, bool const _prebuilt, uint32& o_size, uint32& o_stamp );
+
+		uint8 const*	m_data;					// The mapped file
+		uint32			m_size;
+		uint32			m_manufacturerCount;
+		uint32			m_productCount;
+		uint32			m_configCount;
+		uint32			m_stringsOffset;
+		uint32			m_stringsLength;
+		bool			m_prebuilt;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		string			m_configPath;
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ProductIndex_H
@@ -26,12 +26,15 @@
 //-----------------------------------------------------------------------------
 
 #include <cstring>
+#include <map>
 #include "Manager.h"
+#include "Driver.h"
 #include "platform/Log.h"
 #include "value_classes/Value.h"
 #include "value_classes/ValueID.h"
 #include "Scene.h"
 #include "Options.h"
+#include "platform/FileOps.h"
 
 #include "tinyxml.h"
 
@@ -42,8 +45,9 @@ uint32 const c_sceneVersion = 1;
 //-----------------------------------------------------------------------------
 // Statics
 //-----------------------------------------------------------------------------
-uint8		Scene::s_sceneCnt = 0;
-Scene*		Scene::s_scenes[256] = { 0 };
+map<uint16,Scene*>			Scene::s_scenes;
+multiset< pair<ValueID,uint16> >	Scene::s_valueScenes;
+bool					Scene::s_dirty = false;
 
 //-----------------------------------------------------------------------------
 // <Scene::Scene>
@@ -51,13 +55,13 @@ Scene*		Scene::s_scenes[256] = { 0 };
 //-----------------------------------------------------------------------------
 Scene::Scene
 ( 
-	uint8 const _sceneId
+	uint16 const _sceneId
 ):
 	m_sceneId( _sceneId ),
 	m_label( "" )
 {
 	s_scenes[_sceneId] = this;
-	s_sceneCnt++;
+	s_dirty = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -72,22 +76,28 @@ Scene::~Scene
 	{
 		SceneStorage* ss = m_values.back();
 		m_values.pop_back();
+		s_valueScenes.erase( s_valueScenes.find( pair<ValueID,uint16>( ss->m_id, m_sceneId ) ) );
 		delete ss;
 	}
 
-	s_sceneCnt--;
-	s_scenes[m_sceneId] = NULL;
+	s_scenes.erase( m_sceneId );
+	s_dirty = true;
 }
 
 //-----------------------------------------------------------------------------
 // <Scene::WriteXML>
-// Write ourselves to an XML document
+// Write ourselves to an XML document, if we have changed
 //-----------------------------------------------------------------------------
 void Scene::WriteXML
 (
 	string const& _name
 )
 {
+	if( !s_dirty )
+	{
+		return;
+	}
+
 	char str[16];
 
 	// Create a new XML document to contain the driver configuration
@@ -102,20 +112,16 @@ void Scene::WriteXML
 	snprintf( str, sizeof(str), "%d", c_sceneVersion );
 	scenesElement->SetAttribute( "version", str);
 
-	for( int i = 1; i < 256; i++ )
+	for( map<uint16,Scene*>::iterator it = s_scenes.begin(); it != s_scenes.end(); ++it )
 	{
-		if( s_scenes[i] == NULL )
-		{
-			continue;
-		}
-
+		Scene* scene = it->second;
 		TiXmlElement* sceneElement = new TiXmlElement( "Scene" );
 
-		snprintf( str, sizeof(str), "%d", i );
+		snprintf( str, sizeof(str), "%d", scene->m_sceneId );
 		sceneElement->SetAttribute( "id", str );
-		sceneElement->SetAttribute( "label", s_scenes[i]->m_label.c_str() );
+		sceneElement->SetAttribute( "label", scene->m_label.c_str() );
 
-		for( vector<SceneStorage*>::iterator vt = s_scenes[i]->m_values.begin(); vt != s_scenes[i]->m_values.end(); ++vt )
+		for( vector<SceneStorage*>::iterator vt = scene->m_values.begin(); vt != scene->m_values.end(); ++vt )
 		{
 			TiXmlElement* valueElement = new TiXmlElement( "Value" );
 
@@ -152,7 +158,14 @@ void Scene::WriteXML
 
 	string filename =  userPath + _name;
 
-	doc.SaveFile( filename.c_str() );
+	// Written beside the old file and then moved over it, so a crash leaves one or the other
+	string tmpname = filename + ".tmp";
+	if( !doc.SaveFile( tmpname.c_str() ) || !FileOps::ReplaceFile( tmpname, filename ) )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Failed to save the scenes to %s", filename.c_str() );
+		return;
+	}
+	s_dirty = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -200,13 +213,15 @@ bool Scene::ReadScenes
 	{
 		Scene* scene = NULL;
 
-		if( TIXML_SUCCESS == sceneElement->QueryIntAttribute( "id", &intVal ) )
+		if( TIXML_SUCCESS == sceneElement->QueryIntAttribute( "id", &intVal ) && intVal > 0 && intVal <= 0xffff && Get( (uint16)intVal ) == NULL )
 		{
-			scene = new Scene( (uint8)intVal );
+			scene = new Scene( (uint16)intVal );
 		}
 
 		if( scene == NULL )
 		{
+			Log::Write( LogLevel_Warning, "Scene::ReadScenes - a scene in %s has a missing, invalid or repeated id, and is skipped", filename.c_str() );
+			sceneElement = sceneElement->NextSiblingElement();
 			continue;
 		}
 
@@ -254,13 +269,16 @@ bool Scene::ReadScenes
 				ValueID::ValueType type = Value::GetTypeEnumFromName( valueElement->Attribute( "type" ) );
 				char const* data = valueElement->GetText();
 
-				scene->m_values.push_back( new SceneStorage( ValueID(homeId, nodeId, genre, commandClassId, instance, index, type), data ) );
+				scene->AddValue( ValueID(homeId, nodeId, genre, commandClassId, instance, index, type), data ? data : "" );
 			}
 
 			valueElement = valueElement->NextSiblingElement();
 		}
 		sceneElement = sceneElement->NextSiblingElement();
 	}
+
+	// What was read matches the file
+	s_dirty = false;
 	return true;
 }
 
@@ -270,38 +288,30 @@ bool Scene::ReadScenes
 //-----------------------------------------------------------------------------
 Scene* Scene::Get
 (
-	uint8 const _sceneId
+	uint16 const _sceneId
 )
 {
-	if ( s_scenes[_sceneId] != NULL )
+	map<uint16,Scene*>::iterator it = s_scenes.find( _sceneId );
+	if( it != s_scenes.end() )
 	{
-		return s_scenes[_sceneId];
+		return it->second;
 	}
 	return NULL;
 }
 
 //-----------------------------------------------------------------------------
 // <Scene::GetAllScenes>
-// Return an array of uint8 of used Scene IDs and the count
+// Fill a vector with the used Scene IDs, in order
 //-----------------------------------------------------------------------------
-uint8 Scene::GetAllScenes
+void Scene::GetAllScenes
 (
-	uint8** _sceneIds
+	vector<uint16>* o_sceneIds
 )
 {
-	if( s_sceneCnt > 0 )
+	for( map<uint16,Scene*>::iterator it = s_scenes.begin(); it != s_scenes.end(); ++it )
 	{
-		*_sceneIds = new uint8[s_sceneCnt];
-		int j = 0;
-		for( int i = 1; i < 256; i++ )
-		{
-			if (s_scenes[i] != NULL)
-			{
-				(*_sceneIds)[j++] = s_scenes[i]->m_sceneId;
-			}
-		}
+		o_sceneIds->push_back( it->first );
 	}
-	return s_sceneCnt;
 }
 
 //-----------------------------------------------------------------------------
@@ -315,6 +325,8 @@ bool Scene::AddValue
 )
 {
 	m_values.push_back( new SceneStorage( _valueId, _value ) );
+	s_valueScenes.insert( pair<ValueID,uint16>( _valueId, m_sceneId ) );
+	s_dirty = true;
 	return true;
 }
 
@@ -331,8 +343,10 @@ bool Scene::RemoveValue
 	{
 		if( (*it)->m_id == _valueId )
 		{
+			s_valueScenes.erase( s_valueScenes.find( pair<ValueID,uint16>( _valueId, m_sceneId ) ) );
 			delete *it;
 			m_values.erase( it );
+			s_dirty = true;
 			return true;
 		}
 	}
@@ -341,28 +355,14 @@ bool Scene::RemoveValue
 
 //-----------------------------------------------------------------------------
 // <Scene::RemoveValues>
-// Remove all ValueIDs from given Home ID 
+// Remove all ValueIDs from given Home ID
 //-----------------------------------------------------------------------------
 void Scene::RemoveValues
 (
 	uint32 const _homeId
 )
 {
- again:
-	for( vector<SceneStorage*>::iterator it = m_values.begin(); it != m_values.end(); ++it )
-	{
-		if( (*it)->m_id.GetHomeId() == _homeId )
-		{
-			delete *it;
-			m_values.erase( it );
-			goto again;
-		}
-	}
-	// If the scene is now empty, delete it.
-	if( m_values.empty() )
-	{
-		delete this;
-	}
+	RemoveValues( ValueID( _homeId, (uint64)0 ), ValueID( _homeId, ~(uint64)0 ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -375,28 +375,59 @@ void Scene::RemoveValues
 	uint8 const _nodeId
 )
 {
-	for( int i = 1; i < 256; i++ )
+	// A node's values are ordered together, as the node ID is the top byte of the ID
+	uint64 node = ( (uint64)_nodeId ) << 24;
+	RemoveValues( ValueID( _homeId, node ), ValueID( _homeId, node | 0xffffffff00ffffffULL ) );
+}
+
+//-----------------------------------------------------------------------------
+// <Scene::RemoveValues>
+// Remove the ValueIDs in a range from every scene, found through the index.
+// Scenes left empty are deleted.
+//-----------------------------------------------------------------------------
+void Scene::RemoveValues
+(
+	ValueID const& _first,
+	ValueID const& _last
+)
+{
+	multiset< pair<ValueID,uint16> >::iterator begin = s_valueScenes.lower_bound( pair<ValueID,uint16>( _first, 0 ) );
+	multiset< pair<ValueID,uint16> >::iterator end = s_valueScenes.upper_bound( pair<ValueID,uint16>( _last, 0xffff ) );
+	if( begin == end )
+	{
+		return;
+	}
+
+	set<uint16> sceneIds;
+	for( multiset< pair<ValueID,uint16> >::iterator it = begin; it != end; ++it )
 	{
-		Scene *scene = Scene::Get( i );
-		if( scene != NULL )
+		sceneIds.insert( it->second );
+	}
+	s_valueScenes.erase( begin, end );
+
+	for( set<uint16>::iterator it = sceneIds.begin(); it != sceneIds.end(); ++it )
+	{
+		Scene* scene = Get( *it );
+		size_t kept = 0;
+		for( size_t i = 0; i < scene->m_values.size(); ++i )
 		{
-		again:
-			for( vector<SceneStorage*>::iterator it = scene->m_values.begin(); it != scene->m_values.end(); ++it )
-			{
-				if( (*it)->m_id.GetHomeId() == _homeId && (*it)->m_id.GetNodeId() == _nodeId )
-				{
-					delete *it;
-					scene->m_values.erase( it );
-					goto again;
-				}
-			}
-			// If the scene is now empty, delete it.
-			if( scene->m_values.empty() )
+			ValueID const& id = scene->m_values[i]->m_id;
+			if( !( id < _first ) && !( _last < id ) )
 			{
-				delete scene;
+				delete scene->m_values[i];
+				continue;
 			}
+			scene->m_values[kept++] = scene->m_values[i];
+		}
+		scene->m_values.resize( kept );
+
+		// If the scene is now empty, delete it.
+		if( scene->m_values.empty() )
+		{
+			delete scene;
 		}
 	}
+	s_dirty = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -455,6 +486,7 @@ bool Scene::SetValue
 		if( (*it)->m_id == _valueId )
 		{
 			(*it)->m_value = _value;
+			s_dirty = true;
 			return true;
 		} 
 	}
@@ -470,9 +502,30 @@ bool Scene::Activate
 )
 {
 	bool res = true;
+	bool multicast = false;
+	Options::Get()->GetOptionAsBool( "SceneMulticast", &multicast );
+	if( !multicast )
+	{
+		for( vector<SceneStorage*>::iterator it = m_values.begin(); it != m_values.end(); ++it )
+		{
+			if ( !Manager::Get()->SetValue( (*it)->m_id, (*it)->m_value ) )
+			{
+				res = false;
+			}
+		}
+		return res;
+	}
+
+	// Each network's driver sends what it can as multicasts
+	map< uint32, vector< pair<ValueID,string> > > networks;
 	for( vector<SceneStorage*>::iterator it = m_values.begin(); it != m_values.end(); ++it )
 	{
-		if ( !Manager::Get()->SetValue( (*it)->m_id, (*it)->m_value ) )
+		networks[(*it)->m_id.GetHomeId()].push_back( pair<ValueID,string>( (*it)->m_id, (*it)->m_value ) );
+	}
+	for( map< uint32, vector< pair<ValueID,string> > >::iterator it = networks.begin(); it != networks.end(); ++it )
+	{
+		Driver* driver = Manager::Get()->GetDriver( it->first );
+		if( !driver || !driver->ActivateScene( it->second ) )
 		{
 			res = false;
 		}
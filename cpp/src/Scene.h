@@ -28,18 +28,27 @@
 #ifndef _Scene_H
 #define _Scene_H
 
+#include <map>
+#include <set>
 #include <string>
 #include <vector>
 
 #include "Defs.h"
+#include "value_classes/ValueID.h"
 
 class TiXmlElement;
 
 namespace OpenZWave
 {
-	class ValueID;
-
 	/** \brief Collection of ValueIDs to be treated as a unit.
+	 *
+	 * Scenes are numbered from 1 to 65535, though the Manager's scene functions only
+	 * reach the first 255.  Besides each scene's own list of values, an index of every
+	 * value in every scene, sorted by ValueID, finds the scenes holding a node's values
+	 * when the node is removed, without searching them all.
+	 *
+	 * The scenes are only written to zwscene.xml when they have changed since it was
+	 * read or last written.
 	 */
 	class Scene
 	{
@@ -51,25 +60,25 @@ namespace OpenZWave
 	// Construction
 	//-----------------------------------------------------------------------------
 	private:
-		Scene( uint8 const _sceneId );
+		Scene( uint16 const _sceneId );
 		~Scene();
 
 		static void WriteXML( string const& _name );
 		static bool ReadScenes();
-		
+
 	//-----------------------------------------------------------------------------
 	// Scene functions
 	//-----------------------------------------------------------------------------
 	private:
-		static Scene* Get( uint8 const _sceneId );
-		static uint8 GetAllScenes( uint8** _sceneIds );
+		static Scene* Get( uint16 const _sceneId );
+		static void GetAllScenes( vector<uint16>* o_sceneIds );
 
 		string const& GetLabel()const{ return m_label; }
-		void SetLabel( string const &_label ){ m_label = _label; }
+		void SetLabel( string const &_label ){ m_label = _label; s_dirty = true; }
 
 		bool AddValue( ValueID const& _valueId, string const& _value );
 		bool RemoveValue( ValueID const& _valueId );
-		void RemoveValues( uint32 const _homeId );
+		static void RemoveValues( uint32 const _homeId );
 		static void RemoveValues( uint32 const _homeId, uint8 const _nodeId );
 		int GetValues( vector<ValueID>* o_value );
 		bool GetValue( ValueID const& _valueId, string* o_value );
@@ -89,15 +98,19 @@ namespace OpenZWave
 			ValueID const m_id;
 			string m_value;
 		};
+
+		static void RemoveValues( ValueID const& _first, ValueID const& _last );
+
 	//-----------------------------------------------------------------------------
 	// Member variables
 	//-----------------------------------------------------------------------------
 	private:
-		uint8					m_sceneId;
+		uint16					m_sceneId;
 		string					m_label;
 		vector<SceneStorage*>			m_values;
-		static uint8				s_sceneCnt;
-		static Scene*				s_scenes[256];
+		static map<uint16,Scene*>		s_scenes;
+		static multiset< pair<ValueID,uint16> >	s_valueScenes;		// Each value of each scene, with the scene ID
+		static bool				s_dirty;			// The scenes have changed since zwscene.xml was read or written
 	};
 
 } //namespace OpenZWave
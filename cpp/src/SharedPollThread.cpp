@@ -0,0 +1,219 @@
+//-----------------------------------------------------------------------------
+//
+//	SharedPollThread.cpp
+//
+//	One poll thread shared by all the drivers
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include <vector>
+
+#include "SharedPollThread.h"
+#include "Driver.h"
+#include "Options.h"
+#include "platform/Event.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+
+using namespace OpenZWave;
+
+SharedPollThread* SharedPollThread::s_instance = NULL;
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::Create>
+// Create the shared poll thread if the option asks for it
+//-----------------------------------------------------------------------------
+void SharedPollThread::Create
+(
+)
+{
+	bool shared = false;
+	Options::Get()->GetOptionAsBool( "SharedThreads", &shared );
+	if( shared && !s_instance )
+	{
+		s_instance = new SharedPollThread();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::Destroy>
+// Stop the shared poll thread
+//-----------------------------------------------------------------------------
+void SharedPollThread::Destroy
+(
+)
+{
+	delete s_instance;
+	s_instance = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::SharedPollThread>
+// Constructor
+//-----------------------------------------------------------------------------
+SharedPollThread::SharedPollThread
+(
+):
+	m_mutex( new Mutex() ),
+	m_changedEvent( new Event() ),
+	m_thread( new Thread( "poll" ) )
+{
+	m_thread->Start( SharedPollThread::ThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::~SharedPollThread>
+// Destructor
+//-----------------------------------------------------------------------------
+SharedPollThread::~SharedPollThread
+(
+)
+{
+	m_thread->Stop();
+	m_thread->Release();
+	m_changedEvent->Release();
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::Add>
+// Start polling for a driver
+//-----------------------------------------------------------------------------
+void SharedPollThread::Add
+(
+	Driver* _driver
+)
+{
+	m_mutex->Lock();
+	bool found = false;
+	for( list<Driver*>::iterator it = m_drivers.begin(); it != m_drivers.end(); ++it )
+	{
+		if( *it == _driver )
+		{
+			found = true;
+			break;
+		}
+	}
+	if( !found )
+	{
+		m_drivers.push_back( _driver );
+	}
+	m_mutex->Unlock();
+	m_changedEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::Remove>
+// Stop polling for a driver
+//-----------------------------------------------------------------------------
+void SharedPollThread::Remove
+(
+	Driver* _driver
+)
+{
+	// Steps run under the mutex, so once it is held the driver is not in one.
+	// The thread may still be waiting on the driver's events, but it holds
+	// references to them until the wait is over.
+	m_mutex->Lock();
+	m_drivers.remove( _driver );
+	m_mutex->Unlock();
+	m_changedEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::GetThreadId>
+// Get the operating system's id for the thread
+//-----------------------------------------------------------------------------
+uint64 SharedPollThread::GetThreadId
+(
+)
+{
+	return m_thread->GetId();
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::ThreadEntryPoint>
+// Entry point of the shared poll thread
+//-----------------------------------------------------------------------------
+void SharedPollThread::ThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	SharedPollThread* spt = (SharedPollThread*)_context;
+	if( spt )
+	{
+		spt->ThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SharedPollThread::ThreadProc>
+// Run each driver's poll step, then wait for whichever needs attention first
+//-----------------------------------------------------------------------------
+void SharedPollThread::ThreadProc
+(
+	Event* _exitEvent
+)
+{
+	vector<Wait*> waitObjects;
+	while( true )
+	{
+		waitObjects.clear();
+		waitObjects.push_back( _exitEvent );
+		waitObjects.push_back( m_changedEvent );
+
+		int32 timeout = Wait::Timeout_Infinite;
+		m_mutex->Lock();
+		m_changedEvent->Reset();
+		for( list<Driver*>::iterator it = m_drivers.begin(); it != m_drivers.end(); ++it )
+		{
+			Driver* driver = *it;
+			bool waitForIdle;
+			int32 step = driver->PollStep( &waitForIdle );
+			if( step != Wait::Timeout_Infinite && ( timeout == Wait::Timeout_Infinite || step < timeout ) )
+			{
+				timeout = step;
+			}
+
+			// Referenced, so that a driver removed during the wait can release them
+			driver->m_pollEvent->AddRef();
+			waitObjects.push_back( driver->m_pollEvent );
+			if( waitForIdle )
+			{
+				driver->m_sendIdleEvent->AddRef();
+				waitObjects.push_back( driver->m_sendIdleEvent );
+			}
+		}
+		m_mutex->Unlock();
+
+		int32 res = Wait::Multiple( &waitObjects[0], (uint32)waitObjects.size(), timeout );
+		for( size_t i = 2; i < waitObjects.size(); ++i )
+		{
+			waitObjects[i]->Release();
+		}
+		if( res == 0 )
+		{
+			// Exit has been called
+			return;
+		}
+	}
+}
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+//
+//	SharedPollThread.h
+//
+//	One poll thread shared by all the drivers
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _SharedPollThread_H
+#define _SharedPollThread_H
+
+#include <list>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	class Driver;
+	class Event;
+	class Mutex;
+	class Thread;
+
+	/** \brief Runs the polling of every driver on a single thread.
+	 *
+	 * With the SharedThreads option, drivers do not start a poll thread each.  They
+	 * add themselves here instead, and this thread calls each driver's PollStep in
+	 * turn, then waits on all their poll events at once for as long as the soonest of
+	 * them asked.  A process with many controllers then has one poll thread rather
+	 * than one per controller.
+	 *
+	 * The Manager creates it, if the option is set, and destroys it after the drivers.
+	 */
+	class SharedPollThread
+	{
+	public:
+		/**
+		 * Create the shared poll thread, if the SharedThreads option is set.
+		 */
+		static void Create();
+
+		/**
+		 * Stop the thread.  All drivers must have been removed.
+		 */
+		static void Destroy();
+
+		/**
+		 * \return the shared poll thread, or NULL if drivers poll on threads of their own.
+		 */
+		static SharedPollThread* Get(){ return s_instance; }
+
+		/**
+		 * Start polling for a driver.  Adding a driver again does nothing.
+		 */
+		void Add( Driver* _driver );
+
+		/**
+		 * Stop polling for a driver.  Once this returns, the driver is not touched again.
+		 */
+		void Remove( Driver* _driver );
+
+		/**
+		 * \return the operating system's id for the thread.
+		 */
+		uint64 GetThreadId();
+
+	private:
+		SharedPollThread();
+		~SharedPollThread();
+
+		static void ThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ThreadProc( Event* _exitEvent );
+
+		static SharedPollThread*	s_instance;
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<Driver*>		m_drivers;
+OPENZWAVE_EXPORT_WARNINGS_ON
+		Mutex*				m_mutex;			// Guards m_drivers, and is held while a driver's PollStep runs
+		Event*				m_changedEvent;		// Set when a driver is added or removed
+		Thread*				m_thread;
+	};
+
+} // namespace OpenZWave
+
+#endif //_SharedPollThread_H
@@ -0,0 +1,189 @@
+//-----------------------------------------------------------------------------
+//
+//	SharedString.cpp
+//
+//	A string stored once however many objects hold it
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <set>
+#include <string.h>
+#include "SharedString.h"
+#include "platform/Atomic.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	struct EntryLess
+	{
+		bool operator()( SharedString::Entry const* _a, SharedString::Entry const* _b )const{ return _a->m_text < _b->m_text; }
+	};
+
+	// Entries are added and removed with the mutex locked.  A holder's count is
+	// only ever raised by another holder, so copying needs no lock.  Neither is
+	// ever destroyed, so strings held by static objects can still be released.
+	Mutex* s_poolMutex = new Mutex( false );
+	set<SharedString::Entry*,EntryLess>* s_pool = new set<SharedString::Entry*,EntryLess>();
+}
+
+string const SharedString::s_empty;
+
+//-----------------------------------------------------------------------------
+// <SharedString::SharedString>
+// Constructor
+//-----------------------------------------------------------------------------
+SharedString::SharedString
+(
+	char const* _str
+):
+	m_entry( _str ? Intern( _str, (uint32)strlen( _str ) ) : NULL )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::SharedString>
+// Copy constructor
+//-----------------------------------------------------------------------------
+SharedString::SharedString
+(
+	SharedString const& _other
+):
+	m_entry( _other.m_entry )
+{
+	if( m_entry )
+	{
+		AtomicIncrement( &m_entry->m_refs );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::operator=>
+// Share another string's entry
+//-----------------------------------------------------------------------------
+SharedString& SharedString::operator =
+(
+	SharedString const& _other
+)
+{
+	if( m_entry != _other.m_entry )
+	{
+		if( _other.m_entry )
+		{
+			AtomicIncrement( &_other.m_entry->m_refs );
+		}
+		Release( m_entry );
+		m_entry = _other.m_entry;
+	}
+	return *this;
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::Intern>
+// Find the pool's entry for a text, adding it if there is none
+//-----------------------------------------------------------------------------
+SharedString::Entry* SharedString::Intern
+(
+	char const* _str,
+	uint32 const _length
+)
+{
+	if( _length == 0 )
+	{
+		return NULL;
+	}
+
+	Entry key;
+	key.m_text.assign( _str, _length );
+
+	s_poolMutex->Lock();
+	set<Entry*,EntryLess>::iterator it = s_pool->find( &key );
+	Entry* entry;
+	if( it != s_pool->end() )
+	{
+		entry = *it;
+		AtomicIncrement( &entry->m_refs );
+	}
+	else
+	{
+		entry = new Entry();
+		entry->m_text.swap( key.m_text );
+		entry->m_refs = 1;
+		s_pool->insert( entry );
+	}
+	s_poolMutex->Unlock();
+	return entry;
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::Release>
+// Let go of an entry, removing it from the pool if it was the last holder
+//-----------------------------------------------------------------------------
+void SharedString::Release
+(
+	Entry* _entry
+)
+{
+	if( _entry == NULL )
+	{
+		return;
+	}
+
+	s_poolMutex->Lock();
+	if( AtomicDecrement( &_entry->m_refs ) == 0 )
+	{
+		s_pool->erase( _entry );
+		delete _entry;
+	}
+	s_poolMutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::GetPoolSize>
+// Number of distinct strings held
+//-----------------------------------------------------------------------------
+uint32 SharedString::GetPoolSize
+(
+)
+{
+	s_poolMutex->Lock();
+	uint32 size = (uint32)s_pool->size();
+	s_poolMutex->Unlock();
+	return size;
+}
+
+//-----------------------------------------------------------------------------
+// <SharedString::GetPoolMemoryUsage>
+// Bytes used by the pool, counting four pointers for each node of the set
+//-----------------------------------------------------------------------------
+uint32 SharedString::GetPoolMemoryUsage
+(
+)
+{
+	s_poolMutex->Lock();
+	uint32 bytes = 0;
+	for( set<Entry*,EntryLess>::const_iterator it = s_pool->begin(); it != s_pool->end(); ++it )
+	{
+		bytes += (uint32)( sizeof(Entry) + 4 * sizeof(void*) + (*it)->m_text.capacity() );
+	}
+	s_poolMutex->Unlock();
+	return bytes;
+}
@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+//
+//	SharedString.h
+//
+//	A string stored once however many objects hold it
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _SharedString_H
+#define _SharedString_H
+
+#include <string>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief An immutable string kept in a process wide pool, so equal strings share one copy.
+	 *
+	 * Value labels, units and help texts, and the labels of list items, mostly come from
+	 * the device configuration files, and every node of the same product has the same
+	 * ones.  Held as SharedStrings, each distinct text is stored once, with a count of
+	 * its holders, and freed when the last of them lets go.  Copying a SharedString only
+	 * increments that count.  Making one from a string looks it up in the pool, so it is
+	 * meant for text that is set rarely and read often.
+	 */
+	class OPENZWAVE_EXPORT SharedString
+	{
+	public:
+		SharedString(): m_entry( NULL ){}
+		SharedString( string const& _str ): m_entry( Intern( _str.c_str(), (uint32)_str.length() ) ){}
+		SharedString( char const* _str );
+		SharedString( SharedString const& _other );
+		~SharedString(){ Release( m_entry ); }
+
+		SharedString& operator = ( SharedString const& _other );
+
+		string const& str()const{ return m_entry ? m_entry->m_text : s_empty; }
+		operator string const& ()const{ return str(); }
+		char const* c_str()const{ return str().c_str(); }
+		size_t length()const{ return str().length(); }
+		bool empty()const{ return m_entry == NULL; }
+
+		// Equal texts always share an entry
+		bool operator == ( SharedString const& _other )const{ return m_entry == _other.m_entry; }
+		bool operator != ( SharedString const& _other )const{ return m_entry != _other.m_entry; }
+
+		/**
+		 * \return the number of distinct strings in the pool.
+		 */
+		static uint32 GetPoolSize();
+
+		/**
+		 * \return the bytes used by the pool and the strings in it.
+		 */
+		static uint32 GetPoolMemoryUsage();
+
+		/** The text of a string in the pool and the number of its holders. */
+		struct Entry
+		{
+			string				m_text;
+			volatile uint32		m_refs;
+		};
+
+	private:
+		static Entry* Intern( char const* _str, uint32 const _length );
+		static void Release( Entry* _entry );
+
+		Entry*					m_entry;			// NULL for the empty string
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		static string const		s_empty;
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+	inline bool operator == ( string const& _str, SharedString const& _shared ){ return _str == _shared.str(); }
+	inline bool operator == ( SharedString const& _shared, string const& _str ){ return _str == _shared.str(); }
+
+} // namespace OpenZWave
+
+#endif //_SharedString_H
@@ -0,0 +1,354 @@
+//-----------------------------------------------------------------------------
+//
+//	StateWriter.cpp
+//
+//	Writes structured data as JSON or CBOR, straight into a buffer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "StateWriter.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	// CBOR major types
+	uint8 const c_cborUInt = 0;
+	uint8 const c_cborNegInt = 1;
+	uint8 const c_cborText = 3;
+
+	uint8 const c_cborArray = 0x9f;			// Array of indefinite length
+	uint8 const c_cborMap = 0xbf;			// Map of indefinite length
+	uint8 const c_cborFalse = 0xf4;
+	uint8 const c_cborTrue = 0xf5;
+	uint8 const c_cborNull = 0xf6;
+	uint8 const c_cborBreak = 0xff;			// Ends an item of indefinite length
+
+	char const c_hex[] = "0123456789abcdef";
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::StateWriter>
+// Constructor
+//-----------------------------------------------------------------------------
+StateWriter::StateWriter
+(
+	Format const _format,
+	string* o_buffer
+):
+	m_format( _format ),
+	m_buffer( o_buffer ),
+	m_afterKey( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Separate>
+// Write the comma that comes before a JSON value or key, if one is needed
+//-----------------------------------------------------------------------------
+void StateWriter::Separate
+(
+)
+{
+	if( m_afterKey )
+	{
+		m_afterKey = false;
+		return;
+	}
+	if( !m_empty.empty() )
+	{
+		if( !m_empty.back() && m_format == Format_Json )
+		{
+			m_buffer->push_back( ',' );
+		}
+		m_empty.back() = false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Begin>
+// Start an object or array
+//-----------------------------------------------------------------------------
+void StateWriter::Begin
+(
+	char const _json,
+	uint8 const _cbor
+)
+{
+	Separate();
+	m_buffer->push_back( ( m_format == Format_Json ) ? _json : (char)_cbor );
+	m_empty.push_back( true );
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::End>
+// End the current object or array
+//-----------------------------------------------------------------------------
+void StateWriter::End
+(
+	char const _json
+)
+{
+	m_buffer->push_back( ( m_format == Format_Json ) ? _json : (char)c_cborBreak );
+	if( !m_empty.empty() )
+	{
+		m_empty.pop_back();
+	}
+}
+
+void StateWriter::BeginObject(){ Begin( '{', c_cborMap ); }
+void StateWriter::EndObject(){ End( '}' ); }
+void StateWriter::BeginArray(){ Begin( '[', c_cborArray ); }
+void StateWriter::EndArray(){ End( ']' ); }
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Key>
+// Write the name of the next member of an object
+//-----------------------------------------------------------------------------
+void StateWriter::Key
+(
+	char const* _key
+)
+{
+	String( _key );
+	if( m_format == Format_Json )
+	{
+		m_buffer->push_back( ':' );
+	}
+	m_afterKey = true;
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Head>
+// Write the type and the length or value of a CBOR item
+//-----------------------------------------------------------------------------
+void StateWriter::Head
+(
+	uint8 const _major,
+	uint64 const _value
+)
+{
+	uint8 major = (uint8)( _major << 5 );
+	uint32 bytes;
+	if( _value < 24 )
+	{
+		m_buffer->push_back( (char)( major | (uint8)_value ) );
+		return;
+	}
+	else if( _value <= 0xff )
+	{
+		m_buffer->push_back( (char)( major | 24 ) );
+		bytes = 1;
+	}
+	else if( _value <= 0xffff )
+	{
+		m_buffer->push_back( (char)( major | 25 ) );
+		bytes = 2;
+	}
+	else if( _value <= 0xffffffffULL )
+	{
+		m_buffer->push_back( (char)( major | 26 ) );
+		bytes = 4;
+	}
+	else
+	{
+		m_buffer->push_back( (char)( major | 27 ) );
+		bytes = 8;
+	}
+
+	// Big endian
+	for( uint32 i = bytes; i > 0; --i )
+	{
+		m_buffer->push_back( (char)(uint8)( _value >> ( ( i - 1 ) * 8 ) ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Digits>
+// Write a number in decimal
+//-----------------------------------------------------------------------------
+void StateWriter::Digits
+(
+	uint64 _value
+)
+{
+	char digits[20];
+	uint32 count = 0;
+	do
+	{
+		digits[count++] = (char)( '0' + ( _value % 10 ) );
+		_value /= 10;
+	}
+	while( _value );
+
+	while( count )
+	{
+		m_buffer->push_back( digits[--count] );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::String>
+// Write a string
+//-----------------------------------------------------------------------------
+void StateWriter::String
+(
+	char const* _str,
+	uint32 const _length
+)
+{
+	Separate();
+	if( m_format == Format_Cbor )
+	{
+		Head( c_cborText, _length );
+		m_buffer->append( _str, _length );
+		return;
+	}
+
+	m_buffer->push_back( '"' );
+	uint32 start = 0;
+	for( uint32 i = 0; i < _length; ++i )
+	{
+		uint8 ch = (uint8)_str[i];
+		if( ch >= 0x20 && ch != '"' && ch != '\\' )
+		{
+			continue;
+		}
+
+		// Copy the run of characters that need no escaping in one go
+		m_buffer->append( _str + start, i - start );
+		start = i + 1;
+		m_buffer->push_back( '\\' );
+		switch( ch )
+		{
+			case '"':	m_buffer->push_back( '"' );		break;
+			case '\\':	m_buffer->push_back( '\\' );	break;
+			case '\n':	m_buffer->push_back( 'n' );		break;
+			case '\r':	m_buffer->push_back( 'r' );		break;
+			case '\t':	m_buffer->push_back( 't' );		break;
+			default:
+			{
+				m_buffer->append( "u00" );
+				m_buffer->push_back( c_hex[ch >> 4] );
+				m_buffer->push_back( c_hex[ch & 0x0f] );
+				break;
+			}
+		}
+	}
+	m_buffer->append( _str + start, _length - start );
+	m_buffer->push_back( '"' );
+}
+
+void StateWriter::String
+(
+	char const* _str
+)
+{
+	String( _str ? _str : "", _str ? (uint32)strlen( _str ) : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Int>
+// Write a signed integer
+//-----------------------------------------------------------------------------
+void StateWriter::Int
+(
+	int64 const _value
+)
+{
+	if( _value >= 0 )
+	{
+		UInt( (uint64)_value );
+		return;
+	}
+
+	Separate();
+	// -1 - n, which cannot overflow however negative the value is
+	uint64 magnitude = (uint64)( -( _value + 1 ) );
+	if( m_format == Format_Cbor )
+	{
+		Head( c_cborNegInt, magnitude );
+	}
+	else
+	{
+		m_buffer->push_back( '-' );
+		Digits( magnitude + 1 );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::UInt>
+// Write an unsigned integer
+//-----------------------------------------------------------------------------
+void StateWriter::UInt
+(
+	uint64 const _value
+)
+{
+	Separate();
+	if( m_format == Format_Cbor )
+	{
+		Head( c_cborUInt, _value );
+	}
+	else
+	{
+		Digits( _value );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Bool>
+// Write true or false
+//-----------------------------------------------------------------------------
+void StateWriter::Bool
+(
+	bool const _value
+)
+{
+	Separate();
+	if( m_format == Format_Cbor )
+	{
+		m_buffer->push_back( (char)( _value ? c_cborTrue : c_cborFalse ) );
+	}
+	else
+	{
+		m_buffer->append( _value ? "true" : "false" );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <StateWriter::Null>
+// Write null
+//-----------------------------------------------------------------------------
+void StateWriter::Null
+(
+)
+{
+	Separate();
+	if( m_format == Format_Cbor )
+	{
+		m_buffer->push_back( (char)c_cborNull );
+	}
+	else
+	{
+		m_buffer->append( "null" );
+	}
+}
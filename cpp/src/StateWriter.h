@@ -0,0 +1,96 @@
+//-----------------------------------------------------------------------------
+//
+//	StateWriter.h
+//
+//	Writes structured data as JSON or CBOR, straight into a buffer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _StateWriter_H
+#define _StateWriter_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief Writes objects, arrays, strings and numbers as JSON or CBOR.
+	 *
+	 * Used by Manager::WriteNetworkState.  Everything is appended to the caller's
+	 * buffer as it is written, with numbers formatted in place, so a buffer that is
+	 * reused from one call to the next is only grown when the state is larger than
+	 * it has been before.
+	 *
+	 * In JSON, strings are written as UTF-8 with quotes, backslashes and control
+	 * characters escaped.  In CBOR (RFC 7049), objects and arrays are written with
+	 * indefinite lengths, so they can be written without counting their members first.
+	 *
+	 * Each member of an object is written as a Key followed by its value.
+	 */
+	class StateWriter
+	{
+	public:
+		enum Format
+		{
+			Format_Json = 0,
+			Format_Cbor
+		};
+
+		/**
+		 * \param _format how to write.
+		 * \param o_buffer what is written is appended to it.
+		 */
+		StateWriter( Format const _format, string* o_buffer );
+
+		void BeginObject();
+		void EndObject();
+		void BeginArray();
+		void EndArray();
+
+		/**
+		 * Write the name of the next member of an object.
+		 */
+		void Key( char const* _key );
+
+		void String( char const* _str, uint32 const _length );
+		void String( char const* _str );
+		void String( string const& _str ){ String( _str.c_str(), (uint32)_str.length() ); }
+		void Int( int64 const _value );
+		void UInt( uint64 const _value );
+		void Bool( bool const _value );
+		void Null();
+
+	private:
+		void Separate();											// Write the comma that comes before a JSON value, if one is needed
+		void Begin( char const _json, uint8 const _cbor );
+		void End( char const _json );
+		void Head( uint8 const _major, uint64 const _value );		// The first bytes of a CBOR item
+		void Digits( uint64 _value );
+
+		Format			m_format;
+		string*			m_buffer;
+		vector<bool>	m_empty;			// For each object and array not yet ended, whether nothing has been written in it
+		bool			m_afterKey;			// A key has just been written, so its value needs no comma
+	};
+
+} // namespace OpenZWave
+
+#endif //_StateWriter_H
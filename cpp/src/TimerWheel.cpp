@@ -0,0 +1,222 @@
+//-----------------------------------------------------------------------------
+//
+//	TimerWheel.cpp
+//
+//	Hierarchical timer wheel used to schedule value polling
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "TimerWheel.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::TimerWheel>
+// Constructor
+//-----------------------------------------------------------------------------
+TimerWheel::TimerWheel
+(
+):
+	m_now( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::Insert>
+// Schedule an entry to come due after a number of ticks
+//-----------------------------------------------------------------------------
+void TimerWheel::Insert
+(
+	ValueID const& _id,
+	uint32 _ticks
+)
+{
+	Remove( _id );
+
+	if( _ticks == 0 )
+	{
+		_ticks = 1;
+	}
+	else if( _ticks > MaxTicks )
+	{
+		_ticks = MaxTicks;
+	}
+	Place( _id, m_now + _ticks );
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::Remove>
+// Remove an entry from the wheel
+//-----------------------------------------------------------------------------
+bool TimerWheel::Remove
+(
+	ValueID const& _id
+)
+{
+	map<ValueID,Position>::iterator it = m_index.find( _id );
+	if( it == m_index.end() )
+	{
+		return false;
+	}
+
+	it->second.m_slot->erase( it->second.m_it );
+	m_index.erase( it );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::Advance>
+// Move the wheel on by a number of ticks, collecting the entries that come due
+//-----------------------------------------------------------------------------
+void TimerWheel::Advance
+(
+	uint32 _ticks,
+	list<ValueID>& _due
+)
+{
+	for( ; _ticks > 0; --_ticks )
+	{
+		if( m_index.empty() )
+		{
+			// Nothing is scheduled, so there is nothing to step through
+			m_now += _ticks;
+			break;
+		}
+
+		++m_now;
+
+		// When a level wraps, the next slot of the level above is spread out below it
+		if( ( m_now & ( Level0Size - 1 ) ) == 0 )
+		{
+			Cascade( 0 );
+		}
+
+		list<Entry>& slot = m_level0[m_now & ( Level0Size - 1 )];
+		while( !slot.empty() )
+		{
+			_due.push_back( slot.front().m_id );
+			m_index.erase( slot.front().m_id );
+			slot.pop_front();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::GetTicksToNext>
+// Number of ticks until Advance could have something to return
+//-----------------------------------------------------------------------------
+uint32 TimerWheel::GetTicksToNext
+(
+)const
+{
+	if( m_index.empty() )
+	{
+		return 0;
+	}
+
+	uint32 ticks = 1;
+	for( ; ticks < Level0Size; ++ticks )
+	{
+		uint32 pos = m_now + ticks;
+		if( ( pos & ( Level0Size - 1 ) ) == 0 )
+		{
+			// The first level wraps here, and entries move down from above
+			break;
+		}
+		if( !m_level0[pos & ( Level0Size - 1 )].empty() )
+		{
+			break;
+		}
+	}
+	return ticks;
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::GetSlot>
+// Find the slot that should hold an entry expiring at the given tick
+//-----------------------------------------------------------------------------
+list<TimerWheel::Entry>* TimerWheel::GetSlot
+(
+	uint32 _expires
+)
+{
+	uint32 delta = _expires - m_now;
+	if( delta < Level0Size )
+	{
+		return &m_level0[_expires & ( Level0Size - 1 )];
+	}
+
+	for( uint32 level = 0; level < NumLevels - 1; ++level )
+	{
+		uint32 shift = Level0Bits + level * LevelBits;
+		if( ( level == NumLevels - 2 ) || ( delta < ( 1u << ( shift + LevelBits ) ) ) )
+		{
+			return &m_levels[level][( _expires >> shift ) & ( LevelSize - 1 )];
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::Place>
+// Put an entry into the slot for its expiry tick
+//-----------------------------------------------------------------------------
+void TimerWheel::Place
+(
+	ValueID const& _id,
+	uint32 _expires
+)
+{
+	Position pos;
+	pos.m_slot = GetSlot( _expires );
+	pos.m_it = pos.m_slot->insert( pos.m_slot->end(), Entry( _id, _expires ) );
+	m_index.insert( pair<ValueID,Position>( _id, pos ) );
+}
+
+//-----------------------------------------------------------------------------
+// <TimerWheel::Cascade>
+// Redistribute the current slot of a level into the levels below it
+//-----------------------------------------------------------------------------
+void TimerWheel::Cascade
+(
+	uint32 _level
+)
+{
+	if( _level >= NumLevels - 1 )
+	{
+		return;
+	}
+
+	uint32 shift = Level0Bits + _level * LevelBits;
+	uint32 index = ( m_now >> shift ) & ( LevelSize - 1 );
+	if( index == 0 )
+	{
+		// This level has wrapped too
+		Cascade( _level + 1 );
+	}
+
+	list<Entry> entries;
+	entries.splice( entries.end(), m_levels[_level][index] );
+	for( list<Entry>::iterator it = entries.begin(); it != entries.end(); ++it )
+	{
+		m_index.erase( it->m_id );
+		Place( it->m_id, it->m_expires );
+	}
+}
@@ -0,0 +1,120 @@
+//-----------------------------------------------------------------------------
+//
+//	TimerWheel.h
+//
+//	Hierarchical timer wheel used to schedule value polling
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _TimerWheel_H
+#define _TimerWheel_H
+
+#include <list>
+#include <map>
+
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	/** \brief Schedules ValueIDs to come due after a delay.
+	 *
+	 * The wheel counts time in ticks.  The first level has a slot for each of the next
+	 * 256 ticks, and each further level covers 64 times the span of the one below it.
+	 * Entries are placed in the coarsest level that can hold them, and move down a level
+	 * each time the level below wraps around, so adding, removing and expiring an entry
+	 * costs the same however many entries there are.
+	 */
+	class TimerWheel
+	{
+	public:
+		TimerWheel();
+
+		/**
+		 * Schedule an entry.  An entry that is already scheduled is moved.
+		 * \param _id the ValueID to schedule.
+		 * \param _ticks number of ticks from now until the entry is due (at least one).
+		 */
+		void Insert( ValueID const& _id, uint32 _ticks );
+
+		/**
+		 * Remove an entry from the wheel.
+		 * \return true if the entry was scheduled.
+		 */
+		bool Remove( ValueID const& _id );
+
+		bool Contains( ValueID const& _id )const{ return( m_index.find( _id ) != m_index.end() ); }
+		size_t Size()const{ return m_index.size(); }
+
+		/** \return the current tick, counted from when the wheel was created. */
+		uint32 GetNow()const{ return m_now; }
+
+		/**
+		 * Move the wheel on, collecting the entries that come due.
+		 * \param _ticks number of ticks that have passed.
+		 * \param _due entries that are now due are added to the end of this list, earliest first.
+		 */
+		void Advance( uint32 _ticks, list<ValueID>& _due );
+
+		/**
+		 * Number of ticks to wait before calling Advance again.  This is the time until the
+		 * next entry is due, or until the first level wraps if everything is further away.
+		 * \return the number of ticks, or zero if the wheel is empty.
+		 */
+		uint32 GetTicksToNext()const;
+
+	private:
+		enum
+		{
+			Level0Bits = 8,
+			LevelBits = 6,
+			NumLevels = 4,
+			Level0Size = 1 << Level0Bits,
+			LevelSize = 1 << LevelBits,
+			MaxTicks = ( 1 << ( Level0Bits + ( NumLevels - 1 ) * LevelBits ) ) - 1
+		};
+
+		struct Entry
+		{
+			Entry( ValueID const& _id, uint32 _expires ): m_id( _id ), m_expires( _expires ){}
+
+			ValueID	m_id;
+			uint32	m_expires;
+		};
+
+		struct Position
+		{
+			list<Entry>*			m_slot;
+			list<Entry>::iterator	m_it;
+		};
+
+		list<Entry>* GetSlot( uint32 _expires );
+		void Place( ValueID const& _id, uint32 _expires );
+		void Cascade( uint32 _level );
+
+		uint32					m_now;							// Current tick
+		list<Entry>				m_level0[Level0Size];
+		list<Entry>				m_levels[NumLevels-1][LevelSize];
+		map<ValueID,Position>	m_index;						// Where each entry is held
+	};
+
+} // namespace OpenZWave
+
+#endif //_TimerWheel_H
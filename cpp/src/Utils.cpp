@@ -26,6 +26,7 @@
 //-----------------------------------------------------------------------------
 
 
+#include <string.h>
 #include "Defs.h"
 #include "Utils.h"
 
@@ -119,6 +120,34 @@ void OpenZWave::PrintHex(std::string prefix, uint8_t const *data, uint32 const l
 	Log::Write(LogLevel_Info, "%s: %s", prefix.c_str(), PktToString(data, length).c_str());
 }
 
+char const* OpenZWave::PktToString(uint8 const *data, uint32 const length, char *buf, uint32 const bufSize) {
+	static char const c_hexDigits[] = "0123456789abcdef";
+	if( bufSize == 0 )
+	{
+		return buf;
+	}
+	uint32 pos = 0;
+	for( uint32 i=0; i<length; ++i )
+	{
+		// each byte needs ", 0xNN" (or "0xNN" for the first) plus room for the terminator
+		if( pos + (i ? 6 : 4) >= bufSize )
+		{
+			break;
+		}
+		if( i )
+		{
+			buf[pos++] = ',';
+			buf[pos++] = ' ';
+		}
+		buf[pos++] = '0';
+		buf[pos++] = 'x';
+		buf[pos++] = c_hexDigits[data[i] >> 4];
+		buf[pos++] = c_hexDigits[data[i] & 0x0f];
+	}
+	buf[pos] = '\0';
+	return buf;
+}
+
 string OpenZWave::PktToString(uint8 const *data, uint32 const length) {
 	char byteStr[5];
 	std::string str;
@@ -135,3 +164,38 @@ string OpenZWave::PktToString(uint8 const *data, uint32 const length) {
 	return str;
 
 }
+
+//-----------------------------------------------------------------------------
+// <OpenZWave::AppendHex>
+// Append bytes as hex digits, with no separators
+//-----------------------------------------------------------------------------
+void OpenZWave::AppendHex( uint8 const* _data, uint32 const _length, string& o_str ) {
+	static char const c_hexDigits[] = "0123456789abcdef";
+	for( uint32 i = 0; i < _length; ++i )
+	{
+		o_str += c_hexDigits[_data[i] >> 4];
+		o_str += c_hexDigits[_data[i] & 0x0f];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <OpenZWave::ParseHex>
+// Read bytes written by AppendHex
+//-----------------------------------------------------------------------------
+bool OpenZWave::ParseHex( char const* _str, uint8* o_data, uint32 const _length ) {
+	if( _str == NULL || strlen( _str ) != _length * 2 )
+	{
+		return false;
+	}
+	for( uint32 i = 0; i < _length * 2; ++i )
+	{
+		char c = _str[i];
+		uint8 nibble;
+		if( c >= '0' && c <= '9' )		nibble = (uint8)( c - '0' );
+		else if( c >= 'a' && c <= 'f' )	nibble = (uint8)( c - 'a' + 10 );
+		else if( c >= 'A' && c <= 'F' )	nibble = (uint8)( c - 'A' + 10 );
+		else							return false;
+		o_data[i >> 1] = (uint8)( ( i & 1 ) ? ( o_data[i >> 1] | nibble ) : ( nibble << 4 ) );
+	}
+	return true;
+}
@@ -29,6 +29,7 @@
 #define _Utils_H
 
 #include "platform/Mutex.h"
+#include "platform/RWLock.h"
 #include "platform/Log.h"
 
 #include <string>
@@ -75,6 +76,34 @@ namespace OpenZWave
 	void PrintHex(std::string prefix, uint8_t const *data, uint32 const length);
 	string PktToString(uint8 const *data, uint32 const length);
 
+	/**
+	 * Format a packet as "0x01, 0x02, ..." into a caller supplied buffer without any heap allocation.
+	 * The output is truncated (but always NUL terminated) if the buffer is too small.
+	 * \param data the bytes to format
+	 * \param length the number of bytes
+	 * \param buf the buffer to write into
+	 * \param bufSize the size of buf in bytes
+	 * \return buf, for use directly as a Log::Write argument
+	 */
+	char const* PktToString(uint8 const *data, uint32 const length, char *buf, uint32 const bufSize);
+
+	/**
+	 * Append bytes to a string as two lower case hex digits each, with no separators.
+	 * \param _data the bytes
+	 * \param _length the number of bytes
+	 * \param o_str the string to append to
+	 */
+	void AppendHex( uint8 const* _data, uint32 const _length, string& o_str );
+
+	/**
+	 * Read bytes written by AppendHex.
+	 * \param _str the hex digits
+	 * \param o_data filled with the bytes
+	 * \param _length the number of bytes expected
+	 * \return false if _str is NULL, is not exactly _length bytes long or is not all hex digits
+	 */
+	bool ParseHex( char const* _str, uint8* o_data, uint32 const _length );
+
 	struct LockGuard
 	{
 			LockGuard(Mutex* mutex) : _ref(mutex)
@@ -107,6 +136,66 @@ namespace OpenZWave
 			Mutex* _ref;
 	};
 
+	/**
+	 * Holds the read lock of an RWLock until it goes out of scope.
+	 */
+	struct ReadLockGuard
+	{
+			ReadLockGuard(RWLock* lock) : _ref(lock), _locked(true)
+			{
+				_ref->LockShared();
+			}
+
+			~ReadLockGuard()
+			{
+				Unlock();
+			}
+			void Unlock()
+			{
+				if (_locked)
+				{
+					_ref->UnlockShared();
+					_locked = false;
+				}
+			}
+		private:
+			ReadLockGuard(const ReadLockGuard&);
+			ReadLockGuard& operator = ( ReadLockGuard const& );
+
+			RWLock* _ref;
+			bool _locked;
+	};
+
+	/**
+	 * Holds the write lock of an RWLock until it goes out of scope.
+	 */
+	struct WriteLockGuard
+	{
+			WriteLockGuard(RWLock* lock) : _ref(lock), _locked(true)
+			{
+				_ref->Lock();
+			}
+
+			~WriteLockGuard()
+			{
+				Unlock();
+			}
+			void Unlock()
+			{
+				if (_locked)
+				{
+					_ref->Unlock();
+					_locked = false;
+				}
+			}
+		private:
+			WriteLockGuard(const WriteLockGuard&);
+			WriteLockGuard& operator = ( WriteLockGuard const& );
+
+			RWLock* _ref;
+			bool _locked;
+	};
+
 
 
 } // namespace OpenZWave
@@ -0,0 +1,356 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueLog.cpp
+//
+//	The value changes made since the network configuration was last saved
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "ValueLog.h"
+#include "Checksum.h"
+#include "Utils.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	// The file starts with the magic number, the version and the home ID
+	uint32 const c_headerSize = 10;
+
+	// Each record is a two byte length, the eight byte ID, the value and a two byte CRC
+	uint32 const c_recordOverhead = 12;
+
+	void PutLE( vector<uint8>& _data, uint64 _value, uint32 const _bytes )
+	{
+		for( uint32 i = 0; i < _bytes; ++i )
+		{
+			_data.push_back( (uint8)_value );
+			_value >>= 8;
+		}
+	}
+
+	uint64 GetLE( uint8 const* _data, uint32 const _bytes )
+	{
+		uint64 value = 0;
+		for( uint32 i = _bytes; i > 0; --i )
+		{
+			value = ( value << 8 ) | _data[i-1];
+		}
+		return value;
+	}
+
+	// Read a whole file, or as much of it as can be read
+	void ReadFile( FILE* _file, vector<uint8>& o_data )
+	{
+		uint8 buffer[4096];
+		size_t length;
+		while( ( length = fread( buffer, 1, sizeof(buffer), _file ) ) > 0 )
+		{
+			o_data.insert( o_data.end(), buffer, buffer + length );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::ValueLog>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueLog::ValueLog
+(
+	string const& _filename,
+	uint32 const _homeId
+):
+	m_filename( _filename ),
+	m_homeId( _homeId ),
+	m_mutex( new Mutex( false ) ),
+	m_file( NULL ),
+	m_start( 0 ),
+	m_end( 0 ),
+	m_marked( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::~ValueLog>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueLog::~ValueLog
+(
+)
+{
+	if( m_file )
+	{
+		fclose( m_file );
+	}
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::GetAttribute>
+// The attribute that holds a value
+//-----------------------------------------------------------------------------
+char const* ValueLog::GetAttribute
+(
+	ValueID::ValueType const _type
+)
+{
+	// A list saves the index of its selected item
+	return( ( _type == ValueID::ValueType_List ) ? "vindex" : "value" );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::Open>
+// Read the changes in the log, and ready it for more
+//-----------------------------------------------------------------------------
+bool ValueLog::Open
+(
+	vector<Record>* o_records
+)
+{
+	LockGuard LG( m_mutex );
+	o_records->clear();
+
+	vector<uint8> data;
+	if( FILE* file = fopen( m_filename.c_str(), "rb" ) )
+	{
+		ReadFile( file, data );
+		fclose( file );
+	}
+
+	uint32 length = (uint32)data.size();
+	uint32 pos = 0;
+	if( length >= c_headerSize && GetLE( &data[0], 4 ) == Magic && GetLE( &data[4], 2 ) == Version && GetLE( &data[6], 4 ) == m_homeId )
+	{
+		pos = c_headerSize;
+		while( pos + c_recordOverhead <= length )
+		{
+			uint32 bodyLength = (uint32)GetLE( &data[pos], 2 );
+			if( bodyLength < 8 || pos + 2 + bodyLength + 2 > length )
+			{
+				break;
+			}
+			uint8 const* body = &data[pos+2];
+			if( Crc16Ccitt( body, bodyLength ) != (uint16)GetLE( body + bodyLength, 2 ) )
+			{
+				break;
+			}
+
+			Record record;
+			record.m_id = GetLE( body, 8 );
+			record.m_value.assign( (char const*)body + 8, bodyLength - 8 );
+			o_records->push_back( record );
+			pos += 2 + bodyLength + 2;
+		}
+	}
+	else if( length > 0 )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: %s is not a value log for this network, so it is replaced", m_filename.c_str() );
+	}
+
+	if( pos < length || length == 0 )
+	{
+		// Start again from what could be read, so new records are not
+		// appended after a damaged one
+		if( pos < length && pos > 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Dropped %d bytes that could not be read from the end of %s", length - pos, m_filename.c_str() );
+		}
+		uint32 kept = ( pos > c_headerSize ) ? pos - c_headerSize : 0;
+		if( !Rewrite( kept ? &data[c_headerSize] : NULL, kept ) )
+		{
+			if( m_file )
+			{
+				fclose( m_file );
+				m_file = NULL;
+			}
+			return false;
+		}
+	}
+	else if( ( m_file = fopen( m_filename.c_str(), "ab" ) ) == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Could not open the value log %s", m_filename.c_str() );
+		return false;
+	}
+
+	m_start = 0;
+	m_end = ( pos > c_headerSize ) ? pos - c_headerSize : 0;
+	m_marked = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::Append>
+// Add changes to the end of the log
+//-----------------------------------------------------------------------------
+bool ValueLog::Append
+(
+	vector<Record> const& _records
+)
+{
+	vector<uint8> data;
+	for( vector<Record>::const_iterator it = _records.begin(); it != _records.end(); ++it )
+	{
+		uint32 bodyLength = 8 + (uint32)it->m_value.size();
+		if( bodyLength > 0xffff )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: A value of %d bytes is too long for the value log", (uint32)it->m_value.size() );
+			continue;
+		}
+		size_t body = data.size() + 2;
+		PutLE( data, bodyLength, 2 );
+		PutLE( data, it->m_id, 8 );
+		data.insert( data.end(), it->m_value.begin(), it->m_value.end() );
+		PutLE( data, Crc16Ccitt( &data[body], bodyLength ), 2 );
+	}
+
+	LockGuard LG( m_mutex );
+	if( !m_file || data.empty() )
+	{
+		return false;
+	}
+
+	bool ok = ( fwrite( &data[0], 1, data.size(), m_file ) == data.size() );
+	ok = ( fflush( m_file ) == 0 ) && ok;
+	if( !ok )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Failed to write to the value log %s", m_filename.c_str() );
+	}
+	// Whatever reached the file counts, so later positions still match it
+	m_end += data.size();
+	return ok;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::Mark>
+// Note the end of the log, before a snapshot is built
+//-----------------------------------------------------------------------------
+uint64 ValueLog::Mark
+(
+)
+{
+	LockGuard LG( m_mutex );
+	m_marked = m_end;
+	return m_marked;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::GetUnmarked>
+// The bytes added since the last mark
+//-----------------------------------------------------------------------------
+uint32 ValueLog::GetUnmarked
+(
+)const
+{
+	LockGuard LG( m_mutex );
+	return (uint32)( m_end - m_marked );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::Compact>
+// Drop the records before a mark, which a saved snapshot covers
+//-----------------------------------------------------------------------------
+void ValueLog::Compact
+(
+	uint64 const _mark
+)
+{
+	LockGuard LG( m_mutex );
+	if( !m_file || _mark <= m_start )
+	{
+		return;
+	}
+
+	// Keep the records after the mark
+	vector<uint8> data;
+	if( _mark < m_end )
+	{
+		fflush( m_file );
+		FILE* file = fopen( m_filename.c_str(), "rb" );
+		if( !file || fseek( file, (long)( c_headerSize + _mark - m_start ), SEEK_SET ) != 0 )
+		{
+			if( file )
+			{
+				fclose( file );
+			}
+			Log::Write( LogLevel_Warning, "WARNING: Could not read the value log %s to compact it", m_filename.c_str() );
+			return;
+		}
+		ReadFile( file, data );
+		fclose( file );
+		if( data.size() != m_end - _mark )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Could not read the value log %s to compact it", m_filename.c_str() );
+			return;
+		}
+	}
+
+	if( Rewrite( data.empty() ? NULL : &data[0], (uint32)data.size() ) )
+	{
+		m_start = _mark;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueLog::Rewrite>
+// Replace the file with a header and the given records, and reopen it.
+// Must be called with m_mutex locked.
+//-----------------------------------------------------------------------------
+bool ValueLog::Rewrite
+(
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	vector<uint8> header;
+	PutLE( header, Magic, 4 );
+	PutLE( header, Version, 2 );
+	PutLE( header, m_homeId, 4 );
+
+	string tmpname = m_filename + ".tmp";
+	bool ok = false;
+	if( FILE* file = fopen( tmpname.c_str(), "wb" ) )
+	{
+		ok = ( fwrite( &header[0], 1, header.size(), file ) == header.size() );
+		ok = ok && ( !_length || fwrite( _data, 1, _length, file ) == _length );
+		ok = ( fclose( file ) == 0 ) && ok;
+	}
+
+	// The file is closed while it is replaced, which Windows requires
+	if( m_file )
+	{
+		fclose( m_file );
+	}
+	ok = ok && FileOps::ReplaceFile( tmpname, m_filename );
+	if( !ok )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Failed to rewrite the value log %s", m_filename.c_str() );
+	}
+
+	m_file = fopen( m_filename.c_str(), "ab" );
+	if( !m_file )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Could not open the value log %s", m_filename.c_str() );
+		return false;
+	}
+	return ok;
+}
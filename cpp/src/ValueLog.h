@@ -0,0 +1,127 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueLog.h
+//
+//	The value changes made since the network configuration was last saved
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueLog_H
+#define _ValueLog_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief A file of the value changes made since the configuration was saved.
+	 *
+	 * With the ValueLog option, each driver appends every value change to
+	 * zwcfg_0x<homeid>.log next to its configuration file, as it happens, rather than
+	 * relying on the configuration being saved to keep the values.  When the driver
+	 * starts, the changes are applied on top of the values read from the configuration.
+	 *
+	 * Each change is written as a record: the length of the rest, the ValueID::GetId
+	 * of the value, the value as the configuration file holds it, and a CRC over
+	 * them.  A record cut short by a crash fails its CRC and is dropped with anything
+	 * after it when the log is next opened.
+	 *
+	 * Once a configuration snapshot has been saved, the records it already covers are
+	 * dropped from the start of the log.  Positions in the log are counted from when it
+	 * was opened, so they stay valid while records are dropped.
+	 */
+	class ValueLog
+	{
+	public:
+		enum
+		{
+			Magic			= 0x4c575a4f,		// "OZWL"
+			Version			= 1
+		};
+
+		/** One change */
+		struct Record
+		{
+			uint64		m_id;				// ValueID::GetId
+			string		m_value;			// The value's GetAttribute attribute, as written by Value::WriteXML
+		};
+
+		/**
+		 * \param _filename path of the log.
+		 * \param _homeId the network's home ID.  A log for another network is discarded.
+		 */
+		ValueLog( string const& _filename, uint32 const _homeId );
+		~ValueLog();
+
+		/**
+		 * Read the changes in the log, and ready it for more.  The log is created if
+		 * there is none, and anything that cannot be read is removed from it.
+		 * \param o_records filled with the changes, oldest first.
+		 * \return true if the log can be appended to.
+		 */
+		bool Open( vector<Record>* o_records );
+
+		/**
+		 * Add changes to the end of the log, in one write.
+		 * \return true if they were written.
+		 */
+		bool Append( vector<Record> const& _records );
+
+		/**
+		 * Note the end of the log, before a configuration snapshot is built.
+		 * \return the position to pass to Compact once the snapshot is saved.
+		 */
+		uint64 Mark();
+
+		/**
+		 * \return the bytes added since Mark was last called.
+		 */
+		uint32 GetUnmarked()const;
+
+		/**
+		 * Drop the records before a position returned by Mark.
+		 */
+		void Compact( uint64 const _mark );
+
+		/**
+		 * \return the attribute of a value's XML element that holds its value.
+		 */
+		static char const* GetAttribute( ValueID::ValueType const _type );
+
+	private:
+		bool Rewrite( uint8 const* _data, uint32 const _length );	// Replace the file with a header and the given records, and reopen it
+
+		string			m_filename;
+		uint32			m_homeId;
+		Mutex*			m_mutex;			// Appends come from the driver thread, compaction from whichever thread saved the configuration
+		FILE*			m_file;				// Open for appending, or NULL
+		uint64			m_start;			// Position of the first record in the file
+		uint64			m_end;				// Position of the end of the file
+		uint64			m_marked;			// Position last returned by Mark
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueLog_H
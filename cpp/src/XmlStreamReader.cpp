@@ -0,0 +1,482 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlStreamReader.cpp
+//
+//	Reads an XML file one top level element at a time
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+
+#include "XmlStreamReader.h"
+#include "platform/Log.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::XmlStreamReader>
+// Constructor
+//-----------------------------------------------------------------------------
+XmlStreamReader::XmlStreamReader
+(
+):
+	m_file( NULL ),
+	m_pos( 0 ),
+	m_row( 1 ),
+	m_childRow( 1 ),
+	m_done( false ),
+	m_error( false ),
+	m_root( new TiXmlDocument() ),
+	m_child( new TiXmlDocument() )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::~XmlStreamReader>
+// Destructor
+//-----------------------------------------------------------------------------
+XmlStreamReader::~XmlStreamReader
+(
+)
+{
+	if( m_file )
+	{
+		fclose( m_file );
+	}
+	delete m_child;
+	delete m_root;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::Open>
+// Open a file and parse the start tag of its root element
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::Open
+(
+	string const& _filename
+)
+{
+	m_filename = _filename;
+	m_file = fopen( _filename.c_str(), "rb" );
+	if( !m_file )
+	{
+		return false;
+	}
+
+	// Skip a UTF-8 byte order mark
+	if( StartsWith( 0, "\xef\xbb\xbf" ) )
+	{
+		m_pos = 3;
+	}
+
+	if( !SkipMisc() || StartsWith( m_pos, "</" ) )
+	{
+		SetError( "no root element" );
+		return false;
+	}
+
+	size_t end;
+	bool empty;
+	if( !ScanTag( m_pos, end, empty ) )
+	{
+		SetError( "unterminated root element" );
+		return false;
+	}
+
+	// Parse the start tag on its own, as an empty element
+	string tag = m_buffer.substr( m_pos, end - m_pos - ( empty ? 2 : 1 ) ) + "/>";
+	m_root->Parse( tag.c_str(), 0, TIXML_ENCODING_UTF8 );
+	if( m_root->Error() || !m_root->RootElement() )
+	{
+		SetError( "malformed root element" );
+		return false;
+	}
+
+	Advance( end );
+	m_done = empty;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::GetRoot>
+// The root element, without its children
+//-----------------------------------------------------------------------------
+TiXmlElement const* XmlStreamReader::GetRoot
+(
+)const
+{
+	return m_root->RootElement();
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::ReadChild>
+// Find the end of the next child of the root element and parse just that
+//-----------------------------------------------------------------------------
+TiXmlElement const* XmlStreamReader::ReadChild
+(
+)
+{
+	m_child->Clear();
+	if( m_done || m_error || !m_file )
+	{
+		return NULL;
+	}
+
+	// Everything before the read position has been parsed already
+	m_buffer.erase( 0, m_pos );
+	m_pos = 0;
+
+	if( !SkipMisc() )
+	{
+		SetError( "unterminated root element" );
+		return NULL;
+	}
+
+	if( StartsWith( m_pos, "</" ) )
+	{
+		m_done = true;
+		return NULL;
+	}
+
+	size_t end;
+	if( !ScanElement( end ) )
+	{
+		SetError( "unterminated element" );
+		return NULL;
+	}
+
+	// Terminate the element's text in place, rather than copy it out
+	m_childRow = m_row;
+	char next = m_buffer[end];
+	m_buffer[end] = 0;
+	m_child->Parse( m_buffer.c_str() + m_pos, 0, TIXML_ENCODING_UTF8 );
+	m_buffer[end] = next;
+
+	if( m_child->Error() || !m_child->RootElement() )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: %s is malformed at line %d - %s", m_filename.c_str(), m_childRow + m_child->ErrorRow() - 1, m_child->ErrorDesc() );
+		m_error = true;
+		return NULL;
+	}
+
+	Advance( end );
+	return m_child->RootElement();
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::GetRow>
+// Line of the file a node of the last child is on
+//-----------------------------------------------------------------------------
+int XmlStreamReader::GetRow
+(
+	TiXmlNode const* _node
+)const
+{
+	return m_childRow + _node->Row() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::Fill>
+// Read another block of the file onto the end of the buffer
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::Fill
+(
+)
+{
+	if( !m_file )
+	{
+		return false;
+	}
+
+	char block[c_blockSize];
+	size_t count = fread( block, 1, c_blockSize, m_file );
+	if( count == 0 )
+	{
+		fclose( m_file );
+		m_file = NULL;
+		return false;
+	}
+
+	m_buffer.append( block, count );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::Peek>
+// Get the character at a position of the buffer, reading more if needed
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::Peek
+(
+	size_t const _at,
+	char& o_char
+)
+{
+	while( _at >= m_buffer.size() )
+	{
+		if( !Fill() )
+		{
+			return false;
+		}
+	}
+
+	o_char = m_buffer[_at];
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::StartsWith>
+// Whether the buffer holds a string at a position
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::StartsWith
+(
+	size_t const _at,
+	char const* _str
+)
+{
+	char c;
+	for( size_t i = 0; _str[i]; ++i )
+	{
+		if( !Peek( _at + i, c ) || c != _str[i] )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::Find>
+// Find a string at or after a position, reading more of the file as needed
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::Find
+(
+	char const* _str,
+	size_t const _from,
+	size_t& o_at
+)
+{
+	size_t length = strlen( _str );
+	size_t from = _from;
+	while( true )
+	{
+		size_t at = m_buffer.find( _str, from );
+		if( at != string::npos )
+		{
+			o_at = at;
+			return true;
+		}
+
+		// The string could start in the last few characters and end in the next block
+		if( m_buffer.size() + 1 > from + length )
+		{
+			from = m_buffer.size() + 1 - length;
+		}
+		if( !Fill() )
+		{
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::SkipMisc>
+// Move past text, comments, processing instructions and the document type,
+// to the next start or end tag
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::SkipMisc
+(
+)
+{
+	size_t at;
+	while( Find( "<", m_pos, at ) )
+	{
+		Advance( at );
+		if( StartsWith( m_pos, "<!--" ) )
+		{
+			if( !Find( "-->", m_pos + 4, at ) )
+			{
+				return false;
+			}
+			Advance( at + 3 );
+		}
+		else if( StartsWith( m_pos, "<?" ) )
+		{
+			if( !Find( "?>", m_pos + 2, at ) )
+			{
+				return false;
+			}
+			Advance( at + 2 );
+		}
+		else if( StartsWith( m_pos, "<!" ) )
+		{
+			if( !Find( ">", m_pos + 2, at ) )
+			{
+				return false;
+			}
+			Advance( at + 1 );
+		}
+		else
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::ScanTag>
+// Find the end of a start or end tag, allowing for '>' in attribute values
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::ScanTag
+(
+	size_t const _at,
+	size_t& o_end,
+	bool& o_empty
+)
+{
+	char quote = 0;
+	char prev = 0;
+	char c;
+	for( size_t i = _at + 1; Peek( i, c ); ++i )
+	{
+		if( quote )
+		{
+			if( c == quote )
+			{
+				quote = 0;
+			}
+		}
+		else if( c == '"' || c == '\'' )
+		{
+			quote = c;
+		}
+		else if( c == '>' )
+		{
+			o_end = i + 1;
+			o_empty = ( prev == '/' );
+			return true;
+		}
+		prev = c;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::ScanElement>
+// Find the end of the element that starts at the read position
+//-----------------------------------------------------------------------------
+bool XmlStreamReader::ScanElement
+(
+	size_t& o_end
+)
+{
+	uint32 depth = 0;
+	size_t at = m_pos;
+	size_t end;
+	bool empty;
+	while( true )
+	{
+		if( StartsWith( at, "<!--" ) )
+		{
+			if( !Find( "-->", at + 4, end ) )
+			{
+				return false;
+			}
+			at = end + 3;
+		}
+		else if( StartsWith( at, "<![CDATA[" ) )
+		{
+			if( !Find( "]]>", at + 9, end ) )
+			{
+				return false;
+			}
+			at = end + 3;
+		}
+		else if( StartsWith( at, "<?" ) )
+		{
+			if( !Find( "?>", at + 2, end ) )
+			{
+				return false;
+			}
+			at = end + 2;
+		}
+		else
+		{
+			if( !ScanTag( at, end, empty ) )
+			{
+				return false;
+			}
+
+			if( StartsWith( at, "</" ) )
+			{
+				--depth;
+			}
+			else if( !empty )
+			{
+				++depth;
+			}
+			at = end;
+
+			if( depth == 0 )
+			{
+				o_end = end;
+				return true;
+			}
+		}
+
+		if( !Find( "<", at, at ) )
+		{
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::Advance>
+// Move the read position forward, counting the lines passed
+//-----------------------------------------------------------------------------
+void XmlStreamReader::Advance
+(
+	size_t const _to
+)
+{
+	for( size_t i = m_pos; i < _to; ++i )
+	{
+		if( m_buffer[i] == '\n' )
+		{
+			++m_row;
+		}
+	}
+	m_pos = _to;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlStreamReader::SetError>
+// Stop reading a file that is not well formed
+//-----------------------------------------------------------------------------
+void XmlStreamReader::SetError
+(
+	char const* _reason
+)
+{
+	Log::Write( LogLevel_Warning, "WARNING: %s is malformed at line %d - %s", m_filename.c_str(), m_row, _reason );
+	m_error = true;
+}
@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlStreamReader.h
+//
+//	Reads an XML file one top level element at a time
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _XmlStreamReader_H
+#define _XmlStreamReader_H
+
+#include <stdio.h>
+#include <string>
+
+#include "Defs.h"
+
+class TiXmlDocument;
+class TiXmlElement;
+class TiXmlNode;
+
+namespace OpenZWave
+{
+	/** \brief Reads an XML file a child of the root element at a time.
+	 *
+	 * Loading a whole file into a TiXmlDocument holds the text and every element
+	 * of it in memory at once, several times the size of the file.  This reader
+	 * only scans the file for where each child of the root element ends, then
+	 * parses that one child into its own small document with tinyxml.  The
+	 * child is freed when the next one is read, so the memory needed no longer
+	 * grows with the number of children, such as the nodes in a network.
+	 *
+	 * Comments, processing instructions and CDATA sections are skipped over
+	 * while scanning.  Any text directly inside the root element is ignored.
+	 */
+	class XmlStreamReader
+	{
+	public:
+		XmlStreamReader();
+		~XmlStreamReader();
+
+		/**
+		 * Open a file and read up to the end of the root element's start tag.
+		 * \param _filename path of the file to read.
+		 * \return true if the file was opened and has a root element.
+		 */
+		bool Open( string const& _filename );
+
+		/**
+		 * \return the root element, with its attributes but none of its children.
+		 */
+		TiXmlElement const* GetRoot()const;
+
+		/**
+		 * Read the next child of the root element.
+		 * \return the child, which is freed by the next call.  NULL once the end
+		 * of the root element is reached, or if the file is not well formed.
+		 */
+		TiXmlElement const* ReadChild();
+
+		/**
+		 * \return true if reading stopped because the file is not well formed.
+		 */
+		bool HasError()const{ return m_error; }
+
+		/**
+		 * \param _node an element or other node of the last child read.
+		 * \return the line of the file the node is on.
+		 */
+		int GetRow( TiXmlNode const* _node )const;
+
+	private:
+		bool Fill();
+		bool Peek( size_t const _at, char& o_char );
+		bool StartsWith( size_t const _at, char const* _str );
+		bool Find( char const* _str, size_t const _from, size_t& o_at );
+		bool SkipMisc();
+		bool ScanTag( size_t const _at, size_t& o_end, bool& o_empty );
+		bool ScanElement( size_t& o_end );
+		void Advance( size_t const _to );
+		void SetError( char const* _reason );
+
+		static size_t const c_blockSize = 16 * 1024;
+
+		FILE*			m_file;
+		string			m_filename;
+		string			m_buffer;		// Text read from the file and not yet consumed, from m_pos
+		size_t			m_pos;
+		int				m_row;			// Line of the file at m_pos
+		int				m_childRow;		// Line of the file the last child started on
+		bool			m_done;			// The end of the root element has been read
+		bool			m_error;
+		TiXmlDocument*	m_root;
+		TiXmlDocument*	m_child;
+	};
+
+} // namespace OpenZWave
+
+#endif //_XmlStreamReader_H
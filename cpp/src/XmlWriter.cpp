@@ -0,0 +1,466 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlWriter.cpp
+//
+//	Writes XML text straight into a buffer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "XmlWriter.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	char const c_hexDigits[] = "0123456789abcdef";
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::XmlWriter>
+// Constructor
+//-----------------------------------------------------------------------------
+XmlWriter::XmlWriter
+(
+):
+	m_inStartTag( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Clear>
+// Start again with an empty buffer
+//-----------------------------------------------------------------------------
+void XmlWriter::Clear
+(
+	uint32 const _capacity	// = 0
+)
+{
+	m_buffer.clear();
+	m_buffer.reserve( _capacity );
+	m_stack.clear();
+	m_inStartTag = false;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Declaration>
+// Write the XML declaration, as TiXmlDeclaration( "1.0", "utf-8", "" ) does
+//-----------------------------------------------------------------------------
+void XmlWriter::Declaration
+(
+)
+{
+	m_buffer += "<?xml version=\"1.0\" encoding=\"utf-8\" ?>\n";
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::StartElement>
+// Open the start tag of an element
+//-----------------------------------------------------------------------------
+void XmlWriter::StartElement
+(
+	char const* _name
+)
+{
+	StartChild();
+	m_buffer += '<';
+	m_buffer += _name;
+	m_stack.push_back( _name );
+	m_inStartTag = true;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::EndElement>
+// Close the current element
+//-----------------------------------------------------------------------------
+void XmlWriter::EndElement
+(
+)
+{
+	if( m_stack.empty() )
+	{
+		return;
+	}
+
+	char const* name = m_stack.back();
+	m_stack.pop_back();
+	if( m_inStartTag )
+	{
+		m_buffer += " />";
+		m_inStartTag = false;
+	}
+	else
+	{
+		m_buffer += '\n';
+		Indent( (uint32)m_stack.size(), m_buffer );
+		m_buffer += "</";
+		m_buffer += name;
+		m_buffer += '>';
+	}
+
+	if( m_stack.empty() )
+	{
+		// The end of the root element ends the document
+		m_buffer += '\n';
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Attribute>
+// Add an attribute with a string value
+//-----------------------------------------------------------------------------
+void XmlWriter::Attribute
+(
+	char const* _name,
+	char const* _value
+)
+{
+	m_buffer += ' ';
+	m_buffer += _name;
+	m_buffer += "=\"";
+	Encode( _value, m_buffer );
+	m_buffer += '"';
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::AttributeInt>
+// Add an attribute with a signed decimal value
+//-----------------------------------------------------------------------------
+void XmlWriter::AttributeInt
+(
+	char const* _name,
+	int32 const _value
+)
+{
+	if( _value >= 0 )
+	{
+		AttributeUInt( _name, (uint32)_value );
+		return;
+	}
+
+	char digits[12];
+	char* p = &digits[sizeof(digits)];
+	*--p = 0;
+	uint32 value = 0u - (uint32)_value;
+	do
+	{
+		*--p = (char)( '0' + value % 10 );
+		value /= 10;
+	}
+	while( value );
+	*--p = '-';
+	Attribute( _name, p );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::AttributeUInt>
+// Add an attribute with an unsigned decimal value
+//-----------------------------------------------------------------------------
+void XmlWriter::AttributeUInt
+(
+	char const* _name,
+	uint32 const _value
+)
+{
+	char digits[12];
+	char* p = &digits[sizeof(digits)];
+	*--p = 0;
+	uint32 value = _value;
+	do
+	{
+		*--p = (char)( '0' + value % 10 );
+		value /= 10;
+	}
+	while( value );
+	Attribute( _name, p );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::AttributeHex>
+// Add an attribute with a hexadecimal value, as printf's "0x%.<n>x" would
+//-----------------------------------------------------------------------------
+void XmlWriter::AttributeHex
+(
+	char const* _name,
+	uint32 const _value,
+	uint32 const _digits
+)
+{
+	char digits[12];
+	char* p = &digits[sizeof(digits)];
+	*--p = 0;
+	uint32 value = _value;
+	uint32 count = 0;
+	while( value || count < _digits || count == 0 )
+	{
+		*--p = c_hexDigits[value & 0x0f];
+		value >>= 4;
+		if( ++count == 8 )
+		{
+			break;
+		}
+	}
+	*--p = 'x';
+	*--p = '0';
+	Attribute( _name, p );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::AttributeBool>
+// Add an attribute of "true" or "false"
+//-----------------------------------------------------------------------------
+void XmlWriter::AttributeBool
+(
+	char const* _name,
+	bool const _value
+)
+{
+	Attribute( _name, _value ? "true" : "false" );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Raw>
+// Add a child element that has already been formatted
+//-----------------------------------------------------------------------------
+void XmlWriter::Raw
+(
+	string const& _xml
+)
+{
+	StartChild();
+	m_buffer += _xml;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Element>
+// Add a child element from a document tree
+//-----------------------------------------------------------------------------
+void XmlWriter::Element
+(
+	TiXmlElement const& _element
+)
+{
+	StartChild();
+	Print( _element, GetDepth(), m_buffer );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::TakeText>
+// Hand over the text written, without copying it
+//-----------------------------------------------------------------------------
+void XmlWriter::TakeText
+(
+	string& o_text
+)
+{
+	o_text.clear();
+	o_text.swap( m_buffer );
+	m_stack.clear();
+	m_inStartTag = false;
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::StartChild>
+// Close the parent's start tag, if still open, and begin a new indented line
+//-----------------------------------------------------------------------------
+void XmlWriter::StartChild
+(
+)
+{
+	if( m_inStartTag )
+	{
+		m_buffer += '>';
+		m_inStartTag = false;
+	}
+	if( !m_stack.empty() )
+	{
+		m_buffer += '\n';
+		Indent( (uint32)m_stack.size(), m_buffer );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Print>
+// Append an element, following the layout of TiXmlElement::Print: no
+// children as <a />, a single text child on one line, otherwise each child
+// on its own line
+//-----------------------------------------------------------------------------
+void XmlWriter::Print
+(
+	TiXmlElement const& _element,
+	uint32 const _depth,
+	string& o_xml
+)
+{
+	o_xml += '<';
+	o_xml += _element.Value();
+	for( TiXmlAttribute const* attribute = _element.FirstAttribute(); attribute; attribute = attribute->Next() )
+	{
+		o_xml += ' ';
+		Encode( attribute->Name(), o_xml );
+		o_xml += "=\"";
+		Encode( attribute->Value(), o_xml );
+		o_xml += '"';
+	}
+
+	TiXmlNode const* child = _element.FirstChild();
+	if( !child )
+	{
+		o_xml += " />";
+	}
+	else if( child == _element.LastChild() && child->ToText() )
+	{
+		o_xml += '>';
+		PrintNode( child, _depth + 1, o_xml );
+		o_xml += "</";
+		o_xml += _element.Value();
+		o_xml += '>';
+	}
+	else
+	{
+		o_xml += '>';
+		for( ; child; child = child->NextSibling() )
+		{
+			if( !child->ToText() )
+			{
+				o_xml += '\n';
+				Indent( _depth + 1, o_xml );
+			}
+			PrintNode( child, _depth + 1, o_xml );
+		}
+		o_xml += '\n';
+		Indent( _depth, o_xml );
+		o_xml += "</";
+		o_xml += _element.Value();
+		o_xml += '>';
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::PrintNode>
+// Append a child node, after its indentation
+//-----------------------------------------------------------------------------
+void XmlWriter::PrintNode
+(
+	TiXmlNode const* _node,
+	uint32 const _depth,
+	string& o_xml
+)
+{
+	if( TiXmlElement const* element = _node->ToElement() )
+	{
+		Print( *element, _depth, o_xml );
+	}
+	else if( TiXmlText const* text = _node->ToText() )
+	{
+		if( text->CDATA() )
+		{
+			o_xml += '\n';
+			Indent( _depth, o_xml );
+			o_xml += "<![CDATA[";
+			o_xml += text->Value();
+			o_xml += "]]>\n";
+		}
+		else
+		{
+			Encode( text->Value(), o_xml );
+		}
+	}
+	else if( _node->ToComment() )
+	{
+		o_xml += "<!--";
+		o_xml += _node->Value();
+		o_xml += "-->";
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Encode>
+// Append a string with the characters XML reserves replaced by entities,
+// as TiXmlBase::EncodeString does
+//-----------------------------------------------------------------------------
+void XmlWriter::Encode
+(
+	char const* _str,
+	string& o_xml
+)
+{
+	char const* run = _str;
+	char const* p = _str;
+	for( ; *p; ++p )
+	{
+		unsigned char c = (unsigned char)*p;
+		char const* entity;
+		switch( c )
+		{
+			case '&':
+			{
+				if( p[1] == '#' && p[2] == 'x' )
+				{
+					// A character reference, which is kept as it is
+					continue;
+				}
+				entity = "&amp;";
+				break;
+			}
+			case '<':	entity = "&lt;";	break;
+			case '>':	entity = "&gt;";	break;
+			case '"':	entity = "&quot;";	break;
+			case '\'':	entity = "&apos;";	break;
+			default:
+			{
+				if( c >= 32 )
+				{
+					continue;
+				}
+				entity = NULL;
+				break;
+			}
+		}
+
+		o_xml.append( run, p - run );
+		if( entity )
+		{
+			o_xml += entity;
+		}
+		else
+		{
+			o_xml += "&#x";
+			o_xml += (char)( c < 16 ? '0' : '1' );
+			o_xml += "0123456789ABCDEF"[c & 0x0f];
+			o_xml += ';';
+		}
+		run = p + 1;
+	}
+	o_xml.append( run, p - run );
+}
+
+//-----------------------------------------------------------------------------
+// <XmlWriter::Indent>
+// Append a tab for each level of nesting
+//-----------------------------------------------------------------------------
+void XmlWriter::Indent
+(
+	uint32 const _depth,
+	string& o_xml
+)
+{
+	o_xml.append( _depth, '\t' );
+}
@@ -0,0 +1,131 @@
+//-----------------------------------------------------------------------------
+//
+//	XmlWriter.h
+//
+//	Writes XML text straight into a buffer
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _XmlWriter_H
+#define _XmlWriter_H
+
+#include <string>
+#include <vector>
+
+#include "Defs.h"
+
+class TiXmlElement;
+class TiXmlNode;
+
+namespace OpenZWave
+{
+	/** \brief Builds XML text directly, without a document tree.
+	 *
+	 * Elements and attributes are appended to a single buffer as they are written,
+	 * with integers formatted in place, so nothing is allocated per attribute.
+	 * The layout is the same as TiXmlDocument::SaveFile produces, so files are
+	 * unchanged.  Elements that were built as a tinyxml tree can be printed into
+	 * the buffer too, or printed once and their text reused with Raw.
+	 *
+	 * Element names must remain valid until the element is ended.
+	 */
+	class XmlWriter
+	{
+	public:
+		XmlWriter();
+
+		/**
+		 * Discard the text written so far, keeping the buffer for reuse.
+		 * \param _capacity size to reserve, such as the length of the last document written.
+		 */
+		void Clear( uint32 const _capacity = 0 );
+
+		/**
+		 * Write the XML declaration.  Must come before the root element.
+		 */
+		void Declaration();
+
+		/**
+		 * Start an element, as a child of the current one.
+		 */
+		void StartElement( char const* _name );
+
+		/**
+		 * End the current element.
+		 */
+		void EndElement();
+
+		/**
+		 * Add an attribute to the element just started, before any children are written.
+		 */
+		void Attribute( char const* _name, char const* _value );
+		void AttributeInt( char const* _name, int32 const _value );
+		void AttributeUInt( char const* _name, uint32 const _value );
+		void AttributeHex( char const* _name, uint32 const _value, uint32 const _digits );	// As "0x" and at least _digits digits
+		void AttributeBool( char const* _name, bool const _value );							// As "true" or "false"
+
+		/**
+		 * Add a child element already formatted for this depth, as Print produces it.
+		 */
+		void Raw( string const& _xml );
+
+		/**
+		 * Add a child element from a tinyxml tree.
+		 */
+		void Element( TiXmlElement const& _element );
+
+		/**
+		 * \return the depth of the next child element, for Print.
+		 */
+		uint32 GetDepth()const{ return (uint32)m_stack.size(); }
+
+		/**
+		 * \return the text written so far.
+		 */
+		string const& GetText()const{ return m_buffer; }
+
+		/**
+		 * Move the text written so far into a string, leaving the writer empty.
+		 */
+		void TakeText( string& o_text );
+
+		/**
+		 * Append an element from a tinyxml tree as XML text, laid out as tinyxml would print it.
+		 * \param _element the element.
+		 * \param _depth the number of elements it is nested in, for the indentation.
+		 * \param o_xml the text to append to.
+		 */
+		static void Print( TiXmlElement const& _element, uint32 const _depth, string& o_xml );
+
+	private:
+		void StartChild();
+
+		static void PrintNode( TiXmlNode const* _node, uint32 const _depth, string& o_xml );
+		static void Encode( char const* _str, string& o_xml );
+		static void Indent( uint32 const _depth, string& o_xml );
+
+		string					m_buffer;
+		vector<char const*>		m_stack;			// Names of the elements not yet ended
+		bool					m_inStartTag;		// The start tag of the current element is still open for attributes
+	};
+
+} // namespace OpenZWave
+
+#endif //_XmlWriter_H
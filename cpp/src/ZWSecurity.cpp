@@ -26,6 +26,7 @@
 //-----------------------------------------------------------------------------
 
 #include "Defs.h"
+#include "Checksum.h"
 #include "ZWSecurity.h"
 #include "Node.h"
 #include "Driver.h"
@@ -41,6 +42,91 @@
 namespace OpenZWave {
 	//using namespace OpenZWave;
 
+	//-----------------------------------------------------------------------------
+	// <FrameMac>
+	// CBC-MAC of a frame, taken a byte at a time so that it can be worked out in
+	// the same pass over the data as the encryption or decryption
+	//-----------------------------------------------------------------------------
+	class FrameMac
+	{
+	public:
+		FrameMac( aes_encrypt_ctx const* _key, uint8 const* _iv ): m_key( _key ), m_pos( 0 )
+		{
+			/* the MAC starts from the IV encrypted with the auth key */
+			m_ok = ( aes_encrypt( _iv, m_state, m_key ) != EXIT_FAILURE );
+		}
+
+		void Add( uint8 const _byte )
+		{
+			m_state[m_pos++] ^= _byte;
+			if( m_pos == 16 )
+			{
+				Encrypt();
+			}
+		}
+
+		bool Finish( uint8* _mac )
+		{
+			/* a partial block is padded with zeros, which leave the state as it is */
+			if( m_pos > 0 )
+			{
+				Encrypt();
+			}
+			/* we only care about the first 8 bytes of the state as the mac */
+			memcpy( _mac, m_state, 8 );
+			return m_ok;
+		}
+
+	private:
+		void Encrypt()
+		{
+			if( aes_encrypt( m_state, m_state, m_key ) == EXIT_FAILURE )
+			{
+				m_ok = false;
+			}
+			m_pos = 0;
+		}
+
+		aes_encrypt_ctx const*	m_key;
+		uint8					m_state[16];
+		uint32					m_pos;
+		bool					m_ok;
+	};
+
+	//-----------------------------------------------------------------------------
+	// <FrameCipher>
+	// AES-OFB, a byte at a time.  Encryption and decryption are the same.
+	//-----------------------------------------------------------------------------
+	class FrameCipher
+	{
+	public:
+		FrameCipher( aes_encrypt_ctx const* _key, uint8 const* _iv ): m_key( _key ), m_pos( 16 ), m_ok( true )
+		{
+			memcpy( m_stream, _iv, 16 );
+		}
+
+		uint8 Next( uint8 const _byte )
+		{
+			if( m_pos == 16 )
+			{
+				if( aes_encrypt( m_stream, m_stream, m_key ) == EXIT_FAILURE )
+				{
+					m_ok = false;
+				}
+				m_pos = 0;
+			}
+			return _byte ^ m_stream[m_pos++];
+		}
+
+		bool IsOk()const{ return m_ok; }
+
+	private:
+		aes_encrypt_ctx const*	m_key;
+		uint8					m_stream[16];
+		uint32					m_pos;
+		bool					m_ok;
+	};
+
 	//-----------------------------------------------------------------------------
 	// <GenerateAuthentication>
 	// Generate authentication data from a security-encrypted message
@@ -56,77 +142,26 @@ namespace OpenZWave {
 			uint8* _authentication			// 8-byte buffer that will be filled with the authentication data
 	)
 	{
-		// Build a buffer containing a 4-byte header and the encrypted
-		// message data, padded with zeros to a 16-byte boundary.
-		uint8 buffer[256];
-		uint8 tmpauth[16];
-		memset(buffer, 0, 256);
-		memset(tmpauth, 0, 16);
-		buffer[0] = _data[0];							// Security command class command
-		buffer[1] = _sendingNode;
-		buffer[2] = _receivingNode;
-		buffer[3] = _length - 19; // Subtract 19 to account for the 9 security command class bytes that come before and after the encrypted data
-		memcpy( &buffer[4], &_data[9], _length-19 );	// Encrypted message
-
-		uint8 bufsize = _length - 19 + 4; /* the size of buffer */
-#ifdef DEBUG
-		PrintHex("Raw Auth (minus IV)", buffer, bufsize);
-		Log::Write(LogLevel_Debug, _receivingNode, "Raw Auth (Minus IV) Size: %d (%d)", bufsize, bufsize+16);
-#endif
-
-		aes_mode_reset(driver->GetAuthKey());
-		/* encrypt the IV with ecb */
-		if (aes_ecb_encrypt(iv, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-			Log::Write(LogLevel_Warning, _receivingNode, "Failed Initial ECB Encrypt of Auth Packet");
-			return false;
-		}
-
-		/* our temporary holding var */
-		uint8 encpck[16];
-
-		int block = 0;
-		/* reset our encpck temp var */
-		memset(encpck, 0, 16);
-		/* now xor the buffer with our encrypted IV */
-		for (int i = 0; i < bufsize; i++) {
-			encpck[block] = buffer[i];
-			block++;
-			/* if we hit a blocksize, then encrypt */
-			if (block == 16) {
-				for (int j = 0; j < 16; j++) {
-					/* here we do our xor */
-					tmpauth[j] = encpck[j] ^ tmpauth[j];
-					/* and reset encpck for good measure */
-					encpck[j] = 0;
-				}
-				/* reset our block counter back to 0 */
-				block = 0;
-				aes_mode_reset(driver->GetAuthKey());
-				if (aes_ecb_encrypt(tmpauth, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-					Log::Write(LogLevel_Warning, _receivingNode, "Failed Subsequent (%d) ECB Encrypt of Auth Packet", i);
-					return false;
-				}
-			}
+		// The MAC covers a 4-byte header and the encrypted message data,
+		// padded with zeros to a 16-byte boundary.
+		uint32 encryptedLength = _length - 19;		// Subtract 19 to account for the 9 security command class bytes that come before and after the encrypted data
+		FrameMac mac( driver->GetAuthKey(), iv );
+		mac.Add( _data[0] );						// Security command class command
+		mac.Add( _sendingNode );
+		mac.Add( _receivingNode );
+		mac.Add( (uint8)encryptedLength );
+		for( uint32 i = 0; i < encryptedLength; i++ )
+		{
+			mac.Add( _data[9+i] );					// Encrypted message
 		}
-		/* any left over data that isn't a full block size*/
-		if (block > 0) {
-			for (int i= 0; i < 16; i++) {
-				/* encpck from block to 16 is already gauranteed to be 0
-				 * so its safe to xor it with out tmpmac */
-				tmpauth[i] = encpck[i] ^ tmpauth[i];
-			}
-			aes_mode_reset(driver->GetAuthKey());
-			if (aes_ecb_encrypt(tmpauth, tmpauth, 16, driver->GetAuthKey()) == EXIT_FAILURE) {
-				Log::Write(LogLevel_Warning, _receivingNode, "Failed Final ECB Encrypt of Auth Packet");
-				return false;
-			}
+		if( !mac.Finish( _authentication ) )
+		{
+			Log::Write(LogLevel_Warning, _receivingNode, "Failed ECB Encrypt of Auth Packet");
+			return false;
 		}
-		/* we only care about the first 8 bytes of tmpauth as the mac */
 #ifdef DEBUG
-		PrintHex("Computed Auth", tmpauth, 8);
+		PrintHex("Computed Auth", _authentication, 8);
 #endif
-		/* so only copy 8 bytes to the _authentication var */
-		memcpy(_authentication, tmpauth, 8);
 		return true;
 	}
 
@@ -137,20 +172,12 @@ namespace OpenZWave {
 			uint8 const _sendingNode,
 			uint8 const _receivingNode,
 			uint8 const m_nonce[8],
-			uint8* e_buffer
+			uint8* e_buffer,
+			bool const _nonceGet
 	)
 	{
-
-#if 0
-		m_nonce[0] = 0x09;
-		m_nonce[1] = 0x0d;
-		m_nonce[2] = 0x93;
-		m_nonce[3] = 0xd3;
-		m_nonce[4] = 0x61;
-		m_nonce[5] = 0x61;
-		m_nonce[6] = 0x1d;
-		m_nonce[7] = 0xd6;
-#endif
+		/* a MessageEncapNonceGet also asks the node to send us a new nonce */
+		uint8 const securityCmd = _nonceGet ? SecurityCmd_MessageEncapNonceGet : SecurityCmd_MessageEncap;
 		uint8 len = 0;
 		e_buffer[len++] = SOF;
 		e_buffer[len++] = m_length + 18; // length of full packet
@@ -159,7 +186,7 @@ namespace OpenZWave {
 		e_buffer[len++] = _receivingNode;
 		e_buffer[len++] = m_length + 11; 					// Length of the payload
 		e_buffer[len++] = Security::StaticGetCommandClassId();
-		e_buffer[len++] = SecurityCmd_MessageEncap;
+		e_buffer[len++] = securityCmd;
 
 		/* create our IV */
 		uint8 initializationVector[16];
@@ -175,62 +202,50 @@ namespace OpenZWave {
 			initializationVector[8+i] = m_nonce[i];
 		}
 
-		/* we need a copy b/c aes_ofb_encrypt will overwrite it */
-		uint8 iv_dup[16];
-		for (int i = 0; i < 16; i++) {
-			iv_dup[i] = initializationVector[i];
-		}
-
-		uint8 plaintextmsg[32];
-		/* add the Sequence Flag
-		 * - Since we dont currently handle multipacket encryption
-		 * just set this to 0
+		/* The plain text is a sequence flag (since we dont currently handle
+		 * multipacket encryption, just 0) followed by the actual message.
+		 * Each byte is encrypted and added to the MAC as it goes, so the
+		 * payload is only walked once.
 		 */
-		plaintextmsg[0] = 0;
-		/* now add the actual message to be encrypted */
-		for (int i = 0; i < m_length-6-3; i++)
-			plaintextmsg[i+1] = m_buffer[6+i];
-
-		/* now encrypt */
-		uint8 encryptedpayload[30];
-		aes_mode_reset(driver->GetEncKey());
+		uint8 const plaintextLength = m_length-5-3;
+		FrameCipher cipher( driver->GetEncKey(), initializationVector );
+		FrameMac mac( driver->GetAuthKey(), initializationVector );
+		mac.Add( securityCmd );
+		mac.Add( _sendingNode );
+		mac.Add( _receivingNode );
+		mac.Add( plaintextLength );
 #ifdef DEBUG
-		PrintHex("Plain Text Packet:", plaintextmsg, m_length-5-3);
+		PrintHex("Plain Text Packet:", &m_buffer[6], plaintextLength-1);
 #endif
-		if (aes_ofb_encrypt(plaintextmsg, encryptedpayload, m_length-5-3, initializationVector, driver->GetEncKey()) == EXIT_FAILURE) {
+		for (int i = 0; i < plaintextLength; i++) {
+			uint8 encrypted = cipher.Next( i == 0 ? 0 : m_buffer[6+i-1] );
+			e_buffer[len++] = encrypted;
+			mac.Add( encrypted );
+		}
+		if( !cipher.IsOk() ) {
 			Log::Write(LogLevel_Warning, _receivingNode, "Failed to Encrypt Packet");
 			return false;
 		}
 #ifdef DEBUG
-		PrintHex("Encrypted Packet", encryptedpayload, m_length-5-3);
+		PrintHex("Encrypted Packet", &e_buffer[len-plaintextLength], plaintextLength);
 #endif
-		/* now add the Encrypted output to the packet */
-		for (int i = 0; i < m_length-5-3; i++) {
-			e_buffer[len++] = encryptedpayload[i];
-		}
 
 		// Append the nonce identifier :)
 		e_buffer[len++] = m_nonce[0];
 
-
-		/* now calculate the MAC and append it */
-		uint8 mac[8];
-		GenerateAuthentication(&e_buffer[7], e_buffer[5], driver, _sendingNode, _receivingNode, iv_dup, mac);
-		for(int i=0; i<8; ++i )
-		{
-			e_buffer[len++] = mac[i];
+		/* now append the MAC */
+		if( !mac.Finish( &e_buffer[len] ) ) {
+			Log::Write(LogLevel_Warning, _receivingNode, "Failed ECB Encrypt of Auth Packet");
+			return false;
 		}
+		len += 8;
 
-		e_buffer[len++] = driver->GetTransmitOptions();
+		e_buffer[len++] = driver->GetTransmitOptions( _receivingNode );
 		/* this is the same as the Actual Message */
 		e_buffer[len++] = m_buffer[m_length-2];
 		// Calculate the checksum
-		uint8 csum = 0xff;
-		for( int32 i=1; i<len; ++i )
-		{
-			csum ^= e_buffer[i];
-		}
-		e_buffer[len++] = csum;
+		e_buffer[len] = XorChecksum( &e_buffer[1], len-1 );
+		len++;
 		return true;
 	}
 
@@ -275,7 +290,9 @@ namespace OpenZWave {
 			uint8* m_buffer
 	)
 	{
+#ifdef DEBUG
 		PrintHex("Raw", e_buffer, e_length);
+#endif
 
 		if (e_length < 19) {
 			Log::Write(LogLevel_Warning, _sendingNode, "Received a Encrypted Message that is too Short. Dropping it");
@@ -296,48 +313,35 @@ namespace OpenZWave {
 			return false;
 		}
 
-
-		uint8 encyptedpacket[32];
-
-		for (uint32 i = 0; i < 32; i++) {
-			if (i >= encryptedpacketsize) {
-				/* pad the remaining fields */
-				encyptedpacket[i] = 0;
-			} else {
-				encyptedpacket[i] = e_buffer[10+i];
-			}
-		}
-
-
 #ifdef DEBUG
 		Log::Write(LogLevel_Debug, _sendingNode, "Encrypted Packet Sizes: %d (Total) %d (Payload)", e_length, encryptedpacketsize);
 		PrintHex("IV", iv, 16);
-		PrintHex("Encrypted", encyptedpacket, 16);
+		PrintHex("Encrypted", &e_buffer[10], encryptedpacketsize);
 		/* Mac Starts after Encrypted Packet. */
 		PrintHex("Auth", &e_buffer[11+encryptedpacketsize], 8);
 #endif
-		aes_mode_reset(driver->GetEncKey());
-#if 0
-		uint8_t iv[16] = {  0x81, 0x42, 0xd1, 0x51, 0xf1, 0x59, 0x3d, 0x70, 0xd5, 0xe3, 0x6c, 0xcb, 0x02, 0xd0, 0x3f, 0x5c,  /* */  };
-		uint8_t pck[] = {  0x25, 0x68, 0x06, 0xc5, 0xb3, 0xee, 0x2c, 0x17, 0x26, 0x7e, 0xf0, 0x84, 0xd4, 0xc3, 0xba, 0xed, 0xe5, 0xb9, 0x55};
-		if (aes_ofb_decrypt(pck, decryptpacket, 19, iv, this->EncryptKey) == EXIT_FAILURE) {
-			Log::Write(LogLevel_Warning, GetNodeId(), "Failed to Decrypt Packet");
-			return false;
+		/* The MAC is over the encrypted data, so it is worked out in the
+		 * same pass as the decryption.  Both start from the same IV.
+		 */
+		FrameCipher cipher( driver->GetEncKey(), iv );
+		FrameMac mac( driver->GetAuthKey(), iv );
+		mac.Add( e_buffer[1] );
+		mac.Add( _sendingNode );
+		mac.Add( _receivingNode );
+		mac.Add( (uint8)encryptedpacketsize );
+		for( uint32 i = 0; i < encryptedpacketsize; i++ )
+		{
+			mac.Add( e_buffer[10+i] );
+			m_buffer[i] = cipher.Next( e_buffer[10+i] );
 		}
-		PrintHex("Pck", decryptpacket, 19);
-#else
-		if (aes_ofb_decrypt(encyptedpacket, m_buffer, encryptedpacketsize, iv, driver->GetEncKey()) == EXIT_FAILURE) {
+		if( !cipher.IsOk() ) {
 			Log::Write(LogLevel_Warning, _sendingNode, "Failed to Decrypt Packet");
 			return false;
 		}
 		Log::Write(LogLevel_Detail, _sendingNode, "Decrypted Packet: %s", PktToString(m_buffer, encryptedpacketsize).c_str());
-#endif
-		uint8 mac[32];
-		/* we have to regenerate the IV as the ofb decryption routine will alter it. */
-		createIVFromPacket_inbound(&e_buffer[2], m_nonce, iv);
 
-		GenerateAuthentication(&e_buffer[1], e_length-1, driver, _sendingNode, _receivingNode, iv, mac);
-		if (memcmp(&e_buffer[11+encryptedpacketsize], mac, 8) != 0) {
+		uint8 computed[8];
+		if (!mac.Finish(computed) || memcmp(&e_buffer[11+encryptedpacketsize], computed, 8) != 0) {
 			Log::Write(LogLevel_Warning, _sendingNode, "MAC Authentication of Packet Failed. Dropping");
 			return false;
 		}
@@ -72,23 +72,122 @@ enum
 	Alarm_Count
 };
 
-static char const* c_alarmTypeName[] =
+// The value of each alarm type is at its type plus this
+static uint8 const c_typeIndexBase = 3;
+
+// Event 0 reports that the type has gone back to idle, with the event that
+// has ended as its parameter
+static uint8 const c_eventIdle = 0x00;
+static uint8 const c_eventUnknown = 0xfe;
+
+static char const* const c_smokeEvents[] =
+{
+		"Idle", "Smoke Detected (location)", "Smoke Detected", "Smoke Alarm Test", "Replacement Required", "Replacement Required, End of Life",
+		"Alarm Silenced", "Maintenance Required, Periodic Inspection", "Maintenance Required, Dust in Device"
+};
+static char const* const c_carbonMonoxideEvents[] =
+{
+		"Idle", "Carbon Monoxide Detected (location)", "Carbon Monoxide Detected", "Carbon Monoxide Test", "Replacement Required", "Replacement Required, End of Life",
+		"Alarm Silenced", "Maintenance Required, Periodic Inspection"
+};
+static char const* const c_carbonDioxideEvents[] =
+{
+		"Idle", "Carbon Dioxide Detected (location)", "Carbon Dioxide Detected", "Carbon Dioxide Test", "Replacement Required", "Replacement Required, End of Life",
+		"Alarm Silenced", "Maintenance Required, Periodic Inspection"
+};
+static char const* const c_heatEvents[] =
+{
+		"Idle", "Overheat Detected (location)", "Overheat Detected", "Rapid Temperature Rise (location)", "Rapid Temperature Rise", "Underheat Detected (location)",
+		"Underheat Detected", "Heat Alarm Test", "Replacement Required, End of Life", "Alarm Silenced", "Maintenance Required, Dust in Device",
+		"Maintenance Required, Periodic Inspection"
+};
+static char const* const c_floodEvents[] =
+{
+		"Idle", "Water Leak Detected (location)", "Water Leak Detected", "Water Level Dropped (location)", "Water Level Dropped", "Replace Water Filter"
+};
+static char const* const c_accessControlEvents[] =
+{
+		"Idle", "Manual Lock", "Manual Unlock", "RF Lock", "RF Unlock", "Keypad Lock", "Keypad Unlock", "Manual Not Fully Locked",
+		"RF Not Fully Locked", "Auto Locked", "Auto Lock Not Fully Locked", "Lock Jammed", "All User Codes Deleted", "Single User Code Deleted",
+		"New User Code Added", "New User Code Not Added, Duplicate", "Keypad Temporarily Disabled", "Keypad Busy", "New Program Code Entered",
+		"User Code Limit Exceeded", "RF Unlock, Invalid User Code", "RF Lock, Invalid User Code", "Window/Door Open", "Window/Door Closed"
+};
+static char const* const c_burglarEvents[] =
+{
+		"Idle", "Intrusion (location)", "Intrusion", "Tampering, Cover Removed", "Tampering, Invalid Code", "Glass Breakage (location)",
+		"Glass Breakage", "Motion Detected (location)", "Motion Detected", "Tampering, Product Moved"
+};
+static char const* const c_powerManagementEvents[] =
+{
+		"Idle", "Power Applied", "AC Mains Disconnected", "AC Mains Reconnected", "Surge Detected", "Voltage Drop/Drift", "Over-current Detected",
+		"Over-voltage Detected", "Over-load Detected", "Load Error", "Replace Battery Soon", "Replace Battery Now", "Battery Charging",
+		"Battery Fully Charged", "Charge Battery Soon", "Charge Battery Now"
+};
+static char const* const c_systemEvents[] =
+{
+		"Idle", "Hardware Failure", "Software Failure", "Hardware Failure (code)", "Software Failure (code)"
+};
+static char const* const c_emergencyEvents[] =
+{
+		"Idle", "Contact Police", "Contact Fire Service", "Contact Medical Service"
+};
+static char const* const c_clockEvents[] =
 {
-		"General",
-		"Smoke",
-		"Carbon Monoxide",
-		"Carbon Dioxide",
-		"Heat",
-		"Flood",
-		"Access Control",
-		"Burglar",
-		"Power Management",
-		"System",
-		"Emergency",
-		"Clock",
-		"Appliance",
-		"HomeHealth"
+		"Idle", "Wake Up Alert", "Timer Ended", "Time Remaining"
 };
+static char const* const c_applianceEvents[] =
+{
+		"Idle", "Program Started", "Program In Progress", "Program Completed", "Replace Main Filter", "Failure to Set Target Temperature",
+		"Supplying Water", "Water Supply Failure", "Boiling", "Boiling Failure", "Washing", "Washing Failure", "Rinsing", "Rinsing Failure",
+		"Draining", "Draining Failure", "Spinning", "Spinning Failure", "Drying", "Drying Failure", "Fan Failure", "Compressor Failure"
+};
+static char const* const c_homeHealthEvents[] =
+{
+		"Idle", "Leaving Bed", "Sitting on Bed", "Lying on Bed", "Posture Changed", "Sitting on Bed Edge"
+};
+
+#define ALARM_EVENTS( _events ) sizeof(_events) / sizeof(_events[0]), _events
+
+// Each alarm type, indexed by the type, with the labels of its events
+// indexed by the event
+static struct AlarmType
+{
+	char const*			m_label;
+	uint8				m_numEvents;
+	char const* const*	m_events;
+} const c_alarmTypes[Alarm_Count] =
+{
+		{ "General",			0, NULL },
+		{ "Smoke",				ALARM_EVENTS( c_smokeEvents ) },
+		{ "Carbon Monoxide",	ALARM_EVENTS( c_carbonMonoxideEvents ) },
+		{ "Carbon Dioxide",		ALARM_EVENTS( c_carbonDioxideEvents ) },
+		{ "Heat",				ALARM_EVENTS( c_heatEvents ) },
+		{ "Flood",				ALARM_EVENTS( c_floodEvents ) },
+		{ "Access Control",		ALARM_EVENTS( c_accessControlEvents ) },
+		{ "Burglar",			ALARM_EVENTS( c_burglarEvents ) },
+		{ "Power Management",	ALARM_EVENTS( c_powerManagementEvents ) },
+		{ "System",				ALARM_EVENTS( c_systemEvents ) },
+		{ "Emergency",			ALARM_EVENTS( c_emergencyEvents ) },
+		{ "Clock",				ALARM_EVENTS( c_clockEvents ) },
+		{ "Appliance",			ALARM_EVENTS( c_applianceEvents ) },
+		{ "HomeHealth",			ALARM_EVENTS( c_homeHealthEvents ) }
+};
+
+#undef ALARM_EVENTS
+
+// The label of an event of a type
+static char const* GetEventLabel( uint8 const _type, uint8 const _event )
+{
+	if( _event == c_eventUnknown )
+	{
+		return "Unknown Event";
+	}
+	if( ( _type < Alarm_Count ) && ( _event < c_alarmTypes[_type].m_numEvents ) )
+	{
+		return c_alarmTypes[_type].m_events[_event];
+	}
+	return "Unlisted Event";
+}
 
 //-----------------------------------------------------------------------------
 // <WakeUp::WakeUp>
@@ -172,7 +271,7 @@ bool Alarm::RequestValue
 			bool res = false;
 			for( uint8 i = 0; i < Alarm_Count; i++ )
 			{
-				if( Value* value = GetValue( _instance, i + 3 ) ) {
+				if( Value* value = GetValue( _instance, i + c_typeIndexBase ) ) {
 					value->Release();
 					Msg* msg = new Msg( "AlarmCmd_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
 					msg->SetInstance( this, _instance );
@@ -215,12 +314,20 @@ bool Alarm::HandleMsg
 		{
 			Log::Write( LogLevel_Info, GetNodeId(), "Received Alarm report: type=%d, level=%d", _data[1], _data[2] );
 		}
-		else
+		else if( _length >= 7 )
 		{
-			string alarm_type =  ( _data[5] < Alarm_Count ) ? c_alarmTypeName[_data[5]] : "Unknown type";
+			uint8 type = _data[5];
+			uint8 event = _data[6];
+			char const* typeLabel = ( type < Alarm_Count ) ? c_alarmTypes[type].m_label : "Unknown type";
 
-			Log::Write( LogLevel_Info, GetNodeId(), "Received Alarm report: type=%d, level=%d, sensorSrcID=%d, type:%s event:%d, status=%d",
-							_data[1], _data[2], _data[3], alarm_type.c_str(), _data[6], _data[4] );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Alarm report: type=%d, level=%d, sensorSrcID=%d, type:%s event:%d (%s), status=%d",
+							_data[1], _data[2], _data[3], typeLabel, event, GetEventLabel( type, event ), _data[4] );
+
+			// From version 3 an idle report says which event has ended
+			if( ( event == c_eventIdle ) && ( _length >= 9 ) && ( ( _data[7] & 0x1f ) >= 1 ) )
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "    %s is no longer active", GetEventLabel( type, _data[8] ) );
+			}
 		}
 
 		ValueByte* value;
@@ -244,7 +351,7 @@ bool Alarm::HandleMsg
 				value->Release();
 			}
 
-			if( (value = static_cast<ValueByte*>( GetValue( _instance, _data[5]+3 ) )) )
+			if( (value = GetTypeValue( _instance, _data[5] )) )
 			{
 				value->OnValueRefreshed( _data[6] );
 				value->Release();
@@ -275,8 +382,9 @@ bool Alarm::HandleMsg
 						int32 index = (int32)(i<<3) + bit;
 						if( index < Alarm_Count )
 						{
-							node->CreateValueByte( ValueID::ValueGenre_User, GetCommandClassId(), _instance, index+3, c_alarmTypeName[index], "", true, false, 0, 0 );
-							Log::Write( LogLevel_Info, GetNodeId(), "    Added alarm type: %s", c_alarmTypeName[index] );
+							node->CreateValueByte( ValueID::ValueGenre_User, GetCommandClassId(), _instance, index+c_typeIndexBase, c_alarmTypes[index].m_label, "", true, false, 0, 0 );
+							m_typeValues[_instance] |= 1u << index;
+							Log::Write( LogLevel_Info, GetNodeId(), "    Added alarm type: %s", c_alarmTypes[index].m_label );
 						} else {
 							Log::Write( LogLevel_Info, GetNodeId(), "    Unknown alarm type: %d", index );
 						}
@@ -292,6 +400,39 @@ bool Alarm::HandleMsg
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Alarm::GetTypeValue>
+// The value of an alarm type.  A type the node did not list as supported has
+// its value created the first time it is reported, and never again after that.
+//-----------------------------------------------------------------------------
+ValueByte* Alarm::GetTypeValue
+(
+		uint8 const _instance,
+		uint8 const _type
+)
+{
+	if( _type >= Alarm_Count )
+	{
+		return NULL;
+	}
+
+	uint8 index = _type + c_typeIndexBase;
+	ValueByte* value = static_cast<ValueByte*>( GetValue( _instance, index ) );
+	uint32& known = m_typeValues[_instance];
+	uint32 bit = 1u << _type;
+	if( ( value == NULL ) && !( known & bit ) )
+	{
+		if( Node* node = GetNodeUnsafe() )
+		{
+			node->CreateValueByte( ValueID::ValueGenre_User, GetCommandClassId(), _instance, index, c_alarmTypes[_type].m_label, "", true, false, 0, 0 );
+			Log::Write( LogLevel_Info, GetNodeId(), "    Added alarm type: %s, which the node reported but did not list", c_alarmTypes[_type].m_label );
+			value = static_cast<ValueByte*>( GetValue( _instance, index ) );
+		}
+	}
+	known |= bit;
+	return value;
+}
+
 //-----------------------------------------------------------------------------
 // <Alarm::CreateVars>
 // Create the values managed by this command class
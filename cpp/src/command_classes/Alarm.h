@@ -64,6 +64,9 @@ namespace OpenZWave
 
 	private:
 		Alarm( uint32 const _homeId, uint8 const _nodeId );
+		ValueByte* GetTypeValue( uint8 const _instance, uint8 const _type );	// The value of an alarm type, created the first time the type is reported if need be
+
+		map<uint8,uint32>	m_typeValues;		// For each instance, a bit for each alarm type whose value has been created or found
 	};
 
 } // namespace OpenZWave
@@ -47,6 +47,8 @@ enum AssociationCmd
 	AssociationCmd_GroupingsReport	= 0x06
 };
 
+static uint32 const c_maxTargets = 16;		// Node ids in one Set or Remove, few enough to be sent encrypted
+
 
 //-----------------------------------------------------------------------------
 // <Association::Association>
@@ -388,3 +390,52 @@ void Association::Remove
 	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
 }
 
+//-----------------------------------------------------------------------------
+// <Association::SendTargets>
+// Add or remove several nodes at once, as few to a message as the frame allows
+//-----------------------------------------------------------------------------
+void Association::SendTargets
+(
+	uint8 const _groupIdx,
+	NodeSet const& _targets,
+	bool const _remove
+)
+{
+	// An Association group cannot hold an instance of a node
+	vector<uint8> nodes;
+	uint32 position = 0;
+	InstanceAssociation target;
+	while( _targets.GetNext( position, &target ) )
+	{
+		if( target.m_instance != 0x00 )
+		{
+			Log::Write( LogLevel_Warning, GetNodeId(), "Association - Ignoring instance %d of node %d, as group %d is not multi instance", target.m_instance, target.m_nodeId, _groupIdx );
+			continue;
+		}
+		nodes.push_back( target.m_nodeId );
+	}
+
+	// An empty list would clear the whole group, so it is never sent
+	for( uint32 start = 0; start < nodes.size(); start += c_maxTargets )
+	{
+		uint32 count = (uint32)nodes.size() - start;
+		if( count > c_maxTargets )
+		{
+			count = c_maxTargets;
+		}
+
+		Log::Write( LogLevel_Info, GetNodeId(), "Association::%s - %s %d nodes %s group %d of node %d", _remove ? "Remove" : "Set", _remove ? "Removing" : "Adding", count, _remove ? "from" : "to", _groupIdx, GetNodeId() );
+		Msg* msg = new Msg( _remove ? "AssociationCmd_Remove" : "AssociationCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+		msg->Append( GetNodeId() );
+		msg->Append( 3 + count );
+		msg->Append( GetCommandClassId() );
+		msg->Append( _remove ? AssociationCmd_Remove : AssociationCmd_Set );
+		msg->Append( _groupIdx );
+		for( uint32 i = 0; i < count; ++i )
+		{
+			msg->Append( nodes[start+i] );
+		}
+		msg->Append( GetDriver()->GetTransmitOptions() );
+		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+	}
+}
@@ -33,6 +33,8 @@
 
 namespace OpenZWave
 {
+	class NodeSet;
+
 	/** \brief Implements COMMAND_CLASS_ASSOCIATION (0x85), a Z-Wave device command class.
 	 */
 	class Association: public CommandClass
@@ -58,11 +60,14 @@ namespace OpenZWave
 		void RequestAllGroups( uint32 const _requestFlags );
 		void Set( uint8 const _group, uint8 const _nodeId );
 		void Remove( uint8 const _group, uint8 const _nodeId );
+		void Set( uint8 const _group, NodeSet const& _targets ){ SendTargets( _group, _targets, false ); }
+		void Remove( uint8 const _group, NodeSet const& _targets ){ SendTargets( _group, _targets, true ); }
 
 	private:
 		Association( uint32 const _homeId, uint8 const _nodeId );
 		void QueryGroup( uint8 _groupIdx, uint32 const _requestFlags );
 		void AutoAssociate();
+		void SendTargets( uint8 const _groupIdx, NodeSet const& _targets, bool const _remove );
 
 		bool			m_queryAll;			// When true, once a group has been queried, we request the next one.
 		uint8			m_numGroups;		// Number of groups supported by the device.  255 is reported by certain manufacturers and requires special handling.
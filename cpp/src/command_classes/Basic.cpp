@@ -61,7 +61,8 @@ Basic::Basic
 	CommandClass( _homeId, _nodeId ),
 	m_mapping( 0 ),
 	m_ignoreMapping( false ),
-	m_setAsReport( false )
+	m_setAsReport( false ),
+	m_mappedClass( NULL )
 {
 }
 
@@ -96,6 +97,9 @@ void Basic::ReadXML
 	{
 		m_setAsReport = !strcmp( str, "true");
 	}
+
+	// The mapping may now be ignored, or be to another class
+	ResolveMapping();
 }
 
 //-----------------------------------------------------------------------------
@@ -190,15 +194,8 @@ bool Basic::HandleMsg
 	{
 		// Level
 		Log::Write( LogLevel_Info, GetNodeId(), "Received Basic report from node %d: level=%d", GetNodeId(), _data[1] );
-		if( !m_ignoreMapping && m_mapping != 0 )
-		{
-			UpdateMappedClass( _instance, m_mapping, _data[1] );
-		}
-		else if( ValueByte* value = static_cast<ValueByte*>( GetValue( _instance, 0 ) ) )
+		if( !UpdateLevel( _instance, _data[1] ) )
 		{
-			value->OnValueRefreshed( _data[1] );
-			value->Release();
-		} else {
 			Log::Write(LogLevel_Warning, GetNodeId(), "No Valid Mapping for Basic Command Class and No ValueID Exported. Error?");
 		}
 		return true;
@@ -209,15 +206,7 @@ bool Basic::HandleMsg
 		if( m_setAsReport )
 		{
 			Log::Write( LogLevel_Info, GetNodeId(), "Received Basic set from node %d: level=%d. Treating it as a Basic report.", GetNodeId(), _data[1] );
-			if( !m_ignoreMapping && m_mapping != 0 )
-			{
-				UpdateMappedClass( _instance, m_mapping, _data[1] );
-			}
-			else if( ValueByte* value = static_cast<ValueByte*>( GetValue( _instance, 0 ) ) )
-			{
-				value->OnValueRefreshed( _data[1] );
-				value->Release();
-			}
+			UpdateLevel( _instance, _data[1] );
 		}
 		else
 		{
@@ -235,6 +224,60 @@ bool Basic::HandleMsg
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Basic::UpdateLevel>
+// Pass a level reported by the node on to the mapped class, or to the
+// Basic value if there is none.  False if there is neither.
+//-----------------------------------------------------------------------------
+bool Basic::UpdateLevel
+(
+	uint8 const _instance,
+	uint8 const _level
+)
+{
+	if( m_mappedClass != NULL )
+	{
+		// Resolved when the interview completed
+		m_mappedClass->SetValueBasic( _instance, _level );
+		return true;
+	}
+	if( !m_ignoreMapping && m_mapping != 0 )
+	{
+		UpdateMappedClass( _instance, m_mapping, _level );
+		return true;
+	}
+	if( ValueByte* value = static_cast<ValueByte*>( GetValue( _instance, 0 ) ) )
+	{
+		value->OnValueRefreshed( _level );
+		value->Release();
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Basic::ResolveMapping>
+// Look the mapped class up once, if the node's interview is complete, so
+// that the reports need not
+//-----------------------------------------------------------------------------
+void Basic::ResolveMapping
+(
+)
+{
+	m_mappedClass = NULL;
+	if( m_ignoreMapping || m_mapping == 0 )
+	{
+		return;
+	}
+	if( Node* node = GetNodeUnsafe() )
+	{
+		if( node->GetCurrentQueryStage() == Node::QueryStage_Complete )
+		{
+			m_mappedClass = node->GetCommandClass( m_mapping );
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Basic::SetValue>
 // Set a value on the Z-Wave device
@@ -251,6 +294,7 @@ bool Basic::SetValue
 		Log::Write( LogLevel_Info, GetNodeId(), "Basic::Set - Setting node %d to level %d", GetNodeId(), value->GetValue() );
 		Msg* msg = new Msg( "BasicCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
 		msg->SetInstance( this, _value.GetID().GetInstance() );
+		msg->SetSupersedable( 2 );
 		msg->Append( GetNodeId() );
 		msg->Append( 3 );
 		msg->Append( GetCommandClassId() );
@@ -264,6 +308,18 @@ bool Basic::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Basic::GetSetKeyLength>
+// A later BasicCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 Basic::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( BasicCmd_Set == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <Basic::CreateVars>
 // Create the values managed by this command class
@@ -331,6 +387,7 @@ bool Basic::SetMapping
 		}
 		m_mapping = _commandClassId;
 		RemoveValue( 1, 0 );
+		ResolveMapping();
 		res = true;
 	}
 
@@ -47,6 +47,8 @@ namespace OpenZWave
 
 		bool SetMapping( uint8 const _commandClassId, bool const _doLog = true );	// Map COMMAND_CLASS_BASIC messages to another command class
 		uint8 GetMapping(){ return m_mapping; }
+		void ResolveMapping();														// Look up the mapped class, once the interview is complete, for the reports to go straight to
+		void ClearResolvedMapping(){ m_mappedClass = NULL; }						// The mapped class may be going, or the node being interviewed again
 
 		// From CommandClass
 		virtual void ReadXML( TiXmlElement const* _ccElement );
@@ -57,6 +59,7 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+		virtual uint8 GetSetKeyLength( uint8 const _command )const;
 
 		void Set( uint8 const _level );
 
@@ -65,11 +68,13 @@ namespace OpenZWave
 
 	private:
 		Basic( uint32 const _homeId, uint8 const _nodeId );
+		bool UpdateLevel( uint8 const _instance, uint8 const _level );		// Pass a reported level on to the mapped class or the Basic value
 
 		uint8						m_mapping;
 		bool						m_ignoreMapping;
 		bool						m_setAsReport;
 		std::vector<int>			m_instances;
+		CommandClass*				m_mappedClass;				// The class m_mapping names, while the interview is complete, or NULL
 	};
 
 } // namespace OpenZWave
@@ -28,28 +28,18 @@
 #include "command_classes/CommandClasses.h"
 #include "command_classes/CRC16Encap.h"
 #include "Defs.h"
+#include "Checksum.h"
 #include "Msg.h"
 #include "Node.h"
 #include "Driver.h"
+#include "CommandClassProfile.h"
 #include "platform/Log.h"
 
 using namespace OpenZWave;
 
-//
-// CRC-CCITT (0x1D0F)
-//
-uint16 crc16(uint8 const * data_p, uint32 const _length){
-    uint8 x;
-    uint16 crc = 0xF6AF; // 0x1D0F with first byte 0x56;
-	uint32 length = _length;
-
-    while (length--){
-        x = crc >> 8 ^ *data_p++;
-        x ^= x>>4;
-        crc = (crc << 8) ^ ((uint16)(x << 12)) ^ ((uint16)(x <<5)) ^ ((uint16)x);
-    }
-    return crc;
-}
+// CRC-CCITT (0x1D0F) of the command class byte (0x56) that starts each encapsulated
+// message, which the data passed to HandleMsg no longer includes
+static uint16 const c_crcSeed = 0xF6AF;
 
 enum CRC16EncapCmd
 {
@@ -73,7 +63,7 @@ bool CRC16Encap::HandleMsg
 		Log::Write( LogLevel_Info, GetNodeId(), "Received CRC16-command from node %d", GetNodeId());
 
 		uint16 crcM = (_data[_length - 3] << 8) + _data[_length - 2] ; // crc as reported in msg
-		uint16 crcC = crc16(&_data[0], _length - 3 );				   // crc calculated
+		uint16 crcC = Crc16Ccitt( &_data[0], _length - 3, c_crcSeed );				   // crc calculated
 
 		if ( crcM != crcC )
 		{
@@ -87,6 +77,7 @@ bool CRC16Encap::HandleMsg
 
 			if( CommandClass* pCommandClass = node->GetCommandClass( commandClassId ) )
 			{
+				CommandClassProfile::Timer timer( commandClassId, CommandClassProfile::Operation_HandleMsg );
 				pCommandClass->HandleMsg( &_data[2], _length - 4 );
 			}
 		}
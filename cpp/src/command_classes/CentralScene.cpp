@@ -161,6 +161,17 @@ bool CentralScene::HandleMsg
 {
 	if( CentralSceneCmd_Set == (CentralSceneCmd)_data[0] )
 	{
+		// The scene event watchers hear of it first
+		Driver::SceneEvent event;
+		event.m_nodeId = GetNodeId();
+		event.m_instance = (uint8)_instance;
+		event.m_commandClassId = GetCommandClassId();
+		event.m_sceneId = _data[3];
+		event.m_keyAttributes = _data[2] & 0x07;
+		event.m_sequence = _data[1];
+		event.m_duration = 0;
+		GetDriver()->RaiseSceneEvent( event );
+
 		// Central Scene Set received so send notification
 		int32 when;
 		if( _data[2] == 0 )
@@ -219,6 +219,9 @@ bool ClimateControlSchedule::HandleMsg
 				Log::Write( LogLevel_Info, GetNodeId(), "  No Switch points have been set" );
 			}
 
+			// This is now what the device holds, so it need not be sent back
+			value->SetInDevice();
+
 			// Notify the user
 			value->OnValueRefreshed();
 			value->Release();
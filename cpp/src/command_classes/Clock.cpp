@@ -201,16 +201,7 @@ bool Clock::SetValue
 			}
 
 
-			Msg* msg = new Msg( "ClockCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
-			msg->SetInstance( this, instance );
-			msg->Append( GetNodeId() );
-			msg->Append( 4 );
-			msg->Append( GetCommandClassId() );
-			msg->Append( ClockCmd_Set );
-			msg->Append( ( day << 5 ) | hour );
-			msg->Append( minute );
-			msg->Append( GetDriver()->GetTransmitOptions() );
-			GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+			SendSet( instance, day, hour, minute );
 			ret = true;
 		}
 	}
@@ -230,6 +221,89 @@ bool Clock::SetValue
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <Clock::GetSetKeyLength>
+// A later ClockCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 Clock::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ClockCmd_Set == _command ) ? 2 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <Clock::SetTime>
+// Set the device's clock to a local time
+//-----------------------------------------------------------------------------
+bool Clock::SetTime
+(
+	uint8 const _instance,
+	time_t const _time
+)
+{
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(push)
+#pragma warning(disable:4996)
+#endif
+	struct tm* timeinfo = localtime( &_time );
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(pop)
+#endif
+	if( timeinfo == NULL )
+	{
+		return false;
+	}
+
+	// The clock counts the days from Monday = 1 to Sunday = 7
+	uint8 day = timeinfo->tm_wday ? (uint8)timeinfo->tm_wday : 7;
+	uint8 hour = (uint8)timeinfo->tm_hour;
+	uint8 minute = (uint8)timeinfo->tm_min;
+	SendSet( _instance, day, hour, minute );
+
+	if( ValueList* dayValue = static_cast<ValueList*>( GetValue( _instance, ClockIndex_Day ) ) )
+	{
+		dayValue->OnValueRefreshed( day );
+		dayValue->Release();
+	}
+	if( ValueByte* hourValue = static_cast<ValueByte*>( GetValue( _instance, ClockIndex_Hour ) ) )
+	{
+		hourValue->OnValueRefreshed( hour );
+		hourValue->Release();
+	}
+	if( ValueByte* minuteValue = static_cast<ValueByte*>( GetValue( _instance, ClockIndex_Minute ) ) )
+	{
+		minuteValue->OnValueRefreshed( minute );
+		minuteValue->Release();
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Clock::SendSet>
+// Send the day and time to the device
+//-----------------------------------------------------------------------------
+void Clock::SendSet
+(
+	uint8 const _instance,
+	uint8 const _day,
+	uint8 const _hour,
+	uint8 const _minute
+)
+{
+	Msg* msg = new Msg( "ClockCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->SetInstance( this, _instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 4 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( ClockCmd_Set );
+	msg->Append( ( _day << 5 ) | _hour );
+	msg->Append( _minute );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
+
 //-----------------------------------------------------------------------------
 // <Clock::CreateVars>
 // Create the values managed by this command class
@@ -53,12 +53,15 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+		virtual uint8 GetSetKeyLength( uint8 const _command )const;
+		virtual bool SetTime( uint8 const _instance, time_t const _time );
 
 	protected:
 		virtual void CreateVars( uint8 const _instance );
 
 	private:
 		Clock( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){}
+		void SendSet( uint8 const _instance, uint8 const _day, uint8 const _hour, uint8 const _minute );
 	};
 
 } // namespace OpenZWave
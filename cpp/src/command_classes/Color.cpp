@@ -124,7 +124,9 @@ CommandClass( _homeId, _nodeId ),
 m_capabilities ( 0 ),
 m_coloridxbug ( false ),
 m_refreshinprogress ( false ),
-m_coloridxcount ( 0 )
+m_coloridxcount ( 0 ),
+m_awaiting ( 0 ),
+m_stale ( 0 )
 {
 	for (uint8 i = 0; i < 9; i++)
 		m_colorvalues[i] = 0;
@@ -210,25 +212,14 @@ bool Color::RequestState
 	}
 	if (_requestFlags & RequestFlag_Dynamic)
 	{
-		/* do a request for each channel. the RequestValue will filter out channels that are not supported
+		/* request every channel. RequestColorChannels will filter out channels that are not supported
 		 * by the device
 		 */
 		if (m_refreshinprogress == true) {
 			Log::Write(LogLevel_Info, GetNodeId(), "Color Refresh in progress");
 			return false;
 		}
-
-		/* if the device has the ColorIDX bug, then only request the first channel. We will get the rest later */
-		for (int i = 0; i <= 9; i++) {
-			bool tmprequests = RequestColorChannelReport(i, _instance, _queue );
-			if (tmprequests)
-				m_coloridxcount = i;
-			requests |= tmprequests;
-			if (m_coloridxbug && tmprequests) {
-				m_refreshinprogress = true;
-				break;
-			}
-		}
+		requests = RequestColorChannels(m_capabilities, _instance, _queue);
 	}
 
 	return requests;
@@ -253,18 +244,80 @@ bool Color::RequestValue
 			Log::Write(LogLevel_Warning, GetNodeId(), "ColorRefresh is already in progress. Ignoring Get Request");
 			return false;
 		}
-		for (int i = 0; i <= 9; i++) {
-			if (RequestColorChannelReport(i, _instance, _queue))
-			{
-				if (m_coloridxbug) {
-					m_refreshinprogress = true;
-					m_coloridxcount = 0;
-					return true;
-				}
+		/* after a set, only the channels it changed need to be read back */
+		return RequestColorChannels(m_stale ? m_stale : m_capabilities, _instance, _queue);
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Color::RequestColorChannels>
+// Request several channels, together where the device allows it
+//-----------------------------------------------------------------------------
+bool Color::RequestColorChannels
+(
+		uint16 const _channels,
+		uint8 const _instance,
+		Driver::MsgQueue const _queue
+)
+{
+	uint16 channels = _channels & m_capabilities & 0x1ff;
+	if (channels == 0) {
+		return false;
+	}
+	m_awaiting = channels;
+
+	/* if the device has the ColorIDX bug, then only request the first channel. We will get the rest later */
+	if (m_coloridxbug) {
+		for (uint8 idx = 0; idx < 9; idx++) {
+			if (channels & (1<<idx)) {
+				m_coloridxcount = idx;
+				m_refreshinprogress = true;
+				return RequestColorChannelReport(idx, _instance, _queue);
 			}
 		}
 	}
-	return false;
+
+	list<Msg*> batch;
+	for (uint8 idx = 0; idx < 9; idx++) {
+		if (channels & (1<<idx)) {
+			batch.push_back(NewColorGet(idx, _instance));
+		}
+	}
+	Node* node = GetNodeUnsafe();
+	if (node && batch.size() > 1) {
+		/* each Get only has a channel number in it, so they pack well into a MultiCmd */
+		uint32 count = (uint32)batch.size();
+		uint32 encapsulated = 0;
+		uint32 frames = GetDriver()->SendBatch(node, batch, _queue, encapsulated);
+		Log::Write(LogLevel_Detail, GetNodeId(), "Requested %d Color channels in %d frames", count, frames);
+	} else {
+		for (list<Msg*>::iterator it = batch.begin(); it != batch.end(); ++it) {
+			GetDriver()->SendMsg(*it, _queue);
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Color::NewColorGet>
+// Create a request for one channel
+//-----------------------------------------------------------------------------
+Msg* Color::NewColorGet
+(
+		uint8 const coloridx,
+		uint8 const _instance
+)
+{
+	Msg* msg = new Msg("ColorCmd_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId());
+	msg->SetInstance( this, _instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 3 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( ColorCmd_Get );
+	msg->Append( coloridx );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	return msg;
 }
 
 bool Color::RequestColorChannelReport
@@ -276,15 +329,7 @@ bool Color::RequestColorChannelReport
 {
 	/* make sure our coloridx is valid */
 	if ((m_capabilities) & (1<<(coloridx))) {
-		Msg* msg = new Msg("ColorCmd_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId());
-		msg->SetInstance( this, _instance );
-		msg->Append( GetNodeId() );
-		msg->Append( 3 );
-		msg->Append( GetCommandClassId() );
-		msg->Append( ColorCmd_Get );
-		msg->Append( coloridx );
-		msg->Append( GetDriver()->GetTransmitOptions() );
-		GetDriver()->SendMsg( msg, _queue );
+		GetDriver()->SendMsg( NewColorGet( coloridx, _instance ), _queue );
 		return true;
 	}
 	return false;
@@ -413,19 +458,23 @@ bool Color::HandleMsg
 		if (m_coloridxbug) {
 			coloridx = m_coloridxcount;
 			for (uint8 idx = m_coloridxcount + 1; idx < 9; idx++ ) {
-				if (RequestColorChannelReport(idx, _instance, Driver::MsgQueue_Send)) {
+				if ((m_awaiting & (1<<idx)) && RequestColorChannelReport(idx, _instance, Driver::MsgQueue_Send)) {
 					m_coloridxcount = idx;
 					break;
 				}
 			}
 		}
+		if (coloridx > COLORIDX_INDEXCOLOR) {
+			Log::Write(LogLevel_Warning, GetNodeId(), "Color Report for unknown channel %d", coloridx);
+			return false;
+		}
 		m_colorvalues[coloridx] = _data[2];
+		m_stale &= ~(1<<coloridx);
 
-		/* test if there are any more valid coloridx */
-		for ( uint8 idx = coloridx+1; idx < 9; idx++ ) {
-			if ((m_capabilities) & (1<<(idx))) {
-				return true;
-			}
+		/* wait until every channel we asked for has been reported */
+		m_awaiting &= ~(1<<coloridx);
+		if (m_awaiting & m_capabilities) {
+			return true;
 		}
 		if (m_coloridxbug)
 			m_refreshinprogress = false;
@@ -729,6 +778,14 @@ bool Color::SetValue
 		}
 		Log::Write( LogLevel_Info, GetNodeId(), "Color::SetValue - Setting Color value");
 
+		/* note the channels that change, so a refresh only needs to read those back */
+		for (uint8 idx = 0; idx < 8; idx++) {
+			bool sent = (idx == COLORIDX_RED) || (idx == COLORIDX_GREEN) || (idx == COLORIDX_BLUE) || colvalset[idx];
+			if (sent && (colvals[idx] != m_colorvalues[idx])) {
+				m_stale |= (1<<idx);
+			}
+		}
+
 
 		Msg* msg = new Msg( "ColorCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, false);
 		msg->SetInstance( this, _value.GetID().GetInstance() );
@@ -788,6 +845,9 @@ bool Color::SetValue
 		uint8 index = value->GetItem()->m_value;
 		if ((m_capabilities) & (1<<(COLORIDX_INDEXCOLOR))) {
 			Log::Write( LogLevel_Info, GetNodeId(), "Color::SetValue - Setting Color Index Value (Real)");
+			if (index != m_colorvalues[COLORIDX_INDEXCOLOR]) {
+				m_stale |= (1<<COLORIDX_INDEXCOLOR);
+			}
 
 			Msg* msg = new Msg( "Value_Color_Index", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, false);
 			msg->SetInstance( this, _value.GetID().GetInstance() );
@@ -813,6 +873,8 @@ bool Color::SetValue
 			return true;
 		} else {
 			Log::Write( LogLevel_Info, GetNodeId(), "Color::SetValue - Setting Color Index Value (Fake)");
+			/* every channel is sent, so any of them may change */
+			m_stale |= (m_capabilities & ~(1<<COLORIDX_INDEXCOLOR));
 
 			/* figure out the size */
 			uint8 nocols = 3;
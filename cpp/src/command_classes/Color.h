@@ -63,11 +63,15 @@ namespace OpenZWave
 
 	private:
 		Color( uint32 const _homeId, uint8 const _nodeId );
+		Msg* NewColorGet( uint8 const _coloridx, uint8 const _instance );
+		bool RequestColorChannels( uint16 const _channels, uint8 const _instance, Driver::MsgQueue const _queue );
 		uint16 m_capabilities;
 		bool m_coloridxbug; // Fibaro RGBW before version 25.25 always reported the coloridx as 3 in the Report Message. Work around it
 		bool m_refreshinprogress;
 		uint8 m_coloridxcount;
 		uint8 m_colorvalues[9];
+		uint16 m_awaiting;			// Channels requested that have not yet been reported
+		uint16 m_stale;				// Channels set to a new value that have not been reported since
 	};
 
 } // namespace OpenZWave
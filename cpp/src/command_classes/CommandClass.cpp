@@ -32,12 +32,16 @@
 #include "command_classes/Basic.h"
 #include "command_classes/MultiInstance.h"
 #include "command_classes/CommandClasses.h"
+#include "command_classes/Supervision.h"
 #include "Msg.h"
 #include "Node.h"
 #include "Driver.h"
+#include "CommandClassProfile.h"
 #include "Manager.h"
+#include "Options.h"
 #include "platform/Log.h"
 #include "value_classes/ValueStore.h"
+#include "value_classes/ValueDecimal.h"
 
 using namespace OpenZWave;
 
@@ -47,6 +51,49 @@ static uint8 const	c_scaleShift		= 0x03;
 static uint8 const	c_precisionMask		= 0xe0;
 static uint8 const	c_precisionShift	= 0x05;
 
+// Read for every refresh of a value
+static Options::Handle<int32> s_refreshMaxAge( "RefreshMaxAge", 0 );
+
+namespace
+{
+	// Readers and writers of the big endian, signed numbers of the sizes that
+	// values are sent in, so the compiler can fix each one's shifts and sign extension
+	template<uint8 Size> int32 DecodeMantissa( uint8 const* _data );
+
+	template<> inline int32 DecodeMantissa<1>( uint8 const* _data )
+	{
+		return (int8)_data[0];
+	}
+
+	template<> inline int32 DecodeMantissa<2>( uint8 const* _data )
+	{
+		return (int16)( ( (uint16)_data[0] << 8 ) | _data[1] );
+	}
+
+	template<> inline int32 DecodeMantissa<4>( uint8 const* _data )
+	{
+		return (int32)( ( (uint32)_data[0] << 24 ) | ( (uint32)_data[1] << 16 ) | ( (uint32)_data[2] << 8 ) | _data[3] );
+	}
+
+	template<uint8 Size> inline void EncodeMantissa( Msg* _msg, int32 const _mantissa )
+	{
+		for( int32 shift = ( Size - 1 ) * 8; shift >= 0; shift -= 8 )
+		{
+			_msg->Append( (uint8)( _mantissa >> shift ) );
+		}
+	}
+
+	// The fewest of 1, 2 or 4 bytes that hold a number
+	inline uint8 GetMantissaSize( int32 const _mantissa )
+	{
+		if( _mantissa < 0 )
+		{
+			return ( _mantissa >= -0x80 ) ? 1 : ( ( _mantissa >= -0x8000 ) ? 2 : 4 );
+		}
+		return ( _mantissa <= 0xff ) ? 1 : ( ( _mantissa <= 0xffff ) ? 2 : 4 );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <CommandClass::CommandClass>
 // Constructor
@@ -385,6 +432,26 @@ void CommandClass::ReadValueRefreshXML
 	}
 	if (ok == true) {
 		m_RefreshClassValues.push_back( rcc );
+
+		// Index the targets by their trigger, so that a change is matched with one lookup
+		vector<RefreshValue const*>& targets = m_refreshTargets[RefreshKey( rcc->genre, rcc->instance, rcc->index )];
+		for (uint32 i = 0; i < rcc->RefreshClasses.size(); i++)
+		{
+			RefreshValue const* arcc = rcc->RefreshClasses.at(i);
+			bool known = false;
+			for (uint32 j = 0; j < targets.size(); j++)
+			{
+				if ((targets[j]->cc == arcc->cc) && (targets[j]->genre == arcc->genre) && (targets[j]->instance == arcc->instance) && (targets[j]->index == arcc->index))
+				{
+					known = true;
+					break;
+				}
+			}
+			if (!known)
+			{
+				targets.push_back(arcc);
+			}
+		}
 	} else {
 		Log::Write(LogLevel_Warning, GetNodeId(), "Failed to add a RefreshClassValue from XML");
 		delete rcc;
@@ -393,38 +460,41 @@ void CommandClass::ReadValueRefreshXML
 
 //-----------------------------------------------------------------------------
 // <CommandClass::CheckForRefreshValues>
-// Scan our m_RefreshClassValues vector to see if we should call any other
-// Command Classes to refresh their value
+// Look up the values that a change to this one should refresh.  Refreshes
+// triggered while the driver handles a frame are collected, and requested
+// together once it has been.
 //-----------------------------------------------------------------------------
 
 bool CommandClass::CheckForRefreshValues (
 		Value const* _value
 )
 {
-	if (m_RefreshClassValues.empty())
+	if (m_refreshTargets.empty())
 	{
 		//Log::Write(LogLevel_Debug, GetNodeId(), "Bailing out of CheckForRefreshValues");
 		return false;
 	}
+	ValueID const& id = _value->GetID();
+	map< uint32, vector<RefreshValue const*> >::const_iterator it = m_refreshTargets.find( RefreshKey( (uint8)id.GetGenre(), id.GetInstance(), id.GetIndex() ) );
+	if (it == m_refreshTargets.end())
+	{
+		return false;
+	}
 	Node* node = GetNodeUnsafe();
 	if( node != NULL )
 	{
-		for (uint32 i = 0; i < m_RefreshClassValues.size(); i++)
+		vector<RefreshValue const*> const& targets = it->second;
+		for (uint32 j = 0; j < targets.size(); j++)
 		{
-			RefreshValue *rcc = m_RefreshClassValues.at(i);
-			//Log::Write(LogLevel_Debug, GetNodeId(), "Checking Value Against RefreshClassList: CommandClass %s = %s, Genre %d = %d, Instance %d = %d, Index %d = %d", CommandClasses::GetName(rcc->cc).c_str(), CommandClasses::GetName(_value->GetID().GetCommandClassId()).c_str(), rcc->genre, _value->GetID().GetGenre(), rcc->instance, _value->GetID().GetInstance(), rcc->index, _value->GetID().GetIndex());
-			if ((rcc->genre == _value->GetID().GetGenre()) && (rcc->instance == _value->GetID().GetInstance()) && (rcc->index == _value->GetID().GetIndex()) )
+			RefreshValue const* arcc = targets[j];
+			Log::Write(LogLevel_Debug, GetNodeId(), "Requesting Refresh of Value: CommandClass: %s Genre %d, Instance %d, Index %d", CommandClasses::GetName(arcc->cc).c_str(), arcc->genre, arcc->instance, arcc->index);
+			if( GetDriver()->CollectTriggeredRefresh( GetNodeId(), arcc->cc, arcc->genre, arcc->instance, arcc->index ) )
 			{
-				/* we got a match..... */
-				for (uint32 j = 0; j < rcc->RefreshClasses.size(); j++)
-				{
-					RefreshValue *arcc = rcc->RefreshClasses.at(j);
-					Log::Write(LogLevel_Debug, GetNodeId(), "Requesting Refresh of Value: CommandClass: %s Genre %d, Instance %d, Index %d", CommandClasses::GetName(arcc->cc).c_str(), arcc->genre, arcc->instance, arcc->index);
-					if( CommandClass* cc = node->GetCommandClass( arcc->cc ) )
-					{
-						cc->RequestValue(arcc->genre, arcc->index, arcc->instance, Driver::MsgQueue_Send);
-					}
-				}
+				continue;
+			}
+			if( CommandClass* cc = node->GetCommandClass( arcc->cc ) )
+			{
+				cc->RequestValueIfStale( -1, arcc->genre, arcc->index, arcc->instance, Driver::MsgQueue_Send );
 			}
 		}
 	}
@@ -551,9 +621,34 @@ string CommandClass::ExtractValue
 		uint8* _precision,
 		uint8 _valueOffset // = 1
 )const
+{
+	ValueDecimal::Fixed value;
+	value.m_mantissa = ExtractMantissa( _data, _scale, &value.m_precision, _valueOffset );
+	if( _precision )
+	{
+		*_precision = value.m_precision;
+	}
+
+	// Convert the integer to a decimal string.  We avoid
+	// using floats to prevent accuracy issues.
+	char numBuf[16];
+	return ValueDecimal::Format( value, numBuf, sizeof(numBuf) );
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::ExtractMantissa>
+// Read a value from a variable length sequence of bytes, as an integer and
+// the number of digits after its decimal point
+//-----------------------------------------------------------------------------
+int32 CommandClass::ExtractMantissa
+(
+		uint8 const* _data,
+		uint8* _scale,
+		uint8* _precision,
+		uint8 _valueOffset // = 1
+)const
 {
 	uint8 const size = _data[0] & c_sizeMask;
-	uint8 const precision = (_data[0] & c_precisionMask) >> c_precisionShift;
 
 	if( _scale )
 	{
@@ -562,82 +657,28 @@ string CommandClass::ExtractValue
 
 	if( _precision )
 	{
-		*_precision = precision;
+		*_precision = (_data[0] & c_precisionMask) >> c_precisionShift;
+	}
+
+	uint8 const* data = &_data[_valueOffset];
+	switch( size )
+	{
+		case 1:	return DecodeMantissa<1>( data );
+		case 2:	return DecodeMantissa<2>( data );
+		case 4:	return DecodeMantissa<4>( data );
+		default:	break;
 	}
 
+	// Other sizes are outside the spec, but are read as before
 	uint32 value = 0;
 	uint8 i;
 	for( i=0; i<size; ++i )
 	{
 		value <<= 8;
-		value |= (uint32)_data[i+(uint32)_valueOffset];
-	}
-
-	// Deal with sign extension.  All values are signed
-	string res;
-	if( _data[_valueOffset] & 0x80 )
-	{
-		res = "-";
-
-		// MSB is signed
-		if( size == 1 )
-		{
-			value |= 0xffffff00;
-		}
-		else if( size == 2 )
-		{
-			value |= 0xffff0000;
-		}
-	}
-
-	// Convert the integer to a decimal string.  We avoid
-	// using floats to prevent accuracy issues.
-	char numBuf[12] = {0};
-
-	if( precision == 0 )
-	{
-		// The precision is zero, so we can just print the number directly into the string.
-		snprintf( numBuf, 12, "%d", (signed int)value );
-		res = numBuf;
-	}
-	else
-	{
-		// We'll need to insert a decimal point and include any necessary leading zeros.
-
-		// Fill the buffer with the value padded with leading zeros.
-		snprintf( numBuf, 12, "%011d", (signed int)value );
-
-		// Calculate the position of the decimal point in the buffer
-		int32 decimal = 10-precision;
-
-		// Shift the characters to make space for the decimal point.
-		// We don't worry about overwriting any minus sign since that is
-		// already written into the res string. While we're shifting, we
-		// also look for the real starting position of the number so we
-		// can copy it into the res string later.
-		int32 start = -1;
-		for( int32 i=0; i<decimal; ++i )
-		{
-			numBuf[i] = numBuf[i+1];
-			if( ( start<0 ) && ( numBuf[i] != '0' ) )
-			{
-				start = i;
-			}
-		}
-		if( start<0 )
-		{
-			start = decimal-1;
-		}
-
-		// Insert the decimal point
-		struct lconv const* locale = localeconv();
-		numBuf[decimal] = *(locale->decimal_point);
-
-		// Copy the buffer into res
-		res += &numBuf[start];
+		value |= (uint32)data[i];
 	}
 
-	return res;
+	return (int32)value;
 }
 
 //-----------------------------------------------------------------------------
@@ -664,6 +705,37 @@ void CommandClass::AppendValue
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <CommandClass::AppendValue>
+// Add a number with a fixed number of decimal places to a message as a
+// sequence of bytes
+//-----------------------------------------------------------------------------
+void CommandClass::AppendValue
+(
+		Msg* _msg,
+		int32 const _mantissa,
+		uint8 const _precision,
+		uint8 const _scale
+)const
+{
+	int32 val = _mantissa;
+	uint8 precision = _precision;
+	while( precision < m_overridePrecision )
+	{
+		++precision;
+		val *= 10;
+	}
+
+	uint8 size = GetMantissaSize( val );
+	_msg->Append( (precision<<c_precisionShift) | (_scale<<c_scaleShift) | size );
+	switch( size )
+	{
+		case 1:		EncodeMantissa<1>( _msg, val );	break;
+		case 2:		EncodeMantissa<2>( _msg, val );	break;
+		default:	EncodeMantissa<4>( _msg, val );	break;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <CommandClass::GetAppendValueSize>
 // Get the number of bytes that would be added by a call to AppendValue
@@ -678,6 +750,24 @@ uint8 const CommandClass::GetAppendValueSize
 	return size;
 }
 
+//-----------------------------------------------------------------------------
+// <CommandClass::GetAppendValueSize>
+// Get the number of bytes that would be added by a call to AppendValue
+//-----------------------------------------------------------------------------
+uint8 const CommandClass::GetAppendValueSize
+(
+		int32 const _mantissa,
+		uint8 const _precision
+)const
+{
+	int32 val = _mantissa;
+	for( uint8 precision = _precision; precision < m_overridePrecision; ++precision )
+	{
+		val *= 10;
+	}
+	return GetMantissaSize( val );
+}
+
 //-----------------------------------------------------------------------------
 // <CommandClass::ValueToInteger>
 // Convert a decimal string to an integer and report the precision and
@@ -728,29 +818,7 @@ int32 CommandClass::ValueToInteger
 	if( o_size )
 	{
 		// Work out the size as either 1, 2 or 4 bytes
-		*o_size = 4;
-		if( val < 0 )
-		{
-			if( ( val & 0xffffff80 ) == 0xffffff80 )
-			{
-				*o_size = 1;
-			}
-			else if( ( val & 0xffff8000 ) == 0xffff8000 )
-			{
-				*o_size = 2;
-			}
-		}
-		else
-		{
-			if( ( val & 0xffffff00 ) == 0 )
-			{
-				*o_size = 1;
-			}
-			else if( ( val & 0xffff0000 ) == 0 )
-			{
-				*o_size = 2;
-			}
-		}
+		*o_size = GetMantissaSize( val );
 	}
 
 	return val;
@@ -792,6 +860,51 @@ void CommandClass::ClearStaticRequest
 	m_staticRequests &= ~_request;
 }
 
+//-----------------------------------------------------------------------------
+// <CommandClass::Supervise>
+// Have a Set wrapped in a Supervision Get, so that the node reports whether
+// it carried the Set out
+//-----------------------------------------------------------------------------
+bool CommandClass::Supervise
+(
+	Msg* _msg,
+	uint8 const _instance,
+	uint8 const _index
+)
+{
+	if( Node* node = GetNodeUnsafe() )
+	{
+		Supervision* supervision = static_cast<Supervision*>( node->GetCommandClass( Supervision::StaticGetCommandClassId() ) );
+		if( supervision && !supervision->IsAfterMark() )
+		{
+			supervision->StartSession( _msg, GetCommandClassId(), _instance, _index );
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <CommandClass::IsSupervised>
+// Whether a Set of a value is waiting for a Supervision report, in which case
+// there is no need to read the value back
+//-----------------------------------------------------------------------------
+bool CommandClass::IsSupervised
+(
+	uint8 const _instance,
+	uint8 const _index
+)
+{
+	if( Node* node = GetNodeUnsafe() )
+	{
+		if( Supervision* supervision = static_cast<Supervision*>( node->GetCommandClass( Supervision::StaticGetCommandClassId() ) ) )
+		{
+			return supervision->IsPending( GetCommandClassId(), _instance, _index );
+		}
+	}
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // <CommandClass::RequestStateForAllInstances>
 // Request current state from the device
@@ -805,6 +918,7 @@ bool CommandClass::RequestStateForAllInstances
 	bool res = false;
 	if( m_createVars )
 	{
+		CommandClassProfile::Timer timer( GetCommandClassId(), CommandClassProfile::Operation_RequestState );
 		if( Node* node = GetNodeUnsafe() )
 		{
 			MultiInstance* multiInstance = static_cast<MultiInstance*>( node->GetCommandClass( MultiInstance::StaticGetCommandClassId() ) );
@@ -825,4 +939,34 @@ bool CommandClass::RequestStateForAllInstances
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <CommandClass::RequestValueIfStale>
+// Request a value, unless it was read from the device recently enough
+//-----------------------------------------------------------------------------
+bool CommandClass::RequestValueIfStale
+(
+		int32 const _maxAge,
+		uint32 const _requestFlags,
+		uint8 const _index,
+		uint8 const _instance,
+		Driver::MsgQueue const _queue
+)
+{
+	int32 maxAge = ( _maxAge < 0 ) ? s_refreshMaxAge.Get() : _maxAge;
+	if( maxAge > 0 )
+	{
+		if( Value* value = GetValue( _instance, _index ) )
+		{
+			bool cached = value->RefreshFromCache( (uint32)maxAge );
+			value->Release();
+			if( cached )
+			{
+				return true;
+			}
+		}
+	}
+	CommandClassProfile::Timer timer( GetCommandClassId(), CommandClassProfile::Operation_RequestValue );
+	return RequestValue( _requestFlags, _index, _instance, _queue );
+}
+
 
@@ -31,6 +31,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <time.h>
 #include "Defs.h"
 #include "Bitfield.h"
 #include "Driver.h"
@@ -68,9 +69,16 @@ namespace OpenZWave
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 ) = 0;
 		virtual bool SetValue( Value const& _value ){ return false; }
 		virtual void SetValueBasic( uint8 const _instance, uint8 const _level ){}		// Class specific handling of BASIC value mapping
+		virtual uint8 GetSetKeyLength( uint8 const _command )const{ return 0; }		// Bytes at the start of a command's payload that say what it sets, so that a later command starting with the same bytes can replace it in a wake up queue.  0 if it is never replaced.
+		virtual bool ApplySupervisedSet( uint8 const* _data, uint8 const _length, uint8 const _instance ){ return false; }	// Update the values from a Set, starting at its command byte, that the node reported it carried out.  False if they must be read back instead.
+		virtual bool SetTime( uint8 const _instance, time_t const _time ){ return false; }	// Set the device's clock to a time, as Driver::SyncTime does.  False if the class has no clock.
 		virtual void SetVersion( uint8 const _version ){ m_version = _version; }
+		void RestoreVersion( uint8 const _version ){ m_version = _version; }		// As ReadXML does, without what SetVersion may request
 
 		bool RequestStateForAllInstances( uint32 const _requestFlags, Driver::MsgQueue const _queue );
+		bool RequestValueIfStale( int32 const _maxAge, uint32 const _requestFlags, uint8 const _index, uint8 const _instance, Driver::MsgQueue const _queue );	// RequestValue, unless the value was read within _maxAge ms (-1 for the RefreshMaxAge option)
+		bool Supervise( Msg* _msg, uint8 const _instance, uint8 const _index );		// Have the node report on a Set, if it supports Supervision.  Call after Msg::SetInstance.
+		bool IsSupervised( uint8 const _instance, uint8 const _index );			// Whether a Set of a value is waiting for a Supervision report
 		bool CheckForRefreshValues(Value const* _value );
 
 		// The highest version number of the command class implemented by OpenZWave.  We only need
@@ -119,6 +127,7 @@ namespace OpenZWave
 
 		// Helper methods
 		string ExtractValue( uint8 const* _data, uint8* _scale, uint8* _precision, uint8 _valueOffset = 1 )const;
+		int32 ExtractMantissa( uint8 const* _data, uint8* _scale, uint8* _precision, uint8 _valueOffset = 1 )const;	// As ExtractValue, without turning the number into a string
 
 		/**
 		 *  Append a floating-point value to a message.
@@ -128,7 +137,9 @@ namespace OpenZWave
 		 *  \see Msg
 		 */
 		void AppendValue( Msg* _msg, string const& _value, uint8 const _scale )const;
+		void AppendValue( Msg* _msg, int32 const _mantissa, uint8 const _precision, uint8 const _scale )const;	// As above, from the number rather than a string
 		uint8 const GetAppendValueSize( string const& _value )const;
+		uint8 const GetAppendValueSize( int32 const _mantissa, uint8 const _precision )const;
 		int32 ValueToInteger( string const& _value, uint8* o_precision, uint8* o_size )const;
 
 		void UpdateMappedClass( uint8 const _instance, uint8 const _classId, uint8 const _value );		// Update mapped class's value from BASIC class
@@ -145,6 +156,9 @@ namespace OpenZWave
 		virtual void CreateVars( uint8 const _instance ){}
 		void ReadValueRefreshXML ( TiXmlElement const* _ccElement );
 
+	private:
+		static uint32 RefreshKey( uint8 const _genre, uint8 const _instance, uint8 const _index ){ return ( ((uint32)_genre) << 16 ) | ( ((uint32)_instance) << 8 ) | _index; }
+
 	public:
 		virtual void CreateVars( uint8 const _instance, uint8 const _index ){}
 
@@ -163,6 +177,9 @@ OPENZWAVE_EXPORT_WARNINGS_ON
 		bool		m_isSecured;		// is this command class secured with the Security Command Class
 		bool		m_SecureSupport; 	// Does this commandclass support secure encryption (eg, the Security CC doesn't encrypt itself, so it doesn't support encryption)
 		std::vector<RefreshValue *> m_RefreshClassValues; // what Command Class Values should we refresh ?
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		map< uint32, vector<RefreshValue const*> > m_refreshTargets;	// The values to refresh, from m_RefreshClassValues, by the RefreshKey of the value that triggers them
+OPENZWAVE_EXPORT_WARNINGS_ON
 		bool		m_inNIF; 			// Was this command class present in the NIF Frame we recieved (or was it created from our device_classes.xml file, or because it was in the Security SupportedReport message
 	//-----------------------------------------------------------------------------
 	// Record which items of static data have been read from the device
@@ -0,0 +1,89 @@
+//-----------------------------------------------------------------------------
+//
+//	CommandClassList.h
+//
+//	The command classes that are registered, one line each
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+// Included by CommandClasses::RegisterCommandClasses with OPENZWAVE_COMMAND_CLASS
+// defined, so there is no include guard.
+//
+// A build can register fewer command classes by setting OPENZWAVE_COMMAND_CLASS_LIST
+// to a list of its own, in the same form, as cpp/build/Makefile does with
+// COMMAND_CLASSES.  The classes left out are then never created for a node, as
+// though they were excluded with the Exclude option.
+
+OPENZWAVE_COMMAND_CLASS( Alarm )
+OPENZWAVE_COMMAND_CLASS( ApplicationStatus )
+OPENZWAVE_COMMAND_CLASS( Association )
+OPENZWAVE_COMMAND_CLASS( AssociationCommandConfiguration )
+OPENZWAVE_COMMAND_CLASS( Basic )
+OPENZWAVE_COMMAND_CLASS( BasicWindowCovering )
+OPENZWAVE_COMMAND_CLASS( Battery )
+OPENZWAVE_COMMAND_CLASS( CentralScene )
+OPENZWAVE_COMMAND_CLASS( ClimateControlSchedule )
+OPENZWAVE_COMMAND_CLASS( Clock )
+OPENZWAVE_COMMAND_CLASS( Color )
+OPENZWAVE_COMMAND_CLASS( Configuration )
+OPENZWAVE_COMMAND_CLASS( ControllerReplication )
+OPENZWAVE_COMMAND_CLASS( CRC16Encap )
+OPENZWAVE_COMMAND_CLASS( DeviceResetLocally )
+OPENZWAVE_COMMAND_CLASS( DoorLock )
+OPENZWAVE_COMMAND_CLASS( DoorLockLogging )
+OPENZWAVE_COMMAND_CLASS( EnergyProduction )
+OPENZWAVE_COMMAND_CLASS( FirmwareUpdateMetaData )
+OPENZWAVE_COMMAND_CLASS( Hail )
+OPENZWAVE_COMMAND_CLASS( Indicator )
+OPENZWAVE_COMMAND_CLASS( Language )
+OPENZWAVE_COMMAND_CLASS( Lock )
+OPENZWAVE_COMMAND_CLASS( ManufacturerSpecific )
+OPENZWAVE_COMMAND_CLASS( Meter )
+OPENZWAVE_COMMAND_CLASS( MeterPulse )
+OPENZWAVE_COMMAND_CLASS( MultiCmd )
+OPENZWAVE_COMMAND_CLASS( MultiInstance )
+OPENZWAVE_COMMAND_CLASS( MultiChannelAssociation )
+OPENZWAVE_COMMAND_CLASS( NodeNaming )
+OPENZWAVE_COMMAND_CLASS( NoOperation )
+OPENZWAVE_COMMAND_CLASS( Powerlevel )
+OPENZWAVE_COMMAND_CLASS( Proprietary )
+OPENZWAVE_COMMAND_CLASS( Protection )
+OPENZWAVE_COMMAND_CLASS( SceneActivation )
+OPENZWAVE_COMMAND_CLASS( Security )
+OPENZWAVE_COMMAND_CLASS( SensorAlarm )
+OPENZWAVE_COMMAND_CLASS( SensorBinary )
+OPENZWAVE_COMMAND_CLASS( SensorMultilevel )
+OPENZWAVE_COMMAND_CLASS( Supervision )
+OPENZWAVE_COMMAND_CLASS( SwitchAll )
+OPENZWAVE_COMMAND_CLASS( SwitchBinary )
+OPENZWAVE_COMMAND_CLASS( SwitchMultilevel )
+OPENZWAVE_COMMAND_CLASS( SwitchToggleBinary )
+OPENZWAVE_COMMAND_CLASS( SwitchToggleMultilevel )
+OPENZWAVE_COMMAND_CLASS( TimeParameters )
+OPENZWAVE_COMMAND_CLASS( ThermostatFanMode )
+OPENZWAVE_COMMAND_CLASS( ThermostatFanState )
+OPENZWAVE_COMMAND_CLASS( ThermostatMode )
+OPENZWAVE_COMMAND_CLASS( ThermostatOperatingState )
+OPENZWAVE_COMMAND_CLASS( ThermostatSetpoint )
+OPENZWAVE_COMMAND_CLASS( TransportService )
+OPENZWAVE_COMMAND_CLASS( UserCode )
+OPENZWAVE_COMMAND_CLASS( Version )
+OPENZWAVE_COMMAND_CLASS( WakeUp )
+OPENZWAVE_COMMAND_CLASS( ZWavePlusInfo )
@@ -71,6 +71,11 @@ bool Configuration::HandleMsg
 			paramValue |= (int32)_data[i+3];
 		}
 
+		if( Node* node = GetNodeUnsafe() )
+		{
+			node->MaterializeConfigParam( parameter );
+		}
+
 		if ( Value* value = GetValue( 1, parameter ) )
 		{
 			switch ( value->GetID().GetType() )
@@ -146,6 +151,7 @@ bool Configuration::HandleMsg
 		}
 
 		Log::Write( LogLevel_Info, GetNodeId(), "Received Configuration report: Parameter=%d, Value=%d", parameter, paramValue );
+		GetDriver()->ProvisionReport( GetNodeId(), parameter, paramValue, size );
 		return true;
 	}
 
@@ -210,6 +216,18 @@ bool Configuration::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Configuration::GetSetKeyLength>
+// A later ConfigurationCmd_Set for the same parameter number replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 Configuration::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ConfigurationCmd_Set == _command ) ? 3 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <Configuration::RequestValue>
 // Request current parameter value from the device
@@ -245,7 +245,7 @@ void ControllerReplication::SendNextData
 			}
 		}
 		i = m_nodeId == -1 ? 0 : m_nodeId+1;
-		LockGuard LG(GetDriver()->m_nodeMutex);
+		WriteLockGuard LG(GetDriver()->m_nodeMutex);
 		while( i < 256 )
 		{
 			if( GetDriver()->m_nodes[i] )
@@ -31,7 +31,10 @@
 #include "Msg.h"
 #include "Node.h"
 #include "Driver.h"
+#include "Notification.h"
+#include "Utils.h"
 #include "platform/Log.h"
+#include "platform/Mutex.h"
 
 #include "value_classes/ValueBool.h"
 #include "value_classes/ValueByte.h"
@@ -130,6 +133,8 @@ enum ValueIDSystemIndexes
 	Value_LogRecord						= 0x02		/* Simple String Representation of the Log Record - Tab Delimited Fields */
 };
 
+static uint32 const c_maxRecords = 255;		/* Most records kept for the application, as no log holds more */
+
 
 
 //-----------------------------------------------------------------------------
@@ -143,11 +148,26 @@ DoorLockLogging::DoorLockLogging
 ):
 	CommandClass( _homeId, _nodeId ),
 	m_MaxRecords(0),
-	m_CurRecord(0)
+	m_CurRecord(0),
+	m_lastRecord(0),
+	m_newestRecord(0),
+	m_fetchState(FetchState_Idle),
+	m_recordsMutex( new Mutex() )
 {
 	SetStaticRequest( StaticRequest_Values );
 }
 
+//-----------------------------------------------------------------------------
+// <DoorLockLogging::~DoorLockLogging>
+// Destructor
+//-----------------------------------------------------------------------------
+DoorLockLogging::~DoorLockLogging
+(
+)
+{
+	m_recordsMutex->Release();
+}
+
 //-----------------------------------------------------------------------------
 // <UserCode::ReadXML>
 // Class specific configuration
@@ -164,6 +184,10 @@ void DoorLockLogging::ReadXML
 	{
 		m_MaxRecords = intVal;
 	}
+	if( TIXML_SUCCESS == _ccElement->QueryIntAttribute( "lastrecord", &intVal ) )
+	{
+		m_lastRecord = intVal;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -180,6 +204,11 @@ void DoorLockLogging::WriteXML
 	CommandClass::WriteXML( _ccElement );
 	snprintf( str, sizeof(str), "%d", m_MaxRecords );
 	_ccElement->SetAttribute( "m_MaxRecords", str);
+	if( m_lastRecord != 0 )
+	{
+		snprintf( str, sizeof(str), "%d", m_lastRecord );
+		_ccElement->SetAttribute( "lastrecord", str);
+	}
 }
 
 
@@ -236,20 +265,93 @@ bool DoorLockLogging::RequestValue
 		return true;
 
 	} else if (_what == DoorLockLoggingCmd_Record_Get) {
-		Msg* msg = new Msg( "DoorLockLoggingCmd_Record_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
-		msg->SetInstance( this, _instance );
-		msg->Append( GetNodeId() );
-		msg->Append( 2 );
-		msg->Append( GetCommandClassId() );
-		msg->Append( DoorLockLoggingCmd_Record_Get );
-		msg->Append( m_CurRecord );
-		msg->Append( GetDriver()->GetTransmitOptions() );
-		GetDriver()->SendMsg( msg, _queue );
+		/* Only fetch the records after the cursor.  Record 0 is the most recent one, so
+		 * ask for that first to find out how far the log has moved on.  A fetch that
+		 * never finished is started again from the same cursor */
+		m_fetchState = FetchState_Latest;
+		m_newestText.clear();
+		RequestRecord( 0, _instance, _queue );
 		return true;
 	}
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <DoorLockLogging::RequestRecord>
+// Request one record from the device
+//-----------------------------------------------------------------------------
+void DoorLockLogging::RequestRecord
+(
+	uint8 const _record,
+	uint8 const _instance,
+	Driver::MsgQueue const _queue
+)
+{
+	Msg* msg = new Msg( "DoorLockLoggingCmd_Record_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->SetInstance( this, _instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 3 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( DoorLockLoggingCmd_Record_Get );
+	msg->Append( _record );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, _queue );
+	m_CurRecord = _record;
+}
+
+//-----------------------------------------------------------------------------
+// <DoorLockLogging::EndFetch>
+// Hand the records read to the application
+//-----------------------------------------------------------------------------
+void DoorLockLogging::EndFetch
+(
+	uint8 const _instance
+)
+{
+	uint32 count = 0;
+	{
+		LockGuard LG(m_recordsMutex);
+		if( !m_newestText.empty() )
+		{
+			m_records.push_back( m_newestText );
+			m_newestText.clear();
+		}
+		if( m_records.size() > c_maxRecords )
+		{
+			// The application has not been taking them, so keep only the newest
+			m_records.erase( m_records.begin(), m_records.end() - c_maxRecords );
+		}
+		count = (uint32)m_records.size();
+	}
+	m_fetchState = FetchState_Idle;
+	m_lastRecord = m_newestRecord;
+
+	Log::Write( LogLevel_Info, GetNodeId(), "DoorLockLogging fetch complete, %d records waiting, cursor at record %d", count, m_lastRecord );
+	if( count > 0 )
+	{
+		Notification* notification = new Notification( Notification::Type_DoorLockLogRecords );
+		notification->SetHomeNodeIdAndInstance( GetHomeId(), GetNodeId(), _instance );
+		notification->SetLogRecordCount( (uint8)( count < 0xff ? count : 0xff ) );
+		GetDriver()->QueueNotification( notification );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <DoorLockLogging::TakeRecords>
+// Take the records read since the last call
+//-----------------------------------------------------------------------------
+uint32 DoorLockLogging::TakeRecords
+(
+	vector<string>* o_records
+)
+{
+	LockGuard LG(m_recordsMutex);
+	uint32 count = (uint32)m_records.size();
+	o_records->insert( o_records->end(), m_records.begin(), m_records.end() );
+	m_records.clear();
+	return count;
+}
+
 
 //-----------------------------------------------------------------------------
 // <DoorLockLogging::HandleMsg>
@@ -288,16 +390,15 @@ bool DoorLockLogging::HandleMsg
 			value->OnValueRefreshed( _data[1]);
 			value->Release();
 		}
-		if( ValueString* value = static_cast<ValueString*>( GetValue( _instance, Value_LogRecord ) ) )
+		char msg[512];
+		bool valid = false;
 		{
-			char msg[512];
 			uint16 year = (_data[2] << 8) + (_data[3] & 0xFF);
 			uint8 month = (_data[4] & 0x0F);
 			uint8 day = (_data[5] & 0x1F);
 			uint8 hour = (_data[6] & 0x1F);
 			uint8 minute = (_data[7] & 0x3F);
 			uint8 second = (_data[8] & 0x3F);
-			bool valid = false;
 			if (((_data[6] & 0xE0) >> 5) > 0)
 			{
 				valid = true;
@@ -316,9 +417,53 @@ bool DoorLockLogging::HandleMsg
 				snprintf(msg, sizeof(msg), "%02d/%02d/%02d %02d:%02d:%02d \tMessage: %s \tUserID: %d \t%s", (int)day, (int)month, (int)year, (int)hour, (int)minute, (int)second, c_DoorLockEventType[EventType], (int)userid, usercode);
 			} else
 				snprintf(msg, sizeof(msg), "Invalid Record");
+		}
+		if( ValueString* value = static_cast<ValueString*>( GetValue( _instance, Value_LogRecord ) ) )
+		{
 			value->OnValueRefreshed(msg);
 			value->Release();
 		}
+
+		uint8 record = _data[1];
+		if( m_fetchState == FetchState_Latest )
+		{
+			m_newestRecord = record;
+			if( record == 0 || record == m_lastRecord )
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "No new DoorLockLogging records since record %d", m_lastRecord );
+				m_fetchState = FetchState_Idle;
+				return true;
+			}
+			if( valid )
+			{
+				m_newestText = msg;
+			}
+			if( m_lastRecord == 0 || record > m_MaxRecords || NextRecord( m_lastRecord ) == record )
+			{
+				/* Without a cursor (or the size of the log) we cannot tell which records
+				 * are new, so start from the most recent one rather than walk them all */
+				EndFetch( _instance );
+				return true;
+			}
+			m_fetchState = FetchState_Walk;
+			RequestRecord( NextRecord( m_lastRecord ), _instance, Driver::MsgQueue_Send );
+		}
+		else if( m_fetchState == FetchState_Walk && record == m_CurRecord )
+		{
+			if( valid )
+			{
+				LockGuard LG(m_recordsMutex);
+				m_records.push_back( msg );
+			}
+			if( NextRecord( record ) == m_newestRecord )
+			{
+				EndFetch( _instance );
+			}
+			else
+			{
+				RequestRecord( NextRecord( record ), _instance, Driver::MsgQueue_Send );
+			}
+		}
 		return true;
 
 	}
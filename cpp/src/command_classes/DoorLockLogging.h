@@ -28,10 +28,12 @@
 #ifndef _DoorLockLogging_H
 #define _DoorLockLogging_H
 
+#include <vector>
 #include "CommandClass.h"
 
 namespace OpenZWave
 {
+	class Mutex;
 	class ValueBool;
 
 	/** \brief Implements COMMAND_CLASS_DOOR_LOCK_LOGGING (0x4C), a Z-Wave device command class.
@@ -40,7 +42,7 @@ namespace OpenZWave
 	{
 	public:
 		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new DoorLockLogging( _homeId, _nodeId ); }
-		virtual ~DoorLockLogging(){}
+		virtual ~DoorLockLogging();
 
 		static uint8 const StaticGetCommandClassId(){ return 0x4c; }
 		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_DOOR_LOCK_LOGGING"; }
@@ -54,13 +56,39 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+
+		/**
+		 * Take the records read since the last call.
+		 * \param o_records the records are added to the end of this, oldest first, in the
+		 * same form as the Log Record value.
+		 * \return the number of records added.
+		 */
+		uint32 TakeRecords( vector<string>* o_records );
+
 	protected:
 		virtual void CreateVars( uint8 const _instance );
 
 	private:
 		DoorLockLogging( uint32 const _homeId, uint8 const _nodeId );
+		uint8 NextRecord( uint8 const _record )const{ return ( _record >= m_MaxRecords ) ? 1 : _record + 1; }
+		void RequestRecord( uint8 const _record, uint8 const _instance, Driver::MsgQueue const _queue );
+		void EndFetch( uint8 const _instance );
+
+		enum FetchState
+		{
+			FetchState_Idle = 0,
+			FetchState_Latest,				// Waiting for the most recent record, to learn its number
+			FetchState_Walk					// Reading each record after the cursor in turn
+		};
+
 		uint8 m_MaxRecords;
 		uint8 m_CurRecord;
+		uint8 m_lastRecord;					// The newest record read by a fetch, or 0 if none has been
+		uint8 m_newestRecord;				// Where the fetch in progress stops
+		FetchState m_fetchState;
+		string m_newestText;				// The most recent record, kept until the ones before it have been read
+		Mutex* m_recordsMutex;
+		vector<string> m_records;			// Read but not yet taken by the application
 	};
 
 } // namespace OpenZWave
@@ -134,7 +134,7 @@ bool EnergyProduction::HandleMsg
 	{
 		uint8 scale;
 		uint8 precision = 0;
-		string value = ExtractValue( &_data[2], &scale, &precision );
+		int32 mantissa = ExtractMantissa( &_data[2], &scale, &precision );
 		uint8 paramType = _data[1];
 		if (paramType > 4) /* size of  c_energyParameterNames minus Invalid Entry*/
 		{
@@ -142,10 +142,14 @@ bool EnergyProduction::HandleMsg
 			return false;
 		}
 
-		Log::Write( LogLevel_Info, GetNodeId(), "Received an Energy production report: %s = %s", c_energyParameterNames[_data[1]], value.c_str() );
+		ValueDecimal::Fixed reading;
+		reading.m_mantissa = mantissa;
+		reading.m_precision = precision;
+		char valueStr[16];
+		Log::Write( LogLevel_Info, GetNodeId(), "Received an Energy production report: %s = %s", c_energyParameterNames[_data[1]], ValueDecimal::Format( reading, valueStr, sizeof(valueStr) ) );
 		if( ValueDecimal* decimalValue = static_cast<ValueDecimal*>( GetValue( _instance, _data[1] ) ) )
 		{
-			decimalValue->OnValueRefreshed( value );
+			decimalValue->OnValueRefreshed( mantissa, precision );
 			if( decimalValue->GetPrecision() != precision )
 			{
 				decimalValue->SetPrecision( precision );
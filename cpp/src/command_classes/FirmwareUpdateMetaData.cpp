@@ -0,0 +1,580 @@
+//-----------------------------------------------------------------------------
+//
+//	FirmwareUpdateMetaData.cpp
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_FIRMWARE_UPDATE_MD
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "command_classes/CommandClasses.h"
+#include "command_classes/FirmwareUpdateMetaData.h"
+#include "Defs.h"
+#include "Checksum.h"
+#include "Msg.h"
+#include "Node.h"
+#include "Driver.h"
+#include "Notification.h"
+#include "Utils.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+enum FirmwareUpdateMetaDataCmd
+{
+	FirmwareUpdateMetaDataCmd_Get				= 0x01,
+	FirmwareUpdateMetaDataCmd_Report			= 0x02,
+	FirmwareUpdateMetaDataCmd_RequestGet		= 0x03,
+	FirmwareUpdateMetaDataCmd_RequestReport		= 0x04,
+	FirmwareUpdateMetaDataCmd_FragmentGet		= 0x05,
+	FirmwareUpdateMetaDataCmd_FragmentReport	= 0x06,
+	FirmwareUpdateMetaDataCmd_StatusReport		= 0x07
+};
+
+static uint8 const c_requestValid = 0xff;				// Request Report status when the node will take the image
+static uint8 const c_statusStored = 0xfd;				// Status Reports from here up mean the image was taken
+static uint8 const c_lastFragment = 0x80;
+
+// The command class payload of a ZW_SEND_DATA request can be no longer than this.
+// Security encapsulation takes 20 bytes of it, and a fragment report has 6 bytes
+// of its own around the image data.
+static uint32 const c_maxPayload = 46;
+static uint32 const c_securityOverhead = 20;
+static uint32 const c_reportOverhead = 6;
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::FirmwareUpdateMetaData>
+// Constructor
+//-----------------------------------------------------------------------------
+FirmwareUpdateMetaData::FirmwareUpdateMetaData
+(
+	uint32 const _homeId,
+	uint8 const _nodeId
+):
+	CommandClass( _homeId, _nodeId ),
+	m_mutex( new Mutex() ),
+	m_state( Driver::FirmwareUpdateState_Idle ),
+	m_status( 0 ),
+	m_target( 0 ),
+	m_image( NULL ),
+	m_imageSize( 0 ),
+	m_checksum( 0 ),
+	m_haveMetaData( false ),
+	m_manufacturerId( 0 ),
+	m_hardwareVersion( 0 ),
+	m_maxFragmentSize( 0 ),
+	m_fragmentSize( 0 ),
+	m_highest( 0 ),
+	m_sent( 0 ),
+	m_percent( 0 ),
+	m_elapsed( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::~FirmwareUpdateMetaData>
+// Destructor
+//-----------------------------------------------------------------------------
+FirmwareUpdateMetaData::~FirmwareUpdateMetaData
+(
+)
+{
+	if( m_image )
+	{
+		FileOps::UnmapFile( m_image, m_imageSize );
+	}
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::HandleMsg>
+// Handle a message from the Z-Wave network
+//-----------------------------------------------------------------------------
+bool FirmwareUpdateMetaData::HandleMsg
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint32 const _instance	// = 1
+)
+{
+	LockGuard LG( m_mutex );
+	switch( (FirmwareUpdateMetaDataCmd)_data[0] )
+	{
+		case FirmwareUpdateMetaDataCmd_Report:
+		{
+			if( _length >= 7 )
+			{
+				HandleMetaDataReport( _data, _length );
+			}
+			return true;
+		}
+		case FirmwareUpdateMetaDataCmd_RequestReport:
+		{
+			if( m_state != Driver::FirmwareUpdateState_Requesting )
+			{
+				return true;
+			}
+			if( _data[1] == c_requestValid )
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "Firmware update request accepted, sending %d fragments of %d bytes", m_crcs.size(), m_fragmentSize );
+				m_started.SetTime();
+				SetState( Driver::FirmwareUpdateState_Transferring );
+			}
+			else
+			{
+				Log::Write( LogLevel_Warning, GetNodeId(), "Firmware update request refused, status 0x%.2x", _data[1] );
+				EndUpdate( Driver::FirmwareUpdateState_Failed, _data[1] );
+			}
+			return true;
+		}
+		case FirmwareUpdateMetaDataCmd_FragmentGet:
+		{
+			if( _length >= 4 )
+			{
+				HandleGet( _data );
+			}
+			return true;
+		}
+		case FirmwareUpdateMetaDataCmd_StatusReport:
+		{
+			if( m_state != Driver::FirmwareUpdateState_Transferring && m_state != Driver::FirmwareUpdateState_Verifying )
+			{
+				return true;
+			}
+			if( _data[1] >= c_statusStored )
+			{
+				EndUpdate( Driver::FirmwareUpdateState_Complete, _data[1] );
+			}
+			else
+			{
+				EndUpdate( Driver::FirmwareUpdateState_Failed, _data[1] );
+			}
+			return true;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::BeginUpdate>
+// Map the image and ask the node which firmware it runs, to start the update
+//-----------------------------------------------------------------------------
+bool FirmwareUpdateMetaData::BeginUpdate
+(
+	string const& _fileName,
+	uint8 const _target
+)
+{
+	LockGuard LG( m_mutex );
+	if( m_image != NULL )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "A firmware update is already under way" );
+		return false;
+	}
+
+	uint32 size = 0;
+	m_image = FileOps::MapFile( _fileName, size );
+	if( m_image == NULL || size == 0 )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Firmware image %s could not be read", _fileName.c_str() );
+		if( m_image )
+		{
+			FileOps::UnmapFile( m_image, size );
+			m_image = NULL;
+		}
+		return false;
+	}
+
+	m_imageSize = size;
+	m_checksum = Crc16Ccitt( m_image, m_imageSize );
+	m_target = _target;
+	m_status = 0;
+	m_highest = 0;
+	m_sent = 0;
+	m_percent = 0;
+	m_elapsed = 0;
+	m_crcs.clear();
+	Log::Write( LogLevel_Info, GetNodeId(), "Starting firmware update of target %d with %s, %d bytes", m_target, _fileName.c_str(), m_imageSize );
+
+	// The firmware ids may have changed since they were last read, with an earlier update
+	SetState( Driver::FirmwareUpdateState_MetaData );
+	RequestMetaData();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::CancelUpdate>
+// Stop sending fragments
+//-----------------------------------------------------------------------------
+bool FirmwareUpdateMetaData::CancelUpdate
+(
+)
+{
+	LockGuard LG( m_mutex );
+	if( m_image == NULL )
+	{
+		return false;
+	}
+
+	Log::Write( LogLevel_Info, GetNodeId(), "Firmware update cancelled" );
+	EndUpdate( Driver::FirmwareUpdateState_Failed, 0 );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::GetProgress>
+// Report on the update under way, or the last one
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::GetProgress
+(
+	Driver::FirmwareUpdateData* _data
+)
+{
+	LockGuard LG( m_mutex );
+	_data->m_state = m_state;
+	_data->m_status = m_status;
+	_data->m_fragmentSize = m_fragmentSize;
+	_data->m_fragments = (uint32)m_crcs.size();
+	_data->m_highest = m_highest;
+	_data->m_sent = m_sent;
+	_data->m_elapsed = GetElapsed();
+
+	uint32 bytes = m_highest * m_fragmentSize;
+	if( bytes > m_imageSize )
+	{
+		bytes = m_imageSize;
+	}
+	_data->m_bytesPerSecond = _data->m_elapsed ? (uint32)( (uint64)bytes * 1000 / _data->m_elapsed ) : 0;
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::HandleMetaDataReport>
+// Note which firmware the node runs, and ask it to take the image
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::HandleMetaDataReport
+(
+	uint8 const* _data,
+	uint32 const _length
+)
+{
+	m_haveMetaData = true;
+	m_manufacturerId = ( (uint16)_data[1] << 8 ) | _data[2];
+	m_firmwareIds.assign( 1, ( (uint16)_data[3] << 8 ) | _data[4] );
+	m_maxFragmentSize = 0;
+	m_hardwareVersion = 0;
+
+	bool upgradable = true;
+	if( _length >= 11 )
+	{
+		// Version 3 and later
+		upgradable = ( _data[7] != 0 );
+		uint8 targets = _data[8];
+		m_maxFragmentSize = ( (uint16)_data[9] << 8 ) | _data[10];
+		uint32 pos = 11;
+		for( uint8 i = 0; i < targets && pos + 2 <= _length - 1; ++i, pos += 2 )
+		{
+			m_firmwareIds.push_back( ( (uint16)_data[pos] << 8 ) | _data[pos+1] );
+		}
+		if( pos < _length - 1 )
+		{
+			// Version 5
+			m_hardwareVersion = _data[pos];
+		}
+	}
+
+	Log::Write( LogLevel_Info, GetNodeId(), "Received Firmware Update Meta Data report: manufacturer 0x%.4x, firmware 0x%.4x, %d other targets, max fragment size %d", m_manufacturerId, m_firmwareIds[0], m_firmwareIds.size() - 1, m_maxFragmentSize );
+
+	if( m_state != Driver::FirmwareUpdateState_MetaData )
+	{
+		return;
+	}
+	if( m_target >= m_firmwareIds.size() || ( m_target == 0 && !upgradable ) )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Firmware target %d cannot be updated", m_target );
+		EndUpdate( Driver::FirmwareUpdateState_Failed, 0 );
+		return;
+	}
+	RequestUpdate();
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::HandleGet>
+// Send the fragments the node has asked for
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::HandleGet
+(
+	uint8 const* _data
+)
+{
+	if( m_state != Driver::FirmwareUpdateState_Transferring && m_state != Driver::FirmwareUpdateState_Verifying )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "Ignoring a request for firmware fragments, as no update is under way" );
+		return;
+	}
+
+	uint32 count = _data[1];
+	uint32 first = ( (uint32)( _data[2] & 0x7f ) << 8 ) | _data[3];
+	uint32 fragments = (uint32)m_crcs.size();
+	Log::Write( LogLevel_Detail, GetNodeId(), "Node asked for %d firmware fragments from %d", count, first );
+	for( uint32 fragment = first; fragment < first + count && fragment <= fragments; ++fragment )
+	{
+		if( fragment == 0 )
+		{
+			continue;
+		}
+		SendFragment( fragment );
+		if( fragment > m_highest )
+		{
+			m_highest = fragment;
+		}
+	}
+
+	if( m_highest == fragments && m_state == Driver::FirmwareUpdateState_Transferring )
+	{
+		SetState( Driver::FirmwareUpdateState_Verifying );
+	}
+	else if( m_highest * 10 / fragments > m_percent )
+	{
+		m_percent = (uint8)( m_highest * 10 / fragments );
+		Notify();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::RequestMetaData>
+// Ask the node which firmware it runs
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::RequestMetaData
+(
+)
+{
+	Msg* msg = new Msg( "FirmwareUpdateMetaDataCmd_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( 2 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( FirmwareUpdateMetaDataCmd_Get );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::RequestUpdate>
+// Work out the fragments, and ask the node to take the image
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::RequestUpdate
+(
+)
+{
+	// As large a fragment as fits in a frame, unless the node takes less
+	uint32 fragmentSize = c_maxPayload - c_reportOverhead;
+	if( IsSecured() )
+	{
+		fragmentSize -= c_securityOverhead;
+	}
+	if( m_maxFragmentSize != 0 && m_maxFragmentSize < fragmentSize )
+	{
+		fragmentSize = m_maxFragmentSize;
+	}
+	m_fragmentSize = (uint16)fragmentSize;
+
+	// Each report is sent as soon as it is asked for, so its CRC is worked out now.
+	// The CRC covers the whole command, starting with the command class.
+	uint32 fragments = ( m_imageSize + fragmentSize - 1 ) / fragmentSize;
+	if( fragments > 0x7fff )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Firmware image is too large to send in %d byte fragments", fragmentSize );
+		EndUpdate( Driver::FirmwareUpdateState_Failed, 0 );
+		return;
+	}
+	uint8 const prefix[2] = { GetCommandClassId(), FirmwareUpdateMetaDataCmd_FragmentReport };
+	uint16 prefixCrc = Crc16Ccitt( prefix, sizeof(prefix) );
+	m_crcs.resize( fragments );
+	for( uint32 i = 0; i < fragments; ++i )
+	{
+		uint32 fragment = i + 1;
+		uint32 offset = i * fragmentSize;
+		uint32 length = ( m_imageSize - offset < fragmentSize ) ? m_imageSize - offset : fragmentSize;
+		uint8 header[2] = { (uint8)( ( fragment == fragments ? c_lastFragment : 0 ) | ( fragment >> 8 ) ), (uint8)( fragment & 0xff ) };
+		m_crcs[i] = Crc16Ccitt( &m_image[offset], length, Crc16Ccitt( header, sizeof(header), prefixCrc ) );
+	}
+
+	uint16 firmwareId = m_firmwareIds[m_target];
+	Log::Write( LogLevel_Info, GetNodeId(), "Requesting firmware update of target %d: firmware 0x%.4x, checksum 0x%.4x, %d byte fragments", m_target, firmwareId, m_checksum, m_fragmentSize );
+
+	uint8 version = GetVersion();
+	uint8 length = 8;
+	if( version >= 3 )
+	{
+		length += 3;
+	}
+	if( version >= 4 )
+	{
+		length += 1;
+	}
+	if( version >= 5 )
+	{
+		length += 1;
+	}
+
+	Msg* msg = new Msg( "FirmwareUpdateMetaDataCmd_RequestGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( length );
+	msg->Append( GetCommandClassId() );
+	msg->Append( FirmwareUpdateMetaDataCmd_RequestGet );
+	msg->Append( (uint8)( m_manufacturerId >> 8 ) );
+	msg->Append( (uint8)( m_manufacturerId & 0xff ) );
+	msg->Append( (uint8)( firmwareId >> 8 ) );
+	msg->Append( (uint8)( firmwareId & 0xff ) );
+	msg->Append( (uint8)( m_checksum >> 8 ) );
+	msg->Append( (uint8)( m_checksum & 0xff ) );
+	if( version >= 3 )
+	{
+		msg->Append( m_target );
+		msg->Append( (uint8)( m_fragmentSize >> 8 ) );
+		msg->Append( (uint8)( m_fragmentSize & 0xff ) );
+	}
+	if( version >= 4 )
+	{
+		// Apply the image as soon as it has been checked
+		msg->Append( 0 );
+	}
+	if( version >= 5 )
+	{
+		msg->Append( m_hardwareVersion );
+	}
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+
+	SetState( Driver::FirmwareUpdateState_Requesting );
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::SendFragment>
+// Queue a fragment report
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::SendFragment
+(
+	uint32 const _fragment
+)
+{
+	uint32 fragments = (uint32)m_crcs.size();
+	uint32 offset = ( _fragment - 1 ) * m_fragmentSize;
+	uint32 length = ( m_imageSize - offset < m_fragmentSize ) ? m_imageSize - offset : m_fragmentSize;
+
+	// Version 1 has no CRC
+	bool crc = ( GetVersion() >= 2 );
+
+	Msg* msg = new Msg( "FirmwareUpdateMetaDataCmd_FragmentReport", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, false );
+	msg->Append( GetNodeId() );
+	msg->Append( (uint8)( 4 + length + ( crc ? 2 : 0 ) ) );
+	msg->Append( GetCommandClassId() );
+	msg->Append( FirmwareUpdateMetaDataCmd_FragmentReport );
+	msg->Append( (uint8)( ( _fragment == fragments ? c_lastFragment : 0 ) | ( _fragment >> 8 ) ) );
+	msg->Append( (uint8)( _fragment & 0xff ) );
+	for( uint32 i = 0; i < length; ++i )
+	{
+		msg->Append( m_image[offset+i] );
+	}
+	if( crc )
+	{
+		msg->Append( (uint8)( m_crcs[_fragment-1] >> 8 ) );
+		msg->Append( (uint8)( m_crcs[_fragment-1] & 0xff ) );
+	}
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+	++m_sent;
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::SetState>
+// Move the update on a stage, and tell the application
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::SetState
+(
+	Driver::FirmwareUpdateState const _state
+)
+{
+	m_state = _state;
+	Notify();
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::EndUpdate>
+// Release the image and report the outcome
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::EndUpdate
+(
+	Driver::FirmwareUpdateState const _state,
+	uint8 const _status
+)
+{
+	m_elapsed = GetElapsed();
+	m_status = _status;
+	if( m_image )
+	{
+		FileOps::UnmapFile( m_image, m_imageSize );
+		m_image = NULL;
+	}
+
+	if( _state == Driver::FirmwareUpdateState_Complete )
+	{
+		m_percent = 10;
+		Log::Write( LogLevel_Info, GetNodeId(), "Firmware update complete, status 0x%.2x: %d bytes in %dms (%d bytes/s), %d fragments sent for %d", _status, m_imageSize, m_elapsed, m_elapsed ? (uint32)( (uint64)m_imageSize * 1000 / m_elapsed ) : 0, m_sent, m_crcs.size() );
+	}
+	else
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Firmware update failed, status 0x%.2x, after %d of %d fragments", _status, m_highest, m_crcs.size() );
+	}
+	SetState( _state );
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::Notify>
+// Send a Type_FirmwareUpdate notification
+//-----------------------------------------------------------------------------
+void FirmwareUpdateMetaData::Notify
+(
+)
+{
+	Notification* notification = new Notification( Notification::Type_FirmwareUpdate );
+	notification->SetHomeAndNodeIds( GetHomeId(), GetNodeId() );
+	notification->SetFirmwareUpdateProgress( (uint8)m_state, (uint8)( m_percent * 10 ) );
+	GetDriver()->QueueNotification( notification );
+}
+
+//-----------------------------------------------------------------------------
+// <FirmwareUpdateMetaData::GetElapsed>
+// Time since the node took the request, while fragments are being sent
+//-----------------------------------------------------------------------------
+uint32 FirmwareUpdateMetaData::GetElapsed
+(
+)
+{
+	if( m_state == Driver::FirmwareUpdateState_Transferring || m_state == Driver::FirmwareUpdateState_Verifying )
+	{
+		return (uint32)( -m_started.TimeRemaining() );
+	}
+	return m_elapsed;
+}
@@ -0,0 +1,119 @@
+//-----------------------------------------------------------------------------
+//
+//	FirmwareUpdateMetaData.h
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_FIRMWARE_UPDATE_MD
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _FirmwareUpdateMetaData_H
+#define _FirmwareUpdateMetaData_H
+
+#include <vector>
+#include "command_classes/CommandClass.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief Implements COMMAND_CLASS_FIRMWARE_UPDATE_MD (0x7A), a Z-Wave device command class.
+	 *
+	 * Sends a firmware image to a node while the rest of the network carries on.  The
+	 * image is mapped into memory rather than read, and the CRC of every fragment is
+	 * worked out before the node is asked to take it, so each fragment the node asks
+	 * for is sent without delay.  The fragments are as large as the node and the frame
+	 * allow, and all those the node asks for at once are queued together.  They go on
+	 * the send queue, where no poll batch can take them and the poll queue's airtime
+	 * limit does not hold them back.
+	 */
+	class FirmwareUpdateMetaData: public CommandClass
+	{
+	public:
+		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new FirmwareUpdateMetaData( _homeId, _nodeId ); }
+		virtual ~FirmwareUpdateMetaData();
+
+		static uint8 const StaticGetCommandClassId(){ return 0x7a; }
+		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_FIRMWARE_UPDATE_MD"; }
+
+		// From CommandClass
+		virtual uint8 const GetCommandClassId()const{ return StaticGetCommandClassId(); }
+		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
+		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
+		virtual uint8 GetMaxVersion(){ return 5; }
+
+		/**
+		 * Start sending a firmware image to the node.
+		 * \param _fileName the image, as it is to be written to the node.
+		 * \param _target the firmware target, 0 for the node's own firmware.
+		 * \return true if the update was started.  False if one is already under way or the
+		 * file could not be read.  A target the node does not have fails the update later,
+		 * once the node has said which targets it has.
+		 */
+		bool BeginUpdate( string const& _fileName, uint8 const _target );
+
+		/**
+		 * Stop sending the image.  The node gives up on the update once it stops receiving fragments.
+		 * \return true if an update was under way.
+		 */
+		bool CancelUpdate();
+
+		/**
+		 * Get the progress of the update under way, or the outcome of the last one.
+		 */
+		void GetProgress( Driver::FirmwareUpdateData* _data );
+
+	private:
+		FirmwareUpdateMetaData( uint32 const _homeId, uint8 const _nodeId );
+
+		void HandleMetaDataReport( uint8 const* _data, uint32 const _length );
+		void HandleGet( uint8 const* _data );
+		void RequestMetaData();
+		void RequestUpdate();
+		void SendFragment( uint32 const _fragment );
+		void SetState( Driver::FirmwareUpdateState const _state );
+		void EndUpdate( Driver::FirmwareUpdateState const _state, uint8 const _status );
+		void Notify();
+		uint32 GetElapsed();
+
+		Mutex*							m_mutex;				// Guards the update, which the application starts and the driver thread runs
+		Driver::FirmwareUpdateState		m_state;
+		uint8							m_status;
+		uint8							m_target;
+		uint8 const*					m_image;				// The mapped file, while an update is under way
+		uint32							m_imageSize;
+		uint16							m_checksum;				// CRC of the whole image
+		bool							m_haveMetaData;
+		uint16							m_manufacturerId;
+		uint8							m_hardwareVersion;
+		uint16							m_maxFragmentSize;		// The most the node takes in one fragment, or 0 if it did not say
+		vector<uint16>					m_firmwareIds;			// Indexed by target
+		uint16							m_fragmentSize;
+		vector<uint16>					m_crcs;					// CRC of each fragment's report, indexed by fragment number - 1
+		uint32							m_highest;
+		uint32							m_sent;
+		uint8							m_percent;				// Progress last notified, in tens of percent
+		TimeStamp						m_started;				// When the node took the request
+		uint32							m_elapsed;				// ms the transfer took, once it is over
+	};
+
+} // namespace OpenZWave
+
+#endif
@@ -25,8 +25,10 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
 #include "command_classes/CommandClasses.h"
 #include "command_classes/ManufacturerSpecific.h"
+#include "command_classes/Basic.h"
 #include "tinyxml.h"
 
 #include "Defs.h"
@@ -36,7 +38,13 @@
 #include "Manager.h"
 #include "Driver.h"
 #include "Notification.h"
+#include "ProductIndex.h"
+#include "platform/Event.h"
 #include "platform/Log.h"
+#include "platform/Mutex.h"
+#include "platform/Thread.h"
+#include "Utils.h"
+#include "XmlStreamReader.h"
 
 #include "value_classes/ValueStore.h"
 #include "value_classes/ValueString.h"
@@ -52,6 +60,28 @@ enum ManufacturerSpecificCmd
 map<uint16,string> ManufacturerSpecific::s_manufacturerMap;
 map<int64,ManufacturerSpecific::Product*> ManufacturerSpecific::s_productMap;
 bool ManufacturerSpecific::s_bXmlLoaded = false;
+ProductIndex* ManufacturerSpecific::s_productIndex = NULL;
+Mutex* ManufacturerSpecific::s_xmlMutex = new Mutex();
+map<string,TiXmlDocument*> ManufacturerSpecific::s_configDocs;
+
+namespace
+{
+	// The device files shared out between the preload threads
+	struct PreloadJob
+	{
+		Mutex*					m_mutex;		// Guards m_next
+		vector<string>			m_configXMLs;
+		vector<TiXmlDocument*>	m_docs;			// Filled in by the threads, NULL if a file could not be loaded
+		size_t					m_next;			// The next file to be taken by a thread
+	};
+
+	// What each preload thread is given
+	struct PreloadWorker
+	{
+		PreloadJob*	m_job;
+		Event*		m_done;
+	};
+}
 
 //-----------------------------------------------------------------------------
 // <ManufacturerSpecific::RequestState>
@@ -115,7 +145,7 @@ string ManufacturerSpecific::SetProductDetails
 {
 	char str[64];
 
-	if (!s_bXmlLoaded) LoadProductXML();
+	LoadProductXML();
 
 	snprintf( str, sizeof(str), "Unknown: id=%.4x", manufacturerId );
 	string manufacturerName = str;
@@ -126,19 +156,10 @@ string ManufacturerSpecific::SetProductDetails
 	string configPath = "";
 
 	// Try to get the real manufacturer and product names
-	map<uint16,string>::iterator mit = s_manufacturerMap.find( manufacturerId );
-	if( mit != s_manufacturerMap.end() )
+	if( GetManufacturerName( manufacturerId, manufacturerName ) )
 	{
-		// Replace the id with the real name
-		manufacturerName = mit->second;
-
 		// Get the product
-		map<int64,Product*>::iterator pit = s_productMap.find( Product::GetKey( manufacturerId, productType, productId ) );
-		if( pit != s_productMap.end() )
-		{
-			productName = pit->second->GetProductName();
-			configPath = pit->second->GetConfigPath();
-		}
+		GetProduct( manufacturerId, productType, productId, productName, configPath );
 	}
 
 	// Set the values into the node
@@ -218,34 +239,58 @@ bool ManufacturerSpecific::HandleMsg
 
 //-----------------------------------------------------------------------------
 // <ManufacturerSpecific::LoadProductXML>
-// Load the XML that maps manufacturer and product IDs to human-readable names
+// Load the XML that maps manufacturer and product IDs to human-readable names,
+// if no driver has loaded it yet.  Once loaded the tables are not changed
+// until the Manager is destroyed, so they are read without locking.
 //-----------------------------------------------------------------------------
 bool ManufacturerSpecific::LoadProductXML
 (
 )
 {
+	LockGuard LG(s_xmlMutex);
+	if( s_bXmlLoaded )
+	{
+		return true;
+	}
 	s_bXmlLoaded = true;
 
-	// Parse the Z-Wave manufacturer and product XML file.
 	string configPath;
 	Options::Get()->GetOptionAsString( "ConfigPath", &configPath );
 
+	// Use the compiled index if there is an up to date one, either built here
+	// before or checked and built with the config folder
+	bool useIndex = false;
+	Options::Get()->GetOptionAsBool( "ProductIndex", &useIndex );
+	if( useIndex )
+	{
+		string userPath;
+		Options::Get()->GetOptionAsString( "UserPath", &userPath );
+		s_productIndex = ProductIndex::Open( userPath + "manufacturer_specific.idx", configPath );
+		if( !s_productIndex )
+		{
+			s_productIndex = ProductIndex::Open( configPath + "manufacturer_specific.idx", configPath );
+		}
+		if( s_productIndex )
+		{
+			return true;
+		}
+	}
+
+	// Parse the Z-Wave manufacturer and product XML file.
 	string filename =  configPath + "manufacturer_specific.xml";
 
-	TiXmlDocument* pDoc = new TiXmlDocument();
-	if( !pDoc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	// Read it a manufacturer at a time, so only one manufacturer's products are parsed at once
+	XmlStreamReader reader;
+	if( !reader.Open( filename ) )
 	{
-		delete pDoc;
 		Log::Write( LogLevel_Info, "Unable to load %s", filename.c_str() );
 		return false;
 	}
 
-	TiXmlElement const* root = pDoc->RootElement();
-
 	char const* str;
 	char* pStopChar;
 
-	TiXmlElement const* manufacturerElement = root->FirstChildElement();
+	TiXmlElement const* manufacturerElement = reader.ReadChild();
 	while( manufacturerElement )
 	{
 		str = manufacturerElement->Value();
@@ -255,8 +300,7 @@ bool ManufacturerSpecific::LoadProductXML
 			str = manufacturerElement->Attribute( "id" );
 			if( !str )
 			{
-				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer id attribute", manufacturerElement->Row() );
-				delete pDoc;
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer id attribute", reader.GetRow( manufacturerElement ) );
 				return false;
 			}
 			uint16 manufacturerId = (uint16)strtol( str, &pStopChar, 16 );
@@ -264,8 +308,7 @@ bool ManufacturerSpecific::LoadProductXML
 			str = manufacturerElement->Attribute( "name" );
 			if( !str )
 			{
-				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer name attribute", manufacturerElement->Row() );
-				delete pDoc;
+				Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing manufacturer name attribute", reader.GetRow( manufacturerElement ) );
 				return false;
 			}
 
@@ -282,8 +325,7 @@ bool ManufacturerSpecific::LoadProductXML
 					str = productElement->Attribute( "type" );
 					if( !str )
 					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product type attribute", productElement->Row() );
-						delete pDoc;
+						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product type attribute", reader.GetRow( productElement ) );
 						return false;
 					}
 					uint16 productType = (uint16)strtol( str, &pStopChar, 16 );
@@ -291,8 +333,7 @@ bool ManufacturerSpecific::LoadProductXML
 					str = productElement->Attribute( "id" );
 					if( !str )
 					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product id attribute", productElement->Row() );
-						delete pDoc;
+						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product id attribute", reader.GetRow( productElement ) );
 						return false;
 					}
 					uint16 productId = (uint16)strtol( str, &pStopChar, 16 );
@@ -300,8 +341,7 @@ bool ManufacturerSpecific::LoadProductXML
 					str = productElement->Attribute( "name" );
 					if( !str )
 					{
-						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product name attribute", productElement->Row() );
-						delete pDoc;
+						Log::Write( LogLevel_Info, "Error in manufacturer_specific.xml at line %d - missing product name attribute", reader.GetRow( productElement ) );
 						return false;
 					}
 					string productName = str;
@@ -334,10 +374,113 @@ bool ManufacturerSpecific::LoadProductXML
 		}
 
 		// Move on to the next manufacturer.
-		manufacturerElement = manufacturerElement->NextSiblingElement();
+		manufacturerElement = reader.ReadChild();
+	}
+
+	if( reader.HasError() )
+	{
+		return false;
+	}
+
+	if( useIndex )
+	{
+		BuildProductIndex( configPath );
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::BuildProductIndex>
+// Compile the loaded maps and the device files into an index, and switch to
+// it so the maps can be freed
+//-----------------------------------------------------------------------------
+void ManufacturerSpecific::BuildProductIndex
+(
+	string const& _configPath
+)
+{
+	vector<ProductIndex::Entry> products;
+	products.reserve( s_productMap.size() );
+	for( map<int64,Product*>::iterator pit = s_productMap.begin(); pit != s_productMap.end(); ++pit )
+	{
+		ProductIndex::Entry entry;
+		entry.m_manufacturerId = pit->second->GetManufacturerId();
+		entry.m_productType = pit->second->GetProductType();
+		entry.m_productId = pit->second->GetProductId();
+		entry.m_productName = pit->second->GetProductName();
+		entry.m_configPath = pit->second->GetConfigPath();
+		products.push_back( entry );
+	}
+
+	string userPath;
+	Options::Get()->GetOptionAsString( "UserPath", &userPath );
+	string filename = userPath + "manufacturer_specific.idx";
+	if( !ProductIndex::Build( filename, _configPath, s_manufacturerMap, products ) )
+	{
+		return;
+	}
+
+	s_productIndex = ProductIndex::Open( filename, _configPath );
+	if( s_productIndex )
+	{
+		for( map<int64,Product*>::iterator pit = s_productMap.begin(); pit != s_productMap.end(); ++pit )
+		{
+			delete pit->second;
+		}
+		s_productMap.clear();
+		s_manufacturerMap.clear();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::GetManufacturerName>
+// Look up a manufacturer's name
+//-----------------------------------------------------------------------------
+bool ManufacturerSpecific::GetManufacturerName
+(
+	uint16 const _manufacturerId,
+	string& _name
+)
+{
+	if( s_productIndex )
+	{
+		return s_productIndex->GetManufacturerName( _manufacturerId, _name );
 	}
 
-	delete pDoc;
+	map<uint16,string>::iterator mit = s_manufacturerMap.find( _manufacturerId );
+	if( mit == s_manufacturerMap.end() )
+	{
+		return false;
+	}
+	_name = mit->second;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::GetProduct>
+// Look up a product's name and device file
+//-----------------------------------------------------------------------------
+bool ManufacturerSpecific::GetProduct
+(
+	uint16 const _manufacturerId,
+	uint16 const _productType,
+	uint16 const _productId,
+	string& _name,
+	string& _configPath
+)
+{
+	if( s_productIndex )
+	{
+		return s_productIndex->GetProduct( _manufacturerId, _productType, _productId, _name, _configPath );
+	}
+
+	map<int64,Product*>::iterator pit = s_productMap.find( Product::GetKey( _manufacturerId, _productType, _productId ) );
+	if( pit == s_productMap.end() )
+	{
+		return false;
+	}
+	_name = pit->second->GetProductName();
+	_configPath = pit->second->GetConfigPath();
 	return true;
 }
 
@@ -349,6 +492,7 @@ void ManufacturerSpecific::UnloadProductXML
 (
 )
 {
+	LockGuard LG(s_xmlMutex);
 	if (s_bXmlLoaded)
 	{
 		map<int64,Product*>::iterator pit = s_productMap.begin();
@@ -366,8 +510,17 @@ void ManufacturerSpecific::UnloadProductXML
 			mit = s_manufacturerMap.begin();
 		}
 
+		delete s_productIndex;
+		s_productIndex = NULL;
+
 		s_bXmlLoaded = false;
 	}
+
+	for( map<string,TiXmlDocument*>::iterator it = s_configDocs.begin(); it != s_configDocs.end(); ++it )
+	{
+		delete it->second;
+	}
+	s_configDocs.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -380,19 +533,12 @@ bool ManufacturerSpecific::LoadConfigXML
 	string const& _configXML
 )
 {
-	string configPath;
-	Options::Get()->GetOptionAsString( "ConfigPath", &configPath );
-
-	string filename =  configPath + _configXML;
-
-	TiXmlDocument* doc = new TiXmlDocument();
-	Log::Write( LogLevel_Info, _node->GetNodeId(), "  Opening config param file %s", filename.c_str() );
-	if( !doc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	TiXmlDocument const* doc = GetConfigDocument( _configXML, _node->GetNodeId() );
+	if( doc == NULL )
 	{
-		delete doc;
-		Log::Write( LogLevel_Info, _node->GetNodeId(), "Unable to find or load Config Param file %s", filename.c_str() );
 		return false;
 	}
+
 	Node::QueryStage qs = _node->GetCurrentQueryStage();
 	if( qs == Node::QueryStage_ManufacturerSpecific1 )
 	{
@@ -404,13 +550,189 @@ bool ManufacturerSpecific::LoadConfigXML
 		{
 			_node->ReadDeviceProtocolXML( doc->RootElement() );
 		}
-		_node->ReadCommandClassesXML( doc->RootElement() );
+		// The shared document outlives the node, so parameters can be left to be created when used
+		bool lazy = false;
+		Options::Get()->GetOptionAsBool( "LazyConfigParams", &lazy );
+		_node->ReadCommandClassesXML( doc->RootElement(), lazy );
 	}
-
-	delete doc;
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::GetConfigDocument>
+// Get a device configuration file, parsing it if no other node has needed it
+//-----------------------------------------------------------------------------
+TiXmlDocument const* ManufacturerSpecific::GetConfigDocument
+(
+	string const& _configXML,
+	uint8 const _nodeId
+)
+{
+	// The lock is held while the file is parsed, so that nodes of the
+	// same product in other drivers wait for it rather than parse it too
+	LockGuard LG(s_xmlMutex);
+	map<string,TiXmlDocument*>::iterator it = s_configDocs.find( _configXML );
+	if( it != s_configDocs.end() )
+	{
+		Log::Write( LogLevel_Info, _nodeId, "  Using the already loaded config param file %s", _configXML.c_str() );
+		return it->second;
+	}
+
+	TiXmlDocument* doc = ParseConfigDocument( _configXML, _nodeId );
+	if( doc != NULL )
+	{
+		s_configDocs[_configXML] = doc;
+	}
+	return doc;
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::ParseConfigDocument>
+// Read a device configuration file.  Must be called with s_xmlMutex locked,
+// or by a preload thread while it is held for it.
+//-----------------------------------------------------------------------------
+TiXmlDocument* ManufacturerSpecific::ParseConfigDocument
+(
+	string const& _configXML,
+	uint8 const _nodeId
+)
+{
+	string configPath;
+	Options::Get()->GetOptionAsString( "ConfigPath", &configPath );
+
+	string filename =  configPath + _configXML;
+
+	// Nodes read from the saved configuration get here before the tables are
+	// needed, so only use the index if another driver has already opened it
+	TiXmlDocument* doc = new TiXmlDocument();
+	if( s_productIndex && s_productIndex->LoadConfig( _configXML, *doc ) )
+	{
+		Log::Write( LogLevel_Info, _nodeId, "  Loaded config param file %s from the product index", filename.c_str() );
+	}
+	else
+	{
+		Log::Write( LogLevel_Info, _nodeId, "  Opening config param file %s", filename.c_str() );
+		if( !doc->LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+		{
+			delete doc;
+			Log::Write( LogLevel_Info, _nodeId, "Unable to find or load Config Param file %s", filename.c_str() );
+			return NULL;
+		}
+	}
+	return doc;
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::GetConfigPath>
+// Look up the device file for a product
+//-----------------------------------------------------------------------------
+bool ManufacturerSpecific::GetConfigPath
+(
+	uint16 const _manufacturerId,
+	uint16 const _productType,
+	uint16 const _productId,
+	string& _configPath
+)
+{
+	LoadProductXML();
+
+	string productName;
+	return GetProduct( _manufacturerId, _productType, _productId, productName, _configPath );
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::PreloadConfigXML>
+// Parse device files in parallel, ahead of the nodes that need them
+//-----------------------------------------------------------------------------
+void ManufacturerSpecific::PreloadConfigXML
+(
+	list<string> const& _configXMLs,
+	uint32 const _numThreads
+)
+{
+	// The lock is held throughout, so other drivers wait for these files
+	// rather than parse them too.  The threads do not take it.
+	LockGuard LG(s_xmlMutex);
+
+	PreloadJob job;
+	for( list<string>::const_iterator it = _configXMLs.begin(); it != _configXMLs.end(); ++it )
+	{
+		if( !it->empty() && s_configDocs.find( *it ) == s_configDocs.end()
+			&& find( job.m_configXMLs.begin(), job.m_configXMLs.end(), *it ) == job.m_configXMLs.end() )
+		{
+			job.m_configXMLs.push_back( *it );
+		}
+	}
+	if( job.m_configXMLs.empty() )
+	{
+		return;
+	}
+
+	job.m_mutex = new Mutex();
+	job.m_docs.resize( job.m_configXMLs.size(), NULL );
+	job.m_next = 0;
+
+	uint32 numThreads = _numThreads;
+	if( numThreads > job.m_configXMLs.size() )
+	{
+		numThreads = (uint32)job.m_configXMLs.size();
+	}
+	Log::Write( LogLevel_Info, "Preloading %d device files on %d threads", (int)job.m_configXMLs.size(), numThreads );
+
+	vector<Thread*> threads( numThreads );
+	vector<PreloadWorker> workers( numThreads );
+	for( uint32 i = 0; i < numThreads; ++i )
+	{
+		workers[i].m_job = &job;
+		workers[i].m_done = new Event();
+		threads[i] = new Thread( "preload" );
+		threads[i]->Start( ManufacturerSpecific::PreloadThreadProc, &workers[i] );
+	}
+
+	for( uint32 i = 0; i < numThreads; ++i )
+	{
+		Wait::Single( workers[i].m_done );
+		threads[i]->Stop();
+		threads[i]->Release();
+		workers[i].m_done->Release();
+	}
+	job.m_mutex->Release();
+
+	for( size_t i = 0; i < job.m_configXMLs.size(); ++i )
+	{
+		if( job.m_docs[i] != NULL )
+		{
+			s_configDocs[job.m_configXMLs[i]] = job.m_docs[i];
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ManufacturerSpecific::PreloadThreadProc>
+// Parse device files until there are none left
+//-----------------------------------------------------------------------------
+void ManufacturerSpecific::PreloadThreadProc
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	PreloadWorker* worker = (PreloadWorker*)_context;
+	PreloadJob* job = worker->m_job;
+	while( true )
+	{
+		job->m_mutex->Lock();
+		size_t i = job->m_next++;
+		job->m_mutex->Unlock();
+		if( i >= job->m_configXMLs.size() )
+		{
+			break;
+		}
+		job->m_docs[i] = ParseConfigDocument( job->m_configXMLs[i], 0 );
+	}
+	worker->m_done->Set();
+}
+
 //-----------------------------------------------------------------------------
 // <ManufacturerSpecific::ReLoadConfigXML>
 // Reload previously discovered device configuration.
@@ -421,24 +743,27 @@ void ManufacturerSpecific::ReLoadConfigXML
 {
 	if( Node* node = GetNodeUnsafe() )
 	{
-		if (!s_bXmlLoaded) LoadProductXML();
+		LoadProductXML();
 
 		uint16 manufacturerId = node->GetManufacturerId();
 		uint16 productType = node->GetProductType();
 		uint16 productId = node->GetProductId();
 
-		map<uint16,string>::iterator mit = s_manufacturerMap.find( manufacturerId );
-		if( mit != s_manufacturerMap.end() )
+		string manufacturerName;
+		string productName;
+		string configPath;
+		if( GetManufacturerName( manufacturerId, manufacturerName ) && GetProduct( manufacturerId, productType, productId, productName, configPath ) )
 		{
-			map<int64,Product*>::iterator pit = s_productMap.find( Product::GetKey( manufacturerId, productType, productId ) );
-			if( pit != s_productMap.end() )
+			if( configPath.size() > 0 )
 			{
-				string configPath = pit->second->GetConfigPath();
-				if( configPath.size() > 0 )
-				{
-					LoadConfigXML( node, configPath );
-				}
+				LoadConfigXML( node, configPath );
 			}
 		}
+
+		// The device file may have changed what Basic is mapped to
+		if( Basic* basic = static_cast<Basic*>( node->GetCommandClass( Basic::StaticGetCommandClassId() ) ) )
+		{
+			basic->ResolveMapping();
+		}
 	}
 }
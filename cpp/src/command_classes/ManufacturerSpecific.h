@@ -28,18 +28,25 @@
 #ifndef _ManufacturerSpecific_H
 #define _ManufacturerSpecific_H
 
+#include <list>
 #include <map>
 #include "command_classes/CommandClass.h"
 
+class TiXmlDocument;
+
 namespace OpenZWave
 {
+	class ProductIndex;
+	class Mutex;
+	class Event;
+
 	/** \brief Implements COMMAND_CLASS_MANUFACTURER_SPECIFIC (0x72), a Z-Wave device command class.
 	 */
 	class ManufacturerSpecific: public CommandClass
 	{
 	public:
 		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new ManufacturerSpecific( _homeId, _nodeId ); }
-		virtual ~ManufacturerSpecific(){ UnloadProductXML(); }
+		virtual ~ManufacturerSpecific(){}
 
 		static uint8 const StaticGetCommandClassId(){ return 0x72; }
 		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_MANUFACTURER_SPECIFIC"; }
@@ -56,10 +63,31 @@ namespace OpenZWave
 		
 		void ReLoadConfigXML();
 
+		/** Free the product tables shared by every driver.  Called when the Manager is destroyed. */
+		static void UnloadProductXML();
+
+		/**
+		 * Look up the device file for a product, loading the product tables if no driver has yet.
+		 * \return true if the product is known, with its device file (which may be empty) in _configPath.
+		 */
+		static bool GetConfigPath( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, string& _configPath );
+
+		/**
+		 * Parse device files on a few threads of their own, and add them to those shared by
+		 * every driver.  Files that are already loaded are skipped.  Returns once all have
+		 * been parsed, so that nodes of these products do not wait on the disk during their interview.
+		 */
+		static void PreloadConfigXML( list<string> const& _configXMLs, uint32 const _numThreads );
+
 	private:
 		ManufacturerSpecific( uint32 const _homeId, uint8 const _nodeId ): CommandClass( _homeId, _nodeId ){ SetStaticRequest( StaticRequest_Values ); }
 		static bool LoadProductXML();
-		static void UnloadProductXML();
+		static void BuildProductIndex( string const& _configPath );
+		static bool GetManufacturerName( uint16 const _manufacturerId, string& _name );
+		static bool GetProduct( uint16 const _manufacturerId, uint16 const _productType, uint16 const _productId, string& _name, string& _configPath );
+		static TiXmlDocument const* GetConfigDocument( string const& _configXML, uint8 const _nodeId );
+		static TiXmlDocument* ParseConfigDocument( string const& _configXML, uint8 const _nodeId );
+		static void PreloadThreadProc( Event* _exitEvent, void* _context );
 
 		class Product
 		{
@@ -108,6 +136,13 @@ namespace OpenZWave
 		static map<uint16,string>	s_manufacturerMap;
 		static map<int64,Product*>	s_productMap;
 		static bool					s_bXmlLoaded;
+		static ProductIndex*		s_productIndex;		// If not NULL, the products are looked up here rather than in the maps
+		static Mutex*				s_xmlMutex;			// Lets the first driver thread to need the tables load them while the others wait
+
+		// Each device configuration file, parsed the first time a node of that product
+		// needs it.  The documents are only read after that, by any driver, and are freed
+		// by UnloadProductXML.  Guarded by s_xmlMutex.
+		static map<string,TiXmlDocument*>	s_configDocs;
 	};
 
 } // namespace OpenZWave
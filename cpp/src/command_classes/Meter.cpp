@@ -33,7 +33,9 @@
 #include "Msg.h"
 #include "Node.h"
 #include "Driver.h"
+#include "Options.h"
 #include "platform/Log.h"
+#include <math.h>
 
 #include "value_classes/ValueDecimal.h"
 #include "value_classes/ValueList.h"
@@ -43,6 +45,11 @@
 
 using namespace OpenZWave;
 
+// Read for every meter report
+static Options::Handle<bool> s_meterAdaptivePolling( "MeterAdaptivePolling", false );
+static Options::Handle<int32> s_meterPollFastest( "MeterPollFastest", 30000 );
+static Options::Handle<int32> s_meterPollSlowest( "MeterPollSlowest", 900000 );
+
 enum MeterCmd
 {
 	MeterCmd_Get				= 0x01,
@@ -111,6 +118,56 @@ static char const* c_waterUnits[] =
 	""
 };
 
+static float const c_rateChange = 0.2f;			// A rate that moves by more than this fraction counts as a change of load
+
+//-----------------------------------------------------------------------------
+// <IsCumulative>
+// Whether a scale of a meter counts up, rather than reporting a rate or level
+//-----------------------------------------------------------------------------
+static bool IsCumulative
+(
+	uint8 const _meterType,
+	uint8 const _scale
+)
+{
+	switch( _meterType )
+	{
+		case MeterType_Electric:
+		{
+			// kWh, kVAh and pulses
+			return( _scale == 0 || _scale == 1 || _scale == 3 );
+		}
+		case MeterType_Gas:
+		case MeterType_Water:
+		{
+			// Volumes and pulses
+			return( _scale <= 3 );
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ToDouble>
+// A mantissa and precision as a double
+//-----------------------------------------------------------------------------
+static double ToDouble
+(
+	int32 const _mantissa,
+	uint8 const _precision
+)
+{
+	double value = (double)_mantissa;
+	for( uint8 i=0; i<_precision; ++i )
+	{
+		value /= 10.0;
+	}
+	return value;
+}
+
 static char const* c_electricityLabels[] =
 {
 	"Energy",
@@ -137,6 +194,20 @@ Meter::Meter
 	SetStaticRequest( StaticRequest_Values );
 }
 
+//-----------------------------------------------------------------------------
+// <Meter::~Meter>
+// Destructor
+//-----------------------------------------------------------------------------
+Meter::~Meter
+(
+)
+{
+	for( map<uint16,Rate*>::iterator it = m_rates.begin(); it != m_rates.end(); ++it )
+	{
+		delete it->second;
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Meter::RequestState>
 // Request current state from the device
@@ -380,7 +451,14 @@ bool Meter::HandleReport
 	// Get the value and scale
 	uint8 scale;
 	uint8 precision = 0;
-	string valueStr = ExtractValue( &_data[2], &scale, &precision );
+	int32 mantissa = ExtractMantissa( &_data[2], &scale, &precision );
+
+	// Only needed for the log
+	ValueDecimal::Fixed reading;
+	reading.m_mantissa = mantissa;
+	reading.m_precision = precision;
+	char valueStr[16];
+	ValueDecimal::Format( reading, valueStr, sizeof(valueStr) );
 
 	if (scale > 7) /* size of c_electricityLabels, c_electricityUnits, c_gasUnits, c_waterUnits */
 	{
@@ -432,14 +510,18 @@ bool Meter::HandleReport
 
 		if( ValueDecimal* value = static_cast<ValueDecimal*>( GetValue( _instance, 0 ) ) )
 		{
-			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s=%s%s", GetNodeId(), label.c_str(), valueStr.c_str(), units.c_str() );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s=%s%s", GetNodeId(), label.c_str(), valueStr, units.c_str() );
 			value->SetLabel( label );
 			value->SetUnits( units );
-			value->OnValueRefreshed( valueStr );
+			value->OnValueRefreshed( mantissa, precision );
 			if( value->GetPrecision() != precision )
 			{
 				value->SetPrecision( precision );
 			}
+			if( IsCumulative( _data[1] & 0x1f, scale ) )
+			{
+				OnCumulativeReading( _instance, 0, value, _data[1] & 0x1f, scale, ToDouble( mantissa, precision ), 0.0, 0 );
+			}
 			value->Release();
 		}
 	}
@@ -456,13 +538,15 @@ bool Meter::HandleReport
 
 		if( ValueDecimal* value = static_cast<ValueDecimal*>( GetValue( _instance, baseIndex ) ) )
 		{
-			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s%s=%s%s", GetNodeId(), exporting ? "Exporting ": "", value->GetLabel().c_str(), valueStr.c_str(), value->GetUnits().c_str() );
-			value->OnValueRefreshed( valueStr );
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Meter report from node %d: %s%s=%s%s", GetNodeId(), exporting ? "Exporting ": "", value->GetLabel().c_str(), valueStr, value->GetUnits().c_str() );
+			value->OnValueRefreshed( mantissa, precision );
 			if( value->GetPrecision() != precision )
 			{
 				value->SetPrecision( precision );
 			}
-			value->Release();
+			uint8 const readingScale = scale;
+			double current = ToDouble( mantissa, precision );
+			double last = 0.0;
 
 			// Read any previous value and time delta
 			uint8 size = _data[2] & 0x07;
@@ -471,6 +555,10 @@ bool Meter::HandleReport
 			if( delta )
 			{
 				// There is only a previous value if the time delta is non-zero
+				precision = 0;
+				mantissa = ExtractMantissa( &_data[2], &scale, &precision, 3+size );
+				last = ToDouble( mantissa, precision );
+
 				ValueDecimal* previous = static_cast<ValueDecimal*>( GetValue( _instance, baseIndex+1 ) );
 				if( NULL == previous )
 				{
@@ -483,10 +571,10 @@ bool Meter::HandleReport
 				}
 				if( previous )
 				{
-					precision = 0;
-					valueStr = ExtractValue( &_data[2], &scale, &precision, 3+size );
-					Log::Write( LogLevel_Info, GetNodeId(), "    Previous value was %s%s, received %d seconds ago.", valueStr.c_str(), previous->GetUnits().c_str(), delta );
-					previous->OnValueRefreshed( valueStr );
+					reading.m_mantissa = mantissa;
+					reading.m_precision = precision;
+					Log::Write( LogLevel_Info, GetNodeId(), "    Previous value was %s%s, received %d seconds ago.", ValueDecimal::Format( reading, valueStr, sizeof(valueStr) ), previous->GetUnits().c_str(), delta );
+					previous->OnValueRefreshed( mantissa, precision );
 					if( previous->GetPrecision() != precision )
 					{
 						previous->SetPrecision( precision );
@@ -511,12 +599,154 @@ bool Meter::HandleReport
 					interval->Release();
 				}
 			}
+
+			if( !exporting && IsCumulative( _data[1] & 0x1f, readingScale ) )
+			{
+				OnCumulativeReading( _instance, baseIndex, value, _data[1] & 0x1f, readingScale, current, last, delta );
+			}
+			value->Release();
 		}
 	}
 
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// <Meter::OnCumulativeReading>
+// Derive a rate from a reading that counts up, and poll it more often while
+// the rate is changing
+//-----------------------------------------------------------------------------
+void Meter::OnCumulativeReading
+(
+	uint8 const _instance,
+	uint8 const _baseIndex,
+	ValueDecimal* _value,
+	uint8 const _meterType,
+	uint8 const _scale,
+	double const _reading,
+	double const _previous,
+	uint16 const _delta
+)
+{
+	uint16 key = (uint16)( ( _instance << 8 ) | _baseIndex );
+	Rate* rate;
+	double elapsed = 0.0;
+	map<uint16,Rate*>::iterator it = m_rates.find( key );
+	if( it == m_rates.end() )
+	{
+		rate = new Rate();
+		rate->m_rate = 0.0;
+		rate->m_hasRate = false;
+		m_rates[key] = rate;
+	}
+	else
+	{
+		rate = it->second;
+		elapsed = -(double)rate->m_time.TimeRemaining();
+		if( _reading < rate->m_reading )
+		{
+			// The meter has been reset or has rolled over, so start again from this reading
+			Log::Write( LogLevel_Info, GetNodeId(), "Meter reading went down from %.3f to %.3f, so it has been reset", rate->m_reading, _reading );
+			rate->m_hasRate = false;
+			elapsed = 0.0;
+		}
+	}
+
+	// The device may have sent the change since its previous reading.  If not,
+	// use the change since the last one we received.
+	double perHour;
+	if( _delta && _reading >= _previous )
+	{
+		perHour = ( _reading - _previous ) * 3600.0 / (double)_delta;
+	}
+	else if( elapsed >= 1000.0 )
+	{
+		perHour = ( _reading - rate->m_reading ) * 3600000.0 / elapsed;
+	}
+	else
+	{
+		perHour = -1.0;
+	}
+	rate->m_reading = _reading;
+	rate->m_time.SetTime();
+	if( perHour < 0.0 )
+	{
+		return;
+	}
+
+	// Publish the rate.  kWh and kVAh become W and VA.
+	bool energy = ( _meterType == MeterType_Electric ) && ( _scale <= 1 );
+	double derived = energy ? perHour * 1000.0 : perHour;
+	int32 mantissa = ( derived * 100.0 >= 2147483647.0 ) ? 0x7fffffff : (int32)floor( derived * 100.0 + 0.5 );
+	ValueDecimal* rateValue = static_cast<ValueDecimal*>( GetValue( _instance, _baseIndex+3 ) );
+	if( NULL == rateValue )
+	{
+		if( Node* node = GetNodeUnsafe() )
+		{
+			string units = energy ? ( _scale ? "VA" : "W" ) : _value->GetUnits() + "/h";
+			node->CreateValueDecimal( ValueID::ValueGenre_User, GetCommandClassId(), _instance, _baseIndex+3, energy ? "Derived Power" : "Derived Rate", units, true, false, "0.0", 0 );
+			rateValue = static_cast<ValueDecimal*>( GetValue( _instance, _baseIndex+3 ) );
+		}
+	}
+	if( rateValue )
+	{
+		rateValue->OnValueRefreshed( mantissa, 2 );
+		if( rateValue->GetPrecision() != 2 )
+		{
+			rateValue->SetPrecision( 2 );
+		}
+		rateValue->Release();
+	}
+
+	// Poll the reading sooner while the load is changing, and back off while it is steady
+	if( s_meterAdaptivePolling.Get() && _value->IsPolled() )
+	{
+		int32 fastest = s_meterPollFastest.Get();
+		int32 slowest = s_meterPollSlowest.Get();
+		if( fastest < 1000 )
+		{
+			fastest = 1000;
+		}
+		if( slowest < fastest )
+		{
+			slowest = fastest;
+		}
+
+		uint32 interval = _value->GetPollInterval();
+		if( interval == 0 )
+		{
+			interval = (uint32)fastest;
+		}
+
+		double largest = ( fabs( perHour ) > fabs( rate->m_rate ) ) ? fabs( perHour ) : fabs( rate->m_rate );
+		if( !rate->m_hasRate || fabs( perHour - rate->m_rate ) > c_rateChange * largest )
+		{
+			interval /= 2;
+		}
+		else
+		{
+			interval += interval / 2;
+		}
+		if( interval < (uint32)fastest )
+		{
+			interval = (uint32)fastest;
+		}
+		if( interval > (uint32)slowest )
+		{
+			interval = (uint32)slowest;
+		}
+
+		if( interval != _value->GetPollInterval() )
+		{
+			Log::Write( LogLevel_Detail, GetNodeId(), "Meter rate is %.3f/h, polling every %d seconds", perHour, interval / 1000 );
+		}
+		GetDriver()->AdaptValuePollInterval( _value, interval );
+	}
+
+	rate->m_rate = perHour;
+	rate->m_hasRate = true;
+}
+
 //-----------------------------------------------------------------------------
 // <Meter::SetValue>
 // Set the device's scale, or reset its accumulated values.
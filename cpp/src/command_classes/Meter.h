@@ -28,7 +28,9 @@
 #ifndef _Meter_H
 #define _Meter_H
 
+#include <map>
 #include "command_classes/CommandClass.h"
+#include "platform/TimeStamp.h"
 
 namespace OpenZWave
 {
@@ -40,7 +42,7 @@ namespace OpenZWave
 	{
 	public:
 		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new Meter( _homeId, _nodeId ); }
-		virtual ~Meter(){}
+		virtual ~Meter();
 
 		static uint8 const StaticGetCommandClassId(){ return 0x32; }
 		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_METER"; }
@@ -62,7 +64,18 @@ namespace OpenZWave
 
 		bool HandleSupportedReport( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		bool HandleReport( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
+		void OnCumulativeReading( uint8 const _instance, uint8 const _baseIndex, ValueDecimal* _value, uint8 const _meterType, uint8 const _scale, double const _reading, double const _previous, uint16 const _delta );
 
+		/** What is known of the rate of a cumulative reading */
+		struct Rate
+		{
+			TimeStamp	m_time;				// When m_reading arrived
+			double		m_reading;
+			double		m_rate;				// Units per hour
+			bool		m_hasRate;
+		};
+
+		map<uint16,Rate*>	m_rates;		// Keyed by instance and value index.  Only used by the driver thread.
 	};
 
 } // namespace OpenZWave
@@ -47,6 +47,8 @@ enum MultiChannelAssociationCmd
 	MultiChannelAssociationCmd_GroupingsReport	= 0x06
 };
 
+static uint32 const c_maxTargetBytes = 16;	// Bytes of node ids and instances in one Set or Remove, few enough to be sent encrypted
+
 // <MultiChannelAssociation::MultiChannelAssociation>
 // Constructor
 //-----------------------------------------------------------------------------
@@ -471,3 +473,92 @@ void MultiChannelAssociation::Remove
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <MultiChannelAssociation::SendTargets>
+// Add or remove several nodes and instances at once, as few to a message as
+// the frame allows
+//-----------------------------------------------------------------------------
+void MultiChannelAssociation::SendTargets
+(
+	uint8 const _groupIdx,
+	NodeSet const& _targets,
+	bool const _remove
+)
+{
+	vector<uint8> nodes;
+	vector<InstanceAssociation> instances;
+	uint32 position = 0;
+	InstanceAssociation target;
+	while( _targets.GetNext( position, &target ) )
+	{
+		/* for Qubino devices, we should always set a Instance if its the ControllerNode, so MultChannelEncap works.  - See Bug #857 */
+		if( !_remove && m_alwaysSetInstance && ( target.m_instance == 0x00 ) && ( GetDriver()->GetControllerNodeId() == target.m_nodeId ) )
+		{
+			target.m_instance = 0x01;
+		}
+
+		if( target.m_instance == 0x00 )
+		{
+			nodes.push_back( target.m_nodeId );
+		}
+		else
+		{
+			instances.push_back( target );
+		}
+	}
+
+	// Whole nodes come first, then a marker and the node and instance pairs.
+	// An empty list would clear the whole group, so it is never sent.
+	uint32 nextNode = 0;
+	uint32 nextInstance = 0;
+	while( ( nextNode < nodes.size() ) || ( nextInstance < instances.size() ) )
+	{
+		uint32 numNodes = 0;
+		uint32 numInstances = 0;
+		uint32 bytes = 0;
+		while( ( nextNode + numNodes < nodes.size() ) && ( bytes + 1 <= c_maxTargetBytes ) )
+		{
+			++numNodes;
+			++bytes;
+		}
+		if( nextInstance < instances.size() )
+		{
+			++bytes;	// marker
+			while( ( nextInstance + numInstances < instances.size() ) && ( bytes + 2 <= c_maxTargetBytes ) )
+			{
+				++numInstances;
+				bytes += 2;
+			}
+			if( numInstances == 0 )
+			{
+				--bytes;
+			}
+		}
+
+		Log::Write( LogLevel_Info, GetNodeId(), "MultiChannelAssociation::%s - %s %d nodes and %d instances %s group %d of node %d", _remove ? "Remove" : "Set", _remove ? "Removing" : "Adding", numNodes, numInstances, _remove ? "from" : "to", _groupIdx, GetNodeId() );
+		Msg* msg = new Msg( _remove ? "MultiChannelAssociationCmd_Remove" : "MultiChannelAssociationCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+		msg->Append( GetNodeId() );
+		msg->Append( 3 + bytes );
+		msg->Append( GetCommandClassId() );
+		msg->Append( _remove ? MultiChannelAssociationCmd_Remove : MultiChannelAssociationCmd_Set );
+		msg->Append( _groupIdx );
+		for( uint32 i = 0; i < numNodes; ++i )
+		{
+			msg->Append( nodes[nextNode+i] );
+		}
+		if( numInstances > 0 )
+		{
+			msg->Append( 0x00 ); // marker
+			for( uint32 i = 0; i < numInstances; ++i )
+			{
+				msg->Append( instances[nextInstance+i].m_nodeId );
+				msg->Append( instances[nextInstance+i].m_instance );
+			}
+		}
+		msg->Append( GetDriver()->GetTransmitOptions() );
+		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+
+		nextNode += numNodes;
+		nextInstance += numInstances;
+	}
+}
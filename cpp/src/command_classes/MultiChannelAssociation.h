@@ -59,11 +59,14 @@ namespace OpenZWave
 		void RequestAllGroups( uint32 const _requestFlags );
 		void Set( uint8 const _group, uint8 const _nodeId, uint8 const _instance );
 		void Remove( uint8 const _group, uint8 const _nodeId, uint8 const _instance );
+		void Set( uint8 const _group, NodeSet const& _targets ){ SendTargets( _group, _targets, false ); }
+		void Remove( uint8 const _group, NodeSet const& _targets ){ SendTargets( _group, _targets, true ); }
 
 	private:
 		MultiChannelAssociation( uint32 const _homeId, uint8 const _nodeId );
 		void QueryGroup( uint8 _groupIdx, uint32 const _requestFlags );
 		void AutoAssociate();
+		void SendTargets( uint8 const _groupIdx, NodeSet const& _targets, bool const _remove );
 
 		bool			m_queryAll;			// When true, once a group has been queried, we request the next one.
 		uint8			m_numGroups;		// Number of groups supported by the device.  255 is reported by certain manufacturers and requires special handling.
@@ -31,6 +31,7 @@
 #include "Msg.h"
 #include "Node.h"
 #include "Driver.h"
+#include "CommandClassProfile.h"
 #include "platform/Log.h"
 
 using namespace OpenZWave;
@@ -62,6 +63,7 @@ bool MultiCmd::HandleMsg
 
 				if( CommandClass* pCommandClass = node->GetCommandClass( commandClassId ) )
 				{
+					CommandClassProfile::Timer timer( commandClassId, CommandClassProfile::Operation_HandleMsg );
 					pCommandClass->HandleMsg( &_data[base+2], length-1 );
 				}
 
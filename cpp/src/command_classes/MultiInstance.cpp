@@ -33,6 +33,7 @@
 #include "Defs.h"
 #include "Msg.h"
 #include "Driver.h"
+#include "CommandClassProfile.h"
 #include "Node.h"
 #include "platform/Log.h"
 
@@ -262,6 +263,7 @@ bool MultiInstance::HandleMsg
 		{
 			case MultiInstanceCmd_Report:
 			{
+				node->RecordDiscoveryReport( GetCommandClassId(), _data, _length );
 				HandleMultiInstanceReport( _data, _length );
 				break;
 			}
@@ -272,11 +274,13 @@ bool MultiInstance::HandleMsg
 			}
 			case MultiChannelCmd_EndPointReport:
 			{
+				node->RecordDiscoveryReport( GetCommandClassId(), _data, _length );
 				HandleMultiChannelEndPointReport( _data, _length );
 				break;
 			}
 			case MultiChannelCmd_CapabilityReport:
 			{
+				node->RecordDiscoveryReport( GetCommandClassId(), _data, _length );
 				HandleMultiChannelCapabilityReport( _data, _length );
 				break;
 			}
@@ -348,6 +352,7 @@ void MultiInstance::HandleMultiInstanceEncap
 		{
 			Log::Write( LogLevel_Info, GetNodeId(), "Received a MultiInstanceEncap from node %d, instance %d, for Command Class %s", GetNodeId(), instance, pCommandClass->GetCommandClassName().c_str() );
 			pCommandClass->ReceivedCntIncr();
+			CommandClassProfile::Timer timer( commandClassId, CommandClassProfile::Operation_HandleMsg );
 			pCommandClass->HandleMsg( &_data[3], _length-3, instance );
 		}
 	}
@@ -395,6 +400,13 @@ void MultiInstance::HandleMultiChannelEndPointReport
 		Log::Write( LogLevel_Info, GetNodeId(), "Received MultiChannelEndPointReport from node %d. %d endpoints are not all the same.", GetNodeId(), m_numEndPoints );
 	}
 
+	Node* node = GetNodeUnsafe();
+	if( node && node->m_replayingDiscovery )
+	{
+		// The capability reports of the node this one was recorded from follow it
+		return;
+	}
+
 	// This code assumes the endpoints are all in numeric sequential order.
 	// Since the end point finds do not appear to work this is the best estimate.
 	for( uint8 i = 1; i <= len; i++ )
@@ -434,7 +446,7 @@ void MultiInstance::HandleMultiChannelCapabilityReport
 		 * https://groups.google.com/d/topic/openzwave/IwepxScRAVo/discussion
 		 */
 		if ((m_ignoreUnsolicitedMultiChannelCapabilityReport && (node->GetCurrentQueryStage() != Node::QueryStage_Instances))
-				&& !dynamic && m_endPointCommandClasses.size() > 0) {
+				&& !dynamic && m_endPointCommandClasses.size() > 0 && !node->m_replayingDiscovery) {
 			Log::Write(LogLevel_Error, GetNodeId(), "Received a Unsolicited MultiChannelEncap when we are not in QueryState_Instances");
 			return;
 		}
@@ -691,6 +703,7 @@ void MultiInstance::HandleMultiChannelEncap
 			else
 			{
 				Log::Write( LogLevel_Info, GetNodeId(), "Received a MultiChannelEncap from node %d, endpoint %d for Command Class %s", GetNodeId(), endPoint, pCommandClass->GetCommandClassName().c_str() );
+				CommandClassProfile::Timer timer( commandClassId, CommandClassProfile::Operation_HandleMsg );
 				pCommandClass->HandleMsg( &_data[4], _length-4, instance );
 			}
 		} else {
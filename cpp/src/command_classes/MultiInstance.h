@@ -78,6 +78,7 @@ namespace OpenZWave
 		virtual uint8 GetMaxVersion(){ return 2; }
 
 		MultiInstanceMapping GetEndPointMap(){ return m_endPointMap; }
+		void ResetEndPoints(){ m_numEndPoints = 0; }	// So that the next endpoint report is handled, rather than ignored
 
 	private:
 		MultiInstance( uint32 const _homeId, uint8 const _nodeId );
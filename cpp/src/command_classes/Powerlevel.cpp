@@ -203,6 +203,7 @@ bool Powerlevel::HandleMsg
 			value->OnValueRefreshed( (short)ackCount );
 			value->Release();
 		}
+		GetDriver()->OnLinkTestReport( GetNodeId(), testNode, (uint8)status, ackCount );
 		return true;
 	}
 	return false;
@@ -462,6 +463,49 @@ bool Powerlevel::Report
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// <Powerlevel::TestLink>
+// Test the link to another node for a network health scan
+//-----------------------------------------------------------------------------
+bool Powerlevel::TestLink
+(
+	uint8 const _targetId,
+	uint16 const _frames
+)
+{
+	Log::Write( LogLevel_Info, GetNodeId(), "Testing the link to node %d with %d frames", _targetId, _frames );
+	Msg* msg = new Msg( "PowerlevelCmd_TestNodeSet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( 6 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( PowerlevelCmd_TestNodeSet );
+	msg->Append( _targetId );
+	msg->Append( (uint8)PowerLevel_Normal );
+	msg->Append( (uint8)(_frames >> 8) );
+	msg->Append( (uint8)(_frames & 0x00ff) );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Powerlevel::RequestLinkTestReport>
+// Request the result of a link test
+//-----------------------------------------------------------------------------
+bool Powerlevel::RequestLinkTestReport
+(
+)
+{
+	Msg* msg = new Msg( "PowerlevelCmd_TestNodeGet", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->Append( GetNodeId() );
+	msg->Append( 2 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( PowerlevelCmd_TestNodeGet );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <Powerlevel::CreateVars>
 // Create the values managed by this command class
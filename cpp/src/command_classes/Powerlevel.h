@@ -74,6 +74,19 @@ namespace OpenZWave
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
 
+		/**
+		 * Have the node send test frames to another node, at normal power.
+		 * The result is passed to the driver's network health scan.
+		 * \param _targetId the node to send the frames to.
+		 * \param _frames how many frames to send.
+		 */
+		bool TestLink( uint8 const _targetId, uint16 const _frames );
+
+		/**
+		 * Ask for the result of the last test started by TestLink.
+		 */
+		bool RequestLinkTestReport();
+
 	protected:
 		virtual void CreateVars( uint8 const _instance );
 
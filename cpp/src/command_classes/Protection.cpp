@@ -166,6 +166,18 @@ bool Protection::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <Protection::GetSetKeyLength>
+// A later ProtectionCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 Protection::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ProtectionCmd_Set == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <Protection::CreateVars>
 // Create the values managed by this command class
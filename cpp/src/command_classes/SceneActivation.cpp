@@ -55,6 +55,17 @@ bool SceneActivation::HandleMsg
 {
 	if( SceneActivationCmd_Set == (SceneActivationCmd)_data[0] )
 	{
+		// The scene event watchers hear of it first
+		Driver::SceneEvent event;
+		event.m_nodeId = GetNodeId();
+		event.m_instance = (uint8)_instance;
+		event.m_commandClassId = GetCommandClassId();
+		event.m_sceneId = _data[1];
+		event.m_keyAttributes = 0;
+		event.m_sequence = 0;
+		event.m_duration = ( _length > 3 ) ? _data[2] : 0xff;
+		GetDriver()->RaiseSceneEvent( event );
+
 		// Scene Activation Set received so send notification
 		char msg[64];
 		if( _data[2] == 0 )
@@ -217,6 +217,7 @@ bool Security::HandleMsg
 				value->Release();
 			}
 			HandleSupportedReport(&_data[2], _length-2);
+			GetNodeUnsafe()->RecordSecuredClasses( _data, _length );
 			break;
 		}
 		case SecurityCmd_SchemeReport:
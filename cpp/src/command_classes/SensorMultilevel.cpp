@@ -307,7 +307,7 @@ bool SensorMultilevel::HandleMsg
 		uint8 scale;
 		uint8 precision = 0;
 		uint8 sensorType = _data[1];
-		string valueStr = ExtractValue( &_data[2], &scale, &precision );
+		int32 mantissa = ExtractMantissa( &_data[2], &scale, &precision );
 
 		Node* node = GetNodeUnsafe();
 		if( node != NULL )
@@ -431,12 +431,16 @@ bool SensorMultilevel::HandleMsg
 				value->SetUnits(units);
 			}
 
-			Log::Write( LogLevel_Info, GetNodeId(), "Received SensorMultiLevel report from node %d, instance %d, %s: value=%s%s", GetNodeId(), _instance, c_sensorTypeNames[sensorType], valueStr.c_str(), value->GetUnits().c_str() );
+			ValueDecimal::Fixed reading;
+			reading.m_mantissa = mantissa;
+			reading.m_precision = precision;
+			char valueStr[16];
+			Log::Write( LogLevel_Info, GetNodeId(), "Received SensorMultiLevel report from node %d, instance %d, %s: value=%s%s", GetNodeId(), _instance, c_sensorTypeNames[sensorType], ValueDecimal::Format( reading, valueStr, sizeof(valueStr) ), value->GetUnits().c_str() );
 			if( value->GetPrecision() != precision )
 			{
 				value->SetPrecision( precision );
 			}
-			value->OnValueRefreshed( valueStr );
+			value->OnValueRefreshed( mantissa, precision );
 			value->Release();
 			return true;
 		}
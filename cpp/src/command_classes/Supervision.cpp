@@ -0,0 +1,253 @@
+//-----------------------------------------------------------------------------
+//
+//	Supervision.cpp
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_SUPERVISION
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "command_classes/CommandClasses.h"
+#include "command_classes/Supervision.h"
+#include "Defs.h"
+#include "Msg.h"
+#include "Node.h"
+#include "Driver.h"
+#include "CommandClassProfile.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+enum SupervisionStatus
+{
+	SupervisionStatus_NoSupport	= 0x00,
+	SupervisionStatus_Working	= 0x01,
+	SupervisionStatus_Fail		= 0x02,
+	SupervisionStatus_Success	= 0xff
+};
+
+static uint8 const c_statusUpdates = 0x80;		// In a Get, asks for a report each time the status changes.  In a report, says more will follow.
+static uint8 const c_sessionIdMask = 0x3f;
+
+//-----------------------------------------------------------------------------
+// <Supervision::Supervision>
+// Constructor
+//-----------------------------------------------------------------------------
+Supervision::Supervision
+(
+	uint32 const _homeId,
+	uint8 const _nodeId
+):
+	CommandClass( _homeId, _nodeId ),
+	m_nextSessionId( 0 )
+{
+	memset( m_sessions, 0, sizeof(m_sessions) );
+}
+
+//-----------------------------------------------------------------------------
+// <Supervision::HandleMsg>
+// Handle a message from the Z-Wave network
+//-----------------------------------------------------------------------------
+bool Supervision::HandleMsg
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint32 const _instance	// = 1
+)
+{
+	if( SupervisionCmd_Report == (SupervisionCmd)_data[0] && _length >= 4 )
+	{
+		HandleReport( _data );
+		return true;
+	}
+
+	if( SupervisionCmd_Get == (SupervisionCmd)_data[0] && _length >= 4 && _data[2] + 3u <= _length )
+	{
+		HandleGet( _data, _instance );
+		return true;
+	}
+
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Supervision::StartSession>
+// Wrap a Set in a Supervision Get, and remember it until it is reported on
+//-----------------------------------------------------------------------------
+void Supervision::StartSession
+(
+	Msg* _msg,
+	uint8 const _commandClassId,
+	uint8 const _instance,
+	uint8 const _index
+)
+{
+	uint8 length = 0;
+	uint8 const* payload = _msg->GetUnwrappedPayload( length );
+	if( payload == NULL || length < 2 || length - 1 > MaxSetLength )
+	{
+		return;
+	}
+
+	// A later Set of the same value replaces the earlier one
+	for( uint8 i = 0; i < MaxSessions; ++i )
+	{
+		Session& session = m_sessions[i];
+		if( session.m_open && session.m_commandClassId == _commandClassId && session.m_instance == _instance && session.m_index == _index )
+		{
+			session.m_open = false;
+		}
+	}
+
+	uint8 sessionId = m_nextSessionId;
+	m_nextSessionId = ( m_nextSessionId + 1 ) & c_sessionIdMask;
+
+	Session& session = m_sessions[sessionId];
+	session.m_open = true;
+	session.m_commandClassId = _commandClassId;
+	session.m_instance = _instance;
+	session.m_index = _index;
+	session.m_length = length - 1;
+	memcpy( session.m_data, &payload[1], session.m_length );
+
+	_msg->SetSupervision( c_statusUpdates | sessionId );
+}
+
+//-----------------------------------------------------------------------------
+// <Supervision::IsPending>
+// Whether a Set of a value is waiting for its report
+//-----------------------------------------------------------------------------
+bool Supervision::IsPending
+(
+	uint8 const _commandClassId,
+	uint8 const _instance,
+	uint8 const _index
+)const
+{
+	for( uint8 i = 0; i < MaxSessions; ++i )
+	{
+		Session const& session = m_sessions[i];
+		if( session.m_open && session.m_commandClassId == _commandClassId && session.m_instance == _instance && session.m_index == _index )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <Supervision::HandleReport>
+// Finish the session of a Set the node has reported on
+//-----------------------------------------------------------------------------
+void Supervision::HandleReport
+(
+	uint8 const* _data
+)
+{
+	uint8 sessionId = _data[1] & c_sessionIdMask;
+	uint8 status = _data[2];
+	Session& session = m_sessions[sessionId];
+	if( !session.m_open )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "Received Supervision report for session %d, which is not open", sessionId );
+		return;
+	}
+
+	Node* node = GetNodeUnsafe();
+	CommandClass* cc = node ? node->GetCommandClass( session.m_commandClassId ) : NULL;
+	string ccName = cc ? cc->GetCommandClassName() : "";
+	switch( status )
+	{
+		case SupervisionStatus_Working:
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Supervision report for session %d: %s Set in progress, duration 0x%.2x", sessionId, ccName.c_str(), _data[3] );
+			if( ( _data[1] & c_statusUpdates ) != 0 )
+			{
+				// Another report will follow once the node is done
+				return;
+			}
+			break;
+		}
+		case SupervisionStatus_Success:
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Supervision report for session %d: %s Set succeeded", sessionId, ccName.c_str() );
+			break;
+		}
+		case SupervisionStatus_Fail:
+		{
+			Log::Write( LogLevel_Warning, GetNodeId(), "Received Supervision report for session %d: %s Set failed", sessionId, ccName.c_str() );
+			break;
+		}
+		default:
+		{
+			Log::Write( LogLevel_Warning, GetNodeId(), "Received Supervision report for session %d: %s Set not supported (status 0x%.2x)", sessionId, ccName.c_str(), status );
+			break;
+		}
+	}
+
+	session.m_open = false;
+	if( cc == NULL )
+	{
+		return;
+	}
+
+	// Take the values from the Set if it was carried out, and otherwise read them back
+	if( status != SupervisionStatus_Success || !cc->ApplySupervisedSet( session.m_data, session.m_length, session.m_instance ) )
+	{
+		cc->RequestValue( 0, session.m_index, session.m_instance, Driver::MsgQueue_Send );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <Supervision::HandleGet>
+// Hand a command the node sent to its command class, and report on it
+//-----------------------------------------------------------------------------
+void Supervision::HandleGet
+(
+	uint8 const* _data,
+	uint32 const _instance
+)
+{
+	uint8 sessionId = _data[1] & c_sessionIdMask;
+	uint8 status = SupervisionStatus_NoSupport;
+	if( Node* node = GetNodeUnsafe() )
+	{
+		if( CommandClass* cc = node->GetCommandClass( _data[3] ) )
+		{
+			Log::Write( LogLevel_Info, GetNodeId(), "Received Supervision Get for session %d: %s", sessionId, cc->GetCommandClassName().c_str() );
+			CommandClassProfile::Timer timer( _data[3], CommandClassProfile::Operation_HandleMsg );
+			if( cc->HandleMsg( &_data[4], _data[2], _instance ) )
+			{
+				status = SupervisionStatus_Success;
+			}
+		}
+	}
+
+	Msg* msg = new Msg( "SupervisionCmd_Report", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, false );
+	msg->SetInstance( this, (uint8)_instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 5 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( SupervisionCmd_Report );
+	msg->Append( sessionId );
+	msg->Append( status );
+	msg->Append( 0 );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+//
+//	Supervision.h
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_SUPERVISION
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _Supervision_H
+#define _Supervision_H
+
+#include "command_classes/CommandClass.h"
+
+namespace OpenZWave
+{
+	/** \brief Implements COMMAND_CLASS_SUPERVISION (0x6C), a Z-Wave device command class.
+	 *
+	 * A Set sent to a node that supports Supervision is wrapped in a Supervision Get,
+	 * and the node answers with a report saying whether it carried the Set out.  On
+	 * success the command class that sent the Set updates its values from the Set
+	 * itself, so no Get is needed to read them back.  If the node could not carry it
+	 * out, the values are read back as before.
+	 *
+	 * Commands a node sends wrapped in a Supervision Get are handed to their command
+	 * class, and answered with a report.
+	 */
+	class Supervision: public CommandClass
+	{
+	public:
+		enum SupervisionCmd
+		{
+			SupervisionCmd_Get		= 0x01,
+			SupervisionCmd_Report	= 0x02
+		};
+
+		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new Supervision( _homeId, _nodeId ); }
+		virtual ~Supervision(){}
+
+		static uint8 const StaticGetCommandClassId(){ return 0x6C; }
+		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_SUPERVISION"; }
+
+		// From CommandClass
+		virtual uint8 const GetCommandClassId()const{ return StaticGetCommandClassId(); }
+		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
+		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
+
+		/**
+		 * Start a session for a Set, and have the message wrapped in a Supervision Get.
+		 * \param _msg the Set, with its payload appended but not yet sent.
+		 * \param _commandClassId the command class sending the Set.
+		 * \param _instance the instance of the value being set.
+		 * \param _index the index of the value being set.
+		 */
+		void StartSession( Msg* _msg, uint8 const _commandClassId, uint8 const _instance, uint8 const _index );
+
+		/**
+		 * \return true if a Set of the value is waiting for its report.
+		 */
+		bool IsPending( uint8 const _commandClassId, uint8 const _instance, uint8 const _index )const;
+
+	private:
+		Supervision( uint32 const _homeId, uint8 const _nodeId );
+
+		void HandleGet( uint8 const* _data, uint32 const _instance );
+		void HandleReport( uint8 const* _data );
+
+		enum
+		{
+			MaxSessions		= 64,		// Session ids are six bits
+			MaxSetLength	= 16		// Longest Set kept for when it is confirmed
+		};
+
+		struct Session
+		{
+			bool	m_open;
+			uint8	m_commandClassId;
+			uint8	m_instance;
+			uint8	m_index;
+			uint8	m_length;
+			uint8	m_data[MaxSetLength];	// The Set, from its command byte on
+		};
+
+		Session		m_sessions[MaxSessions];		// Indexed by session id
+		uint8		m_nextSessionId;
+	};
+
+} // namespace OpenZWave
+
+#endif
@@ -182,6 +182,21 @@ void SwitchAll::Off
 	_driver->SendMsg( msg, Driver::MsgQueue_Send );
 }
 
+//-----------------------------------------------------------------------------
+// <SwitchAll::Broadcast>
+// Send a command to switch all devices on or off, in one frame
+//-----------------------------------------------------------------------------
+void SwitchAll::Broadcast
+(
+	Driver* _driver,
+	bool const _on,
+	vector<uint8> const& _nodeIds
+)
+{
+	uint8 command[2] = { StaticGetCommandClassId(), (uint8)( _on ? SwitchAllCmd_On : SwitchAllCmd_Off ) };
+	_driver->SendBroadcast( _on ? "SwitchAllCmd_On" : "SwitchAllCmd_Off", command, 2, _nodeIds );
+}
+
 //-----------------------------------------------------------------------------
 // <SwitchAll::On>
 // Send a command to switch all devices on
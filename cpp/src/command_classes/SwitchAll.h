@@ -47,6 +47,7 @@ namespace OpenZWave
 
 		static void On( Driver* _driver, uint8 const _nodeId );
 		static void Off( Driver* _driver, uint8 const _nodeId );
+		static void Broadcast( Driver* _driver, bool const _on, vector<uint8> const& _nodeIds );	// Checked afterwards on _nodeIds, the listening nodes with SwitchAll
 
 		// From CommandClass
 		virtual bool RequestState( uint32 const _requestFlags, uint8 const _instance, Driver::MsgQueue const _queue );
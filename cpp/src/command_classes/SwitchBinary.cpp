@@ -135,12 +135,14 @@ bool SwitchBinary::SetValue
 		Log::Write( LogLevel_Info, GetNodeId(), "SwitchBinary::Set - Setting node %d to %s", GetNodeId(), value->GetValue() ? "On" : "Off" );
 		Msg* msg = new Msg( "SwitchBinaryCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
 		msg->SetInstance( this, _value.GetID().GetInstance() );
+		msg->SetSupersedable( 2 );
 		msg->Append( GetNodeId() );
 		msg->Append( 3 );
 		msg->Append( GetCommandClassId() );
 		msg->Append( SwitchBinaryCmd_Set );
 		msg->Append( value->GetValue() ? 0xff : 0x00 );
 		msg->Append( GetDriver()->GetTransmitOptions() );
+		Supervise( msg, _value.GetID().GetInstance(), 0 );
 		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
 		return true;
 	}
@@ -148,6 +150,42 @@ bool SwitchBinary::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <SwitchBinary::ApplySupervisedSet>
+// The node has switched as it was told to
+//-----------------------------------------------------------------------------
+bool SwitchBinary::ApplySupervisedSet
+(
+	uint8 const* _data,
+	uint8 const _length,
+	uint8 const _instance
+)
+{
+	if( SwitchBinaryCmd_Set != (SwitchBinaryCmd)_data[0] || _length < 2 )
+	{
+		return false;
+	}
+
+	if( ValueBool* value = static_cast<ValueBool*>( GetValue( _instance, 0 ) ) )
+	{
+		value->OnValueRefreshed( _data[1] != 0 );
+		value->Release();
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <SwitchBinary::GetSetKeyLength>
+// A later SwitchBinaryCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 SwitchBinary::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( SwitchBinaryCmd_Set == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <SwitchBinary::SetValueBasic>
 // Update class values based in BASIC mapping
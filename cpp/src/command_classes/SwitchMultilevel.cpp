@@ -400,6 +400,43 @@ bool SwitchMultilevel::SetValue
 	return res;
 }
 
+//-----------------------------------------------------------------------------
+// <SwitchMultilevel::GetSetKeyLength>
+// A later SwitchMultilevelCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 SwitchMultilevel::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( SwitchMultilevelCmd_Set == _command ) ? 2 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <SwitchMultilevel::ApplySupervisedSet>
+// The node has reached the level it was told to.  A level of 0xff restores
+// the last level the node had, which only the node knows.
+//-----------------------------------------------------------------------------
+bool SwitchMultilevel::ApplySupervisedSet
+(
+	uint8 const* _data,
+	uint8 const _length,
+	uint8 const _instance
+)
+{
+	if( SwitchMultilevelCmd_Set != (SwitchMultilevelCmd)_data[0] || _length < 2 || _data[1] == 0xff )
+	{
+		return false;
+	}
+
+	if( ValueByte* value = static_cast<ValueByte*>( GetValue( _instance, SwitchMultilevelIndex_Level ) ) )
+	{
+		value->OnValueRefreshed( _data[1] );
+		value->Release();
+	}
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <SwitchMultilevel::SetValueBasic>
 // Update class values based in BASIC mapping
@@ -445,6 +482,7 @@ bool SwitchMultilevel::SetLevel
 	Log::Write( LogLevel_Info, GetNodeId(), "SwitchMultilevel::Set - Setting to level %d", _level );
 	Msg* msg = new Msg( "SwitchMultilevelCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
 	msg->SetInstance( this, _instance );
+	msg->SetSupersedable( 2 );
 	msg->Append( GetNodeId() );
 
 	if( ValueByte* durationValue = static_cast<ValueByte*>( GetValue( _instance, SwitchMultilevelIndex_Duration ) ) )
@@ -479,6 +517,7 @@ bool SwitchMultilevel::SetLevel
 	}
 
 	msg->Append( GetDriver()->GetTransmitOptions() );
+	Supervise( msg, _instance, SwitchMultilevelIndex_Level );
 	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
 	return true;
 }
@@ -54,7 +54,9 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+		virtual uint8 GetSetKeyLength( uint8 const _command )const;
 		virtual void SetValueBasic( uint8 const _instance, uint8 const _value );
+		virtual bool ApplySupervisedSet( uint8 const* _data, uint8 const _length, uint8 const _instance );
 		virtual void SetVersion( uint8 const _version );
 
 		virtual uint8 GetMaxVersion(){ return 3; }
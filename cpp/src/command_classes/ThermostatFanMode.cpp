@@ -337,6 +337,18 @@ bool ThermostatFanMode::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <ThermostatFanMode::GetSetKeyLength>
+// A later ThermostatFanModeCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 ThermostatFanMode::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ThermostatFanModeCmd_Set == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <ThermostatFanMode::CreateVars>
 // Create the values managed by this command class
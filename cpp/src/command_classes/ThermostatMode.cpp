@@ -348,6 +348,18 @@ bool ThermostatMode::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <ThermostatMode::GetSetKeyLength>
+// A later ThermostatModeCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 ThermostatMode::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ThermostatModeCmd_Set == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <ThermostatMode::CreateVars>
 // Create the values managed by this command class
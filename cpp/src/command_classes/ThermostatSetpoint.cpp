@@ -228,10 +228,10 @@ bool ThermostatSetpoint::HandleMsg
 		{
 			uint8 scale;
 			uint8 precision = 0;
-			string temperature = ExtractValue( &_data[2], &scale, &precision );
+			int32 temperature = ExtractMantissa( &_data[2], &scale, &precision );
 
 			value->SetUnits( scale ? "F" : "C" );
-			value->OnValueRefreshed( temperature );
+			value->OnValueRefreshed( temperature, precision );
 			if( value->GetPrecision() != precision )
 			{
 				value->SetPrecision( precision );
@@ -293,11 +293,12 @@ bool ThermostatSetpoint::SetValue
 		Msg* msg = new Msg( "ThermostatSetpointCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
 		msg->SetInstance( this, _value.GetID().GetInstance() );
 		msg->Append( GetNodeId() );
-		msg->Append( 4 + GetAppendValueSize( value->GetValue() ) );
+		ValueDecimal::Fixed const& setpoint = value->GetFixedValue();
+		msg->Append( 4 + GetAppendValueSize( setpoint.m_mantissa, setpoint.m_precision ) );
 		msg->Append( GetCommandClassId() );
 		msg->Append( ThermostatSetpointCmd_Set );
 		msg->Append( value->GetID().GetIndex() );
-		AppendValue( msg, value->GetValue(), scale );
+		AppendValue( msg, setpoint.m_mantissa, setpoint.m_precision, scale );
 		msg->Append( GetDriver()->GetTransmitOptions() );
 		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
 		return true;
@@ -306,6 +307,18 @@ bool ThermostatSetpoint::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <ThermostatSetpoint::GetSetKeyLength>
+// A later ThermostatSetpointCmd_Set for the same setpoint type replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 ThermostatSetpoint::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( ThermostatSetpointCmd_Set == _command ) ? 3 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <ThermostatSetpoint::CreateVars>
 // Create the values managed by this command class
@@ -175,40 +175,7 @@ bool TimeParameters::SetValue
 
 	if ( (ValueID::ValueType_Button == _value.GetID().GetType()) && (_value.GetID().GetIndex() == TimeParametersIndex_Set) )
 	{
-		time_t rawtime;
-		struct tm *timeinfo;
-		time(&rawtime);
-#ifdef WINAPI_FAMILY_APP
-#pragma warning(push)
-#pragma warning(disable:4996)
-#endif
-		timeinfo = localtime(&rawtime);
-#ifdef WINAPI_FAMILY_APP
-#pragma warning(pop)
-#endif
-		Msg* msg = new Msg( "TimeParametersCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
-		msg->SetInstance( this, instance );
-		msg->Append( GetNodeId() );
-		msg->Append( 9 );
-		msg->Append( GetCommandClassId() );
-		msg->Append( TimeParametersCmd_Set );
-		/* Year 1 */
-		msg->Append( ((timeinfo->tm_year + 1900)>> 8) & 0xFF);
-		/* Year 2 */
-		msg->Append( ((timeinfo->tm_year + 1900) & 0xFF));
-		/* Month */
-		msg->Append( (timeinfo->tm_mon & 0x0F)+1);
-		/* Day */
-		msg->Append( (timeinfo->tm_mday & 0x1F));
-		/* Hour */
-		msg->Append( (timeinfo->tm_hour & 0x1F));
-		/* Minute */
-		msg->Append( (timeinfo->tm_min & 0x3F));
-		/* Second */
-		msg->Append( (timeinfo->tm_sec & 0x3F));
-		msg->Append( GetDriver()->GetTransmitOptions() );
-		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
-
+		SetTime( instance, time( NULL ) );
 
 		/* Refresh after we send updated date/time */
 		SetStaticRequest( StaticRequest_Values );
@@ -223,6 +190,67 @@ bool TimeParameters::SetValue
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <TimeParameters::GetSetKeyLength>
+// A later TimeParametersCmd_Set replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 TimeParameters::GetSetKeyLength
+(
+	uint8 const _command
+)const
+{
+	return( ( TimeParametersCmd_Set == _command ) ? 2 : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <TimeParameters::SetTime>
+// Set the device's date and time
+//-----------------------------------------------------------------------------
+bool TimeParameters::SetTime
+(
+	uint8 const _instance,
+	time_t const _time
+)
+{
+	struct tm *timeinfo;
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(push)
+#pragma warning(disable:4996)
+#endif
+	timeinfo = localtime(&_time);
+#ifdef WINAPI_FAMILY_APP
+#pragma warning(pop)
+#endif
+	if( timeinfo == NULL )
+	{
+		return false;
+	}
+
+	Msg* msg = new Msg( "TimeParametersCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->SetInstance( this, _instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 9 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( TimeParametersCmd_Set );
+	/* Year 1 */
+	msg->Append( ((timeinfo->tm_year + 1900)>> 8) & 0xFF);
+	/* Year 2 */
+	msg->Append( ((timeinfo->tm_year + 1900) & 0xFF));
+	/* Month */
+	msg->Append( (timeinfo->tm_mon & 0x0F)+1);
+	/* Day */
+	msg->Append( (timeinfo->tm_mday & 0x1F));
+	/* Hour */
+	msg->Append( (timeinfo->tm_hour & 0x1F));
+	/* Minute */
+	msg->Append( (timeinfo->tm_min & 0x3F));
+	/* Second */
+	msg->Append( (timeinfo->tm_sec & 0x3F));
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <TimeParameters::CreateVars>
 // Create the values managed by this command class
@@ -53,6 +53,8 @@ namespace OpenZWave
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+		virtual uint8 GetSetKeyLength( uint8 const _command )const;
+		virtual bool SetTime( uint8 const _instance, time_t const _time );
 
 	protected:
 		virtual void CreateVars( uint8 const _instance );
@@ -0,0 +1,414 @@
+//-----------------------------------------------------------------------------
+//
+//	TransportService.cpp
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_TRANSPORT_SERVICE
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "command_classes/CommandClasses.h"
+#include "command_classes/TransportService.h"
+#include "Defs.h"
+#include "Checksum.h"
+#include "Msg.h"
+#include "Node.h"
+#include "Driver.h"
+#include "CommandClassProfile.h"
+#include "Utils.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+// The low three bits of the command byte hold the top of the datagram size, or
+// are unused, so only the top five identify the command
+enum TransportServiceCmd
+{
+	TransportServiceCmd_FirstSegment		= 0xc0,
+	TransportServiceCmd_SegmentRequest		= 0xc8,
+	TransportServiceCmd_SubsequentSegment	= 0xe0,
+	TransportServiceCmd_SegmentComplete		= 0xe8,
+	TransportServiceCmd_SegmentWait			= 0xf0
+};
+
+static uint8 const c_commandMask = 0xf8;
+static uint8 const c_headerExtension = 0x08;
+static uint8 const c_noSession = 0xff;
+
+// Bytes of each segment around the part of the datagram it carries, counting the command class and CRC
+static uint32 const c_firstSegmentOverhead = 6;
+static uint32 const c_subsequentSegmentOverhead = 7;
+
+//-----------------------------------------------------------------------------
+// <TransportService::TransportService>
+// Constructor
+//-----------------------------------------------------------------------------
+TransportService::TransportService
+(
+	uint32 const _homeId,
+	uint8 const _nodeId
+):
+	CommandClass( _homeId, _nodeId ),
+	m_mutex( new Mutex() ),
+	m_txSession( 0 ),
+	m_txOptions( 0 ),
+	m_txExpectedReply( 0 ),
+	m_txExpectedCommandClassId( 0 ),
+	m_rxMissing( 0 ),
+	m_rxSession( c_noSession ),
+	m_rxLastSession( c_noSession )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::~TransportService>
+// Destructor
+//-----------------------------------------------------------------------------
+TransportService::~TransportService
+(
+)
+{
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::HandleMsg>
+// Handle a message from the Z-Wave network
+//-----------------------------------------------------------------------------
+bool TransportService::HandleMsg
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint32 const _instance	// = 1
+)
+{
+	// The driver passes segments to HandleSegment itself.  This is only reached if one
+	// arrives inside another encapsulation.
+	switch( _data[0] & c_commandMask )
+	{
+		case TransportServiceCmd_FirstSegment:
+		case TransportServiceCmd_SegmentRequest:
+		case TransportServiceCmd_SubsequentSegment:
+		case TransportServiceCmd_SegmentComplete:
+		case TransportServiceCmd_SegmentWait:
+		{
+			uint8 datagram[c_maxDatagram];
+			uint32 length = 0;
+			if( HandleSegment( _data, _length, datagram, length ) )
+			{
+				if( Node const* node = GetNodeUnsafe() )
+				{
+					if( CommandClass* pCommandClass = node->GetCommandClass( datagram[0] ) )
+					{
+						CommandClassProfile::Timer timer( datagram[0], CommandClassProfile::Operation_HandleMsg );
+						pCommandClass->HandleMsg( &datagram[1], length, _instance );
+					}
+				}
+			}
+			return true;
+		}
+		default:
+		{
+			break;
+		}
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::HandleSegment>
+// Add a segment to the datagram being received, or act on the node's reply to one sent
+//-----------------------------------------------------------------------------
+bool TransportService::HandleSegment
+(
+	uint8 const* _data,
+	uint32 const _length,
+	uint8* o_datagram,
+	uint32& o_length
+)
+{
+	uint32 bytes = _length - 1;
+	if( bytes < 2 )
+	{
+		return false;
+	}
+
+	uint8 command = _data[0] & c_commandMask;
+	if( command == TransportServiceCmd_SegmentRequest )
+	{
+		uint8 session = _data[1] >> 4;
+		uint16 offset = (uint16)( ( ( _data[1] & 0x07 ) << 8 ) | ( bytes > 2 ? _data[2] : 0 ) );
+		Msg* msg = NULL;
+		{
+			LockGuard LG( m_mutex );
+			if( session == m_txSession && offset < m_txDatagram.size() )
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "Node asked for the segment of datagram %d at offset %d again", session, offset );
+				msg = CreateSegment( offset, false );
+			}
+		}
+		if( msg )
+		{
+			GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+		}
+		return false;
+	}
+	if( command == TransportServiceCmd_SegmentComplete )
+	{
+		LockGuard LG( m_mutex );
+		if( ( _data[1] >> 4 ) == m_txSession && !m_txDatagram.empty() )
+		{
+			Log::Write( LogLevel_Detail, GetNodeId(), "Node received all of datagram %d", m_txSession );
+			m_txDatagram.clear();
+		}
+		return false;
+	}
+	if( command == TransportServiceCmd_SegmentWait )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "Node is busy with another datagram, %d segments still to come", _data[1] );
+		return false;
+	}
+	if( command != TransportServiceCmd_FirstSegment && command != TransportServiceCmd_SubsequentSegment )
+	{
+		return false;
+	}
+
+	// A segment of a datagram from the node
+	bool first = ( command == TransportServiceCmd_FirstSegment );
+	uint32 header = first ? 3 : 4;
+	if( bytes < header + 2 )
+	{
+		return false;
+	}
+	if( ( _data[2] & c_headerExtension ) != 0 )
+	{
+		header += 1 + _data[header];
+		if( bytes < header + 2 )
+		{
+			return false;
+		}
+	}
+
+	// The CRC covers the whole command, starting with the command class
+	uint8 const commandClassId = StaticGetCommandClassId();
+	uint16 crc = Crc16Ccitt( _data, bytes - 2, Crc16Ccitt( &commandClassId, 1 ) );
+	if( crc != ( ( (uint16)_data[bytes-2] << 8 ) | _data[bytes-1] ) )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Dropping a datagram segment that failed its CRC check" );
+		return false;
+	}
+
+	uint32 size = ( ( _data[0] & 0x07 ) << 8 ) | _data[1];
+	uint8 session = _data[2] >> 4;
+	uint32 offset = first ? 0 : ( ( ( _data[2] & 0x07 ) << 8 ) | _data[3] );
+	uint32 length = bytes - header - 2;
+	if( size > c_maxDatagram || offset + length > size )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Dropping a segment of a %d byte datagram, which is too large", size );
+		return false;
+	}
+
+	if( session != m_rxSession )
+	{
+		if( session == m_rxLastSession )
+		{
+			// The node did not hear that the datagram was complete
+			SendComplete( session );
+			return false;
+		}
+
+		// A new datagram replaces any that was not finished.  Its size is in every
+		// segment, so it can be started even if the first segment was lost.
+		m_rxSession = session;
+		m_rxDatagram.assign( size, 0 );
+		m_rxHave.assign( size, false );
+		m_rxMissing = size;
+	}
+	else if( size != m_rxDatagram.size() )
+	{
+		return false;
+	}
+
+	for( uint32 i = 0; i < length; ++i )
+	{
+		if( !m_rxHave[offset+i] )
+		{
+			m_rxHave[offset+i] = true;
+			m_rxDatagram[offset+i] = _data[header+i];
+			--m_rxMissing;
+		}
+	}
+
+	if( m_rxMissing == 0 )
+	{
+		Log::Write( LogLevel_Detail, GetNodeId(), "Received all %d bytes of datagram %d", size, session );
+		memcpy( o_datagram, &m_rxDatagram[0], size );
+		o_length = size;
+		m_rxLastSession = session;
+		m_rxSession = c_noSession;
+		m_rxDatagram.clear();
+		m_rxHave.clear();
+		SendComplete( session );
+		return( size != 0 );
+	}
+
+	if( offset + length == size )
+	{
+		// That was the last segment, so ask for the first of any that were missed
+		uint32 missing = 0;
+		while( m_rxHave[missing] )
+		{
+			++missing;
+		}
+		RequestSegment( (uint16)missing );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::Segment>
+// Split a request into segments
+//-----------------------------------------------------------------------------
+bool TransportService::Segment
+(
+	Msg* _msg,
+	vector<Msg*>& o_segments
+)
+{
+	uint8 const* buffer = _msg->GetBuffer();
+	uint32 size = buffer[5];
+	if( size > 0x07ff )
+	{
+		return false;
+	}
+
+	LockGuard LG( m_mutex );
+	m_txDatagram.assign( &buffer[6], &buffer[6+size] );
+	m_txSession = ( m_txSession + 1 ) & 0x0f;
+	m_txOptions = _msg->GetTransmitOptions();
+	m_txExpectedReply = _msg->GetExpectedReply();
+	m_txExpectedCommandClassId = _msg->GetExpectedCommandClassId();
+
+	uint32 offset = 0;
+	while( offset < size )
+	{
+		uint32 room = c_maxFramePayload - ( offset ? c_subsequentSegmentOverhead : c_firstSegmentOverhead );
+		uint32 next = ( size - offset < room ) ? size : offset + room;
+		o_segments.push_back( CreateSegment( (uint16)offset, next == size ) );
+		offset = next;
+	}
+	Log::Write( LogLevel_Detail, GetNodeId(), "Sending a %d byte datagram as %d segments of session %d", size, o_segments.size(), m_txSession );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::CreateSegment>
+// Build the segment of the datagram being sent that starts at an offset
+//-----------------------------------------------------------------------------
+Msg* TransportService::CreateSegment
+(
+	uint16 const _offset,
+	bool const _last
+)
+{
+	uint32 size = (uint32)m_txDatagram.size();
+	bool first = ( _offset == 0 );
+	uint32 room = c_maxFramePayload - ( first ? c_firstSegmentOverhead : c_subsequentSegmentOverhead );
+	uint32 length = ( size - _offset < room ) ? size - _offset : room;
+
+	uint8 frame[c_maxFramePayload];
+	uint32 n = 0;
+	frame[n++] = GetCommandClassId();
+	frame[n++] = (uint8)( ( first ? TransportServiceCmd_FirstSegment : TransportServiceCmd_SubsequentSegment ) | ( ( size >> 8 ) & 0x07 ) );
+	frame[n++] = (uint8)( size & 0xff );
+	if( first )
+	{
+		frame[n++] = (uint8)( m_txSession << 4 );
+	}
+	else
+	{
+		frame[n++] = (uint8)( ( m_txSession << 4 ) | ( ( _offset >> 8 ) & 0x07 ) );
+		frame[n++] = (uint8)( _offset & 0xff );
+	}
+	memcpy( &frame[n], &m_txDatagram[_offset], length );
+	n += length;
+	uint16 crc = Crc16Ccitt( frame, n );
+	frame[n++] = (uint8)( crc >> 8 );
+	frame[n++] = (uint8)( crc & 0xff );
+
+	// Only the last segment waits for the reply the whole request would have
+	Msg* msg;
+	if( _last )
+	{
+		msg = new Msg( "TransportServiceCmd_Segment", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, m_txExpectedReply != 0, m_txExpectedReply, m_txExpectedCommandClassId );
+	}
+	else
+	{
+		msg = new Msg( "TransportServiceCmd_Segment", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	}
+	msg->Append( GetNodeId() );
+	msg->Append( (uint8)n );
+	for( uint32 i = 0; i < n; ++i )
+	{
+		msg->Append( frame[i] );
+	}
+	msg->Append( m_txOptions ? m_txOptions : GetDriver()->GetTransmitOptions() );
+	return msg;
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::RequestSegment>
+// Ask the node for a segment of the datagram being received that did not arrive
+//-----------------------------------------------------------------------------
+void TransportService::RequestSegment
+(
+	uint16 const _offset
+)
+{
+	Log::Write( LogLevel_Info, GetNodeId(), "Asking for the segment of datagram %d at offset %d", m_rxSession, _offset );
+	Msg* msg = new Msg( "TransportServiceCmd_SegmentRequest", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->Append( GetNodeId() );
+	msg->Append( 4 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( TransportServiceCmd_SegmentRequest );
+	msg->Append( (uint8)( ( m_rxSession << 4 ) | ( ( _offset >> 8 ) & 0x07 ) ) );
+	msg->Append( (uint8)( _offset & 0xff ) );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
+
+//-----------------------------------------------------------------------------
+// <TransportService::SendComplete>
+// Tell the node that all of a datagram has arrived
+//-----------------------------------------------------------------------------
+void TransportService::SendComplete
+(
+	uint8 const _session
+)
+{
+	Msg* msg = new Msg( "TransportServiceCmd_SegmentComplete", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->Append( GetNodeId() );
+	msg->Append( 3 );
+	msg->Append( GetCommandClassId() );
+	msg->Append( TransportServiceCmd_SegmentComplete );
+	msg->Append( (uint8)( _session << 4 ) );
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+}
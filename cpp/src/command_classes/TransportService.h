@@ -0,0 +1,113 @@
+//-----------------------------------------------------------------------------
+//
+//	TransportService.h
+//
+//	Implementation of the Z-Wave COMMAND_CLASS_TRANSPORT_SERVICE
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _TransportService_H
+#define _TransportService_H
+
+#include <vector>
+#include "command_classes/CommandClass.h"
+
+namespace OpenZWave
+{
+	class Msg;
+	class Mutex;
+
+	/** \brief Implements COMMAND_CLASS_TRANSPORT_SERVICE (0x55), a Z-Wave device command class.
+	 *
+	 * Carries a datagram too long for a single frame as a series of segments.  The driver
+	 * passes each segment a node sends to HandleSegment, and once the datagram is whole
+	 * processes it as if it had arrived in one frame, so it can be the reply a request is
+	 * waiting for.  Going the other way, the driver hands Segment any message whose payload
+	 * does not fit in a frame, and sends the segments in its place.
+	 */
+	class TransportService: public CommandClass
+	{
+	public:
+		static CommandClass* Create( uint32 const _homeId, uint8 const _nodeId ){ return new TransportService( _homeId, _nodeId ); }
+		virtual ~TransportService();
+
+		static uint8 const StaticGetCommandClassId(){ return 0x55; }
+		static string const StaticGetCommandClassName(){ return "COMMAND_CLASS_TRANSPORT_SERVICE"; }
+
+		/** The largest command class payload sent in a single frame */
+		static uint8 const c_maxFramePayload = 46;
+
+		/** The largest datagram that can be passed on once it is whole */
+		static uint8 const c_maxDatagram = 250;
+
+		// From CommandClass
+		virtual uint8 const GetCommandClassId()const{ return StaticGetCommandClassId(); }
+		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
+		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
+		virtual uint8 GetMaxVersion(){ return 2; }
+
+		/**
+		 * Add a segment from the node to the datagram being put back together.
+		 * \param _data the segment, starting with the command, as passed to HandleMsg.
+		 * \param _length the length of the segment, counting the command class.
+		 * \param o_datagram filled in with the datagram, starting with its command class, once it is whole.
+		 * Must hold c_maxDatagram bytes.
+		 * \param o_length set to the length of the datagram once it is whole.
+		 * \return true if this segment completed the datagram.
+		 */
+		bool HandleSegment( uint8 const* _data, uint32 const _length, uint8* o_datagram, uint32& o_length );
+
+		/**
+		 * Split a finalized ZW_SEND_DATA request into segments.  The last segment waits for the
+		 * same reply as the request.  The datagram is kept until the node confirms it, so that
+		 * any segment the node missed can be sent again.
+		 * \param _msg the request.
+		 * \param o_segments the segments are added to this, in the order they are to be sent.
+		 * \return true if the request was split.  False if it is too long even for segments.
+		 */
+		bool Segment( Msg* _msg, vector<Msg*>& o_segments );
+
+	private:
+		TransportService( uint32 const _homeId, uint8 const _nodeId );
+
+		Msg* CreateSegment( uint16 const _offset, bool const _last );
+		void RequestSegment( uint16 const _offset );
+		void SendComplete( uint8 const _session );
+
+		Mutex*			m_mutex;				// Guards the datagram being sent, which Segment is given on any thread
+
+		// The datagram being sent
+		vector<uint8>	m_txDatagram;			// Empty once the node has confirmed it
+		uint8			m_txSession;
+		uint8			m_txOptions;
+		uint8			m_txExpectedReply;
+		uint8			m_txExpectedCommandClassId;
+
+		// The datagram being received, only touched by the driver thread
+		vector<uint8>	m_rxDatagram;
+		vector<bool>	m_rxHave;				// Which bytes of the datagram have arrived
+		uint32			m_rxMissing;			// How many have not
+		uint8			m_rxSession;			// 0xff while none is being received
+		uint8			m_rxLastSession;		// The last session completed, to confirm again if the node missed it
+	};
+
+} // namespace OpenZWave
+
+#endif
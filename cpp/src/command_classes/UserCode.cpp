@@ -29,6 +29,7 @@
 #include "command_classes/CommandClasses.h"
 #include "command_classes/UserCode.h"
 #include "Node.h"
+#include "Driver.h"
 #include "Options.h"
 #include "platform/Log.h"
 
@@ -67,11 +68,15 @@ UserCode::UserCode
 	m_queryAll( false ),
 	m_currentCode( 0 ),
 	m_userCodeCount( 0 ),
-	m_refreshUserCodes(false)
+	m_refreshUserCodes(false),
+	m_forceRefresh( false ),
+	m_cacheAge( 0 )
 {
 	SetStaticRequest( StaticRequest_Values );
 	memset( m_userCodesStatus, 0xff, sizeof(m_userCodesStatus) );
+	memset( m_userCodesTime, 0, sizeof(m_userCodesTime) );
 	Options::Get()->GetOptionAsBool("RefreshAllUserCodes", &m_refreshUserCodes );
+	Options::Get()->GetOptionAsInt("UserCodeCacheAge", &m_cacheAge );
 
 }
 
@@ -91,6 +96,24 @@ void UserCode::ReadXML
 	{
 		m_userCodeCount = intVal;
 	}
+
+	// The state of each slot, as two hex digits per slot, all read at
+	// about the same time
+	int32 readTime = 0;
+	_ccElement->QueryIntAttribute( "slotsread", &readTime );
+	char const* str = _ccElement->Attribute( "slots" );
+	if( str && readTime > 0 )
+	{
+		for( uint32 i = 1; i <= m_userCodeCount && str[0] && str[1]; ++i, str += 2 )
+		{
+			char hex[3] = { str[0], str[1], 0 };
+			m_userCodesStatus[i] = (uint8)strtol( hex, NULL, 16 );
+			if( m_userCodesStatus[i] != UserCode_Unset )
+			{
+				m_userCodesTime[i] = (uint32)readTime;
+			}
+		}
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -107,6 +130,26 @@ void UserCode::WriteXML
 	CommandClass::WriteXML( _ccElement );
 	snprintf( str, sizeof(str), "%d", m_userCodeCount );
 	_ccElement->SetAttribute( "codes", str);
+
+	// Only the oldest report time is kept, so slots read since then are
+	// read again a little sooner than they need to be
+	string slots;
+	uint32 oldest = 0;
+	for( uint32 i = 1; i <= m_userCodeCount; ++i )
+	{
+		snprintf( str, sizeof(str), "%.2x", m_userCodesStatus[i] );
+		slots += str;
+		if( m_userCodesStatus[i] != UserCode_Unset && ( oldest == 0 || m_userCodesTime[i] < oldest ) )
+		{
+			oldest = m_userCodesTime[i];
+		}
+	}
+	if( oldest != 0 )
+	{
+		_ccElement->SetAttribute( "slots", slots.c_str() );
+		snprintf( str, sizeof(str), "%u", oldest );
+		_ccElement->SetAttribute( "slotsread", str );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -130,9 +173,16 @@ bool UserCode::RequestState
 	{
 		if( m_userCodeCount > 0 )
 		{
-			m_queryAll = true;
-			m_currentCode = 1;
-			requests |= RequestValue( _requestFlags, m_currentCode, _instance, _queue );
+			if( uint8 slot = NextSlotToRead( 0 ) )
+			{
+				m_queryAll = true;
+				m_currentCode = slot;
+				requests |= RequestValue( _requestFlags, m_currentCode, _instance, _queue );
+			}
+			else
+			{
+				Log::Write( LogLevel_Info, GetNodeId(), "Not Requesting UserCode Slots, as all were reported within the last %d seconds", m_cacheAge );
+			}
 		}
 	}
 
@@ -178,15 +228,99 @@ bool UserCode::RequestValue
 		Log::Write( LogLevel_Warning, GetNodeId(), "UserCodeCmd_Get with Index 0 not Supported");
 		return false;
 	}
+	GetDriver()->SendMsg( NewCodeGet( _userCodeIdx, _instance ), _queue );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::NewCodeGet>
+// Create a request for one user code slot
+//-----------------------------------------------------------------------------
+Msg* UserCode::NewCodeGet
+(
+	uint8 const _userCodeIdx,
+	uint8 const _instance
+)
+{
 	Msg* msg = new Msg( "UserCodeCmd_Get", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true, true, FUNC_ID_APPLICATION_COMMAND_HANDLER, GetCommandClassId() );
+	msg->SetInstance( this, _instance );
 	msg->Append( GetNodeId() );
 	msg->Append( 3 );
 	msg->Append( GetCommandClassId() );
 	msg->Append( UserCodeCmd_Get );
 	msg->Append( _userCodeIdx );
 	msg->Append( GetDriver()->GetTransmitOptions() );
-	GetDriver()->SendMsg( msg, _queue );
-	return true;
+	return msg;
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::NewCodeSet>
+// Create a message setting one user code slot
+//-----------------------------------------------------------------------------
+Msg* UserCode::NewCodeSet
+(
+	uint8 const _userCodeIdx,
+	uint8 const _status,
+	uint8 const* _code,
+	uint8 const _length,
+	uint8 const _instance
+)
+{
+	Msg* msg = new Msg( "UserCodeCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
+	msg->SetInstance( this, _instance );
+	msg->Append( GetNodeId() );
+	msg->Append( 4 + _length );
+	msg->Append( GetCommandClassId() );
+	msg->Append( UserCodeCmd_Set );
+	msg->Append( _userCodeIdx );
+	msg->Append( _status );
+	for( uint8 i = 0; i < _length; i++ )
+	{
+		msg->Append( _code[i] );
+	}
+	msg->Append( GetDriver()->GetTransmitOptions() );
+	return msg;
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::IsSlotRecent>
+// Whether a slot was reported within the UserCodeCacheAge option
+//-----------------------------------------------------------------------------
+bool UserCode::IsSlotRecent
+(
+	uint8 const _userCodeIdx
+)const
+{
+	if( m_forceRefresh || m_cacheAge <= 0 || m_userCodesStatus[_userCodeIdx] == UserCode_Unset || m_userCodesTime[_userCodeIdx] == 0 )
+	{
+		return false;
+	}
+	uint32 now = (uint32)time( NULL );
+	return ( now >= m_userCodesTime[_userCodeIdx] ) && ( now - m_userCodesTime[_userCodeIdx] < (uint32)m_cacheAge );
+}
+
+//-----------------------------------------------------------------------------
+// <UserCode::NextSlotToRead>
+// Find the next slot after _after whose state needs to be read
+//-----------------------------------------------------------------------------
+uint8 UserCode::NextSlotToRead
+(
+	uint8 const _after
+)const
+{
+	for( uint32 i = _after + 1; i <= m_userCodeCount; ++i )
+	{
+		if( !IsSlotRecent( (uint8)i ) )
+		{
+			return (uint8)i;
+		}
+		if( !m_refreshUserCodes && m_userCodesStatus[i] == UserCode_Available )
+		{
+			// As if the slot had just been read
+			return 0;
+		}
+	}
+	return 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -260,6 +394,7 @@ bool UserCode::HandleMsg
 			}
 			Log::Write( LogLevel_Info, GetNodeId(), "User Code Packet is %d", size );
 			m_userCodesStatus[i] = _data[2];
+			m_userCodesTime[i] = (uint32)time( NULL );
 			if (size > 0) {
 				memcpy( data, &_data[3], size );
 			} else {
@@ -274,9 +409,9 @@ bool UserCode::HandleMsg
 		{
 
 			if (m_refreshUserCodes || (_data[2] != UserCode_Available)) {
-				if( ++i <= m_userCodeCount )
+				if( uint8 next = NextSlotToRead( (uint8)i ) )
 				{
-					m_currentCode = i;
+					m_currentCode = next;
 					RequestValue( 0, m_currentCode, _instance, Driver::MsgQueue_Query );
 				}
 				else
@@ -284,6 +419,7 @@ bool UserCode::HandleMsg
 					m_queryAll = false;
 					/* we might have reset this as part of the RefreshValues Button Value */
 					Options::Get()->GetOptionAsBool("RefreshAllUserCodes", &m_refreshUserCodes );
+					m_forceRefresh = false;
 				}
 			} else {
 				Log::Write( LogLevel_Info, GetNodeId(), "Not Requesting additional UserCode Slots as RefreshAllUserCodes is false, and slot %d is available", i);
@@ -316,25 +452,14 @@ bool UserCode::SetValue
 			return false;
 		}
 		m_userCodesStatus[value->GetID().GetIndex()] = UserCode_Occupied;
-		Msg* msg = new Msg( "UserCodeCmd_Set", GetNodeId(), REQUEST, FUNC_ID_ZW_SEND_DATA, true );
-		msg->SetInstance( this, _value.GetID().GetInstance() );
-		msg->Append( GetNodeId() );
-		msg->Append( 4 + len );
-		msg->Append( GetCommandClassId() );
-		msg->Append( UserCodeCmd_Set );
-		msg->Append( value->GetID().GetIndex() );
-		msg->Append( UserCode_Occupied );
-		for( uint8 i = 0; i < len; i++ )
-		{
-			msg->Append( s[i] );
-		}
-		msg->Append( GetDriver()->GetTransmitOptions() );
-		GetDriver()->SendMsg( msg, Driver::MsgQueue_Send );
+		m_userCodesTime[value->GetID().GetIndex()] = 0;
+		GetDriver()->SendMsg( NewCodeSet( value->GetID().GetIndex(), UserCode_Occupied, s, len, _value.GetID().GetInstance() ), Driver::MsgQueue_Send );
 		return true;
 	}
 	if ( (ValueID::ValueType_Button == _value.GetID().GetType()) && (_value.GetID().GetIndex() == UserCodeIndex_Refresh) )
 	{
 		m_refreshUserCodes = true;
+		m_forceRefresh = true;
 		m_currentCode = 1;
 		m_queryAll = true;
 		RequestValue( 0, m_currentCode, _value.GetID().GetInstance(), Driver::MsgQueue_Query );
@@ -343,6 +468,96 @@ bool UserCode::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <UserCode::ProvisionCodes>
+// Set the slots whose last reported state is not the one wanted
+//-----------------------------------------------------------------------------
+uint32 UserCode::ProvisionCodes
+(
+	map<uint8,string> const& _codes,
+	bool const _clearOthers
+)
+{
+	// A cleared slot is sent with a code of all zeros
+	static uint8 const c_clearCode[4] = { 0, 0, 0, 0 };
+
+	Node* node = GetNodeUnsafe();
+	if( !node || m_userCodeCount == 0 )
+	{
+		Log::Write( LogLevel_Warning, GetNodeId(), "Cannot provision user codes before the number of slots is known" );
+		return 0;
+	}
+
+	list<Msg*> batch;
+	uint32 skipped = 0;
+	for( uint32 i = 1; i <= m_userCodeCount; ++i )
+	{
+		uint8 slot = (uint8)i;
+		map<uint8,string>::const_iterator it = _codes.find( slot );
+		if( it == _codes.end() && !_clearOthers )
+		{
+			continue;
+		}
+
+		string code = ( it != _codes.end() ) ? it->second : string();
+		if( code.size() > UserCodeLength )
+		{
+			Log::Write( LogLevel_Warning, GetNodeId(), "User Code for slot %d is longer than the maximum of %d", slot, UserCodeLength );
+			continue;
+		}
+
+		uint8 status = m_userCodesStatus[slot];
+		if( code.empty() )
+		{
+			// Known-empty slots, and ones the lock will not let us use,
+			// are left alone
+			if( status == UserCode_Available || status == UserCode_NotAvailable )
+			{
+				++skipped;
+				continue;
+			}
+			batch.push_back( NewCodeSet( slot, UserCode_Available, c_clearCode, sizeof(c_clearCode), 1 ) );
+			m_userCodesStatus[slot] = UserCode_Available;
+		}
+		else
+		{
+			if( status == UserCode_Occupied )
+			{
+				bool same = false;
+				if( ValueRaw* value = static_cast<ValueRaw*>( GetValue( 1, slot ) ) )
+				{
+					same = ( value->GetLength() == code.size() ) && ( memcmp( value->GetValue(), code.c_str(), code.size() ) == 0 );
+					value->Release();
+				}
+				if( same )
+				{
+					++skipped;
+					continue;
+				}
+			}
+			batch.push_back( NewCodeSet( slot, UserCode_Occupied, (uint8 const*)code.c_str(), (uint8)code.size(), 1 ) );
+			m_userCodesStatus[slot] = UserCode_Occupied;
+		}
+
+		// Read the slot back, so the cached state is what the lock accepted
+		m_userCodesTime[slot] = 0;
+		batch.push_back( NewCodeGet( slot, 1 ) );
+	}
+
+	uint32 changed = (uint32)batch.size() / 2;
+	Log::Write( LogLevel_Info, GetNodeId(), "Provisioning %d User Code slots (%d already set)", changed, skipped );
+	if( !batch.empty() )
+	{
+		// Messages for a sleeping lock wait in the wake up queue, so they
+		// are all sent while it is awake
+		uint32 count = (uint32)batch.size();
+		uint32 encapsulated = 0;
+		uint32 frames = GetDriver()->SendBatch( node, batch, Driver::MsgQueue_Send, encapsulated );
+		Log::Write( LogLevel_Detail, GetNodeId(), "Sent %d User Code messages in %d frames", count, frames );
+	}
+	return changed;
+}
+
 //-----------------------------------------------------------------------------
 // <UserCode::CreateVars>
 // Create the values managed by this command class
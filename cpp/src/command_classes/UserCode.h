@@ -28,6 +28,7 @@
 #ifndef _UserCode_H
 #define _UserCode_H
 
+#include <map>
 #include "command_classes/CommandClass.h"
 
 namespace OpenZWave
@@ -62,12 +63,26 @@ namespace OpenZWave
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
 
+		/**
+		 * Bring the user code slots in line with the codes wanted, sending a Set and Get
+		 * only for the slots whose last reported state differs.
+		 * \param _codes the codes wanted, keyed by slot.  An empty code clears the slot.
+		 * \param _clearOthers if true, slots not in _codes that may hold a code are cleared.
+		 * \return the number of slots changed.
+		 */
+		uint32 ProvisionCodes( map<uint8,string> const& _codes, bool const _clearOthers );
+
 	protected:
 		virtual void CreateVars( uint8 const _instance );
 
 	private:
 		UserCode( uint32 const _homeId, uint8 const _nodeId );
 
+		Msg* NewCodeGet( uint8 const _userCodeIdx, uint8 const _instance );
+		Msg* NewCodeSet( uint8 const _userCodeIdx, uint8 const _status, uint8 const* _code, uint8 const _length, uint8 const _instance );
+		bool IsSlotRecent( uint8 const _userCodeIdx )const;
+		uint8 NextSlotToRead( uint8 const _after )const;		// 0 if there are no more slots to read
+
 		string CodeStatus( uint8 const _byte )
 		{
 			switch( _byte )
@@ -103,7 +118,10 @@ namespace OpenZWave
 		uint8		m_currentCode;
 		uint8		m_userCodeCount;
 		uint8		m_userCodesStatus[256];
+		uint32		m_userCodesTime[256];	// When each slot was last reported, in seconds since the epoch
 		bool		m_refreshUserCodes;
+		bool		m_forceRefresh;			// Read every slot, however recently it was reported
+		int32		m_cacheAge;
 	};
 
 } // namespace OpenZWave
@@ -197,6 +197,7 @@ bool Version::HandleMsg
 				applicationValue->OnValueRefreshed( application );
 				applicationValue->Release();
 			}
+			node->ProductVersionReported( application );
 
 			return true;
 		}
@@ -208,6 +209,7 @@ bool Version::HandleMsg
 				Log::Write( LogLevel_Info, GetNodeId(), "Received Command Class Version report from node %d: CommandClass=%s, Version=%d", GetNodeId(), pCommandClass->GetCommandClassName().c_str(), _data[2] );
 				pCommandClass->ClearStaticRequest( StaticRequest_Version );
 				pCommandClass->SetVersion( _data[2] );
+				node->RecordDiscoveryReport( GetCommandClassId(), _data, _length );
 			}
 
 			return true;
@@ -37,6 +37,7 @@
 #include "platform/Log.h"
 #include "platform/Mutex.h"
 #include "value_classes/ValueInt.h"
+#include "tinyxml.h"
 
 using namespace OpenZWave;
 
@@ -64,7 +65,10 @@ WakeUp::WakeUp
 CommandClass( _homeId, _nodeId ),
 m_mutex( new Mutex() ),
 m_awake( true ),
-m_pollRequired( false )
+m_pollRequired( false ),
+m_wakeUpSeen( false ),
+m_learnedInterval( 0 ),
+m_missedWakeUps( 0 )
 {
 	Options::Get()->GetOptionAsBool("AssumeAwake", &m_awake);
 
@@ -95,6 +99,120 @@ WakeUp::~WakeUp
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <WakeUp::ReadXML>
+// Restore the messages and controller commands that were waiting for the
+// device to wake up when the configuration was saved
+//-----------------------------------------------------------------------------
+void WakeUp::ReadXML
+(
+		TiXmlElement const* _ccElement
+)
+{
+	CommandClass::ReadXML( _ccElement );
+
+	TiXmlElement const* pendingElement = _ccElement->FirstChildElement( "Pending" );
+	if( pendingElement == NULL )
+	{
+		return;
+	}
+
+	uint32 count = 0;
+	m_mutex->Lock();
+	for( TiXmlElement const* element = pendingElement->FirstChildElement(); element; element = element->NextSiblingElement() )
+	{
+		char const* str = element->Value();
+		Driver::MsgQueueItem item;
+		if( !strcmp( str, "Msg" ) )
+		{
+			item.m_command = Driver::MsgQueueCmd_SendMsg;
+			item.m_msg = Msg::ReadXML( element, GetHomeId() );
+			if( item.m_msg == NULL )
+			{
+				continue;
+			}
+		}
+		else if( !strcmp( str, "ControllerCommand" ) )
+		{
+			int32 command, node, arg;
+			if( TIXML_SUCCESS != element->QueryIntAttribute( "command", &command )
+				|| TIXML_SUCCESS != element->QueryIntAttribute( "node", &node )
+				|| TIXML_SUCCESS != element->QueryIntAttribute( "arg", &arg ) )
+			{
+				continue;
+			}
+			// The application's callback does not outlive the process that
+			// queued the command, so its progress is only notified
+			item.m_command = Driver::MsgQueueCmd_Controller;
+			item.m_cci = new Driver::ControllerCommandItem();
+			item.m_cci->m_controllerCommand = (Driver::ControllerCommand)command;
+			item.m_cci->m_controllerCommandNode = (uint8)node;
+			item.m_cci->m_controllerCommandArg = (uint8)arg;
+			str = element->Attribute( "high_power" );
+			item.m_cci->m_highPower = ( str && !strcmp( str, "true" ) );
+		}
+		else
+		{
+			continue;
+		}
+		item.m_nodeId = GetNodeId();
+		m_pendingQueue.push_back( item );
+		++count;
+	}
+	m_mutex->Unlock();
+
+	if( count )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "Restored %d commands waiting for the device to wake up", count );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <WakeUp::WriteXML>
+// Save the messages and controller commands waiting for the device to wake
+// up, so they are not lost if the driver restarts before it does
+//-----------------------------------------------------------------------------
+void WakeUp::WriteXML
+(
+		TiXmlElement* _ccElement
+)
+{
+	CommandClass::WriteXML( _ccElement );
+
+	TiXmlElement* pendingElement = NULL;
+	m_mutex->Lock();
+	for( list<Driver::MsgQueueItem>::const_iterator it = m_pendingQueue.begin(); it != m_pendingQueue.end(); ++it )
+	{
+		if( Driver::MsgQueueCmd_QueryStageComplete == it->m_command )
+		{
+			// The interview is started again anyway
+			continue;
+		}
+		if( pendingElement == NULL )
+		{
+			pendingElement = new TiXmlElement( "Pending" );
+			_ccElement->LinkEndChild( pendingElement );
+		}
+
+		if( Driver::MsgQueueCmd_SendMsg == it->m_command )
+		{
+			TiXmlElement* msgElement = new TiXmlElement( "Msg" );
+			pendingElement->LinkEndChild( msgElement );
+			it->m_msg->WriteXML( msgElement );
+		}
+		else
+		{
+			TiXmlElement* commandElement = new TiXmlElement( "ControllerCommand" );
+			pendingElement->LinkEndChild( commandElement );
+			commandElement->SetAttribute( "command", it->m_cci->m_controllerCommand );
+			commandElement->SetAttribute( "node", it->m_cci->m_controllerCommandNode );
+			commandElement->SetAttribute( "arg", it->m_cci->m_controllerCommandArg );
+			commandElement->SetAttribute( "high_power", it->m_cci->m_highPower ? "true" : "false" );
+		}
+	}
+	m_mutex->Unlock();
+}
+
 //-----------------------------------------------------------------------------
 // <WakeUp::Init>
 // Starts the process of requesting node state from a sleeping device
@@ -240,6 +358,7 @@ bool WakeUp::HandleMsg
 	{
 		// The device is awake.
 		Log::Write( LogLevel_Info, GetNodeId(), "Received Wakeup Notification from node %d", GetNodeId() );
+		RecordWakeUp();
 		SetAwake( true );
 		return true;
 	}
@@ -318,6 +437,18 @@ bool WakeUp::SetValue
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <WakeUp::GetSetKeyLength>
+// A later WakeUpCmd_IntervalSet replaces an earlier one
+//-----------------------------------------------------------------------------
+uint8 WakeUp::GetSetKeyLength
+(
+		uint8 const _command
+)const
+{
+	return( ( WakeUpCmd_IntervalSet == _command ) ? 2 : 0 );
+}
+
 //-----------------------------------------------------------------------------
 // <WakeUp::SetVersion>
 // Set the command class version
@@ -342,7 +473,21 @@ void WakeUp::SetAwake
 {
 	if( m_awake != _state )
 	{
+		if( _state )
+		{
+			// While the node is still marked as asleep, a clock set waiting
+			// for it can be replaced by one of the current time
+			if( Node* node = GetNodeUnsafe() )
+			{
+				GetDriver()->RestageTimeSync( node );
+			}
+		}
 		m_awake = _state;
+		if( !m_awake )
+		{
+			// Messages for the node have to be held until it wakes again
+			GetDriver()->InvalidateSendRoute( GetNodeId() );
+		}
 		Log::Write( LogLevel_Info, GetNodeId(), "  Node %d has been marked as %s", GetNodeId(), m_awake ? "awake" : "asleep" );
 		Notification* notification = new Notification( Notification::Type_Notification );
 		notification->SetHomeAndNodeIds( GetHomeId(), GetNodeId() );
@@ -369,6 +514,99 @@ void WakeUp::SetAwake
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <WakeUp::RecordWakeUp>
+// Learn the interval between wake up notifications
+//-----------------------------------------------------------------------------
+void WakeUp::RecordWakeUp
+(
+)
+{
+	if( m_wakeUpSeen )
+	{
+		// Intervals too long for the time stamp to measure come out negative
+		int32 elapsed = -m_lastWakeUp.TimeRemaining();
+		if( elapsed > 0 )
+		{
+			uint32 interval = (uint32)elapsed;
+			if( m_learnedInterval == 0 || m_missedWakeUps >= 2 )
+			{
+				// First interval, or the device's interval has been changed
+				m_learnedInterval = interval;
+				m_missedWakeUps = 0;
+			}
+			else if( interval > m_learnedInterval / 2 && interval < m_learnedInterval + m_learnedInterval / 2 )
+			{
+				// Average out the drift of the device's clock
+				m_learnedInterval = (uint32)( ( (uint64)m_learnedInterval * 3 + interval ) / 4 );
+				m_missedWakeUps = 0;
+			}
+			else
+			{
+				// A wake up that was missed, or one the user triggered
+				++m_missedWakeUps;
+			}
+			Log::Write( LogLevel_Detail, GetNodeId(), "  Woke up after %d seconds, interval is learned as %d seconds", interval / 1000, m_learnedInterval / 1000 );
+		}
+	}
+	m_lastWakeUp.SetTime();
+	m_wakeUpSeen = true;
+}
+
+//-----------------------------------------------------------------------------
+// <WakeUp::GetPendingMemoryUsage>
+// Bytes used by the pending queue
+//-----------------------------------------------------------------------------
+uint32 WakeUp::GetPendingMemoryUsage
+(
+)
+{
+	uint32 bytes = 0;
+	m_mutex->Lock();
+	for( list<Driver::MsgQueueItem>::const_iterator it = m_pendingQueue.begin(); it != m_pendingQueue.end(); ++it )
+	{
+		bytes += Driver::GetMemoryUsage( *it );
+	}
+	m_mutex->Unlock();
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// <WakeUp::GetNextWakeUp>
+// Predict when the device will next wake up
+//-----------------------------------------------------------------------------
+int32 WakeUp::GetNextWakeUp
+(
+)
+{
+	if( !m_wakeUpSeen )
+	{
+		return -1;
+	}
+
+	// Until two wake ups have been seen, go by the configured interval
+	int64 interval = m_learnedInterval;
+	if( interval == 0 )
+	{
+		if( ValueInt* value = static_cast<ValueInt*>( GetValue( 1, 0 ) ) )
+		{
+			interval = (int64)value->GetValue() * 1000;
+			value->Release();
+		}
+	}
+	if( interval <= 0 )
+	{
+		return -1;
+	}
+
+	int64 next = interval + m_lastWakeUp.TimeRemaining();
+	if( next < 0 )
+	{
+		return 0;
+	}
+	return( next > 0x7fffffff ? 0x7fffffff : (int32)next );
+}
+
 //-----------------------------------------------------------------------------
 // <WakeUp::QueueMsg>
 // Add a Z-Wave message to the queue
@@ -402,6 +640,13 @@ void WakeUp::QueueMsg
 			}
 			m_pendingQueue.erase( it++ );
 		}
+		else if( Supersedes( _item, item ) )
+		{
+			// A later command that sets the same thing makes this one pointless
+			OZW_LOG( LogLevel_Detail, GetNodeId(), "Dropping superseded %s from the wake up queue", item.m_msg->GetLogText().c_str() );
+			delete item.m_msg;
+			m_pendingQueue.erase( it++ );
+		}
 		else
 		{
 			++it;
@@ -413,6 +658,48 @@ void WakeUp::QueueMsg
 
 	m_pendingQueue.push_back( _item );
 	m_mutex->Unlock();
+
+	if( Driver::MsgQueueCmd_QueryStageComplete != _item.m_command )
+	{
+		// The queue is saved with the node
+		GetDriver()->SetConfigDirty( GetNodeId() );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <WakeUp::Supersedes>
+// Whether a newly queued command makes a queued one pointless, because it
+// sets the same thing, such as the same configuration parameter
+//-----------------------------------------------------------------------------
+bool WakeUp::Supersedes
+(
+		Driver::MsgQueueItem const& _newItem,
+		Driver::MsgQueueItem const& _oldItem
+)const
+{
+	if( ( Driver::MsgQueueCmd_SendMsg != _newItem.m_command ) || ( Driver::MsgQueueCmd_SendMsg != _oldItem.m_command ) )
+	{
+		return false;
+	}
+
+	uint8 newLength = 0;
+	uint8 oldLength = 0;
+	uint8 const* newPayload = _newItem.m_msg->GetSendDataPayload( newLength );
+	uint8 const* oldPayload = _oldItem.m_msg->GetSendDataPayload( oldLength );
+	if( ( newPayload == NULL ) || ( oldPayload == NULL ) || ( newLength < 2 ) )
+	{
+		return false;
+	}
+
+	Node* node = GetNodeUnsafe();
+	CommandClass* cc = node ? node->GetCommandClass( newPayload[0] ) : NULL;
+	if( cc == NULL )
+	{
+		return false;
+	}
+
+	uint8 keyLength = cc->GetSetKeyLength( newPayload[1] );
+	return( ( keyLength != 0 ) && ( newLength >= keyLength ) && ( oldLength >= keyLength ) && !memcmp( newPayload, oldPayload, keyLength ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -426,15 +713,36 @@ void WakeUp::SendPending
 	m_awake = true;
 
 	m_mutex->Lock();
+	if( !m_pendingQueue.empty() )
+	{
+		GetDriver()->SetConfigDirty( GetNodeId() );
+	}
+
+	// Runs of messages are sent as a batch, so that if the node supports
+	// MultiCmd they go in as few frames as possible, and the node can go
+	// back to sleep sooner.  Other items keep their place between the runs.
+	Node* node = GetNodeUnsafe();
+	list<Msg*> batch;
+	uint32 count = 0;
+	uint32 frames = 0;
 	list<Driver::MsgQueueItem>::iterator it = m_pendingQueue.begin();
 	while( it != m_pendingQueue.end() )
 	{
 		Driver::MsgQueueItem const& item = *it;
 		if( Driver::MsgQueueCmd_SendMsg == item.m_command )
 		{
-			GetDriver()->SendMsg( item.m_msg, Driver::MsgQueue_WakeUp );
+			batch.push_back( item.m_msg );
+			it = m_pendingQueue.erase( it );
+			continue;
+		}
+
+		if( !batch.empty() )
+		{
+			count += (uint32)batch.size();
+			frames += SendBatch( node, batch );
 		}
-		else if( Driver::MsgQueueCmd_QueryStageComplete == item.m_command )
+
+		if( Driver::MsgQueueCmd_QueryStageComplete == item.m_command )
 		{
 			GetDriver()->SendQueryStageComplete( item.m_nodeId, item.m_queryStage );
 		} else if( Driver::MsgQueueCmd_Controller == item.m_command )
@@ -444,11 +752,20 @@ void WakeUp::SendPending
 		}
 		it = m_pendingQueue.erase( it );
 	}
+	if( !batch.empty() )
+	{
+		count += (uint32)batch.size();
+		frames += SendBatch( node, batch );
+	}
 	m_mutex->Unlock();
 
+	if( count > frames )
+	{
+		Log::Write( LogLevel_Info, GetNodeId(), "  Sent %d queued messages in %d frames", count, frames );
+	}
+
 	// Send the device back to sleep, unless we have outstanding queries.
 	bool sendToSleep = m_awake;
-	Node* node = GetNodeUnsafe();
 	if( node != NULL )
 	{
 
@@ -470,6 +787,33 @@ void WakeUp::SendPending
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <WakeUp::SendBatch>
+// Send a run of queued messages, packed together if the node allows it.
+// Returns the number of frames.
+//-----------------------------------------------------------------------------
+uint32 WakeUp::SendBatch
+(
+		Node* _node,
+		list<Msg*>& _batch
+)
+{
+	if( _node != NULL )
+	{
+		uint32 encapsulated = 0;
+		return GetDriver()->SendBatch( _node, _batch, Driver::MsgQueue_WakeUp, encapsulated );
+	}
+
+	uint32 frames = 0;
+	for( list<Msg*>::iterator it = _batch.begin(); it != _batch.end(); ++it )
+	{
+		GetDriver()->SendMsg( *it, Driver::MsgQueue_WakeUp );
+		++frames;
+	}
+	_batch.clear();
+	return frames;
+}
+
 //-----------------------------------------------------------------------------
 // <WakeUp::CreateVars>
 // Create the values managed by this command class
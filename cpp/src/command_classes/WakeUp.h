@@ -31,6 +31,7 @@
 #include <list>
 #include "command_classes/CommandClass.h"
 #include "Driver.h"
+#include "platform/TimeStamp.h"
 
 namespace OpenZWave
 {
@@ -56,13 +57,28 @@ namespace OpenZWave
 		void SetAwake( bool _state );
 		void SetPollRequired(){ m_pollRequired = true; }
 
+		/**
+		 * Predict when the device will next wake up, from the times it has woken before.
+		 * \return milliseconds until the predicted wake up, zero if it is overdue, or -1
+		 * if the device has not been seen to wake up since the driver started.
+		 */
+		int32 GetNextWakeUp();
+
+		/**
+		 * \return the bytes used by the messages waiting for the device to wake up.
+		 */
+		uint32 GetPendingMemoryUsage();
+
 		// From CommandClass
+		virtual void ReadXML( TiXmlElement const* _ccElement );
+		virtual void WriteXML( TiXmlElement* _ccElement );
 		virtual bool RequestState( uint32 const _requestFlags, uint8 const _instance, Driver::MsgQueue const _queue );
 		virtual bool RequestValue( uint32 const _requestFlags, uint8 const _index, uint8 const _instance, Driver::MsgQueue const _queue );
 		virtual uint8 const GetCommandClassId()const{ return StaticGetCommandClassId(); }
 		virtual string const GetCommandClassName()const{ return StaticGetCommandClassName(); }
 		virtual bool HandleMsg( uint8 const* _data, uint32 const _length, uint32 const _instance = 1 );
 		virtual bool SetValue( Value const& _value );
+		virtual uint8 GetSetKeyLength( uint8 const _command )const;
 		virtual void SetVersion( uint8 const _version );
 
 		virtual uint8 GetMaxVersion(){ return 2; }
@@ -73,10 +89,19 @@ namespace OpenZWave
 	private:
 		WakeUp( uint32 const _homeId, uint8 const _nodeId );
 
+		bool Supersedes( Driver::MsgQueueItem const& _newItem, Driver::MsgQueueItem const& _oldItem )const;	// True if the new item sets what the old one did
+		uint32 SendBatch( Node* _node, list<Msg*>& _batch );			// Send a run of queued messages, MultiCmd encapsulated where possible
+		void RecordWakeUp();											// Learn the interval between wake up notifications
+
 		Mutex*						m_mutex;			// Serialize access to the pending queue
 		list<Driver::MsgQueueItem>	m_pendingQueue;		// Messages waiting to be sent when the device wakes up
 		bool						m_awake;
 		bool						m_pollRequired;
+
+		TimeStamp					m_lastWakeUp;		// When the last wake up notification arrived
+		bool						m_wakeUpSeen;		// m_lastWakeUp has been set
+		uint32						m_learnedInterval;	// Average time between wake ups, in milliseconds, or 0 until one has been seen
+		uint32						m_missedWakeUps;	// Intervals in a row that did not fit m_learnedInterval
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,713 @@
+//-----------------------------------------------------------------------------
+//
+//	AsyncLog.cpp
+//
+//	A log that writes to its file on a background thread
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include <time.h>
+#include "Defs.h"
+#include "platform/AsyncLog.h"
+#include "platform/Atomic.h"
+#include "platform/Event.h"
+#include "platform/Thread.h"
+
+#if defined WIN32 || defined WINRT
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
+
+using namespace OpenZWave;
+
+static uint32 const c_outputBufferSize = 64 * 1024;	// Lines are gathered into buffers this big before each fwrite
+static uint32 const c_maxQueuedEntries = 500;		// Same limit as the platform LogImpl
+
+//-----------------------------------------------------------------------------
+//	<EscapeCode>
+//	Console colour for each log level
+//-----------------------------------------------------------------------------
+static uint32 EscapeCode
+(
+	uint8 const _level
+)
+{
+	switch( _level )
+	{
+		case LogLevel_Debug:	return 34;	// blue
+		case LogLevel_Detail:	return 34;	// blue
+		case LogLevel_Info:		return 39;	// white
+		case LogLevel_Alert:	return 33;	// orange
+		case LogLevel_Warning:	return 33;	// orange
+		case LogLevel_Error:	return 31;	// red
+		case LogLevel_Fatal:	return 95;	// magenta
+		case LogLevel_Always:	return 32;	// green
+		default:				return 39;	// white (reset to default)
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::AsyncLog>
+//	Constructor
+//-----------------------------------------------------------------------------
+AsyncLog::AsyncLog
+(
+	string const& _filename,
+	bool const _bAppend,
+	bool const _bConsoleOutput,
+	LogLevel const _saveLevel,
+	LogLevel const _queueLevel,
+	LogLevel const _dumpTrigger,
+	uint32 const _capacity,		// = 1024
+	uint32 const _maxFileSize,	// = 0
+	uint32 const _maxFiles		// = 1
+):
+	m_pushPos( 0 ),
+	m_popPos( 0 ),
+	m_dropped( 0 ),
+	m_droppedReported( 0 ),
+	m_logQueueBytes( 0 ),
+	m_saveLevel( _saveLevel ),
+	m_queueLevel( _queueLevel ),
+	m_dumpTrigger( _dumpTrigger ),
+	m_bConsoleOutput( _bConsoleOutput ),
+	m_filename( _filename ),
+	m_file( NULL ),
+	m_fileSize( 0 ),
+	m_maxFileSize( _maxFileSize ),
+	m_maxFiles( _maxFiles ),
+	m_fileBuffer( new char[c_outputBufferSize] ),
+	m_fileBufferLength( 0 ),
+	m_consoleBuffer( new char[c_outputBufferSize] ),
+	m_consoleBufferLength( 0 ),
+	m_thread( new Thread( "AsyncLog" ) ),
+	m_dataEvent( new Event() ),
+	m_spaceEvent( new Event() )
+{
+	uint32 capacity = 2;
+	while( capacity < _capacity )
+	{
+		capacity <<= 1;
+	}
+	m_mask = capacity - 1;
+
+	m_records = new Record[capacity];
+	for( uint32 i=0; i<capacity; ++i )
+	{
+		m_records[i].m_sequence = i;
+	}
+
+	Open( _bAppend );
+	m_thread->Start( AsyncLog::WriterThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::~AsyncLog>
+//	Destructor
+//-----------------------------------------------------------------------------
+AsyncLog::~AsyncLog
+(
+)
+{
+	m_thread->Stop();
+	m_thread->Release();
+
+	// Anything pushed while the thread was stopping
+	Drain();
+
+	if( m_file )
+	{
+		fclose( m_file );
+	}
+
+	m_spaceEvent->Release();
+	m_dataEvent->Release();
+	delete [] m_consoleBuffer;
+	delete [] m_fileBuffer;
+	delete [] m_records;
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Write>
+//	Format an entry into the ring.  Never waits: if the ring is full, the
+//	entry is dropped.
+//-----------------------------------------------------------------------------
+void AsyncLog::Write
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args
+)
+{
+	if( ( _level > m_queueLevel ) && ( _level > m_dumpTrigger ) && ( _level != LogLevel_Internal ) )
+	{
+		// Nothing would be done with this entry
+		return;
+	}
+
+	Record* record = Claim();
+	if( record == NULL )
+	{
+		AtomicIncrement( &m_dropped );
+		return;
+	}
+
+	Stamp( record );
+	record->m_level = (uint8)_level;
+	record->m_nodeId = _nodeId;
+	record->m_kind = Kind_Entry;
+	record->m_text[0] = 0;
+	if( _format != NULL && _format[0] != '\0' )
+	{
+		vsnprintf( record->m_text, sizeof(record->m_text), _format, _args );
+	}
+	Publish( record );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::QueueDump>
+//	Ask the writer to write out the kept entries
+//-----------------------------------------------------------------------------
+void AsyncLog::QueueDump
+(
+)
+{
+	PushControl( Kind_QueueDump, NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::QueueClear>
+//	Ask the writer to discard the kept entries
+//-----------------------------------------------------------------------------
+void AsyncLog::QueueClear
+(
+)
+{
+	PushControl( Kind_QueueClear, NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::SetLoggingState>
+//	Change the levels.  Entries already in the ring use the new levels.
+//-----------------------------------------------------------------------------
+void AsyncLog::SetLoggingState
+(
+	LogLevel _saveLevel,
+	LogLevel _queueLevel,
+	LogLevel _dumpTrigger
+)
+{
+	m_saveLevel = _saveLevel;
+	m_queueLevel = _queueLevel;
+	m_dumpTrigger = _dumpTrigger;
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::SetLogFileName>
+//	Ask the writer to carry on in another file
+//-----------------------------------------------------------------------------
+void AsyncLog::SetLogFileName
+(
+	const string &_filename
+)
+{
+	PushControl( Kind_SetFileName, _filename.c_str() );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::GetDroppedCount>
+//	Number of entries lost because the ring was full
+//-----------------------------------------------------------------------------
+uint32 AsyncLog::GetDroppedCount
+(
+)const
+{
+	return AtomicLoad( &m_dropped );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Claim>
+//	Reserve the next free record.  Each record's sequence number says which
+//	push position it is ready for, so writers only have to agree on m_pushPos.
+//-----------------------------------------------------------------------------
+AsyncLog::Record* AsyncLog::Claim
+(
+)
+{
+	uint32 pos = AtomicLoad( &m_pushPos );
+	while( 1 )
+	{
+		Record* record = &m_records[pos & m_mask];
+		int32 diff = (int32)( AtomicLoad( &record->m_sequence ) - pos );
+		if( diff == 0 )
+		{
+			if( AtomicCompareExchange( &m_pushPos, pos, pos + 1 ) )
+			{
+				return record;
+			}
+		}
+		else if( diff < 0 )
+		{
+			// The writer has not emptied this record yet
+			return NULL;
+		}
+		pos = AtomicLoad( &m_pushPos );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Publish>
+//	Hand a filled record to the writer
+//-----------------------------------------------------------------------------
+void AsyncLog::Publish
+(
+	Record* _record
+)
+{
+	// The record was claimed at the position its sequence number held
+	AtomicStore( &_record->m_sequence, _record->m_sequence + 1 );
+	m_dataEvent->Set();
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Stamp>
+//	Set a record's time to now
+//-----------------------------------------------------------------------------
+void AsyncLog::Stamp
+(
+	Record* _record
+)
+{
+#if defined WIN32 || defined WINRT
+	struct _timeb now;
+	_ftime_s( &now );
+	_record->m_seconds = (uint32)now.time;
+	_record->m_milliseconds = (uint16)now.millitm;
+#else
+	struct timeval now;
+	gettimeofday( &now, NULL );
+	_record->m_seconds = (uint32)now.tv_sec;
+	_record->m_milliseconds = (uint16)( now.tv_usec / 1000 );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::PushControl>
+//	Queue a request for the writer.  Unlike entries, these are never dropped,
+//	so wait for room if the ring is full.
+//-----------------------------------------------------------------------------
+void AsyncLog::PushControl
+(
+	Kind const _kind,
+	char const* _text
+)
+{
+	Record* record = Claim();
+	while( record == NULL )
+	{
+		m_spaceEvent->Reset();
+		record = Claim();
+		if( record == NULL )
+		{
+			Wait::Single( m_spaceEvent, 1000 );
+			record = Claim();
+		}
+	}
+
+	Stamp( record );
+	record->m_level = LogLevel_Always;
+	record->m_nodeId = 0;
+	record->m_kind = (uint8)_kind;
+	record->m_text[0] = 0;
+	if( _text )
+	{
+		strncpy( record->m_text, _text, sizeof(record->m_text) - 1 );
+		record->m_text[sizeof(record->m_text) - 1] = 0;
+	}
+	Publish( record );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Drain>
+//	Write everything that is in the ring, with one fwrite per output
+//-----------------------------------------------------------------------------
+uint32 AsyncLog::Drain
+(
+)
+{
+	uint32 count = 0;
+	while( 1 )
+	{
+		Record* record = &m_records[m_popPos & m_mask];
+		if( (int32)( AtomicLoad( &record->m_sequence ) - ( m_popPos + 1 ) ) < 0 )
+		{
+			break;
+		}
+
+		Process( *record );
+		AtomicStore( &record->m_sequence, m_popPos + m_mask + 1 );
+		++m_popPos;
+		++count;
+	}
+
+	uint32 dropped = AtomicLoad( &m_dropped );
+	if( dropped != m_droppedReported )
+	{
+		Record note;
+		Stamp( &note );
+		note.m_level = LogLevel_Warning;
+		note.m_nodeId = 0;
+		note.m_kind = Kind_Entry;
+		snprintf( note.m_text, sizeof(note.m_text), "The log could not keep up, and dropped %u entries", dropped - m_droppedReported );
+		m_droppedReported = dropped;
+		Process( note );
+	}
+
+	if( count )
+	{
+		m_spaceEvent->Set();
+	}
+	Flush();
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Process>
+//	Handle one record on the writer thread
+//-----------------------------------------------------------------------------
+void AsyncLog::Process
+(
+	Record const& _record
+)
+{
+	switch( _record.m_kind )
+	{
+		case Kind_Entry:
+		{
+			break;
+		}
+		case Kind_QueueDump:
+		{
+			DumpQueue();
+			return;
+		}
+		case Kind_QueueClear:
+		{
+			m_logQueue.clear();
+			m_logQueueBytes = 0;
+			return;
+		}
+		case Kind_SetFileName:
+		{
+			Flush();
+			if( m_file )
+			{
+				fclose( m_file );
+				m_file = NULL;
+			}
+			m_filename = _record.m_text;
+			Open( true );
+			return;
+		}
+	}
+
+	char line[c_maxLineLength + 64];
+	uint32 length = Format( _record, line, sizeof(line) );
+
+	if( ( _record.m_level <= m_saveLevel ) || ( _record.m_level == LogLevel_Internal ) )
+	{
+		WriteLine( _record.m_level, line, length );
+	}
+
+	if( _record.m_level != LogLevel_Internal )
+	{
+		if( _record.m_level <= m_queueLevel )
+		{
+			m_logQueue.push_back( string( line, length ) );
+			m_logQueueBytes += length;
+			if( m_logQueue.size() > c_maxQueuedEntries )
+			{
+				m_logQueueBytes -= (uint32)m_logQueue.front().size();
+				m_logQueue.pop_front();
+			}
+		}
+
+		if( ( _record.m_level <= m_dumpTrigger ) && ( _record.m_level != LogLevel_Always ) )
+		{
+			DumpQueue();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Format>
+//	Build the line for an entry, in the same layout as the platform LogImpl
+//-----------------------------------------------------------------------------
+uint32 AsyncLog::Format
+(
+	Record const& _record,
+	char* o_buffer,
+	uint32 const _size
+)
+{
+	if( _record.m_level == LogLevel_Internal )
+	{
+		// Already has its time stamp
+		int length = snprintf( o_buffer, _size, "%s\n", _record.m_text );
+		return ( length < 0 || (uint32)length >= _size ) ? _size - 1 : (uint32)length;
+	}
+
+	time_t seconds = (time_t)_record.m_seconds;
+	struct tm tm;
+#if defined WIN32 || defined WINRT
+	localtime_s( &tm, &seconds );
+#else
+	localtime_r( &seconds, &tm );
+#endif
+
+	char node[16] = "";
+	if( _record.m_nodeId == 255 )
+	{
+		snprintf( node, sizeof(node), "contrlr, " );
+	}
+	else if( _record.m_nodeId != 0 )
+	{
+		snprintf( node, sizeof(node), "Node%03d, ", _record.m_nodeId );
+	}
+
+	char const* level = ( _record.m_level >= LogLevel_None && _record.m_level <= LogLevel_Internal ) ? LogLevelString[_record.m_level] : "Unknown";
+
+	int length = snprintf( o_buffer, _size, "%04d-%02d-%02d %02d:%02d:%02d.%03d %s, %s%s\n",
+			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+			tm.tm_hour, tm.tm_min, tm.tm_sec, (int)_record.m_milliseconds,
+			level, node, _record.m_text );
+	if( length < 0 || (uint32)length >= _size )
+	{
+		// Truncated, but keep the line ending
+		o_buffer[_size - 2] = '\n';
+		return _size - 1;
+	}
+	return (uint32)length;
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::WriteLine>
+//	Add a line to the file and console buffers
+//-----------------------------------------------------------------------------
+void AsyncLog::WriteLine
+(
+	uint8 const _level,
+	char const* _line,
+	uint32 const _length
+)
+{
+	if( m_file )
+	{
+		if( m_fileBufferLength + _length > c_outputBufferSize )
+		{
+			Flush();
+		}
+		memcpy( &m_fileBuffer[m_fileBufferLength], _line, _length );
+		m_fileBufferLength += _length;
+	}
+
+	if( m_bConsoleOutput )
+	{
+		if( m_consoleBufferLength + _length + 16 > c_outputBufferSize )
+		{
+			Flush();
+		}
+		m_consoleBufferLength += snprintf( &m_consoleBuffer[m_consoleBufferLength], 8, "\x1B[%02um", EscapeCode( _level ) );
+		memcpy( &m_consoleBuffer[m_consoleBufferLength], _line, _length );
+		m_consoleBufferLength += _length;
+		memcpy( &m_consoleBuffer[m_consoleBufferLength], "\x1b[39m", 5 );
+		m_consoleBufferLength += 5;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Flush>
+//	Write out the buffered lines, and rotate the file if it has grown too big
+//-----------------------------------------------------------------------------
+void AsyncLog::Flush
+(
+)
+{
+	if( m_fileBufferLength )
+	{
+		if( m_file )
+		{
+			fwrite( m_fileBuffer, 1, m_fileBufferLength, m_file );
+			fflush( m_file );
+			m_fileSize += m_fileBufferLength;
+		}
+		m_fileBufferLength = 0;
+
+		if( m_maxFileSize && ( m_fileSize >= m_maxFileSize ) )
+		{
+			Rotate();
+		}
+	}
+
+	if( m_consoleBufferLength )
+	{
+		fwrite( m_consoleBuffer, 1, m_consoleBufferLength, stdout );
+		fflush( stdout );
+		m_consoleBufferLength = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::DumpQueue>
+//	Write out the kept entries
+//-----------------------------------------------------------------------------
+void AsyncLog::DumpQueue
+(
+)
+{
+	static char const c_start[] = "\nDumping queued log messages\n\n";
+	static char const c_end[] = "\nEnd of queued log message dump\n\n";
+
+	WriteLine( LogLevel_Always, c_start, sizeof(c_start) - 1 );
+	for( list<string>::iterator it = m_logQueue.begin(); it != m_logQueue.end(); ++it )
+	{
+		WriteLine( LogLevel_Internal, it->c_str(), (uint32)it->size() );
+	}
+	m_logQueue.clear();
+	m_logQueueBytes = 0;
+	WriteLine( LogLevel_Always, c_end, sizeof(c_end) - 1 );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Open>
+//	Open the log file
+//-----------------------------------------------------------------------------
+void AsyncLog::Open
+(
+	bool const _bAppend
+)
+{
+	m_fileSize = 0;
+	if( m_filename.empty() )
+	{
+		return;
+	}
+
+	m_file = fopen( m_filename.c_str(), _bAppend ? "a" : "w" );
+	if( m_file == NULL )
+	{
+		fprintf( stderr, "Could Not Open OZW Log File.\n" );
+		return;
+	}
+
+	if( _bAppend && fseek( m_file, 0, SEEK_END ) == 0 )
+	{
+		long size = ftell( m_file );
+		m_fileSize = ( size > 0 ) ? (uint32)size : 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::Rotate>
+//	Move the full file aside, shifting the older ones along, and start a new one
+//-----------------------------------------------------------------------------
+void AsyncLog::Rotate
+(
+)
+{
+	if( m_file )
+	{
+		fclose( m_file );
+		m_file = NULL;
+	}
+
+	if( m_maxFiles )
+	{
+		char from[16];
+		char to[16];
+		snprintf( to, sizeof(to), ".%u", m_maxFiles );
+		remove( ( m_filename + to ).c_str() );
+		for( uint32 i=m_maxFiles-1; i>0; --i )
+		{
+			snprintf( from, sizeof(from), ".%u", i );
+			snprintf( to, sizeof(to), ".%u", i+1 );
+			rename( ( m_filename + from ).c_str(), ( m_filename + to ).c_str() );
+		}
+		rename( m_filename.c_str(), ( m_filename + ".1" ).c_str() );
+	}
+
+	Open( false );
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::WriterThreadEntryPoint>
+//	Entry point of the writer thread
+//-----------------------------------------------------------------------------
+void AsyncLog::WriterThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	AsyncLog* log = (AsyncLog*)_context;
+	if( log )
+	{
+		log->WriterThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<AsyncLog::WriterThreadProc>
+//	Write out records as they are pushed
+//-----------------------------------------------------------------------------
+void AsyncLog::WriterThreadProc
+(
+	Event* _exitEvent
+)
+{
+	Wait* waitObjects[2];
+	waitObjects[0] = _exitEvent;
+	waitObjects[1] = m_dataEvent;
+
+	while( 1 )
+	{
+		if( Drain() )
+		{
+			continue;
+		}
+
+		// Only sleep once the reset is certain not to have hidden a push
+		m_dataEvent->Reset();
+		if( Drain() )
+		{
+			continue;
+		}
+
+		if( Wait::Multiple( waitObjects, 2 ) == 0 )
+		{
+			// Exit has been signalled
+			Drain();
+			return;
+		}
+	}
+}
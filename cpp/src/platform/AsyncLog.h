@@ -0,0 +1,165 @@
+//-----------------------------------------------------------------------------
+//
+//	AsyncLog.h
+//
+//	A log that writes to its file on a background thread
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _AsyncLog_H
+#define _AsyncLog_H
+
+#include <stdio.h>
+#include <list>
+#include <string>
+#include "Defs.h"
+#include "platform/Log.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Thread;
+
+	/** \brief A log implementation that never does file or console I/O on the calling thread.
+	 *
+	 * Each entry is formatted into a preallocated, fixed size record, in a ring that any
+	 * number of threads may write to without taking a lock.  A writer thread takes all the
+	 * records that are waiting each time it wakes, and writes them with a single fwrite.
+	 * If the ring is full, the entry is dropped and counted, rather than holding up the
+	 * caller, and the writer notes in the log how many entries were lost.
+	 *
+	 * The file can be rotated once it reaches a given size: "name" is renamed to "name.1",
+	 * "name.1" to "name.2" and so on, and a new "name" is started.
+	 *
+	 * Install it with Log::SetLoggingClass.  The log does not take ownership, so delete the
+	 * AsyncLog after Log::Destroy.
+	 */
+	class OPENZWAVE_EXPORT AsyncLog : public i_LogImpl
+	{
+	public:
+		/**
+		 * Constructor.  Opens the file and starts the writer thread.
+		 * \param _filename the log file.  If empty, entries only go to the console.
+		 * \param _bAppend if true, add to any existing file rather than replacing it.
+		 * \param _bConsoleOutput if true, also write entries to stdout.
+		 * \param _saveLevel level of entries to write.
+		 * \param _queueLevel level of entries to keep, to be written if a _dumpTrigger entry is seen.
+		 * \param _dumpTrigger level of entry that writes out the kept entries.
+		 * \param _capacity number of records in the ring.  Rounded up to a power of two.
+		 * \param _maxFileSize size in bytes at which the file is rotated, or zero never to rotate.
+		 * \param _maxFiles number of rotated files to keep, besides the current one.
+		 */
+		AsyncLog( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel const _saveLevel, LogLevel const _queueLevel, LogLevel const _dumpTrigger, uint32 const _capacity = 1024, uint32 const _maxFileSize = 0, uint32 const _maxFiles = 1 );
+
+		/**
+		 * Destructor.  Writes out anything still in the ring, then stops the writer thread.
+		 */
+		virtual ~AsyncLog();
+
+		// From i_LogImpl
+		virtual void Write( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args );
+		virtual void QueueDump();
+		virtual void QueueClear();
+		virtual void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
+		virtual void SetLogFileName( const string &_filename );
+		virtual uint32 GetQueueMemoryUsage(){ return m_logQueueBytes; }
+
+		/**
+		 * \return the number of entries dropped because the ring was full.
+		 */
+		uint32 GetDroppedCount()const;
+
+	private:
+		enum Kind
+		{
+			Kind_Entry = 0,
+			Kind_QueueDump,
+			Kind_QueueClear,
+			Kind_SetFileName			/**< The new name is in m_text */
+		};
+
+		enum
+		{
+			c_maxLineLength = 1024		/**< Matches the line buffer of the platform LogImpl */
+		};
+
+		struct Record
+		{
+			volatile uint32	m_sequence;			// Position of the push that may fill this record next
+			uint32			m_seconds;
+			uint16			m_milliseconds;
+			uint8			m_level;
+			uint8			m_nodeId;
+			uint8			m_kind;
+			char			m_text[c_maxLineLength];
+		};
+
+		Record* Claim();							// Reserve the next free record, or NULL if the ring is full
+		void Publish( Record* _record );			// Hand a filled record to the writer
+		static void Stamp( Record* _record );		// Set the record's time to now
+		void PushControl( Kind const _kind, char const* _text );
+		uint32 Drain();								// Write everything in the ring, returning the number of records taken
+
+		void Process( Record const& _record );
+		uint32 Format( Record const& _record, char* o_buffer, uint32 const _size );
+		void WriteLine( uint8 const _level, char const* _line, uint32 const _length );	// Add a line to the buffered output
+		void Flush();
+		void DumpQueue();
+		void Open( bool const _bAppend );
+		void Rotate();
+
+		static void WriterThreadEntryPoint( Event* _exitEvent, void* _context );
+		void WriterThreadProc( Event* _exitEvent );
+
+		Record*				m_records;
+		uint32				m_mask;				// Capacity - 1
+		volatile uint32		m_pushPos;			// Position of the next push
+		uint32				m_popPos;			// Position of the next pop, only used by the writer thread
+		volatile uint32		m_dropped;
+		uint32				m_droppedReported;	// How many drops the writer has already noted in the log
+		volatile uint32		m_logQueueBytes;	// Text held in m_logQueue, kept up to date by the writer thread
+
+		volatile LogLevel	m_saveLevel;
+		volatile LogLevel	m_queueLevel;
+		volatile LogLevel	m_dumpTrigger;
+		bool				m_bConsoleOutput;
+
+		// Only used by the writer thread
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		string				m_filename;
+		list<string>		m_logQueue;			// Kept entries, waiting for a dump trigger
+OPENZWAVE_EXPORT_WARNINGS_ON
+		FILE*				m_file;
+		uint32				m_fileSize;
+		uint32				m_maxFileSize;
+		uint32				m_maxFiles;
+		char*				m_fileBuffer;
+		uint32				m_fileBufferLength;
+		char*				m_consoleBuffer;
+		uint32				m_consoleBufferLength;
+
+		Thread*				m_thread;
+		Event*				m_dataEvent;		// Signalled when records have been pushed
+		Event*				m_spaceEvent;		// Signalled when the writer has emptied some records
+	};
+
+} // namespace OpenZWave
+
+#endif //_AsyncLog_H
@@ -0,0 +1,234 @@
+//-----------------------------------------------------------------------------
+//
+//	Atomic.h
+//
+//	Cross-platform atomic operations on 32 bit integers
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _Atomic_H
+#define _Atomic_H
+
+#include "Defs.h"
+
+#if defined _MSC_VER
+#include <intrin.h>
+#pragma intrinsic(_InterlockedExchangeAdd, _InterlockedCompareExchange, _InterlockedCompareExchange64, _ReadWriteBarrier)
+
+// x86 and x64 keep loads in order with later accesses, and stores in order with
+// earlier ones, so a compiler barrier gives acquire and release.  ARM reorders
+// them, and with the default /volatile:iso a volatile access has no fence, so
+// one is added.
+#if defined _M_ARM64
+#define OZW_ATOMIC_FENCE() __dmb( _ARM64_BARRIER_ISH )
+#elif defined _M_ARM
+#define OZW_ATOMIC_FENCE() __dmb( _ARM_BARRIER_ISH )
+#else
+#define OZW_ATOMIC_FENCE() _ReadWriteBarrier()
+#endif
+#endif
+
+namespace OpenZWave
+{
+	/**
+	 * Load a value, with acquire semantics.  Memory reads after the load
+	 * cannot be reordered before it.
+	 * \param _ptr pointer to the value to read.
+	 * \return the value.
+	 */
+	inline uint32 AtomicLoad( volatile uint32 const* _ptr )
+	{
+#if defined _MSC_VER
+#if defined _M_ARM || defined _M_ARM64
+		uint32 value = (uint32)__iso_volatile_load32( (volatile __int32 const*)_ptr );
+#else
+		uint32 value = *_ptr;
+#endif
+		OZW_ATOMIC_FENCE();
+		return value;
+#else
+		return __atomic_load_n( _ptr, __ATOMIC_ACQUIRE );
+#endif
+	}
+
+	/**
+	 * Store a value, with release semantics.  Memory writes before the store
+	 * cannot be reordered after it.
+	 * \param _ptr pointer to the value to write.
+	 * \param _value the new value.
+	 */
+	inline void AtomicStore( volatile uint32* _ptr, uint32 _value )
+	{
+#if defined _MSC_VER
+		OZW_ATOMIC_FENCE();
+#if defined _M_ARM || defined _M_ARM64
+		__iso_volatile_store32( (volatile __int32*)_ptr, (__int32)_value );
+#else
+		*_ptr = _value;
+#endif
+#else
+		__atomic_store_n( _ptr, _value, __ATOMIC_RELEASE );
+#endif
+	}
+
+	/**
+	 * Keep the memory reads before the fence from being reordered after the
+	 * reads that follow it, such as the second read of a sequence count.
+	 */
+	inline void AtomicAcquireFence()
+	{
+#if defined _MSC_VER
+		OZW_ATOMIC_FENCE();
+#else
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+#endif
+	}
+
+	/**
+	 * Load a pointer, with acquire semantics.
+	 * \param _ptr pointer to the pointer to read.
+	 * \return the pointer.
+	 */
+	template<class T> inline T* AtomicLoadPtr( T* volatile const* _ptr )
+	{
+#if defined _MSC_VER
+		// An aligned pointer is read whole, so only the ordering needs a fence
+		T* value = *_ptr;
+		OZW_ATOMIC_FENCE();
+		return value;
+#else
+		return __atomic_load_n( _ptr, __ATOMIC_ACQUIRE );
+#endif
+	}
+
+	/**
+	 * Store a pointer, with release semantics, so that a thread that loads it
+	 * with AtomicLoadPtr sees the object fully constructed.
+	 * \param _ptr pointer to the pointer to write.
+	 * \param _value the new pointer.
+	 */
+	template<class T> inline void AtomicStorePtr( T* volatile* _ptr, T* _value )
+	{
+#if defined _MSC_VER
+		OZW_ATOMIC_FENCE();
+		*_ptr = _value;
+#else
+		__atomic_store_n( _ptr, _value, __ATOMIC_RELEASE );
+#endif
+	}
+
+	/**
+	 * Add to a value as a single atomic operation.
+	 * \param _ptr pointer to the value to modify.
+	 * \param _value amount to add (may be negative when cast).
+	 * \return the new value.
+	 */
+	inline uint32 AtomicAdd( volatile uint32* _ptr, uint32 _value )
+	{
+#if defined _MSC_VER
+		return (uint32)_InterlockedExchangeAdd( (volatile long*)_ptr, (long)_value ) + _value;
+#else
+		return __atomic_add_fetch( _ptr, _value, __ATOMIC_ACQ_REL );
+#endif
+	}
+
+	/**
+	 * Increment a value as a single atomic operation.
+	 * \return the new value.
+	 */
+	inline uint32 AtomicIncrement( volatile uint32* _ptr ){ return AtomicAdd( _ptr, 1 ); }
+
+	/**
+	 * Increment a value as a single atomic operation, without ordering the memory
+	 * accesses around it.  For counts that only need to be exact, such as a new
+	 * reference taken by a thread that already holds one.
+	 * \return the new value.
+	 */
+	inline uint32 AtomicIncrementRelaxed( volatile uint32* _ptr )
+	{
+#if defined _MSC_VER
+		return (uint32)_InterlockedExchangeAdd( (volatile long*)_ptr, 1 ) + 1;
+#else
+		return __atomic_add_fetch( _ptr, 1, __ATOMIC_RELAXED );
+#endif
+	}
+
+	/**
+	 * Decrement a value as a single atomic operation.
+	 * \return the new value.
+	 */
+	inline uint32 AtomicDecrement( volatile uint32* _ptr ){ return AtomicAdd( _ptr, (uint32)-1 ); }
+
+	/**
+	 * Replace a value only if it still holds the expected value.
+	 * \param _ptr pointer to the value to modify.
+	 * \param _expected the value _ptr must hold for the exchange to happen.
+	 * \param _value the new value.
+	 * \return true if the exchange happened.
+	 */
+	inline bool AtomicCompareExchange( volatile uint32* _ptr, uint32 _expected, uint32 _value )
+	{
+#if defined _MSC_VER
+		return( (uint32)_InterlockedCompareExchange( (volatile long*)_ptr, (long)_value, (long)_expected ) == _expected );
+#else
+		return __atomic_compare_exchange_n( _ptr, &_expected, _value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE );
+#endif
+	}
+
+	/**
+	 * Load a 64 bit value without tearing, even on a 32 bit machine.  No ordering is implied.
+	 * \param _ptr pointer to the value to read.  Must be 8 byte aligned.
+	 * \return the value.
+	 */
+	inline uint64 AtomicLoad64( volatile uint64 const* _ptr )
+	{
+#if defined _MSC_VER
+#if defined _M_X64
+		return *_ptr;
+#else
+		// Exchanging zero for zero leaves the value alone and returns it whole
+		return (uint64)_InterlockedCompareExchange64( (volatile __int64*)_ptr, 0, 0 );
+#endif
+#else
+		return __atomic_load_n( _ptr, __ATOMIC_RELAXED );
+#endif
+	}
+
+	/**
+	 * Add to a 64 bit value as a single atomic operation.  No ordering is implied.
+	 * \param _ptr pointer to the value to modify.  Must be 8 byte aligned.
+	 * \param _value amount to add.
+	 */
+	inline void AtomicAdd64( volatile uint64* _ptr, uint64 _value )
+	{
+#if defined _MSC_VER
+		__int64 value = *(volatile __int64*)_ptr;
+		__int64 seen;
+		while( ( seen = _InterlockedCompareExchange64( (volatile __int64*)_ptr, value + (__int64)_value, value ) ) != value )
+		{
+			value = seen;
+		}
+#else
+		__atomic_add_fetch( _ptr, _value, __ATOMIC_RELAXED );
+#endif
+	}
+
+} // namespace OpenZWave
+
+#endif //_Atomic_H
@@ -0,0 +1,941 @@
+//-----------------------------------------------------------------------------
+//
+//	BinaryLog.cpp
+//
+//	A log that records the arguments of each entry rather than its text
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include <time.h>
+#include "Defs.h"
+#include "platform/BinaryLog.h"
+
+#if defined WIN32 || defined WINRT
+#include <sys/timeb.h>
+#else
+#include <sys/time.h>
+#endif
+
+using namespace OpenZWave;
+
+// Start of every binary log
+static char const c_magic[8] = { 'O', 'Z', 'W', 'B', 'L', 'O', 'G', 0 };
+static uint8 const c_version = 1;
+
+namespace
+{
+	// What each conversion of a format string takes from the argument list
+	enum ArgType
+	{
+		ArgType_None = 0,				// %%
+		ArgType_Int = 'i',				// int, or anything promoted to it
+		ArgType_Long = 'l',
+		ArgType_ULong = 'u',
+		ArgType_LongLong = 'L',
+		ArgType_ULongLong = 'U',
+		ArgType_Size = 'z',
+		ArgType_Double = 'd',
+		ArgType_String = 's',
+		ArgType_Pointer = 'p'
+	};
+
+	// What the reader has to do for each conversion of a format string
+	struct Conversion
+	{
+		char const*	m_start;		// The '%'
+		char const*	m_length;		// The length modifier, if any
+		char const*	m_end;			// Just past the conversion character
+		uint32		m_stars;		// Number of '*' widths and precisions, each taking an int
+		char		m_argType;		// ArgType of the value
+	};
+
+	//-----------------------------------------------------------------------------
+	// Find the next conversion in a format string.  Returns false at the end
+	// of the string, or at a conversion that is not understood, in which case
+	// the rest of the string is treated as plain text.
+	//-----------------------------------------------------------------------------
+	bool NextConversion
+	(
+		char const* _format,
+		Conversion& o_conversion
+	)
+	{
+		char const* p = strchr( _format, '%' );
+		if( p == NULL )
+		{
+			return false;
+		}
+
+		o_conversion.m_start = p++;
+		o_conversion.m_stars = 0;
+		if( *p == '%' )
+		{
+			o_conversion.m_end = p + 1;
+			o_conversion.m_argType = ArgType_None;
+			return true;
+		}
+
+		// Flags, width and precision
+		while( *p && strchr( "-+ #0'", *p ) )
+		{
+			++p;
+		}
+		while( *p == '*' || ( *p >= '0' && *p <= '9' ) || *p == '.' )
+		{
+			if( *p == '*' )
+			{
+				++o_conversion.m_stars;
+			}
+			++p;
+		}
+
+		// Length
+		o_conversion.m_length = p;
+		char length = 0;
+		if( *p == 'h' )
+		{
+			p += ( p[1] == 'h' ) ? 2 : 1;
+		}
+		else if( *p == 'l' )
+		{
+			length = ( p[1] == 'l' ) ? 'L' : 'l';
+			p += ( p[1] == 'l' ) ? 2 : 1;
+		}
+		else if( *p == 'q' || *p == 'j' || *p == 'L' )
+		{
+			length = 'L';
+			++p;
+		}
+		else if( *p == 'z' || *p == 't' )
+		{
+			length = 'z';
+			++p;
+		}
+		else if( *p == 'I' )
+		{
+			// Microsoft's I, I32 and I64
+			if( p[1] == '6' && p[2] == '4' )
+			{
+				length = 'L';
+				p += 3;
+			}
+			else if( p[1] == '3' && p[2] == '2' )
+			{
+				p += 3;
+			}
+			else
+			{
+				length = 'z';
+				++p;
+			}
+		}
+
+		bool isUnsigned = false;
+		switch( *p )
+		{
+			case 'o':
+			case 'u':
+			case 'x':
+			case 'X':
+			{
+				isUnsigned = true;
+				// Fall through
+			}
+			case 'd':
+			case 'i':
+			{
+				switch( length )
+				{
+					case 'l':	o_conversion.m_argType = isUnsigned ? ArgType_ULong : ArgType_Long;			break;
+					case 'L':	o_conversion.m_argType = isUnsigned ? ArgType_ULongLong : ArgType_LongLong;	break;
+					case 'z':	o_conversion.m_argType = ArgType_Size;										break;
+					default:	o_conversion.m_argType = ArgType_Int;										break;
+				}
+				break;
+			}
+			case 'c':
+			{
+				o_conversion.m_argType = ArgType_Int;
+				break;
+			}
+			case 'e':
+			case 'E':
+			case 'f':
+			case 'F':
+			case 'g':
+			case 'G':
+			case 'a':
+			case 'A':
+			{
+				if( length == 'L' )
+				{
+					// long double is not supported
+					return false;
+				}
+				o_conversion.m_argType = ArgType_Double;
+				break;
+			}
+			case 's':
+			{
+				if( length == 'l' )
+				{
+					// Nor are wide strings
+					return false;
+				}
+				o_conversion.m_argType = ArgType_String;
+				break;
+			}
+			case 'p':
+			case 'n':
+			{
+				o_conversion.m_argType = ArgType_Pointer;
+				break;
+			}
+			default:
+			{
+				return false;
+			}
+		}
+
+		o_conversion.m_end = p + 1;
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Append a varint to a record
+	//-----------------------------------------------------------------------------
+	void PutVarint
+	(
+		string& _record,
+		uint64 _value
+	)
+	{
+		while( _value >= 0x80 )
+		{
+			_record += (char)( _value | 0x80 );
+			_value >>= 7;
+		}
+		_record += (char)_value;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Append a signed value to a record, zigzag encoded so that small negative
+	// numbers stay short
+	//-----------------------------------------------------------------------------
+	void PutSigned
+	(
+		string& _record,
+		int64 _value
+	)
+	{
+		PutVarint( _record, ( (uint64)_value << 1 ) ^ (uint64)( _value >> 63 ) );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Read a varint from a file
+	//-----------------------------------------------------------------------------
+	bool GetVarint
+	(
+		FILE* _file,
+		uint64& o_value
+	)
+	{
+		o_value = 0;
+		for( uint32 shift = 0; shift < 70; shift += 7 )
+		{
+			int byte = fgetc( _file );
+			if( byte == EOF )
+			{
+				return false;
+			}
+			o_value |= (uint64)( byte & 0x7f ) << shift;
+			if( !( byte & 0x80 ) )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Read a zigzag encoded value from a file
+	//-----------------------------------------------------------------------------
+	bool GetSigned
+	(
+		FILE* _file,
+		int64& o_value
+	)
+	{
+		uint64 value;
+		if( !GetVarint( _file, value ) )
+		{
+			return false;
+		}
+		o_value = (int64)( value >> 1 ) ^ -(int64)( value & 1 );
+		return true;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Read a length and that many bytes from a file
+	//-----------------------------------------------------------------------------
+	bool GetString
+	(
+		FILE* _file,
+		string& o_value
+	)
+	{
+		uint64 length;
+		if( !GetVarint( _file, length ) || length > 0xffff )
+		{
+			return false;
+		}
+		o_value.resize( (size_t)length );
+		return( length == 0 || fread( &o_value[0], 1, (size_t)length, _file ) == length );
+	}
+
+	//-----------------------------------------------------------------------------
+	// Write the start of a line, in the same layout as the platform LogImpl
+	//-----------------------------------------------------------------------------
+	void WritePrefix
+	(
+		FILE* _out,
+		uint64 const _seconds,
+		uint64 const _milliseconds,
+		uint8 const _level,
+		uint8 const _nodeId
+	)
+	{
+		time_t seconds = (time_t)_seconds;
+		struct tm tm;
+#if defined WIN32 || defined WINRT
+		localtime_s( &tm, &seconds );
+#else
+		localtime_r( &seconds, &tm );
+#endif
+		fprintf( _out, "%04d-%02d-%02d %02d:%02d:%02d.%03d %s, ",
+				tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+				tm.tm_hour, tm.tm_min, tm.tm_sec, (int)_milliseconds,
+				( _level >= LogLevel_None && _level <= LogLevel_Internal ) ? LogLevelString[_level] : "Unknown" );
+
+		if( _nodeId == 255 )
+		{
+			fputs( "contrlr, ", _out );
+		}
+		else if( _nodeId != 0 )
+		{
+			fprintf( _out, "Node%03d, ", _nodeId );
+		}
+	}
+
+	//-----------------------------------------------------------------------------
+	// Read the arguments of an entry and write out its text
+	//-----------------------------------------------------------------------------
+	bool WriteText
+	(
+		FILE* _file,
+		FILE* _out,
+		string const& _format
+	)
+	{
+		char const* text = _format.c_str();
+		Conversion conversion;
+		while( NextConversion( text, conversion ) )
+		{
+			fwrite( text, 1, conversion.m_start - text, _out );
+			text = conversion.m_end;
+			if( conversion.m_argType == ArgType_None )
+			{
+				fputc( '%', _out );
+				continue;
+			}
+
+			// Rebuild the conversion with the widths filled in, and a length
+			// to suit the type the value was read back as.
+			string spec;
+			for( char const* p = conversion.m_start; p < conversion.m_length; ++p )
+			{
+				if( *p == '*' )
+				{
+					int64 width;
+					if( !GetSigned( _file, width ) )
+					{
+						return false;
+					}
+					char buffer[16];
+					snprintf( buffer, sizeof(buffer), "%d", (int)width );
+					spec += buffer;
+				}
+				else
+				{
+					spec += *p;
+				}
+			}
+			char const type = conversion.m_argType;
+			if( type != ArgType_Int && type != ArgType_Double && type != ArgType_String && type != ArgType_Pointer )
+			{
+				spec += "ll";
+			}
+			else if( *conversion.m_length == 'h' )
+			{
+				// Keep h and hh, which truncate the int they are given
+				spec.append( conversion.m_length, conversion.m_end - 1 );
+			}
+			spec += conversion.m_end[-1];
+
+			char buffer[1024];
+			buffer[0] = 0;
+			switch( type )
+			{
+				case ArgType_Int:
+				case ArgType_Long:
+				case ArgType_ULong:
+				case ArgType_LongLong:
+				case ArgType_ULongLong:
+				case ArgType_Size:
+				{
+					int64 value;
+					if( !GetSigned( _file, value ) )
+					{
+						return false;
+					}
+					if( type == ArgType_Int )
+					{
+						snprintf( buffer, sizeof(buffer), spec.c_str(), (int)value );
+					}
+					else
+					{
+						snprintf( buffer, sizeof(buffer), spec.c_str(), (long long)value );
+					}
+					break;
+				}
+				case ArgType_Double:
+				{
+					double value;
+					if( fread( &value, sizeof(value), 1, _file ) != 1 )
+					{
+						return false;
+					}
+					snprintf( buffer, sizeof(buffer), spec.c_str(), value );
+					break;
+				}
+				case ArgType_String:
+				{
+					string value;
+					if( !GetString( _file, value ) )
+					{
+						return false;
+					}
+					snprintf( buffer, sizeof(buffer), spec.c_str(), value.c_str() );
+					break;
+				}
+				case ArgType_Pointer:
+				{
+					uint64 value;
+					if( !GetVarint( _file, value ) )
+					{
+						return false;
+					}
+					if( conversion.m_end[-1] == 'p' )
+					{
+						snprintf( buffer, sizeof(buffer), "0x%llx", (unsigned long long)value );
+					}
+					break;
+				}
+			}
+			fputs( buffer, _out );
+		}
+		fputs( text, _out );
+		fputc( '\n', _out );
+		return true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::BinaryLog>
+//	Constructor
+//-----------------------------------------------------------------------------
+BinaryLog::BinaryLog
+(
+	string const& _filename,
+	LogLevel const _saveLevel,
+	LogLevel const _queueLevel,
+	LogLevel const _dumpTrigger
+):
+	m_file( NULL ),
+	m_saveLevel( _saveLevel ),
+	m_queueLevel( _queueLevel ),
+	m_dumpTrigger( _dumpTrigger ),
+	m_filename( _filename ),
+	m_queue( c_maxQueued ),
+	m_queueHead( 0 ),
+	m_queueCount( 0 )
+{
+	if( !m_filename.empty() )
+	{
+		m_file = fopen( m_filename.c_str(), "wb" );
+	}
+	if( m_file == NULL )
+	{
+		fprintf( stderr, "Could Not Open OZW Log File.\n" );
+		return;
+	}
+
+	fwrite( c_magic, 1, sizeof(c_magic), m_file );
+	fputc( c_version, m_file );
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::~BinaryLog>
+//	Destructor
+//-----------------------------------------------------------------------------
+BinaryLog::~BinaryLog
+(
+)
+{
+	if( m_file )
+	{
+		fclose( m_file );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::Write>
+//	Record an entry
+//-----------------------------------------------------------------------------
+void BinaryLog::Write
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args
+)
+{
+	WriteEntry( _level, _nodeId, _format, _args, _level <= m_saveLevel );
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::WriteNode>
+//	Record an entry from a node with its own log level
+//-----------------------------------------------------------------------------
+void BinaryLog::WriteNode
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args,
+	bool const _save
+)
+{
+	WriteEntry( _level, _nodeId, _format, _args, _save );
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::WriteEntry>
+//	Record an entry, saving it or not as the caller decided
+//-----------------------------------------------------------------------------
+void BinaryLog::WriteEntry
+(
+	LogLevel _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args,
+	bool const _save
+)
+{
+	bool save = _save || ( _level == LogLevel_Internal );
+	bool queue = ( _level <= m_queueLevel ) && ( _level != LogLevel_Internal );
+	if( save || queue )
+	{
+		Encode( _level, _nodeId, ( _format != NULL ) ? _format : "", _args );
+		if( save && m_file )
+		{
+			fwrite( m_record.data(), 1, m_record.size(), m_file );
+		}
+		if( queue )
+		{
+			Queue();
+		}
+	}
+
+	if( ( _level <= m_dumpTrigger ) && ( _level != LogLevel_Internal ) && ( _level != LogLevel_Always ) )
+	{
+		QueueDump();
+	}
+
+	// Make sure anything serious reaches the disk, in case it is followed by a crash
+	if( save && m_file && ( _level <= LogLevel_Warning ) )
+	{
+		fflush( m_file );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::QueueDump>
+//	Write the kept entries to the file, and forget them
+//-----------------------------------------------------------------------------
+void BinaryLog::QueueDump
+(
+)
+{
+	if( m_file )
+	{
+		fputc( RecordKind_DumpStart, m_file );
+		for( uint32 i=0; i<m_queueCount; ++i )
+		{
+			string const& record = m_queue[( m_queueHead + i ) % c_maxQueued];
+			fwrite( record.data(), 1, record.size(), m_file );
+		}
+		fputc( RecordKind_DumpEnd, m_file );
+		fflush( m_file );
+	}
+	QueueClear();
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::QueueClear>
+//	Forget the kept entries
+//-----------------------------------------------------------------------------
+void BinaryLog::QueueClear
+(
+)
+{
+	m_queueHead = 0;
+	m_queueCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::SetLoggingState>
+//	Sets the various log state variables
+//-----------------------------------------------------------------------------
+void BinaryLog::SetLoggingState
+(
+	LogLevel _saveLevel,
+	LogLevel _queueLevel,
+	LogLevel _dumpTrigger
+)
+{
+	m_saveLevel = _saveLevel;
+	m_queueLevel = _queueLevel;
+	m_dumpTrigger = _dumpTrigger;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::GetQueueMemoryUsage>
+//	Bytes used by the kept entries
+//-----------------------------------------------------------------------------
+uint32 BinaryLog::GetQueueMemoryUsage
+(
+)
+{
+	uint32 bytes = (uint32)( m_queue.capacity() * sizeof(string) );
+	for( vector<string>::const_iterator it = m_queue.begin(); it != m_queue.end(); ++it )
+	{
+		bytes += (uint32)it->capacity();
+	}
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::SetLogFileName>
+//	Provide a new log file name (applicable to future writes)
+//-----------------------------------------------------------------------------
+void BinaryLog::SetLogFileName
+(
+	const string &_filename
+)
+{
+	m_filename = _filename;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::ParseFormat>
+//	Work out the types of the arguments a format string takes
+//-----------------------------------------------------------------------------
+void BinaryLog::ParseFormat
+(
+	char const* _format,
+	string& o_args
+)
+{
+	o_args.clear();
+	Conversion conversion;
+	while( NextConversion( _format, conversion ) )
+	{
+		o_args.append( conversion.m_stars, (char)ArgType_Int );
+		if( conversion.m_argType != ArgType_None )
+		{
+			o_args += conversion.m_argType;
+		}
+		_format = conversion.m_end;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::GetFormatId>
+//	Find the id of a format string, writing out the string if this is the
+//	first time it has been seen.  Format strings are nearly always literals,
+//	so they are looked up by address, with the text checked in case the
+//	address has been reused.  Returns c_maxFormats once the table is full.
+//-----------------------------------------------------------------------------
+uint32 BinaryLog::GetFormatId
+(
+	char const* _format
+)
+{
+	map<char const*,uint32>::iterator it = m_formatIds.find( _format );
+	if( it != m_formatIds.end() && m_formats[it->second].m_text == _format )
+	{
+		return it->second;
+	}
+
+	if( m_formats.size() >= c_maxFormats )
+	{
+		return c_maxFormats;
+	}
+
+	uint32 id = (uint32)m_formats.size();
+	m_formats.resize( id + 1 );
+	m_formats[id].m_text = _format;
+	ParseFormat( _format, m_formats[id].m_args );
+	m_formatIds[_format] = id;
+
+	if( m_file )
+	{
+		string record;
+		record += (char)RecordKind_Format;
+		PutVarint( record, id );
+		PutVarint( record, m_formats[id].m_text.size() );
+		record += m_formats[id].m_text;
+		fwrite( record.data(), 1, record.size(), m_file );
+	}
+	return id;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::Encode>
+//	Build the record for an entry in m_record
+//-----------------------------------------------------------------------------
+void BinaryLog::Encode
+(
+	LogLevel const _level,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args
+)
+{
+	uint32 id = GetFormatId( _format );
+
+	m_record.clear();
+	m_record += (char)( ( id < c_maxFormats ) ? RecordKind_Entry : RecordKind_Text );
+	m_record += (char)_level;
+	m_record += (char)_nodeId;
+
+#if defined WIN32 || defined WINRT
+	struct _timeb now;
+	_ftime_s( &now );
+	PutVarint( m_record, (uint64)now.time );
+	PutVarint( m_record, now.millitm );
+#else
+	struct timeval now;
+	gettimeofday( &now, NULL );
+	PutVarint( m_record, (uint64)now.tv_sec );
+	PutVarint( m_record, (uint64)( now.tv_usec / 1000 ) );
+#endif
+
+	if( id == c_maxFormats )
+	{
+		char text[1024];
+		vsnprintf( text, sizeof(text), _format, _args );
+		PutVarint( m_record, strlen( text ) );
+		m_record += text;
+		return;
+	}
+
+	PutVarint( m_record, id );
+	string const& args = m_formats[id].m_args;
+	for( string::const_iterator it = args.begin(); it != args.end(); ++it )
+	{
+		switch( *it )
+		{
+			case ArgType_Int:		PutSigned( m_record, va_arg( _args, int ) );						break;
+			case ArgType_Long:		PutSigned( m_record, va_arg( _args, long ) );						break;
+			case ArgType_ULong:		PutSigned( m_record, (int64)va_arg( _args, unsigned long ) );		break;
+			case ArgType_LongLong:	PutSigned( m_record, va_arg( _args, long long ) );					break;
+			case ArgType_ULongLong:	PutSigned( m_record, (int64)va_arg( _args, unsigned long long ) );	break;
+			case ArgType_Size:		PutSigned( m_record, (int64)va_arg( _args, size_t ) );				break;
+			case ArgType_Double:
+			{
+				double value = va_arg( _args, double );
+				m_record.append( (char const*)&value, sizeof(value) );
+				break;
+			}
+			case ArgType_String:
+			{
+				char const* value = va_arg( _args, char const* );
+				if( value == NULL )
+				{
+					value = "(null)";
+				}
+				size_t length = strlen( value );
+				if( length > 0xffff )
+				{
+					length = 0xffff;
+				}
+				PutVarint( m_record, length );
+				m_record.append( value, length );
+				break;
+			}
+			case ArgType_Pointer:
+			{
+				PutVarint( m_record, (uint64)(size_t)va_arg( _args, void* ) );
+				break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::Queue>
+//	Keep m_record in the ring of recent entries
+//-----------------------------------------------------------------------------
+void BinaryLog::Queue
+(
+)
+{
+	uint32 index = ( m_queueHead + m_queueCount ) % c_maxQueued;
+	if( m_queueCount < c_maxQueued )
+	{
+		++m_queueCount;
+	}
+	else
+	{
+		// Full, so overwrite the oldest
+		m_queueHead = ( m_queueHead + 1 ) % c_maxQueued;
+	}
+	m_queue[index] = m_record;
+}
+
+//-----------------------------------------------------------------------------
+//	<BinaryLog::Decode>
+//	Convert a binary log to text
+//-----------------------------------------------------------------------------
+bool BinaryLog::Decode
+(
+	string const& _filename,
+	FILE* _out
+)
+{
+	FILE* file = fopen( _filename.c_str(), "rb" );
+	if( file == NULL )
+	{
+		return false;
+	}
+
+	char magic[sizeof(c_magic)];
+	if( fread( magic, 1, sizeof(magic), file ) != sizeof(magic) || memcmp( magic, c_magic, sizeof(magic) ) || fgetc( file ) != c_version )
+	{
+		fclose( file );
+		return false;
+	}
+
+	vector<string> formats;
+	int kind;
+	while( ( kind = fgetc( file ) ) != EOF )
+	{
+		bool ok = true;
+		switch( kind )
+		{
+			case RecordKind_Format:
+			{
+				uint64 id;
+				string text;
+				ok = GetVarint( file, id ) && id < c_maxFormats && GetString( file, text );
+				if( ok )
+				{
+					if( id >= formats.size() )
+					{
+						formats.resize( (size_t)id + 1 );
+					}
+					formats[(size_t)id] = text;
+				}
+				break;
+			}
+			case RecordKind_Entry:
+			case RecordKind_Text:
+			{
+				int level = fgetc( file );
+				int nodeId = fgetc( file );
+				uint64 seconds, milliseconds;
+				ok = ( nodeId != EOF ) && GetVarint( file, seconds ) && GetVarint( file, milliseconds );
+				if( !ok )
+				{
+					break;
+				}
+
+				if( level != LogLevel_Internal )
+				{
+					WritePrefix( _out, seconds, milliseconds, (uint8)level, (uint8)nodeId );
+				}
+
+				if( kind == RecordKind_Text )
+				{
+					string text;
+					ok = GetString( file, text );
+					if( ok )
+					{
+						fprintf( _out, "%s\n", text.c_str() );
+					}
+				}
+				else
+				{
+					uint64 id;
+					ok = GetVarint( file, id ) && id < formats.size() && WriteText( file, _out, formats[(size_t)id] );
+				}
+				break;
+			}
+			case RecordKind_DumpStart:
+			{
+				fputs( "\nDumping queued log messages\n\n", _out );
+				break;
+			}
+			case RecordKind_DumpEnd:
+			{
+				fputs( "\nEnd of queued log message dump\n\n", _out );
+				break;
+			}
+			default:
+			{
+				ok = false;
+				break;
+			}
+		}
+
+		if( !ok )
+		{
+			// Truncated or damaged.  Nothing after this can be trusted.
+			fputc( '\n', _out );
+			break;
+		}
+	}
+
+	fclose( file );
+	return true;
+}
@@ -0,0 +1,135 @@
+//-----------------------------------------------------------------------------
+//
+//	BinaryLog.h
+//
+//	A log that records the arguments of each entry rather than its text
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _BinaryLog_H
+#define _BinaryLog_H
+
+#include <stdio.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "platform/Log.h"
+
+namespace OpenZWave
+{
+	/** \brief A log implementation that defers the formatting of each entry until the log is read.
+	 *
+	 * Each entry is stored as its time, level and node, the id of its format string and
+	 * the raw values of its arguments.  The text of a format string is written to the
+	 * file once, the first time it is used.  Decode turns a file back into the usual
+	 * text log, so detailed levels can be left on at the cost of a few bytes per entry.
+	 *
+	 * The file starts with the eight characters "OZWBLOG" and a NUL, then a version
+	 * byte.  Each record is a kind byte followed by its fields, with integers as varints
+	 * (seven bits to a byte, least significant first, signed values zigzag encoded):
+	 *   - a format: its id and the length and bytes of the string.
+	 *   - an entry: the level and node bytes, the time in seconds and milliseconds, the
+	 *     format id and then the arguments.  Integers and pointers are varints, doubles
+	 *     are eight bytes in the byte order of the machine that wrote them and strings
+	 *     are a length and the bytes.
+	 *   - a text entry: as an entry, but with the text of the line instead of a format
+	 *     id and arguments.  Used once the format table is full.
+	 *   - the start and end of a queue dump.  The entries in between are the ones that
+	 *     were kept in memory when the dump was triggered.
+	 *
+	 * Nothing is written to the console.
+	 */
+	class OPENZWAVE_EXPORT BinaryLog : public i_LogImpl
+	{
+	public:
+		/**
+		 * Constructor.  Creates the file, replacing any file of that name.
+		 * \param _filename the log file.
+		 * \param _saveLevel level of entries to write.
+		 * \param _queueLevel level of entries to keep, to be written if a _dumpTrigger entry is seen.
+		 * \param _dumpTrigger level of entry that writes out the kept entries.
+		 */
+		BinaryLog( string const& _filename, LogLevel const _saveLevel, LogLevel const _queueLevel, LogLevel const _dumpTrigger );
+		virtual ~BinaryLog();
+
+		// From i_LogImpl
+		virtual void Write( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args );
+		virtual void WriteNode( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args, bool const _save );
+		virtual void QueueDump();
+		virtual void QueueClear();
+		virtual void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
+		virtual void SetLogFileName( const string &_filename );
+		virtual uint32 GetQueueMemoryUsage();
+
+		/**
+		 * Convert a binary log to text, in the layout of the usual log file.
+		 * \param _filename the binary log to read.
+		 * \param _out where to write the text.
+		 * \return true if the file is a binary log.  A truncated last record is ignored.
+		 */
+		static bool Decode( string const& _filename, FILE* _out );
+
+	private:
+		enum RecordKind
+		{
+			RecordKind_Format = 0,
+			RecordKind_Entry,
+			RecordKind_Text,
+			RecordKind_DumpStart,
+			RecordKind_DumpEnd
+		};
+
+		struct Format
+		{
+			string	m_text;
+			string	m_args;				// The type of each argument taken, as ParseFormat finds them
+		};
+
+		static void ParseFormat( char const* _format, string& o_args );
+		uint32 GetFormatId( char const* _format );
+		void Encode( LogLevel const _level, uint8 const _nodeId, char const* _format, va_list _args );
+		void WriteEntry( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args, bool const _save );
+		void Queue();
+
+		static uint32 const c_maxFormats = 4096;	// Beyond this, entries are stored as text
+		static uint32 const c_maxQueued = 500;		// Same limit as the platform LogImpl
+
+		FILE*				m_file;
+		LogLevel			m_saveLevel;
+		LogLevel			m_queueLevel;
+		LogLevel			m_dumpTrigger;
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		string				m_filename;
+
+		map<char const*,uint32>	m_formatIds;		// Last id seen for each format string address
+		vector<Format>		m_formats;			// Indexed by id
+		string				m_record;			// The record being encoded, reused to save allocations
+
+		vector<string>		m_queue;			// Ring of the most recent kept entries
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32				m_queueHead;		// Index of the oldest kept entry
+		uint32				m_queueCount;
+	};
+
+} // namespace OpenZWave
+
+#endif //_BinaryLog_H
@@ -27,9 +27,21 @@
 #include "Defs.h"
 #include "Driver.h"
 #include "platform/Controller.h"
+#include "platform/Log.h"
 
 using namespace OpenZWave;
 
+//-----------------------------------------------------------------------------
+//	<Controller::~Controller>
+//	Destructor
+//-----------------------------------------------------------------------------
+Controller::~Controller
+(
+)
+{
+	delete m_trace;
+}
+
 //-----------------------------------------------------------------------------
 // <Controller::PlayInitSequence>
 //  Queues up the controller's initialization commands.
@@ -66,3 +78,242 @@ uint32 Controller::Read
 	return 0;
 }
 
+//-----------------------------------------------------------------------------
+//	<Controller::ReadFrame>
+//	Read the next frame or single byte without copying it
+//-----------------------------------------------------------------------------
+bool Controller::ReadFrame
+(
+	Frame* o_frame,
+	uint8* _scratch
+)
+{
+	uint8* data = Peek( 1, _scratch );
+	if( data == NULL )
+	{
+		// Nothing to read
+		return false;
+	}
+
+	o_frame->m_data = data;
+	o_frame->m_length = 1;
+	o_frame->m_size = 1;
+	o_frame->m_age = 0;
+	if( data[0] != SOF )
+	{
+		return true;
+	}
+
+	// The frame decoder only passes on complete frames, so the length byte and the
+	// rest of the frame should already be here.
+	uint32 length = 0;
+	if( ( data = Peek( 2, _scratch ) ) != NULL )
+	{
+		length = (uint32)data[1] + 2;
+		data = Peek( length, _scratch );
+	}
+	if( data == NULL )
+	{
+		o_frame->m_length = 0;
+		o_frame->m_size = ( GetDataSize() < 2 ) ? GetDataSize() : 2;
+		return true;
+	}
+
+	o_frame->m_data = data;
+	o_frame->m_length = length;
+	o_frame->m_size = length;
+	if( (int32)( AtomicLoad( &m_framesPut ) - m_framesRead ) > 0 )
+	{
+		o_frame->m_age = (uint32)-m_epoch.TimeRemaining() - m_frameTimes[m_framesRead % c_frameTimes];
+		++m_framesRead;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::Purge>
+//	Empty the receive buffer
+//-----------------------------------------------------------------------------
+void Controller::Purge
+(
+)
+{
+	Stream::Purge();
+	m_framesRead = AtomicLoad( &m_framesPut );
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::TakeReconnected>
+//	Check whether the hardware has come back since the last call
+//-----------------------------------------------------------------------------
+bool Controller::TakeReconnected
+(
+)
+{
+	if( !AtomicLoad( &m_reconnected ) )
+	{
+		return false;
+	}
+	AtomicStore( &m_reconnected, 0 );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::Reconnected>
+//	Wake the driver to see that the hardware has come back
+//-----------------------------------------------------------------------------
+void Controller::Reconnected
+(
+)
+{
+	AtomicStore( &m_reconnected, 1 );
+	Notify();
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::IsSignalled>
+//	Signalled while there is data to read, or the hardware has come back
+//-----------------------------------------------------------------------------
+bool Controller::IsSignalled
+(
+)
+{
+	return AtomicLoad( &m_reconnected ) || Stream::IsSignalled();
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::PutFrame>
+//	Pass a complete frame to the driver, noting when it arrived
+//-----------------------------------------------------------------------------
+void Controller::PutFrame
+(
+)
+{
+	// Count the frame before putting it, so the driver never reads a frame without its time
+	uint32 framesPut = m_framesPut;
+	m_frameTimes[framesPut % c_frameTimes] = (uint32)-m_epoch.TimeRemaining();
+	AtomicStore( &m_framesPut, framesPut + 1 );
+	if( !Put( m_frame, m_framePos ) )
+	{
+		AtomicStore( &m_framesPut, framesPut );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::StartTrace>
+//	Record the traffic to and from the controller in a trace file
+//-----------------------------------------------------------------------------
+bool Controller::StartTrace
+(
+	string const& _filename
+)
+{
+	delete m_trace;
+	m_trace = ControllerTrace::Create( _filename );
+	return( m_trace != NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::Received>
+//	Decode data from the controller into frames before passing it to the driver
+//-----------------------------------------------------------------------------
+void Controller::Received
+(
+	uint8 const* _buffer,
+	uint32 _length
+)
+{
+	if( m_trace )
+	{
+		m_trace->Write( ControllerTrace::Direction_FromController, _buffer, _length );
+	}
+
+	if( ( m_frameState != FrameState_Idle ) && ( m_frameTimeout.TimeRemaining() < 0 ) )
+	{
+		// The rest of the frame never turned up.  Drop what we have and resync on the new data.
+		Log::Write( LogLevel_Warning, "WARNING: %dms passed without reading the rest of the frame...aborting frame read", 500 + GetLinkDelay() );
+		m_readAborts++;
+		m_frameState = FrameState_Idle;
+	}
+
+	uint32 i = 0;
+	while( i < _length )
+	{
+		switch( m_frameState )
+		{
+			case FrameState_Idle:
+			{
+				if( _buffer[i] != SOF )
+				{
+					// ACK, NAK, CAN or out of frame data - the driver deals with these a byte at a time
+					uint32 start = i;
+					while( ( i < _length ) && ( _buffer[i] != SOF ) )
+					{
+						++i;
+					}
+					Put( (uint8*)&_buffer[start], i - start );
+					break;
+				}
+
+				m_frame[0] = SOF;
+				m_framePos = 1;
+				m_frameState = FrameState_Length;
+				m_frameTimeout.SetTime( 500 + GetLinkDelay() );
+				++i;
+				break;
+			}
+			case FrameState_Length:
+			{
+				m_frame[m_framePos++] = _buffer[i++];
+				if( m_frame[1] == 0 )
+				{
+					// Nothing else to wait for.  Let the driver reject it.
+					PutFrame();
+					m_frameState = FrameState_Idle;
+				}
+				else
+				{
+					m_frameState = FrameState_Data;
+				}
+				break;
+			}
+			case FrameState_Data:
+			{
+				uint32 needed = ( (uint32)m_frame[1] + 2 ) - m_framePos;
+				uint32 count = _length - i;
+				if( count > needed )
+				{
+					count = needed;
+				}
+
+				memcpy( &m_frame[m_framePos], &_buffer[i], count );
+				m_framePos += count;
+				i += count;
+
+				if( count == needed )
+				{
+					// Frame complete.  Hand it over in one go.
+					PutFrame();
+					m_frameState = FrameState_Idle;
+				}
+				break;
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<Controller::Sent>
+//	Record data written to the controller in the trace
+//-----------------------------------------------------------------------------
+void Controller::Sent
+(
+	uint8 const* _buffer,
+	uint32 _length
+)
+{
+	if( m_trace )
+	{
+		m_trace->Write( ControllerTrace::Direction_ToController, _buffer, _length );
+	}
+}
@@ -33,6 +33,8 @@
 #include "Defs.h"
 #include "Driver.h"
 #include "platform/Stream.h"
+#include "platform/TimeStamp.h"
+#include "platform/ControllerTrace.h"
 
 namespace OpenZWave
 {
@@ -49,13 +51,13 @@ namespace OpenZWave
 		 * Consructor.
 		 * Creates the controller object.
 		 */
-		Controller():Stream( 2048 ){}
+		Controller():Stream( 2048 ), m_frameState( FrameState_Idle ), m_framePos( 0 ), m_readAborts( 0 ), m_trace( NULL ), m_framesPut( 0 ), m_framesRead( 0 ), m_reconnected( 0 ){}
 
 		/**
 		 * Destructor.
-		 * Destroys the controller object.
+		 * Destroys the controller object, closing any trace.
 		 */
-		virtual ~Controller(){}
+		virtual ~Controller();
 
 		/**
 		 * Queues a set of Z-Wave messages in the correct order needed to initialize the Controller implementation.
@@ -99,6 +101,150 @@ namespace OpenZWave
 		 * @see Write, Open, Close
 		 */
 		uint32 Read( uint8* _buffer, uint32 _length );
+
+		/** A frame, or single byte, taken from the controller without copying it. */
+		struct Frame
+		{
+			uint8*		m_data;			// The SOF of a frame, or a single ACK, NAK, CAN or out of frame byte
+			uint32		m_length;		// Bytes from the SOF to the checksum, 1 for a single byte, or 0 if a SOF came without the rest of its frame
+			uint32		m_age;			// Milliseconds between the frame arriving and being read
+			uint32		m_size;			// Bytes to remove from the stream when done with the frame
+		};
+
+		/**
+		 * Read the next frame or single byte from the controller.  The data is normally left in
+		 * place in the receive buffer, and only copied when it wraps round the end of it.
+		 * Follow with ReleaseFrame once finished with the frame.
+		 * @param o_frame Filled in with the frame.
+		 * @param _scratch At least c_maxFrameSize bytes, used if the frame has to be copied.
+		 * @return False if there is nothing to read.
+		 * @see ReleaseFrame, Read
+		 */
+		bool ReadFrame( Frame* o_frame, uint8* _scratch );
+
+		/**
+		 * Remove a frame from the receive buffer, after ReadFrame.  Must come before any Purge.
+		 * @param _frame The frame filled in by ReadFrame.
+		 * @see ReadFrame
+		 */
+		void ReleaseFrame( Frame const& _frame ){ Skip( _frame.m_size ); }
+
+		/**
+		 * Empty the receive buffer.  Hides Stream::Purge so the arrival times of any
+		 * discarded frames are dropped with them.
+		 */
+		void Purge();
+
+		enum
+		{
+			c_maxFrameSize = 257			// SOF, length and up to 255 bytes of frame data
+		};
+
+		/**
+		 * Number of partially received frames discarded by the frame decoder
+		 * because the rest of the frame did not arrive in time.
+		 * @return The number of aborted frame reads.
+		 * @see Received
+		 */
+		uint32 GetReadAborts()const{ return m_readAborts; }
+
+		/**
+		 * Get the operating system's id for the thread that reads from the controller.
+		 * @return The thread id, or zero if the controller has no read thread of its own.
+		 * @see Thread::GetId
+		 */
+		virtual uint64 GetThreadId(){ return 0; }
+
+		/**
+		 * Get how much longer than a local port data takes to reach the controller and come back,
+		 * such as over a network connection.  The driver allows this much more time for ACKs and
+		 * for the rest of a frame to arrive.
+		 * @return The extra time in milliseconds.
+		 * @see TcpController
+		 */
+		virtual uint32 GetLinkDelay(){ return 0; }
+
+		/**
+		 * Record everything read from and written to the controller in a trace file, which
+		 * ReplayController can play back.  Call before the controller is opened.
+		 * @param _filename The trace file to create.
+		 * @return True if the trace file was created.
+		 * @see ControllerTrace
+		 */
+		bool StartTrace( string const& _filename );
+
+		/**
+		 * Check whether the hardware has been opened again, after failing, since the last call.
+		 * Called only from the driver thread.
+		 * @return True if the controller has come back.
+		 * @see Reconnected
+		 */
+		bool TakeReconnected();
+
+	protected:
+		/**
+		 * Tell the driver that the hardware has been opened again after it failed, waking it as
+		 * data arriving does.  Called only from the implementation's read thread.
+		 * @see TakeReconnected
+		 */
+		void Reconnected();
+
+		/**
+		 * Used by the Wait class.  Signalled while there is data to read, or the hardware has come back.
+		 */
+		virtual bool IsSignalled();
+
+		/**
+		 * Pass data received from the hardware to the driver.
+		 * Called only from the implementation's read thread.  Single byte frames (ACK, NAK, CAN)
+		 * and anything out of frame go straight to the stream.  Data frames are collected by an
+		 * incremental decoder and put into the stream in one go once complete, so the driver
+		 * thread is woken once per frame and never has to wait for the rest of it to arrive.
+		 * @param _buffer Pointer to the data received.
+		 * @param _length Length in bytes of the data.
+		 * @see Read
+		 */
+		void Received( uint8 const* _buffer, uint32 _length );
+
+		/**
+		 * Record data written to the hardware in the trace, if there is one.
+		 * Called by the implementations' Write.
+		 * @param _buffer Pointer to the data written.
+		 * @param _length Length in bytes of the data.
+		 * @see StartTrace
+		 */
+		void Sent( uint8 const* _buffer, uint32 _length );
+
+	private:
+		void PutFrame();
+
+		enum FrameState
+		{
+			FrameState_Idle = 0,		// Waiting for a SOF
+			FrameState_Length,			// SOF received, waiting for the length byte
+			FrameState_Data				// Collecting the rest of the frame
+		};
+
+		FrameState	m_frameState;
+		uint8		m_frame[258];		// SOF, length and up to 255 bytes of frame data
+		uint32		m_framePos;			// Number of bytes of m_frame filled so far
+		TimeStamp	m_frameTimeout;		// Partial frames are discarded if not completed by this time
+		uint32		m_readAborts;
+		ControllerTrace*	m_trace;
+
+		// When each frame put into the stream arrived, in milliseconds since m_epoch.
+		// The read thread writes the time and counts the frame before putting it, so
+		// the driver thread finds the time there when it reads the frame.  A frame is at least two
+		// bytes, so the stream can never hold more frames than there are slots.
+		enum
+		{
+			c_frameTimes = 1024
+		};
+		TimeStamp		m_epoch;
+		uint32			m_frameTimes[c_frameTimes];
+		volatile uint32	m_framesPut;		// Written by the read thread
+		uint32			m_framesRead;		// Written by the driver thread
+		volatile uint32	m_reconnected;		// Set by the read thread, cleared by the driver thread
 	};
 
 } // namespace OpenZWave
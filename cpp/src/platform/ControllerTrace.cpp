@@ -0,0 +1,227 @@
+//-----------------------------------------------------------------------------
+//
+//	ControllerTrace.cpp
+//
+//	Timestamped record of the raw traffic to and from a controller
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <string.h>
+#include "Defs.h"
+#include "Utils.h"
+#include "platform/ControllerTrace.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+// Start of every trace file
+static char const c_magic[8] = { 'O', 'Z', 'W', 'T', 'R', 'A', 'C', 'E' };
+static uint8 const c_version = 1;
+
+namespace
+{
+	//-----------------------------------------------------------------------------
+	// Append a varint to a buffer
+	//-----------------------------------------------------------------------------
+	uint32 PutVarint
+	(
+		uint8* _buffer,
+		uint32 _value
+	)
+	{
+		uint32 length = 0;
+		while( _value >= 0x80 )
+		{
+			_buffer[length++] = (uint8)( _value | 0x80 );
+			_value >>= 7;
+		}
+		_buffer[length++] = (uint8)_value;
+		return length;
+	}
+
+	//-----------------------------------------------------------------------------
+	// Read a varint from a file
+	//-----------------------------------------------------------------------------
+	bool GetVarint
+	(
+		FILE* _file,
+		uint32& _value
+	)
+	{
+		_value = 0;
+		for( uint32 shift = 0; shift < 35; shift += 7 )
+		{
+			int byte = fgetc( _file );
+			if( byte == EOF )
+			{
+				return false;
+			}
+			_value |= (uint32)( byte & 0x7f ) << shift;
+			if( !( byte & 0x80 ) )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerTrace::ControllerTrace>
+// Constructor
+//-----------------------------------------------------------------------------
+ControllerTrace::ControllerTrace
+(
+	FILE* _file
+):
+	m_file( _file ),
+	m_mutex( new Mutex() ),
+	m_lastTime( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerTrace::~ControllerTrace>
+// Destructor
+//-----------------------------------------------------------------------------
+ControllerTrace::~ControllerTrace
+(
+)
+{
+	fclose( m_file );
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerTrace::Create>
+// Create a trace file
+//-----------------------------------------------------------------------------
+ControllerTrace* ControllerTrace::Create
+(
+	string const& _filename
+)
+{
+	FILE* file = fopen( _filename.c_str(), "wb" );
+	if( file == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ControllerTrace::Create - could not create %s", _filename.c_str() );
+		return NULL;
+	}
+
+	if( fwrite( c_magic, 1, sizeof(c_magic), file ) != sizeof(c_magic) || fputc( c_version, file ) == EOF )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ControllerTrace::Create - could not write to %s", _filename.c_str() );
+		fclose( file );
+		return NULL;
+	}
+	fflush( file );
+
+	Log::Write( LogLevel_Info, "Tracing the controller traffic to %s", _filename.c_str() );
+	return new ControllerTrace( file );
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerTrace::Write>
+// Add a record to the trace
+//-----------------------------------------------------------------------------
+void ControllerTrace::Write
+(
+	Direction const _direction,
+	uint8 const* _data,
+	uint32 const _length,
+	int32 const _time		// = -1
+)
+{
+	LockGuard LG(m_mutex);
+
+	// The read and write threads can race to the lock, so never go backwards
+	int32 now = ( _time < 0 ) ? -m_start.TimeRemaining() : _time;
+	if( now < m_lastTime )
+	{
+		now = m_lastTime;
+	}
+
+	uint8 header[11];
+	uint32 headerLength = 0;
+	header[headerLength++] = (uint8)_direction;
+	headerLength += PutVarint( &header[headerLength], (uint32)( now - m_lastTime ) );
+	headerLength += PutVarint( &header[headerLength], _length );
+	m_lastTime = now;
+
+	if( fwrite( header, 1, headerLength, m_file ) != headerLength || fwrite( _data, 1, _length, m_file ) != _length || fflush( m_file ) != 0 )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ControllerTrace::Write - could not write the trace" );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ControllerTrace::Load>
+// Read all the records of a trace file
+//-----------------------------------------------------------------------------
+bool ControllerTrace::Load
+(
+	string const& _filename,
+	vector<Record>& _records
+)
+{
+	FILE* file = fopen( _filename.c_str(), "rb" );
+	if( file == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ControllerTrace::Load - could not open %s", _filename.c_str() );
+		return false;
+	}
+
+	char magic[sizeof(c_magic)];
+	if( fread( magic, 1, sizeof(magic), file ) != sizeof(magic) || memcmp( magic, c_magic, sizeof(magic) ) || fgetc( file ) != c_version )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: ControllerTrace::Load - %s is not a trace file", _filename.c_str() );
+		fclose( file );
+		return false;
+	}
+
+	_records.clear();
+	uint32 time = 0;
+	int direction;
+	while( ( direction = fgetc( file ) ) != EOF )
+	{
+		uint32 delta;
+		uint32 length;
+		if( direction > Direction_Sniffed || !GetVarint( file, delta ) || !GetVarint( file, length ) || length > 0xffff )
+		{
+			break;
+		}
+
+		Record record;
+		record.m_direction = (Direction)direction;
+		record.m_time = time + delta;
+		record.m_data.resize( length );
+		if( length && fread( &record.m_data[0], 1, length, file ) != length )
+		{
+			break;
+		}
+
+		time = record.m_time;
+		_records.push_back( record );
+	}
+
+	fclose( file );
+	return true;
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+//
+//	ControllerTrace.h
+//
+//	Timestamped record of the raw traffic to and from a controller
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ControllerTrace_H
+#define _ControllerTrace_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief Writes and reads trace files of the raw bytes passing between the driver and a controller.
+	 *
+	 * A trace file starts with the eight characters "OZWTRACE" and a version byte.  Each record
+	 * that follows is a direction byte, the milliseconds since the previous record and the number
+	 * of bytes as varints (seven bits to a byte, least significant first), and then the bytes
+	 * themselves.  Records are flushed as they are written, so a trace survives a crash.
+	 */
+	class ControllerTrace
+	{
+	public:
+		enum Direction
+		{
+			Direction_FromController = 0,		/**< Read from the controller */
+			Direction_ToController,				/**< Written to the controller */
+			Direction_Sniffed					/**< A frame between two other nodes, captured by the driver's sniffer.  The data is the source node, the destination node and the command class payload. */
+		};
+
+		/** A record read back from a trace file */
+		struct Record
+		{
+			Direction		m_direction;
+			uint32			m_time;				/**< Milliseconds since the trace started */
+			vector<uint8>	m_data;
+		};
+
+		/**
+		 * Create a trace file, replacing any file of that name.
+		 * \param _filename the file to write.
+		 * \return the trace, or NULL if the file could not be created.
+		 */
+		static ControllerTrace* Create( string const& _filename );
+
+		/**
+		 * Read all the records of a trace file.
+		 * \param _filename the file to read.
+		 * \param _records filled with the records, in the order they were written.
+		 * \return true if the file is a trace file.  A truncated last record is dropped.
+		 */
+		static bool Load( string const& _filename, vector<Record>& _records );
+
+		/**
+		 * Close the trace file.
+		 */
+		~ControllerTrace();
+
+		/**
+		 * Add a record to the trace.  Safe to call from the read and write threads at once.
+		 * \param _direction which way the bytes went.
+		 * \param _data the bytes.
+		 * \param _length how many bytes there are.
+		 * \param _time when the bytes went, in milliseconds since the trace was created, or -1 for now.
+		 */
+		void Write( Direction const _direction, uint8 const* _data, uint32 const _length, int32 const _time = -1 );
+
+	private:
+		ControllerTrace( FILE* _file );
+
+		FILE*			m_file;
+		Mutex*			m_mutex;
+		TimeStamp		m_start;
+		int32			m_lastTime;			// Milliseconds from m_start to the last record
+	};
+
+} // namespace OpenZWave
+
+#endif //_ControllerTrace_H
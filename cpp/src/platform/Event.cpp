@@ -27,6 +27,7 @@
 //-----------------------------------------------------------------------------
 #include "Defs.h"
 #include "platform/Event.h"
+#include "platform/TimeStamp.h"
 
 #ifdef WIN32
 #include "platform/windows/EventImpl.h"	// Platform-specific implementation of an event
@@ -106,4 +107,16 @@ bool Event::Wait
 	return m_pImpl->Wait( _timeout );
 }
 
+//-----------------------------------------------------------------------------
+//	<Event::WaitUntil>
+//	Wait for the event to become signalled, until a deadline
+//-----------------------------------------------------------------------------
+bool Event::WaitUntil
+(
+	TimeStamp& _deadline
+)
+{
+	return m_pImpl->WaitUntil( _deadline.m_pImpl );
+}
+
 
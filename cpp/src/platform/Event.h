@@ -33,6 +33,7 @@
 namespace OpenZWave
 {
 	class EventImpl;
+	class TimeStamp;
 
 	/** \brief Platform-independent definition of event objects.
 	 */
@@ -40,6 +41,7 @@ namespace OpenZWave
 	{
 		friend class SerialControllerImpl;
 		friend class Wait;
+		friend class WaitSet;
 
 	public:
 		/**
@@ -72,6 +74,12 @@ namespace OpenZWave
 		 */
 		bool Wait( int32 _timeout );
 
+		/**
+		 * Used by the WaitSet::MultipleUntil method.
+		 * returns true if the event signalled, false if the deadline passed first
+		 */
+		bool WaitUntil( TimeStamp& _deadline );
+
 		/**
 		 * Destructor.
 		 * Destroys the event object.
@@ -84,6 +84,91 @@ bool FileOps::FolderExists
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+//	<FileOps::ReplaceFile>
+//	Static method to commit a new file in place of an existing one
+//-----------------------------------------------------------------------------
+bool FileOps::ReplaceFile
+(
+	const string &_newFileName,
+	const string &_fileName
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->ReplaceFile( _newFileName, _fileName );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::FileInfo>
+//	Static method to get the size and modification time of a file
+//-----------------------------------------------------------------------------
+bool FileOps::FileInfo
+(
+	const string &_fileName,
+	uint32 &_size,
+	uint32 &_modified
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->FileInfo( _fileName, _size, _modified );
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::MapFile>
+//	Static method to map a file into memory
+//-----------------------------------------------------------------------------
+uint8 const* FileOps::MapFile
+(
+	const string &_fileName,
+	uint32 &_size
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->MapFile( _fileName, _size );
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::UnmapFile>
+//	Static method to release a mapping made by MapFile
+//-----------------------------------------------------------------------------
+void FileOps::UnmapFile
+(
+	uint8 const* _data,
+	uint32 _size
+)
+{
+	if( s_instance != NULL && _data != NULL )
+	{
+		s_instance->m_pImpl->UnmapFile( _data, _size );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOps::CreateSharedFile>
+//	Static method to create a file mapped for writing
+//-----------------------------------------------------------------------------
+uint8* FileOps::CreateSharedFile
+(
+	const string &_fileName,
+	uint32 _size
+)
+{
+	if( s_instance != NULL )
+	{
+		return s_instance->m_pImpl->CreateSharedFile( _fileName, _size );
+	}
+	return NULL;
+}
+
 //-----------------------------------------------------------------------------
 //	<FileOps::FileOps>
 //	Constructor
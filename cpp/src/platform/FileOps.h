@@ -61,6 +61,53 @@ namespace OpenZWave
 		 */
 		static bool FolderExists( const string &_folderName );
 
+		/**
+		 * ReplaceFile. Flush a newly written file to disk, then rename it over another,
+		 * so that readers see either the old contents or the new ones, never a mix.
+		 * \param string. Name of the newly written file.
+		 * \param string. Name of the file to replace.
+		 * \return Bool value indicating success.
+		 */
+		static bool ReplaceFile( const string &_newFileName, const string &_fileName );
+
+		/**
+		 * FileInfo. Get the size and last modification time of a file.
+		 * \param string. File name.
+		 * \param uint32. Set to the size of the file in bytes.
+		 * \param uint32. Set to a value that changes whenever the file is modified.
+		 * \return Bool value indicating whether the file exists.
+		 */
+		static bool FileInfo( const string &_fileName, uint32 &_size, uint32 &_modified );
+
+		/**
+		 * MapFile. Map a whole file into memory for reading.
+		 * \param string. File name.
+		 * \param uint32. Set to the size of the mapping in bytes.
+		 * \return Pointer to the start of the file, or NULL if it could not be mapped.
+		 * \see UnmapFile.
+		 */
+		static uint8 const* MapFile( const string &_fileName, uint32 &_size );
+
+		/**
+		 * UnmapFile. Release a mapping made by MapFile or CreateSharedFile.
+		 * \param uint8 const*. Pointer returned by MapFile or CreateSharedFile.
+		 * \param uint32. Size of the mapping.
+		 * \see MapFile.
+		 */
+		static void UnmapFile( uint8 const* _data, uint32 _size );
+
+		/**
+		 * CreateSharedFile. Create a file filled with zeros and map it for writing, so that
+		 * other processes mapping the same file see each change as it is made.  An existing
+		 * file is removed first where the platform allows, so that processes still mapping
+		 * it keep the old contents rather than having them cut short.
+		 * \param string. File name.
+		 * \param uint32. Size of the file in bytes.
+		 * \return Pointer to the start of the file, or NULL if it could not be created.
+		 * \see UnmapFile.
+		 */
+		static uint8* CreateSharedFile( const string &_fileName, uint32 _size );
+
 	private:
 		FileOps();
 		~FileOps();
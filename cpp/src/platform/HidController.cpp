@@ -42,6 +42,12 @@
 #define INPUT_REPORT_LENGTH 0x5
 #define OUTPUT_REPORT_LENGTH 0x0
 
+// How long to block on the interrupt endpoint, in milliseconds, before checking
+// for exit.  Until the stick announces rx data, the feature report is polled
+// at the shorter interval instead.
+#define HID_READ_TIMEOUT 100
+#define HID_POLL_INTERVAL 10
+
 using namespace OpenZWave;
 
 //-----------------------------------------------------------------------------
@@ -57,7 +63,8 @@ HidController::HidController
 	m_productId( 0x01 ),	// ControlThink ThinkStick
 	m_serialNumber( "" ),
 	m_hidControllerName( "" ),
-	m_bOpen( false )
+	m_bOpen( false ),
+	m_inputReportsAnnounceRx( false )
 {
 }
 
@@ -156,6 +163,17 @@ bool HidController::Open
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+//	<HidController::GetThreadId>
+//	Get the operating system's id for the read thread
+//-----------------------------------------------------------------------------
+uint64 HidController::GetThreadId
+(
+)
+{
+	return m_thread ? m_thread->GetId() : 0;
+}
+
 //-----------------------------------------------------------------------------
 //	<HidController::Close>
 //	Close a HID port
@@ -214,7 +232,7 @@ void HidController::ThreadProc
 		{
 			// Enter read loop.  Call will only return if
 			// an exit is requested or an error occurs
-			Read();
+			Read( _exitEvent );
 
 			// Reset the attempts, so we get a rapid retry for temporary errors
 			attempts = 0;
@@ -350,12 +368,13 @@ bool HidController::Init
 	CHECK_HIDAPI_RESULT(hidApiResult, HidOpenFailure);
 
 	// Ensure that reads for input reports are blocked.
-	// Input report data is polled in Wait() to check if there are feature
+	// Read() waits on input reports, which say when there are feature
 	// reports waiting to be retrieved that contain ZWave rx packets.
 	hidApiResult = hid_set_nonblocking(m_hHidController, 0);
 	CHECK_HIDAPI_RESULT(hidApiResult, HidOpenFailure);
 
-	// Open successful
+	// Open successful.  Whether this stick announces rx data is learned again.
+	m_inputReportsAnnounceRx = false;
 	m_bOpen = true;
 	return true;
 
@@ -374,74 +393,57 @@ HidOpenFailure:
 //-----------------------------------------------------------------------------
 void HidController::Read
 (
+	Event* _exitEvent
 )
 {
-	uint8 buffer[FEATURE_REPORT_LENGTH];
 	int bytesRead = 0;
 	uint8 inputReport[INPUT_REPORT_LENGTH];
-	TimeStamp readTimer;
 
  	while( true )
 	{
-		// Rx feature report buffer should contain
-		// [0]      - 0x05 (rx feature report ID)
-		// [1]      - length of rx data (or 0x00 and no further bytes if no rx data waiting)
-		// [2]...   - rx data
-	  	// We poll this waiting for data.
-		bytesRead = GetFeatureReport(FEATURE_REPORT_LENGTH, 0x5, buffer);
-		CHECK_HIDAPI_RESULT(bytesRead, HidPortError);
-		if( bytesRead >= 2 )
+		if( Wait::Single( _exitEvent, 0 ) >= 0 )
 		{
+			// Exit signalled
+			return;
+		}
 
-			if( buffer[1] > 0 )
-			{
-				string tmp = "";
-				for (int i = 0; i < buffer[1]; i++)
-				{
-					char bstr[16];
-					snprintf( bstr, sizeof(bstr), "0x%.2x ", buffer[2+i] );
-					tmp += bstr;
-				}
-				Log::Write( LogLevel_Detail, "hid report read=%d ID=%d len=%d %s", bytesRead, buffer[0], buffer[1], tmp.c_str() );
-			}
+		// Block on the interrupt endpoint.  Wayne-Dalton input report data is
+		// structured as follows (best guess):
+		// [0] 0x03      - input report ID
+		// [1] 0x01      - ??? never changes
+		// [2] 0xNN      - if 0x01, no feature reports waiting
+		//                 if 0x02, feature report ID 0x05 is waiting to be retrieved
+		// [3,4] 0xNNNN  - Number of ZWave messages?
+		// Keeping a read hung on it also acknowledges receipt, as the response
+		// seems to convey transaction status.  Until the stick has shown that it
+		// announces rx data this way, the feature report is polled between reads.
+		int timeout = m_inputReportsAnnounceRx ? HID_READ_TIMEOUT : HID_POLL_INTERVAL;
+		int hidApiResult = hid_read_timeout( m_hHidController, inputReport, INPUT_REPORT_LENGTH, timeout );
+		if( hidApiResult < 0 )
+		{
+			const wchar_t* errString = hid_error(m_hHidController);
+			Log::Write( LogLevel_Warning, "Error: HID port returned error reading input bytes: 0x%08hx, HIDAPI error string: %ls", hidApiResult, errString );
+			goto HidPortError;
+		}
 
-			if( buffer[1] > 0 )
+		if( hidApiResult >= 3 && inputReport[2] == 0x02 )
+		{
+			if( !m_inputReportsAnnounceRx )
 			{
-				Put( &buffer[2], buffer[1] );
+				Log::Write( LogLevel_Info, "      HID controller announces rx data in input reports, no longer polling" );
+				m_inputReportsAnnounceRx = true;
 			}
 		}
-		if( readTimer.TimeRemaining() <= 0 )
+		else if( hidApiResult > 0 && m_inputReportsAnnounceRx )
 		{
-			// Hang a hid_read to acknowledge receipt. Seems the response is conveying
-			// transaction status.
-			// Wayne-Dalton input report data is structured as follows (best guess):
-			// [0] 0x03      - input report ID
-			// [1] 0x01      - ??? never changes
-			// [2] 0xNN      - if 0x01, no feature reports waiting
-			//                 if 0x02, feature report ID 0x05 is waiting to be retrieved
-			// [3,4] 0xNNNN  - Number of ZWave messages?
-
-			int hidApiResult = hid_read( m_hHidController, inputReport, INPUT_REPORT_LENGTH );
-			//if( hidApiResult != 0 )
-			//{
-			//	string tmp = "";
-			//	for( int i = 0; i < INPUT_REPORT_LENGTH; i++ )
-			//	{
-			//		char bstr[16];
-			//		snprintf(bstr, sizeof(bstr), "%02x ", inputReport[i] );
-			//		tmp += bstr;
-			//	}
-			//	Log::Write( LogLevel_Detail, "hid read %d %s", hidApiResult, tmp.c_str() );
-			//}
-
-			if( hidApiResult == -1 )
-			{
-				const wchar_t* errString = hid_error(m_hHidController);
-				Log::Write( LogLevel_Warning, "Error: HID port returned error reading input bytes: 0x%08hx, HIDAPI error string: %ls", hidApiResult, errString );
-			}
-			readTimer.SetTime( 100 );
+			// Nothing waiting
+			continue;
 		}
-		m_thread->Sleep(10);
+
+		// An announcement, or a timeout.  After a timeout the feature report is
+		// still checked, in case an announcement was missed.
+		bytesRead = ReadRxReports();
+		CHECK_HIDAPI_RESULT(bytesRead, HidPortError);
 	}
 
 HidPortError:
@@ -449,6 +451,49 @@ HidPortError:
 	Log::Write( LogLevel_Warning, "%ls", hid_error(m_hHidController));
 }
 
+//-----------------------------------------------------------------------------
+// <HidController::ReadRxReports>
+// Retrieve rx feature reports until none are waiting
+//-----------------------------------------------------------------------------
+int HidController::ReadRxReports
+(
+)
+{
+	uint8 buffer[FEATURE_REPORT_LENGTH];
+	while( true )
+	{
+		// Rx feature report buffer should contain
+		// [0]      - 0x05 (rx feature report ID)
+		// [1]      - length of rx data (or 0x00 and no further bytes if no rx data waiting)
+		// [2]...   - rx data
+		int bytesRead = GetFeatureReport(FEATURE_REPORT_LENGTH, 0x5, buffer);
+		if( bytesRead < 0 )
+		{
+			return bytesRead;
+		}
+		if( bytesRead < 2 || buffer[1] == 0 )
+		{
+			return 0;
+		}
+
+		if( buffer[1] > FEATURE_REPORT_LENGTH - 2 )
+		{
+			buffer[1] = FEATURE_REPORT_LENGTH - 2;
+		}
+
+		string tmp = "";
+		for (int i = 0; i < buffer[1]; i++)
+		{
+			char bstr[16];
+			snprintf( bstr, sizeof(bstr), "0x%.2x ", buffer[2+i] );
+			tmp += bstr;
+		}
+		Log::Write( LogLevel_Detail, "hid report read=%d ID=%d len=%d %s", bytesRead, buffer[0], buffer[1], tmp.c_str() );
+
+		Received( &buffer[2], buffer[1] );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <HidController::Write>
 // Send data to the HID port
@@ -485,6 +530,7 @@ uint32 HidController::Write
 
 	Log::Write( LogLevel_Debug, "      HidController::Write (sent to controller)" );
 	LogData(_buffer, _length, "      Write: ");
+	Sent( _buffer, _length );
 
 	int bytesSent = SendFeatureReport(FEATURE_REPORT_LENGTH, hidBuffer);
 	if (bytesSent < 2)
@@ -110,9 +110,16 @@ namespace OpenZWave
 		 */
 		uint32 Write( uint8* _buffer, uint32 _length );
 
+		/**
+		 * Get the operating system's id for the thread reading from the HID controller.
+		 * @return The thread id, or zero if the controller is not open.
+		 */
+		uint64 GetThreadId();
+
 	private:
 		bool Init( uint32 const _attempts );
-		void Read();
+		void Read( Event* _exitEvent );
+		int ReadRxReports();
 
         // helpers for internal use only
 
@@ -143,6 +150,7 @@ namespace OpenZWave
         string          	m_serialNumber;
 		string			m_hidControllerName;
 		bool			m_bOpen;
+		bool			m_inputReportsAnnounceRx;	// Input reports have been seen to say when rx data is waiting, so polling is not needed
 	};
 
 } // namespace OpenZWave
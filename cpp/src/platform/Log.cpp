@@ -30,6 +30,7 @@
 #include "Defs.h"
 #include "platform/Mutex.h"
 #include "platform/Log.h"
+#include "platform/BinaryLog.h"
 
 #ifdef WIN32
 #include "platform/windows/LogImpl.h"	// Platform-specific implementation of a log
@@ -64,6 +65,11 @@ char const *OpenZWave::LogLevelString[] =
 Log* Log::s_instance = NULL;
 i_LogImpl* Log::m_pImpl = NULL;
 bool Log::s_customLogger = false;
+LogLevel Log::s_saveLevel = LogLevel_None;
+LogLevel Log::s_queueLevel = LogLevel_None;
+LogLevel Log::s_dumpTrigger = LogLevel_None;
+volatile uint8 Log::s_nodeLevel[256] = { 0 };
+volatile uint8 Log::s_maxNodeLevel = LogLevel_Invalid;
 static bool s_dologging;
 
 //-----------------------------------------------------------------------------
@@ -77,16 +83,17 @@ Log* Log::Create
 	bool const _bConsoleOutput,
 	LogLevel const _saveLevel,
 	LogLevel const _queueLevel,
-	LogLevel const _dumpTrigger
+	LogLevel const _dumpTrigger,
+	bool const _bBinary			// = false
 )
 {
 	if( NULL == s_instance )
 	{
-		s_instance = new Log( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger );
+		s_instance = new Log( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger, _bBinary );
 		s_dologging = true; // default logging to true so no change to what people experience now
 	} else {
 		Log::Destroy();
-		s_instance = new Log( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger );
+		s_instance = new Log( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger, _bBinary );
 		s_dologging = true; // default logging to true so no change to what people experience now
 	}
 
@@ -194,6 +201,10 @@ void Log::SetLoggingState
 		s_dologging = false;
 	}
 
+	s_saveLevel = _saveLevel;
+	s_queueLevel = _queueLevel;
+	s_dumpTrigger = _dumpTrigger;
+
 	if( s_instance && s_dologging && s_instance->m_pImpl )
 	{
 		s_instance->m_logMutex->Lock();
@@ -226,7 +237,7 @@ void Log::Write
 	...
 )
 {
-	if( s_instance && s_dologging && s_instance->m_pImpl )
+	if( IsEnabled( _level ) )
 	{
 		s_instance->m_logMutex->Lock(); // double locks if recursive
 		va_list args;
@@ -249,19 +260,105 @@ void Log::Write
 	...
 )
 {
-	if( s_instance && s_dologging && s_instance->m_pImpl )
+	if( IsEnabled( _level, _nodeId ) )
 	{
+		LogLevel nodeLevel = (LogLevel)s_nodeLevel[_nodeId];
 		if( _level != LogLevel_Internal )
 			s_instance->m_logMutex->Lock();
 		va_list args;
 		va_start( args, _format );
-		s_instance->m_pImpl->Write( _level, _nodeId, _format, args );
+		if( ( nodeLevel != LogLevel_Invalid ) && !s_customLogger && ( _level != LogLevel_Internal ) )
+		{
+			s_instance->m_pImpl->WriteNode( _level, _nodeId, _format, args, _level <= nodeLevel );
+		}
+		else
+		{
+			s_instance->m_pImpl->Write( _level, _nodeId, _format, args );
+		}
 		va_end( args );
 		if( _level != LogLevel_Internal )
 			s_instance->m_logMutex->Unlock();
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	<Log::IsEnabled>
+//	Return true if an entry at this level would be logged or queued
+//-----------------------------------------------------------------------------
+bool Log::IsEnabled
+(
+	LogLevel _level,
+	uint8 const _nodeId
+)
+{
+	if( !s_instance || !s_dologging || !s_instance->m_pImpl )
+	{
+		return false;
+	}
+
+	// We cannot know what filtering a custom logger applies, so let it see everything
+	if( s_customLogger || _level == LogLevel_Internal )
+	{
+		return true;
+	}
+
+	// A node with its own level is saved by that level rather than the save level.
+	// Without a node, as from OZW_LOG, any node's level may apply.
+	LogLevel saveLevel = (LogLevel)s_nodeLevel[_nodeId];
+	if( saveLevel == LogLevel_Invalid )
+	{
+		saveLevel = s_saveLevel;
+		if( _nodeId == 0 && s_maxNodeLevel > saveLevel )
+		{
+			saveLevel = (LogLevel)s_maxNodeLevel;
+		}
+	}
+
+	// The implementation still has to see entries at or above the dump trigger,
+	// even if they are neither saved nor queued.
+	return( (_level <= saveLevel) || (_level <= s_queueLevel) || (_level <= s_dumpTrigger) );
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::SetNodeLogLevel>
+//	Set the level of the entries about one node that are written
+//-----------------------------------------------------------------------------
+void Log::SetNodeLogLevel
+(
+	uint8 const _nodeId,
+	LogLevel const _level
+)
+{
+	// Node zero is used for entries that are not about a node
+	if( _nodeId == 0 || _level == LogLevel_Internal )
+	{
+		return;
+	}
+	s_nodeLevel[_nodeId] = (uint8)_level;
+
+	uint8 maxLevel = LogLevel_Invalid;
+	for( uint32 i = 1; i < 256; ++i )
+	{
+		if( s_nodeLevel[i] > maxLevel )
+		{
+			maxLevel = s_nodeLevel[i];
+		}
+	}
+	s_maxNodeLevel = maxLevel;
+}
+
+//-----------------------------------------------------------------------------
+//	<Log::GetNodeLogLevel>
+//	Get the level set for a node
+//-----------------------------------------------------------------------------
+LogLevel Log::GetNodeLogLevel
+(
+	uint8 const _nodeId
+)
+{
+	return (LogLevel)s_nodeLevel[_nodeId];
+}
+
 //-----------------------------------------------------------------------------
 //	<Log::QueueDump>
 //	Send queued messages to the log (and empty the queue)
@@ -278,6 +375,24 @@ void Log::QueueDump
 	}
 }
 
+//-----------------------------------------------------------------------------
+//	<Log::GetQueueMemoryUsage>
+//	Bytes used by the queued message queue
+//-----------------------------------------------------------------------------
+uint32 Log::GetQueueMemoryUsage
+(
+)
+{
+	uint32 bytes = 0;
+	if( s_instance && s_instance->m_pImpl )
+	{
+		s_instance->m_logMutex->Lock();
+		bytes = s_instance->m_pImpl->GetQueueMemoryUsage();
+		s_instance->m_logMutex->Unlock();
+	}
+	return bytes;
+}
+
 //-----------------------------------------------------------------------------
 //	<Log::QueueClear>
 //	Empty the queued message queue
@@ -322,13 +437,24 @@ Log::Log
 	bool const _bConsoleOutput,
 	LogLevel const _saveLevel,
 	LogLevel const _queueLevel,
-	LogLevel const _dumpTrigger
+	LogLevel const _dumpTrigger,
+	bool const _bBinary
 ):
 	m_logMutex( new Mutex() )
 {
+		s_saveLevel = _saveLevel;
+		s_queueLevel = _queueLevel;
+		s_dumpTrigger = _dumpTrigger;
 		if (NULL == m_pImpl) {
 			s_customLogger = false;
-			m_pImpl = new LogImpl( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger );
+			if( _bBinary )
+			{
+				m_pImpl = new BinaryLog( _filename, _saveLevel, _queueLevel, _dumpTrigger );
+			}
+			else
+			{
+				m_pImpl = new LogImpl( _filename, _bAppend, _bConsoleOutput, _saveLevel, _queueLevel, _dumpTrigger );
+			}
 		}
 }
 
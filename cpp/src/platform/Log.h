@@ -61,10 +61,13 @@ namespace OpenZWave
 		i_LogImpl() { } ;
 		virtual ~i_LogImpl() { } ;
 		virtual void Write( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args ) = 0;
+		// An entry from a node with its own log level, which has decided whether it is saved
+		virtual void WriteNode( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args, bool const _save ){ Write( _level, _nodeId, _format, _args ); }
 		virtual void QueueDump() = 0;
 		virtual void QueueClear() = 0;
 		virtual void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger ) = 0;
 		virtual void SetLogFileName( const string &_filename ) = 0;
+		virtual uint32 GetQueueMemoryUsage(){ return 0; }		// Bytes held for entries kept until a dump trigger
 	};
 
 	/** \brief Implements a platform-independent log...written to the console and, optionally, a file.
@@ -76,10 +79,13 @@ namespace OpenZWave
 		 * Create a log.
 		 * Creates the cross-platform logging singleton.
 		 * Any previous log will be cleared.
+		 * \param _bBinary if true, the file is a binary log, which records the arguments of each
+		 * entry rather than formatting it.  Read it with BinaryLog::Decode.  _bAppend and
+		 * _bConsoleOutput are ignored.
 		 * \return a pointer to the logging object.
-		 * \see Destroy, Write
+		 * \see Destroy, Write, BinaryLog
 		 */
-		static Log* Create( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel const _saveLevel, LogLevel const _queueLevel, LogLevel const _dumpTrigger );
+		static Log* Create( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel const _saveLevel, LogLevel const _queueLevel, LogLevel const _dumpTrigger, bool const _bBinary = false );
 
 		/**
 		 * Create a log.
@@ -165,6 +171,35 @@ namespace OpenZWave
 		 */
 		static void Write( LogLevel _level, uint8 const _nodeId, char const* _format, ... );
 
+		/**
+		 * \brief Determine whether an entry at the given level would be written or queued.
+		 * Callers on hot paths use this to skip building expensive arguments (such as hex
+		 * dumps of a frame) for entries that would be discarded anyway.
+		 * \param _level	Specifies the type of log message (Error, Warning, Debug, etc.)
+		 * \param _nodeId	Node Id the entry would be about, or zero if that is not known, which allows for the levels set with SetNodeLogLevel.
+		 * \return true if an entry at this level would reach the log or the log queue.
+		 * \see Write
+		 */
+		static bool IsEnabled( LogLevel _level, uint8 const _nodeId = 0 );
+
+		/**
+		 * \brief Set the level of the entries about one node that are written in real-time,
+		 * in place of the save level set with SetLoggingState.  One misbehaving device can be
+		 * traced at LogLevel_Debug while the rest of the network is logged at LogLevel_Warning,
+		 * or a noisy one quietened.  Entries are still queued and trigger queue dumps by the
+		 * levels set with SetLoggingState.  Not applied by a custom logging class.
+		 * \param _nodeId	Node Id, from 1 to 255.
+		 * \param _level	LogLevel of the node's entries to write, or LogLevel_Invalid to go back to the save level.
+		 * \see GetNodeLogLevel, SetLoggingState
+		 */
+		static void SetNodeLogLevel( uint8 const _nodeId, LogLevel const _level );
+
+		/**
+		 * \brief Get the level set for a node with SetNodeLogLevel.
+		 * \return the level, or LogLevel_Invalid if the node is logged at the save level.
+		 */
+		static LogLevel GetNodeLogLevel( uint8 const _nodeId );
+
 		/**
 		 * Send the queued log messages to the log output.
 		 */
@@ -175,15 +210,44 @@ namespace OpenZWave
 		 */
 		static void QueueClear();
 
+		/**
+		 * \return the bytes used to keep log messages until a dump trigger.
+		 */
+		static uint32 GetQueueMemoryUsage();
+
 	private:
-		Log( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
+		Log( string const& _filename, bool const _bAppend, bool const _bConsoleOutput, LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger, bool const _bBinary );
 		~Log();
 
 		static i_LogImpl*	m_pImpl;		/**< Pointer to an object that encapsulates the platform-specific logging implementation. */
 		static Log*	s_instance;
 		static bool	s_customLogger;
+		static LogLevel	s_saveLevel;		/**< Cached copy of the levels handed to the implementation, so IsEnabled need not lock. */
+		static LogLevel	s_queueLevel;
+		static LogLevel	s_dumpTrigger;
+		static volatile uint8	s_nodeLevel[256];	/**< The LogLevel set for each node, or LogLevel_Invalid.  Read without a lock before an entry is formatted. */
+		static volatile uint8	s_maxNodeLevel;		/**< The most verbose of them, for entries whose node is not known */
 		Mutex*		m_logMutex;
 	};
 } // namespace OpenZWave
 
+// The most verbose level that is compiled in.  Building with, for example,
+// -DOPENZWAVE_LOG_MAX_LEVEL=LogLevel_Info removes every OZW_LOG call at
+// LogLevel_Detail and below, arguments and all.
+#ifndef OPENZWAVE_LOG_MAX_LEVEL
+#	define OPENZWAVE_LOG_MAX_LEVEL LogLevel_StreamDetail
+#endif
+
+// Write to the log, only evaluating the arguments if the entry will be kept.
+// Use OZW_LOG( level, format, ... ) or OZW_LOG( level, nodeId, format, ... ),
+// just as with Log::Write, from code that is using namespace OpenZWave.
+#define OZW_LOG( _level, ... ) \
+	do \
+	{ \
+		if( ( ( (_level) <= OPENZWAVE_LOG_MAX_LEVEL ) || ( (_level) == LogLevel_Internal ) ) && Log::IsEnabled( _level ) ) \
+		{ \
+			Log::Write( _level, __VA_ARGS__ ); \
+		} \
+	} while( 0 )
+
 #endif //_Log_H
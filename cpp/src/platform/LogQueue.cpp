@@ -0,0 +1,206 @@
+//-----------------------------------------------------------------------------
+//
+//	LogQueue.cpp
+//
+//	The recent log entries kept in memory, to be written out on an error
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "Defs.h"
+#include "platform/LogQueue.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::LogQueue>
+//	Constructor
+//-----------------------------------------------------------------------------
+LogQueue::LogQueue
+(
+	uint32 const _maxLines,		// = 500
+	uint32 const _size			// = 128 * 1024
+):
+	m_buffer( new char[_size] ),
+	m_size( _size ),
+	m_maxLines( _maxLines ),
+	m_readPos( 0 ),
+	m_writePos( 0 ),
+	m_used( 0 ),
+	m_count( 0 ),
+	m_reserved( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::~LogQueue>
+//	Destructor
+//-----------------------------------------------------------------------------
+LogQueue::~LogQueue
+(
+)
+{
+	delete [] m_buffer;
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::Reserve>
+//	Make room for a line at the write position
+//-----------------------------------------------------------------------------
+char* LogQueue::Reserve
+(
+	uint32& _length
+)
+{
+	if( _length > m_size / 2 )
+	{
+		_length = m_size / 2;
+	}
+	if( _length >= c_skip )
+	{
+		_length = c_skip - 1;
+	}
+
+	if( m_count == 0 )
+	{
+		// Start again from the beginning, so nothing is wasted
+		Clear();
+	}
+
+	uint32 need = c_headerLength + _length;
+	uint32 waste = ( m_writePos + need > m_size ) ? m_size - m_writePos : 0;
+
+	// The free space runs from the write position, round the end of the
+	// buffer, to the read position.  Discard old lines until it can hold
+	// the skipped end of the buffer as well as the new line.
+	while( m_count > 0 && ( m_count >= m_maxLines || m_size - m_used < waste + need ) )
+	{
+		PopFront();
+		if( m_count == 0 )
+		{
+			waste = ( m_writePos + need > m_size ) ? m_size - m_writePos : 0;
+		}
+	}
+
+	if( waste )
+	{
+		if( waste >= c_headerLength )
+		{
+			m_buffer[m_writePos] = (char)( c_skip & 0xff );
+			m_buffer[m_writePos+1] = (char)( c_skip >> 8 );
+		}
+		m_used += waste;
+		m_writePos = 0;
+	}
+
+	m_reserved = _length;
+	return &m_buffer[m_writePos + c_headerLength];
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::Commit>
+//	Keep the line written into the reserved space
+//-----------------------------------------------------------------------------
+void LogQueue::Commit
+(
+	uint32 const _length
+)
+{
+	if( m_reserved == 0 )
+	{
+		return;
+	}
+
+	uint32 length = ( _length < m_reserved ) ? _length : m_reserved - 1;
+	m_buffer[m_writePos] = (char)( length & 0xff );
+	m_buffer[m_writePos+1] = (char)( length >> 8 );
+	m_buffer[m_writePos + c_headerLength + length] = 0;
+
+	uint32 size = c_headerLength + length + 1;
+	m_writePos += size;
+	if( m_writePos == m_size )
+	{
+		m_writePos = 0;
+	}
+	m_used += size;
+	++m_count;
+	m_reserved = 0;
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::Front>
+//	Get the oldest line
+//-----------------------------------------------------------------------------
+char const* LogQueue::Front
+(
+)
+{
+	if( m_count == 0 )
+	{
+		return NULL;
+	}
+
+	SkipEnd();
+	return &m_buffer[m_readPos + c_headerLength];
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::PopFront>
+//	Discard the oldest line
+//-----------------------------------------------------------------------------
+void LogQueue::PopFront
+(
+)
+{
+	if( m_count == 0 )
+	{
+		return;
+	}
+
+	SkipEnd();
+	uint32 length = (uint8)m_buffer[m_readPos] | ( (uint32)(uint8)m_buffer[m_readPos+1] << 8 );
+	uint32 size = c_headerLength + length + 1;
+	m_readPos += size;
+	if( m_readPos == m_size )
+	{
+		m_readPos = 0;
+	}
+	m_used -= size;
+
+	if( --m_count == 0 )
+	{
+		Clear();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<LogQueue::SkipEnd>
+//	If the writer skipped the end of the buffer, carry on from the start
+//-----------------------------------------------------------------------------
+void LogQueue::SkipEnd
+(
+)
+{
+	uint32 remaining = m_size - m_readPos;
+	if( remaining < c_headerLength || ( (uint8)m_buffer[m_readPos] == ( c_skip & 0xff ) && (uint8)m_buffer[m_readPos+1] == ( c_skip >> 8 ) ) )
+	{
+		m_used -= remaining;
+		m_readPos = 0;
+	}
+}
@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+//
+//	LogQueue.h
+//
+//	The recent log entries kept in memory, to be written out on an error
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _LogQueue_H
+#define _LogQueue_H
+
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	/** \brief A ring of text lines in a single preallocated buffer.
+	 *
+	 * Each line is written straight into the buffer, with a two byte length in
+	 * front of it, so keeping a line costs no allocations.  When there is no room
+	 * for a new line, or the ring holds the maximum number of lines, the oldest
+	 * lines are discarded.  A line never wraps around the end of the buffer;
+	 * if it would not fit, the end is skipped and the line goes at the start.
+	 *
+	 * Not thread safe.  The platform LogImpl only uses it from within the log's mutex.
+	 */
+	class LogQueue
+	{
+	public:
+		/**
+		 * Constructor.
+		 * \param _maxLines most lines to keep.
+		 * \param _size size of the buffer in bytes.
+		 */
+		LogQueue( uint32 const _maxLines = 500, uint32 const _size = 128 * 1024 );
+		~LogQueue();
+
+		/**
+		 * Make room for a line, discarding old lines as needed.  Follow with Commit.
+		 * \param _length most bytes the line may need, including its terminating null.
+		 * \return where to write the line.  The length may have been reduced to fit the
+		 * buffer, so the line must be written with a call that truncates, such as snprintf.
+		 */
+		char* Reserve( uint32& _length );
+
+		/**
+		 * Keep the line written after a call to Reserve.
+		 * \param _length the length of the line, not including its terminating null.
+		 * Longer than the reserved space if the line was truncated.
+		 */
+		void Commit( uint32 const _length );
+
+		/**
+		 * \return the oldest line, or NULL if there are none.
+		 */
+		char const* Front();
+
+		/**
+		 * Discard the oldest line.
+		 */
+		void PopFront();
+
+		/**
+		 * Discard all the lines.
+		 */
+		void Clear(){ m_readPos = m_writePos = m_used = m_count = 0; }
+
+		/**
+		 * \return the number of lines kept.
+		 */
+		uint32 GetCount()const{ return m_count; }
+
+		/**
+		 * \return the size of the buffer.  It is allocated in full up front.
+		 */
+		uint32 GetMemoryUsage()const{ return m_size; }
+
+	private:
+		enum
+		{
+			c_headerLength = 2,
+			c_skip = 0xffff						// Length that marks an unused end of the buffer
+		};
+
+		void SkipEnd();							// Move the read position past any unused end of the buffer
+
+		char*	m_buffer;
+		uint32	m_size;
+		uint32	m_maxLines;
+		uint32	m_readPos;						// Header of the oldest line
+		uint32	m_writePos;						// Where the next line's header goes
+		uint32	m_used;							// Bytes from m_readPos to m_writePos, going round the end
+		uint32	m_count;
+		uint32	m_reserved;						// Space given out by the last Reserve, including the null
+	};
+
+} // namespace OpenZWave
+
+#endif //_LogQueue_H
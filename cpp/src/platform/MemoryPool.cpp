@@ -0,0 +1,111 @@
+//-----------------------------------------------------------------------------
+//
+//	MemoryPool.cpp
+//
+//	Recycles fixed size blocks for frequently allocated objects
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include <new>
+
+#include "Defs.h"
+#include "platform/MemoryPool.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<MemoryPool::MemoryPool>
+//	Constructor
+//-----------------------------------------------------------------------------
+MemoryPool::MemoryPool
+(
+	size_t _blockSize,
+	uint32 _maxFree
+):
+	m_blockSize( _blockSize < sizeof(Block) ? sizeof(Block) : _blockSize ),
+	m_maxFree( _maxFree ),
+	m_numFree( 0 ),
+	m_free( NULL ),
+	m_mutex( new Mutex( false ) )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<MemoryPool::Allocate>
+//	Take a block from the free list, or from the heap if it is empty
+//-----------------------------------------------------------------------------
+void* MemoryPool::Allocate
+(
+	size_t _size
+)
+{
+	if( _size <= m_blockSize )
+	{
+		m_mutex->Lock();
+		Block* block = m_free;
+		if( block )
+		{
+			m_free = block->m_next;
+			--m_numFree;
+		}
+		m_mutex->Unlock();
+
+		if( block )
+		{
+			return block;
+		}
+		_size = m_blockSize;
+	}
+
+	return ::operator new( _size );
+}
+
+//-----------------------------------------------------------------------------
+//	<MemoryPool::Free>
+//	Put a block on the free list, unless the list is already full
+//-----------------------------------------------------------------------------
+void MemoryPool::Free
+(
+	void* _block,
+	size_t _size
+)
+{
+	if( _block == NULL )
+	{
+		return;
+	}
+
+	if( _size <= m_blockSize )
+	{
+		m_mutex->Lock();
+		if( m_numFree < m_maxFree )
+		{
+			Block* block = (Block*)_block;
+			block->m_next = m_free;
+			m_free = block;
+			++m_numFree;
+			m_mutex->Unlock();
+			return;
+		}
+		m_mutex->Unlock();
+	}
+
+	::operator delete( _block );
+}
@@ -0,0 +1,82 @@
+//-----------------------------------------------------------------------------
+//
+//	MemoryPool.h
+//
+//	Recycles fixed size blocks for frequently allocated objects
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _MemoryPool_H
+#define _MemoryPool_H
+
+#include <stddef.h>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief A free list of equally sized blocks.
+	 *
+	 * Freed blocks are kept for reuse, up to a limit, instead of going back to the heap.
+	 * A class uses a pool by declaring its own operator new and operator delete that call
+	 * Allocate and Free.  Blocks come from the global operator new, so a block is always
+	 * safe to hand either to the pool or to the global operator delete.  There is
+	 * deliberately no destructor, so that objects deleted during static destruction are
+	 * still handled.
+	 */
+	class MemoryPool
+	{
+	public:
+		/**
+		 * Constructor.
+		 * \param _blockSize size of the blocks the pool recycles.
+		 * \param _maxFree the most freed blocks the pool keeps for reuse.
+		 */
+		MemoryPool( size_t _blockSize, uint32 _maxFree );
+
+		/**
+		 * Get a block, reusing a freed one if there is one.
+		 * \param _size size required.  Larger requests go straight to the heap.
+		 */
+		void* Allocate( size_t _size );
+
+		/**
+		 * Return a block to the pool.
+		 * \param _block the block, which may be NULL.
+		 * \param _size the size that was passed to Allocate.
+		 */
+		void Free( void* _block, size_t _size );
+
+	private:
+		struct Block
+		{
+			Block*		m_next;
+		};
+
+		size_t			m_blockSize;
+		uint32			m_maxFree;
+		uint32			m_numFree;
+		Block*			m_free;
+		Mutex*			m_mutex;
+	};
+
+} // namespace OpenZWave
+
+#endif //_MemoryPool_H
@@ -25,8 +25,10 @@
 //	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
 //
 //-----------------------------------------------------------------------------
+#include <string.h>
 #include "Defs.h"
 #include "platform/Mutex.h"
+#include "platform/TimeStamp.h"
 
 #ifdef WIN32
 #include "platform/windows/MutexImpl.h"	// Platform-specific implementation of a mutex
@@ -39,15 +41,28 @@
 
 using namespace OpenZWave;
 
+// Kept in debug builds, while the mutex is held
+struct Mutex::Tracking
+{
+	Statistics	m_stats;
+	TimeStamp	m_lockedAt;
+};
+
 //-----------------------------------------------------------------------------
 //	<Mutex::Mutex>
 //	Constructor
 //-----------------------------------------------------------------------------
 Mutex::Mutex
 (
+	bool const _recursive // = true
 ):
-	m_pImpl( new MutexImpl() )
+	m_pImpl( new MutexImpl( _recursive ) ),
+	m_tracking( NULL )
 {
+#ifdef DEBUG
+	m_tracking = new Tracking();
+	memset( &m_tracking->m_stats, 0, sizeof(Statistics) );
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -58,6 +73,7 @@ Mutex::~Mutex
 (
 )
 {
+	delete m_tracking;
 	delete m_pImpl;
 }
 
@@ -70,7 +86,38 @@ bool Mutex::Lock
 	bool const _bWait // = true;
 )
 {
-	return m_pImpl->Lock( _bWait );
+	if( !m_tracking )
+	{
+		return m_pImpl->Lock( _bWait );
+	}
+
+	// Only a lock that cannot be had at once is timed
+	bool res = m_pImpl->Lock( false );
+	int32 waited = -1;
+	if( !res && _bWait )
+	{
+		TimeStamp start;
+		res = m_pImpl->Lock( true );
+		waited = -start.TimeRemaining();
+	}
+
+	if( res && ( m_pImpl->m_lockCount == 1 ) )
+	{
+		// Counted under the lock itself
+		Statistics& stats = m_tracking->m_stats;
+		++stats.m_locks;
+		if( waited >= 0 )
+		{
+			++stats.m_contended;
+			stats.m_waitTime += (uint32)waited;
+			if( (uint32)waited > stats.m_maxWaitTime )
+			{
+				stats.m_maxWaitTime = (uint32)waited;
+			}
+		}
+		m_tracking->m_lockedAt.SetTime();
+	}
+	return res;
 }
 
 //-----------------------------------------------------------------------------
@@ -81,9 +128,19 @@ void Mutex::Unlock
 (
 )
 {
+	if( m_tracking && ( m_pImpl->m_lockCount == 1 ) )
+	{
+		uint32 held = (uint32)-m_tracking->m_lockedAt.TimeRemaining();
+		if( held > m_tracking->m_stats.m_maxHoldTime )
+		{
+			m_tracking->m_stats.m_maxHoldTime = held;
+		}
+	}
+
 	m_pImpl->Unlock();
 
-	if( IsSignalled() )
+	// Mutexes are seldom waited on through Wait, so most unlocks skip the watchers' lock
+	if( HasWatchers() && IsSignalled() )
 	{
 		// The mutex has no owners, so notify the watchers
 		Notify();
@@ -101,3 +158,24 @@ bool Mutex::IsSignalled
 	return m_pImpl->IsSignalled();
 }
 
+//-----------------------------------------------------------------------------
+//	<Mutex::GetStatistics>
+//	Get how much the mutex has been waited for
+//-----------------------------------------------------------------------------
+bool Mutex::GetStatistics
+(
+	Statistics* o_stats
+)
+{
+	if( !m_tracking )
+	{
+		memset( o_stats, 0, sizeof(Statistics) );
+		return false;
+	}
+
+	// Copied under the lock without being counted as a use of it
+	m_pImpl->Lock();
+	*o_stats = m_tracking->m_stats;
+	m_pImpl->Unlock();
+	return true;
+}
@@ -39,11 +39,25 @@ namespace OpenZWave
 	class Mutex: public Wait
 	{
 	public:
+		/** \brief How much a mutex has been waited for.  Only kept in builds with DEBUG defined. */
+		struct Statistics
+		{
+			uint32	m_locks;			// Times the mutex was taken, not counting a thread locking it again
+			uint32	m_contended;		// Times a thread had to wait for it
+			uint32	m_waitTime;			// Total time threads spent waiting for it, in milliseconds
+			uint32	m_maxWaitTime;		// Longest wait, in milliseconds
+			uint32	m_maxHoldTime;		// Longest time it was held, in milliseconds
+		};
+
 		/**
 		 * Constructor.
 		 * Creates a mutex object that can be used to serialize access to a shared resource.
+		 * \param _recursive if true, the thread holding the mutex may lock it again, and
+		 * must unlock it as many times.  A mutex that no thread ever locks twice should
+		 * pass false, which is quicker to lock and unlock on Linux and Unix.  A thread
+		 * locking a non-recursive mutex it already holds deadlocks.
 		 */
-		Mutex();
+		Mutex( bool const _recursive = true );
 
 		/**
 		 * Lock the mutex.
@@ -67,6 +81,14 @@ namespace OpenZWave
 		 * Used by the Wait class to test whether the mutex is free.
 		 */
 		virtual bool IsSignalled();
+
+		/**
+		 * Get how much the mutex has been waited for.  Must not be called by a thread
+		 * holding a non-recursive mutex.
+		 * \param o_stats filled with the statistics, or zeros if they are not kept.
+		 * \return false in a build without DEBUG, where they are not kept.
+		 */
+		bool GetStatistics( Statistics* o_stats );
 	protected:
 
 		/**
@@ -80,6 +102,9 @@ namespace OpenZWave
 		Mutex& operator = ( Mutex const& );		// prevent assignment
 
 		MutexImpl*	m_pImpl;					// Pointer to an object that encapsulates the platform-specific implementation of a mutex.
+
+		struct Tracking;
+		Tracking*	m_tracking;					// The statistics, and when the mutex was taken.  NULL unless DEBUG is defined.
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,206 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLock.cpp
+//
+//	Cross-platform reader/writer lock
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include "Defs.h"
+#include "platform/RWLock.h"
+#include "platform/Atomic.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/Wait.h"
+
+using namespace OpenZWave;
+
+#if defined _MSC_VER
+#define OZW_THREAD_LOCAL __declspec( thread )
+#else
+#define OZW_THREAD_LOCAL __thread
+#endif
+
+namespace
+{
+	// The read locks each thread holds, and how many times it has taken each.
+	// A thread rarely holds more than one or two, so a short list will do.
+	struct ReadHold
+	{
+		RWLock const*	m_lock;
+		uint32			m_depth;
+	};
+
+	uint32 const c_maxReadHolds = 16;
+	OZW_THREAD_LOCAL ReadHold s_readHolds[c_maxReadHolds];
+
+	// Find this thread's entry for a lock, or a free one if _add is set
+	ReadHold* FindReadHold( RWLock const* _lock, bool const _add )
+	{
+		ReadHold* free = NULL;
+		for( uint32 i = 0; i < c_maxReadHolds; ++i )
+		{
+			if( s_readHolds[i].m_lock == _lock )
+			{
+				return &s_readHolds[i];
+			}
+			if( !free && !s_readHolds[i].m_lock )
+			{
+				free = &s_readHolds[i];
+			}
+		}
+		if( _add && free )
+		{
+			free->m_lock = _lock;
+			free->m_depth = 0;
+			return free;
+		}
+		return NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::RWLock>
+//	Constructor
+//-----------------------------------------------------------------------------
+RWLock::RWLock
+(
+):
+	m_writer( new Mutex() ),
+	m_drained( new Event() ),
+	m_readers( 0 ),
+	m_depth( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::~RWLock>
+//	Destructor
+//-----------------------------------------------------------------------------
+RWLock::~RWLock
+(
+)
+{
+	m_drained->Release();
+	m_writer->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::Lock>
+//	Take the write lock
+//-----------------------------------------------------------------------------
+void RWLock::Lock
+(
+)
+{
+	// Holding the mutex keeps new readers out while the current ones finish
+	m_writer->Lock();
+	if( AtomicIncrement( &m_depth ) == 1 )
+	{
+		while( true )
+		{
+			// Reset before looking, so that the last reader's Set cannot be missed
+			m_drained->Reset();
+			if( AtomicLoad( &m_readers ) == 0 )
+			{
+				break;
+			}
+			Wait::Single( m_drained );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::Unlock>
+//	Release the write lock
+//-----------------------------------------------------------------------------
+void RWLock::Unlock
+(
+)
+{
+	AtomicDecrement( &m_depth );
+	m_writer->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::LockShared>
+//	Take the read lock
+//-----------------------------------------------------------------------------
+void RWLock::LockShared
+(
+)
+{
+	// A thread that already holds the read lock takes it again without the
+	// mutex, since it must not queue behind a writer that is waiting for it.
+	// While it holds the lock, no writer can have started.
+	ReadHold* hold = FindReadHold( this, true );
+	if( hold && hold->m_depth != 0 )
+	{
+		AtomicIncrement( &m_readers );
+		++hold->m_depth;
+		return;
+	}
+
+	// Otherwise the mutex is only held long enough to be counted in, so other
+	// threads wait while a writer holds the lock or is waiting for it.  The
+	// writer's own thread gets it straight away, since it is recursive.
+	m_writer->Lock();
+	AtomicIncrement( &m_readers );
+	m_writer->Unlock();
+
+	// Without a free entry the thread is still counted in, but a nested read
+	// lock will go through the mutex as well
+	if( hold )
+	{
+		hold->m_depth = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::UnlockShared>
+//	Release the read lock
+//-----------------------------------------------------------------------------
+void RWLock::UnlockShared
+(
+)
+{
+	if( ReadHold* hold = FindReadHold( this, false ) )
+	{
+		if( --hold->m_depth == 0 )
+		{
+			hold->m_lock = NULL;
+		}
+	}
+
+	if( AtomicDecrement( &m_readers ) == 0 )
+	{
+		m_drained->Set();
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<RWLock::IsLocked>
+//	Test whether any thread holds the lock
+//-----------------------------------------------------------------------------
+bool RWLock::IsLocked
+(
+)
+{
+	return( AtomicLoad( &m_depth ) != 0 || AtomicLoad( &m_readers ) != 0 );
+}
@@ -0,0 +1,104 @@
+//-----------------------------------------------------------------------------
+//
+//	RWLock.h
+//
+//	Cross-platform reader/writer lock
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _RWLock_H
+#define _RWLock_H
+
+#include "Defs.h"
+#include "platform/Ref.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+	class Event;
+
+	/** \brief A lock that many readers can share, or one writer can hold.
+	 *
+	 * The write lock is recursive, like a Mutex, and the thread holding it may also take
+	 * the read lock.  Other threads' readers wait while a writer holds the lock or is
+	 * waiting for the readers to finish.  Only a thread that already holds the read lock
+	 * takes it again straight away, so that it does not queue behind that writer.
+	 * A thread holding the read lock must not go on to take the write lock.
+	 */
+	class RWLock: public Ref
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates an unlocked reader/writer lock.
+		 */
+		RWLock();
+
+		/**
+		 * Take the write lock, waiting for the current readers and writer to finish.
+		 * There must be a matching call to Unlock for every call to Lock.
+		 * \see Unlock, LockShared
+		 */
+		void Lock();
+
+		/**
+		 * Release the write lock.
+		 * \see Lock
+		 */
+		void Unlock();
+
+		/**
+		 * Take the read lock, waiting for any writer to finish.
+		 * There must be a matching call to UnlockShared for every call to LockShared.
+		 * \see UnlockShared, Lock
+		 */
+		void LockShared();
+
+		/**
+		 * Release the read lock.
+		 * \see LockShared
+		 */
+		void UnlockShared();
+
+		/**
+		 * Test whether any thread holds the lock, in either mode.
+		 * \return true if there is a writer or at least one reader.
+		 */
+		bool IsLocked();
+
+	protected:
+		/**
+		 * Destructor.
+		 * Destroys the lock object.
+		 */
+		virtual ~RWLock();
+
+	private:
+		RWLock( RWLock const& );					// prevent copy
+		RWLock& operator = ( RWLock const& );		// prevent assignment
+
+		Mutex*			m_writer;					// Held by the writer, and briefly by each reader as it starts
+		Event*			m_drained;					// Set when the last reader finishes
+		volatile uint32	m_readers;
+		volatile uint32	m_depth;					// Number of times the writer has taken the lock
+	};
+
+} // namespace OpenZWave
+
+#endif //_RWLock_H
@@ -31,6 +31,7 @@
 #pragma once
 
 #include "Defs.h"
+#include "platform/Atomic.h"
 
 namespace OpenZWave
 {
@@ -40,7 +41,8 @@ namespace OpenZWave
 	 * Derived classes must declare their destructor as protected virtual.
 	 * On construction, the reference count is set to one.  Calls to AddRef increment 
 	 * the count.  Calls to Release decrement the count.  When the count reaches
-	 * zero, the object is deleted.
+	 * zero, the object is deleted.  The count is changed atomically, so
+	 * threads that share an object may add and remove references at once.
 	 */
 	class Ref
 	{
@@ -52,28 +54,38 @@ namespace OpenZWave
 		 */
 		Ref(){ m_refs = 1; }
 
+		/**
+		 * A copy is a new object, with its own single reference.  The count of the
+		 * original, which other threads may be changing, is not read.
+		 */
+		Ref( Ref const& ){ m_refs = 1; }
+		Ref& operator = ( Ref const& ){ return *this; }
+
 		/**
 		 * Increases the reference count of the object.
 		 * Every call to AddRef requires a matching call
 		 * to Release before the object will be deleted.
 		 * \see Release
 		 */
-		void AddRef(){ ++m_refs; }
+		void AddRef(){ AtomicIncrementRelaxed( &m_refs ); }
 
 		/**
 		 * Removes a reference to an object.
 		 * If this was the last reference to the message, the 
-		 * object is deleted.
+		 * object is deleted.  The decrement orders the memory accesses around it,
+		 * so whatever a thread did with the object before releasing it is seen
+		 * by the thread that deletes it.
 		 * \see AddRef
 		 */
 		int32 Release()
 		{
-			if( 0 >= ( --m_refs ) )
+			int32 refs = (int32)AtomicDecrement( &m_refs );
+			if( 0 >= refs )
 			{
 				delete this;
 				return 0;
 			}
-			return m_refs;
+			return refs;
 		}
 
 	protected:
@@ -81,7 +93,7 @@ namespace OpenZWave
 
 	private:
 		// Reference counting
-		int32	m_refs;
+		volatile uint32	m_refs;
 
 	}; // class Ref
 
@@ -0,0 +1,190 @@
+//-----------------------------------------------------------------------------
+//
+//	ReplayController.cpp
+//
+//	Plays back a trace of the traffic from a controller
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "Defs.h"
+#include "Options.h"
+#include "platform/ReplayController.h"
+#include "platform/Thread.h"
+#include "platform/Event.h"
+#include "platform/TimeStamp.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+// Room in the driver's stream, which is also the size the Controller gives it
+static uint32 const c_streamSize = 2048;
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::ReplayController>
+//	Constructor
+//-----------------------------------------------------------------------------
+ReplayController::ReplayController
+(
+):
+	m_thread( NULL ),
+	m_speed( 1 ),
+	m_bOpen( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::~ReplayController>
+//	Destructor
+//-----------------------------------------------------------------------------
+ReplayController::~ReplayController
+(
+)
+{
+	Close();
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::Open>
+//	Load a trace and start playing it back
+//-----------------------------------------------------------------------------
+bool ReplayController::Open
+(
+	string const& _filename
+)
+{
+	if( m_bOpen )
+	{
+		return false;
+	}
+
+	if( !ControllerTrace::Load( _filename, m_records ) )
+	{
+		return false;
+	}
+
+	Options::Get()->GetOptionAsInt( "TraceReplaySpeed", &m_speed );
+	if( m_speed < 0 )
+	{
+		m_speed = 1;
+	}
+
+	m_filename = _filename;
+	Log::Write( LogLevel_Info, "Replaying %d records from %s, at %dx speed", (uint32)m_records.size(), _filename.c_str(), m_speed );
+
+	m_bOpen = true;
+	m_thread = new Thread( "ReplayController" );
+	m_thread->Start( ThreadEntryPoint, this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::Close>
+//	Stop playing back the trace
+//-----------------------------------------------------------------------------
+bool ReplayController::Close
+(
+)
+{
+	if( !m_bOpen )
+	{
+		return false;
+	}
+
+	m_thread->Stop();
+	m_thread->Release();
+	m_thread = NULL;
+
+	m_records.clear();
+	m_bOpen = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::Write>
+//	Discard what the driver writes
+//-----------------------------------------------------------------------------
+uint32 ReplayController::Write
+(
+	uint8* _buffer,
+	uint32 _length
+)
+{
+	if( !m_bOpen )
+	{
+		return 0;
+	}
+
+	Log::Write( LogLevel_StreamDetail, "      ReplayController::Write (discarded)" );
+	LogData( _buffer, _length, "      Write: " );
+	return _length;
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::ThreadEntryPoint>
+//	Entry point of the thread that plays back the trace
+//-----------------------------------------------------------------------------
+void ReplayController::ThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	ReplayController* rc = (ReplayController*)_context;
+	if( rc )
+	{
+		rc->ThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<ReplayController::ThreadProc>
+//	Feed the recorded reads to the driver as they come due
+//-----------------------------------------------------------------------------
+void ReplayController::ThreadProc
+(
+	Event* _exitEvent
+)
+{
+	TimeStamp start;
+	for( vector<ControllerTrace::Record>::const_iterator it = m_records.begin(); it != m_records.end(); ++it )
+	{
+		if( it->m_direction != ControllerTrace::Direction_FromController || it->m_data.empty() )
+		{
+			continue;
+		}
+
+		int32 due = m_speed ? (int32)( it->m_time / (uint32)m_speed ) : 0;
+		int32 wait = due + start.TimeRemaining();
+		while( wait > 0 || c_streamSize - GetDataSize() < it->m_data.size() )
+		{
+			// Wait for the record to come due, or for the driver to make room for it
+			if( Wait::Single( _exitEvent, wait > 0 ? wait : 1 ) == 0 )
+			{
+				return;
+			}
+			wait = due + start.TimeRemaining();
+		}
+
+		Received( &it->m_data[0], (uint32)it->m_data.size() );
+	}
+
+	Log::Write( LogLevel_Info, "Replay of %s finished", m_filename.c_str() );
+	Wait::Single( _exitEvent );
+}
@@ -0,0 +1,101 @@
+//-----------------------------------------------------------------------------
+//
+//	ReplayController.h
+//
+//	Plays back a trace of the traffic from a controller
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ReplayController_H
+#define _ReplayController_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "platform/Controller.h"
+#include "platform/ControllerTrace.h"
+
+namespace OpenZWave
+{
+	class Thread;
+	class Event;
+
+	/** \brief A controller that plays back a trace recorded with the ControllerTrace option.
+	 *
+	 * Everything the real controller sent is fed to the driver again, at the times it was
+	 * recorded divided by the TraceReplaySpeed option (0 plays it back as fast as the driver
+	 * reads it).  What the driver writes is accepted and discarded.
+	 */
+	class ReplayController: public Controller
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates an object that plays back a trace.
+		 */
+		ReplayController();
+
+		/**
+		 * Destructor.
+		 * Destroys the replay controller object.
+		 */
+		virtual ~ReplayController();
+
+		/**
+		 * Open a trace and start playing it back.
+		 * @param _filename The trace file.
+		 * @return True if the trace was loaded.
+		 * @see Close, Read, Write
+		 */
+		bool Open( string const& _filename );
+
+		/**
+		 * Stop playing back the trace.
+		 * @return True if the trace was closed, or false if it was already closed.
+		 * @see Open
+		 */
+		bool Close();
+
+		/**
+		 * Write to the replay controller.  The data is discarded.
+		 * @param _buffer Pointer to a block of memory containing the data to be written.
+		 * @param _length Length in bytes of the data.
+		 * @return The number of bytes written.
+		 * @see Read, Open, Close
+		 */
+		uint32 Write( uint8* _buffer, uint32 _length );
+
+	private:
+		static void ThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ThreadProc( Event* _exitEvent );
+
+		Thread*			m_thread;
+		int32			m_speed;
+		bool			m_bOpen;
+		string			m_filename;
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<ControllerTrace::Record>	m_records;
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ReplayController_H
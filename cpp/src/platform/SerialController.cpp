@@ -179,9 +179,18 @@ uint32 SerialController::Write
 
 	Log::Write( LogLevel_StreamDetail, "      SerialController::Write (sent to controller)" );
 	LogData(_buffer, _length, "      Write: ");
+	Sent( _buffer, _length );
 
 	return( m_pImpl->Write( _buffer, _length ) );
 }
 
-
-
+//-----------------------------------------------------------------------------
+//	<SerialController::GetThreadId>
+//	Get the operating system's id for the read thread
+//-----------------------------------------------------------------------------
+uint64 SerialController::GetThreadId
+(
+)
+{
+	return m_pImpl->GetThreadId();
+}
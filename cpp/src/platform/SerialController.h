@@ -122,6 +122,12 @@ namespace OpenZWave
 		 */
 		uint32 Write( uint8* _buffer, uint32 _length );
 
+		/**
+		 * Get the operating system's id for the thread reading from the serial port.
+		 * @return The thread id, or zero if the port is not open.
+		 */
+		uint64 GetThreadId();
+
    	private:
         uint32                      m_baud;
         SerialController::Parity    m_parity;
@@ -0,0 +1,863 @@
+//-----------------------------------------------------------------------------
+//
+//	SimulatedController.cpp
+//
+//	A Z-Wave controller and network simulated in software
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdlib.h>
+#include <string.h>
+#include "Defs.h"
+#include "Checksum.h"
+#include "Utils.h"
+#include "platform/SimulatedController.h"
+#include "platform/Thread.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+// The simulated network
+static uint32 const c_homeId = 0x0badc0de;
+static uint8 const c_controllerNodeId = 1;
+
+// Room in the driver's stream, which is also the size the Controller gives it
+static uint32 const c_streamSize = 2048;
+
+// The command classes every virtual node supports, as sent in its node information frame
+static uint8 const c_commandClasses[] =
+{
+	0x25,		// COMMAND_CLASS_SWITCH_BINARY
+	0x27,		// COMMAND_CLASS_SWITCH_ALL
+	0x31,		// COMMAND_CLASS_SENSOR_MULTILEVEL
+	0x72,		// COMMAND_CLASS_MANUFACTURER_SPECIFIC
+	0x86		// COMMAND_CLASS_VERSION
+};
+
+// The Serial API functions the simulated controller answers
+static uint8 const c_supportedFunctions[] =
+{
+	FUNC_ID_SERIAL_API_GET_INIT_DATA,
+	FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION,
+	FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES,
+	FUNC_ID_SERIAL_API_SET_TIMEOUTS,
+	FUNC_ID_SERIAL_API_GET_CAPABILITIES,
+	FUNC_ID_ZW_SEND_DATA,
+	FUNC_ID_ZW_GET_VERSION,
+	FUNC_ID_ZW_MEMORY_GET_ID,
+	FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO,
+	FUNC_ID_ZW_GET_SUC_NODE_ID,
+	FUNC_ID_ZW_REQUEST_NODE_INFO,
+	FUNC_ID_ZW_GET_ROUTING_INFO
+};
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::SimulatedController>
+//	Constructor
+//-----------------------------------------------------------------------------
+SimulatedController::SimulatedController
+(
+):
+	m_thread( NULL ),
+	m_wakeEvent( new Event() ),
+	m_mutex( new Mutex() ),
+	m_bOpen( false ),
+	m_nodeCount( 4 ),
+	m_latency( 10 ),
+	m_jitter( 0 ),
+	m_loss( 0 ),
+	m_reportInterval( 0 ),
+	m_seed( 1 ),
+	m_nextReport( 0 ),
+	m_nextReportNode( 0 )
+{
+	memset( m_nodes, 0, sizeof(m_nodes) );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::~SimulatedController>
+//	Destructor
+//-----------------------------------------------------------------------------
+SimulatedController::~SimulatedController
+(
+)
+{
+	Close();
+	m_mutex->Release();
+	m_wakeEvent->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Open>
+//	Build the virtual network and start delivering its frames
+//-----------------------------------------------------------------------------
+bool SimulatedController::Open
+(
+	string const& _settings
+)
+{
+	if( m_bOpen )
+	{
+		return false;
+	}
+
+	if( !ParseSettings( _settings ) )
+	{
+		return false;
+	}
+
+	for( uint32 i=0; i<m_nodeCount; ++i )
+	{
+		VirtualNode& node = m_nodes[c_controllerNodeId + 1 + i];
+		node.m_on = false;
+		node.m_temperature = (int16)( 180 + Random() % 80 );
+	}
+
+	Log::Write( LogLevel_Info, "Simulated controller with %d nodes, latency %dms (+%dms), %d%% loss, reports every %dms",
+		m_nodeCount, m_latency, m_jitter, m_loss, m_reportInterval );
+
+	m_start.SetTime();
+	m_nextReport = m_reportInterval;
+	m_nextReportNode = 0;
+	m_bOpen = true;
+
+	m_thread = new Thread( "SimulatedController" );
+	m_thread->Start( ThreadEntryPoint, this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Close>
+//	Stop delivering frames
+//-----------------------------------------------------------------------------
+bool SimulatedController::Close
+(
+)
+{
+	if( !m_bOpen )
+	{
+		return false;
+	}
+
+	m_thread->Stop();
+	m_thread->Release();
+	m_thread = NULL;
+
+	LockGuard LG(m_mutex);
+	m_pending.clear();
+	m_bOpen = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Write>
+//	Acknowledge and answer the frames written by the driver
+//-----------------------------------------------------------------------------
+uint32 SimulatedController::Write
+(
+	uint8* _buffer,
+	uint32 _length
+)
+{
+	if( !m_bOpen )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Simulated controller is not open" );
+		return 0;
+	}
+
+	LockGuard LG(m_mutex);
+	uint32 i = 0;
+	while( i < _length )
+	{
+		if( _buffer[i] != SOF )
+		{
+			// The driver's ACK, NAK and CAN need no answer
+			++i;
+			continue;
+		}
+
+		uint32 frameLength = ( i + 1 < _length ) ? (uint32)_buffer[i+1] + 2 : 0;
+		if( frameLength < 5 || i + frameLength > _length )
+		{
+			// The driver always writes whole frames, so this one cannot be completed
+			Log::Write( LogLevel_Warning, "WARNING: Simulated controller received a truncated frame" );
+			break;
+		}
+
+		HandleFrame( &_buffer[i], frameLength );
+		i += frameLength;
+	}
+
+	m_wakeEvent->Set();
+	return _length;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::ParseSettings>
+//	Read the comma separated settings that describe the network
+//-----------------------------------------------------------------------------
+bool SimulatedController::ParseSettings
+(
+	string const& _settings
+)
+{
+	size_t pos = 0;
+	while( pos < _settings.size() )
+	{
+		size_t end = _settings.find( ',', pos );
+		if( end == string::npos )
+		{
+			end = _settings.size();
+		}
+
+		string setting = _settings.substr( pos, end - pos );
+		pos = end + 1;
+
+		size_t equals = setting.find( '=' );
+		if( equals == string::npos )
+		{
+			// Anything without a value, such as a name for the network, is ignored
+			continue;
+		}
+
+		string name = setting.substr( 0, equals );
+		char const* str = setting.c_str() + equals + 1;
+		char* pStop;
+		long value = strtol( str, &pStop, 10 );
+		if( pStop == str || *pStop || value < 0 )
+		{
+			Log::Write( LogLevel_Error, "ERROR: Simulated controller setting %s is not a number", setting.c_str() );
+			return false;
+		}
+
+		if( name == "nodes" )
+		{
+			if( value < 1 || value > 231 )
+			{
+				Log::Write( LogLevel_Error, "ERROR: Simulated controller can have from 1 to 231 nodes" );
+				return false;
+			}
+			m_nodeCount = (uint32)value;
+		}
+		else if( name == "latency" )
+		{
+			m_latency = (int32)value;
+		}
+		else if( name == "jitter" )
+		{
+			m_jitter = (int32)value;
+		}
+		else if( name == "loss" )
+		{
+			if( value > 100 )
+			{
+				Log::Write( LogLevel_Error, "ERROR: Simulated controller loss is a percentage" );
+				return false;
+			}
+			m_loss = (uint32)value;
+		}
+		else if( name == "report" )
+		{
+			m_reportInterval = (int32)value;
+		}
+		else if( name == "seed" )
+		{
+			m_seed = (uint32)value;
+		}
+		else
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Unknown simulated controller setting %s", name.c_str() );
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Now>
+//	Milliseconds since the controller was opened
+//-----------------------------------------------------------------------------
+int32 SimulatedController::Now
+(
+)
+{
+	return -m_start.TimeRemaining();
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Random>
+//	Next number from a linear congruential generator, so runs can be repeated
+//-----------------------------------------------------------------------------
+uint32 SimulatedController::Random
+(
+)
+{
+	m_seed = m_seed * 1664525 + 1013904223;
+	return m_seed >> 8;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Latency>
+//	How long a frame takes to cross the simulated network
+//-----------------------------------------------------------------------------
+int32 SimulatedController::Latency
+(
+)
+{
+	if( m_jitter > 0 )
+	{
+		return m_latency + (int32)( Random() % (uint32)( m_jitter + 1 ) );
+	}
+	return m_latency;
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Lost>
+//	Whether a frame crossing the simulated network is lost
+//-----------------------------------------------------------------------------
+bool SimulatedController::Lost
+(
+)
+{
+	return( m_loss && ( Random() % 100 ) < m_loss );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Queue>
+//	Queue a frame for the driver, to be delivered after a delay
+//-----------------------------------------------------------------------------
+void SimulatedController::Queue
+(
+	int32 const _delay,
+	uint8 const _type,
+	uint8 const _function,
+	uint8 const* _payload,
+	uint32 const _length
+)
+{
+	vector<uint8> data;
+	data.reserve( _length + 5 );
+	data.push_back( SOF );
+	data.push_back( (uint8)( _length + 3 ) );
+	data.push_back( _type );
+	data.push_back( _function );
+	data.insert( data.end(), _payload, _payload + _length );
+	data.push_back( XorChecksum( &data[1], (uint32)data.size() - 1 ) );
+	Queue( _delay, data );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::Queue>
+//	Queue raw data for the driver, to be delivered after a delay
+//-----------------------------------------------------------------------------
+void SimulatedController::Queue
+(
+	int32 const _delay,
+	vector<uint8>& _data
+)
+{
+	int32 due = Now() + _delay;
+
+	// Frames due at the same time keep the order they were queued in
+	list<Pending>::iterator it = m_pending.end();
+	while( it != m_pending.begin() )
+	{
+		list<Pending>::iterator prev = it;
+		--prev;
+		if( prev->m_due <= due )
+		{
+			break;
+		}
+		it = prev;
+	}
+	it = m_pending.insert( it, Pending() );
+	it->m_due = due;
+	it->m_data.swap( _data );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::QueueNodeCommand>
+//	Queue a command class message from a virtual node
+//-----------------------------------------------------------------------------
+void SimulatedController::QueueNodeCommand
+(
+	int32 const _delay,
+	uint8 const _nodeId,
+	uint8 const* _command,
+	uint32 const _length
+)
+{
+	uint8 payload[64];
+	payload[0] = 0;								// Receive status
+	payload[1] = _nodeId;
+	payload[2] = (uint8)_length;
+	memcpy( &payload[3], _command, _length );
+	Queue( _delay, REQUEST, FUNC_ID_APPLICATION_COMMAND_HANDLER, payload, _length + 3 );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::HandleFrame>
+//	Acknowledge a frame from the driver and answer it as a static controller would
+//-----------------------------------------------------------------------------
+void SimulatedController::HandleFrame
+(
+	uint8 const* _frame,
+	uint32 const _length
+)
+{
+	bool valid = ( _frame[_length-1] == XorChecksum( &_frame[1], _length-2 ) );
+	vector<uint8> reply( 1, valid ? ACK : NAK );
+	Queue( 0, reply );
+	if( !valid )
+	{
+		return;
+	}
+
+	uint8 const function = _frame[3];
+	uint8 const* data = &_frame[4];
+	uint8 payload[64];
+	uint32 length = 0;
+	memset( payload, 0, sizeof(payload) );
+
+	switch( function )
+	{
+		case FUNC_ID_ZW_GET_VERSION:
+		{
+			static char const c_version[] = "Z-Wave 4.05";
+			memcpy( payload, c_version, sizeof(c_version) );
+			length = sizeof(c_version);
+			payload[length++] = 0x01;					// Static controller library
+			break;
+		}
+		case FUNC_ID_ZW_MEMORY_GET_ID:
+		{
+			payload[length++] = (uint8)( c_homeId >> 24 );
+			payload[length++] = (uint8)( c_homeId >> 16 );
+			payload[length++] = (uint8)( c_homeId >> 8 );
+			payload[length++] = (uint8)c_homeId;
+			payload[length++] = c_controllerNodeId;
+			break;
+		}
+		case FUNC_ID_ZW_GET_CONTROLLER_CAPABILITIES:
+		{
+			payload[length++] = 0x08;					// The real primary
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_CAPABILITIES:
+		{
+			payload[length++] = 5;						// Serial API version
+			payload[length++] = 0;
+			length += 6;								// Manufacturer, product type and id
+			for( uint32 i=0; i<sizeof(c_supportedFunctions); ++i )
+			{
+				payload[length + ( c_supportedFunctions[i] - 1 ) / 8] |= 1 << ( ( c_supportedFunctions[i] - 1 ) % 8 );
+			}
+			length += 32;
+			break;
+		}
+		case FUNC_ID_ZW_GET_SUC_NODE_ID:
+		{
+			payload[length++] = c_controllerNodeId;
+			break;
+		}
+		case FUNC_ID_SERIAL_API_GET_INIT_DATA:
+		{
+			payload[length++] = 5;
+			payload[length++] = 0x08;					// SUC
+			payload[length++] = NUM_NODE_BITFIELD_BYTES;
+			for( uint32 i=0; i<m_nodeCount; ++i )
+			{
+				uint8 nodeId = (uint8)( c_controllerNodeId + 1 + i );
+				payload[length + ( nodeId - 1 ) / 8] |= 1 << ( ( nodeId - 1 ) % 8 );
+			}
+			length += NUM_NODE_BITFIELD_BYTES;
+			payload[length++] = 5;						// Chip type and version
+			payload[length++] = 0;
+			break;
+		}
+		case FUNC_ID_SERIAL_API_SET_TIMEOUTS:
+		{
+			payload[length++] = data[0];
+			payload[length++] = data[1];
+			break;
+		}
+		case FUNC_ID_SERIAL_API_APPL_NODE_INFORMATION:
+		{
+			// No reply
+			return;
+		}
+		case FUNC_ID_ZW_GET_NODE_PROTOCOL_INFO:
+		{
+			if( data[0] == c_controllerNodeId )
+			{
+				// A static controller
+				payload[length++] = 0x92;
+				payload[length++] = 0x16;
+				payload[length++] = 0x00;
+				payload[length++] = 0x02;
+				payload[length++] = 0x02;
+				payload[length++] = 0x01;
+			}
+			else
+			{
+				// A listening, routing binary switch
+				payload[length++] = 0xd3;
+				payload[length++] = 0x9c;
+				payload[length++] = 0x00;
+				payload[length++] = 0x04;
+				payload[length++] = 0x10;
+				payload[length++] = 0x01;
+			}
+			break;
+		}
+		case FUNC_ID_ZW_GET_ROUTING_INFO:
+		{
+			// Every node can hear every other
+			for( uint32 i=0; i<m_nodeCount + 1; ++i )
+			{
+				uint8 nodeId = (uint8)( c_controllerNodeId + i );
+				if( nodeId != data[0] )
+				{
+					payload[( nodeId - 1 ) / 8] |= 1 << ( ( nodeId - 1 ) % 8 );
+				}
+			}
+			length = NUM_NODE_BITFIELD_BYTES;
+			break;
+		}
+		case FUNC_ID_ZW_REQUEST_NODE_INFO:
+		{
+			uint8 nodeId = data[0];
+			bool known = ( nodeId > c_controllerNodeId ) && ( nodeId <= c_controllerNodeId + m_nodeCount );
+			payload[length++] = 1;
+			Queue( 0, RESPONSE, function, payload, length );
+
+			length = 0;
+			if( !known || Lost() )
+			{
+				payload[length++] = UPDATE_STATE_NODE_INFO_REQ_FAILED;
+				payload[length++] = 0;
+				payload[length++] = 0;
+				Queue( 2 * Latency(), REQUEST, FUNC_ID_ZW_APPLICATION_UPDATE, payload, length );
+				return;
+			}
+
+			payload[length++] = UPDATE_STATE_NODE_INFO_RECEIVED;
+			payload[length++] = nodeId;
+			payload[length++] = (uint8)( 3 + sizeof(c_commandClasses) );
+			payload[length++] = 0x04;
+			payload[length++] = 0x10;
+			payload[length++] = 0x01;
+			memcpy( &payload[length], c_commandClasses, sizeof(c_commandClasses) );
+			length += sizeof(c_commandClasses);
+			Queue( 2 * Latency(), REQUEST, FUNC_ID_ZW_APPLICATION_UPDATE, payload, length );
+			return;
+		}
+		case FUNC_ID_ZW_SEND_DATA:
+		{
+			HandleSendData( _frame, _length );
+			return;
+		}
+		default:
+		{
+			// Not in the capabilities we reported, so the driver should not be waiting for it
+			Log::Write( LogLevel_Warning, "WARNING: Simulated controller does not handle function 0x%.2x", function );
+			return;
+		}
+	}
+
+	Queue( 0, RESPONSE, function, payload, length );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::HandleSendData>
+//	Deliver a message to a virtual node, and complete the transmission
+//-----------------------------------------------------------------------------
+void SimulatedController::HandleSendData
+(
+	uint8 const* _frame,
+	uint32 const _length
+)
+{
+	// SOF, length, type, function, node, data length, data, transmit options, callback and checksum
+	uint8 const nodeId = _frame[4];
+	uint32 const commandLength = _frame[5];
+	uint8 const callbackId = _frame[_length-2];
+	if( commandLength + 9 > _length )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Simulated controller received a malformed ZW_SEND_DATA" );
+		return;
+	}
+
+	uint8 payload[2];
+	payload[0] = 1;
+	Queue( 0, RESPONSE, FUNC_ID_ZW_SEND_DATA, payload, 1 );
+
+	bool known = ( nodeId > c_controllerNodeId ) && ( nodeId <= c_controllerNodeId + m_nodeCount );
+	bool delivered = known && !Lost();
+	int32 delay = Latency();
+	if( !delivered )
+	{
+		// The controller tries the other routes before giving up
+		delay *= 3;
+	}
+
+	if( callbackId )
+	{
+		payload[0] = callbackId;
+		payload[1] = delivered ? TRANSMIT_COMPLETE_OK : TRANSMIT_COMPLETE_NO_ACK;
+		Queue( delay, REQUEST, FUNC_ID_ZW_SEND_DATA, payload, 2 );
+	}
+
+	uint8 reply[32];
+	uint32 replyLength = 0;
+	if( delivered && HandleNodeCommand( nodeId, &_frame[6], commandLength, reply, replyLength ) && !Lost() )
+	{
+		QueueNodeCommand( delay + Latency(), nodeId, reply, replyLength );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::HandleNodeCommand>
+//	Apply a command to a virtual node, and make its reply if it has one
+//-----------------------------------------------------------------------------
+bool SimulatedController::HandleNodeCommand
+(
+	uint8 const _nodeId,
+	uint8 const* _command,
+	uint32 const _length,
+	uint8* _reply,
+	uint32& _replyLength
+)
+{
+	if( _length < 2 )
+	{
+		// Including the NoOperation used to probe a node
+		return false;
+	}
+
+	VirtualNode& node = m_nodes[_nodeId];
+	uint8 const commandClassId = _command[0];
+	uint8 const command = _command[1];
+	_replyLength = 0;
+
+	switch( commandClassId )
+	{
+		case 0x20:		// COMMAND_CLASS_BASIC
+		case 0x25:		// COMMAND_CLASS_SWITCH_BINARY
+		{
+			if( command == 0x01 && _length >= 3 )
+			{
+				node.m_on = ( _command[2] != 0 );
+			}
+			else if( command == 0x02 )
+			{
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x03;
+				_reply[_replyLength++] = node.m_on ? 0xff : 0x00;
+			}
+			break;
+		}
+		case 0x27:		// COMMAND_CLASS_SWITCH_ALL
+		{
+			if( command == 0x02 )
+			{
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x03;
+				_reply[_replyLength++] = 0xff;			// Included in all on and all off
+			}
+			break;
+		}
+		case 0x31:		// COMMAND_CLASS_SENSOR_MULTILEVEL
+		{
+			if( command == 0x04 )
+			{
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x05;
+				_reply[_replyLength++] = 0x01;			// Temperature
+				_reply[_replyLength++] = 0x22;			// One decimal place, Celsius, two bytes
+				_reply[_replyLength++] = (uint8)( node.m_temperature >> 8 );
+				_reply[_replyLength++] = (uint8)node.m_temperature;
+			}
+			break;
+		}
+		case 0x72:		// COMMAND_CLASS_MANUFACTURER_SPECIFIC
+		{
+			if( command == 0x04 )
+			{
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x05;
+				_reply[_replyLength++] = 0x00;			// Manufacturer, product type and product id
+				_reply[_replyLength++] = 0x00;
+				_reply[_replyLength++] = 0x00;
+				_reply[_replyLength++] = 0x01;
+				_reply[_replyLength++] = 0x00;
+				_reply[_replyLength++] = 0x01;
+			}
+			break;
+		}
+		case 0x86:		// COMMAND_CLASS_VERSION
+		{
+			if( command == 0x11 )
+			{
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x12;
+				_reply[_replyLength++] = 0x03;			// Library type
+				_reply[_replyLength++] = 0x04;			// Protocol version
+				_reply[_replyLength++] = 0x05;
+				_reply[_replyLength++] = 0x01;			// Application version
+				_reply[_replyLength++] = 0x00;
+			}
+			else if( command == 0x13 && _length >= 3 )
+			{
+				uint8 version = 0;
+				for( uint32 i=0; i<sizeof(c_commandClasses); ++i )
+				{
+					if( c_commandClasses[i] == _command[2] )
+					{
+						version = 1;
+					}
+				}
+				_reply[_replyLength++] = commandClassId;
+				_reply[_replyLength++] = 0x14;
+				_reply[_replyLength++] = _command[2];
+				_reply[_replyLength++] = version;
+			}
+			break;
+		}
+		default:
+		{
+			break;
+		}
+	}
+
+	return( _replyLength != 0 );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::QueueReport>
+//	Send an unsolicited sensor report from the next node in turn
+//-----------------------------------------------------------------------------
+void SimulatedController::QueueReport
+(
+)
+{
+	uint8 nodeId = (uint8)( c_controllerNodeId + 1 + m_nextReportNode );
+	m_nextReportNode = (uint8)( ( m_nextReportNode + 1 ) % m_nodeCount );
+
+	// The readings wander up and down a little
+	VirtualNode& node = m_nodes[nodeId];
+	node.m_temperature = (int16)( node.m_temperature + (int32)( Random() % 5 ) - 2 );
+
+	if( Lost() )
+	{
+		return;
+	}
+
+	uint8 const report[] =
+	{
+		0x31, 0x05, 0x01, 0x22, (uint8)( node.m_temperature >> 8 ), (uint8)node.m_temperature
+	};
+	QueueNodeCommand( 0, nodeId, report, sizeof(report) );
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::ThreadEntryPoint>
+//	Entry point of the thread that delivers the simulated frames
+//-----------------------------------------------------------------------------
+void SimulatedController::ThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	SimulatedController* sc = (SimulatedController*)_context;
+	if( sc )
+	{
+		sc->ThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<SimulatedController::ThreadProc>
+//	Deliver the simulated frames to the driver as they come due
+//-----------------------------------------------------------------------------
+void SimulatedController::ThreadProc
+(
+	Event* _exitEvent
+)
+{
+	while( true )
+	{
+		int32 timeout = Wait::Timeout_Infinite;
+		{
+			LockGuard LG(m_mutex);
+			int32 now = Now();
+
+			if( m_reportInterval > 0 )
+			{
+				while( m_nextReport <= now )
+				{
+					QueueReport();
+					m_nextReport += m_reportInterval;
+				}
+				timeout = m_nextReport - now;
+			}
+
+			while( !m_pending.empty() && m_pending.front().m_due <= now )
+			{
+				Pending& pending = m_pending.front();
+				if( c_streamSize - GetDataSize() < pending.m_data.size() )
+				{
+					// The driver has fallen behind.  Try again shortly.
+					timeout = 1;
+					break;
+				}
+				Received( &pending.m_data[0], (uint32)pending.m_data.size() );
+				m_pending.pop_front();
+			}
+
+			if( !m_pending.empty() && timeout != 1 )
+			{
+				int32 due = m_pending.front().m_due - now;
+				if( due < 0 )
+				{
+					due = 0;
+				}
+				if( timeout == Wait::Timeout_Infinite || due < timeout )
+				{
+					timeout = due;
+				}
+			}
+
+			// Write sets the event under the mutex, so nothing queued after this is missed
+			m_wakeEvent->Reset();
+		}
+
+		Wait* waitObjects[2];
+		waitObjects[0] = _exitEvent;
+		waitObjects[1] = m_wakeEvent;
+		if( Wait::Multiple( waitObjects, 2, timeout ) == 0 )
+		{
+			// Exit has been called
+			return;
+		}
+	}
+}
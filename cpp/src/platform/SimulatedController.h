@@ -0,0 +1,157 @@
+//-----------------------------------------------------------------------------
+//
+//	SimulatedController.h
+//
+//	A Z-Wave controller and network simulated in software
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _SimulatedController_H
+#define _SimulatedController_H
+
+#include <string>
+#include <list>
+#include <vector>
+#include "Defs.h"
+#include "platform/Controller.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Thread;
+	class Event;
+	class Mutex;
+
+	/** \brief A static controller and a network of virtual nodes, simulated in software.
+	 *
+	 * Answers the Serial API requests the driver makes during initialization, and
+	 * ZW_SEND_DATA to the virtual nodes, so that the driver can be load tested and
+	 * benchmarked without hardware.  Each node is an always listening binary switch
+	 * with a temperature sensor, which answers gets for its command classes.
+	 *
+	 * The network is described by the controller path, a comma separated list of
+	 * settings, for example "nodes=232,latency=20,jitter=5,loss=2,report=100":
+	 * - nodes: the number of virtual nodes (1 to 231, default 4).
+	 * - latency: milliseconds before a transmission completes, and again before a node replies (default 10).
+	 * - jitter: up to this many milliseconds are added to each latency (default 0).
+	 * - loss: percentage of frames to and from the nodes that are lost (default 0).
+	 * - report: milliseconds between unsolicited sensor reports, from each node in turn (default 0, none).
+	 * - seed: seed for the random numbers behind the jitter, loss and readings (default 1),
+	 *   so that a run can be repeated exactly.
+	 */
+	class SimulatedController: public Controller
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates an object that represents a simulated controller.
+		 */
+		SimulatedController();
+
+		/**
+		 * Destructor.
+		 * Destroys the simulated controller object.
+		 */
+		virtual ~SimulatedController();
+
+		/**
+		 * Open the simulated controller.
+		 * Builds the virtual network and starts the thread that delivers its frames.
+		 * @param _settings The settings describing the network.  See the class description.
+		 * @return True if the settings were understood.
+		 * @see Close, Read, Write
+		 */
+		bool Open( string const& _settings );
+
+		/**
+		 * Close the simulated controller.
+		 * @return True if the controller was closed, or false if it was already closed.
+		 * @see Open
+		 */
+		bool Close();
+
+		/**
+		 * Write to the simulated controller.
+		 * Frames from the driver are acknowledged and answered as a real controller would.
+		 * @param _buffer Pointer to a block of memory containing the data to be written.
+		 * @param _length Length in bytes of the data.
+		 * @return The number of bytes written.
+		 * @see Read, Open, Close
+		 */
+		uint32 Write( uint8* _buffer, uint32 _length );
+
+	private:
+		/** A frame waiting to be delivered to the driver */
+		struct Pending
+		{
+			int32			m_due;			/**< Milliseconds after Open at which the frame is due */
+			vector<uint8>	m_data;
+		};
+
+		/** The state of a virtual node */
+		struct VirtualNode
+		{
+			bool			m_on;
+			int16			m_temperature;	/**< Tenths of a degree Celsius */
+		};
+
+		bool ParseSettings( string const& _settings );
+		int32 Now();
+		uint32 Random();
+		int32 Latency();
+		bool Lost();
+
+		void Queue( int32 const _delay, uint8 const _type, uint8 const _function, uint8 const* _payload, uint32 const _length );
+		void Queue( int32 const _delay, vector<uint8>& _data );
+		void QueueNodeCommand( int32 const _delay, uint8 const _nodeId, uint8 const* _command, uint32 const _length );
+		void HandleFrame( uint8 const* _frame, uint32 const _length );
+		void HandleSendData( uint8 const* _frame, uint32 const _length );
+		bool HandleNodeCommand( uint8 const _nodeId, uint8 const* _command, uint32 const _length, uint8* _reply, uint32& _replyLength );
+		void QueueReport();
+
+		static void ThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ThreadProc( Event* _exitEvent );
+
+		Thread*			m_thread;
+		Event*			m_wakeEvent;		// Set when a frame is queued, so the thread can reschedule
+		Mutex*			m_mutex;			// Guards the pending frames and the virtual nodes
+		TimeStamp		m_start;
+		bool			m_bOpen;
+
+		// Settings
+		uint32			m_nodeCount;
+		int32			m_latency;
+		int32			m_jitter;
+		uint32			m_loss;
+		int32			m_reportInterval;
+		uint32			m_seed;
+
+		int32			m_nextReport;		// When the next unsolicited report is due
+		uint8			m_nextReportNode;
+		VirtualNode		m_nodes[256];
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		list<Pending>	m_pending;			// Sorted by when each frame is due
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_SimulatedController_H
@@ -28,6 +28,7 @@
 #include "platform/Stream.h"
 #include "platform/Mutex.h"
 #include "platform/Log.h"
+#include "Utils.h"
 
 #include <string.h>
 
@@ -45,13 +46,21 @@ Stream::Stream
 ):
 	m_bufferSize( _bufferSize ),
 	m_signalSize(1),
-	m_dataSize(0),
+	m_mutex( new Mutex( false ) ),
 	m_head(0),
-	m_tail(0),
-	m_mutex( new Mutex() )
+	m_tail(0)
 {
-	m_buffer = new uint8[m_bufferSize];
-	memset(m_buffer, 0x00, m_bufferSize);
+	// The free running head and tail counts only map consistently onto
+	// buffer positions when the size is a power of two
+	uint32 size = 1;
+	while( size < _bufferSize )
+	{
+		size <<= 1;
+	}
+	m_bufferSize = size;
+
+	m_buffer = new uint8[m_bufferSize + c_slack];
+	memset(m_buffer, 0x00, m_bufferSize + c_slack);
 }
 
 //-----------------------------------------------------------------------------
@@ -75,7 +84,7 @@ void Stream::SetSignalThreshold
 	uint32 _size 
 )
 {
-	m_signalSize = _size;
+	AtomicStore( &m_signalSize, _size );
 	if( IsSignalled() )
 	{
 		// We have more data than we are waiting for, so notify the watchers
@@ -93,38 +102,95 @@ bool Stream::Get
 	uint32 _size
 )
 {
-	if( m_dataSize < _size )
+	// Only the consumer moves the tail, so it cannot change under us.  The acquire
+	// load of the head makes sure the producer's data is visible before we copy it.
+	uint32 tail = m_tail;
+	uint32 head = AtomicLoad( &m_head );
+	if( ( head - tail ) < _size )
 	{
 		// There is not enough data in the buffer to fulfill the request
 		Log::Write( LogLevel_Error, "ERROR: Not enough data in stream buffer");
 		return false;
 	}
 
-	m_mutex->Lock();
-	if( (m_tail + _size) > m_bufferSize )
+	uint32 pos = tail & ( m_bufferSize - 1 );
+	if( (pos + _size) > m_bufferSize )
 	{
 		// We will have to wrap around
-		uint32 block1 = m_bufferSize - m_tail;
+		uint32 block1 = m_bufferSize - pos;
 		uint32 block2 = _size - block1;
 
-		memcpy( _buffer, &m_buffer[m_tail], block1 );
+		memcpy( _buffer, &m_buffer[pos], block1 );
 		memcpy( &_buffer[block1], m_buffer, block2 );
-		m_tail = block2;
 	}
 	else
 	{
 		// Requested data is in a contiguous block
-		memcpy( _buffer, &m_buffer[m_tail], _size );
-		m_tail += _size;
+		memcpy( _buffer, &m_buffer[pos], _size );
 	}
 
 	LogData( _buffer, _size, "      Read (buffer->application): ");
 
-	m_dataSize -= _size;
-	m_mutex->Unlock();
+	// Release the space back to the producer
+	AtomicStore( &m_tail, tail + _size );
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+//	<Stream::Peek>
+//	Look at data at the front of the buffer without removing it
+//-----------------------------------------------------------------------------
+uint8* Stream::Peek
+(
+	uint32 _size,
+	uint8* _scratch
+)
+{
+	uint32 tail = m_tail;
+	uint32 head = AtomicLoad( &m_head );
+	if( ( head - tail ) < _size )
+	{
+		return NULL;
+	}
+
+	uint32 pos = tail & ( m_bufferSize - 1 );
+	if( (pos + _size) > m_bufferSize )
+	{
+		// The data wraps around, so it has to be copied into one piece
+		uint32 block1 = m_bufferSize - pos;
+		memcpy( _scratch, &m_buffer[pos], block1 );
+		memcpy( &_scratch[block1], m_buffer, _size - block1 );
+		return _scratch;
+	}
+
+	return &m_buffer[pos];
+}
+
+//-----------------------------------------------------------------------------
+//	<Stream::Skip>
+//	Remove data from the buffer without copying it
+//-----------------------------------------------------------------------------
+void Stream::Skip
+(
+	uint32 _size
+)
+{
+	uint32 tail = m_tail;
+	uint32 pos = tail & ( m_bufferSize - 1 );
+	if( (pos + _size) > m_bufferSize )
+	{
+		LogData( &m_buffer[pos], m_bufferSize - pos, "      Read (buffer->application): " );
+		LogData( m_buffer, _size - ( m_bufferSize - pos ), "      Read (buffer->application): " );
+	}
+	else
+	{
+		LogData( &m_buffer[pos], _size, "      Read (buffer->application): " );
+	}
+
+	// Release the space back to the producer
+	AtomicStore( &m_tail, tail + _size );
+}
+
 //-----------------------------------------------------------------------------
 //	<Stream::Put>
 //	Add data to the buffer
@@ -135,36 +201,42 @@ bool Stream::Put
 	uint32 _size
 )
 {
-	if( (m_bufferSize-m_dataSize) < _size )
+	m_mutex->Lock();
+
+	// Only producers move the head.  The acquire load of the tail makes sure the
+	// consumer has finished with the space before we overwrite it.
+	uint32 head = m_head;
+	uint32 tail = AtomicLoad( &m_tail );
+	if( (m_bufferSize - ( head - tail )) < _size )
 	{
 		// There is not enough space left in the buffer for the data
+		m_mutex->Unlock();
 		Log::Write( LogLevel_Error, "ERROR: Not enough space in stream buffer");
 		return false;
 	}
 
-	m_mutex->Lock();
-	if( (m_head + _size) > m_bufferSize )
+	uint32 pos = head & ( m_bufferSize - 1 );
+	if( (pos + _size) > m_bufferSize )
 	{
 		// We will have to wrap around
-		uint32 block1 = m_bufferSize - m_head;
+		uint32 block1 = m_bufferSize - pos;
 		uint32 block2 = _size - block1;
 
-		memcpy( &m_buffer[m_head], _buffer, block1 );
+		memcpy( &m_buffer[pos], _buffer, block1 );
 		memcpy( m_buffer, &_buffer[block1], block2 );
-		uint8 * logpos = m_buffer + m_head;
-		m_head = block2;
-		LogData( logpos, block1, "      Read (controller->buffer):  ");
+		LogData( &m_buffer[pos], block1, "      Read (controller->buffer):  ");
 		LogData( m_buffer, block2, "      Read (controller->buffer):  ");
 	}
 	else
 	{
 		// There is enough space before we reach the end of the buffer
-		memcpy( &m_buffer[m_head], _buffer, _size );
-		m_head += _size;
-		LogData(m_buffer+m_head-_size, _size, "      Read (controller->buffer):  ");
+		memcpy( &m_buffer[pos], _buffer, _size );
+		LogData( &m_buffer[pos], _size, "      Read (controller->buffer):  ");
 	}
 
-	m_dataSize += _size;
+	// Publish the data to the consumer
+	AtomicStore( &m_head, head + _size );
+	m_mutex->Unlock();
 
 	if( IsSignalled() )
 	{
@@ -172,7 +244,6 @@ bool Stream::Put
 		Notify();
 	}
 
-	m_mutex->Unlock();
 	return true;
 }
 
@@ -184,9 +255,8 @@ void Stream::Purge
 (
 )
 {
-	m_tail = 0;
-	m_head = 0;
-	m_dataSize = 0;
+	// Called by the consumer.  Discard everything the producer has published so far.
+	AtomicStore( &m_tail, AtomicLoad( &m_head ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -197,7 +267,7 @@ bool Stream::IsSignalled
 (
 )
 {
-	return( m_dataSize >= m_signalSize );
+	return( GetDataSize() >= AtomicLoad( &m_signalSize ) );
 }
 
 //-----------------------------------------------------------------------------
@@ -211,19 +281,8 @@ void Stream::LogData
 	const string &_function
 )
 {
-	if( !_length ) return;
+	if( !_length || !Log::IsEnabled( LogLevel_StreamDetail ) ) return;
 
-	string str = "";
-	for( uint32 i=0; i<_length; ++i ) 
-	{
-		if( i )
-		{
-			str += ", ";
-		}
-			
-		char byteStr[8];
-		snprintf( byteStr, sizeof(byteStr), "0x%.2x", _buffer[i] );
-		str += byteStr;
-	}
-	Log::Write( LogLevel_StreamDetail, "%s%s", _function.c_str(), str.c_str() );
+	char str[256*6];
+	Log::Write( LogLevel_StreamDetail, "%s%s", _function.c_str(), PktToString( _buffer, _length, str, sizeof(str) ) );
 }
@@ -30,6 +30,7 @@
 
 #include "Defs.h"
 #include "platform/Wait.h"
+#include "platform/Atomic.h"
 
 #include <string>
 
@@ -38,6 +39,11 @@ namespace OpenZWave
 	class Mutex;
 
 	/** \brief Platform-independent definition of a circular buffer.
+	 *
+	 * The buffer is lock-free for one producer thread (calling Put) and one consumer
+	 * thread (calling Get, Purge and SetSignalThreshold).  The head index is only
+	 * written by the producer and the tail index only by the consumer, so neither side
+	 * ever waits on the other.  Concurrent producers are serialized between themselves.
 	 */
 	class Stream: public Wait
 	{
@@ -71,6 +77,26 @@ namespace OpenZWave
 		 */
 		bool Get( uint8* _buffer, uint32 _size );
 
+		/**
+		 * Looks at data at the front of the stream without removing it.  Called by the consumer,
+		 * which follows it with a call to Skip once it has finished with the data.
+		 * \param _size the amount of data in bytes to look at.
+		 * \param _scratch a block of at least _size bytes, used if the data wraps round the end of
+		 * the circular buffer.
+		 * \return a pointer to the data, in the circular buffer itself when it is in one piece and
+		 * otherwise copied to _scratch.  NULL if there is not enough data in the stream.  The data
+		 * is valid until the consumer next calls Skip, Get or Purge.
+		 * \see Skip, Get
+		 */
+		uint8* Peek( uint32 _size, uint8* _scratch );
+
+		/**
+		 * Removes data from the front of the stream without copying it anywhere.
+		 * \param _size the amount of data in bytes to remove.  No more than is in the stream.
+		 * \see Peek
+		 */
+		void Skip( uint32 _size );
+
 		/**
 		 * Copies the requested amount of data from the buffer into the stream.
 		 * If there is insufficient room available in the stream's circular buffer, and no data is transferred.
@@ -87,7 +113,7 @@ namespace OpenZWave
 		 * \return the number of bytes of data in the stream.
 		 * \see Get, GetDataSize
 		 */
-		uint32 GetDataSize()const{ return m_dataSize; }
+		uint32 GetDataSize()const{ return AtomicLoad( &m_head ) - AtomicLoad( &m_tail ); }
 
  		/**
 		 * Empties the stream bytes held in the buffer.  
@@ -117,16 +143,27 @@ namespace OpenZWave
 		~Stream();
 
 	private:
+		enum
+		{
+			c_slack = 256			// Zeroed bytes after the buffer, so a parser reading a little past the end of data from Peek stays in bounds
+		};
+
 		Stream( Stream const&	);					// prevent copy
 		Stream& operator = ( Stream const& );		// prevent assignment
 
-		uint8*	m_buffer;
-		uint32	m_bufferSize;
-		uint32	m_signalSize;
-		uint32	m_dataSize;
-		uint32	m_head;
-		uint32	m_tail;
- 		Mutex*	m_mutex;
+		// m_head and m_tail are free running byte counts (the buffer index is the count
+		// modulo the buffer size), so the amount of data is always m_head - m_tail.
+		// They are kept on separate cache lines so the producer and consumer do not
+		// keep stealing the line from each other.
+		uint8*			m_buffer;
+		uint32			m_bufferSize;
+		volatile uint32	m_signalSize;
+		Mutex*			m_mutex;		// Serializes producers only
+		uint8			m_pad0[64];
+		volatile uint32	m_head;			// Written by the producer
+		uint8			m_pad1[64];
+		volatile uint32	m_tail;			// Written by the consumer
+		uint8			m_pad2[64];
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,556 @@
+//-----------------------------------------------------------------------------
+//
+//	TcpController.cpp
+//
+//	A Z-Wave controller reached over a TCP connection, such as ser2net
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+// The socket headers must come before anything that includes windows.h
+#if defined WIN32 || defined WINRT
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#ifdef _MSC_VER
+#pragma comment( lib, "ws2_32.lib" )
+#endif
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <string.h>
+#include "Defs.h"
+#include "Utils.h"
+#include "platform/TcpController.h"
+#include "platform/Atomic.h"
+#include "platform/Thread.h"
+#include "platform/Event.h"
+#include "platform/Mutex.h"
+#include "platform/Log.h"
+
+using namespace OpenZWave;
+
+static int32 const c_connectTimeout = 5000;		// Milliseconds allowed for a connection to be made
+static int32 const c_writeTimeout = 1000;		// Milliseconds a write may wait for room in the socket's buffer
+static int32 const c_readPoll = 100;			// Milliseconds between checks for the thread being asked to exit
+static int32 const c_minBackoff = 500;			// First wait before connecting again
+static int32 const c_maxBackoff = 30000;		// Longest wait between attempts to connect
+static int32 const c_measureInterval = 10000;	// Milliseconds between readings of the round trip time
+static uint32 const c_maxLinkDelay = 5000;
+
+#if defined WIN32 || defined WINRT
+static int const c_sendFlags = 0;
+
+static int LastError(){ return WSAGetLastError(); }
+static bool WouldBlock( int const _error ){ return _error == WSAEWOULDBLOCK; }
+static bool InProgress( int const _error ){ return _error == WSAEWOULDBLOCK; }
+static bool Interrupted( int const _error ){ return _error == WSAEINTR; }
+static void CloseSocket( intptr_t const _socket ){ closesocket( (SOCKET)_socket ); }
+static bool SetNonBlocking( intptr_t const _socket )
+{
+	u_long on = 1;
+	return( ioctlsocket( (SOCKET)_socket, FIONBIO, &on ) == 0 );
+}
+#else
+#ifdef MSG_NOSIGNAL
+static int const c_sendFlags = MSG_NOSIGNAL;	// A dropped connection is reported by send, rather than by SIGPIPE
+#else
+static int const c_sendFlags = 0;
+#endif
+
+static int LastError(){ return errno; }
+static bool WouldBlock( int const _error ){ return _error == EAGAIN || _error == EWOULDBLOCK; }
+static bool InProgress( int const _error ){ return _error == EINPROGRESS; }
+static bool Interrupted( int const _error ){ return _error == EINTR; }
+static void CloseSocket( intptr_t const _socket ){ close( (int)_socket ); }
+static bool SetNonBlocking( intptr_t const _socket )
+{
+	int flags = fcntl( (int)_socket, F_GETFL, 0 );
+	return( flags != -1 && fcntl( (int)_socket, F_SETFL, flags | O_NONBLOCK ) != -1 );
+}
+#endif
+
+//-----------------------------------------------------------------------------
+//	<WaitForSocket>
+//	Wait until a socket can be read or written, or the timeout passes
+//-----------------------------------------------------------------------------
+static int WaitForSocket
+(
+	intptr_t const _socket,
+	bool const _write,
+	int32 const _timeout
+)
+{
+	fd_set fds;
+	FD_ZERO( &fds );
+	FD_SET( _socket, &fds );
+	struct timeval tv;
+	tv.tv_sec = _timeout / 1000;
+	tv.tv_usec = ( _timeout % 1000 ) * 1000;
+	return select( (int)_socket + 1, _write ? NULL : &fds, _write ? &fds : NULL, NULL, &tv );
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::TcpController>
+//	Constructor
+//-----------------------------------------------------------------------------
+TcpController::TcpController
+(
+):
+	m_socket( -1 ),
+	m_mutex( new Mutex() ),
+	m_thread( NULL ),
+	m_bOpen( false ),
+	m_linkDelay( 0 )
+{
+#if defined WIN32 || defined WINRT
+	WSADATA wsaData;
+	WSAStartup( MAKEWORD( 2, 2 ), &wsaData );
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::~TcpController>
+//	Destructor
+//-----------------------------------------------------------------------------
+TcpController::~TcpController
+(
+)
+{
+	Close();
+	m_mutex->Release();
+#if defined WIN32 || defined WINRT
+	WSACleanup();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Open>
+//	Connect to the controller and start the read thread
+//-----------------------------------------------------------------------------
+bool TcpController::Open
+(
+	string const& _address
+)
+{
+	if( m_bOpen )
+	{
+		return false;
+	}
+
+	string address = _address;
+	if( address.compare( 0, 6, "tcp://" ) == 0 )
+	{
+		address = address.substr( 6 );
+	}
+
+	// The port follows the last colon, and an IPv6 address is in brackets
+	size_t colon = address.rfind( ':' );
+	if( colon == string::npos || colon == 0 || colon + 1 == address.size() )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Controller address %s is not in the form host:port", _address.c_str() );
+		return false;
+	}
+	m_host = address.substr( 0, colon );
+	m_port = address.substr( colon + 1 );
+	if( m_host.size() > 2 && m_host[0] == '[' && m_host[m_host.size()-1] == ']' )
+	{
+		m_host = m_host.substr( 1, m_host.size() - 2 );
+	}
+
+	// As with a serial port, there are only retries after the first connection succeeds
+	if( !Connect( 1 ) )
+	{
+		return false;
+	}
+
+	m_bOpen = true;
+	m_thread = new Thread( "TcpController" );
+	m_thread->Start( ReadThreadEntryPoint, this );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Close>
+//	Stop the read thread and close the connection
+//-----------------------------------------------------------------------------
+bool TcpController::Close
+(
+)
+{
+	if( !m_bOpen )
+	{
+		return false;
+	}
+
+	m_thread->Stop();
+	m_thread->Release();
+	m_thread = NULL;
+
+	Disconnect();
+	m_bOpen = false;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Write>
+//	Send data to the controller
+//-----------------------------------------------------------------------------
+uint32 TcpController::Write
+(
+	uint8* _buffer,
+	uint32 _length
+)
+{
+	LockGuard LG(m_mutex);
+	if( m_socket == -1 )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Not connected to controller %s:%s", m_host.c_str(), m_port.c_str() );
+		return 0;
+	}
+
+	Log::Write( LogLevel_StreamDetail, "      TcpController::Write (sent to controller)" );
+	LogData( _buffer, _length, "      Write: " );
+	Sent( _buffer, _length );
+
+	uint32 written = 0;
+	while( written < _length )
+	{
+		int sent = send( m_socket, (char const*)_buffer + written, (int)( _length - written ), c_sendFlags );
+		if( sent > 0 )
+		{
+			written += (uint32)sent;
+			continue;
+		}
+
+		int error = LastError();
+		if( sent < 0 && ( WouldBlock( error ) || Interrupted( error ) ) )
+		{
+			// The socket's buffer is full.  Wait for room, but not for ever.
+			if( WaitForSocket( m_socket, true, c_writeTimeout ) > 0 )
+			{
+				continue;
+			}
+			Log::Write( LogLevel_Error, "ERROR: Timed out writing to controller %s:%s", m_host.c_str(), m_port.c_str() );
+		}
+		else
+		{
+			Log::Write( LogLevel_Error, "ERROR: Failed to write to controller %s:%s. Error code %d", m_host.c_str(), m_port.c_str(), error );
+		}
+
+		// Let the read thread find the connection closed, and make a new one
+		shutdown( m_socket, 2 );
+		break;
+	}
+	return written;
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::GetThreadId>
+//	Get the operating system's id for the read thread
+//-----------------------------------------------------------------------------
+uint64 TcpController::GetThreadId
+(
+)
+{
+	return m_thread ? m_thread->GetId() : 0;
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::GetLinkDelay>
+//	How much longer than a local port data takes to get there and back
+//-----------------------------------------------------------------------------
+uint32 TcpController::GetLinkDelay
+(
+)
+{
+	return AtomicLoad( &m_linkDelay );
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Connect>
+//	Make a connection to the controller, trying each address of the host
+//-----------------------------------------------------------------------------
+bool TcpController::Connect
+(
+	uint32 const _attempts
+)
+{
+	Log::Write( LogLevel_Info, "Trying to connect to controller %s:%s (attempt %d)", m_host.c_str(), m_port.c_str(), _attempts );
+
+	struct addrinfo hints;
+	memset( &hints, 0, sizeof(hints) );
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	struct addrinfo* addresses = NULL;
+	int error = getaddrinfo( m_host.c_str(), m_port.c_str(), &hints, &addresses );
+	if( error != 0 )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Cannot resolve controller host %s. Error code %d", m_host.c_str(), error );
+		return false;
+	}
+
+	intptr_t s = -1;
+	int32 connectTime = 0;
+	for( struct addrinfo* ai = addresses; ai != NULL && s == -1; ai = ai->ai_next )
+	{
+		s = (intptr_t)socket( ai->ai_family, ai->ai_socktype, ai->ai_protocol );
+		if( s == -1 )
+		{
+			continue;
+		}
+
+		TimeStamp start;
+		bool connected = false;
+		if( SetNonBlocking( s ) )
+		{
+			if( connect( s, ai->ai_addr, (int)ai->ai_addrlen ) == 0 )
+			{
+				connected = true;
+			}
+			else if( InProgress( LastError() ) && WaitForSocket( s, true, c_connectTimeout ) > 0 )
+			{
+				int result = 0;
+				socklen_t size = sizeof(result);
+				connected = ( getsockopt( s, SOL_SOCKET, SO_ERROR, (char*)&result, &size ) == 0 && result == 0 );
+			}
+		}
+
+		if( !connected )
+		{
+			CloseSocket( s );
+			s = -1;
+			continue;
+		}
+		connectTime = -start.TimeRemaining();
+	}
+	freeaddrinfo( addresses );
+
+	if( s == -1 )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Cannot connect to controller %s:%s. Error code %d", m_host.c_str(), m_port.c_str(), LastError() );
+		return false;
+	}
+
+	// Frames are small, and waiting to fill a segment would only add latency
+	int on = 1;
+	setsockopt( s, IPPROTO_TCP, TCP_NODELAY, (char const*)&on, sizeof(on) );
+
+	// Find out about a dead link even when nothing is being sent
+	setsockopt( s, SOL_SOCKET, SO_KEEPALIVE, (char const*)&on, sizeof(on) );
+#ifdef TCP_KEEPIDLE
+	int idle = 10;
+	setsockopt( s, IPPROTO_TCP, TCP_KEEPIDLE, (char const*)&idle, sizeof(idle) );
+#endif
+#ifdef TCP_KEEPINTVL
+	int interval = 5;
+	setsockopt( s, IPPROTO_TCP, TCP_KEEPINTVL, (char const*)&interval, sizeof(interval) );
+#endif
+#ifdef TCP_KEEPCNT
+	int count = 3;
+	setsockopt( s, IPPROTO_TCP, TCP_KEEPCNT, (char const*)&count, sizeof(count) );
+#endif
+#if defined SO_NOSIGPIPE && !defined MSG_NOSIGNAL
+	setsockopt( s, SOL_SOCKET, SO_NOSIGPIPE, (char const*)&on, sizeof(on) );
+#endif
+
+	{
+		LockGuard LG(m_mutex);
+		m_socket = s;
+	}
+
+	// Making the connection took a round trip.  Allow twice that until the
+	// kernel has a better estimate.
+	uint32 delay = (uint32)connectTime * 2;
+	AtomicStore( &m_linkDelay, delay < c_maxLinkDelay ? delay : c_maxLinkDelay );
+	m_nextMeasure.SetTime( 0 );
+	MeasureLinkDelay();
+
+	Log::Write( LogLevel_Info, "Connected to controller %s:%s (attempt %d), allowing %dms for the link", m_host.c_str(), m_port.c_str(), _attempts, AtomicLoad( &m_linkDelay ) );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Disconnect>
+//	Close the socket
+//-----------------------------------------------------------------------------
+void TcpController::Disconnect
+(
+)
+{
+	LockGuard LG(m_mutex);
+	if( m_socket != -1 )
+	{
+		CloseSocket( m_socket );
+		m_socket = -1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::MeasureLinkDelay>
+//	Take the kernel's estimate of the round trip time, where there is one
+//-----------------------------------------------------------------------------
+void TcpController::MeasureLinkDelay
+(
+)
+{
+#if defined TCP_INFO && defined __linux__
+	if( m_nextMeasure.TimeRemaining() > 0 )
+	{
+		return;
+	}
+	m_nextMeasure.SetTime( c_measureInterval );
+
+	struct tcp_info info;
+	socklen_t size = sizeof(info);
+	if( getsockopt( (int)m_socket, IPPROTO_TCP, TCP_INFO, &info, &size ) == 0 && info.tcpi_rtt != 0 )
+	{
+		// Both are in microseconds
+		uint32 delay = ( info.tcpi_rtt + 4 * info.tcpi_rttvar + 999 ) / 1000;
+		AtomicStore( &m_linkDelay, delay < c_maxLinkDelay ? delay : c_maxLinkDelay );
+	}
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::ReadThreadEntryPoint>
+//	Entry point of the thread that receives data from the controller
+//-----------------------------------------------------------------------------
+void TcpController::ReadThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	TcpController* tc = (TcpController*)_context;
+	if( tc )
+	{
+		tc->ReadThreadProc( _exitEvent );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::ReadThreadProc>
+//	Receive data, connecting again with backoff whenever the connection drops
+//-----------------------------------------------------------------------------
+void TcpController::ReadThreadProc
+(
+	Event* _exitEvent
+)
+{
+	uint32 attempts = 0;
+	int32 backoff = c_minBackoff;
+	while( true )
+	{
+		// Open has made the first connection
+		if( m_socket != -1 )
+		{
+			if( Read( _exitEvent ) )
+			{
+				// Exit signalled
+				break;
+			}
+			Disconnect();
+
+			// Start again with a short wait, as the drop may only be brief
+			attempts = 0;
+			backoff = c_minBackoff;
+		}
+
+		if( Wait::Single( _exitEvent, backoff ) >= 0 )
+		{
+			// Exit signalled
+			break;
+		}
+
+		if( Connect( ++attempts ) )
+		{
+			Reconnected();
+		}
+		else
+		{
+			backoff = ( backoff < c_maxBackoff / 2 ) ? backoff * 2 : c_maxBackoff;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<TcpController::Read>
+//	Pass data to the driver until the connection drops
+//-----------------------------------------------------------------------------
+bool TcpController::Read
+(
+	Event* _exitEvent
+)
+{
+	uint8 buffer[1024];
+	while( true )
+	{
+		if( Wait::Single( _exitEvent, 0 ) >= 0 )
+		{
+			return true;
+		}
+
+		int ready = WaitForSocket( m_socket, false, c_readPoll );
+		if( ready < 0 )
+		{
+			int error = LastError();
+			if( Interrupted( error ) )
+			{
+				continue;
+			}
+			Log::Write( LogLevel_Error, "ERROR: Failed waiting for data from controller %s:%s. Error code %d", m_host.c_str(), m_port.c_str(), error );
+			return false;
+		}
+		if( ready == 0 )
+		{
+			continue;
+		}
+
+		int received = recv( m_socket, (char*)buffer, sizeof(buffer), 0 );
+		if( received > 0 )
+		{
+			Received( buffer, (uint32)received );
+			MeasureLinkDelay();
+			continue;
+		}
+		if( received == 0 )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Controller %s:%s closed the connection", m_host.c_str(), m_port.c_str() );
+			return false;
+		}
+
+		int error = LastError();
+		if( !WouldBlock( error ) && !Interrupted( error ) )
+		{
+			Log::Write( LogLevel_Error, "ERROR: Failed to read from controller %s:%s. Error code %d", m_host.c_str(), m_port.c_str(), error );
+			return false;
+		}
+	}
+}
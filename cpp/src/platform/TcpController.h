@@ -0,0 +1,126 @@
+//-----------------------------------------------------------------------------
+//
+//	TcpController.h
+//
+//	A Z-Wave controller reached over a TCP connection, such as ser2net
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _TcpController_H
+#define _TcpController_H
+
+#include <stddef.h>
+#include <string>
+#include "Defs.h"
+#include "platform/Controller.h"
+
+namespace OpenZWave
+{
+	class Thread;
+	class Event;
+	class Mutex;
+
+	/** \brief A controller attached to another machine, reached over TCP.
+	 *
+	 * The controller path is "host:port", optionally prefixed with "tcp://", for
+	 * example "pi.local:3333" for a stick shared with ser2net in raw mode.  The
+	 * serial settings are left to the remote end.
+	 *
+	 * The socket is non-blocking, with Nagle's algorithm turned off so that each
+	 * frame and ACK leaves at once, and TCP keepalive on so that a dead link is
+	 * noticed while the network is quiet.  If the connection drops, the read thread
+	 * connects again, waiting twice as long after each failure, up to 30 seconds.
+	 *
+	 * The round trip time of the connection is measured, and GetLinkDelay lets the
+	 * driver wait that much longer for ACKs and the rest of a frame than it would
+	 * for a local port.
+	 */
+	class TcpController: public Controller
+	{
+	public:
+		/**
+		 * Constructor.
+		 * Creates an object that represents a controller reached over TCP.
+		 */
+		TcpController();
+
+		/**
+		 * Destructor.
+		 * Closes the connection.
+		 */
+		virtual ~TcpController();
+
+		/**
+		 * Connect to the controller.
+		 * Like a serial port, the first attempt must succeed.  Later drops are retried by the read thread.
+		 * @param _address "host:port" or "tcp://host:port".
+		 * @return True if the connection was made.
+		 * @see Close, Read, Write
+		 */
+		bool Open( string const& _address );
+
+		/**
+		 * Close the connection.
+		 * @return True if the connection was closed, or false if it was already closed.
+		 * @see Open
+		 */
+		bool Close();
+
+		/**
+		 * Write to the controller.
+		 * @param _buffer Pointer to a block of memory containing the data to be written.
+		 * @param _length Length in bytes of the data.
+		 * @return The number of bytes written.
+		 * @see Read, Open, Close
+		 */
+		uint32 Write( uint8* _buffer, uint32 _length );
+
+		/**
+		 * @return The operating system's id for the read thread, or zero if the controller is not open.
+		 */
+		uint64 GetThreadId();
+
+		/**
+		 * @return The round trip time of the connection plus four times its variation, in milliseconds.
+		 */
+		uint32 GetLinkDelay();
+
+	private:
+		bool Connect( uint32 const _attempts );
+		void Disconnect();
+		bool Read( Event* _exitEvent );
+		void MeasureLinkDelay();
+
+		static void ReadThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ReadThreadProc( Event* _exitEvent );
+
+		string			m_host;
+		string			m_port;
+		intptr_t		m_socket;			// -1 while not connected.  Only the read thread changes it, under m_mutex.
+		Mutex*			m_mutex;			// Keeps Write off the socket while it is replaced
+		Thread*			m_thread;
+		bool			m_bOpen;
+		volatile uint32	m_linkDelay;
+		TimeStamp		m_nextMeasure;		// When to read the kernel's round trip estimate again
+	};
+
+} // namespace OpenZWave
+
+#endif //_TcpController_H
@@ -99,6 +99,17 @@ bool Thread::Stop
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+//	<Thread::Signal>
+//	Ask a function running on this thread to stop, without waiting for it
+//-----------------------------------------------------------------------------
+void Thread::Signal
+(
+)
+{
+	m_exitEvent->Set();
+}
+
 //-----------------------------------------------------------------------------
 //	<Thread::Sleep>
 //	Causes the thread to sleep for the specified number of milliseconds.
@@ -111,6 +122,28 @@ void Thread::Sleep
 	return( m_pImpl->Sleep( _milliseconds ) );
 }
 
+//-----------------------------------------------------------------------------
+//	<Thread::GetId>
+//	Get the operating system's id for the thread
+//-----------------------------------------------------------------------------
+uint64 Thread::GetId
+(
+)
+{
+	return m_pImpl->GetId();
+}
+
+//-----------------------------------------------------------------------------
+//	<Thread::GetCurrentId>
+//	Get the operating system's id for the calling thread
+//-----------------------------------------------------------------------------
+uint64 Thread::GetCurrentId
+(
+)
+{
+	return ThreadImpl::GetCurrentId();
+}
+
 //-----------------------------------------------------------------------------
 //	<Thread::IsSignalled>
 //	Test whether the event is set
@@ -72,12 +72,33 @@ namespace OpenZWave
 		 */
 		bool Stop();
 
+		/**
+		 * Ask a function running on this thread to stop, without waiting for it.
+		 * Stop must still be called to wait for it.  Signalling several threads
+		 * first lets them all wind down at the same time.
+		 * \see Stop
+		 */
+		void Signal();
+
 		/**
 		 * Causes the thread to sleep for the specified number of milliseconds.
 		 * \param _millisecs Number of milliseconds to sleep.
 		 */
 		void Sleep( uint32 _millisecs );
 
+		/**
+		 * Get the operating system's id for the thread, so that an application can
+		 * find it in system tools or keep its own threads off the same CPUs.
+		 * \return the thread id (the kernel thread id on Linux), or zero if the thread
+		 * has not started or the platform does not provide one.
+		 */
+		uint64 GetId();
+
+		/**
+		 * Get the operating system's id for the thread that calls this, as GetId gives it.
+		 */
+		static uint64 GetCurrentId();
+
 	protected:
 		/**
 		 * Used by the Wait class to test whether the thread has been completed.
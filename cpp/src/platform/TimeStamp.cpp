@@ -104,5 +104,16 @@ int32 TimeStamp::operator-
 	TimeStamp const& _other
 )
 {
-	return (int32)(m_pImpl - _other.m_pImpl);
+	return( *m_pImpl - *_other.m_pImpl );
+}
+
+//-----------------------------------------------------------------------------
+//	<TimeStamp::GetTicksNs>
+//	Read a high resolution clock in nanoseconds
+//-----------------------------------------------------------------------------
+uint64 TimeStamp::GetTicksNs
+(
+)
+{
+	return TimeStampImpl::GetTicksNs();
 }
@@ -78,7 +78,16 @@ namespace OpenZWave
 		 */
 		int32 operator- ( TimeStamp const& _other );
 
+		/**
+		 * Read a high resolution clock, for measuring short intervals.
+		 * \return nanoseconds from an arbitrary starting point.  Only the
+		 * difference between two readings has any meaning.
+		 */
+		static uint64 GetTicksNs();
+
 	private:
+		friend class Event;
+
 		TimeStamp( TimeStamp const& );				// prevent copy
 		TimeStamp& operator = ( TimeStamp const& );	// prevent assignment
 
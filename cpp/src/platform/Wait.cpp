@@ -49,7 +49,8 @@ void WaitMultipleCallback( void* _context );
 //-----------------------------------------------------------------------------
 Wait::Wait
 (
-)
+):
+	m_numWatchers( 0 )
 {
 	m_pImpl = new WaitImpl( this );
 }
@@ -84,6 +85,9 @@ void Wait::AddWatcher
 	// Add a ref so our object cannot disappear while being watched
 	AddRef();
 
+	// Counted first, as the watcher may be called as soon as it is added
+	AtomicIncrement( &m_numWatchers );
+
 	// Add the watcher (platform specific code required here for thread safety)
 	m_pImpl->AddWatcher( _callback, _context );
 }
@@ -100,6 +104,7 @@ void Wait::RemoveWatcher
 {
 	if( m_pImpl->RemoveWatcher( _callback, _context ) )
 	{
+		AtomicDecrement( &m_numWatchers );
 		Release();
 	}
 }
@@ -42,6 +42,7 @@ namespace OpenZWave
 	{
 		friend class WaitImpl;
 		friend class ThreadImpl;
+		friend class WaitSet;
 
 	public:
 		enum
@@ -95,6 +96,12 @@ namespace OpenZWave
 		 */
 		void Notify();
 
+		/**
+		 * \return true if anything is watching the object, so that a change of state
+		 * nothing is waiting for can skip Notify.
+		 */
+		bool HasWatchers()const{ return AtomicLoad( &m_numWatchers ) != 0; }
+
 		/**
 		 * Test whether an object is signalled.
 		 */
@@ -105,6 +112,7 @@ namespace OpenZWave
 		Wait& operator = ( Wait const& );		// prevent assignment
 	
 		WaitImpl*	m_pImpl;					// Pointer to an object that encapsulates the platform-specific implementation of a Wait object.
+		volatile uint32	m_numWatchers;			// Watchers added and not yet removed
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,175 @@
+//-----------------------------------------------------------------------------
+//
+//	WaitSet.cpp
+//
+//	A fixed set of objects that are waited on again and again
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include "Defs.h"
+#include "platform/WaitSet.h"
+#include "platform/Event.h"
+#include "platform/TimeStamp.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::WaitSet>
+//	Constructor
+//-----------------------------------------------------------------------------
+WaitSet::WaitSet
+(
+	Wait** _objects,
+	uint32 _numObjects
+):
+	m_objects( new Wait*[_numObjects] ),
+	m_numObjects( _numObjects ),
+	m_event( new Event() )
+{
+	for( uint32 i=0; i<m_numObjects; ++i )
+	{
+		m_objects[i] = _objects[i];
+		m_objects[i]->AddWatcher( WaitSetCallback, this );
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::~WaitSet>
+//	Destructor
+//-----------------------------------------------------------------------------
+WaitSet::~WaitSet
+(
+)
+{
+	for( uint32 i=0; i<m_numObjects; ++i )
+	{
+		m_objects[i]->RemoveWatcher( WaitSetCallback, this );
+	}
+	delete [] m_objects;
+	m_event->Release();
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::Multiple>
+//	Wait for one of the objects to become signalled
+//-----------------------------------------------------------------------------
+int32 WaitSet::Multiple
+(
+	uint32 _count,
+	int32 _timeout, // = -1
+	uint32 _ignore	// = 0
+)
+{
+	if( _count > m_numObjects )
+	{
+		_count = m_numObjects;
+	}
+
+	if( _timeout > 0 )
+	{
+		TimeStamp deadline;
+		deadline.SetTime( _timeout );
+		return MultipleUntil( _count, deadline, _ignore );
+	}
+
+	while( true )
+	{
+		// Reset before looking, so an object signalled after the check
+		// sets the event again and the wait below returns at once.
+		m_event->Reset();
+
+		int32 res = FirstSignalled( _count, _ignore );
+		if( res >= 0 || _timeout == 0 )
+		{
+			return res;
+		}
+
+		m_event->Wait( _timeout );
+
+		// The event is also set by objects beyond _count, or by an object that was
+		// reset again before we looked, so go round and check.
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::MultipleUntil>
+//	Wait for one of the objects to become signalled, or for a deadline to pass
+//-----------------------------------------------------------------------------
+int32 WaitSet::MultipleUntil
+(
+	uint32 _count,
+	TimeStamp& _deadline,
+	uint32 _ignore	// = 0
+)
+{
+	if( _count > m_numObjects )
+	{
+		_count = m_numObjects;
+	}
+
+	while( true )
+	{
+		m_event->Reset();
+
+		int32 res = FirstSignalled( _count, _ignore );
+		if( res >= 0 )
+		{
+			return res;
+		}
+
+		if( !m_event->WaitUntil( _deadline ) )
+		{
+			// The deadline passed, but an object may have been signalled just as it did
+			return FirstSignalled( _count, _ignore );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::FirstSignalled>
+//	Index of the first of the objects that is signalled, or -1 if none are
+//-----------------------------------------------------------------------------
+int32 WaitSet::FirstSignalled
+(
+	uint32 _count,
+	uint32 _ignore
+)const
+{
+	for( uint32 i=0; i<_count; ++i )
+	{
+		if( ( ( _ignore & ( 1 << i ) ) == 0 ) && m_objects[i]->IsSignalled() )
+		{
+			return (int32)i;
+		}
+	}
+	return -1;
+}
+
+//-----------------------------------------------------------------------------
+//	<WaitSet::WaitSetCallback>
+//	Called by an object in the set when it becomes signalled
+//-----------------------------------------------------------------------------
+void WaitSet::WaitSetCallback
+(
+	void* _context
+)
+{
+	WaitSet* waitSet = (WaitSet*)_context;
+	waitSet->m_event->Set();
+}
@@ -0,0 +1,88 @@
+//-----------------------------------------------------------------------------
+//
+//	WaitSet.h
+//
+//	A fixed set of objects that are waited on again and again
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _WaitSet_H
+#define _WaitSet_H
+
+#include "Defs.h"
+#include "platform/Wait.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class TimeStamp;
+
+	/** \brief Waits for one of a fixed list of objects, without setting anything up each time.
+	 *
+	 * Wait::Multiple creates an event and adds a watcher to every object on each call,
+	 * then removes them all again.  A WaitSet adds its watchers once, when it is created,
+	 * so a wait only has to check the objects and block on a single event.  Use it for a
+	 * loop that waits on the same objects every time round.
+	 */
+	class WaitSet
+	{
+	public:
+		/**
+		 * Constructor.  The objects are referenced until the set is destroyed.
+		 * \param _objects array of pointers to the objects to wait on.  Copied.
+		 * \param _numObjects number of objects in the array.
+		 */
+		WaitSet( Wait** _objects, uint32 _numObjects );
+		~WaitSet();
+
+		/**
+		 * Wait for one of the objects to become signalled, as Wait::Multiple does.
+		 * \param _count how many objects to wait on, from the start of the array.  The others are ignored.
+		 * \param _timeout optional maximum time to wait.  Defaults to -1, which means wait forever.
+		 * \param _ignore optional mask of objects to ignore, with bit n for the object at index n.
+		 * \return index of the signalled object with the lowest index, -1 if the wait timed out.
+		 */
+		int32 Multiple( uint32 _count, int32 _timeout = Wait::Timeout_Infinite, uint32 _ignore = 0 );
+
+		/**
+		 * Wait for one of the objects to become signalled, or for a deadline to pass.
+		 * A loop that waits more than once for the same thing can keep its deadline,
+		 * rather than working out the time left before each wait.
+		 * \param _count how many objects to wait on, from the start of the array.  The others are ignored.
+		 * \param _deadline when to give up.
+		 * \param _ignore optional mask of objects to ignore, with bit n for the object at index n.
+		 * \return index of the signalled object with the lowest index, -1 if the deadline passed.
+		 */
+		int32 MultipleUntil( uint32 _count, TimeStamp& _deadline, uint32 _ignore = 0 );
+
+	private:
+		WaitSet( WaitSet const& );					// prevent copy
+		WaitSet& operator = ( WaitSet const& );		// prevent assignment
+
+		static void WaitSetCallback( void* _context );
+		int32 FirstSignalled( uint32 _count, uint32 _ignore )const;
+
+		Wait**		m_objects;
+		uint32		m_numObjects;
+		Event*		m_event;						// Set whenever one of the objects is signalled
+	};
+
+} // namespace OpenZWave
+
+#endif //_WaitSet_H
@@ -27,6 +27,7 @@
 //-----------------------------------------------------------------------------
 #include "Defs.h"
 #include "EventImpl.h"
+#include "TimeStampImpl.h"
 
 #include <stdio.h>
 #include <sys/time.h>
@@ -46,13 +47,22 @@ EventImpl::EventImpl
 {
 	pthread_mutexattr_t ma;
 	pthread_mutexattr_init( &ma );
+#ifdef DEBUG
 	pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_ERRORCHECK );
+#else
+	// The lock is only held around the flag and the condition, never twice
+	pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_NORMAL );
+#endif
 	pthread_mutex_init( &m_lock, &ma );
 	pthread_mutexattr_destroy( &ma );
 	
 	pthread_condattr_t ca;
 	pthread_condattr_init( &ca );
 	pthread_condattr_setpshared( &ca, PTHREAD_PROCESS_PRIVATE );
+#ifdef OPENZWAVE_MONOTONIC_CLOCK
+	// Time out against the same clock as TimeStampImpl, so that setting the system time does not affect waits
+	pthread_condattr_setclock( &ca, CLOCK_MONOTONIC );
+#endif
 	pthread_cond_init( &m_condition, &ca );
 	pthread_condattr_destroy( &ca );
 }
@@ -160,6 +170,13 @@ bool EventImpl::Wait
 	int32 const _timeout /* milliseconds */
 )
 {
+	if( _timeout > 0 )
+	{
+		TimeStampImpl deadline;
+		deadline.SetTime( _timeout );
+		return WaitUntil( &deadline );
+	}
+
 	bool result = true;
 
 	int err = pthread_mutex_lock( &m_lock );
@@ -182,54 +199,6 @@ bool EventImpl::Wait
        		{
 			result = m_isSignaled;
 	        }
-	        else if( _timeout > 0 )
-		{
-			struct timeval now;
-			struct timespec abstime;
-
-			gettimeofday(&now, NULL);
-            
-			abstime.tv_sec = now.tv_sec + (_timeout / 1000);
-
-			// Now add the remainder of our timeout to the microseconds part of 'now'
-			now.tv_usec += (_timeout % 1000) * 1000;
-
-			// Careful now! Did it wrap?
-			while( now.tv_usec >= ( 1000 * 1000 ) )
-			{
-				// Yes it did so bump our seconds and subtract
-				now.tv_usec -= (1000 * 1000);
-				abstime.tv_sec++;
-			}
-            
-			abstime.tv_nsec = now.tv_usec * 1000;
-            
-			while( !m_isSignaled )
-			{
-				int oldstate;
-				pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
-
-				err = pthread_cond_timedwait( &m_condition, &m_lock, &abstime );
-
-				pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
-
-				if( err == ETIMEDOUT )
-				{
-					result = false;
-					break;
-				}
-				else
-					if( err == 0 )
-					{
-						result = true;
-					}
-					else
-					{
-						fprintf(stderr,   "EventImpl::Wait cond timedwait error %d (%d)\n", errno, err );
-						assert( 0 );
-					}
-			}
-		}
 		else
 		{
 			while( !m_isSignaled )
@@ -260,3 +229,68 @@ bool EventImpl::Wait
 	return result;
 }
 
+//-----------------------------------------------------------------------------
+//	<EventImpl::WaitUntil>
+//	Wait for the event to become signalled, until a deadline on the clock
+//	the condition variable uses, so a wait that is woken early and goes
+//	round again does not have to work out how long is left.
+//-----------------------------------------------------------------------------
+bool EventImpl::WaitUntil
+(
+	TimeStampImpl* _deadline
+)
+{
+	bool result = true;
+
+	int err = pthread_mutex_lock( &m_lock );
+	if( err != 0 )
+	{
+		fprintf(stderr,  "EventImpl::WaitUntil lock error %d (%d)\n", errno, err );
+		assert( 0 );
+	}
+	if( m_isSignaled )
+	{
+		if ( !m_manualReset )
+		{
+			m_isSignaled = false;
+		}
+	}
+	else
+	{
+		++m_waitingThreads;
+		while( !m_isSignaled )
+		{
+			int oldstate;
+			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
+
+			err = pthread_cond_timedwait( &m_condition, &m_lock, &_deadline->m_stamp );
+
+			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
+
+			if( err == ETIMEDOUT )
+			{
+				result = false;
+				break;
+			}
+			else if( err == 0 )
+			{
+				result = true;
+			}
+			else
+			{
+				fprintf(stderr,   "EventImpl::WaitUntil cond timedwait error %d (%d)\n", errno, err );
+				assert( 0 );
+			}
+		}
+		--m_waitingThreads;
+	}
+
+	err = pthread_mutex_unlock( &m_lock );
+	if( err != 0 )
+	{
+		fprintf(stderr, "EventImpl::WaitUntil unlock error %d (%d)\n", errno, err );
+		assert( 0 );
+	}
+	return result;
+}
+
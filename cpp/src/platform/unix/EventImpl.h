@@ -33,6 +33,8 @@
 
 namespace OpenZWave
 {
+	class TimeStampImpl;
+
 	class EventImpl
 	{
 	private:
@@ -47,6 +49,7 @@ namespace OpenZWave
 		void Reset();
 		
 		bool Wait( int32 _timeout );	// The wait method is to be used only by the Wait::Multiple method
+		bool WaitUntil( TimeStampImpl* _deadline );	// Wait until a deadline, for the WaitSet::MultipleUntil method
 		bool IsSignalled();
 
 		pthread_mutex_t		m_lock;
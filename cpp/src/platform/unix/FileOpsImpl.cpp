@@ -27,6 +27,11 @@
 //-----------------------------------------------------------------------------
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "FileOpsImpl.h"
 
 using namespace OpenZWave;
@@ -69,3 +74,125 @@ bool FileOpsImpl::FolderExists
 	else
 		return false;
 }
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::ReplaceFile>
+//	Flush a new file to disk and rename it over an existing one
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::ReplaceFile
+(
+	const string &_newFileName,
+	const string &_fileName
+)
+{
+	int fd = open( _newFileName.c_str(), O_RDWR );
+	if( fd < 0 )
+	{
+		return false;
+	}
+	bool synced = ( fsync( fd ) == 0 );
+	close( fd );
+
+	return( synced && rename( _newFileName.c_str(), _fileName.c_str() ) == 0 );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::FileInfo>
+//	Get the size and modification time of a file
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::FileInfo
+(
+	const string &_fileName,
+	uint32 &_size,
+	uint32 &_modified
+)
+{
+	struct stat st;
+	if( stat( _fileName.c_str(), &st ) != 0 || !S_ISREG( st.st_mode ) )
+	{
+		return false;
+	}
+	_size = (uint32)st.st_size;
+	_modified = (uint32)st.st_mtime;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::MapFile>
+//	Map a file into memory for reading
+//-----------------------------------------------------------------------------
+uint8 const* FileOpsImpl::MapFile
+(
+	const string &_fileName,
+	uint32 &_size
+)
+{
+	int fd = open( _fileName.c_str(), O_RDONLY );
+	if( fd < 0 )
+	{
+		return NULL;
+	}
+
+	void* data = MAP_FAILED;
+	struct stat st;
+	if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+	{
+		data = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	}
+	// The mapping stays valid once the descriptor is closed
+	close( fd );
+
+	if( data == MAP_FAILED )
+	{
+		return NULL;
+	}
+	_size = (uint32)st.st_size;
+	return (uint8 const*)data;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::UnmapFile>
+//	Release a mapping made by MapFile
+//-----------------------------------------------------------------------------
+void FileOpsImpl::UnmapFile
+(
+	uint8 const* _data,
+	uint32 _size
+)
+{
+	munmap( (void*)_data, _size );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::CreateSharedFile>
+//	Create a file mapped for writing
+//-----------------------------------------------------------------------------
+uint8* FileOpsImpl::CreateSharedFile
+(
+	const string &_fileName,
+	uint32 _size
+)
+{
+	// A new file rather than the old one truncated, which would fault any
+	// process still reading the old one
+	unlink( _fileName.c_str() );
+	int fd = open( _fileName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644 );
+	if( fd < 0 )
+	{
+		return NULL;
+	}
+
+	void* data = MAP_FAILED;
+	if( ftruncate( fd, (off_t)_size ) == 0 )
+	{
+		data = mmap( NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	}
+	close( fd );
+
+	if( data == MAP_FAILED )
+	{
+		unlink( _fileName.c_str() );
+		return NULL;
+	}
+	return (uint8*)data;
+}
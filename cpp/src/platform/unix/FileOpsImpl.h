@@ -44,6 +44,11 @@ namespace OpenZWave
 		~FileOpsImpl();
 
 		bool FolderExists( string _filename );
+		bool ReplaceFile( const string &_newFileName, const string &_fileName );
+		bool FileInfo( const string &_fileName, uint32 &_size, uint32 &_modified );
+		uint8 const* MapFile( const string &_fileName, uint32 &_size );
+		void UnmapFile( uint8 const* _data, uint32 _size );
+		uint8* CreateSharedFile( const string &_fileName, uint32 _size );
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,441 @@
+//-----------------------------------------------------------------------------
+//
+//	IoReactor.cpp
+//
+//	One thread that waits on the file descriptors of many controllers
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "Defs.h"
+#include "platform/Log.h"
+#include "platform/Thread.h"
+#include "IoReactor.h"
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+using namespace OpenZWave;
+
+pthread_once_t	IoReactor::s_once = PTHREAD_ONCE_INIT;
+pthread_mutex_t	IoReactor::s_instanceMutex;
+IoReactor*		IoReactor::s_instance = NULL;
+uint32			IoReactor::s_refs = 0;
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Init>
+// Create the mutex guarding the instance, once per process
+//-----------------------------------------------------------------------------
+void IoReactor::Init
+(
+)
+{
+	pthread_mutex_init( &s_instanceMutex, NULL );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Get>
+// Get the reactor, creating it if need be
+//-----------------------------------------------------------------------------
+IoReactor* IoReactor::Get
+(
+)
+{
+	pthread_once( &s_once, IoReactor::Init );
+	pthread_mutex_lock( &s_instanceMutex );
+	if( !s_instance )
+	{
+		s_instance = new IoReactor();
+	}
+	++s_refs;
+	IoReactor* reactor = s_instance;
+	pthread_mutex_unlock( &s_instanceMutex );
+	return reactor;
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Release>
+// Give up a reference, destroying the reactor after the last
+//-----------------------------------------------------------------------------
+void IoReactor::Release
+(
+)
+{
+	pthread_mutex_lock( &s_instanceMutex );
+	if( --s_refs == 0 )
+	{
+		delete s_instance;
+		s_instance = NULL;
+	}
+	pthread_mutex_unlock( &s_instanceMutex );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::IoReactor>
+// Constructor
+//-----------------------------------------------------------------------------
+IoReactor::IoReactor
+(
+):
+	m_current( NULL ),
+	m_stopping( false ),
+	m_thread( new Thread( "io" ) ),
+	m_wakeRead( -1 ),
+	m_wakeWrite( -1 )
+{
+	pthread_mutex_init( &m_mutex, NULL );
+	pthread_cond_init( &m_callDone, NULL );
+
+#ifdef __linux__
+	m_wakeRead = m_wakeWrite = eventfd( 0, EFD_NONBLOCK );
+#else
+	int fds[2];
+	if( pipe( fds ) == 0 )
+	{
+		fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL, 0 ) | O_NONBLOCK );
+		fcntl( fds[1], F_SETFL, fcntl( fds[1], F_GETFL, 0 ) | O_NONBLOCK );
+		m_wakeRead = fds[0];
+		m_wakeWrite = fds[1];
+	}
+#endif
+
+	m_thread->Start( IoReactor::ThreadEntryPoint, this );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::~IoReactor>
+// Destructor
+//-----------------------------------------------------------------------------
+IoReactor::~IoReactor
+(
+)
+{
+	pthread_mutex_lock( &m_mutex );
+	m_stopping = true;
+	pthread_mutex_unlock( &m_mutex );
+	Wake();
+
+	m_thread->Stop();
+	m_thread->Release();
+
+	if( m_wakeWrite != m_wakeRead )
+		close( m_wakeWrite );
+	if( m_wakeRead >= 0 )
+		close( m_wakeRead );
+
+	for( vector<Entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+	{
+		delete *it;
+	}
+
+	pthread_cond_destroy( &m_callDone );
+	pthread_mutex_destroy( &m_mutex );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Add>
+// Register a handler
+//-----------------------------------------------------------------------------
+void IoReactor::Add
+(
+	Handler* _handler
+)
+{
+	pthread_mutex_lock( &m_mutex );
+	if( !Find( _handler ) )
+	{
+		Entry* entry = new Entry();
+		entry->m_handler = _handler;
+		entry->m_fd = -1;
+		entry->m_timerSet = false;
+		m_entries.push_back( entry );
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Remove>
+// Unregister a handler, waiting for any call to it to finish
+//-----------------------------------------------------------------------------
+void IoReactor::Remove
+(
+	Handler* _handler
+)
+{
+	pthread_mutex_lock( &m_mutex );
+	for( vector<Entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+	{
+		if( (*it)->m_handler == _handler )
+		{
+			delete *it;
+			m_entries.erase( it );
+			break;
+		}
+	}
+
+	// A handler removing itself is left to return by itself
+	while( m_current == _handler && !pthread_equal( m_threadId, pthread_self() ) )
+	{
+		pthread_cond_wait( &m_callDone, &m_mutex );
+	}
+	pthread_mutex_unlock( &m_mutex );
+	Wake();
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Watch>
+// Change the descriptor watched for a handler
+//-----------------------------------------------------------------------------
+void IoReactor::Watch
+(
+	Handler* _handler,
+	int const _fd
+)
+{
+	pthread_mutex_lock( &m_mutex );
+	if( Entry* entry = Find( _handler ) )
+	{
+		entry->m_fd = _fd;
+	}
+	pthread_mutex_unlock( &m_mutex );
+	Wake();
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::SetTimer>
+// Call a handler back after a delay
+//-----------------------------------------------------------------------------
+void IoReactor::SetTimer
+(
+	Handler* _handler,
+	int32 const _milliseconds
+)
+{
+	pthread_mutex_lock( &m_mutex );
+	if( Entry* entry = Find( _handler ) )
+	{
+		entry->m_timerSet = true;
+		entry->m_timer.SetTime( _milliseconds );
+	}
+	pthread_mutex_unlock( &m_mutex );
+	Wake();
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::GetThreadId>
+// Get the operating system's id for the reactor's thread
+//-----------------------------------------------------------------------------
+uint64 IoReactor::GetThreadId
+(
+)
+{
+	return m_thread->GetId();
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Find>
+// Find the entry for a handler.  Called with m_mutex held.
+//-----------------------------------------------------------------------------
+IoReactor::Entry* IoReactor::Find
+(
+	Handler* _handler
+)
+{
+	for( vector<Entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+	{
+		if( (*it)->m_handler == _handler )
+		{
+			return *it;
+		}
+	}
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Wake>
+// Make the reactor's thread return from poll
+//-----------------------------------------------------------------------------
+void IoReactor::Wake
+(
+)
+{
+	if( m_wakeWrite >= 0 )
+	{
+		uint64 one = 1;
+		if( write( m_wakeWrite, &one, sizeof(one) ) < 0 && errno != EAGAIN )
+		{
+			Log::Write( LogLevel_Warning, "WARNING: Cannot wake the I/O thread. Error code %d", errno );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::ThreadEntryPoint>
+// Entry point of the reactor's thread
+//-----------------------------------------------------------------------------
+void IoReactor::ThreadEntryPoint
+(
+	Event* _exitEvent,
+	void* _context
+)
+{
+	IoReactor* reactor = (IoReactor*)_context;
+	if( reactor )
+	{
+		reactor->ThreadProc();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::Call>
+// Call a handler without m_mutex held, if it is still registered.  Called
+// with m_mutex held.
+//-----------------------------------------------------------------------------
+void IoReactor::Call
+(
+	Handler* _handler,
+	bool const _timer,
+	bool const _failed
+)
+{
+	if( !Find( _handler ) )
+	{
+		// Removed by an earlier call
+		return;
+	}
+
+	m_current = _handler;
+	pthread_mutex_unlock( &m_mutex );
+	if( _timer )
+	{
+		_handler->OnTimer();
+	}
+	else
+	{
+		_handler->OnReadable( _failed );
+	}
+	pthread_mutex_lock( &m_mutex );
+	m_current = NULL;
+	pthread_cond_broadcast( &m_callDone );
+}
+
+//-----------------------------------------------------------------------------
+// <IoReactor::ThreadProc>
+// Wait on every watched descriptor, and call back the handlers that are ready
+//-----------------------------------------------------------------------------
+void IoReactor::ThreadProc
+(
+)
+{
+	vector<struct pollfd> fds;
+	vector<Handler*> handlers;		// The handler for each of fds after the first
+	vector<Handler*> timers;
+
+	pthread_mutex_lock( &m_mutex );
+	m_threadId = pthread_self();
+	while( !m_stopping )
+	{
+		fds.clear();
+		handlers.clear();
+
+		struct pollfd wake;
+		wake.fd = m_wakeRead;
+		wake.events = POLLIN;
+		wake.revents = 0;
+		fds.push_back( wake );
+
+		int timeout = -1;
+		for( vector<Entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+		{
+			Entry* entry = *it;
+			if( entry->m_fd >= 0 )
+			{
+				struct pollfd pfd;
+				pfd.fd = entry->m_fd;
+				pfd.events = POLLIN;
+				pfd.revents = 0;
+				fds.push_back( pfd );
+				handlers.push_back( entry->m_handler );
+			}
+			if( entry->m_timerSet )
+			{
+				int32 remaining = entry->m_timer.TimeRemaining();
+				if( remaining < 0 )
+				{
+					remaining = 0;
+				}
+				if( timeout < 0 || remaining < timeout )
+				{
+					timeout = remaining;
+				}
+			}
+		}
+		pthread_mutex_unlock( &m_mutex );
+
+		int res = poll( &fds[0], fds.size(), timeout );
+		if( res < 0 && errno != EINTR )
+		{
+			Log::Write( LogLevel_Error, "ERROR: I/O thread failed waiting for data. Error code %d", errno );
+		}
+
+		if( fds[0].revents )
+		{
+			uint8 drain[8];
+			while( read( m_wakeRead, drain, sizeof(drain) ) > 0 )
+			{
+			}
+		}
+
+		pthread_mutex_lock( &m_mutex );
+		for( size_t i = 1; res > 0 && i < fds.size() && !m_stopping; ++i )
+		{
+			if( fds[i].revents )
+			{
+				// Only if the handler still watches the same descriptor
+				Entry* entry = Find( handlers[i-1] );
+				if( entry && entry->m_fd == fds[i].fd )
+				{
+					bool failed = !( fds[i].revents & POLLIN ) && ( fds[i].revents & ( POLLERR | POLLHUP | POLLNVAL ) );
+					Call( handlers[i-1], false, failed );
+				}
+			}
+		}
+
+		timers.clear();
+		for( vector<Entry*>::iterator it = m_entries.begin(); it != m_entries.end(); ++it )
+		{
+			Entry* entry = *it;
+			if( entry->m_timerSet && entry->m_timer.TimeRemaining() <= 0 )
+			{
+				entry->m_timerSet = false;
+				timers.push_back( entry->m_handler );
+			}
+		}
+		for( vector<Handler*>::iterator it = timers.begin(); it != timers.end() && !m_stopping; ++it )
+		{
+			Call( *it, true, false );
+		}
+	}
+	pthread_mutex_unlock( &m_mutex );
+}
@@ -0,0 +1,142 @@
+//-----------------------------------------------------------------------------
+//
+//	IoReactor.h
+//
+//	One thread that waits on the file descriptors of many controllers
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+#ifndef _IoReactor_H
+#define _IoReactor_H
+
+#include <pthread.h>
+#include <vector>
+
+#include "Defs.h"
+#include "platform/TimeStamp.h"
+
+namespace OpenZWave
+{
+	class Event;
+	class Thread;
+
+	/** \brief A thread shared by controllers to wait for their data.
+	 *
+	 * With the SharedThreads option, serial controllers do not start a read thread
+	 * each.  They register a Handler here and say which file descriptor to watch, and
+	 * the reactor's thread polls all of them at once, calling back the handler whose
+	 * descriptor has data.  A handler can also ask to be called back after a delay,
+	 * to open a port again after it has failed.
+	 *
+	 * Handlers are only ever called on the reactor's thread, one at a time, so they
+	 * must not block.  The reactor is created by the first Get and destroyed by the
+	 * last Release.
+	 */
+	class IoReactor
+	{
+	public:
+		class Handler
+		{
+		public:
+			virtual ~Handler(){}
+
+			/**
+			 * The descriptor being watched has data, or, with _failed set, has
+			 * failed or been hung up.
+			 */
+			virtual void OnReadable( bool const _failed ) = 0;
+
+			/**
+			 * The delay set with SetTimer has passed.
+			 */
+			virtual void OnTimer() = 0;
+		};
+
+		/**
+		 * Get the reactor, creating it and starting its thread if need be.  Each Get
+		 * must be matched by a Release.
+		 */
+		static IoReactor* Get();
+		void Release();
+
+		/**
+		 * Register a handler, watching nothing yet.
+		 */
+		void Add( Handler* _handler );
+
+		/**
+		 * Unregister a handler.  Once this returns, the handler is not being called and
+		 * will not be called again, unless this is called from the handler itself.
+		 */
+		void Remove( Handler* _handler );
+
+		/**
+		 * Watch a descriptor for a handler, in place of any it watched before.
+		 * \param _fd the descriptor, or -1 to watch nothing.
+		 */
+		void Watch( Handler* _handler, int const _fd );
+
+		/**
+		 * Call a handler's OnTimer once, after a delay.
+		 */
+		void SetTimer( Handler* _handler, int32 const _milliseconds );
+
+		/**
+		 * \return the operating system's id for the reactor's thread.
+		 */
+		uint64 GetThreadId();
+
+	private:
+		struct Entry
+		{
+			Handler*	m_handler;
+			int			m_fd;
+			bool		m_timerSet;
+			TimeStamp	m_timer;
+		};
+
+		IoReactor();
+		~IoReactor();
+
+		static void Init();
+		static void ThreadEntryPoint( Event* _exitEvent, void* _context );
+		void ThreadProc();
+		Entry* Find( Handler* _handler );
+		void Call( Handler* _handler, bool const _timer, bool const _failed );
+		void Wake();
+
+		static pthread_once_t	s_once;
+		static pthread_mutex_t	s_instanceMutex;
+		static IoReactor*		s_instance;
+		static uint32			s_refs;
+
+		pthread_mutex_t			m_mutex;			// Guards m_entries, m_current and m_stopping
+		pthread_cond_t			m_callDone;			// Signalled when a call to a handler returns
+		vector<Entry*>			m_entries;
+		Handler*				m_current;			// The handler being called, if any
+		pthread_t				m_threadId;			// The reactor's thread, set before any handler is called
+		bool					m_stopping;
+		Thread*					m_thread;
+		int						m_wakeRead;			// Becomes readable when the descriptors or timers change
+		int						m_wakeWrite;		// The same as m_wakeRead for an eventfd, or the other end of a pipe
+	};
+
+} // namespace OpenZWave
+
+#endif //_IoReactor_H
@@ -116,14 +116,46 @@ void LogImpl::Write
 		va_list _args
 )
 {
-	// create a timestamp string
-	string timeStr = GetTimeStampString();
-	string nodeStr = GetNodeString( _nodeId );
-	string loglevelStr = GetLogLevelString(_logLevel);
+	WriteEntry( _logLevel, _nodeId, _format, _args, _logLevel <= m_saveLevel );
+}
 
+//-----------------------------------------------------------------------------
+//	<LogImpl::WriteNode>
+//	Write an entry from a node with its own log level
+//-----------------------------------------------------------------------------
+void LogImpl::WriteNode
+(
+		LogLevel _logLevel,
+		uint8 const _nodeId,
+		char const* _format,
+		va_list _args,
+		bool const _save
+)
+{
+	WriteEntry( _logLevel, _nodeId, _format, _args, _save );
+}
+
+//-----------------------------------------------------------------------------
+//	<LogImpl::WriteEntry>
+//	Write to the log, saving the entry or not as the caller decided
+//-----------------------------------------------------------------------------
+void LogImpl::WriteEntry
+(
+		LogLevel _logLevel,
+		uint8 const _nodeId,
+		char const* _format,
+		va_list _args,
+		bool const _save
+)
+{
 	// handle this message
-	if( (_logLevel <= m_queueLevel) || (_logLevel == LogLevel_Internal) )	// we're going to do something with this message...
+	if( _save || (_logLevel <= m_queueLevel) || (_logLevel == LogLevel_Internal) )	// we're going to do something with this message...
 	{
+		// create a timestamp string, only once we know the message is wanted
+		string timeStr = GetTimeStampString();
+		string nodeStr = GetNodeString( _nodeId );
+		string loglevelStr = GetLogLevelString(_logLevel);
+
 		char lineBuf[1024] = {0};
 		//int lineLen = 0;
 		if( _format != NULL && _format[0] != '\0' )
@@ -136,7 +168,7 @@ void LogImpl::Write
 		}
 
 		// should this message be saved to file (and possibly written to console?)
-		if( (_logLevel <= m_saveLevel) || (_logLevel == LogLevel_Internal) )
+		if( _save || (_logLevel == LogLevel_Internal) )
 		{
 			std::string outBuf;
 
@@ -147,10 +179,9 @@ void LogImpl::Write
 					outBuf.append(timeStr);
 					outBuf.append(loglevelStr);
 					outBuf.append(nodeStr);
-					outBuf.append(lineBuf);
-					outBuf.append("\n");
-
 				}
+				outBuf.append(lineBuf);
+				outBuf.append("\n");
 
 				// print message to file (and possibly screen)
 				if( this->pFile != NULL )
@@ -166,12 +197,9 @@ void LogImpl::Write
 			}
 		}
 
-		if( _logLevel != LogLevel_Internal )
+		if( (_logLevel <= m_queueLevel) && (_logLevel != LogLevel_Internal) )
 		{
-			char queueBuf[1024];
-			string threadStr = GetThreadId();
-			snprintf( queueBuf, sizeof(queueBuf), "%s%s%s", timeStr.c_str(), threadStr.c_str(), lineBuf );
-			Queue( queueBuf );
+			Queue( timeStr, lineBuf );
 		}
 	}
 
@@ -182,21 +210,18 @@ void LogImpl::Write
 
 //-----------------------------------------------------------------------------
 //	<LogImpl::Queue>
-//	Write to the log queue
+//	Write to the log queue, formatting the line straight into its ring
 //-----------------------------------------------------------------------------
 void LogImpl::Queue
 (
-		char const* _buffer
+		string const& _timeStr,
+		char const* _line
 )
 {
-	string bufStr = _buffer;
-	m_logQueue.push_back( bufStr );
-
-	// rudimentary queue size management
-	if( m_logQueue.size() > 500 )
-	{
-		m_logQueue.pop_front();
-	}
+	uint32 length = 1024;
+	char* buffer = m_logQueue.Reserve( length );
+	int written = snprintf( buffer, length, "%s%08lx %s", _timeStr.c_str(), (long unsigned int)pthread_self(), _line );
+	m_logQueue.Commit( ( written < 0 ) ? 0 : (uint32)written );
 }
 
 //-----------------------------------------------------------------------------
@@ -210,14 +235,11 @@ void LogImpl::QueueDump
 	Log::Write( LogLevel_Always, "" );
 	Log::Write( LogLevel_Always, "Dumping queued log messages");
 	Log::Write( LogLevel_Always, "" );
-	list<string>::iterator it = m_logQueue.begin();
-	while( it != m_logQueue.end() )
+	while( char const* line = m_logQueue.Front() )
 	{
-		string strTemp = *it;
-		Log::Write( LogLevel_Internal, strTemp.c_str() );
-		it++;
+		Log::Write( LogLevel_Internal, "%s", line );
+		m_logQueue.PopFront();
 	}
-	m_logQueue.clear();
 	Log::Write( LogLevel_Always, "" );
 	Log::Write( LogLevel_Always, "End of queued log message dump");
 	Log::Write( LogLevel_Always, "" );
@@ -231,7 +253,7 @@ void LogImpl::QueueClear
 (
 )
 {
-	m_logQueue.clear();
+	m_logQueue.Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -299,20 +321,6 @@ string LogImpl::GetNodeString
 		}
 }
 
-//-----------------------------------------------------------------------------
-//	<LogImpl::GetThreadId>
-//	Generate a string with formatted thread id
-//-----------------------------------------------------------------------------
-string LogImpl::GetThreadId
-(
-)
-{
-	char buf[20];
-	snprintf( buf, sizeof(buf), "%08lx ", (long unsigned int)pthread_self() );
-	string str = buf;
-	return str;
-}
-
 //-----------------------------------------------------------------------------
 //	<LogImpl::SetLogFileName>
 //	Provide a new log file name (applicable to future writes)
@@ -32,8 +32,8 @@
 #include <stdarg.h>
 #include <time.h>
 #include <sys/time.h>
-#include <list>
 #include "platform/Log.h"
+#include "platform/LogQueue.h"
 
 namespace OpenZWave
 {
@@ -46,15 +46,17 @@ namespace OpenZWave
 		~LogImpl();
 
 		void Write( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args );
-		void Queue( char const* _buffer );
+		void WriteNode( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args, bool const _save );
+		void WriteEntry( LogLevel _level, uint8 const _nodeId, char const* _format, va_list _args, bool const _save );
+		void Queue( string const& _timeStr, char const* _line );
 		void QueueDump();
 		void QueueClear();
 		void SetLoggingState( LogLevel _saveLevel, LogLevel _queueLevel, LogLevel _dumpTrigger );
 		void SetLogFileName( const string &_filename );
+		uint32 GetQueueMemoryUsage(){ return m_logQueue.GetMemoryUsage(); }
 
 		string GetTimeStampString();
 		string GetNodeString( uint8 const _nodeId );
-		string GetThreadId();
 		string GetLogLevelString(LogLevel _level);
 		unsigned int toEscapeCode(LogLevel _level);
 
@@ -62,7 +64,7 @@ namespace OpenZWave
 		string m_filename;						/**< filename specified by user (default is ozw_log.txt) */
 		bool m_bConsoleOutput;					/**< if true, send log output to console as well as to the file */
 		bool m_bAppendLog;						/**< if true, the log file should be appended to any with the same name */
-		list<string> m_logQueue;				/**< list of queued log messages */
+		LogQueue m_logQueue;					/**< ring of queued log messages */
 		LogLevel m_saveLevel;
 		LogLevel m_queueLevel;
 		LogLevel m_dumpTrigger;
@@ -41,13 +41,26 @@ using namespace OpenZWave;
 //-----------------------------------------------------------------------------
 MutexImpl::MutexImpl
 (
+	bool const _recursive
 ):
 	m_lockCount( 0 )
 {
 	pthread_mutexattr_t ma;
 
 	pthread_mutexattr_init ( &ma );
-	pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_RECURSIVE );
+	if( _recursive )
+	{
+		pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_RECURSIVE );
+	}
+	else
+	{
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP
+		// glibc spins briefly before sleeping, as the locks are held for a short time
+		pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_ADAPTIVE_NP );
+#else
+		pthread_mutexattr_settype( &ma, PTHREAD_MUTEX_NORMAL );
+#endif
+	}
 	int err = pthread_mutex_init( &m_criticalSection, &ma );
 	if( err != 0 )
 	{
@@ -25,10 +25,10 @@
 //	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
 //
 //-----------------------------------------------------------------------------
-#include <sys/select.h>
+#include <poll.h>
 #include <unistd.h>
-#include <pthread.h>
 #include "Defs.h"
+#include "Options.h"
 #include "platform/Thread.h"
 #include "platform/Event.h"
 #include "SerialControllerImpl.h"
@@ -36,6 +36,9 @@
 
 #ifdef __linux__
 #include <libudev.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <linux/serial.h>
 #endif
 
 using namespace OpenZWave;
@@ -49,8 +52,25 @@ SerialControllerImpl::SerialControllerImpl
 	SerialController* _owner
 ):
 	m_owner( _owner ),
-	m_hSerialController( -1 )
+	m_hSerialController( -1 ),
+	m_pThread( NULL ),
+	m_wakeRead( -1 ),
+	m_wakeWrite( -1 ),
+	m_reactor( NULL ),
+	m_attempts( 0 )
 {
+#ifdef __linux__
+	m_wakeRead = m_wakeWrite = eventfd( 0, EFD_NONBLOCK );
+#else
+	int fds[2];
+	if( pipe( fds ) == 0 )
+	{
+		fcntl( fds[0], F_SETFL, fcntl( fds[0], F_GETFL, 0 ) | O_NONBLOCK );
+		fcntl( fds[1], F_SETFL, fcntl( fds[1], F_GETFL, 0 ) | O_NONBLOCK );
+		m_wakeRead = fds[0];
+		m_wakeWrite = fds[1];
+	}
+#endif
 }
 
 //-----------------------------------------------------------------------------
@@ -64,6 +84,10 @@ SerialControllerImpl::~SerialControllerImpl
 	flock(m_hSerialController, LOCK_UN);
 	if(m_hSerialController >= 0)
 		close( m_hSerialController );
+	if( m_wakeWrite != m_wakeRead )
+		close( m_wakeWrite );
+	if( m_wakeRead >= 0 )
+		close( m_wakeRead );
 }
 
 //-----------------------------------------------------------------------------
@@ -82,6 +106,23 @@ bool SerialControllerImpl::Open
 		return false;
 	}
 
+	bool shared = false;
+	Options::Get()->GetOptionAsBool( "SharedThreads", &shared );
+	if( shared )
+	{
+		// Let the shared I/O thread read the port
+		m_reactor = IoReactor::Get();
+		m_reactor->Add( this );
+		m_reactor->Watch( this, m_hSerialController );
+		return true;
+	}
+
+	// Forget any wake left over from an earlier Close
+	uint8 drain[8];
+	while( m_wakeRead >= 0 && read( m_wakeRead, drain, sizeof(drain) ) > 0 )
+	{
+	}
+
 	// Start the read thread
 	m_pThread = new Thread( "SerialController" );
 	m_pThread->Start( SerialReadThreadEntryPoint, this );
@@ -89,6 +130,21 @@ bool SerialControllerImpl::Open
 	return true;
 }
 
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::GetThreadId>
+// Get the operating system's id for the read thread
+//-----------------------------------------------------------------------------
+uint64 SerialControllerImpl::GetThreadId
+(
+)
+{
+	if( m_reactor )
+	{
+		return m_reactor->GetThreadId();
+	}
+	return m_pThread ? m_pThread->GetId() : 0;
+}
+
 //-----------------------------------------------------------------------------
 // <SerialControllerImpl::Close>
 // Close the serial port 
@@ -99,10 +155,18 @@ void SerialControllerImpl::Close
 {
 	if( m_pThread )
 	{
+		// Stop the read thread waiting for data, so it sees the exit event straight away
+		Wake();
 		m_pThread->Stop();
 		m_pThread->Release();
 		m_pThread = NULL;
 	}
+	if( m_reactor )
+	{
+		m_reactor->Remove( this );
+		m_reactor->Release();
+		m_reactor = NULL;
+	}
 	close( m_hSerialController );
 	m_hSerialController = -1;
 }
@@ -133,6 +197,9 @@ void SerialControllerImpl::ReadThreadProc
 	Event* _exitEvent
 )
 {  
+	bool hotReconnect = false;
+	Options::Get()->GetOptionAsBool( "HotReconnect", &hotReconnect );
+
 	uint32 attempts = 0;
 	while( true )
 	{
@@ -148,7 +215,15 @@ void SerialControllerImpl::ReadThreadProc
 			attempts = 0;
 		}
 
-		if( attempts < 25 )		
+		if( hotReconnect )
+		{
+			// Try again as soon as the device comes back
+			if( !WaitForDevice( _exitEvent, GetRetryDelay( attempts ) ) )
+			{
+				break;
+			}
+		}
+		else if( attempts < 25 )
 		{
 			// Retry every 5 seconds for the first two minutes...
 			if( Wait::Single( _exitEvent, 5000 ) >= 0 )
@@ -167,8 +242,117 @@ void SerialControllerImpl::ReadThreadProc
 			}
 		}
 
-		Init( ++attempts );
+		if( Init( ++attempts ) )
+		{
+			m_owner->Reconnected();
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::GetRetryDelay>
+// How long to wait before trying to open the port again
+//-----------------------------------------------------------------------------
+uint32 SerialControllerImpl::GetRetryDelay
+(
+	uint32 const _attempts
+)
+{
+	bool hotReconnect = false;
+	Options::Get()->GetOptionAsBool( "HotReconnect", &hotReconnect );
+	if( hotReconnect && _attempts < 120 )
+	{
+		// Every second for the first two minutes, in case the device's return is missed
+		return 1000;
+	}
+
+	// Every 5 seconds for the first two minutes, then every 30 seconds
+	return ( _attempts < 25 ) ? 5000 : 30000;
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::WaitForDevice>
+// Wait until the port's device file is created again, such as when a USB
+// stick that was reset comes back, or the timeout passes
+//-----------------------------------------------------------------------------
+bool SerialControllerImpl::WaitForDevice
+(
+	Event* _exitEvent,
+	int32 const _timeout
+)
+{
+#ifdef __linux__
+	string const& device = m_owner->m_serialControllerName;
+	string::size_type slash = device.rfind( '/' );
+	string dir = ( slash == string::npos ) ? "." : ( ( slash == 0 ) ? "/" : device.substr( 0, slash ) );
+	string name = ( slash == string::npos ) ? device : device.substr( slash + 1 );
+
+	int fd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+	if( fd >= 0 && inotify_add_watch( fd, dir.c_str(), IN_CREATE | IN_ATTRIB | IN_MOVED_TO ) >= 0 )
+	{
+		struct pollfd fds[2];
+		fds[0].fd = fd;
+		fds[0].events = POLLIN;
+		fds[1].fd = m_wakeRead;
+		fds[1].events = POLLIN;
+
+		TimeStamp due;
+		due.SetTime( _timeout );
+		bool found = false;
+		while( !found )
+		{
+			int32 remaining = due.TimeRemaining();
+			if( remaining <= 0 )
+			{
+				break;
+			}
+			fds[0].revents = 0;
+			fds[1].revents = 0;
+			int res = poll( fds, 2, remaining );
+			if( res < 0 && errno == EINTR )
+			{
+				continue;
+			}
+			if( res <= 0 )
+			{
+				break;
+			}
+			if( fds[1].revents )
+			{
+				// Close is stopping the thread
+				close( fd );
+				return false;
+			}
+
+			// Created, or made accessible by udev, under the port's name
+			uint64 buffer[512];
+			ssize_t length = read( fd, buffer, sizeof(buffer) );
+			char const* p = (char const*)buffer;
+			while( length > 0 && p < (char const*)buffer + length )
+			{
+				struct inotify_event const* event = (struct inotify_event const*)p;
+				if( event->len && name == event->name )
+				{
+					found = true;
+				}
+				p += sizeof(struct inotify_event) + event->len;
+			}
+		}
+		close( fd );
+		if( found )
+		{
+			Log::Write( LogLevel_Info, "Serial port %s has reappeared", device.c_str() );
+		}
+		return( Wait::Single( _exitEvent, 0 ) < 0 );
+	}
+
+	// The directory may have gone with the device, as /dev/serial/by-id does
+	if( fd >= 0 )
+	{
+		close( fd );
 	}
+#endif
+	return( Wait::Single( _exitEvent, _timeout ) < 0 );
 }
 
 //-----------------------------------------------------------------------------
@@ -239,8 +423,10 @@ bool SerialControllerImpl::Init
 	tios.c_lflag = 0;
 	for( int i = 0; i < NCCS; i++ )
 		tios.c_cc[i] = 0;
+	// The read thread waits in poll, so read only needs to take whatever
+	// has arrived, without waiting for more
 	tios.c_cc[VMIN] = 0;
-	tios.c_cc[VTIME] = 1;
+	tios.c_cc[VTIME] = 0;
 	switch( m_owner->m_baud )
 	{
 		case 300:
@@ -291,6 +477,14 @@ bool SerialControllerImpl::Init
 
 	tcflush( m_hSerialController, TCIOFLUSH );
 
+	bool lowLatency;
+	lowLatency = false;
+	Options::Get()->GetOptionAsBool( "SerialLowLatency", &lowLatency );
+	if( lowLatency )
+	{
+		SetLowLatency();
+	}
+
 	// Open successful
  	Log::Write( LogLevel_Info, "Serial port %s opened (attempt %d)", device.c_str(), _attempts );
 	return true;
@@ -305,44 +499,184 @@ SerialOpenFailure:
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::SetLowLatency>
+// Ask the serial driver to pass on received bytes at once
+//-----------------------------------------------------------------------------
+void SerialControllerImpl::SetLowLatency
+(
+)
+{
+#if defined __linux__ && defined ASYNC_LOW_LATENCY
+	// USB serial chips such as FTDI's hold received bytes back for up to
+	// their latency timer, 16ms by default, which this takes down to 1ms
+	struct serial_struct serial;
+	if( ioctl( m_hSerialController, TIOCGSERIAL, &serial ) == 0 )
+	{
+		serial.flags |= ASYNC_LOW_LATENCY;
+		if( ioctl( m_hSerialController, TIOCSSERIAL, &serial ) == 0 )
+		{
+			Log::Write( LogLevel_Info, "Serial port %s set to low latency", m_owner->m_serialControllerName.c_str() );
+			return;
+		}
+	}
+	Log::Write( LogLevel_Warning, "WARNING: Cannot set serial port %s to low latency. Error code %d", m_owner->m_serialControllerName.c_str(), errno );
+#else
+	Log::Write( LogLevel_Warning, "WARNING: SerialLowLatency is not supported on this platform" );
+#endif
+}
+
 //-----------------------------------------------------------------------------
 // <SerialControllerImpl::Read>
-// Read data from the serial port
+// Read data from the serial port until Close wakes us or the port fails
 //-----------------------------------------------------------------------------
 void SerialControllerImpl::Read
 (
 )
 {
-	uint8 buffer[256];
+	struct pollfd fds[2];
+	fds[0].fd = m_hSerialController;
+	fds[0].events = POLLIN;
+	fds[1].fd = m_wakeRead;
+	fds[1].events = POLLIN;
 
-	while( 1 )
-        {
-		int32 bytesRead;
-		int err;
+	while( true )
+	{
+		fds[0].revents = 0;
+		fds[1].revents = 0;
+		if( poll( fds, 2, -1 ) < 0 )
+		{
+			if( errno == EINTR )
+			{
+				continue;
+			}
+			Log::Write( LogLevel_Error, "ERROR: Failed waiting for data from serial port. Error code %d", errno );
+			break;
+		}
+
+		if( fds[1].revents )
+		{
+			// Close is stopping the thread
+			return;
+		}
 
-		do
+		if( fds[0].revents & POLLIN )
 		{
-			bytesRead = read( m_hSerialController, buffer, sizeof(buffer) );
-			if( bytesRead > 0 )
-				m_owner->Put( buffer, bytesRead );
-		} while( bytesRead > 0 );
+			if( !ReadAvailable() )
+			{
+				break;
+			}
+		}
+		else if( fds[0].revents & ( POLLERR | POLLHUP | POLLNVAL ) )
+		{
+			// The device has gone, such as a USB stick being pulled out
+			Log::Write( LogLevel_Error, "ERROR: Serial port closed unexpectedly" );
+			break;
+		}
+	}
+
+	// Let the read thread open the port again
+	flock( m_hSerialController, LOCK_UN );
+	close( m_hSerialController );
+	m_hSerialController = -1;
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::ReadAvailable>
+// Pass on whatever the port has received.  Returns false if the read failed.
+//-----------------------------------------------------------------------------
+bool SerialControllerImpl::ReadAvailable
+(
+)
+{
+	uint8 buffer[256];
+	int32 bytesRead;
+	do
+	{
+		bytesRead = read( m_hSerialController, buffer, sizeof(buffer) );
+		if( bytesRead > 0 )
+			m_owner->Received( buffer, bytesRead );
+	} while( bytesRead == sizeof(buffer) );
+
+	if( bytesRead < 0 && errno != EAGAIN && errno != EINTR )
+	{
+		Log::Write( LogLevel_Error, "ERROR: Failed to read from serial port. Error code %d", errno );
+		return false;
+	}
+	return true;
+}
 
-		do
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::OnReadable>
+// Called on the shared I/O thread when the port has data or has failed
+//-----------------------------------------------------------------------------
+void SerialControllerImpl::OnReadable
+(
+	bool const _failed
+)
+{
+	if( _failed )
+	{
+		// The device has gone, such as a USB stick being pulled out
+		Log::Write( LogLevel_Error, "ERROR: Serial port closed unexpectedly" );
+		PortFailed();
+	}
+	else if( !ReadAvailable() )
+	{
+		PortFailed();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::PortFailed>
+// Close the port and try to open it again later, as ReadThreadProc would
+//-----------------------------------------------------------------------------
+void SerialControllerImpl::PortFailed
+(
+)
+{
+	m_reactor->Watch( this, -1 );
+	flock( m_hSerialController, LOCK_UN );
+	close( m_hSerialController );
+	m_hSerialController = -1;
+
+	m_attempts = 0;
+	m_reactor->SetTimer( this, GetRetryDelay( 0 ) );
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::OnTimer>
+// Called on the shared I/O thread to open the port again after it failed
+//-----------------------------------------------------------------------------
+void SerialControllerImpl::OnTimer
+(
+)
+{
+	if( Init( ++m_attempts ) )
+	{
+		m_reactor->Watch( this, m_hSerialController );
+		m_owner->Reconnected();
+		return;
+	}
+
+	m_reactor->SetTimer( this, GetRetryDelay( m_attempts ) );
+}
+
+//-----------------------------------------------------------------------------
+// <SerialControllerImpl::Wake>
+// Make the read thread return from poll
+//-----------------------------------------------------------------------------
+void SerialControllerImpl::Wake
+(
+)
+{
+	if( m_wakeWrite >= 0 )
+	{
+		uint64 one = 1;
+		if( write( m_wakeWrite, &one, sizeof(one) ) < 0 )
 		{
-			struct timeval *whenp;
-			fd_set rds, eds;
-			int oldstate;
-
-			FD_ZERO( &rds );
-			FD_SET( m_hSerialController, &rds );
-			FD_ZERO( &eds );
-			FD_SET( m_hSerialController, &eds );
-			whenp = NULL;
-
-			pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &oldstate);
-			err = select( m_hSerialController + 1, &rds, NULL, &eds, whenp );
-			pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &oldstate);
-		} while( err <= 0 );
+			Log::Write( LogLevel_Warning, "WARNING: Cannot wake the serial port's read thread. Error code %d", errno );
+		}
 	}
 }
 
@@ -39,10 +39,11 @@
 
 #include "Defs.h"
 #include "platform/SerialController.h"
+#include "IoReactor.h"
 
 namespace OpenZWave
 {
-	class SerialControllerImpl
+	class SerialControllerImpl: public IoReactor::Handler
 	{
 	public:
 		void ReadThreadProc( Event* _exitEvent );
@@ -57,13 +58,28 @@ namespace OpenZWave
 		void Close();
 
 		uint32 Write( uint8* _buffer, uint32 _length );
+		uint64 GetThreadId();
 
 		bool Init( uint32 const _attempts );
+		void SetLowLatency();
 		void Read();
+		bool ReadAvailable();
+		void PortFailed();
+		void Wake();
+		bool WaitForDevice( Event* _exitEvent, int32 const _timeout );	// False if Close is stopping the thread
+		static uint32 GetRetryDelay( uint32 const _attempts );
+
+		// With the SharedThreads option, the port is read from the IoReactor's thread
+		void OnReadable( bool const _failed );
+		void OnTimer();
 
 		SerialController*	m_owner;
 		int			m_hSerialController;
 		Thread*			m_pThread;
+		int			m_wakeRead;		// Becomes readable when Close wants the read thread to stop waiting for data
+		int			m_wakeWrite;		// The same as m_wakeRead for an eventfd, or the other end of a pipe
+		IoReactor*		m_reactor;		// Reads the port in place of m_pThread, or NULL
+		uint32			m_attempts;		// Failed attempts to open the port again, when using m_reactor
 
 		static void SerialReadThreadEntryPoint( Event* _exitEvent, void* _content );
 	};
@@ -26,9 +26,18 @@
 //
 //-----------------------------------------------------------------------------
 #include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #include "Defs.h"
+#include "Options.h"
 #include "platform/Event.h"
 #include "platform/Thread.h"
+#include "platform/Log.h"
 #include "ThreadImpl.h"
 
 #ifdef DARWIN
@@ -49,7 +58,8 @@ ThreadImpl::ThreadImpl
 	m_owner( _owner ),
 //	m_hThread( NULL ),  /* p_thread_t isn't a pointer in Linux, so can't do this */
 	m_bIsRunning( false ),
-	m_name( _tname )
+	m_name( _tname ),
+	m_id( 0 )
 {
 }
 
@@ -172,6 +182,9 @@ void ThreadImpl::Run
 ( 
 )
 {
+	m_id = GetCurrentId();
+	ApplySchedulingOptions();
+
 	m_bIsRunning = true;
 	m_pfnThreadProc( m_exitEvent, m_pContext );
 	m_bIsRunning = false;
@@ -179,3 +192,134 @@ void ThreadImpl::Run
 	// Let any watchers know that the thread has finished running
 	m_owner->Notify();
 }
+
+//-----------------------------------------------------------------------------
+//	<ThreadImpl::GetCurrentId>
+//	Get the operating system's id for the calling thread
+//-----------------------------------------------------------------------------
+uint64 ThreadImpl::GetCurrentId
+(
+)
+{
+#ifdef __linux__
+	return (uint64)syscall( SYS_gettid );
+#else
+	return (uint64)(uintptr_t)pthread_self();
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<ThreadImpl::ApplySchedulingOptions>
+//	Set the CPU affinity and priority given for this thread in the options
+//-----------------------------------------------------------------------------
+void ThreadImpl::ApplySchedulingOptions
+(
+)
+{
+	string value;
+	if( GetSchedulingOption( "ThreadAffinity", &value ) )
+	{
+#ifdef __linux__
+		// A list of CPUs and ranges of CPUs, such as 1,2 or 0-3
+		cpu_set_t cpus;
+		CPU_ZERO( &cpus );
+		char const* pos = value.c_str();
+		while( *pos )
+		{
+			char* end;
+			long first = strtol( pos, &end, 10 );
+			long last = first;
+			if( end == pos )
+			{
+				break;
+			}
+			if( *end == '-' )
+			{
+				pos = end + 1;
+				last = strtol( pos, &end, 10 );
+			}
+			for( long cpu = first; cpu <= last && cpu >= 0 && cpu < CPU_SETSIZE; ++cpu )
+			{
+				CPU_SET( cpu, &cpus );
+			}
+			pos = ( *end == ',' ) ? end + 1 : end;
+		}
+
+		int err = pthread_setaffinity_np( pthread_self(), sizeof(cpus), &cpus );
+		if( err != 0 )
+		{
+			Log::Write( LogLevel_Warning, "Thread %s: unable to set CPU affinity %s (error %d)", m_name.c_str(), value.c_str(), err );
+		}
+#else
+		Log::Write( LogLevel_Warning, "Thread %s: CPU affinity is not supported on this platform", m_name.c_str() );
+#endif
+	}
+
+	if( GetSchedulingOption( "ThreadPriority", &value ) )
+	{
+		// fifo:<priority> for the real-time SCHED_FIFO policy, or nice:<value>
+		int err = EINVAL;
+		if( value.compare( 0, 5, "fifo:" ) == 0 )
+		{
+			struct sched_param param;
+			param.sched_priority = atoi( value.c_str() + 5 );
+			err = pthread_setschedparam( pthread_self(), SCHED_FIFO, &param );
+		}
+		else if( value.compare( 0, 5, "nice:" ) == 0 )
+		{
+#ifdef __linux__
+			// On Linux the nice value belongs to each thread
+			err = ( setpriority( PRIO_PROCESS, (id_t)m_id, atoi( value.c_str() + 5 ) ) == 0 ) ? 0 : errno;
+#else
+			err = ENOTSUP;
+#endif
+		}
+
+		if( err != 0 )
+		{
+			Log::Write( LogLevel_Warning, "Thread %s: unable to set priority %s (error %d)", m_name.c_str(), value.c_str(), err );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<ThreadImpl::GetSchedulingOption>
+//	Find this thread's entry in an option of the form "name=value name=value"
+//-----------------------------------------------------------------------------
+bool ThreadImpl::GetSchedulingOption
+(
+	string const& _option,
+	string* o_value
+)
+{
+	Options* options = Options::Get();
+	string setting;
+	if( options == NULL || !options->GetOptionAsString( _option, &setting ) )
+	{
+		return false;
+	}
+
+	size_t pos = 0;
+	while( pos < setting.size() )
+	{
+		size_t start = setting.find_first_not_of( " \t", pos );
+		if( start == string::npos )
+		{
+			break;
+		}
+		size_t end = setting.find_first_of( " \t", start );
+		if( end == string::npos )
+		{
+			end = setting.size();
+		}
+
+		size_t equals = setting.find( '=', start );
+		if( equals < end && setting.compare( start, equals - start, m_name ) == 0 )
+		{
+			*o_value = setting.substr( equals + 1, end - equals - 1 );
+			return !o_value->empty();
+		}
+		pos = end;
+	}
+	return false;
+}
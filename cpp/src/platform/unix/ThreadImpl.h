@@ -50,8 +50,12 @@ namespace OpenZWave
         void Sleep( uint32 _millisecs );
         bool IsSignalled();
         bool Terminate();
+        uint64 GetId(){ return m_id; }
+        static uint64 GetCurrentId();
 
         void Run();
+        void ApplySchedulingOptions();
+        bool GetSchedulingOption( string const& _option, string* o_value );
         static void* ThreadProc( void *parg);
 
         Thread*                 m_owner;
@@ -61,6 +65,7 @@ namespace OpenZWave
         void*                   m_pContext;
         bool                    m_bIsRunning;
         string                  m_name;
+        uint64                  m_id;
     };
 } // namespace OpenZWave
 
@@ -62,23 +62,22 @@ void TimeStampImpl::SetTime
 	int32 _milliseconds	// = 0
 )
 {
-    struct timeval now;
-    gettimeofday(&now, NULL);
-    
-    m_stamp.tv_sec = now.tv_sec + (_milliseconds / 1000);
-    
-    // Now add the remainder of our timeout to the microseconds part of 'now'
-    now.tv_usec += ((_milliseconds % 1000) * 1000);
-    
-    // Careful now! Did it wrap?
-    if(now.tv_usec >= 1000000)
-    {
-        // Yes it did so bump our seconds and modulo
-        now.tv_usec %= 1000000;
-        m_stamp.tv_sec++;
-    }
-    
-    m_stamp.tv_nsec = now.tv_usec * 1000;
+	GetClock( m_stamp );
+
+	m_stamp.tv_sec += _milliseconds / 1000;
+	m_stamp.tv_nsec += (long)( _milliseconds % 1000 ) * 1000000;
+
+	// Careful now! Did it wrap?
+	if( m_stamp.tv_nsec >= 1000000000 )
+	{
+		m_stamp.tv_nsec -= 1000000000;
+		m_stamp.tv_sec++;
+	}
+	else if( m_stamp.tv_nsec < 0 )
+	{
+		m_stamp.tv_nsec += 1000000000;
+		m_stamp.tv_sec--;
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -89,18 +88,16 @@ int32 TimeStampImpl::TimeRemaining
 (
 )
 {
-    int32 diff;
-    
-    struct timeval now;   
-    gettimeofday(&now, NULL);
-    
-    // Seconds
-    diff = (int32)((m_stamp.tv_sec - now.tv_sec)*1000);
-    
-    // Milliseconds
-    diff += (((m_stamp.tv_nsec/1000)-now.tv_usec)/1000);
-    
-    return diff;
+	struct timespec now;
+	GetClock( now );
+
+	// Seconds
+	int32 diff = (int32)( ( m_stamp.tv_sec - now.tv_sec ) * 1000 );
+
+	// Milliseconds
+	diff += (int32)( ( m_stamp.tv_nsec - now.tv_nsec ) / 1000000 );
+
+	return diff;
 }
 
 //-----------------------------------------------------------------------------
@@ -111,13 +108,20 @@ string TimeStampImpl::GetAsString
 (
 )
 {
+	// The stamp may not be on the time of day clock, so express it as
+	// an offset from now and apply that to the time of day.
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	int64 ms = (int64)tv.tv_sec * 1000 + tv.tv_usec / 1000 + TimeRemaining();
+	time_t secs = (time_t)( ms / 1000 );
+
 	char str[100];
 	struct tm *tm;
-	tm = localtime( &m_stamp.tv_sec );
+	tm = localtime( &secs );
 
-	snprintf( str, sizeof(str), "%04d-%02d-%02d %02d:%02d:%02d:%03d ", 
+	snprintf( str, sizeof(str), "%04d-%02d-%02d %02d:%02d:%02d:%03d ",
 		  tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
-		  tm->tm_hour, tm->tm_min, tm->tm_sec, (int)(m_stamp.tv_nsec / (1000*1000)) );
+		  tm->tm_hour, tm->tm_min, tm->tm_sec, (int)( ms % 1000 ) );
 	return str;
 }
 
@@ -131,11 +135,43 @@ int32 TimeStampImpl::operator-
 	TimeStampImpl const& _other
 )
 {
-    // Seconds
-    int32 diff = (int32)((m_stamp.tv_sec-_other.m_stamp.tv_sec)*1000);
-    
-    // Milliseconds
-    diff += ((m_stamp.tv_nsec - _other.m_stamp.tv_nsec)/1000000);
-    
-    return diff;  
+	// Seconds
+	int32 diff = (int32)( ( m_stamp.tv_sec - _other.m_stamp.tv_sec ) * 1000 );
+
+	// Milliseconds
+	diff += (int32)( ( m_stamp.tv_nsec - _other.m_stamp.tv_nsec ) / 1000000 );
+
+	return diff;
+}
+
+//-----------------------------------------------------------------------------
+//	<TimeStampImpl::GetClock>
+//	Get the current time on the clock the timestamps use
+//-----------------------------------------------------------------------------
+void TimeStampImpl::GetClock
+(
+	struct timespec& o_now
+)
+{
+#ifdef OPENZWAVE_MONOTONIC_CLOCK
+	clock_gettime( CLOCK_MONOTONIC, &o_now );
+#else
+	struct timeval now;
+	gettimeofday( &now, NULL );
+	o_now.tv_sec = now.tv_sec;
+	o_now.tv_nsec = now.tv_usec * 1000;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+//	<TimeStampImpl::GetTicksNs>
+//	Read a high resolution clock in nanoseconds
+//-----------------------------------------------------------------------------
+uint64 TimeStampImpl::GetTicksNs
+(
+)
+{
+	struct timespec now;
+	GetClock( now );
+	return( (uint64)now.tv_sec * 1000000000ULL + (uint64)now.tv_nsec );
 }
@@ -33,6 +33,12 @@
 #include <sys/time.h>
 #include "Defs.h"
 
+// Measure time on a clock that is not changed when the system time is set,
+// where the condition variables used by EventImpl can be made to use it too.
+#if defined CLOCK_MONOTONIC && !defined DARWIN
+#define OPENZWAVE_MONOTONIC_CLOCK
+#endif
+
 namespace OpenZWave
 {
 	/** \brief Windows implementation of a timestamp.
@@ -78,7 +84,20 @@ namespace OpenZWave
 		 */
 		int32 operator- ( TimeStampImpl const& _other );
 
+		/**
+		 * Get the current time on the clock the timestamps are measured with.
+		 * This is CLOCK_MONOTONIC where it can be used, otherwise the time of day.
+		 */
+		static void GetClock( struct timespec& o_now );
+
+		/**
+		 * Read a high resolution clock in nanoseconds, for measuring short intervals.
+		 */
+		static uint64 GetTicksNs();
+
 	private:
+		friend class EventImpl;							// Waits until m_stamp
+
 		TimeStampImpl( TimeStampImpl const& );					// prevent copy
 		TimeStampImpl& operator = ( TimeStampImpl const& );			// prevent assignment
 
@@ -33,6 +33,8 @@
 
 namespace OpenZWave
 {
+	class TimeStampImpl;
+
 	/** \brief Windows-specific implementation of the Event class.
 	 */
 	class EventImpl
@@ -49,6 +51,7 @@ namespace OpenZWave
 		void Reset();
 
 		bool Wait( int32 _timeout );	// The wait method is to be used only by the Wait::Multiple method
+		bool WaitUntil( TimeStampImpl* _deadline );	// Wait until a deadline, for the WaitSet::MultipleUntil method
 		bool IsSignalled();
 
 		HANDLE	m_hEvent;
@@ -67,3 +67,130 @@ bool FileOpsImpl::FolderExists(
 
 	return (fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)? true: false;
 }
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::ReplaceFile>
+//	Flush a new file to disk and rename it over an existing one
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::ReplaceFile
+(
+	const string &_newFileName,
+	const string &_fileName
+)
+{
+	wstring wNewFileName( _newFileName.begin(), _newFileName.end() );
+	wstring wFileName( _fileName.begin(), _fileName.end() );
+
+	HANDLE file = CreateFile2( wNewFileName.c_str(), GENERIC_WRITE, 0, OPEN_EXISTING, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+	bool flushed = ( FlushFileBuffers( file ) != 0 );
+	CloseHandle( file );
+
+	return( flushed && MoveFileExW( wNewFileName.c_str(), wFileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0 );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::FileInfo>
+//	Get the size and modification time of a file
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::FileInfo
+(
+	const string &_fileName,
+	uint32 &_size,
+	uint32 &_modified
+)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad = { 0 };
+	wstring wFileName( _fileName.begin(), _fileName.end() );
+	if( 0 == GetFileAttributesEx( wFileName.c_str(), GetFileExInfoStandard, &fad ) || ( fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+	{
+		return false;
+	}
+	_size = fad.nFileSizeLow;
+	// Fold the 64 bit file time into 32 bits.  It only has to change when the file does.
+	_modified = fad.ftLastWriteTime.dwLowDateTime ^ fad.ftLastWriteTime.dwHighDateTime;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::MapFile>
+//	Map a file into memory for reading
+//-----------------------------------------------------------------------------
+uint8 const* FileOpsImpl::MapFile
+(
+	const string &_fileName,
+	uint32 &_size
+)
+{
+	wstring wFileName( _fileName.begin(), _fileName.end() );
+	HANDLE file = CreateFile2( wFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return NULL;
+	}
+
+	void* data = NULL;
+	LARGE_INTEGER size;
+	if( GetFileSizeEx( file, &size ) && size.QuadPart > 0 && size.HighPart == 0 )
+	{
+		HANDLE mapping = CreateFileMappingFromApp( file, NULL, PAGE_READONLY, 0, NULL );
+		if( mapping != NULL )
+		{
+			data = MapViewOfFileFromApp( mapping, FILE_MAP_READ, 0, 0 );
+			// The view stays valid once both handles are closed
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+
+	if( data == NULL )
+	{
+		return NULL;
+	}
+	_size = size.LowPart;
+	return (uint8 const*)data;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::UnmapFile>
+//	Release a mapping made by MapFile
+//-----------------------------------------------------------------------------
+void FileOpsImpl::UnmapFile
+(
+	uint8 const* _data,
+	uint32 _size
+)
+{
+	UnmapViewOfFile( _data );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::CreateSharedFile>
+//	Create a file mapped for writing
+//-----------------------------------------------------------------------------
+uint8* FileOpsImpl::CreateSharedFile
+(
+	const string &_fileName,
+	uint32 _size
+)
+{
+	wstring wFileName( _fileName.begin(), _fileName.end() );
+	HANDLE file = CreateFile2( wFileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, CREATE_ALWAYS, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return NULL;
+	}
+
+	void* data = NULL;
+	HANDLE mapping = CreateFileMappingFromApp( file, NULL, PAGE_READWRITE, _size, NULL );
+	if( mapping != NULL )
+	{
+		data = MapViewOfFileFromApp( mapping, FILE_MAP_WRITE, 0, 0 );
+		CloseHandle( mapping );
+	}
+	CloseHandle( file );
+	return (uint8*)data;
+}
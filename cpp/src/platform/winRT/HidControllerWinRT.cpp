@@ -149,7 +149,7 @@ bool HidController::Open(string const& _hidControllerName)
 					if (!data.empty())
 					{
 						reader->ReadBytes(::Platform::ArrayReference<uint8>(&data[0], bufferSize));
-						Put(&data[0], bufferSize);
+						Received(&data[0], bufferSize);
 					}
 				});
 			}
@@ -241,6 +241,8 @@ uint32 HidController::Write
 	uint32 _length
 )
 {
+	Sent( _buffer, _length );
+
 	// report Id 0x04 is tx feature report
 	return SendFeatureReport(_buffer, _length, 0x04);
 }
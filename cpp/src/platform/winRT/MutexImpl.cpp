@@ -37,10 +37,13 @@ using namespace OpenZWave;
 //-----------------------------------------------------------------------------
 MutexImpl::MutexImpl
 (
+	bool const _recursive
 ):
 	m_lockCount( 0 )
 {
-	InitializeCriticalSectionEx( &m_criticalSection, 0, 0 );
+	// A critical section is always recursive.  One that is never taken twice
+	// guards short work, so it spins for a while before sleeping.
+	InitializeCriticalSectionEx( &m_criticalSection, _recursive ? 0 : 4000, 0 );
 }
 
 //-----------------------------------------------------------------------------
@@ -196,7 +196,7 @@ void SerialControllerImpl::StartReadTask()
 					if (!byteVector.empty())
 					{
 						reader->ReadBytes(::Platform::ArrayReference<uint8>(byteVector.data(), bytesRead));
-						m_owner->Put(byteVector.data(), bytesRead);
+						m_owner->Received(byteVector.data(), bytesRead);
 					}
 				}).wait();
 			}
@@ -49,6 +49,7 @@ namespace OpenZWave
 		void Close();
 
 		uint32 Write( uint8* _buffer, uint32 _length );
+		uint64 GetThreadId(){ return 0; }		// Reads are tasks, not a thread of their own
 		void StartReadTask();
 
 		Windows::Devices::SerialCommunication::SerialDevice ^ m_serialDevice;
@@ -49,7 +49,8 @@ ThreadImpl::ThreadImpl
 ):
 	m_owner( _owner ),
 	m_bIsRunning( false ),
-	m_name( _name )
+	m_name( _name ),
+	m_id( 0 )
 {
 	static bool staticsInitialized = false;
 	if (!staticsInitialized)
@@ -89,6 +90,7 @@ bool ThreadImpl::Start
 
 	create_task([this]()
 	{
+		m_id = GetCurrentThreadId();
 		m_bIsRunning = true;
 		try
 		{
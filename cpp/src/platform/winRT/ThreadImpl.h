@@ -51,6 +51,8 @@ namespace OpenZWave
 		bool Start( Thread::pfnThreadProc_t _pfnThreadProc, Event* _exitEvent, void* _context );
 		void Sleep( uint32 _milliseconds );
 		bool Terminate();
+		uint64 GetId(){ return m_id; }
+		static uint64 GetCurrentId(){ return ::GetCurrentThreadId(); }
 
 		bool IsSignalled();
 
@@ -63,6 +65,7 @@ namespace OpenZWave
 		void*					m_context;
 		bool					m_bIsRunning;
 		string					m_name;
+		DWORD					m_id;
 
 		static int32			s_threadTerminateTimeout;
 	};
@@ -112,3 +112,29 @@ int32 TimeStampImpl::operator-
 {
 	return (int32)( ( m_stamp - _other.m_stamp ) / 10000LL );
 }
+
+//-----------------------------------------------------------------------------
+//	<TimeStampImpl::GetTicksNs>
+//	Read the performance counter in nanoseconds
+//-----------------------------------------------------------------------------
+uint64 TimeStampImpl::GetTicksNs
+(
+)
+{
+	// The frequency is fixed at boot, so it is only asked for once
+	static int64 s_frequency = 0;
+	if( !s_frequency )
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency( &frequency );
+		s_frequency = frequency.QuadPart;
+	}
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter( &now );
+
+	// Split the count so the multiplication cannot overflow
+	uint64 count = (uint64)now.QuadPart;
+	uint64 frequency = (uint64)s_frequency;
+	return( ( count / frequency ) * 1000000000ULL + ( ( count % frequency ) * 1000000000ULL ) / frequency );
+}
@@ -75,6 +75,11 @@ namespace OpenZWave
 		 */
 		int32 operator- ( TimeStampImpl const& _other );
 
+		/**
+		 * Read a high resolution clock in nanoseconds, for measuring short intervals.
+		 */
+		static uint64 GetTicksNs();
+
 	private:
 		TimeStampImpl( TimeStampImpl const& );			// prevent copy
 		TimeStampImpl& operator = ( TimeStampImpl const& );	// prevent assignment
@@ -29,6 +29,7 @@
 
 #include "Defs.h"
 #include "EventImpl.h"
+#include "TimeStampImpl.h"
 
 using namespace OpenZWave;
 
@@ -100,3 +101,17 @@ bool EventImpl::Wait
 {
 	return( WAIT_TIMEOUT != ::WaitForSingleObject( m_hEvent, (DWORD)_timeout ) );
 }
+
+//-----------------------------------------------------------------------------
+//	<EventImpl::WaitUntil>
+//	Wait for the event to become signalled, until a deadline
+//-----------------------------------------------------------------------------
+bool EventImpl::WaitUntil
+(
+	TimeStampImpl* _deadline
+)
+{
+	// WaitForSingleObject only takes a relative timeout
+	int32 remaining = _deadline->TimeRemaining();
+	return Wait( ( remaining > 0 ) ? remaining : 0 );
+}
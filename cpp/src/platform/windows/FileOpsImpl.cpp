@@ -67,3 +67,126 @@ bool FileOpsImpl::FolderExists(
 
 	return false;
 }
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::ReplaceFile>
+//	Flush a new file to disk and rename it over an existing one
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::ReplaceFile
+(
+	const string &_newFileName,
+	const string &_fileName
+)
+{
+	HANDLE file = CreateFileA( _newFileName.c_str(), GENERIC_WRITE, 0, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+	bool flushed = ( FlushFileBuffers( file ) != 0 );
+	CloseHandle( file );
+
+	return( flushed && MoveFileExA( _newFileName.c_str(), _fileName.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH ) != 0 );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::FileInfo>
+//	Get the size and modification time of a file
+//-----------------------------------------------------------------------------
+bool FileOpsImpl::FileInfo
+(
+	const string &_fileName,
+	uint32 &_size,
+	uint32 &_modified
+)
+{
+	WIN32_FILE_ATTRIBUTE_DATA fad = { 0 };
+	if( 0 == GetFileAttributesExA( _fileName.c_str(), GetFileExInfoStandard, &fad ) || ( fad.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY ) )
+	{
+		return false;
+	}
+	_size = fad.nFileSizeLow;
+	// Fold the 64 bit file time into 32 bits.  It only has to change when the file does.
+	_modified = fad.ftLastWriteTime.dwLowDateTime ^ fad.ftLastWriteTime.dwHighDateTime;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::MapFile>
+//	Map a file into memory for reading
+//-----------------------------------------------------------------------------
+uint8 const* FileOpsImpl::MapFile
+(
+	const string &_fileName,
+	uint32 &_size
+)
+{
+	HANDLE file = CreateFileA( _fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return NULL;
+	}
+
+	void* data = NULL;
+	LARGE_INTEGER size;
+	if( GetFileSizeEx( file, &size ) && size.QuadPart > 0 && size.HighPart == 0 )
+	{
+		HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READONLY, 0, 0, NULL );
+		if( mapping != NULL )
+		{
+			data = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			// The view stays valid once both handles are closed
+			CloseHandle( mapping );
+		}
+	}
+	CloseHandle( file );
+
+	if( data == NULL )
+	{
+		return NULL;
+	}
+	_size = size.LowPart;
+	return (uint8 const*)data;
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::UnmapFile>
+//	Release a mapping made by MapFile
+//-----------------------------------------------------------------------------
+void FileOpsImpl::UnmapFile
+(
+	uint8 const* _data,
+	uint32 _size
+)
+{
+	UnmapViewOfFile( _data );
+}
+
+//-----------------------------------------------------------------------------
+//	<FileOpsImpl::CreateSharedFile>
+//	Create a file mapped for writing
+//-----------------------------------------------------------------------------
+uint8* FileOpsImpl::CreateSharedFile
+(
+	const string &_fileName,
+	uint32 _size
+)
+{
+	// Windows will not replace a file that another process has mapped, so in
+	// that case this fails until the readers let go of it
+	HANDLE file = CreateFileA( _fileName.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+	if( file == INVALID_HANDLE_VALUE )
+	{
+		return NULL;
+	}
+
+	void* data = NULL;
+	HANDLE mapping = CreateFileMappingA( file, NULL, PAGE_READWRITE, 0, _size, NULL );
+	if( mapping != NULL )
+	{
+		data = MapViewOfFile( mapping, FILE_MAP_WRITE, 0, 0, 0 );
+		CloseHandle( mapping );
+	}
+	CloseHandle( file );
+	return (uint8*)data;
+}
@@ -152,14 +152,46 @@ void LogImpl::Write
 	va_list _args
 )
 {
-	// create a timestamp string
-	string timeStr = GetTimeStampString();
-	string nodeStr = GetNodeString( _nodeId );
-	string logLevelStr = GetLogLevelString(_logLevel);
+	WriteEntry( _logLevel, _nodeId, _format, _args, _logLevel <= m_saveLevel );
+}
 
+//-----------------------------------------------------------------------------
+//	<LogImpl::WriteNode>
+//	Write an entry from a node with its own log level
+//-----------------------------------------------------------------------------
+void LogImpl::WriteNode
+(
+	LogLevel _logLevel,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args,
+	bool const _save
+)
+{
+	WriteEntry( _logLevel, _nodeId, _format, _args, _save );
+}
+
+//-----------------------------------------------------------------------------
+//	<LogImpl::WriteEntry>
+//	Write to the log, saving the entry or not as the caller decided
+//-----------------------------------------------------------------------------
+void LogImpl::WriteEntry
+(
+	LogLevel _logLevel,
+	uint8 const _nodeId,
+	char const* _format,
+	va_list _args,
+	bool const _save
+)
+{
 	// handle this message
-	if( (_logLevel <= m_queueLevel) || (_logLevel == LogLevel_Internal) )	// we're going to do something with this message...
+	if( _save || (_logLevel <= m_queueLevel) || (_logLevel == LogLevel_Internal) )	// we're going to do something with this message...
 	{
+		// create a timestamp string, only once we know the message is wanted
+		string timeStr = GetTimeStampString();
+		string nodeStr = GetNodeString( _nodeId );
+		string logLevelStr = GetLogLevelString(_logLevel);
+
 		char lineBuf[1024];
 		if( !_format || ( _format[0] == 0 ) )
 		{
@@ -171,7 +203,7 @@ void LogImpl::Write
 		}
 
 		// should this message be saved to file (and possibly written to console?)
-		if( (_logLevel <= m_saveLevel) || (_logLevel == LogLevel_Internal) )
+		if( _save || (_logLevel == LogLevel_Internal) )
 		{
 			// save to file
 			FILE* pFile = NULL;
@@ -207,12 +239,9 @@ void LogImpl::Write
 			}
 		}
 
-		if( _logLevel != LogLevel_Internal )
+		if( (_logLevel <= m_queueLevel) && (_logLevel != LogLevel_Internal) )
 		{
-			char queueBuf[1024];
-			string threadStr = GetThreadId();
-			sprintf_s( queueBuf, sizeof(queueBuf), "%s%s%s", timeStr.c_str(), threadStr.c_str(), lineBuf );
-			Queue( queueBuf );
+			Queue( timeStr, lineBuf );
 		}
 	}
 
@@ -225,21 +254,18 @@ void LogImpl::Write
 
 //-----------------------------------------------------------------------------
 //	<LogImpl::Queue>
-//	Write to the log queue
+//	Write to the log queue, formatting the line straight into its ring
 //-----------------------------------------------------------------------------
 void LogImpl::Queue
 (
-	char const* _buffer
+	string const& _timeStr,
+	char const* _line
 )
 {
-	string bufStr = _buffer;
-	m_logQueue.push_back( bufStr );
-
-	// rudimentary queue size management
-	if( m_logQueue.size() > 500 )
-	{
-		m_logQueue.pop_front();
-	}
+	uint32 length = 1024;
+	char* buffer = m_logQueue.Reserve( length );
+	int written = _snprintf_s( buffer, length, _TRUNCATE, "%s%04d %s", _timeStr.c_str(), ::GetCurrentThreadId(), _line );
+	m_logQueue.Commit( ( written < 0 ) ? length - 1 : (uint32)written );
 }
 
 //-----------------------------------------------------------------------------
@@ -251,14 +277,11 @@ void LogImpl::QueueDump
 )
 {
 	Log::Write( LogLevel_Internal, "\n\nDumping queued log messages\n");
-	list<string>::iterator it = m_logQueue.begin();
-	while( it != m_logQueue.end() )
+	while( char const* line = m_logQueue.Front() )
 	{
-		string strTemp = *it;
-		Log::Write( LogLevel_Internal, "%s", strTemp.c_str() );
-		++it;
+		Log::Write( LogLevel_Internal, "%s", line );
+		m_logQueue.PopFront();
 	}
-	m_logQueue.clear();
 	Log::Write( LogLevel_Internal, "\nEnd of queued log message dump\n\n");
 }
 
@@ -270,7 +293,7 @@ void LogImpl::QueueClear
 (
 )
 {
-	m_logQueue.clear();
+	m_logQueue.Clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -334,21 +357,6 @@ string LogImpl::GetNodeString
 		}
 }
 
-//-----------------------------------------------------------------------------
-//	<LogImpl::GetThreadId>
-//	Generate a string with formatted thread id
-//-----------------------------------------------------------------------------
-string LogImpl::GetThreadId
-(
-)
-{
-	char buf[20];
-	DWORD dwThread = ::GetCurrentThreadId();
-	sprintf_s( buf, sizeof(buf), "%04d ", dwThread );
-	string str = buf;
-	return str;
-}
-
 //-----------------------------------------------------------------------------
 //	<LogImpl::SetLogFileName>
 //	Provide a new log file name (applicable to future writes)
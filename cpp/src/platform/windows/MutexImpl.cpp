@@ -37,10 +37,20 @@ using namespace OpenZWave;
 //-----------------------------------------------------------------------------
 MutexImpl::MutexImpl
 (
+	bool const _recursive
 ):
 	m_lockCount( 0 )
 {
-	InitializeCriticalSection( &m_criticalSection );
+	// A critical section is always recursive.  One that is never taken twice
+	// guards short work, so it spins for a while before sleeping.
+	if( _recursive )
+	{
+		InitializeCriticalSection( &m_criticalSection );
+	}
+	else
+	{
+		InitializeCriticalSectionAndSpinCount( &m_criticalSection, 4000 );
+	}
 }
 
 //-----------------------------------------------------------------------------
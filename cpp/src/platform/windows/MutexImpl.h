@@ -40,7 +40,7 @@ namespace OpenZWave
 	private:
 		friend class Mutex;
 
-		MutexImpl();
+		MutexImpl( bool const _recursive );
 		~MutexImpl();
 
 		bool Lock( bool const _bWait = true );
@@ -42,7 +42,8 @@ SerialControllerImpl::SerialControllerImpl
 (
 	SerialController* _owner
 ):
-	m_owner( _owner )
+	m_owner( _owner ),
+	m_hThread( INVALID_HANDLE_VALUE )
 {
 }
 
@@ -164,7 +165,10 @@ void SerialControllerImpl::ReadThreadProc
 			}
 		}
 
-		Init( ++attempts );
+		if( Init( ++attempts ) )
+		{
+			m_owner->Reconnected();
+		}
 	}
 }
 
@@ -217,7 +221,9 @@ bool SerialControllerImpl::Init
 		goto SerialOpenFailure;
 	}
 
-	// Set the timeouts for the serial port
+	// Set the timeouts for the serial port.  A read returns at once with
+	// whatever is there, as Read only asks for what ClearCommError reports
+	// has arrived, and otherwise waits for EV_RXCHAR.
 	COMMTIMEOUTS commTimeouts;
 	commTimeouts.ReadIntervalTimeout = MAXDWORD;
 	commTimeouts.ReadTotalTimeoutConstant = 0;
@@ -263,110 +269,117 @@ void SerialControllerImpl::Read
 {
 	uint8 buffer[256];
 
-	OVERLAPPED overlapped;
-	memset( &overlapped, 0, sizeof(overlapped) );
-	overlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
-   
+	// Waiting for a character and reading have an OVERLAPPED each, so
+	// that a wait left pending is never confused with a read completing
+	OVERLAPPED waitOverlapped;
+	memset( &waitOverlapped, 0, sizeof(waitOverlapped) );
+	waitOverlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+	OVERLAPPED readOverlapped;
+	memset( &readOverlapped, 0, sizeof(readOverlapped) );
+	readOverlapped.hEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+
+	HANDLE handles[2];
+	handles[1] = m_hExit;
+
+	bool waitPending = false;
+	bool readPending = false;
 	while( true )
 	{
-		// Try to read all available data from the serial port
-		DWORD bytesRead = 0;
-		do
+		// Read exactly what the driver has queued, so a read never comes back
+		// empty.  The timeouts make ReadFile return at once with what is there.
+		DWORD errors;
+		COMSTAT comStat;
+		if( !ClearCommError( m_hSerialController, &errors, &comStat ) )
 		{
-			if( ::ReadFile( m_hSerialController, buffer, 256, NULL, &overlapped ) )
-			{
-				// Read completed
-				GetOverlappedResult( m_hSerialController, &overlapped, &bytesRead, TRUE );
-
-				// Copy to the stream buffer
-				if( bytesRead > 0 )
-					m_owner->Put( buffer, bytesRead );
-			}
-			else
-			{
-				//Wait for the read to complete
-				if( ERROR_IO_PENDING == GetLastError() )
-				{
-					// Wait for the read to complete or the
-					// signal that this thread should exit.
-					HANDLE handles[2];
-					handles[0] = overlapped.hEvent;
-					handles[1] = m_hExit;
-					DWORD res = WaitForMultipleObjects( 2, handles, FALSE, INFINITE );
-			
-					if( (WAIT_OBJECT_0+1) == res )
-					{
-						// Exit signalled.  Cancel the read.
-						goto exitRead;
-					}
-
-					if( WAIT_TIMEOUT == res )
-					{
-						// Timed out - should never happen
-						goto exitRead;
-					}
-
-					// Read completed
-					GetOverlappedResult( m_hSerialController, &overlapped, &bytesRead, TRUE );
-
-					// Copy to the stream buffer
-					if( bytesRead > 0 )
-						m_owner->Put( buffer, bytesRead );
-				}
-				else
-				{
-					// An error has occurred
-					goto exitRead;
-				}
-			}
+			Log::Write( LogLevel_Error, "ERROR: Serial port status (0x%.8x)", GetLastError() );
+			goto exitRead;
 		}
-		while( bytesRead > 0 );
-		
-		// Clear the event
-		ResetEvent( overlapped.hEvent );
-
-		// Nothing available to read, so wait for the next rx char event
-		DWORD dwEvtMask;
-		if( !WaitCommEvent( m_hSerialController, &dwEvtMask, &overlapped ) )
+
+		if( comStat.cbInQue > 0 )
 		{
-			if( ERROR_IO_PENDING == GetLastError() )
+			DWORD toRead = ( comStat.cbInQue < sizeof(buffer) ) ? comStat.cbInQue : sizeof(buffer);
+			DWORD bytesRead = 0;
+			ResetEvent( readOverlapped.hEvent );
+			if( !::ReadFile( m_hSerialController, buffer, toRead, NULL, &readOverlapped ) )
 			{
-				// Wait for either some data to arrive or 
-				// the signal that this thread should exit.
-				HANDLE handles[2];
-				handles[0] = overlapped.hEvent;
-				handles[1] = m_hExit;
-				
-				DWORD res = WaitForMultipleObjects( 2, handles, FALSE, INFINITE );
-			
-				if( (WAIT_OBJECT_0+1) == res )
+				if( ERROR_IO_PENDING != GetLastError() )
 				{
-					// Exit signalled.  Prevent WaitCommEvent from corrupting the 
-					// stack by forcing it to exit.
+					Log::Write( LogLevel_Error, "ERROR: Serial port read (0x%.8x)", GetLastError() );
 					goto exitRead;
 				}
 
-				if( WAIT_TIMEOUT == res )
+				// Wait for the read to complete or the signal that this thread should exit
+				readPending = true;
+				handles[0] = readOverlapped.hEvent;
+				if( WAIT_OBJECT_0 != WaitForMultipleObjects( 2, handles, FALSE, INFINITE ) )
 				{
-					// Timed out - should never happen
 					goto exitRead;
 				}
+			}
+			GetOverlappedResult( m_hSerialController, &readOverlapped, &bytesRead, TRUE );
+			readPending = false;
+
+			// Copy to the stream buffer
+			if( bytesRead > 0 )
+				m_owner->Received( buffer, bytesRead );
+			continue;
+		}
 
-				GetOverlappedResult( m_hSerialController, &overlapped, &bytesRead, TRUE );
+		// Nothing to read, so wait for the next rx char event.  A character that
+		// arrived since ClearCommError completes the wait straight away.
+		if( !waitPending )
+		{
+			DWORD dwEvtMask;
+			ResetEvent( waitOverlapped.hEvent );
+			if( WaitCommEvent( m_hSerialController, &dwEvtMask, &waitOverlapped ) )
+			{
+				continue;
 			}
+			if( ERROR_IO_PENDING != GetLastError() )
+			{
+				Log::Write( LogLevel_Error, "ERROR: Serial port wait (0x%.8x)", GetLastError() );
+				goto exitRead;
+			}
+			waitPending = true;
 		}
 
-		// Clear the event
-		ResetEvent( overlapped.hEvent );
+		// Wait for either some data to arrive or the signal that this thread should exit
+		handles[0] = waitOverlapped.hEvent;
+		if( WAIT_OBJECT_0 != WaitForMultipleObjects( 2, handles, FALSE, INFINITE ) )
+		{
+			goto exitRead;
+		}
 
-		// Loop back to the top to read the waiting data
+		DWORD unused;
+		GetOverlappedResult( m_hSerialController, &waitOverlapped, &unused, FALSE );
+		waitPending = false;
 	}
 
 exitRead:
-	// Exit event has been signalled, or an error has occurred
+	// Exit event has been signalled, or an error has occurred.  Any pending
+	// operation must finish before its OVERLAPPED goes out of scope.
 	SetCommMask( m_hSerialController, 0 );
 	CancelIo( m_hSerialController );
-	CloseHandle( overlapped.hEvent );
+	DWORD unused;
+	if( waitPending )
+	{
+		GetOverlappedResult( m_hSerialController, &waitOverlapped, &unused, TRUE );
+	}
+	if( readPending )
+	{
+		GetOverlappedResult( m_hSerialController, &readOverlapped, &unused, TRUE );
+	}
+	CloseHandle( readOverlapped.hEvent );
+	CloseHandle( waitOverlapped.hEvent );
+
+	if( WAIT_OBJECT_0 != WaitForSingleObject( m_hExit, 0 ) )
+	{
+		// The port failed, such as a USB stick being pulled out.  Close it so
+		// that ReadThreadProc can open it again.
+		CloseHandle( m_hSerialController );
+		m_hSerialController = INVALID_HANDLE_VALUE;
+	}
 }
 
 //-----------------------------------------------------------------------------
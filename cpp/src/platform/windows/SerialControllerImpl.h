@@ -50,6 +50,7 @@ namespace OpenZWave
 		void Close();
 
 		uint32 Write( uint8* _buffer, uint32 _length );
+		uint64 GetThreadId(){ return ( m_hThread != INVALID_HANDLE_VALUE ) ? ::GetThreadId( m_hThread ) : 0; }
 		
 		bool Init( uint32 const _attempts );
 		void Read();
@@ -45,7 +45,8 @@ ThreadImpl::ThreadImpl
 	m_owner( _owner ),
 	m_hThread( INVALID_HANDLE_VALUE ),
 	m_bIsRunning( false ),
-	m_name( _name )
+	m_name( _name ),
+	m_id( 0 )
 {
 
 }
@@ -77,7 +78,7 @@ bool ThreadImpl::Start
 	m_exitEvent = _exitEvent;
 	m_exitEvent->Reset();
 
-	HANDLE hThread = ::CreateThread( NULL, 0, ThreadImpl::ThreadProc, this, CREATE_SUSPENDED, NULL );
+	HANDLE hThread = ::CreateThread( NULL, 0, ThreadImpl::ThreadProc, this, CREATE_SUSPENDED, &m_id );
 	m_hThread = hThread;
 
 	::ResumeThread( hThread );
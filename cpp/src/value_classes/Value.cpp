@@ -27,18 +27,73 @@
 
 #include "tinyxml.h"
 #include "Manager.h"
+#include "CommandClassProfile.h"
 #include "Driver.h"
 #include "Node.h"
 #include "Notification.h"
 #include "Msg.h"
 #include "value_classes/Value.h"
+#include "value_classes/ValueDecimal.h"
+#include "value_classes/ValueIndex.h"
 #include "platform/Log.h"
+#include "platform/Atomic.h"
+#include "platform/TimeStamp.h"
 #include "command_classes/CommandClass.h"
 #include <ctime>
+#include <math.h>
 #include "Options.h"
 
 using namespace OpenZWave;
 
+// Read for every report of every value
+static Options::Handle<bool> s_suppressValueRefresh( "SuppressValueRefresh", false );
+static Options::Handle<int32> s_deadbandHeartbeat( "DeadbandHeartbeat", 3600 );
+static Options::Handle<bool> s_optimisticSet( "OptimisticSet", false );
+static Options::Handle<int32> s_optimisticSetTimeout( "OptimisticSetTimeout", 10000 );
+
+// Start of the millisecond clock for the refresh times
+static TimeStamp s_refreshClock;
+
+//-----------------------------------------------------------------------------
+// <GetNumericValue>
+// The value of a decimal, int or short as a double
+//-----------------------------------------------------------------------------
+static bool GetNumericValue
+(
+	void const* _value,
+	ValueID::ValueType const _type,
+	double* o_value
+)
+{
+	switch( _type )
+	{
+		case ValueID::ValueType_Decimal:
+		{
+			ValueDecimal::Fixed const* fixed = (ValueDecimal::Fixed const*)_value;
+			*o_value = (double)fixed->m_mantissa;
+			for( uint8 i=0; i<fixed->m_precision; ++i )
+			{
+				*o_value /= 10.0;
+			}
+			return true;
+		}
+		case ValueID::ValueType_Int:
+		{
+			*o_value = (double)*((int32 const*)_value);
+			return true;
+		}
+		case ValueID::ValueType_Short:
+		{
+			*o_value = (double)*((int16 const*)_value);
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
 static char const* c_genreName[] =
 {
 	"basic",
@@ -86,6 +141,7 @@ Value::Value
 	m_min( 0 ),
 	m_max( 0 ),
 	m_refreshTime(0),
+	m_refreshTick( 0 ),
 	m_verifyChanges( false ),
 	m_id( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, _type ),
 	m_label( _label ),
@@ -98,7 +154,16 @@ Value::Value
 	m_affects(),
 	m_affectsAll( false ),
 	m_checkChange( false ),
-	m_pollIntensity( _pollIntensity )
+	m_pollIntensity( _pollIntensity ),
+	m_pollInterval( 0 ),
+	m_deadband( 0.0f ),
+	m_deadbandPercent( false ),
+	m_notifiedValue( 0.0 ),
+	m_notifiedTime( 0 ),
+	m_snapshot( 0 ),
+	m_snapshotSeq( 0 ),
+	m_exportSlot( NULL ),
+	m_index( NULL )
 {
 }
 
@@ -112,6 +177,7 @@ Value::Value
 	m_min( 0 ),
 	m_max( 0 ),
 	m_refreshTime(0),
+	m_refreshTick( 0 ),
 	m_verifyChanges( false ),
 	m_readOnly( false ),
 	m_writeOnly( false ),
@@ -120,7 +186,16 @@ Value::Value
 	m_affects(),
 	m_affectsAll( false ),
 	m_checkChange( false ),
-	m_pollIntensity( 0 )
+	m_pollIntensity( 0 ),
+	m_pollInterval( 0 ),
+	m_deadband( 0.0f ),
+	m_deadbandPercent( false ),
+	m_notifiedValue( 0.0 ),
+	m_notifiedTime( 0 ),
+	m_snapshot( 0 ),
+	m_snapshotSeq( 0 ),
+	m_exportSlot( NULL ),
+	m_index( NULL )
 {
 }
 
@@ -172,7 +247,7 @@ void Value::ReadXML
 	char const* label = _valueElement->Attribute( "label" );
 	if( label )
 	{
-		m_label = label;
+		SetLabel( label );
 	}
 
 	char const* units = _valueElement->Attribute( "units" );
@@ -198,6 +273,11 @@ void Value::ReadXML
 		m_pollIntensity = (uint8)intVal;
 	}
 
+	if( TIXML_SUCCESS == _valueElement->QueryIntAttribute( "poll_interval", &intVal ) && intVal > 0 )
+	{
+		m_pollInterval = (uint32)intVal;
+	}
+
 	char const* affects = _valueElement->Attribute( "affects" );
 	if( affects )
 	{
@@ -277,6 +357,28 @@ void Value::ReadXML
 	}
 }
 
+//-----------------------------------------------------------------------------
+// <Value::SetLabel>
+// Change the label, and where the value is indexed under it
+//-----------------------------------------------------------------------------
+void Value::SetLabel
+(
+	string const& _label
+)
+{
+	SharedString label( _label );
+	if( label == m_label )
+	{
+		return;
+	}
+
+	m_label = label;
+	if( m_index )
+	{
+		m_index->Relabel( m_id, m_label );
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Value::WriteXML>
 // Write ourselves to an XML document
@@ -306,6 +408,12 @@ void Value::WriteXML
 	snprintf( str, sizeof(str), "%d", m_pollIntensity );
 	_valueElement->SetAttribute( "poll_intensity", str );
 
+	if( m_pollInterval )
+	{
+		snprintf( str, sizeof(str), "%d", m_pollInterval );
+		_valueElement->SetAttribute( "poll_interval", str );
+	}
+
 	snprintf( str, sizeof(str), "%d", m_min );
 	_valueElement->SetAttribute( "min", str );
 
@@ -359,23 +467,39 @@ bool Value::Set
 	// retrieve the driver, node and commandclass object for this value
 	bool res = false;
 	Node* node = NULL;
-	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
+	Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() );
+	if( driver != NULL )
 	{
 		node = driver->GetNodeUnsafe( m_id.GetNodeId() );
 		if( node != NULL )
 		{
 			if( CommandClass* cc = node->GetCommandClass( m_id.GetCommandClassId() ) )
 			{
-				Log::Write(LogLevel_Info, m_id.GetNodeId(), "Value::Set - %s - %s - %d - %d - %s", cc->GetCommandClassName().c_str(), this->GetLabel().c_str(), m_id.GetIndex(), m_id.GetInstance(), this->GetAsString().c_str());
+				OZW_LOG( LogLevel_Info, m_id.GetNodeId(), "Value::Set - %s - %s - %d - %d - %s", cc->GetCommandClassName().c_str(), this->GetLabel().c_str(), m_id.GetIndex(), m_id.GetInstance(), this->GetAsString().c_str());
 				// flag value as set and queue a "Set Value" message for transmission to the device
-				res = cc->SetValue( *this );
+				{
+					CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_SetValue );
+					res = cc->SetValue( *this );
+				}
 
 				if( res )
 				{
 					if( !IsWriteOnly() )
 					{
-						// queue a "RequestValue" message to update the value
-						cc->RequestValue( 0, m_id.GetIndex(), m_id.GetInstance(), Driver::MsgQueue_Send );
+						// Show the new value straight away, until the device reports it
+						if( s_optimisticSet.Get() )
+						{
+							int32 timeout = s_optimisticSetTimeout.Get();
+							driver->BeginOptimisticSet( this, timeout > 0 ? (uint32)timeout : 0 );
+						}
+
+						// queue a "RequestValue" message to update the value, unless the
+						// node will report on the Set itself
+						if( !cc->IsSupervised( m_id.GetInstance(), m_id.GetIndex() ) )
+						{
+							CommandClassProfile::Timer timer( cc->GetCommandClassId(), CommandClassProfile::Operation_RequestValue );
+							cc->RequestValue( 0, m_id.GetIndex(), m_id.GetInstance(), Driver::MsgQueue_Send );
+						}
 					}
 					else
 					{
@@ -417,13 +541,13 @@ void Value::OnValueRefreshed
 		return;
 	}
 
+	StampRefreshTime();
 	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
 	{
 		m_isSet = true;
+		driver->ValueSetReported( this );
 
-		bool bSuppress;
-		Options::Get()->GetOptionAsBool( "SuppressValueRefresh", &bSuppress );
-		if( !bSuppress )
+		if( !s_suppressValueRefresh.Get() )
 		{
 			// Notify the watchers
 			Notification* notification = new Notification( Notification::Type_ValueRefreshed );
@@ -447,9 +571,12 @@ void Value::OnValueChanged
 		return;
 	}
 
+	StampRefreshTime();
 	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
 	{
 		m_isSet = true;
+		driver->ValueSetReported( this );
+		driver->CheckSceneRules( this );
 
 		// Notify the watchers
 		Notification* notification = new Notification( Notification::Type_ValueChanged );
@@ -554,6 +681,80 @@ char const* Value::GetTypeNameFromEnum
 	return c_typeName[_type];
 }
 
+//-----------------------------------------------------------------------------
+// <Value::PublishSnapshot>
+// Store a scalar value where ReadSnapshot can get it without a lock
+//-----------------------------------------------------------------------------
+void Value::PublishSnapshot
+(
+	uint32 const _value
+)
+{
+	// Values are set by the driver thread, and by an optimistic set with the
+	// node locked.  Each store is a single word, so a reader that catches two
+	// writers at once still reads one of their values.
+	AtomicIncrement( &m_snapshotSeq );
+	AtomicStore( &m_snapshot, _value );
+	AtomicIncrement( &m_snapshotSeq );
+	Export();
+}
+
+//-----------------------------------------------------------------------------
+// <Value::Export>
+// Copy the value to its slot in the shared value table
+//-----------------------------------------------------------------------------
+void Value::Export
+(
+)
+{
+	if( !m_exportSlot )
+	{
+		return;
+	}
+
+	int64 integer = 0;
+	double real = 0.0;
+	uint8 precision = 0;
+	uint8 flags = m_isSet ? ValueExport::SlotFlag_Set : 0;
+	if( !GetExportValue( &integer, &real, &precision ) )
+	{
+		flags |= ValueExport::SlotFlag_Empty;
+	}
+	ValueExport::Write( m_exportSlot, flags, (uint32)m_refreshTime, integer, real, precision );
+}
+
+//-----------------------------------------------------------------------------
+// <Value::ReadSnapshot>
+// Read a scalar value without a lock
+//-----------------------------------------------------------------------------
+void Value::ReadSnapshot
+(
+	uint32* o_value,
+	uint32* o_version
+)const
+{
+	while( true )
+	{
+		uint32 seq = AtomicLoad( &m_snapshotSeq );
+		if( seq & 1 )
+		{
+			// Caught the writer part way through
+			continue;
+		}
+
+		uint32 value = AtomicLoad( &m_snapshot );
+		if( AtomicLoad( &m_snapshotSeq ) == seq )
+		{
+			*o_value = value;
+			if( o_version )
+			{
+				*o_version = seq >> 1;
+			}
+			return;
+		}
+	}
+}
+
 //-----------------------------------------------------------------------------
 // <Value::VerifyRefreshedValue>
 // Check a refreshed value
@@ -567,16 +768,26 @@ int Value::VerifyRefreshedValue
 	int _length	// = 0
 )
 {
+	// Counts the notifications and everything else the update leads to
+	CommandClassProfile::Timer timer( m_id.GetCommandClassId(), CommandClassProfile::Operation_ValueUpdate );
+
 	// TODO: this is pretty rough code, but it's reused by each value type.  It would be
 	// better if the actions were taken (m_value = _value, etc.) in this code rather than
 	// in the calling routine as a result of the return value.  In particular, it's messy
 	// to be setting these values after the refesh or notification is sent.  With some
 	// focus on the actual variable storage, we should be able to accomplish this with
 	// memory functions.  It's really the strings that make things complicated(?).
+	double newValue = 0.0;
+	bool const deadband = ( m_deadband > 0.0f ) && GetNumericValue( _newValue, _type, &newValue );
+
 	// if this is the first read of a value, assume it is valid (and notify as a change)
 	if( !IsSet() )
 	{
-		Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Initial read of value" );
+		OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Initial read of value" );
+		if( deadband )
+		{
+			OnDeadbandNotified( newValue );
+		}
 		Value::OnValueChanged();
 		return 2;		// confirmed change of value
 	}
@@ -587,54 +798,72 @@ int Value::VerifyRefreshedValue
 			case ValueID::ValueType_Button:			// Button is stored as a bool
 			case ValueID::ValueType_Bool:			// bool
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", *((bool*)_originalValue)?"true":"false", *((uint8*)_newValue)?"true":"false", GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", *((bool*)_originalValue)?"true":"false", *((uint8*)_newValue)?"true":"false", GetTypeNameFromEnum(_type) );
 				break;
 			}
 			case ValueID::ValueType_Byte:			// byte
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((uint8*)_originalValue), *((uint8*)_newValue), GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((uint8*)_originalValue), *((uint8*)_newValue), GetTypeNameFromEnum(_type) );
+				break;
+			}
+			case ValueID::ValueType_Decimal:		// decimal
+			{
+				char originalStr[16];
+				char newStr[16];
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", ValueDecimal::Format( *((ValueDecimal::Fixed*)_originalValue), originalStr, sizeof(originalStr) ), ValueDecimal::Format( *((ValueDecimal::Fixed*)_newValue), newStr, sizeof(newStr) ), GetTypeNameFromEnum(_type) );
 				break;
 			}
-			case ValueID::ValueType_Decimal:		// decimal is stored as a string, so treat it as a string here
 			case ValueID::ValueType_String:			// string
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", ((string*)_originalValue)->c_str(), ((string*)_newValue)->c_str(), GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", ((string*)_originalValue)->c_str(), ((string*)_newValue)->c_str(), GetTypeNameFromEnum(_type) );
 				break;
 			}
 			case ValueID::ValueType_Short:			// short
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((short*)_originalValue), *((short*)_newValue), GetTypeNameFromEnum(_type));
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((short*)_originalValue), *((short*)_newValue), GetTypeNameFromEnum(_type));
 				break;
 			}
 			case ValueID::ValueType_List:			// List Type is treated as a int32
 			case ValueID::ValueType_Int:			// int32
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((int32*)_originalValue), *((int32*)_newValue), GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%d, new value=%d, type=%s", *((int32*)_originalValue), *((int32*)_newValue), GetTypeNameFromEnum(_type) );
 				break;
 			}
 			case ValueID::ValueType_Raw:			// raw
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%x, new value=%x, type=%s", _originalValue, _newValue, GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%x, new value=%x, type=%s", _originalValue, _newValue, GetTypeNameFromEnum(_type) );
 				break;
 			}
 			case ValueID::ValueType_Schedule:		// Schedule Type
 			{
-				Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", _originalValue, _newValue, GetTypeNameFromEnum(_type) );
+				OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Refreshed Value: old value=%s, new value=%s, type=%s", _originalValue, _newValue, GetTypeNameFromEnum(_type) );
 				/* we cant support verifyChanges yet... so always unset this */
 				m_verifyChanges = false;
 				break;
 			}
 		}
 	}
-	m_refreshTime = time( NULL );	// update value refresh time
+	StampRefreshTime();
+
+	// a small enough change is applied without telling the watchers
+	if( deadband && IsWithinDeadband( newValue ) )
+	{
+		OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Change is within the deadband, not notified" );
+		SetCheckingChange( false );
+		return 2;				// apply the value
+	}
 
 	// check whether changes in this value should be verified (since some devices will report values that always
 	// change, where confirming changes is difficult or impossible)
-	Log::Write( LogLevel_Detail, m_id.GetNodeId(), "Changes to this value are %sverified", m_verifyChanges ? "" : "not " );
+	OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Changes to this value are %sverified", m_verifyChanges ? "" : "not " );
 
 	if( !m_verifyChanges )
 	{
 		// since we're not checking changes in this value, notify ValueChanged (to be on the safe side)
+		if( deadband )
+		{
+			OnDeadbandNotified( newValue );
+		}
 		Value::OnValueChanged();
 		return 2;				// confirmed change of value
 	}
@@ -643,7 +872,9 @@ int Value::VerifyRefreshedValue
 	bool bOriginalEqual = false;
 	switch( _type )
 	{
-	case ValueID::ValueType_Decimal:		// Decimal is stored as a string
+	case ValueID::ValueType_Decimal:		// Decimal is stored as a fixed point number
+		bOriginalEqual = ( *((ValueDecimal::Fixed*)_originalValue) == *((ValueDecimal::Fixed*)_newValue) );
+		break;
 	case ValueID::ValueType_String:			// string
 		bOriginalEqual = ( strcmp( ((string*)_originalValue)->c_str(), ((string*)_newValue)->c_str() ) == 0 );
 		break;
@@ -675,12 +906,16 @@ int Value::VerifyRefreshedValue
 		if( bOriginalEqual )
 		{
 			// values are the same, so signal a refresh and return
+			if( deadband )
+			{
+				OnDeadbandNotified( newValue );
+			}
 			Value::OnValueRefreshed();
 			return 0;			// value hasn't changed
 		}
 
 		// values are different, so flag this as a verification refresh and queue it
-		Log::Write( LogLevel_Info, m_id.GetNodeId(), "Changed value (possible)--rechecking" );
+		OZW_LOG( LogLevel_Info, m_id.GetNodeId(), "Changed value (possible)--rechecking" );
 		SetCheckingChange( true );
 		Manager::Get()->RefreshValue( GetID() );
 		return 1;				// value has changed (to be confirmed)
@@ -691,7 +926,9 @@ int Value::VerifyRefreshedValue
 		bool bCheckEqual = false;
 		switch( _type )
 		{
-		case ValueID::ValueType_Decimal:		// Decimal is stored as a string
+		case ValueID::ValueType_Decimal:		// Decimal is stored as a fixed point number
+			bCheckEqual = ( *((ValueDecimal::Fixed*)_checkValue) == *((ValueDecimal::Fixed*)_newValue) );
+			break;
 		case ValueID::ValueType_String:			// string
 			bCheckEqual = ( strcmp( ((string*)_checkValue)->c_str(), ((string*)_newValue)->c_str() ) == 0 );
 			break;
@@ -718,10 +955,14 @@ int Value::VerifyRefreshedValue
 		}
 		if( bCheckEqual )
 		{
-			Log::Write( LogLevel_Info, m_id.GetNodeId(), "Changed value--confirmed" );
+			OZW_LOG( LogLevel_Info, m_id.GetNodeId(), "Changed value--confirmed" );
 			SetCheckingChange( false );
 
 			// update the saved value and send notification
+			if( deadband )
+			{
+				OnDeadbandNotified( newValue );
+			}
 			Value::OnValueChanged();
 			return 2;
 		}
@@ -730,7 +971,7 @@ int Value::VerifyRefreshedValue
 		// log this situation, but don't change the value or send a ValueChanged Notification
 		if( bOriginalEqual )
 		{
-			Log::Write( LogLevel_Info, m_id.GetNodeId(), "Spurious value change was noted." );
+			OZW_LOG( LogLevel_Info, m_id.GetNodeId(), "Spurious value change was noted." );
 			SetCheckingChange( false );
 			Value::OnValueRefreshed();
 			return 0;
@@ -738,7 +979,7 @@ int Value::VerifyRefreshedValue
 
 		// the second read is different than both the original value and the checked value...retry
 		// keep trying until we get the same value twice
-		Log::Write( LogLevel_Info, m_id.GetNodeId(), "Changed value (changed again)--rechecking" );
+		OZW_LOG( LogLevel_Info, m_id.GetNodeId(), "Changed value (changed again)--rechecking" );
 		SetCheckingChange( true );
 
 		// save a temporary copy of value and re-read value from device
@@ -746,3 +987,87 @@ int Value::VerifyRefreshedValue
 		return 1;
 	}
 }
+
+//-----------------------------------------------------------------------------
+// <Value::RefreshFromCache>
+// Tell the watchers a recently read value has been refreshed
+//-----------------------------------------------------------------------------
+bool Value::RefreshFromCache
+(
+	uint32 const _maxAge
+)
+{
+	if( !m_isSet || IsCheckingChange() || IsWriteOnly() || m_refreshTime == 0 )
+	{
+		return false;
+	}
+
+	// The millisecond clock wraps, so check the time of day first
+	if( time( NULL ) - m_refreshTime > (time_t)( _maxAge / 1000 + 1 ) )
+	{
+		return false;
+	}
+	uint32 age = ( 0u - (uint32)s_refreshClock.TimeRemaining() ) - m_refreshTick;
+	if( age > _maxAge )
+	{
+		return false;
+	}
+
+	if( Driver* driver = Manager::Get()->GetDriver( m_id.GetHomeId() ) )
+	{
+		OZW_LOG( LogLevel_Detail, m_id.GetNodeId(), "Value was read %dms ago, so it is not requested again", age );
+		Notification* notification = new Notification( Notification::Type_ValueRefreshed );
+		notification->SetValueId( m_id );
+		driver->QueueNotification( notification );
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Value::StampRefreshTime>
+// Note that the value has just been read from the device
+//-----------------------------------------------------------------------------
+void Value::StampRefreshTime
+(
+)
+{
+	m_refreshTime = time( NULL );
+	m_refreshTick = 0u - (uint32)s_refreshClock.TimeRemaining();
+}
+
+//-----------------------------------------------------------------------------
+// <Value::IsWithinDeadband>
+// Whether a report is close enough to the last notified value to skip notifying
+//-----------------------------------------------------------------------------
+bool Value::IsWithinDeadband
+(
+	double const _value
+)const
+{
+	double limit = m_deadbandPercent ? fabs( m_notifiedValue ) * m_deadband / 100.0 : m_deadband;
+	if( fabs( _value - m_notifiedValue ) > limit )
+	{
+		return false;
+	}
+
+	// Let one through now and then, so the watchers know the device is still reporting
+	int32 heartbeat = s_deadbandHeartbeat.Get();
+	if( heartbeat > 0 && m_refreshTime - m_notifiedTime >= heartbeat )
+	{
+		return false;
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <Value::OnDeadbandNotified>
+// Note the value the watchers were last told about
+//-----------------------------------------------------------------------------
+void Value::OnDeadbandNotified
+(
+	double const _value
+)
+{
+	m_notifiedValue = _value;
+	m_notifiedTime = time( NULL );
+}
@@ -33,20 +33,25 @@
 #include <time.h>
 #endif
 #include "Defs.h"
+#include "SharedString.h"
 #include "platform/Ref.h"
 #include "value_classes/ValueID.h"
+#include "value_classes/ValueExport.h"
 
 class TiXmlElement;
 
 namespace OpenZWave
 {
 	class Node;
+	class ValueIndex;
 
 	/** \brief Base class for values associated with a node.
 	 */
 	class Value: public Ref
 	{
 		friend class Driver;
+		friend class ValueExport;
+		friend class ValueIndex;
 		friend class ValueStore;
 
 	public:
@@ -63,7 +68,7 @@ namespace OpenZWave
 		bool IsPolled()const{ return m_pollIntensity != 0; }
 
 		string const& GetLabel()const{ return m_label; }
-		void SetLabel( string const& _label ){ m_label = _label; }
+		void SetLabel( string const& _label );
 
 		string const& GetUnits()const{ return m_units; }
 		void SetUnits( string const& _units ){ m_units = _units; }
@@ -71,8 +76,15 @@ namespace OpenZWave
 		string const& GetHelp()const{ return m_help; }
 		void SetHelp( string const& _help ){ m_help = _help; }
 
+		// The texts as held, which can be kept without copying them
+		SharedString const& GetSharedLabel()const{ return m_label; }
+		SharedString const& GetSharedUnits()const{ return m_units; }
+		SharedString const& GetSharedHelp()const{ return m_help; }
+
 		uint8 const& GetPollIntensity()const{ return m_pollIntensity; }
 		void SetPollIntensity( uint8 const& _intensity ){ m_pollIntensity = _intensity; }
+		uint32 GetPollInterval()const{ return m_pollInterval; }
+		void SetPollInterval( uint32 const _milliseconds ){ m_pollInterval = _milliseconds; }
 
 		int32 GetMin()const{ return m_min; }
 		int32 GetMax()const{ return m_max; }
@@ -80,11 +92,48 @@ namespace OpenZWave
 		void SetChangeVerified( bool _verify ){ m_verifyChanges = _verify; }
 		bool GetChangeVerified() { return m_verifyChanges; }
 
+		/**
+		 * Hold back ValueChanged notifications for small changes to a decimal, int or short
+		 * value.  A report within the deadband of the last value the watchers were told about
+		 * still updates the value, but sends no notification, unless the DeadbandHeartbeat
+		 * option's time has passed since the last one.
+		 * \param _deadband the largest change to hold back, or zero to notify every report.
+		 * \param _percent if true, the deadband is a percentage of the last notified value
+		 * rather than an amount in the value's units.
+		 */
+		void SetDeadband( float const _deadband, bool const _percent ){ m_deadband = _deadband; m_deadbandPercent = _percent; }
+		float GetDeadband()const{ return m_deadband; }
+		bool IsDeadbandPercent()const{ return m_deadbandPercent; }
+
 		virtual string const GetAsString() const { return ""; }
 		virtual bool SetFromString( string const& ) { return false; }
 
+		/**
+		 * \return the bytes used by the value, including what it owns on the heap.  The
+		 * label, units and help are shared between values, so are not counted here.
+		 */
+		virtual uint32 GetMemoryUsage()const{ return sizeof(Value) + m_affectsLength; }
+
 		bool Set();							// For the user to change a value in a device
 
+		/**
+		 * Read the snapshot of a scalar value without taking the node lock.  Bool, byte,
+		 * short and int values keep their current value in a snapshot, along with the
+		 * number of times it has been published.  The pair is read consistently, even
+		 * while the driver thread is updating it.
+		 * \param o_value filled with the value, cast to 32 bits.
+		 * \param o_version if not NULL, filled with the number of times the value has been published.
+		 */
+		void ReadSnapshot( uint32* o_value, uint32* o_version )const;
+
+		/**
+		 * Tell the watchers the value has been refreshed without asking the device, if it
+		 * was read from the device within the last _maxAge milliseconds.  A value waiting
+		 * to be read again, to confirm a change, is never recent enough.
+		 * \return true if the watchers were told.  False if the value must be requested.
+		 */
+		bool RefreshFromCache( uint32 const _maxAge );
+
 		// Helpers
 		static ValueID::ValueGenre GetGenreEnumFromName( char const* _name );
 		static char const* GetGenreNameFromEnum( ValueID::ValueGenre _genre );
@@ -100,18 +149,27 @@ namespace OpenZWave
 		void OnValueRefreshed();			// A value in a device has been refreshed
 		void OnValueChanged();				// The refreshed value actually changed
 		int VerifyRefreshedValue( void* _originalValue, void* _checkValue, void* _newValue, ValueID::ValueType _type, int _length = 0 );
+		void PublishSnapshot( uint32 const _value );	// Called by the scalar values whenever their value is set
+		virtual bool SwapValue( Value* _other ){ return false; }	// Exchange values with another of the same type, for an optimistic set.  False if the type does not support it.
+		void Export();						// Copy the value to the shared value table, if it has a slot there.  Called whenever the value is set.
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const{ return false; }	// The value as the table holds it.  False if there is none.
 
 		int32		m_min;
 		int32		m_max;
 
 		time_t		m_refreshTime;			// time_t identifying when this value was last refreshed
+		uint32		m_refreshTick;			// The same, on a millisecond clock that wraps every 49 days
 		bool		m_verifyChanges;		// if true, apparent changes are verified; otherwise, they're not
 
 	private:
+		bool IsWithinDeadband( double const _value )const;	// Whether a report can be applied without notifying the watchers
+		void OnDeadbandNotified( double const _value );		// Note the value the watchers were last told about
+		void StampRefreshTime();							// Note that the value has just been read from the device
+
 		ValueID		m_id;
-		string		m_label;
-		string		m_units;
-		string		m_help;
+		SharedString	m_label;		// Shared with the other values that have the same text
+		SharedString	m_units;
+		SharedString	m_help;
 		bool		m_readOnly;
 		bool		m_writeOnly;
 		bool		m_isSet;
@@ -120,6 +178,15 @@ namespace OpenZWave
 		bool		m_affectsAll;
 		bool		m_checkChange;
 		uint8		m_pollIntensity;
+		uint32		m_pollInterval;			// milliseconds between polls, or zero to derive it from the poll intensity
+		float		m_deadband;				// largest change not notified, or zero to notify every report
+		bool		m_deadbandPercent;		// if true, m_deadband is a percentage of m_notifiedValue
+		double		m_notifiedValue;		// the value in the last ValueChanged notification, when there is a deadband
+		time_t		m_notifiedTime;			// when that notification was sent
+		volatile uint32	m_snapshot;			// The value, for ReadSnapshot
+		volatile uint32	m_snapshotSeq;		// Odd while m_snapshot is being written
+		ValueExport::Slot*	m_exportSlot;	// The value's slot in the shared value table, or NULL
+		ValueIndex*	m_index;				// The index of the driver's values, once the value is in its node
 	};
 
 } // namespace OpenZWave
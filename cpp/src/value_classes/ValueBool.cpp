@@ -60,6 +60,7 @@ ValueBool::ValueBool
 	m_valueCheck( false ),
 	m_newValue( false )
 {
+	PublishSnapshot( (uint32)m_value );
 }
 
 bool ValueBool::SetFromString
@@ -94,6 +95,7 @@ void ValueBool::ReadXML
 	if( str )
 	{
 		m_value = !strcmp( str, "True" );
+		PublishSnapshot( (uint32)m_value );
 	}
 	else
 	{
@@ -130,12 +132,46 @@ bool ValueBool::Set
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueBool::SwapValue>
+// Exchange values with another bool value
+//-----------------------------------------------------------------------------
+bool ValueBool::SwapValue
+(
+	Value* _other
+)
+{
+	ValueBool* other = static_cast<ValueBool*>( _other );
+	bool value = m_value;
+	m_value = other->m_value;
+	other->m_value = value;
+	PublishSnapshot( (uint32)m_value );
+	other->PublishSnapshot( (uint32)other->m_value );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueBool::GetExportValue>
+// The value as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueBool::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_value ? 1 : 0;
+	*o_real = (double)*o_integer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueBool::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -154,6 +190,7 @@ void ValueBool::OnValueRefreshed
 		break;
 	case 2:		// value has changed (confirmed), save _value in m_value
 		m_value = _value;
+		PublishSnapshot( (uint32)m_value );
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
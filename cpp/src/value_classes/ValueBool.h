@@ -54,6 +54,7 @@ namespace OpenZWave
 
 		// From Value
 		virtual string const GetAsString() const { return ( GetValue() ? "True" : "False" ); }
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueBool) - sizeof(Value); }
 		virtual bool SetFromString( string const& _value );
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
@@ -61,6 +62,9 @@ namespace OpenZWave
 		bool GetValue()const{ return m_value; }
 
 	private:
+		virtual bool SwapValue( Value* _other );
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const;
+
 		bool	m_value;				// the current index in the m_items vector
 		bool	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
 		bool	m_newValue;				// a new value to be set on the appropriate device
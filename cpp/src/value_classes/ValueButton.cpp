@@ -92,6 +92,7 @@ bool ValueButton::PressButton
 {
 	// Set the value in the device.
 	m_pressed = true;
+	Export();
 	return Value::Set();
 }
 
@@ -105,6 +106,7 @@ bool ValueButton::ReleaseButton
 {
 	// Set the value in the device.
 	m_pressed = false;
+	Export();
 	bool res = Value::Set();
 	if( Driver* driver = Manager::Get()->GetDriver( GetID().GetHomeId() ) )
 	{
@@ -116,5 +118,18 @@ bool ValueButton::ReleaseButton
 	return res;
 }
 
-
-
+//-----------------------------------------------------------------------------
+// <ValueButton::GetExportValue>
+// Whether the button is pressed, as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueButton::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_pressed ? 1 : 0;
+	*o_real = (double)*o_integer;
+	return true;
+}
@@ -53,6 +53,7 @@ namespace OpenZWave
 		bool ReleaseButton();
 
 		virtual string const GetAsString() const { return ( IsPressed() ? "true" : "false" ); }
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueButton) - sizeof(Value); }
 
 		// From Value
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
@@ -61,6 +62,8 @@ namespace OpenZWave
 		bool IsPressed()const{ return m_pressed; }
 
 	private:
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const;
+
 		bool	m_pressed;
 	};
 
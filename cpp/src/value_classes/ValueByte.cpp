@@ -60,6 +60,7 @@ ValueByte::ValueByte
 	m_valueCheck( false ),
 	m_newValue( false )
 {
+	PublishSnapshot( (uint32)m_value );
 	m_min = 0;
 	m_max = 255;
 }
@@ -116,6 +117,7 @@ void ValueByte::ReadXML
 	if( TIXML_SUCCESS == _valueElement->QueryIntAttribute( "value", &intVal ) )
 	{
 		m_value = (uint8)intVal;
+		PublishSnapshot( (uint32)m_value );
 	}
 	else
 	{
@@ -155,12 +157,46 @@ bool ValueByte::Set
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueByte::SwapValue>
+// Exchange values with another byte value
+//-----------------------------------------------------------------------------
+bool ValueByte::SwapValue
+(
+	Value* _other
+)
+{
+	ValueByte* other = static_cast<ValueByte*>( _other );
+	uint8 value = m_value;
+	m_value = other->m_value;
+	other->m_value = value;
+	PublishSnapshot( (uint32)m_value );
+	other->PublishSnapshot( (uint32)other->m_value );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueByte::GetExportValue>
+// The value as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueByte::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_value;
+	*o_real = (double)*o_integer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueByte::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -179,6 +215,7 @@ void ValueByte::OnValueRefreshed
 		break;
 	case 2:		// value has changed (confirmed), save _value in m_value
 		m_value = _value;
+		PublishSnapshot( (uint32)m_value );
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
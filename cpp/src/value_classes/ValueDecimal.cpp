@@ -27,13 +27,24 @@
 
 #include "tinyxml.h"
 #include "value_classes/ValueDecimal.h"
+#include "value_classes/ValueHistory.h"
+#include "command_classes/Meter.h"
+#include "command_classes/SensorMultilevel.h"
 #include "Msg.h"
 #include "platform/Log.h"
 #include "Manager.h"
+#include "Options.h"
 #include <ctime>
+#include <clocale>
 
 using namespace OpenZWave;
 
+static int32 const c_powersOfTen[] =
+{
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static uint8 const c_maxPrecision = 9;
 
 //-----------------------------------------------------------------------------
 // <ValueDecimal::ValueDecimal>
@@ -55,11 +66,72 @@ ValueDecimal::ValueDecimal
 	uint8 const _pollIntensity
 ):
   	Value( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, ValueID::ValueType_Decimal, _label, _units, _readOnly, _writeOnly, false, _pollIntensity ),
-	m_value( _value ),
-	m_valueCheck( "" ),
-	m_newValue( "" ),
-	m_precision( 0 )
+	m_value( Parse( _value ) ),
+	m_valueCheck( Parse( "" ) ),
+	m_newValue( Parse( "" ) ),
+	m_precision( 0 ),
+	m_history( NULL ),
+	m_historyChecked( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::ValueDecimal>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueDecimal::ValueDecimal
+(
+):
+	m_value( Parse( "" ) ),
+	m_valueCheck( Parse( "" ) ),
+	m_newValue( Parse( "" ) ),
+	m_precision( 0 ),
+	m_history( NULL ),
+	m_historyChecked( false )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::~ValueDecimal>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueDecimal::~ValueDecimal
+(
+)
+{
+	delete m_history;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::GetMemoryUsage>
+// Bytes used by the value and its history
+//-----------------------------------------------------------------------------
+uint32 ValueDecimal::GetMemoryUsage
+(
+)const
+{
+	return Value::GetMemoryUsage() + sizeof(ValueDecimal) - sizeof(Value) + ( m_history ? m_history->GetMemoryUsage() : 0 );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::SetHistoryDepth>
+// Keep the most recent readings of this value
+//-----------------------------------------------------------------------------
+void ValueDecimal::SetHistoryDepth
+(
+	uint32 const _depth
+)
 {
+	m_historyChecked = true;
+	if( m_history )
+	{
+		// Emptied rather than deleted, as the driver thread may be adding to it
+		m_history->SetDepth( _depth );
+	}
+	else if( _depth )
+	{
+		m_history = new ValueHistory( _depth );
+	}
 }
 
 //-----------------------------------------------------------------------------
@@ -79,7 +151,8 @@ void ValueDecimal::ReadXML
 	char const* str = _valueElement->Attribute( "value" );
 	if( str )
 	{
-		m_value = str;
+		m_value = Parse( str );
+		Export();
 	}
 	else
 	{
@@ -97,7 +170,33 @@ void ValueDecimal::WriteXML
 )
 {
 	Value::WriteXML( _valueElement );
-	_valueElement->SetAttribute( "value", m_value.c_str() );
+
+	char str[16];
+	_valueElement->SetAttribute( "value", Format( m_value, str, sizeof(str) ) );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::GetValue>
+// Get the value as a string
+//-----------------------------------------------------------------------------
+string ValueDecimal::GetValue
+(
+)const
+{
+	char str[16];
+	return Format( m_value, str, sizeof(str) );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::GetValueAsFloat>
+// Get the value as a floating point number
+//-----------------------------------------------------------------------------
+float ValueDecimal::GetValueAsFloat
+(
+)const
+{
+	// Divide as doubles, so the result matches converting the string with atof
+	return (float)( (double)m_value.m_mantissa / (double)c_powersOfTen[m_value.m_precision] );
 }
 
 //-----------------------------------------------------------------------------
@@ -111,17 +210,56 @@ bool ValueDecimal::Set
 {
 	// create a temporary copy of this value to be submitted to the Set() call and set its value to the function param
   	ValueDecimal* tempValue = new ValueDecimal( *this );
-	tempValue->m_value = _value;
+	tempValue->m_value = Parse( _value );
+	tempValue->m_history = NULL;		// the readings stay with this value
 
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueDecimal::SwapValue>
+// Exchange values with another decimal value
+//-----------------------------------------------------------------------------
+bool ValueDecimal::SwapValue
+(
+	Value* _other
+)
+{
+	ValueDecimal* other = static_cast<ValueDecimal*>( _other );
+	Fixed value = m_value;
+	m_value = other->m_value;
+	other->m_value = value;
+	uint8 precision = m_precision;
+	m_precision = other->m_precision;
+	other->m_precision = precision;
+	Export();
+	other->Export();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::GetExportValue>
+// The value as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueDecimal::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_value.m_mantissa;
+	*o_real = (double)m_value.m_mantissa / (double)c_powersOfTen[m_value.m_precision];
+	*o_precision = m_value.m_precision;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueDecimal::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -131,17 +269,147 @@ void ValueDecimal::OnValueRefreshed
 	string const& _value
 )
 {
-	switch( VerifyRefreshedValue( (void*) &m_value, (void*) &m_valueCheck, (void*) &_value, ValueID::ValueType_Decimal) )
+	Fixed value = Parse( _value );
+	OnValueRefreshed( value.m_mantissa, value.m_precision );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::OnValueRefreshed>
+// A value in a device has been refreshed
+//-----------------------------------------------------------------------------
+void ValueDecimal::OnValueRefreshed
+(
+	int32 const _mantissa,
+	uint8 const _precision
+)
+{
+	Fixed value;
+	value.m_mantissa = _mantissa;
+	value.m_precision = ( _precision > c_maxPrecision ) ? c_maxPrecision : _precision;
+
+	if( !m_historyChecked )
+	{
+		// Meter and sensor readings are kept if the application asked for it
+		m_historyChecked = true;
+		uint8 commandClassId = GetID().GetCommandClassId();
+		if( commandClassId == Meter::StaticGetCommandClassId() || commandClassId == SensorMultilevel::StaticGetCommandClassId() )
+		{
+			int32 depth = 0;
+			Options::Get()->GetOptionAsInt( "ValueHistoryDepth", &depth );
+			if( depth > 0 )
+			{
+				m_history = new ValueHistory( (uint32)depth );
+			}
+		}
+	}
+	if( m_history )
+	{
+		m_history->Add( value.m_mantissa, value.m_precision );
+	}
+
+	switch( VerifyRefreshedValue( (void*) &m_value, (void*) &m_valueCheck, (void*) &value, ValueID::ValueType_Decimal) )
 	{
 	case 0:		// value hasn't changed, nothing to do
 		break;
-	case 1:		// value has changed (not confirmed yet), save _value in m_valueCheck
-		m_valueCheck = _value;
+	case 1:		// value has changed (not confirmed yet), save value in m_valueCheck
+		m_valueCheck = value;
 		break;
-	case 2:		// value has changed (confirmed), save _value in m_value
-		m_value = _value;
+	case 2:		// value has changed (confirmed), save value in m_value
+		m_value = value;
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+	// Even if unchanged, the time it was read has moved on
+	Export();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::Parse>
+// Convert a decimal string such as "-12.5" to a fixed point number.  Either
+// '.' or ',' may separate the decimals.  Like atol, parsing stops at the
+// first character that does not belong to the number.
+//-----------------------------------------------------------------------------
+ValueDecimal::Fixed ValueDecimal::Parse
+(
+	string const& _value
+)
+{
+	Fixed res;
+	res.m_mantissa = 0;
+	res.m_precision = 0;
+
+	char const* str = _value.c_str();
+	while( isspace( *str ) )
+	{
+		++str;
+	}
+
+	bool negative = false;
+	if( ( *str == '-' ) || ( *str == '+' ) )
+	{
+		negative = ( *str == '-' );
+		++str;
+	}
+
+	bool decimals = false;
+	int64 mantissa = 0;
+	for( ; *str; ++str )
+	{
+		if( isdigit( *str ) )
+		{
+			int64 next = mantissa * 10 + ( *str - '0' );
+			if( decimals )
+			{
+				if( ( res.m_precision == c_maxPrecision ) || ( next > 0x7fffffff ) )
+				{
+					// Drop any decimals beyond what we can hold
+					continue;
+				}
+				++res.m_precision;
+			}
+			else if( next > 0x7fffffff )
+			{
+				next = 0x7fffffff;
+			}
+			mantissa = next;
+		}
+		else if( !decimals && ( ( *str == '.' ) || ( *str == ',' ) ) )
+		{
+			decimals = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	res.m_mantissa = (int32)( negative ? -mantissa : mantissa );
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueDecimal::Format>
+// Write a fixed point number into a buffer, with the precision's number of
+// decimal places, and the locale's decimal point
+//-----------------------------------------------------------------------------
+char const* ValueDecimal::Format
+(
+	Fixed const& _value,
+	char* o_buffer,
+	uint32 const _size
+)
+{
+	if( _value.m_precision == 0 )
+	{
+		snprintf( o_buffer, _size, "%d", _value.m_mantissa );
+	}
+	else
+	{
+		uint32 divisor = (uint32)c_powersOfTen[_value.m_precision];
+		uint32 magnitude = ( _value.m_mantissa < 0 ) ? (uint32)( -(int64)_value.m_mantissa ) : (uint32)_value.m_mantissa;
+		struct lconv const* locale = localeconv();
+		snprintf( o_buffer, _size, "%s%u%c%0*u", ( _value.m_mantissa < 0 ) ? "-" : "", magnitude / divisor, *(locale->decimal_point), (int)_value.m_precision, magnitude % divisor );
+	}
+	return o_buffer;
 }
@@ -38,8 +38,12 @@ namespace OpenZWave
 {
 	class Msg;
 	class Node;
+	class ValueHistory;
 
 	/** \brief Decimal value sent to/received from a node.
+	 *
+	 * The value is held as it arrives from the device: an integer, and the number of
+	 * digits after the decimal point.  It is only turned into a string when asked for.
 	 */
 	class ValueDecimal: public Value
 	{
@@ -49,29 +53,60 @@ namespace OpenZWave
 		friend class ThermostatSetpoint;
 
 	public:
+		/** A fixed point number: m_mantissa / 10^m_precision */
+		struct Fixed
+		{
+			int32	m_mantissa;
+			uint8	m_precision;
+
+			bool operator == ( Fixed const& _other )const{ return( ( m_mantissa == _other.m_mantissa ) && ( m_precision == _other.m_precision ) ); }
+		};
+
 		ValueDecimal( uint32 const _homeId, uint8 const _nodeId, ValueID::ValueGenre const _genre, uint8 const _commandClassId, uint8 const _instance, uint8 const _index, string const& _label, string const& _units, bool const _readOnly, bool const _writeOnly, string const& _value, uint8 const _pollIntensity );
-		ValueDecimal(): m_precision( 0 ){}
-		virtual ~ValueDecimal(){}
+		ValueDecimal();
+		virtual ~ValueDecimal();
 
 		bool Set( string const& _value );
 		void OnValueRefreshed( string const& _value );
+		void OnValueRefreshed( int32 const _mantissa, uint8 const _precision );
 
 		// From Value
 		virtual string const GetAsString() const { return GetValue(); }
+		virtual uint32 GetMemoryUsage()const;
 		virtual bool SetFromString( string const& _value ) { return Set( _value ); }
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
 
-		string GetValue()const{ return m_value; }
+		string GetValue()const;
+		Fixed const& GetFixedValue()const{ return m_value; }
+		float GetValueAsFloat()const;
 		uint8 GetPrecision()const{ return m_precision; }
 
+		/**
+		 * Keep the most recent readings of this value.
+		 * \param _depth number of readings to keep, or zero to stop keeping them.
+		 */
+		void SetHistoryDepth( uint32 const _depth );
+
+		/**
+		 * \return the recent readings, or NULL if none are being kept.
+		 */
+		ValueHistory const* GetHistory()const{ return m_history; }
+
+		static Fixed Parse( string const& _value );
+		static char const* Format( Fixed const& _value, char* o_buffer, uint32 const _size );	// Returns o_buffer
+
 	private:
 		void SetPrecision( uint8 _precision ){ m_precision = _precision; }
-
-		string	m_value;				// the current value
-		string	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
-		string	m_newValue;				// a new value to be set on the appropriate device
-	        uint8	m_precision;
+		virtual bool SwapValue( Value* _other );
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const;
+
+		Fixed	m_value;				// the current value
+		Fixed	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
+		Fixed	m_newValue;				// a new value to be set on the appropriate device
+		uint8	m_precision;			// precision of the last report, which can differ from m_value's while a change is being checked
+		ValueHistory*	m_history;		// recent readings, if they are being kept
+		bool	m_historyChecked;		// whether the ValueHistoryDepth option has been applied
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,296 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueExport.cpp
+//
+//	A table of the current values in shared memory, for other processes to read
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "value_classes/ValueExport.h"
+#include "value_classes/Value.h"
+#include "Utils.h"
+#include "platform/FileOps.h"
+#include "platform/Log.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+namespace
+{
+	// The layout is shared with other processes, so it must not change by accident
+	typedef char HeaderSizeCheck[ ( sizeof(ValueExport::Header) == 64 ) ? 1 : -1 ];
+	typedef char SlotSizeCheck[ ( sizeof(ValueExport::Slot) == 40 ) ? 1 : -1 ];
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Create>
+// Create the table for a network
+//-----------------------------------------------------------------------------
+ValueExport* ValueExport::Create
+(
+	string const& _folder,
+	uint32 const _homeId,
+	uint32 const _slots
+)
+{
+	string filename = GetFilename( _folder, _homeId );
+	uint32 size = (uint32)sizeof(Header) + _slots * (uint32)sizeof(Slot);
+	uint8* data = FileOps::CreateSharedFile( filename, size );
+	if( data == NULL )
+	{
+		Log::Write( LogLevel_Warning, "WARNING: Could not create the value table %s", filename.c_str() );
+		return NULL;
+	}
+
+	ValueExport* table = new ValueExport( data, size );
+	Header* header = table->m_header;
+	header->m_magic = Magic;
+	header->m_version = Version;
+	header->m_slotSize = (uint16)sizeof(Slot);
+	header->m_homeId = _homeId;
+	header->m_slotCount = _slots;
+	AtomicStore( &header->m_state, State_Open );
+
+	Log::Write( LogLevel_Info, "Exporting up to %d values to %s", _slots, filename.c_str() );
+	return table;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::ValueExport>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueExport::ValueExport
+(
+	uint8* _data,
+	uint32 const _size
+):
+	m_data( _data ),
+	m_size( _size ),
+	m_header( (Header*)_data ),
+	m_slots( (Slot*)( _data + sizeof(Header) ) ),
+	m_mutex( new Mutex( false ) ),
+	m_inUse( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::~ValueExport>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueExport::~ValueExport
+(
+)
+{
+	AtomicStore( &m_header->m_state, State_Closed );
+	if( m_inUse == 0 )
+	{
+		FileOps::UnmapFile( m_data, m_size );
+	}
+	else
+	{
+		Log::Write( LogLevel_Warning, "WARNING: %d values still have slots in the value table, so it is left mapped", m_inUse );
+	}
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::GetFilename>
+// The name of the file for a network
+//-----------------------------------------------------------------------------
+string ValueExport::GetFilename
+(
+	string const& _folder,
+	uint32 const _homeId
+)
+{
+	char str[32];
+	snprintf( str, sizeof(str), "ozwvalues_0x%08x.bin", _homeId );
+	return _folder + str;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::IsExported>
+// Whether values of a type have a slot
+//-----------------------------------------------------------------------------
+bool ValueExport::IsExported
+(
+	uint8 const _type
+)
+{
+	switch( _type )
+	{
+		case ValueID::ValueType_Bool:
+		case ValueID::ValueType_Byte:
+		case ValueID::ValueType_Decimal:
+		case ValueID::ValueType_Int:
+		case ValueID::ValueType_List:
+		case ValueID::ValueType_Short:
+		case ValueID::ValueType_Button:
+		{
+			return true;
+		}
+		default:
+		{
+			return false;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Add>
+// Give a value a slot
+//-----------------------------------------------------------------------------
+void ValueExport::Add
+(
+	Value* _value
+)
+{
+	ValueID const& id = _value->GetID();
+	if( _value->m_exportSlot || !IsExported( (uint8)id.GetType() ) )
+	{
+		return;
+	}
+
+	Slot* slot;
+	{
+		LockGuard LG( m_mutex );
+		uint32 index;
+		if( !m_free.empty() )
+		{
+			index = m_free.back();
+			m_free.pop_back();
+		}
+		else if( m_header->m_slotsUsed < m_header->m_slotCount )
+		{
+			index = m_header->m_slotsUsed;
+		}
+		else
+		{
+			if( AtomicIncrement( &m_header->m_dropped ) == 1 )
+			{
+				Log::Write( LogLevel_Warning, "WARNING: The value table is full.  Raise the ValueExportSlots option to export every value." );
+			}
+			return;
+		}
+		slot = &m_slots[index];
+		++m_inUse;
+
+		Lock( slot );
+		slot->m_type = (uint8)id.GetType();
+		slot->m_flags = 0;
+		slot->m_id = id.GetId();
+		Unlock( slot );
+
+		if( index == m_header->m_slotsUsed )
+		{
+			// Only now that the slot is filled in may readers look at it
+			AtomicStore( &m_header->m_slotsUsed, index + 1 );
+		}
+	}
+
+	_value->m_exportSlot = slot;
+	_value->Export();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Remove>
+// Clear a value's slot
+//-----------------------------------------------------------------------------
+void ValueExport::Remove
+(
+	Value* _value
+)
+{
+	Slot* slot = _value->m_exportSlot;
+	if( !slot )
+	{
+		return;
+	}
+	_value->m_exportSlot = NULL;
+
+	Lock( slot );
+	slot->m_flags = 0;
+	slot->m_id = 0;
+	slot->m_time = 0;
+	slot->m_integer = 0;
+	slot->m_real = 0.0;
+	Unlock( slot );
+
+	LockGuard LG( m_mutex );
+	m_free.push_back( (uint32)( slot - m_slots ) );
+	--m_inUse;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Write>
+// Write a value into its slot
+//-----------------------------------------------------------------------------
+void ValueExport::Write
+(
+	Slot* _slot,
+	uint8 const _flags,
+	uint32 const _time,
+	int64 const _integer,
+	double const _real,
+	uint8 const _precision
+)
+{
+	Lock( _slot );
+	_slot->m_flags = _flags | SlotFlag_Used;
+	_slot->m_precision = _precision;
+	_slot->m_time = _time;
+	_slot->m_integer = _integer;
+	_slot->m_real = _real;
+	Unlock( _slot );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Lock>
+// Make a slot's sequence count odd, waiting for any other writer to finish
+//-----------------------------------------------------------------------------
+void ValueExport::Lock
+(
+	Slot* _slot
+)
+{
+	// Values are set by the driver thread, and by an optimistic set with the
+	// node locked, so two writers can meet on one slot
+	while( true )
+	{
+		uint32 seq = AtomicLoad( &_slot->m_seq );
+		if( !( seq & 1 ) && AtomicCompareExchange( &_slot->m_seq, seq, seq + 1 ) )
+		{
+			return;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueExport::Unlock>
+// Make a slot's sequence count even again, publishing what was written
+//-----------------------------------------------------------------------------
+void ValueExport::Unlock
+(
+	Slot* _slot
+)
+{
+	AtomicStore( &_slot->m_seq, _slot->m_seq + 1 );
+}
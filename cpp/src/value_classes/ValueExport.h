@@ -0,0 +1,208 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueExport.h
+//
+//	A table of the current values in shared memory, for other processes to read
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueExport_H
+#define _ValueExport_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "platform/Atomic.h"
+
+namespace OpenZWave
+{
+	class Value;
+	class Mutex;
+
+	/** \brief The numeric values of a network, kept in a file mapped into memory.
+	 *
+	 * With the ValueExportPath option, each driver keeps a table of its bool, byte,
+	 * short, int, decimal, list and button values in ozwvalues_0x<homeid>.bin in
+	 * that folder, which is meant to be in memory, such as /dev/shm.  Other processes
+	 * map the file read only and read the values as they change, without calling
+	 * into the library or waiting on its locks.
+	 *
+	 * The file is a Header followed by Header::m_slotCount Slots.  Both are laid out
+	 * with fixed sizes and offsets in the machine's own byte order.  A value takes
+	 * the first free slot when it is added to a node, and keeps it until it is
+	 * removed, when the slot is cleared for reuse.  Only the slots below
+	 * Header::m_slotsUsed have ever been used.  Values beyond the ValueExportSlots
+	 * option are left out, and counted in Header::m_dropped.
+	 *
+	 * Each slot is guarded by a sequence count, which is odd while the slot is being
+	 * written.  A reader loads the count, copies the slot, and loads the count again;
+	 * the copy is good if the count was even and had not changed.  ReadSlot does
+	 * this, for readers that include this header.
+	 *
+	 * The table is rewritten each time the driver starts, as a new file, so readers
+	 * of the old one are not disturbed.  When a driver is removed it sets
+	 * Header::m_state to State_Closed, and readers should map the file again.
+	 */
+	class ValueExport
+	{
+	public:
+		enum
+		{
+			Magic			= 0x56575a4f,		// "OZWV"
+			Version			= 1
+		};
+
+		enum State
+		{
+			State_Closed	= 0,				// The driver has gone, and a new table may replace this one
+			State_Open		= 1
+		};
+
+		enum SlotFlag
+		{
+			SlotFlag_Used	= 0x01,				// The slot holds a value
+			SlotFlag_Set	= 0x02,				// The value has been read from the device, rather than from the configuration
+			SlotFlag_Empty	= 0x04				// The value has nothing to show, such as a list with no item selected
+		};
+
+		/** The start of the file, 64 bytes */
+		struct Header
+		{
+			uint32			m_magic;			// Magic
+			uint16			m_version;			// Version
+			uint16			m_slotSize;			// sizeof(Slot)
+			uint32			m_homeId;
+			uint32			m_slotCount;		// Number of slots in the file
+			volatile uint32	m_slotsUsed;		// Slots at or above this have never held a value
+			volatile uint32	m_state;			// State
+			volatile uint32	m_dropped;			// Values left out because the table was full
+			uint32			m_reserved[9];
+		};
+
+		/** One value, 40 bytes */
+		struct Slot
+		{
+			volatile uint32	m_seq;				// Odd while the slot is being written
+			uint8			m_type;				// ValueID::ValueType
+			uint8			m_flags;			// SlotFlags
+			uint8			m_precision;		// For a decimal, the number of digits in m_integer after the decimal point
+			uint8			m_reserved;
+			uint64			m_id;				// ValueID::GetId
+			uint32			m_time;				// When the value was last read from the device, in seconds since 1970, or zero
+			uint32			m_reserved2;
+			int64			m_integer;			// The value.  For a list, the value of the selected item.  For a decimal, the value times 10^m_precision.
+			double			m_real;				// The value as a double, for every type
+		};
+
+		/**
+		 * Create the table for a network.
+		 * \param _folder where to put the file, ending with a path separator.
+		 * \param _homeId the network's home ID.
+		 * \param _slots number of values the table can hold.
+		 * \return the table, or NULL if the file could not be created.
+		 */
+		static ValueExport* Create( string const& _folder, uint32 const _homeId, uint32 const _slots );
+
+		/**
+		 * Mark the table closed and unmap it.  If any value still has a slot, the table
+		 * is left mapped, so that the value can go on writing to it harmlessly.
+		 */
+		~ValueExport();
+
+		/**
+		 * Give a value a slot, and fill it in.  Values of types the table does not hold are ignored.
+		 */
+		void Add( Value* _value );
+
+		/**
+		 * Clear a value's slot and make it free for reuse.
+		 */
+		void Remove( Value* _value );
+
+		/**
+		 * Write a value into its slot.  Called by Value::Export whenever the value changes.
+		 * \param _slot the value's slot.
+		 * \param _flags SlotFlags, other than SlotFlag_Used.
+		 * \param _time when the value was last read from the device.
+		 * \param _integer the value, or for a decimal its mantissa.
+		 * \param _real the value as a double.
+		 * \param _precision for a decimal, the number of digits after the decimal point.
+		 */
+		static void Write( Slot* _slot, uint8 const _flags, uint32 const _time, int64 const _integer, double const _real, uint8 const _precision );
+
+		/**
+		 * Copy a slot, consistently, from a table mapped by another process.
+		 * \param _slot the slot in the mapped table.
+		 * \param o_copy filled with the slot's contents.
+		 * \return true if the slot holds a value.
+		 */
+		static bool ReadSlot( Slot const* _slot, Slot* o_copy )
+		{
+			while( true )
+			{
+				uint32 seq = AtomicLoad( &_slot->m_seq );
+				if( seq & 1 )
+				{
+					// Caught the writer part way through
+					continue;
+				}
+
+				o_copy->m_type = _slot->m_type;
+				o_copy->m_flags = _slot->m_flags;
+				o_copy->m_precision = _slot->m_precision;
+				o_copy->m_id = _slot->m_id;
+				o_copy->m_time = _slot->m_time;
+				o_copy->m_integer = _slot->m_integer;
+				o_copy->m_real = _slot->m_real;
+				AtomicAcquireFence();
+				if( AtomicLoad( &_slot->m_seq ) == seq )
+				{
+					o_copy->m_seq = seq;
+					return( ( o_copy->m_flags & SlotFlag_Used ) != 0 );
+				}
+			}
+		}
+
+		/**
+		 * \return the name of the file for a network.
+		 */
+		static string GetFilename( string const& _folder, uint32 const _homeId );
+
+	private:
+		ValueExport( uint8* _data, uint32 const _size );
+
+		static bool IsExported( uint8 const _type );	// Whether values of a ValueID::ValueType have a slot
+		static void Lock( Slot* _slot );				// Make the sequence count odd, waiting for any other writer
+		static void Unlock( Slot* _slot );				// Make it even again
+
+		uint8*			m_data;
+		uint32			m_size;
+		Header*			m_header;
+		Slot*			m_slots;
+		Mutex*			m_mutex;			// Guards the free list, m_slotsUsed and m_inUse
+		uint32			m_inUse;			// Values with a slot
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<uint32>	m_free;				// Slots below m_slotsUsed that have been cleared
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueExport_H
@@ -0,0 +1,202 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueHandle.cpp
+//
+//	Lock free reads of a scalar value
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "value_classes/ValueHandle.h"
+#include "value_classes/Value.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::ValueHandle>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueHandle::ValueHandle
+(
+):
+	m_value( NULL )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::ValueHandle>
+// Constructor, taking over a reference to a value
+//-----------------------------------------------------------------------------
+ValueHandle::ValueHandle
+(
+	Value* _value
+):
+	m_value( _value ),
+	m_id( _value->GetID() )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::ValueHandle>
+// Copy constructor
+//-----------------------------------------------------------------------------
+ValueHandle::ValueHandle
+(
+	ValueHandle const& _other
+):
+	m_value( _other.m_value ),
+	m_id( _other.m_id )
+{
+	if( m_value )
+	{
+		m_value->AddRef();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::operator =>
+// Assignment
+//-----------------------------------------------------------------------------
+ValueHandle& ValueHandle::operator =
+(
+	ValueHandle const& _other
+)
+{
+	// Add the new reference first, in case the two share a value
+	if( _other.m_value )
+	{
+		_other.m_value->AddRef();
+	}
+	if( m_value )
+	{
+		m_value->Release();
+	}
+	m_value = _other.m_value;
+	m_id = _other.m_id;
+	return *this;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::~ValueHandle>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueHandle::~ValueHandle
+(
+)
+{
+	if( m_value )
+	{
+		m_value->Release();
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::GetValueAsBool>
+// Read a bool value
+//-----------------------------------------------------------------------------
+bool ValueHandle::GetValueAsBool
+(
+	bool* o_value,
+	uint32* o_version	// = NULL
+)const
+{
+	uint32 value;
+	if( !o_value || !Read( ValueID::ValueType_Bool, &value, o_version ) )
+	{
+		return false;
+	}
+	*o_value = ( value != 0 );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::GetValueAsByte>
+// Read a byte value
+//-----------------------------------------------------------------------------
+bool ValueHandle::GetValueAsByte
+(
+	uint8* o_value,
+	uint32* o_version	// = NULL
+)const
+{
+	uint32 value;
+	if( !o_value || !Read( ValueID::ValueType_Byte, &value, o_version ) )
+	{
+		return false;
+	}
+	*o_value = (uint8)value;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::GetValueAsShort>
+// Read a short value
+//-----------------------------------------------------------------------------
+bool ValueHandle::GetValueAsShort
+(
+	int16* o_value,
+	uint32* o_version	// = NULL
+)const
+{
+	uint32 value;
+	if( !o_value || !Read( ValueID::ValueType_Short, &value, o_version ) )
+	{
+		return false;
+	}
+	*o_value = (int16)value;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::GetValueAsInt>
+// Read an int value
+//-----------------------------------------------------------------------------
+bool ValueHandle::GetValueAsInt
+(
+	int32* o_value,
+	uint32* o_version	// = NULL
+)const
+{
+	uint32 value;
+	if( !o_value || !Read( ValueID::ValueType_Int, &value, o_version ) )
+	{
+		return false;
+	}
+	*o_value = (int32)value;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHandle::Read>
+// Read the value's snapshot, if it is of the expected type
+//-----------------------------------------------------------------------------
+bool ValueHandle::Read
+(
+	ValueID::ValueType const _type,
+	uint32* o_value,
+	uint32* o_version
+)const
+{
+	if( m_value == NULL || m_id.GetType() != _type )
+	{
+		return false;
+	}
+	m_value->ReadSnapshot( o_value, o_version );
+	return true;
+}
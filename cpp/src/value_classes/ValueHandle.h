@@ -0,0 +1,114 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueHandle.h
+//
+//	Lock free reads of a scalar value
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueHandle_H
+#define _ValueHandle_H
+
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Value;
+
+	/** \brief A handle for reading a bool, byte, short or int value without taking any locks.
+	 *
+	 * Obtained from Manager::GetValueHandle.  The handle keeps a reference to the value, so
+	 * each read is just a few atomic loads, with no lookup of the ValueID.  Each read also
+	 * returns a version, which goes up every time the value is set, so a poller can tell
+	 * when it has changed.
+	 *
+	 * If the value is removed from its node (for instance when the node is removed), the
+	 * handle still works, but goes on returning the last value.  Handles may be copied, and
+	 * used from any thread.
+	 */
+	class OPENZWAVE_EXPORT ValueHandle
+	{
+		friend class Manager;
+
+	public:
+		/**
+		 * Constructor.  Creates a handle that does not refer to any value.
+		 */
+		ValueHandle();
+
+		ValueHandle( ValueHandle const& _other );
+		ValueHandle& operator = ( ValueHandle const& _other );
+		~ValueHandle();
+
+		/**
+		 * \return true if the handle refers to a value.
+		 */
+		bool IsValid()const{ return( m_value != NULL ); }
+
+		/**
+		 * \return the ValueID of the value the handle refers to.
+		 */
+		ValueID const& GetID()const{ return m_id; }
+
+		/**
+		 * Read a bool value.
+		 * \param o_value filled with the value.
+		 * \param o_version if not NULL, filled with the number of times the value has been set.
+		 * \return true if the value was read.  Returns false if the handle is not valid, or is not for a ValueID::ValueType_Bool.
+		 */
+		bool GetValueAsBool( bool* o_value, uint32* o_version = NULL )const;
+
+		/**
+		 * Read a byte value.
+		 * \param o_value filled with the value.
+		 * \param o_version if not NULL, filled with the number of times the value has been set.
+		 * \return true if the value was read.  Returns false if the handle is not valid, or is not for a ValueID::ValueType_Byte.
+		 */
+		bool GetValueAsByte( uint8* o_value, uint32* o_version = NULL )const;
+
+		/**
+		 * Read a short value.
+		 * \param o_value filled with the value.
+		 * \param o_version if not NULL, filled with the number of times the value has been set.
+		 * \return true if the value was read.  Returns false if the handle is not valid, or is not for a ValueID::ValueType_Short.
+		 */
+		bool GetValueAsShort( int16* o_value, uint32* o_version = NULL )const;
+
+		/**
+		 * Read an int value.
+		 * \param o_value filled with the value.
+		 * \param o_version if not NULL, filled with the number of times the value has been set.
+		 * \return true if the value was read.  Returns false if the handle is not valid, or is not for a ValueID::ValueType_Int.
+		 */
+		bool GetValueAsInt( int32* o_value, uint32* o_version = NULL )const;
+
+	private:
+		ValueHandle( Value* _value );				// Takes over a reference the caller holds
+
+		bool Read( ValueID::ValueType const _type, uint32* o_value, uint32* o_version )const;
+
+		Value*		m_value;
+		ValueID		m_id;
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueHandle_H
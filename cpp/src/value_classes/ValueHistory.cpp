@@ -0,0 +1,187 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueHistory.cpp
+//
+//	The recent readings of a decimal value
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <time.h>
+#include "value_classes/ValueHistory.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::Sample::GetValueAsFloat>
+// The reading as a float
+//-----------------------------------------------------------------------------
+float ValueHistory::Sample::GetValueAsFloat
+(
+)const
+{
+	float value = (float)m_mantissa;
+	for( uint8 i=0; i<m_precision; ++i )
+	{
+		value /= 10.0f;
+	}
+	return value;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::ValueHistory>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueHistory::ValueHistory
+(
+	uint32 const _depth
+):
+	m_mutex( new Mutex( false ) ),
+	m_samples( _depth ),
+	m_next( 0 ),
+	m_count( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::~ValueHistory>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueHistory::~ValueHistory
+(
+)
+{
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::SetDepth>
+// Change the number of readings kept
+//-----------------------------------------------------------------------------
+void ValueHistory::SetDepth
+(
+	uint32 const _depth
+)
+{
+	m_mutex->Lock();
+	if( _depth != m_samples.size() )
+	{
+		// Unwind the ring into the new one, newest readings last
+		uint32 keep = ( m_count < _depth ) ? m_count : _depth;
+		vector<Sample> samples( _depth );
+		uint32 size = (uint32)m_samples.size();
+		for( uint32 i=0; i<keep; ++i )
+		{
+			samples[i] = m_samples[( m_next + size - keep + i ) % size];
+		}
+		m_samples.swap( samples );
+		m_count = keep;
+		m_next = ( _depth == 0 ) ? 0 : keep % _depth;
+	}
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::GetDepth>
+// The number of readings kept
+//-----------------------------------------------------------------------------
+uint32 ValueHistory::GetDepth
+(
+)const
+{
+	m_mutex->Lock();
+	uint32 depth = (uint32)m_samples.size();
+	m_mutex->Unlock();
+	return depth;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::GetMemoryUsage>
+// Bytes used by the history
+//-----------------------------------------------------------------------------
+uint32 ValueHistory::GetMemoryUsage
+(
+)const
+{
+	m_mutex->Lock();
+	uint32 bytes = (uint32)( sizeof(ValueHistory) + m_samples.capacity() * sizeof(Sample) );
+	m_mutex->Unlock();
+	return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::Add>
+// Record a reading, replacing the oldest once the ring is full
+//-----------------------------------------------------------------------------
+void ValueHistory::Add
+(
+	int32 const _mantissa,
+	uint8 const _precision
+)
+{
+	m_mutex->Lock();
+	uint32 size = (uint32)m_samples.size();
+	if( size )
+	{
+		Sample& sample = m_samples[m_next];
+		sample.m_time = (uint32)time( NULL );
+		sample.m_mantissa = _mantissa;
+		sample.m_precision = _precision;
+		m_next = ( m_next + 1 ) % size;
+		if( m_count < size )
+		{
+			++m_count;
+		}
+	}
+	m_mutex->Unlock();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueHistory::Get>
+// Copy out the readings since a time, oldest first
+//-----------------------------------------------------------------------------
+uint32 ValueHistory::Get
+(
+	uint32 const _since,
+	vector<Sample>* o_samples
+)const
+{
+	o_samples->clear();
+
+	m_mutex->Lock();
+	uint32 size = (uint32)m_samples.size();
+	uint32 first = ( m_next + size - m_count ) % ( size ? size : 1 );
+
+	// The readings are in time order, so skip the ones that are too old
+	uint32 skip = 0;
+	while( skip < m_count && m_samples[( first + skip ) % size].m_time < _since )
+	{
+		++skip;
+	}
+
+	o_samples->reserve( m_count - skip );
+	for( uint32 i=skip; i<m_count; ++i )
+	{
+		o_samples->push_back( m_samples[( first + i ) % size] );
+	}
+	m_mutex->Unlock();
+
+	return (uint32)o_samples->size();
+}
@@ -0,0 +1,106 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueHistory.h
+//
+//	The recent readings of a decimal value
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueHistory_H
+#define _ValueHistory_H
+
+#include <vector>
+#include "Defs.h"
+
+namespace OpenZWave
+{
+	class Mutex;
+
+	/** \brief A fixed size ring of the most recent readings of a decimal value.
+	 *
+	 * Every report of the value is kept, whether or not it changed the value, with the
+	 * time it arrived.  Readings are held as they came from the device, as an integer and
+	 * the number of digits after the decimal point.  Once the ring is full, each new
+	 * reading replaces the oldest.
+	 *
+	 * Readings are added by the driver thread and copied out by the application's, so the
+	 * ring has a lock of its own.
+	 */
+	class OPENZWAVE_EXPORT ValueHistory
+	{
+	public:
+		/** One reading of the value */
+		struct Sample
+		{
+			uint32	m_time;					/**< When the reading arrived, in seconds since 1970 UTC */
+			int32	m_mantissa;
+			uint8	m_precision;			/**< The reading is m_mantissa / 10^m_precision */
+
+			float GetValueAsFloat()const;
+		};
+
+		/**
+		 * Constructor.
+		 * \param _depth number of readings to keep.
+		 */
+		ValueHistory( uint32 const _depth );
+		~ValueHistory();
+
+		/**
+		 * Change the number of readings kept.  The newest readings that fit are kept.
+		 * \param _depth number of readings, or zero to keep none.
+		 */
+		void SetDepth( uint32 const _depth );
+
+		/**
+		 * \return the number of readings kept.
+		 */
+		uint32 GetDepth()const;
+
+		/**
+		 * \return the bytes used by the history and its ring.
+		 */
+		uint32 GetMemoryUsage()const;
+
+		/**
+		 * Record a reading, timed now.
+		 */
+		void Add( int32 const _mantissa, uint8 const _precision );
+
+		/**
+		 * Copy out readings, oldest first.
+		 * \param _since only copy readings that arrived at or after this time, in seconds since 1970 UTC.
+		 * \param o_samples filled with the readings.  Anything it held is removed.
+		 * \return the number of readings copied.
+		 */
+		uint32 Get( uint32 const _since, vector<Sample>* o_samples )const;
+
+	private:
+		Mutex*				m_mutex;
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<Sample>		m_samples;			// The ring, sized to the depth
+OPENZWAVE_EXPORT_WARNINGS_ON
+		uint32				m_next;				// Where the next reading goes
+		uint32				m_count;			// Readings held, up to the depth
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueHistory_H
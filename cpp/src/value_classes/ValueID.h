@@ -59,6 +59,7 @@ namespace OpenZWave
 		friend class CommandClass;
 		friend class Value;
 		friend class ValueStore;
+		friend class ValueHandle;
 		friend class Notification;
 		friend class ManufacturerSpecific;
 
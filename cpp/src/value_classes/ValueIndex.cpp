@@ -0,0 +1,425 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueIndex.cpp
+//
+//	An index of a network's values, to find them by their properties
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <algorithm>
+
+#include "value_classes/ValueIndex.h"
+#include "value_classes/Value.h"
+#include "Utils.h"
+#include "platform/Mutex.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::CompareEntry>
+// Order an index entry against a ValueID
+//-----------------------------------------------------------------------------
+bool ValueIndex::CompareEntry
+(
+	ValueIndex::Entry const& _entry,
+	ValueID const& _id
+)
+{
+	return( _entry.m_id < _id );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Query::Query>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueIndex::Query::Query
+(
+):
+	m_commandClassId( 0 ),
+	m_genre( ValueID::ValueGenre_Count ),
+	m_instance( 0 )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::ValueIndex>
+// Constructor
+//-----------------------------------------------------------------------------
+ValueIndex::ValueIndex
+(
+):
+	m_mutex( new Mutex() )
+{
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::~ValueIndex>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueIndex::~ValueIndex
+(
+)
+{
+	m_mutex->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::HashLabel>
+// FNV-1a hash of a label
+//-----------------------------------------------------------------------------
+uint32 ValueIndex::HashLabel
+(
+	string const& _label
+)
+{
+	uint32 hash = 2166136261u;
+	for( string::const_iterator it = _label.begin(); it != _label.end(); ++it )
+	{
+		hash = ( hash ^ (uint8)*it ) * 16777619u;
+	}
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Insert>
+// Add an ID to a sorted list
+//-----------------------------------------------------------------------------
+void ValueIndex::Insert
+(
+	List& _list,
+	ValueID const& _id
+)
+{
+	// Values are mostly added in order, so most of them go on the end
+	if( _list.empty() || ( _list.back() < _id ) )
+	{
+		_list.push_back( _id );
+	}
+	else
+	{
+		_list.insert( lower_bound( _list.begin(), _list.end(), _id ), _id );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Erase>
+// Remove an ID from one of a map of sorted lists, and the list if it is left empty
+//-----------------------------------------------------------------------------
+void ValueIndex::Erase
+(
+	map<uint8,List>& _lists,
+	uint8 const _key,
+	ValueID const& _id
+)
+{
+	map<uint8,List>::iterator lit = _lists.find( _key );
+	if( lit != _lists.end() )
+	{
+		List::iterator it = lower_bound( lit->second.begin(), lit->second.end(), _id );
+		if( ( it != lit->second.end() ) && ( *it == _id ) )
+		{
+			lit->second.erase( it );
+		}
+		if( lit->second.empty() )
+		{
+			_lists.erase( lit );
+		}
+	}
+}
+
+void ValueIndex::Erase
+(
+	map<uint32,List>& _lists,
+	uint32 const _key,
+	ValueID const& _id
+)
+{
+	map<uint32,List>::iterator lit = _lists.find( _key );
+	if( lit != _lists.end() )
+	{
+		List::iterator it = lower_bound( lit->second.begin(), lit->second.end(), _id );
+		if( ( it != lit->second.end() ) && ( *it == _id ) )
+		{
+			lit->second.erase( it );
+		}
+		if( lit->second.empty() )
+		{
+			_lists.erase( lit );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::FindEntry>
+// Binary search for the entry of a value
+//-----------------------------------------------------------------------------
+vector<ValueIndex::Entry>::const_iterator ValueIndex::FindEntry
+(
+	ValueID const& _id
+)const
+{
+	vector<Entry>::const_iterator it = lower_bound( m_entries.begin(), m_entries.end(), _id, CompareEntry );
+	if( ( it != m_entries.end() ) && ( it->m_id == _id ) )
+	{
+		return it;
+	}
+	return m_entries.end();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Add>
+// Index a value that has been added to its node
+//-----------------------------------------------------------------------------
+void ValueIndex::Add
+(
+	Value* _value
+)
+{
+	ValueID const& id = _value->GetID();
+
+	LockGuard LG( m_mutex );
+	vector<Entry>::iterator it = lower_bound( m_entries.begin(), m_entries.end(), id, CompareEntry );
+	if( ( it != m_entries.end() ) && ( it->m_id == id ) )
+	{
+		return;
+	}
+
+	SharedString const& label = _value->m_label;
+	m_entries.insert( it, Entry( id, label ) );
+	_value->m_index = this;
+
+	Insert( m_all, id );
+	Insert( m_byCommandClass[id.GetCommandClassId()], id );
+	Insert( m_byGenre[id.GetGenre()], id );
+	Insert( m_byLabel[HashLabel( label )], id );
+	Insert( m_byInstance[id.GetInstance()], id );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Remove>
+// Stop indexing a value that has been removed from its node
+//-----------------------------------------------------------------------------
+void ValueIndex::Remove
+(
+	Value* _value
+)
+{
+	ValueID const& _id = _value->GetID();
+
+	LockGuard LG( m_mutex );
+	_value->m_index = NULL;
+	vector<Entry>::iterator it = lower_bound( m_entries.begin(), m_entries.end(), _id, CompareEntry );
+	if( ( it == m_entries.end() ) || ( it->m_id != _id ) )
+	{
+		return;
+	}
+
+	Erase( m_byLabel, HashLabel( it->m_label ), _id );
+	m_entries.erase( it );
+
+	m_all.erase( lower_bound( m_all.begin(), m_all.end(), _id ) );
+	Erase( m_byCommandClass, _id.GetCommandClassId(), _id );
+	List& genre = m_byGenre[_id.GetGenre()];
+	List::iterator git = lower_bound( genre.begin(), genre.end(), _id );
+	if( ( git != genre.end() ) && ( *git == _id ) )
+	{
+		genre.erase( git );
+	}
+	Erase( m_byInstance, _id.GetInstance(), _id );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Relabel>
+// Index a value under its new label
+//-----------------------------------------------------------------------------
+void ValueIndex::Relabel
+(
+	ValueID const& _id,
+	SharedString const& _label
+)
+{
+	LockGuard LG( m_mutex );
+	vector<Entry>::iterator it = lower_bound( m_entries.begin(), m_entries.end(), _id, CompareEntry );
+	if( ( it == m_entries.end() ) || ( it->m_id != _id ) || ( it->m_label == _label ) )
+	{
+		return;
+	}
+
+	Erase( m_byLabel, HashLabel( it->m_label ), _id );
+	it->m_label = _label;
+	Insert( m_byLabel[HashLabel( _label )], _id );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::GetShortestList>
+// The shortest list the conditions of a query select
+//-----------------------------------------------------------------------------
+ValueIndex::List const* ValueIndex::GetShortestList
+(
+	Query const& _query
+)const
+{
+	List const* shortest = &m_all;
+
+	if( _query.m_commandClassId )
+	{
+		map<uint8,List>::const_iterator it = m_byCommandClass.find( _query.m_commandClassId );
+		if( it == m_byCommandClass.end() )
+		{
+			return NULL;
+		}
+		shortest = &it->second;
+	}
+
+	if( _query.m_genre < ValueID::ValueGenre_Count )
+	{
+		List const* list = &m_byGenre[_query.m_genre];
+		if( list->size() < shortest->size() )
+		{
+			shortest = list;
+		}
+	}
+
+	if( !_query.m_label.empty() )
+	{
+		map<uint32,List>::const_iterator it = m_byLabel.find( HashLabel( _query.m_label ) );
+		if( it == m_byLabel.end() )
+		{
+			return NULL;
+		}
+		if( it->second.size() < shortest->size() )
+		{
+			shortest = &it->second;
+		}
+	}
+
+	if( _query.m_instance )
+	{
+		map<uint8,List>::const_iterator it = m_byInstance.find( _query.m_instance );
+		if( it == m_byInstance.end() )
+		{
+			return NULL;
+		}
+		if( it->second.size() < shortest->size() )
+		{
+			shortest = &it->second;
+		}
+	}
+
+	return( shortest->empty() ? NULL : shortest );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Matches>
+// Whether a value meets all the conditions of a query, other than its node
+//-----------------------------------------------------------------------------
+bool ValueIndex::Matches
+(
+	Query const& _query,
+	ValueID const& _id
+)const
+{
+	if( _query.m_commandClassId && ( _id.GetCommandClassId() != _query.m_commandClassId ) )
+	{
+		return false;
+	}
+	if( ( _query.m_genre < ValueID::ValueGenre_Count ) && ( _id.GetGenre() != _query.m_genre ) )
+	{
+		return false;
+	}
+	if( _query.m_instance && ( _id.GetInstance() != _query.m_instance ) )
+	{
+		return false;
+	}
+	if( !_query.m_label.empty() )
+	{
+		// Labels that share a hash are told apart by their text
+		vector<Entry>::const_iterator it = FindEntry( _id );
+		if( ( it == m_entries.end() ) || !( _query.m_label == it->m_label ) )
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::Find>
+// Find the values that match a query
+//-----------------------------------------------------------------------------
+void ValueIndex::Find
+(
+	Query const& _query,
+	vector<ValueID>* o_values
+)const
+{
+	o_values->clear();
+
+	LockGuard LG( m_mutex );
+	List const* list = GetShortestList( _query );
+	if( !list )
+	{
+		return;
+	}
+
+	if( _query.m_nodeIds.empty() )
+	{
+		for( List::const_iterator it = list->begin(); it != list->end(); ++it )
+		{
+			if( Matches( _query, *it ) )
+			{
+				o_values->push_back( *it );
+			}
+		}
+		return;
+	}
+
+	// Visit the nodes in order, so the values are found in order
+	vector<uint8> nodeIds( _query.m_nodeIds );
+	sort( nodeIds.begin(), nodeIds.end() );
+	nodeIds.erase( unique( nodeIds.begin(), nodeIds.end() ), nodeIds.end() );
+
+	uint32 homeId = list->front().GetHomeId();
+	List::const_iterator it = list->begin();
+	for( vector<uint8>::const_iterator nit = nodeIds.begin(); nit != nodeIds.end(); ++nit )
+	{
+		// A node's values sort after the ID with only the node set
+		it = lower_bound( it, list->end(), ValueID( homeId, ( (uint64)*nit ) << 24 ) );
+		for( ; ( it != list->end() ) && ( it->GetNodeId() == *nit ); ++it )
+		{
+			if( Matches( _query, *it ) )
+			{
+				o_values->push_back( *it );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <ValueIndex::GetSize>
+// The number of values indexed
+//-----------------------------------------------------------------------------
+uint32 ValueIndex::GetSize
+(
+)const
+{
+	LockGuard LG( m_mutex );
+	return (uint32)m_entries.size();
+}
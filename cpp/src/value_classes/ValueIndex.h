@@ -0,0 +1,136 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueIndex.h
+//
+//	An index of a network's values, to find them by their properties
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueIndex_H
+#define _ValueIndex_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include "Defs.h"
+#include "SharedString.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Value;
+	class Mutex;
+
+	/** \brief The values of a network, indexed by command class, genre, label and instance.
+	 *
+	 * Each driver keeps its values in an index as they are added to and removed from
+	 * their nodes, so Manager::FindValues can answer a query such as "the user values
+	 * of SensorMultilevel on these nodes" without visiting every value of every node.
+	 *
+	 * The values are held in sorted lists of ValueIDs: one of every value, and one for
+	 * each command class, genre, label and instance that has values.  A ValueID sorts by
+	 * its node first, so the values of a node are next to each other in each list.  A
+	 * query walks the shortest of the lists that its conditions select, and only the
+	 * nodes it asks for, checking the rest of the conditions as it goes.
+	 */
+	class OPENZWAVE_EXPORT ValueIndex
+	{
+	public:
+		/** \brief What the values to find must have.  A condition left at its default matches any value. */
+		struct OPENZWAVE_EXPORT Query
+		{
+			Query();
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+			vector<uint8>			m_nodeIds;				// The nodes to look at, or empty for every node
+			string					m_label;				// The label, or empty for any
+OPENZWAVE_EXPORT_WARNINGS_ON
+			uint8					m_commandClassId;		// The command class, or zero for any
+			ValueID::ValueGenre		m_genre;				// The genre, or ValueGenre_Count for any
+			uint8					m_instance;				// The instance, or zero for any
+		};
+
+		ValueIndex();
+		~ValueIndex();
+
+		/**
+		 * Index a value that has been added to its node.
+		 */
+		void Add( Value* _value );
+
+		/**
+		 * Stop indexing a value that has been removed from its node.
+		 */
+		void Remove( Value* _value );
+
+		/**
+		 * Index a value under its new label.  Called by Value::SetLabel.
+		 */
+		void Relabel( ValueID const& _id, SharedString const& _label );
+
+		/**
+		 * Find the values that match a query.
+		 * \param o_values cleared, then filled with the values found, in ValueID order.
+		 */
+		void Find( Query const& _query, vector<ValueID>* o_values )const;
+
+		/**
+		 * \return the number of values indexed.
+		 */
+		uint32 GetSize()const;
+
+	private:
+		/** A value, and the label it is indexed under */
+		struct Entry
+		{
+			Entry( ValueID const& _id, SharedString const& _label ): m_id( _id ), m_label( _label ){}
+
+			ValueID			m_id;
+			SharedString	m_label;
+		};
+
+		typedef vector<ValueID> List;
+
+		ValueIndex( ValueIndex const& );					// prevent copy
+		ValueIndex& operator = ( ValueIndex const& );		// prevent assignment
+
+		static bool CompareEntry( Entry const& _entry, ValueID const& _id );
+		static uint32 HashLabel( string const& _label );
+		static void Insert( List& _list, ValueID const& _id );
+		static void Erase( map<uint8,List>& _lists, uint8 const _key, ValueID const& _id );
+		static void Erase( map<uint32,List>& _lists, uint32 const _key, ValueID const& _id );
+		vector<Entry>::const_iterator FindEntry( ValueID const& _id )const;
+		List const* GetShortestList( Query const& _query )const;			// The shortest list the query's conditions select, or NULL if one of them selects nothing
+		bool Matches( Query const& _query, ValueID const& _id )const;
+
+		Mutex*				m_mutex;						// Values come and go on the driver thread, while queries come from the application
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<Entry>		m_entries;						// Every value, in ValueID order
+		List				m_all;							// The IDs of m_entries, so it can be walked like the other lists
+		map<uint8,List>		m_byCommandClass;
+		List				m_byGenre[ValueID::ValueGenre_Count];
+		map<uint32,List>	m_byLabel;						// By the hash of the label
+		map<uint8,List>		m_byInstance;
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueIndex_H
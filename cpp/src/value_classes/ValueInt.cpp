@@ -61,6 +61,7 @@ ValueInt::ValueInt
 	m_valueCheck( 0 ),
 	m_newValue( 0 )
 {
+	PublishSnapshot( (uint32)m_value );
 	m_min = INT_MIN;
 	m_max = INT_MAX;
 }
@@ -118,6 +119,7 @@ void ValueInt::ReadXML
 	if( TIXML_SUCCESS == _valueElement->QueryIntAttribute( "value", &intVal ) )
 	{
 		m_value = (int32)intVal;
+		PublishSnapshot( (uint32)m_value );
 	}
 	else
 	{
@@ -157,12 +159,46 @@ bool ValueInt::Set
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueInt::SwapValue>
+// Exchange values with another int value
+//-----------------------------------------------------------------------------
+bool ValueInt::SwapValue
+(
+	Value* _other
+)
+{
+	ValueInt* other = static_cast<ValueInt*>( _other );
+	int32 value = m_value;
+	m_value = other->m_value;
+	other->m_value = value;
+	PublishSnapshot( (uint32)m_value );
+	other->PublishSnapshot( (uint32)other->m_value );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueInt::GetExportValue>
+// The value as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueInt::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_value;
+	*o_real = (double)*o_integer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueInt::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -181,6 +217,7 @@ void ValueInt::OnValueRefreshed
 		break;
 	case 2:		// value has changed (confirmed), save _value in m_value
 		m_value = _value;
+		PublishSnapshot( (uint32)m_value );
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
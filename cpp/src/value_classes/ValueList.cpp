@@ -30,10 +30,153 @@
 #include "Msg.h"
 #include "platform/Log.h"
 #include "Manager.h"
+#include "Utils.h"
+#include "platform/Atomic.h"
+#include <algorithm>
+#include <set>
 #include <ctime>
 
 using namespace OpenZWave;
 
+namespace
+{
+	// Shorter lists are searched item by item, which is as quick as an index
+	uint32 const c_minIndexedItems = 8;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueList::ItemIndex>
+// The items of a list, sorted by label and by value.  Lists made from the same
+// device configuration have the same items, and share one index from a process
+// wide pool, in the way SharedString shares the label texts.
+//-----------------------------------------------------------------------------
+struct ValueList::ItemIndex
+{
+	// Orders indices by the item labels, ties by position, so the first match is found
+	struct LabelLess
+	{
+		LabelLess( vector<Item> const& _items ): m_items( _items ){}
+		bool operator()( int32 _a, int32 _b )const
+		{
+			int cmp = m_items[_a].m_label.str().compare( m_items[_b].m_label.str() );
+			return( cmp < 0 || ( cmp == 0 && _a < _b ) );
+		}
+		bool operator()( int32 _a, string const& _b )const{ return m_items[_a].m_label.str() < _b; }
+		bool operator()( string const& _a, int32 _b )const{ return _a < m_items[_b].m_label.str(); }
+		vector<Item> const& m_items;
+	};
+
+	// Orders indices in the pool by their items.  Equal labels share a pooled text,
+	// so comparing the texts' addresses is enough to tell lists apart.
+	struct PoolLess
+	{
+		bool operator()( ItemIndex const* _a, ItemIndex const* _b )const
+		{
+			vector<Item> const& a = _a->m_items;
+			vector<Item> const& b = _b->m_items;
+			if( a.size() != b.size() )
+			{
+				return a.size() < b.size();
+			}
+			for( size_t i = 0; i < a.size(); ++i )
+			{
+				if( a[i].m_label.c_str() != b[i].m_label.c_str() )
+				{
+					return a[i].m_label.c_str() < b[i].m_label.c_str();
+				}
+				if( a[i].m_value != b[i].m_value )
+				{
+					return a[i].m_value < b[i].m_value;
+				}
+			}
+			return false;
+		}
+	};
+
+	static ItemIndex* Attach( ItemIndex* volatile* _slot, vector<Item> const& _items );
+	static void Release( ItemIndex* _index );
+
+	vector<Item>				m_items;
+	vector<int32>				m_byLabel;		// Item positions, sorted by label
+	vector< pair<int32,int32> >	m_byValue;		// Item values and positions, sorted
+	uint32						m_refs;			// Lists using the index.  Changed with s_poolMutex locked.
+
+	// As with SharedString, neither is ever destroyed
+	static Mutex*						s_poolMutex;
+	static set<ItemIndex*,PoolLess>*	s_pool;
+};
+
+Mutex* ValueList::ItemIndex::s_poolMutex = new Mutex( false );
+set<ValueList::ItemIndex*,ValueList::ItemIndex::PoolLess>* ValueList::ItemIndex::s_pool = new set<ValueList::ItemIndex*,ValueList::ItemIndex::PoolLess>();
+
+//-----------------------------------------------------------------------------
+// <ValueList::ItemIndex::Attach>
+// Fill a list's empty slot with the pool's index for its items, building the
+// index if there is none.  A slot already filled by another thread is kept.
+//-----------------------------------------------------------------------------
+ValueList::ItemIndex* ValueList::ItemIndex::Attach
+(
+	ItemIndex* volatile* _slot,
+	vector<Item> const& _items
+)
+{
+	LockGuard LG( s_poolMutex );
+	if( ItemIndex* index = *_slot )
+	{
+		return index;
+	}
+
+	ItemIndex* index = new ItemIndex();
+	index->m_items = _items;
+	set<ItemIndex*,PoolLess>::iterator it = s_pool->find( index );
+	if( it != s_pool->end() )
+	{
+		delete index;
+		index = *it;
+	}
+	else
+	{
+		int32 numItems = (int32)_items.size();
+		index->m_byLabel.reserve( numItems );
+		index->m_byValue.reserve( numItems );
+		for( int32 i = 0; i < numItems; ++i )
+		{
+			index->m_byLabel.push_back( i );
+			index->m_byValue.push_back( pair<int32,int32>( _items[i].m_value, i ) );
+		}
+		sort( index->m_byLabel.begin(), index->m_byLabel.end(), LabelLess( index->m_items ) );
+		sort( index->m_byValue.begin(), index->m_byValue.end() );
+		index->m_refs = 0;
+		s_pool->insert( index );
+	}
+
+	++index->m_refs;
+	AtomicStorePtr( _slot, index );
+	return index;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueList::ItemIndex::Release>
+// Let go of an index, removing it from the pool if it was the last list using it
+//-----------------------------------------------------------------------------
+void ValueList::ItemIndex::Release
+(
+	ItemIndex* _index
+)
+{
+	if( _index == NULL )
+	{
+		return;
+	}
+
+	LockGuard LG( s_poolMutex );
+	if( --_index->m_refs == 0 )
+	{
+		s_pool->erase( _index );
+		delete _index;
+	}
+}
+
 
 //-----------------------------------------------------------------------------
 // <ValueList::ValueList>
@@ -58,6 +201,7 @@ ValueList::ValueList
 ):
 	Value( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, ValueID::ValueType_List, _label, _units, _readOnly, _writeOnly, false, _pollIntensity ),
 	m_items( _items ),
+	m_index( NULL ),
 	m_valueIdx( _valueIdx ),
 	m_valueIdxCheck( 0 ),
 	m_newValueIdx( 0 ),
@@ -74,6 +218,7 @@ ValueList::ValueList
 ):
 	Value(),
 	m_items( ),
+	m_index( NULL ),
 	m_valueIdx(),
 	m_valueIdxCheck( 0 ),
 	m_newValueIdx( 0 ),
@@ -81,6 +226,55 @@ ValueList::ValueList
 {
 }
 
+//-----------------------------------------------------------------------------
+// <ValueList::ValueList>
+// Copy constructor
+//-----------------------------------------------------------------------------
+ValueList::ValueList
+(
+	ValueList const& _other
+):
+	Value( _other ),
+	m_items( _other.m_items ),
+	m_index( NULL ),
+	m_valueIdx( _other.m_valueIdx ),
+	m_valueIdxCheck( _other.m_valueIdxCheck ),
+	m_newValueIdx( _other.m_newValueIdx ),
+	m_size( _other.m_size )
+{
+	// The copy finds the same index in the pool if it needs one
+}
+
+//-----------------------------------------------------------------------------
+// <ValueList::~ValueList>
+// Destructor
+//-----------------------------------------------------------------------------
+ValueList::~ValueList
+(
+)
+{
+	ItemIndex::Release( m_index );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueList::GetIndex>
+// The index of the items, or NULL if the list is short enough to search
+//-----------------------------------------------------------------------------
+ValueList::ItemIndex const* ValueList::GetIndex
+(
+)const
+{
+	if( m_items.size() < c_minIndexedItems )
+	{
+		return NULL;
+	}
+	if( ItemIndex* index = AtomicLoadPtr( &m_index ) )
+	{
+		return index;
+	}
+	return ItemIndex::Attach( &m_index, m_items );
+}
+
 //-----------------------------------------------------------------------------
 // <ValueList::ReadXML>
 // Apply settings from XML
@@ -113,7 +307,9 @@ void ValueList::ReadXML
 		Log::Write( LogLevel_Info, "Value list size is not set, assuming 4 bytes for node %d, class 0x%02x, instance %d, index %d", _nodeId, _commandClassId, GetID().GetInstance(), GetID().GetIndex() );
 	}
 
-	// Read the items
+	// Read the items, which any index no longer matches
+	ItemIndex::Release( m_index );
+	m_index = NULL;
 	m_items.clear();
 	TiXmlElement const* itemElement = _valueElement->FirstChildElement();
 	while( itemElement )
@@ -182,6 +378,7 @@ void ValueList::ReadXML
 	{
 		Log::Write( LogLevel_Info, "Missing default list value or vindex from xml configuration: node %d, class 0x%02x, instance %d, index %d", _nodeId,  _commandClassId, GetID().GetInstance(), GetID().GetIndex() );
 	}
+	Export();
 }
 
 //-----------------------------------------------------------------------------
@@ -230,12 +427,50 @@ bool ValueList::SetByValue
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueList::SwapValue>
+// Exchange the selected items with another list value
+//-----------------------------------------------------------------------------
+bool ValueList::SwapValue
+(
+	Value* _other
+)
+{
+	ValueList* other = static_cast<ValueList*>( _other );
+	int32 valueIdx = m_valueIdx;
+	m_valueIdx = other->m_valueIdx;
+	other->m_valueIdx = valueIdx;
+	Export();
+	other->Export();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueList::GetExportValue>
+// The value of the selected item, as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueList::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	if( m_valueIdx < 0 || m_valueIdx >= (int32)m_items.size() )
+	{
+		return false;
+	}
+	*o_integer = m_items[m_valueIdx].m_value;
+	*o_real = (double)*o_integer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueList::SetByLabel>
 // Set a new value in the device, selected by item label
@@ -286,6 +521,8 @@ void ValueList::OnValueRefreshed
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
 	}
+	// Even if unchanged, the time it was read has moved on
+	Export();
 }
 
 //-----------------------------------------------------------------------------
@@ -297,6 +534,13 @@ int32 ValueList::GetItemIdxByLabel
 	string const& _label
 ) const
 {
+	if( ItemIndex const* index = GetIndex() )
+	{
+		ItemIndex::LabelLess less( index->m_items );
+		vector<int32>::const_iterator it = lower_bound( index->m_byLabel.begin(), index->m_byLabel.end(), _label, less );
+		return( ( it != index->m_byLabel.end() && _label == m_items[*it].m_label ) ? *it : -1 );
+	}
+
 	for( int32 i=0; i<(int32)m_items.size(); ++i )
 	{
 		if( _label == m_items[i].m_label )
@@ -317,6 +561,13 @@ int32 ValueList::GetItemIdxByValue
 	int32 const _value
 ) const
 {
+	if( ItemIndex const* index = GetIndex() )
+	{
+		// Positions are never negative, so this finds the first item with the value
+		vector< pair<int32,int32> >::const_iterator it = lower_bound( index->m_byValue.begin(), index->m_byValue.end(), pair<int32,int32>( _value, -1 ) );
+		return( ( it != index->m_byValue.end() && it->first == _value ) ? it->second : -1 );
+	}
+
 	for( int32 i=0; i<(int32)m_items.size(); ++i )
 	{
 		if( _value == m_items[i].m_value )
@@ -350,6 +601,28 @@ bool ValueList::GetItemLabels
 	return false;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueList::GetItemLabels>
+// Fill a vector with the item labels, sharing their text
+//-----------------------------------------------------------------------------
+bool ValueList::GetItemLabels
+(
+	vector<SharedString>* o_items
+)
+{
+	if( o_items )
+	{
+		for( vector<Item>::iterator it = m_items.begin(); it != m_items.end(); ++it )
+		{
+			o_items->push_back( (*it).m_label );
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueList::GetItemValues>
 // Fill a vector with the item values
@@ -49,13 +49,14 @@ namespace OpenZWave
 		*/
 		struct Item
 		{
-			string	m_label;
-			int32	m_value;
+			SharedString	m_label;
+			int32			m_value;
 		};
 
 		ValueList( uint32 const _homeId, uint8 const _nodeId, ValueID::ValueGenre const _genre, uint8 const _commandClassId, uint8 const _instance, uint8 const _index, string const& _label, string const& _units, bool const _readOnly, bool const _writeOnly, vector<Item> const& _items, int32 const _valueIdx, uint8 const _pollIntensity, uint8 const _size = 4 );
 		ValueList();
-		virtual ~ValueList(){}
+		ValueList( ValueList const& _other );
+		virtual ~ValueList();
 
 		bool SetByLabel( string const& _label );
 		bool SetByValue( int32 const _value );
@@ -64,6 +65,7 @@ namespace OpenZWave
 
 		// From Value
 		virtual string const GetAsString() const { return GetItem()->m_label; }
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueList) - sizeof(Value) + (uint32)( m_items.capacity() * sizeof(Item) ); }
 		virtual bool SetFromString( string const& _value ) { return SetByLabel( _value ); }
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
@@ -74,12 +76,23 @@ namespace OpenZWave
 		int32 GetItemIdxByValue( int32 const _value ) const;
 
 		bool GetItemLabels( vector<string>* o_items );
+		bool GetItemLabels( vector<SharedString>* o_items );
 		bool GetItemValues( vector<int32>* o_values );
 
 		uint8 GetSize()const{ return m_size; }
 
 	private:
+		ValueList& operator = ( ValueList const& );			// prevent assignment
+
+		/** Lookups of items by label and by value, shared by the lists with the same items. */
+		struct ItemIndex;
+
+		virtual bool SwapValue( Value* _other );
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const;
+		ItemIndex const* GetIndex()const;
+
 		vector<Item>	m_items;
+		mutable ItemIndex* volatile	m_index;		// Built on the first lookup in a long list, NULL until then
 		int32			m_valueIdx;					// the current index in the m_items vector
 		int32			m_valueIdxCheck;			// the previous index in the m_items vector (used for double-checking spurious value reads)
 		int32			m_newValueIdx;				// a new value to be set on the appropriate device
@@ -53,6 +53,7 @@ namespace OpenZWave
 
 		// From Value
 		virtual string const GetAsString() const;
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueRaw) - sizeof(Value) + 2 * m_valueLength; }
 		virtual bool SetFromString( string const& _value );
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
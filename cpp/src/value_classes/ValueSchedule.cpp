@@ -53,8 +53,9 @@ ValueSchedule::ValueSchedule
 	uint8 const _pollIntensity
 ):
 	Value( _homeId, _nodeId, _genre, _commandClassId, _instance, _index, ValueID::ValueType_Schedule, _label, _units, _readOnly, _writeOnly, false, _pollIntensity ),
-	m_numSwitchPoints( 0 )
-
+	m_numSwitchPoints( 0 ),
+	m_numDeviceSwitchPoints( 0 ),
+	m_deviceKnown( false )
 {
 }
 
@@ -66,8 +67,9 @@ ValueSchedule::ValueSchedule
 (
 ):
 	Value(),
-	m_numSwitchPoints( 0 )
-
+	m_numSwitchPoints( 0 ),
+	m_numDeviceSwitchPoints( 0 ),
+	m_deviceKnown( false )
 {
 }
 
@@ -85,7 +87,23 @@ void ValueSchedule::ReadXML
 {
 	Value::ReadXML( _homeId, _nodeId, _commandClassId, _valueElement );
 
-	// Read in the switch points
+	// The switch points are saved in one attribute, as "hh:mm/setback" separated by spaces
+	char const* attr = _valueElement->Attribute( "switchpoints" );
+	if( attr )
+	{
+		int hours;
+		int minutes;
+		int setback;
+		int used;
+		while( sscanf( attr, " %d:%d/%d%n", &hours, &minutes, &setback, &used ) == 3 )
+		{
+			SetSwitchPoint( (uint8)hours, (uint8)minutes, (int8)setback );
+			attr += used;
+		}
+		return;
+	}
+
+	// Older files have an element for each switch point
 	TiXmlElement const* child = _valueElement->FirstChildElement();
 	while( child )
 	{
@@ -133,28 +151,15 @@ void ValueSchedule::WriteXML
 {
 	Value::WriteXML( _valueElement );
 
+	// One attribute rather than an element per switch point keeps the file small
+	string switchPoints;
 	for( uint8 i=0; i<GetNumSwitchPoints(); ++i )
 	{
-		uint8 hours;
-		uint8 minutes;
-		int8 setback;
-		if( GetSwitchPoint( i, &hours, &minutes, &setback ) )
-		{
-			char str[8];
-
-			TiXmlElement* switchPointElement = new TiXmlElement( "SwitchPoint" );
-			_valueElement->LinkEndChild( switchPointElement );
-
-			snprintf( str, sizeof(str), "%d", hours );
-			switchPointElement->SetAttribute( "hours", str );
-
-			snprintf( str, sizeof(str), "%d", minutes );
-			switchPointElement->SetAttribute( "minutes", str );
-
-			snprintf( str, sizeof(str), "%d", setback );
-			switchPointElement->SetAttribute( "setback", str );
-		}
+		char str[16];
+		snprintf( str, sizeof(str), "%s%d:%02d/%d", i ? " " : "", m_switchPoints[i].m_hours, m_switchPoints[i].m_minutes, m_switchPoints[i].m_setback );
+		switchPoints += str;
 	}
+	_valueElement->SetAttribute( "switchpoints", switchPoints.c_str() );
 }
 
 //-----------------------------------------------------------------------------
@@ -165,9 +170,56 @@ bool ValueSchedule::Set
 (
 )
 {
-	// Set the value in the device.
-	// TODO this needs to be checked to make sure it works as intended
-	return Value::Set();
+	// Only send the schedule if it differs from what the device holds
+	if( IsInDevice() )
+	{
+		Log::Write( LogLevel_Info, GetID().GetNodeId(), "Schedule for day %d is unchanged, not sent", GetID().GetIndex() );
+		return true;
+	}
+
+	bool res = Value::Set();
+	if( res )
+	{
+		SetInDevice();
+	}
+	return res;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSchedule::SetInDevice>
+// Note that the device holds the current switch points
+//-----------------------------------------------------------------------------
+void ValueSchedule::SetInDevice
+(
+)
+{
+	memcpy( m_deviceSwitchPoints, m_switchPoints, sizeof(m_switchPoints) );
+	m_numDeviceSwitchPoints = m_numSwitchPoints;
+	m_deviceKnown = true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSchedule::IsInDevice>
+// Compare the switch points with what the device was last known to hold
+//-----------------------------------------------------------------------------
+bool ValueSchedule::IsInDevice
+(
+)const
+{
+	if( !m_deviceKnown || ( m_numDeviceSwitchPoints != m_numSwitchPoints ) )
+	{
+		return false;
+	}
+	for( uint8 i=0; i<m_numSwitchPoints; ++i )
+	{
+		if( ( m_switchPoints[i].m_hours != m_deviceSwitchPoints[i].m_hours )
+			|| ( m_switchPoints[i].m_minutes != m_deviceSwitchPoints[i].m_minutes )
+			|| ( m_switchPoints[i].m_setback != m_deviceSwitchPoints[i].m_setback ) )
+		{
+			return false;
+		}
+	}
+	return true;
 }
 
 //-----------------------------------------------------------------------------
@@ -55,10 +55,14 @@ namespace OpenZWave
 		bool FindSwitchPoint( uint8 const _hours, uint8 const _minutes, uint8* o_idx )const;
 		uint8 GetNumSwitchPoints()const{ return m_numSwitchPoints; }
 
-		bool Set();
+		bool Set();							// Sends the schedule, unless the device already holds it
 		void OnValueRefreshed();
 
+		void SetInDevice();					// Note that the device holds the current switch points
+		bool IsInDevice()const;				// True if the switch points are the ones the device was last known to hold
+
 		virtual string const GetAsString() const;
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueSchedule) - sizeof(Value); }
 
 		// From Value
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
@@ -74,6 +78,10 @@ namespace OpenZWave
 
 		SwitchPoint		m_switchPoints[9];
 		uint8			m_numSwitchPoints;
+
+		SwitchPoint		m_deviceSwitchPoints[9];	// As last reported by, or sent to, the device
+		uint8			m_numDeviceSwitchPoints;
+		bool			m_deviceKnown;
 	};
 
 } // namespace OpenZWave
@@ -61,6 +61,7 @@ ValueShort::ValueShort
 	m_valueCheck( 0 ),
 	m_newValue( 0 )
 {
+	PublishSnapshot( (uint32)m_value );
 	m_min = SHRT_MIN;
 	m_max = SHRT_MAX;
 }
@@ -121,6 +122,7 @@ void ValueShort::ReadXML
 	if( TIXML_SUCCESS == _valueElement->QueryIntAttribute( "value", &intVal ) )
 	{
 		m_value = (int16)intVal;
+		PublishSnapshot( (uint32)m_value );
 	}
 	else
 	{
@@ -160,12 +162,46 @@ bool ValueShort::Set
 	// Set the value in the device.
 	bool ret = ((Value*)tempValue)->Set();
 
-	// clean up the temporary value
-	delete tempValue;
+	// clean up the temporary value, unless an optimistic set has kept it to roll back to
+	tempValue->Release();
 
 	return ret;
 }
 
+//-----------------------------------------------------------------------------
+// <ValueShort::SwapValue>
+// Exchange values with another short value
+//-----------------------------------------------------------------------------
+bool ValueShort::SwapValue
+(
+	Value* _other
+)
+{
+	ValueShort* other = static_cast<ValueShort*>( _other );
+	int16 value = m_value;
+	m_value = other->m_value;
+	other->m_value = value;
+	PublishSnapshot( (uint32)m_value );
+	other->PublishSnapshot( (uint32)other->m_value );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueShort::GetExportValue>
+// The value as the shared value table holds it
+//-----------------------------------------------------------------------------
+bool ValueShort::GetExportValue
+(
+	int64* o_integer,
+	double* o_real,
+	uint8* o_precision
+)const
+{
+	*o_integer = m_value;
+	*o_real = (double)*o_integer;
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // <ValueShort::OnValueRefreshed>
 // A value in a device has been refreshed
@@ -184,6 +220,7 @@ void ValueShort::OnValueRefreshed
 		break;
 	case 2:		// value has changed (confirmed), save _value in m_value
 		m_value = _value;
+		PublishSnapshot( (uint32)m_value );
 		break;
 	case 3:		// all three values are different, so wait for next refresh to try again
 		break;
@@ -53,6 +53,7 @@ namespace OpenZWave
 
 		// From Value
 		virtual string const GetAsString() const;
+		virtual uint32 GetMemoryUsage()const{ return Value::GetMemoryUsage() + sizeof(ValueShort) - sizeof(Value); }
 		virtual bool SetFromString( string const& _value );
 		virtual void ReadXML( uint32 const _homeId, uint8 const _nodeId, uint8 const _commandClassId, TiXmlElement const* _valueElement );
 		virtual void WriteXML( TiXmlElement* _valueElement );
@@ -60,6 +61,9 @@ namespace OpenZWave
 		int16 GetValue()const{ return m_value; }
 
 	private:
+		virtual bool SwapValue( Value* _other );
+		virtual bool GetExportValue( int64* o_integer, double* o_real, uint8* o_precision )const;
+
 		int16	m_value;				// the current value
 		int16	m_valueCheck;			// the previous value (used for double-checking spurious value reads)
 		int16	m_newValue;				// a new value to be set on the appropriate device
@@ -0,0 +1,294 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueSnapshot.cpp
+//
+//	A copy of many values, taken under a single lock
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "value_classes/ValueSnapshot.h"
+#include "value_classes/ValueBool.h"
+#include "value_classes/ValueButton.h"
+#include "value_classes/ValueByte.h"
+#include "value_classes/ValueInt.h"
+#include "value_classes/ValueList.h"
+#include "value_classes/ValueShort.h"
+
+using namespace OpenZWave;
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::Clear>
+// Remove all the values
+//-----------------------------------------------------------------------------
+void ValueSnapshot::Clear
+(
+)
+{
+	m_entries.clear();
+	m_text.clear();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::Add>
+// Copy a value onto the end of the snapshot
+//-----------------------------------------------------------------------------
+void ValueSnapshot::Add
+(
+	Value* _value
+)
+{
+	Entry entry( _value->GetID() );
+	switch( entry.m_id.GetType() )
+	{
+		case ValueID::ValueType_Bool:
+		{
+			entry.m_number = static_cast<ValueBool*>( _value )->GetValue() ? 1 : 0;
+			entry.m_hasNumber = true;
+			break;
+		}
+		case ValueID::ValueType_Button:
+		{
+			entry.m_number = static_cast<ValueButton*>( _value )->IsPressed() ? 1 : 0;
+			entry.m_hasNumber = true;
+			break;
+		}
+		case ValueID::ValueType_Byte:
+		{
+			entry.m_number = static_cast<ValueByte*>( _value )->GetValue();
+			entry.m_hasNumber = true;
+			break;
+		}
+		case ValueID::ValueType_Short:
+		{
+			entry.m_number = static_cast<ValueShort*>( _value )->GetValue();
+			entry.m_hasNumber = true;
+			break;
+		}
+		case ValueID::ValueType_Int:
+		{
+			entry.m_number = static_cast<ValueInt*>( _value )->GetValue();
+			entry.m_hasNumber = true;
+			break;
+		}
+		case ValueID::ValueType_List:
+		{
+			// A list may have nothing selected yet
+			if( ValueList::Item const* item = static_cast<ValueList*>( _value )->GetItem() )
+			{
+				entry.m_number = item->m_value;
+				entry.m_hasNumber = true;
+				AddText( &entry, item->m_label );
+			}
+			break;
+		}
+		case ValueID::ValueType_Decimal:
+		case ValueID::ValueType_String:
+		case ValueID::ValueType_Raw:
+		case ValueID::ValueType_Schedule:
+		{
+			AddText( &entry, _value->GetAsString() );
+			break;
+		}
+	}
+	m_entries.push_back( entry );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::AddText>
+// Append a value's text to the shared buffer
+//-----------------------------------------------------------------------------
+void ValueSnapshot::AddText
+(
+	Entry* _entry,
+	string const& _text
+)
+{
+	_entry->m_textOffset = (uint32)m_text.size();
+	_entry->m_textLength = (uint32)_text.size();
+	m_text.append( _text );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetNumber>
+// Get a value held as a number, if it is of the expected type
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetNumber
+(
+	uint32 const _index,
+	ValueID::ValueType const _type,
+	int32* o_value
+)const
+{
+	if( !o_value || _index >= m_entries.size() )
+	{
+		return false;
+	}
+
+	Entry const& entry = m_entries[_index];
+	if( entry.m_id.GetType() != _type || !entry.m_hasNumber )
+	{
+		return false;
+	}
+	*o_value = entry.m_number;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueAsBool>
+// Get the value of a bool or button
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueAsBool
+(
+	uint32 const _index,
+	bool* o_value
+)const
+{
+	int32 value;
+	if( GetNumber( _index, ValueID::ValueType_Bool, &value ) || GetNumber( _index, ValueID::ValueType_Button, &value ) )
+	{
+		*o_value = ( value != 0 );
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueAsByte>
+// Get the value of a byte
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueAsByte
+(
+	uint32 const _index,
+	uint8* o_value
+)const
+{
+	int32 value;
+	if( GetNumber( _index, ValueID::ValueType_Byte, &value ) )
+	{
+		*o_value = (uint8)value;
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueAsShort>
+// Get the value of a short
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueAsShort
+(
+	uint32 const _index,
+	int16* o_value
+)const
+{
+	int32 value;
+	if( GetNumber( _index, ValueID::ValueType_Short, &value ) )
+	{
+		*o_value = (int16)value;
+		return true;
+	}
+	return false;
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueAsInt>
+// Get the value of an int
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueAsInt
+(
+	uint32 const _index,
+	int32* o_value
+)const
+{
+	return GetNumber( _index, ValueID::ValueType_Int, o_value );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueListSelection>
+// Get the value of the selected item of a list
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueListSelection
+(
+	uint32 const _index,
+	int32* o_value
+)const
+{
+	return GetNumber( _index, ValueID::ValueType_List, o_value );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueSnapshot::GetValueAsString>
+// Get any value as a string
+//-----------------------------------------------------------------------------
+bool ValueSnapshot::GetValueAsString
+(
+	uint32 const _index,
+	string* o_value
+)const
+{
+	if( !o_value || _index >= m_entries.size() )
+	{
+		return false;
+	}
+
+	Entry const& entry = m_entries[_index];
+	char str[16];
+	switch( entry.m_id.GetType() )
+	{
+		case ValueID::ValueType_Bool:
+		case ValueID::ValueType_Button:
+		{
+			*o_value = entry.m_number ? "True" : "False";
+			return true;
+		}
+		case ValueID::ValueType_Byte:
+		{
+			snprintf( str, sizeof(str), "%u", (uint8)entry.m_number );
+			*o_value = str;
+			return true;
+		}
+		case ValueID::ValueType_Short:
+		case ValueID::ValueType_Int:
+		{
+			snprintf( str, sizeof(str), "%d", entry.m_number );
+			*o_value = str;
+			return true;
+		}
+		case ValueID::ValueType_List:
+		{
+			if( !entry.m_hasNumber )
+			{
+				return false;
+			}
+			o_value->assign( m_text, entry.m_textOffset, entry.m_textLength );
+			return true;
+		}
+		case ValueID::ValueType_Decimal:
+		case ValueID::ValueType_String:
+		case ValueID::ValueType_Raw:
+		case ValueID::ValueType_Schedule:
+		{
+			o_value->assign( m_text, entry.m_textOffset, entry.m_textLength );
+			return true;
+		}
+	}
+	return false;
+}
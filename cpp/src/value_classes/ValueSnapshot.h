@@ -0,0 +1,145 @@
+//-----------------------------------------------------------------------------
+//
+//	ValueSnapshot.h
+//
+//	A copy of many values, taken under a single lock
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#ifndef _ValueSnapshot_H
+#define _ValueSnapshot_H
+
+#include <string>
+#include <vector>
+#include "Defs.h"
+#include "value_classes/ValueID.h"
+
+namespace OpenZWave
+{
+	class Value;
+
+	/** \brief A copy of the values of a node, or of a whole network.
+	 *
+	 * Filled by Manager::GetNodeValues and Manager::SnapshotNetwork, which copy every value
+	 * while holding the node lock once.  Bool, byte, short, int, button and list values are
+	 * kept as numbers, and the text of decimal, string, list, raw and schedule values is packed
+	 * into one shared buffer, so the snapshot is a few contiguous allocations however many values
+	 * it holds.  A snapshot can be reused, which keeps those allocations from one refresh to the
+	 * next.
+	 *
+	 * The snapshot is not updated when the values change.  Values are read by their position,
+	 * from zero to GetCount()-1, and appear in node order, then in the order of their ValueIDs.
+	 */
+	class OPENZWAVE_EXPORT ValueSnapshot
+	{
+		friend class Manager;
+
+	public:
+		ValueSnapshot(){}
+
+		/**
+		 * Remove all the values, keeping the memory for reuse.
+		 */
+		void Clear();
+
+		/**
+		 * \return the number of values in the snapshot.
+		 */
+		uint32 GetCount()const{ return (uint32)m_entries.size(); }
+
+		/**
+		 * \param _index position of the value, from zero to GetCount()-1.
+		 * \return the ValueID of the value at that position.
+		 */
+		ValueID const& GetID( uint32 const _index )const{ return m_entries[_index].m_id; }
+
+		/**
+		 * Get the value of a bool or button.  For a button, the value is whether it was pressed.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value.
+		 * \return true if the value is a ValueID::ValueType_Bool or ValueID::ValueType_Button.
+		 */
+		bool GetValueAsBool( uint32 const _index, bool* o_value )const;
+
+		/**
+		 * Get the value of a byte.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value.
+		 * \return true if the value is a ValueID::ValueType_Byte.
+		 */
+		bool GetValueAsByte( uint32 const _index, uint8* o_value )const;
+
+		/**
+		 * Get the value of a short.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value.
+		 * \return true if the value is a ValueID::ValueType_Short.
+		 */
+		bool GetValueAsShort( uint32 const _index, int16* o_value )const;
+
+		/**
+		 * Get the value of an int.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value.
+		 * \return true if the value is a ValueID::ValueType_Int.
+		 */
+		bool GetValueAsInt( uint32 const _index, int32* o_value )const;
+
+		/**
+		 * Get the value of the selected item of a list.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value of the selected item.
+		 * \return true if the value is a ValueID::ValueType_List with an item selected.
+		 */
+		bool GetValueListSelection( uint32 const _index, int32* o_value )const;
+
+		/**
+		 * Get any value as a string, in the same form as Manager::GetValueAsString.
+		 * \param _index position of the value.
+		 * \param o_value filled with the value.
+		 * \return true if the value could be read.  Returns false for a list with no item selected.
+		 */
+		bool GetValueAsString( uint32 const _index, string* o_value )const;
+
+	private:
+		struct Entry
+		{
+			Entry( ValueID const& _id ): m_id( _id ), m_number( 0 ), m_textOffset( 0 ), m_textLength( 0 ), m_hasNumber( false ){}
+
+			ValueID		m_id;
+			int32		m_number;			// The value, for the types held as numbers
+			uint32		m_textOffset;		// Where the value's text starts in m_text
+			uint32		m_textLength;
+			bool		m_hasNumber;		// False for a list with no selection
+		};
+
+		void Add( Value* _value );			// Copy a value onto the end of the snapshot
+		void AddText( Entry* _entry, string const& _text );
+		bool GetNumber( uint32 const _index, ValueID::ValueType const _type, int32* o_value )const;
+
+OPENZWAVE_EXPORT_WARNINGS_OFF
+		vector<Entry>	m_entries;
+		string			m_text;				// The text of all the values, back to back
+OPENZWAVE_EXPORT_WARNINGS_ON
+	};
+
+} // namespace OpenZWave
+
+#endif //_ValueSnapshot_H
@@ -25,14 +25,33 @@
 //
 //-----------------------------------------------------------------------------
 
+#include <algorithm>
+
 #include "value_classes/ValueStore.h"
 #include "value_classes/Value.h"
+#include "value_classes/ValueIndex.h"
 #include "Manager.h"
 #include "Notification.h"
+#include "platform/Atomic.h"
 
 using namespace OpenZWave;
 
 
+//-----------------------------------------------------------------------------
+// <CompareKey>
+// Order a store entry against a key
+//-----------------------------------------------------------------------------
+static bool CompareKey
+(
+	ValueStore::Entry const& _entry,
+	uint32 const _key
+)
+{
+	return( _entry.first < _key );
+}
+
+volatile uint32 ValueStore::s_generation = 1;
+
 //-----------------------------------------------------------------------------
 // <ValueStore::ValueStore>
 // Destructor
@@ -41,13 +60,82 @@ ValueStore::~ValueStore
 (
 )
 {
-	map<uint32,Value*>::iterator it = m_values.begin();
-	while( !m_values.empty() )
+	for( vector<Entry>::iterator it = m_values.begin(); it != m_values.end(); ++it )
+	{
+		ReleaseValue( it->second );
+	}
+	m_values.clear();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::Find>
+// Binary search for the position of a key
+//-----------------------------------------------------------------------------
+vector<ValueStore::Entry>::iterator ValueStore::Find
+(
+	uint32 const _key
+)
+{
+	return lower_bound( m_values.begin(), m_values.end(), _key, CompareKey );
+}
+
+vector<ValueStore::Entry>::const_iterator ValueStore::Find
+(
+	uint32 const _key
+)const
+{
+	return lower_bound( m_values.begin(), m_values.end(), _key, CompareKey );
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::ReleaseValue>
+// Notify the watchers that a value is being removed, then release it
+//-----------------------------------------------------------------------------
+void ValueStore::ReleaseValue
+(
+	Value* _value
+)
+{
+	ValueID const& valueId = _value->GetID();
+
+	// Any pointers to the value held with the old generation are now stale
+	AtomicIncrement( &s_generation );
+
+	// Free its slot in the values shared with other processes, as the value
+	// may outlive the driver and its table
+	Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() );
+	if( driver && driver->m_valueExport )
+	{
+		driver->m_valueExport->Remove( _value );
+	}
+
+	// Queries no longer find it
+	if( _value->m_index )
 	{
-		ValueID const& valueId = it->second->GetID();
-		RemoveValue( valueId.GetValueStoreKey() );
-		it = m_values.begin();
+		_value->m_index->Remove( _value );
 	}
+
+	// Then notify the watchers, unless the whole driver is going
+	if( driver && !driver->m_tearingDown )
+	{
+		Notification* notification = new Notification( Notification::Type_ValueRemoved );
+		notification->SetValueId( valueId );
+		driver->QueueNotification( notification );
+	}
+
+	// Now release the value
+	_value->Release();
+}
+
+//-----------------------------------------------------------------------------
+// <ValueStore::GetGeneration>
+// Count of values removed from all the stores
+//-----------------------------------------------------------------------------
+uint32 ValueStore::GetGeneration
+(
+)
+{
+	return AtomicLoad( &s_generation );
 }
 
 //-----------------------------------------------------------------------------
@@ -65,19 +153,31 @@ bool ValueStore::AddValue
 	}
 
 	uint32 key = _value->GetID().GetValueStoreKey();
-	map<uint32,Value*>::iterator it = m_values.find( key );
-	if( it != m_values.end() )
+	vector<Entry>::iterator it = Find( key );
+	if( ( it != m_values.end() ) && ( it->first == key ) )
 	{
 		// There is already a value in the store with this key, so we give up.
 		return false;
 	}
 
-	m_values[key] = _value;
+	m_values.insert( it, Entry( key, _value ) );
 	_value->AddRef();
 
-	// Notify the watchers of the new value
 	if( Driver* driver = Manager::Get()->GetDriver( _value->GetID().GetHomeId() ) )
 	{
+		// Give it a slot in the values shared with other processes
+		if( driver->m_valueExport )
+		{
+			driver->m_valueExport->Add( _value );
+		}
+
+		// Index it, for Manager::FindValues
+		if( driver->m_valueIndex )
+		{
+			driver->m_valueIndex->Add( _value );
+		}
+
+		// Notify the watchers of the new value
 		Notification* notification = new Notification( Notification::Type_ValueAdded );
 		notification->SetValueId( _value->GetID() );
 		driver->QueueNotification( notification );
@@ -95,24 +195,12 @@ bool ValueStore::RemoveValue
 	uint32 const& _key
 )
 {
-	map<uint32,Value*>::iterator it = m_values.find( _key );
-	if( it != m_values.end() )
+	vector<Entry>::iterator it = Find( _key );
+	if( ( it != m_values.end() ) && ( it->first == _key ) )
 	{
 		Value* value = it->second;
-		ValueID const& valueId = value->GetID();
-
-		// First notify the watchers
-		if( Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() ) )
-		{
-			Notification* notification = new Notification( Notification::Type_ValueRemoved );
-			notification->SetValueId( valueId );
-			driver->QueueNotification( notification ); 
-		}
-
-		// Now release and remove the value from the store
-		value->Release();
 		m_values.erase( it );
-
+		ReleaseValue( value );
 		return true;
 	}
 
@@ -139,32 +227,21 @@ void ValueStore::RemoveCommandClassValues
 	uint8 const _commandClassId
 )
 {
-	map<uint32,Value*>::iterator it = m_values.begin();
-	while( it != m_values.end() )
+	// Compact the remaining values in a single pass, keeping their order
+	vector<Entry>::iterator keep = m_values.begin();
+	for( vector<Entry>::iterator it = m_values.begin(); it != m_values.end(); ++it )
 	{
-		Value* value = it->second;
-		ValueID const& valueId = value->GetID();
-		if( _commandClassId == valueId.GetCommandClassId() )
+		if( _commandClassId == it->second->GetID().GetCommandClassId() )
 		{
 			// The value belongs to the specified command class
-			
-			// First notify the watchers
-			if( Driver* driver = Manager::Get()->GetDriver( valueId.GetHomeId() ) )
-			{
-				Notification* notification = new Notification( Notification::Type_ValueRemoved );
-				notification->SetValueId( valueId );
-				driver->QueueNotification( notification ); 
-			}
-
-			// Now release and remove the value from the store
-			value->Release();
-			m_values.erase( it++ );
+			ReleaseValue( it->second );
 		}
 		else
 		{
-			++it;
+			*keep++ = *it;
 		}
 	}
+	m_values.erase( keep, m_values.end() );
 }
 
 //-----------------------------------------------------------------------------
@@ -178,8 +255,8 @@ Value* ValueStore::GetValue
 {
 	Value* value = NULL;
 
-	map<uint32,Value*>::const_iterator it = m_values.find( _key );
-	if( it != m_values.end() )
+	vector<Entry>::const_iterator it = Find( _key );
+	if( ( it != m_values.end() ) && ( it->first == _key ) )
 	{
 		value = it->second;
 		if( value )
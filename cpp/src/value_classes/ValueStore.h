@@ -28,7 +28,8 @@
 #ifndef _ValueStore_H
 #define _ValueStore_H
 
-#include <map>
+#include <utility>
+#include <vector>
 #include "Defs.h"
 #include "value_classes/ValueID.h"
 
@@ -39,12 +40,15 @@ namespace OpenZWave
 	class Value;
 
 	/** \brief Container that holds all of the values associated with a given node.
+	 *
+	 * The values are held in a vector sorted by their value store key, so lookups are a
+	 * binary search over contiguous memory, and iteration visits the values in key order.
 	 */
 	class ValueStore
 	{
 	public:
-		
-		typedef map<uint32,Value*>::const_iterator Iterator;
+		typedef pair<uint32,Value*> Entry;
+		typedef vector<Entry>::const_iterator Iterator;
 
 		Iterator Begin(){ return m_values.begin(); }
 		Iterator End(){ return m_values.end(); }
@@ -58,8 +62,21 @@ namespace OpenZWave
 
 		void RemoveCommandClassValues( uint8 const _commandClassId );		// Remove all the values associated with a command class
 
+		/**
+		 * \brief Count of values removed from all the stores.
+		 * Changes whenever a value leaves a store, so a value pointer kept along with the
+		 * count is still in its store for as long as the count has not changed.
+		 */
+		static uint32 GetGeneration();
+
 	private:
-		map<uint32,Value*>	m_values;
+		vector<Entry>::iterator Find( uint32 const _key );					// First entry with a key that is not less than _key
+		vector<Entry>::const_iterator Find( uint32 const _key )const;
+		void ReleaseValue( Value* _value );									// Notify the watchers that a value is going, and release it
+
+		vector<Entry>	m_values;
+
+		static volatile uint32	s_generation;
 	};
 
 } // namespace OpenZWave
@@ -0,0 +1,409 @@
+//-----------------------------------------------------------------------------
+//
+//	ConfigIndex.cpp
+//
+//	Check the config folder and compile it into a prebuilt product index,
+//	which the library maps at startup instead of parsing the XML.
+//
+//	Usage: ozwconfigindex <config folder> [index file]
+//	The index is written to manufacturer_specific.idx in the config folder
+//	if no index file is given.  Nothing is written if any file has an error,
+//	and the exit status is then 1, so a build stops on a bad config folder.
+//
+//	Errors are what the library cannot read at all: XML that does not parse,
+//	a missing device file, or a required attribute that is missing or not a
+//	number.  What it reads, but perhaps not as meant, such as a duplicate or
+//	a number too large for its field, is a warning.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "Defs.h"
+#include "ProductIndex.h"
+#include "platform/FileOps.h"
+#include "value_classes/Value.h"
+#include "tinyxml.h"
+
+using namespace OpenZWave;
+
+static uint32 s_errors = 0;
+static uint32 s_warnings = 0;
+
+//-----------------------------------------------------------------------------
+// <Report>
+// Print an error or warning against a line of a file
+//-----------------------------------------------------------------------------
+static void Report
+(
+	bool const _error,
+	string const& _file,
+	TiXmlNode const* _node,
+	char const* _format,
+	...
+)
+{
+	if( _node )
+	{
+		fprintf( stderr, "%s:%d: %s: ", _file.c_str(), _node->Row(), _error ? "error" : "warning" );
+	}
+	else
+	{
+		fprintf( stderr, "%s: %s: ", _file.c_str(), _error ? "error" : "warning" );
+	}
+
+	va_list args;
+	va_start( args, _format );
+	vfprintf( stderr, _format, args );
+	va_end( args );
+	fprintf( stderr, "\n" );
+
+	if( _error )
+	{
+		++s_errors;
+	}
+	else
+	{
+		++s_warnings;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <GetNumber>
+// Read an attribute as a number from _min to _max.  Missing or badly formed
+// attributes are errors, unless _optional is set and it is missing.  Numbers
+// out of range are warnings, and are cut to fit as the library would.
+//-----------------------------------------------------------------------------
+static bool GetNumber
+(
+	string const& _file,
+	TiXmlElement const* _element,
+	char const* _name,
+	int const _base,
+	uint32 const _min,
+	uint32 const _max,
+	bool const _optional,
+	uint32& o_value
+)
+{
+	char const* str = _element->Attribute( _name );
+	if( !str )
+	{
+		if( !_optional )
+		{
+			Report( true, _file, _element, "<%s> has no %s attribute", _element->Value(), _name );
+		}
+		return false;
+	}
+
+	char* end;
+	unsigned long value = strtoul( str, &end, _base );
+	if( end == str )
+	{
+		Report( true, _file, _element, "<%s> %s=\"%s\" is not a number", _element->Value(), _name, str );
+		return false;
+	}
+
+	while( *end == ' ' || *end == '\t' )
+	{
+		++end;
+	}
+	if( *end )
+	{
+		Report( true, _file, _element, "<%s> %s=\"%s\" is not a number", _element->Value(), _name, str );
+		return false;
+	}
+	if( end[-1] == ' ' || end[-1] == '\t' )
+	{
+		Report( false, _file, _element, "<%s> %s=\"%s\" has trailing spaces", _element->Value(), _name, str );
+	}
+
+	if( value < _min || value > _max )
+	{
+		Report( false, _file, _element, "<%s> %s=\"%s\" is not from %u to %u", _element->Value(), _name, str, _min, _max );
+		value &= _max;
+	}
+
+	o_value = (uint32)value;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// <CheckValue>
+// Check a value definition in a device file
+//-----------------------------------------------------------------------------
+static void CheckValue
+(
+	string const& _file,
+	TiXmlElement const* _valueElement
+)
+{
+	uint32 number;
+	char const* type = _valueElement->Attribute( "type" );
+	bool known = false;
+	for( int i=0; type && i<=(int)ValueID::ValueType_Max; ++i )
+	{
+		known = known || !strcmp( type, Value::GetTypeNameFromEnum( (ValueID::ValueType)i ) );
+	}
+	if( !known )
+	{
+		Report( true, _file, _valueElement, "<Value> type=\"%s\" is not a value type", type ? type : "" );
+	}
+
+	if( char const* genre = _valueElement->Attribute( "genre" ) )
+	{
+		known = false;
+		for( int i=0; i<(int)ValueID::ValueGenre_Count; ++i )
+		{
+			known = known || !strcmp( genre, Value::GetGenreNameFromEnum( (ValueID::ValueGenre)i ) );
+		}
+		if( !known )
+		{
+			Report( true, _file, _valueElement, "<Value> genre=\"%s\" is not a value genre", genre );
+		}
+	}
+
+	GetNumber( _file, _valueElement, "index", 10, 0, 0xff, false, number );
+	GetNumber( _file, _valueElement, "instance", 10, 1, 0xff, true, number );
+
+	if( !_valueElement->Attribute( "label" ) )
+	{
+		Report( false, _file, _valueElement, "<Value> has no label" );
+	}
+
+	if( type && !strcmp( type, "list" ) )
+	{
+		set<int> values;
+		TiXmlElement const* itemElement = _valueElement->FirstChildElement( "Item" );
+		for( ; itemElement; itemElement = itemElement->NextSiblingElement( "Item" ) )
+		{
+			int value;
+			if( !itemElement->Attribute( "label" ) )
+			{
+				Report( true, _file, itemElement, "<Item> has no label" );
+			}
+			if( TIXML_SUCCESS != itemElement->QueryIntAttribute( "value", &value ) )
+			{
+				Report( true, _file, itemElement, "<Item> has no value" );
+			}
+			else if( !values.insert( value ).second )
+			{
+				Report( false, _file, itemElement, "<Item> value %d is used twice", value );
+			}
+		}
+		if( values.empty() )
+		{
+			Report( true, _file, _valueElement, "list <Value> has no items" );
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <CheckDeviceFile>
+// Check a device file, as Node::ReadCommandClassesXML would read it
+//-----------------------------------------------------------------------------
+static void CheckDeviceFile
+(
+	string const& _configPath,
+	string const& _file
+)
+{
+	string filename = _configPath + _file;
+	TiXmlDocument doc;
+	if( !doc.LoadFile( filename.c_str(), TIXML_ENCODING_UTF8 ) )
+	{
+		if( doc.ErrorId() == TiXmlBase::TIXML_ERROR_OPENING_FILE )
+		{
+			Report( true, _file, NULL, "file is missing" );
+		}
+		else
+		{
+			fprintf( stderr, "%s:%d: error: %s\n", _file.c_str(), doc.ErrorRow(), doc.ErrorDesc() );
+			++s_errors;
+		}
+		return;
+	}
+
+	TiXmlElement const* root = doc.RootElement();
+	if( !root || strcmp( root->Value(), "Product" ) )
+	{
+		Report( true, _file, root, "the root element is not <Product>" );
+		return;
+	}
+
+	uint32 number;
+	set<uint32> commandClasses;
+	TiXmlElement const* ccElement = root->FirstChildElement( "CommandClass" );
+	for( ; ccElement; ccElement = ccElement->NextSiblingElement( "CommandClass" ) )
+	{
+		if( !GetNumber( _file, ccElement, "id", 10, 1, 0xff, false, number ) )
+		{
+			continue;
+		}
+		if( !commandClasses.insert( number ).second )
+		{
+			Report( false, _file, ccElement, "<CommandClass> %u appears twice", number );
+		}
+
+		set<uint32> indexes;
+		TiXmlElement const* valueElement = ccElement->FirstChildElement( "Value" );
+		for( ; valueElement; valueElement = valueElement->NextSiblingElement( "Value" ) )
+		{
+			CheckValue( _file, valueElement );
+
+			int index;
+			int instance = 1;
+			valueElement->QueryIntAttribute( "instance", &instance );
+			if( TIXML_SUCCESS == valueElement->QueryIntAttribute( "index", &index ) && !indexes.insert( ( (uint32)instance << 8 ) | (uint32)index ).second )
+			{
+				Report( false, _file, valueElement, "<Value> instance %d index %d is defined twice", instance, index );
+			}
+		}
+
+		TiXmlElement const* associationsElement = ccElement->FirstChildElement( "Associations" );
+		if( associationsElement )
+		{
+			TiXmlElement const* groupElement = associationsElement->FirstChildElement( "Group" );
+			for( ; groupElement; groupElement = groupElement->NextSiblingElement( "Group" ) )
+			{
+				GetNumber( _file, groupElement, "index", 10, 0, 0xff, false, number );
+				GetNumber( _file, groupElement, "max_associations", 10, 0, 0xff, true, number );
+			}
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// <main>
+//-----------------------------------------------------------------------------
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 || argc > 3 )
+	{
+		fprintf( stderr, "Usage: %s <config folder> [index file]\n", argv[0] );
+		return 2;
+	}
+
+	string configPath = argv[1];
+	if( configPath[configPath.size()-1] != '/' )
+	{
+		configPath += '/';
+	}
+	string indexFile = ( argc == 3 ) ? string( argv[2] ) : configPath + "manufacturer_specific.idx";
+
+	string const productFile = "manufacturer_specific.xml";
+	TiXmlDocument doc;
+	if( !doc.LoadFile( ( configPath + productFile ).c_str(), TIXML_ENCODING_UTF8 ) )
+	{
+		fprintf( stderr, "%s:%d: error: %s\n", productFile.c_str(), doc.ErrorRow(), doc.ErrorDesc() );
+		return 1;
+	}
+
+	map<uint16,string> manufacturers;
+	vector<ProductIndex::Entry> products;
+	set<uint64> productKeys;
+	set<string> configFiles;
+
+	TiXmlElement const* manufacturerElement = doc.RootElement()->FirstChildElement( "Manufacturer" );
+	for( ; manufacturerElement; manufacturerElement = manufacturerElement->NextSiblingElement( "Manufacturer" ) )
+	{
+		uint32 manufacturerId;
+		char const* name = manufacturerElement->Attribute( "name" );
+		if( !name )
+		{
+			Report( true, productFile, manufacturerElement, "<Manufacturer> has no name" );
+		}
+		if( !GetNumber( productFile, manufacturerElement, "id", 16, 0, 0xffff, false, manufacturerId ) || !name )
+		{
+			continue;
+		}
+		if( manufacturers.find( (uint16)manufacturerId ) != manufacturers.end() )
+		{
+			// The library merges the products, under the last name given
+			Report( false, productFile, manufacturerElement, "manufacturer %.4x is listed twice", manufacturerId );
+		}
+		manufacturers[(uint16)manufacturerId] = name;
+
+		TiXmlElement const* productElement = manufacturerElement->FirstChildElement( "Product" );
+		for( ; productElement; productElement = productElement->NextSiblingElement( "Product" ) )
+		{
+			uint32 type;
+			uint32 id;
+			char const* productName = productElement->Attribute( "name" );
+			if( !productName )
+			{
+				Report( true, productFile, productElement, "<Product> has no name" );
+			}
+			bool ok = GetNumber( productFile, productElement, "type", 16, 0, 0xffff, false, type );
+			ok = GetNumber( productFile, productElement, "id", 16, 0, 0xffff, false, id ) && ok;
+			if( !ok || !productName )
+			{
+				continue;
+			}
+
+			// The library keeps the first of two products with the same ids
+			uint64 key = ( (uint64)manufacturerId << 32 ) | ( type << 16 ) | id;
+			if( !productKeys.insert( key ).second )
+			{
+				Report( false, productFile, productElement, "product %.4x:%.4x:%.4x is listed twice, and only the first is used", manufacturerId, type, id );
+				continue;
+			}
+
+			ProductIndex::Entry entry;
+			entry.m_manufacturerId = (uint16)manufacturerId;
+			entry.m_productType = (uint16)type;
+			entry.m_productId = (uint16)id;
+			entry.m_productName = productName;
+			if( char const* config = productElement->Attribute( "config" ) )
+			{
+				entry.m_configPath = config;
+				if( configFiles.insert( config ).second )
+				{
+					CheckDeviceFile( configPath, config );
+				}
+			}
+			products.push_back( entry );
+		}
+	}
+
+	if( s_errors )
+	{
+		fprintf( stderr, "%u errors and %u warnings in %s - the product index was not built\n", s_errors, s_warnings, configPath.c_str() );
+		return 1;
+	}
+
+	FileOps::Create();
+	bool built = ProductIndex::Build( indexFile, configPath, manufacturers, products, true );
+	FileOps::Destroy();
+	if( !built )
+	{
+		fprintf( stderr, "Cannot write %s\n", indexFile.c_str() );
+		return 1;
+	}
+
+	printf( "Checked %d manufacturers, %d products and %d device files with %u warnings, and built %s\n",
+		(int)manufacturers.size(), (int)products.size(), (int)configFiles.size(), s_warnings, indexFile.c_str() );
+	return 0;
+}
@@ -0,0 +1,67 @@
+//-----------------------------------------------------------------------------
+//
+//	LogDecode.cpp
+//
+//	Convert a binary log, written with the LogFormat option set to "binary",
+//	to the usual text log.
+//
+//	Usage: ozwlogdecode <binary log> [text log]
+//	The text goes to standard output if no text log is given.
+//
+//	SOFTWARE NOTICE AND LICENSE
+//
+//	This file is part of OpenZWave.
+//
+//	OpenZWave is free software: you can redistribute it and/or modify
+//	it under the terms of the GNU Lesser General Public License as published
+//	by the Free Software Foundation, either version 3 of the License,
+//	or (at your option) any later version.
+//
+//	OpenZWave is distributed in the hope that it will be useful,
+//	but WITHOUT ANY WARRANTY; without even the implied warranty of
+//	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//	GNU Lesser General Public License for more details.
+//
+//	You should have received a copy of the GNU Lesser General Public License
+//	along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include "Defs.h"
+#include "platform/BinaryLog.h"
+
+using namespace OpenZWave;
+
+int main( int argc, char* argv[] )
+{
+	if( argc < 2 || argc > 3 )
+	{
+		fprintf( stderr, "Usage: %s <binary log> [text log]\n", argv[0] );
+		return 2;
+	}
+
+	FILE* out = stdout;
+	if( argc == 3 )
+	{
+		out = fopen( argv[2], "w" );
+		if( out == NULL )
+		{
+			fprintf( stderr, "Cannot create %s\n", argv[2] );
+			return 1;
+		}
+	}
+
+	bool ok = BinaryLog::Decode( argv[1], out );
+	if( out != stdout )
+	{
+		fclose( out );
+	}
+
+	if( !ok )
+	{
+		fprintf( stderr, "%s is not a binary log\n", argv[1] );
+		return 1;
+	}
+	return 0;
+}
@@ -498,8 +498,13 @@ DISTFILES =	.gitignore \
 	config/zwcfg.xsd \
 	config/zwp/WD-100.xml \
 	config/zwscene.xsd \
+	cpp/bench/Bench.cpp \
+	cpp/bench/Makefile \
+	cpp/bench/ozwbench.in \
+	cpp/build/CommandClassList.example \
 	cpp/build/Makefile \
 	cpp/build/OZW_RunTests.sh \
+	cpp/build/gendeviceclasses.pl \
 	cpp/build/libopenzwave.pc.in \
 	cpp/build/ozw_config.in \
 	cpp/build/sh2ju.sh \
@@ -576,24 +581,62 @@ DISTFILES =	.gitignore \
 	cpp/src/Defs.h \
 	cpp/src/DoxygenMain.h \
 	cpp/src/Driver.cpp \
+	cpp/src/ConfigCache.cpp \
+	cpp/src/Checksum.cpp \
+	cpp/src/ChangeJournal.cpp \
+	cpp/src/ValueLog.cpp \
+	cpp/src/DeviceClassTables.cpp \
+	cpp/src/DeviceClasses.cpp \
+	cpp/src/ProductIndex.cpp \
 	cpp/src/Driver.h \
+	cpp/src/ConfigCache.h \
+	cpp/src/Checksum.h \
+	cpp/src/ChangeJournal.h \
+	cpp/src/NodeTable.h \
+	cpp/src/ValueLog.h \
+	cpp/src/DeviceClasses.h \
+	cpp/src/ProductIndex.h \
 	cpp/src/Group.cpp \
 	cpp/src/Group.h \
 	cpp/src/Manager.cpp \
 	cpp/src/Manager.h \
 	cpp/src/Msg.cpp \
+	cpp/src/MsgTrace.cpp \
 	cpp/src/Msg.h \
+	cpp/src/MsgTrace.h \
 	cpp/src/Node.cpp \
 	cpp/src/Node.h \
 	cpp/src/Notification.cpp \
+	cpp/src/NotificationDispatcher.cpp \
 	cpp/src/Notification.h \
+	cpp/src/NotificationDispatcher.h \
 	cpp/src/OZWException.h \
+	cpp/src/NotificationFilter.cpp \
 	cpp/src/Options.cpp \
+	cpp/src/NotificationFilter.h \
 	cpp/src/Options.h \
 	cpp/src/Scene.cpp \
+	cpp/src/SharedPollThread.cpp \
+	cpp/src/SharedString.cpp \
+	cpp/src/StateWriter.cpp \
+	cpp/src/TimerWheel.cpp \
+	cpp/src/LatencyHistogram.cpp \
+	cpp/src/CommandClassProfile.cpp \
+	cpp/src/ControllerGroup.cpp \
 	cpp/src/Scene.h \
+	cpp/src/SharedPollThread.h \
+	cpp/src/SharedString.h \
+	cpp/src/StateWriter.h \
+	cpp/src/TimerWheel.h \
+	cpp/src/LatencyHistogram.h \
+	cpp/src/CommandClassProfile.h \
+	cpp/src/ControllerGroup.h \
 	cpp/src/Utils.cpp \
+	cpp/src/XmlStreamReader.cpp \
+	cpp/src/XmlWriter.cpp \
 	cpp/src/Utils.h \
+	cpp/src/XmlStreamReader.h \
+	cpp/src/XmlWriter.h \
 	cpp/src/ZWSecurity.cpp \
 	cpp/src/ZWSecurity.h \
 	cpp/src/aes/aes.h \
@@ -635,6 +678,7 @@ DISTFILES =	.gitignore \
 	cpp/src/command_classes/CommandClass.h \
 	cpp/src/command_classes/CommandClasses.cpp \
 	cpp/src/command_classes/CommandClasses.h \
+	cpp/src/command_classes/CommandClassList.h \
 	cpp/src/command_classes/Configuration.cpp \
 	cpp/src/command_classes/Configuration.h \
 	cpp/src/command_classes/ControllerReplication.cpp \
@@ -647,6 +691,8 @@ DISTFILES =	.gitignore \
 	cpp/src/command_classes/DoorLockLogging.h \
 	cpp/src/command_classes/EnergyProduction.cpp \
 	cpp/src/command_classes/EnergyProduction.h \
+	cpp/src/command_classes/FirmwareUpdateMetaData.cpp \
+	cpp/src/command_classes/FirmwareUpdateMetaData.h \
 	cpp/src/command_classes/Hail.cpp \
 	cpp/src/command_classes/Hail.h \
 	cpp/src/command_classes/Indicator.cpp \
@@ -687,6 +733,8 @@ DISTFILES =	.gitignore \
 	cpp/src/command_classes/SensorBinary.h \
 	cpp/src/command_classes/SensorMultilevel.cpp \
 	cpp/src/command_classes/SensorMultilevel.h \
+	cpp/src/command_classes/Supervision.cpp \
+	cpp/src/command_classes/Supervision.h \
 	cpp/src/command_classes/SwitchAll.cpp \
 	cpp/src/command_classes/SwitchAll.h \
 	cpp/src/command_classes/SwitchBinary.cpp \
@@ -709,6 +757,8 @@ DISTFILES =	.gitignore \
 	cpp/src/command_classes/ThermostatSetpoint.h \
 	cpp/src/command_classes/TimeParameters.cpp \
 	cpp/src/command_classes/TimeParameters.h \
+	cpp/src/command_classes/TransportService.cpp \
+	cpp/src/command_classes/TransportService.h \
 	cpp/src/command_classes/UserCode.cpp \
 	cpp/src/command_classes/UserCode.h \
 	cpp/src/command_classes/Version.cpp \
@@ -717,7 +767,11 @@ DISTFILES =	.gitignore \
 	cpp/src/command_classes/WakeUp.h \
 	cpp/src/command_classes/ZWavePlusInfo.cpp \
 	cpp/src/command_classes/ZWavePlusInfo.h \
+	cpp/src/platform/AsyncLog.cpp \
+	cpp/src/platform/BinaryLog.cpp \
 	cpp/src/platform/Controller.cpp \
+	cpp/src/platform/AsyncLog.h \
+	cpp/src/platform/BinaryLog.h \
 	cpp/src/platform/Controller.h \
 	cpp/src/platform/Event.cpp \
 	cpp/src/platform/Event.h \
@@ -727,23 +781,42 @@ DISTFILES =	.gitignore \
 	cpp/src/platform/HidController.h \
 	cpp/src/platform/Log.cpp \
 	cpp/src/platform/Log.h \
+	cpp/src/platform/LogQueue.cpp \
 	cpp/src/platform/Mutex.cpp \
+	cpp/src/platform/MemoryPool.cpp \
+	cpp/src/platform/LogQueue.h \
 	cpp/src/platform/Mutex.h \
+	cpp/src/platform/MemoryPool.h \
 	cpp/src/platform/Ref.h \
+	cpp/src/platform/Atomic.h \
 	cpp/src/platform/SerialController.cpp \
+	cpp/src/platform/ReplayController.cpp \
+	cpp/src/platform/ControllerTrace.cpp \
+	cpp/src/platform/SimulatedController.cpp \
 	cpp/src/platform/SerialController.h \
+	cpp/src/platform/ReplayController.h \
+	cpp/src/platform/ControllerTrace.h \
+	cpp/src/platform/SimulatedController.h \
 	cpp/src/platform/Stream.cpp \
+	cpp/src/platform/RWLock.cpp \
 	cpp/src/platform/Stream.h \
+	cpp/src/platform/TcpController.cpp \
+	cpp/src/platform/TcpController.h \
+	cpp/src/platform/RWLock.h \
 	cpp/src/platform/Thread.cpp \
 	cpp/src/platform/Thread.h \
 	cpp/src/platform/TimeStamp.cpp \
 	cpp/src/platform/TimeStamp.h \
+	cpp/src/platform/WaitSet.cpp \
 	cpp/src/platform/Wait.cpp \
+	cpp/src/platform/WaitSet.h \
 	cpp/src/platform/Wait.h \
 	cpp/src/platform/unix/EventImpl.cpp \
 	cpp/src/platform/unix/EventImpl.h \
 	cpp/src/platform/unix/FileOpsImpl.cpp \
 	cpp/src/platform/unix/FileOpsImpl.h \
+	cpp/src/platform/unix/IoReactor.cpp \
+	cpp/src/platform/unix/IoReactor.h \
 	cpp/src/platform/unix/LogImpl.cpp \
 	cpp/src/platform/unix/LogImpl.h \
 	cpp/src/platform/unix/MutexImpl.cpp \
@@ -801,6 +874,14 @@ DISTFILES =	.gitignore \
 	cpp/src/value_classes/ValueDecimal.cpp \
 	cpp/src/value_classes/ValueDecimal.h \
 	cpp/src/value_classes/ValueID.h \
+	cpp/src/value_classes/ValueExport.cpp \
+	cpp/src/value_classes/ValueExport.h \
+	cpp/src/value_classes/ValueHandle.cpp \
+	cpp/src/value_classes/ValueHandle.h \
+	cpp/src/value_classes/ValueHistory.cpp \
+	cpp/src/value_classes/ValueIndex.cpp \
+	cpp/src/value_classes/ValueHistory.h \
+	cpp/src/value_classes/ValueIndex.h \
 	cpp/src/value_classes/ValueInt.cpp \
 	cpp/src/value_classes/ValueInt.h \
 	cpp/src/value_classes/ValueList.cpp \
@@ -811,7 +892,9 @@ DISTFILES =	.gitignore \
 	cpp/src/value_classes/ValueSchedule.h \
 	cpp/src/value_classes/ValueShort.cpp \
 	cpp/src/value_classes/ValueShort.h \
+	cpp/src/value_classes/ValueSnapshot.cpp \
 	cpp/src/value_classes/ValueStore.cpp \
+	cpp/src/value_classes/ValueSnapshot.h \
 	cpp/src/value_classes/ValueStore.h \
 	cpp/src/value_classes/ValueString.cpp \
 	cpp/src/value_classes/ValueString.h \
@@ -822,6 +905,11 @@ DISTFILES =	.gitignore \
 	cpp/tinyxml/tinyxml.h \
 	cpp/tinyxml/tinyxmlerror.cpp \
 	cpp/tinyxml/tinyxmlparser.cpp \
+	cpp/tools/ConfigIndex.cpp \
+	cpp/tools/LogDecode.cpp \
+	cpp/tools/Makefile \
+	cpp/tools/ozwconfigindex.in \
+	cpp/tools/ozwlogdecode.in \
 	debian/MinOZW.1 \
 	debian/TODO \
 	debian/changelog \
@@ -908,6 +996,8 @@ DISTFILES =	.gitignore \
 	dotnet/src/ZWManager.cpp \
 	dotnet/src/ZWManager.h \
 	dotnet/src/ZWNotification.h \
+	dotnet/src/ZWNotificationQueue.cpp \
+	dotnet/src/ZWNotificationQueue.h \
 	dotnet/src/ZWOptions.cpp \
 	dotnet/src/ZWOptions.h \
 	dotnet/src/ZWValueID.h \
@@ -53,6 +53,77 @@ void ZWManager::Create
 	m_gchControllerState = GCHandle::Alloc( m_onStateChanged ); 
 }
 
+//-----------------------------------------------------------------------------
+//	<ZWManager::Destroy>
+//	Destroy the unmanaged Manager singleton object, and stop batching
+//-----------------------------------------------------------------------------
+void ZWManager::Destroy
+(
+)
+{
+	Manager::Get()->Destroy();
+
+	if( m_notificationQueue )
+	{
+		// The drivers are gone, so nothing more will be queued
+		m_notificationQueue->Stop();
+		m_notificationBatchThread->Join();
+		m_notificationBatchThread = nullptr;
+
+		m_gchNotificationBatch.Free();
+		m_notificationBatch = nullptr;
+
+		delete m_notificationQueue;
+		m_notificationQueue = NULL;
+	}
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWManager::EnableNotificationBatching>
+//	Replace the managed watcher with a native one that queues notifications
+//-----------------------------------------------------------------------------
+bool ZWManager::EnableNotificationBatching
+(
+	uint32 capacity,
+	uint32 batchSize
+)
+{
+	if( m_notificationQueue || 0 == capacity || 0 == batchSize )
+	{
+		return false;
+	}
+
+	m_notificationBatch = gcnew array<ZWNotificationRecord>( batchSize );
+	m_gchNotificationBatch = GCHandle::Alloc( m_notificationBatch, GCHandleType::Pinned );
+	m_notificationQueue = new ZWNotificationQueue( capacity );
+
+	m_notificationBatchThread = gcnew Thread( gcnew ThreadStart( this, &ZWManager::NotificationBatchThreadProc ) );
+	m_notificationBatchThread->Name = "OpenZWave notifications";
+	m_notificationBatchThread->IsBackground = true;
+	m_notificationBatchThread->Start();
+
+	IntPtr ip = Marshal::GetFunctionPointerForDelegate( m_onNotification );
+	Manager::Get()->RemoveWatcher( (Manager::pfnOnNotification_t)ip.ToPointer(), NULL );
+	Manager::Get()->AddWatcher( &ZWNotificationQueue::OnNotification, m_notificationQueue );
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWManager::NotificationBatchThreadProc>
+//	Copy waiting notifications into the pinned array and hand them on
+//-----------------------------------------------------------------------------
+void ZWManager::NotificationBatchThreadProc
+(
+)
+{
+	NotificationRecord* records = (NotificationRecord*)m_gchNotificationBatch.AddrOfPinnedObject().ToPointer();
+	uint32 batchSize = (uint32)m_notificationBatch->Length;
+	while( uint32 count = m_notificationQueue->Pop( records, batchSize ) )
+	{
+		ZWOnNotificationBatch( m_notificationBatch, (int)count );
+	}
+}
+
 //-----------------------------------------------------------------------------
 //	<ZWManager::OnNotificationFromUnmanaged>
 //	Trigger an event from the unmanaged notification callback
@@ -34,6 +34,7 @@
 
 #include "ZWValueID.h"
 #include "ZWNotification.h"
+#include "ZWNotificationQueue.h"
 
 #include "Manager.h"
 #include "ValueID.h"
@@ -53,6 +54,10 @@ namespace OpenZWaveDotNet
 	// Delegate for handling notification callbacks
 	public delegate void ManagedNotificationsHandler(ZWNotification^ notification);
 
+	// Delegate for handling batches of notifications.  The array is reused, so
+	// only the first count records are valid, and only until the handler returns.
+	public delegate void ManagedNotificationBatchHandler(array<ZWNotificationRecord>^ batch, int count);
+
 	[UnmanagedFunctionPointer(CallingConvention::Cdecl)]
 	private delegate void OnNotificationFromUnmanagedDelegate(Notification* _notification, void* _context);
 
@@ -93,7 +98,10 @@ namespace OpenZWaveDotNet
 	{
 		Unknown		= Driver::ControllerInterface_Unknown,
 		Serial		= Driver::ControllerInterface_Serial,
-		Hid			= Driver::ControllerInterface_Hid
+		Hid			= Driver::ControllerInterface_Hid,
+		Simulated	= Driver::ControllerInterface_Simulated,
+		Replay		= Driver::ControllerInterface_Replay,
+		Tcp			= Driver::ControllerInterface_Tcp
 	};
 
 	public enum class ZWControllerCommand
@@ -164,6 +172,47 @@ namespace OpenZWaveDotNet
 			}
 		}
 
+	private:
+		ManagedNotificationBatchHandler^ m_notificationBatchEvent;
+		event ManagedNotificationBatchHandler^ ZWOnNotificationBatch
+		{
+			void add( ManagedNotificationBatchHandler ^ d )
+			{ 
+				m_notificationBatchEvent += d;
+			} 
+			
+			void remove(ManagedNotificationBatchHandler ^ d)
+			{ 
+				m_notificationBatchEvent -= d;
+			} 
+			
+			void raise(array<ZWNotificationRecord>^ batch, int count)
+			{ 
+				ManagedNotificationBatchHandler^ tmp = m_notificationBatchEvent; 
+				if (tmp)
+				{ 
+					tmp->Invoke( batch, count );
+				} 
+			} 
+		}
+
+	public:
+		/**
+		 * \brief Handler for batches of notifications, once EnableNotificationBatching has been called.
+		 * It is called on the wrapper's own thread rather than the driver's.
+		 */
+		property ManagedNotificationBatchHandler^ OnNotificationBatch
+		{
+			ManagedNotificationBatchHandler^ get()
+			{
+				return m_notificationBatchEvent;
+			}
+			void set( ManagedNotificationBatchHandler^ value )
+			{
+				m_notificationBatchEvent = value;
+			}
+		}
+
 	private:
 		ManagedControllerStateChangedHandler^ m_controllerStateChangedEvent;
 		event ManagedControllerStateChangedHandler^ ZWOnControllerStateChanged
@@ -229,7 +278,23 @@ namespace OpenZWaveDotNet
 		 *
 		 * \see Create, Get
 		 */
-		void Destroy(){ Manager::Get()->Destroy(); }
+		void Destroy();
+
+		/**
+		 * \brief Deliver notifications in batches, to OnNotificationBatch, instead of one at a time to OnNotification.
+		 *
+		 * Each notification is copied as a ZWNotificationRecord into a native ring without entering
+		 * managed code, so the driver thread is not held up by delegates or garbage collection.  A thread
+		 * of the wrapper's takes whatever has collected, up to batchSize records, into a pinned array that
+		 * is reused for every batch, and calls OnNotificationBatch with it.  If the ring fills up, the driver
+		 * waits for room rather than dropping notifications.
+		 * Call this after Create and before AddDriver.  Batching lasts until Destroy.
+		 * \param capacity the number of notifications the ring holds.
+		 * \param batchSize the most notifications delivered in one call.
+		 * \return true if batching was enabled, or false if it already was.
+		 * \see OnNotificationBatch, ZWNotificationRecord
+		 */
+		bool EnableNotificationBatching( uint32 capacity, uint32 batchSize );
 
 		/**
 		 * \brief Get the Version Number of OZW as a string
@@ -427,6 +492,14 @@ namespace OpenZWaveDotNet
 		 */
 		String^ GetControllerPath( uint32 homeId ) { return gcnew String(Manager::Get()->GetControllerPath(homeId).c_str()); }
 
+		/**
+		 * \brief Get the operating system's id for one of the driver's threads.
+		 * \param homeId The Home ID of the Z-Wave controller.
+		 * \param thread "driver", "poll" or "controller".
+		 * \return the thread id, or zero if there is no such thread.
+		 */
+		UInt64 GetDriverThreadId( uint32 homeId, String^ thread ) { return Manager::Get()->GetDriverThreadId( homeId, (const char*)(Marshal::StringToHGlobalAnsi(thread)).ToPointer() ); }
+
 	/*@}*/					   
 
 	//-----------------------------------------------------------------------------
@@ -509,6 +582,20 @@ namespace OpenZWaveDotNet
 		 */
 		uint8 GetPollIntensity( ZWValueID^ valueId ) { return Manager::Get()->GetPollIntensity( valueId->CreateUnmanagedValueID()); }
 
+		/**
+		 * \brief Set the time between polls of a value, in milliseconds.
+		 * \param valueId The ID of the value whose poll interval should be set.
+		 * \param milliseconds The time between polls, or zero to go back to using the poll intensity.
+		 */
+		void SetValuePollInterval( ZWValueID^ valueId, uint32 milliseconds ) { Manager::Get()->SetValuePollInterval(valueId->CreateUnmanagedValueID(), milliseconds); }
+
+		/**
+		 * \brief Get the time between polls of a value, in milliseconds.
+		 * \param valueId The ID of the value to check.
+		 * \return The time between polls, or zero if it is derived from the poll intensity.
+		 */
+		uint32 GetValuePollInterval( ZWValueID^ valueId ) { return Manager::Get()->GetValuePollInterval( valueId->CreateUnmanagedValueID()); }
+
 	/*@}*/
 
 	//-----------------------------------------------------------------------------
@@ -1186,6 +1273,15 @@ namespace OpenZWaveDotNet
 		 */
 		bool RefreshValue( ZWValueID^ id ){ return Manager::Get()->RefreshValue(id->CreateUnmanagedValueID()); }
 
+		/**
+		 * \brief Refreshes the specified value from the Z-Wave network, unless it was read within the last maxAge milliseconds.
+		 * A value recent enough is reported with a ValueRefreshed notification straight away.
+		 * \param id The unique identifier of the value to be refreshed.
+		 * \param maxAge The oldest the value may be, in milliseconds.  0 always asks the device, and -1 uses the RefreshMaxAge option.
+		 * \return true if the driver and node were found; false otherwise
+		 */
+		bool RefreshValue( ZWValueID^ id, int32 maxAge ){ return Manager::Get()->RefreshValue(id->CreateUnmanagedValueID(), maxAge); }
+
 		/**
 		 * \brief Sets a flag indicating whether value changes noted upon a refresh should be verified.  If so, the
 		 * library will immediately refresh the value a second time whenever a change is observed.  This helps to filter
@@ -1195,6 +1291,30 @@ namespace OpenZWaveDotNet
 		 */
 		void SetChangeVerified( ZWValueID^ id, bool verify ){ Manager::Get()->SetChangeVerified(id->CreateUnmanagedValueID(), verify); }
 
+		/**
+		 * \brief Sets the shortest time between notifications for a value.  Notifications that
+		 * arrive sooner are merged, so that only the latest value is reported.
+		 * \param id The unique identifier of the value.
+		 * \param milliseconds the interval, or zero to deliver every notification.
+		 */
+		void SetValueNotificationInterval( ZWValueID^ id, uint32 milliseconds ){ Manager::Get()->SetValueNotificationInterval(id->CreateUnmanagedValueID(), milliseconds); }
+
+		/**
+		 * \brief Gets the shortest time between notifications for a value.
+		 * \param id The unique identifier of the value.
+		 * \return the interval in milliseconds, or zero if every notification is delivered.
+		 */
+		uint32 GetValueNotificationInterval( ZWValueID^ id ){ return Manager::Get()->GetValueNotificationInterval(id->CreateUnmanagedValueID()); }
+
+		/**
+		 * \brief Sets a deadband for a decimal, int or short value.  Reports that differ from
+		 * the last notified value by no more than the deadband are not notified.
+		 * \param id The unique identifier of the value.
+		 * \param deadband the largest change to hold back, or zero to notify every report.
+		 * \param percent if true, the deadband is a percentage of the last notified value.
+		 */
+		void SetValueDeadband( ZWValueID^ id, float deadband, bool percent ){ Manager::Get()->SetValueDeadband(id->CreateUnmanagedValueID(), deadband, percent); }
+
 		/**
 		 * \brief Starts an activity in a device.
 		 *
@@ -1293,6 +1413,13 @@ namespace OpenZWaveDotNet
 		 * \see GetNumSwitchPoints
 		 */
 		bool GetSwitchPoint( ZWValueID^ id, uint8 idx, [Out] System::Byte %o_value, [Out] System::Byte %o_minutes, [Out] System::SByte %o_setback );
+
+		/**
+		 * \brief Sends a schedule to the device, if its switch points have changed.
+		 * \param id The unique identifier of the schedule value.
+		 * \return true if the schedule was sent or the device already holds it.
+		 */
+		bool SetSchedule( ZWValueID^ id ){ return Manager::Get()->SetSchedule( id->CreateUnmanagedValueID() ); }
 		
 	/*@}*/
 
@@ -2207,17 +2334,23 @@ namespace OpenZWaveDotNet
 	/*@}*/
 
 	public:
-		ZWManager(){}
+		ZWManager(): m_notificationQueue( NULL ){}
 
 	private:
 
 		void  OnNotificationFromUnmanaged(Notification* _notification,void* _context);					// Forward notification to managed delegates hooked via Event addhandler 
 		void  OnControllerStateChangedFromUnmanaged(Driver::ControllerState _state,void* _context);		// Forward controller state change to managed delegates hooked via Event addhandler 
+		void  NotificationBatchThreadProc();															// Deliver batches from m_notificationQueue until it is stopped
 
 		GCHandle										m_gchNotification;
 		OnNotificationFromUnmanagedDelegate^			m_onNotification;
 
 		GCHandle										m_gchControllerState;
 		OnControllerStateChangedFromUnmanagedDelegate^	m_onStateChanged;
+
+		ZWNotificationQueue*							m_notificationQueue;		// NULL unless batching
+		array<ZWNotificationRecord>^					m_notificationBatch;
+		GCHandle										m_gchNotificationBatch;		// Pins m_notificationBatch for the native queue to copy into
+		Thread^											m_notificationBatchThread;
 	};
 }
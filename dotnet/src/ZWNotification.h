@@ -86,7 +86,15 @@ namespace OpenZWaveDotNet
 			AllNodesQueried					= Notification::Type_AllNodesQueried,
 			Notification					= Notification::Type_Notification,
 			DriverRemoved					= Notification::Type_DriverRemoved,
-			ControllerCommand				= Notification::Type_ControllerCommand
+			ControllerCommand				= Notification::Type_ControllerCommand,
+			ConfigSaved						= Notification::Type_ConfigSaved,
+			ConfigProvisioning				= Notification::Type_ConfigProvisioning,
+			DoorLockLogRecords				= Notification::Type_DoorLockLogRecords,
+			NetworkHealthScan				= Notification::Type_NetworkHealthScan,
+			RefreshRoundComplete			= Notification::Type_RefreshRoundComplete,
+			NodeQueryStage					= Notification::Type_NodeQueryStage,
+			FirmwareUpdate					= Notification::Type_FirmwareUpdate,
+			ControllerNvm					= Notification::Type_ControllerNvm
 		};
 
 	public:
@@ -98,7 +106,9 @@ namespace OpenZWaveDotNet
 			Awake = Notification::Code_Awake,
 			Sleep = Notification::Code_Sleep,
 			Dead = Notification::Code_Dead,
-			Alive = Notification::Code_Alive
+			Alive = Notification::Code_Alive,
+			Flooding = Notification::Code_Flooding,
+			Expired = Notification::Code_Expired
 		};
 
 		ZWNotification( Notification* notification )
@@ -130,4 +140,49 @@ namespace OpenZWaveDotNet
 		uint8		m_byte;
 		uint8		m_event;
 	};
+
+	/** \brief A notification as plain data, for batched delivery.
+	 *
+	 * Records are delivered in a preallocated array that is reused for each batch,
+	 * so nothing is allocated per notification.  The value id and the value's
+	 * string are only created if asked for.  A ValuesAdded notification arrives
+	 * as a ValueAdded record for each value.
+	 */
+	[StructLayout(LayoutKind::Sequential)]
+	public value struct ZWNotificationRecord
+	{
+	public:
+		ZWNotification::Type GetType(){ return (ZWNotification::Type)m_type; }
+		ZWNotification::Code GetCode(){ return (ZWNotification::Code)m_byte; }
+		uint32 GetHomeId(){ return m_homeId; }
+		uint8 GetNodeId(){ return (uint8)( ( m_valueId & 0xff000000 ) >> 24 ); }
+		uint8 GetGroupIdx(){ assert(ZWNotification::Type::Group==GetType()); return m_byte; }
+		uint8 GetEvent(){ return m_event; }
+		uint8 GetByte(){ return m_byte; }
+
+		ZWValueID^ GetValueID(){ return gcnew ZWValueID( ValueID( m_homeId, m_valueId ) ); }
+
+		/**
+		 * The current value as a string.  It is read when this is called, so a
+		 * later change to the value may already be reflected.
+		 */
+		String^ GetValueAsString()
+		{
+			string value;
+			if( !Manager::Get()->GetValueAsString( ValueID( m_homeId, m_valueId ), &value ) )
+			{
+				return nullptr;
+			}
+			return gcnew String( value.c_str() );
+		}
+
+	internal:
+		// Same layout as the native NotificationRecord
+		uint64		m_valueId;
+		uint32		m_homeId;
+		uint8		m_type;
+		uint8		m_byte;
+		uint8		m_event;
+		uint8		m_reserved;
+	};
 }
@@ -0,0 +1,186 @@
+//-----------------------------------------------------------------------------
+//
+//      ZWNotificationQueue.cpp
+//
+//      Native queue that collects notifications for the .NET wrapper
+//
+//      SOFTWARE NOTICE AND LICENSE
+//
+//      This file is part of OpenZWave.
+//
+//      OpenZWave is free software: you can redistribute it and/or modify
+//      it under the terms of the GNU Lesser General Public License as published
+//      by the Free Software Foundation, either version 3 of the License,
+//      or (at your option) any later version.
+//
+//      OpenZWave is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU Lesser General Public License for more details.
+//
+//      You should have received a copy of the GNU Lesser General Public License
+//      along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#include "ZWNotificationQueue.h"
+
+using namespace OpenZWaveDotNet;
+using namespace OpenZWave;
+
+// None of this touches managed objects, so the driver threads that call
+// OnNotification never make the transition into the CLR.
+#pragma managed(push, off)
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::ZWNotificationQueue>
+//	Constructor
+//-----------------------------------------------------------------------------
+ZWNotificationQueue::ZWNotificationQueue
+(
+	uint32 _capacity
+):
+	m_records( new NotificationRecord[_capacity] ),
+	m_capacity( _capacity ),
+	m_head( 0 ),
+	m_count( 0 ),
+	m_stopping( false )
+{
+	InitializeCriticalSection( &m_lock );
+	m_dataEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+	m_spaceEvent = CreateEvent( NULL, FALSE, FALSE, NULL );
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::~ZWNotificationQueue>
+//	Destructor
+//-----------------------------------------------------------------------------
+ZWNotificationQueue::~ZWNotificationQueue
+(
+)
+{
+	CloseHandle( m_spaceEvent );
+	CloseHandle( m_dataEvent );
+	DeleteCriticalSection( &m_lock );
+	delete [] m_records;
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::OnNotification>
+//	Copy a notification into the ring.  A ValuesAdded notification is split
+//	into the ValueAdded notifications it replaces.
+//-----------------------------------------------------------------------------
+void ZWNotificationQueue::OnNotification
+(
+	Notification const* _notification,
+	void* _context
+)
+{
+	ZWNotificationQueue* queue = (ZWNotificationQueue*)_context;
+	if( Notification::Type_ValuesAdded == _notification->GetType() )
+	{
+		vector<ValueID> const& valueIds = _notification->GetValueIDs();
+		for( vector<ValueID>::const_iterator it = valueIds.begin(); it != valueIds.end(); ++it )
+		{
+			queue->Push( _notification, *it, Notification::Type_ValueAdded );
+		}
+		return;
+	}
+
+	queue->Push( _notification, _notification->GetValueID(), (uint8)_notification->GetType() );
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::Push>
+//	Add a record, waiting for room if the ring is full
+//-----------------------------------------------------------------------------
+void ZWNotificationQueue::Push
+(
+	Notification const* _notification,
+	ValueID const& _valueId,
+	uint8 _type
+)
+{
+	EnterCriticalSection( &m_lock );
+	while( m_count == m_capacity && !m_stopping )
+	{
+		LeaveCriticalSection( &m_lock );
+		WaitForSingleObject( m_spaceEvent, INFINITE );
+		EnterCriticalSection( &m_lock );
+	}
+
+	if( !m_stopping )
+	{
+		NotificationRecord& record = m_records[( m_head + m_count ) % m_capacity];
+		record.m_valueId = _valueId.GetId();
+		record.m_homeId = _valueId.GetHomeId();
+		record.m_type = _type;
+		record.m_byte = _notification->GetByte();
+		record.m_event = 0;
+		record.m_reserved = 0;
+		if( ( Notification::Type_NodeEvent == _type ) || ( Notification::Type_ControllerCommand == _type ) )
+		{
+			record.m_event = _notification->GetEvent();
+		}
+
+		if( 0 == m_count++ )
+		{
+			SetEvent( m_dataEvent );
+		}
+	}
+	LeaveCriticalSection( &m_lock );
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::Pop>
+//	Wait for records and copy as many as are waiting, up to _max
+//-----------------------------------------------------------------------------
+uint32 ZWNotificationQueue::Pop
+(
+	NotificationRecord* o_records,
+	uint32 _max
+)
+{
+	EnterCriticalSection( &m_lock );
+	while( 0 == m_count && !m_stopping )
+	{
+		LeaveCriticalSection( &m_lock );
+		WaitForSingleObject( m_dataEvent, INFINITE );
+		EnterCriticalSection( &m_lock );
+	}
+
+	uint32 count = ( m_count < _max ) ? m_count : _max;
+	uint32 first = m_capacity - m_head;
+	if( first > count )
+	{
+		first = count;
+	}
+	memcpy( o_records, &m_records[m_head], first * sizeof(NotificationRecord) );
+	memcpy( &o_records[first], m_records, ( count - first ) * sizeof(NotificationRecord) );
+
+	if( m_count == m_capacity && count > 0 )
+	{
+		SetEvent( m_spaceEvent );
+	}
+	m_head = ( m_head + count ) % m_capacity;
+	m_count -= count;
+	LeaveCriticalSection( &m_lock );
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+//	<ZWNotificationQueue::Stop>
+//	Release the threads waiting on the ring
+//-----------------------------------------------------------------------------
+void ZWNotificationQueue::Stop
+(
+)
+{
+	EnterCriticalSection( &m_lock );
+	m_stopping = true;
+	LeaveCriticalSection( &m_lock );
+	SetEvent( m_dataEvent );
+	SetEvent( m_spaceEvent );
+}
+
+#pragma managed(pop)
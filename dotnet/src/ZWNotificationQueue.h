@@ -0,0 +1,75 @@
+//-----------------------------------------------------------------------------
+//
+//      ZWNotificationQueue.h
+//
+//      Native queue that collects notifications for the .NET wrapper
+//
+//      SOFTWARE NOTICE AND LICENSE
+//
+//      This file is part of OpenZWave.
+//
+//      OpenZWave is free software: you can redistribute it and/or modify
+//      it under the terms of the GNU Lesser General Public License as published
+//      by the Free Software Foundation, either version 3 of the License,
+//      or (at your option) any later version.
+//
+//      OpenZWave is distributed in the hope that it will be useful,
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//      GNU Lesser General Public License for more details.
+//
+//      You should have received a copy of the GNU Lesser General Public License
+//      along with OpenZWave.  If not, see <http://www.gnu.org/licenses/>.
+//
+//-----------------------------------------------------------------------------
+
+#pragma once
+#include "Windows.h"
+#include "Notification.h"
+
+namespace OpenZWaveDotNet
+{
+	// A notification reduced to plain data, laid out as ZWNotificationRecord
+	struct NotificationRecord
+	{
+		uint64	m_valueId;		// ValueID::GetId
+		uint32	m_homeId;
+		uint8	m_type;
+		uint8	m_byte;
+		uint8	m_event;
+		uint8	m_reserved;
+	};
+
+	// Ring of NotificationRecords filled by the driver threads without entering
+	// managed code, and emptied in batches by the wrapper's dispatch thread.
+	// If the ring is full, the driver waits for the dispatch thread to make
+	// room rather than losing a notification.
+	class ZWNotificationQueue
+	{
+	public:
+		ZWNotificationQueue( uint32 _capacity );
+		~ZWNotificationQueue();
+
+		// Manager watcher.  _context is the queue.
+		static void OnNotification( OpenZWave::Notification const* _notification, void* _context );
+
+		// Wait for notifications and copy up to _max of them into o_records.
+		// Returns zero once Stop has been called and the ring is empty.
+		uint32 Pop( NotificationRecord* o_records, uint32 _max );
+
+		// Wake the dispatch thread, and any driver waiting for room, for shutdown
+		void Stop();
+
+	private:
+		void Push( OpenZWave::Notification const* _notification, OpenZWave::ValueID const& _valueId, uint8 _type );
+
+		NotificationRecord*	m_records;
+		uint32				m_capacity;
+		uint32				m_head;			// Next record to pop
+		uint32				m_count;
+		bool				m_stopping;
+		CRITICAL_SECTION	m_lock;
+		HANDLE				m_dataEvent;	// Auto reset.  Set when the ring stops being empty.
+		HANDLE				m_spaceEvent;	// Auto reset.  Set when the ring stops being full.
+	};
+}